@@ -25,14 +25,17 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "permutohedral.h"
-#include <unordered_map>
+#include <mutex>
 #include "macroses.h"
+#include "simd.h"
+#include "DenseOCL.h"
 
 // Copy constructor
 CPermutohedral::CPermutohedral(const CPermutohedral &rhs)
     : m_nFeatures(rhs.m_nFeatures)
 	, m_M(rhs.m_M)
 	, m_featureSize(rhs.m_featureSize)
+	, m_compact(rhs.m_compact)
 {
 	if (!rhs.m_offset.empty()) rhs.m_offset.copyTo(m_offset); 
 	if (!rhs.m_barycentric.empty()) rhs.m_barycentric.copyTo(m_barycentric);
@@ -48,85 +51,153 @@ CPermutohedral & CPermutohedral::operator= (const CPermutohedral &rhs)
 	m_nFeatures		= rhs.m_nFeatures;
     m_M				= rhs.m_M;
     m_featureSize	= rhs.m_featureSize;
+    m_compact		= rhs.m_compact;
     
 	m_offset		= rhs.m_offset.empty()			? Mat() : rhs.m_offset.clone();
 	m_barycentric	= rhs.m_barycentric.empty()		? Mat() : rhs.m_barycentric.clone();
 	m_blurNeighbor1 = rhs.m_blurNeighbor1.empty()	? Mat() : rhs.m_blurNeighbor1.clone();
 	m_blurNeighbor2 = rhs.m_blurNeighbor2.empty()	? Mat() : rhs.m_blurNeighbor2.clone();
+#ifdef ENABLE_OCL
+	m_uSplatStart.release();				// the device copies are uploaded again at the next OpenCL call
+#endif
 
 	return *this;
 }
 
-struct Key {
-	Mat mat;
+namespace {
+	// Concurrent hash table of the lattice keys. The keys are distributed over the shards by their hash, every shard is an open addressing 
+	// hash table with its own lock. The keys of every shard are numbered in the order of insertion.
+	// find() takes no lock and may be called concurrently, provided that no insertions take place at the same time
+	class CLatticeHashTable {
+	public:
+		static const int N_SHARDS = 64;
 
-	bool operator==(const Key& other) const {
-		if (mat.size() != other.mat.size()) return false;
-		if (mat.type() != other.mat.type()) return false;
+		explicit CLatticeHashTable(int keySize) : m_keySize(keySize) {}
 
-		for (int y = 0; y < mat.rows; y++) {
-			const short* pMat = mat.ptr<short>(y);
-			const short* pMatOther = other.mat.ptr<short>(y);
-			for (int x = 0; x < mat.cols; x++)
-				if (pMat[x] != pMatOther[x]) return false;
+		// Returns the hash of the key
+		uint64_t hash(const short *key) const
+		{
+			uint64_t res = 0;
+			for (int i = 0; i < m_keySize; i++) {
+				res += static_cast<word>(key[i]);
+				res *= 0x9E3779B97F4A7C15ull;
+			}
+			return res ^ (res >> 32);
 		}
-		return true;
-	}
-};
-
-struct hashFunc
-{
-	std::size_t operator()(const Key &key) const
-	{
-		std::size_t res = 0;
-		const short* ptr = key.mat.ptr<short>(0);
-		for (int i = 0; i < key.mat.cols; i++) {
-			res += static_cast<size_t>(ptr[i]);
-			res *= 1664525;
+		// Returns the shard and the index of the key in the shard, inserting the key if needed
+		std::pair<int, int> insert(const short *key)
+		{
+			const uint64_t	h		= hash(key);
+			const int		shard	= static_cast<int>(h % N_SHARDS);
+			std::lock_guard<std::mutex> lock(m_vShards[shard].mtx);
+			return std::make_pair(shard, m_vShards[shard].insert(key, h, m_keySize));
 		}
-		return res;
-	}
-};
+		// Returns the shard and the index of the key in the shard, or (-1, -1) if the key is not found
+		std::pair<int, int> find(const short *key) const
+		{
+			const uint64_t	h		= hash(key);
+			const int		shard	= static_cast<int>(h % N_SHARDS);
+			const int		idx		= m_vShards[shard].find(key, h, m_keySize);
+			return idx < 0 ? std::make_pair(-1, -1) : std::make_pair(shard, idx);
+		}
+		// Returns the number of keys in the shard
+		int size(int shard) const { return static_cast<int>(m_vShards[shard].vHashes.size()); }
+		// Returns the key with index idx of the shard
+		const short * getKey(int shard, int idx) const { return m_vShards[shard].vKeys.data() + static_cast<size_t>(idx) * m_keySize; }
+
+
+	private:
+		struct Shard {
+			std::mutex				mtx;
+			std::vector<short>		vKeys;		// the keys: m_keySize values per key
+			std::vector<uint64_t>	vHashes;	// the hashes of the keys
+			std::vector<int>		vTable;		// the slots with the key indexes (-1 for empty slots), the size is a power of 2
 
-void CPermutohedral::init(const Mat &features)
+			int find(const short *key, uint64_t h, int keySize) const
+			{
+				if (vTable.empty()) return -1;
+				const size_t mask = vTable.size() - 1;
+				for (size_t slot = (h / N_SHARDS) & mask; ; slot = (slot + 1) & mask) {
+					const int idx = vTable[slot];
+					if (idx < 0) return -1;
+					if (vHashes[idx] == h && std::equal(key, key + keySize, vKeys.data() + static_cast<size_t>(idx) * keySize)) return idx;
+				}
+			}
+			int insert(const short *key, uint64_t h, int keySize)
+			{
+				int idx = find(key, h, keySize);
+				if (idx >= 0) return idx;
+
+				idx = static_cast<int>(vHashes.size());
+				vKeys.insert(vKeys.end(), key, key + keySize);
+				vHashes.push_back(h);
+				if (2 * vHashes.size() > vTable.size()) {							// the load factor is at most 1/2
+					vTable.assign(MAX(static_cast<size_t>(16), 2 * vTable.size()), -1);
+					for (int i = 0; i < static_cast<int>(vHashes.size()); i++) place(i);
+				}
+				else place(idx);
+				return idx;
+			}
+			void place(int idx)
+			{
+				const size_t mask = vTable.size() - 1;
+				size_t slot = (vHashes[idx] / N_SHARDS) & mask;
+				while (vTable[slot] >= 0) slot = (slot + 1) & mask;
+				vTable[slot] = idx;
+			}
+		};
+
+		int		m_keySize;
+		Shard	m_vShards[N_SHARDS];
+	};
+}
+
+void CPermutohedral::init(const Mat &features, bool compact)
 {
 	// Compute the lattice coordinates for each feature [there is going to be a lot of magic here
     m_nFeatures = features.rows;
     m_featureSize = features.cols;
-	std::unordered_map<Key, int, hashFunc> hash_table;
-	hash_table.reserve(m_nFeatures * (m_featureSize + 1));
-	Mat allKeys;
+	m_compact = compact;
+#ifdef ENABLE_OCL
+	m_uSplatStart.release();
+#endif
+	const int d1 = m_featureSize + 1;
+	CLatticeHashTable hashTable(m_featureSize);
 
     // Allocate the class memory
-	m_offset		= Mat(m_nFeatures, m_featureSize + 1, CV_32SC1); 
-    m_barycentric	= Mat(m_nFeatures, m_featureSize + 1, CV_32FC1);
-
-    
-    // Allocate the local memory
-    vec_float_t scale_factor(m_featureSize);
-    vec_float_t elevated(m_featureSize + 1);
-    vec_float_t rem0(m_featureSize + 1);
-    vec_float_t barycentric(m_featureSize + 2);
-    std::vector<short> rank(m_featureSize + 1);
-    std::vector<short> canonical((m_featureSize + 1) * (m_featureSize + 1));
-	Mat key(1, m_featureSize + 1, CV_16SC1);
+	m_offset		= Mat(m_nFeatures, d1, CV_32SC1); 
+    m_barycentric	= Mat(m_nFeatures, d1, CV_32FC1);
+	std::vector<byte> vShard(static_cast<size_t>(m_nFeatures) * d1);		// the shards of the lattice points: m_offset keeps the indexes in the shards first
     
     // Compute the canonical simplex
+	std::vector<short> canonical(d1 * d1);
     for(int i = 0; i <= m_featureSize; i++) {
         for(int j = 0; j <= m_featureSize - i; j++)
-            canonical[i * (m_featureSize + 1) + j] = i;
+            canonical[i * d1 + j] = i;
         for(int j = m_featureSize - i + 1; j <= m_featureSize; j++)
-            canonical[i * (m_featureSize + 1) + j] = i - (m_featureSize + 1);
+            canonical[i * d1 + j] = i - d1;
     }
     
     // Expected standard deviation of our filter (p.6 in [Adams etal 2010])
-    float inv_std_dev = sqrtf(2.f / 3.f) * (m_featureSize + 1);
+    float inv_std_dev = sqrtf(2.f / 3.f) * d1;
     // Compute the diagonal part of E (p.5 in [Adams etal 2010])
+	vec_float_t scale_factor(m_featureSize);
     for(int i = 0; i < m_featureSize; i++)
         scale_factor[i] = 1.f / sqrtf((i + 2.f) * (i + 1.f)) * inv_std_dev;
     
-    // Compute the simplex each feature lies in
-    for(int k = 0; k < m_nFeatures; k++) {
+    // Compute the simplex each feature lies in: the features are independent, the hash table is shared
+#ifdef ENABLE_PDP
+	parallel_for_(Range(0, m_nFeatures), [&](const Range &range) {
+#else
+	const Range range(0, m_nFeatures);
+#endif
+	// Allocate the local memory
+	vec_float_t elevated(d1);
+	vec_float_t rem0(d1);
+	vec_float_t barycentric(m_featureSize + 2);
+	std::vector<short> rank(d1);
+	std::vector<short> key(d1);
+	for(int k = range.start; k < range.end; k++) {
         // Elevate the feature ( y = Ep, see p.5 in [Adams etal 2010])
         const float *f = features.ptr<float>(k);
         
@@ -140,8 +211,8 @@ void CPermutohedral::init(const Mat &features)
         elevated[0] = sm;
         
         // Find the closest 0-colored simplex through rounding
-        float down_factor = 1.0f / (m_featureSize + 1);
-        float up_factor = static_cast<float>(m_featureSize + 1);
+        float down_factor = 1.0f / d1;
+        float up_factor = static_cast<float>(d1);
         int sum = 0;
         for(int i = 0; i <= m_featureSize; i++) {
             int rd = static_cast<int>(round( down_factor * elevated[i]));
@@ -163,12 +234,12 @@ void CPermutohedral::init(const Mat &features)
         for(int i = 0; i <= m_featureSize; i++) {
             rank[i] += sum;
             if ( rank[i] < 0 ){
-                rank[i] += m_featureSize + 1;
-                rem0[i] += m_featureSize + 1;
+                rank[i] += d1;
+                rem0[i] += d1;
             }
             else if (rank[i] > m_featureSize) {
-                rank[i] -= m_featureSize + 1;
-                rem0[i] -= m_featureSize + 1;
+                rank[i] -= d1;
+                rem0[i] -= d1;
             }
         }
         
@@ -186,55 +257,81 @@ void CPermutohedral::init(const Mat &features)
         // Compute all vertices and their offset
 		int		*pOffset		= m_offset.ptr<int>(k);
 		float	*pBarycentric	= m_barycentric.ptr<float>(k);
+		byte	*pShard			= vShard.data() + static_cast<size_t>(k) * d1;
 		for(int remainder = 0; remainder <= m_featureSize; remainder++) {
             for(int i = 0; i < m_featureSize; i++)
-                key.at<short>(0, i) = static_cast<short>(rem0[i] + canonical[ remainder * (m_featureSize + 1) + rank[i]]);		// TODO
+                key[i] = static_cast<short>(rem0[i] + canonical[ remainder * d1 + rank[i]]);
 			
-			auto it = hash_table.find({ key(Rect(0, 0, m_featureSize, 1)) });
-			int val = it == hash_table.end() ? -1 : it->second;
-			if (val == -1) {
-				val = static_cast<int>(hash_table.size());
-				hash_table[{ key(Rect(0, 0, m_featureSize, 1)).clone() }] = val;
-				allKeys.push_back(key(Rect(0, 0, m_featureSize, 1)));
-			}
-			pOffset[remainder]		= val;	
+			auto [shard, idx]		= hashTable.insert(key.data());
+			pShard[remainder]		= static_cast<byte>(shard);
+			pOffset[remainder]		= idx;	
 			pBarycentric[remainder]	= barycentric[remainder];		
         }
     } // k
+#ifdef ENABLE_PDP
+	});
+#endif
+
+	// Number the lattice points shard by shard
+	vec_int_t vShardStart(CLatticeHashTable::N_SHARDS + 1, 0);
+	for (int s = 0; s < CLatticeHashTable::N_SHARDS; s++) vShardStart[s + 1] = vShardStart[s] + hashTable.size(s);
+	m_M = vShardStart.back();
+#ifdef ENABLE_PDP
+	parallel_for_(Range(0, m_nFeatures), [&](const Range &range) {
+#else
+	const Range range(0, m_nFeatures);
+#endif
+	for (int k = range.start; k < range.end; k++) {
+		int			*pOffset	= m_offset.ptr<int>(k);
+		const byte	*pShard		= vShard.data() + static_cast<size_t>(k) * d1;
+		for (int j = 0; j <= m_featureSize; j++) pOffset[j] += vShardStart[pShard[j]];
+	}
+#ifdef ENABLE_PDP
+	});
+#endif
+	vShard.clear();
+	vShard.shrink_to_fit();
+
+	// The barycentric weights lie in [0; 1]
+	if (m_compact) m_barycentric.convertTo(m_barycentric, CV_16UC1, BARYCENTRIC_SCALE);
     
-    // Find the Neighbors of each lattice point
-    // Get the number of vertices in the lattice
-	m_M = static_cast<int>(hash_table.size());
-    
-    // Create the neighborhood structure
-	m_blurNeighbor1 = Mat(m_M, m_featureSize + 1, CV_32SC1);
-	m_blurNeighbor2 = Mat(m_M, m_featureSize + 1, CV_32SC1);
-    
-    Mat n1(1, m_featureSize + 1, CV_16SC1);
-    Mat n2(1, m_featureSize + 1, CV_16SC1);
-    
-    // For each of d+1 axes,
-	for (int i = 0; i < m_M; i++) {
+    // Find the Neighbors of each lattice point: the lattice points are independent, the hash table is read-only
+	m_blurNeighbor1 = Mat(m_M, d1, CV_32SC1);
+	m_blurNeighbor2 = Mat(m_M, d1, CV_32SC1);
+#ifdef ENABLE_PDP
+	parallel_for_(Range(0, m_M), [&](const Range &range) {
+#else
+	const Range range(0, m_M);
+#endif
+	std::vector<short> n1(d1);
+	std::vector<short> n2(d1);
+	auto getIndex = [&](const short *key) {
+		auto [shard, idx] = hashTable.find(key);
+		return shard < 0 ? -1 : vShardStart[shard] + idx;
+	};
+	for (int i = range.start; i < range.end; i++) {
 		int *pBlurNeighbor1 = m_blurNeighbor1.ptr<int>(i);
 		int *pBlurNeighbor2 = m_blurNeighbor2.ptr<int>(i);
 		
-		Mat key = allKeys.row(i); 
+		const int	shard	= static_cast<int>(std::upper_bound(vShardStart.begin(), vShardStart.end(), i) - vShardStart.begin()) - 1;
+		const short *key	= hashTable.getKey(shard, i - vShardStart[shard]);
 
+		// For each of d+1 axes,
 		for(int j = 0; j <= m_featureSize; j++) {
-
 			for(int k = 0; k < m_featureSize; k++) {
-                n1.at<short>(0, k) = key.at<short>(0, k) - 1;	// TODO
-                n2.at<short>(0, k) = key.at<short>(0, k) + 1;	// TODO
+                n1[k] = key[k] - 1;
+                n2[k] = key[k] + 1;
             }
-            n1.at<short>(0, j) = key.at<short>(0, std::min(j, m_featureSize - 1)) + m_featureSize;	// TODO
-            n2.at<short>(0, j) = key.at<short>(0, std::min(j, m_featureSize - 1)) - m_featureSize;	// TODO
+            n1[j] = key[std::min(j, m_featureSize - 1)] + m_featureSize;
+            n2[j] = key[std::min(j, m_featureSize - 1)] - m_featureSize;
             
-			auto it = hash_table.find({ n1(Rect(0, 0, m_featureSize, 1)) });
-			pBlurNeighbor1[j] = it == hash_table.end() ? -1 : it->second;
-			it = hash_table.find({ n2(Rect(0, 0, m_featureSize, 1)) });
-			pBlurNeighbor2[j] = it == hash_table.end() ? -1 : it->second;
+			pBlurNeighbor1[j] = getIndex(n1.data());
+			pBlurNeighbor2[j] = getIndex(n2.data());
         }
-    }
+    } // i
+#ifdef ENABLE_PDP
+	});
+#endif
 }
 
 void CPermutohedral::compute(const Mat &src, Mat &dst, int in_offset, int out_offset, size_t in_size, size_t out_size) const
@@ -243,54 +340,223 @@ void CPermutohedral::compute(const Mat &src, Mat &dst, int in_offset, int out_of
     if (out_size == 0) out_size = m_nFeatures - out_offset;
 	if (dst.empty())   dst		= Mat(static_cast<int>(out_size), src.cols, CV_32FC1);
 
+	const int nCols = src.cols;
+
     // Shift all values by 1 such that -1 -> 0 (used for blurring)
-	Mat values(m_M + 2, src.cols, CV_32FC1, Scalar(0));
-    Mat newValues(m_M + 2, src.cols, CV_32FC1, Scalar(0));
+	Mat values(m_M + 2, nCols, CV_32FC1, Scalar(0));
 
-    // Splatting
-    for(int i = 0; i < in_size; i++) {
-        const float *pIn			= src.ptr<float>(i);
-		const int	*pOffset		= m_offset.ptr<int>(in_offset + i);
-		const float	*pBarycentric	= m_barycentric.ptr<float>(in_offset + i);
-		for(int j = 0; j <= m_featureSize; j++) {
-            int   o	= pOffset[j] + 1;
-            float w = pBarycentric[j];	
-			float *pValues = values.ptr<float>(o);
-			for(int k = 0; k < src.cols; k++)
-				pValues[k] += w * pIn[k];
-        }
-    }
+    // Splatting: every chunk of the features is accumulated in its own buffer, the buffers are reduced afterwards
+#ifdef ENABLE_PDP
+	const int nChunks = MAX(1, MIN(getNumThreads(), static_cast<int>(in_size / 4096)));
+#else
+	const int nChunks = 1;
+#endif
+	vec_mat_t vValues(nChunks);
+	vValues[0] = values;
+	for (int c = 1; c < nChunks; c++) vValues[c] = Mat(m_M + 2, nCols, CV_32FC1, Scalar(0));
+	
+	auto splat = [&](const Range &range) {
+		vec_float_t barycentric(m_featureSize + 1);
+		for (int c = range.start; c < range.end; c++) {
+			const int first = static_cast<int>(in_size * c / nChunks);
+			const int last	= static_cast<int>(in_size * (c + 1) / nChunks);
+			for (int i = first; i < last; i++) {
+				const float *pIn			= src.ptr<float>(i);
+				const int	*pOffset		= m_offset.ptr<int>(in_offset + i);
+				getBarycentric(in_offset + i, barycentric.data());
+				for (int j = 0; j <= m_featureSize; j++)
+					DirectGraphicalModels::simd::axpy(barycentric[j], pIn, vValues[c].ptr<float>(pOffset[j] + 1), nCols);
+			} // i
+		} // c
+	};
+#ifdef ENABLE_PDP
+	if (nChunks > 1) {
+		parallel_for_(Range(0, nChunks), splat);
+		parallel_for_(Range(1, m_M + 1), [&](const Range &range) {
+			for (int i = range.start; i < range.end; i++) {
+				float *pValues = values.ptr<float>(i);
+				for (int c = 1; c < nChunks; c++) {
+					const float *pChunk = vValues[c].ptr<float>(i);
+					for (int k = 0; k < nCols; k++) pValues[k] += pChunk[k];
+				} // c
+			} // i
+		});
+	}
+	else
+#endif
+	splat(Range(0, 1));
+	vValues.clear();
+
+	// In the compact storage, the values are kept in half precision between the blurring passes, the arithmetic is performed in single precision.
+	// Every pass may double the values (v + (n1 + n2) / 2 <= 2 max), thus the values are scaled by the power of two, so that the largest value
+	// stays in the half range (65504) after all the passes; the scaling is exact and is undone in the slicing
+	float scale = 1.0f;
+	if (m_compact) {
+		const double maxValue = norm(values, NORM_INF);
+		if (maxValue > 0) {
+			scale = exp2f(floorf(log2f(static_cast<float>(32768.0 / (maxValue * exp2(m_featureSize + 1))))));
+			values *= scale;
+		}
+		Mat halfValues(m_M + 2, nCols, CV_16UC1);
+		DirectGraphicalModels::simd::floatToHalf(values.ptr<float>(), halfValues.ptr<word>(), (m_M + 2) * nCols);
+		values = halfValues;
+	}
+	Mat newValues(m_M + 2, nCols, values.type(), Scalar(0));
     
-    for(int j = 0; j <= m_featureSize; j++) {
-        for(int i = 0; i < m_M; i++) {
-            float *pValues		= values.ptr<float>(i + 1);
-            float *pNewValues	= newValues.ptr<float>(i + 1);
-            
-            int n1 = m_blurNeighbor1.at<int>(i, j) + 1;
-            int n2 = m_blurNeighbor2.at<int>(i, j) + 1;
-            float *n1_val = values.ptr<float>(n1);
-            float *n2_val = values.ptr<float>(n2);
-            for(int k = 0; k < src.cols; k++)
+	// Blurring: the directions are processed one after another, the lattice points of one direction are independent
+    for (int j = 0; j <= m_featureSize; j++) {
+#ifdef ENABLE_PDP
+		parallel_for_(Range(0, m_M), [&, j](const Range &range) {
+#else
+		const Range range(0, m_M);
+#endif
+		if (m_compact) {
+			vec_float_t buffer(4 * nCols);
+			float *pValues		= buffer.data();
+			float *n1_val		= pValues + nCols;
+			float *n2_val		= n1_val + nCols;
+			float *pNewValues	= n2_val + nCols;
+			for (int i = range.start; i < range.end; i++) {
+				DirectGraphicalModels::simd::halfToFloat(values.ptr<word>(i + 1), pValues, nCols);
+				DirectGraphicalModels::simd::halfToFloat(values.ptr<word>(m_blurNeighbor1.ptr<int>(i)[j] + 1), n1_val, nCols);
+				DirectGraphicalModels::simd::halfToFloat(values.ptr<word>(m_blurNeighbor2.ptr<int>(i)[j] + 1), n2_val, nCols);
+				for (int k = 0; k < nCols; k++)
+					pNewValues[k] = pValues[k] + 0.5f * (n1_val[k] + n2_val[k]);
+				DirectGraphicalModels::simd::floatToHalf(pNewValues, newValues.ptr<word>(i + 1), nCols);
+			} // i
+		}
+		else for (int i = range.start; i < range.end; i++) {
+			const float *pValues	= values.ptr<float>(i + 1);
+			float		*pNewValues	= newValues.ptr<float>(i + 1);
+			const float *n1_val		= values.ptr<float>(m_blurNeighbor1.ptr<int>(i)[j] + 1);
+			const float *n2_val		= values.ptr<float>(m_blurNeighbor2.ptr<int>(i)[j] + 1);
+			for (int k = 0; k < nCols; k++)
 				pNewValues[k] = pValues[k] + 0.5f * (n1_val[k] + n2_val[k]);
-        }
+		} // i
+#ifdef ENABLE_PDP
+		});
+#endif
 		swap(values, newValues);
     }
     // Alpha is a magic scaling constant (write Andrew if you really wanna understand this)
-    float alpha = 1.0f / (1.0f + powf(2.0f, -static_cast<float>(m_featureSize)));
+    const float alpha = 1.0f / (1.0f + powf(2.0f, -static_cast<float>(m_featureSize))) / scale;
     
     // Slicing
-    for(int i = 0; i < out_size; i++) {
+#ifdef ENABLE_PDP
+	parallel_for_(Range(0, static_cast<int>(out_size)), [&](const Range &range) {
+#else
+	const Range range(0, static_cast<int>(out_size));
+#endif
+	vec_float_t barycentric(m_featureSize + 1);
+	vec_float_t value(m_compact ? nCols : 0);
+	for (int i = range.start; i < range.end; i++) {
         float		*pOut			= dst.ptr<float>(i);
 		const int	*pOffset		= m_offset.ptr<int>(in_offset + i);
-		const float	*pBarycentric	= m_barycentric.ptr<float>(in_offset + i);
-		for(int k = 0; k < src.cols; k++)
-            pOut[k] = 0;
-        for(int j = 0; j <= m_featureSize; j++) {
-            int   o = pOffset[j] + 1;		
-            float w = pBarycentric[j];	
-			float *pValues = values.ptr<float>(o);
-			for(int k = 0; k < src.cols; k++)
-                pOut[k] += w * pValues[k] * alpha;
-        }
-    }
+		getBarycentric(in_offset + i, barycentric.data());
+		std::fill(pOut, pOut + nCols, 0.0f);
+        for (int j = 0; j <= m_featureSize; j++) {
+			const float *pValue;
+			if (m_compact) {
+				DirectGraphicalModels::simd::halfToFloat(values.ptr<word>(pOffset[j] + 1), value.data(), nCols);
+				pValue = value.data();
+			}
+			else pValue = values.ptr<float>(pOffset[j] + 1);
+			DirectGraphicalModels::simd::axpy(barycentric[j] * alpha, pValue, pOut, nCols);
+		} // j
+    } // i
+#ifdef ENABLE_PDP
+	});
+#endif
+}
+
+#ifdef ENABLE_OCL
+bool CPermutohedral::compute(const UMat &src, UMat &dst) const
+{
+	using namespace DirectGraphicalModels;
+	DGM_ASSERT_MSG(src.rows == m_nFeatures, "The number of the source rows (%d) does not match the number of the lattice features (%d)", src.rows, m_nFeatures);
+	if (!gpu::isAvailable() || !upload()) return false;
+
+	const int nCols = src.cols;
+	const int d1	= m_featureSize + 1;
+	UMat values(m_M + 2, nCols, CV_32FC1, Scalar(0));
+	UMat newValues(m_M + 2, nCols, CV_32FC1, Scalar(0));
+	
+	// Splatting
+	ocl::Kernel splat = gpu::getKernel("splat");
+	splat.args(ocl::KernelArg::PtrReadOnly(src), ocl::KernelArg::PtrWriteOnly(values), ocl::KernelArg::PtrReadOnly(m_uSplatStart), 
+		ocl::KernelArg::PtrReadOnly(m_uSplatFeature), ocl::KernelArg::PtrReadOnly(m_uSplatWeight), nCols, m_M);
+	if (!gpu::run(splat, m_M, nCols)) return false;
+
+	// Blurring
+	for (int j = 0; j <= m_featureSize; j++) {
+		ocl::Kernel blur = gpu::getKernel("blur");
+		blur.args(ocl::KernelArg::PtrReadOnly(values), ocl::KernelArg::PtrWriteOnly(newValues), ocl::KernelArg::PtrReadOnly(m_uBlurNeighbor1), 
+			ocl::KernelArg::PtrReadOnly(m_uBlurNeighbor2), j, d1, nCols, m_M);
+		if (!gpu::run(blur, m_M, nCols)) return false;
+		swap(values, newValues);
+	}
+
+	// Slicing
+	const float alpha = 1.0f / (1.0f + powf(2.0f, -static_cast<float>(m_featureSize)));
+	dst.create(m_nFeatures, nCols, CV_32FC1);
+	ocl::Kernel slice = gpu::getKernel("slice");
+	slice.args(ocl::KernelArg::PtrReadOnly(values), ocl::KernelArg::PtrWriteOnly(dst), ocl::KernelArg::PtrReadOnly(m_uOffset), 
+		ocl::KernelArg::PtrReadOnly(m_uBarycentric), alpha, d1, nCols, m_nFeatures);
+	return gpu::run(slice, m_nFeatures, nCols);
+}
+
+#endif
+size_t CPermutohedral::getMemorySize(void) const
+{
+	size_t res = 0;
+	for (const Mat &m : { m_offset, m_barycentric, m_blurNeighbor1, m_blurNeighbor2 })
+		res += m.total() * m.elemSize();
+	return res;
+}
+
+// ------------------------------ PRIVATE ------------------------------
+void CPermutohedral::getBarycentric(int k, float *dst) const
+{
+	if (m_compact) {
+		const word *pBarycentric = m_barycentric.ptr<word>(k);
+		for (int j = 0; j <= m_featureSize; j++) dst[j] = pBarycentric[j] * (1.0f / BARYCENTRIC_SCALE);
+	}
+	else memcpy(dst, m_barycentric.ptr<float>(k), (m_featureSize + 1) * sizeof(float));
+}
+
+#ifdef ENABLE_OCL
+bool CPermutohedral::upload(void) const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!m_uSplatStart.empty()) return true;
+	if (m_offset.empty()) return false;
+
+	const int d1 = m_featureSize + 1;
+	Mat barycentric(m_nFeatures, d1, CV_32FC1);
+	for (int k = 0; k < m_nFeatures; k++) getBarycentric(k, barycentric.ptr<float>(k));
+
+	// Inverting the offsets: the features, which contribute to every lattice point
+	vec_int_t	vStart(m_M + 1, 0);
+	for (int k = 0; k < m_nFeatures; k++)
+		for (int j = 0; j < d1; j++) vStart[m_offset.at<int>(k, j) + 1]++;
+	for (int i = 0; i < m_M; i++) vStart[i + 1] += vStart[i];
+	vec_int_t	vCursor(vStart.begin(), vStart.end() - 1);
+	vec_int_t	vFeature(m_nFeatures * d1);
+	vec_float_t	vWeight(m_nFeatures * d1);
+	for (int k = 0; k < m_nFeatures; k++)
+		for (int j = 0; j < d1; j++) {
+			const int p = vCursor[m_offset.at<int>(k, j)]++;
+			vFeature[p] = k;
+			vWeight[p]	= barycentric.at<float>(k, j);
+		}
+
+	m_offset.copyTo(m_uOffset);
+	barycentric.copyTo(m_uBarycentric);
+	m_blurNeighbor1.copyTo(m_uBlurNeighbor1);
+	m_blurNeighbor2.copyTo(m_uBlurNeighbor2);
+	Mat(vFeature).copyTo(m_uSplatFeature);
+	Mat(vWeight).copyTo(m_uSplatWeight);
+	Mat(vStart).copyTo(m_uSplatStart);
+	return true;
 }
+#endif
@@ -30,6 +30,9 @@
 #pragma once
 
 #include "types.h"
+#ifdef ENABLE_OCL
+#include <mutex>
+#endif
 
 /************************************************/
 /***          Permutohedral Lattice           ***/
@@ -42,17 +45,47 @@ public:
     CPermutohedral& operator= (const CPermutohedral& rhs);
 	~CPermutohedral(void) = default;
 
-    void init(const Mat& features);
+    // compact: the barycentric weights are kept in 16 bits and the lattice values are blurred in half precision
+    void init(const Mat& features, bool compact = false);
     void compute(const Mat& src, Mat& dst, int in_offset = 0, int out_offset = 0, size_t in_size = 0, size_t out_size = 0) const;
+    // Returns the size of the lattice tables in bytes
+    size_t getMemorySize(void) const;
+#ifdef ENABLE_OCL
+    // OpenCL version of compute() for all the features of the lattice: the lattice tables are uploaded to the device at the first call and stay there.
+    // Returns false if the OpenCL device may not be used
+    bool compute(const UMat& src, UMat& dst) const;
+#endif
 
     
+private:
+    static const int BARYCENTRIC_SCALE = 0xFFFF;
+
+    void getBarycentric(int k, float *dst) const;
+#ifdef ENABLE_OCL
+    bool upload(void) const;
+#endif
+
+
 private:
     int	m_nFeatures         = 0;        // Number of elements
     int	m_M                 = 0;        // Size of sparse discretized space
     int m_featureSize       = 0;        // Dimension of features
+    bool m_compact          = false;    // Compact storage
     
     Mat m_offset			= Mat();
-    Mat	m_barycentric       = Mat();
+    Mat	m_barycentric       = Mat();    // CV_32FC1 or CV_16UC1 with the weights scaled by BARYCENTRIC_SCALE in the compact storage
     Mat	m_blurNeighbor1		= Mat();
 	Mat	m_blurNeighbor2		= Mat();
+
+#ifdef ENABLE_OCL
+    // The device copies of the lattice tables
+    mutable std::mutex  m_mtx;
+    mutable UMat        m_uOffset;
+    mutable UMat        m_uBarycentric;         // always in single precision
+    mutable UMat        m_uBlurNeighbor1;
+    mutable UMat        m_uBlurNeighbor2;
+    mutable UMat        m_uSplatStart;          // the splatting is a gather: the features of the lattice point i are m_uSplatFeature[m_uSplatStart[i]; m_uSplatStart[i + 1])
+    mutable UMat        m_uSplatFeature;
+    mutable UMat        m_uSplatWeight;
+#endif
 };
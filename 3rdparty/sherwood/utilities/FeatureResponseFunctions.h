@@ -52,6 +52,11 @@ namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
 		* @returns A single precision response value.
 		*/
 		float							GetResponse(const IDataPointCollection &data, size_t index) const;
+		/**
+		* @brief Returns the direction vector
+		* @returns The pointer to the \a nFeatures elements of the direction vector
+		*/
+		const float					  * GetDirection(void) const { return m_pDx; }
 
 
 	private:
@@ -34,6 +34,14 @@ void HistogramAggregator::Aggregate(const HistogramAggregator& aggregator)
 	m_sampleCount += aggregator.m_sampleCount;
 } 
 
+void HistogramAggregator::Aggregate(unsigned char state, unsigned long count)
+{
+	assert(state < m_nStates);
+
+	m_pBins[state] += count;
+	m_sampleCount += count;
+}
+
 HistogramAggregator HistogramAggregator::DeepClone() const
 {
 	HistogramAggregator res(m_nStates);
@@ -22,10 +22,12 @@ namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
 		void				Clear(void);
 		void				Aggregate(const IDataPointCollection& data, size_t index);
 		void				Aggregate(const HistogramAggregator& aggregator);
+		void				Aggregate(unsigned char state, unsigned long count);
 		HistogramAggregator	DeepClone(void) const;
 
 		unsigned long		SampleCount(void) const {return m_sampleCount;}
 		float				GetProbability(int classIndex) const {return (float)(m_pBins[classIndex]) / m_sampleCount;}
+		unsigned long		GetBinCount(int classIndex) const {return m_pBins[classIndex];}
 		double				Entropy(void) const;
 		double				Entropy(unsigned char state) const;
 		unsigned char		FindTallestBinIndex(void) const;
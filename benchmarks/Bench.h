@@ -0,0 +1,53 @@
+#pragma once
+
+#include "benchmark/benchmark.h"
+#include "types.h"
+#include "DGM.h"
+#include "DGM/random.h"
+
+using namespace DirectGraphicalModels;
+
+// Synthetic inputs, shared by the benchmarks. The data is drawn from a fixed random stream, so that the runs are comparable
+namespace bench
+{
+	const byte	nFeatures	= 3;
+
+	// Returns the feature image Mat(size: size; type: CV_8UC(nFeatures)), where the features of every pixel are drawn around the value of its class
+	inline Mat getFeatures(Size size, byte nStates, Mat &gt)
+	{
+		random::CPhilox generator = random::getStream(0);
+		gt.create(size, CV_8UC1);
+		Mat res(size, CV_8UC(nFeatures));
+		for (int y = 0; y < size.height; y++)
+			for (int x = 0; x < size.width; x++) {
+				const byte s = static_cast<byte>((x / 16 + y / 16) % nStates);			// blocks of 16 x 16 pixels
+				gt.at<byte>(y, x) = s;
+				for (byte f = 0; f < nFeatures; f++)
+					res.ptr<byte>(y)[x * nFeatures + f] = static_cast<byte>(random::u<int>(generator, 0, 60) + 195 * (s + f) / (nStates + nFeatures));
+			}
+		return res;
+	}
+
+	// Returns the node potentials Mat(size: size; type: CV_32FC(nStates)) in range [0.1; 1]
+	inline Mat getPotentials(Size size, byte nStates)
+	{
+		random::CPhilox generator = random::getStream(0);
+		Mat res(size, CV_32FC(nStates));
+		for (int y = 0; y < size.height; y++) {
+			float *pRes = res.ptr<float>(y);
+			for (int i = 0; i < size.width * nStates; i++) pRes[i] = random::U<float>(generator, 0.1f, 1.0f);
+		}
+		return res;
+	}
+
+	// Returns the 8-bit color image with smooth gradients and noise
+	inline Mat getImage(Size size)
+	{
+		random::CPhilox generator = random::getStream(0);
+		Mat res(size, CV_8UC3);
+		for (int y = 0; y < size.height; y++)
+			for (int x = 0; x < size.width; x++) 
+				res.at<Vec3b>(y, x) = Vec3b(static_cast<byte>(x), static_cast<byte>(y), static_cast<byte>(random::u<int>(generator, 0, 255)));
+		return res;
+	}
+}
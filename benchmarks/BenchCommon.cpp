@@ -0,0 +1,65 @@
+#include "Bench.h"
+#include "DGM/parallel.h"
+
+// Builds the k-d tree of range(0) random 3-dimensional keys
+static void BM_buildKDTree(benchmark::State &state)
+{
+	const int n = static_cast<int>(state.range(0));
+	Mat keys	= random::U(Size(bench::nFeatures, n), CV_8UC1, 0.0, 255.0);
+	Mat values	= random::U(Size(1, n), CV_8UC1, 0.0, 5.0);
+	for (auto _ : state) {
+		state.PauseTiming();
+		Mat k = keys.clone();															// the tree sorts the keys in place
+		Mat v = values.clone();
+		state.ResumeTiming();
+		CKDTree tree;
+		tree.build(k, v);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_buildKDTree)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+// Queries 10000 random keys with range(1) nearest neighbours in the k-d tree of range(0) keys
+static void BM_queryKDTree(benchmark::State &state)
+{
+	const int		n = static_cast<int>(state.range(0));
+	const size_t	k = static_cast<size_t>(state.range(1));
+	Mat keys	= random::U(Size(bench::nFeatures, n), CV_8UC1, 0.0, 255.0);
+	Mat values	= random::U(Size(1, n), CV_8UC1, 0.0, 5.0);
+	Mat queries	= random::U(Size(bench::nFeatures, 10000), CV_8UC1, 0.0, 255.0);
+	CKDTree tree;
+	tree.build(keys, values);
+	Mat labels;
+	for (auto _ : state)
+		tree.knnSearch(queries, k, labels);
+	state.SetItemsProcessed(state.iterations() * queries.rows);
+}
+BENCHMARK(BM_queryKDTree)->ArgsProduct({ { 10000, 1000000 }, { 1, 8 } })->Unit(benchmark::kMillisecond);
+
+// Multiplies two random range(0) x range(0) matrices
+static void BM_gemm(benchmark::State &state)
+{
+	const int n = static_cast<int>(state.range(0));
+	Mat A = random::U(Size(n, n), CV_32FC1);
+	Mat B = random::U(Size(n, n), CV_32FC1);
+	Mat res;
+	for (auto _ : state)
+		parallel::gemm(A, B, 1.0f, Mat(), 0.0f, res);
+	state.counters["FLOPS"] = benchmark::Counter(2.0 * n * n * n * state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_gemm)->RangeMultiplier(4)->Range(64, 1024)->Unit(benchmark::kMillisecond);
+
+// Sorts lexicographically range(0) random rows of 3 bytes
+static void BM_sortRows(benchmark::State &state)
+{
+	const int n = static_cast<int>(state.range(0));
+	Mat m = random::U(Size(bench::nFeatures, n), CV_8UC1, 0.0, 255.0);
+	for (auto _ : state) {
+		state.PauseTiming();
+		Mat data = m.clone();
+		state.ResumeTiming();
+		parallel::sortRows<byte>(data);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_sortRows)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,35 @@
+#include "Bench.h"
+#include "FEX.h"
+
+namespace
+{
+	using extractor_t = std::function<Mat(const fex::CCommonFeatureExtractor &)>;
+
+	const std::vector<std::pair<std::string, extractor_t>> vExtractors = {
+		{ "Coordinate",	[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getCoordinate().get(); } },
+		{ "Intensity",	[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getIntensity().get(); } },
+		{ "HSV",		[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getHSV().get(); } },
+		{ "Gradient",	[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getGradient().get(); } },
+		{ "NDVI",		[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getNDVI().get(); } },
+		{ "Distance",	[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getDistance().get(); } },
+		{ "HOG",		[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getHOG().get(); } },
+		{ "DenseSIFT",	[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getDenseSIFT().get(); } },
+		{ "Variance",	[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.getVariance().get(); } },
+		{ "Scale",		[](const fex::CCommonFeatureExtractor &fExtractor) { return fExtractor.reScale().get(); } },
+	};
+}
+
+// Extracts the feature range(0) (ref. vExtractors) from the image of size range(1) x range(1)
+static void BM_extractFeature(benchmark::State &state)
+{
+	const auto &extractor = vExtractors[state.range(0)];
+	const Size	size(static_cast<int>(state.range(1)), static_cast<int>(state.range(1)));
+	Mat img = bench::getImage(size);
+	state.SetLabel(extractor.first);
+	for (auto _ : state) 
+		benchmark::DoNotOptimize(extractor.second(fex::CCommonFeatureExtractor(img)));
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_extractFeature)
+	->ArgsProduct({ benchmark::CreateDenseRange(0, static_cast<int64_t>(vExtractors.size()) - 1, 1), { 256, 1024 } })
+	->Unit(benchmark::kMillisecond);
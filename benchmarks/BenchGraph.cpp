@@ -0,0 +1,68 @@
+#include "Bench.h"
+
+// Builds the grid graph of size range(0) x range(0) with the storage range(1) (ref. GraphType)
+static void BM_buildGraph(benchmark::State &state)
+{
+	const byte	nStates	= 6;
+	const Size	size(static_cast<int>(state.range(0)), static_cast<int>(state.range(0)));
+	CGraphPairwiseKit graphKit(nStates, INFER::LBP, static_cast<GraphType>(state.range(1)));
+	for (auto _ : state) {
+		graphKit.getGraph().reset();
+		graphKit.getGraphExt().buildGraph(size);
+	}
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_buildGraph)
+	->ArgsProduct({ { 128, 512 }, { static_cast<int64_t>(GraphType::pairwise), static_cast<int64_t>(GraphType::csr), static_cast<int64_t>(GraphType::grid) } })
+	->Unit(benchmark::kMillisecond);
+
+// Fills the node and edge potentials of the grid graph of size range(0) x range(0) with the storage range(1)
+static void BM_fillGraph(benchmark::State &state)
+{
+	const byte	nStates	= 6;
+	const Size	size(static_cast<int>(state.range(0)), static_cast<int>(state.range(0)));
+	CGraphPairwiseKit graphKit(nStates, INFER::LBP, static_cast<GraphType>(state.range(1)));
+	graphKit.getGraphExt().buildGraph(size);
+	Mat gt;
+	Mat features	= bench::getFeatures(size, nStates, gt);
+	Mat pots		= bench::getPotentials(size, nStates);
+	for (auto _ : state) {
+		graphKit.getGraphExt().setGraph(pots);
+		graphKit.getGraphExt().addDefaultEdgesModel(features, 100.0f, 3.0f);
+	}
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_fillGraph)
+	->ArgsProduct({ { 128, 512 }, { static_cast<int64_t>(GraphType::pairwise), static_cast<int64_t>(GraphType::csr), static_cast<int64_t>(GraphType::grid) } })
+	->Unit(benchmark::kMillisecond);
+
+// Builds the grid graph of size range(0) x range(0), fills its edges one by one and traverses its adjacency with the storage range(1): 0 - CGraphPairwise, 1 - CGraphWeiss
+static void BM_graphStorage(benchmark::State &state)
+{
+	const byte	nStates	= 6;
+	const Size	size(static_cast<int>(state.range(0)), static_cast<int>(state.range(0)));
+	std::unique_ptr<IGraphPairwise> pGraph;
+	if (state.range(1) == 0)	pGraph = std::make_unique<CGraphPairwise>(nStates);
+	else						pGraph = std::make_unique<CGraphWeiss>(nStates);
+	CGraphPairwiseExt graphExt(*pGraph, GRAPH_EDGES_GRID);
+	const Mat pots	= bench::getPotentials(size, nStates);
+	const Mat pot	= CTrainEdge::getDefaultEdgePotentials(3.0f, nStates);
+	vec_size_t vChilds;
+	for (auto _ : state) {
+		pGraph->reset();
+		graphExt.buildGraph(size);
+		graphExt.setGraph(pots);
+		size_t nEdges = 0;
+		for (size_t n = 0; n < pGraph->getNumNodes(); n++) {
+			pGraph->getChildNodes(n, vChilds);
+			for (size_t c : vChilds) pGraph->setEdge(n, c, pot);
+			nEdges += vChilds.size();
+		}
+		benchmark::DoNotOptimize(nEdges);
+	}
+	state.SetItemsProcessed(state.iterations() * size.area());
+	state.counters["bytes"] = static_cast<double>(pGraph->getMemoryUsage());
+}
+BENCHMARK(BM_graphStorage)
+	->ArgsProduct({ { 128, 512 }, { 0, 1 } })
+	->Unit(benchmark::kMillisecond);
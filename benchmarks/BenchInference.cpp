@@ -0,0 +1,48 @@
+#include "Bench.h"
+
+// Decodes the grid graph of size range(1) x range(1) with range(2) states with the inference range(0) (ref. INFER)
+static void BM_decode(benchmark::State &state)
+{
+	const INFER	infer	= static_cast<INFER>(state.range(0));
+	const Size	size(static_cast<int>(state.range(1)), static_cast<int>(state.range(1)));
+	const byte	nStates	= static_cast<byte>(state.range(2));
+	CGraphPairwiseKit graphKit(nStates, infer, GraphType::csr);
+	graphKit.getGraphExt().buildGraph(size);
+	Mat pots = bench::getPotentials(size, nStates);
+	for (auto _ : state) {
+		state.PauseTiming();
+		graphKit.getGraphExt().setGraph(pots);											// the inference overwrites the node potentials
+		graphKit.getGraphExt().addDefaultEdgesModel(100.0f, 3.0f);
+		state.ResumeTiming();
+		benchmark::DoNotOptimize(graphKit.getInfer().decode(10));
+	}
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_decode)
+	->ArgsProduct({ { static_cast<int64_t>(INFER::LBP), static_cast<int64_t>(INFER::ResidualBP), static_cast<int64_t>(INFER::TRW), 
+					  static_cast<int64_t>(INFER::Viterbi), static_cast<int64_t>(INFER::GraphCut) }, { 64, 256 }, { 2, 6, 32 } })
+	->Unit(benchmark::kMillisecond);
+
+// Decodes the dense CRF of size range(0) x range(0) with range(1) states
+static void BM_decodeDense(benchmark::State &state)
+{
+	const Size	size(static_cast<int>(state.range(0)), static_cast<int>(state.range(0)));
+	const byte	nStates	= static_cast<byte>(state.range(1));
+	CGraphDenseKit graphKit(nStates);
+	Mat gt;
+	Mat features	= bench::getFeatures(size, nStates, gt);
+	Mat pots		= bench::getPotentials(size, nStates);
+	for (auto _ : state) {
+		state.PauseTiming();
+		graphKit.getGraph().reset();
+		graphKit.getGraphExt().setGraph(pots);
+		graphKit.getGraphExt().addDefaultEdgesModel(100.0f, 3.0f);
+		graphKit.getGraphExt().addDefaultEdgesModel(features, 300.0f, 10.0f);
+		state.ResumeTiming();
+		benchmark::DoNotOptimize(graphKit.getInfer().decode(10));
+	}
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_decodeDense)
+	->ArgsProduct({ { 128, 512 }, { 2, 6, 32 } })
+	->Unit(benchmark::kMillisecond);
@@ -0,0 +1,49 @@
+#include "Bench.h"
+
+namespace
+{
+	const byte	nStates	= 6;
+	const Size	size(256, 256);
+
+	const std::vector<int64_t> vModels = {
+		NodeRandomModel::Bayes,
+		NodeRandomModel::GM,
+		NodeRandomModel::GMM,
+		NodeRandomModel::KNN,
+		NodeRandomModel::CvGM,
+		NodeRandomModel::CvGMM,
+		NodeRandomModel::CvKNN,
+		NodeRandomModel::CvRF,
+#ifdef USE_SHERWOOD
+		NodeRandomModel::MsRF,
+#endif
+	};
+}
+
+// Adds the samples of the feature image to the node trainer range(0) (ref. NodeRandomModel) and trains it
+static void BM_trainNode(benchmark::State &state)
+{
+	Mat gt;
+	Mat features = bench::getFeatures(size, nStates, gt);
+	for (auto _ : state) {
+		auto nodeTrainer = CTrainNode::create(static_cast<NodeRandomModel>(state.range(0)), nStates, bench::nFeatures);
+		nodeTrainer->addFeatureVecs(features, gt);
+		nodeTrainer->train();
+	}
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_trainNode)->ArgsProduct({ vModels })->Unit(benchmark::kMillisecond);
+
+// Calculates the node potentials of the feature image with the trained node trainer range(0)
+static void BM_predictNode(benchmark::State &state)
+{
+	Mat gt;
+	Mat features = bench::getFeatures(size, nStates, gt);
+	auto nodeTrainer = CTrainNode::create(static_cast<NodeRandomModel>(state.range(0)), nStates, bench::nFeatures);
+	nodeTrainer->addFeatureVecs(features, gt);
+	nodeTrainer->train();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(nodeTrainer->getNodePotentials(features));
+	state.SetItemsProcessed(state.iterations() * size.area());
+}
+BENCHMARK(BM_predictNode)->ArgsProduct({ vModels })->Unit(benchmark::kMillisecond);
@@ -0,0 +1,4 @@
+#include "benchmark/benchmark.h"
+
+// The results are written in the JSON format with --benchmark_out=<file> --benchmark_out_format=json
+BENCHMARK_MAIN();
@@ -21,8 +21,6 @@ int main(int argc, char *argv[])
 	Mat		  imgR			= imread(argv[2], 0);	if (imgR.empty()) printf("Can't open %s\n", argv[2]);
 	int		  minDisparity	= atoi(argv[3]);
 	int		  maxDisparity	= atoi(argv[4]);
-	int		  width			= imgL.cols;
-	int		  height		= imgL.rows;
 	unsigned int nStates	= maxDisparity - minDisparity;
 
 	CGraphPairwiseKit graphKit(nStates, INFER::TRW);
@@ -32,23 +30,9 @@ int main(int argc, char *argv[])
 	graphKit.getGraphExt().addDefaultEdgesModel(1.175f);
 
 	// ==================== Building and filling the graph ====================
-	Mat nodePot(nStates, 1, CV_32FC1);										// node Potential (column-vector)
-	size_t idx = 0;
-	for (int y = 0; y < height; y++) {
-		byte * pImgL	= imgL.ptr<byte>(y);
-		byte * pImgR	= imgR.ptr<byte>(y);
-		for (int x = 0; x < width; x++) {
-			float imgL_value = static_cast<float>(pImgL[x]);
-			for (unsigned int s = 0; s < nStates; s++) {					// state
-				int disparity = minDisparity + s;
-				float imgR_value = (x + disparity < width) ? static_cast<float>(pImgR[x + disparity]) : imgL_value;
-				float p = 1.0f - fabs(imgL_value - imgR_value) / 255.0f;
-				nodePot.at<float>(s, 0) = p * p;
-			}
-
-			graphKit.getGraph().setNode(idx++, nodePot);
-		} // x
-	} // y
+	Timer::start("Filling the graph... ");
+	graphKit.getGraphExt().setGraph(CStereoCost(minDisparity, maxDisparity).getPotentials(imgL, imgR));
+	Timer::stop();
 
 	// =============================== Decoding ===============================
 	Timer::start("Decoding... ");
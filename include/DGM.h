@@ -5,8 +5,19 @@
 #include "DGM/FeaturesConcatenator.h"
 #include "DGM/KDGauss.h"
 #include "DGM/KDTree.h"
+#include "DGM/KDForest.h"
 #include "DGM/random.h"
 #include "DGM/parallel.h"
+#include "DGM/numa.h"
+#include "DGM/Pipeline.h"
+#include "DGM/profiler.h"
+#include "DGM/footprint.h"
+#include "DGM/simd.h"
+#include "DGM/kernels.h"
+#include "DGM/ModelFile.h"
+#include "DGM/ModelHandle.h"
+#include "DGM/DatasetLoader.h"
+#include "DGM/StereoCost.h"
 
 #include "DGM/IPDF.h"
 #include "DGM/PDFHistogram.h"
@@ -31,6 +42,7 @@
 #include "DGM/TrainNodeMsRF.h"
 #include "DGM/TrainNodeCvANN.h"
 #include "DGM/TrainNodeCvSVM.h"
+#include "DGM/TrainNodeCascade.h"
 #include "DGM/TrainEdge.h"
 #include "DGM/TrainEdgePotts.h"
 #include "DGM/TrainEdgePottsCS.h"
@@ -48,31 +60,63 @@
 #include "DGM/GraphDenseExt.h"
 #include "DGM/GraphPairwiseExt.h"
 #include "DGM/GraphLayeredExt.h"
+#include "DGM/GraphSuperpixelExt.h"
+#include "DGM/GraphVolumeExt.h"
 
 #include "DGM/GraphDense.h"
 #include "DGM/IGraphPairwise.h"
 #include "DGM/GraphPairwise.h"
+#include "DGM/GraphPairwiseCSR.h"
+#include "DGM/GraphGrid.h"
 #include "DGM/GraphWeiss.h"
 #include "DGM/Graph3.h"
+#include "DGM/GraphReorder.h"
+#include "DGM/LabelSpace.h"
 
 #include "DGM/IEdgeModel.h"
 #include "DGM/EdgeModelPotts.h"
+#include "DGM/EdgeModelCompatibility.h"
 
 #include "DGM/Infer.h"
 #include "DGM/InferExact.h"
 #include "DGM/InferDense.h"
+#include "DGM/InferDenseDownsampled.h"
+#include "DGM/DenseOCL.h"
 #include "DGM/InferChain.h"
+#include "DGM/InferChainBatch.h"
 #include "DGM/InferTree.h"
+#include "DGM/InferJunctionTree.h"
 #include "DGM/InferLBP.h"
+#include "DGM/InferLBP3.h"
+#include "DGM/InferResidualBP.h"
 #include "DGM/InferTRW.h"
 #include "DGM/InferViterbi.h"
+#include "DGM/InferGraphCut.h"
+#include "DGM/InferSGM.h"
+#include "DGM/InferDualDecomposition.h"
+#include "DGM/InferGibbs.h"
+#include "DGM/InferMeanField.h"
+#include "DGM/InferPartitioned.h"
+#include "DGM/InferPnPotts.h"
+#include "DGM/MaxFlow.h"
+#include "DGM/InferTiled.h"
+#include "DGM/InferSlabs.h"
+#include "DGM/InferMultiscale.h"
+#include "DGM/InferBatch.h"
+#include "DGM/InferPerturbMAP.h"
+#include "DGM/AutoTuner.h"
 
 #include "DGM/Decode.h"
 #include "DGM/DecodeExact.h"
+#include "DGM/LabelEncoding.h"
 
 #include "DGM/ParamEstimationPSO.h"
 #include "DGM/ParamEstimation.h"
 #include "DGM/ParamEstimationPowell.h"
+#include "DGM/ParamEstimationBO.h"
+#include "DGM/ParamEstimationDense.h"
+#include "DGM/ParamEstimationPL.h"
+#include "DGM/EdgeTuner.h"
 
 /**
 @mainpage Introduction
@@ -110,6 +154,8 @@ DGM implements the following training methods:
 - <b>MsRF:</b> Microsoft Research Random Forest training @ref DirectGraphicalModels::CTrainNodeMsRF
 - <b>CvANN:</b> OpenCV Artificial Neural Network training @ref DirectGraphicalModels::CTrainNodeCvANN
 - <b>CvSVM:</b> OpenCV Support Vector Machine training @ref DirectGraphicalModels::CTrainNodeCvSVM
+- <b>DNN:</b> Multilayer perceptron training (DNN module) @ref DirectGraphicalModels::CTrainNodeDNN
+- <b>Cascade:</b> Early-exit cascade of the node trainers above @ref DirectGraphicalModels::CTrainNodeCascade
 
 The corresponding classes are @b CTrainNode* (where @b * is the name of the method above). The difference between these methods is described at forum:
 <a href="http://www.project-10.de/forum/viewtopic.php?f=22&t=954">Training of a Random Model</a>.
@@ -128,11 +174,29 @@ DGM implements the following inference and decoding methods:
 @subsubsection sec_main_decode_inference Inference
 - <b>Exact:</b> Exact inferece for small graphs with an exhaustive search @ref DirectGraphicalModels::CInferExact
 - <b>Chain:</b> Exact inferece for Markov chains (chain-structured graphs) @ref DirectGraphicalModels::CInferChain
+- <b>Chain Batch:</b> Exact inferece and decoding for many independent Markov chains without building the graphs @ref DirectGraphicalModels::CInferChainBatch
 - <b>Tree:</b> Exact inferece for undirected graphs without loops (tree-structured graphs) @ref DirectGraphicalModels::CInferTree
+- <b>Junction Tree:</b> Exact inference and decoding for graphs with low treewidth via the min-fill elimination and the calibration of the clique tree @ref DirectGraphicalModels::CInferJunctionTree
 - <b>LBP:</b> Approximate inference based on the Loopy Belief Propagation (\a sum-product message-passing) algorithm @ref DirectGraphicalModels::CInferLBP 
+- <b>LBP Triplet:</b> Approximate inference based on the Loopy Belief Propagation on the factor graphs with triplets @ref DirectGraphicalModels::CInferLBP3 
+- <b>Residual BP:</b> Approximate inference based on the Loopy Belief Propagation with residual message scheduling @ref DirectGraphicalModels::CInferResidualBP 
 - <b>TRW:</b> Approximate inference based on the (<a href="http://pub.ist.ac.at/~vnk/papers/TRW-S-PAMI.pdf" target="_blank">Convergent Tree-Reweighted</a>) (\a max-sum message-passing) algorithm @ref DirectGraphicalModels::CInferTRW 
+- <b>Gibbs:</b> Approximate inference based on the chromatic (parallel) Gibbs sampling with the stored samples of the posterior @ref DirectGraphicalModels::CInferGibbs 
+- <b>Mean Field:</b> Approximate inference based on the fully factorized (mean-field) approximation for the sparse pairwise graphs @ref DirectGraphicalModels::CInferMeanField 
+- <b>Partitioned:</b> Approximate inference based on the Loopy Belief Propagation over the graph partitions with the halo exchange of the cut messages @ref DirectGraphicalModels::CInferPartitioned 
+- <b>Pn-Potts:</b> Approximate inference based on the max-product Loopy Belief Propagation with the higher-order robust P<sup>n</sup>-Potts clique potentials @ref DirectGraphicalModels::CInferPnPotts 
 - <b>Viterbi:</b> Approximate inference based on Viterbi (\a max-sum message-passing) algorithm @ref DirectGraphicalModels::CInferViterbi 
+- <b>Graph Cut:</b> Approximate decoding based on the (<a href="https://www.csd.uwo.ca/~yboykov/Papers/pami01.pdf" target="_blank">alpha-expansion</a>) algorithm with the Boykov-Kolmogorov max-flow @ref DirectGraphicalModels::CInferGraphCut 
+- <b>SGM:</b> Fast approximate decoding of the 2D grids with the semi-global matching along 8 or 16 scanline directions @ref DirectGraphicalModels::CInferSGM 
+- <b>Dual Decomposition:</b> Approximate decoding of 2D grid graphs, decomposed into the row and column chains, with the lower bound of the energy @ref DirectGraphicalModels::CInferDualDecomposition 
+- <b>Batch:</b> Inference over many small graphs, parallelized over the graphs @ref DirectGraphicalModels::CInferBatch 
+- <b>Perturb-and-MAP:</b> Sampling of the MAP solutions with the Gumbel-perturbed unaries, solved concurrently on one graph @ref DirectGraphicalModels::CInferPerturbMAP 
+- <b>Multiscale:</b> Coarse-to-fine decoding of 2D grid graphs, where the messages are initialized from a coarser level @ref DirectGraphicalModels::CInferMultiscale 
+- <b>Tiled:</b> Decoding of large images tile by tile with overlapping margins and bounded memory @ref DirectGraphicalModels::CInferTiled 
+- <b>Slabs:</b> Decoding of large 3D volumes and video streams slab by slab with overlapping margins and bounded memory @ref DirectGraphicalModels::CInferSlabs 
+- <b>Auto-tuner:</b> Selection of the inference method, schedule, precision, graph storage and tile size for the time and memory budgets @ref DirectGraphicalModels::CAutoTuner 
 - <b>Dense:</b> Efficient inference for \a dense CRFs with Gaussian edge potentials (<a href="http://vladlen.info/publications/efficient-inference-in-fully-connected-crfs-with-gaussian-edge-potentials/" target="_blank">paper</a>) @ref DirectGraphicalModels::CInferDense
+- <b>Dense Downsampled:</b> Dense inference on a downsampled graph with the full-resolution refinement @ref DirectGraphicalModels::CInferDenseDownsampled
 
 The corresponding classes are @b CInfer* (where @b * is the name of the method above). 
 
@@ -147,6 +211,9 @@ The corresponding classes are @b CDecode* (where @b * is the name of the method
 DGM implements the following parameter estimation methods:
 - <b>CParamEstimationPowell:</b> CParamEstimationPowell search method @ref DirectGraphicalModels::CParamEstimationPowell
 - <b>CParamEstimationPSO:</b> Particle Swarm Optimization method @ref DirectGraphicalModels::CParamEstimationPSO
+- <b>CParamEstimationBO:</b> Bayesian optimization method with a Gaussian process surrogate @ref DirectGraphicalModels::CParamEstimationBO
+- <b>CParamEstimationDense:</b> Gradient-based training of the dense CRF edge models @ref DirectGraphicalModels::CParamEstimationDense
+- <b>CParamEstimationPL:</b> Pseudo-likelihood training of the pairwise CRF parameters @ref DirectGraphicalModels::CParamEstimationPL
 
 @subsection sec_main_sampling Sampling
 DGM implements the following sampling method:
@@ -1,8 +1,13 @@
 #pragma once
+#include "DNN/Activation.h"
+#include "DNN/ConvLayer.h"
 #include "DNN/Neuron.h"
 #include "DNN/NeuronLayer.h"
 #include "DNN/NeuronLayerBias.h"
 #include "DNN/Perceptron.h"
+#include "DNN/PerceptronTrainer.h"
+#include "DNN/QuantizedPerceptron.h"
+#include "DNN/TrainNodeDNN.h"
 // #include "DNN/Functions.hpp"
 
 /**
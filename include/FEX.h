@@ -2,6 +2,8 @@
 
 #include "FEX/CommonFeatureExtractor.h"
 #include "FEX/SparseDictionary.h"
+#include "FEX/TiledExtractor.h"
+#include "FEX/FeaturePyramid.h"
 
 /**
 @defgroup moduleFEX FEX Module
@@ -55,6 +57,7 @@ Please see also our tutorial: @ref demofex.
  Gradient             | DirectGraphicalModels::fex::CGradient	  | CV_8UC1 or CV_8UC3 | CV_8UC1
  HOG                  | DirectGraphicalModels::fex::CHOG		  | CV_8UC1 or CV_8UC3 | CV_8UC{nBins}
  SIFT                 | DirectGraphicalModels::fex::CSIFT		  | CV_8UC1 or CV_8UC3 | CV_8UC{128}
+ Gradient Descriptors | DirectGraphicalModels::fex::CGradientDescriptors | CV_8UC1 or CV_8UC3 | CV_8UC{1 + nBins + 128}
  Intensity            | DirectGraphicalModels::fex::CIntensity    | CV_8UC3            | CV_8UC1
  NDVI                 | DirectGraphicalModels::fex::CNDVI		  | CV_8UC3            | CV_8UC1
  Hue-Saturation-Value | DirectGraphicalModels::fex::CHSV          | CV_8UC3            | CV_8UC3
@@ -74,6 +77,7 @@ Variance             | DirectGraphicalModels::fex::global::getVariance    | CV_8
 Area                 | DirectGraphicalModels::fex::global::getArea        | CV_8UC1 or CV_8UC3 | int
 Perimeter            | DirectGraphicalModels::fex::global::getPerimeter   | CV_8UC1 or CV_8UC3 | int
 Compactness          | DirectGraphicalModels::fex::global::getCompactness | CV_8UC1 or CV_8UC3 | float
+Batch of Features    | DirectGraphicalModels::fex::global::get            | vec_mat_t          | CV_32FC1
 
 
 */
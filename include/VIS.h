@@ -3,6 +3,7 @@
 #include "VIS/Marker.h"
 #include "VIS/MarkerGraph.h"
 #include "VIS/MarkerHistogram.h"
+#include "VIS/ProgressViewer.h"
 
 /**
 @defgroup moduleVIS VIS Module
@@ -16,7 +17,9 @@ Marker module provides with a variety of tools for visualizing and analyzing use
 - @ref DirectGraphicalModels::vis::CMarkerHistogram::showHistogram() "CMarkerHistogram::showHistogram()" for showing the window with the feature distribution histograms with <b>user interaction</b> capacity;
 - @ref DirectGraphicalModels::vis::drawDictionary()                  "drawDictionary()" for visualizing the sparse dictionaries;
 - @ref DirectGraphicalModels::vis::drawGraph()                       "drawGraph()" for visualizing the graphical models;
-- @ref DirectGraphicalModels::vis::showGraph3D()                     "showGraph3D()" for visualizing the graphical models in 3D with <b>user interaction</b> capacity.
+- @ref DirectGraphicalModels::vis::showGraph3D()                     "showGraph3D()" for visualizing the graphical models in 3D with <b>user interaction</b> capacity;
+- @ref DirectGraphicalModels::vis::CGraphViewer3D                    "CGraphViewer3D" for the interactive 3D viewing of large graphs, whose colors are updated during the inference;
+- @ref DirectGraphicalModels::vis::CProgressViewer                   "CProgressViewer" for watching the beliefs of a running inference without stalling it.
 
 For user interaction capacity, there are more functions, which allow for handling the mouse clicks over the figures. Please see our tutorial @ref demovis for more details.
 
@@ -1,9 +1,11 @@
 #pragma once
 
-namespace DirectGraphicalModels {
-#ifndef _CRT_STRINGIZE
-    #define __CRT_STRINGIZE(_Value) #_Value
-    #define _CRT_STRINGIZE(_Value) __CRT_STRINGIZE(_Value)
+#include <type_traits>
+
+namespace DirectGraphicalModels {
+#ifndef _CRT_STRINGIZE
+    #define __CRT_STRINGIZE(_Value) #_Value
+    #define _CRT_STRINGIZE(_Value) __CRT_STRINGIZE(_Value)
 #endif
 #define __ATTRIBUTES__ " in \"" __FILE__ "\", line " _CRT_STRINGIZE(__LINE__) ""
 #define DGM_ASSERT(_condition_) \
@@ -104,45 +106,134 @@ namespace DirectGraphicalModels {
 		}
 	}
 
+	/// @cond
+	namespace impl {
+		// Copies the features of pixel x of the planar layout into <pVec>: for N > 0 the number of features is known at compile time and the loop is unrolled
+		template<int N>
+		inline void gatherFeatures(const byte * const *vpM, int x, int nFeatures, byte *pVec)
+		{
+			if constexpr (N > 0)	for (int f = 0; f < N; f++) pVec[f] = vpM[f][x];
+			else					for (int f = 0; f < nFeatures; f++) pVec[f] = vpM[f][x];
+		}
+
+		// Calls <body> with std::integral_constant<int, N> for the usual numbers of features N, and with N = 0 for all other
+		template<typename F>
+		inline void dispatchFeatures(int nFeatures, F &&body)
+		{
+			switch (nFeatures) {
+				case 1:  body(std::integral_constant<int, 1>()); break;
+				case 2:  body(std::integral_constant<int, 2>()); break;
+				case 3:  body(std::integral_constant<int, 3>()); break;
+				case 4:  body(std::integral_constant<int, 4>()); break;
+				default: body(std::integral_constant<int, 0>()); break;
+			}
+		}
+
+		// The rows, given by <rows>, or all the <nRows> rows, if <rows> is Range::all()
+		inline Range getRows(const Range &rows, int nRows)
+		{
+			return rows.start == Range::all().start && rows.end == Range::all().end ? Range(0, nRows) : rows;
+		}
+	}
+	/// @endcond
+
+	/**
+	* @brief Declares the callee of the traversals thread-safe
+	* @details The traversals of the parallel namespace (\a e.g. parallel::vectorwise1()) process the rows of the block concurrently only for the classes \a T,
+	* whose method may be called concurrently for different pixels. Such classes specialise this trait:
+	* @code
+	* template<> struct is_thread_safe<CMyAccumulator> : std::true_type {};
+	* @endcode
+	*/
+	template<typename T> struct is_thread_safe : std::false_type {};
+
 	// For: CTrainNode::addFeatureVec()
+	// The interleaved features of every pixel are passed as a Mat header over the block, without copying
 	template<typename T, void (T::*SomeMethod)(const Mat &vec, byte b)>
-	inline void DGM_VECTORWISE1(T &self, const Mat &m1, const Mat &m2)
+	inline void DGM_VECTORWISE1(T &self, const Mat &m1, const Mat &m2, const Range &rows = Range::all())
 	{
 		// Assertions
 		DGM_ASSERT(m1.size() == m2.size());
 		DGM_ASSERT(m1.depth() == CV_8U);
 		DGM_ASSERT(m2.type() == CV_8UC1);
 
-		Mat vec(m1.channels(), 1, CV_8UC1);
-		for (int y = 0; y < m2.rows; y++) {
+		const int	nFeatures	= m1.channels();
+		const Range	r			= impl::getRows(rows, m2.rows);
+		for (int y = r.start; y < r.end; y++) {
 			const byte *pM1 = m1.ptr<byte>(y);
 			const byte *pM2 = m2.ptr<byte>(y);
 			for (int x = 0; x < m2.cols; x++) {
-				for (int f = 0; f < vec.rows; f++) vec.at<byte>(f, 0) = pM1[vec.rows * x + f];
+				const Mat vec(nFeatures, 1, CV_8UC1, const_cast<byte *>(pM1 + nFeatures * x));
 				(self.*SomeMethod)(vec, pM2[x]);
 			} // x
 		} // y
 	}
 
+	// The planar features of every pixel are gathered with the loop, specialised on the number of features
 	template<typename T, void (T::*SomeMethod)(const Mat &vec, byte b)>
-	inline void DGM_VECTORWISE1(T &self, const vec_mat_t &m1, const Mat &m2)
+	inline void DGM_VECTORWISE1(T &self, const vec_mat_t &m1, const Mat &m2, const Range &rows = Range::all())
 	{
 		// Assertions
 		DGM_ASSERT(m1[0].size() == m2.size());
 		DGM_ASSERT(m1[0].type() == CV_8UC1);
 		DGM_ASSERT(m2.type() == CV_8UC1);
 
-		const word nFeatures = static_cast<word>(m1.size());
+		const int	nFeatures	= static_cast<int>(m1.size());
+		const Range	r			= impl::getRows(rows, m2.rows);
 		Mat vec(nFeatures, 1, CV_8UC1);
 		std::vector<const byte *> vM1(nFeatures);
-		for (int y = 0; y < m2.rows; y++) {
-			for (int f = 0; f < vec.rows; f++) vM1[f] = m1[f].ptr<byte>(y);
-			const byte *pM2 = m2.ptr<byte>(y);
-			for (int x = 0; x < m2.cols; x++) {
-				for (int f = 0; f < vec.rows; f++) vec.at<byte>(f, 0) = vM1[f][x];
-				(self.*SomeMethod)(vec, pM2[x]);
-			} // x
-		} // y
+		impl::dispatchFeatures(nFeatures, [&](auto N) {
+			for (int y = r.start; y < r.end; y++) {
+				for (int f = 0; f < nFeatures; f++) vM1[f] = m1[f].ptr<byte>(y);
+				const byte *pM2 = m2.ptr<byte>(y);
+				for (int x = 0; x < m2.cols; x++) {
+					impl::gatherFeatures<decltype(N)::value>(vM1.data(), x, nFeatures, vec.data);
+					(self.*SomeMethod)(vec, pM2[x]);
+				} // x
+			} // y
+		});
+	}
+
+	// For: CTrainNode::addFeatureVecBlock()
+	// The rows of the interleaved block are passed at once, without copying
+	template<typename T, void (T::*SomeMethod)(const Mat &block, const Mat &gt)>
+	inline void DGM_BLOCKWISE1(T &self, const Mat &m1, const Mat &m2, const Range &rows = Range::all())
+	{
+		// Assertions
+		DGM_ASSERT(m1.size() == m2.size());
+		DGM_ASSERT(m1.depth() == CV_8U);
+		DGM_ASSERT(m2.type() == CV_8UC1);
+
+		const Range r = impl::getRows(rows, m2.rows);
+		if (r.size() > 0) (self.*SomeMethod)(m1.rowRange(r), m2.rowRange(r));
+	}
+
+	// The planar features of several rows are gathered into one interleaved buffer of about 4096 pixels, which is passed at once
+	template<typename T, void (T::*SomeMethod)(const Mat &block, const Mat &gt)>
+	inline void DGM_BLOCKWISE1(T &self, const vec_mat_t &m1, const Mat &m2, const Range &rows = Range::all())
+	{
+		// Assertions
+		DGM_ASSERT(m1[0].size() == m2.size());
+		DGM_ASSERT(m1[0].type() == CV_8UC1);
+		DGM_ASSERT(m2.type() == CV_8UC1);
+
+		const int	nFeatures	= static_cast<int>(m1.size());
+		const Range	r			= impl::getRows(rows, m2.rows);
+		const int	nRows		= MAX(1, 4096 / MAX(1, m2.cols));
+		Mat block;
+		std::vector<const byte *> vM1(nFeatures);
+		impl::dispatchFeatures(nFeatures, [&](auto N) {
+			for (int y0 = r.start; y0 < r.end; y0 += nRows) {
+				const int y1 = MIN(y0 + nRows, r.end);
+				block.create(y1 - y0, m2.cols, CV_8UC(nFeatures));
+				for (int y = y0; y < y1; y++) {
+					for (int f = 0; f < nFeatures; f++) vM1[f] = m1[f].ptr<byte>(y);
+					byte *pBlock = block.ptr<byte>(y - y0);
+					for (int x = 0; x < m2.cols; x++) impl::gatherFeatures<decltype(N)::value>(vM1.data(), x, nFeatures, pBlock + nFeatures * x);
+				} // y
+				(self.*SomeMethod)(block, m2.rowRange(y0, y1));
+			} // y0
+		});
 	}
 
 	// For: CTrinLink::addFeatureVec()
@@ -156,13 +247,13 @@ namespace DirectGraphicalModels {
 		DGM_ASSERT(m2.type() == CV_8UC1);
 		DGM_ASSERT(m3.type() == CV_8UC1);
 
-		Mat vec(m1.channels(), 1, CV_8UC1);
+		const int nFeatures = m1.channels();
 		for (int y = 0; y < m2.rows; y++) {
 			const byte *pM1 = m1.ptr<byte>(y);
 			const byte *pM2 = m2.ptr<byte>(y);
 			const byte *pM3 = m3.ptr<byte>(y);
 			for (int x = 0; x < m2.cols; x++) {
-				for (int f = 0; f < vec.rows; f++) vec.at<byte>(f, 0) = pM1[vec.rows * x + f];
+				const Mat vec(nFeatures, 1, CV_8UC1, const_cast<byte *>(pM1 + nFeatures * x));
 				(self.*SomeMethod)(vec, pM2[x], pM3[x]);
 			} // x
 		} // y
@@ -178,17 +269,19 @@ namespace DirectGraphicalModels {
 		DGM_ASSERT(m2.type() == CV_8UC1);
 		DGM_ASSERT(m3.type() == CV_8UC1);
 
-		const word nFeatures = static_cast<word>(m1.size());
+		const int nFeatures = static_cast<int>(m1.size());
 		Mat vec(nFeatures, 1, CV_8UC1);
 		std::vector<const byte *> vM1(nFeatures);
-		for (int y = 0; y < m2.rows; y++) {
-			for (int f = 0; f < vec.rows; f++) vM1[f] = m1[f].ptr<byte>(y);
-			const byte *pM2 = m2.ptr<byte>(y);
-			const byte *pM3 = m3.ptr<byte>(y);
-			for (int x = 0; x < m2.cols; x++) {
-				for (int f = 0; f < vec.rows; f++) vec.at<byte>(f, 0) = vM1[f][x];
-				(self.*SomeMethod)(vec, pM2[x], pM3[x]);
-			} // x
-		} // y
+		impl::dispatchFeatures(nFeatures, [&](auto N) {
+			for (int y = 0; y < m2.rows; y++) {
+				for (int f = 0; f < nFeatures; f++) vM1[f] = m1[f].ptr<byte>(y);
+				const byte *pM2 = m2.ptr<byte>(y);
+				const byte *pM3 = m3.ptr<byte>(y);
+				for (int x = 0; x < m2.cols; x++) {
+					impl::gatherFeatures<decltype(N)::value>(vM1.data(), x, nFeatures, vec.data);
+					(self.*SomeMethod)(vec, pM2[x], pM3[x]);
+				} // x
+			} // y
+		});
 	}
 }
@@ -0,0 +1,80 @@
+#include "Arena.h"
+#include "macroses.h"
+#include <new>
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		size_t alignSize(size_t size) { return (size + CArena::ALIGNMENT - 1) / CArena::ALIGNMENT * CArena::ALIGNMENT; }
+	}
+
+	void CArena::reset(void)
+	{
+		if (m_vBlocks.size() > 1) {														// merging the overflow blocks
+			const size_t size = getCapacity();
+			release();
+			m_vBlocks.push_back(createBlock(size));
+		}
+		m_used = 0;
+	}
+
+	void CArena::release(void)
+	{
+		for (Block &block : m_vBlocks) deleteBlock(block);
+		m_vBlocks.clear();
+		m_used = 0;
+	}
+
+	size_t CArena::getCapacity(void) const
+	{
+		size_t res = 0;
+		for (const Block &block : m_vBlocks) res += block.size;
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void * CArena::allocateBytes(size_t size)
+	{
+		size = alignSize(MAX(size, static_cast<size_t>(1)));
+		if (m_vBlocks.empty() || m_used + size > m_vBlocks.back().size) {
+			const size_t blockSize = m_vBlocks.empty() ? size : MAX(size, 2 * m_vBlocks.back().size);
+			m_vBlocks.push_back(createBlock(blockSize));
+			m_used = 0;
+		}
+		void *res = m_vBlocks.back().data + m_used;
+		m_used += size;
+		return res;
+	}
+
+	void * CArena::getScratchBytes(size_t size, byte slot)
+	{
+		struct Scratch {
+			Block vBlocks[4] = { { NULL, 0 }, { NULL, 0 }, { NULL, 0 }, { NULL, 0 } };
+			~Scratch(void) { for (Block &block : vBlocks) deleteBlock(block); }
+		};
+		thread_local Scratch scratch;
+
+		DGM_ASSERT_MSG(slot < 4, "The scratch slot %d is out of range [0; 3]", slot);
+		Block &block = scratch.vBlocks[slot];
+		if (block.size < size) {
+			deleteBlock(block);
+			block = createBlock(alignSize(size));
+		}
+		return block.data;
+	}
+
+	CArena::Block CArena::createBlock(size_t size)
+	{
+		Block res;
+		res.data = static_cast<byte *>(::operator new(size, std::align_val_t(ALIGNMENT)));
+		res.size = size;
+		return res;
+	}
+
+	void CArena::deleteBlock(Block &block)
+	{
+		if (block.data) ::operator delete(block.data, std::align_val_t(ALIGNMENT));
+		block.data = NULL;
+		block.size = 0;
+	}
+}
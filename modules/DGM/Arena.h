@@ -0,0 +1,80 @@
+// Reusable memory arena class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Arena Class ================================
+	/**
+	* @brief Reusable aligned memory arena
+	* @details The arena serves the allocations with a pointer bump from one contiguous aligned block. The memory is not returned to the system after use:
+	* reset() invalidates all the allocations, but keeps the block, so that the subsequent allocations of the same (or smaller) total size need no
+	* system calls. If the block is exhausted, an overflow block is added, and on the next reset() the blocks are merged into one block of the total size.
+	*
+	* In addition, the arena provides the thread-local scratch buffers via getScratch(): every thread owns its own buffers, which are reused across calls.
+	* > The allocate() function is not thread-safe
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CArena
+	{
+	public:
+		static const size_t ALIGNMENT = 64;		///< Alignment of all the allocations in bytes (the cache line / AVX-512 register size)
+
+		DllExport CArena(void) : m_used(0) {}
+		DllExport ~CArena(void) { release(); }
+		CArena(const CArena &) = delete;
+		const CArena& operator= (const CArena &) = delete;
+
+		/**
+		* @brief Allocates the memory
+		* @tparam T The type of the elements
+		* @param n The number of elements
+		* @return The pointer to the uninitialized aligned memory for \b n elements, valid until reset() or release()
+		*/
+		template<typename T>
+		T*						allocate(size_t n) { return static_cast<T*>(allocateBytes(n * sizeof(T))); }
+		/**
+		* @brief Invalidates all the allocations, keeping the memory for reuse
+		*/
+		DllExport void			reset(void);
+		/**
+		* @brief Invalidates all the allocations and returns the memory to the system
+		*/
+		DllExport void			release(void);
+		/**
+		* @brief Returns the capacity of the arena
+		* @return The total size of the memory blocks in bytes
+		*/
+		DllExport size_t		getCapacity(void) const;
+		/**
+		* @brief Returns the thread-local scratch buffer
+		* @details Every thread owns its own buffers, which grow when needed and are reused across calls
+		* @tparam T The type of the elements
+		* @param n The number of elements
+		* @param slot The index of the buffer (0 - 3), which allows for several scratch buffers to be used simultaneously
+		* @return The pointer to the uninitialized aligned memory for \b n elements, valid in the calling thread until the next call with the same \b slot
+		*/
+		template<typename T>
+		static T*				getScratch(size_t n, byte slot = 0) { return static_cast<T*>(getScratchBytes(n * sizeof(T), slot)); }
+
+
+	private:
+		/// Memory block
+		struct Block {
+			byte	* data;		///< Pointer to the aligned memory
+			size_t	  size;		///< Size of the block in bytes
+		};
+
+		DllExport void			* allocateBytes(size_t size);
+		DllExport static void	* getScratchBytes(size_t size, byte slot);
+		static Block			  createBlock(size_t size);
+		static void				  deleteBlock(Block &block);
+
+
+	private:
+		std::vector<Block>	m_vBlocks;		///< The memory blocks: the first one is the main block, the others are the overflow blocks
+		size_t				m_used;			///< The number of used bytes in the last block
+	};
+}
@@ -0,0 +1,152 @@
+#include "AutoTuner.h"
+#include "InferLBP.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	TunedConfig CAutoTuner::tune(const Workload &workload, const Mat &samplePots)
+	{
+		DGM_ASSERT_MSG(workload.size.width > 0 && workload.size.height > 0, "The workload is empty");
+		DGM_ASSERT_MSG(samplePots.empty() || samplePots.type() == CV_32FC(workload.nStates), "The sample potentials must be of type CV_32FC(%d)", workload.nStates);
+		
+		const std::string signature = getSignature(workload);
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			auto it = m_cache.find(signature);
+			if (it != m_cache.end()) return it->second;
+		}
+
+		const TunedConfig res = calibrate(workload, samplePots);			// the calibration runs without the lock
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_cache.emplace(signature, res).first->second;
+	}
+
+	void CAutoTuner::apply(const TunedConfig &config, CInfer &infer)
+	{
+		auto pMessagePassing = dynamic_cast<CMessagePassing *>(&infer);
+		if (pMessagePassing) pMessagePassing->setHalfPrecision(config.halfPrecision);
+		auto pLBP = dynamic_cast<CInferLBP *>(&infer);
+		if (pLBP) pLBP->setCheckerboard(config.checkerboard);
+	}
+
+	std::string CAutoTuner::getSignature(const Workload &workload) const
+	{
+		char res[256];
+		snprintf(res, sizeof(res), "%dx%d:%d:%d:%d:%u:%lld:%zu", workload.size.width, workload.size.height, workload.nStates, workload.gType, workload.sharedEdgePots ? 1 : 0,
+			m_nIt, static_cast<long long>(m_timeBudget.count()), m_memoryBudget);
+		return res;
+	}
+
+	size_t CAutoTuner::getNumCached(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_cache.size();
+	}
+
+	void CAutoTuner::clearCache(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_cache.clear();
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// Every candidate is decoded on the same sample; the time is extrapolated to the workload and the memory is estimated for the whole workload or for the tiles
+	TunedConfig CAutoTuner::calibrate(const Workload &workload, const Mat &samplePots) const
+	{
+		const byte	nStates		= workload.nStates;
+		const bool	isBipartite	= (workload.gType & GRAPH_EDGES_DIAG) == 0;		// the checkerboard schedule needs a bipartite graph
+		Mat			pots;
+		Rect		roi;
+		if (samplePots.empty()) {
+			roi = Rect(Point(0, 0), Size(MIN(m_sampleSize.width, workload.size.width), MIN(m_sampleSize.height, workload.size.height)));
+			pots = Mat(roi.height, roi.width * nStates, CV_32FC1);
+			RNG(0x5EED).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+			pots = pots.reshape(nStates);
+		}
+		else {
+			const Size size(MIN(m_sampleSize.width, samplePots.cols), MIN(m_sampleSize.height, samplePots.rows));
+			roi		= Rect(Point((samplePots.cols - size.width) / 2, (samplePots.rows - size.height) / 2), size);
+			pots	= samplePots(roi);
+		}
+		const double scale = static_cast<double>(workload.size.width) * workload.size.height / roi.area();
+
+		// ------------------------------ Calibration ------------------------------
+		const INFER		vInfers[]		= { INFER::LBP, INFER::TRW, INFER::Viterbi };
+		const GraphType	vGraphTypes[]	= { GraphType::pairwise, GraphType::csr, GraphType::grid };
+		std::vector<TunedConfig> vConfigs;
+		for (GraphType graphType : vGraphTypes)
+			for (INFER infer : vInfers)
+				for (bool checkerboard : { false, true }) {
+					if (checkerboard && (infer != INFER::LBP || !isBipartite)) continue;
+					for (bool halfPrecision : { false, true }) {
+						TunedConfig config;
+						config.infer			= infer;
+						config.graphType		= graphType;
+						config.checkerboard		= checkerboard;
+						config.halfPrecision	= halfPrecision;
+						config.memory			= CGraphPairwiseKit::estimateMemory(workload.size, nStates, infer, graphType, workload.gType, workload.sharedEdgePots);
+
+						CGraphPairwiseKit	graphKit(nStates, infer, graphType);
+						CGraphLayeredExt	graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), 1, workload.gType);
+						graphExt.setGraph(pots);
+						m_edges(graphExt, roi);
+						apply(config, graphKit.getInfer());
+						graphKit.getInfer().setKeepPotentials(true);							// the energy is computed with the node potentials, not with the beliefs
+
+						const auto			start		= std::chrono::steady_clock::now();
+						const vec_byte_t	solution	= graphKit.getInfer().decode(m_nIt);
+						config.time		= static_cast<float>(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() * scale);
+						config.energy	= graphKit.getGraph().computeEnergy(solution);
+						vConfigs.push_back(config);
+					} // halfPrecision
+				} // checkerboard
+
+		// ------------------------------ Tiling ------------------------------
+		// Only the configurations of CInferTiled may be tiled: the whole graph is replaced with one tile graph per thread
+		if (m_memoryBudget) {
+#ifdef ENABLE_PDP
+			const size_t nThreads = static_cast<size_t>(MAX(1, getNumThreads()));
+#else
+			const size_t nThreads = 1;
+#endif
+			const int overlap = 32;
+			for (TunedConfig &config : vConfigs) {
+				if (config.memory <= m_memoryBudget || config.graphType != GraphType::grid || config.checkerboard || config.halfPrecision) continue;
+				for (int side : { 2048, 1024, 512, 256, 128, 64 }) {
+					const Size		tileSize(MIN(side, workload.size.width), MIN(side, workload.size.height));
+					const Size		extSize(MIN(tileSize.width + 2 * overlap, workload.size.width), MIN(tileSize.height + 2 * overlap, workload.size.height));
+					const size_t	nTiles	= static_cast<size_t>((workload.size.width + tileSize.width - 1) / tileSize.width) * ((workload.size.height + tileSize.height - 1) / tileSize.height);
+					const size_t	memory	= CGraphPairwiseKit::estimateMemory(extSize, nStates, config.infer, GraphType::grid, workload.gType, workload.sharedEdgePots) * MIN(nThreads, nTiles);
+					if (memory > m_memoryBudget) continue;
+					config.tileSize	= tileSize;
+					config.overlap	= overlap;
+					config.memory	= memory;
+					config.time		*= static_cast<float>(extSize.area()) / tileSize.area();			// the margins are decoded as well
+					break;
+				}
+			}
+		}
+
+		// ------------------------------ Selection ------------------------------
+		auto fitsTime = [&](const TunedConfig &config) { return m_timeBudget.count() == 0 || config.time <= m_timeBudget.count(); };
+		const TunedConfig *pBest = NULL;
+		for (const TunedConfig &config : vConfigs) {
+			if (m_memoryBudget && config.memory > m_memoryBudget) continue;
+			if (!pBest) { pBest = &config; continue; }
+			const bool fits		= fitsTime(config);
+			const bool bestFits	= fitsTime(*pBest);
+			if (fits != bestFits) {
+				if (fits) pBest = &config;
+			}
+			else if (!fits) {															// none fits the time budget: the fastest one
+				if (config.time < pBest->time) pBest = &config;
+			}
+			else {
+				const double tolerance = 1e-4 * MAX(1.0, fabs(pBest->energy));
+				if (config.energy < pBest->energy - tolerance || (fabs(config.energy - pBest->energy) <= tolerance && config.time < pBest->time)) pBest = &config;
+			}
+		}
+		DGM_ASSERT_MSG(pBest, "No configuration fits the memory budget of %zu bytes", m_memoryBudget);
+		return *pBest;
+	}
+}
@@ -0,0 +1,148 @@
+// Automatic selection of the inference configuration class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "InferTiled.h"
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+namespace DirectGraphicalModels
+{
+	/**
+	* @brief Shape descriptor of the inference workload
+	* @details The workload is a single-layer 2D grid graph, as built by @ref CGraphPairwiseExt or @ref CGraphLayeredExt (ref. CGraphPairwiseKit::estimateMemory())
+	*/
+	struct Workload {
+		Size	size;							///< The size of the grid (image)
+		byte	nStates;						///< The number of States (classes)
+		byte	gType			= GRAPH_EDGES_GRID;	///< The edge types: a combination of GRAPH_EDGES_GRID and GRAPH_EDGES_DIAG (ref. @ref graphEdgesType)
+		bool	sharedEdgePots	= true;			///< Flag indicating whether the edges share their potentials
+	};
+
+	/**
+	* @brief Inference configuration, selected by @ref CAutoTuner
+	*/
+	struct TunedConfig {
+		INFER		infer			= INFER::TRW;		///< The inference method
+		GraphType	graphType		= GraphType::csr;	///< Storage of the pairwise graph
+		bool		checkerboard	= false;			///< Flag indicating whether the checkerboard schedule is used (only for INFER::LBP, ref. CInferLBP::setCheckerboard())
+		bool		halfPrecision	= false;			///< Flag indicating whether the edge potentials are stored in the half precision (ref. CMessagePassing::setHalfPrecision())
+		Size		tileSize		= Size(0, 0);		///< The tile size for @ref CInferTiled (with the grid storage, the synchronous schedule and the single precision), or the empty size, if the whole graph fits into the memory budget
+		int			overlap			= 0;				///< The overlap margin of the tiles
+		float		time			= 0;				///< The predicted time of the inference of the whole workload in milliseconds
+		size_t		memory			= 0;				///< The estimated peak memory of the whole workload in bytes
+		double		energy			= 0;				///< The energy of the solution of the calibration sample (ref. CGraph::computeEnergy())
+	};
+
+	// ================================ Auto Tuner Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Automatic selection of the inference configuration
+	* @details This class selects the inference method, the message schedule, the precision, the storage of the graph and the tile size for a workload under
+	* the given time and memory budgets. Every candidate configuration is calibrated with a short inference on a sample of the workload, \a i.e. the central
+	* crop of the node potentials (or the random potentials, if no potentials are given), with the same edge model. The time of the whole workload is
+	* extrapolated linearly in the number of nodes, while the memory is estimated with CGraphPairwiseKit::estimateMemory(). Among the configurations, which
+	* fit into the budgets, the one with the lowest energy of the sample solution is selected; the faster one wins the ties. If no configuration fits the time
+	* budget, the fastest one is selected. If the whole graph does not fit the memory budget, the largest tile, whose graphs of all the threads fit it, is selected.
+	*
+	* The decisions are cached per workload signature (ref. getSignature()), thus the calibration runs only once for every workload shape:
+	* @code
+	* CAutoTuner tuner(std::chrono::milliseconds(500), 2ull << 30);
+	* tuner.setDefaultEdgesModel(2.0f);
+	* TunedConfig config = tuner.tune(pots);
+	* CGraphPairwiseKit graphKit(nStates, config.infer, config.graphType);
+	* CAutoTuner::apply(config, graphKit.getInfer());
+	* @endcode
+	* > Only the pairwise methods are calibrated: the dense graphs (ref. @ref CInferDense) model other (Gaussian) edge potentials and are not interchangeable with them.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CAutoTuner
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param timeBudget The time budget for the inference of one workload. Zero value means no limit
+		* @param memoryBudget The memory budget for the inference of one workload in bytes. Zero value means no limit
+		* @param nIt The number of the inference iterations
+		*/
+		DllExport CAutoTuner(std::chrono::milliseconds timeBudget, size_t memoryBudget = 0, unsigned int nIt = 10)
+			: m_timeBudget(timeBudget), m_memoryBudget(memoryBudget), m_nIt(nIt), m_sampleSize(128, 128) {}
+		DllExport ~CAutoTuner(void) = default;
+		CAutoTuner(const CAutoTuner &) = delete;
+		const CAutoTuner& operator= (const CAutoTuner &) = delete;
+
+		/**
+		* @brief Sets the edge model of the calibration graphs
+		* @details The model should be the same as the one of the workload. The region argument is the sample region of the workload.
+		* The edge model is not a part of the workload signature, thus the cached decisions are cleared
+		* @param edges The callback function, which fills the edges of a calibration graph (ref. CInferTiled::setEdgesModel())
+		*/
+		DllExport void			setEdgesModel(CInferTiled::edges_function_t edges) { m_edges = edges; clearCache(); }
+		/**
+		* @brief Sets the default data-independent edge model of the calibration graphs
+		* @param val Value, specifying the smoothness strength (ref. CGraphLayeredExt::addDefaultEdgesModel())
+		* @param weight The weighting parameter
+		*/
+		DllExport void			setDefaultEdgesModel(float val, float weight = 1.0f) { setEdgesModel([val, weight](CGraphLayeredExt &graphExt, const Rect &) { graphExt.addDefaultEdgesModel(val, weight); }); }
+		/**
+		* @brief Sets the maximal size of the calibration sample
+		* @param sampleSize The size of the central crop of the workload (default: 128 x 128)
+		*/
+		DllExport void			setSampleSize(Size sampleSize) { m_sampleSize = sampleSize; }
+		/**
+		* @brief Selects the configuration for the workload
+		* @details If the workload with the same signature has been tuned before, the cached decision is returned without the calibration.
+		* > This function is thread-safe; the concurrent calls for the same new workload may calibrate it concurrently
+		* @param workload The shape descriptor of the workload
+		* @param samplePots (optional) The node potentials of the workload or of a representative image: Mat(type: CV_32FC(nStates)). If empty,
+		* the random potentials are used for the calibration
+		* @return The selected configuration
+		*/
+		DllExport TunedConfig	tune(const Workload &workload, const Mat &samplePots = EmptyMat);
+		/**
+		* @brief Selects the configuration for the node potentials
+		* @param pots The node potentials of the workload: Mat(type: CV_32FC(nStates))
+		* @param gType The edge types: a combination of GRAPH_EDGES_GRID and GRAPH_EDGES_DIAG (ref. @ref graphEdgesType)
+		* @return The selected configuration
+		*/
+		DllExport TunedConfig	tune(const Mat &pots, byte gType = GRAPH_EDGES_GRID) { return tune(Workload{ pots.size(), static_cast<byte>(pots.channels()), gType }, pots); }
+		/**
+		* @brief Applies the schedule and the precision of the configuration to the inferer
+		* @details The inference method and the storage are chosen, when the inferer is created, \a e.g. with CGraphPairwiseKit(nStates, config.infer, config.graphType)
+		* @param config The configuration
+		* @param infer The inferer
+		*/
+		DllExport static void	apply(const TunedConfig &config, CInfer &infer);
+		/**
+		* @brief Returns the signature of the workload
+		* @details The signature includes the shape of the workload, the number of iterations and the budgets of the tuner
+		* @param workload The shape descriptor of the workload
+		* @return The signature string
+		*/
+		DllExport std::string	getSignature(const Workload &workload) const;
+		/**
+		* @brief Returns the number of the cached decisions
+		* @return The number of the tuned workload signatures
+		*/
+		DllExport size_t		getNumCached(void) const;
+		/**
+		* @brief Clears the cached decisions
+		*/
+		DllExport void			clearCache(void);
+
+
+	private:
+		TunedConfig				calibrate(const Workload &workload, const Mat &samplePots) const;
+
+
+	private:
+		std::chrono::milliseconds						m_timeBudget;		///< The time budget
+		size_t											m_memoryBudget;		///< The memory budget in bytes
+		unsigned int									m_nIt;				///< The number of the inference iterations
+		Size											m_sampleSize;		///< The maximal size of the calibration sample
+		CInferTiled::edges_function_t					m_edges = [](CGraphLayeredExt &graphExt, const Rect &) { graphExt.addDefaultEdgesModel(100.0f); };
+		std::unordered_map<std::string, TunedConfig>	m_cache;			///< The decisions per workload signature
+		mutable std::mutex								m_mtx;				///< The mutex, protecting the cache
+	};
+}
@@ -1,5 +1,7 @@
 #include "AveragePrecision.h"
+#include "ThreadPool.h"
 #include "macroses.h"
+#include <numeric>
 
 namespace DirectGraphicalModels 
 {
@@ -37,4 +39,148 @@ namespace DirectGraphicalModels
 		return res;
 	}
 
+	// For every state only the index array is sorted
+	vec_float_t getAveragePrecisions(const vec_byte_t &predictions, const Mat &potentials, const vec_byte_t &gt)
+	{
+		const size_t nNodes = predictions.size();
+		
+		// Assertions
+		DGM_ASSERT(gt.size() == nNodes);
+		DGM_ASSERT(potentials.depth() == CV_32F && potentials.isContinuous());
+		DGM_ASSERT(nNodes > 0 && (potentials.total() * potentials.channels()) % nNodes == 0);
+		DGM_ASSERT_MSG(nNodes <= 0xFFFFFFFF, "The number of nodes %zu exceeds 2^32", nNodes);
+
+		const int		nStates = static_cast<int>(potentials.total() * potentials.channels() / nNodes);
+		const float	  * pPot	= potentials.ptr<float>();
+		vec_float_t		res(nStates, 0.0f);
+
+		parallel::parallelFor(Range(0, nStates), [&](const Range &range) {
+			std::vector<dword> vIdx(nNodes);
+			for (int state = range.start; state < range.end; state++) {
+				std::iota(vIdx.begin(), vIdx.end(), 0);
+				std::stable_sort(vIdx.begin(), vIdx.end(), [pPot, nStates, state](dword left, dword right) { 
+					return pPot[static_cast<size_t>(left) * nStates + state] > pPot[static_cast<size_t>(right) * nStates + state]; 
+				});
+
+				double	ap				= 0;
+				size_t	nRelevants		= 0;				// number of relevant elements
+				size_t	nCoincidences	= 0;				// number of correct predictions
+				for (size_t i = 0; i < nNodes; i++) {
+					const dword idx = vIdx[i];
+					if (gt[idx] == state) {					// if (gt == state)
+						nRelevants++;
+						if (predictions[idx] == state) {	// if (prediction = state)
+							nCoincidences++;
+							ap += static_cast<double>(nCoincidences) / (i + 1);
+						}
+					}
+				} // i
+				res[state] = nRelevants > 0 ? static_cast<float>(ap / nRelevants) : 0.0f;
+			} // state
+		});
+		return res;
+	}
+
+	float getMeanAveragePrecision(const vec_float_t &vAP, const vec_byte_t &gt)
+	{
+		vec_bool_t vPresent(vAP.size(), false);
+		for (byte g : gt) if (g < vAP.size()) vPresent[g] = true;
+		
+		float	res		= 0.0f;
+		int		nStates = 0;
+		for (size_t s = 0; s < vAP.size(); s++)
+			if (vPresent[s]) {
+				res += vAP[s];
+				nStates++;
+			}
+		return nStates > 0 ? res / nStates : 0.0f;
+	}
+
+	// =============================== CAveragePrecision ===============================
+	CAveragePrecision::CAveragePrecision(byte nStates, word nBins) 
+		: m_nStates(nStates)
+		, m_nBins(nBins)
+		, m_vCount(static_cast<size_t>(nStates) * nBins, 0)
+		, m_vHit(static_cast<size_t>(nStates) * nBins, 0)
+		, m_vRelevant(nStates, 0)
+	{
+		DGM_ASSERT(nBins > 0);
+	}
+
+	void CAveragePrecision::reset(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		std::fill(m_vCount.begin(), m_vCount.end(), 0);
+		std::fill(m_vHit.begin(), m_vHit.end(), 0);
+		std::fill(m_vRelevant.begin(), m_vRelevant.end(), 0);
+	}
+
+	// The states are accumulated in parallel: every state has its own histograms
+	void CAveragePrecision::addPredictions(const vec_byte_t &predictions, const Mat &potentials, const vec_byte_t &gt)
+	{
+		const size_t nNodes = predictions.size();
+		
+		// Assertions
+		DGM_ASSERT(gt.size() == nNodes);
+		DGM_ASSERT(potentials.depth() == CV_32F && potentials.isContinuous());
+		DGM_ASSERT(potentials.total() * potentials.channels() == nNodes * m_nStates);
+
+		const float	* pPot = potentials.ptr<float>();
+		std::lock_guard<std::mutex> lock(m_mtx);
+
+		parallel::parallelFor(Range(0, m_nStates), [&](const Range &range) {
+			for (int state = range.start; state < range.end; state++) {
+				qword *pCount	= &m_vCount[static_cast<size_t>(state) * m_nBins];
+				qword *pHit		= &m_vHit[static_cast<size_t>(state) * m_nBins];
+				for (size_t n = 0; n < nNodes; n++) {
+					const int bin = MIN(m_nBins - 1, MAX(0, static_cast<int>(pPot[n * m_nStates + state] * m_nBins)));
+					pCount[bin]++;
+					if (gt[n] == state) {
+						m_vRelevant[state]++;
+						if (predictions[n] == state) pHit[bin]++;
+					}
+				} // n
+			} // state
+		});
+	}
+
+	// The bins are traversed in the descending order of the potentials; the hits of one bin take the evenly spaced ranks within the bin
+	float CAveragePrecision::getAveragePrecision(byte state) const
+	{
+		DGM_ASSERT(state < m_nStates);
+		std::lock_guard<std::mutex> lock(m_mtx);
+		
+		const qword *pCount = &m_vCount[static_cast<size_t>(state) * m_nBins];
+		const qword *pHit	= &m_vHit[static_cast<size_t>(state) * m_nBins];
+		if (m_vRelevant[state] == 0) return 0.0f;
+
+		double	res		= 0;
+		qword	nRank	= 0;										// number of elements in the previous bins
+		qword	nHits	= 0;										// number of hits in the previous bins
+		for (int bin = m_nBins - 1; bin >= 0; bin--) {
+			const double step = pHit[bin] ? static_cast<double>(pCount[bin]) / pHit[bin] : 0;
+			for (qword j = 1; j <= pHit[bin]; j++)
+				res += static_cast<double>(nHits + j) / (nRank + (j - 0.5) * step + 0.5);
+			nRank += pCount[bin];
+			nHits += pHit[bin];
+		} // bin
+		return static_cast<float>(res / m_vRelevant[state]);
+	}
+
+	float CAveragePrecision::getMeanAveragePrecision(void) const
+	{
+		float	res		= 0.0f;
+		int		nStates = 0;
+		for (byte s = 0; s < m_nStates; s++) {
+			bool present;
+			{
+				std::lock_guard<std::mutex> lock(m_mtx);
+				present = m_vRelevant[s] > 0;
+			}
+			if (!present) continue;
+			res += getAveragePrecision(s);
+			nStates++;
+		}
+		return nStates > 0 ? res / nStates : 0.0f;
+	}
 }
\ No newline at end of file
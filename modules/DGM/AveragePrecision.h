@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include <mutex>
 
 namespace DirectGraphicalModels 
 {
@@ -35,5 +36,84 @@ namespace DirectGraphicalModels
 	* @returns The Average Precision value
 	*/	
 	DllExport float getAveragePrecision(const vec_byte_t &predictions, const vec_float_t &potentials, const vec_byte_t &gt, byte state);
+	/**
+	* @ingroup moduleEva
+	* @brief Returns the Average Precision for all the states (classes)
+	* @details This function is equivalent to calling getAveragePrecision() for every state, but the potentials are not copied: for every state 
+	* only an array of pixel indices is sorted by the potentials of this state, and the states are processed in parallel. The pixels with equal potentials
+	* keep their original order.
+	* > This function supports PPL
+	* @param predictions The most probable configuration, returned by the CDecode::decode() function
+	* @param potentials The potential values for each node of the graph and each state: Mat(size: nNodes x nStates; type: CV_32FC1), \a e.g. the marginals, 
+	* returned by the CInfer::getResults() function. Any continuous container of the same data, \a e.g. Mat(size: width x height; type: CV_32FC(nStates)), is supported as well
+	* @param gt The groundtruth values for each node of the graph
+	* @returns The Average Precision values for every state: vector of size nStates
+	*/
+	DllExport vec_float_t getAveragePrecisions(const vec_byte_t &predictions, const Mat &potentials, const vec_byte_t &gt);
+	/**
+	* @ingroup moduleEva
+	* @brief Returns the mean Average Precision
+	* @param vAP The Average Precision values for every state, \a e.g. returned by getAveragePrecisions()
+	* @param gt The groundtruth values: the states, which do not occur in \b gt, are excluded from the mean
+	* @returns The mean Average Precision
+	*/
+	DllExport float getMeanAveragePrecision(const vec_float_t &vAP, const vec_byte_t &gt);
+
+	// ================================ Average Precision Class ================================
+	/**
+	* @ingroup moduleEva
+	* @brief Streaming approximation of the Average Precision
+	* @details This class estimates the Average Precision (ref. getAveragePrecision()) for the datasets, which are too large to hold all the potentials in
+	* memory. The potentials, which should lie in range [0; 1], are accumulated into the histograms with \a nBins bins per state, thus the memory does 
+	* not depend on the number of pixels. The hits (the pixels, whose groundtruth and predicted states are both equal to the state of interest) are assumed
+	* to be uniformly distributed over the ranks within one bin, which makes the result exact for the bins without ties of the potentials and the hits, and
+	* approximate otherwise: the error decreases with the number of bins.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CAveragePrecision
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param nBins Number of the histogram bins per state
+		*/
+		DllExport CAveragePrecision(byte nStates, word nBins = 4096);
+		DllExport ~CAveragePrecision(void) = default;
+
+		/**
+		* @brief Resets the histograms
+		*/
+		DllExport void		reset(void);
+		/**
+		* @brief Adds a chunk of the data
+		* @details This function may be called concurrently from different threads: the chunks may be added as soon as they are labelled.
+		* > This function supports PPL
+		* @param predictions The most probable states of the chunk
+		* @param potentials The potential values for each node of the chunk and each state: Mat(size: nNodes x nStates; type: CV_32FC1) (ref. getAveragePrecisions())
+		* @param gt The groundtruth values of the chunk
+		*/
+		DllExport void		addPredictions(const vec_byte_t &predictions, const Mat &potentials, const vec_byte_t &gt);
+		/**
+		* @brief Returns the approximated Average Precision for the selected state (class)
+		* @param state The state (class)
+		* @returns The Average Precision value
+		*/
+		DllExport float		getAveragePrecision(byte state) const;
+		/**
+		* @brief Returns the approximated mean Average Precision
+		* @details The states, which were not observed in the groundtruth, are excluded from the mean
+		* @returns The mean Average Precision
+		*/
+		DllExport float		getMeanAveragePrecision(void) const;
+
 
+	private:
+		byte				m_nStates;		///< The number of states (classes)
+		word				m_nBins;		///< The number of the histogram bins per state
+		std::vector<qword>	m_vCount;		///< The number of pixels in every bin: nStates x nBins
+		std::vector<qword>	m_vHit;			///< The number of hits in every bin: nStates x nBins
+		std::vector<qword>	m_vRelevant;	///< The number of the groundtruth pixels of every state: nStates
+		mutable std::mutex	m_mtx;			///< Guards the accumulation
+	};
 }
\ No newline at end of file
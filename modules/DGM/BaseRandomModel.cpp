@@ -1,8 +1,32 @@
 #include "BaseRandomModel.h"
+#include "ModelFile.h"
 #include "macroses.h"
 
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#endif
+
 namespace DirectGraphicalModels
 {
+namespace {
+	// Opens a temporary file, which is deleted on closing. tmpfile() of the Microsoft CRT creates the file in the root directory, which is usually
+	// not writable, thus the file is created in the temporary directory of the user
+	FILE *openTempFile(void)
+	{
+#ifdef _WIN32
+		char path[MAX_PATH + 1];
+		char fileName[MAX_PATH + 1];
+		const DWORD len = GetTempPathA(sizeof(path), path);
+		if (len == 0 || len > sizeof(path) || GetTempFileNameA(path, "dgm", 0, fileName) == 0) return NULL;
+		return fopen(fileName, "w+bTD");										// T: short-lived, D: deleted on closing
+#else
+		return tmpfile();
+#endif
+	}
+}
 
 void CBaseRandomModel::save(const std::string &path, const std::string &name, short idx) const
 {
@@ -25,6 +49,51 @@ void CBaseRandomModel::load(const std::string &path, const std::string &name, sh
 	fclose(pFile);
 }
 
+void CBaseRandomModel::saveModel(const std::string &fileName) const
+{
+	CModelFileWriter writer;
+	saveSections(writer);
+	writer.save(fileName);
+}
+
+void CBaseRandomModel::loadModel(const std::string &fileName, bool mapped, bool verify)
+{
+	std::shared_ptr<const CModelFile> pModelFile = CModelFile::open(fileName, mapped);
+	DGM_ASSERT_MSG(!verify || pModelFile->verify(), "The model file %s is corrupted", fileName.c_str());
+	loadSections(*pModelFile);
+	m_pModelFile = pModelFile;								// the sections may be used by the random model in place
+}
+
+// The output of saveFile() is buffered in a temporary file, which is read back in blocks: its size may exceed the range of ftell()
+void CBaseRandomModel::saveSections(CModelFileWriter &writer) const
+{
+	FILE *pFile = openTempFile();
+	DGM_ASSERT_MSG(pFile, "Can't create a temporary file");
+	saveFile(pFile);
+	rewind(pFile);
+	vec_byte_t vData;
+	byte block[65536];
+	for (size_t nRead; (nRead = fread(block, 1, sizeof(block), pFile)) > 0; )
+		vData.insert(vData.end(), block, block + nRead);
+	const bool error = ferror(pFile) != 0;
+	fclose(pFile);
+	DGM_ASSERT_MSG(!error, "Can't read the temporary file");
+	writer.addSection("stream", vData.data(), vData.size());
+}
+
+void CBaseRandomModel::loadSections(const CModelFile &file)
+{
+	const Mat data = file.getSection("stream");
+	FILE *pFile = openTempFile();
+	DGM_ASSERT_MSG(pFile, "Can't create a temporary file");
+	const size_t nWritten = fwrite(data.data, 1, data.total(), pFile);
+	if (nWritten != data.total()) fclose(pFile);
+	DGM_ASSERT_MSG(nWritten == data.total(), "Can't write the temporary file");
+	rewind(pFile);
+	loadFile(pFile);
+	fclose(pFile);
+}
+
 std::string CBaseRandomModel::generateFileName(const std::string &path, const std::string &_name, short idx) const
 {
 	std::string name;
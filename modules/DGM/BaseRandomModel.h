@@ -6,6 +6,9 @@
 
 namespace DirectGraphicalModels
 {
+	class CModelFileWriter;
+	class CModelFile;
+
 	/**
 	* @brief Random model types
 	* @details Define the maximal number of nodes in the cliques
@@ -53,6 +56,22 @@ namespace DirectGraphicalModels
 		*/		
 		DllExport virtual void	load(const std::string &path, const std::string &name = std::string(), short idx = -1); 
 		/**
+		* @brief Saves the training data into the versioned model container
+		* @details The random model is stored in the named sections of the container (Ref. @ref CModelFileWriter), which are aligned and protected with checksums.
+		* @param fileName The name of the model file
+		*/
+		DllExport void			saveModel(const std::string &fileName) const;
+		/**
+		* @brief Loads the training data from the versioned model container
+		* @details If \b mapped is \a true, the container is mapped into memory and the random models, which support this, use its sections in place: 
+		* the loading takes almost no time, and the pages of the file are shared between the processes, which load the same model.
+		* The container is kept alive by the random model until the next loadModel() call.
+		* @param fileName The name of the model file, written by the saveModel() function
+		* @param mapped Flag indicating whether the file should be mapped into memory
+		* @param verify Flag indicating whether the data of all the sections should be checked with their checksums. This requires reading the whole file
+		*/
+		DllExport void			loadModel(const std::string &fileName, bool mapped = true, bool verify = false);
+		/**
 		* @brief Returns number of states (classes)
 		* @return Number of states (features) 
 		*/		
@@ -73,6 +92,20 @@ namespace DirectGraphicalModels
 		*/	
 		DllExport virtual void	loadFile(FILE *pFile) = 0;
 		/**
+		* @brief Adds the random model to the model container
+		* @details The default implementation stores the output of the saveFile() function in one section. The derived classes may override it
+		* in order to store their data in the sections, which can be used in place after loading.
+		* @param writer The writer of the model container
+		*/
+		DllExport virtual void	saveSections(CModelFileWriter &writer) const;
+		/**
+		* @brief Loads the random model from the model container
+		* @details The default implementation passes the section, written by the default saveSections() function, to the loadFile() function.
+		* The matrices, referring to the sections of the container, stay valid as long as the random model exists.
+		* @param file The model container
+		*/
+		DllExport virtual void	loadSections(const CModelFile &file);
+		/**
 		* @brief Generates name of the data file for storing random model parameters.
 		* @details This function generated the file name as follows: \b fileName="<path><name>_<idx>.dat", where \b idx always has 5 symbols. 
 		* @param path Path to the folder, containing the data file.
@@ -84,6 +117,10 @@ namespace DirectGraphicalModels
 
 
 	protected:
-		byte	m_nStates;		///< The number of states (classes)
+		byte								m_nStates;		///< The number of states (classes)
+
+
+	private:
+		std::shared_ptr<const CModelFile>	m_pModelFile;	///< The model container, whose sections may be used by the random model
 	};
 }
@@ -1,4 +1,5 @@
 #include "CMat.h"
+#include "ThreadPool.h"
 #include "PriorEdge.h"
 #include "macroses.h"
 
@@ -31,10 +32,36 @@ void CCMat::load(const std::string &path, const std::string &name, short idx)
 	m_pConfusionMatrix->load(path, name.empty() ? "CMat" : name, idx); 
 } 
 
+// Every stripe of rows is counted into its own integer histogram; the histograms are summed up and added to the confusion matrix at once
 void CCMat::estimate(const Mat &gt, const Mat &solution, const Mat &mask)
 {
-	if (mask.empty())	DGM_ELEMENTWISE2<CCMat, &CCMat::estimate>(*this, gt, solution);
-	else				DGM_ELEMENTWISE2<CCMat, &CCMat::estimate>(*this, gt, solution, mask);
+	// Assertions
+	DGM_ASSERT(gt.size() == solution.size());
+	DGM_ASSERT(gt.type() == CV_8UC1 && solution.type() == CV_8UC1);
+	DGM_ASSERT(mask.empty() || (mask.size() == gt.size() && mask.type() == CV_8UC1));
+
+	const byte	nStates = m_pConfusionMatrix->getNumStates();
+	Mat			counts(nStates, nStates, CV_32SC1, Scalar(0));
+	std::mutex	mtx;
+
+	parallel::parallelFor(Range(0, gt.rows), [&](const Range &range) {
+		vec_int_t vCounts(nStates * nStates, 0);
+		for (int y = range.start; y < range.end; y++) {
+			const byte *pGt		= gt.ptr<byte>(y);
+			const byte *pSol	= solution.ptr<byte>(y);
+			const byte *pMask	= mask.empty() ? NULL : mask.ptr<byte>(y);
+			for (int x = 0; x < gt.cols; x++) {
+				if (pMask && !pMask[x]) continue;
+				DGM_ASSERT(pGt[x] < nStates && pSol[x] < nStates);
+				vCounts[pGt[x] * nStates + pSol[x]]++;
+			} // x
+		} // y
+		std::lock_guard<std::mutex> lock(mtx);
+		for (int i = 0; i < nStates * nStates; i++) counts.at<int>(i / nStates, i % nStates) += vCounts[i];
+	});
+
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_pConfusionMatrix->addEdgeGroundTruth(counts);
 }
 
 void CCMat::estimate(byte gt, byte solution) 
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include <mutex>
 
 namespace DirectGraphicalModels
 {
@@ -50,6 +51,13 @@ namespace DirectGraphicalModels
 		DllExport void	load(const std::string &path, const std::string &name = std::string(), short idx = -1);
 		/**
 		* @brief Estimates the confusion matrix
+		* @details The rows of the matrices are counted in parallel into the integer histograms, which are added to the confusion matrix at once.
+		* This function may be called concurrently from different threads, \a e.g. for the tiles or chunks of one large image as soon as they are labelled:
+		* @code
+		* CCMat confMat(nStates);
+		* tiledInferer.decode(imgSize, potentials, [&](const Rect &roi, const Mat &labels) { confMat.estimate(gt(roi), labels); });
+		* @endcode
+		* > This function supports PPL
 		* @param gt Matrix, each element of which is a ground-truth state (class)
 		* @param solution Matrix with the predicted states, provided by classifier
 		* @param mask Operation mask. Its non-zero elements indicate which matrix elements need to be stimated. 
@@ -60,6 +68,7 @@ namespace DirectGraphicalModels
 		* @brief Estimates the confusion matrix
 		* @param gt	The ground-truth state (class)
 		* @param solution The predicted state, provided by classifier
+		* @note In contrast to estimate(const Mat &, const Mat &, const Mat &), this function is not thread-safe
 		*/
 		DllExport void	estimate(byte gt, byte solution);
 		
@@ -82,6 +91,7 @@ namespace DirectGraphicalModels
 
 	private:
 		CPriorEdge	* m_pConfusionMatrix;		///< COnfusion matrix container
+		std::mutex	  m_mtx;					///< Guards the accumulation of the histograms
 
 	//	DllExport void	saveFile(FILE *pFile) const {CPriorEdge::saveFile(pFile);} 
 	//	DllExport void	loadFile(FILE *pFile) {CPriorEdge::loadFile(pFile);}		
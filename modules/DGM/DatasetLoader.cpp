@@ -0,0 +1,87 @@
+#include "DatasetLoader.h"
+#include "TrainNode.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	// Constructor
+	CDatasetLoader::CDatasetLoader(size_t nItems, loader_t loader, size_t nThreads, size_t capacity)
+		: m_loader(std::move(loader))
+		, m_nItems(nItems)
+		, m_nextLoad(0)
+		, m_nextConsume(0)
+		, m_stop(false)
+	{
+		DGM_ASSERT_MSG(m_loader, "The loader function is empty");
+		if (nThreads == 0) nThreads = MAX(1, std::thread::hardware_concurrency());
+		nThreads = MIN(nThreads, MAX(1, nItems));
+		if (capacity == 0) capacity = 2 * nThreads;
+		m_vSlots.resize(MAX(capacity, nThreads));
+
+		m_vWorkers.reserve(nThreads);
+		for (size_t t = 0; t < nThreads; t++)
+			m_vWorkers.emplace_back(&CDatasetLoader::work, this);
+	}
+
+	// Destructor
+	CDatasetLoader::~CDatasetLoader(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_cvFree.notify_all();
+		for (std::thread &worker : m_vWorkers) worker.join();
+	}
+
+	bool CDatasetLoader::next(item_t &item)
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		if (m_nextConsume >= m_nItems) return false;
+
+		Slot &slot = m_vSlots[m_nextConsume % m_vSlots.size()];
+		m_cvLoaded.wait(lock, [&] { return slot.ready; });
+		item = std::move(slot.item);
+		std::exception_ptr pException = slot.pException;
+		slot = Slot();
+		m_nextConsume++;
+		lock.unlock();
+		m_cvFree.notify_all();
+
+		if (pException) std::rethrow_exception(pException);
+		return true;
+	}
+
+	void CDatasetLoader::feed(CTrainNode &nodeTrainer)
+	{
+		item_t item;
+		while (next(item))
+			nodeTrainer.addFeatureVecs(item.first, item.second);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The item i may be loaded only when the slot i % capacity is free, i.e. when the item i - capacity has been consumed
+	void CDatasetLoader::work(void)
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		for (;;) {
+			m_cvFree.wait(lock, [&] { return m_stop || m_nextLoad >= m_nItems || m_nextLoad < m_nextConsume + m_vSlots.size(); });
+			if (m_stop || m_nextLoad >= m_nItems) return;
+			const size_t idx = m_nextLoad++;
+			lock.unlock();
+
+			Slot res;
+			try {
+				res.item = m_loader(idx);
+			}
+			catch (...) {
+				res.pException = std::current_exception();
+			}
+			res.ready = true;
+
+			lock.lock();
+			m_vSlots[idx % m_vSlots.size()] = std::move(res);
+			m_cvLoaded.notify_all();
+		}
+	}
+}
@@ -0,0 +1,101 @@
+// Prefetching dataset loader class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace DirectGraphicalModels
+{
+	class CTrainNode;
+
+	// ============================== Dataset Loader Class ==============================
+	/**
+	* @brief Prefetching dataset loader
+	* @details This class overlaps the loading of the training data with the training: the items of the dataset are loaded by a set of dedicated threads,
+	* while the calling thread consumes the already loaded items, \a e.g. adds them to the node trainer. The loader function performs all the stages
+	* of the preparation of one item, such as reading and decoding of the image, resizing and feature extraction; different items are prepared concurrently.
+	*
+	* At most \a capacity items are loaded ahead of the consumer, thus the memory consumption is bounded. The items are returned in the order of their indexes,
+	* so the result does not depend on the number of threads. The loading threads are separate from the thread pool of the library (ref. @ref CThreadPool),
+	* since they are mostly waiting for the disk, and the pool remains available for the parallel training functions.
+	* @code
+	* CDatasetLoader loader(vFileNames.size(), [&](size_t i) {
+	*	Mat img = imread(vImgFileNames[i], 1); resize(img, img, imgSize, 0, 0, INTER_LANCZOS4);
+	*	Mat gt  = imread(vGtFileNames[i], 0);  resize(gt, gt, imgSize, 0, 0, INTER_NEAREST);
+	*	return std::make_pair(fex::CCommonFeatureExtractor(img).getNSDVI(fex::sqrt).get(), gt);
+	* });
+	* loader.feed(*nodeTrainer);
+	* nodeTrainer->train();
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CDatasetLoader
+	{
+	public:
+		/// The loaded item: the feature vectors Mat(size: nSamples; type: CV_8UC(nFeatures)) and the groundtruth Mat(size: nSamples; type: CV_8UC1)
+		using item_t	= std::pair<Mat, Mat>;
+		/// The loader function: returns the item with the given index. It is called concurrently
+		using loader_t	= std::function<item_t(size_t)>;
+
+		/**
+		* @brief Constructor
+		* @details The loading starts immediately
+		* @param nItems The number of items in the dataset
+		* @param loader The loader function
+		* @param nThreads The number of the loading threads. If zero, the number of the hardware threads is used
+		* @param capacity The maximal number of items, loaded ahead of the consumer. If zero, twice the number of the loading threads is used
+		*/
+		DllExport CDatasetLoader(size_t nItems, loader_t loader, size_t nThreads = 0, size_t capacity = 0);
+		DllExport CDatasetLoader(const CDatasetLoader &) = delete;
+		/**
+		* @brief Destructor
+		* @details The loading of the items, which were not consumed, is cancelled
+		*/
+		DllExport ~CDatasetLoader(void);
+
+		DllExport bool	operator=(const CDatasetLoader &) = delete;
+
+		/**
+		* @brief Returns the next item
+		* @details This function waits until the item is loaded. If the loader function has thrown an exception for this item, the exception is re-thrown
+		* @param[out] item The item
+		* @return \a true if the item is returned, \a false if all the items have been consumed already
+		*/
+		DllExport bool	next(item_t &item);
+		/**
+		* @brief Adds all the remaining items to the node trainer
+		* @details The items are added with CTrainNode::addFeatureVecs(const Mat &, const Mat &) in the order of their indexes; meanwhile, the next items are being loaded
+		* @param nodeTrainer The node trainer
+		*/
+		DllExport void	feed(CTrainNode &nodeTrainer);
+
+
+	private:
+		/// Slot of the ring buffer of the loaded items
+		struct Slot {
+			item_t				item;				///< The item
+			std::exception_ptr	pException;			///< The exception, thrown by the loader function
+			bool				ready = false;		///< Flag indicating whether the item is loaded
+		};
+
+		void	work(void);
+
+
+	private:
+		loader_t					m_loader;		///< The loader function
+		size_t						m_nItems;		///< The number of items
+		std::vector<Slot>			m_vSlots;		///< The ring buffer of the loaded items: the item i is stored in the slot i % capacity
+		std::vector<std::thread>	m_vWorkers;		///< The loading threads
+		size_t						m_nextLoad;		///< The index of the next item to be loaded
+		size_t						m_nextConsume;	///< The index of the next item to be consumed
+		bool						m_stop;			///< Flag indicating whether the loading threads should stop
+		std::mutex					m_mtx;			///< The mutex, protecting the state of the loader
+		std::condition_variable		m_cvLoaded;		///< The condition for the consumer, waiting for an item
+		std::condition_variable		m_cvFree;		///< The condition for the loading threads, waiting for a free slot
+	};
+}
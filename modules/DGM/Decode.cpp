@@ -1,5 +1,7 @@
 #include "Decode.h"
+#include "ThreadPool.h"
 #include "Graph.h"
+#include "kernels.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
@@ -8,27 +10,68 @@ namespace DirectGraphicalModels
 	{
 		size_t		nNodes		= graph.getNumNodes();			// number of nodes
 		vec_byte_t	res(nNodes);
-		Mat			pot;
-		bool		ifLossMat	= !lossMatrix.empty();
-
-		// Getting optimal state
-		for (size_t n = 0; n < nNodes; n++) {						// all nodes
-			graph.getNode(n, pot);
-			if (ifLossMat) gemm(lossMatrix, pot, 1.0, Mat(), 0.0, pot);
-		
-			Point extremumLoc;
-			if (ifLossMat) minMaxLoc(pot, NULL, NULL, &extremumLoc, NULL);
-			else minMaxLoc(pot, NULL, NULL, NULL, &extremumLoc);
-			res[n] = static_cast<byte>(extremumLoc.y);
-		} // n
-
+		if (nNodes) {
+			Mat labels(static_cast<int>(nNodes), 1, CV_8UC1, res.data());
+			decodeLabels(graph, labels, lossMatrix);
+		}
 		return res;
 	}
 
+	void CDecode::decodeLabels(const CGraph &graph, Mat &labels, const Mat &lossMatrix)
+	{
+		decodeBlocks(&graph, Mat(), graph.getNumNodes(), graph.getNumStates(), labels, lossMatrix);
+	}
+
+	void CDecode::decodeLabels(const Mat &pots, Mat &labels, const Mat &lossMatrix)
+	{
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1 && pots.cols <= 255, "The potentials must be of type CV_32FC1 with at most 255 columns");
+		decodeBlocks(NULL, pots, pots.rows, static_cast<byte>(pots.cols), labels, lossMatrix);
+	}
+
 	Mat	CDecode::getDefaultLossMatrix(byte nStates)
 	{
 		Mat res(nStates, nStates, CV_32FC1, Scalar(1.0f));
 		for (byte i = 0; i < nStates; i++) res.at<float>(i,i) = 0.0f;
 		return res;
 	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CDecode::decodeBlocks(const CGraph *pGraph, const Mat &pots, size_t nNodes, byte nStates, Mat &labels, const Mat &lossMatrix)
+	{
+		const int		blockSize	= 4096;						// nodes per block
+		const int		nBlocks		= static_cast<int>((nNodes + blockSize - 1) / blockSize);
+		const bool		ifLossMat	= !lossMatrix.empty();
+
+		DGM_ASSERT_MSG(!ifLossMat || (lossMatrix.rows == nStates && lossMatrix.cols == nStates && lossMatrix.type() == CV_32FC1), 
+			"The loss matrix must be of size %d x %d and type CV_32FC1", nStates, nStates);
+		if (labels.total() != nNodes || labels.type() != CV_8UC1 || !labels.isContinuous())
+			labels.create(static_cast<int>(nNodes), 1, CV_8UC1);
+
+		const Mat	lossMatrixT	= ifLossMat ? Mat(lossMatrix.t()) : Mat();	// the risks of a block: pots x L^T
+		byte	  * pLabels		= labels.ptr<byte>();
+
+		parallel::parallelFor(Range(0, nBlocks), [&](const Range& range) {
+			kernels::dispatch(nStates, [&](auto N) {
+				Mat		block;
+				Mat		risk;
+				for (int b = range.start; b < range.end; b++) {
+					const size_t start	= static_cast<size_t>(b) * blockSize;
+					const size_t num	= MIN(static_cast<size_t>(blockSize), nNodes - start);
+					if (pGraph) pGraph->getNodes(start, num, block);
+					else block = pots.rowRange(static_cast<int>(start), static_cast<int>(start + num));
+					if (ifLossMat) {
+						// The Bayesian risks of all the nodes of the block are calculated with one matrix product
+						risk.create(static_cast<int>(num), nStates, CV_32FC1);
+						simd::sgemm(static_cast<int>(num), nStates, nStates, 1.0f, block.ptr<float>(), static_cast<int>(block.step1()), 
+							lossMatrixT.ptr<float>(), static_cast<int>(lossMatrixT.step1()), 0.0f, risk.ptr<float>(), static_cast<int>(risk.step1()));
+						for (int i = 0; i < static_cast<int>(num); i++)
+							pLabels[start + i] = kernels::argMin<decltype(N)::value>(risk.ptr<float>(i), nStates);
+					}
+					else 
+						for (int i = 0; i < static_cast<int>(num); i++)
+							pLabels[start + i] = kernels::argMax<decltype(N)::value>(block.ptr<float>(i), nStates);
+				} // b
+			});
+		});
+	}
 }
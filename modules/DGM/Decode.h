@@ -48,6 +48,29 @@ namespace DirectGraphicalModels
 		*/
 		DllExport static vec_byte_t	decode(const CGraph &graph, Mat &lossMatrix = EmptyMat);
 		/**
+		* @brief Approximate decoding into a label container
+		* @details This function estimates the most probable configuration of states (classes) in the graph, based on marginal probabilities in graph nodes,
+		* as decode() does, but writes the states directly into the caller's container, \a e.g. the label image. The node potentials are read in blocks
+		* with CGraph::getNodes(), which copies a block of the flat storage at once, and the blocks are decoded in parallel: without the loss matrix every
+		* node takes one vectorized search of the maximum (ref. simd::argMax()), and with the loss matrix the Bayesian risks of all the nodes of a block are calculated
+		* with one blocked matrix product \f$P\times L^\top\f$ (ref. simd::sgemm()), followed by the search of the minimum of every row.
+		* > This function supports PPL
+		* @param[in] graph The graph
+		* @param[out] labels The most probable configuration: Mat(type: CV_8UC1) with \a nNodes elements. If the container is already allocated with \a nNodes
+		* continuous elements of type CV_8UC1, \a e.g. as an image of size \a width x \a height = \a nNodes, it is filled in place; otherwise it is allocated as Mat(size: nNodes x 1)
+		* @param[in] lossMatrix (optional) The loss matrix \f$L\f$ (size: nStates x nStates; type: CV_32FC1) (ref. decode())
+		*/
+		DllExport static void		decodeLabels(const CGraph &graph, Mat &labels, const Mat &lossMatrix = EmptyMat);
+		/**
+		* @brief Approximate decoding of a block of potentials into a label container
+		* @details Same as decodeLabels(const CGraph &, Mat &, const Mat &), but the potentials are given directly, \a e.g. the marginals, returned by CInfer::getMarginals()
+		* > This function supports PPL
+		* @param[in] pots The potentials: Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param[out] labels The most probable configuration: Mat(type: CV_8UC1) with \a nNodes elements (ref. decodeLabels(const CGraph &, Mat &, const Mat &))
+		* @param[in] lossMatrix (optional) The loss matrix \f$L\f$ (size: nStates x nStates; type: CV_32FC1) (ref. decode())
+		*/
+		DllExport static void		decodeLabels(const Mat &pots, Mat &labels, const Mat &lossMatrix = EmptyMat);
+		/**
 		* @brief Returns a default loss matrix \f$L\f$
 		* @param nStates The number of States (classes)
 		* @return a loss matrix \f$nStates\times nStates\f$: \f$L=\left\{\begin{array}{rl}0&\mbox{if i = j}\\ 1&\mbox{otherwise}\end{array}\right.\f$
@@ -66,6 +89,11 @@ namespace DirectGraphicalModels
 		CGraph & getGraph(void) const { return m_graph; }
 
 
+	private:
+		// Decodes the potentials, read either from the graph \b pGraph, if it is not NULL, or from \b pots
+		static void	decodeBlocks(const CGraph *pGraph, const Mat &pots, size_t nNodes, byte nStates, Mat &labels, const Mat &lossMatrix);
+
+
 	private:
 		CGraph & m_graph;		///< The graph
 	};
@@ -1,38 +1,29 @@
 #include "DecodeExact.h"
+#include "ThreadPool.h"
 #include "macroses.h"
-#include <numeric>
+#include <mutex>
 
 namespace DirectGraphicalModels
 {
 	vec_byte_t CDecodeExact::decode(Mat &lossMatrix) const
 	{
-		DGM_IF_WARNING(!lossMatrix.empty(), "The Loss Matrix is not supported by the algorithm.");
+		const bool ifLossMat = !lossMatrix.empty();
 
-		size_t			nNodes = getGraph().getNumNodes();
-		vec_byte_t		state(nNodes);
-
-		// Calculating the potentials for every possible configuration
-		vec_float_t     P = calculatePotentials();
+		m_budget.start();
+		Enumeration res = enumerate(ifLossMat, &m_budget);
 
 #ifdef DEBUG_PRINT_INFO
-		// Printing out
-		printf("nConfigurations = %zd\n", P.size());
-
-        // Calculating the partition function
-        float Z = std::accumulate(P.cbegin(), P.cend(), 0.0f);
-        
-        setState(state, 0);
-        for (float &p: P) {
-			for (size_t n = 0; n < nNodes; n++) printf("%d ", state[n]);
-			printf(":-> %2.1f\t| %2.1f %% \n", p, p * 100 / Z);
-			incState(state);
-		}
+		printf("nConfigurations = %.0Lf\n", powl(getGraph().getNumStates(), static_cast<long double>(getGraph().getNumNodes())));
+		printf("log(Z) = %f\n", res.logZ);
 #endif
 
-		// Finding the most probable configuration
-		qword c = std::max_element(P.cbegin(), P.cend()) - P.begin();
-		setState(state, c);
-		return state;
+		if (ifLossMat && !res.argmax.empty()) {
+			Mat marginals;
+			Mat(static_cast<int>(res.argmax.size()), getGraph().getNumStates(), CV_64FC1, res.vMarginals.data()).convertTo(marginals, CV_32FC1);
+			Mat labels(static_cast<int>(res.argmax.size()), 1, CV_8UC1, res.argmax.data());
+			decodeLabels(marginals, labels, lossMatrix);
+		}
+		return res.argmax;
 	}
 
 	// Sets the <state> according to the configuration number <c>
@@ -54,38 +45,165 @@ namespace DirectGraphicalModels
 			else break;
 	}
 
-	// Calculates potentials for all possible configurations
-	vec_float_t CDecodeExact::calculatePotentials(void) const
+	// Enumerates all possible configurations
+	CDecodeExact::Enumeration CDecodeExact::enumerate(bool marginals, const CTimeBudget *pBudget) const
 	{
-		size_t		nNodes = getGraph().getNumNodes();
-		size_t		nConfigurations = static_cast<size_t> (powl(getGraph().getNumStates(), static_cast<long double>(nNodes)));
-		vec_byte_t	state(nNodes);
-
-		vec_float_t		  res;
-		DGM_ASSERT_MSG(nConfigurations < res.max_size(), "The number of configurations %d^%zu exceeds the maximal possible size of container.", getGraph().getNumStates(), nNodes);
-		res.resize(nConfigurations, 1.0f);
-
-		setState(state, 0);
-        Mat nPot, ePot;
-        vec_size_t vChildNodes;
-		for (float &p: res) {
-            for (size_t n = 0; n < nNodes; n++) {
-                getGraph().getNode(n, nPot);
-                p *= nPot.at<float>(state[n], 0);
-                vec_size_t vChilds;
-                getGraph().getChildNodes(n, vChilds);
-                for (size_t c: vChilds) {
-                    getGraphPairwise().getEdge(n, c, ePot);
-                    p *= ePot.at<float>(state[n], state[c]);
-                }
-            }
-            
-            // Old implementation with direct access to CGraphPairwise private member variables
-            // for (ptr_node_t &node : getGraphPairwise().m_vNodes) p *= node->Pot.at<float>(state[node->id], 0);
-            // for (ptr_edge_t &edge : getGraphPairwise().m_vEdges) p *= edge->Pot.at<float>(state[edge->node1], state[edge->node2]);
-			incState(state);
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const byte		nStates = getGraph().getNumStates();
+		const size_t	K		= nStates;
+
+		// ---------- Flattened logarithms of the potentials; the zeros are counted separately ----------
+		struct Edge { size_t src; size_t dst; };
+		std::vector<Edge>	vEdges;
+		vec_float_t			vNodeLog(nNodes * K), vEdgeLog;
+		vec_byte_t			vNodeZero(nNodes * K), vEdgeZero;
+		double				Lref = 0;												// upper bound of the log-potentials: scales the potentials below 1
+		
+		auto toLog = [](float val, float &lg, byte &zero) { zero = val > 0 ? 0 : 1; lg = val > 0 ? logf(val) : 0; };
+		Mat pot;
+		vec_size_t vChilds;
+		for (size_t n = 0; n < nNodes; n++) {
+			const span<const float> nodePot = getGraph().getNodeView(n);
+			float max = 0;
+			for (size_t s = 0; s < K; s++) {
+				toLog(nodePot[s], vNodeLog[n * K + s], vNodeZero[n * K + s]);
+				max = MAX(max, nodePot[s]);
+			}
+			if (max > 0) Lref += log(max);
+
+			getGraph().getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				span<const float> edgePot = getGraphPairwise().getEdgeView(n, c);
+				if (edgePot.empty()) {												// the compact potential is expanded
+					getGraphPairwise().getEdge(n, c, pot);
+					edgePot = span<const float>(pot.ptr<float>(), pot.total());
+				}
+				vEdges.push_back({ n, c });
+				vEdgeLog.resize(vEdges.size() * K * K);
+				vEdgeZero.resize(vEdges.size() * K * K);
+				float *pLog  = &vEdgeLog[(vEdges.size() - 1) * K * K];
+				byte  *pZero = &vEdgeZero[(vEdges.size() - 1) * K * K];
+				max = 0;
+				for (size_t x = 0; x < K; x++)
+					for (size_t y = 0; y < K; y++) {
+						const float val = edgePot[x * K + y];
+						toLog(val, pLog[x * K + y], pZero[x * K + y]);
+						max = MAX(max, val);
+					}
+				if (max > 0) Lref += log(max);
+			}
+		} // n
+
+		// Incident edges of every node in CSR; the edge index is doubled, the lowest bit is set if the node is the source of the edge
+		vec_size_t vOffset(nNodes + 1, 0), vIncident(2 * vEdges.size());
+		for (const Edge &edge : vEdges) { vOffset[edge.src + 1]++; vOffset[edge.dst + 1]++; }
+		for (size_t n = 0; n < nNodes; n++) vOffset[n + 1] += vOffset[n];
+		{
+			vec_size_t vPos(vOffset.begin(), vOffset.end() - 1);
+			for (size_t e = 0; e < vEdges.size(); e++) {
+				vIncident[vPos[vEdges[e].src]++] = 2 * e + 1;
+				vIncident[vPos[vEdges[e].dst]++] = 2 * e;
+			}
 		}
 
+		// ---------- Sharding: the states of the last nOuter nodes are fixed in every shard ----------
+		size_t nOuter  = 0;
+		size_t nShards = 1;
+		while (K > 1 && nOuter < nNodes && nShards < 256) { nOuter++; nShards *= K; }
+		const size_t nInner = nNodes - nOuter;
+
+		Enumeration res;
+		res.argmax.assign(nNodes, 0);
+		res.vMarginals.assign(marginals ? nNodes * K : 0, 0.0);
+		res.complete = true;
+		double Zsum		= 0;
+		double bestL	= -std::numeric_limits<double>::infinity();
+		std::mutex mtx;
+
+		parallel::parallelFor(Range(0, static_cast<int>(nShards)), [&](const Range& range) {
+			vec_byte_t			state(nNodes);
+			std::vector<signed char> dir(nInner);
+			std::vector<double>	vMarg(marginals ? nNodes * K : 0, 0.0);
+			std::vector<double>	vSince(marginals ? nNodes : 0);					// the values of S, when the node entered its current state
+			vec_byte_t			best(nNodes, 0);
+			double				localBestL	= -std::numeric_limits<double>::infinity();
+			double				localZ		= 0;
+
+			for (int shard = range.start; shard < range.end; shard++) {
+				if (pBudget && pBudget->isExpired()) break;								// the rest of the configurations is not enumerated
+
+				// Initial configuration of the shard
+				std::fill(state.begin(), state.begin() + nInner, static_cast<byte>(0));
+				for (size_t i = 0, c = shard; i < nOuter; i++, c /= K) state[nInner + i] = static_cast<byte>(c % K);
+				std::fill(dir.begin(), dir.end(), static_cast<signed char>(1));
+
+				double	L		= 0;
+				int		nZeros	= 0;
+				for (size_t n = 0; n < nNodes; n++) {
+					L		+= vNodeLog[n * K + state[n]];
+					nZeros	+= vNodeZero[n * K + state[n]];
+				}
+				for (size_t e = 0; e < vEdges.size(); e++) {
+					const size_t idx = e * K * K + state[vEdges[e].src] * K + state[vEdges[e].dst];
+					L		+= vEdgeLog[idx];
+					nZeros	+= vEdgeZero[idx];
+				}
+
+				double S = 0;															// sum of the potentials in the shard
+				if (marginals) std::fill(vSince.begin(), vSince.end(), 0.0);
+				for (;;) {
+					// Accumulating the current configuration
+					if (nZeros == 0) {
+						S += exp(L - Lref);
+						if (L > localBestL) { localBestL = L; best = state; }
+					}
+
+					// Reflected Gray code: the lowest node, which may move in its direction, changes the state by one
+					size_t j = 0;
+					while (j < nInner) {
+						const int next = state[j] + dir[j];
+						if (next >= 0 && next < static_cast<int>(K)) break;
+						dir[j] = -dir[j];
+						j++;
+					}
+					if (j == nInner) break;
+
+					const size_t a = state[j];
+					const size_t b = a + dir[j];
+					if (marginals) {
+						vMarg[j * K + a] += S - vSince[j];
+						vSince[j] = S;
+					}
+					L		+= vNodeLog[j * K + b] - vNodeLog[j * K + a];
+					nZeros	+= vNodeZero[j * K + b] - vNodeZero[j * K + a];
+					for (size_t k = vOffset[j]; k < vOffset[j + 1]; k++) {
+						const size_t e		= vIncident[k] / 2;
+						const bool	 isSrc	= vIncident[k] & 1;
+						const size_t other	= isSrc ? state[vEdges[e].dst] : state[vEdges[e].src];
+						const size_t idxOld = e * K * K + (isSrc ? a * K + other : other * K + a);
+						const size_t idxNew = e * K * K + (isSrc ? b * K + other : other * K + b);
+						L		+= vEdgeLog[idxNew] - vEdgeLog[idxOld];
+						nZeros	+= vEdgeZero[idxNew] - vEdgeZero[idxOld];
+					}
+					state[j] = static_cast<byte>(b);
+				}
+
+				if (marginals)
+					for (size_t n = 0; n < nNodes; n++) vMarg[n * K + state[n]] += S - vSince[n];
+				localZ += S;
+			} // shard
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				Zsum += localZ;
+				for (size_t i = 0; i < vMarg.size(); i++) res.vMarginals[i] += vMarg[i];
+				if (localBestL > bestL) { bestL = localBestL; res.argmax = best; }
+			}
+		});
+
+		if (pBudget && pBudget->hasExpired()) res.complete = false;
+		res.logZ = log(Zsum) + Lref;
+		if (Zsum > 0) for (double &m : res.vMarginals) m /= Zsum;
 		return res;
 	}
 }
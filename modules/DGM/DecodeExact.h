@@ -4,6 +4,7 @@
 
 #include "Decode.h"
 #include "IGraphPairwise.h"
+#include "TimeBudget.h"
 
 namespace DirectGraphicalModels
 {
@@ -11,7 +12,11 @@ namespace DirectGraphicalModels
 	/**
 	* @ingroup moduleDecode
 	* @brief Exact decoding class
-	* @note Use this class only if \f$ nStates^{nNodes} < 2^{32}\f$
+	* @details The configurations are enumerated in the reflected Gray code order, so that every next configuration differs from the previous one in 
+	* the state of a single node and its potential is updated incrementally. The configuration space is sharded across the threads; the memory 
+	* consumption does not depend on the number of configurations.
+	* @note The states of the nodes are changed one by one, thus the number of configurations is not limited by a counter; however, the running time grows as
+	* \f$ nStates^{nNodes}\f$: for the larger graphs use setTimeBudget().
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CDecodeExact : public CDecode
@@ -26,10 +31,29 @@ namespace DirectGraphicalModels
 
 		/**
 		* @brief Exact decoding
-		* @param lossMatrix is not used
-		* @return The most probable configuration
+		* @details Without the loss matrix, this function returns the most probable configuration. With the loss matrix, the exact marginal probabilities 
+		* are enumerated and every node takes the state with the minimal Bayesian risk (ref. CDecode::decodeLabels(const Mat &, Mat &, const Mat &))
+		* @param lossMatrix (optional) The loss matrix \f$L\f$ (size: nStates x nStates; type: CV_32FC1) (ref. CDecode::decode())
+		* @return The most probable configuration or the configuration with the minimal risk
 		*/
 		DllExport virtual vec_byte_t decode(Mat &lossMatrix = EmptyMat) const;
+		/**
+		* @brief Sets the time budget of the decoding
+		* @details If set, the decoding stops after the current chunk of configurations and returns the best configuration found so far
+		* @param budget The maximal duration of one call of decode(). Zero value disables the time budget (default)
+		*/
+		DllExport void	setTimeBudget(std::chrono::milliseconds budget) { m_budget.setTimeBudget(budget); }
+		/**
+		* @brief Sets the cancellation token of the decoding
+		* @param pToken Pointer to the flag, which cancels the decoding once set to \a true, or NULL to disable the cancellation (default)
+		*/
+		DllExport void	setCancellationToken(const std::atomic<bool> *pToken) { m_budget.setCancellationToken(pToken); }
+		/**
+		* @brief Checks whether the last call of decode() was interrupted
+		* @retval true if the time budget has expired or the decoding was cancelled
+		* @retval false otherwise
+		*/
+		DllExport bool	isInterrupted(void) const { return m_budget.hasExpired(); }
 
 
 	protected:
@@ -51,12 +75,28 @@ namespace DirectGraphicalModels
 		* @param state Array of \a nNodes elements with the current configuration (states destributed along the nodes)
 		*/
 		void			incState(vec_byte_t &state) const;
+		/// Result of the enumeration of all configurations
+		struct Enumeration {
+			vec_byte_t			argmax;			///< The most probable configuration
+			double				logZ;			///< The logarithm of the partition function
+			std::vector<double>	vMarginals;		///< The marginal probabilities: \a nNodes x \a nStates values (if requested)
+			bool				complete;		///< Flag indicating whether all configurations were enumerated
+		};
 		/**
-		* @brief Calculates potentials for all possible configurations
-		* @details This function is used in exact inference / decoding
-		* @return \f$nStates^{nNodes}\f$ potentials, corresponding to the all possible configurations (states destributed along the nodes)
+		* @brief Enumerates all possible configurations 
+		* @details This function is used in exact inference / decoding. The potentials of the graph are read once; the potential of every configuration
+		* is accumulated in the logarithmic domain.
+		* If the time budget \b pBudget expires, the enumeration stops after the current shard of configurations, and the result covers only the
+		* enumerated configurations.
+		* @param marginals Flag indicating whether the marginal probabilities should be calculated
+		* @param pBudget Pointer to the time budget, or NULL
+		* @return The most probable configuration, partition function and (optionally) the marginal probabilities
 		*/
-		vec_float_t		calculatePotentials(void) const;
+		Enumeration		enumerate(bool marginals, const CTimeBudget *pBudget = NULL) const;
+
+
+	private:
+		mutable CTimeBudget	m_budget;		///< The time budget and the cancellation token of decode()
 	};
 }
 
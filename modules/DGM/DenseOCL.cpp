@@ -0,0 +1,185 @@
+#include "DenseOCL.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels { namespace gpu {
+#ifdef ENABLE_OCL
+	namespace {
+		// All the buffers are continuous: the row step equals the number of columns
+		const char *programSource = R"(
+			// values[i + 1] = sum_p weight[p] * src[feature[p]], p in [start[i]; start[i + 1])
+			__kernel void splat(__global const float *src, __global float *values, __global const int *start, __global const int *feature, __global const float *weight, int nCols, int M)
+			{
+				const int i = get_global_id(0);
+				const int c = get_global_id(1);
+				if (i >= M || c >= nCols) return;
+				float sum = 0;
+				for (int p = start[i]; p < start[i + 1]; p++) sum += weight[p] * src[feature[p] * nCols + c];
+				values[(i + 1) * nCols + c] = sum;
+			}
+
+			__kernel void blur(__global const float *values, __global float *newValues, __global const int *neighbor1, __global const int *neighbor2, int j, int d1, int nCols, int M)
+			{
+				const int i = get_global_id(0);
+				const int c = get_global_id(1);
+				if (i >= M || c >= nCols) return;
+				const float n1 = values[(neighbor1[i * d1 + j] + 1) * nCols + c];
+				const float n2 = values[(neighbor2[i * d1 + j] + 1) * nCols + c];
+				newValues[(i + 1) * nCols + c] = values[(i + 1) * nCols + c] + 0.5f * (n1 + n2);
+			}
+
+			__kernel void slice(__global const float *values, __global float *dst, __global const int *offset, __global const float *barycentric, float alpha, int d1, int nCols, int N)
+			{
+				const int k = get_global_id(0);
+				const int c = get_global_id(1);
+				if (k >= N || c >= nCols) return;
+				float sum = 0;
+				for (int j = 0; j < d1; j++) sum += barycentric[k * d1 + j] * values[(offset[k * d1 + j] + 1) * nCols + c];
+				dst[k * nCols + c] = alpha * sum;
+			}
+
+			__kernel void scale_rows_add(__global float *acc, __global const float *src, __global const float *norm, float weight, int nCols, int N)
+			{
+				const int n = get_global_id(0);
+				const int c = get_global_id(1);
+				if (n >= N || c >= nCols) return;
+				acc[n * nCols + c] += weight * norm[n] * src[n * nCols + c];
+			}
+
+			// The maximum is subtracted so that the exp doesn't explode
+			__kernel void mean_field_update(__global const float *pot0, __global const float *acc, __global float *pot, __global float *res, int nStates, int N)
+			{
+				const int n = get_global_id(0);
+				if (n >= N) return;
+				__global const float *pPot0 = pot0 + n * nStates;
+				__global const float *pAcc	= acc + n * nStates;
+				__global float		 *pPot	= pot + n * nStates;
+
+				float maxAcc = pAcc[0];
+				for (int s = 1; s < nStates; s++) maxAcc = fmax(maxAcc, pAcc[s]);
+				float sum = 0;
+				for (int s = 0; s < nStates; s++) sum += pPot0[s] * exp(pAcc[s] - maxAcc);
+				if (sum <= FLT_EPSILON) {
+					for (int s = 0; s < nStates; s++) pPot[s] = pPot0[s] * exp(pAcc[s] - maxAcc);
+					res[n] = 0;
+					return;
+				}
+				float r = 0;
+				for (int s = 0; s < nStates; s++) {
+					const float val = pPot0[s] * exp(pAcc[s] - maxAcc) / sum;
+					r += fabs(val - pPot[s]);
+					pPot[s] = val;
+				}
+				res[n] = r;
+			}
+
+			// pot[n, s] = exp(logPrior[s] + sum_f lut[f * 256 + fv[n, f], s]), or -1 for the states without estimated PDFs
+			__kernel void lut_potentials(__global const uchar *fv, __global const float *lut, __global const float *logPrior, __global const uchar *estimated, __global float *pot, int nFeatures, int nStates, int N)
+			{
+				const int n = get_global_id(0);
+				const int s = get_global_id(1);
+				if (n >= N || s >= nStates) return;
+				__global const uchar *pFv = fv + n * nFeatures;
+				float sum = logPrior[s];
+				for (int f = 0; f < nFeatures; f++) sum += lut[(f * 256 + pFv[f]) * nStates + s];
+				pot[n * nStates + s] = estimated[s] ? exp(sum) : -1.0f;
+			}
+
+			// Synchronous sum- or max-product message of the edge e = (src) -> (dst): msgNew_e = normalize(Pot2_e^T x (pot_src * prod msg_f)), where f runs over the
+			// edges, incoming to src, except the one from dst. potIdx[e] is the index of the squared potential table, -2 for the Potts edges with the squared values potts[e], -1 for the edges without potential or -3 for the unused edge slots
+			__kernel void lbp_message(__global const float *nodePot, __global const float *msg, __global float *msgNew, __global float *res, 
+				__global const int *edgeSrc, __global const int *edgeDst, __global const int *inOffset, __global const int *inEdges,
+				__global const int *potIdx, __global const float *pots, __global const float2 *potts, int maxSum, int nStates, int nEdges)
+			{
+				const int e = get_global_id(0);
+				if (e >= nEdges) return;
+				const int idx = potIdx[e];
+				if (idx < -2) {															// unused edge slot
+					res[e] = 0;
+					return;
+				}
+				const int src = edgeSrc[e];
+				const int dst = edgeDst[e];
+
+				float temp[256];
+				for (int s = 0; s < nStates; s++) temp[s] = nodePot[src * nStates + s];
+				for (int p = inOffset[src]; p < inOffset[src + 1]; p++) {
+					const int f = inEdges[p];
+					if (edgeSrc[f] == dst) continue;
+					for (int s = 0; s < nStates; s++) temp[s] *= msg[f * nStates + s];
+				}
+
+				__global float *pNew = msgNew + e * nStates;
+				float Z = 0;
+				if (idx >= 0) {
+					__global const float *pPot = pots + idx * nStates * nStates;
+					for (int x = 0; x < nStates; x++) {
+						float val = 0;
+						for (int y = 0; y < nStates; y++) {
+							const float prod = temp[y] * pPot[y * nStates + x];
+							val = maxSum ? fmax(val, prod) : val + prod;
+						}
+						pNew[x] = val;
+						Z += val;
+					}
+				}
+				else if (idx == -2) {
+					const float a = potts[e].x;
+					const float c = potts[e].y;
+					float S = 0, vMax = 0, vMax2 = 0;
+					int   yMax = 0;
+					for (int y = 0; y < nStates; y++) {
+						S += temp[y];
+						if (temp[y] > temp[yMax]) yMax = y;
+					}
+					vMax = temp[yMax];
+					for (int y = 0; y < nStates; y++) if (y != yMax && temp[y] > vMax2) vMax2 = temp[y];
+					for (int x = 0; x < nStates; x++) {
+						pNew[x] = maxSum ? fmax(a * temp[x], c * (x == yMax ? vMax2 : vMax)) : c * S + (a - c) * temp[x];
+						Z += pNew[x];
+					}
+				}
+
+				float r = 0;
+				for (int s = 0; s < nStates; s++) {
+					pNew[s] = Z > FLT_EPSILON ? pNew[s] / Z : 1.0f / nStates;
+					r += fabs(pNew[s] - msg[e * nStates + s]);
+				}
+				res[e] = r;
+			}
+		)";
+
+		const cv::ocl::Program & getProgram(void)
+		{
+			static const cv::ocl::Program program = [] {
+				std::string		errMsg;
+				cv::ocl::Program res(cv::ocl::ProgramSource(programSource), "", errMsg);
+				DGM_IF_WARNING(!res.ptr(), "The OpenCL program could not be built: %s", errMsg.c_str());
+				return res;
+			}();
+			return program;
+		}
+	}
+
+	bool isAvailable(void)
+	{
+		return cv::ocl::haveOpenCL() && cv::ocl::useOpenCL() && getProgram().ptr();
+	}
+
+	cv::ocl::Kernel getKernel(const char *name)
+	{
+		return cv::ocl::Kernel(name, getProgram());
+	}
+
+	bool run(cv::ocl::Kernel &kernel, size_t nRows, size_t nCols)
+	{
+		if (kernel.empty()) return false;
+		size_t globalSize[2] = { nRows, nCols };
+		return kernel.run(nCols > 1 ? 2 : 1, globalSize, NULL, false);
+	}
+#else
+	bool isAvailable(void)
+	{
+		return false;
+	}
+#endif
+} }
@@ -0,0 +1,40 @@
+// OpenCL kernels of the library
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels { namespace gpu {
+	/**
+	* @brief Checks whether the OpenCL device may be used
+	* @details The OpenCL support is available if the library is built with the \b ENABLE_OCL option and OpenCV finds an OpenCL device, which 
+	* is not disabled with \b cv::ocl::setUseOpenCL(false)
+	* @retval true if the OpenCL device may be used
+	* @retval false otherwise
+	*/
+	DllExport bool				isAvailable(void);
+
+#ifdef ENABLE_OCL
+	/**
+	* @brief Returns the kernel of the library OpenCL program
+	* @details The program is built once at the first call. The kernels are:
+	* - \b splat, \b blur and \b slice of the permutohedral lattice
+	* - \b scale_rows_add: \f$acc_{n,s} \mathrel{+}= w\cdot norm_n\cdot src_{n,s}\f$
+	* - \b mean_field_update: \f$pot_n = normalize(pot0_n\cdot e^{acc_n})\f$ with the L1-residual of every node
+	* - \b lut_potentials: the node potentials of a batch of samples from the log-density lookup tables (ref. @ref CTrainNodeBayes)
+	* - \b lbp_message: the synchronous loopy belief propagation message of every edge with its L1-residual (ref. @ref CInferLBP)
+	* @param name The name of the kernel
+	* @return The kernel or an empty kernel, if the program could not be built
+	*/
+	DllExport cv::ocl::Kernel	getKernel(const char *name);
+	/**
+	* @brief Runs the kernel
+	* @param kernel The kernel with the set arguments
+	* @param nRows The number of the work items in the first dimension
+	* @param nCols The number of the work items in the second dimension (1 for the one-dimensional kernels)
+	* @retval true if the kernel was successfully enqueued
+	* @retval false otherwise
+	*/
+	DllExport bool				run(cv::ocl::Kernel &kernel, size_t nRows, size_t nCols = 1);
+#endif
+} }
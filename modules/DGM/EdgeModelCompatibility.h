@@ -0,0 +1,35 @@
+// Label Compatibility Edge Model class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "EdgeModelPotts.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels {
+	// ================================ Label Compatibility Edge Model ================================
+	/**
+	* @brief Label Compatibility %Edge Model for dense graphical models
+	* @details This class generalizes the @ref CEdgeModelPotts model with an arbitrary label compatibility matrix \f$\mu\f$: the filtered potentials
+	* \f$\tilde{Q}\f$ contribute \f$w\cdot norm\cdot\sum_{s'}\mu(s, s')\,\tilde{Q}(s')\f$ to the state \f$s\f$. The Potts model corresponds to the identity matrix.
+	* The matrix is applied as one matrix product per block of nodes, which allows for expressing \a e.g. class co-occurrence costs at the speed of the Potts model.
+	* @ingroup moduleGraph
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CEdgeModelCompatibility : public CEdgeModelPotts {
+	public:
+		/**
+		* @brief Constructor
+		* @param features The set of features which correspond to the nodes of the dense graphical model: Mat(size: nNodes x nFeatures; type: CV_32FC1)
+		* @param compatibility The label compatibility matrix: Mat(size: nStates x nStates; type: CV_32FC1)
+		* @param weight The weighting parameter (default value is 1)
+		* @param perPixelNormalization Flag indicating whether per-pixel normalization should be used during applying the edge model.
+		*/
+		DllExport CEdgeModelCompatibility(const Mat &features, const Mat &compatibility, float weight = 1.0f, bool perPixelNormalization = true)
+			: CEdgeModelPotts(features, weight, {}, perPixelNormalization)
+		{
+			DGM_ASSERT_MSG(!compatibility.empty(), "The compatibility matrix is empty");
+			setCompatibility(compatibility);
+		}
+		DllExport virtual ~CEdgeModelCompatibility(void) = default;
+	};
+}
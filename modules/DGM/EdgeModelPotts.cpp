@@ -1,16 +1,25 @@
 #include "EdgeModelPotts.h"
+#include "ThreadPool.h"
 #include "permutohedral/permutohedral.h"
+#include "simd.h"
+#include "DenseOCL.h"
+#include "footprint.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels {
 	// Constructor
-	CEdgeModelPotts::CEdgeModelPotts(const Mat& features, float weight, const std::function<void(const Mat& src, Mat& dst)>& semiMetricFunction, bool perPixelNormalization)
+	CEdgeModelPotts::CEdgeModelPotts(const Mat& features, float weight, const std::function<void(const Mat& src, Mat& dst)>& semiMetricFunction, bool perPixelNormalization, bool compactLattice)
 		: IEdgeModel()
-		, m_pLattice(new CPermutohedral())
 		, m_weight(weight)
 		, m_norm(features.rows, 1, CV_32FC1, Scalar(1))
 		, m_function(semiMetricFunction)
+#ifdef ENABLE_OCL
+		, m_pDeviceNorm(std::make_shared<DeviceNorm>())
+#endif
 	{
-		m_pLattice->init(features);
+		auto pLattice = std::make_shared<CPermutohedral>();
+		pLattice->init(features, compactLattice);
+		m_pLattice = pLattice;
 
 		// Compute the normalization factor
 		m_pLattice->compute(m_norm, m_norm);
@@ -25,35 +34,123 @@ namespace DirectGraphicalModels {
 		}
 	}
 
+	// Copy constructor
+	CEdgeModelPotts::CEdgeModelPotts(const CEdgeModelPotts &rhs)
+		: IEdgeModel()
+		, m_pLattice(rhs.m_pLattice)
+		, m_weight(rhs.m_weight)
+		, m_norm(rhs.m_norm)
+		, m_compatibilityT(rhs.m_compatibilityT.clone())
+		, m_function(rhs.m_function)
+#ifdef ENABLE_OCL
+		, m_pDeviceNorm(rhs.m_pDeviceNorm)
+#endif
+	{}
+
 	// Destructor
-	CEdgeModelPotts::~CEdgeModelPotts(void)
+	CEdgeModelPotts::~CEdgeModelPotts(void) = default;
+
+	std::shared_ptr<CEdgeModelPotts> CEdgeModelPotts::clone(void) const
 	{
- 		delete m_pLattice;
+		return std::shared_ptr<CEdgeModelPotts>(new CEdgeModelPotts(*this));
 	}
 
 	// dst = e^(w * norm * f(Lattice.compute(src)))
 	void CEdgeModelPotts::apply(const Mat &src, Mat &dst) const
 	{
-		m_pLattice->compute(src, dst);				// dst = Lattice.compute(src)
+		Mat buffer;
+		dst = Mat(src.size(), CV_32FC1, Scalar(0));
+		accumulate(src, dst, buffer);
+		exp(dst, dst);
+	}
 
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, dst.rows), [&](const Range& range) {
+	// acc += w * norm * f(Lattice.compute(src)) x compatibility^T
+	void CEdgeModelPotts::accumulate(const Mat &src, Mat &acc, Mat &buffer) const
+	{
+		const byte	nStates	= static_cast<byte>(src.cols);
+		const int	nBlocks	= (src.rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		DGM_ASSERT_MSG(m_compatibilityT.empty() || m_compatibilityT.rows == nStates, "The compatibility matrix does not match the number of states");
+		
+		buffer.create(src.size(), CV_32FC1);
+		m_pLattice->compute(src, buffer);			// buffer = Lattice.compute(src)
+		
+		// The nodes are processed in blocks, so that the compatibility matrix is applied as one matrix product per block
+		parallel::parallelFor(Range(0, nBlocks), [&](const Range& range) {
+			Mat temp;
+			for (int b = range.start; b < range.end; b++) {	// blocks
+				const Range	rows(b * BLOCK_SIZE, MIN((b + 1) * BLOCK_SIZE, buffer.rows));
+				Mat			block = buffer.rowRange(rows);
+				if (m_function)								// With the SemiMetric function
+					for (int n = 0; n < block.rows; n++) m_function(block.row(n), lvalue_cast(block.row(n)));
+				if (!m_compatibilityT.empty()) {
+					gemm(block, m_compatibilityT, 1, noArray(), 0, temp);
+					block = temp;
+				}
+				for (int n = 0; n < block.rows; n++)
+					simd::axpy(m_weight * m_norm.at<float>(rows.start + n, 0), block.ptr<float>(n), acc.ptr<float>(rows.start + n), nStates);
+			} // b
+		});
+	}
+
+	// acc += w * norm * Lattice.compute(src) x compatibility^T on the device
+	bool CEdgeModelPotts::accumulate(const UMat &src, UMat &acc, UMat &buffer) const
+	{
+#ifdef ENABLE_OCL
+		if (m_function) return false;
+		if (!m_pLattice->compute(src, buffer)) return false;
+		UMat temp;
+		if (!m_compatibilityT.empty()) gemm(buffer, m_compatibilityT, 1, noArray(), 0, temp);
+		const UMat &filtered = m_compatibilityT.empty() ? buffer : temp;
+
+		std::call_once(m_pDeviceNorm->flag, [this] { m_norm.copyTo(m_pDeviceNorm->norm); });
+		ocl::Kernel kernel = gpu::getKernel("scale_rows_add");
+		kernel.args(ocl::KernelArg::PtrReadWrite(acc), ocl::KernelArg::PtrReadOnly(filtered), ocl::KernelArg::PtrReadOnly(m_pDeviceNorm->norm), m_weight, acc.cols, acc.rows);
+		return gpu::run(kernel, acc.rows, acc.cols);
 #else
-		const Range range(0, dst.rows); 
+		return false;
 #endif
-		for (int n = range.start; n < range.end; n++) {	// nodes
-			if (m_function) m_function(dst.row(n), lvalue_cast(dst.row(n)));		// With the SemiMetric function
-
-			// dst.row(n) *= m_weight * m_norm.at<float>(n, 0);
-			// Using expressive notation for sake of efficiency
-			float* pDst = dst.ptr<float>(n);
-			float	k = m_weight * m_norm.at<float>(n, 0);
-			for (int s = 0; s < dst.cols; s++) pDst[s] *= k;
+	}
+
+	size_t CEdgeModelPotts::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + (m_pLattice ? m_pLattice->getMemorySize() : 0) + footprint::getBytes(m_norm) + footprint::getBytes(m_compatibilityT);
+	}
+
+	// dst = norm * Lattice.compute(src) or dst = Lattice.compute(norm * src)
+	void CEdgeModelPotts::filter(const Mat &src, Mat &dst, bool transposed) const
+	{
+		dst.create(src.size(), CV_32FC1);
+		if (transposed) {
+			Mat temp(src.size(), CV_32FC1);
+			for (int n = 0; n < src.rows; n++) {
+				const float *pSrc	= src.ptr<float>(n);
+				float		*pTemp	= temp.ptr<float>(n);
+				const float	 k		= m_norm.at<float>(n, 0);
+				for (int s = 0; s < src.cols; s++) pTemp[s] = k * pSrc[s];
+			}
+			m_pLattice->compute(temp, dst);
+		}
+		else {
+			m_pLattice->compute(src, dst);
+			for (int n = 0; n < dst.rows; n++) {
+				float		*pDst	= dst.ptr<float>(n);
+				const float	 k		= m_norm.at<float>(n, 0);
+				for (int s = 0; s < dst.cols; s++) pDst[s] *= k;
+			}
+		}
+	}
+
+	void CEdgeModelPotts::setCompatibility(const Mat &compatibility)
+	{
+		if (compatibility.empty()) m_compatibilityT.release();
+		else {
+			DGM_ASSERT_MSG(compatibility.rows == compatibility.cols && compatibility.type() == CV_32FC1, "The compatibility matrix must be a square matrix of type CV_32FC1");
+			m_compatibilityT = compatibility.t();
 		}
-#ifdef ENABLE_PDP
-		});
-#endif
-		exp(dst, dst);
 	}
 
+	Mat CEdgeModelPotts::getCompatibility(void) const
+	{
+		return m_compatibilityT.empty() ? Mat() : Mat(m_compatibilityT.t());
+	}
 }
@@ -3,6 +3,9 @@
 #pragma once
 
 #include "IEdgeModel.h"
+#ifdef ENABLE_OCL
+#include <mutex>
+#endif
 
 class CPermutohedral;
 
@@ -28,17 +31,94 @@ namespace DirectGraphicalModels {
 		* @param semiMetricFunction Reference to a semi-metric function, which arguments \b src and \b dst are: Mat(size: 1 x nFeatures; type: CV_32FC1). This function when provided 
 		* will be called for every node potential in the apply() method. 
 		* @param perPixelNormalization Flag indicating whether er-pixel normalization should be used during applying the edge model.
+		* @param compactLattice Flag indicating whether the compact storage of the permutohedral lattice should be used: the barycentric weights are kept
+		* in 16 bits and the lattice values are blurred in half precision. This reduces the memory footprint and the memory traffic of the large lattices at the cost
+		* of the relative error about \f$10^{-3}\f$ in the filtered values.
 		*/
-		DllExport CEdgeModelPotts(const Mat& features, float weight = 1.0f, const std::function<void(const Mat& src, Mat& dst)>& semiMetricFunction = {}, bool perPixelNormalization = true);
+		DllExport CEdgeModelPotts(const Mat& features, float weight = 1.0f, const std::function<void(const Mat& src, Mat& dst)>& semiMetricFunction = {}, bool perPixelNormalization = true, bool compactLattice = false);
 		DllExport virtual ~CEdgeModelPotts(void);
+		/**
+		* @brief Returns a copy of the model
+		* @details The copy shares the permutohedral lattice and the normalization factors, which are not changed after the construction, with this model,
+		* while its weight and compatibility matrix may be changed independently, \a e.g. by @ref CParamEstimationDense
+		* @return The pointer to the copy
+		*/
+		DllExport std::shared_ptr<CEdgeModelPotts> clone(void) const;
 	
 		DllExport void apply(const Mat &src, Mat &dst) const override;
+		/**
+		* @brief Adds the logarithm of the applied edge model to the accumulator
+		* @details This function calculates \f$acc = acc + w \cdot norm \cdot f(Lattice.compute(src))\f$, \a i.e. apply() without the exponent, in one pass
+		* @param[in] src The dense graph node potentials in form Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param[in,out] acc The accumulator: Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param buffer Auxiliary container, which is reused between the calls in order to avoid the allocations
+		*/
+		DllExport void accumulate(const Mat &src, Mat &acc, Mat &buffer) const override;
+		/**
+		* @brief Adds the logarithm of the applied edge model to the accumulator on the OpenCL device
+		* @details The lattice tables are uploaded to the device at the first call and stay there (ref. IEdgeModel::accumulate(const UMat &, UMat &, UMat &)).
+		* The models with a semi-metric function are applied on the CPU only.
+		*/
+		DllExport bool accumulate(const UMat &src, UMat &acc, UMat &buffer) const override;
+		DllExport size_t getMemoryUsage(void) const override;
+		/**
+		* @brief Filters the node potentials with the normalized Gaussian kernel
+		* @details This function calculates \f$dst = norm \cdot Lattice.compute(src)\f$, or, for the transposed kernel, \f$dst = Lattice.compute(norm \cdot src)\f$,
+		* which is needed for the gradients of the mean-field inference (ref. @ref CParamEstimationDense)
+		* @param[in] src The dense graph node potentials in form Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param[out] dst The filtered potentials: Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param[in] transposed Flag indicating whether the transposed kernel should be applied
+		*/
+		DllExport void	filter(const Mat &src, Mat &dst, bool transposed = false) const;
+		/**
+		* @brief Sets the weighting parameter
+		* @param weight The weighting parameter
+		*/
+		DllExport void	setWeight(float weight) { m_weight = weight; }
+		/**
+		* @brief Returns the weighting parameter
+		* @return The weighting parameter
+		*/
+		DllExport float	getWeight(void) const { return m_weight; }
+		/**
+		* @brief Sets the label compatibility matrix
+		* @details With the compatibility matrix \f$\mu\f$ the model adds \f$w \cdot norm \cdot \sum_{l'}\mu(l, l')\,f_{l'}\f$ to the state \f$l\f$, 
+		* where \f$f\f$ is the filtered potential. Without the matrix (default) the Potts model, \a i.e. \f$\mu = I\f$, is used.
+		* @param compatibility The compatibility matrix: Mat(size: nStates x nStates; type: CV_32FC1), or empty Mat for the Potts model
+		*/
+		DllExport void	setCompatibility(const Mat &compatibility);
+		/**
+		* @brief Returns the label compatibility matrix
+		* @return The compatibility matrix: Mat(size: nStates x nStates; type: CV_32FC1), or empty Mat for the Potts model
+		*/
+		DllExport Mat	getCompatibility(void) const;
+		/**
+		* @brief Checks whether the semi-metric function is set
+		* @retval true if the semi-metric function is set
+		* @retval false otherwise
+		*/
+		DllExport bool	hasSemiMetricFunction(void) const { return static_cast<bool>(m_function); }
 	
 
 	private:
-		CPermutohedral								  * m_pLattice;		///< Pointer to the permutohedral lattice
+		CEdgeModelPotts(const CEdgeModelPotts &rhs);
+
+
+	private:
+		static const int								BLOCK_SIZE = 256;	///< The number of nodes, processed at once in accumulate()
+
+		std::shared_ptr<const CPermutohedral>			m_pLattice;		///< Pointer to the permutohedral lattice, shared by the copies of the model
 		float											m_weight;		///< The weighting parameter
 		Mat												m_norm;			///< Array with normalization factors
+		Mat												m_compatibilityT;	///< The transposed label compatibility matrix (empty for the Potts model)
 		std::function<void(const Mat &src, Mat &dst)>	m_function;		///< The semi-metric function
+#ifdef ENABLE_OCL
+		/// The device copy of the normalization factors, uploaded at the first call
+		struct DeviceNorm {
+			UMat				norm;
+			std::once_flag		flag;
+		};
+		std::shared_ptr<DeviceNorm>						m_pDeviceNorm;	///< The device data, shared by the copies of the model
+#endif
 	};
 }
\ No newline at end of file
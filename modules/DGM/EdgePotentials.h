@@ -0,0 +1,26 @@
+// Helpers for the edge potentials of the pairwise graphs
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	/**
+	* @brief Checks whether the edge potential is a Potts potential
+	* @details The graph extensions set such potentials with IGraphPairwise::setEdgePotts(), which stores only two values per edge.
+	* They apply it to the square roots of the arc potentials, as IGraphPairwise::setArc() does.
+	* @param pot The row-major potential matrix: nStates x nStates
+	* @param nStates The number of states
+	* @retval true if the matrix has constant diagonal and constant off-diagonal values
+	* @retval false otherwise
+	*/
+	inline bool isPotts(const float *pot, byte nStates)
+	{
+		if (nStates < 2) return false;
+		for (byte y = 0; y < nStates; y++)
+			for (byte x = 0; x < nStates; x++)
+				if (pot[y * nStates + x] != pot[x == y ? 0 : 1]) return false;
+		return true;
+	}
+}
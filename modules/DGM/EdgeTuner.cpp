@@ -0,0 +1,84 @@
+#include "EdgeTuner.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	// Constructor
+	CEdgeTuner::CEdgeTuner(const IGraphPairwise &graph, INFER infer, fill_function_t fill, score_function_t score, unsigned int nIt)
+		: m_pGraph(graph.clone())
+		, m_infer(infer)
+		, m_fill(std::move(fill))
+		, m_score(std::move(score))
+		, m_nIt(nIt)
+		, m_warmStart(true)
+		, m_nCopies(0)
+	{
+		DGM_ASSERT_MSG(m_fill && m_score, "The filling and scoring functions must be set");
+	}
+
+	float CEdgeTuner::evaluate(const vec_float_t &vParams)
+	{
+		std::unique_ptr<Copy> pCopy = acquire();
+		float res = 0;
+		try {
+			IGraphPairwise &graph = dynamic_cast<IGraphPairwise &>(*pCopy->pGraph);
+			m_fill(vParams, graph);
+			res = m_score(pCopy->pInfer->decode(m_nIt));
+		}
+		catch (...) {
+			release(std::move(pCopy));
+			throw;
+		}
+		release(std::move(pCopy));
+		return res;
+	}
+
+	vec_float_t CEdgeTuner::optimize(CParamEstimation &paramEstimation, size_t maxConcurrency)
+	{
+		return paramEstimation.optimize([this](const vec_float_t &vParams) { return evaluate(vParams); }, maxConcurrency);
+	}
+
+	void CEdgeTuner::setWarmStart(bool enable)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_warmStart = enable;
+	}
+
+	size_t CEdgeTuner::getNumCopies(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_nCopies;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The copies are created on demand, thus their number equals the maximal number of the concurrent evaluations
+	std::unique_ptr<CEdgeTuner::Copy> CEdgeTuner::acquire(void)
+	{
+		std::unique_ptr<Copy> res;
+		bool warmStart;
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if (!m_vFree.empty()) {
+				res = std::move(m_vFree.back());
+				m_vFree.pop_back();
+			}
+			else m_nCopies++;
+			warmStart = m_warmStart;
+		}
+
+		if (!res) {
+			res = std::make_unique<Copy>();
+			res->pGraph = m_pGraph->clone();
+			res->pInfer = CGraphPairwiseKit::createInfer(m_infer, dynamic_cast<IGraphPairwise &>(*res->pGraph));
+			res->pInfer->setKeepPotentials(true);									// the node potentials are re-used by the next evaluations
+		}
+		res->pInfer->setWarmStart(warmStart);
+		return res;
+	}
+
+	void CEdgeTuner::release(std::unique_ptr<Copy> pCopy)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_vFree.push_back(std::move(pCopy));
+	}
+}
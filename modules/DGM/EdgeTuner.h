@@ -0,0 +1,108 @@
+// Incremental evaluation of the edge parameters class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphPairwiseKit.h"
+#include "ParamEstimation.h"
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	// =============================== Edge Tuner Class ===============================
+	/**
+	* @brief Incremental evaluation of the objective function for the tuning of the edge parameters
+	* @details When only the edge parameters are tuned, \a e.g. the parameters of CGraphPairwiseExt::fillEdges() or of the edge models, the features, the node potentials
+	* and the topology of the graph do not depend on the tuned parameters. This class builds the graph once and keeps a few working copies of it (one per concurrent
+	* evaluation), each with its own inferer. Every evaluation only re-fills the edge potentials of a copy, runs the inference and scores the result: the node
+	* potentials of the copies are kept intact (ref. CInfer::setKeepPotentials()), and the messages are warm-started from the previous evaluation on the same copy
+	* (ref. CMessagePassing::setWarmStart()), which is usually close, since the search methods probe the neighbouring parameters:
+	* @code
+	* // ... building the graph and filling its nodes once
+	* CEdgeTuner tuner(graph, INFER::TRW, [&](const vec_float_t &vParams, IGraphPairwise &graphCopy) {
+	*	CGraphPairwiseExt(graphCopy).fillEdges(edgeTrainer, featureVectors, { vParams[0], 0.001f });
+	* }, [&](const vec_byte_t &solution) { return getAccuracy(solution, gt); });
+	* CParamEstimationPowell powell(1);
+	* vec_float_t vParams = tuner.optimize(powell);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CEdgeTuner
+	{
+	public:
+		/**
+		* @brief Edge filling function
+		* @details Sets the edge potentials of the copy of the graph for the parameters. It must not change the nodes and the topology of the graph. It is called concurrently for different copies
+		*/
+		using fill_function_t	= std::function<void(const vec_float_t &vParams, IGraphPairwise &graph)>;
+		/**
+		* @brief Scoring function
+		* @details Returns the value of the objective function, \a e.g. the accuracy, for the decoded states of all the nodes. It is called concurrently
+		*/
+		using score_function_t	= std::function<float(const vec_byte_t &solution)>;
+
+		/**
+		* @brief Constructor
+		* @param graph The graph with the filled nodes. It is copied for the evaluations and may be destroyed afterwards
+		* @param infer The inference algorithm
+		* @param fill The edge filling function
+		* @param score The scoring function
+		* @param nIt The number of the inference iterations per evaluation
+		*/
+		DllExport CEdgeTuner(const IGraphPairwise &graph, INFER infer, fill_function_t fill, score_function_t score, unsigned int nIt = 100);
+		DllExport ~CEdgeTuner(void) = default;
+		CEdgeTuner(const CEdgeTuner &) = delete;
+		const CEdgeTuner& operator= (const CEdgeTuner &) = delete;
+
+		/**
+		* @brief Evaluates the objective function
+		* @details A free copy of the graph is taken (or created, if all the copies are busy), its edges are filled, and the decoded states are scored.
+		* > This function is thread-safe
+		* @param vParams The edge parameters
+		* @return The value of the objective function
+		*/
+		DllExport float			evaluate(const vec_float_t &vParams);
+		/**
+		* @brief Runs the search until the method has converged
+		* @details The evaluations of every batch of the search method (ref. CParamEstimation::getBatch()) are executed concurrently
+		* @param paramEstimation The search method
+		* @param maxConcurrency The maximal number of concurrent evaluations, \a i.e. the maximal number of the graph copies. If zero, no limit is applied
+		* @return The array with the optimal parameters
+		*/
+		DllExport vec_float_t	optimize(CParamEstimation &paramEstimation, size_t maxConcurrency = 0);
+		/**
+		* @brief Enables or disables the warm start of the inference
+		* @details The warm start is enabled by default. Without it, every evaluation starts the inference from the uniform messages, and its result does not
+		* depend on the order of the evaluations
+		* @param enable Flag indicating whether the messages should be warm-started from the previous evaluation on the same copy of the graph
+		*/
+		DllExport void			setWarmStart(bool enable);
+		/**
+		* @brief Returns the number of the graph copies
+		* @return The number of the copies, \a i.e. the maximal number of the concurrent evaluations so far
+		*/
+		DllExport size_t		getNumCopies(void) const;
+
+
+	private:
+		/// Working copy of the graph
+		struct Copy {
+			std::unique_ptr<CGraph>				pGraph;		///< The copy of the graph
+			std::unique_ptr<CMessagePassing>	pInfer;		///< The inferer of the copy
+		};
+
+		std::unique_ptr<Copy>	acquire(void);
+		void					release(std::unique_ptr<Copy> pCopy);
+
+
+	private:
+		std::unique_ptr<CGraph>				m_pGraph;		///< The copy of the original graph, which the working copies are cloned from
+		INFER								m_infer;		///< The inference algorithm
+		fill_function_t						m_fill;			///< The edge filling function
+		score_function_t					m_score;		///< The scoring function
+		unsigned int						m_nIt;			///< The number of the inference iterations
+		bool								m_warmStart;	///< Flag indicating whether the inference is warm-started
+		std::vector<std::unique_ptr<Copy>>	m_vFree;		///< The free working copies
+		size_t								m_nCopies;		///< The number of the working copies
+		mutable std::mutex					m_mtx;			///< The mutex, protecting the working copies
+	};
+}
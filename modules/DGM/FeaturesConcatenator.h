@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include "parallel.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
@@ -35,6 +36,24 @@ namespace DirectGraphicalModels
 		* @param[out] dst The resulting feture vector: Mat(size: this->nFeaturs() x 1; type: CV_8UC1) 
 		*/
 		DllExport virtual void	concatenate(const Mat &featureVector1, const Mat &featureVector2, Mat &dst) const = 0;
+		/**
+		* @brief Concatenates two blocks of feature vectors
+		* @details The default implementation calls concatenate(const Mat &, const Mat &, Mat &) const for every row, writing directly into the rows of \b dst;
+		* the derived classes may override it in order to concatenate the rows in parallel
+		* @param[in] featureMatrix1 The first feature vectors, stored row-wise: Mat(size: nVectors x nFeatures; type: CV_8UC1)
+		* @param[in] featureMatrix2 The second feature vectors, stored row-wise: Mat(size: nVectors x nFeatures; type: CV_8UC1)
+		* @param[out] dst The resulting feature vectors, stored row-wise: Mat(size: nVectors x this->getNumFeatures(); type: CV_8UC1).
+		* It is re-allocated only if its size or type differs, thus may be reused for the blocks of the same size
+		*/
+		DllExport virtual void	concatenateBlock(const Mat &featureMatrix1, const Mat &featureMatrix2, Mat &dst) const
+		{
+			DGM_ASSERT(featureMatrix1.size() == featureMatrix2.size());
+			dst.create(featureMatrix1.rows, getNumFeatures(), CV_8UC1);
+			for (int i = 0; i < featureMatrix1.rows; i++) {
+				Mat res = dst.row(i).reshape(1, getNumFeatures());
+				concatenate(featureMatrix1.row(i).reshape(1, m_nFeatures), featureMatrix2.row(i).reshape(1, m_nFeatures), res);
+			}
+		}
 
 
 	protected:
@@ -70,6 +89,25 @@ namespace DirectGraphicalModels
 				dst.at<byte>(2 * f + 1, 0) = featureVector2.at<byte>(f, 0);
 			}			
 		}
+		DllExport virtual void	concatenateBlock(const Mat &featureMatrix1, const Mat &featureMatrix2, Mat &dst) const {
+			// Assertions
+			DGM_ASSERT(featureMatrix1.size() == featureMatrix2.size());
+			DGM_ASSERT(featureMatrix1.type() == CV_8UC1 && featureMatrix2.type() == CV_8UC1);
+			DGM_ASSERT(featureMatrix1.cols == m_nFeatures);
+
+			dst.create(featureMatrix1.rows, getNumFeatures(), CV_8UC1);
+			parallel::parallelFor(Range(0, featureMatrix1.rows), [&](const Range &range) {
+				for (int i = range.start; i < range.end; i++) {
+					const byte *pFv1 = featureMatrix1.ptr<byte>(i);
+					const byte *pFv2 = featureMatrix2.ptr<byte>(i);
+					byte	   *pDst = dst.ptr<byte>(i);
+					for (word f = 0; f < m_nFeatures; f++) {
+						pDst[2 * f]		= pFv1[f];
+						pDst[2 * f + 1]	= pFv2[f];
+					}
+				} // i
+			}, 1024);
+		}
 	};
 
 	
@@ -100,6 +138,23 @@ namespace DirectGraphicalModels
 				dst.at<byte>(1 * f, 0) = static_cast<byte>(MIN(255, MAX(0, 127.5 + 1.0 * featureVector1.at<byte>(f, 0) - 1.0 * featureVector2.at<byte>(f, 0))));
 			}			
 		}
+		DllExport virtual void	concatenateBlock(const Mat &featureMatrix1, const Mat &featureMatrix2, Mat &dst) const {
+			// Assertions
+			DGM_ASSERT(featureMatrix1.size() == featureMatrix2.size());
+			DGM_ASSERT(featureMatrix1.type() == CV_8UC1 && featureMatrix2.type() == CV_8UC1);
+			DGM_ASSERT(featureMatrix1.cols == m_nFeatures);
+
+			// The truncation of 127.5 + d is equal to 127 + d for all the differences d, which are not clamped
+			dst.create(featureMatrix1.rows, getNumFeatures(), CV_8UC1);
+			parallel::parallelFor(Range(0, featureMatrix1.rows), [&](const Range &range) {
+				for (int i = range.start; i < range.end; i++) {
+					const byte *pFv1 = featureMatrix1.ptr<byte>(i);
+					const byte *pFv2 = featureMatrix2.ptr<byte>(i);
+					byte	   *pDst = dst.ptr<byte>(i);
+					for (word f = 0; f < m_nFeatures; f++) pDst[f] = static_cast<byte>(MIN(255, MAX(0, 127 + pFv1[f] - pFv2[f])));
+				} // i
+			}, 1024);
+		}
 	};
 
 }
@@ -1,8 +1,41 @@
 #include "Graph.h"
+#include "ThreadPool.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels 
 {
+	std::unique_ptr<CGraph> CGraph::clone(void) const
+	{
+		DGM_ASSERT_MSG(false, "This graph does not support cloning");
+		return nullptr;
+	}
+
+	span<const float> CGraph::getNodeView(size_t) const
+	{
+		DGM_ASSERT_MSG(false, "This graph does not support the views of the potentials");
+		return {};
+	}
+
+	span<float> CGraph::getMutableNodeView(size_t)
+	{
+		DGM_ASSERT_MSG(false, "This graph does not support the views of the potentials");
+		return {};
+	}
+
+	double CGraph::parallelSum(size_t n, const std::function<double(size_t begin, size_t end)> &fn)
+	{
+		const size_t blockSize	= 4096;
+		const size_t nBlocks	= (n + blockSize - 1) / blockSize;
+		std::vector<double> vSum(nBlocks, 0);
+		parallel::parallelFor(Range(0, static_cast<int>(nBlocks)), [&](const Range &range) {
+			for (int b = range.start; b < range.end; b++)
+				vSum[b] = fn(b * blockSize, MIN((b + 1) * blockSize, n));
+		}, 1);
+		double res = 0;
+		for (double sum : vSum) res += sum;
+		return res;
+	}
+
 	void CGraph::addNodes(const Mat &pots) {
 		for (int n = 0; n < pots.rows; n++)
 			addNode(pots.row(n).t());
@@ -12,16 +45,10 @@ namespace DirectGraphicalModels
 		// Assertions
 		DGM_ASSERT_MSG(start_node + pots.rows <= getNumNodes(), "The given ranges exceed the number of nodes(%zu)", getNumNodes());
 
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, pots.rows), [start_node, &pots, this](const Range& range) {
-#else
-		const Range range(0, pots.rows);
-#endif
-		for (int n = range.start; n < range.end; n++)
-			setNode(start_node + n, pots.row(n).t());
-#ifdef ENABLE_PDP
+		parallel::parallelFor(Range(0, pots.rows), [start_node, &pots, this](const Range& range) {
+			for (int n = range.start; n < range.end; n++)
+				setNode(start_node + n, pots.row(n).t());
 		});
-#endif
 	}
 
 	void CGraph::getNodes(size_t start_node, size_t num_nodes, Mat& pots) const {
@@ -35,16 +62,10 @@ namespace DirectGraphicalModels
 		
 		transpose(pots, pots);
 
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, pots.cols), [start_node, &pots, this](const Range& range) {
-#else
-		const Range range(0, pots.cols);
-#endif
-		for (int n = range.start; n < range.end; n++)
-			getNode(start_node + n, lvalue_cast(pots.col(n)));
-#ifdef ENABLE_PDP
+		parallel::parallelFor(Range(0, pots.cols), [start_node, &pots, this](const Range& range) {
+			for (int n = range.start; n < range.end; n++)
+				getNode(start_node + n, lvalue_cast(pots.col(n)));
 		});
-#endif
 		transpose(pots, pots);
 	}
 }
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "types.h"
+#include "span.h"
+#include <functional>
 
 namespace DirectGraphicalModels {
 	// ================================ Graph Interface Class ================================
@@ -31,6 +33,16 @@ namespace DirectGraphicalModels {
 		*/
 		DllExport virtual void		reset(void) = 0;
 		/**
+		* @brief Creates a copy of the graph
+		* @details The copy is independent from the original graph: changing the potentials or the structure of one graph does not affect the other one.
+		* It is intended for running several inferences with different parameters concurrently, one per copy. The @ref CGraphPairwise graphs share the
+		* edge potentials between the copies until they are changed (copy-on-write), and the graphs with flat storage (@ref CGraphPairwiseCSR) copy their
+		* buffers at once, so that the copy is always cheaper than building the graph anew.
+		* > The default implementation does not support copying
+		* @return The copy of the graph
+		*/
+		DllExport virtual std::unique_ptr<CGraph> clone(void) const;
+		/**
 		* @brief Adds an additional node (with specified potentional)
 		* @param pot node potential vector: Mat(size: nStates x 1; type: CV_32FC1)
 		* @return the node's ID
@@ -71,6 +83,24 @@ namespace DirectGraphicalModels {
 		*/
 		DllExport virtual void		getNodes(size_t start_node, size_t num_nodes, Mat &pots) const;
 		/**
+		* @brief Returns the view of the node potential
+		* @details In contrast to getNode(), the potential is not copied: the view addresses the storage of the graph and remains valid until the nodes
+		* are added, removed or reset. The inner loops of the decoders and the inference read the potentials this way without the allocations.
+		* > This function supports PPL
+		* @param node node index
+		* @return The view of the \a nStates values of the node potential
+		*/
+		DllExport virtual span<const float>	getNodeView(size_t node) const;
+		/**
+		* @brief Returns the mutable view of the node potential
+		* @details The potential may be changed in place through the view, which is equivalent to setNode(): the pairwise graphs mark the node as changed
+		* (ref. IGraphPairwise::setDirtyTracking()) when the view is returned.
+		* > This function supports PPL
+		* @param node node index
+		* @return The mutable view of the \a nStates values of the node potential
+		*/
+		DllExport virtual span<float>		getMutableNodeView(size_t node);
+		/**
 		* @brief Returns the set of IDs of the child nodes of the argument node
 		* @param[in] node node index
 		* @param[out] vNodes vector with the child node's ID
@@ -97,6 +127,42 @@ namespace DirectGraphicalModels {
 		* @return Number of states (features)
 		*/
 		DllExport byte				getNumStates(void) const { return m_nStates; }
+		/**
+		* @brief Calculates the energy of a configuration
+		* @details The energy is the negative logarithm of the unnormalized joint probability of the configuration:
+		* \f$E(x)=-\sum_i\log\psi_i(x_i)-\sum_{(i,j)}\log\psi_{ij}(x_i,x_j)\f$. For the pairwise graphs the pairwise term runs over all the edges, thus an arc 
+		* contributes twice, the same way as in the exact inference (ref. @ref CInferExact). The zero potentials are clamped to \a FLT_MIN. The lower energy is better:
+		* the energy allows for comparing the solutions of different inference algorithms and for monitoring the solvers, \a e.g. once per iteration:
+		* @code
+		* vec_byte_t lbp = CInferLBP(graph).decode(100);
+		* vec_byte_t trw = CInferTRW(graph).decode(100);
+		* printf("LBP: %f, TRW: %f\n", graph.computeEnergy(lbp), graph.computeEnergy(trw));
+		* @endcode
+		* > This function supports PPL
+		* @param vLabels The configuration: the states of all the nodes
+		* @return The energy
+		*/
+		DllExport virtual double	computeEnergy(const vec_byte_t &vLabels) const = 0;
+		/**
+		* @brief Returns the memory, used by the graph
+		* @details The result includes the object itself and the allocated capacity of all its containers; the shared potentials are counted once and the
+		* bookkeeping overhead of the heap allocator is not included (ref. @ref footprint). The memory, needed by a graph before it is built, may be
+		* estimated with CGraphPairwiseKit::estimateMemory().
+		* > The default implementation returns only the size of this base object: the derived graphs should add the sizes of their members and containers
+		* @return The size of the graph in bytes
+		*/
+		DllExport virtual size_t	getMemoryUsage(void) const { return sizeof(*this); }
+
+
+	protected:
+		/**
+		* @brief Sums up a function over the blocks of items in parallel
+		* @details The partial sums of the blocks are added in the order of the blocks, thus the result does not depend on the number of threads
+		* @param n The number of items
+		* @param fn The function, returning the sum over the items [\a begin; \a end)
+		* @return The total sum
+		*/
+		static double	parallelSum(size_t n, const std::function<double(size_t begin, size_t end)> &fn);
 
 	
 	private:
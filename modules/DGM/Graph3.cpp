@@ -1,17 +1,91 @@
 #include "Graph3.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels {
 
-void CGraph3::addTriplet(dword Node1, dword Node2, dword Node3) 
+void CGraph3::reset(void)
 {
+	CGraphPairwise::reset();
+	m_vTriplets.clear();
+	m_vNodeTriplets.clear();
 }
 
-void CGraph3::addTriplet(dword Node1, dword Node2, dword Node3, const Mat &pot) 
+// The triplets share the potentials with the original graph
+std::unique_ptr<CGraph> CGraph3::clone(void) const
 {
+	auto res = std::make_unique<CGraph3>(getNumStates());
+	copyTo(*res);
+	res->m_vTriplets		= m_vTriplets;
+	res->m_vNodeTriplets	= m_vNodeTriplets;
+	return res;
 }
 
-void CGraph3::setTriplet(dword Node1, dword Node2, dword Node3, const Mat &pot) 
+void CGraph3::addTriplet(dword Node1, dword Node2, dword Node3)
 {
+	const size_t nNodes = getNumNodes();
+	DGM_ASSERT_MSG(Node1 < nNodes, "The first node index %u is out of range %zu", Node1, nNodes);
+	DGM_ASSERT_MSG(Node2 < nNodes, "The second node index %u is out of range %zu", Node2, nNodes);
+	DGM_ASSERT_MSG(Node3 < nNodes, "The third node index %u is out of range %zu", Node3, nNodes);
+	DGM_ASSERT_MSG(Node1 != Node2 && Node1 != Node3 && Node2 != Node3, "The nodes of the triplet (%u, %u, %u) must be different", Node1, Node2, Node3);
+
+	if (m_vNodeTriplets.size() <= Node1) m_vNodeTriplets.resize(Node1 + 1);
+	m_vNodeTriplets[Node1].push_back(m_vTriplets.size());
+	m_vTriplets.emplace_back(Node1, Node2, Node3);
+}
+
+void CGraph3::addTriplet(dword Node1, dword Node2, dword Node3, const Mat &pot)
+{
+	addTriplet(Node1, Node2, Node3);
+	m_vTriplets.back().Pot = pot.clone();
 }
 
-}
\ No newline at end of file
+void CGraph3::setTriplet(dword Node1, dword Node2, dword Node3, const Mat &pot)
+{
+	DGM_ASSERT_MSG(pot.dims == 3 && pot.size[0] == getNumStates() && pot.size[1] == getNumStates() && pot.size[2] == getNumStates(),
+		"The triplet potential must be a table of size %d x %d x %d", getNumStates(), getNumStates(), getNumStates());
+	m_vTriplets[findTriplet(Node1, Node2, Node3)].Pot = pot.clone();			// copy-on-write: detach the triplet from a potential, shared by setTriplets()
+}
+
+void CGraph3::setTripletPotts(dword Node1, dword Node2, dword Node3, float same, float diff)
+{
+	Mat &pot = m_vTriplets[findTriplet(Node1, Node2, Node3)].Pot;
+	pot = Mat(2, 1, CV_32FC1);
+	pot.at<float>(0, 0) = same;
+	pot.at<float>(1, 0) = diff;
+}
+
+// All the triplets reference one shared potential
+void CGraph3::setTriplets(const Mat &pot)
+{
+	DGM_ASSERT_MSG(isPotts(pot) || (pot.dims == 3 && pot.size[0] == getNumStates() && pot.size[1] == getNumStates() && pot.size[2] == getNumStates()),
+		"The triplet potential must be either a table of size %d x %d x %d or the Potts parameters", getNumStates(), getNumStates(), getNumStates());
+	const Mat sharedPot = pot.clone();
+	for (Triplet &triplet : m_vTriplets) triplet.Pot = sharedPot;
+}
+
+void CGraph3::getTriplet(dword Node1, dword Node2, dword Node3, Mat &pot) const
+{
+	const Mat &src = m_vTriplets[findTriplet(Node1, Node2, Node3)].Pot;
+	if (!isPotts(src)) {
+		pot = src.clone();
+		return;
+	}
+
+	const int nStates	= getNumStates();
+	const int size[]	= { nStates, nStates, nStates };
+	pot = Mat(3, size, CV_32FC1);
+	pot.setTo(src.at<float>(1, 0));
+	for (int s = 0; s < nStates; s++) pot.at<float>(s, s, s) = src.at<float>(0, 0);
+}
+
+// ------------------------------ PRIVATE ------------------------------
+size_t CGraph3::findTriplet(dword Node1, dword Node2, dword Node3) const
+{
+	if (Node1 < m_vNodeTriplets.size())
+		for (size_t t : m_vNodeTriplets[Node1])
+			if (m_vTriplets[t].node2 == Node2 && m_vTriplets[t].node3 == Node3) return t;
+	DGM_ASSERT_MSG(false, "The triplet (%u, %u, %u) is not found", Node1, Node2, Node3);
+	return 0;
+}
+
+}
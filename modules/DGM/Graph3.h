@@ -15,6 +15,7 @@ namespace DirectGraphicalModels
 		size_t	node1;			///< First node in edge
 		size_t	node2;			///< Second node in edge
 		size_t	node3;			///< Third node in edge
+		Mat		Pot;			///< The triplet potentials: either the full table Mat(dims: 3; size: nStates x nStates x nStates; type: CV_32FC1) or the Potts parameters Mat(size: 2 x 1; type: CV_32FC1) (Ref. @ref CGraph3::setTripletPotts()). The data may be shared with other triplets (Ref. @ref CGraph3::setTriplets())
 
 		Triplet(void) {}
 		
@@ -26,6 +27,9 @@ namespace DirectGraphicalModels
 	/**
 	* @brief Triple graph class
 	* @ingroup moduleGraph
+	* @details Besides the pairwise edges, the graph holds the triplets: the factors over three nodes. The function setTriplets() does not copy the potential
+	* table into every triplet: all the triplets reference one shared table, which is detached from a triplet (copy-on-write) when the triplet potential is
+	* changed individually with setTriplet(). The Potts triplets (Ref. setTripletPotts()) store only two parameters instead of the \f$nStates^3\f$ table.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CGraph3 : public CGraphPairwise
@@ -38,30 +42,84 @@ namespace DirectGraphicalModels
 		DllExport CGraph3(byte nStates) : CGraphPairwise(nStates) {}
 		DllExport virtual ~CGraph3(void) {}
 
-
+		DllExport void		reset(void) override;
+		DllExport std::unique_ptr<CGraph> clone(void) const override;
 
 		/**
-		@brief Adds an additional directed edge 
+		@brief Adds an additional triplet
 		@param[in] Node1 index of the first node
 		@param[in] Node2 index of the second node
 		@param[in] Node3 index of the third node
 		*/
 		DllExport void		addTriplet(dword Node1, dword Node2, dword Node3);
 		/**
-		@brief Adds an additional directed edge with specified potentional
+		@brief Adds an additional triplet with specified potentional
 		@param[in] Node1 index of the first node
 		@param[in] Node2 index of the second node
 		@param[in] Node3 index of the third node
-		@param[in] pot edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
+		@param[in] pot triplet potential table: Mat(dims: 3; size: nStates x nStates x nStates; type: CV_32FC1), \a e.g. CTrainTriplet::getTripletPotentials()
 		*/
 		DllExport void		addTriplet(dword Node1, dword Node2, dword Node3, const Mat &pot);
 		/**
-		@brief Sets or changes the potentional of directed edge
+		@brief Sets or changes the potentional of triplet
 		@param[in] Node1 index of the first node
 		@param[in] Node2 index of the second node
 		@param[in] Node3 index of the third node
-		@param[in] pot edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
+		@param[in] pot triplet potential table: Mat(dims: 3; size: nStates x nStates x nStates; type: CV_32FC1), 
+		where the element \a pot.at<float>(x1, x2, x3) corresponds to the states \a x1, \a x2 and \a x3 of the nodes \b Node1, \b Node2 and \b Node3
 		*/
 		DllExport void		setTriplet(dword Node1, dword Node2, dword Node3, const Mat &pot);
+		/**
+		@brief Sets or changes the potentional of triplet to the parametric Potts potential
+		@details The potential is equal to \b same, if all three nodes take the same state, and to \b diff otherwise. Only these two values are stored.
+		@param[in] Node1 index of the first node
+		@param[in] Node2 index of the second node
+		@param[in] Node3 index of the third node
+		@param[in] same the potential value for the equal states of the nodes
+		@param[in] diff the potential value for all other configurations
+		*/
+		DllExport void		setTripletPotts(dword Node1, dword Node2, dword Node3, float same, float diff);
+		/**
+		@brief Sets the potential of all triplets
+		@details All the triplets reference one shared copy of \b pot
+		@param[in] pot triplet potential: either the table Mat(dims: 3; size: nStates x nStates x nStates; type: CV_32FC1) or
+		the Potts parameters Mat(size: 2 x 1; type: CV_32FC1), containing the values \a same and \a diff (Ref. setTripletPotts())
+		*/
+		DllExport void		setTriplets(const Mat &pot);
+		/**
+		@brief Returns the potential table of triplet
+		@param[in] Node1 index of the first node
+		@param[in] Node2 index of the second node
+		@param[in] Node3 index of the third node
+		@param[out] pot triplet potential table: Mat(dims: 3; size: nStates x nStates x nStates; type: CV_32FC1). The Potts potentials are expanded to the full table.
+		If the potential is not set, \b pot is empty
+		*/
+		DllExport void		getTriplet(dword Node1, dword Node2, dword Node3, Mat &pot) const;
+		/**
+		@brief Returns the number of triplets in the graph
+		@return The number of triplets
+		*/
+		DllExport size_t	getNumTriplets(void) const { return m_vTriplets.size(); }
+		/**
+		@brief Returns the triplets container
+		@return The triplets with their (possibly shared and compact) potentials
+		*/
+		DllExport const vec_triplet_t& getTriplets(void) const { return m_vTriplets; }
+		/**
+		@brief Checks whether the triplet potential is a parametric Potts potential
+		@param pot The triplet potential (Ref. @ref Triplet::Pot)
+		@retval true if \b pot holds only the values \a same and \a diff
+		@retval false otherwise
+		*/
+		DllExport static bool isPotts(const Mat &pot) { return !pot.empty() && pot.dims == 2 && pot.total() == 2; }
+
+
+	private:
+		size_t				findTriplet(dword Node1, dword Node2, dword Node3) const;
+
+
+	private:
+		vec_triplet_t			m_vTriplets;		///< The triplets
+		std::vector<vec_size_t>	m_vNodeTriplets;	///< The triplets, indexed by their first node
 	};
 }
\ No newline at end of file
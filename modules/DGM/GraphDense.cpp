@@ -1,4 +1,6 @@
 #include "GraphDense.h"
+#include "IEdgeModel.h"
+#include "footprint.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels 
@@ -44,6 +46,18 @@ namespace DirectGraphicalModels
 			pot.at<float>(s, 0) = pPot[s];
 	}
 
+	span<const float> CGraphDense::getNodeView(size_t node) const
+	{
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		return { m_nodePotentials.ptr<float>(static_cast<int>(node)), getNumStates() };
+	}
+
+	span<float> CGraphDense::getMutableNodeView(size_t node)
+	{
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		return { m_nodePotentials.ptr<float>(static_cast<int>(node)), getNumStates() };
+	}
+
 	void CGraphDense::getNodes(size_t start_node, size_t num_nodes, Mat &pots) const
 	{
 		if (!num_nodes) num_nodes = getNumNodes() - start_node;
@@ -61,4 +75,36 @@ namespace DirectGraphicalModels
 			if (i != node)
 				vNodes.push_back(i);
 	}
+
+	// E = - sum_i log(pot_i(l_i)) - 1/2 sum_i acc_i(l_i), where acc = sum_m accumulate_m(onehot(l)), the self-interaction terms included
+	double CGraphDense::computeEnergy(const vec_byte_t &vLabels) const
+	{
+		const size_t nNodes = getNumNodes();
+		DGM_ASSERT_MSG(vLabels.size() == nNodes, "The number of labels (%zu) does not match the number of nodes (%zu)", vLabels.size(), nNodes);
+		
+		Mat oneHot(m_nodePotentials.size(), CV_32FC1, Scalar(0));
+		for (size_t n = 0; n < nNodes; n++) oneHot.at<float>(static_cast<int>(n), vLabels[n]) = 1.0f;
+		Mat acc(m_nodePotentials.size(), CV_32FC1, Scalar(0));
+		Mat buffer;
+		for (auto &pEdgeModel : m_vpEdgeModels)
+			pEdgeModel->accumulate(oneHot, acc, buffer);
+
+		return parallelSum(nNodes, [&](size_t begin, size_t end) {
+			double sum = 0;
+			for (size_t n = begin; n < end; n++) {
+				const int row = static_cast<int>(n);
+				sum -= log(MAX(FLT_MIN, m_nodePotentials.at<float>(row, vLabels[n])));
+				sum -= 0.5 * acc.at<float>(row, vLabels[n]);
+			}
+			return sum;
+		});
+	}
+
+	size_t CGraphDense::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_nodePotentials) + footprint::getBytes(m_vpEdgeModels);
+		for (const ptr_edgeModel_t &pEdgeModel : m_vpEdgeModels)
+			res += pEdgeModel->getMemoryUsage();
+		return res;
+	}
 }
@@ -33,12 +33,25 @@ namespace DirectGraphicalModels
 		
 		DllExport void		getNode(size_t node, Mat &pot) const override;
 		DllExport void		getNodes(size_t start_node, size_t num_nodes, Mat &pots) const override;
+		DllExport span<const float>	getNodeView(size_t node) const override;
+		DllExport span<float>		getMutableNodeView(size_t node) override;
 		
 		DllExport void		getChildNodes (size_t node, vec_size_t &vNodes) const override;
 		DllExport void		getParentNodes(size_t node, vec_size_t &vNodes) const override { getChildNodes(node, vNodes); }
 
 		DllExport size_t	getNumNodes(void) const override { return static_cast<size_t>(m_nodePotentials.rows); }
 		DllExport size_t	getNumEdges(void) const override { return getNumNodes() * (getNumNodes() - 1) / 2; }
+		/**
+		* @brief Calculates the energy of a configuration
+		* @details The pairwise term is evaluated by applying the edge models to the one-hot encoding of the configuration (ref. IEdgeModel::accumulate()),
+		* thus in O(nNodes) instead of O(nNodes<sup>2</sup>). This is exact for the edge models, whose accumulate() is linear in the potentials, such as
+		* @ref CEdgeModelPotts. The self-interaction terms, which the edge models include (the kernel of a node with itself), are not subtracted: for the linear
+		* models they do not depend on the configuration, as long as the compatibility of every state with itself is the same, and shift all the energies equally.
+		* @param vLabels The configuration: the states of all the nodes
+		* @return The energy
+		*/
+		DllExport double	computeEnergy(const vec_byte_t &vLabels) const override;
+		DllExport size_t	getMemoryUsage(void) const override;
 
 		// Own
 		/**
@@ -1,12 +1,80 @@
 #include "GraphDenseExt.h"
+#include "ThreadPool.h"
 #include "GraphDense.h"
 #include "EdgeModelPotts.h"
+#include "profiler.h"
 #include "macroses.h"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 namespace DirectGraphicalModels 
 {
+	namespace {
+		// First-in-first-out cache of the immutable objects
+		template<typename Key, typename Value>
+		class CCache {
+		public:
+			static const size_t CAPACITY = 16;
+
+			template<typename Create>
+			Value get(const Key &key, Create create) 
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mtx);
+					auto it = m_map.find(key);
+					if (it != m_map.end()) return it->second;
+				}
+				Value res = create();											// created outside the lock: the duplicates are harmless
+				std::lock_guard<std::mutex> lock(m_mtx);
+				if (m_map.emplace(key, res).second) {
+					m_order.push_back(key);
+					if (m_order.size() > CAPACITY) {
+						m_map.erase(m_order.front());
+						m_order.pop_front();
+					}
+				}
+				return res;
+			}
+			void clear(void) 
+			{
+				std::lock_guard<std::mutex> lock(m_mtx);
+				m_map.clear();
+				m_order.clear();
+			}
+
+		private:
+			std::mutex			m_mtx;
+			std::map<Key, Value>	m_map;
+			std::deque<Key>		m_order;
+		};
+
+		using spatial_key_t		= std::tuple<int, int, float, float>;			// width, height, sigma
+		using gaussian_key_t	= std::tuple<int, int, float, float, float>;	// width, height, sigma, weight
+
+		CCache<spatial_key_t, Mat>& getSpatialCache(void) { static CCache<spatial_key_t, Mat> cache; return cache; }
+		CCache<gaussian_key_t, ptr_edgeModel_t>& getGaussianCache(void) { static CCache<gaussian_key_t, ptr_edgeModel_t> cache; return cache; }
+
+		// Fills the features (x / sigma[0], y / sigma[1], fill(y, x)) of the graph nodes: the image rows are filled in parallel
+		template<typename Fill>
+		void fillFeatures(Mat &features, Size size, Vec2f sigma, Fill fill)
+		{
+			parallel::parallelFor(Range(0, size.height), [&](const Range& range) {
+				for (int y = range.start; y < range.end; y++)
+					for (int x = 0; x < size.width; x++) {
+						float *pFeature = features.ptr<float>(y * size.width + x);
+						pFeature[0] = x / sigma.val[0];
+						pFeature[1] = y / sigma.val[1];
+						fill(y, x, pFeature + 2);
+					} // x
+			});
+		}
+	}
+
     void CGraphDenseExt::buildGraph(Size graphSize)
     {
+		DGM_PROFILE_ZONE("buildGraph");
         m_size = graphSize;
 		
 		if (m_graph.getNumNodes()) m_graph.reset();
@@ -14,34 +82,34 @@ namespace DirectGraphicalModels
 		// 2D default potentials
 		Mat pots(graphSize, CV_32FC(m_graph.getNumStates()));
 		pots.setTo(1.0f / m_graph.getNumStates());
-        m_graph.addNodes(pots.clone().reshape(1, pots.cols * pots.rows));
+        m_graph.addNodes(pots.reshape(1, pots.cols * pots.rows));
     }
     
     void CGraphDenseExt::setGraph(const Mat &pots)
 	{
+		DGM_PROFILE_ZONE("setGraph");
         m_size = pots.size();
 
+		// The graph copies the potentials: the clone is needed only for the reshaping of a non-continuous matrix
+		const Mat nodePots = (pots.isContinuous() ? pots : pots.clone()).reshape(1, pots.cols * pots.rows);
         if (m_graph.getNumNodes() == pots.cols * pots.rows) 
-			m_graph.setNodes(0, pots.clone().reshape(1, pots.cols * pots.rows));
+			m_graph.setNodes(0, nodePots);
         else {
             if (m_graph.getNumNodes()) m_graph.reset();
-            m_graph.addNodes(pots.clone().reshape(1, pots.cols * pots.rows));
+            m_graph.addNodes(nodePots);
         }
 	}
 
 	void CGraphDenseExt::addGaussianEdgeModel(Vec2f sigma, float weight, const std::function<void(const Mat& src, Mat& dst)> &semiMetricFunction)
 	{
-		Mat features;
-		Mat feature(1, 2, CV_32FC1);
-		float *pFeature = feature.ptr<float>(0);
-		for (int y = 0; y < m_size.height; y++) 
-			for (int x = 0; x < m_size.width; x++) {
-				pFeature[0] = x / sigma.val[0];
-				pFeature[1] = y / sigma.val[1];
-				features.push_back(feature);
-			} // x
-
-		m_graph.addEdgeModel(std::make_shared<CEdgeModelPotts>(features, weight, semiMetricFunction));
+		if (semiMetricFunction) 
+			m_graph.addEdgeModel(std::make_shared<CEdgeModelPotts>(getSpatialFeatures(m_size, sigma), weight, semiMetricFunction));
+		else {
+			const gaussian_key_t key(m_size.width, m_size.height, sigma.val[0], sigma.val[1], weight);
+			m_graph.addEdgeModel(getGaussianCache().get(key, [&]() -> ptr_edgeModel_t { 
+				return std::make_shared<CEdgeModelPotts>(getSpatialFeatures(m_size, sigma), weight); 
+			}));
+		}
 	}
 
 	void CGraphDenseExt::addBilateralEdgeModel(const Mat &featureVectors, Vec2f sigma, float sigma_opt, float weight, const std::function<void(const Mat& src, Mat& dst)> &semiMetricFunction)
@@ -49,19 +117,11 @@ namespace DirectGraphicalModels
         const word	nFeatures = featureVectors.channels();
         
         DGM_ASSERT_MSG(featureVectors.size() == m_size, "Resilution of the train image does not equal to the graph size");
-        Mat features; 
-        Mat feature(1, 2 + nFeatures, CV_32FC1);
-        float *pFeature = feature.ptr<float>(0);
-        for (int y = 0; y < m_size.height; y++) {
-			const byte *pFv = featureVectors.ptr<byte>(y);
-			for (int x = 0; x < m_size.width; x++) {
-				pFeature[0] = x / sigma.val[0];
-				pFeature[1] = y / sigma.val[1];
-                for (word f = 0; f < nFeatures; f++)
-                    pFeature[2 + f] = pFv[nFeatures * x + f] / sigma_opt;
-                features.push_back(feature);
-			} // x
-		} // y
+        Mat features(m_size.width * m_size.height, 2 + nFeatures, CV_32FC1);
+		fillFeatures(features, m_size, sigma, [&](int y, int x, float *pFeature) {
+			const byte *pFv = featureVectors.ptr<byte>(y) + nFeatures * x;
+			for (word f = 0; f < nFeatures; f++) pFeature[f] = pFv[f] / sigma_opt;
+		});
 		m_graph.addEdgeModel(std::make_shared<CEdgeModelPotts>(features, weight, semiMetricFunction));
 	}
 
@@ -71,20 +131,27 @@ namespace DirectGraphicalModels
         
         DGM_ASSERT_MSG(!featureVectors.empty(), "The train image is empty");
         DGM_ASSERT_MSG(featureVectors[0].size() == m_size, "Resilution of the train image does not equal to the graph size");
-        Mat features;
-        Mat feature(1, 2 + nFeatures, CV_32FC1);
-        float *pFeature = feature.ptr<float>(0);
-        for (int y = 0; y < m_size.height; y++) {
-            byte const **pFv = new const byte *[nFeatures];
-            for (word f = 0; f < nFeatures; f++) pFv[f] = featureVectors[f].ptr<byte>(y);
-            for (int x = 0; x < m_size.width; x++) {
-                pFeature[0] = x / sigma.val[0];
-                pFeature[1] = y / sigma.val[1];
-                for (int f = 0; f < nFeatures; f++)
-                    pFeature[2 + f] = pFv[f][x] / sigma_opt;
-                features.push_back(feature);
-            } // x
-        } // y
+        Mat features(m_size.width * m_size.height, 2 + nFeatures, CV_32FC1);
+		fillFeatures(features, m_size, sigma, [&](int y, int x, float *pFeature) {
+			for (word f = 0; f < nFeatures; f++) pFeature[f] = featureVectors[f].ptr<byte>(y)[x] / sigma_opt;
+		});
         m_graph.addEdgeModel(std::make_shared<CEdgeModelPotts>(features, weight, semiMetricFunction));
     }
+
+	void CGraphDenseExt::clearEdgeModelCache(void)
+	{
+		getSpatialCache().clear();
+		getGaussianCache().clear();
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	Mat CGraphDenseExt::getSpatialFeatures(Size size, Vec2f sigma)
+	{
+		const spatial_key_t key(size.width, size.height, sigma.val[0], sigma.val[1]);
+		return getSpatialCache().get(key, [&]() {
+			Mat res(size.width * size.height, 2, CV_32FC1);
+			fillFeatures(res, size, sigma, [](int, int, float *) {});
+			return res;
+		});
+	}
 }
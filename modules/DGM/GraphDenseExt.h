@@ -64,6 +64,8 @@ namespace DirectGraphicalModels
 		
 		/**
 		* @brief Add a Gaussian potential model with standard deviation \b sigma
+		* @details The Gaussian model depends only on the graph size, \b sigma and \b weight. Thus, if no \b semiMetricFunction is given, the initialized
+		* models are kept in a process-wide cache and the graphs of the same size share one immutable model (ref. clearEdgeModelCache()).
 		* @param sigma The spatial standard deviation of the 2D-Gaussian filter 
 		* @param weight The weighting parameter
 		* @param semiMetricFunction Reference to a semi-metric function, which arguments \b src and \b dst are: Mat(size: 1 x nFeatures; type: CV_32FC1). 
@@ -72,6 +74,7 @@ namespace DirectGraphicalModels
         DllExport void addGaussianEdgeModel(Vec2f sigma, float weight = 1.0f, const std::function<void(const Mat& src, Mat& dst)>& semiMetricFunction = {});
 		/**
 		* @brief Add a Bilateral pairwise potential with spacial standard deviations \b sigma and color standard deviations sr,sg,sb
+		* @details The features are written directly into one preallocated matrix, which is filled in parallel and passed to the lattice without copying
 		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC<nFeatures>)
 		* @param sigma The spatial standard deviation of the 2D-bilateral filter 
 		* @param sigma_opt The standard deviation for \b featureVectors
@@ -90,6 +93,17 @@ namespace DirectGraphicalModels
 		* For more details refere to @ref CEdgeModelPotts.
         */
         DllExport void addBilateralEdgeModel(const vec_mat_t& featureVectors, Vec2f sigma, float sigma_opt = 1.0f, float weight = 1.0f, const std::function<void(const Mat& src, Mat& dst)>& semiMetricFunction = {});
+		/**
+		* @brief Clears the cache of the Gaussian edge models and spatial features
+		* @details The cache keeps up to 16 models and 16 spatial feature sets: the oldest ones are dropped first. The models, which are already 
+		* added to the graphs, stay valid.
+		*/
+		DllExport static void clearEdgeModelCache(void);
+
+
+	private:
+		// Returns the spatial features (x / sigma[0], y / sigma[1]) of the graph nodes: Mat(size: nNodes x 2; type: CV_32FC1)
+		static Mat getSpatialFeatures(Size size, Vec2f sigma);
 
 
 	private:
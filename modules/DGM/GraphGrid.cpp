@@ -0,0 +1,424 @@
+#include "GraphGrid.h"
+#include "ThreadPool.h"
+#include "footprint.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	void CGraphGrid::build(Size size, word nLayers, byte gType)
+	{
+		DGM_ASSERT_MSG(nLayers > 0, "The number of layers must be positive");
+		reset();
+
+		m_size		= size;
+		m_nLayers	= nLayers;
+		m_gType		= gType;
+
+		if (gType & GRAPH_EDGES_GRID) {
+			m_vDirections.push_back({ -1,  0, 0, 0, 0 });
+			m_vDirections.push_back({  1,  0, 0, 0, 0 });
+			m_vDirections.push_back({  0, -1, 0, 0, 0 });
+			m_vDirections.push_back({  0,  1, 0, 0, 0 });
+		}
+		if (gType & GRAPH_EDGES_DIAG) {
+			m_vDirections.push_back({ -1, -1, 0, 0, 0 });
+			m_vDirections.push_back({  1,  1, 0, 0, 0 });
+			m_vDirections.push_back({  1, -1, 0, 0, 0 });
+			m_vDirections.push_back({ -1,  1, 0, 0, 0 });
+		}
+		if ((gType & GRAPH_EDGES_LINK) && nLayers >= 2) {
+			m_vDirections.push_back({  0,  0, 0,  1, 1 });		// layer l -> l + 1
+			m_vDirections.push_back({  0,  0, 0, -1, 1 });		// layer 1 -> 0 (the second half of the arc between the first two layers)
+		}
+
+		const size_t nNodes = static_cast<size_t>(size.width) * size.height * nLayers;
+		m_vNodePots.assign(nNodes * getNumStates(), 1.0f / getNumStates());
+		countEdges();
+	}
+
+	void CGraphGrid::buildVolume(Size size, int depth, byte connectivity)
+	{
+		DGM_ASSERT_MSG(depth > 0, "The depth of the volume must be positive");
+		reset();
+
+		m_size	= size;
+		m_depth	= depth;
+		for (const CGraphVolumeExt::Direction &dir : CGraphVolumeExt::getDirections(connectivity)) {
+			m_vDirections.push_back({  dir.dx,  dir.dy,  dir.dz, 0, dir.group });
+			m_vDirections.push_back({ -dir.dx, -dir.dy, -dir.dz, 0, dir.group });
+		}
+
+		const size_t nNodes = static_cast<size_t>(size.width) * size.height * depth;
+		m_vNodePots.assign(nNodes * getNumStates(), 1.0f / getNumStates());
+		countEdges();
+	}
+
+	void CGraphGrid::reset(void)
+	{
+		m_size = Size(0, 0);
+		m_depth = 1;
+		m_nLayers = 1;
+		m_gType = GRAPH_EDGES_NONE;
+		m_vDirections.clear();
+		m_nEdges = 0;
+		m_vNodePots.clear();
+		m_vGroupPots.assign(256, vec_float_t());
+		m_hasEdgeArrays = false;
+		m_vEdgePots.clear();
+		m_vEdgeHasPot.clear();
+		m_vEdgeGroup.clear();
+		m_vEdgeRemoved.clear();
+	}
+
+	size_t CGraphGrid::addNode(const Mat &)
+	{
+		DGM_ASSERT_MSG(false, "Nodes can not be added to the grid graph. Use CGraphGrid::build() instead");
+		return getNumNodes();
+	}
+
+	// Set or change the potential of node idx
+	void CGraphGrid::setNode(size_t node, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		DGM_ASSERT_MSG((pot.cols == 1) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, 1, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		float *pPot = &m_vNodePots[node * nStates];
+		for (byte s = 0; s < nStates; s++) pPot[s] = pot.at<float>(s, 0);
+		markDirty(node, node + 1);
+	}
+
+	void CGraphGrid::setNodes(size_t start_node, const Mat &pots)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(start_node + pots.rows <= getNumNodes(), "The given ranges exceed the number of nodes(%zu)", getNumNodes());
+		DGM_ASSERT_MSG(pots.cols == nStates, "Potential size (%d) does not match (%d)", pots.cols, nStates);
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1, "Potentials type is not CV_32FC1");
+
+		parallel::parallelFor(Range(0, pots.rows), [start_node, nStates, &pots, this](const Range& range) {
+			for (int n = range.start; n < range.end; n++)
+				memcpy(&m_vNodePots[(start_node + n) * nStates], pots.ptr<float>(n), nStates * sizeof(float));
+		});
+		markDirty(start_node, start_node + pots.rows);
+	}
+
+	// Return node potential vector
+	void CGraphGrid::getNode(size_t node, Mat &pot) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		if (pot.empty() || pot.cols != 1 || pot.rows != nStates || pot.type() != CV_32FC1)
+			pot = Mat(nStates, 1, CV_32FC1);
+
+		const float *pPot = &m_vNodePots[node * nStates];
+		for (byte s = 0; s < nStates; s++)
+			pot.at<float>(s, 0) = pPot[s];
+	}
+
+	span<const float> CGraphGrid::getNodeView(size_t node) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		return { &m_vNodePots[node * nStates], nStates };
+	}
+
+	span<float> CGraphGrid::getMutableNodeView(size_t node)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		markDirty(node, node + 1);
+		return { &m_vNodePots[node * nStates], nStates };
+	}
+
+	void CGraphGrid::getNodes(size_t start_node, size_t num_nodes, Mat &pots) const
+	{
+		const byte nStates = getNumStates();
+		if (!num_nodes) num_nodes = getNumNodes() - start_node;
+		DGM_ASSERT_MSG(start_node + num_nodes <= getNumNodes(), "The given ranges exceed the number of nodes(%zu)", getNumNodes());
+
+		pots = Mat(static_cast<int>(num_nodes), nStates, CV_32FC1);
+		memcpy(pots.data, &m_vNodePots[start_node * nStates], num_nodes * nStates * sizeof(float));
+	}
+
+	// Return child nodes ID's
+	void CGraphGrid::getChildNodes(size_t node, vec_size_t &vNodes) const
+	{
+		const size_t nNodes = getNumNodes();
+		DGM_ASSERT_MSG(node < nNodes, "Node %zu is out of range %zu", node, nNodes);
+		if (!vNodes.empty()) vNodes.clear();
+		for (size_t d = 0; d < m_vDirections.size(); d++) {
+			size_t dst = getNeighbour(node, d);
+			if (dst < nNodes && !isSlotRemoved(node * m_vDirections.size() + d)) vNodes.push_back(dst);
+		}
+	}
+
+	// Return parent nodes ID's
+	void CGraphGrid::getParentNodes(size_t node, vec_size_t &vNodes) const
+	{
+		const size_t nNodes = getNumNodes();
+		DGM_ASSERT_MSG(node < nNodes, "Node %zu is out of range %zu", node, nNodes);
+		if (!vNodes.empty()) vNodes.clear();
+		for (size_t d = 0; d < m_vDirections.size(); d++) {
+			const Direction &dir = m_vDirections[d];
+			long long src = static_cast<long long>(node) - ((static_cast<long long>(dir.dz) * m_size.height + dir.dy) * m_size.width + dir.dx) * m_nLayers - dir.dl;
+			if (src < 0 || static_cast<size_t>(src) >= nNodes) continue;
+			if (getNeighbour(static_cast<size_t>(src), d) != node) continue;
+			if (!isSlotRemoved(static_cast<size_t>(src) * m_vDirections.size() + d)) vNodes.push_back(static_cast<size_t>(src));
+		}
+	}
+
+	void CGraphGrid::addEdge(size_t srcNode, size_t dstNode, byte group, const Mat &pot)
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = getNumSlots();
+		for (size_t d = 0; d < m_vDirections.size(); d++)
+			if (getNeighbour(srcNode, d) == dstNode) slot = srcNode * m_vDirections.size() + d;
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) does not belong to the grid", srcNode, dstNode);
+		DGM_ASSERT_MSG(isSlotRemoved(slot), "The edge (%zu)->(%zu) already exists", srcNode, dstNode);
+
+		m_vEdgeRemoved[slot] = 0;
+		m_vEdgeGroup[slot] = group;
+		m_nEdges++;
+		if (!pot.empty()) setEdge(srcNode, dstNode, pot);
+	}
+
+	// Set or change the potentional of an directed edge
+	void CGraphGrid::setEdge(size_t srcNode, size_t dstNode, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+		DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		createEdgeArrays();
+		for (byte y = 0; y < nStates; y++)
+			memcpy(&m_vEdgePots[(slot * nStates + y) * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+		m_vEdgeHasPot[slot] = 1;
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
+	}
+
+	void CGraphGrid::setEdges(std::optional<byte> group, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		vec_float_t vPot(nStates * nStates);
+		for (byte y = 0; y < nStates; y++)
+			memcpy(&vPot[y * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+
+		if (group) m_vGroupPots[group.value()] = vPot;
+		else std::fill(m_vGroupPots.begin(), m_vGroupPots.end(), vPot);
+
+		// The group potential replaces the individual potentials of the group's edges
+		if (m_hasEdgeArrays) {
+			const int nSlots = static_cast<int>(getNumSlots());
+			parallel::parallelFor(Range(0, nSlots), [&, group](const Range& range) {
+				for (int e = range.start; e < range.end; e++)
+					if (!group || m_vEdgeGroup[e] == group.value()) m_vEdgeHasPot[e] = 0;
+			});
+		}
+		markDirty(0, getNumNodes());
+	}
+
+	// Return edge potential matrix
+	void CGraphGrid::getEdge(size_t srcNode, size_t dstNode, Mat &pot) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		const float *pPot = getSlotPot(slot);
+		if (!pPot) {
+			DGM_WARNING("Edge Potential is empty");
+			if (!pot.empty()) pot.release();
+		} else {
+			pot = Mat(nStates, nStates, CV_32FC1);
+			memcpy(pot.data, pPot, nStates * nStates * sizeof(float));
+		}
+	}
+
+	span<const float> CGraphGrid::getEdgeView(size_t srcNode, size_t dstNode) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const float *pPot = getSlotPot(slot);
+		if (!pPot) return {};
+		return { pPot, static_cast<size_t>(nStates) * nStates };
+	}
+
+	span<float> CGraphGrid::getMutableEdgeView(size_t srcNode, size_t dstNode)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const float *pPot = getSlotPot(slot);
+		if (!pPot) return {};
+
+		// copy-on-write: the edge gets its own copy of the group potential
+		createEdgeArrays();
+		float *pDst = &m_vEdgePots[slot * nStates * nStates];
+		if (!m_vEdgeHasPot[slot]) {
+			memcpy(pDst, pPot, nStates * nStates * sizeof(float));
+			m_vEdgeHasPot[slot] = 1;
+		}
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
+		return { pDst, static_cast<size_t>(nStates) * nStates };
+	}
+
+	void CGraphGrid::setEdgeGroup(size_t srcNode, size_t dstNode, byte group)
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		if (getSlotGroup(slot) == group) return;
+		createEdgeArrays();
+		m_vEdgeGroup[slot] = group;
+	}
+
+	byte CGraphGrid::getEdgeGroup(size_t srcNode, size_t dstNode) const
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		return getSlotGroup(slot);
+	}
+
+	void CGraphGrid::removeEdge(size_t srcNode, size_t dstNode)
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t slot = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(slot < getNumSlots(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		createEdgeArrays();
+		m_vEdgeRemoved[slot] = 1;
+		m_vEdgeHasPot[slot] = 0;
+		m_nEdges--;
+	}
+
+	bool CGraphGrid::isEdgeExists(size_t srcNode, size_t dstNode) const
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		return findEdge(srcNode, dstNode) < getNumSlots();
+	}
+
+	double CGraphGrid::computeEnergy(const vec_byte_t &vLabels) const
+	{
+		const size_t nStates	= getNumStates();
+		const size_t nNodes		= getNumNodes();
+		const size_t nDirs		= m_vDirections.size();
+		DGM_ASSERT_MSG(vLabels.size() == nNodes, "The number of labels (%zu) does not match the number of nodes (%zu)", vLabels.size(), nNodes);
+		return parallelSum(nNodes, [&](size_t begin, size_t end) {
+			double sum = 0;
+			for (size_t n = begin; n < end; n++) {
+				sum -= log(MAX(FLT_MIN, m_vNodePots[n * nStates + vLabels[n]]));
+				for (size_t d = 0; d < nDirs; d++) {
+					const size_t slot	= n * nDirs + d;
+					const size_t dst	= getNeighbour(n, d);
+					if (dst >= nNodes || isSlotRemoved(slot)) continue;
+					const float *pPot = getSlotPot(slot);
+					if (pPot) sum -= log(MAX(FLT_MIN, pPot[vLabels[n] * nStates + vLabels[dst]]));
+				} // d
+			} // n
+			return sum;
+		});
+	}
+
+	size_t CGraphGrid::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + footprint::getBytes(m_vDirections) + footprint::getBytes(m_vNodePots) + footprint::getBytes(m_vGroupPots)
+			+ footprint::getBytes(m_vEdgePots) + footprint::getBytes(m_vEdgeHasPot) + footprint::getBytes(m_vEdgeGroup) + footprint::getBytes(m_vEdgeRemoved);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	size_t CGraphGrid::getNeighbour(size_t node, size_t dir) const
+	{
+		const size_t	  nNodes	= getNumNodes();
+		const Direction	& d			= m_vDirections[dir];
+		const int		  l			= static_cast<int>(node % m_nLayers);
+		const size_t	  pixel		= node / m_nLayers;
+		const size_t	  area		= static_cast<size_t>(m_size.width) * m_size.height;
+		const size_t	  inSlice	= pixel % area;
+		const int		  x			= static_cast<int>(inSlice % m_size.width) + d.dx;
+		const int		  y			= static_cast<int>(inSlice / m_size.width) + d.dy;
+		const int		  z			= static_cast<int>(pixel / area) + d.dz;
+
+		if (x < 0 || x >= m_size.width || y < 0 || y >= m_size.height || z < 0 || z >= m_depth) return nNodes;
+		if (d.dl > 0 && l + 1 >= m_nLayers) return nNodes;
+		if (d.dl < 0 && l != 1) return nNodes;
+
+		return ((static_cast<size_t>(z) * m_size.height + y) * m_size.width + x) * m_nLayers + l + d.dl;
+	}
+
+	void CGraphGrid::countEdges(void)
+	{
+		const size_t nNodes = getNumNodes();
+		m_nEdges = 0;
+		for (size_t n = 0; n < nNodes; n++)
+			for (size_t d = 0; d < m_vDirections.size(); d++)
+				if (getNeighbour(n, d) < nNodes) m_nEdges++;
+	}
+
+	size_t CGraphGrid::findEdge(size_t srcNode, size_t dstNode) const
+	{
+		for (size_t d = 0; d < m_vDirections.size(); d++)
+			if (getNeighbour(srcNode, d) == dstNode) {
+				size_t slot = srcNode * m_vDirections.size() + d;
+				return isSlotRemoved(slot) ? getNumSlots() : slot;
+			}
+		return getNumSlots();
+	}
+
+	const float* CGraphGrid::getSlotPot(size_t slot) const
+	{
+		const byte nStates = getNumStates();
+		if (isSlotRemoved(slot)) return NULL;
+		if (m_hasEdgeArrays && m_vEdgeHasPot[slot]) return &m_vEdgePots[slot * nStates * nStates];
+		const vec_float_t &groupPot = m_vGroupPots[getSlotGroup(slot)];
+		return groupPot.empty() ? NULL : groupPot.data();
+	}
+
+	void CGraphGrid::createEdgeArrays(void)
+	{
+		if (m_hasEdgeArrays) return;
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (m_hasEdgeArrays) return;
+
+		const byte		nStates = getNumStates();
+		const size_t	nSlots	= getNumSlots();
+		m_vEdgePots.assign(nSlots * nStates * nStates, 0.0f);
+		m_vEdgeHasPot.assign(nSlots, 0);
+		m_vEdgeRemoved.assign(nSlots, 0);
+		m_vEdgeGroup.resize(nSlots);
+		for (size_t e = 0; e < nSlots; e++) m_vEdgeGroup[e] = m_vDirections[e % m_vDirections.size()].group;
+		m_hasEdgeArrays = true;
+	}
+}
@@ -0,0 +1,157 @@
+// (pairwise) Implicit grid graph class interface;
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "IGraphPairwise.h"
+#include "GraphLayeredExt.h"
+#include "GraphVolumeExt.h"
+#include <atomic>
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	// ================================ Grid Graph Class ================================
+	/**
+	* @brief Pairwise graph class with implicit regular grid structure
+	* @ingroup moduleGraph
+	* @details This class represents a 2D (multi-layer) lattice without storing the adjacency: the neighbours of every node are computed from its
+	* position (x, y, layer). The node indexing and the edge pattern are the same as the ones produced by @ref CGraphLayeredExt::buildGraph():
+	* node index is \f$(y \cdot width + x) \cdot nLayers + layer\f$, grid and diagonal edges are arcs within one layer (group 0), links connect
+	* the layers of one pixel (group 1). The graph is created with the build() function, which is also called by @ref CGraphLayeredExt::buildGraph().
+	* The 3D lattices (volumes and video stacks) are created with the buildVolume() function, which is also called by @ref CGraphVolumeExt::buildGraph():
+	* their node index is \f$(z \cdot height + y) \cdot width + x\f$ and every direction has its own edge group (ref. CGraphVolumeExt::getDirectionGroup()).
+	*
+	* The edge potentials are stored per edge group, and thus setEdges() does not depend on the number of edges. A dense per-edge array is allocated
+	* on the first call of setEdge(), setArc() or setEdgeGroup(); the per-edge potentials override the group potentials.
+	* > Nodes can not be added with addNode(); addEdge() only restores a previously removed edge of the grid.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGraphGrid : public IGraphPairwise
+	{
+		friend class CMessagePassing;
+
+	public:
+		/**
+		* @brief Constructor
+		* @param nStates the number of States (classes)
+		*/
+		DllExport CGraphGrid(byte nStates) : IGraphPairwise(nStates), m_size(0, 0), m_depth(1), m_nLayers(1), m_gType(GRAPH_EDGES_NONE), m_nEdges(0), m_vGroupPots(256), m_hasEdgeArrays(false) {}
+		DllExport virtual ~CGraphGrid(void) = default;
+
+		/**
+		* @brief Builds the grid
+		* @details All the node potentials are initialized with the uniform potential \f$1 / nStates\f$. The edge potentials are not set.
+		* @param size The size of the grid (image resolution)
+		* @param nLayers The number of layers
+		* @param gType The graph type. (Ref. @ref graphEdgesType)
+		*/
+		DllExport void		build(Size size, word nLayers = 1, byte gType = GRAPH_EDGES_GRID);
+		/**
+		* @brief Builds the 3D lattice
+		* @details All the node potentials are initialized with the uniform potential \f$1 / nStates\f$. The edge potentials are not set.
+		* @param size The size of one slice
+		* @param depth The number of slices
+		* @param connectivity The connectivity of the lattice (Ref. @ref volumeEdgesType)
+		*/
+		DllExport void		buildVolume(Size size, int depth, byte connectivity = VOLUME_EDGES_6);
+		/**
+		* @brief Returns the size of the grid
+		* @return The size of the grid (of one slice for the 3D lattices)
+		*/
+		DllExport Size		getSize(void) const { return m_size; }
+		/**
+		* @brief Returns the depth of the grid
+		* @return The number of slices of the 3D lattice, or 1 for the 2D grid
+		*/
+		DllExport int		getDepth(void) const { return m_depth; }
+
+		// CGraph
+		DllExport void		reset(void) override;
+		DllExport size_t	addNode		  (const Mat &pot = EmptyMat) override;
+		DllExport void		setNode       (size_t node, const Mat &pot) override;
+		DllExport void		setNodes	  (size_t start_node, const Mat &pots) override;
+		DllExport void		getNode       (size_t node, Mat &pot) const override;
+		DllExport span<const float>	getNodeView(size_t node) const override;
+		DllExport span<float>		getMutableNodeView(size_t node) override;
+		DllExport void		getNodes	  (size_t start_node, size_t num_nodes, Mat &pots) const override;
+		DllExport void		getChildNodes (size_t node, vec_size_t &vNodes) const override;
+		DllExport void		getParentNodes(size_t node, vec_size_t &vNodes) const override;
+		DllExport size_t	getNumNodes(void) const override { return m_vNodePots.size() / getNumStates(); }
+		DllExport size_t	getNumEdges(void) const override { return m_nEdges; }
+
+		// IGraphPairwise
+		DllExport void		addEdge		(size_t srcNode, size_t dstNode, byte group, const Mat &pot) override;
+		DllExport void		setEdge		(size_t srcNode, size_t dstNode, const Mat &pot) override;
+		DllExport void		setEdges	(std::optional<byte> group, const Mat& pot) override;
+		DllExport void		getEdge		(size_t srcNode, size_t dstNode, Mat &pot) const override;
+		DllExport span<const float>	getEdgeView(size_t srcNode, size_t dstNode) const override;
+		DllExport span<float>		getMutableEdgeView(size_t srcNode, size_t dstNode) override;
+		DllExport void		setEdgeGroup(size_t srcNode, size_t dstNode, byte group) override;
+		DllExport byte		getEdgeGroup(size_t srcNode, size_t dstNode) const override;
+		DllExport void		removeEdge	(size_t srcNode, size_t dstNode) override;
+		DllExport bool		isEdgeExists(size_t srcNode, size_t dstNode) const override;
+		DllExport double	computeEnergy(const vec_byte_t &vLabels) const override;
+		DllExport size_t	getMemoryUsage(void) const override;
+
+
+	private:
+		/// Direction of an edge in the grid
+		struct Direction {
+			int		dx;			///< Shift along the x-axis
+			int		dy;			///< Shift along the y-axis
+			int		dz;			///< Shift along the z-axis (between the slices)
+			int		dl;			///< Shift along the layers
+			byte	group;		///< Default edge group
+		};
+
+
+	private:
+		/**
+		* @brief Returns the neighbour of the node in the given direction
+		* @param node The node index
+		* @param dir The direction index
+		* @return The neighbouring node index, or the number of nodes if the neighbour does not exist
+		*/
+		size_t		getNeighbour(size_t node, size_t dir) const;
+		/**
+		* @brief Returns the edge slot of the edge (\b srcNode) --> (\b dstNode)
+		* @details Every node owns one edge slot per direction: slot = node * nDirections + direction
+		* @return The slot index if the edge exists, or the number of slots otherwise
+		*/
+		size_t		findEdge(size_t srcNode, size_t dstNode) const;
+		// Counts the existing edges of the grid
+		void		countEdges(void);
+		size_t		getNumSlots(void) const { return getNumNodes() * m_vDirections.size(); }
+		byte		getSlotGroup(size_t slot) const { return m_hasEdgeArrays ? m_vEdgeGroup[slot] : m_vDirections[slot % m_vDirections.size()].group; }
+		bool		isSlotRemoved(size_t slot) const { return m_hasEdgeArrays && m_vEdgeRemoved[slot]; }
+		/**
+		* @brief Returns the pointer to the edge potential of the slot
+		* @return The pointer to \a nStates x \a nStates values, or NULL if the potential is not set
+		*/
+		const float* getSlotPot(size_t slot) const;
+		/**
+		* @brief Allocates the dense per-edge arrays
+		* @details Thread-safe
+		*/
+		void		createEdgeArrays(void);
+
+
+	private:
+		Size						m_size;				///< Size of the grid
+		int							m_depth;			///< Number of slices
+		word						m_nLayers;			///< Number of layers
+		byte						m_gType;			///< The graph type
+		std::vector<Direction>		m_vDirections;		///< Active edge directions
+		size_t						m_nEdges;			///< Number of the existing edges
+
+		vec_float_t					m_vNodePots;		///< %Node potentials: nNodes x nStates
+		std::vector<vec_float_t>	m_vGroupPots;		///< %Edge potentials per group: 256 x (nStates x nStates or empty)
+
+		std::atomic<bool>			m_hasEdgeArrays;	///< Flag indicating whether the dense per-edge arrays are allocated
+		vec_float_t					m_vEdgePots;		///< Per-edge potentials: nSlots x nStates x nStates
+		vec_byte_t					m_vEdgeHasPot;		///< Flags indicating whether the per-edge potential is set
+		vec_byte_t					m_vEdgeGroup;		///< Group of every edge slot
+		vec_byte_t					m_vEdgeRemoved;		///< Flags indicating whether the edge was removed
+		std::mutex					m_mtx;				///< Guards the lazy allocation of the per-edge arrays
+	};
+}
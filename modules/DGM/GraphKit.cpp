@@ -11,6 +11,10 @@ namespace DirectGraphicalModels
 		{
 		case DirectGraphicalModels::GraphType::pairwise:
 			return std::make_shared<CGraphPairwiseKit>(nStates);
+		case DirectGraphicalModels::GraphType::csr:
+			return std::make_shared<CGraphPairwiseKit>(nStates, INFER::LBP, GraphType::csr);
+		case DirectGraphicalModels::GraphType::grid:
+			return std::make_shared<CGraphPairwiseKit>(nStates, INFER::LBP, GraphType::grid);
 		case DirectGraphicalModels::GraphType::dense:
 			return std::make_shared<CGraphDenseKit>(nStates);
 		default:
@@ -9,7 +9,9 @@ namespace DirectGraphicalModels
 	/// Types of the graphical model
 	enum class GraphType { 
 		pairwise,		///< Pairwise graph
-		dense			///< Dense (complete) graph
+		dense,			///< Dense (complete) graph
+		csr,			///< Pairwise graph with compressed sparse row (CSR) storage
+		grid			///< Pairwise graph with implicit regular grid structure
 	};
 	
 	class CGraph;
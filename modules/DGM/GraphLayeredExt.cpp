@@ -1,61 +1,107 @@
 #include "GraphLayeredExt.h"
 #include "GraphPairwise.h"
+#include "GraphGrid.h"
+#include "EdgePotentials.h"
 
 #include "TrainNode.h"
 #include "TrainEdge.h"
 #include "TrainEdgePotts.h"
 #include "TrainLink.h"
 #include "TrainEdgePottsCS.h"
+#include "parallel.h"
+#include "profiler.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
 {
+	// Constants
+	const int CGraphLayeredExt::MIN_WORKER_PIXELS = 16384;
+
 	void CGraphLayeredExt::buildGraph(Size graphSize)
 	{
-		if (m_graph.getNumNodes() != 0) m_graph.reset();
+		DGM_PROFILE_ZONE("buildGraph");
+		const Size prevSize = m_size;
 		m_size = graphSize;
 
-		word l;
-		for (int y = 0; y < m_size.height; y++)
-			for (int x = 0; x < m_size.width; x++) {
-				// Nodes
-				size_t idx = m_graph.addNode();
-				for (l = 1; l < m_nLayers; l++) m_graph.addNode();
-
-				// All links have group_id = 1
-				if (m_gType & GRAPH_EDGES_LINK) {
-					if (m_nLayers >= 2)
-						m_graph.addArc(idx, idx + 1, 1, Mat());
-					for (l = 2; l < m_nLayers; l++)
-						m_graph.addEdge(idx + l - 1, idx + l, 1, Mat());
-				} // if LINK
-
-				if (m_gType & GRAPH_EDGES_GRID) {
-					if (x > 0)
-						for (l = 0; l < m_nLayers; l++)
-							m_graph.addArc(idx + l, idx + l - m_nLayers);
-					if (y > 0)
-						for (l = 0; l < m_nLayers; l++)
-							m_graph.addArc(idx + l, idx + l - m_nLayers * m_size.width);
-				} // if GRID
-			} // x
+		// The grid graph has implicit structure and does not need to be built node by node
+		CGraphGrid *pGraphGrid = dynamic_cast<CGraphGrid *>(&m_graph);
+		if (pGraphGrid) {
+			pGraphGrid->build(m_size, m_nLayers, m_gType);
+			return;
+		}
 
+		// The numbers of edges, added for every pixel: links, and arcs to every preceding grid or diagonal neighbour
+		const byte		nStates		= m_graph.getNumStates();
+		const size_t	width		= MAX(0, m_size.width);
+		const size_t	height		= MAX(0, m_size.height);
+		const size_t	nLinkEdges	= (m_gType & GRAPH_EDGES_LINK) ? (m_nLayers >= 2 ? 2 : 0) + (m_nLayers > 2 ? m_nLayers - 2 : 0) : 0;
+		const size_t	nGridEdges	= (m_gType & GRAPH_EDGES_GRID) ? 2 * m_nLayers : 0;
+		const size_t	nDiagEdges	= (m_gType & GRAPH_EDGES_DIAG) ? 2 * m_nLayers : 0;
+		const size_t	nBaseEdges	= width * height * nLinkEdges + nGridEdges * ((width ? width - 1 : 0) * height + width * (height ? height - 1 : 0));
+		const size_t	nEdges		= nBaseEdges + (width && height ? nDiagEdges * 2 * (width - 1) * (height - 1) : 0);
+		const size_t	nNodes		= width * height * m_nLayers;
+
+		// The graph of the same shape is reused: only its potentials are reset
+		if (prevSize == m_size && m_graph.getNumNodes() == nNodes && m_graph.getNumEdges() == nEdges) {
+			m_graph.setNodes(0, Mat(static_cast<int>(nNodes), nStates, CV_32FC1, Scalar(1.0f / nStates)));
+			m_graph.setEdges(std::nullopt, CTrainEdge::getDefaultEdgePotentials(1.0f, nStates));
+			return;
+		}
 
-		if (m_gType & GRAPH_EDGES_DIAG) {
-			for (int y = 0; y < m_size.height; y++) {
+		// The edges are enumerated in the row-major order of the pixels, the diagonal edges following all the others; 
+		// the index of the first edge of every pixel is given in the closed form, thus the rows are filled in parallel
+		Mat			edges(static_cast<int>(nEdges), 2, CV_32SC1);
+		vec_byte_t	vGroups(nEdges, 0);
+		parallel::parallelFor(Range(0, m_size.height), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++)
 				for (int x = 0; x < m_size.width; x++) {
-					size_t idx = (y * m_size.width + x) * m_nLayers;
-
-					if ((x > 0) && (y > 0))
-						for (l = 0; l < m_nLayers; l++)
-							m_graph.addArc(idx + l, idx + l - m_nLayers * (m_size.width + 1));
+					const size_t idx = (y * width + x) * m_nLayers;
+					size_t e = (y * width + x) * nLinkEdges + nGridEdges * (y * (width - 1) + MAX(0, x - 1) + (y > 0 ? (y - 1) * width + x : 0));
+					auto addEdge = [&](size_t srcNode, size_t dstNode, byte group) {
+						int *pEdge = edges.ptr<int>(static_cast<int>(e));
+						pEdge[0] = static_cast<int>(srcNode);
+						pEdge[1] = static_cast<int>(dstNode);
+						vGroups[e++] = group;
+					};
+					auto addArc = [&](size_t node1, size_t node2) {
+						addEdge(node1, node2, 0);
+						addEdge(node2, node1, 0);
+					};
+
+					// All links have group_id = 1
+					if (m_gType & GRAPH_EDGES_LINK) {
+						if (m_nLayers >= 2) {
+							addEdge(idx, idx + 1, 1);
+							addEdge(idx + 1, idx, 1);
+						}
+						for (word l = 2; l < m_nLayers; l++)
+							addEdge(idx + l - 1, idx + l, 1);
+					} // if LINK
 
-					if ((x < graphSize.width - 1) && (y > 0))
-						for (l = 0; l < m_nLayers; l++)
-							m_graph.addArc(idx + l, idx + l - m_nLayers * (m_size.width - 1));
+					if (m_gType & GRAPH_EDGES_GRID) {
+						if (x > 0)
+							for (word l = 0; l < m_nLayers; l++)
+								addArc(idx + l, idx + l - m_nLayers);
+						if (y > 0)
+							for (word l = 0; l < m_nLayers; l++)
+								addArc(idx + l, idx + l - m_nLayers * width);
+					} // if GRID
+
+					if ((m_gType & GRAPH_EDGES_DIAG) && (y > 0)) {
+						e = nBaseEdges + nDiagEdges * ((y - 1) * 2 * (width - 1) + MAX(0, x - 1) + MIN(static_cast<size_t>(x), width - 1));
+						if (x > 0)
+							for (word l = 0; l < m_nLayers; l++)
+								addArc(idx + l, idx + l - m_nLayers * (width + 1));
+						if (x < m_size.width - 1)
+							for (word l = 0; l < m_nLayers; l++)
+								addArc(idx + l, idx + l - m_nLayers * (width - 1));
+					} // if DIAG
 				} // x
-			} // y
-		} // if DIAG
+		});
+
+		if (m_graph.getNumNodes() != 0) m_graph.reset();
+		m_graph.addNodes(Mat(static_cast<int>(nNodes), nStates, CV_32FC1, Scalar(1.0f / nStates)));
+		if (nEdges) m_graph.addEdges(edges, vGroups);
 	}
 
 	void CGraphLayeredExt::setGraph(const Mat& pots) 
@@ -92,6 +138,7 @@ namespace DirectGraphicalModels
 
 	void CGraphLayeredExt::setGraph(const Mat &potBase, const Mat &potOccl)
 	{
+		DGM_PROFILE_ZONE("setGraph");
 		// Assertions
         DGM_ASSERT(!potBase.empty());
 		DGM_ASSERT(CV_32F == potBase.depth());
@@ -104,44 +151,44 @@ namespace DirectGraphicalModels
         DGM_ASSERT(m_size.width == potBase.cols);
         DGM_ASSERT(m_size.width * m_size.height * m_nLayers == m_graph.getNumNodes());
 
-		byte nStatesBase = static_cast<byte>(potBase.channels());
-		byte nStatesOccl = potOccl.empty() ? 0 : static_cast<byte>(potOccl.channels());
+		const byte nStates	   = m_graph.getNumStates();
+		const byte nStatesBase = static_cast<byte>(potBase.channels());
+		const byte nStatesOccl = potOccl.empty() ? 0 : static_cast<byte>(potOccl.channels());
 		if (m_nLayers >= 2) DGM_ASSERT(nStatesOccl);
-		DGM_ASSERT(nStatesBase + nStatesOccl == m_graph.getNumStates());
-
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, m_size.height), [&, nStatesBase, nStatesOccl](const Range& range) {
-#else
-		const Range range(0, m_size.height);
-#endif
-		Mat nPotBase(m_graph.getNumStates(), 1, CV_32FC1, Scalar(0.0f));
-		Mat nPotOccl(m_graph.getNumStates(), 1, CV_32FC1, Scalar(0.0f));
-		Mat nPotIntr(m_graph.getNumStates(), 1, CV_32FC1, Scalar(0.0f));
-		for (byte s = 0; s < nStatesOccl; s++)
-			nPotIntr.at<float>(m_graph.getNumStates() - nStatesOccl + s, 0) = 100.0f / nStatesOccl;
-		for (int y = range.start; y < range.end; y++) {
-			const float* pPotBase = potBase.ptr<float>(y);
-			const float* pPotOccl = potOccl.empty() ? NULL : potOccl.ptr<float>(y);
-			for (int x = 0; x < m_size.width; x++) {
-				size_t idx = (y * m_size.width + x) * m_nLayers;
-
-				for (byte s = 0; s < nStatesBase; s++)
-					nPotBase.at<float>(s, 0) = pPotBase[nStatesBase * x + s];
-				m_graph.setNode(idx, nPotBase);
-
-				if (m_nLayers >= 2) {
-					for (byte s = 0; s < nStatesOccl; s++)
-						nPotOccl.at<float>(m_graph.getNumStates() - nStatesOccl + s, 0) = pPotOccl[nStatesOccl * x + s];
-					m_graph.setNode(idx + 1, nPotOccl);
-				}
+		DGM_ASSERT(nStatesBase + nStatesOccl == nStates);
+
+		// One layer with all the states: the rows of the image are already the node potentials
+		if (m_nLayers == 1 && nStatesBase == nStates) {
+			if (potBase.isContinuous()) m_graph.setNodes(0, potBase.reshape(1, m_size.area()));
+			else
+				for (int y = 0; y < m_size.height; y++)
+					m_graph.setNodes(static_cast<size_t>(y) * m_size.width, potBase.row(y).reshape(1, m_size.width));
+			return;
+		}
 
-				for (word l = 2; l < m_nLayers; l++)
-					m_graph.setNode(idx + l, nPotIntr);
-			} // x
-		} // y
-#ifdef ENABLE_PDP	
+		// The potentials of all the nodes are gathered in one parallel pass into the buffer, which is allocated once per graph size:
+		// the zeros and the potentials of the intermediate layers are written only on allocation, since they are the same for all the images
+		const int nNodes = m_size.area() * m_nLayers;
+		if (m_nodePots.rows != nNodes || m_nodePots.cols != nStates) {
+			m_nodePots = Mat(nNodes, nStates, CV_32FC1, Scalar(0.0f));
+			for (int n = 0; n < nNodes; n++) {
+				if (n % m_nLayers < 2) continue;
+				float *pPot = m_nodePots.ptr<float>(n);
+				for (byte s = 0; s < nStatesOccl; s++) pPot[nStates - nStatesOccl + s] = 100.0f / nStatesOccl;
+			}
+		}
+		parallel::parallelFor(Range(0, m_size.height), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				const float* pPotBase = potBase.ptr<float>(y);
+				const float* pPotOccl = potOccl.empty() ? NULL : potOccl.ptr<float>(y);
+				for (int x = 0; x < m_size.width; x++) {
+					float *pPot = m_nodePots.ptr<float>((y * m_size.width + x) * m_nLayers);
+					memcpy(pPot, pPotBase + nStatesBase * x, nStatesBase * sizeof(float));
+					if (m_nLayers >= 2) memcpy(pPot + nStates + nStates - nStatesOccl, pPotOccl + nStatesOccl * x, nStatesOccl * sizeof(float));
+				} // x
+			} // y
 		});
-#endif
+		m_graph.setNodes(0, m_nodePots);
 	}
 
 	void CGraphLayeredExt::addFeatureVecs(CTrainEdge &edgeTrainer, const Mat &featureVectors, const Mat &gt)
@@ -153,44 +200,32 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(featureVectors.channels() == edgeTrainer.getNumFeatures(),
 			"Number of features in the <featureVectors> (%d) does not correspond to the specified (%d)", featureVectors.channels(), edgeTrainer.getNumFeatures());
 
-		const word		nFeatures = featureVectors.channels();
-
-		Mat featureVector1(nFeatures, 1, CV_8UC1);
-		Mat featureVector2(nFeatures, 1, CV_8UC1);
-
-		for (int y = 0; y < gt.rows; y++) {
-			const byte *pFV1 = featureVectors.ptr<byte>(y);
-			const byte *pFV2 = y > 0 ? featureVectors.ptr<byte>(y - 1) : NULL;
-			const byte *pGt1 = gt.ptr<byte>(y);
-			const byte *pGt2 = y > 0 ? gt.ptr<byte>(y - 1) : NULL;
-			for (int x = 0; x < gt.cols; x++) {
-				for (word f = 0; f < nFeatures; f++) featureVector1.at<byte>(f, 0) = pFV1[nFeatures * x + f];					// featureVector[x][y]
-				if (m_gType & GRAPH_EDGES_GRID) {
-					if (x > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFV1[nFeatures * (x - 1) + f];		// featureVector[x-1][y]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt1[x - 1]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt1[x - 1], featureVector1, pGt1[x]);
-					}
-					if (y > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFV2[nFeatures * x + f];			// featureVector[x][y-1]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt2[x]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt2[x], featureVector1, pGt1[x]);
-					}
-				}
-				if (m_gType & GRAPH_EDGES_DIAG) {
-					if ((x > 0) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFV2[nFeatures * (x - 1) + f];		// featureVector[x-1][y-1]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt2[x - 1]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt2[x - 1], featureVector1, pGt1[x]);
-					}
-					if ((x < gt.cols - 1) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFV2[nFeatures * (x + 1) + f];		// featureVector[x+1][y-1]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt2[x + 1]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt2[x + 1], featureVector1, pGt1[x]);
-					}
+#ifdef ENABLE_PDP
+		// The stripes of a fixed size are processed in waves of as many stripes as there are threads: every worker accumulates one stripe and is merged after
+		// its wave, thus the edges reach the edge trainer in the same order for any number of threads
+		const int nStripes = MIN(gt.size().area() / MIN_WORKER_PIXELS, gt.rows);
+		std::shared_ptr<CTrainEdge> pWorker = nStripes >= 2 ? edgeTrainer.createWorker() : nullptr;
+		if (pWorker) {
+			const int nWave = static_cast<int>(CThreadPool::getDefault().getNumThreads());
+			for (int first = 0; first < nStripes; first += nWave) {
+				const int last = MIN(first + nWave, nStripes);
+				std::vector<std::shared_ptr<CTrainEdge>> vpWorkers(last - first);
+				for (int w = MAX(1, first); w < last; w++) {
+					vpWorkers[w - first] = pWorker ? pWorker : edgeTrainer.createWorker();
+					pWorker.reset();
 				}
-			} // x
-		} // y
+				parallel::parallelFor(Range(first, last), [&, nStripes](const Range &range) {
+					for (int w = range.start; w < range.end; w++) {
+						const Range rows(gt.rows * w / nStripes, gt.rows * (w + 1) / nStripes);
+						addFeatureVecs(w ? *vpWorkers[w - first] : edgeTrainer, featureVectors, gt, rows);
+					} // w
+				}, 1);
+				for (auto &pStripeWorker : vpWorkers) if (pStripeWorker) edgeTrainer.merge(*pStripeWorker);
+			} // first
+			return;
+		}
+#endif
+		addFeatureVecs(edgeTrainer, featureVectors, gt, Range(0, gt.rows));
 	}
 
 	void CGraphLayeredExt::addFeatureVecs(CTrainEdge &edgeTrainer, const vec_mat_t &featureVectors, const Mat &gt)
@@ -202,198 +237,105 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(featureVectors.size() == edgeTrainer.getNumFeatures(),
 			"Number of features in the <featureVectors> (%zu) does not correspond to the specified (%d)", featureVectors.size(), edgeTrainer.getNumFeatures());
 
-		const word		nFeatures = static_cast<word>(featureVectors.size());
-
-		Mat featureVector1(nFeatures, 1, CV_8UC1);
-		Mat featureVector2(nFeatures, 1, CV_8UC1);
-
-		std::vector<const byte *> vFV1(nFeatures);
-		std::vector<const byte *> vFV2(nFeatures);
-		for (int y = 0; y < gt.rows; y++) {
-			for (word f = 0; f < nFeatures; f++) {
-				vFV1[f] = featureVectors[f].ptr<byte>(y);
-				if (y > 0) vFV2[f] = featureVectors[f].ptr<byte>(y - 1);
-			}
-			const byte *pGt1 = gt.ptr<byte>(y);
-			const byte *pGt2 = y > 0 ? gt.ptr<byte>(y - 1) : NULL;
-			for (int x = 0; x < gt.cols; x++) {
-				for (word f = 0; f < nFeatures; f++) featureVector1.at<byte>(f, 0) = vFV1[f][x];					// featureVector[x][y]
-				if (m_gType & GRAPH_EDGES_GRID) {
-					if (x > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = vFV1[f][x - 1];		// featureVector[x-1][y]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt1[x - 1]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt1[x - 1], featureVector1, pGt1[x]);
-					}
-					if (y > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = vFV2[f][x];			// featureVector[x][y-1]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt2[x]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt2[x], featureVector1, pGt1[x]);
-					}
-				}
-				if (m_gType & GRAPH_EDGES_DIAG) {
-					if ((x > 0) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = vFV2[f][x - 1];		// featureVector[x-1][y-1]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt2[x - 1]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt2[x - 1], featureVector1, pGt1[x]);
-					}
-					if ((x < gt.cols - 1) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = vFV2[f][x + 1];		// featureVector[x+1][y-1]
-						edgeTrainer.addFeatureVecs(featureVector1, pGt1[x], featureVector2, pGt2[x + 1]);
-						edgeTrainer.addFeatureVecs(featureVector2, pGt2[x + 1], featureVector1, pGt1[x]);
-					}
-				}
-			} // x
-		} // y
+		// The stripes of the multi-channel image are contiguous
+		Mat fv;
+		merge(featureVectors, fv);
+		addFeatureVecs(edgeTrainer, fv, gt);
 	}
 
 	void CGraphLayeredExt::fillEdges(const CTrainEdge& edgeTrainer, const CTrainLink* linkTrainer, const Mat& featureVectors, const vec_float_t& vParams, float edgeWeight, float linkWeight)
 	{
+		DGM_PROFILE_ZONE("fillEdges");
 		const word	nFeatures	= featureVectors.channels();
+		const byte	nStates		= m_graph.getNumStates();
 
 		// Assertions
 		DGM_ASSERT(m_size.height == featureVectors.rows);
 		DGM_ASSERT(m_size.width == featureVectors.cols);
+		DGM_ASSERT(featureVectors.depth() == CV_8U);
 		DGM_ASSERT(nFeatures == edgeTrainer.getNumFeatures());
 		if (linkTrainer) DGM_ASSERT(nFeatures == linkTrainer->getNumFeatures());
 		DGM_ASSERT(m_size.width * m_size.height * m_nLayers == m_graph.getNumNodes());
 
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, m_size.height), [&, nFeatures](const Range& range) {
+		// The link potentials of all the pixels are calculated at once: Mat(size: width * height x nStates * nStates)
+		Mat linkPots;
+		const Mat linkPotDefault = CTrainEdge::getDefaultEdgePotentials(100, nStates);
+		if (m_gType & GRAPH_EDGES_LINK) {
+			DGM_ASSERT_MSG(linkTrainer, "The link trainer is required for the graph with links");
+			const Mat fv = featureVectors.isContinuous() ? featureVectors : featureVectors.clone();
+			linkTrainer->getLinkPotentials(fv.reshape(1, m_size.width * m_size.height), linkPots, linkWeight);
+			DGM_ASSERT(linkPots.cols == nStates * nStates);
+		}
 
-#else 
-		const Range range(0, m_size.height);
-#endif
-		Mat featureVector1(nFeatures, 1, CV_8UC1);
-		Mat featureVector2(nFeatures, 1, CV_8UC1);
-		Mat ePot;
-		word l;
-		for (int y = range.start; y < range.end; y++) {
-			const byte* pFv1 = featureVectors.ptr<byte>(y);
-			const byte* pFv2 = (y > 0) ? featureVectors.ptr<byte>(y - 1) : NULL;
-			for (int x = 0; x < m_size.width; x++) {
-				size_t idx = (y * m_size.width + x) * m_nLayers;
-				for (word f = 0; f < nFeatures; f++) featureVector1.at<byte>(f, 0) = pFv1[nFeatures * x + f];				// featureVectors[x][y]
-
-				if (m_gType & GRAPH_EDGES_LINK) {
-					ePot = linkTrainer->getLinkPotentials(featureVector1, linkWeight);
-					add(ePot, ePot.t(), ePot);
-					if (m_nLayers >= 2)
-						m_graph.setArc(idx, idx + 1, ePot);
-					ePot = CTrainEdge::getDefaultEdgePotentials(100, m_graph.getNumStates());
-					for (l = 2; l < m_nLayers; l++)
-						m_graph.setEdge(idx + l - 1, idx + l, ePot);
-				} // edges_link
+		parallel::parallelFor(Range(0, m_size.height), [&, nStates](const Range& range) {
+			const int width = m_size.width;
+			Mat ePot, potT;
+			Mat vPots[4];																									// one buffer per direction: the block sizes differ, thus are not re-allocated
+			word l;
+			for (int y = range.start; y < range.end; y++) {
+				// Sets the arcs (idx + x0 + i) -- (idx + x0 + i - shift) for all the rows i of the blocks fv1 and fv2
+				auto setArcs = [&](const Mat &fv1, const Mat &fv2, int x0, size_t shift, Mat &pots) {
+					if (fv1.rows == 0) return;
+					edgeTrainer.getEdgePotentials(fv1, fv2, vParams, pots, edgeWeight);
+					sqrt(pots, pots);																						// as in IGraphPairwise::setArc()
+					for (int i = 0; i < pots.rows; i++) {
+						const float	*pPot = pots.ptr<float>(i);
+						const size_t idx  = (static_cast<size_t>(y) * width + x0 + i) * m_nLayers;
+						if (isPotts(pPot, nStates)) {																			// the symmetric Potts potential needs only two values
+							for (word l = 0; l < m_nLayers; l++) {
+								m_graph.setEdgePotts(idx + l, idx + l - shift, pPot[0], pPot[1]);
+								m_graph.setEdgePotts(idx + l - shift, idx + l, pPot[0], pPot[1]);
+							}
+							continue;
+						}
+						const Mat pot(nStates, nStates, CV_32FC1, const_cast<float *>(pPot));
+						transpose(pot, potT);
+						for (word l = 0; l < m_nLayers; l++) {
+							m_graph.setEdge(idx + l, idx + l - shift, pot);
+							m_graph.setEdge(idx + l - shift, idx + l, potT);
+						}
+					} // i
+				};
+
+				const Mat row1 = featureVectors.row(y).reshape(1, width);													// featureVectors[0..width)[y]: Mat(size: width x nFeatures)
+				const Mat row2 = (y > 0) ? featureVectors.row(y - 1).reshape(1, width) : Mat();								// featureVectors[0..width)[y-1]
+
+				if (m_gType & GRAPH_EDGES_LINK) 
+					for (int x = 0; x < width; x++) {
+						size_t idx = (y * width + x) * m_nLayers;
+						const Mat linkPot(nStates, nStates, CV_32FC1, linkPots.ptr<float>(y * width + x));					// featureVectors[x][y]
+						add(linkPot, linkPot.t(), ePot);
+						if (m_nLayers >= 2)
+							m_graph.setArc(idx, idx + 1, ePot);
+						for (l = 2; l < m_nLayers; l++)
+							m_graph.setEdge(idx + l - 1, idx + l, linkPotDefault);
+					} // x
 
 				if (m_gType & GRAPH_EDGES_GRID) {
-					if (x > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv1[nFeatures * (x - 1) + f];	// featureVectors[x-1][y]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers, ePot);
-					} // if x
-
-					if (y > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv2[nFeatures * x + f];		// featureVectors[x][y-1]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers * m_size.width, ePot);
-					} // if y
+					setArcs(row1.rowRange(1, width), row1.rowRange(0, width - 1), 1, m_nLayers, vPots[0]);					// featureVectors[x][y] -- featureVectors[x-1][y]
+					if (y > 0) setArcs(row1, row2, 0, m_nLayers * width, vPots[1]);											// featureVectors[x][y] -- featureVectors[x][y-1]
 				} // edges_grid
 
-				if (m_gType & GRAPH_EDGES_DIAG) {
-					if ((x > 0) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv2[nFeatures * (x - 1) + f];	// featureVectors[x-1][y-1]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers * m_size.width - m_nLayers, ePot);
-					} // if x, y
-
-					if ((x < m_size.width - 1) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv2[nFeatures * (x + 1) + f];	// featureVectors[x+1][y-1]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers * m_size.width + m_nLayers, ePot);
-					} // x, y
+				if ((m_gType & GRAPH_EDGES_DIAG) && (y > 0)) {
+					setArcs(row1.rowRange(1, width), row2.rowRange(0, width - 1), 1, m_nLayers * width + m_nLayers, vPots[2]);	// featureVectors[x][y] -- featureVectors[x-1][y-1]
+					setArcs(row1.rowRange(0, width - 1), row2.rowRange(1, width), 0, m_nLayers * width - m_nLayers, vPots[3]);	// featureVectors[x][y] -- featureVectors[x+1][y-1]
 				} // edges_diag
-			} // x
-		} // y
-#ifdef ENABLE_PDP
+			} // y
 		});
-#endif
 	}
 
 	void CGraphLayeredExt::fillEdges(const CTrainEdge& edgeTrainer, const CTrainLink* linkTrainer, const vec_mat_t& featureVectors, const vec_float_t& vParams, float edgeWeight, float linkWeight)
 	{
-		const word	nFeatures	=static_cast<word>(featureVectors.size());
-
+		DGM_PROFILE_ZONE("fillEdges");
 		// Assertions
+		DGM_ASSERT(featureVectors.size() == edgeTrainer.getNumFeatures());
 		DGM_ASSERT(m_size.height == featureVectors[0].rows);
 		DGM_ASSERT(m_size.width == featureVectors[0].cols);
-		DGM_ASSERT(nFeatures == edgeTrainer.getNumFeatures());
-		if (linkTrainer) DGM_ASSERT(nFeatures == linkTrainer->getNumFeatures());
-		DGM_ASSERT(m_size.width * m_size.height * m_nLayers == m_graph.getNumNodes());
-
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, m_size.height), [&, nFeatures](const Range& range) {
-#else 
-		const Range range(0, m_size.height);
-#endif
-		Mat featureVector1(nFeatures, 1, CV_8UC1);
-		Mat featureVector2(nFeatures, 1, CV_8UC1);
-		Mat ePot;
-		word l;
-		for (int y = range.start; y < range.end; y++) {
-			byte const** pFv1 = new const byte * [nFeatures];
-			for (word f = 0; f < nFeatures; f++) pFv1[f] = featureVectors[f].ptr<byte>(y);
-			byte const** pFv2 = NULL;
-			if (y > 0) {
-				pFv2 = new const byte * [nFeatures];
-				for (word f = 0; f < nFeatures; f++) pFv2[f] = featureVectors[f].ptr<byte>(y - 1);
-			}
 
-			for (int x = 0; x < m_size.width; x++) {
-				size_t idx = (y * m_size.width + x) * m_nLayers;
-
-				for (word f = 0; f < nFeatures; f++) featureVector1.at<byte>(f, 0) = pFv1[f][x];				// featureVectors[x][y]
-
-				if (m_gType & GRAPH_EDGES_LINK) {
-					ePot = linkTrainer->getLinkPotentials(featureVector1, linkWeight);
-					add(ePot, ePot.t(), ePot);
-					if (m_nLayers >= 2)
-						m_graph.setArc(idx, idx + 1, ePot);
-					ePot = CTrainEdge::getDefaultEdgePotentials(100, m_graph.getNumStates());
-					for (l = 2; l < m_nLayers; l++)
-						m_graph.setEdge(idx + l - 1, idx + l, ePot);
-				} // edges_link
-
-				if (m_gType & GRAPH_EDGES_GRID) {
-					if (x > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv1[f][x - 1];				// featureVectors[x-1][y]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers, ePot);
-					} // if x
-
-					if (y > 0) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv2[f][x];					// featureVectors[x][y-1]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers * m_size.width, ePot);
-					} // if y
-				} // edges_grid
-
-				if (m_gType & GRAPH_EDGES_DIAG) {
-					if ((x > 0) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv2[f][x - 1];				// featureVectors[x-1][y-1]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers * m_size.width - m_nLayers, ePot);
-					} // if x, y
-
-					if ((x < m_size.width - 1) && (y > 0)) {
-						for (word f = 0; f < nFeatures; f++) featureVector2.at<byte>(f, 0) = pFv2[f][x + 1];				// featureVectors[x+1][y-1]
-						ePot = edgeTrainer.getEdgePotentials(featureVector1, featureVector2, vParams, edgeWeight);
-						for (word l = 0; l < m_nLayers; l++) m_graph.setArc(idx + l, idx + l - m_nLayers * m_size.width + m_nLayers, ePot);
-					} // x, y
-				} // edges_diag
-			} // x
-		} // y
-#ifdef ENABLE_PDP
-		}); 
-#endif
+		// The edge potentials are calculated for whole rows of pixels, which are contiguous in the multi-channel image
+		Mat fv;
+		merge(featureVectors, fv);
+		fillEdges(edgeTrainer, linkTrainer, fv, vParams, edgeWeight, linkWeight);
 	}
 
 	void CGraphLayeredExt::defineEdgeGroup(float A, float B, float C, byte group)
@@ -401,50 +343,44 @@ namespace DirectGraphicalModels
 		// Assertion
 		DGM_ASSERT_MSG(A != 0 || B != 0, "Wrong arguments");
 
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, m_size.height), [&](const Range& range) {
-#else
-		const Range range(0, m_size.height);
-#endif
-		for (int y = range.start; y < range.end; y++) {
-			for (int x = 0; x < m_size.width; x++) {
-				int i = (y * m_size.width + x) * m_nLayers;							// index of the current node from the base layer	
-				int s = SIGN(A * x + B * y + C);									// sign of the current pixel according to the given line
+		parallel::parallelFor(Range(0, m_size.height), [&](const Range& range) {
+			for (int y = range.start; y < range.end; y++) {
+				for (int x = 0; x < m_size.width; x++) {
+					int i = (y * m_size.width + x) * m_nLayers;							// index of the current node from the base layer	
+					int s = SIGN(A * x + B * y + C);									// sign of the current pixel according to the given line
 
-				if (m_gType & GRAPH_EDGES_GRID) {
-					if (x > 0) {
-						int _x = x - 1;
-						int _y = y;
-						int _s = SIGN(A * _x + B * _y + C);
-						if (s != _s) m_graph.setArcGroup(i, i - m_nLayers, group);
-					} // if x
-					if (y > 0) {
-						int _x = x;
-						int _y = y - 1;
-						int _s = SIGN(A * _x + B * _y + C);
-						if (s != _s) m_graph.setArcGroup(i, i - m_nLayers * m_size.width, group);
-					} // if y
-				}
+					if (m_gType & GRAPH_EDGES_GRID) {
+						if (x > 0) {
+							int _x = x - 1;
+							int _y = y;
+							int _s = SIGN(A * _x + B * _y + C);
+							if (s != _s) m_graph.setArcGroup(i, i - m_nLayers, group);
+						} // if x
+						if (y > 0) {
+							int _x = x;
+							int _y = y - 1;
+							int _s = SIGN(A * _x + B * _y + C);
+							if (s != _s) m_graph.setArcGroup(i, i - m_nLayers * m_size.width, group);
+						} // if y
+					}
 
-				if (m_gType & GRAPH_EDGES_DIAG) {
-					if ((x > 0) && (y > 0)) {
-						int _x = x - 1;
-						int _y = y - 1;
-						int _s = SIGN(A * _x + B * _y + C);
-						if (s != _s) m_graph.setArcGroup(i, i - m_nLayers * m_size.width - m_nLayers, group);
-					} // if x, y
-					if ((x < m_size.width - 1) && (y > 0)) {
-						int _x = x + 1;
-						int _y = y - 1;
-						int _s = SIGN(A * _x + B * _y + C);
-						if (s != _s) m_graph.setArcGroup(i, i - m_nLayers * m_size.width + m_nLayers, group);
-					} // x, y
-				}
-			} // x
-		} // y
-#ifdef ENABLE_PDP
+					if (m_gType & GRAPH_EDGES_DIAG) {
+						if ((x > 0) && (y > 0)) {
+							int _x = x - 1;
+							int _y = y - 1;
+							int _s = SIGN(A * _x + B * _y + C);
+							if (s != _s) m_graph.setArcGroup(i, i - m_nLayers * m_size.width - m_nLayers, group);
+						} // if x, y
+						if ((x < m_size.width - 1) && (y > 0)) {
+							int _x = x + 1;
+							int _y = y - 1;
+							int _s = SIGN(A * _x + B * _y + C);
+							if (s != _s) m_graph.setArcGroup(i, i - m_nLayers * m_size.width + m_nLayers, group);
+						} // x, y
+					}
+				} // x
+			} // y
 		});
-#endif
 	}
 
 	void CGraphLayeredExt::setEdges(std::optional<byte> group, const Mat &pot)
@@ -482,4 +418,52 @@ namespace DirectGraphicalModels
 			m_graph.setEdges(group, Pot);
 		}
 	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The edges of one row are gathered into one block in the order of the pixels, as if they were added one by one: for every pixel the edges to
+	// its left, upper, upper-left and upper-right neighbours, each in both directions. Thus the order-dependent edge trainers get the same sequence of samples
+	void CGraphLayeredExt::addFeatureVecs(CTrainEdge &edgeTrainer, const Mat &featureVectors, const Mat &gt, const Range &rows)
+	{
+		const int	width		= gt.cols;
+		const int	nFeatures	= featureVectors.channels();
+		const int	nMaxEdges	= 8 * width;																				// 4 neighbours in 2 directions
+		Mat fv1(nMaxEdges, nFeatures, CV_8UC1);
+		Mat fv2(nMaxEdges, nFeatures, CV_8UC1);
+		Mat gt1(nMaxEdges, 1, CV_8UC1);
+		Mat gt2(nMaxEdges, 1, CV_8UC1);
+
+		for (int y = rows.start; y < rows.end; y++) {
+			int nEdges = 0;
+			// Adds the edge (x1, y1) -- (x2, y2) in both directions
+			auto addEdge = [&](int x1, int y1, int x2, int y2) {
+				const byte *pFV1 = featureVectors.ptr<byte>(y1) + x1 * nFeatures;
+				const byte *pFV2 = featureVectors.ptr<byte>(y2) + x2 * nFeatures;
+				const byte	 s1	 = gt.at<byte>(y1, x1);
+				const byte	 s2	 = gt.at<byte>(y2, x2);
+				memcpy(fv1.ptr<byte>(nEdges), pFV1, nFeatures);
+				memcpy(fv2.ptr<byte>(nEdges), pFV2, nFeatures);
+				gt1.at<byte>(nEdges, 0) = s1;
+				gt2.at<byte>(nEdges, 0) = s2;
+				nEdges++;
+				memcpy(fv1.ptr<byte>(nEdges), pFV2, nFeatures);
+				memcpy(fv2.ptr<byte>(nEdges), pFV1, nFeatures);
+				gt1.at<byte>(nEdges, 0) = s2;
+				gt2.at<byte>(nEdges, 0) = s1;
+				nEdges++;
+			};
+
+			for (int x = 0; x < width; x++) {
+				if (m_gType & GRAPH_EDGES_GRID) {
+					if (x > 0)							addEdge(x, y, x - 1, y);										// featureVector[x][y] -- featureVector[x-1][y]
+					if (y > 0)							addEdge(x, y, x, y - 1);										// featureVector[x][y] -- featureVector[x][y-1]
+				}
+				if (m_gType & GRAPH_EDGES_DIAG) {
+					if (x > 0 && y > 0)					addEdge(x, y, x - 1, y - 1);									// featureVector[x][y] -- featureVector[x-1][y-1]
+					if (x < width - 1 && y > 0)			addEdge(x, y, x + 1, y - 1);									// featureVector[x][y] -- featureVector[x+1][y-1]
+				}
+			} // x
+			if (nEdges) edgeTrainer.addFeatureVecBlock(fv1.rowRange(0, nEdges), gt1.rowRange(0, nEdges), fv2.rowRange(0, nEdges), gt2.rowRange(0, nEdges));
+		} // y
+	}
+
 }
@@ -46,7 +46,10 @@ namespace DirectGraphicalModels
         /**
         * @brief Builds a 2D graph of size corresponding to the image resolution
 		* @details All edges in graph will have group id 0 except the edges connecting different layers (links), which will have group id 1.
-		* When called multiple times, previouse graph structure is always replaced.
+		* When called multiple times, previouse graph structure is always replaced. If the graph has already the same size, number of nodes and number of edges,
+		* its structure is reused, and only the potentials are reset: the node potentials to \f$1 / nStates\f$ and the edge potentials to 1.
+		* The node and edge indices follow from the size, the number of layers and the graph type in closed form, thus the edges are generated in parallel
+		* and added at once with IGraphPairwise::addEdges().
         * @param graphSize The size of the graph (image resolution)
         */
 		DllExport void buildGraph(Size graphSize) override;
@@ -80,6 +83,9 @@ namespace DirectGraphicalModels
         * @code
         * buildGraph(potBase.size())
         * @endcode
+		* The potentials of all the layers are gathered in one parallel pass into a buffer, which is kept while the size of the graph does not change, and set at once
+		* with CGraph::setNodes(), which copies them directly into the graphs with flat potential storage (@ref CGraphPairwiseCSR, @ref CGraphGrid), and in place
+		* into the node potentials of @ref CGraphPairwise. Thus, for the images of the same size, neither the graph nor the potentials are re-allocated.
 		* > This function supports PPL
 		* @param potBase A block of potentials for the base layer: Mat(type: CV_32FC(nStatesBase))
 		* @param potOccl A block of potentials for the occlusion layer: Mat(type: CV_32FC(nStatesOccl))
@@ -89,7 +95,9 @@ namespace DirectGraphicalModels
 		* @brief Adds a block of new feature vectors
 		* @details This function may be used only for basic graphical models, built with the CGraphExt::build() method. It extracts
 		* pairs of feature vectors with corresponding ground-truth values from blocks \b featureVectors and \b gt, according to the graph structure,
-		* provided during the class construction via \b gType argument
+		* provided during the class construction via \b gType argument. If the edge trainer supports workers (Ref. CTrainEdge::createWorker()), 
+		* large blocks are split into horizontal stripes, which are accumulated in parallel and merged together in the order of the stripes. The edges
+		* reach the edge trainer pixel by pixel in the row-major order, thus the order-dependent edge trainers are trained on the same sequence of samples for any number of threads.
 		* @param edgeTrainer A pointer to the edge trainer
 		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC<nFeatures>)
 		* @param gt Matrix, each element of which is a ground-truth state (class)
@@ -108,7 +116,10 @@ namespace DirectGraphicalModels
 		/**
 		* @brief Fills the graph edges with potentials
 		* @details This function uses \b edgeTrainer class in oerder to achieve edge potentials from feature vectors, stored in \b featureVectors
-		* and fills with them the graph edges
+		* and fills with them the graph edges. The potentials of all the edges of one direction in one image row are calculated at once with
+		* CTrainEdge::getEdgePotentials(const Mat &, const Mat &, const vec_float_t &, Mat &, float) const. The edges with the Potts potentials, 
+		* \a e.g. from @ref CTrainEdgePottsCS with one smoothness parameter, are set with IGraphPairwise::setEdgePotts(). The link potentials of all the pixels
+		* are calculated in one batch with CTrainLink::getLinkPotentials(const Mat &, Mat &, float) const before the edges are filled.
 		* > This function supports PPL
 		* @param edgeTrainer A pointer to the edge trainer
 		* @param linkTrainer A pointer to tht link (inter-layer edge) trainer
@@ -158,10 +169,24 @@ namespace DirectGraphicalModels
 		IGraphPairwise& getGraph(void) const { return m_graph; }
 
 
+	private:
+		static const int MIN_WORKER_PIXELS;
+
+		/**
+		* @brief Adds the pairs of feature vectors of the edges, which start in the given rows
+		* @param edgeTrainer The edge trainer
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC<nFeatures>)
+		* @param gt Matrix, each element of which is a ground-truth state (class)
+		* @param rows The range of rows of \b featureVectors and \b gt; the edges to the row above the range are included
+		*/
+		void addFeatureVecs(CTrainEdge &edgeTrainer, const Mat &featureVectors, const Mat &gt, const Range &rows);
+
+
 	private:
 		IGraphPairwise&	m_graph;		///< The graph
 		const word		m_nLayers;		///< Number of layers
 		const byte		m_gType;		///< Graph type (Ref. @ref graphEdgesType)
 		Size			m_size;			///< Size of the graph
+		Mat				m_nodePots;		///< The buffer for the potentials of all the nodes of the multi-layer graphs: Mat(size: nNodes x nStates; type: CV_32FC1)
 	};
 }
@@ -1,4 +1,7 @@
 #include "GraphPairwise.h"
+#include "footprint.h"
+#include "parallel.h"
+#include <unordered_set>
 #include "macroses.h"
 
 namespace DirectGraphicalModels
@@ -7,9 +10,18 @@ namespace DirectGraphicalModels
 	{
 		m_vNodes.clear();
 		m_vEdges.clear();
+		m_edgeIndex.clear();
+		m_nRemovedEdges = 0;
 		m_IDx = 0;
 	}
 
+	std::unique_ptr<CGraph> CGraphPairwise::clone(void) const
+	{
+		auto res = std::make_unique<CGraphPairwise>(getNumStates());
+		copyTo(*res);
+		return res;
+	}
+
 	// Add a new node to the graph with specified potentional
 	size_t CGraphPairwise::addNode(const Mat &pot)
 	{
@@ -17,14 +29,46 @@ namespace DirectGraphicalModels
 		return m_IDx++;
 	}
 
+	// Add the new nodes: the potentials are copied once and shared by the nodes
+	void CGraphPairwise::addNodes(const Mat &pots)
+	{
+		DGM_ASSERT_MSG(pots.cols == getNumStates(), "The number of columns (%d) does not match the number of states (%d)", pots.cols, getNumStates());
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1, "The potentials must be of type CV_32FC1");
+
+		const Mat block = pots.clone();
+		m_vNodes.reserve(m_vNodes.size() + block.rows);
+		for (int n = 0; n < block.rows; n++) {
+			m_vNodes.push_back(ptr_node_t(new Node(m_IDx++)));
+			m_vNodes.back()->Pot = block.row(n).reshape(1, getNumStates());
+		}
+	}
+
 	// Set or change the potential of node idx
 	void CGraphPairwise::setNode(size_t node, const Mat &pot)
 	{
 		DGM_ASSERT_MSG(node < m_vNodes.size(), "Node %zu is out of range %zu", node, m_vNodes.size());
 		DGM_ASSERT_MSG((pot.cols == 1) && (pot.rows == getNumStates()), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, 1, getNumStates());
 
-		if (!m_vNodes[node]->Pot.empty()) m_vNodes[node]->Pot.release();
-		pot.copyTo(m_vNodes[node]->Pot);
+		pot.copyTo(m_vNodes[node]->Pot);						// in place, if the potential is already set
+		markDirty(node, node + 1);
+	}
+
+	// The potentials are copied in place, if they are already set, thus the nodes of the built graph are filled without allocations
+	void CGraphPairwise::setNodes(size_t start_node, const Mat &pots)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(start_node + pots.rows <= m_vNodes.size(), "The given ranges exceed the number of nodes(%zu)", m_vNodes.size());
+		DGM_ASSERT_MSG(pots.cols == nStates, "Potential size (%d) does not match (%d)", pots.cols, nStates);
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1, "Potentials type is not CV_32FC1");
+
+		parallel::parallelFor(Range(0, pots.rows), [&](const Range &range) {
+			for (int n = range.start; n < range.end; n++) {
+				Mat &pot = m_vNodes[start_node + n]->Pot;
+				if (pot.rows != nStates || pot.cols != 1 || pot.type() != CV_32FC1 || !pot.isContinuous()) pot.create(nStates, 1, CV_32FC1);
+				memcpy(pot.data, pots.ptr<float>(n), nStates * sizeof(float));
+			}
+		});
+		markDirty(start_node, start_node + pots.rows);
 	}
 
 	// Return node potential vector 
@@ -35,6 +79,22 @@ namespace DirectGraphicalModels
 		m_vNodes[node]->Pot.copyTo(pot);
 	}
 
+	span<const float> CGraphPairwise::getNodeView(size_t node) const
+	{
+		DGM_ASSERT_MSG(node < m_vNodes.size(), "Node %zu is out of range %zu", node, m_vNodes.size());
+		const Mat &pot = m_vNodes[node]->Pot;
+		DGM_ASSERT_MSG(!pot.empty(), "Specified node %zu is not set", node);
+		DGM_ASSERT_MSG(pot.isContinuous(), "The potential of node %zu is not continuous", node);
+		return { pot.ptr<float>(), getNumStates() };
+	}
+
+	span<float> CGraphPairwise::getMutableNodeView(size_t node)
+	{
+		const span<const float> view = getNodeView(node);
+		markDirty(node, node + 1);
+		return { const_cast<float *>(view.data()), view.size() };
+	}
+
 	// Return child nodes ID's
 	void CGraphPairwise::getChildNodes(size_t node, vec_size_t &vNodes) const
 	{
@@ -59,16 +119,65 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
 		// Check if the edge exists
-		if (m_vNodes[srcNode]->to.size() < m_vNodes[dstNode]->from.size())
-			for (size_t &e : m_vNodes[srcNode]->to) { DGM_ASSERT(m_vEdges[e]->node2 != dstNode); }
-		else
-			for (size_t &e : m_vNodes[dstNode]->from) { DGM_ASSERT(m_vEdges[e]->node1 != srcNode); }
+		DGM_ASSERT_MSG(findEdge(srcNode, dstNode) == m_vEdges.size(), "The edge (%zu)->(%zu) already exists", srcNode, dstNode);
 
 		// Else: create a new one
 		size_t e = m_vEdges.size();
 		m_vEdges.push_back(ptr_edge_t(new Edge(srcNode, dstNode, group, pot)));
 		m_vNodes[srcNode]->to.push_back(e);
 		m_vNodes[dstNode]->from.push_back(e);
+		if (m_edgeIndexing) m_edgeIndex.emplace(getEdgeKey(srcNode, dstNode), e);
+	}
+
+	// Add a block of new (directed) edges
+	void CGraphPairwise::addEdges(const Mat &edges, const vec_byte_t &vGroups, const Mat &pot)
+	{
+		DGM_ASSERT_MSG(edges.cols == 2 && edges.type() == CV_32SC1, "The edge list must be a Mat(size: nEdges x 2; type: CV_32SC1)");
+		DGM_ASSERT_MSG(vGroups.empty() || vGroups.size() == static_cast<size_t>(edges.rows), "The number of groups (%zu) does not match the number of edges (%d)", vGroups.size(), edges.rows);
+		
+		const size_t nNodes		= m_vNodes.size();
+		const size_t nEdges		= m_vEdges.size();
+		const size_t nNewEdges	= edges.rows;
+
+		// Check if the edges exist: all the edges of the graph are sorted once
+		std::vector<std::pair<size_t, size_t>> vPairs;
+		vPairs.reserve(nEdges + nNewEdges);
+		for (const ptr_node_t &pNode : m_vNodes)
+			for (size_t e : pNode->to) vPairs.emplace_back(m_vEdges[e]->node1, m_vEdges[e]->node2);
+		for (size_t e = 0; e < nNewEdges; e++) {
+			const int *pEdge = edges.ptr<int>(static_cast<int>(e));
+			DGM_ASSERT_MSG(pEdge[0] >= 0 && static_cast<size_t>(pEdge[0]) < nNodes, "The source node index %d is out of range %zu", pEdge[0], nNodes);
+			DGM_ASSERT_MSG(pEdge[1] >= 0 && static_cast<size_t>(pEdge[1]) < nNodes, "The destination node index %d is out of range %zu", pEdge[1], nNodes);
+			vPairs.emplace_back(pEdge[0], pEdge[1]);
+		}
+		std::sort(vPairs.begin(), vPairs.end());
+		auto it = std::adjacent_find(vPairs.begin(), vPairs.end());
+		DGM_ASSERT_MSG(it == vPairs.end(), "The edge (%zu)->(%zu) already exists", it->first, it->second);
+		
+		// Create the new ones
+		vec_size_t vNumTo(nNodes, 0), vNumFrom(nNodes, 0);
+		for (size_t e = 0; e < nNewEdges; e++) {
+			const int *pEdge = edges.ptr<int>(static_cast<int>(e));
+			vNumTo[pEdge[0]]++;
+			vNumFrom[pEdge[1]]++;
+		}
+		for (size_t n = 0; n < nNodes; n++) {
+			m_vNodes[n]->to.reserve(m_vNodes[n]->to.size() + vNumTo[n]);
+			m_vNodes[n]->from.reserve(m_vNodes[n]->from.size() + vNumFrom[n]);
+		}
+		const Mat sharedPot = pot.clone();
+		m_vEdges.reserve(nEdges + nNewEdges);
+		if (m_edgeIndexing) m_edgeIndex.reserve(nEdges + nNewEdges);
+		for (size_t e = 0; e < nNewEdges; e++) {
+			const int *pEdge = edges.ptr<int>(static_cast<int>(e));
+			const size_t srcNode = pEdge[0];
+			const size_t dstNode = pEdge[1];
+			m_vEdges.push_back(ptr_edge_t(new Edge(srcNode, dstNode, vGroups.empty() ? 0 : vGroups[e])));
+			m_vEdges.back()->Pot = sharedPot;
+			m_vNodes[srcNode]->to.push_back(nEdges + e);
+			m_vNodes[dstNode]->from.push_back(nEdges + e);
+			if (m_edgeIndexing) m_edgeIndex.emplace(getEdgeKey(srcNode, dstNode), nEdges + e);
+		}
 	}
 
 	// Set or change the potentional of an directed edge
@@ -77,28 +186,30 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		vec_size_t::const_iterator e_t = std::find_if(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), [&](size_t e) { return (m_vEdges[e]->node2 == dstNode); });
-		DGM_ASSERT_MSG(e_t != m_vNodes[srcNode]->to.end(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
 
-		pot.copyTo(m_vEdges[*e_t]->Pot);
+		Mat &edgePot = m_vEdges[e]->Pot;
+		if (edgePot.u && edgePot.u->refcount == 1 && edgePot.size() == pot.size() && edgePot.type() == pot.type())
+			pot.copyTo(edgePot);						// the own potential is overwritten in place
+		else
+			edgePot = pot.clone();						// copy-on-write: detach the edge from a potential, shared by setEdges() or by the clones
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
 	}
 
+	// All the edges of the group reference one shared potential matrix
 	void CGraphPairwise::setEdges(std::optional<byte> group, const Mat& pot)
 	{
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, m_vEdges.size()), [group, &pot, this](const Range& range) {
+		const Mat sharedPot = pot.clone();
+		parallel::parallelFor(Range(0, static_cast<int>(m_vEdges.size())), [group, &sharedPot, this](const Range& range) {
 			for (int i = range.start; i < range.end; i++) {
 				ptr_edge_t& pEdge = m_vEdges[i];
-				if (!group || pEdge->group_id == group.value())
-					pot.copyTo(pEdge->Pot);
+				if (pEdge && (!group || pEdge->group_id == group.value()))
+					pEdge->Pot = sharedPot;
 			}
 		});
-#else 			
-		for (ptr_edge_t& pEdge : m_vEdges) {
-			if(!group || pEdge->group_id == group.value())
-					pot.copyTo(pEdge->Pot);	
-		}
-#endif
+		markDirty(0, m_vNodes.size());
 	}
 
 	// Return edge potential matrix
@@ -107,12 +218,41 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		vec_size_t::const_iterator e_t = std::find_if(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), [&](size_t e) { return (m_vEdges[e]->node2 == dstNode); });
-		DGM_ASSERT_MSG(e_t != m_vNodes[srcNode]->to.end(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
-		if (m_vEdges[*e_t]->Pot.empty()) {
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		if (m_vEdges[e]->Pot.empty()) {
  			DGM_WARNING("Edge Potential is empty");
 			if (!pot.empty()) pot.release();
-		} else m_vEdges[*e_t]->Pot.copyTo(pot);
+		} else m_vEdges[e]->Pot.copyTo(pot);
+	}
+
+	span<const float> CGraphPairwise::getEdgeView(size_t srcNode, size_t dstNode) const
+	{
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const Mat &pot = m_vEdges[e]->Pot;
+		if (pot.empty()) return {};
+		DGM_ASSERT_MSG(pot.isContinuous(), "The potential of the edge (%zu)->(%zu) is not continuous", srcNode, dstNode);
+		return { pot.ptr<float>(), pot.total() };
+	}
+
+	span<float> CGraphPairwise::getMutableEdgeView(size_t srcNode, size_t dstNode)
+	{
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		Mat &pot = m_vEdges[e]->Pot;
+		if (pot.empty()) return {};
+		if (!pot.u || pot.u->refcount != 1 || !pot.isContinuous())
+			pot = pot.clone();							// copy-on-write: detach the edge from a potential, shared by setEdges() or by the clones
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
+		return { pot.ptr<float>(), pot.total() };
 	}
 
 	void CGraphPairwise::setEdgeGroup(size_t srcNode, size_t dstNode, byte group)
@@ -120,9 +260,9 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		vec_size_t::const_iterator e_t = std::find_if(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), [&](size_t e) { return (m_vEdges[e]->node2 == dstNode); });
-		DGM_ASSERT_MSG(e_t != m_vNodes[srcNode]->to.end(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
-		m_vEdges[*e_t]->group_id = group;
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		m_vEdges[e]->group_id = group;
 	}
 
 	byte CGraphPairwise::getEdgeGroup(size_t srcNode, size_t dstNode) const
@@ -130,10 +270,10 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		vec_size_t::const_iterator e_t = std::find_if(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), [&](size_t e) { return (m_vEdges[e]->node2 == dstNode); });
-		DGM_ASSERT_MSG(e_t != m_vNodes[srcNode]->to.end(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
 
-		return m_vEdges[*e_t]->group_id;
+		return m_vEdges[e]->group_id;
 	}
 
 	void CGraphPairwise::removeEdge(size_t srcNode, size_t dstNode)
@@ -141,11 +281,10 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		vec_size_t::const_iterator e_t = std::find_if(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), [&](size_t e) { return (m_vEdges[e]->node2 == dstNode); });
-
-		DGM_ASSERT_MSG(e_t != m_vNodes[srcNode]->to.end(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
 
-		removeEdge(*e_t);
+		removeEdge(e);
 	}
 
 	bool CGraphPairwise::isEdgeExists(size_t srcNode, size_t dstNode) const
@@ -153,24 +292,133 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
 		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 		
-		auto e_t = std::find_if(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), [&](size_t e) { return (m_vEdges[e]->node2 == dstNode); });
+		return findEdge(srcNode, dstNode) < m_vEdges.size();
+	}
+
+	double CGraphPairwise::computeEnergy(const vec_byte_t &vLabels) const
+	{
+		DGM_ASSERT_MSG(vLabels.size() == m_vNodes.size(), "The number of labels (%zu) does not match the number of nodes (%zu)", vLabels.size(), m_vNodes.size());
+		double res = parallelSum(m_vNodes.size(), [&](size_t begin, size_t end) {
+			double sum = 0;
+			for (size_t n = begin; n < end; n++)
+				sum -= log(MAX(FLT_MIN, m_vNodes[n]->Pot.at<float>(vLabels[n], 0)));
+			return sum;
+		});
+		res += parallelSum(m_vEdges.size(), [&](size_t begin, size_t end) {
+			double sum = 0;
+			for (size_t e = begin; e < end; e++) {
+				const Edge *pEdge = m_vEdges[e].get();
+				if (!pEdge || pEdge->Pot.empty()) continue;									// tombstone or edge without potentials
+				sum -= log(MAX(FLT_MIN, pEdge->Pot.at<float>(vLabels[pEdge->node1], vLabels[pEdge->node2])));
+			}
+			return sum;
+		});
+		return res;
+	}
+
+	size_t CGraphPairwise::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vNodes) + footprint::getBytes(m_vEdges);
+		for (const ptr_node_t &pNode : m_vNodes)
+			res += sizeof(Node) + footprint::getBytes(pNode->Pot) + footprint::getBytes(pNode->to) + footprint::getBytes(pNode->from);
+		
+		std::unordered_set<const uchar *> sPots;											// the potentials, shared by the edges of one group, are counted once
+		for (const ptr_edge_t &pEdge : m_vEdges) {
+			if (!pEdge) continue;
+			res += sizeof(Edge);
+			if (!pEdge->Pot.empty() && sPots.insert(pEdge->Pot.datastart).second) res += footprint::getBytes(pEdge->Pot);
+		}
+		res += m_edgeIndex.bucket_count() * sizeof(void *) + m_edgeIndex.size() * (sizeof(std::pair<const qword, size_t>) + sizeof(void *));
+		return res;
+	}
 
-		if (e_t == m_vNodes[srcNode]->to.cend()) return false;
-		else									 return true;
+	void CGraphPairwise::setEdgeIndex(bool enable)
+	{
+		m_edgeIndexing = enable;
+		m_edgeIndex.clear();
+		if (!enable) return;
+
+		DGM_ASSERT_MSG(m_vNodes.size() <= 0x100000000ULL, "The edge index supports up to 2^32 nodes");
+		m_edgeIndex.reserve(m_vEdges.size());
+		for (const ptr_node_t &pNode : m_vNodes)
+			for (size_t e : pNode->to)
+				m_edgeIndex.emplace(getEdgeKey(m_vEdges[e]->node1, m_vEdges[e]->node2), e);
 	}
 
 
+	// Drops the tombstones of the removed edges and renumbers the remaining ones
+	void CGraphPairwise::compact(void)
+	{
+		if (m_nRemovedEdges == 0) return;
+
+		vec_size_t vNewIdx(m_vEdges.size());
+		size_t nEdges = 0;
+		for (size_t e = 0; e < m_vEdges.size(); e++) {
+			vNewIdx[e] = nEdges;
+			if (!m_vEdges[e]) continue;
+			if (nEdges != e) m_vEdges[nEdges] = std::move(m_vEdges[e]);
+			nEdges++;
+		}
+		m_vEdges.resize(nEdges);
+		m_nRemovedEdges = 0;
+
+		for (ptr_node_t &pNode : m_vNodes) {
+			for (size_t &e : pNode->to)   e = vNewIdx[e];
+			for (size_t &e : pNode->from) e = vNewIdx[e];
+		}
+		if (m_edgeIndexing)
+			for (auto &entry : m_edgeIndex) entry.second = vNewIdx[entry.second];
+	}
+
+	// The edges share the potentials with the original graph; the node potentials are copied into one block
+	void CGraphPairwise::copyTo(CGraphPairwise &graph) const
+	{
+		DGM_ASSERT_MSG(graph.getNumStates() == getNumStates(), "The number of states (%d) does not match (%d)", graph.getNumStates(), getNumStates());
+		const byte		nStates = getNumStates();
+		const size_t	nNodes	= m_vNodes.size();
+
+		graph.reset();
+
+		vec_size_t vNewIdx(m_vEdges.size());
+		graph.m_vEdges.reserve(getNumEdges());
+		for (size_t e = 0; e < m_vEdges.size(); e++) {
+			if (!m_vEdges[e]) continue;												// tombstone
+			vNewIdx[e] = graph.m_vEdges.size();
+			graph.m_vEdges.push_back(ptr_edge_t(new Edge(*m_vEdges[e])));
+		}
+
+		Mat block(static_cast<int>(nNodes), nStates, CV_32FC1);
+		graph.m_vNodes.reserve(nNodes);
+		for (size_t n = 0; n < nNodes; n++) {
+			const Node *pSrc = m_vNodes[n].get();
+			graph.m_vNodes.push_back(ptr_node_t(new Node(pSrc->id)));
+			Node *pDst = graph.m_vNodes.back().get();
+			if (!pSrc->Pot.empty()) {
+				pDst->Pot = block.row(static_cast<int>(n)).reshape(1, nStates);
+				pSrc->Pot.copyTo(pDst->Pot);
+			}
+			pDst->sol = pSrc->sol;
+			pDst->to.reserve(pSrc->to.size());
+			for (size_t e : pSrc->to) pDst->to.push_back(vNewIdx[e]);
+			pDst->from.reserve(pSrc->from.size());
+			for (size_t e : pSrc->from) pDst->from.push_back(vNewIdx[e]);
+		}
+		graph.m_IDx = m_IDx;
+		graph.setEdgeIndex(m_edgeIndexing);
+	}
+
     // ------------------------------ PRIVATE ------------------------------
-	///@todo Optimize the edge removement
+	// The edge slot becomes a tombstone, which is dropped by compact()
 	void CGraphPairwise::removeEdge(size_t edge)
 	{
-		DGM_ASSERT_MSG(edge < m_vEdges.size(), "Edge %zu is out of range %zu", edge, m_vEdges.size());
+		DGM_ASSERT_MSG(edge < m_vEdges.size() && m_vEdges[edge], "Edge %zu is out of range %zu", edge, m_vEdges.size());
 
 		size_t srcNode = m_vEdges[edge]->node1;
 		size_t dstNode = m_vEdges[edge]->node2;
 
-		m_vEdges[edge]->Pot.release();
-		//m_vEdges.erase(m_vEdges.begin() + edge);
+		m_vEdges[edge].reset();
+		m_nRemovedEdges++;
+		if (m_edgeIndexing) m_edgeIndex.erase(getEdgeKey(srcNode, dstNode));
 		
 		vec_size_t::const_iterator e_t = std::find(m_vNodes[srcNode]->to.cbegin(), m_vNodes[srcNode]->to.cend(), edge);
 		DGM_ASSERT(e_t != m_vNodes[srcNode]->to.cend());
@@ -180,5 +428,22 @@ namespace DirectGraphicalModels
 		DGM_ASSERT(e_f != m_vNodes[dstNode]->from.cend());
 		m_vNodes[dstNode]->from.erase(e_f);
 	}
-}
 
+	size_t CGraphPairwise::findEdge(size_t srcNode, size_t dstNode) const
+	{
+		if (m_edgeIndexing) {
+			auto it = m_edgeIndex.find(getEdgeKey(srcNode, dstNode));
+			return it == m_edgeIndex.end() ? m_vEdges.size() : it->second;
+		}
+
+		// Scanning the shorter one of the adjacency lists
+		const vec_size_t &vTo	= m_vNodes[srcNode]->to;
+		const vec_size_t &vFrom = m_vNodes[dstNode]->from;
+		if (vTo.size() <= vFrom.size()) {
+			for (size_t e : vTo) if (m_vEdges[e]->node2 == dstNode) return e;
+		}
+		else
+			for (size_t e : vFrom) if (m_vEdges[e]->node1 == srcNode) return e;
+		return m_vEdges.size();
+	}
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "IGraphPairwise.h"
+#include <unordered_map>
 
 namespace DirectGraphicalModels
 {
@@ -32,7 +33,7 @@ namespace DirectGraphicalModels
 	struct Edge {
 		size_t	  node1;		///< First (source) node in edge
 		size_t	  node2;		///< Second (destination) node in edge
-		Mat		  Pot;			///< The edge potentials: Mat(size: nStates x nStates; type: CV_32FC1)
+		Mat		  Pot;			///< The edge potentials: Mat(size: nStates x nStates; type: CV_32FC1). The data may be shared with other edges of the same group (Ref. @ref CGraphPairwise::setEdges())
 		byte	  group_id;		///< ID of the group, to which the edge belongs
 
 		Edge(void) = delete;
@@ -45,16 +46,16 @@ namespace DirectGraphicalModels
 	/**
 	* @brief Pairwise graph class
 	* @ingroup moduleGraph
+	* @details The function setEdges() does not copy the potential matrix into every edge: all the affected edges reference one shared matrix,
+	* which is detached from an edge (copy-on-write) when the edge potential is changed individually with setEdge().
+	* 
+	* By default an edge is found by scanning the outgoing edges of its source node. For the graphs with high node degree, \a e.g. the superpixel graphs
+	* with hundreds of neighbours per node, the hashed edge index may be enabled with setEdgeIndex(): then every edge is found in constant time.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CGraphPairwise : public IGraphPairwise
 	{
 		friend class CMessagePassing;
-		friend class CInferChain;
-		friend class CInferTree;
-		friend class CInferLBP;
-		friend class CInferViterbi;
-		friend class CInferTRW;
 
         
 	public:
@@ -62,29 +63,76 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param nStates the number of States (classes)
 		*/
-		DllExport CGraphPairwise(byte nStates) : IGraphPairwise(nStates), m_IDx(0) {}
+		DllExport CGraphPairwise(byte nStates) : IGraphPairwise(nStates), m_IDx(0), m_nRemovedEdges(0), m_edgeIndexing(false) {}
         DllExport virtual ~CGraphPairwise(void) = default;
 
 		// CGraph
 		DllExport void		reset(void) override;
+		DllExport std::unique_ptr<CGraph> clone(void) const override;
 		DllExport size_t	addNode		  (const Mat &pot = EmptyMat) override;
+		/**
+		* @brief Adds the graph nodes with potentials
+		* @details The potentials are copied once: the nodes reference the rows of one copy of \b pots instead of being cloned one by one
+		* @param pots A block of potentials: Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		DllExport void		addNodes	  (const Mat &pots) override;
 		DllExport void		setNode       (size_t node, const Mat &pot) override;
+		/**
+		* @brief Fills the graph nodes with new potentials
+		* @details The potentials are copied in place into the already set node potentials, thus no memory is allocated, when the nodes are filled repeatedly
+		* > This function supports PPL
+		* @param start_node The index of the node, starting from which the potentials should be set
+		* @param pots A block of potentials: Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		DllExport void		setNodes	  (size_t start_node, const Mat &pots) override;
 		DllExport void		getNode       (size_t node, Mat &pot) const override;
+		DllExport span<const float>	getNodeView(size_t node) const override;
+		DllExport span<float>		getMutableNodeView(size_t node) override;
 		DllExport void		getChildNodes (size_t node, vec_size_t &vNodes) const override;
 		DllExport void		getParentNodes(size_t node, vec_size_t &vNodes) const override;
 		DllExport size_t	getNumNodes(void) const override { return m_vNodes.size(); }
-		DllExport size_t	getNumEdges(void) const override { return m_vEdges.size(); } 
+		DllExport size_t	getNumEdges(void) const override { return m_vEdges.size() - m_nRemovedEdges; } 
 		
 //     DllExport virtual void      marginalize(const vec_size_t &nodes);
 		
 		DllExport void		addEdge		(size_t srcNode, size_t dstNode, byte group, const Mat &pot) override;
+		/**
+		* @brief Adds a block of directed edges
+		* @details The uniqueness of the new edges is validated in one sorting pass over all the edges of the graph, and all the added edges
+		* reference one shared copy of \b pot (Ref. setEdges()).
+		* @param edges The edge list: Mat(size: nEdges x 2; type: CV_32SC1), where every row holds the indices of the source and of the destination nodes
+		* @param vGroups The group IDs of the edges: one per edge, or empty for the group 0
+		* @param pot %Edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1), which is set to all the added edges, or empty
+		*/
+		DllExport void		addEdges	(const Mat &edges, const vec_byte_t &vGroups = vec_byte_t(), const Mat &pot = EmptyMat) override;
 		DllExport void		setEdge		(size_t srcNode, size_t dstNode, const Mat &pot) override;
 		DllExport void		setEdges	(std::optional<byte> group, const Mat& pot) override;
 		DllExport void		getEdge		(size_t srcNode, size_t dstNode, Mat &pot) const override;
+		DllExport span<const float>	getEdgeView(size_t srcNode, size_t dstNode) const override;
+		DllExport span<float>		getMutableEdgeView(size_t srcNode, size_t dstNode) override;
 		DllExport void		setEdgeGroup(size_t srcNode, size_t dstNode, byte group) override;
 		DllExport byte		getEdgeGroup(size_t srcNode, size_t dstNode) const override;
 		DllExport void		removeEdge	(size_t srcNode, size_t dstNode) override;
 		DllExport bool		isEdgeExists(size_t srcNode, size_t dstNode) const override;
+		DllExport double	computeEnergy(const vec_byte_t &vLabels) const override;
+		DllExport size_t	getMemoryUsage(void) const override;
+
+		/**
+		* @brief Enables or disables the hashed edge index
+		* @details If enabled, the index, mapping the pair (\a srcNode, \a dstNode) to the edge, is built for all the existing edges and then maintained
+		* incrementally by addEdge(), addEdges() and removeEdge(). Thus, all the functions, which find an edge by its nodes, take constant time instead of
+		* the time, linear in the node degree. The index takes additional memory and is disabled by default.
+		* @param enable Flag indicating whether the index should be enabled
+		*/
+		DllExport void		setEdgeIndex(bool enable);
+		/**
+		* @brief Compacts the edge container
+		* @details The removed edges leave the empty slots in the edge container (tombstones), so that the slots of the remaining edges stay unchanged.
+		* This function drops the tombstones and renumbers the remaining edges and the adjacency lists of the nodes in one pass, keeping the order of the edges.
+		* The message passing algorithms (@ref CMessagePassing) do not compact the graph, but keep the tombstones as the unused message slots; calling this
+		* function after removing many edges avoids allocating the messages for them.
+		*/
+		DllExport void		compact(void);
 
 #ifdef DEBUG_MODE
 		/**
@@ -95,18 +143,39 @@ namespace DirectGraphicalModels
 		DllExport vec_edge_t* getEdgesContainer(void) { return &m_vEdges; }
 #endif
 
+	protected:
+		/**
+		* @brief Copies the graph into another graph
+		* @details The removed edges are not copied. The node potentials are copied into one block, and the edge potentials are shared with the copy
+		* until they are changed (copy-on-write).
+		* @param graph The empty graph with the same number of states
+		*/
+		void						copyTo(CGraphPairwise &graph) const;
+
+
 	private:
 		/**
 		* @brief Removes the specified edge
 		* @param edge index of the edge
 		*/
 		DllExport void				removeEdge(size_t edge);
+		/**
+		* @brief Returns the index of the edge (\b srcNode) --> (\b dstNode)
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		* @return The edge index if the edge exists, or the number of edges otherwise
+		*/
+		size_t						findEdge(size_t srcNode, size_t dstNode) const;
+		static qword				getEdgeKey(size_t srcNode, size_t dstNode) { return (static_cast<qword>(srcNode) << 32) | static_cast<qword>(dstNode); }
 
 
 	private:
 		size_t		m_IDx;			// = 0;	Primary Key
 		vec_node_t	m_vNodes;		// Nodes container
-		vec_edge_t	m_vEdges;		// Edges container
+		vec_edge_t	m_vEdges;		// Edges container; the removed edges are the empty slots (tombstones) until compact() is called
+		size_t		m_nRemovedEdges;// = 0; Number of the tombstones in the edges container
+		bool		m_edgeIndexing;	// = false; Flag indicating whether the hashed edge index is maintained
+		std::unordered_map<qword, size_t>	m_edgeIndex;	// Hashed edge index: (srcNode, dstNode) -> edge
 	};
 }
 
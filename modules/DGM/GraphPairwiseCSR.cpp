@@ -0,0 +1,577 @@
+#include "GraphPairwiseCSR.h"
+#include "ThreadPool.h"
+#include "ModelFile.h"
+#include "footprint.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Returns the matrix header over the array: one row per element
+		template <typename T>
+		Mat asMat(const std::vector<T> &vData)
+		{
+			return Mat(static_cast<int>(vData.size()), 1, CV_8UC(sizeof(T)), const_cast<T *>(vData.data()));
+		}
+
+		// Returns the matrix header over the array of potentials: one row per node or edge
+		Mat asMat(const vec_float_t &vData, int cols)
+		{
+			return Mat(static_cast<int>(vData.size() / cols), cols, CV_32FC1, const_cast<float *>(vData.data()));
+		}
+
+		// Copies the matrix, written with asMat(), into the array
+		template <typename T>
+		void fromMat(const Mat &data, std::vector<T> &vData)
+		{
+			DGM_ASSERT_MSG(data.elemSize() % sizeof(T) == 0, "The file has been saved on a platform with another element size");
+			const T *pData = data.empty() ? nullptr : reinterpret_cast<const T *>(data.data);
+			vData.assign(pData, pData + data.total() * data.elemSize() / sizeof(T));
+		}
+	}
+
+	void CGraphPairwiseCSR::reset(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_vNodePots.clear();
+		m_vEdgePots.clear();
+		m_vEdgePotts.clear();
+		m_vEdgeSrc.clear();
+		m_vEdgeDst.clear();
+		m_vEdgeGroup.clear();
+		m_vEdgePotIdx.clear();
+		m_vEdgeRemoved.clear();
+		m_vSharedPots.clear();
+		m_hasOwnPots = false;
+		m_hasPottsPots = false;
+		m_vOutOffset.clear();
+		m_vOutEdges.clear();
+		m_vInOffset.clear();
+		m_vInEdges.clear();
+		m_indexState = INDEX_NONE;
+	}
+
+	std::unique_ptr<CGraph> CGraphPairwiseCSR::clone(void) const
+	{
+		auto res = std::make_unique<CGraphPairwiseCSR>(getNumStates());
+		std::lock_guard<std::mutex> lock(m_mtx);
+		res->m_vNodePots	= m_vNodePots;
+		res->m_vEdgePots	= m_vEdgePots;
+		res->m_vEdgePotts	= m_vEdgePotts;
+		res->m_vSharedPots	= m_vSharedPots;
+		res->m_vEdgePotIdx	= m_vEdgePotIdx;
+		res->m_hasOwnPots	= m_hasOwnPots.load();
+		res->m_hasPottsPots = m_hasPottsPots.load();
+		res->m_vEdgeSrc		= m_vEdgeSrc;
+		res->m_vEdgeDst		= m_vEdgeDst;
+		res->m_vEdgeGroup	= m_vEdgeGroup;
+		res->m_vEdgeRemoved = m_vEdgeRemoved;
+		res->m_vOutOffset	= m_vOutOffset;
+		res->m_vOutEdges	= m_vOutEdges;
+		res->m_vInOffset	= m_vInOffset;
+		res->m_vInEdges		= m_vInEdges;
+		res->m_indexState	= m_indexState.load();
+		return res;
+	}
+
+	void CGraphPairwiseCSR::save(const std::string &fileName) const
+	{
+		buildIndex(true);
+		std::lock_guard<std::mutex> lock(m_mtx);
+
+		const byte nStates = getNumStates();
+		const int  nEdgeValues = nStates * nStates;
+		Mat sharedPots(static_cast<int>(m_vSharedPots.size()), nEdgeValues, CV_32FC1);
+		for (int i = 0; i < sharedPots.rows; i++)
+			memcpy(sharedPots.ptr<float>(i), m_vSharedPots[i].data(), nEdgeValues * sizeof(float));
+		const dword info[] = { nStates, m_hasOwnPots ? 1u : 0u, m_hasPottsPots ? 1u : 0u };
+
+		CModelFileWriter writer;
+		writer.addSection("Graph.info",			info, sizeof(info));
+		writer.addSection("Graph.nodePots",		asMat(m_vNodePots, nStates));
+		writer.addSection("Graph.edgePots",		asMat(m_vEdgePots, nEdgeValues));
+		writer.addSection("Graph.edgePotts",	asMat(m_vEdgePotts, 2));
+		writer.addSection("Graph.sharedPots",	sharedPots);
+		writer.addSection("Graph.edgePotIdx",	asMat(m_vEdgePotIdx));
+		writer.addSection("Graph.edgeSrc",		asMat(m_vEdgeSrc));
+		writer.addSection("Graph.edgeDst",		asMat(m_vEdgeDst));
+		writer.addSection("Graph.edgeGroup",	asMat(m_vEdgeGroup));
+		writer.addSection("Graph.edgeRemoved",	asMat(m_vEdgeRemoved));
+		writer.addSection("Graph.outOffset",	asMat(m_vOutOffset));
+		writer.addSection("Graph.outEdges",		asMat(m_vOutEdges));
+		writer.addSection("Graph.inOffset",		asMat(m_vInOffset));
+		writer.addSection("Graph.inEdges",		asMat(m_vInEdges));
+		writer.save(fileName);
+	}
+
+	void CGraphPairwiseCSR::load(const std::string &fileName, bool mapped)
+	{
+		std::shared_ptr<const CModelFile> pFile = CModelFile::open(fileName, mapped);
+		const Mat info = pFile->getSection("Graph.info");
+		DGM_ASSERT_MSG(info.total() * info.elemSize() >= 3 * sizeof(dword), "The file %s is corrupted", fileName.c_str());
+		const dword *pInfo = reinterpret_cast<const dword *>(info.data);
+		DGM_ASSERT_MSG(pInfo[0] == getNumStates(), "The graph in the file %s has %u states, but %u expected", fileName.c_str(), pInfo[0], static_cast<unsigned int>(getNumStates()));
+
+		std::lock_guard<std::mutex> lock(m_mtx);
+		fromMat(pFile->getSection("Graph.nodePots"),	m_vNodePots);
+		fromMat(pFile->getSection("Graph.edgePots"),	m_vEdgePots);
+		fromMat(pFile->getSection("Graph.edgePotts"),	m_vEdgePotts);
+		fromMat(pFile->getSection("Graph.edgePotIdx"),	m_vEdgePotIdx);
+		fromMat(pFile->getSection("Graph.edgeSrc"),		m_vEdgeSrc);
+		fromMat(pFile->getSection("Graph.edgeDst"),		m_vEdgeDst);
+		fromMat(pFile->getSection("Graph.edgeGroup"),	m_vEdgeGroup);
+		fromMat(pFile->getSection("Graph.edgeRemoved"),	m_vEdgeRemoved);
+		fromMat(pFile->getSection("Graph.outOffset"),	m_vOutOffset);
+		fromMat(pFile->getSection("Graph.outEdges"),	m_vOutEdges);
+		fromMat(pFile->getSection("Graph.inOffset"),	m_vInOffset);
+		fromMat(pFile->getSection("Graph.inEdges"),		m_vInEdges);
+
+		const Mat sharedPots = pFile->getSection("Graph.sharedPots");
+		m_vSharedPots.resize(sharedPots.rows);
+		for (int i = 0; i < sharedPots.rows; i++)
+			m_vSharedPots[i].assign(sharedPots.ptr<float>(i), sharedPots.ptr<float>(i) + sharedPots.cols);
+
+		m_hasOwnPots	= pInfo[1] != 0;
+		m_hasPottsPots	= pInfo[2] != 0;
+		m_indexState	= INDEX_VALID;
+	}
+
+	// Add a new node to the graph with specified potentional
+	size_t CGraphPairwiseCSR::addNode(const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		size_t res = getNumNodes();
+		if (pot.empty()) m_vNodePots.resize(m_vNodePots.size() + nStates, 1.0f / nStates);
+		else {
+			DGM_ASSERT_MSG((pot.cols == 1) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, 1, nStates);
+			DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+			for (byte s = 0; s < nStates; s++) m_vNodePots.push_back(pot.at<float>(s, 0));
+		}
+		m_indexState = INDEX_NONE;
+		return res;
+	}
+
+	void CGraphPairwiseCSR::addNodes(const Mat &pots)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(pots.cols == nStates, "Potential size (%d) does not match (%d)", pots.cols, nStates);
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1, "Potentials type is not CV_32FC1");
+
+		size_t offset = m_vNodePots.size();
+		m_vNodePots.resize(offset + static_cast<size_t>(pots.rows) * nStates);
+		for (int n = 0; n < pots.rows; n++)
+			memcpy(&m_vNodePots[offset + n * nStates], pots.ptr<float>(n), nStates * sizeof(float));
+		m_indexState = INDEX_NONE;
+	}
+
+	// Set or change the potential of node idx
+	void CGraphPairwiseCSR::setNode(size_t node, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		DGM_ASSERT_MSG((pot.cols == 1) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, 1, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		float *pPot = &m_vNodePots[node * nStates];
+		for (byte s = 0; s < nStates; s++) pPot[s] = pot.at<float>(s, 0);
+		markDirty(node, node + 1);
+	}
+
+	void CGraphPairwiseCSR::setNodes(size_t start_node, const Mat &pots)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(start_node + pots.rows <= getNumNodes(), "The given ranges exceed the number of nodes(%zu)", getNumNodes());
+		DGM_ASSERT_MSG(pots.cols == nStates, "Potential size (%d) does not match (%d)", pots.cols, nStates);
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1, "Potentials type is not CV_32FC1");
+
+		parallel::parallelFor(Range(0, pots.rows), [start_node, nStates, &pots, this](const Range& range) {
+			for (int n = range.start; n < range.end; n++)
+				memcpy(&m_vNodePots[(start_node + n) * nStates], pots.ptr<float>(n), nStates * sizeof(float));
+		});
+		markDirty(start_node, start_node + pots.rows);
+	}
+
+	// Return node potential vector
+	void CGraphPairwiseCSR::getNode(size_t node, Mat &pot) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		if (pot.empty() || pot.cols != 1 || pot.rows != nStates || pot.type() != CV_32FC1)
+			pot = Mat(nStates, 1, CV_32FC1);
+
+		const float *pPot = &m_vNodePots[node * nStates];
+		for (byte s = 0; s < nStates; s++)
+			pot.at<float>(s, 0) = pPot[s];
+	}
+
+	span<const float> CGraphPairwiseCSR::getNodeView(size_t node) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		return { &m_vNodePots[node * nStates], nStates };
+	}
+
+	span<float> CGraphPairwiseCSR::getMutableNodeView(size_t node)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		markDirty(node, node + 1);
+		return { &m_vNodePots[node * nStates], nStates };
+	}
+
+	void CGraphPairwiseCSR::getNodes(size_t start_node, size_t num_nodes, Mat &pots) const
+	{
+		const byte nStates = getNumStates();
+		if (!num_nodes) num_nodes = getNumNodes() - start_node;
+		DGM_ASSERT_MSG(start_node + num_nodes <= getNumNodes(), "The given ranges exceed the number of nodes(%zu)", getNumNodes());
+
+		pots = Mat(static_cast<int>(num_nodes), nStates, CV_32FC1);
+		memcpy(pots.data, &m_vNodePots[start_node * nStates], num_nodes * nStates * sizeof(float));
+	}
+
+	// Return child nodes ID's
+	void CGraphPairwiseCSR::getChildNodes(size_t node, vec_size_t &vNodes) const
+	{
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		buildIndex();
+		if (!vNodes.empty()) vNodes.clear();
+		for (size_t i = m_vOutOffset[node]; i < m_vOutOffset[node + 1]; i++) {
+			size_t e = m_vOutEdges[i];
+			if (!m_vEdgeRemoved[e]) vNodes.push_back(m_vEdgeDst[e]);
+		}
+	}
+
+	// Return parent nodes ID's
+	void CGraphPairwiseCSR::getParentNodes(size_t node, vec_size_t &vNodes) const
+	{
+		DGM_ASSERT_MSG(node < getNumNodes(), "Node %zu is out of range %zu", node, getNumNodes());
+		buildIndex();
+		if (!vNodes.empty()) vNodes.clear();
+		for (size_t i = m_vInOffset[node]; i < m_vInOffset[node + 1]; i++) {
+			size_t e = m_vInEdges[i];
+			if (!m_vEdgeRemoved[e]) vNodes.push_back(m_vEdgeSrc[e]);
+		}
+	}
+
+	// Add a new (directed) edge to the graph with specified potentional
+	void CGraphPairwiseCSR::addEdge(size_t srcNode, size_t dstNode, byte group, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = m_vEdgeSrc.size();
+		m_vEdgeSrc.push_back(srcNode);
+		m_vEdgeDst.push_back(dstNode);
+		m_vEdgeGroup.push_back(group);
+		m_vEdgePotIdx.push_back(POT_NONE);
+		m_vEdgeRemoved.push_back(0);
+		if (m_hasOwnPots) m_vEdgePots.resize(m_vEdgePots.size() + nStates * nStates);
+		if (m_hasPottsPots) m_vEdgePotts.resize(m_vEdgePotts.size() + 2);
+		m_indexState = INDEX_NONE;
+
+		if (!pot.empty()) {
+			DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+			DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+			createOwnPots();
+			for (byte y = 0; y < nStates; y++)
+				memcpy(&m_vEdgePots[(e * nStates + y) * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+			m_vEdgePotIdx[e] = POT_OWN;
+		}
+	}
+
+	// Set or change the potentional of an directed edge
+	void CGraphPairwiseCSR::setEdge(size_t srcNode, size_t dstNode, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+		DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		// copy-on-write: the edge gets its own potential and stops referencing the shared one
+		createOwnPots();
+		for (byte y = 0; y < nStates; y++)
+			memcpy(&m_vEdgePots[(e * nStates + y) * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+		m_vEdgePotIdx[e] = POT_OWN;
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
+	}
+
+	void CGraphPairwiseCSR::setEdgePotts(size_t srcNode, size_t dstNode, float diag, float offDiag)
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		createPottsPots();
+		m_vEdgePotts[2 * e]		= diag;
+		m_vEdgePotts[2 * e + 1]	= offDiag;
+		m_vEdgePotIdx[e] = POT_POTTS;
+	}
+
+	void CGraphPairwiseCSR::setEdges(std::optional<byte> group, const Mat &pot)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		const size_t nEdges = getNumEdges();
+
+		// Find a free shared potential
+		dword idx = 0;
+		while (idx < m_vSharedPots.size() && !m_vSharedPots[idx].empty()) idx++;
+		if (idx == m_vSharedPots.size()) m_vSharedPots.emplace_back();
+		m_vSharedPots[idx].resize(nStates * nStates);
+		for (byte y = 0; y < nStates; y++)
+			memcpy(&m_vSharedPots[idx][y * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+
+		// Let all the edges of the group reference it
+		parallel::parallelFor(Range(0, static_cast<int>(nEdges)), [&, group, idx](const Range& range) {
+			for (int e = range.start; e < range.end; e++) {
+				if (m_vEdgeRemoved[e]) continue;
+				if (!group || m_vEdgeGroup[e] == group.value())
+					m_vEdgePotIdx[e] = idx;
+			}
+		});
+
+		// Release the shared potentials, which are not referenced anymore
+		vec_bool_t vReferenced(m_vSharedPots.size(), false);
+		for (size_t e = 0; e < nEdges; e++)
+			if (m_vEdgePotIdx[e] < m_vSharedPots.size()) vReferenced[m_vEdgePotIdx[e]] = true;
+		for (size_t i = 0; i < m_vSharedPots.size(); i++)
+			if (!vReferenced[i]) vec_float_t().swap(m_vSharedPots[i]);
+		markDirty(0, getNumNodes());
+	}
+
+	// Return edge potential matrix
+	void CGraphPairwiseCSR::getEdge(size_t srcNode, size_t dstNode, Mat &pot) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const float *pPot = getEdgePot(e);
+		const float *pPotts = getEdgePotts(e);
+		if (pPotts) {
+			pot = Mat(nStates, nStates, CV_32FC1, Scalar(pPotts[1]));
+			for (byte s = 0; s < nStates; s++) pot.at<float>(s, s) = pPotts[0];
+		} else if (!pPot) {
+			DGM_WARNING("Edge Potential is empty");
+			if (!pot.empty()) pot.release();
+		} else {
+			pot = Mat(nStates, nStates, CV_32FC1);
+			memcpy(pot.data, pPot, nStates * nStates * sizeof(float));
+		}
+	}
+
+	span<const float> CGraphPairwiseCSR::getEdgeView(size_t srcNode, size_t dstNode) const
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const float *pPot = getEdgePot(e);
+		if (!pPot) return {};
+		return { pPot, static_cast<size_t>(nStates) * nStates };
+	}
+
+	span<float> CGraphPairwiseCSR::getMutableEdgeView(size_t srcNode, size_t dstNode)
+	{
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		if (m_vEdgePotIdx[e] == POT_NONE) return {};
+		if (m_vEdgePotIdx[e] != POT_OWN) {
+			// copy-on-write: the edge gets its own copy of the shared or of the Potts potential
+			createOwnPots();
+			float		*pDst	= &m_vEdgePots[e * nStates * nStates];
+			const float *pPotts = getEdgePotts(e);
+			if (pPotts)
+				for (byte y = 0; y < nStates; y++)
+					for (byte x = 0; x < nStates; x++)
+						pDst[y * nStates + x] = x == y ? pPotts[0] : pPotts[1];
+			else memcpy(pDst, getEdgePot(e), nStates * nStates * sizeof(float));
+			m_vEdgePotIdx[e] = POT_OWN;
+		}
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
+		return { &m_vEdgePots[e * nStates * nStates], static_cast<size_t>(nStates) * nStates };
+	}
+
+	void CGraphPairwiseCSR::setEdgeGroup(size_t srcNode, size_t dstNode, byte group)
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		m_vEdgeGroup[e] = group;
+	}
+
+	byte CGraphPairwiseCSR::getEdgeGroup(size_t srcNode, size_t dstNode) const
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		return m_vEdgeGroup[e];
+	}
+
+	void CGraphPairwiseCSR::removeEdge(size_t srcNode, size_t dstNode)
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < getNumEdges(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		// The edge slot is kept (as in CGraphPairwise), it is only excluded from the adjacency
+		m_vEdgeRemoved[e] = 1;
+		m_vEdgePotIdx[e] = POT_NONE;
+		byte valid = INDEX_VALID;
+		m_indexState.compare_exchange_strong(valid, INDEX_STALE);
+	}
+
+	bool CGraphPairwiseCSR::isEdgeExists(size_t srcNode, size_t dstNode) const
+	{
+		DGM_ASSERT_MSG(srcNode < getNumNodes(), "The source node index %zu is out of range %zu", srcNode, getNumNodes());
+		DGM_ASSERT_MSG(dstNode < getNumNodes(), "The destination node index %zu is out of range %zu", dstNode, getNumNodes());
+
+		return findEdge(srcNode, dstNode) < getNumEdges();
+	}
+
+	double CGraphPairwiseCSR::computeEnergy(const vec_byte_t &vLabels) const
+	{
+		const size_t nStates = getNumStates();
+		DGM_ASSERT_MSG(vLabels.size() == getNumNodes(), "The number of labels (%zu) does not match the number of nodes (%zu)", vLabels.size(), getNumNodes());
+		double res = parallelSum(getNumNodes(), [&](size_t begin, size_t end) {
+			double sum = 0;
+			for (size_t n = begin; n < end; n++)
+				sum -= log(MAX(FLT_MIN, m_vNodePots[n * nStates + vLabels[n]]));
+			return sum;
+		});
+		res += parallelSum(getNumEdges(), [&](size_t begin, size_t end) {
+			double sum = 0;
+			for (size_t e = begin; e < end; e++) {
+				if (!m_vEdgeRemoved.empty() && m_vEdgeRemoved[e]) continue;
+				const byte x = vLabels[m_vEdgeSrc[e]];
+				const byte y = vLabels[m_vEdgeDst[e]];
+				const float *pPotts = getEdgePotts(e);
+				if (pPotts) sum -= log(MAX(FLT_MIN, x == y ? pPotts[0] : pPotts[1]));
+				else {
+					const float *pPot = getEdgePot(e);
+					if (pPot) sum -= log(MAX(FLT_MIN, pPot[x * nStates + y]));
+				}
+			}
+			return sum;
+		});
+		return res;
+	}
+
+	size_t CGraphPairwiseCSR::getMemoryUsage(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return sizeof(*this)
+			+ footprint::getBytes(m_vNodePots) + footprint::getBytes(m_vEdgePots) + footprint::getBytes(m_vEdgePotts) + footprint::getBytes(m_vSharedPots)
+			+ footprint::getBytes(m_vEdgePotIdx) + footprint::getBytes(m_vEdgeSrc) + footprint::getBytes(m_vEdgeDst) + footprint::getBytes(m_vEdgeGroup)
+			+ footprint::getBytes(m_vEdgeRemoved) + footprint::getBytes(m_vOutOffset) + footprint::getBytes(m_vOutEdges) + footprint::getBytes(m_vInOffset)
+			+ footprint::getBytes(m_vInEdges);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CGraphPairwiseCSR::buildIndex(bool compact) const
+	{
+		byte state = m_indexState.load();
+		if (state == INDEX_VALID || (state == INDEX_STALE && !compact)) return;
+
+		std::lock_guard<std::mutex> lock(m_mtx);
+		state = m_indexState.load();
+		if (state == INDEX_VALID || (state == INDEX_STALE && !compact)) return;
+
+		const size_t nNodes = getNumNodes();
+		const size_t nEdges = getNumEdges();
+
+		m_vOutOffset.assign(nNodes + 1, 0);
+		m_vInOffset.assign(nNodes + 1, 0);
+		size_t nActive = 0;
+		for (size_t e = 0; e < nEdges; e++) {
+			if (m_vEdgeRemoved[e]) continue;
+			m_vOutOffset[m_vEdgeSrc[e] + 1]++;
+			m_vInOffset[m_vEdgeDst[e] + 1]++;
+			nActive++;
+		}
+		for (size_t n = 0; n < nNodes; n++) {
+			m_vOutOffset[n + 1] += m_vOutOffset[n];
+			m_vInOffset[n + 1] += m_vInOffset[n];
+		}
+
+		m_vOutEdges.resize(nActive);
+		m_vInEdges.resize(nActive);
+		vec_size_t vOutPos(m_vOutOffset.begin(), m_vOutOffset.end() - 1);
+		vec_size_t vInPos(m_vInOffset.begin(), m_vInOffset.end() - 1);
+		for (size_t e = 0; e < nEdges; e++) {								// edges keep their insertion order within every row
+			if (m_vEdgeRemoved[e]) continue;
+			m_vOutEdges[vOutPos[m_vEdgeSrc[e]]++] = e;
+			m_vInEdges[vInPos[m_vEdgeDst[e]]++] = e;
+		}
+
+		m_indexState = INDEX_VALID;
+	}
+
+	const float* CGraphPairwiseCSR::getEdgePot(size_t edge) const
+	{
+		const dword idx = m_vEdgePotIdx[edge];
+		if (idx == POT_NONE || idx == POT_POTTS) return NULL;
+		if (idx == POT_OWN)	 return &m_vEdgePots[edge * getNumStates() * getNumStates()];
+		return m_vSharedPots[idx].data();
+	}
+
+	const float* CGraphPairwiseCSR::getEdgePotts(size_t edge) const
+	{
+		return m_vEdgePotIdx[edge] == POT_POTTS ? &m_vEdgePotts[2 * edge] : NULL;
+	}
+
+	void CGraphPairwiseCSR::createOwnPots(void)
+	{
+		if (m_hasOwnPots) return;
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (m_hasOwnPots) return;
+
+		m_vEdgePots.assign(getNumEdges() * getNumStates() * getNumStates(), 0.0f);
+		m_hasOwnPots = true;
+	}
+
+	void CGraphPairwiseCSR::createPottsPots(void)
+	{
+		if (m_hasPottsPots) return;
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (m_hasPottsPots) return;
+
+		m_vEdgePotts.assign(2 * getNumEdges(), 0.0f);
+		m_hasPottsPots = true;
+	}
+
+	size_t CGraphPairwiseCSR::findEdge(size_t srcNode, size_t dstNode) const
+	{
+		buildIndex();
+		for (size_t i = m_vOutOffset[srcNode]; i < m_vOutOffset[srcNode + 1]; i++) {
+			size_t e = m_vOutEdges[i];
+			if (m_vEdgeDst[e] == dstNode && !m_vEdgeRemoved[e]) return e;
+		}
+		return getNumEdges();
+	}
+}
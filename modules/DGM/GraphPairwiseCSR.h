@@ -0,0 +1,162 @@
+// (pairwise) Graph class interface with compressed sparse row (CSR) storage;
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "IGraphPairwise.h"
+#include <atomic>
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	// ================================ CSR Graph Class ================================
+	/**
+	* @brief Pairwise graph class with contiguous storage
+	* @ingroup moduleGraph
+	* @details In contrast to the @ref CGraphPairwise class, which stores every node and edge as a separate heap object, this class keeps the graph
+	* in a structure-of-arrays layout:
+	* - all node potentials are stored in one flat buffer of size \a nNodes x \a nStates;
+	* - the edge potentials, set with setEdges(), are stored once per call and shared by all the affected edges; the individual edge potentials,
+	* set with addEdge(), setEdge() or setArc(), are stored in one flat buffer of size \a nEdges x \a nStates x \a nStates, which is allocated on the first use.
+	* Changing a shared edge potential with setEdge() detaches the edge from the shared potential (copy-on-write);
+	* - the individual Potts edge potentials, set with setEdgePotts() or setArcPotts(), are stored in the compact form of only two values per edge in the buffer
+	* of size \a nEdges x 2, which is also allocated on the first use. The message passing algorithms use the \f$O(nStates)\f$ Potts update for such edges;
+	* - the adjacency is kept in the compressed sparse row (CSR) format: the outgoing (and incoming) edges of node \a n are enumerated by the
+	* offset arrays in range [offset[n]; offset[n+1]).
+	*
+	* The CSR index is built lazily on the first query after the edges were added, thus the graph should preferably be built first (all the nodes and edges),
+	* and filled with potentials afterwards. The functions setNode(), setEdge(), setArc() and setEdgeGroup() may be called concurrently from different threads.
+	* > Please note, that in contrast to the @ref CGraphPairwise class, addEdge() does not check whether the edge already exists.
+	* > Nodes added without potential are initialized with the uniform potential \f$1 / nStates\f$.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGraphPairwiseCSR : public IGraphPairwise
+	{
+		friend class CMessagePassing;
+
+	public:
+		/**
+		* @brief Constructor
+		* @param nStates the number of States (classes)
+		*/
+		DllExport CGraphPairwiseCSR(byte nStates) : IGraphPairwise(nStates), m_hasOwnPots(false), m_hasPottsPots(false), m_indexState(INDEX_NONE) {}
+		DllExport virtual ~CGraphPairwiseCSR(void) = default;
+
+		// CGraph
+		DllExport void		reset(void) override;
+		DllExport std::unique_ptr<CGraph> clone(void) const override;
+		DllExport size_t	addNode		  (const Mat &pot = EmptyMat) override;
+		DllExport void		addNodes	  (const Mat &pots) override;
+		DllExport void		setNode       (size_t node, const Mat &pot) override;
+		DllExport void		setNodes	  (size_t start_node, const Mat &pots) override;
+		DllExport void		getNode       (size_t node, Mat &pot) const override;
+		DllExport span<const float>	getNodeView(size_t node) const override;
+		DllExport span<float>		getMutableNodeView(size_t node) override;
+		DllExport void		getNodes	  (size_t start_node, size_t num_nodes, Mat &pots) const override;
+		DllExport void		getChildNodes (size_t node, vec_size_t &vNodes) const override;
+		DllExport void		getParentNodes(size_t node, vec_size_t &vNodes) const override;
+		DllExport size_t	getNumNodes(void) const override { return m_vNodePots.size() / getNumStates(); }
+		DllExport size_t	getNumEdges(void) const override { return m_vEdgeSrc.size(); }
+
+		// IGraphPairwise
+		DllExport void		addEdge		(size_t srcNode, size_t dstNode, byte group, const Mat &pot) override;
+		DllExport void		setEdge		(size_t srcNode, size_t dstNode, const Mat &pot) override;
+		DllExport void		setEdgePotts(size_t srcNode, size_t dstNode, float diag, float offDiag) override;
+		DllExport void		setEdges	(std::optional<byte> group, const Mat& pot) override;
+		DllExport void		getEdge		(size_t srcNode, size_t dstNode, Mat &pot) const override;
+		/**
+		* @brief Returns the view of the edge potential
+		* @details The view of the Potts potentials, set with setEdgePotts(), is empty: getEdge() expands them into the full matrix
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		* @return The view of the \a nStates x \a nStates values of the edge potential matrix in the row-major order
+		*/
+		DllExport span<const float>	getEdgeView(size_t srcNode, size_t dstNode) const override;
+		DllExport span<float>		getMutableEdgeView(size_t srcNode, size_t dstNode) override;
+		DllExport void		setEdgeGroup(size_t srcNode, size_t dstNode, byte group) override;
+		DllExport byte		getEdgeGroup(size_t srcNode, size_t dstNode) const override;
+		DllExport void		removeEdge	(size_t srcNode, size_t dstNode) override;
+		DllExport bool		isEdgeExists(size_t srcNode, size_t dstNode) const override;
+		DllExport double	computeEnergy(const vec_byte_t &vLabels) const override;
+		DllExport size_t	getMemoryUsage(void) const override;
+
+		/**
+		* @brief Saves the graph into a file
+		* @details The whole graph, \a i.e. the node potentials, the edges with their groups and potentials, and the CSR index, is written as a set of flat arrays 
+		* into the model container (ref. @ref CModelFileWriter). The removed edges are preserved, but excluded from the index.
+		* @param fileName The name of the file
+		*/
+		DllExport void		save(const std::string &fileName) const;
+		/**
+		* @brief Loads the graph from a file
+		* @details The graph is restored from the file, written by the save() function, with one block copy per array, and is ready for the inference: 
+		* neither the graph building nor the index building is repeated.
+		* @param fileName The name of the file
+		* @param mapped Flag indicating whether the file should be mapped into memory (ref. CModelFile::open())
+		*/
+		DllExport void		load(const std::string &fileName, bool mapped = true);
+
+
+	private:
+		/**
+		* @brief Builds the CSR adjacency index
+		* @details The index is rebuilt only if it is missing, or if \b compact is true and some edges were removed since the last build.
+		* @param compact Flag indicating whether the removed edges must be excluded from the index
+		*/
+		void	buildIndex(bool compact = false) const;
+		/**
+		* @brief Returns the index of the edge (\b srcNode) --> (\b dstNode)
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		* @return The edge index if the edge exists, or the number of edges otherwise
+		*/
+		size_t	findEdge(size_t srcNode, size_t dstNode) const;
+		/**
+		* @brief Returns the pointer to the edge potential
+		* @param edge index of the edge
+		* @return The pointer to \a nStates x \a nStates values, or NULL if the potential is not set
+		*/
+		const float* getEdgePot(size_t edge) const;
+		/**
+		* @brief Returns the pointer to the compact Potts edge potential
+		* @param edge index of the edge
+		* @return The pointer to the diagonal and off-diagonal values, or NULL if the edge potential is not stored in the compact Potts form
+		*/
+		const float* getEdgePotts(size_t edge) const;
+		/**
+		* @brief Allocates the buffer for the individual edge potentials
+		* @details Thread-safe
+		*/
+		void	createOwnPots(void);
+		/**
+		* @brief Allocates the buffer for the individual Potts edge potentials
+		* @details Thread-safe
+		*/
+		void	createPottsPots(void);
+
+
+	private:
+		enum : byte { INDEX_NONE = 0, INDEX_STALE, INDEX_VALID };
+		static const dword			POT_NONE = 0xFFFFFFFF;	///< The edge potential is not set
+		static const dword			POT_OWN	 = 0xFFFFFFFE;	///< The edge has individual potential
+		static const dword			POT_POTTS = 0xFFFFFFFD;	///< The edge has individual Potts potential
+
+		vec_float_t					m_vNodePots;		///< %Node potentials: nNodes x nStates
+		vec_float_t					m_vEdgePots;		///< Individual edge potentials: nEdges x nStates x nStates
+		vec_float_t					m_vEdgePotts;		///< Individual Potts edge potentials: nEdges x 2 (the diagonal and off-diagonal values)
+		std::vector<vec_float_t>	m_vSharedPots;		///< Shared edge potentials: nStates x nStates each
+		std::vector<dword>			m_vEdgePotIdx;		///< Index of the shared potential of every edge, or POT_NONE or POT_OWN
+		std::atomic<bool>			m_hasOwnPots;		///< Flag indicating whether the buffer for the individual edge potentials is allocated
+		std::atomic<bool>			m_hasPottsPots;		///< Flag indicating whether the buffer for the individual Potts edge potentials is allocated
+		vec_size_t					m_vEdgeSrc;			///< Source node of every edge
+		vec_size_t					m_vEdgeDst;			///< Destination node of every edge
+		vec_byte_t					m_vEdgeGroup;		///< Group of every edge
+		vec_byte_t					m_vEdgeRemoved;		///< Flags indicating whether the edge was removed
+
+		mutable vec_size_t			m_vOutOffset;		///< CSR offsets of the outgoing edges: nNodes + 1
+		mutable vec_size_t			m_vOutEdges;		///< CSR outgoing edge indices
+		mutable vec_size_t			m_vInOffset;		///< CSR offsets of the incoming edges: nNodes + 1
+		mutable vec_size_t			m_vInEdges;			///< CSR incoming edge indices
+		mutable std::atomic<byte>	m_indexState;		///< State of the CSR index
+		mutable std::mutex			m_mtx;				///< Guards the lazy index building and allocation
+	};
+}
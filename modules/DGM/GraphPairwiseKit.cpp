@@ -0,0 +1,69 @@
+#include "GraphPairwiseKit.h"
+#include "MaxFlow.h"
+
+namespace DirectGraphicalModels
+{
+	size_t CGraphPairwiseKit::estimateMemory(Size size, byte nStates, INFER infer, GraphType graphType, byte gType, bool sharedEdgePots)
+	{
+		const size_t nNodes		= static_cast<size_t>(size.width) * size.height;
+		const size_t potSize	= static_cast<size_t>(nStates) * nStates * sizeof(float);
+		size_t nArcs = 0;
+		size_t nDirs = 0;
+		if (gType & GRAPH_EDGES_GRID) {
+			nArcs += static_cast<size_t>(size.width - 1) * size.height + static_cast<size_t>(size.width) * (size.height - 1);
+			nDirs += 4;
+		}
+		if (gType & GRAPH_EDGES_DIAG) {
+			nArcs += 2 * static_cast<size_t>(size.width - 1) * (size.height - 1);
+			nDirs += 4;
+		}
+		const size_t nEdges		= 2 * nArcs;
+		const size_t nPots		= sharedEdgePots ? 1 : nEdges;										// the number of the distinct edge potentials
+
+		// ====================================== Graph ======================================
+		size_t res		  = 0;
+		size_t nEdgeSlots = nEdges;																	// the number of the messages
+		switch (graphType)
+		{
+		case GraphType::pairwise: 
+			res += sizeof(CGraphPairwise) + nNodes * (sizeof(ptr_node_t) + sizeof(Node) + nStates * sizeof(float));
+			res += nEdges * (sizeof(ptr_edge_t) + sizeof(Edge) + 2 * sizeof(size_t)) + nPots * potSize;		// the edges are listed in Node::to and Node::from
+			break;
+		case GraphType::csr:
+			res += sizeof(CGraphPairwiseCSR) + nNodes * nStates * sizeof(float) + 2 * (nNodes + 1) * sizeof(size_t);
+			res += nEdges * (4 * sizeof(size_t) + sizeof(dword) + 2) + nPots * potSize;						// end-points, CSR indexes, potential index, group and removal flag
+			break;
+		case GraphType::grid:
+			nEdgeSlots = nNodes * nDirs;
+			res += sizeof(CGraphGrid) + nNodes * nStates * sizeof(float);
+			if (!sharedEdgePots) res += nEdgeSlots * (potSize + 3);											// per-slot potentials, flags and groups
+			break;
+		default: DGM_ASSERT_MSG(false, "The graph type is not pairwise");
+		}
+
+		// ====================================== Inference ======================================
+		const bool ownAdjacency = graphType != GraphType::csr;
+		switch (infer)
+		{
+		case INFER::LBP:
+		case INFER::Viterbi:
+			res += CMessagePassing::estimateMemory(nNodes, nEdgeSlots, nStates, nPots, ownAdjacency);
+			break;
+		case INFER::ResidualBP:
+			res += CMessagePassing::estimateMemory(nNodes, nEdgeSlots, nStates, nPots, ownAdjacency);
+			res += nEdgeSlots * (sizeof(std::pair<float, size_t>) + sizeof(size_t));						// the priority queues and the committed edges
+			break;
+		case INFER::TRW:
+			res += CMessagePassing::estimateMemory(nNodes, nEdgeSlots, nStates, nPots, ownAdjacency);
+			res += nNodes * sizeof(size_t);																	// the wavefronts
+			break;
+		case INFER::GraphCut:
+			res += CMessagePassing::estimateMemory(nNodes, nEdgeSlots, nStates, nPots, ownAdjacency) - 2 * nEdgeSlots * nStates * sizeof(float);	// only the graph view, no messages
+			res += nNodes * nStates * sizeof(float) + nPots * potSize + nArcs * 4 * sizeof(size_t);		// the node energies, the edge energy tables and the pairs of nodes
+			res += nNodes * (sizeof(bool) + sizeof(byte)) + CMaxFlow::estimateMemory(nNodes, nArcs);		// the move, the labeling and the max-flow solver
+			break;
+		default: DGM_ASSERT_MSG(false, "Unknown inference method");
+		}
+		return res;
+	}
+}
@@ -5,11 +5,15 @@
 #include "GraphKit.h"
 
 #include "GraphPairwise.h"
+#include "GraphPairwiseCSR.h"
+#include "GraphGrid.h"
 
 #include "MessagePassing.h"
 #include "InferLBP.h"
+#include "InferResidualBP.h"
 #include "InferTRW.h"
 #include "InferViterbi.h"
+#include "InferGraphCut.h"
 
 #include "GraphPairwiseExt.h"
 
@@ -20,8 +24,10 @@ namespace DirectGraphicalModels
 	/// Types of the inference / decoding objects
 	enum class INFER { 
 		LBP,		///< Loopy Belief Propagation inference
+		ResidualBP,	///< Residual Belief Propagation inference
 		TRW,		///< Convergent Tree-Reweighted inference
-		Viterbi		///< Viterbi inference
+		Viterbi,	///< Viterbi inference
+		GraphCut	///< Alpha-expansion graph-cut decoding
 	};
 
 	// ================================ Pairwise Graph Kit Class ===============================
@@ -36,30 +42,71 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param nStates the number of States (classes)
 		* @param infer
+		* @param graphType Storage of the pairwise graph: GraphType::pairwise (@ref CGraphPairwise), GraphType::csr (@ref CGraphPairwiseCSR) or GraphType::grid (@ref CGraphGrid)
 		*/	
-		DllExport CGraphPairwiseKit(byte nStates, INFER infer = INFER::LBP)
+		DllExport CGraphPairwiseKit(byte nStates, INFER infer = INFER::LBP, GraphType graphType = GraphType::pairwise)
 			: CGraphKit()
-			, m_graph(nStates)
-			, m_graphExtension(m_graph)
 		{
-			switch (infer)
+			switch (graphType)
 			{
-			case INFER::LBP:	 m_pInfer = std::make_unique<CInferLBP>(m_graph); break;
-			case INFER::TRW:	 m_pInfer = std::make_unique<CInferTRW>(m_graph); break;
-			case INFER::Viterbi: m_pInfer = std::make_unique<CInferViterbi>(m_graph); break;
-			default: DGM_ASSERT_MSG(false, "Unknown inference method");
+			case GraphType::pairwise:	m_pGraph = std::make_unique<CGraphPairwise>(nStates); break;
+			case GraphType::csr:		m_pGraph = std::make_unique<CGraphPairwiseCSR>(nStates); break;
+			case GraphType::grid:		m_pGraph = std::make_unique<CGraphGrid>(nStates); break;
+			default: DGM_ASSERT_MSG(false, "The graph type is not pairwise");
 			}
+			
+			m_pInfer = createInfer(infer, *m_pGraph);
+			m_pGraphExtension = std::make_unique<CGraphPairwiseExt>(*m_pGraph);
 		}
 		DllExport virtual ~CGraphPairwiseKit() = default;
+
+		/**
+		* @brief Creates the inference object
+		* @param infer The inference method
+		* @param graph The pairwise graph
+		* @return The inference object for the graph
+		*/
+		DllExport static std::unique_ptr<CMessagePassing> createInfer(INFER infer, IGraphPairwise &graph)
+		{
+			switch (infer)
+			{
+			case INFER::LBP:	 return std::make_unique<CInferLBP>(graph);
+			case INFER::ResidualBP: return std::make_unique<CInferResidualBP>(graph);
+			case INFER::TRW:	 return std::make_unique<CInferTRW>(graph);
+			case INFER::Viterbi: return std::make_unique<CInferViterbi>(graph);
+			case INFER::GraphCut: return std::make_unique<CInferGraphCut>(graph);
+			default: DGM_ASSERT_MSG(false, "Unknown inference method"); return nullptr;
+			}
+		}
+ 
+		/**
+		* @brief Estimates the peak memory of the graph and of the inference
+		* @details The estimation is made before any allocation, thus the jobs may be placed according to the available memory. It assumes a single-layer
+		* 2D grid graph, as built by @ref CGraphPairwiseExt, and counts the graph and the buffers of the inferer, which are allocated during the inference
+		* (ref. CGraph::getMemoryUsage() and CInfer::getMemoryUsage()); the bookkeeping overhead of the heap allocator is not included.
+		* @code
+		* const size_t bytes = CGraphPairwiseKit::estimateMemory(Size(1920, 1080), 6, INFER::TRW, GraphType::csr);
+		* if (bytes < availableBytes) runJob();
+		* @endcode
+		* @param size The size of the grid (image)
+		* @param nStates The number of States (classes)
+		* @param infer The inference method
+		* @param graphType Storage of the pairwise graph: GraphType::pairwise, GraphType::csr or GraphType::grid
+		* @param gType The edge types: a combination of GRAPH_EDGES_GRID and GRAPH_EDGES_DIAG (ref. @ref graphEdgesType)
+		* @param sharedEdgePots Flag indicating whether the edges share their potentials, \a e.g. after CGraphPairwiseExt::addDefaultEdgesModel(float, float). 
+		* If \a false, every edge has its own potential matrix, \a e.g. after CGraphPairwiseExt::addDefaultEdgesModel(const Mat &, float, float)
+		* @return The estimated peak memory in bytes
+		*/
+		DllExport static size_t	estimateMemory(Size size, byte nStates, INFER infer, GraphType graphType = GraphType::pairwise, byte gType = GRAPH_EDGES_GRID, bool sharedEdgePots = true);
  
-		DllExport CGraph&		getGraph() override { return m_graph; }
+		DllExport CGraph&		getGraph() override { return *m_pGraph; }
 		DllExport CInfer&		getInfer() override { return *m_pInfer; }
-		DllExport CGraphExt&	getGraphExt() override { return m_graphExtension; }
+		DllExport CGraphExt&	getGraphExt() override { return *m_pGraphExtension; }
 
 
 	private:
-		CGraphPairwise						m_graph;				///< Pairwise graph
+		std::unique_ptr<IGraphPairwise>		m_pGraph;				///< Pairwise graph
 		std::unique_ptr<CMessagePassing>	m_pInfer;				///< Inferer for pairwise graphs
-		CGraphPairwiseExt					m_graphExtension;		///< Pairwise graph extension
+		std::unique_ptr<CGraphPairwiseExt>	m_pGraphExtension;		///< Pairwise graph extension
 	};
 }
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include "GraphReorder.h"
+#include "parallel.h"
+#include "macroses.h"
+#include <numeric>
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Returns the index of the point with the 16-bit coordinates (x, y) along the Hilbert curve
+		uint64_t getHilbertIndex(uint32_t x, uint32_t y)
+		{
+			const uint32_t N = 1 << 16;
+			uint64_t res = 0;
+			for (uint32_t s = N / 2; s > 0; s /= 2) {
+				const uint32_t rx = (x & s) ? 1 : 0;
+				const uint32_t ry = (y & s) ? 1 : 0;
+				res += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+				if (ry == 0) {										// rotation of the quadrant
+					if (rx == 1) {
+						x = N - 1 - x;
+						y = N - 1 - y;
+					}
+					std::swap(x, y);
+				}
+			}
+			return res;
+		}
+	}
+
+	// Constructor
+	CGraphReorder::CGraphReorder(const IGraphPairwise &graph, ReorderMethod method, const Mat &coordinates)
+	{
+		const size_t nNodes = graph.getNumNodes();
+		const std::vector<vec_size_t> vAdj = getAdjacency(graph);
+		switch (method) {
+			case ReorderMethod::RCM:
+				m_vOrder = getOrderRCM(vAdj);
+				break;
+			case ReorderMethod::hilbert:
+				DGM_ASSERT_MSG(coordinates.rows == static_cast<int>(nNodes) && coordinates.cols == 2 && coordinates.type() == CV_32FC1,
+					"The coordinates must be a Mat(size: %zu x 2; type: CV_32FC1)", nNodes);
+				m_vOrder = getOrderHilbert(coordinates);
+				break;
+		}
+		m_vNewId.resize(nNodes);
+		for (size_t n = 0; n < nNodes; n++) m_vNewId[m_vOrder[n]] = n;
+
+		// Index distances between the neighbours
+		size_t nEdges = 0;
+		for (size_t n = 0; n < nNodes; n++)
+			for (size_t a : vAdj[n]) {
+				if (a < n) continue;
+				const size_t spanBefore = a - n;
+				const size_t spanAfter	= m_vNewId[a] > m_vNewId[n] ? m_vNewId[a] - m_vNewId[n] : m_vNewId[n] - m_vNewId[a];
+				m_stats.bandwidthBefore = MAX(m_stats.bandwidthBefore, spanBefore);
+				m_stats.bandwidthAfter	= MAX(m_stats.bandwidthAfter, spanAfter);
+				m_stats.meanSpanBefore += spanBefore;
+				m_stats.meanSpanAfter  += spanAfter;
+				if (spanBefore > FAR_DISTANCE) m_stats.nFarBefore++;
+				if (spanAfter > FAR_DISTANCE)  m_stats.nFarAfter++;
+				nEdges++;
+			}
+		if (nEdges) {
+			m_stats.meanSpanBefore /= nEdges;
+			m_stats.meanSpanAfter  /= nEdges;
+		}
+	}
+
+	void CGraphReorder::apply(const IGraphPairwise &src, IGraphPairwise &dst) const
+	{
+		const byte		nStates = src.getNumStates();
+		const size_t	nNodes	= src.getNumNodes();
+		DGM_ASSERT_MSG(nNodes == m_vOrder.size(), "The number of nodes (%zu) does not match the reordering (%zu)", nNodes, m_vOrder.size());
+		DGM_ASSERT_MSG(dst.getNumStates() == nStates, "The number of states (%d) does not match (%d)", dst.getNumStates(), nStates);
+		DGM_ASSERT_MSG(dst.getNumNodes() == 0, "The destination graph must be empty");
+
+		// ======================================== Nodes ========================================
+		Mat pots(static_cast<int>(nNodes), nStates, CV_32FC1);
+		parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range &range) {
+			for (int n = range.start; n < range.end; n++) {
+				const span<const float> pot = src.getNodeView(m_vOrder[n]);
+				std::copy(pot.begin(), pot.end(), pots.ptr<float>(n));
+			}
+		}, 1024);
+		dst.addNodes(pots);
+
+		// ======================================== Edges ========================================
+		struct Edge { size_t src; size_t dst; size_t callerSrc; size_t callerDst; byte group; };
+		std::vector<Edge> vEdges;
+		vEdges.reserve(src.getNumEdges());
+		vec_size_t vChilds;
+		for (size_t n = 0; n < nNodes; n++) {
+			src.getChildNodes(n, vChilds);
+			for (size_t c : vChilds) vEdges.push_back({ m_vNewId[n], m_vNewId[c], n, c, src.getEdgeGroup(n, c) });
+		}
+		std::sort(vEdges.begin(), vEdges.end(), [](const Edge &a, const Edge &b) { return a.src < b.src || (a.src == b.src && a.dst < b.dst); });
+
+		Mat			edges(static_cast<int>(vEdges.size()), 2, CV_32SC1);
+		vec_byte_t	vGroups(vEdges.size());
+		for (size_t e = 0; e < vEdges.size(); e++) {
+			edges.at<int>(static_cast<int>(e), 0) = static_cast<int>(vEdges[e].src);
+			edges.at<int>(static_cast<int>(e), 1) = static_cast<int>(vEdges[e].dst);
+			vGroups[e] = vEdges[e].group;
+		}
+		dst.addEdges(edges, vGroups);
+
+		// The potential, shared by all the edges of a group, is set once for the group
+		std::vector<span<const float>>	vViews(vEdges.size());
+		std::vector<const float *>		vGroupPot(256, NULL);
+		vec_bool_t						vShared(256, true);
+		for (size_t e = 0; e < vEdges.size(); e++) {
+			vViews[e] = src.getEdgeView(vEdges[e].callerSrc, vEdges[e].callerDst);
+			const byte group = vEdges[e].group;
+			if (vViews[e].empty()) vShared[group] = false;
+			else if (!vGroupPot[group]) vGroupPot[group] = vViews[e].data();
+			else if (vGroupPot[group] != vViews[e].data()) vShared[group] = false;
+		}
+		for (size_t g = 0; g < 256; g++)
+			if (vShared[g] && vGroupPot[g]) dst.setEdges(static_cast<byte>(g), Mat(nStates, nStates, CV_32FC1, const_cast<float *>(vGroupPot[g])));
+
+		// The individual potentials
+		Mat pot;
+		for (size_t e = 0; e < vEdges.size(); e++) {
+			const Edge &edge = vEdges[e];
+			if (vShared[edge.group] && vGroupPot[edge.group]) continue;
+			if (!vViews[e].empty()) {
+				dst.setEdge(edge.src, edge.dst, Mat(nStates, nStates, CV_32FC1, const_cast<float *>(vViews[e].data())));
+				continue;
+			}
+			src.getEdge(edge.callerSrc, edge.callerDst, pot);
+			if (pot.empty()) continue;
+
+			// The compact Potts potentials are kept compact
+			const float diag	= pot.at<float>(0, 0);
+			const float offDiag = nStates > 1 ? pot.at<float>(0, 1) : 0;
+			bool isPotts = true;
+			for (byte x = 0; x < nStates && isPotts; x++)
+				for (byte y = 0; y < nStates; y++)
+					if (pot.at<float>(x, y) != (x == y ? diag : offDiag)) { isPotts = false; break; }
+			if (isPotts) dst.setEdgePotts(edge.src, edge.dst, diag, offDiag);
+			else dst.setEdge(edge.src, edge.dst, pot);
+		}
+	}
+
+	vec_byte_t CGraphReorder::toCallerOrder(const vec_byte_t &vLabels) const
+	{
+		DGM_ASSERT_MSG(vLabels.size() == m_vOrder.size(), "The number of labels (%zu) does not match the number of nodes (%zu)", vLabels.size(), m_vOrder.size());
+		vec_byte_t res(vLabels.size());
+		for (size_t n = 0; n < vLabels.size(); n++) res[m_vOrder[n]] = vLabels[n];
+		return res;
+	}
+
+	Mat CGraphReorder::toCallerOrder(const Mat &rows) const
+	{
+		DGM_ASSERT_MSG(rows.rows == static_cast<int>(m_vOrder.size()), "The number of rows (%d) does not match the number of nodes (%zu)", rows.rows, m_vOrder.size());
+		Mat res(rows.size(), rows.type());
+		for (int n = 0; n < rows.rows; n++) rows.row(n).copyTo(res.row(static_cast<int>(m_vOrder[n])));
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	std::vector<vec_size_t> CGraphReorder::getAdjacency(const IGraphPairwise &graph)
+	{
+		const size_t nNodes = graph.getNumNodes();
+		std::vector<vec_size_t> res(nNodes);
+		vec_size_t vChilds;
+		for (size_t n = 0; n < nNodes; n++) {
+			graph.getChildNodes(n, vChilds);
+			for (size_t c : vChilds)
+				if (c != n) {
+					res[n].push_back(c);
+					res[c].push_back(n);
+				}
+		}
+		parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range &range) {
+			for (int n = range.start; n < range.end; n++) {
+				std::sort(res[n].begin(), res[n].end());
+				res[n].erase(std::unique(res[n].begin(), res[n].end()), res[n].end());
+			}
+		}, 1024);
+		return res;
+	}
+
+	vec_size_t CGraphReorder::getOrderRCM(const std::vector<vec_size_t> &vAdj)
+	{
+		const size_t nNodes = vAdj.size();
+		auto byDegree = [&](size_t a, size_t b) { return vAdj[a].size() < vAdj[b].size(); };
+
+		// Breadth-first search in the component of the root; returns the depth and the node of the minimal degree in the last level
+		std::vector<int>	vLevel(nNodes, -1);
+		vec_size_t			vQueue;
+		vQueue.reserve(nNodes);
+		auto getDepth = [&](size_t root, size_t &last) {
+			vQueue.assign(1, root);
+			vLevel[root] = 0;
+			for (size_t i = 0; i < vQueue.size(); i++)
+				for (size_t a : vAdj[vQueue[i]])
+					if (vLevel[a] < 0) {
+						vLevel[a] = vLevel[vQueue[i]] + 1;
+						vQueue.push_back(a);
+					}
+			const int depth = vLevel[vQueue.back()];
+			last = vQueue.back();
+			for (size_t v : vQueue) {
+				if (vLevel[v] == depth && vAdj[v].size() < vAdj[last].size()) last = v;
+				vLevel[v] = -1;
+			}
+			return depth;
+		};
+
+		// The components start from the nodes of the minimal degree
+		vec_size_t vStarts(nNodes);
+		std::iota(vStarts.begin(), vStarts.end(), 0);
+		std::stable_sort(vStarts.begin(), vStarts.end(), byDegree);
+
+		vec_size_t	res;
+		vec_size_t	vNeighbours;
+		vec_bool_t	vVisited(nNodes, false);
+		res.reserve(nNodes);
+		for (size_t start : vStarts) {
+			if (vVisited[start]) continue;
+
+			// Pseudo-peripheral root after George and Liu
+			size_t	root	= start;
+			size_t	candidate;
+			int		depth	= getDepth(root, candidate);
+			for (int k = 0; k < 8; k++) {
+				size_t next;
+				const int d = getDepth(candidate, next);
+				if (d <= depth) break;
+				root		= candidate;
+				depth		= d;
+				candidate	= next;
+			}
+
+			// Cuthill-McKee: the neighbours are visited in the order of increasing degree
+			const size_t first = res.size();
+			res.push_back(root);
+			vVisited[root] = true;
+			for (size_t i = first; i < res.size(); i++) {
+				vNeighbours.clear();
+				for (size_t a : vAdj[res[i]])
+					if (!vVisited[a]) {
+						vVisited[a] = true;
+						vNeighbours.push_back(a);
+					}
+				std::stable_sort(vNeighbours.begin(), vNeighbours.end(), byDegree);
+				res.insert(res.end(), vNeighbours.begin(), vNeighbours.end());
+			}
+		}
+		std::reverse(res.begin(), res.end());
+		return res;
+	}
+
+	vec_size_t CGraphReorder::getOrderHilbert(const Mat &coordinates)
+	{
+		const size_t nNodes = coordinates.rows;
+		double minX = 0, maxX = 0, minY = 0, maxY = 0;
+		if (nNodes) {
+			minMaxLoc(coordinates.col(0), &minX, &maxX);
+			minMaxLoc(coordinates.col(1), &minY, &maxY);
+		}
+		const double scaleX = maxX > minX ? 65535 / (maxX - minX) : 0;
+		const double scaleY = maxY > minY ? 65535 / (maxY - minY) : 0;
+
+		std::vector<std::pair<uint64_t, size_t>> vKeys(nNodes);
+		for (size_t n = 0; n < nNodes; n++) {
+			const float *pCoord = coordinates.ptr<float>(static_cast<int>(n));
+			const uint32_t x = static_cast<uint32_t>((pCoord[0] - minX) * scaleX);
+			const uint32_t y = static_cast<uint32_t>((pCoord[1] - minY) * scaleY);
+			vKeys[n] = { getHilbertIndex(x, y), n };
+		}
+		std::sort(vKeys.begin(), vKeys.end());
+
+		vec_size_t res(nNodes);
+		for (size_t n = 0; n < nNodes; n++) res[n] = vKeys[n].second;
+		return res;
+	}
+}
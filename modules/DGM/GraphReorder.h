@@ -0,0 +1,112 @@
+// Locality-improving node reordering class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "IGraphPairwise.h"
+
+namespace DirectGraphicalModels
+{
+	/// Methods of the node reordering
+	enum class ReorderMethod {
+		RCM,			///< Reverse Cuthill-McKee ordering: breadth-first search from a peripheral node, which reduces the bandwidth of the adjacency matrix
+		hilbert			///< Order of the node coordinates along the Hilbert space-filling curve
+	};
+
+	/// Statistics of the node reordering (ref. CGraphReorder::getStats())
+	struct ReorderStats {
+		size_t	bandwidthBefore = 0;	///< The maximal index distance between two neighbouring nodes in the caller's numbering
+		size_t	bandwidthAfter	= 0;	///< The maximal index distance between two neighbouring nodes in the new numbering
+		double	meanSpanBefore	= 0;	///< The mean index distance between the nodes of an edge in the caller's numbering
+		double	meanSpanAfter	= 0;	///< The mean index distance between the nodes of an edge in the new numbering
+		size_t	nFarBefore		= 0;	///< The number of the edges, which nodes are farther apart than CGraphReorder::FAR_DISTANCE in the caller's numbering
+		size_t	nFarAfter		= 0;	///< The number of the edges, which nodes are farther apart than CGraphReorder::FAR_DISTANCE in the new numbering
+	};
+
+	// ============================= Graph Reorder Class =============================
+	/**
+	* @ingroup moduleGraph
+	* @brief Locality-improving renumbering of the graph nodes
+	* @details The node indices of the graphs, built with IGraphPairwise::addNode() and IGraphPairwise::addEdge(), follow the order of the insertion,
+	* thus the potentials and the messages of the neighbouring nodes may be scattered over the memory. This class finds a new numbering, where the neighbours
+	* have close indices, and copies the graph in the new order: the nodes are renumbered and the edges are sorted by their new source and destination nodes.
+	* The edge groups and the potentials, shared by whole groups (ref. IGraphPairwise::setEdges()), are preserved. The results of the inference on the
+	* reordered graph are mapped back to the caller's numbering:
+	* @code
+	* CGraphReorder reorder(graph);
+	* CGraphPairwise graphReordered(nStates);
+	* reorder.apply(graph, graphReordered);
+	* vec_byte_t solution = reorder.toCallerOrder(CInferLBP(graphReordered).decode(100));
+	* printf("Far edges: %zu -> %zu\n", reorder.getStats().nFarBefore, reorder.getStats().nFarAfter);
+	* @endcode
+	* The hardware cache misses are not measurable portably, thus the statistics (ref. @ref ReorderStats) report the index distances between the neighbours,
+	* which the cache misses of the message passing grow with.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGraphReorder
+	{
+	public:
+		/// The index distance, starting from which the node potentials of \a nStates = 8 do not fit into one 4 KB page
+		static const size_t FAR_DISTANCE = 128;
+
+		/**
+		* @brief Constructor
+		* @details Finds the new numbering of the nodes of the graph
+		* @param graph The graph
+		* @param method The method of the reordering
+		* @param coordinates The coordinates of the nodes for the ReorderMethod::hilbert method: Mat(size: nNodes x 2; type: CV_32FC1)
+		*/
+		DllExport CGraphReorder(const IGraphPairwise &graph, ReorderMethod method = ReorderMethod::RCM, const Mat &coordinates = EmptyMat);
+		DllExport ~CGraphReorder(void) = default;
+
+		/**
+		* @brief Copies the graph in the new order
+		* @param src The graph, which was given to the constructor
+		* @param dst The empty graph with the same number of states, which receives the reordered nodes and edges
+		*/
+		DllExport void				apply(const IGraphPairwise &src, IGraphPairwise &dst) const;
+		/**
+		* @brief Returns the new index of a node
+		* @param callerId The index of the node in the caller's numbering
+		* @return The index of the node in the reordered graph
+		*/
+		DllExport size_t			getNewId(size_t callerId) const { return m_vNewId[callerId]; }
+		/**
+		* @brief Returns the caller's index of a node
+		* @param newId The index of the node in the reordered graph
+		* @return The index of the node in the caller's numbering
+		*/
+		DllExport size_t			getCallerId(size_t newId) const { return m_vOrder[newId]; }
+		/**
+		* @brief Maps the configuration of the reordered graph to the caller's numbering
+		* @param vLabels The states of the nodes of the reordered graph
+		* @return The states of the nodes in the caller's numbering
+		*/
+		DllExport vec_byte_t		toCallerOrder(const vec_byte_t &vLabels) const;
+		/**
+		* @brief Maps the per-node rows (\a e.g. the marginals) of the reordered graph to the caller's numbering
+		* @param rows The rows of the nodes of the reordered graph: Mat(size: nNodes x any)
+		* @return The rows of the nodes in the caller's numbering
+		*/
+		DllExport Mat				toCallerOrder(const Mat &rows) const;
+		/**
+		* @brief Returns the statistics of the reordering
+		* @return The index distances between the neighbouring nodes before and after the reordering (Ref. @ref ReorderStats)
+		*/
+		DllExport const ReorderStats &getStats(void) const { return m_stats; }
+
+
+	private:
+		// Returns the undirected adjacency lists of the graph without the self-loops
+		static std::vector<vec_size_t>	getAdjacency(const IGraphPairwise &graph);
+		// Reverse Cuthill-McKee ordering
+		static vec_size_t				getOrderRCM(const std::vector<vec_size_t> &vAdj);
+		// Ordering along the Hilbert curve
+		static vec_size_t				getOrderHilbert(const Mat &coordinates);
+
+
+	private:
+		vec_size_t		m_vOrder;		///< The caller's index of every new node
+		vec_size_t		m_vNewId;		///< The new index of every caller's node
+		ReorderStats	m_stats;		///< The statistics of the reordering
+	};
+}
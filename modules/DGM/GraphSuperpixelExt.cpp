@@ -0,0 +1,326 @@
+#include "GraphSuperpixelExt.h"
+#include "IGraphPairwise.h"
+#include "EdgePotentials.h"
+#include "TrainEdgePottsCS.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		const int BAND_HEIGHT = 64;							// the number of rows of the label image, scanned by one task
+
+		// Returns the key of the unordered pair of regions
+		inline uint64_t getKey(int a, int b)
+		{
+			return a < b ? (static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b) : (static_cast<uint64_t>(b) << 32) | static_cast<uint32_t>(a);
+		}
+	}
+
+	void CGraphSuperpixelExt::buildGraph(const Mat &labels)
+	{
+		DGM_PROFILE_ZONE("buildGraph");
+		// Assertions
+		DGM_ASSERT(!labels.empty());
+		DGM_ASSERT_MSG(labels.type() == CV_32SC1, "The label image has either wrong depth or more than one channel");
+		double maxVal;
+		minMaxLoc(labels, NULL, &maxVal);
+
+		m_labels	= labels;
+		m_nRegions	= maxVal >= 0 ? static_cast<size_t>(maxVal) + 1 : 0;
+
+		// One scan of the label image: the sizes of the regions, which occur in the band, and the sorted boundary pixel pairs with their counts, independently for every band
+		struct Band {
+			std::vector<std::pair<int, size_t>>			vSizes;
+			std::vector<std::pair<uint64_t, size_t>>	vBoundaries;
+		};
+		const int nBands = (labels.rows + BAND_HEIGHT - 1) / BAND_HEIGHT;
+		std::vector<Band> vBands(nBands);
+		parallel::parallelFor(Range(0, nBands), [&](const Range &range) {
+			std::vector<std::pair<int, size_t>>	vRuns;
+			std::vector<uint64_t>				vKeys;
+			for (int b = range.start; b < range.end; b++) {
+				Band &band = vBands[b];
+				vRuns.clear();
+				vKeys.clear();
+				for (int y = b * BAND_HEIGHT; y < MIN((b + 1) * BAND_HEIGHT, labels.rows); y++) {
+					const int *pLabel = labels.ptr<int>(y);
+					const int *pNext  = y + 1 < labels.rows ? labels.ptr<int>(y + 1) : NULL;
+					for (int x = 0; x < labels.cols; x++) {
+						if (pLabel[x] < 0) continue;										// excluded pixel
+						if (x > 0 && pLabel[x - 1] == pLabel[x]) vRuns.back().second++;
+						else vRuns.emplace_back(pLabel[x], 1);
+						if (x + 1 < labels.cols && pLabel[x + 1] != pLabel[x] && pLabel[x + 1] >= 0)	vKeys.push_back(getKey(pLabel[x], pLabel[x + 1]));
+						if (pNext && pNext[x] != pLabel[x] && pNext[x] >= 0)							vKeys.push_back(getKey(pLabel[x], pNext[x]));
+					} // x
+				} // y
+				std::sort(vRuns.begin(), vRuns.end());
+				band.vSizes.clear();
+				for (const auto &run : vRuns) {
+					if (band.vSizes.empty() || band.vSizes.back().first != run.first) band.vSizes.emplace_back(run.first, 0);
+					band.vSizes.back().second += run.second;
+				}
+				std::sort(vKeys.begin(), vKeys.end());
+				for (size_t i = 0; i < vKeys.size(); i++) {
+					if (band.vBoundaries.empty() || band.vBoundaries.back().first != vKeys[i]) band.vBoundaries.emplace_back(vKeys[i], 0);
+					band.vBoundaries.back().second++;
+				}
+			} // b
+		}, 1);
+
+		// Merging the bands
+		m_vRegionSizes.assign(m_nRegions, 0);
+		m_vvBandRegions.assign(nBands, vec_int_t());
+		std::vector<std::pair<uint64_t, size_t>> vBoundaries;
+		for (int b = 0; b < nBands; b++) {
+			const Band &band = vBands[b];
+			m_vvBandRegions[b].reserve(band.vSizes.size());
+			for (const auto &size : band.vSizes) {
+				m_vRegionSizes[size.first] += size.second;
+				m_vvBandRegions[b].push_back(size.first);
+			}
+			vBoundaries.insert(vBoundaries.end(), band.vBoundaries.begin(), band.vBoundaries.end());
+		}
+		vBands.clear();
+		std::sort(vBoundaries.begin(), vBoundaries.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+		m_vBoundaryLengths.clear();
+		std::vector<uint64_t> vArcKeys;
+		for (const auto &boundary : vBoundaries) {
+			if (vArcKeys.empty() || vArcKeys.back() != boundary.first) {
+				vArcKeys.push_back(boundary.first);
+				m_vBoundaryLengths.push_back(0);
+			}
+			m_vBoundaryLengths.back() += boundary.second;
+		}
+
+		// Emitting the nodes and edges in bulk
+		const size_t	nArcs	= vArcKeys.size();
+		const byte		nStates = m_graph.getNumStates();
+		m_arcs = Mat(static_cast<int>(nArcs), 2, CV_32SC1);
+		Mat edges(static_cast<int>(2 * nArcs), 2, CV_32SC1);
+		for (size_t a = 0; a < nArcs; a++) {
+			const int src = static_cast<int>(vArcKeys[a] >> 32);
+			const int dst = static_cast<int>(vArcKeys[a] & 0xFFFFFFFF);
+			m_arcs.at<int>(static_cast<int>(a), 0) = src;
+			m_arcs.at<int>(static_cast<int>(a), 1) = dst;
+			edges.at<int>(static_cast<int>(2 * a), 0)		= src;
+			edges.at<int>(static_cast<int>(2 * a), 1)		= dst;
+			edges.at<int>(static_cast<int>(2 * a + 1), 0)	= dst;
+			edges.at<int>(static_cast<int>(2 * a + 1), 1)	= src;
+		}
+
+		if (m_graph.getNumNodes() != 0) m_graph.reset();
+		if (m_nRegions) m_graph.addNodes(Mat(static_cast<int>(m_nRegions), nStates, CV_32FC1, Scalar(100.0f / nStates)));
+		if (nArcs) m_graph.addEdges(edges);
+	}
+
+	void CGraphSuperpixelExt::buildGraph(Size graphSize)
+	{
+		DGM_ASSERT_MSG(!m_labels.empty(), "The label image is not set. Use CGraphSuperpixelExt::buildGraph(const Mat &) function instead.");
+		DGM_ASSERT_MSG(graphSize == m_labels.size(), "The size of the graph (%d x %d) does not correspond to the size of the label image (%d x %d)",
+			graphSize.width, graphSize.height, m_labels.cols, m_labels.rows);
+		const Mat labels = m_labels;
+		buildGraph(labels);
+	}
+
+	void CGraphSuperpixelExt::setGraph(const Mat &pots)
+	{
+		DGM_PROFILE_ZONE("setGraph");
+		// Assertions
+		DGM_ASSERT(!pots.empty());
+		DGM_ASSERT(CV_32F == pots.depth());
+		DGM_ASSERT_MSG(!m_labels.empty(), "The graph is not built");
+		if (m_graph.getNumNodes() != m_nRegions) buildGraph(m_labels.size());
+
+		const byte nStates = m_graph.getNumStates();
+		DGM_ASSERT(pots.channels() == nStates);
+
+		if (pots.size() == m_labels.size()) {							// the pixel-wise potentials
+			const std::vector<double> vSums = accumulate(pots);
+			Mat regionPots(static_cast<int>(m_nRegions), nStates, CV_32FC1);
+			for (size_t r = 0; r < m_nRegions; r++) {
+				float *pPot = regionPots.ptr<float>(static_cast<int>(r));
+				for (byte s = 0; s < nStates; s++)
+					pPot[s] = m_vRegionSizes[r] ? static_cast<float>(vSums[r * nStates + s] / m_vRegionSizes[r]) : 100.0f / nStates;
+			}
+			m_graph.setNodes(0, regionPots);
+		}
+		else {															// the region potentials
+			DGM_ASSERT_MSG(pots.total() == m_nRegions, "The number of potentials (%zu) does not correspond to the number of regions (%zu)", pots.total(), m_nRegions);
+			m_graph.setNodes(0, (pots.isContinuous() ? pots : pots.clone()).reshape(1, static_cast<int>(m_nRegions)));
+		}
+	}
+
+	void CGraphSuperpixelExt::addDefaultEdgesModel(float val, float weight)
+	{
+		if (weight != 1.0f) val = powf(val, weight);
+		fillArcs(Mat(), val, weight);
+	}
+
+	void CGraphSuperpixelExt::addDefaultEdgesModel(const Mat &featureVectors, float val, float weight)
+	{
+		fillArcs(getRegionFeatures(featureVectors), val, weight);
+	}
+
+	void CGraphSuperpixelExt::addDefaultEdgesModel(const vec_mat_t &featureVectors, float val, float weight)
+	{
+		Mat fv;
+		merge(featureVectors, fv);
+		addDefaultEdgesModel(fv, val, weight);
+	}
+
+	Mat CGraphSuperpixelExt::getRegionFeatures(const Mat &featureVectors) const
+	{
+		DGM_ASSERT(featureVectors.depth() == CV_8U);
+		const int nFeatures = featureVectors.channels();
+		const std::vector<double> vSums = accumulate(featureVectors);
+
+		Mat res(1, static_cast<int>(m_nRegions), CV_8UC(nFeatures), Scalar(0));
+		byte *pRes = res.ptr<byte>(0);
+		for (size_t r = 0; r < m_nRegions; r++)
+			if (m_vRegionSizes[r])
+				for (int f = 0; f < nFeatures; f++)
+					pRes[r * nFeatures + f] = static_cast<byte>(MIN(255.0, vSums[r * nFeatures + f] / m_vRegionSizes[r] + 0.5));
+		return res;
+	}
+
+	Mat CGraphSuperpixelExt::getPixelSolution(const vec_byte_t &solution, byte excluded) const
+	{
+		DGM_ASSERT_MSG(solution.size() == m_nRegions, "The size of the solution (%zu) does not correspond to the number of regions (%zu)", solution.size(), m_nRegions);
+		Mat res(m_labels.size(), CV_8UC1);
+		parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				const int *pLabel = m_labels.ptr<int>(y);
+				byte	  *pRes	  = res.ptr<byte>(y);
+				for (int x = 0; x < res.cols; x++) pRes[x] = pLabel[x] < 0 ? excluded : solution[pLabel[x]];
+			}
+		});
+		return res;
+	}
+
+	// The valid pixels are numbered in the row-major order: every row starts with the number of valid pixels above it
+	Mat CGraphSuperpixelExt::getPixelLabels(const Mat &mask)
+	{
+		DGM_ASSERT_MSG(mask.type() == CV_8UC1, "The mask has either wrong depth or more than one channel");
+		vec_int_t vOffsets(mask.rows + 1, 0);
+		for (int y = 0; y < mask.rows; y++) vOffsets[y + 1] = vOffsets[y] + countNonZero(mask.row(y));
+
+		Mat res(mask.size(), CV_32SC1);
+		parallel::parallelFor(Range(0, mask.rows), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				const byte	*pMask	= mask.ptr<byte>(y);
+				int			*pRes	= res.ptr<int>(y);
+				int			 label	= vOffsets[y];
+				for (int x = 0; x < mask.cols; x++) pRes[x] = pMask[x] ? label++ : -1;
+			}
+		});
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	std::vector<double> CGraphSuperpixelExt::accumulate(const Mat &src) const
+	{
+		DGM_ASSERT_MSG(src.size() == m_labels.size(), "The size of the image (%d x %d) does not correspond to the size of the label image (%d x %d)",
+			src.cols, src.rows, m_labels.cols, m_labels.rows);
+		DGM_ASSERT(src.depth() == CV_8U || src.depth() == CV_32F);
+		const int n = src.channels();
+
+		// The sums of every band are accumulated only for the regions, which occur in it (ref. m_vvBandRegions)
+		const int nBands = static_cast<int>(m_vvBandRegions.size());
+		std::vector<std::vector<double>> vvSums(nBands);
+		parallel::parallelFor(Range(0, nBands), [&](const Range &range) {
+			for (int b = range.start; b < range.end; b++) {
+				const vec_int_t		&vRegions	= m_vvBandRegions[b];
+				std::vector<double> &vSums		= vvSums[b];
+				vSums.assign(vRegions.size() * n, 0);
+				for (int y = b * BAND_HEIGHT; y < MIN((b + 1) * BAND_HEIGHT, src.rows); y++) {
+					const int *pLabel	= m_labels.ptr<int>(y);
+					int		   label	= -1;
+					double	  *pSum		= NULL;
+					for (int x = 0; x < src.cols; x++) {
+						if (pLabel[x] < 0) continue;										// excluded pixel
+						if (pLabel[x] != label) {
+							label = pLabel[x];
+							pSum  = vSums.data() + (std::lower_bound(vRegions.begin(), vRegions.end(), label) - vRegions.begin()) * n;
+						}
+						if (src.depth() == CV_8U) {
+							const byte *pSrc = src.ptr<byte>(y) + x * n;
+							for (int c = 0; c < n; c++) pSum[c] += pSrc[c];
+						}
+						else {
+							const float *pSrc = src.ptr<float>(y) + x * n;
+							for (int c = 0; c < n; c++) pSum[c] += pSrc[c];
+						}
+					} // x
+				} // y
+			} // b
+		}, 1);
+
+		std::vector<double> res(m_nRegions * n, 0);
+		for (int b = 0; b < nBands; b++) {
+			const vec_int_t &vRegions = m_vvBandRegions[b];
+			for (size_t i = 0; i < vRegions.size(); i++)
+				for (int c = 0; c < n; c++) res[vRegions[i] * n + c] += vvSums[b][i * n + c];
+		}
+		return res;
+	}
+
+	void CGraphSuperpixelExt::fillArcs(const Mat &regionFeatures, float val, float weight)
+	{
+		DGM_PROFILE_ZONE("fillEdges");
+		const byte	nStates = m_graph.getNumStates();
+		const int	nArcs	= m_arcs.rows;
+		DGM_ASSERT_MSG(m_graph.getNumNodes() == m_nRegions, "The graph is not built");
+		if (nArcs == 0) return;
+
+		double meanLength = 0;
+		for (size_t len : m_vBoundaryLengths) meanLength += len;
+		meanLength /= nArcs;
+
+		// The contrast-sensitive potentials of all the arcs at once
+		Mat pots;
+		if (!regionFeatures.empty()) {
+			const word nFeatures = static_cast<word>(regionFeatures.channels());
+			const CTrainEdgePottsCS edgeTrainer(nStates, nFeatures);
+			const Mat fm = regionFeatures.reshape(1, static_cast<int>(m_nRegions));		// Mat(size: nRegions x nFeatures)
+			Mat fm1(nArcs, nFeatures, CV_8UC1);
+			Mat fm2(nArcs, nFeatures, CV_8UC1);
+			for (int a = 0; a < nArcs; a++) {
+				fm.row(m_arcs.at<int>(a, 0)).copyTo(fm1.row(a));
+				fm.row(m_arcs.at<int>(a, 1)).copyTo(fm2.row(a));
+			}
+			edgeTrainer.getEdgePotentials(fm1, fm2, { val, 0.001f }, pots, weight);
+		}
+
+		parallel::parallelFor(Range(0, nArcs), [&](const Range &range) {
+			Mat pot(nStates, nStates, CV_32FC1);
+			Mat potT;
+			for (int a = range.start; a < range.end; a++) {
+				const size_t src		= m_arcs.at<int>(a, 0);
+				const size_t dst		= m_arcs.at<int>(a, 1);
+				const float  exponent	= static_cast<float>(0.5 * m_vBoundaryLengths[a] / meanLength);	// the square root as in IGraphPairwise::setArc()
+
+				if (pots.empty()) {
+					const float diag = powf(val, exponent);
+					m_graph.setEdgePotts(src, dst, diag, 1.0f);
+					m_graph.setEdgePotts(dst, src, diag, 1.0f);
+					continue;
+				}
+
+				const float *pPot	= pots.ptr<float>(a);
+				float		*pDst	= pot.ptr<float>(0);
+				for (int i = 0; i < nStates * nStates; i++) pDst[i] = powf(pPot[i], exponent);
+				if (isPotts(pDst, nStates)) {
+					m_graph.setEdgePotts(src, dst, pDst[0], pDst[1]);
+					m_graph.setEdgePotts(dst, src, pDst[0], pDst[1]);
+					continue;
+				}
+				transpose(pot, potT);
+				m_graph.setEdge(src, dst, pot);
+				m_graph.setEdge(dst, src, potT);
+			} // a
+		});
+	}
+}
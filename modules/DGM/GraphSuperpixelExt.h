@@ -0,0 +1,162 @@
+// Extended (pairwise) Superpixel Graph class interface;
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphExt.h"
+
+namespace DirectGraphicalModels
+{
+	class IGraphPairwise;
+
+	// ================================ Extended Superpixel Graph Class ================================
+	/**
+	* @brief Extended Pairwise graph class for 2D image classifaction over superpixels
+	* @ingroup moduleGraphExt
+	* @details This graph class builds the region adjacency graph from a label image, \a e.g. the result of the SLIC superpixel segmentation: every region
+	* becomes a node, and every pair of 4-connected regions becomes an arc. The adjacency, the boundary lengths and the region sizes are computed in one
+	* parallel scan of the label image, and the nodes and edges are added to the graph in bulk with CGraph::addNodes() and IGraphPairwise::addEdges().
+	* Since the region adjacency is unique by construction, the @ref CGraphPairwiseCSR graph, which does not check the uniqueness of the edges, is the
+	* preferable target.
+	*
+	* The pixels with negative labels are excluded from the graph. This allows for skipping the no-data or masked regions of a tile: with the labels, returned by 
+	* getPixelLabels(), every valid pixel becomes a node, connected with its valid 4-neighbors, so the classification, the graph and the inference scale with the valid area:
+	* @code
+	* graphExt.buildGraph(CGraphSuperpixelExt::getPixelLabels(mask));						// mask: Mat(type: CV_8UC1), non-zero for the valid pixels
+	* graphExt.setGraph(nodeTrainer.getNodePotentials(fv, Mat(), 0.0f, mask));
+	* graphExt.addDefaultEdgesModel(fv, 100.0f);
+	* Mat solution = graphExt.getPixelSolution(CInferLBP(graph).decode(100), 255);			// the masked pixels are set to 255
+	* @endcode
+	*
+	* The pixel-wise node potentials and features are averaged over the regions. Along each arc, the edge potential is powered by the ratio of its boundary
+	* length to the mean boundary length, so that the long boundaries have more influence than the short ones:
+	* @code
+	* CGraphPairwiseCSR		graph(nStates);
+	* CGraphSuperpixelExt	graphExt(graph);
+	* graphExt.buildGraph(labels);															// labels: Mat(type: CV_32SC1)
+	* graphExt.setGraph(nodeTrainer.getNodePotentials(graphExt.getRegionFeatures(fv)));	// or the pixel-wise potentials
+	* graphExt.addDefaultEdgesModel(fv, 100.0f);
+	* Mat solution = graphExt.getPixelSolution(CInferLBP(graph).decode(100));
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGraphSuperpixelExt : public CGraphExt
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		*/
+		DllExport CGraphSuperpixelExt(IGraphPairwise &graph) : m_graph(graph), m_nRegions(0) {}
+		DllExport virtual ~CGraphSuperpixelExt(void) = default;
+
+		/**
+		* @brief Builds the region adjacency graph from the label image
+		* @details When called multiple times, previouse graph structure is always replaced. The empty regions become isolated nodes.
+		* @param labels The label image: Mat(size: image width x image height; type: CV_32SC1) with the region indices in range [0; nRegions), or 
+		* negative values for the excluded pixels
+		*/
+		DllExport void	buildGraph(const Mat &labels);
+		// From CGraphExt
+		/**
+		* @brief Rebuilds the graph from the label image, given in the last call of buildGraph(const Mat &)
+		* @param graphSize The size of the graph, which must correspond to the size of the label image
+		*/
+		DllExport void	buildGraph(Size graphSize) override;
+		/**
+		* @brief Fills the graph nodes with potentials
+		* @param pots Either the region potentials: Mat(size: 1 x nRegions; type: CV_32FC(nStates)), \a e.g. returned by CTrainNode::getNodePotentials() for
+		* getRegionFeatures(), or the pixel-wise potentials: Mat(size: image width x image height; type: CV_32FC(nStates)), which are averaged over the regions
+		*/
+		DllExport void	setGraph(const Mat &pots) override;
+		/**
+		* @brief Adds default data-independet edge model
+		* @param val Value, specifying the smoothness strength along the boundary of the mean length
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addDefaultEdgesModel(float val, float weight = 1.0f) override;
+		/**
+		* @brief Adds default contrast-sensitive edge model
+		* @details The contrast is measured between the mean features of the regions (ref. getRegionFeatures())
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(size: image width x image height; type: CV_8UC<nFeatures>)
+		* @param val Value, specifying the smoothness strength along the boundary of the mean length
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addDefaultEdgesModel(const Mat &featureVectors, float val, float weight = 1.0f) override;
+		/**
+		* @brief Adds default contrast-sensitive edge model
+		* @param featureVectors Vector of size \a nFeatures, each element of which is a single feature - image: Mat(size: image width x image height; type: CV_8UC1)
+		* @param val Value, specifying the smoothness strength along the boundary of the mean length
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addDefaultEdgesModel(const vec_mat_t &featureVectors, float val, float weight = 1.0f) override;
+		DllExport Size	getSize(void) const override { return m_labels.size(); }
+
+		/**
+		* @brief Returns the mean features of the regions
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(size: image width x image height; type: CV_8UC<nFeatures>)
+		* @return The rounded mean feature vectors: Mat(size: 1 x nRegions; type: CV_8UC<nFeatures>)
+		*/
+		DllExport Mat	getRegionFeatures(const Mat &featureVectors) const;
+		/**
+		* @brief Spreads the states of the regions over their pixels
+		* @param solution The states of the nodes, \a e.g. returned by CInfer::decode()
+		* @param excluded The value of the excluded pixels, \a i.e. the pixels with negative labels
+		* @return The pixel-wise solution: Mat(size: image width x image height; type: CV_8UC1)
+		*/
+		DllExport Mat	getPixelSolution(const vec_byte_t &solution, byte excluded = 0) const;
+		/**
+		* @brief Returns the number of regions
+		* @return The number of regions (nodes)
+		*/
+		DllExport size_t getNumRegions(void) const { return m_nRegions; }
+		/**
+		* @brief Returns the sizes of the regions
+		* @return The number of pixels in every region
+		*/
+		DllExport const vec_size_t & getRegionSizes(void) const { return m_vRegionSizes; }
+		/**
+		* @brief Returns the region adjacency
+		* @return The adjacent pairs of regions: Mat(size: nArcs x 2; type: CV_32SC1), where the first index of every pair is smaller than the second one
+		*/
+		DllExport const Mat & getArcs(void) const { return m_arcs; }
+		/**
+		* @brief Returns the boundary lengths
+		* @return The number of the pairs of 4-connected pixels along the boundary of every arc, in the order of getArcs()
+		*/
+		DllExport const vec_size_t & getBoundaryLengths(void) const { return m_vBoundaryLengths; }
+		/**
+		* @brief Returns the label image, where every valid pixel is a region of its own
+		* @details The valid pixels are numbered in the row-major order, thus the pixel-wise potentials and features keep their values in the regions,
+		* and all the boundaries have the length 1, \a i.e. the edge models are the same as in the grid graph (ref. CGraphPairwiseExt).
+		* @param mask The mask of valid pixels: Mat(size: image width x image height; type: CV_8UC1)
+		* @return The label image for buildGraph(const Mat &): Mat(size: image width x image height; type: CV_32SC1) with -1 for the masked pixels
+		*/
+		DllExport static Mat getPixelLabels(const Mat &mask);
+
+
+	private:
+		/**
+		* @brief Averages the pixel-wise values over the regions
+		* @param src The pixel-wise values: Mat(size: image width x image height; type: CV_8UC(n) or CV_32FC(n))
+		* @return The sums of the values: nRegions x n
+		*/
+		std::vector<double> accumulate(const Mat &src) const;
+		/**
+		* @brief Fills the arcs with Potts potentials, powered by the relative boundary lengths
+		* @param regionFeatures The mean features of the regions (ref. getRegionFeatures()), or empty for the data-independent model
+		* @param val Value, specifying the smoothness strength
+		* @param weight The weighting parameter
+		*/
+		void fillArcs(const Mat &regionFeatures, float val, float weight);
+
+
+	private:
+		IGraphPairwise	& m_graph;				///< The graph
+		Mat				  m_labels;				///< The label image
+		size_t			  m_nRegions;			///< The number of regions
+		vec_size_t		  m_vRegionSizes;		///< The number of pixels in every region
+		Mat				  m_arcs;				///< The adjacent pairs of regions: nArcs x 2
+		vec_size_t		  m_vBoundaryLengths;	///< The boundary length of every arc
+		std::vector<vec_int_t>	  m_vvBandRegions;		///< The sorted regions, which occur in every band of rows of the label image
+	};
+}
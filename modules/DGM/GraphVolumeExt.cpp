@@ -0,0 +1,207 @@
+#include "GraphVolumeExt.h"
+#include "IGraphPairwise.h"
+#include "EdgePotentials.h"
+#include "GraphGrid.h"
+#include "TrainEdge.h"
+#include "TrainEdgePottsCS.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// The directions to the preceding nodes: the faces, the in-slice diagonals, the edges and the corners
+		const CGraphVolumeExt::Direction DIRECTIONS[] = {
+			{ -1,  0,  0,  0 }, {  0, -1,  0,  1 }, {  0,  0, -1,  2 },
+			{ -1, -1,  0,  3 }, {  1, -1,  0,  4 },
+			{ -1,  0, -1,  5 }, {  1,  0, -1,  6 }, {  0, -1, -1,  7 }, {  0,  1, -1,  8 },
+			{ -1, -1, -1,  9 }, {  1, -1, -1, 10 }, { -1,  1, -1, 11 }, {  1,  1, -1, 12 }
+		};
+	}
+
+	CGraphVolumeExt::CGraphVolumeExt(IGraphPairwise &graph, int depth, byte connectivity) : m_graph(graph), m_depth(depth), m_connectivity(connectivity), m_sliceSize(0, 0)
+	{
+		DGM_ASSERT_MSG(depth > 0, "The depth of the volume must be positive");
+		getDirections(connectivity);																	// checks the connectivity
+	}
+
+	void CGraphVolumeExt::buildGraph(Size graphSize)
+	{
+		DGM_PROFILE_ZONE("buildGraph");
+		DGM_ASSERT_MSG(graphSize.height % m_depth == 0, "The height of the stack (%d) is not a multiple of the depth (%d)", graphSize.height, m_depth);
+		const Size prevSize = m_sliceSize;
+		m_sliceSize = Size(graphSize.width, graphSize.height / m_depth);
+
+		// The grid graph has implicit structure and does not need to be built node by node
+		CGraphGrid *pGraphGrid = dynamic_cast<CGraphGrid *>(&m_graph);
+		if (pGraphGrid) {
+			pGraphGrid->buildVolume(m_sliceSize, m_depth, m_connectivity);
+			return;
+		}
+
+		// The number of edges of every row of every slice follows from the position of the row
+		const byte								nStates		= m_graph.getNumStates();
+		const int								width		= m_sliceSize.width;
+		const int								height		= m_sliceSize.height;
+		const int								nRows		= height * m_depth;
+		const std::vector<Direction>			vDirections	= getDirections(m_connectivity);
+		auto isRowValid = [&](int row, const Direction &dir) {
+			const int y = row % height + dir.dy;
+			const int z = row / height + dir.dz;
+			return y >= 0 && y < height && z >= 0 && z < m_depth;
+		};
+		vec_size_t vOffset(nRows + 1, 0);																// the index of the first edge of every row
+		for (int row = 0; row < nRows; row++) {
+			size_t nArcs = 0;
+			for (const Direction &dir : vDirections)
+				if (isRowValid(row, dir)) nArcs += MAX(0, width - abs(dir.dx));
+			vOffset[row + 1] = vOffset[row] + 2 * nArcs;
+		}
+		const size_t nEdges = vOffset[nRows];
+		const size_t nNodes = static_cast<size_t>(width) * nRows;
+
+		// The graph of the same shape is reused: only its potentials are reset
+		if (prevSize == m_sliceSize && m_graph.getNumNodes() == nNodes && m_graph.getNumEdges() == nEdges) {
+			m_graph.setNodes(0, Mat(static_cast<int>(nNodes), nStates, CV_32FC1, Scalar(1.0f / nStates)));
+			m_graph.setEdges(std::nullopt, CTrainEdge::getDefaultEdgePotentials(1.0f, nStates));
+			return;
+		}
+
+		Mat			edges(static_cast<int>(nEdges), 2, CV_32SC1);
+		vec_byte_t	vGroups(nEdges, 0);
+		parallel::parallelFor(Range(0, nRows), [&](const Range &range) {
+			for (int row = range.start; row < range.end; row++) {
+				size_t e = vOffset[row];
+				for (const Direction &dir : vDirections) {
+					if (!isRowValid(row, dir)) continue;
+					const int shift = (dir.dz * height + dir.dy) * width + dir.dx;						// the index distance to the neighbour
+					for (int x = MAX(0, -dir.dx); x < width - MAX(0, dir.dx); x++) {
+						const int node = row * width + x;
+						for (int k = 0; k < 2; k++) {
+							int *pEdge = edges.ptr<int>(static_cast<int>(e));
+							pEdge[k]		= node;
+							pEdge[1 - k]	= node + shift;
+							vGroups[e++]	= dir.group;
+						}
+					} // x
+				} // dir
+			} // row
+		});
+
+		if (m_graph.getNumNodes() != 0) m_graph.reset();
+		m_graph.addNodes(Mat(static_cast<int>(nNodes), nStates, CV_32FC1, Scalar(1.0f / nStates)));
+		if (nEdges) m_graph.addEdges(edges, vGroups);
+	}
+
+	void CGraphVolumeExt::setGraph(const Mat &pots)
+	{
+		DGM_PROFILE_ZONE("setGraph");
+		const byte nStates = m_graph.getNumStates();
+		DGM_ASSERT(!pots.empty());
+		DGM_ASSERT_MSG(pots.type() == CV_32FC(nStates), "The potentials must be of type CV_32FC(%d)", nStates);
+		if (getSize() != pots.size() || m_graph.getNumNodes() != pots.total()) buildGraph(pots.size());
+
+		if (pots.isContinuous()) m_graph.setNodes(0, pots.reshape(1, static_cast<int>(pots.total())));
+		else
+			for (int row = 0; row < pots.rows; row++)
+				m_graph.setNodes(static_cast<size_t>(row) * pots.cols, pots.row(row).reshape(1, pots.cols));
+	}
+
+	void CGraphVolumeExt::addDefaultEdgesModel(float val, float weight)
+	{
+		if (weight != 1.0f) val = powf(val, weight);
+		m_graph.setEdges(std::nullopt, CTrainEdge::getDefaultEdgePotentials(sqrtf(val), m_graph.getNumStates()));
+	}
+
+	void CGraphVolumeExt::addDefaultEdgesModel(const Mat &featureVectors, float val, float weight)
+	{
+		const CTrainEdgePottsCS edgeTrainer(m_graph.getNumStates(), featureVectors.channels());
+		fillEdges(edgeTrainer, featureVectors, { val, 0.001f }, weight);
+	}
+
+	void CGraphVolumeExt::addDefaultEdgesModel(const vec_mat_t &featureVectors, float val, float weight)
+	{
+		Mat fv;
+		merge(featureVectors, fv);
+		addDefaultEdgesModel(fv, val, weight);
+	}
+
+	void CGraphVolumeExt::fillEdges(const CTrainEdge &edgeTrainer, const Mat &featureVectors, const vec_float_t &vParams, float weight)
+	{
+		DGM_PROFILE_ZONE("fillEdges");
+		const byte	nStates		= m_graph.getNumStates();
+		const int	width		= m_sliceSize.width;
+		const int	height		= m_sliceSize.height;
+		const int	nRows		= height * m_depth;
+		DGM_ASSERT(featureVectors.size() == getSize());
+		DGM_ASSERT(featureVectors.depth() == CV_8U);
+		DGM_ASSERT(featureVectors.channels() == edgeTrainer.getNumFeatures());
+		DGM_ASSERT(static_cast<size_t>(width) * nRows == m_graph.getNumNodes());
+
+		const std::vector<Direction> vDirections = getDirections(m_connectivity);
+		parallel::parallelFor(Range(0, nRows), [&](const Range &range) {
+			std::vector<Mat> vPots(vDirections.size());													// one buffer per direction: the block sizes differ, thus are not re-allocated
+			Mat potT;
+			for (int row = range.start; row < range.end; row++) {
+				const Mat row1 = featureVectors.row(row).reshape(1, width);								// Mat(size: width x nFeatures)
+				for (size_t d = 0; d < vDirections.size(); d++) {
+					const Direction &dir = vDirections[d];
+					const int y = row % height + dir.dy;
+					const int z = row / height + dir.dz;
+					if (y < 0 || y >= height || z < 0 || z >= m_depth) continue;
+
+					const int x0 = MAX(0, -dir.dx);
+					const int x1 = width - MAX(0, dir.dx);
+					if (x1 <= x0) continue;
+					const Mat row2	= featureVectors.row(z * height + y).reshape(1, width);
+					Mat		 &pots	= vPots[d];
+					edgeTrainer.getEdgePotentials(row1.rowRange(x0, x1), row2.rowRange(x0 + dir.dx, x1 + dir.dx), vParams, pots, weight);
+					sqrt(pots, pots);																	// as in IGraphPairwise::setArc()
+					for (int i = 0; i < pots.rows; i++) {
+						const float	*pPot = pots.ptr<float>(i);
+						const size_t node = static_cast<size_t>(row) * width + x0 + i;
+						const size_t nb	  = static_cast<size_t>(z * height + y) * width + x0 + dir.dx + i;
+						if (isPotts(pPot, nStates)) {
+							m_graph.setEdgePotts(node, nb, pPot[0], pPot[1]);
+							m_graph.setEdgePotts(nb, node, pPot[0], pPot[1]);
+							continue;
+						}
+						const Mat pot(nStates, nStates, CV_32FC1, const_cast<float *>(pPot));
+						transpose(pot, potT);
+						m_graph.setEdge(node, nb, pot);
+						m_graph.setEdge(nb, node, potT);
+					} // i
+				} // d
+			} // row
+		});
+	}
+
+	void CGraphVolumeExt::setDepth(int depth)
+	{
+		DGM_ASSERT_MSG(depth > 0, "The depth of the volume must be positive");
+		if (depth != m_depth) m_sliceSize = Size(0, 0);
+		m_depth = depth;
+	}
+
+	std::vector<CGraphVolumeExt::Direction> CGraphVolumeExt::getDirections(byte connectivity)
+	{
+		size_t nDirections = 0;
+		switch (connectivity) {
+			case VOLUME_EDGES_6:	nDirections = 3;	break;
+			case VOLUME_EDGES_10:	nDirections = 5;	break;
+			case VOLUME_EDGES_18:	nDirections = 9;	break;
+			case VOLUME_EDGES_26:	nDirections = 13;	break;
+			default: DGM_ASSERT_MSG(false, "Unknown connectivity %d", connectivity);
+		}
+		return std::vector<Direction>(DIRECTIONS, DIRECTIONS + nDirections);
+	}
+
+	byte CGraphVolumeExt::getDirectionGroup(int dx, int dy, int dz)
+	{
+		for (const Direction &dir : DIRECTIONS)
+			if ((dir.dx == dx && dir.dy == dy && dir.dz == dz) || (dir.dx == -dx && dir.dy == -dy && dir.dz == -dz)) return dir.group;
+		DGM_ASSERT_MSG(false, "(%d, %d, %d) is not a direction of the lattice", dx, dy, dz);
+		return 0;
+	}
+}
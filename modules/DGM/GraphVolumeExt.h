@@ -0,0 +1,151 @@
+// Extended (pairwise) Volumetric Graph class interface;
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphExt.h"
+
+namespace DirectGraphicalModels
+{
+	class IGraphPairwise;
+	class CTrainEdge;
+
+	///@brief Connectivity of the 3D lattices
+	enum volumeEdgesType {
+		VOLUME_EDGES_6  = 6,		///< Face neighbours: the 4-connected slices with the edges between the slices (\a e.g. the temporal edges between the frames)
+		VOLUME_EDGES_10 = 10,		///< The 8-connected slices with the edges between the slices
+		VOLUME_EDGES_18 = 18,		///< Face and edge neighbours
+		VOLUME_EDGES_26 = 26		///< Face, edge and corner neighbours
+	};
+
+	// ================================ Extended Volumetric Graph Class ================================
+	/**
+	* @brief Extended Pairwise graph class for 3D volume classification
+	* @ingroup moduleGraphExt
+	* @details This graph class builds the 3D lattices, \a e.g. for the medical volumes or for the video stacks, where the slices (frames) are connected with the
+	* spatial (or temporal) edges. The volume of size \a width x \a height x \a depth is represented by the stack of its slices: Mat(size: width x (height * depth)),
+	* so that the node index of voxel \f$(x, y, z)\f$ is \f$(z \cdot height + y) \cdot width + x\f$. The neighbours follow in closed form from the index, thus the
+	* edges are generated in parallel, and for the @ref CGraphGrid graph the topology is not stored at all (ref. CGraphGrid::buildVolume()).
+	*
+	* Every direction of the lattice is an edge group of its own (ref. getDirectionGroup()): the groups 0, 1 and 2 are the \a x, \a y and \a z directions, thus \a e.g.
+	* the temporal edges of a video or the edges along the anisotropic axis of a volume are set independently of the in-slice edges:
+	* @code
+	* CGraphGrid		graph(nStates);
+	* CGraphVolumeExt	graphExt(graph, nFrames, VOLUME_EDGES_6);
+	* graphExt.setGraph(pots);																// pots: Mat(size: width x (height * nFrames); type: CV_32FC(nStates))
+	* graphExt.addDefaultEdgesModel(100.0f);
+	* graph.setEdges(CGraphVolumeExt::getDirectionGroup(0, 0, 1), CTrainEdge::getDefaultEdgePotentials(sqrtf(10.0f), nStates));	// weaker temporal smoothness
+	* @endcode
+	* The volumes, which do not fit into the memory, are decoded slab by slab with @ref CInferSlabs.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGraphVolumeExt : public CGraphExt
+	{
+	public:
+		/// Direction of the lattice
+		struct Direction {
+			int		dx;			///< Shift along the x-axis
+			int		dy;			///< Shift along the y-axis
+			int		dz;			///< Shift along the z-axis
+			byte	group;		///< The edge group
+		};
+
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		* @param depth The number of slices
+		* @param connectivity The connectivity of the lattice (Ref. @ref volumeEdgesType)
+		*/
+		DllExport CGraphVolumeExt(IGraphPairwise &graph, int depth, byte connectivity = VOLUME_EDGES_6);
+		DllExport virtual ~CGraphVolumeExt(void) = default;
+
+		// From CGraphExt
+		/**
+		* @brief Builds the 3D lattice
+		* @details When called multiple times, previouse graph structure is always replaced. If the graph has already the same size, number of nodes and number of edges,
+		* its structure is reused, and only the potentials are reset: the node potentials to \f$1 / nStates\f$ and the edge potentials to 1.
+		* @param graphSize The size of the stack of the slices: (width x (height * depth)). The height must be a multiple of the depth
+		*/
+		DllExport void	buildGraph(Size graphSize) override;
+		/**
+		* @brief Fills the graph nodes with potentials
+		* @param pots The stack of the node potentials of the slices: Mat(size: width x (height * depth); type: CV_32FC(nStates))
+		*/
+		DllExport void	setGraph(const Mat &pots) override;
+		/**
+		* @brief Adds default data-independet edge model
+		* @details All the directions receive the same Potts potential
+		* @param val Value, specifying the smoothness strength
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addDefaultEdgesModel(float val, float weight = 1.0f) override;
+		/**
+		* @brief Adds default contrast-sensitive edge model
+		* @param featureVectors The stack of the feature slices: Mat(size: width x (height * depth); type: CV_8UC<nFeatures>)
+		* @param val Value, specifying the smoothness strength
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addDefaultEdgesModel(const Mat &featureVectors, float val, float weight = 1.0f) override;
+		/**
+		* @brief Adds default contrast-sensitive edge model
+		* @param featureVectors Vector of size \a nFeatures, each element of which is the stack of the slices of a single feature: Mat(size: width x (height * depth); type: CV_8UC1)
+		* @param val Value, specifying the smoothness strength
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addDefaultEdgesModel(const vec_mat_t &featureVectors, float val, float weight = 1.0f) override;
+		/**
+		* @brief Returns the size of the graph
+		* @return The size of the stack of the slices: (width x (height * depth))
+		*/
+		DllExport Size	getSize(void) const override { return Size(m_sliceSize.width, m_sliceSize.height * m_depth); }
+
+		/**
+		* @brief Fills the graph edges with potentials
+		* @details The potentials of all the edges of one direction in one row of a slice are calculated at once, as in CGraphLayeredExt::fillEdges()
+		* > This function supports PPL
+		* @param edgeTrainer The edge trainer
+		* @param featureVectors The stack of the feature slices: Mat(size: width x (height * depth); type: CV_8UC<nFeatures>)
+		* @param vParams Array of control parameters. Please refer to the concrete model implementation of the CTrainEdge::calculateEdgePotentials() function for more details
+		* @param weight The weighting parameter
+		*/
+		DllExport void	fillEdges(const CTrainEdge &edgeTrainer, const Mat &featureVectors, const vec_float_t &vParams, float weight = 1.0f);
+		/**
+		* @brief Sets the number of slices
+		* @details The graph is rebuilt by the next call of buildGraph() or setGraph()
+		* @param depth The number of slices
+		*/
+		DllExport void	setDepth(int depth);
+		/**
+		* @brief Returns the number of slices
+		* @return The depth of the volume
+		*/
+		DllExport int	getDepth(void) const { return m_depth; }
+		/**
+		* @brief Returns the size of one slice
+		* @return The size of the slice
+		*/
+		DllExport Size	getSliceSize(void) const { return m_sliceSize; }
+		/**
+		* @brief Returns the directions of the lattice
+		* @details Only one of two opposite directions is returned: the one pointing to the preceding (in the index order) node
+		* @param connectivity The connectivity of the lattice (Ref. @ref volumeEdgesType)
+		* @return The directions with their edge groups
+		*/
+		DllExport static std::vector<Direction> getDirections(byte connectivity);
+		/**
+		* @brief Returns the edge group of the direction
+		* @details Both opposite directions, \a e.g. (1, 0, 0) and (-1, 0, 0), belong to the same group
+		* @param dx Shift along the x-axis: -1, 0 or 1
+		* @param dy Shift along the y-axis: -1, 0 or 1
+		* @param dz Shift along the z-axis: -1, 0 or 1
+		* @return The edge group in range [0; 13)
+		*/
+		DllExport static byte getDirectionGroup(int dx, int dy, int dz);
+
+
+	private:
+		IGraphPairwise		& m_graph;			///< The graph
+		int					  m_depth;			///< The number of slices
+		byte				  m_connectivity;	///< The connectivity of the lattice
+		Size				  m_sliceSize;		///< The size of one slice
+	};
+}
@@ -1,200 +1,366 @@
 #include "GraphWeiss.h"
+#include "footprint.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
 {
-	// Constructor
-	CGraphWeiss::CGraphWeiss(byte nStates) 
-		: IGraphPairwise(nStates)
-		, m_IDx(0)
-	{}
-
-	// Destructor: clean up the Node objects
-	CGraphWeiss::~CGraphWeiss(void)
-	{
-		size_t nNodes = m_vpNodes.size();
-		for (size_t n = 0; n < nNodes; n++) 
-			delete m_vpNodes.at(n);	
-		m_vpNodes.clear();
-	}
-
 	void CGraphWeiss::reset(void)
 	{
-		size_t nNodes = m_vpNodes.size();
-		for (size_t n = 0; n < nNodes; n++) 
-			delete m_vpNodes.at(n);	
-		m_vpNodes.clear();	
-		m_IDx = 0;
+		m_vNodes.clear();
+		m_vEdges.clear();
+		m_nRemovedEdges = 0;
+		m_vNodePots.clear();
+		m_vEdgePots.clear();
+		m_vSharedPots.clear();
+		m_hasOwnPots = false;
 	}
 
 	// Add a new node to the graph with specified potentional
 	size_t CGraphWeiss::addNode(const Mat &pot)
 	{
-		Node *n = new Node(m_IDx, pot);
-		m_vpNodes.push_back(n);
-		return m_IDx++;
+		const byte	 nStates = getNumStates();
+		const size_t res	 = m_vNodes.size();
+		m_vNodes.push_back({ vec_size_t(), vec_size_t(), !pot.empty() });
+		m_vNodePots.resize(m_vNodePots.size() + nStates, 0.0f);
+		if (!pot.empty()) {
+			DGM_ASSERT_MSG((pot.cols == 1) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, 1, nStates);
+			DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+			for (byte s = 0; s < nStates; s++) m_vNodePots[res * nStates + s] = pot.at<float>(s, 0);
+		}
+		return res;
+	}
+
+	// Add the new nodes: the potentials are appended to the buffer at once
+	void CGraphWeiss::addNodes(const Mat &pots)
+	{
+		DGM_ASSERT_MSG(pots.cols == getNumStates(), "The number of columns (%d) does not match the number of states (%d)", pots.cols, getNumStates());
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1, "The potentials must be of type CV_32FC1");
+
+		const byte	 nStates = getNumStates();
+		const size_t offset	 = m_vNodePots.size();
+		m_vNodes.resize(m_vNodes.size() + pots.rows, { vec_size_t(), vec_size_t(), true });
+		m_vNodePots.resize(offset + static_cast<size_t>(pots.rows) * nStates);
+		for (int n = 0; n < pots.rows; n++)
+			memcpy(&m_vNodePots[offset + n * nStates], pots.ptr<float>(n), nStates * sizeof(float));
 	}
 
 	// Set or change the potential of node idx
 	void CGraphWeiss::setNode(size_t node, const Mat &pot)
 	{
+		const byte nStates = getNumStates();
 		// Assertions
-		DGM_ASSERT_MSG(node < m_vpNodes.size(), "Node %zu is out of range %zu", node, m_vpNodes.size());
-
-		if (!m_vpNodes.at(node)->Pot.empty()) m_vpNodes.at(node)->Pot.release();
-		pot.copyTo(m_vpNodes.at(node)->Pot);
+		DGM_ASSERT_MSG(node < m_vNodes.size(), "Node %zu is out of range %zu", node, m_vNodes.size());
+		DGM_ASSERT_MSG((pot.cols == 1) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, 1, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		float *pPot = &m_vNodePots[node * nStates];
+		for (byte s = 0; s < nStates; s++) pPot[s] = pot.at<float>(s, 0);
+		m_vNodes[node].isSet = true;
+		markDirty(node, node + 1);
 	}
 
-	// Return node potential vector 
+	// Return node potential vector
 	void CGraphWeiss::getNode(size_t node, Mat &pot) const
+	{
+		const span<const float> view = getNodeView(node);
+		pot.create(getNumStates(), 1, CV_32FC1);
+		memcpy(pot.data, view.data(), view.size() * sizeof(float));
+	}
+
+	span<const float> CGraphWeiss::getNodeView(size_t node) const
 	{
 		// Assertions
-		DGM_ASSERT_MSG(node < m_vpNodes.size(), "Node %zu is out of range %zu", node, m_vpNodes.size());
-		DGM_ASSERT_MSG(!m_vpNodes.at(node)->Pot.empty(), "Specified node %zu is not set", node);
+		DGM_ASSERT_MSG(node < m_vNodes.size(), "Node %zu is out of range %zu", node, m_vNodes.size());
+		DGM_ASSERT_MSG(m_vNodes[node].isSet, "Specified node %zu is not set", node);
 
-		m_vpNodes.at(node)->Pot.copyTo(pot);
+		return { &m_vNodePots[node * getNumStates()], getNumStates() };
+	}
+
+	span<float> CGraphWeiss::getMutableNodeView(size_t node)
+	{
+		const span<const float> view = getNodeView(node);
+		markDirty(node, node + 1);
+		return { const_cast<float *>(view.data()), view.size() };
 	}
 
 	// Return child nodes ID's
 	void CGraphWeiss::getChildNodes(size_t node, vec_size_t &vNodes) const
 	{
 		// Assertion
-		DGM_ASSERT_MSG(node < m_vpNodes.size(), "Node %zu is out of range %zu", node, m_vpNodes.size());
-	
-		for (size_t e_t = 0; e_t < m_vpNodes.at(node)->to.size(); e_t++) 
-			vNodes.push_back(m_vpNodes.at(node)->to.at(e_t)->node2->id);
+		DGM_ASSERT_MSG(node < m_vNodes.size(), "Node %zu is out of range %zu", node, m_vNodes.size());
+
+		if (!vNodes.empty()) vNodes.clear();
+		for (size_t e : m_vNodes[node].to) vNodes.push_back(m_vEdges[e].node2);
 	}
 
 	// Return parent nodes ID's
 	void CGraphWeiss::getParentNodes(size_t node, vec_size_t &vNodes) const
 	{
 		// Assertion
-		DGM_ASSERT_MSG(node < m_vpNodes.size(), "Node %zu is out of range %zu", node, m_vpNodes.size());
-	
-		for (size_t e_f = 0; e_f < m_vpNodes.at(node)->from.size(); e_f++) 
-			vNodes.push_back(m_vpNodes.at(node)->from.at(e_f)->node1->id);
+		DGM_ASSERT_MSG(node < m_vNodes.size(), "Node %zu is out of range %zu", node, m_vNodes.size());
+
+		if (!vNodes.empty()) vNodes.clear();
+		for (size_t e : m_vNodes[node].from) vNodes.push_back(m_vEdges[e].node1);
 	}
 
-	size_t CGraphWeiss::getNumEdges(void) const 
-	{ 
-		size_t res = 0;
-		for (const Node* n : m_vpNodes) 
-			res += n->to.size();
+	size_t CGraphWeiss::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vNodes) + footprint::getBytes(m_vEdges) + footprint::getBytes(m_vNodePots)
+			+ footprint::getBytes(m_vEdgePots) + footprint::getBytes(m_vSharedPots);
+		for (const Node &node : m_vNodes)
+			res += footprint::getBytes(node.to) + footprint::getBytes(node.from);
 		return res;
-	} 
+	}
 
 	// Add a new (directed) edge to the graph with specified potentional
 	void CGraphWeiss::addEdge(size_t srcNode, size_t dstNode, byte group, const Mat &pot)
 	{
+		const byte nStates = getNumStates();
 		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+		DGM_ASSERT_MSG(findEdge(srcNode, dstNode) == m_vEdges.size(), "The edge (%zu)->(%zu) already exists", srcNode, dstNode);
 
-		// Check if the edge exists
-		for (size_t e_t = 0; e_t < m_vpNodes.at(srcNode)->to.size(); e_t++) {
-			Edge *edge_to = m_vpNodes.at(srcNode)->to.at(e_t);
-			DGM_ASSERT(edge_to->node2->id != m_vpNodes.at(dstNode)->id);
-		} // e_t
-		
-		// Else: create a new one
-		Edge *e = new Edge(m_vpNodes.at(srcNode), m_vpNodes.at(dstNode), group, pot);
-		m_vpNodes.at(srcNode)->to.push_back(e);
-		m_vpNodes.at(dstNode)->from.push_back(e);
+		const size_t e = m_vEdges.size();
+		m_vEdges.emplace_back(srcNode, dstNode, group);
+		m_vNodes[srcNode].to.push_back(e);
+		m_vNodes[dstNode].from.push_back(e);
+		if (m_hasOwnPots) m_vEdgePots.resize(m_vEdgePots.size() + nStates * nStates);
+
+		if (!pot.empty()) setEdge(srcNode, dstNode, pot);
+	}
+
+	// Add a block of new (directed) edges
+	void CGraphWeiss::addEdges(const Mat &edges, const vec_byte_t &vGroups, const Mat &pot)
+	{
+		DGM_ASSERT_MSG(edges.cols == 2 && edges.type() == CV_32SC1, "The edge list must be a Mat(size: nEdges x 2; type: CV_32SC1)");
+		DGM_ASSERT_MSG(vGroups.empty() || vGroups.size() == static_cast<size_t>(edges.rows), "The number of groups (%zu) does not match the number of edges (%d)", vGroups.size(), edges.rows);
+
+		const byte	 nStates = getNumStates();
+		const size_t nNodes	 = m_vNodes.size();
+
+		// Check if the edges exist: all the edges of the graph are sorted once
+		std::vector<std::pair<size_t, size_t>> vPairs;
+		vPairs.reserve(getNumEdges() + edges.rows);
+		for (const Node &node : m_vNodes)
+			for (size_t e : node.to) vPairs.emplace_back(m_vEdges[e].node1, m_vEdges[e].node2);
+		vec_size_t vNumTo(nNodes, 0), vNumFrom(nNodes, 0);
+		for (int e = 0; e < edges.rows; e++) {
+			const int *pEdge = edges.ptr<int>(e);
+			DGM_ASSERT_MSG(pEdge[0] >= 0 && static_cast<size_t>(pEdge[0]) < nNodes, "The source node index %d is out of range %zu", pEdge[0], nNodes);
+			DGM_ASSERT_MSG(pEdge[1] >= 0 && static_cast<size_t>(pEdge[1]) < nNodes, "The destination node index %d is out of range %zu", pEdge[1], nNodes);
+			vPairs.emplace_back(pEdge[0], pEdge[1]);
+			vNumTo[pEdge[0]]++;
+			vNumFrom[pEdge[1]]++;
+		}
+		std::sort(vPairs.begin(), vPairs.end());
+		auto it = std::adjacent_find(vPairs.begin(), vPairs.end());
+		DGM_ASSERT_MSG(it == vPairs.end(), "The edge (%zu)->(%zu) already exists", it->first, it->second);
+
+		// The new edges reference one shared potential
+		dword idx = POT_NONE;
+		if (!pot.empty()) {
+			DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+			DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+			idx = static_cast<dword>(m_vSharedPots.size());
+			m_vSharedPots.emplace_back(nStates * nStates);
+			for (byte y = 0; y < nStates; y++)
+				memcpy(&m_vSharedPots.back()[y * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+		}
+
+		// Create the new ones
+		for (size_t n = 0; n < nNodes; n++) {
+			m_vNodes[n].to.reserve(m_vNodes[n].to.size() + vNumTo[n]);
+			m_vNodes[n].from.reserve(m_vNodes[n].from.size() + vNumFrom[n]);
+		}
+		m_vEdges.reserve(m_vEdges.size() + edges.rows);
+		for (int i = 0; i < edges.rows; i++) {
+			const int	 *pEdge	= edges.ptr<int>(i);
+			const size_t  e		= m_vEdges.size();
+			m_vEdges.emplace_back(pEdge[0], pEdge[1], vGroups.empty() ? 0 : vGroups[i]);
+			m_vEdges.back().pot = idx;
+			m_vNodes[pEdge[0]].to.push_back(e);
+			m_vNodes[pEdge[1]].from.push_back(e);
+		}
+		if (m_hasOwnPots) m_vEdgePots.resize(m_vEdges.size() * nStates * nStates);
 	}
 
 	// Set or change the potentional of an directed edge
 	void CGraphWeiss::setEdge(size_t srcNode, size_t dstNode, const Mat &pot)
 	{
+		const byte nStates = getNumStates();
 		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
-
-		Edge* e = findEdge(srcNode, dstNode);
-		DGM_ASSERT_MSG(e, "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
-
-		pot.copyTo(e->Pot);
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+		DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+
+		// copy-on-write: the edge gets its own potential and stops referencing the shared one
+		createOwnPots();
+		for (byte y = 0; y < nStates; y++)
+			memcpy(&m_vEdgePots[(e * nStates + y) * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+		m_vEdges[e].pot = POT_OWN;
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
 	}
 
 	void CGraphWeiss::setEdges(std::optional<byte> group, const Mat& pot)
 	{
-		for (Node* n : m_vpNodes)
-			for (Edge* e : n->to)
-				if (!group || e->group_id == group.value())
-					pot.copyTo(e->Pot);
+		const byte nStates = getNumStates();
+		DGM_ASSERT_MSG((pot.cols == nStates) && (pot.rows == nStates), "Potential size (%d x %d) does not match (%d x %d)", pot.cols, pot.rows, nStates, nStates);
+		DGM_ASSERT_MSG(pot.type() == CV_32FC1, "Potential type is not CV_32FC1");
+
+		// Find a free shared potential
+		dword idx = 0;
+		while (idx < m_vSharedPots.size() && !m_vSharedPots[idx].empty()) idx++;
+		if (idx == m_vSharedPots.size()) m_vSharedPots.emplace_back();
+		m_vSharedPots[idx].resize(nStates * nStates);
+		for (byte y = 0; y < nStates; y++)
+			memcpy(&m_vSharedPots[idx][y * nStates], pot.ptr<float>(y), nStates * sizeof(float));
+
+		// Let all the edges of the group reference it
+		vec_bool_t vReferenced(m_vSharedPots.size(), false);
+		for (const Node &node : m_vNodes)
+			for (size_t e : node.to) {
+				Edge &edge = m_vEdges[e];
+				if (!group || edge.group_id == group.value()) edge.pot = idx;
+				if (edge.pot < m_vSharedPots.size()) vReferenced[edge.pot] = true;
+			}
+
+		// Release the shared potentials, which are not referenced anymore
+		for (size_t i = 0; i < m_vSharedPots.size(); i++)
+			if (!vReferenced[i]) vec_float_t().swap(m_vSharedPots[i]);
+		markDirty(0, m_vNodes.size());
 	}
 
 	// Return edge potential matrix
 	void CGraphWeiss::getEdge(size_t srcNode, size_t dstNode, Mat &pot) const
 	{
-		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
+		const span<const float> view = getEdgeView(srcNode, dstNode);
+		if (view.size() == 0) {
+			if (!pot.empty()) pot.release();
+			return;
+		}
+		pot.create(getNumStates(), getNumStates(), CV_32FC1);
+		memcpy(pot.data, view.data(), view.size() * sizeof(float));
+	}
 
-		Edge* e = findEdge(srcNode, dstNode);
-		DGM_ASSERT_MSG(e, "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+	span<const float> CGraphWeiss::getEdgeView(size_t srcNode, size_t dstNode) const
+	{
+		const byte nStates = getNumStates();
+		// Assertions
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const float *pPot = getEdgePot(e);
+		if (!pPot) return {};
+		return { pPot, static_cast<size_t>(nStates) * nStates };
+	}
 
-		e->Pot.copyTo(pot);
+	span<float> CGraphWeiss::getMutableEdgeView(size_t srcNode, size_t dstNode)
+	{
+		const byte nStates = getNumStates();
+		// Assertions
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		if (m_vEdges[e].pot == POT_NONE) return {};
+		if (m_vEdges[e].pot != POT_OWN) {
+			// copy-on-write: the edge gets its own copy of the shared potential
+			createOwnPots();
+			memcpy(&m_vEdgePots[e * nStates * nStates], getEdgePot(e), nStates * nStates * sizeof(float));
+			m_vEdges[e].pot = POT_OWN;
+		}
+		markDirty(srcNode, srcNode + 1);
+		markDirty(dstNode, dstNode + 1);
+		return { &m_vEdgePots[e * nStates * nStates], static_cast<size_t>(nStates) * nStates };
 	}
 
 	void CGraphWeiss::setEdgeGroup(size_t srcNode, size_t dstNode, byte group)
 	{
 		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		Edge* e = findEdge(srcNode, dstNode);
-		DGM_ASSERT_MSG(e, "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
 
-		e->group_id = group;
+		m_vEdges[e].group_id = group;
 	}
 
 	byte CGraphWeiss::getEdgeGroup(size_t srcNode, size_t dstNode) const
 	{
 		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+
+		const size_t e = findEdge(srcNode, dstNode);
+		DGM_ASSERT_MSG(e < m_vEdges.size(), "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
 
-		Edge* e = findEdge(srcNode, dstNode);
-		DGM_ASSERT_MSG(e, "The edge (%zu)->(%zu) is not found", srcNode, dstNode);
-		
-		return e->group_id;
+		return m_vEdges[e].group_id;
 	}
 
 	void CGraphWeiss::removeEdge(size_t srcNode, size_t dstNode)
 	{
 		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
 
-		Edge* e = findEdge(srcNode, dstNode);
-		if (!e) {
+		const size_t e = findEdge(srcNode, dstNode);
+		if (e == m_vEdges.size()) {
 			DGM_WARNING("The edge (%zu)->(%zu) is not found", srcNode, dstNode);
 			return;
 		}
 
-		auto it = std::find(m_vpNodes[srcNode]->to.begin(), m_vpNodes[srcNode]->to.end(), e);
-		m_vpNodes[srcNode]->to.erase(it);
+		vec_size_t &vTo = m_vNodes[srcNode].to;
+		vTo.erase(std::find(vTo.begin(), vTo.end(), e));
+		vec_size_t &vFrom = m_vNodes[dstNode].from;
+		vFrom.erase(std::find(vFrom.begin(), vFrom.end(), e));
 
-		it = std::find(m_vpNodes[dstNode]->from.begin(), m_vpNodes[dstNode]->from.end(), e);
-		m_vpNodes[dstNode]->from.erase(it);
-
-		delete e;
+		m_vEdges[e].pot = POT_NONE;
+		m_nRemovedEdges++;
 	}
 
 	bool CGraphWeiss::isEdgeExists(size_t srcNode, size_t dstNode) const
 	{
 		// Assertions
-		DGM_ASSERT_MSG(srcNode < m_vpNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vpNodes.size());
-		DGM_ASSERT_MSG(dstNode < m_vpNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vpNodes.size());
-		
-		return findEdge(srcNode, dstNode) ? true : false;
+		DGM_ASSERT_MSG(srcNode < m_vNodes.size(), "The source node index %zu is out of range %zu", srcNode, m_vNodes.size());
+		DGM_ASSERT_MSG(dstNode < m_vNodes.size(), "The destination node index %zu is out of range %zu", dstNode, m_vNodes.size());
+
+		return findEdge(srcNode, dstNode) < m_vEdges.size();
+	}
+
+	size_t CGraphWeiss::findEdge(size_t srcNode, size_t dstNode) const
+	{
+		for (size_t e : m_vNodes[srcNode].to)
+			if (m_vEdges[e].node2 == dstNode)
+				return e;
+		return m_vEdges.size();
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	const float* CGraphWeiss::getEdgePot(size_t edge) const
+	{
+		const dword idx = m_vEdges[edge].pot;
+		if (idx == POT_NONE) return NULL;
+		if (idx == POT_OWN)	 return &m_vEdgePots[edge * getNumStates() * getNumStates()];
+		return m_vSharedPots[idx].data();
 	}
 
-	CGraphWeiss::Edge* CGraphWeiss::findEdge(size_t srcNode, size_t dstNode) const
+	void CGraphWeiss::createOwnPots(void)
 	{
-		for (Edge *edge_to : m_vpNodes[srcNode]->to)
-			if (edge_to->node2->id == dstNode)
-				return edge_to;
-		return NULL;
+		if (m_hasOwnPots) return;
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (m_hasOwnPots) return;
+
+		m_vEdgePots.assign(m_vEdges.size() * getNumStates() * getNumStates(), 0.0f);
+		m_hasOwnPots = true;
 	}
 }
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "IGraphPairwise.h"
+#include <atomic>
+#include <mutex>
 
 
 namespace DirectGraphicalModels
@@ -10,7 +12,11 @@ namespace DirectGraphicalModels
 	// ================================ Graph Class ================================
 	/**
 	* @brief Pairwise graph class
-	* @details Implementation is based on M. A. Weiss recommendations
+	* @details Implementation is based on M. A. Weiss recommendations: every node keeps the arrays of its outgoing and incoming edges. The nodes and the edges
+	* are stored in two contiguous containers and reference each other by their indices, thus the nodes and the edges are not allocated individually.
+	* The node potentials are stored in one buffer. The edge potentials are either stored in one buffer of individual potentials, which is allocated on the first
+	* use, or reference one of the shared potentials, set with addEdges() or setEdges(); an edge gets its individual copy (copy-on-write), when its potential 
+	* is changed with setEdge() or getMutableEdgeView().
 	* @warning This class is added for academic reasons. Do not use with Inference / Decoding classes
 	* @ingroup moduleGraph
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
@@ -18,47 +24,31 @@ namespace DirectGraphicalModels
 	class CGraphWeiss : public IGraphPairwise
 	{
 	public:
-		struct Node;
-		
 		// =============================== Edge Structure ==============================
 		/**
 		* @brief %Edge structure
 		* @details Basic item stored in adjacency list.
 		*/
 		struct Edge {
-			Node	* node1;		///< First node in edge
-			Node	* node2;		///< Second node in edge
-			Mat		  Pot;			///< The edge potentials: Mat(size: nStates x nStates; type: CV_32FC1)
-			byte	  group_id;		///< ID of the group, to which the edge belongs
+			size_t	node1;		///< First (source) node in edge
+			size_t	node2;		///< Second (destination) node in edge
+			dword	pot;		///< Index of the shared potential, or POT_NONE or POT_OWN
+			byte	group_id;	///< ID of the group, to which the edge belongs
 			
 			Edge(void) = delete;
-			Edge(Node* n1, Node* n2, byte group = 0, const Mat &p = EmptyMat) : node1(n1), node2(n2), Pot(p.empty() ? Mat() : p.clone()), group_id(group) {}
+			Edge(size_t n1, size_t n2, byte group = 0) : node1(n1), node2(n2), pot(POT_NONE), group_id(group) {}
 		};
 
-		/// @todo Use smart pointers here
-		using vec_pEdge_t = std::vector<Edge *>;
-
 		// =============================== Node Structure ==============================
 		/**
 		* @brief %Node structure
 		* @details Basic info for each node.
 		*/
 		struct Node {
-			size_t		id;		///< Node ID
-			Mat			Pot;	///< Node potentials: Mat(size: nStates x 1; type: CV_32FC1)
-			vec_pEdge_t	to;		///< Child vertices (and potentials)
-			vec_pEdge_t	from;	///< Parent vertices (and potentials)
-
-			Node(void) = delete;
-			Node(size_t _id, const Mat& p = EmptyMat) : id(_id), Pot(p.empty() ? Mat() : p.clone()) {}
-			~Node() {
-				for (Edge* e : to)
-					delete e;
-			}
+			vec_size_t	to;		///< Indices of the outgoing edges, pointing to the child vertices
+			vec_size_t	from;	///< Indices of the incoming edges, coming from the parent vertices
+			bool		isSet;	///< Flag indicating whether the node potential is set
 		};
-
-		/// @todo Use smart pointers here
-		using vec_pNode_t = std::vector<Node *>;
 	
 	
 	public:
@@ -66,25 +56,58 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param nStates the number of States (classes)
 		*/	
-		DllExport CGraphWeiss(byte nStates);
-		DllExport virtual ~CGraphWeiss(void);
+		DllExport CGraphWeiss(byte nStates) : IGraphPairwise(nStates), m_nRemovedEdges(0), m_hasOwnPots(false) {}
+		DllExport virtual ~CGraphWeiss(void) = default;
 		
 
 		DllExport void		reset(void) override;
 		DllExport size_t	addNode(const Mat &pot = EmptyMat) override;
+		/**
+		* @brief Adds the graph nodes with potentials
+		* @details The potentials are appended to the buffer of the node potentials at once
+		* @param pots A block of potentials: Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		DllExport void		addNodes(const Mat &pots) override;
 		DllExport void		setNode(size_t node, const Mat &pot) override;
 		DllExport void		getNode(size_t node, Mat &pot) const override;
+		DllExport span<const float>	getNodeView(size_t node) const override;
+		DllExport span<float>		getMutableNodeView(size_t node) override;
 		DllExport void		getChildNodes(size_t node, vec_size_t &vNodes) const override;
 		DllExport void		getParentNodes(size_t node, vec_size_t &vNodes) const override;
-		DllExport size_t	getNumNodes(void) const override { return m_vpNodes.size(); }
-		DllExport size_t	getNumEdges(void) const override;
+		DllExport size_t	getNumNodes(void) const override { return m_vNodes.size(); }
+		DllExport size_t	getNumEdges(void) const override { return m_vEdges.size() - m_nRemovedEdges; }
+		DllExport size_t	getMemoryUsage(void) const override;
 
 		DllExport void		addEdge		(size_t srcNode, size_t dstNode, byte group, const Mat &pot) override;
+		/**
+		* @brief Adds a block of directed edges
+		* @details The uniqueness of the new edges is validated in one sorting pass, the adjacency arrays are reserved in advance, and all the added edges
+		* reference one shared copy of \b pot
+		* @param edges The edge list: Mat(size: nEdges x 2; type: CV_32SC1), where every row holds the indices of the source and of the destination nodes
+		* @param vGroups The group IDs of the edges: one per edge, or empty for the group 0
+		* @param pot %Edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1), which is set to all the added edges, or empty
+		*/
+		DllExport void		addEdges	(const Mat &edges, const vec_byte_t &vGroups = vec_byte_t(), const Mat &pot = EmptyMat) override;
 		DllExport void		setEdge		(size_t srcNode, size_t dstNode, const Mat &pot) override;
+		/**
+		* @brief Sets the potential \b pot to all the edges of the group \b group
+		* @details The potential is copied once into a shared potential, which all the affected edges reference. The shared potentials, which are not 
+		* referenced anymore, are released
+		* @param group The edge group ID or std::nullopt for all the edges
+		* @param pot %Edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
+		*/
 		DllExport void		setEdges	(std::optional<byte> group, const Mat& pot) override;
 		DllExport void		getEdge		(size_t srcNode, size_t dstNode, Mat &pot) const override;
+		DllExport span<const float>	getEdgeView(size_t srcNode, size_t dstNode) const override;
+		DllExport span<float>		getMutableEdgeView(size_t srcNode, size_t dstNode) override;
 		DllExport void		setEdgeGroup(size_t srcNode, size_t dstNode, byte group) override;
 		DllExport byte		getEdgeGroup(size_t srcNode, size_t dstNode) const override;
+		/**
+		* @brief Removes the specified edge
+		* @details The edge is excluded from the adjacency arrays of its nodes; its slot in the edge container is released only with reset()
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		*/
 		DllExport void		removeEdge	(size_t srcNode, size_t dstNode) override;
 		DllExport bool		isEdgeExists(size_t srcNode, size_t dstNode) const override;
 
@@ -94,13 +117,35 @@ namespace DirectGraphicalModels
 		* @brief Finds and returns the %Edge defined by two nodes
 		* @param srcNode index of the source node
 		* @param dstNode index of the destination node
-		* @return Pointer to the %Edge if found, NULL otherwise
+		* @return Index of the %Edge if found, the size of the edge container otherwise
 		*/
-		DllExport  Edge*			findEdge(size_t srcNode, size_t dstNode) const;
+		DllExport size_t			findEdge(size_t srcNode, size_t dstNode) const;
 
 	private:
-		size_t		m_IDx;			// = 0;	Primary Key
-		vec_pNode_t m_vpNodes;		// Nodes container
+		static const dword POT_NONE = 0xFFFFFFFF;	///< The edge potential is not set
+		static const dword POT_OWN	= 0xFFFFFFFE;	///< The edge has individual potential
+
+		/**
+		* @brief Returns the potential of an edge
+		* @param edge The edge index
+		* @return The pointer to the nStates x nStates values, or NULL if the potential is not set
+		*/
+		const float*				getEdgePot(size_t edge) const;
+		/**
+		* @brief Allocates the buffer for the individual edge potentials, if it is not allocated yet
+		* @details This function is thread-safe
+		*/
+		void						createOwnPots(void);
+
+
+	private:
+		std::vector<Node>			m_vNodes;			///< Nodes container
+		std::vector<Edge>			m_vEdges;			///< Edges container; the removed edges are the empty slots until reset() is called
+		size_t						m_nRemovedEdges;	///< The number of the removed edges
+		vec_float_t					m_vNodePots;		///< %Node potentials: nNodes x nStates
+		vec_float_t					m_vEdgePots;		///< Individual edge potentials: nEdges x nStates x nStates
+		std::vector<vec_float_t>	m_vSharedPots;		///< Shared edge potentials: nStates x nStates each
+		std::atomic<bool>			m_hasOwnPots;		///< Flag indicating whether the buffer for the individual edge potentials is allocated
+		std::mutex					m_mtx;				///< Guards the allocation of the buffer for the individual edge potentials
 	};
 }
-
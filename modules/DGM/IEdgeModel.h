@@ -29,5 +29,39 @@ namespace DirectGraphicalModels {
 		* will be the same size and type as the input one: Mat(size: nNodes x nStates; type: CV_32FC1)
 		*/
 		virtual void apply(const Mat &src, Mat &dst) const = 0;
+		/**
+		* @brief Adds the logarithm of the applied edge model to the accumulator
+		* @details This function is used by the fused mean-field iteration of @ref CInferDense: the logarithms of all edge models are summed up
+		* and exponentiated only once. The default implementation calls apply() and adds the logarithm of its result.
+		* @param[in] src The dense graph node potentials in form Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param[in,out] acc The accumulator: Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param buffer Auxiliary container, which is reused between the calls in order to avoid the allocations
+		*/
+		virtual void accumulate(const Mat &src, Mat &acc, Mat &buffer) const
+		{
+			apply(src, buffer);
+			for (int n = 0; n < acc.rows; n++) {
+				const float *pBuffer = buffer.ptr<float>(n);
+				float		*pAcc	 = acc.ptr<float>(n);
+				for (int s = 0; s < acc.cols; s++) pAcc[s] += logf(MAX(FLT_MIN, pBuffer[s]));
+			}
+		}
+		/**
+		* @brief Adds the logarithm of the applied edge model to the accumulator on the OpenCL device
+		* @details This function is used by @ref CInferDense, when the OpenCL support is enabled (ref. CInferDense::setOpenCL()). The containers stay on the 
+		* device across the iterations. The default implementation does nothing and reports that the edge model has no device implementation.
+		* @param[in] src The dense graph node potentials in form UMat(size: nNodes x nStates; type: CV_32FC1)
+		* @param[in,out] acc The accumulator: UMat(size: nNodes x nStates; type: CV_32FC1)
+		* @param buffer Auxiliary container, which is reused between the calls in order to avoid the allocations
+		* @retval true if the logarithm was added to the accumulator
+		* @retval false if the edge model may not be applied on the device: the accumulator is not changed
+		*/
+		virtual bool accumulate(const UMat &src, UMat &acc, UMat &buffer) const { return false; }
+		/**
+		* @brief Returns the memory, used by the edge model
+		* @details The default implementation returns 0 for the edge models without own buffers
+		* @return The size of the host memory of the edge model in bytes (ref. CGraph::getMemoryUsage())
+		*/
+		virtual size_t getMemoryUsage(void) const { return 0; }
 	};
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "IGraphPairwise.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels
 {
@@ -7,6 +8,37 @@ namespace DirectGraphicalModels
         addEdge(srcNode, dstNode, 0, pot);
     }
     
+    void IGraphPairwise::addEdges(const Mat &edges, const vec_byte_t &vGroups, const Mat &pot)
+    {
+        DGM_ASSERT_MSG(edges.cols == 2 && edges.type() == CV_32SC1, "The edge list must be a Mat(size: nEdges x 2; type: CV_32SC1)");
+        DGM_ASSERT_MSG(vGroups.empty() || vGroups.size() == static_cast<size_t>(edges.rows), "The number of groups (%zu) does not match the number of edges (%d)", vGroups.size(), edges.rows);
+
+        for (int e = 0; e < edges.rows; e++) {
+            const int *pEdge = edges.ptr<int>(e);
+            addEdge(pEdge[0], pEdge[1], vGroups.empty() ? 0 : vGroups[e], pot);
+        }
+    }
+
+	double IGraphPairwise::computeEnergy(const vec_byte_t &vLabels) const
+	{
+		DGM_ASSERT_MSG(vLabels.size() == getNumNodes(), "The number of labels (%zu) does not match the number of nodes (%zu)", vLabels.size(), getNumNodes());
+		return parallelSum(getNumNodes(), [&](size_t begin, size_t end) {
+			Mat			pot;
+			vec_size_t	vChilds;
+			double		res = 0;
+			for (size_t n = begin; n < end; n++) {
+				getNode(n, pot);
+				res -= log(MAX(FLT_MIN, pot.at<float>(vLabels[n], 0)));
+				getChildNodes(n, vChilds);
+				for (size_t c : vChilds) {
+					getEdge(n, c, pot);
+					if (!pot.empty()) res -= log(MAX(FLT_MIN, pot.at<float>(vLabels[n], vLabels[c])));
+				}
+			} // n
+			return res;
+		});
+	}
+
     bool IGraphPairwise::isEdgeArc(size_t srcNode, size_t dstNode) const
     {
         return isEdgeExists(dstNode, srcNode);
@@ -42,12 +74,42 @@ namespace DirectGraphicalModels
 		setEdge(Node2, Node1, Pot.t());
 	}
     
+	void IGraphPairwise::setEdgePotts(size_t srcNode, size_t dstNode, float diag, float offDiag)
+	{
+		const byte nStates = getNumStates();
+		thread_local Mat pot;																// the graphs copy the potential, thus the buffer is reused
+		pot.create(nStates, nStates, CV_32FC1);
+		pot.setTo(offDiag);
+		for (byte s = 0; s < nStates; s++) pot.at<float>(s, s) = diag;
+		setEdge(srcNode, dstNode, pot);
+	}
+
+	void IGraphPairwise::setArcPotts(size_t Node1, size_t Node2, float diag, float offDiag)
+	{
+		diag	= sqrtf(diag);
+		offDiag	= sqrtf(offDiag);
+		setEdgePotts(Node1, Node2, diag, offDiag);
+		setEdgePotts(Node2, Node1, diag, offDiag);
+	}
+
     void IGraphPairwise::setArcGroup(size_t Node1, size_t Node2, byte group)
     {
         setEdgeGroup(Node1, Node2, group);
         setEdgeGroup(Node2, Node1, group);
     }
     
+    span<const float> IGraphPairwise::getEdgeView(size_t, size_t) const
+    {
+        DGM_ASSERT_MSG(false, "This graph does not support the views of the potentials");
+        return {};
+    }
+
+    span<float> IGraphPairwise::getMutableEdgeView(size_t, size_t)
+    {
+        DGM_ASSERT_MSG(false, "This graph does not support the views of the potentials");
+        return {};
+    }
+
     void IGraphPairwise::removeArc(size_t Node1, size_t Node2)
     {
         removeEdge(Node1, Node2);
@@ -112,4 +174,38 @@ namespace DirectGraphicalModels
             for (size_t &child : childNodes)   removeEdge(node, child);
         } // n
     }
+
+    void IGraphPairwise::setDirtyTracking(bool enable)
+    {
+        std::lock_guard<std::mutex> lock(m_mtxDirty);
+        m_dirtyTracking = enable;
+        m_vDirtyNodes.clear();
+        m_vDirtyFlags.clear();
+    }
+
+    vec_size_t IGraphPairwise::getDirtyNodes(void) const
+    {
+        std::lock_guard<std::mutex> lock(m_mtxDirty);
+        return m_vDirtyNodes;
+    }
+
+    void IGraphPairwise::clearDirtyNodes(void)
+    {
+        std::lock_guard<std::mutex> lock(m_mtxDirty);
+        for (size_t node : m_vDirtyNodes) m_vDirtyFlags[node] = 0;
+        m_vDirtyNodes.clear();
+    }
+
+    // ------------------------------ PRIVATE ------------------------------
+    void IGraphPairwise::markDirty(size_t begin, size_t end)
+    {
+        if (!m_dirtyTracking) return;
+        std::lock_guard<std::mutex> lock(m_mtxDirty);
+        if (m_vDirtyFlags.size() < end) m_vDirtyFlags.resize(MAX(end, getNumNodes()), 0);
+        for (size_t node = begin; node < end; node++)
+            if (!m_vDirtyFlags[node]) {
+                m_vDirtyFlags[node] = 1;
+                m_vDirtyNodes.push_back(node);
+            }
+    }
 }
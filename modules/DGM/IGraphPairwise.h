@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Graph.h"
+#include <mutex>
 #include <optional>
 
 namespace DirectGraphicalModels {
@@ -47,6 +48,14 @@ namespace DirectGraphicalModels {
 		*/
 		DllExport virtual void		addEdge(size_t srcNode, size_t dstNode, byte group, const Mat &pot) = 0;
 		/**
+		* @brief Adds a block of directed edges
+		* @details By default the edges are added one by one with addEdge(). The derived classes may validate and store the whole block at once.
+		* @param edges The edge list: Mat(size: nEdges x 2; type: CV_32SC1), where every row holds the indices of the source and of the destination nodes
+		* @param vGroups The group IDs of the edges: one per edge, or empty for the group 0
+		* @param pot %Edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1), which is set to all the added edges, or empty
+		*/
+		DllExport virtual void		addEdges(const Mat &edges, const vec_byte_t &vGroups = vec_byte_t(), const Mat &pot = EmptyMat);
+		/**
 		* @brief Sets or changes the potentional of directed edge
 		* @param srcNode index of the source node
 		* @param dstNode index of the destination node
@@ -54,6 +63,18 @@ namespace DirectGraphicalModels {
 		*/
 		DllExport virtual void		setEdge(size_t srcNode, size_t dstNode, const Mat &pot) = 0;
 		/**
+		* @brief Sets or changes the potentional of directed edge to the Potts potential
+		* @details The Potts potential matrix has the value \b diag on the main diagonal and the value \b offDiag elsewhere, \a e.g. the potentials of the 
+		* @ref CTrainEdgePotts and @ref CTrainEdgePottsCS classes with one smoothness parameter. By default the matrix is built and set with setEdge().
+		* The graphs with compact edge storage (@ref CGraphPairwiseCSR) keep only the two values, and the message passing algorithms use the 
+		* \f$O(nStates)\f$ Potts update for such edges.
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		* @param diag The diagonal value of the potential matrix
+		* @param offDiag The off-diagonal value of the potential matrix
+		*/
+		DllExport virtual void		setEdgePotts(size_t srcNode, size_t dstNode, float diag, float offDiag);
+		/**
 		* @brief Sets the potential \b pot to all edges belonging to group \b group
 		* @details This function assigns the same potential matrix to all the edges in graph with group property equal to \b group.
 		* By default all edges have group 0. This mightbe changes with functon @ref setEdgeGroup()
@@ -69,6 +90,27 @@ namespace DirectGraphicalModels {
 		*/
 		DllExport virtual void		getEdge(size_t srcNode, size_t dstNode, Mat &pot) const = 0;
 		/**
+		* @brief Returns the view of the edge potential
+		* @details In contrast to getEdge(), the potential is not copied: the view addresses the storage of the graph and remains valid until the edges
+		* are added, removed or their potentials are set. The view is empty if the potential of the edge is not set, or if the graph stores it in the compact
+		* form (ref. CGraphPairwiseCSR::setEdgePotts()); getEdge() expands such potentials into the full matrix.
+		* > This function supports PPL
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		* @return The view of the \a nStates x \a nStates values of the edge potential matrix in the row-major order
+		*/
+		DllExport virtual span<const float>	getEdgeView(size_t srcNode, size_t dstNode) const;
+		/**
+		* @brief Returns the mutable view of the edge potential
+		* @details The potential, shared with other edges (ref. setEdges()) or with the copies of the graph (ref. clone()), is detached first, as with setEdge(),
+		* thus the changes made through the view affect this edge only. The compact potentials are expanded into the full matrix.
+		* > This function supports PPL
+		* @param srcNode index of the source node
+		* @param dstNode index of the destination node
+		* @return The mutable view of the \a nStates x \a nStates values of the edge potential matrix in the row-major order, or an empty view if the potential is not set
+		*/
+		DllExport virtual span<float>		getMutableEdgeView(size_t srcNode, size_t dstNode);
+		/**
 		* @brief Assigns a directed edge (\b srcNode) --> (\b dstNode) to the group \b group
 		* @param srcNode index of the source node
 		* @param dstNode index of the destination node
@@ -143,6 +185,19 @@ namespace DirectGraphicalModels {
 		*/
 		DllExport virtual void		setArc(size_t Node1, size_t Node2, const Mat &pot);
 		/**
+		* @brief Sets or changes the Potts potentional of udirected edge (arc)
+		* @details The arc is emulated by two directed edges. For sake of consistency with setArc() the values here are squarerooted:
+		* @code
+		* setEdgePotts(Node1, Node2, sqrt(diag), sqrt(offDiag));
+		* setEdgePotts(Node2, Node1, sqrt(diag), sqrt(offDiag));
+		* @endcode
+		* @param Node1 index of the first node
+		* @param Node2 index of the second node
+		* @param diag The diagonal value of the potential matrix
+		* @param offDiag The off-diagonal value of the potential matrix
+		*/
+		DllExport void				setArcPotts(size_t Node1, size_t Node2, float diag, float offDiag);
+		/**
 		* @brief Assigns an undirected edge (arc) (\b Node1) -- (\b Node2) to the group \b group
 		* @param Node1 index of the source node
 		* @param Node2 index of the destination node
@@ -163,5 +218,54 @@ namespace DirectGraphicalModels {
 		* @retval false otherwise
 		*/
 		DllExport virtual bool		isArcExists(size_t Node1, size_t Node2) const;
+		/**
+		* @brief Calculates the energy of a configuration
+		* @details This generic implementation reads the potentials with getNode() and getEdge(); the graphs with the flat storages override it
+		* with the direct access to the potentials (ref. CGraph::computeEnergy())
+		* > This function supports PPL
+		* @param vLabels The configuration: the states of all the nodes
+		* @return The energy
+		*/
+		DllExport double			computeEnergy(const vec_byte_t &vLabels) const override;
+		/**
+		* @brief Enables or disables the tracking of the changed nodes
+		* @details If enabled, the nodes, whose potentials are set with setNode() or setNodes(), are collected, so that the inference may be restricted to
+		* the region around them (ref. CMessagePassing::setIncremental()). A change of an edge potential with setEdge() or getMutableEdgeView() marks both
+		* nodes of the edge as changed, and a change with setEdges() marks all the nodes. The tracking is not copied by clone()
+		* @param enable Flag indicating whether the changed nodes should be tracked. Enabling or disabling the tracking clears the changed nodes
+		*/
+		DllExport void				setDirtyTracking(bool enable);
+		/**
+		* @brief Checks whether the changed nodes are tracked
+		* @retval true if the tracking is enabled
+		* @retval false otherwise
+		*/
+		DllExport bool				isDirtyTracking(void) const { return m_dirtyTracking; }
+		/**
+		* @brief Returns the nodes, changed since the last call of clearDirtyNodes()
+		* @return The indexes of the changed nodes in the order of their first change
+		*/
+		DllExport vec_size_t		getDirtyNodes(void) const;
+		/**
+		* @brief Clears the set of the changed nodes
+		*/
+		DllExport void				clearDirtyNodes(void);
+
+
+	protected:
+		/**
+		* @brief Registers the change of the node potentials
+		* @details The derived classes should call this function in setNode() and setNodes(). It may be called concurrently
+		* @param begin The index of the first changed node
+		* @param end The index past the last changed node
+		*/
+		void						markDirty(size_t begin, size_t end);
+
+
+	private:
+		bool						m_dirtyTracking = false;	///< Flag indicating whether the changed nodes are tracked
+		vec_size_t					m_vDirtyNodes;				///< The changed nodes
+		vec_byte_t					m_vDirtyFlags;				///< Flags indicating whether a node is in m_vDirtyNodes
+		mutable std::mutex			m_mtxDirty;					///< The mutex, protecting the changed nodes
 	};
 }  
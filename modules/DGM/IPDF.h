@@ -3,6 +3,7 @@
 #pragma once
 
 #include "BaseRandomModel.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels 
 {
@@ -27,12 +28,37 @@ namespace DirectGraphicalModels
 		 * @param point The sample point.
 		 */
 		DllExport virtual void		addPoint(Scalar point) = 0;
+		/**
+		 * @brief Merges the samples of another PDF into this one
+		 * @details After merging, this PDF is equal to the PDF, estimated from the samples of both PDFs
+		 * @param pdf The PDF of the same type
+		 */
+		DllExport virtual void		merge(const IPDF &pdf) = 0;
 		/**
 		 * @brief Returns the probability density value for the argument \b point.
 		 * @param point The sample point.
 		 * @returns The corresponding probaility density value.
 		 */
 		DllExport virtual double	getDensity(Scalar point) = 0;
+		/**
+		 * @brief Returns the probability density values for a batch of points
+		 * @details The default implementation calls getDensity() for every point. The derived classes evaluate the whole batch without the virtual
+		 * call and the Scalar conversion per point.
+		 * @param points The sample points: Mat(size: nPoints x nDims; type: CV_8UC1 or CV_32FC1), where nDims is the dimension of the PDF (up to 4)
+		 * @param densities The corresponding probability density values: Mat(size: nPoints x 1; type: CV_32FC1)
+		 */
+		DllExport virtual void		getDensities(const Mat &points, Mat &densities)
+		{
+			DGM_ASSERT(points.cols <= 4);
+			Mat pts;
+			points.convertTo(pts, CV_64FC1);
+			densities.create(points.rows, 1, CV_32FC1);
+			for (int i = 0; i < pts.rows; i++) {
+				Scalar point;
+				for (int d = 0; d < pts.cols; d++) point[d] = pts.at<double>(i, d);
+				densities.at<float>(i, 0) = static_cast<float>(getDensity(point));
+			}
+		}
 		/**
 		 * @brief Performs the gaussian smoothing on the histogram
 		 * @details Performs \b nIt iterations of gaussian smothing of the histograms in order to overcome the "over-fitting" problem
@@ -49,6 +75,12 @@ namespace DirectGraphicalModels
 		 * @returns The upper bound
 		 */
 		DllExport virtual Scalar	max(void) const = 0;
+		/**
+		 * @brief Returns the memory, used by the PDF
+		 * @details The default implementation returns only the size of this base object: the derived PDFs should add the sizes of their members and containers
+		 * @returns The size of the PDF in bytes
+		 */
+		DllExport virtual size_t	getMemoryUsage(void) const { return sizeof(*this); }
 		/**
 		 * @brief Checks weather the PDF was estimated.
 		 * @retval true if at least one sample was added with the addPoint() function.
@@ -35,6 +35,13 @@ namespace DirectGraphicalModels
 		* @return Number of features
 		*/		
 		DllExport word			getNumFeatures(void) const { return m_nFeatures; }
+		/**
+		* @brief Returns the memory, used by the trainer
+		* @details The result includes the trained model and the accumulated training data. The models, kept by the external libraries 
+		* (\a e.g. OpenCV and Sherwood), are not accounted. The default implementation returns 0
+		* @return The size of the trainer in bytes
+		*/
+		DllExport virtual size_t getMemoryUsage(void) const { return 0; }
 
 
 	private:
@@ -1,46 +1,220 @@
 #include "Infer.h"
 #include "Decode.h"
 #include "Graph.h"
+#include "LabelEncoding.h"
+#include "simd.h"
+#include "profiler.h"
+#include "ThreadPool.h"
+#include "footprint.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels
 {
 	vec_byte_t CInfer::decode(unsigned int nIt, Mat &lossMatrix) 
 	{
+		DGM_PROFILE_ZONE("decode");
 		if (nIt) infer(nIt);
-		return CDecode::decode(getGraph(), lossMatrix);
+		else resetStats();
+		beginPhase("decoding");
+		const Mat *pBeliefs = getFilledOutput();
+		if (!pBeliefs) {
+			vec_byte_t res = CDecode::decode(getGraph(), lossMatrix);
+			endPhase();
+			return res;
+		}
+
+		vec_byte_t res(pBeliefs->rows);
+		if (pBeliefs->rows) {
+			Mat labels(pBeliefs->rows, 1, CV_8UC1, res.data());
+			CDecode::decodeLabels(*pBeliefs, labels, lossMatrix);
+		}
+		endPhase();
+		return res;
+	}
+
+	Mat CInfer::getMarginals(void) const
+	{
+		const Mat *pBeliefs = getFilledOutput();
+		if (pBeliefs) return *pBeliefs;
+		
+		Mat res;
+		if (getGraph().getNumNodes()) getGraph().getNodes(0, 0, res);
+		return res;
 	}
 	
+	size_t CInfer::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + m_arena.getCapacity() + footprint::getBytes(m_marginals) + footprint::getBytes(m_stats.vResiduals)
+			+ footprint::getBytes(m_stats.vEnergies) + footprint::getBytes(m_stats.vIterationTimes) + footprint::getBytes(m_stats.vPhaseTimes);
+	}
+
+	bool CInfer::isConverged(unsigned int it, float residual, size_t nMessages)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		m_nIterations	= it + 1;
+		m_residual		= residual;
+
+		m_stats.nIterations	 = m_nIterations;
+		m_stats.nMessages	+= nMessages;
+		m_stats.vResiduals.push_back(residual);
+		m_stats.vIterationTimes.push_back(std::chrono::duration<float, std::milli>(now - m_iterationStart).count());
+		m_stats.arenaBytes	 = MAX(m_stats.arenaBytes, m_pArena->getCapacity());
+		m_iterationStart	 = now;
+
+		if (m_progress && m_nIterations % m_progressPeriod == 0) m_progress(m_nIterations, getCurrentBeliefs());
+		if (m_budget.isExpired()) return true;
+		m_stats.converged = m_epsilon > 0 && residual < m_epsilon;
+		return m_stats.converged;
+	}
+
+	void CInfer::setProgressCallback(progress_function_t callback, unsigned int period)
+	{
+		DGM_ASSERT_MSG(period > 0, "The period of the progress callback must be positive");
+		m_progress			= callback;
+		m_progressPeriod	= period;
+	}
+
+	void CInfer::resetConvergence(void)
+	{
+		m_nIterations	= 0; 
+		m_residual		= 0; 
+		m_budget.start();
+		resetStats();
+	}
+
+	void CInfer::resetStats(void)
+	{
+		m_stats = InferStats();
+#ifdef ENABLE_PDP
+		switch (parallel::getBackend()) {
+			case parallel::Backend::pool:	m_stats.nThreads = CThreadPool::getDefault().getNumThreads(); break;
+			case parallel::Backend::opencv:	m_stats.nThreads = static_cast<size_t>(MAX(1, getNumThreads())); break;
+			case parallel::Backend::host:	m_stats.nThreads = 0; break;					// unknown
+		}
+#endif
+		m_stats.arenaBytes	= m_pArena->getCapacity();
+		m_iterationStart	= std::chrono::steady_clock::now();
+		m_phase				= NULL;
+	}
+
+	void CInfer::beginPhase(const char *name)
+	{
+		endPhase();
+		m_phase			= name;
+		m_phaseStart	= std::chrono::steady_clock::now();
+	}
+
+	void CInfer::endPhase(void)
+	{
+		if (!m_phase) return;
+		m_stats.vPhaseTimes.emplace_back(m_phase, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_phaseStart).count());
+		m_stats.arenaBytes = MAX(m_stats.arenaBytes, m_pArena->getCapacity());
+		m_phase = NULL;
+	}
+
+	// The confidence values are written by getResults() directly into the vector; the potentials of the graph are read block by block with getNodes(),
+	// thus the graphs without the views of the potentials are supported
 	vec_float_t CInfer::getConfidence(void) const
 	{
-		size_t nNodes = getGraph().getNumNodes();
+		const size_t nNodes = getGraph().getNumNodes();
 		vec_float_t res(nNodes);
-		Mat pot, srt;
+		if (nNodes == 0) return res;
 
-		for (size_t n = 0; n < nNodes; n++) {						// all nodes
-			getGraph().getNode(n, pot);
-		
-			sort(pot, srt, cv::SortFlags::SORT_EVERY_COLUMN | cv::SortFlags::SORT_DESCENDING);
+		Mat labels;
+		Mat confidence(static_cast<int>(nNodes), 1, CV_32FC1, res.data());
+		getResults(labels, &confidence);
+		return res;
+	}
+
+	void CInfer::getResults(Mat &labels, Mat *pConfidence, Mat *pMarginals) const
+	{
+		const size_t	nNodes		= getGraph().getNumNodes();
+		const byte		nStates		= getGraph().getNumStates();
+		const int		blockSize	= 4096;							// nodes per block
+		const int		nBlocks		= static_cast<int>((nNodes + blockSize - 1) / blockSize);
+		const Mat	  * pBeliefs	= getFilledOutput();
 
-			float max		 = srt.at<float>(0, 0);
-			float second_max = srt.at<float>(1, 0);
+		// Keeps the container, if it holds nNodes x nValues continuous values of the given depth
+		auto prepare = [nNodes](Mat &m, int depth, int nValues, bool multiChannel) {
+			if (m.total() * m.channels() != nNodes * nValues || m.depth() != depth || !m.isContinuous() || (!multiChannel && m.channels() != 1))
+				m.create(static_cast<int>(nNodes), nValues, CV_MAKETYPE(depth, 1));
+		};
+		prepare(labels, labels.depth() == CV_16U ? CV_16U : CV_8U, 1, false);
+		if (pConfidence) prepare(*pConfidence, CV_32F, 1, false);
+		if (pMarginals)	 prepare(*pMarginals, CV_32F, nStates, true);
 
-			res[n] = (max == 0) ? 0.0f :  1.0f - second_max / max;
-		} // n
-	
-		return res;
+		byte	* pLabels8	= labels.depth() == CV_8U ? labels.ptr<byte>() : NULL;
+		word	* pLabels16 = labels.depth() == CV_16U ? labels.ptr<word>() : NULL;
+		float	* pConf		= pConfidence ? pConfidence->ptr<float>() : NULL;
+		float	* pMarg		= pMarginals ? pMarginals->ptr<float>() : NULL;
+
+		parallel::parallelFor(Range(0, nBlocks), [&](const Range& range) {
+			Mat pots;
+			for (int b = range.start; b < range.end; b++) {
+				const size_t start	= static_cast<size_t>(b) * blockSize;
+				const size_t num	= MIN(static_cast<size_t>(blockSize), nNodes - start);
+				if (!pBeliefs) getGraph().getNodes(start, num, pots);
+				for (size_t i = 0; i < num; i++) {
+					const size_t  n		= start + i;
+					const float * pot	= pBeliefs ? pBeliefs->ptr<float>(static_cast<int>(n)) : pots.ptr<float>(static_cast<int>(i));
+					const byte	  state = simd::argMax(pot, nStates);
+					if (pLabels8) pLabels8[n] = state;
+					else pLabels16[n] = state;
+					if (pConf) {
+						float second_max = 0;
+						for (byte s = 0; s < nStates; s++) if (s != state && second_max < pot[s]) second_max = pot[s];
+						pConf[n] = (pot[state] == 0) ? 0.0f : 1.0f - second_max / pot[state];
+					}
+					if (pMarg) memcpy(pMarg + n * nStates, pot, nStates * sizeof(float));
+				} // i
+			} // b
+		});
+	}
+
+	void CInfer::encodeResults(Size size, PackedLabels *pPacked, RunLengthLabels *pRuns, LabelStats *pStats) const
+	{
+		const size_t	nNodes		= getGraph().getNumNodes();
+		const byte		nStates		= getGraph().getNumStates();
+		const Mat	  * pBeliefs	= getFilledOutput();
+		DGM_ASSERT_MSG(static_cast<size_t>(size.width) * size.height == nNodes, "The size %d x %d does not correspond to the number of nodes (%zu)", size.width, size.height, nNodes);
+
+		CLabelEncoder::encode(size, nStates, [&](int y, byte *pRow) {
+			thread_local Mat pots;															// the rows of one thread re-use the buffer
+			const size_t start = static_cast<size_t>(y) * size.width;
+			if (!pBeliefs) getGraph().getNodes(start, size.width, pots);
+			for (int x = 0; x < size.width; x++) {
+				const float *pot = pBeliefs ? pBeliefs->ptr<float>(static_cast<int>(start + x)) : pots.ptr<float>(x);
+				pRow[x] = simd::argMax(pot, nStates);
+			}
+		}, pPacked, pRuns, pStats);
 	}
 
 	vec_float_t CInfer::getPotentials(byte state) const 
 	{
-		size_t nNodes = getGraph().getNumNodes();
+		const size_t nNodes		= getGraph().getNumNodes();
+		const size_t blockSize	= 4096;								// nodes per block
 		vec_float_t res(nNodes);
-		Mat pot;
+		const Mat *pBeliefs = getFilledOutput();
 
-		for (size_t n = 0; n < nNodes; n++) {						// all nodes
-			getGraph().getNode(n, pot);
-			res[n] = pot.at<float>(state, 0);
-		} // n
+		if (pBeliefs)
+			for (size_t n = 0; n < nNodes; n++)						// all nodes
+				res[n] = pBeliefs->at<float>(static_cast<int>(n), state);
+		else {
+			Mat pots;
+			for (size_t start = 0; start < nNodes; start += blockSize) {
+				const size_t num = MIN(blockSize, nNodes - start);
+				getGraph().getNodes(start, num, pots);
+				for (size_t i = 0; i < num; i++) res[start + i] = pots.at<float>(static_cast<int>(i), state);
+			}
+		}
 
 		return res;
 	}
+
+	const Mat* CInfer::getFilledOutput(void) const
+	{
+		if (!m_pBeliefs) return NULL;
+		const bool filled = m_pBeliefs->rows == static_cast<int>(getGraph().getNumNodes()) && m_pBeliefs->cols == getGraph().getNumStates() && m_pBeliefs->type() == CV_32FC1;
+		return filled ? m_pBeliefs : NULL;
+	}
 }
\ No newline at end of file
@@ -5,11 +5,37 @@
 #pragma once
 
 #include "types.h"
+#include "Arena.h"
+#include "TimeBudget.h"
+#include <functional>
 
 namespace DirectGraphicalModels 
 {
 	class CGraph;
+	struct PackedLabels;
+	struct RunLengthLabels;
+	struct LabelStats;
 	
+	/// Norms of the residual, used in the convergence criterion of the iterative inference
+	enum class ResidualNorm {
+		max,		///< Maximal L1-norm of the change of a message (node potential) between two iterations
+		mean		///< Mean L1-norm of the change of the messages (node potentials) between two iterations
+	};
+
+	/// Statistics of the last inference (ref. CInfer::getStats())
+	struct InferStats {
+		unsigned int	nIterations		= 0;		///< The number of the performed iterations
+		size_t			nMessages		= 0;		///< The number of the computed messages, or of the updated node potentials for @ref CInferDense
+		vec_float_t		vResiduals;					///< The residual after every iteration, in the norm given in CInfer::setConvergence()
+		vec_float_t		vEnergies;					///< The energy after every iteration, if the algorithm tracks it (@ref CInferGraphCut and @ref CInferTRW with the energy tracking)
+		vec_float_t		vIterationTimes;			///< The wall time of every iteration in milliseconds. The time of the first iteration includes the preparation, which is not timed as a separate phase
+		std::vector<std::pair<const char *, float>> vPhaseTimes;	///< The wall times of the phases in milliseconds, \a e.g. "setup", "messages", "beliefs" for @ref CMessagePassing and "decoding" for CInfer::decode()
+		size_t			arenaBytes		= 0;		///< The capacity of the memory arena of the inferer in bytes (ref. CArena::getCapacity())
+		size_t			nThreads		= 1;		///< The number of threads of the parallel backend, or 0 for the executor of the host application (parallel::Backend::host), whose concurrency is unknown
+		vec_size_t		vNumaBytes;					///< The bytes of the message buffers and of the contiguous graph potentials on every NUMA node, or empty if the NUMA placement is disabled (ref. numa::isEnabled())
+		bool			converged		= false;	///< Flag indicating whether the convergence criterion was fulfilled
+	};
+
 	// ================================ Infer Class ===============================
 	/**
 	* @ingroup moduleDecode
@@ -19,11 +45,18 @@ namespace DirectGraphicalModels
 	class CInfer
 	{
 	public:
+		/**
+		* @brief Progress function
+		* @details Receives the number of the completed iterations and the read-only view of the current beliefs: Mat(size: nNodes x nStates; type: CV_32FC1),
+		* or an empty Mat, if the algorithm does not provide them. The view refers to the buffers of the inferer and is valid only during the call
+		*/
+		using progress_function_t = std::function<void(unsigned int nIt, const Mat &beliefs)>;
+
 		/**
 		* @brief Constructor
 		* @param graph The graph
 		*/
-		DllExport CInfer(CGraph &graph) : m_graph(graph) {}
+		DllExport CInfer(CGraph &graph) : m_graph(graph), m_epsilon(0), m_residualNorm(ResidualNorm::max), m_nIterations(0), m_residual(0) {}
         CInfer(const CInfer&) = delete;
         DllExport virtual ~CInfer() = default;
         const CInfer& operator= (const CInfer&) = delete;
@@ -31,8 +64,8 @@ namespace DirectGraphicalModels
 		/**
 		* @brief Inference
 		* @details This function estimates the marginal potentials for each graph node, and stores them as node potentials
-		* > This function modifies Node::Pot containers of graph nodes
-		* @param nIt Number of iterations
+		* > This function modifies Node::Pot containers of graph nodes, unless the output buffer is set (ref. setOutput() and setKeepPotentials())
+		* @param nIt Number of iterations. If the convergence criterion is set with setConvergence(), this is the maximal number of iterations
 		* @note This function must not to be linear, \a i.e. \f$ infer(\alpha\times N)\not\equiv\alpha\times infer(N) \f$
 		* @note This function substitutes the graph nodes' potentials with estimated marginal potentials
 		*/
@@ -42,7 +75,7 @@ namespace DirectGraphicalModels
 		* @details This function calls first inference @ref infer() and then, using resulting marginal probabilities, estimates the most
 		* probable configuration of states (classes) in the graph via CDecode::decode().
 		* > This function modifies Node::Pot containers of graph nodes
-		* @param nIt Number of iterations
+		* @param nIt Number of iterations. If the convergence criterion is set with setConvergence(), this is the maximal number of iterations
 		* @param lossMatrix (optional) The loss matrix \f$L\f$ (size: nStates x nStates; type: CV_32FC1).
 		* It must be a quadratic zero-diagonal matrix, whith all non-diagonal elements \f$L_{i,j} > 0, \forall i\neq j\f$.
 		* The elemets \f$L_{i,j}\f$ represent a loss if state \f$j\f$ is classified as a state \f$i\f$.
@@ -72,6 +105,138 @@ namespace DirectGraphicalModels
 		* @return The potential values for each node of the graph.
 		*/
 		DllExport vec_float_t	getPotentials(byte state) const;
+		/**
+		* @brief Returns the results of the inference in the caller's containers
+		* @details This function fills the most probable states (as decode() without the loss matrix), the confidence values (as getConfidence()) and
+		* the marginal potentials of all the nodes in one parallel pass, reading the potentials in blocks with CGraph::getNodes() or, if the external output 
+		* buffer is set (ref. setOutput()) and filled by infer(), directly from this buffer. Every container, which is already allocated with the required number
+		* of continuous elements of a supported type, is filled in place: thus, the results of the graphs, built over an image, may be written directly into the 
+		* images of the same size.
+		* > This function supports PPL
+		* @param[out] labels The most probable states: Mat(type: CV_8UC1 or CV_16UC1) with \a nNodes elements, \a e.g. the label image. The 16-bit containers
+		* are supported for the label images, which should accommodate more than 255 labels. If not allocated appropriately, it is allocated as Mat(size: nNodes x 1; type: CV_8UC1)
+		* @param[out] pConfidence (optional) Pointer to the confidence values: Mat(type: CV_32FC1) with \a nNodes elements. If not allocated appropriately,
+		* it is allocated as Mat(size: nNodes x 1; type: CV_32FC1)
+		* @param[out] pMarginals (optional) Pointer to the marginal potentials: Mat(depth: CV_32F) with \a nNodes x \a nStates values, \a e.g. Mat(size: width x height;
+		* type: CV_32FC(nStates)). If not allocated appropriately, it is allocated as Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		DllExport void			getResults(Mat &labels, Mat *pConfidence = NULL, Mat *pMarginals = NULL) const;
+		/**
+		* @brief Returns the most probable states in the compact form
+		* @details This function runs the same argmax pass as getResults(), row by row in parallel, and passes every row directly to the encoders of
+		* @ref CLabelEncoder: the bit-packed labels, the run-length encoded rows and the area and the bounding box of every state are produced without
+		* the byte label map of the whole graph. The graph must be a 2D grid, whose node \f$(x, y)\f$ has the index \f$y \cdot width + x\f$, as built by @ref CGraphPairwiseExt.
+		* > This function supports PPL
+		* @param size The size of the grid (image): \a size.area() must be equal to the number of nodes
+		* @param[in,out] pPacked (optional) Pointer to the bit-packed labels. If its \a nBits is zero, the minimal number of bits is used (ref. CLabelEncoder::getNumBits())
+		* @param[out] pRuns (optional) Pointer to the run-length encoded labels
+		* @param[out] pStats (optional) Pointer to the statistics of the labels
+		*/
+		DllExport void			encodeResults(Size size, PackedLabels *pPacked, RunLengthLabels *pRuns = NULL, LabelStats *pStats = NULL) const;
+		/**
+		* @brief Sets the convergence criterion for the iterative inference
+		* @details If set, the iterative inference algorithms (@ref CInferLBP, @ref CInferViterbi, @ref CInferTRW and @ref CInferDense) stop as soon as
+		* the residual, \a i.e. the change of the messages (or node potentials) during one iteration, falls below \b epsilon. The residual is 
+		* accumulated while the messages are written, and thus adds no extra pass over the graph.
+		* @param epsilon The threshold for the residual. Zero value disables the criterion (default): the inference always runs the given number of iterations
+		* @param norm The norm of the residual (Ref. @ref ResidualNorm)
+		*/
+		DllExport void			setConvergence(float epsilon, ResidualNorm norm = ResidualNorm::max) { m_epsilon = epsilon; m_residualNorm = norm; }
+		/**
+		* @brief Returns the number of iterations, performed by the last call of infer()
+		* @return The number of iterations, or 0 for the non-iterative inference algorithms
+		*/
+		DllExport unsigned int	getNumIterations(void) const { return m_nIterations; }
+		/**
+		* @brief Returns the residual after the last iteration of the last call of infer()
+		* @details The residual is measured in the norm, given in setConvergence()
+		* @return The residual, or 0 for the non-iterative inference algorithms
+		*/
+		DllExport float			getResidual(void) const { return m_residual; }
+		/**
+		* @brief Returns the statistics of the last call of infer() or decode()
+		* @details The statistics are collected at the end of every iteration and of every phase of the inference, thus they cost a few timer calls per iteration
+		* and are always on. The statistics of decode(0), which does not run the inference, contain only the decoding phase. They may be used, \a e.g. to detect the regressions of the convergence or the run time:
+		* @code
+		* graphKit.getInfer().setConvergence(1e-3f);
+		* graphKit.getInfer().decode(100);
+		* const InferStats &stats = graphKit.getInfer().getStats();
+		* if (!stats.converged) printf("No convergence in %u iterations: residual %f\n", stats.nIterations, stats.vResiduals.back());
+		* @endcode
+		* @return The statistics (Ref. @ref InferStats)
+		*/
+		DllExport const InferStats& getStats(void) const { return m_stats; }
+		/**
+		* @brief Returns the memory, used by the inferer
+		* @details The result includes the own memory arena,  i.e. the message buffers, the own output buffer and the containers of the derived classes,
+		* which are kept between the inferences. The graph and the external arena (ref. setArena()) are not included. The peak memory of the 
+		* inference may be estimated before building the graph with CGraphPairwiseKit::estimateMemory()
+		* @return The size of the inferer in bytes
+		*/
+		DllExport virtual size_t	getMemoryUsage(void) const;
+		/**
+		* @brief Sets the time budget of the inference
+		* @details If set, the iterative inference algorithms stop after the iteration, during which the budget has expired, and the exact inference
+		* stops after the current chunk of configurations. The result of the interrupted inference is the best current solution, and the number of the 
+		* completed iterations is returned by getNumIterations().
+		* @param budget The maximal duration of one call of infer(). Zero value disables the time budget (default)
+		*/
+		DllExport void			setTimeBudget(std::chrono::milliseconds budget) { m_budget.setTimeBudget(budget); }
+		/**
+		* @brief Sets the cancellation token of the inference
+		* @details The inference is interrupted the same way as with the time budget (ref. setTimeBudget()), as soon as the token is set from another thread
+		* @param pToken Pointer to the flag, which cancels the inference once set to \a true, or NULL to disable the cancellation (default)
+		*/
+		DllExport void			setCancellationToken(const std::atomic<bool> *pToken) { m_budget.setCancellationToken(pToken); }
+		/**
+		* @brief Checks whether the last call of infer() was interrupted
+		* @retval true if the time budget has expired or the inference was cancelled
+		* @retval false otherwise
+		*/
+		DllExport bool			isInterrupted(void) const { return m_budget.hasExpired(); }
+		/**
+		* @brief Sets the progress callback of the iterative inference
+		* @details The callback is called in the inferring thread after every \b period iterations and receives the current beliefs, so that the labelling
+		* may be watched while it converges, \a e.g. with vis::CProgressViewer. The inference waits for the callback, which therefore should only copy the view or skip it.
+		* The beliefs are provided by the message passing algorithms (@ref CMessagePassing), where they are calculated from the current messages at the cost
+		* of one pass over the graph per call, and by @ref CInferDense, where the current distribution is viewed directly (except for the OpenCL path).
+		* For @ref CInferTRW the beliefs are the normalized reparametrized node potentials, which are maximal for the current solution
+		* @param callback The progress function, or \a nullptr to disable the callback (default)
+		* @param period The number of iterations between two calls
+		*/
+		DllExport void			setProgressCallback(progress_function_t callback, unsigned int period = 1);
+		/**
+		* @brief Sets the external memory arena
+		* @details By default every inferer owns its arena (ref. getArena()). Many short-lived inferers, \a e.g. one per small graph, may share one
+		* external arena instead, so that the memory is allocated only once. The arena must outlive the inferer and must not be used by two inferers concurrently
+		* @param pArena Pointer to the external arena, or NULL to use the own arena
+		*/
+		DllExport void			setArena(CArena *pArena) { m_pArena = pArena ? pArena : &m_arena; }
+		/**
+		* @brief Sets the external output buffer for the marginal potentials
+		* @details If set, infer() leaves the node potentials of the graph unchanged and writes the estimated marginal potentials into the buffer instead,
+		* so that the graph, \a e.g. its copy (ref. CGraph::clone()), may be re-used for the next inference without re-filling the node potentials.
+		* The output buffer is supported by the message passing algorithms (@ref CMessagePassing) and by @ref CInferExact, @ref CInferLBP3 and @ref CInferDense.
+		* > Once the buffer is filled by infer(), the functions decode(), getConfidence(), getPotentials(), getResults() and getMarginals() read the buffer
+		* @param pBeliefs Pointer to the buffer, which is (re-)allocated as Mat(size: nNodes x nStates; type: CV_32FC1), or NULL to write the marginal 
+		* potentials into the graph (default). The buffer must outlive the inferer
+		*/
+		DllExport void			setOutput(Mat *pBeliefs) { m_pBeliefs = pBeliefs; }
+		/**
+		* @brief Enables or disables keeping the node potentials of the graph
+		* @details If enabled, infer() writes the marginal potentials into the own buffer of the inferer, the same way as into the external output buffer
+		* (ref. setOutput()). Thus, the original node potentials (unaries) stay intact: the inference may be repeated, \a e.g. with other parameters, without
+		* rebuilding the graph, and both the unaries and the marginals (ref. getMarginals()) are available. The buffer is allocated once and re-used by the next inferences.
+		* @param enable Flag indicating whether the node potentials of the graph should be kept. Disabling resets the external output buffer as well
+		*/
+		DllExport void			setKeepPotentials(bool enable) { m_pBeliefs = enable ? &m_marginals : NULL; }
+		/**
+		* @brief Returns the marginal potentials of all the nodes
+		* @details If the output buffer is set (ref. setOutput() and setKeepPotentials()) and filled, the buffer is returned without copying. 
+		* Otherwise the node potentials of the graph, \a i.e. the marginals after the inference, are copied in one block with CGraph::getNodes()
+		* @return The marginal potentials: Mat(size: nNodes x nStates; type: CV_32FC1). For the max-product inference (\a e.g. @ref CInferViterbi) these are the max-marginals
+		*/
+		DllExport Mat			getMarginals(void) const;
 
 
 	protected:
@@ -80,9 +245,98 @@ namespace DirectGraphicalModels
 		* @return The reference to the graph
 		*/
 		CGraph& getGraph(void) const { return m_graph; }
+		/**
+		* @brief Returns the norm of the residual
+		* @return The norm of the residual (Ref. @ref ResidualNorm)
+		*/
+		ResidualNorm getResidualNorm(void) const { return m_residualNorm; }
+		/**
+		* @brief Returns the memory arena of the inferer
+		* @details The derived classes allocate their per-inference buffers here: the memory is kept between the calls of infer()
+		* @return The memory arena: the own one or the external one (ref. setArena())
+		*/
+		CArena&	getArena(void) { return *m_pArena; }
+		/**
+		* @brief Registers the iteration of the iterative inference and checks the convergence
+		* @details This function should be called by the derived classes at the end of every iteration
+		* @param it The index of the iteration (starting from 0)
+		* @param residual The residual of the iteration
+		* @retval true if the convergence criterion is set and fulfilled, or the inference is interrupted (ref. setTimeBudget())
+		* @retval false otherwise
+		*/
+		bool	isConverged(unsigned int it, float residual, size_t nMessages = 0);
+		/**
+		* @brief Resets the number of iterations, the residual and the statistics and starts the time budget
+		* @details This function should be called by the derived classes in the beginning of infer()
+		*/
+		void	resetConvergence(void);
+		/**
+		* @brief Resets the statistics
+		* @details This function is called by resetConvergence() and by decode(0), which decodes without the inference
+		*/
+		void	resetStats(void);
+		/**
+		* @brief Starts a phase of the inference
+		* @details The previous phase, if any, is finished. The wall time of the phase is stored in InferStats::vPhaseTimes
+		* @param name The name of the phase: a string literal
+		*/
+		void	beginPhase(const char *name);
+		/**
+		* @brief Finishes the current phase of the inference
+		*/
+		void	endPhase(void);
+		/**
+		* @brief Registers the energy of the current solution
+		* @details The iterative algorithms, which calculate the energy anyway, should call this function once per iteration
+		* @param energy The energy
+		*/
+		void	addEnergy(float energy) { m_stats.vEnergies.push_back(energy); }
+		/**
+		* @brief Registers the placement of the inferer buffers on the NUMA nodes
+		* @param vBytes The number of bytes on every NUMA node (ref. numa::getPlacement())
+		*/
+		void	setNumaBytes(const vec_size_t &vBytes) { m_stats.vNumaBytes = vBytes; }
+		/**
+		* @brief Returns the time budget of the inference
+		* @details The non-iterative algorithms may check CTimeBudget::isExpired() between the chunks of work
+		* @return The time budget
+		*/
+		const CTimeBudget& getTimeBudget(void) const { return m_budget; }
+		/**
+		* @brief Returns the external output buffer for the marginal potentials
+		* @return The pointer to the buffer, or NULL if the marginal potentials should be written into the graph (ref. setOutput())
+		*/
+		Mat*	getOutput(void) const { return m_pBeliefs; }
+		/**
+		* @brief Returns the output buffer for the marginal potentials, if it is filled
+		* @return The pointer to the buffer, if it is set and holds the potentials of all the nodes of the graph, or NULL otherwise
+		*/
+		const Mat* getFilledOutput(void) const;
+		/**
+		* @brief Returns the beliefs after the current iteration
+		* @details This function is called by isConverged() for the progress callback (ref. setProgressCallback()). The derived classes should
+		* return a view of their buffers, which does not disturb the inference; the default implementation returns an empty Mat
+		* @return The beliefs: Mat(size: nNodes x nStates; type: CV_32FC1), or an empty Mat
+		*/
+		virtual Mat	getCurrentBeliefs(void) { return Mat(); }
 
         
 	private:
-		CGraph & m_graph;
+		CGraph		 & m_graph;
+		float		   m_epsilon;			///< The threshold for the residual
+		ResidualNorm   m_residualNorm;		///< The norm of the residual
+		unsigned int   m_nIterations;		///< The number of iterations, performed by the last inference
+		float		   m_residual;			///< The residual after the last inference
+		CArena		   m_arena;				///< Memory for the per-inference buffers
+		CArena		 * m_pArena = &m_arena;	///< The arena in use
+		CTimeBudget	   m_budget;			///< The time budget and the cancellation token
+		InferStats	   m_stats;				///< The statistics of the last inference
+		std::chrono::steady_clock::time_point	m_iterationStart;	///< The end time of the previous iteration
+		std::chrono::steady_clock::time_point	m_phaseStart;		///< The start time of the current phase
+		const char	 * m_phase = NULL;		///< The name of the current phase, or NULL if no phase is started
+		Mat			 * m_pBeliefs = NULL;	///< The output buffer for the marginal potentials: external or m_marginals
+		Mat			   m_marginals;			///< The own output buffer (ref. setKeepPotentials())
+		progress_function_t	m_progress;		///< The progress callback
+		unsigned int   m_progressPeriod = 1;	///< The number of iterations between two calls of the progress callback
 	};
 }
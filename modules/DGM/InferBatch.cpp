@@ -0,0 +1,32 @@
+#include "InferBatch.h"
+#include "ThreadPool.h"
+
+namespace DirectGraphicalModels
+{
+	void CInferBatch::infer(const std::vector<IGraphPairwise *> &vpGraphs, unsigned int nIt) const
+	{
+		run(vpGraphs, nIt, NULL);
+	}
+
+	std::vector<vec_byte_t> CInferBatch::decode(const std::vector<IGraphPairwise *> &vpGraphs, unsigned int nIt) const
+	{
+		std::vector<vec_byte_t> res(vpGraphs.size());
+		run(vpGraphs, nIt, &res);
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferBatch::run(const std::vector<IGraphPairwise *> &vpGraphs, unsigned int nIt, std::vector<vec_byte_t> *pvDecoding) const
+	{
+		parallel::parallelFor(Range(0, static_cast<int>(vpGraphs.size())), [&](const Range& range) {
+			thread_local CArena arena;												// shared by all the inferers of the thread
+			for (int g = range.start; g < range.end; g++) {
+				std::unique_ptr<CMessagePassing> pInfer = CGraphPairwiseKit::createInfer(m_infer, *vpGraphs[g]);
+				pInfer->setArena(&arena);
+				if (m_configure) m_configure(*pInfer);
+				if (pvDecoding) pvDecoding->at(g) = pInfer->decode(nIt);
+				else pInfer->infer(nIt);
+			} // g
+		});
+	}
+}
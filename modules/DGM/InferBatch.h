@@ -0,0 +1,66 @@
+// Batch inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphPairwiseKit.h"
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	// ================================ Batch Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Batch inference over many small graphs
+	* @details For small graphs (\a e.g. tens or hundreds of nodes) the parallelization within one graph does not pay off. This class parallelizes
+	* over the graphs instead: every graph is solved by one thread, while the nested parallel loops of the inference run sequentially. 
+	* All the inferers of one thread share one thread-local memory arena (ref. CInfer::setArena()), so that the per-graph buffers are allocated 
+	* only once per thread and stay in cache.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferBatch
+	{
+	public:
+		/**
+		* @brief Callback function, configuring the inferer of one graph
+		* @details Allows for setting the parameters of the inference, \a e.g. the convergence criterion (ref. CInfer::setConvergence())
+		*/
+		using configure_function_t = std::function<void(CInfer &)>;
+
+		/**
+		* @brief Constructor
+		* @param infer The inference method
+		*/
+		DllExport CInferBatch(INFER infer = INFER::LBP) : m_infer(infer) {}
+		DllExport ~CInferBatch(void) = default;
+
+		/**
+		* @brief Sets the configuration of the inferers
+		* @param configure The callback function, which is called for the inferer of every graph before the inference. It is called concurrently
+		*/
+		DllExport void	setConfiguration(configure_function_t configure) { m_configure = configure; }
+		/**
+		* @brief Inference
+		* @details This function estimates the marginal potentials for each node of every graph, and stores them as node potentials (ref. CInfer::infer())
+		* @param vpGraphs The graphs
+		* @param nIt Number of iterations
+		*/
+		DllExport void	infer(const std::vector<IGraphPairwise *> &vpGraphs, unsigned int nIt = 1) const;
+		/**
+		* @brief Approximate decoding
+		* @details This function performs the inference and estimates the most probable configuration of every graph (ref. CInfer::decode())
+		* @param vpGraphs The graphs
+		* @param nIt Number of iterations
+		* @return The most probable configurations of the graphs
+		*/
+		DllExport std::vector<vec_byte_t>	decode(const std::vector<IGraphPairwise *> &vpGraphs, unsigned int nIt = 10) const;
+
+
+	private:
+		void	run(const std::vector<IGraphPairwise *> &vpGraphs, unsigned int nIt, std::vector<vec_byte_t> *pvDecoding) const;
+
+
+	private:
+		INFER					m_infer;
+		configure_function_t	m_configure;
+	};
+}
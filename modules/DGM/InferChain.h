@@ -20,7 +20,7 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param graph The graph
 		*/
-		DllExport CInferChain(CGraphPairwise& graph) : CMessagePassing(graph) {}
+		DllExport CInferChain(IGraphPairwise &graph) : CMessagePassing(graph) {}
 		DllExport virtual ~CInferChain(void) = default;
 
 
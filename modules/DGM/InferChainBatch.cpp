@@ -0,0 +1,143 @@
+#include "InferChainBatch.h"
+#include "ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	void CInferChainBatch::infer(Mat &pots, const Mat &transition) const
+	{
+		DGM_ASSERT_MSG(pots.type() == CV_32FC(m_nStates), "The potentials have either wrong depth or wrong number of channels");
+		DGM_ASSERT_MSG(transition.type() == CV_32FC1 && transition.rows == m_nStates && transition.cols == m_nStates, "Wrong transition matrix");
+		DGM_ASSERT(transition.isContinuous());
+
+		const int nBlocks = (pots.rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		parallel::parallelFor(Range(0, nBlocks), [&](const Range& range) {
+			for (int b = range.start; b < range.end; b++)
+				processBlock(b * BLOCK_SIZE, pots, transition, NULL);
+		});
+	}
+
+	Mat CInferChainBatch::decode(const Mat &pots, const Mat &transition) const
+	{
+		DGM_ASSERT_MSG(pots.type() == CV_32FC(m_nStates), "The potentials have either wrong depth or wrong number of channels");
+		DGM_ASSERT_MSG(transition.type() == CV_32FC1 && transition.rows == m_nStates && transition.cols == m_nStates, "Wrong transition matrix");
+		DGM_ASSERT(transition.isContinuous());
+
+		Mat res(pots.size(), CV_8UC1);
+		Mat &_pots = const_cast<Mat &>(pots);									// is not modified by decoding
+		const int nBlocks = (pots.rows + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		parallel::parallelFor(Range(0, nBlocks), [&](const Range& range) {
+			for (int b = range.start; b < range.end; b++)
+				processBlock(b * BLOCK_SIZE, _pots, transition, &res);
+		});
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The buffers are stored as [t][s][c], where c is the chain in the block, so that the innermost loops over c are vectorized
+	void CInferChainBatch::processBlock(int c0, Mat &pots, const Mat &transition, Mat *pRes) const
+	{
+		const int		B		= BLOCK_SIZE;
+		const int		nStates = m_nStates;
+		const int		length	= pots.cols;
+		const int		nb		= MIN(B, pots.rows - c0);						// number of chains in the block
+		const bool		maxSum	= pRes != NULL;
+		const float	  * T		= reinterpret_cast<const float *>(transition.data);
+		const size_t	step	= static_cast<size_t>(nStates) * B;
+		if (length == 0) return;
+
+		vec_float_t		vUnary(length * step, 1.0f);							// the missing chains of the last block have uniform potentials
+		vec_float_t		vAlpha(length * step);
+		vec_byte_t		vBack(maxSum ? length * step : 0);						// Viterbi back-pointers
+		float			norm[B];
+
+		for (int c = 0; c < nb; c++) {
+			const float *pPot = pots.ptr<float>(c0 + c);
+			for (int t = 0; t < length; t++)
+				for (int s = 0; s < nStates; s++)
+					vUnary[t * step + s * B + c] = pPot[t * nStates + s];
+		}
+
+		// Normalizes the vectors a[s * B + c] of every chain c to the sum of 1
+		auto normalize = [&](float *a) {
+			std::fill(norm, norm + B, 0.0f);
+			for (int s = 0; s < nStates; s++)
+				for (int c = 0; c < B; c++) norm[c] += a[s * B + c];
+			for (int c = 0; c < B; c++) norm[c] = norm[c] > FLT_MIN ? 1.0f / norm[c] : 0;
+			for (int s = 0; s < nStates; s++)
+				for (int c = 0; c < B; c++) a[s * B + c] = norm[c] > 0 ? a[s * B + c] * norm[c] : 1.0f / nStates;
+		};
+
+		// Forward pass: alpha[t][x] = unary[t][x] * sum_y (or max_y) alpha[t-1][y] * T(y, x)
+		std::copy(vUnary.begin(), vUnary.begin() + step, vAlpha.begin());
+		normalize(vAlpha.data());
+		for (int t = 1; t < length; t++) {
+			const float *prev	= vAlpha.data() + (t - 1) * step;
+			float		*cur	= vAlpha.data() + t * step;
+			const float *unary	= vUnary.data() + t * step;
+			for (int x = 0; x < nStates; x++) {
+				float *acc = cur + x * B;
+				std::fill(acc, acc + B, 0.0f);
+				if (maxSum) {
+					byte *back = vBack.data() + t * step + x * B;
+					for (int y = 0; y < nStates; y++) {
+						const float  w = T[y * nStates + x];
+						const float *a = prev + y * B;
+						for (int c = 0; c < B; c++)
+							if (a[c] * w > acc[c]) { acc[c] = a[c] * w; back[c] = static_cast<byte>(y); }
+					}
+				}
+				else
+					for (int y = 0; y < nStates; y++) {
+						const float  w = T[y * nStates + x];
+						const float *a = prev + y * B;
+						for (int c = 0; c < B; c++) acc[c] += a[c] * w;
+					}
+				for (int c = 0; c < B; c++) acc[c] *= unary[x * B + c];
+			} // x
+			normalize(cur);
+		} // t
+
+		if (maxSum) {
+			// Backtracking
+			int state[B];
+			const float *last = vAlpha.data() + (length - 1) * step;
+			for (int c = 0; c < B; c++) {
+				state[c] = 0;
+				for (int s = 1; s < nStates; s++) if (last[s * B + c] > last[state[c] * B + c]) state[c] = s;
+			}
+			for (int t = length - 1; t >= 0; t--)
+				for (int c = 0; c < nb; c++) {
+					pRes->at<byte>(c0 + c, t) = static_cast<byte>(state[c]);
+					if (t > 0) state[c] = vBack[t * step + state[c] * B + c];
+				}
+			return;
+		}
+
+		// Backward pass: beta[t][y] = sum_x T(y, x) * unary[t+1][x] * beta[t+1][x]; marginal[t] = alpha[t] * beta[t]
+		vec_float_t vBeta(step, 1.0f), vTemp(step);
+		for (int t = length - 1; t >= 0; t--) {
+			if (t < length - 1) {
+				const float *unary = vUnary.data() + (t + 1) * step;
+				for (size_t i = 0; i < step; i++) vTemp[i] = unary[i] * vBeta[i];
+				std::fill(vBeta.begin(), vBeta.end(), 0.0f);
+				for (int y = 0; y < nStates; y++) {
+					float *beta = vBeta.data() + y * B;
+					for (int x = 0; x < nStates; x++) {
+						const float  w   = T[y * nStates + x];
+						const float *tmp = vTemp.data() + x * B;
+						for (int c = 0; c < B; c++) beta[c] += w * tmp[c];
+					}
+				}
+				normalize(vBeta.data());
+			}
+			float *alpha = vAlpha.data() + t * step;
+			for (size_t i = 0; i < step; i++) alpha[i] *= vBeta[i];
+			normalize(alpha);
+			for (int c = 0; c < nb; c++) {
+				float *pPot = pots.ptr<float>(c0 + c) + t * nStates;
+				for (int s = 0; s < nStates; s++) pPot[s] = alpha[s * B + c];
+			}
+		} // t
+	}
+}
@@ -0,0 +1,61 @@
+// Batched chain inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Batched Chain Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Inference for many independent chains
+	* @details This class performs the exact inference (forward-backward algorithm) and the exact decoding (Viterbi algorithm) for a batch of 
+	* independent Markov chains of equal length, which share one transition matrix, \a e.g. the scanlines of an image or the time series.
+	* No graph is built: the potentials of all the chains are given in one matrix, where every row is a chain and every column is a chain node.
+	* The chains are processed in blocks of @ref BLOCK_SIZE chains, which are stored interleaved, so that the inner loops run over the chains of 
+	* a block and are vectorized; the blocks are processed in parallel.
+	*
+	* The potential of the chain configuration \f$(x_0, ..., x_{L-1})\f$ is \f$\prod_t pot_t(x_t) \prod_t transition(x_t, x_{t+1})\f$, 
+	* \a i.e. the transition matrix is used directly (in contrast to the graph edge potentials, which are squared by the message passing algorithms).
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferChainBatch
+	{
+	public:
+		static const int BLOCK_SIZE = 16;		///< Number of chains, processed together
+
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		*/
+		DllExport CInferChainBatch(byte nStates) : m_nStates(nStates) {}
+		DllExport ~CInferChainBatch(void) = default;
+
+		/**
+		* @brief Inference
+		* @details This function replaces the node potentials of all chains with the marginal probabilities, calculated with the forward-backward algorithm
+		* @param[in,out] pots The node potentials: Mat(size: nChains x length; type: CV_32FC(nStates))
+		* @param[in] transition The transition matrix: Mat(size: nStates x nStates; type: CV_32FC1), where the row is the state of node \a t and 
+		* the column is the state of node \a t + 1
+		*/
+		DllExport void	infer(Mat &pots, const Mat &transition) const;
+		/**
+		* @brief Exact decoding
+		* @details This function finds the most probable configuration of every chain with the Viterbi algorithm
+		* @param[in] pots The node potentials: Mat(size: nChains x length; type: CV_32FC(nStates))
+		* @param[in] transition The transition matrix: Mat(size: nStates x nStates; type: CV_32FC1)
+		* @return The most probable states: Mat(size: nChains x length; type: CV_8UC1)
+		*/
+		DllExport Mat	decode(const Mat &pots, const Mat &transition) const;
+
+
+	private:
+		// Processes the block of chains [c0; c0 + BLOCK_SIZE) of pots. If pRes is not NULL, decodes the chains into it, otherwise replaces pots with the marginals
+		void			processBlock(int c0, Mat &pots, const Mat &transition, Mat *pRes) const;
+
+
+	private:
+		byte	m_nStates;		///< Number of states (classes)
+	};
+}
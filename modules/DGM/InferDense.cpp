@@ -1,5 +1,11 @@
 #include "InferDense.h"
-#include "IEdgeModel.h"
+#include "ThreadPool.h"
+#include "EdgeModelPotts.h"
+#include "simd.h"
+#include "DenseOCL.h"
+#include "profiler.h"
+#include "macroses.h"
+#include <mutex>
 
 namespace DirectGraphicalModels
 {
@@ -17,48 +23,220 @@ namespace DirectGraphicalModels
 			} // y
 		}
 		
-		template<typename T>
-		void myexp(const Mat &src, Mat &dst)
+		// pot = normalize(pot0 * exp(acc)); returns the L1-change of the normalized potentials, provided that pot was normalized
+		float update(const Mat &pot0, const Mat &acc, Mat &pot, ResidualNorm norm)
 		{
-			for (int y = 0; y < src.rows; y++) {             
-				const T *pSrc  = src.ptr<float>(y);
-				T *pDst = dst.ptr<float>(y);
-
-				// Find the max and subtract it so that the exp doesn't explode
-				T max = pSrc[0];
-				for (int x = 1; x < src.cols; x++)
-					if (pSrc[x] > max) max = pSrc[x];
-
-				for (int x = 0; x < src.cols; x++)
-					pDst[x] = expf(pSrc[x] - max);
-			} // y
+			const byte	nStates = static_cast<byte>(pot.cols);
+			std::mutex	mtx;
+			float		maxRes	= 0;
+			double		sumRes	= 0;
+			parallel::parallelFor(Range(0, pot.rows), [&](const Range& range) {
+				float	*next			= CArena::getScratch<float>(nStates);
+				float	 maxRangeRes	= 0;
+				double	 sumRangeRes	= 0;
+				for (int y = range.start; y < range.end; y++) {
+					const float *pPot0	= pot0.ptr<float>(y);
+					const float *pAcc	= acc.ptr<float>(y);
+					float		*pPot	= pot.ptr<float>(y);
+				
+					// The maximum is subtracted so that the exp doesn't explode
+					simd::expVec(pAcc, next, nStates, *std::max_element(pAcc, pAcc + nStates));
+					float sum = 0;
+					for (byte s = 0; s < nStates; s++) {
+						next[s] *= pPot0[s];
+						sum += next[s];
+					}
+					if (sum <= FLT_EPSILON) {
+						memcpy(pPot, next, nStates * sizeof(float));
+						continue;
+					}
+					float res = 0;
+					for (byte s = 0; s < nStates; s++) {
+						const float val = next[s] / sum;
+						res += fabs(val - pPot[s]);
+						pPot[s] = val;
+					}
+					if (maxRangeRes < res) maxRangeRes = res;
+					sumRangeRes += res;
+				} // y
+				std::lock_guard<std::mutex> lock(mtx);
+				if (maxRes < maxRangeRes) maxRes = maxRangeRes;
+				sumRes += sumRangeRes;
+			});
+			return norm == ResidualNorm::max ? maxRes : static_cast<float>(sumRes / MAX(1, pot.rows));
 		}
 	}
 	
 	void CInferDense::infer(unsigned int nIt)
+	{
+		infer(EmptyMat, nIt);
+	}
+
+	void CInferDense::infer(const Mat &Q, unsigned int nIt)
 	{
 		// ====================================== Initialization ======================================
 		Mat nodePotentials	= getGraphDense().getNodePotentials();
+		if (getOutput()) {																// the graph potentials stay unchanged
+			nodePotentials.copyTo(*getOutput());
+			nodePotentials = *getOutput();
+		}
 		Mat	nodePotentials0	= nodePotentials.clone();
-		Mat	temp			= Mat(nodePotentials.size(), nodePotentials.type());
-		Mat	tmp;
+		Mat	acc				= Mat(nodePotentials.size(), CV_32FC1);			// sum of the logarithms of the edge models
+		Mat	buffer			= Mat(nodePotentials.size(), CV_32FC1);			// buffer of the edge models
+		resetConvergence();
+		if (!Q.empty()) {
+			DGM_ASSERT_MSG(Q.size() == nodePotentials.size() && Q.type() == nodePotentials.type(), "The initial distribution has wrong size or type");
+			Q.copyTo(nodePotentials);
+		}
+		normalize<float>(nodePotentials, nodePotentials);
+		beginPhase("iterations");
+		if (m_openCL && inferOCL(nodePotentials0, nodePotentials, nIt)) {		// otherwise the remaining iterations run on the host
+			endPhase();
+			return;
+		}
 
 		// =================================== Calculating potentials ==================================	
+		m_current = nodePotentials;
 		for (unsigned int i = 0; i < nIt; i++) {
+			DGM_PROFILE_ZONE("Dense CRF iteration");
 #ifdef DEBUG_PRINT_INFO
 			if (i == 0) printf("\n");
 			if (i % 5 == 0) printf("--- It: %d ---\n", i);
 #endif
-			normalize<float>(nodePotentials, nodePotentials);
-			
-			// Add up all pairwise potentials
-			temp.setTo(1);
-			for (auto &edgePotModel : getGraphDense().getEdgeModels()) {
-				edgePotModel->apply(nodePotentials, tmp);					// tmp = f(pot_i)
-				multiply(temp, tmp, temp);									// temp *= exp(tmp)
+			// Add up all pairwise potentials in the logarithmic domain
+			acc.setTo(0);
+			for (auto &edgePotModel : getGraphDense().getEdgeModels())
+				edgePotModel->accumulate(nodePotentials, acc, buffer);		// acc += log(f(pot_i))
+
+			float residual = update(nodePotentials0, acc, nodePotentials, getResidualNorm());	// pot_(i+1) = normalize(pot_0 * exp(acc))
+			if (isConverged(i, residual, nodePotentials.rows)) break;
+		} // iter
+		m_current.release();
+		endPhase();
+	}
+
+	float CInferDense::computeGradient(const vec_byte_t &vLabels, unsigned int nIt, vec_float_t &vWeightGrad, vec_mat_t &vCompatibilityGrad)
+	{
+		const std::vector<ptr_edgeModel_t> &vpModels = getGraphDense().getEdgeModels();
+		const size_t	nModels			= vpModels.size();
+		Mat				nodePotentials	= getGraphDense().getNodePotentials();
+		const int		nNodes			= nodePotentials.rows;
+		const int		nStates			= nodePotentials.cols;
+		DGM_ASSERT_MSG(vLabels.size() == static_cast<size_t>(nNodes), "The number of labels (%zu) does not match the number of nodes (%d)", vLabels.size(), nNodes);
+
+		// ====================================== Forward pass ======================================
+		Mat	nodePotentials0	= nodePotentials.clone();
+		Mat	acc				= Mat(nodePotentials.size(), CV_32FC1);
+		Mat	buffer			= Mat(nodePotentials.size(), CV_32FC1);
+		normalize<float>(nodePotentials, nodePotentials);
+		vec_mat_t vQ(1, nodePotentials.clone());										// Q_0, ..., Q_nIt
+		for (unsigned int i = 0; i < nIt; i++) {
+			acc.setTo(0);
+			for (auto &edgePotModel : vpModels)
+				edgePotModel->accumulate(nodePotentials, acc, buffer);
+			update(nodePotentials0, acc, nodePotentials, getResidualNorm());
+			vQ.push_back(nodePotentials.clone());
+		} // i
+
+		// ====================================== Loss ======================================
+		Mat		gQ(nodePotentials.size(), CV_32FC1, Scalar(0));						// dL / dQ_t
+		double	loss = 0;
+		for (int n = 0; n < nNodes; n++) {
+			const float q = MAX(FLT_MIN, vQ.back().at<float>(n, vLabels[n]));
+			loss -= log(q);
+			gQ.at<float>(n, vLabels[n]) = -1.0f / (nNodes * q);
+		} // n
+		loss /= MAX(1, nNodes);
+
+		// ====================================== Backward pass ======================================
+		vWeightGrad.assign(nModels, 0.0f);
+		vCompatibilityGrad.resize(nModels);
+		for (Mat &grad : vCompatibilityGrad) grad = Mat(nStates, nStates, CV_32FC1, Scalar(0));
+
+		Mat ga(nodePotentials.size(), CV_32FC1);										// dL / d(log pot_0 + acc_t)
+		Mat f, fm, gaMu, gQprev;
+		for (int t = static_cast<int>(nIt) - 1; t >= 0; t--) {
+			// Softmax: ga = Q_(t+1) * (gQ - <gQ, Q_(t+1)>)
+			for (int n = 0; n < nNodes; n++) {
+				const float *pQ		= vQ[t + 1].ptr<float>(n);
+				const float *pGQ	= gQ.ptr<float>(n);
+				float		*pGa	= ga.ptr<float>(n);
+				float dot = 0;
+				for (int s = 0; s < nStates; s++) dot += pGQ[s] * pQ[s];
+				for (int s = 0; s < nStates; s++) pGa[s] = pQ[s] * (pGQ[s] - dot);
+			} // n
+
+			gQprev = Mat(nodePotentials.size(), CV_32FC1, Scalar(0));
+			for (size_t m = 0; m < nModels; m++) {
+				const CEdgeModelPotts *pModel = dynamic_cast<const CEdgeModelPotts *>(vpModels[m].get());
+				if (!pModel) continue;
+				DGM_IF_WARNING(pModel->hasSemiMetricFunction(), "The semi-metric function of the edge model %zu is ignored in the gradient", m);
+				
+				const float weight	= pModel->getWeight();
+				Mat			mu		= pModel->getCompatibility();
+				if (mu.empty()) mu	= Mat::eye(nStates, nStates, CV_32FC1);
+
+				// acc_t += weight * f * mu^T, where f = norm * K * Q_t
+				pModel->filter(vQ[t], f);
+				gemm(f, mu, 1, noArray(), 0, fm, GEMM_2_T);
+				vWeightGrad[m] += static_cast<float>(sum(ga.mul(fm))[0]);
+				gemm(ga, f, weight, vCompatibilityGrad[m], 1, vCompatibilityGrad[m], GEMM_1_T);
+				
+				// dL / dQ_t = K^T * norm * (weight * ga * mu)
+				gemm(ga, mu, weight, noArray(), 0, gaMu);
+				pModel->filter(gaMu, f, true);
+				gQprev += f;
+			} // m
+			gQ = gQprev;
+		} // t
+
+		return static_cast<float>(loss);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	bool CInferDense::inferOCL(const Mat &pot0, Mat &pot, unsigned int &nIt)
+	{
+#ifdef ENABLE_OCL
+		if (!gpu::isAvailable()) return false;
+		
+		UMat uPot0, uPot;
+		pot0.copyTo(uPot0);
+		pot.copyTo(uPot);
+		UMat uAcc(pot.size(), CV_32FC1);
+		UMat uBuffer(pot.size(), CV_32FC1);
+		UMat uResidual(pot.rows, 1, CV_32FC1);
+
+		// Falls back to the host: the potentials of the completed iterations are copied back and the remaining iterations run on the host
+		auto fallback = [&](unsigned int i) {
+			if (i > 0) {
+				DGM_WARNING("The mean-field update failed on the OpenCL device: the remaining %u iterations run on the host", nIt - i);
+				uPot.copyTo(pot);
 			}
+			nIt -= i;
+			return false;
+		};
+
+		for (unsigned int i = 0; i < nIt; i++) {
+			DGM_PROFILE_ZONE("Dense CRF iteration (OpenCL)");
+			uAcc.setTo(0);
+			for (auto &edgePotModel : getGraphDense().getEdgeModels())
+				if (!edgePotModel->accumulate(uPot, uAcc, uBuffer)) return fallback(i);		// e.g. the models with a semi-metric function
+
+			ocl::Kernel kernel = gpu::getKernel("mean_field_update");
+			kernel.args(ocl::KernelArg::PtrReadOnly(uPot0), ocl::KernelArg::PtrReadOnly(uAcc), ocl::KernelArg::PtrReadWrite(uPot), 
+				ocl::KernelArg::PtrWriteOnly(uResidual), pot.cols, pot.rows);
+			if (!gpu::run(kernel, pot.rows)) return fallback(i);
 
-			multiply(nodePotentials0, temp, nodePotentials);				// pot_(i+1) = pot_0 * next
+			double residual;
+			if (getResidualNorm() == ResidualNorm::max) minMaxLoc(uResidual, NULL, &residual);
+			else residual = sum(uResidual)[0] / MAX(1, pot.rows);
+			if (isConverged(i, static_cast<float>(residual), pot.rows)) break;
 		} // iter
+
+		uPot.copyTo(pot);
+		return true;
+#else
+		return false;
+#endif
 	}
 }
@@ -22,10 +22,43 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param graph The graph
 		*/
-		DllExport CInferDense(CGraphDense& graph) : CInfer(graph) {}
+		DllExport CInferDense(CGraphDense& graph) : CInfer(graph), m_openCL(false) {}
 		DllExport virtual ~CInferDense(void) = default;
 	
 		DllExport virtual void	infer(unsigned int nIt = 1);
+		/**
+		* @brief Inference starting from the given distribution
+		* @details Unlike infer(unsigned int), where the mean-field iterations start from the normalized node potentials, this function starts them from 
+		* the distribution \b Q, \a e.g. the upsampled result of a coarser graph (ref. @ref CInferDenseDownsampled)
+		* @param Q The initial distribution: Mat(size: nNodes x nStates; type: CV_32FC1)
+		* @param nIt Number of iterations
+		*/
+		DllExport void			infer(const Mat &Q, unsigned int nIt);
+		/**
+		* @brief Enables the OpenCL inference
+		* @details If enabled and the OpenCL device is available (ref. gpu::isAvailable()), the mean-field iterations are performed on the device:
+		* the potentials stay on the device across the iterations and the lattice tables of the edge models stay there across the infer() calls.
+		* If an edge model has no device implementation (ref. IEdgeModel::accumulate(const UMat &, UMat &, UMat &)) or the device fails, the potentials of the
+		* completed iterations are copied back and the remaining iterations run on the CPU.
+		* > The library must be built with the \b ENABLE_OCL option
+		* @param enable Flag indicating whether the OpenCL device should be used
+		*/
+		DllExport void			setOpenCL(bool enable) { m_openCL = enable; }
+		/**
+		* @brief Calculates the gradients of the loss with respect to the parameters of the edge models
+		* @details This function performs \b nIt mean-field iterations as infer() does, keeping the intermediate distributions \f$Q_t\f$, and back-propagates
+		* the loss \f$L = -\frac{1}{nNodes}\sum_i\log Q_{nIt}(y_i)\f$ through the iterations. The back-propagation uses the same lattice operations as
+		* the inference: for the symmetric Gaussian kernels the transposed filter is one more lattice pass (ref. CEdgeModelPotts::filter()).
+		* The gradients are calculated for the @ref CEdgeModelPotts edge models; other models are treated as constants.
+		* > This function modifies the node potentials of the graph as infer() does
+		* @param[in] vLabels The ground-truth states of the nodes
+		* @param[in] nIt Number of iterations
+		* @param[out] vWeightGrad The gradients with respect to the weights of the edge models
+		* @param[out] vCompatibilityGrad The gradients with respect to the label compatibility matrices of the edge models (ref. CEdgeModelPotts::setCompatibility()):
+		* Mat(size: nStates x nStates; type: CV_32FC1) for every model
+		* @return The loss
+		*/
+		DllExport float			computeGradient(const vec_byte_t &vLabels, unsigned int nIt, vec_float_t &vWeightGrad, vec_mat_t &vCompatibilityGrad);
 
 
 	protected:
@@ -34,5 +67,20 @@ namespace DirectGraphicalModels
 		* @return The dense graph
 		*/
 		CGraphDense& getGraphDense(void) const { return dynamic_cast<CGraphDense&>(getGraph()); }
+		/**
+		* @brief Returns the current distribution
+		* @return The view of the node potentials, which are being updated by the mean-field iterations, or an empty Mat for the OpenCL path
+		*/
+		virtual Mat			getCurrentBeliefs(void) override { return m_current; }
+
+
+	private:
+		// Mean-field iterations on the OpenCL device; returns false if the device may not be used or fails, then nIt is the number of the remaining iterations
+		bool		inferOCL(const Mat &pot0, Mat &pot, unsigned int &nIt);
+
+
+	private:
+		bool		m_openCL;		///< Flag indicating whether the OpenCL device should be used
+		Mat			m_current;		///< The header of the current distribution during infer()
 	};
 }
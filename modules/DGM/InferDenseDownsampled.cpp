@@ -0,0 +1,62 @@
+#include "InferDenseDownsampled.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	Mat CInferDenseDownsampled::infer(const Mat &pots, unsigned int nIt) const
+	{
+		DGM_ASSERT_MSG(pots.type() == CV_32FC(m_nStates), "The potentials must have type CV_32FC(%d)", m_nStates);
+		const Size size			= pots.size();
+		const Size sizeCoarse	= Size((size.width + m_factor - 1) / m_factor, (size.height + m_factor - 1) / m_factor);
+
+		// Mean-field on the downsampled graph
+		Mat potsCoarse;
+		resize(pots, potsCoarse, sizeCoarse, 0, 0, INTER_AREA);
+		CGraphDense		graphCoarse(m_nStates);
+		CGraphDenseExt	graphExtCoarse(graphCoarse);
+		graphExtCoarse.setGraph(potsCoarse);
+		addEdgeModels(graphExtCoarse, static_cast<float>(sizeCoarse.width) / size.width);
+		CInferDense(graphCoarse).infer(nIt);
+
+		// Upsampling and the full-resolution refinement
+		Mat Q;
+		resize(graphCoarse.getNodePotentials().reshape(m_nStates, sizeCoarse.height), Q, size, 0, 0, INTER_LINEAR);
+		CGraphDense		graph(m_nStates);
+		CGraphDenseExt	graphExt(graph);
+		graphExt.setGraph(pots);
+		addEdgeModels(graphExt, 1.0f);
+		CInferDense(graph).infer(Q.reshape(1, size.width * size.height), 1);
+
+		return graph.getNodePotentials().reshape(m_nStates, size.height).clone();
+	}
+
+	Mat CInferDenseDownsampled::decode(const Mat &pots, unsigned int nIt) const
+	{
+		Mat Q = infer(pots, nIt);
+		Mat res(Q.size(), CV_8UC1);
+		for (int y = 0; y < Q.rows; y++) {
+			const float *pQ	  = Q.ptr<float>(y);
+			byte		*pRes = res.ptr<byte>(y);
+			for (int x = 0; x < Q.cols; x++) {
+				const float *q = pQ + x * m_nStates;
+				pRes[x] = static_cast<byte>(std::max_element(q, q + m_nStates) - q);
+			} // x
+		} // y
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferDenseDownsampled::addEdgeModels(CGraphDenseExt &graphExt, float scale) const
+	{
+		for (const Model &model : m_vModels) {
+			const Vec2f sigma = model.sigma * scale;
+			if (model.featureVectors.empty()) graphExt.addGaussianEdgeModel(sigma, model.weight);
+			else if (scale == 1.0f) graphExt.addBilateralEdgeModel(model.featureVectors, sigma, model.sigma_opt, model.weight);
+			else {
+				Mat featureVectors;
+				resize(model.featureVectors, featureVectors, graphExt.getSize(), 0, 0, INTER_AREA);
+				graphExt.addBilateralEdgeModel(featureVectors, sigma, model.sigma_opt, model.weight);
+			}
+		} // model
+	}
+}
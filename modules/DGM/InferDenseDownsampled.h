@@ -0,0 +1,86 @@
+// Downsampled dense inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "InferDense.h"
+#include "GraphDenseExt.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Downsampled Dense Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Downsampled dense inference with the full-resolution refinement
+	* @details The cost of the dense CRF inference grows with the number of pixels. This class runs the mean-field iterations on a graph, which is 
+	* downsampled by the given factor: the node potentials and the bilateral features are averaged over the blocks of \a factor x \a factor pixels, 
+	* and the spatial standard deviations are scaled down accordingly. The resulting distribution is upsampled with the bilinear interpolation 
+	* and refined with one full-resolution mean-field iteration, which acts as the joint-bilateral upsampling guided by the full-resolution features.
+	*
+	* The edge models are given as for @ref CGraphDenseExt, and are built for every call of infer().
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferDenseDownsampled
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param factor The downsampling factor
+		*/
+		DllExport CInferDenseDownsampled(byte nStates, int factor = 4) : m_nStates(nStates), m_factor(MAX(1, factor)) {}
+		DllExport ~CInferDenseDownsampled(void) = default;
+
+		/**
+		* @brief Add a Gaussian potential model with standard deviation \b sigma
+		* @param sigma The full-resolution spatial standard deviation of the 2D-Gaussian filter 
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addGaussianEdgeModel(Vec2f sigma, float weight = 1.0f) { m_vModels.push_back({ sigma, 0.0f, weight, Mat() }); }
+		/**
+		* @brief Add a Bilateral pairwise potential
+		* @param featureVectors Multi-channel full-resolution image, each element of which is a multi-dimensinal point: Mat(type: CV_8UC<nFeatures>). 
+		* The image is not copied and must stay valid until the inference
+		* @param sigma The full-resolution spatial standard deviation of the 2D-bilateral filter 
+		* @param sigma_opt The standard deviation for \b featureVectors
+		* @param weight The weighting parameter
+		*/
+		DllExport void	addBilateralEdgeModel(const Mat &featureVectors, Vec2f sigma, float sigma_opt = 1.0f, float weight = 1.0f) { m_vModels.push_back({ sigma, sigma_opt, weight, featureVectors }); }
+		/**
+		* @brief Removes all the edge models
+		*/
+		DllExport void	clearEdgeModels(void) { m_vModels.clear(); }
+		/**
+		* @brief Inference
+		* @param pots The full-resolution node potentials: Mat(type: CV_32FC(nStates))
+		* @param nIt Number of mean-field iterations on the downsampled graph
+		* @return The full-resolution distribution: Mat(size: pots.size(); type: CV_32FC(nStates))
+		*/
+		DllExport Mat	infer(const Mat &pots, unsigned int nIt = 10) const;
+		/**
+		* @brief Decoding
+		* @param pots The full-resolution node potentials: Mat(type: CV_32FC(nStates))
+		* @param nIt Number of mean-field iterations on the downsampled graph
+		* @return The most probable states: Mat(size: pots.size(); type: CV_8UC1)
+		*/
+		DllExport Mat	decode(const Mat &pots, unsigned int nIt = 10) const;
+
+
+	private:
+		/// Edge model
+		struct Model {
+			Vec2f	sigma;				///< The full-resolution spatial standard deviation
+			float	sigma_opt;			///< The standard deviation of the features (bilateral model only)
+			float	weight;				///< The weighting parameter
+			Mat		featureVectors;		///< The features: empty for the Gaussian model
+		};
+
+		// Adds the edge models to the graph of the given scale
+		void	addEdgeModels(CGraphDenseExt &graphExt, float scale) const;
+
+
+	private:
+		byte				m_nStates;
+		int					m_factor;
+		std::vector<Model>	m_vModels;
+	};
+}
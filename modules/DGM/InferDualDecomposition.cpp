@@ -0,0 +1,215 @@
+#include "InferDualDecomposition.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <map>
+
+namespace DirectGraphicalModels
+{
+	void CInferDualDecomposition::infer(unsigned int nIt)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+
+		// ====================================== Initialization ======================================
+		resetConvergence();
+		m_vEnergy.clear();
+		m_vLowerBound.clear();
+		createView();
+		createEnergies();
+		m_vLambda.assign(nNodes * nStates, 0.0f);
+
+		vec_byte_t	vRow(nNodes), vCol(nNodes), vBest(nNodes, 0);
+		double		energy	= DBL_MAX;								// the energy of the best configuration
+		double		bound	= -DBL_MAX;								// the best lower bound
+		double		rho		= 1;									// the scale of the Polyak step
+		int			nStall	= 0;									// the number of iterations without the improvement of the bound
+
+		// ======================================= Subgradient ========================================
+		for (unsigned int i = 0; i < MAX(1u, nIt); i++) {							// iterations
+			DGM_PROFILE_ZONE("Dual decomposition iteration");
+			const CTimeBudget *pBudget = i > 0 ? &getTimeBudget() : NULL;			// the first iteration is completed in any case
+			const double dual = solveChains(true, vRow, pBudget) + solveChains(false, vCol, pBudget);
+			if (pBudget && pBudget->hasExpired()) break;							// the chains are solved partially: the iteration is discarded
+
+			for (const vec_byte_t *pLabel : { &vRow, &vCol }) {
+				const double e = getEnergy(*pLabel);
+				if (e < energy) {
+					energy	= e;
+					vBest	= *pLabel;
+				}
+			}
+			if (dual > bound + 1e-9 * MAX(1.0, fabs(bound))) {
+				bound	= dual;
+				nStall	= 0;
+			}
+			else if (++nStall >= 5) {
+				rho		/= 2;
+				nStall	= 0;
+			}
+
+			m_vEnergy.push_back(static_cast<float>(energy));
+			m_vLowerBound.push_back(static_cast<float>(bound));
+			addEnergy(static_cast<float>(energy));
+
+			size_t nDisagree = 0;
+			for (size_t n = 0; n < nNodes; n++) if (vRow[n] != vCol[n]) nDisagree++;
+			const double gap = MAX(0.0, energy - bound);
+			const bool converged = isConverged(i, static_cast<float>(gap));
+			if (converged || nDisagree == 0) break;									// both subproblems agree: the configuration is optimal
+
+			// lambda += alpha * (x_row - x_col)
+			const float alpha = static_cast<float>(rho * MAX(gap, 1e-6 * MAX(1.0, fabs(energy))) / (2 * nDisagree));
+			for (size_t n = 0; n < nNodes; n++)
+				if (vRow[n] != vCol[n]) {
+					m_vLambda[n * nStates + vRow[n]] += alpha;
+					m_vLambda[n * nStates + vCol[n]] -= alpha;
+				}
+		} // i
+
+		// ==================================== Storing the result ====================================
+		for (size_t n = 0; n < nNodes; n++) {
+			float *pot = getNodePot(n);
+			std::fill(pot, pot + nStates, 0.0f);
+			pot[vBest[n]] = 1.0f;
+		}
+
+		deleteMessages();
+	}
+
+	size_t CInferDualDecomposition::getMemoryUsage(void) const
+	{
+		size_t res = CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing);
+		res += footprint::getBytes(m_vUnary) + footprint::getBytes(m_vLambda) + footprint::getBytes(m_vPairEnergy) + footprint::getBytes(m_vRowPair) + footprint::getBytes(m_vColPair);
+		res += footprint::getBytes(m_vEnergy) + footprint::getBytes(m_vLowerBound);
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferDualDecomposition::createEnergies(void)
+	{
+		const size_t	nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const size_t	width	= static_cast<size_t>(m_size.width);
+		const size_t	NONE	= static_cast<size_t>(-1);
+		DGM_ASSERT_MSG(nNodes == static_cast<size_t>(m_size.area()), "The number of nodes (%zu) does not correspond to the grid size %d x %d", nNodes, m_size.width, m_size.height);
+
+		m_vUnary.resize(nNodes * nStates);
+		for (size_t n = 0; n < nNodes; n++)
+			for (size_t s = 0; s < nStates; s++)
+				m_vUnary[n * nStates + s] = -logf(MAX(FLT_MIN, getNodePot(n)[s]));
+
+		// The edges p -> q and q -> p of every pair (p, q), p < q, of the rows and of the columns
+		std::vector<std::pair<size_t, size_t>> vRowEdges(nNodes, { NONE, NONE }), vColEdges(nNodes, { NONE, NONE });
+		for (size_t n = 0; n < nNodes; n++)
+			for (size_t e_t : getOutEdges(n)) {
+				if (!getEdgePot(e_t)) continue;
+				const size_t dst = getEdgeDst(e_t);
+				const size_t p	 = MIN(n, dst);
+				const size_t q	 = MAX(n, dst);
+				if (q == p + 1 && q % width != 0)	(n < dst ? vRowEdges[p].first : vRowEdges[p].second) = e_t;
+				else if (q == p + width)			(n < dst ? vColEdges[p].first : vColEdges[p].second) = e_t;
+				else DGM_ASSERT_MSG(false, "The edge (%zu, %zu) does not connect the 4-connected neighbours of the grid", n, dst);
+			} // e_t
+
+		// Distinct pairwise energy tables: E(a, b) = E_pq(a, b) + E_qp(b, a)
+		std::map<std::pair<const void *, const void *>, size_t> mTable;
+		auto getKey = [&](size_t e) -> const void * {
+			if (e == NONE) return NULL;
+			return isEdgePotPotts(e) ? static_cast<const void *>(&getEdgePotModel(e)) : getEdgePot(e);	// the compact Potts edges with equal values share one model
+		};
+		auto getTable = [&](const std::pair<size_t, size_t> &edges) {
+			if (edges.first == NONE && edges.second == NONE) return NONE;
+			auto it = mTable.emplace(std::make_pair(getKey(edges.first), getKey(edges.second)), mTable.size());
+			if (it.second)
+				for (size_t a = 0; a < nStates; a++)
+					for (size_t b = 0; b < nStates; b++) {
+						float e = 0;
+						if (edges.first  != NONE) e -= logf(MAX(FLT_MIN, getEdgePotValue(edges.first,  static_cast<byte>(a), static_cast<byte>(b))));
+						if (edges.second != NONE) e -= logf(MAX(FLT_MIN, getEdgePotValue(edges.second, static_cast<byte>(b), static_cast<byte>(a))));
+						m_vPairEnergy.push_back(e);
+					}
+			return it.first->second;
+		};
+
+		m_vPairEnergy.clear();
+		m_vRowPair.resize(nNodes);
+		m_vColPair.resize(nNodes);
+		for (size_t n = 0; n < nNodes; n++) {
+			m_vRowPair[n] = getTable(vRowEdges[n]);
+			m_vColPair[n] = getTable(vColEdges[n]);
+		}
+	}
+
+	// Min-sum dynamic programming along every chain, with the backtracking of the minimizing states
+	double CInferDualDecomposition::solveChains(bool rows, vec_byte_t &vLabel, const CTimeBudget *pBudget) const
+	{
+		const int			nStates	= getGraph().getNumStates();
+		const size_t		width	= static_cast<size_t>(m_size.width);
+		const int			nChains	= rows ? m_size.height : m_size.width;
+		const size_t		length	= rows ? m_size.width : m_size.height;
+		const size_t		step	= rows ? 1 : width;								// the node index distance between the neighbours of a chain
+		const float			sign	= rows ? 1.0f : -1.0f;
+		const vec_size_t  & vPair	= rows ? m_vRowPair : m_vColPair;
+		const size_t		NONE	= static_cast<size_t>(-1);
+		std::vector<double>	vMin(nChains);
+
+		parallel::parallelFor(Range(0, nChains), [&](const Range &range) {
+			vec_float_t	vCur(nStates), vNext(nStates);
+			vec_byte_t	vBack(length * nStates);
+			for (int c = range.start; c < range.end; c++) {
+				if (pBudget && pBudget->isExpired()) break;
+				const size_t first = rows ? c * width : c;
+				for (int s = 0; s < nStates; s++)
+					vCur[s] = 0.5f * m_vUnary[first * nStates + s] + sign * m_vLambda[first * nStates + s];
+
+				for (size_t t = 1; t < length; t++) {
+					const size_t  prev	= first + (t - 1) * step;
+					const size_t  n		= prev + step;
+					const float * pE	= vPair[prev] == NONE ? NULL : &m_vPairEnergy[vPair[prev] * nStates * nStates];
+					byte		* pBack	= &vBack[t * nStates];
+					for (int b = 0; b < nStates; b++) {
+						int		arg = 0;
+						float	min = FLT_MAX;
+						for (int a = 0; a < nStates; a++) {
+							const float val = vCur[a] + (pE ? pE[a * nStates + b] : 0.0f);
+							if (val < min) {
+								min = val;
+								arg = a;
+							}
+						} // a
+						vNext[b]	= min + 0.5f * m_vUnary[n * nStates + b] + sign * m_vLambda[n * nStates + b];
+						pBack[b]	= static_cast<byte>(arg);
+					} // b
+					vCur.swap(vNext);
+				} // t
+
+				byte s = static_cast<byte>(std::min_element(vCur.begin(), vCur.end()) - vCur.begin());
+				vMin[c] = vCur[s];
+				for (size_t t = length; t-- > 0; ) {
+					vLabel[first + t * step] = s;
+					if (t > 0) s = vBack[t * nStates + s];
+				}
+			} // c
+		});
+
+		double res = 0;
+		for (double min : vMin) res += min;
+		return res;
+	}
+
+	double CInferDualDecomposition::getEnergy(const vec_byte_t &vLabel) const
+	{
+		const size_t nStates	= getGraph().getNumStates();
+		const size_t width		= static_cast<size_t>(m_size.width);
+		const size_t NONE		= static_cast<size_t>(-1);
+		double res = 0;
+		for (size_t n = 0; n < vLabel.size(); n++) {
+			res += m_vUnary[n * nStates + vLabel[n]];
+			if (m_vRowPair[n] != NONE) res += m_vPairEnergy[(m_vRowPair[n] * nStates + vLabel[n]) * nStates + vLabel[n + 1]];
+			if (m_vColPair[n] != NONE) res += m_vPairEnergy[(m_vColPair[n] * nStates + vLabel[n]) * nStates + vLabel[n + width]];
+		}
+		return res;
+	}
+}
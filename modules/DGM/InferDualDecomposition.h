@@ -0,0 +1,86 @@
+// Dual decomposition decoding class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Dual Decomposition Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Dual decomposition decoding class for the grid graphs
+	* @details This class finds the approximate MAP configuration of a grid graph, \a e.g. built with @ref CGraphPairwiseExt or @ref CGraphGrid with the
+	* @ref GRAPH_EDGES_GRID edges, with the <a href="https://people.csail.mit.edu/dsontag/papers/SonGloJaa_optbook.pdf" target="_blank">dual decomposition</a>.
+	* The energy (as in @ref CInferGraphCut) is split into two subproblems: the rows and the columns of the grid, which share the node energies and are
+	* solved exactly with the min-sum dynamic programming. All the chains of one subproblem are independent and are solved in parallel. The Lagrange multipliers,
+	* which couple the subproblems, are updated with the subgradient method with the Polyak step, until both subproblems agree on the configuration,
+	* or until the convergence criterion is met (ref. setConvergence()): the residual is the gap between the primal energy and the dual lower bound.
+	* The time budget (ref. setTimeBudget()) is checked between the chains: an interrupted iteration is discarded, while the first one is always completed,
+	* so that a configuration is found.
+	*
+	* After every iteration, the configurations of both subproblems are the primal candidates: the best of them is the result. The sum of the minimal energies
+	* of the subproblems is the lower bound of the energy, thus the gap shows how far the result may be from the optimum:
+	* @code
+	* CInferDualDecomposition inferer(graph, imgSize);
+	* vec_byte_t solution = inferer.decode(100);
+	* float gap = inferer.getEnergies().back() - inferer.getLowerBounds().back();
+	* @endcode
+	* @note The inference results in the node potentials, which are 1 for the decoded state and 0 otherwise, thus the decode() function returns the found configuration
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferDualDecomposition : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @details The node \f$(x, y)\f$ of the grid must have the index \f$y \cdot width + x\f$ and may be connected only with its 4-connected neighbours
+		* @param graph The graph
+		* @param size The size of the grid
+		*/
+		DllExport CInferDualDecomposition(IGraphPairwise &graph, Size size) : CMessagePassing(graph), m_size(size) {}
+		DllExport virtual ~CInferDualDecomposition(void) = default;
+
+		/**
+		* @brief Decoding with the dual decomposition
+		* @param nIt The maximal number of the subgradient iterations
+		*/
+		DllExport virtual void	infer(unsigned int nIt = 1);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Returns the energies of the best configuration after every iteration of the last call of infer()
+		* @return The primal energies
+		*/
+		DllExport const vec_float_t& getEnergies(void) const { return m_vEnergy; }
+		/**
+		* @brief Returns the lower bounds of the energy after every iteration of the last call of infer()
+		* @return The dual values
+		*/
+		DllExport const vec_float_t& getLowerBounds(void) const { return m_vLowerBound; }
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int) {}
+
+
+	private:
+		// Creates the unary energies and the pairwise energy tables of the rows and the columns
+		void	createEnergies(void);
+		// Solves all the chains of the rows (or columns) with the unary energies m_vUnary / 2 +/- lambda; returns the sum of their minimal energies.
+		// If pBudget is given, the remaining chains are skipped, as soon as it expires
+		double	solveChains(bool rows, vec_byte_t &vLabel, const CTimeBudget *pBudget = NULL) const;
+		// Returns the energy of the configuration
+		double	getEnergy(const vec_byte_t &vLabel) const;
+
+
+	private:
+		Size					m_size;				///< The size of the grid
+		vec_float_t				m_vUnary;			///< The node energies: nNodes x nStates
+		vec_float_t				m_vLambda;			///< The Lagrange multipliers: nNodes x nStates
+		vec_float_t				m_vPairEnergy;		///< The distinct pairwise energy tables: nStates x nStates each
+		vec_size_t				m_vRowPair;			///< Index of the table of the pair (n, n + 1), or -1
+		vec_size_t				m_vColPair;			///< Index of the table of the pair (n, n + width), or -1
+		vec_float_t				m_vEnergy;			///< The primal energies after every iteration
+		vec_float_t				m_vLowerBound;		///< The lower bounds after every iteration
+	};
+}
@@ -11,7 +11,7 @@ namespace DirectGraphicalModels
 	/**
 	* @ingroup moduleDecode
 	* @brief Exact inference class
-	* @note Use this class only if \f$ nStates^{nNodes} < 2^{32}\f$
+	* @note The number of configurations is not limited (ref. CDecodeExact), but the running time grows as \f$ nStates^{nNodes}\f$
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CInferExact : public CInfer, private CDecodeExact
@@ -41,5 +41,8 @@ namespace DirectGraphicalModels
 		DllExport virtual void	  infer(unsigned int nIt = 0);
         
         using CInfer::decode;
+        using CInfer::setTimeBudget;
+        using CInfer::setCancellationToken;
+        using CInfer::isInterrupted;
 	};
 }
@@ -0,0 +1,157 @@
+#include "InferGibbs.h"
+#include "Arena.h"
+#include "random.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	void CInferGibbs::infer(unsigned int nIt)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const size_t	nSweeps	= MAX(1u, nIt);
+
+		// ====================================== Initialization ======================================
+		resetConvergence();
+		createView();
+		const std::vector<vec_size_t> vColourNodes = createColours();
+
+		m_vState.resize(nNodes);
+		for (size_t n = 0; n < nNodes; n++)
+			m_vState[n] = static_cast<byte>(std::max_element(getNodePot(n), getNodePot(n) + nStates) - getNodePot(n));
+
+		const size_t	nSamples	= MIN(m_nSamples, nSweeps);
+		const size_t	thinning	= nSamples ? nSweeps / nSamples : 0;			// the number of sweeps between the stored samples
+		std::vector<double> vAcc(nNodes * nStates, 0.0);
+		m_samples = nSamples ? Mat(static_cast<int>(nSamples), static_cast<int>(nNodes), CV_8UC1) : Mat();
+
+		// ========================================= Sweeps ==========================================
+		for (size_t i = 0; i < m_burnIn + nSweeps; i++) {
+			DGM_PROFILE_ZONE("Gibbs sweep");
+			const bool		burnIn		= i < m_burnIn;
+			const size_t	it			= burnIn ? 0 : i - m_burnIn;
+			float			maxResidual	= 0;
+			double			sumResidual	= 0;
+			for (const vec_size_t &vNodes : vColourNodes)									// the nodes of one colour are conditionally independent
+				sample(vNodes, i, burnIn ? NULL : vAcc.data(), it + 1, maxResidual, sumResidual);
+
+			if (burnIn) continue;
+			if (nSamples && (it + 1) % thinning == 0 && (it + 1) / thinning <= nSamples)
+				std::copy(m_vState.begin(), m_vState.end(), m_samples.ptr<byte>(static_cast<int>((it + 1) / thinning - 1)));
+
+			const float residual = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(size_t(1), nNodes));
+			if (isConverged(static_cast<unsigned int>(it), residual)) {
+				if (it + 1 < nSweeps && nSamples) m_samples = m_samples.rowRange(0, static_cast<int>(MIN(nSamples, (it + 1) / thinning))).clone();
+				break;
+			}
+		} // i
+
+		// ==================================== Storing the result ====================================
+		const size_t nCounted = getNumIterations();
+		for (size_t n = 0; n < nNodes; n++) {
+			float *pot = getNodePot(n);
+			for (byte s = 0; s < nStates; s++)
+				pot[s] = static_cast<float>(vAcc[n * nStates + s] / MAX(size_t(1), nCounted));
+		}
+
+		deleteMessages();
+	}
+
+	size_t CInferGibbs::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing) + footprint::getBytes(m_vState) + footprint::getBytes(m_samples);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	std::vector<vec_size_t> CInferGibbs::createColours(void) const
+	{
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const size_t	NONE	= static_cast<size_t>(-1);
+		vec_size_t		vColour(nNodes, NONE);
+		vec_size_t		vMark;														// vMark[c] == n, if colour c is used by a neighbour of node n
+		std::vector<vec_size_t> res;
+
+		// In the row-major order of the grid graphs, the greedy colouring results in the checkerboard pattern
+		for (size_t n = 0; n < nNodes; n++) {
+			for (int dir = 0; dir < 2; dir++)
+				for (size_t e : dir ? getInEdges(n) : getOutEdges(n)) {
+					const size_t m = dir ? getEdgeSrc(e) : getEdgeDst(e);
+					if (vColour[m] != NONE) vMark[vColour[m]] = n;
+				} // e
+			size_t c = 0;
+			while (c < vMark.size() && vMark[c] == n) c++;
+			if (c == vMark.size()) {
+				vMark.push_back(NONE);
+				res.emplace_back();
+			}
+			vColour[n] = c;
+			res[c].push_back(n);
+		} // n
+		return res;
+	}
+
+	void CInferGibbs::sample(const vec_size_t &vNodes, uint64_t sweep, double *pAcc, size_t nAcc, float &maxResidual, double &sumResidual)
+	{
+		const byte nStates = getGraph().getNumStates();
+		std::mutex mtx;
+
+		parallel::parallelFor(Range(0, static_cast<int>(vNodes.size())), [&](const Range &range) {
+			double	*p		= CArena::getScratch<double>(nStates);
+			float	 maxRes	= 0;
+			double	 sumRes	= 0;
+			for (int i = range.start; i < range.end; i++) {
+				const size_t n = vNodes[i];
+
+				// Conditional distribution, given the states of the neighbours
+				std::copy(getNodePot(n), getNodePot(n) + nStates, p);
+				for (size_t e : getInEdges(n)) {
+					if (!getEdgePot(e)) continue;
+					const byte x = m_vState[getEdgeSrc(e)];
+					for (byte s = 0; s < nStates; s++) p[s] *= getEdgePotValue(e, x, s);
+				} // e
+				for (size_t e : getOutEdges(n)) {
+					if (!getEdgePot(e)) continue;
+					const byte y = m_vState[getEdgeDst(e)];
+					for (byte s = 0; s < nStates; s++) p[s] *= getEdgePotValue(e, s, y);
+				} // e
+
+				double sum = 0;
+				for (byte s = 0; s < nStates; s++) sum += p[s];
+				if (sum > 0) for (byte s = 0; s < nStates; s++) p[s] /= sum;
+				else std::fill(p, p + nStates, 1.0 / nStates);							// all the states are impossible: uniform distribution
+
+				// Inverse transform sampling: the state is the number of the cumulative probabilities, which do not exceed u
+				random::CPhilox generator = random::getStream(n);
+				generator.discard(sweep);
+				const double u		= generator() * (1.0 / 4294967296.0);
+				double		 cdf	= 0;
+				int			 state	= 0;
+				for (byte s = 0; s < nStates - 1; s++) {
+					cdf += p[s];
+					state += cdf <= u ? 1 : 0;
+				}
+				m_vState[n] = static_cast<byte>(state);
+
+				// The running average changes by (p - mean) / nAcc; the first counted sweep changes it by the whole distribution
+				if (pAcc) {
+					double res = 0;
+					for (byte s = 0; s < nStates; s++) {
+						double &acc = pAcc[n * nStates + s];
+						res += fabs(p[s] - (nAcc > 1 ? acc / (nAcc - 1) : 0.0)) / nAcc;
+						acc += p[s];
+					}
+					if (maxRes < res) maxRes = static_cast<float>(res);
+					sumRes += res;
+				}
+			} // i
+
+			std::lock_guard<std::mutex> lock(mtx);
+			if (maxResidual < maxRes) maxResidual = maxRes;
+			sumResidual += sumRes;
+		});
+	}
+}
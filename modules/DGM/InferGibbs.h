@@ -0,0 +1,89 @@
+// Chromatic Gibbs sampling inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Gibbs Sampling Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Chromatic Gibbs sampling inference class
+	* @details This class estimates the marginal probabilities of a pairwise graph with the Markov chain Monte Carlo method: every node repeatedly draws
+	* its state from the conditional distribution, given the current states of its neighbours. The nodes are greedily coloured, such that no edge
+	* connects the nodes of the same colour (the grid graphs with the @ref GRAPH_EDGES_GRID edges need 2 colours and with the @ref GRAPH_EDGES_DIAG
+	* edges 4 colours); since the nodes of one colour are conditionally independent, they are sampled in parallel. Every node draws from its own
+	* random stream (ref. random::getStream()), thus after random::seed() the result does not depend on the number of threads.
+	*
+	* The marginals are the Rao-Blackwellized estimates: the averages of the conditional distributions, which are sampled from, over all the sweeps
+	* after the burn-in. Unlike the beliefs of the message passing algorithms, they converge to the exact marginals of the loopy graphs, and the
+	* stored samples (ref. setNumSamples()) allow for estimating any other statistic of the posterior, \a e.g. the uncertainty of the regions:
+	* @code
+	* CInferGibbs inferer(graph);
+	* inferer.setBurnIn(200);
+	* inferer.setNumSamples(50);
+	* inferer.infer(1000);									// 1000 sweeps after the burn-in
+	* Mat confidence = inferer.getConfidence();
+	* Mat samples    = inferer.getSamples();					// 50 x nNodes configurations
+	* @endcode
+	* > The residual of every sweep (ref. setConvergence()) is the L1-norm of the change of the marginal estimates of a node, maximal or averaged over
+	* the nodes (ref. @ref ResidualNorm). Since the estimates are the running averages, their changes decrease at least as fast as the inverse number of sweeps
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferGibbs : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		*/
+		DllExport CInferGibbs(IGraphPairwise &graph) : CMessagePassing(graph), m_burnIn(100), m_nSamples(0) {}
+		DllExport virtual ~CInferGibbs(void) = default;
+
+		/**
+		* @brief Inference with the Gibbs sampling
+		* @details The chain starts from the states with the maximal node potentials
+		* @param nIt The number of sweeps after the burn-in
+		*/
+		DllExport virtual void	infer(unsigned int nIt = 1);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Sets the number of the burn-in sweeps
+		* @details The samples of the burn-in sweeps are discarded
+		* @param nSweeps The number of sweeps
+		*/
+		DllExport void			setBurnIn(unsigned int nSweeps) { m_burnIn = nSweeps; }
+		/**
+		* @brief Sets the number of the stored samples
+		* @details The samples are taken with equal spacing from the sweeps after the burn-in
+		* @param nSamples The number of samples (default: 0, \a i.e. no samples are stored)
+		*/
+		DllExport void			setNumSamples(size_t nSamples) { m_nSamples = nSamples; }
+		/**
+		* @brief Returns the samples of the last call of infer()
+		* @return The configurations of the graph: Mat(size: nNodes x nSamples; type: CV_8UC1), one sample per row. There may be less samples, than
+		* set with setNumSamples(), if the number of sweeps is smaller
+		*/
+		DllExport const Mat&	getSamples(void) const { return m_samples; }
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int) {}
+
+
+	private:
+		// Greedy colouring of the graph: returns the nodes of every colour
+		std::vector<vec_size_t>	createColours(void) const;
+		// Samples the states of the nodes with the indexes in vNodes. If pAcc is not NULL, accumulates the conditional distributions of the nAcc-th counted
+		// sweep and updates the maximum and the sum of the L1-changes of the marginal estimates
+		void	sample(const vec_size_t &vNodes, uint64_t sweep, double *pAcc, size_t nAcc, float &maxResidual, double &sumResidual);
+
+
+	private:
+		unsigned int	m_burnIn;		///< The number of the burn-in sweeps
+		size_t			m_nSamples;		///< The number of the stored samples
+		vec_byte_t		m_vState;		///< The current states of the nodes
+		Mat				m_samples;		///< The stored samples: nSamples x nNodes
+	};
+}
@@ -0,0 +1,180 @@
+#include "InferGraphCut.h"
+#include "ThreadPool.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <unordered_map>
+
+namespace DirectGraphicalModels
+{
+	void CInferGraphCut::infer(unsigned int nIt)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+
+		// ====================================== Initialization ======================================
+		resetConvergence();
+		createView();
+		createEnergies();
+		if (m_vMaxFlow.size() < m_nConcurrent) m_vMaxFlow.resize(m_nConcurrent);
+
+		vec_byte_t vLabel(nNodes);
+		for (size_t n = 0; n < nNodes; n++) {
+			const float *pUnary = &m_vUnary[n * nStates];
+			vLabel[n] = static_cast<byte>(std::min_element(pUnary, pUnary + nStates) - pUnary);
+		}
+		m_energy = getEnergy(vLabel);
+
+		// ======================================= Expansions ========================================
+		std::vector<vec_bool_t> vMoves(m_nConcurrent, vec_bool_t(nNodes));
+		vec_byte_t				vCandidate;
+		for (unsigned int i = 0; i < MAX(1u, nIt); i++) {									// sweeps
+			DGM_PROFILE_ZONE("GraphCut sweep");
+			double decrease = 0;
+			for (int alpha0 = 0; alpha0 < nStates; alpha0 += m_nConcurrent) {
+				const int nAlphas = MIN(static_cast<int>(m_nConcurrent), nStates - alpha0);
+				if (nAlphas == 1) expand(static_cast<byte>(alpha0), vLabel, vMoves[0], m_vMaxFlow[0]);
+				else {
+					parallel::parallelFor(Range(0, nAlphas), [&](const Range& range) {
+						for (int k = range.start; k < range.end; k++)
+							expand(static_cast<byte>(alpha0 + k), vLabel, vMoves[k], m_vMaxFlow[k]);
+					});
+				}
+
+				// Applying the moves, which decrease the energy
+				for (int k = 0; k < nAlphas; k++) {
+					vCandidate = vLabel;
+					bool changed = false;
+					for (size_t n = 0; n < nNodes; n++)
+						if (vMoves[k][n]) {
+							vCandidate[n] = static_cast<byte>(alpha0 + k);
+							changed = true;
+						}
+					if (!changed) continue;
+					const double energy = getEnergy(vCandidate);
+					if (energy < m_energy - 1e-9 * MAX(1.0, fabs(m_energy))) {
+						decrease += m_energy - energy;
+						m_energy = energy;
+						vLabel.swap(vCandidate);
+					}
+				} // k
+			} // alpha0
+			
+			addEnergy(static_cast<float>(m_energy));
+			const bool converged = isConverged(i, static_cast<float>(decrease));
+			if (converged || decrease == 0) break;
+		} // i
+
+		// ==================================== Storing the result ====================================
+		for (size_t n = 0; n < nNodes; n++) {
+			float *pot = getNodePot(n);
+			std::fill(pot, pot + nStates, 0.0f);
+			pot[vLabel[n]] = 1.0f;
+		}
+
+		deleteMessages();
+	}
+
+	size_t CInferGraphCut::getMemoryUsage(void) const
+	{
+		size_t res = CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing);
+		res += footprint::getBytes(m_vUnary) + footprint::getBytes(m_vEdgeEnergy) + footprint::getBytes(m_vPairs);
+		res += (m_vMaxFlow.capacity() - m_vMaxFlow.size()) * sizeof(CMaxFlow);
+		for (const CMaxFlow &maxFlow : m_vMaxFlow) res += maxFlow.getMemoryUsage();
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferGraphCut::createEnergies(void)
+	{
+		const size_t	nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const size_t	NONE	= static_cast<size_t>(-1);
+
+		m_vUnary.resize(nNodes * nStates);
+		for (size_t n = 0; n < nNodes; n++)
+			for (size_t s = 0; s < nStates; s++)
+				m_vUnary[n * nStates + s] = -logf(MAX(FLT_MIN, getNodePot(n)[s]));
+
+		// Distinct edge energy tables
+		std::unordered_map<const void *, size_t> mTable;
+		m_vEdgeEnergy.clear();
+		auto getTable = [&](size_t e) {
+			// the compact Potts edges with equal values share one model
+			const void *key = isEdgePotPotts(e) ? static_cast<const void *>(&getEdgePotModel(e)) : getEdgePot(e);
+			auto it = mTable.emplace(key, mTable.size());
+			if (it.second) 
+				for (size_t x = 0; x < nStates; x++)
+					for (size_t y = 0; y < nStates; y++)
+						m_vEdgeEnergy.push_back(-logf(MAX(FLT_MIN, getEdgePotValue(e, static_cast<byte>(x), static_cast<byte>(y)))));
+			return it.first->second;
+		};
+
+		// Pairs: the edges p -> q and q -> p are merged
+		m_vPairs.clear();
+		for (size_t p = 0; p < nNodes; p++) {
+			const size_t first = m_vPairs.size();
+			for (size_t e_t : getOutEdges(p)) {
+				const size_t q = getEdgeDst(e_t);
+				if (q > p && getEdgePot(e_t)) m_vPairs.push_back({ p, q, getTable(e_t), NONE });
+			}
+			for (size_t e_f : getInEdges(p)) {
+				const size_t q = getEdgeSrc(e_f);
+				if (q <= p || !getEdgePot(e_f)) continue;
+				auto it = std::find_if(m_vPairs.begin() + first, m_vPairs.end(), [q, NONE](const Pair &pair) { return pair.q == q && pair.qp == NONE; });
+				if (it != m_vPairs.end()) it->qp = getTable(e_f);
+				else m_vPairs.push_back({ p, q, NONE, getTable(e_f) });
+			}
+		} // p
+	}
+
+	double CInferGraphCut::getPairEnergy(const Pair &pair, byte a, byte b) const
+	{
+		const size_t	nStates = getGraph().getNumStates();
+		const size_t	NONE	= static_cast<size_t>(-1);
+		double res = 0;
+		if (pair.pq != NONE) res += m_vEdgeEnergy[pair.pq * nStates * nStates + a * nStates + b];
+		if (pair.qp != NONE) res += m_vEdgeEnergy[pair.qp * nStates * nStates + b * nStates + a];
+		return res;
+	}
+
+	double CInferGraphCut::getEnergy(const vec_byte_t &vLabel) const
+	{
+		const size_t nStates = getGraph().getNumStates();
+		double res = 0;
+		for (size_t n = 0; n < vLabel.size(); n++) res += m_vUnary[n * nStates + vLabel[n]];
+		for (const Pair &pair : m_vPairs) res += getPairEnergy(pair, vLabel[pair.p], vLabel[pair.q]);
+		return res;
+	}
+
+	// The binary variable y of every node is 1 if the node switches to alpha (sink set) and 0 if it keeps its state (source set)
+	void CInferGraphCut::expand(byte alpha, const vec_byte_t &vLabel, vec_bool_t &vMove, CMaxFlow &maxFlow) const
+	{
+		const size_t nStates	= getGraph().getNumStates();
+		const size_t nNodes		= vLabel.size();
+
+		maxFlow.reset(nNodes, m_vPairs.size());
+		auto addUnary = [&maxFlow](size_t n, double e0, double e1) { maxFlow.addTWeights(n, e1, e0); };	// E(y) = e1 * y + e0 * (1 - y)
+		for (size_t n = 0; n < nNodes; n++)
+			addUnary(n, m_vUnary[n * nStates + vLabel[n]], m_vUnary[n * nStates + alpha]);
+
+		for (const Pair &pair : m_vPairs) {
+			const byte	 a	 = vLabel[pair.p];
+			const byte	 b	 = vLabel[pair.q];
+			const double E00 = getPairEnergy(pair, a, b);
+			const double E01 = getPairEnergy(pair, a, alpha);
+			const double E10 = getPairEnergy(pair, alpha, b);
+			const double E11 = getPairEnergy(pair, alpha, alpha);
+			
+			// E(y_p, y_q) = E00 + (E10 - E00) y_p + (E11 - E10) y_q + C (1 - y_p) y_q
+			const double C = E01 + E10 - E00 - E11;							// C < 0 for the non-submodular terms, which are truncated
+			addUnary(pair.p, 0, E10 - E00);
+			addUnary(pair.q, 0, E11 - E10);
+			if (C > 0) maxFlow.addEdge(pair.p, pair.q, C, 0);
+		}
+
+		maxFlow.maxflow();
+		for (size_t n = 0; n < nNodes; n++)
+			vMove[n] = maxFlow.isSink(n) && vLabel[n] != alpha;
+	}
+}
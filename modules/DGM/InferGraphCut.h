@@ -0,0 +1,82 @@
+// Alpha-expansion graph-cut decoding class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+#include "MaxFlow.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Graph-Cut Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Alpha-expansion graph-cut decoding class
+	* @details This class finds the approximate MAP configuration with the <a href="https://www.csd.uwo.ca/~yboykov/Papers/pami01.pdf" target="_blank">alpha-expansion</a>
+	* algorithm: for every state \f$\alpha\f$ the best move, where any subset of nodes switches to \f$\alpha\f$, is found with a min-cut (ref. @ref CMaxFlow).
+	* The energy is the negative logarithm of the graph potential, \a i.e. the sum of \f$-\log\f$ of the node potentials and of every edge potential
+	* (as in @ref CDecodeExact). For metric energies, \a e.g. Potts potentials from @ref CTrainEdgePotts, every move is optimal and the algorithm converges in a few sweeps.
+	* For non-metric energies the non-submodular terms of the moves are truncated, and only the moves, which decrease the energy, are accepted.
+	* 
+	* The max-flow graphs are reused across the expansions. Optionally, the expansions of several states are computed concurrently from the same configuration
+	* and applied one after another.
+	* @note The inference results in the node potentials, which are 1 for the decoded state and 0 otherwise, thus the decode() function returns the found configuration
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferGraphCut : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		* @param nConcurrent The number of states, which expansions are computed concurrently
+		*/
+		DllExport CInferGraphCut(IGraphPairwise &graph, byte nConcurrent = 1) : CMessagePassing(graph), m_nConcurrent(MAX(1, nConcurrent)) {}
+		DllExport virtual ~CInferGraphCut(void) = default;
+
+		/**
+		* @brief Decoding with the alpha-expansion
+		* @details This function stops, when a sweep over all states does not decrease the energy, or when the convergence criterion is met (ref. setConvergence()):
+		* the residual is the energy decrease of the sweep.
+		* @param nIt The maximal number of sweeps over all states
+		*/
+		DllExport virtual void	infer(unsigned int nIt = 1);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Returns the energy of the configuration, found by the last call of infer()
+		* @return The energy
+		*/
+		DllExport double		getEnergy(void) const { return m_energy; }
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int) {}
+
+
+	private:
+		/// Pair of nodes, connected with one or two edges
+		struct Pair {
+			size_t	p;			///< The first node
+			size_t	q;			///< The second node, q > p
+			size_t	pq;			///< Index of the energy table of the edge p -> q, or -1
+			size_t	qp;			///< Index of the energy table of the edge q -> p, or -1
+		};
+
+		// Creates the unary and pairwise energy tables
+		void	createEnergies(void);
+		// Returns the energy of the pair for the states a (node p) and b (node q)
+		double	getPairEnergy(const Pair &pair, byte a, byte b) const;
+		// Returns the energy of the configuration
+		double	getEnergy(const vec_byte_t &vLabel) const;
+		// Finds the nodes, which switch to state alpha in the optimal expansion move
+		void	expand(byte alpha, const vec_byte_t &vLabel, vec_bool_t &vMove, CMaxFlow &maxFlow) const;
+
+
+	private:
+		byte					m_nConcurrent;		///< The number of concurrent expansions
+		double					m_energy = 0;		///< The energy of the last result
+		std::vector<CMaxFlow>	m_vMaxFlow;			///< The max-flow solvers, reused across the expansions
+		vec_float_t				m_vUnary;			///< The node energies: nNodes x nStates
+		vec_float_t				m_vEdgeEnergy;		///< The distinct edge energy tables: nStates x nStates each
+		std::vector<Pair>		m_vPairs;			///< The pairs of neighbouring nodes
+	};
+}
@@ -0,0 +1,359 @@
+#include "InferJunctionTree.h"
+#include "Arena.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <set>
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		const size_t NONE = static_cast<size_t>(-1);
+
+		// Calls fn(idx, sepIdx) for every configuration idx of a clique with nVars variables, where sepIdx = sum_j state_j * pStride[j]
+		template<typename F>
+		void forEachConfig(size_t nVars, size_t size, byte nStates, const size_t *pStride, F fn)
+		{
+			vec_byte_t	state(nVars, 0);
+			size_t		sepIdx = 0;
+			for (size_t idx = 0; idx < size; idx++) {
+				fn(idx, sepIdx);
+				for (size_t j = 0; j < nVars; j++) {
+					if (++state[j] < nStates) { sepIdx += pStride[j]; break; }
+					state[j] = 0;
+					sepIdx -= (nStates - 1) * pStride[j];
+				} // j
+			} // idx
+		}
+
+		// The strides of the variables pVars in the index of the configuration of the separator pSepVars: nStates^i for the i-th separator variable, 0 for the others
+		void getSeparatorStrides(const size_t *pVars, size_t nVars, const size_t *pSepVars, size_t nSepVars, byte nStates, vec_size_t &vStride)
+		{
+			vStride.assign(nVars, 0);
+			for (size_t i = 0, stride = 1; i < nSepVars; i++, stride *= nStates)
+				for (size_t j = 0; j < nVars; j++)
+					if (pVars[j] == pSepVars[i]) vStride[j] = stride;
+		}
+
+		// Scales the values so that the largest one is 1
+		void normalize(float *pVal, size_t size)
+		{
+			const float max = *std::max_element(pVal, pVal + size);
+			if (max > 0) for (size_t i = 0; i < size; i++) pVal[i] /= max;
+		}
+	}
+
+	void CInferJunctionTree::infer(unsigned int)
+	{
+		const byte	nStates	= getGraph().getNumStates();
+		const int	nNodes	= static_cast<int>(getGraph().getNumNodes());
+
+		resetConvergence();
+		beginPhase("setup");
+		buildTree();
+		fillTables();
+
+		beginPhase("messages");
+		collect(false);
+		distribute();
+
+		// The marginals of every node are the marginals of the clique, where it is eliminated
+		beginPhase("beliefs");
+		Mat *pBeliefs = getOutput();
+		Mat	 marginals;
+		Mat &dst = pBeliefs ? *pBeliefs : marginals;
+		dst.create(nNodes, nStates, CV_32FC1);
+		parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+			for (int n = range.start; n < range.end; n++) {
+				const float *table	= &m_vTables[m_vTableOffset[n]];
+				const size_t size	= m_vTableOffset[n + 1] - m_vTableOffset[n];
+				float		*pot	= dst.ptr<float>(n);
+				std::fill(pot, pot + nStates, 0.0f);
+				for (size_t idx = 0; idx < size; idx++) pot[idx % nStates] += table[idx];
+				float SUM_pot = 0;
+				for (byte s = 0; s < nStates; s++) SUM_pot += pot[s];
+				if (SUM_pot > 0) for (byte s = 0; s < nStates; s++) pot[s] /= SUM_pot;
+			} // n
+		});
+		if (!pBeliefs && nNodes) getGraph().setNodes(0, marginals);
+		endPhase();
+	}
+
+	vec_byte_t CInferJunctionTree::decodeMAP(void)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+
+		resetConvergence();
+		beginPhase("setup");
+		buildTree();
+		fillTables();
+
+		beginPhase("messages");
+		collect(true);
+
+		// Traceback: the separator of every clique consists of its ancestors, which are decoded before
+		beginPhase("decoding");
+		vec_byte_t res(nNodes, 0);
+		for (size_t l = m_vLevels.size(); l > 0; l--) {
+			const vec_size_t &vCliques = m_vLevels[l - 1];
+			parallel::parallelFor(Range(0, static_cast<int>(vCliques.size())), [&](const Range &range) {
+				for (int i = range.start; i < range.end; i++) {
+					const size_t  c		= vCliques[i];
+					const size_t *pVars	= &m_vVars[m_vVarOffset[c]];
+					const size_t  nVars	= m_vVarOffset[c + 1] - m_vVarOffset[c];
+					size_t sepIdx = 0;
+					for (size_t j = nVars; j > 1; j--) sepIdx = sepIdx * nStates + res[pVars[j - 1]];
+					const float *pConfig = &m_vTables[m_vTableOffset[c] + sepIdx * nStates];
+					res[c] = static_cast<byte>(std::max_element(pConfig, pConfig + nStates) - pConfig);
+				} // i
+			}, 64);
+		} // l
+		endPhase();
+		return res;
+	}
+
+	size_t CInferJunctionTree::getMemoryUsage(void) const
+	{
+		return CInfer::getMemoryUsage() + sizeof(*this) - sizeof(CInfer)
+			+ footprint::getBytes(m_vVarOffset) + footprint::getBytes(m_vVars) + footprint::getBytes(m_vParent) + footprint::getBytes(m_vChildOffset)
+			+ footprint::getBytes(m_vChildren) + footprint::getBytes(m_vLevels) + footprint::getBytes(m_vTableOffset) + footprint::getBytes(m_vTables)
+			+ footprint::getBytes(m_vMsgOffset) + footprint::getBytes(m_vMsg) + footprint::getBytes(m_vEdges) + footprint::getBytes(m_vEdgeOffset) + footprint::getBytes(m_vEdgePot);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The clique of every node consists of the node and its neighbours at the time of its elimination; the clique index is the node index
+	void CInferJunctionTree::buildTree(void)
+	{
+		DGM_PROFILE_ZONE("buildTree");
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const byte		nStates	= getGraph().getNumStates();
+
+		// Undirected adjacency and the directed edges with their potentials
+		std::vector<std::set<size_t>>			vAdj(nNodes);
+		std::vector<std::pair<size_t, size_t>>	vEdges;
+		vec_float_t								vEdgePot;
+		vec_size_t								vChilds;
+		Mat										pot;
+		for (size_t n = 0; n < nNodes; n++) {
+			getGraph().getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				if (c == n) continue;
+				vAdj[n].insert(c);
+				vAdj[c].insert(n);
+				vEdges.emplace_back(n, c);
+				span<const float> edgePot = getGraphPairwise().getEdgeView(n, c);
+				if (edgePot.empty()) {												// the compact potential is expanded
+					getGraphPairwise().getEdge(n, c, pot);
+					if (!pot.empty()) edgePot = span<const float>(pot.ptr<float>(), pot.total());
+				}
+				if (edgePot.empty()) vEdgePot.resize(vEdgePot.size() + nStates * nStates, 1.0f);
+				else vEdgePot.insert(vEdgePot.end(), edgePot.begin(), edgePot.end());
+			} // c
+		} // n
+
+		// Greedy min-fill elimination: the node, whose elimination adds the least edges between its neighbours, goes first; the ties are broken by the degree
+		auto getFill = [&](size_t v) {
+			size_t res = 0;
+			for (auto a = vAdj[v].begin(); a != vAdj[v].end(); a++)
+				for (auto b = std::next(a); b != vAdj[v].end(); b++)
+					if (!vAdj[*a].count(*b)) res++;
+			return res;
+		};
+		vec_size_t vFill(nNodes);
+		for (size_t n = 0; n < nNodes; n++) vFill[n] = getFill(n);
+
+		std::vector<vec_size_t> vCliques(nNodes);
+		vec_size_t				vOrder;
+		vec_size_t				vPos(nNodes, NONE);										// the position of every node in the elimination order
+		std::set<size_t>		affected;
+		m_treewidth = 0;
+		for (size_t i = 0; i < nNodes; i++) {
+			size_t v = NONE;
+			for (size_t n = 0; n < nNodes; n++) {
+				if (vPos[n] != NONE) continue;
+				if (v == NONE || vFill[n] < vFill[v] || (vFill[n] == vFill[v] && vAdj[n].size() < vAdj[v].size())) v = n;
+			} // n
+			vPos[v] = i;
+			vOrder.push_back(v);
+			vCliques[v].push_back(v);
+			vCliques[v].insert(vCliques[v].end(), vAdj[v].begin(), vAdj[v].end());
+			DGM_ASSERT_MSG(vCliques[v].size() * log2(MAX(1, nStates)) < 31, "The treewidth of the graph (at least %zu) is too large for %d states", vCliques[v].size() - 1, nStates);
+			m_treewidth = MAX(m_treewidth, vCliques[v].size() - 1);
+
+			affected.clear();
+			for (size_t a : vAdj[v]) {
+				vAdj[a].erase(v);
+				for (size_t b : vAdj[v]) if (b != a) vAdj[a].insert(b);					// fill-in edges
+			}
+			for (size_t a : vAdj[v]) {
+				affected.insert(a);
+				affected.insert(vAdj[a].begin(), vAdj[a].end());
+			}
+			for (size_t n : affected) vFill[n] = getFill(n);
+			vAdj[v].clear();
+		} // i
+
+		// The separator is ordered by the elimination: its first node is the parent clique
+		m_vVarOffset.assign(nNodes + 1, 0);
+		m_vTableOffset.assign(nNodes + 1, 0);
+		m_vMsgOffset.assign(nNodes + 1, 0);
+		m_vParent.assign(nNodes, NONE);
+		m_vVars.clear();
+		for (size_t n = 0; n < nNodes; n++) {
+			vec_size_t &vVars = vCliques[n];
+			std::sort(vVars.begin() + 1, vVars.end(), [&](size_t a, size_t b) { return vPos[a] < vPos[b]; });
+			if (vVars.size() > 1) m_vParent[n] = vVars[1];
+			m_vVars.insert(m_vVars.end(), vVars.begin(), vVars.end());
+			m_vVarOffset[n + 1] = m_vVars.size();
+			size_t size = 1;
+			for (size_t j = 1; j < vVars.size(); j++) size *= nStates;
+			m_vMsgOffset[n + 1]		= m_vMsgOffset[n] + (m_vParent[n] == NONE ? 0 : size);
+			m_vTableOffset[n + 1]	= m_vTableOffset[n] + size * nStates;
+		} // n
+
+		// The children and the levels of the cliques: the children are eliminated before their parents
+		m_vChildOffset.assign(nNodes + 1, 0);
+		for (size_t n = 0; n < nNodes; n++) if (m_vParent[n] != NONE) m_vChildOffset[m_vParent[n] + 1]++;
+		for (size_t n = 0; n < nNodes; n++) m_vChildOffset[n + 1] += m_vChildOffset[n];
+		m_vChildren.resize(m_vChildOffset[nNodes]);
+		vec_size_t vLevel(nNodes, 0);
+		{
+			vec_size_t vCursor(m_vChildOffset.begin(), m_vChildOffset.end() - 1);
+			m_vLevels.clear();
+			for (size_t v : vOrder) {
+				if (vLevel[v] >= m_vLevels.size()) m_vLevels.resize(vLevel[v] + 1);
+				m_vLevels[vLevel[v]].push_back(v);
+				const size_t p = m_vParent[v];
+				if (p == NONE) continue;
+				m_vChildren[vCursor[p]++] = v;
+				vLevel[p] = MAX(vLevel[p], vLevel[v] + 1);
+			} // v
+		}
+
+		// Every edge is assigned to the clique of its first eliminated end-point, which contains both the end-points
+		m_vEdgeOffset.assign(nNodes + 1, 0);
+		auto getClique = [&](const std::pair<size_t, size_t> &edge) { return vPos[edge.first] < vPos[edge.second] ? edge.first : edge.second; };
+		for (const auto &edge : vEdges) m_vEdgeOffset[getClique(edge) + 1]++;
+		for (size_t n = 0; n < nNodes; n++) m_vEdgeOffset[n + 1] += m_vEdgeOffset[n];
+		m_vEdges.resize(vEdges.size());
+		m_vEdgePot.resize(vEdgePot.size());
+		vec_size_t vCursor(m_vEdgeOffset.begin(), m_vEdgeOffset.end() - 1);
+		for (size_t e = 0; e < vEdges.size(); e++) {
+			const size_t k = vCursor[getClique(vEdges[e])]++;
+			m_vEdges[k] = vEdges[e];
+			std::copy(vEdgePot.begin() + e * nStates * nStates, vEdgePot.begin() + (e + 1) * nStates * nStates, m_vEdgePot.begin() + k * nStates * nStates);
+		} // e
+	}
+
+	void CInferJunctionTree::fillTables(void)
+	{
+		DGM_PROFILE_ZONE("fillTables");
+		const byte	nStates	= getGraph().getNumStates();
+		const int	nNodes	= static_cast<int>(getGraph().getNumNodes());
+		Mat			nodePots;
+		if (nNodes) getGraph().getNodes(0, 0, nodePots);
+
+		m_vTables.resize(m_vTableOffset[nNodes]);
+		m_vMsg.resize(m_vMsgOffset[nNodes]);
+		parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+			vec_size_t vStride;
+			for (int c = range.start; c < range.end; c++) {
+				const size_t *pVars	= &m_vVars[m_vVarOffset[c]];
+				const size_t  nVars	= m_vVarOffset[c + 1] - m_vVarOffset[c];
+				float		 *table	= &m_vTables[m_vTableOffset[c]];
+				const size_t  size	= m_vTableOffset[c + 1] - m_vTableOffset[c];
+				const float	 *pPot	= nodePots.ptr<float>(c);
+				for (size_t idx = 0; idx < size; idx++) table[idx] = pPot[idx % nStates];
+
+				for (size_t e = m_vEdgeOffset[c]; e < m_vEdgeOffset[c + 1]; e++) {
+					vStride.assign(nVars, 0);
+					for (size_t j = 0; j < nVars; j++) {
+						if (pVars[j] == m_vEdges[e].first)	vStride[j] += nStates;		// the row of the potential
+						if (pVars[j] == m_vEdges[e].second)	vStride[j] += 1;			// the column of the potential
+					} // j
+					const float *pEdgePot = &m_vEdgePot[e * nStates * nStates];
+					forEachConfig(nVars, size, nStates, vStride.data(), [&](size_t idx, size_t k) { table[idx] *= pEdgePot[k]; });
+				} // e
+				normalize(table, size);
+			} // c
+		});
+	}
+
+	void CInferJunctionTree::collect(bool maxProduct)
+	{
+		const byte nStates = getGraph().getNumStates();
+		for (const vec_size_t &vCliques : m_vLevels)
+			parallel::parallelFor(Range(0, static_cast<int>(vCliques.size())), [&](const Range &range) {
+				vec_size_t vStride;
+				for (int i = range.start; i < range.end; i++) {
+					const size_t  c		= vCliques[i];
+					const size_t *pVars	= &m_vVars[m_vVarOffset[c]];
+					const size_t  nVars	= m_vVarOffset[c + 1] - m_vVarOffset[c];
+					float		 *table	= &m_vTables[m_vTableOffset[c]];
+					const size_t  size	= m_vTableOffset[c + 1] - m_vTableOffset[c];
+
+					// The messages of the children
+					for (size_t k = m_vChildOffset[c]; k < m_vChildOffset[c + 1]; k++) {
+						const size_t ch = m_vChildren[k];
+						getSeparatorStrides(pVars, nVars, &m_vVars[m_vVarOffset[ch] + 1], m_vVarOffset[ch + 1] - m_vVarOffset[ch] - 1, nStates, vStride);
+						const float *msg = &m_vMsg[m_vMsgOffset[ch]];
+						forEachConfig(nVars, size, nStates, vStride.data(), [&](size_t idx, size_t sepIdx) { table[idx] *= msg[sepIdx]; });
+					} // k
+					normalize(table, size);
+
+					// The message to the parent: the eliminated node has the stride 1
+					if (m_vParent[c] == NONE) continue;
+					float		*msg	= &m_vMsg[m_vMsgOffset[c]];
+					const size_t nMsg	= m_vMsgOffset[c + 1] - m_vMsgOffset[c];
+					for (size_t s = 0; s < nMsg; s++) {
+						const float *pConfig = &table[s * nStates];
+						if (maxProduct) msg[s] = *std::max_element(pConfig, pConfig + nStates);
+						else {
+							msg[s] = 0;
+							for (byte x = 0; x < nStates; x++) msg[s] += pConfig[x];
+						}
+					} // s
+					normalize(msg, nMsg);
+				} // i
+			}, 64);
+	}
+
+	// The Hugin update: the table of the clique is multiplied by the ratio of the new and the old marginals over the separator
+	void CInferJunctionTree::distribute(void)
+	{
+		const byte nStates = getGraph().getNumStates();
+		for (size_t l = m_vLevels.size(); l > 0; l--) {
+			const vec_size_t &vCliques = m_vLevels[l - 1];
+			parallel::parallelFor(Range(0, static_cast<int>(vCliques.size())), [&](const Range &range) {
+				vec_size_t vStride;
+				for (int i = range.start; i < range.end; i++) {
+					const size_t c = vCliques[i];
+					const size_t p = m_vParent[c];
+					if (p == NONE) continue;
+
+					const size_t nMsg	= m_vMsgOffset[c + 1] - m_vMsgOffset[c];
+					float		*marg	= CArena::getScratch<float>(nMsg);
+					std::fill(marg, marg + nMsg, 0.0f);
+					const float *parent	= &m_vTables[m_vTableOffset[p]];
+					getSeparatorStrides(&m_vVars[m_vVarOffset[p]], m_vVarOffset[p + 1] - m_vVarOffset[p], &m_vVars[m_vVarOffset[c] + 1], m_vVarOffset[c + 1] - m_vVarOffset[c] - 1, nStates, vStride);
+					forEachConfig(vStride.size(), m_vTableOffset[p + 1] - m_vTableOffset[p], nStates, vStride.data(), [&](size_t idx, size_t sepIdx) { marg[sepIdx] += parent[idx]; });
+
+					const float *msg	= &m_vMsg[m_vMsgOffset[c]];
+					float		*table	= &m_vTables[m_vTableOffset[c]];
+					for (size_t s = 0; s < nMsg; s++) {
+						const float ratio = msg[s] > 0 ? marg[s] / msg[s] : 0.0f;
+						for (byte x = 0; x < nStates; x++) table[s * nStates + x] *= ratio;
+					} // s
+					normalize(table, m_vTableOffset[c + 1] - m_vTableOffset[c]);
+				} // i
+			}, 64);
+		} // l
+	}
+
+	IGraphPairwise& CInferJunctionTree::getGraphPairwise(void) const
+	{
+		return dynamic_cast<IGraphPairwise&>(getGraph());
+	}
+}
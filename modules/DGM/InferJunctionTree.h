@@ -0,0 +1,92 @@
+// Junction Tree exact inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "Infer.h"
+#include "IGraphPairwise.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Junction Tree Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Exact inference for the graphs with low treewidth
+	* @details The nodes are eliminated in the greedy min-fill order: every node, together with its neighbours at the time of its elimination, forms a clique,
+	* whose parent is the clique of the first eliminated neighbour. The resulting clique tree (junction tree) is calibrated with the messages over the separators
+	* in two passes: upward (from the leafs to the roots) and downward (from the roots to the leafs). The cliques of one level of the tree depend on
+	* the lower (upper) levels only and are processed in parallel.
+	*
+	* The clique tables are stored as flat arrays of \f$nStates^{|C|}\f$ values, thus the cost of the inference is linear in the number of nodes and exponential
+	* in the treewidth \f$w = \max|C| - 1\f$ only, \a e.g. a graph with 50 nodes and treewidth 3 is solved exactly, while the enumeration of @ref CInferExact
+	* is not feasible:
+	* @code
+	* CInferJunctionTree inferer(graph);
+	* inferer.infer();								// the exact marginals
+	* vec_byte_t map = inferer.decodeMAP();			// the most probable configuration
+	* @endcode
+	* The probability of a configuration is the product of all the node potentials and of all the edge potentials, the same as with @ref CDecodeExact.
+	* @note Use this class only if \f$ nStates^{w + 1} < 2^{31}\f$
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferJunctionTree : public CInfer
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		*/
+		DllExport CInferJunctionTree(IGraphPairwise &graph) : CInfer(graph) {}
+		DllExport virtual ~CInferJunctionTree(void) = default;
+
+		/**
+		* @brief Exact inference
+		* @details This function calculates the exact marginal probabilities of every node with the sum-product calibration of the junction tree, and stores
+		* them as node potentials, unless the output buffer is set (ref. CInfer::setOutput()).
+		* @param nIt is not used
+		*/
+		DllExport virtual void		infer(unsigned int nIt = 0);
+		/**
+		* @brief Exact decoding
+		* @details This function finds the most probable configuration with the max-product upward pass and the traceback from the roots to the leafs.
+		* In contrast to CInfer::decode(), which takes the most probable state of every node separately, the result is the same as the result of CDecodeExact::decode().
+		* The node potentials of the graph are not changed.
+		* @return The most probable configuration
+		*/
+		DllExport vec_byte_t		decodeMAP(void);
+		DllExport virtual size_t	getMemoryUsage(void) const;
+		/**
+		* @brief Returns the treewidth of the junction tree
+		* @return The size of the largest clique minus one, as found by the last call of infer() or decodeMAP()
+		*/
+		DllExport size_t			getTreewidth(void) const { return m_treewidth; }
+
+
+	private:
+		// Builds the junction tree with the min-fill elimination ordering
+		void	buildTree(void);
+		// Fills the clique tables with the products of the node and edge potentials
+		void	fillTables(void);
+		// Upward pass: every clique multiplies the messages of its children and sends the message to its parent
+		void	collect(bool maxProduct);
+		// Downward pass: every clique multiplies the marginal of its parent over the separator, divided by its own upward message
+		void	distribute(void);
+		IGraphPairwise& getGraphPairwise(void) const;
+
+
+	private:
+		size_t					m_treewidth = 0;	///< The treewidth of the last junction tree
+		vec_size_t				m_vVarOffset;		///< The index of the first variable of every clique in m_vVars, followed by the total number of variables
+		vec_size_t				m_vVars;			///< The variables (nodes) of every clique: the eliminated node, followed by the separator
+		vec_size_t				m_vParent;			///< The parent clique of every clique, or -1 for the roots
+		vec_size_t				m_vChildOffset;		///< The index of the first child of every clique in m_vChildren, followed by the total number of children
+		vec_size_t				m_vChildren;		///< The children of every clique
+		std::vector<vec_size_t>	m_vLevels;			///< The cliques of every level: the level of a clique is one more than the highest level of its children
+		vec_size_t				m_vTableOffset;		///< The index of the first value of the table of every clique in m_vTables, followed by the total size
+		vec_float_t				m_vTables;			///< The clique tables: the state of the eliminated node has the stride 1, the states of the separator the strides nStates^i
+		vec_size_t				m_vMsgOffset;		///< The index of the first value of the upward message of every clique in m_vMsg, followed by the total size
+		vec_float_t				m_vMsg;				///< The upward messages over the separators
+		std::vector<std::pair<size_t, size_t>>	m_vEdges;		///< The directed edges (src, dst) of the graph, grouped by the cliques, to which they are assigned
+		vec_size_t				m_vEdgeOffset;		///< The index of the first edge of every clique in m_vEdges, followed by the total number of edges
+		vec_float_t				m_vEdgePot;			///< The potentials of the edges in m_vEdges: nStates x nStates values per edge
+	};
+}
@@ -1,37 +1,339 @@
 #include "InferLBP.h"
-#include "GraphPairwise.h"
+#include "GraphGrid.h"
+#include "DenseOCL.h"
+#include "parallel.h"
+#include "simd.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace DirectGraphicalModels
 {
 	void CInferLBP::calculateMessages(unsigned int nIt)
 	{
-		const byte		nStates = getGraph().getNumStates();				// number of states
-		
+		const byte		nStates		= getGraph().getNumStates();				// number of states
+		const int		nNodes		= static_cast<int>(getGraph().getNumNodes());
+		const size_t	nEdges		= getGraph().getNumEdges();
+		const bool		inPlace		= m_asynchronous || !m_vColourNodes.empty();	// asynchronous or checkerboard schedule
+		std::mutex		mtx;
+
+		const bool		compressed	= isMessageCompressed();
+		const bool		buffered	= compressed || m_asynchronous;			// the messages are accessed with readMessage() and writeMessage()
+		const bool		openCL		= m_openCL && !inPlace && !compressed && !isLogDomain() && !isHalfPrecision() && getStatePruning() == 0;
+		if (openCL && calculateMessagesOCL(nIt)) return;						// otherwise the remaining iterations run on the host
+		const bool		batched		= m_edgeBatched && !inPlace && !compressed && !isLogDomain() && !isHalfPrecision() && getStatePruning() == 0;
+		if (batched && calculateMessagesBatched(nIt)) return;
+
+		float	maxResidual = 0;													// maximal L1-change of a message
+		double	sumResidual = 0;													// sum of the L1-changes of all messages
+
+		// Calculates the messages from the nodes pNodes[i] (or i if pNodes is NULL), i in [0; size)
+		auto sweep = [&](const size_t *pNodes, int size) {
+			parallel::parallelFor(Range(0, size), [&, nStates](const Range& range) {		// all nodes
+				float  *temp	= CArena::getScratch<float>(nStates);
+				float  *msg_buf	= buffered ? CArena::getScratch<float>(nStates, 2) : NULL;	// new compressed (or concurrent) message
+				float	msg_old[256];
+				float	maxRes = 0;
+				double	sumRes = 0;
+				for (int i = range.start; i < range.end; i++) {
+					const size_t n = pNodes ? pNodes[i] : i;
+					// Calculate a message to each neighbor
+					for (size_t e_t : getOutEdges(n)) {								// outgoing edges
+						const float *msg;
+						float		*msg_new;
+						if (buffered) {
+							msg_new = msg_buf;
+							msg		= readMessage(e_t, msg_old);
+						}
+						else if (inPlace) {
+							msg_new = getMessage(e_t);
+							memcpy(msg_old, msg_new, nStates * sizeof(float));
+							msg = msg_old;
+						}
+						else {
+							msg_new = getMessageTemp(e_t);
+							msg		= getMessage(e_t);
+						}
+						calculateMessage(e_t, temp, msg_new, m_maxSum);
+						if (buffered) writeMessage(e_t, msg_new, !inPlace);
+
+						float res = 0;
+						for (byte s = 0; s < nStates; s++) res += fabs(msg_new[s] - msg[s]);
+						if (maxRes < res) maxRes = res;
+						sumRes += res;
+					} // e_t
+				} // i
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					if (maxResidual < maxRes) maxResidual = maxRes;
+					sumResidual += sumRes;
+				}
+			});
+		};
+
 		// ======================== Main loop (iterative messages calculation) ========================
 		for (unsigned int i = 0; i < nIt; i++) {								// iterations
+			DGM_PROFILE_ZONE("LBP iteration");
 #ifdef DEBUG_PRINT_INFO
 			if (i == 0) printf("\n");
 			if (i % 5 == 0) printf("--- It: %d ---\n", i);
 #endif
-#ifdef ENABLE_PDP
-			parallel_for_(Range(0, getGraphPairwise().m_vNodes.size()), [&, nStates](const Range& range) {		// all nodes
-#else
-			const Range range(0, getGraphPairwise().m_vNodes.size());
-#endif
-			float* temp = new float[nStates];
-			for (int i = range.start; i < range.end; i++) {
-				ptr_node_t& node = getGraphPairwise().m_vNodes[i];
-				// Calculate a message to each neighbor
-				for (size_t e_t : node->to) {									// outgoing edges
-					Edge* edge_to = getGraphPairwise().m_vEdges[e_t].get();		// current outgoing edge
-					calculateMessage(*edge_to, temp, getMessageTemp(e_t), m_maxSum);
-				} // e_t;
-			} // i
-			delete[] temp;
-#ifdef ENABLE_PDP			
+			maxResidual = 0;
+			sumResidual = 0;
+			if (m_asynchronous) sweep(NULL, nNodes);							// the threads use the fresh messages of each other
+			else if (inPlace)
+				for (const vec_size_t &vNodes : m_vColourNodes)					// the nodes of one colour use the fresh messages of the other colour
+					sweep(vNodes.data(), static_cast<int>(vNodes.size()));
+			else {
+				sweep(NULL, nNodes);
+				swapMessages();													// Coping data from msg_temp to msg
+			}
+
+			float residual = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(1, nEdges));
+			if (isConverged(i, residual, nEdges)) break;
+		} // iterations
+	}
+
+	size_t CInferLBP::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing) + footprint::getBytes(m_vColourNodes);
+	}
+
+	bool CInferLBP::isInPlace(void)
+	{
+		m_vColourNodes.clear();
+		if (m_asynchronous) return true;
+		if (!m_checkerboard) return false;
+
+		// 2-colouring of the graph with the depth-first search
+		const size_t nNodes = getGraph().getNumNodes();
+		const byte	 NONE	= 2;
+		vec_byte_t				vColour(nNodes, NONE);
+		std::vector<vec_size_t>	vColourNodes(2);
+		vec_size_t				vStack;
+		for (size_t root = 0; root < nNodes; root++) {
+			if (vColour[root] != NONE) continue;
+			vColour[root] = 0;
+			vStack.push_back(root);
+			while (!vStack.empty()) {
+				const size_t n = vStack.back();
+				vStack.pop_back();
+				vColourNodes[vColour[n]].push_back(n);
+				for (int dir = 0; dir < 2; dir++)
+					for (size_t e : dir ? getInEdges(n) : getOutEdges(n)) {
+						const size_t m = dir ? getEdgeSrc(e) : getEdgeDst(e);
+						if (vColour[m] == NONE) {
+							vColour[m] = 1 - vColour[n];
+							vStack.push_back(m);
+						}
+						else if (vColour[m] == vColour[n]) {
+							DGM_WARNING("The graph is not bipartite: the synchronous schedule is used instead of the checkerboard one");
+							return false;
+						}
+					} // e
+			}
+		} // root
+
+		// Sorting keeps the memory access of every colour sequential, e.g. row by row for the grid graphs
+		for (vec_size_t &vNodes : vColourNodes) std::sort(vNodes.begin(), vNodes.end());
+		m_vColourNodes = std::move(vColourNodes);
+		return true;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The messages are stored at their destination nodes: plane (d * nStates + s) holds the values of the state s of the messages, sent along the direction d.
+	// Thus every row of the grid reads its incoming messages and writes its outgoing messages as contiguous rows of the planes
+	bool CInferLBP::calculateMessagesBatched(unsigned int nIt)
+	{
+		const byte			nStates		= getGraph().getNumStates();
+		const size_t		nNodes		= getGraph().getNumNodes();
+		const size_t		nEdges		= getGraph().getNumEdges();
+		const size_t		nSlots		= getNumEdgeSlots();
+		const CGraphGrid  * pGraphGrid	= dynamic_cast<const CGraphGrid *>(&getGraph());
+		if (!pGraphGrid || nStates > 8) return false;
+		const int			width		= pGraphGrid->getSize().width;
+		const int			height		= pGraphGrid->getSize().height;
+		if (width < 2 || height < 2 || nNodes != static_cast<size_t>(width) * height || nSlots != 4 * nNodes) return false;	// one layer of one slice
+
+		// The direction of every slot and the squared potential, shared by all the edges of a direction
+		const ptrdiff_t	vOffsets[4]	= { 1, -1, width, -width };					// right, left, down, up: the direction d ^ 1 is opposite to the direction d
+		const float	  *	vpPot[4]	= { NULL, NULL, NULL, NULL };
+		int				vSlotDir[4]	= { -1, -1, -1, -1 };
+		size_t			vCount[4]	= { 0, 0, 0, 0 };
+		for (size_t e = 0; e < nSlots; e++) {
+			const size_t src = getEdgeSrc(e);
+			const size_t dst = getEdgeDst(e);
+			if (dst == src && !getEdgePot(e)) continue;								// unused slot
+			if (!getEdgePot(e) || isEdgePotPotts(e)) return false;
+			const ptrdiff_t offset	= static_cast<ptrdiff_t>(dst) - static_cast<ptrdiff_t>(src);
+			const int		d		= static_cast<int>(std::find(vOffsets, vOffsets + 4, offset) - vOffsets);
+			if (d == 4 || (vSlotDir[e % 4] >= 0 && vSlotDir[e % 4] != d)) return false;
+			if (d < 2 && dst / width != src / width) return false;					// the horizontal edges do not wrap around the rows
+			vSlotDir[e % 4] = d;
+			if (!vpPot[d]) vpPot[d] = getEdgePotSquared(e);
+			else if (vpPot[d] != getEdgePotSquared(e)) return false;
+			vCount[d]++;
+		}
+		const size_t nHorizontal	= static_cast<size_t>(width - 1) * height;
+		const size_t nVertical		= static_cast<size_t>(height - 1) * width;
+		if (vCount[0] != nHorizontal || vCount[1] != nHorizontal || vCount[2] != nVertical || vCount[3] != nVertical) return false;	// removed edges
+
+		// The missing neighbours at the borders send the neutral messages
+		vec_float_t vNodePot(nStates * nNodes);
+		vec_float_t vMsg(4 * nStates * nNodes, 1.0f);
+		for (size_t n = 0; n < nNodes; n++)
+			for (byte s = 0; s < nStates; s++) vNodePot[s * nNodes + n] = getNodePot(n)[s];
+		for (size_t e = 0; e < nSlots; e++)
+			if (getEdgePot(e)) {
+				const float *msg = getMessage(e);
+				for (byte s = 0; s < nStates; s++) vMsg[(vSlotDir[e % 4] * nStates + s) * nNodes + getEdgeDst(e)] = msg[s];
+			}
+		vec_float_t vMsgNew(vMsg);
+
+		std::mutex	mtx;
+		float		maxResidual = 0;
+		double		sumResidual = 0;
+		for (unsigned int i = 0; i < nIt; i++) {
+			DGM_PROFILE_ZONE("LBP iteration (edge-batched)");
+			maxResidual = 0;
+			sumResidual = 0;
+			parallel::parallelFor(Range(0, height), [&](const Range &range) {
+				float  *temp	= CArena::getScratch<float>(nStates * width);		// the products of the node potentials and the incoming messages
+				float	maxRes	= 0;
+				double	sumRes	= 0;
+				for (int y = range.start; y < range.end; y++)
+					for (int d = 0; d < 4; d++) {
+						if ((d == 2 && y == height - 1) || (d == 3 && y == 0)) continue;
+						const size_t	first	= static_cast<size_t>(y) * width + (d == 1 ? 1 : 0);	// the first source node
+						const int		n		= d < 2 ? width - 1 : width;						// the number of the edges
+
+						// temp = node.Pot * product of all incoming msgs except the one from the destination node
+						for (byte s = 0; s < nStates; s++) {
+							float *pTemp = temp + s * width;
+							memcpy(pTemp, &vNodePot[s * nNodes + first], n * sizeof(float));
+							for (int dIn = 0; dIn < 4; dIn++)
+								if (dIn != (d ^ 1)) {
+									const float *pMsg = &vMsg[(dIn * nStates + s) * nNodes + first];
+									for (int k = 0; k < n; k++) pTemp[k] *= pMsg[k];
+								}
+						} // s
+
+						const size_t	 offset	 = d * nStates * nNodes + static_cast<size_t>(static_cast<ptrdiff_t>(first) + vOffsets[d]);	// the first destination node
+						float		   * pMsgNew = &vMsgNew[offset];
+						const float	   * pMsg	 = &vMsg[offset];
+						simd::matTVecMulBatch(vpPot[d], temp, width, pMsgNew, static_cast<int>(nNodes), nStates, n, m_maxSum);
+						for (int k = 0; k < n; k++) {
+							float res = 0;
+							for (byte s = 0; s < nStates; s++) res += fabs(pMsgNew[s * nNodes + k] - pMsg[s * nNodes + k]);
+							if (maxRes < res) maxRes = res;
+							sumRes += res;
+						}
+					} // d
+				std::lock_guard<std::mutex> lock(mtx);
+				if (maxResidual < maxRes) maxResidual = maxRes;
+				sumResidual += sumRes;
 			});
-#endif
-			swapMessages();														// Coping data from msg_temp to msg
+			std::swap(vMsg, vMsgNew);
+
+			float residual = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(1, nEdges));
+			if (isConverged(i, residual, nEdges)) break;
 		} // iterations
+
+		for (size_t e = 0; e < nSlots; e++)
+			if (getEdgePot(e)) {
+				float *msg = getMessage(e);
+				for (byte s = 0; s < nStates; s++) msg[s] = vMsg[(vSlotDir[e % 4] * nStates + s) * nNodes + getEdgeDst(e)];
+			}
+		return true;
+	}
+
+	// The graph view is flattened into the index arrays; the equal squared potential tables are uploaded once
+	bool CInferLBP::calculateMessagesOCL(unsigned int &nIt)
+	{
+#ifdef ENABLE_OCL
+		const byte		nStates		= getGraph().getNumStates();
+		const int		nNodes		= static_cast<int>(getGraph().getNumNodes());
+		const int		nSlots		= static_cast<int>(getNumEdgeSlots());
+		const size_t	nEdges		= getGraph().getNumEdges();
+		if (!gpu::isAvailable() || nSlots == 0) return false;
+
+		Mat edgeSrc(1, nSlots, CV_32SC1, Scalar(0));
+		Mat edgeDst(1, nSlots, CV_32SC1, Scalar(0));
+		Mat potIdx(1, nSlots, CV_32SC1, Scalar(-3));								// unused slots are not the outgoing edges of any node
+		Mat potts(1, nSlots, CV_32FC2, Scalar(0, 0));
+		Mat inOffset(1, nNodes + 1, CV_32SC1);
+		vec_int_t vInEdges;
+		std::vector<const float *> vpPots;											// the unique squared potential tables
+		std::unordered_map<const float *, int> pot2idx;
+		Mat nodePot(nNodes, nStates, CV_32FC1);
+		for (int n = 0; n < nNodes; n++) {
+			memcpy(nodePot.ptr<float>(n), getNodePot(n), nStates * sizeof(float));
+			inOffset.at<int>(n) = static_cast<int>(vInEdges.size());
+			for (size_t e : getInEdges(n)) vInEdges.push_back(static_cast<int>(e));
+			for (size_t e : getOutEdges(n)) {
+				edgeSrc.at<int>(static_cast<int>(e)) = n;
+				edgeDst.at<int>(static_cast<int>(e)) = static_cast<int>(getEdgeDst(e));
+				const float *pot2 = getEdgePotSquared(e);
+				int &idx = potIdx.at<int>(static_cast<int>(e));
+				if (!pot2) idx = -1;
+				else if (isEdgePotPotts(e)) {
+					const EdgePotModel &model = getEdgePotModel(e, true);
+					idx = -2;
+					potts.at<Vec2f>(static_cast<int>(e)) = Vec2f(model.diag, model.trunc);
+				}
+				else {
+					auto it = pot2idx.emplace(pot2, static_cast<int>(vpPots.size())).first;
+					if (it->second == static_cast<int>(vpPots.size())) vpPots.push_back(pot2);
+					idx = it->second;
+				}
+			} // e
+		} // n
+		inOffset.at<int>(nNodes) = static_cast<int>(vInEdges.size());
+		if (vInEdges.empty()) vInEdges.push_back(0);
+		
+		Mat pots(MAX(1, static_cast<int>(vpPots.size())), nStates * nStates, CV_32FC1, Scalar(0));
+		for (size_t i = 0; i < vpPots.size(); i++) memcpy(pots.ptr<float>(static_cast<int>(i)), vpPots[i], nStates * nStates * sizeof(float));
+
+		UMat uNodePot, uEdgeSrc, uEdgeDst, uInOffset, uInEdges, uPotIdx, uPots, uPotts, uMsg, uMsgNew;
+		nodePot.copyTo(uNodePot);
+		edgeSrc.copyTo(uEdgeSrc);
+		edgeDst.copyTo(uEdgeDst);
+		inOffset.copyTo(uInOffset);
+		Mat(vInEdges, false).copyTo(uInEdges);
+		potIdx.copyTo(uPotIdx);
+		pots.copyTo(uPots);
+		potts.copyTo(uPotts);
+		Mat msg(nSlots, nStates, CV_32FC1, getMessage(0));
+		msg.copyTo(uMsg);
+		msg.copyTo(uMsgNew);														// the unused slots keep their values in both buffers
+		UMat uResidual(nSlots, 1, CV_32FC1);
+
+		for (unsigned int i = 0; i < nIt; i++) {
+			DGM_PROFILE_ZONE("LBP iteration (OpenCL)");
+			ocl::Kernel kernel = gpu::getKernel("lbp_message");
+			kernel.args(ocl::KernelArg::PtrReadOnly(uNodePot), ocl::KernelArg::PtrReadOnly(uMsg), ocl::KernelArg::PtrWriteOnly(uMsgNew), ocl::KernelArg::PtrWriteOnly(uResidual),
+				ocl::KernelArg::PtrReadOnly(uEdgeSrc), ocl::KernelArg::PtrReadOnly(uEdgeDst), ocl::KernelArg::PtrReadOnly(uInOffset), ocl::KernelArg::PtrReadOnly(uInEdges),
+				ocl::KernelArg::PtrReadOnly(uPotIdx), ocl::KernelArg::PtrReadOnly(uPots), ocl::KernelArg::PtrReadOnly(uPotts), static_cast<int>(m_maxSum), static_cast<int>(nStates), nSlots);
+			if (!gpu::run(kernel, nSlots)) {
+				DGM_WARNING("The message update failed on the OpenCL device: the remaining %u iterations run on the host", nIt - i);
+				if (i > 0) uMsg.copyTo(msg);											// the messages of the completed iterations
+				nIt -= i;
+				return false;
+			}
+			std::swap(uMsg, uMsgNew);
+
+			double residual;
+			if (getResidualNorm() == ResidualNorm::max) minMaxLoc(uResidual, NULL, &residual);
+			else residual = sum(uResidual)[0] / MAX(1, nEdges);
+			if (isConverged(i, static_cast<float>(residual), nEdges)) break;
+		} // iterations
+
+		uMsg.copyTo(msg);
+		return true;
+#else
+		return false;
+#endif
 	}
 }
@@ -20,18 +20,79 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param graph The graph
 		*/			
-		DllExport CInferLBP(CGraphPairwise &graph) : CMessagePassing(graph), m_maxSum(false) {}
+		DllExport CInferLBP(IGraphPairwise &graph) : CMessagePassing(graph), m_maxSum(false), m_checkerboard(false), m_asynchronous(false), m_openCL(false), m_edgeBatched(false) {}
 		DllExport virtual ~CInferLBP(void) = default;
 
+		DllExport virtual size_t getMemoryUsage(void) const;
+
+		/**
+		* @brief Enables the checkerboard (red-black) message schedule
+		* @details For bipartite graphs, \a e.g. the grid graphs built with @ref CGraphPairwiseExt or @ref CGraphLayeredExt with the @ref GRAPH_EDGES_GRID
+		* edges, the nodes are split into two colours, such that no edge connects the nodes of the same colour. Every iteration the nodes of one colour
+		* update their messages in place (in parallel), using the fresh messages of the nodes of the other colour. Thus, no temporary message container
+		* is needed and the messages converge in roughly half of the iterations of the synchronous schedule.
+		* > If the graph is not bipartite (\a e.g. with the @ref GRAPH_EDGES_DIAG edges), the standard synchronous schedule is used.
+		* @param checkerboard Flag indicating whether the checkerboard schedule should be used
+		*/
+		DllExport void			setCheckerboard(bool checkerboard) { m_checkerboard = checkerboard; }
+		/**
+		* @brief Enables the asynchronous (Gauss-Seidel) message schedule
+		* @details Every thread processes a contiguous range of the nodes, \a e.g. a stripe of rows of a grid graph, and updates their messages in place,
+		* using the freshest messages of all the nodes, including those updated by the other threads in the same iteration. Thus, the information travels
+		* across the whole range of a thread in one iteration, no temporary message container is needed and the messages converge in far fewer iterations
+		* than with the synchronous schedule. Every message is guarded with a sequence lock (ref. CMessagePassing::isConcurrent()), so that the readers
+		* never see a partially written message.
+		* > The result depends on the interleaving of the threads and is not exactly reproducible. This schedule takes precedence over the checkerboard one.
+		* @param asynchronous Flag indicating whether the asynchronous schedule should be used
+		*/
+		DllExport void			setAsynchronous(bool asynchronous) { m_asynchronous = asynchronous; }
+		/**
+		* @brief Enables the OpenCL inference
+		* @details If enabled and the OpenCL device is available (ref. gpu::isAvailable()), the synchronous message updates are performed on the device:
+		* the messages, the node potentials and the squared edge potentials stay on the device across the iterations and only the converged messages are copied back.
+		* The shared edge potentials (\a e.g. one potential for all edges of a grid) are uploaded once. The inference falls back to the CPU for the checkerboard schedule
+		* and in the logarithmic domain (ref. setLogDomain()), as well as for the half precision edge potentials, the pruned states and the compressed messages.
+		* If a message update fails on the device, the messages of the completed iterations are copied back and the remaining iterations run on the CPU.
+		* > The library must be built with the \b ENABLE_OCL option
+		* @param enable Flag indicating whether the OpenCL device should be used
+		*/
+		DllExport void			setOpenCL(bool enable) { m_openCL = enable; }
+		/**
+		* @brief Enables the edge-batched message updates for the problems with few states
+		* @details With a small number of states, \a e.g. the binary segmentation, the vectorization of one message update across the states leaves the most
+		* of the vector lanes empty. If enabled, the messages of the 2D grid graphs (@ref CGraphGrid with one layer and the @ref GRAPH_EDGES_GRID edges) are
+		* stored by direction in the structure-of-arrays layout: the messages, sent along one direction by a row of the grid, are contiguous, and
+		* one vector instruction updates 4 to 16 edges at once (ref. simd::matTVecMulBatch()). The synchronous schedule is used; the results match the
+		* standard message updates up to the rounding errors.
+		* > The edge-batched updates are used if the graph has at most 8 states, all the edges of one direction share one potential (\a e.g. set with
+		* setEdges()) and no edge is removed. Otherwise, as well as for the checkerboard and asynchronous schedules, in the logarithmic domain (ref. setLogDomain()),
+		* for the half precision edge potentials, the pruned states and the compressed messages, the standard message updates are performed.
+		* @param enable Flag indicating whether the edge-batched message updates should be used
+		*/
+		DllExport void			setEdgeBatched(bool enable) { m_edgeBatched = enable; }
+
 
 	protected:
 		DllExport virtual void	calculateMessages(unsigned int nIt);
+		DllExport virtual bool	isInPlace(void);
+		DllExport virtual bool	isCompressible(void) { return true; }
+		DllExport virtual bool	isConcurrent(void) { return m_asynchronous; }
 		void					setMaxSum(bool maxSum) { m_maxSum = maxSum; }
-		bool					isMaxSum(void) const { return m_maxSum; }
+		bool					isMaxSum(void) const override { return m_maxSum; }
+
+
+	private:
+		bool					calculateMessagesOCL(unsigned int &nIt);
+		bool					calculateMessagesBatched(unsigned int nIt);
 
 
 	private:
-		bool m_maxSum;			///< Flag indicating weather the max-sum LBP (Viterbi algorithm) should be applied
+		bool					m_maxSum;			///< Flag indicating weather the max-sum LBP (Viterbi algorithm) should be applied
+		bool					m_checkerboard;		///< Flag indicating weather the checkerboard schedule should be applied
+		bool					m_asynchronous;		///< Flag indicating weather the asynchronous schedule should be applied
+		bool					m_openCL;			///< Flag indicating whether the OpenCL device should be used
+		bool					m_edgeBatched;		///< Flag indicating whether the edge-batched message updates should be used
+		std::vector<vec_size_t>	m_vColourNodes;		///< The nodes of both colours for the checkerboard schedule (empty for the synchronous schedule)
 	};
 
 }
@@ -0,0 +1,244 @@
+#include "InferLBP3.h"
+#include "ThreadPool.h"
+#include "profiler.h"
+#include "macroses.h"
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	void CInferLBP3::infer(unsigned int nIt)
+	{
+		const byte		nStates	= m_graph3.getNumStates();
+		const size_t	nNodes	= m_graph3.getNumNodes();
+		const size_t	K		= nStates;
+		const bool		maxSum	= m_maxSum;
+		std::mutex		mtx;
+
+		// ====================================== Initialization ======================================
+		resetConvergence();
+		getArena().reset();
+
+		// The factors: the edges and the triplets; the edge potentials are copied, the triplet potentials are referenced.
+		// Both directed edges of an arc form one factor, since two factors over the same pair of nodes would make a loop in the factor graph
+		std::vector<Factor>	vFactors;
+		vec_size_t			vSlotNode;															// the node of every variable slot
+		float			  * pEdgePot = getArena().allocate<float>(m_graph3.getNumEdges() * K * K);
+		size_t				nEdgePots = 0;
+		Mat					pot, potBack;
+		vec_size_t			vChilds;
+		for (size_t n = 0; n < nNodes; n++) {
+			m_graph3.getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				const bool arc = m_graph3.isEdgeExists(c, n);
+				if (arc && c < n) continue;														// already added with the edge (c) -> (n)
+				m_graph3.getEdge(n, c, pot);
+				if (arc) {
+					m_graph3.getEdge(c, n, potBack);
+					if (pot.empty()) pot = potBack.t();
+					else if (!potBack.empty()) pot = pot.mul(potBack.t());
+				}
+				if (pot.empty()) continue;
+				float *dst = pEdgePot + nEdgePots++ * K * K;
+				for (byte x = 0; x < nStates; x++) memcpy(dst + x * K, pot.ptr<float>(x), K * sizeof(float));
+				vFactors.push_back({ FactorKind::pairwise, dst, vSlotNode.size() });
+				vSlotNode.push_back(n);
+				vSlotNode.push_back(c);
+			}
+		} // n
+		for (const Triplet &triplet : m_graph3.getTriplets()) {
+			if (triplet.Pot.empty()) continue;
+			DGM_ASSERT_MSG(triplet.Pot.isContinuous(), "The triplet potential must be continuous");
+			vFactors.push_back({ CGraph3::isPotts(triplet.Pot) ? FactorKind::potts : FactorKind::triplet, triplet.Pot.ptr<float>(), vSlotNode.size() });
+			vSlotNode.push_back(triplet.node1);
+			vSlotNode.push_back(triplet.node2);
+			vSlotNode.push_back(triplet.node3);
+		}
+		const size_t nSlots = vSlotNode.size();
+		const int	 nFactors = static_cast<int>(vFactors.size());
+
+		// The variable slots of every node in CSR
+		vec_size_t vOffset(nNodes + 1, 0), vNodeSlots(nSlots);
+		for (size_t node : vSlotNode) vOffset[node + 1]++;
+		for (size_t n = 0; n < nNodes; n++) vOffset[n + 1] += vOffset[n];
+		{
+			vec_size_t vPos(vOffset.begin(), vOffset.end() - 1);
+			for (size_t slot = 0; slot < nSlots; slot++) vNodeSlots[vPos[vSlotNode[slot]]++] = slot;
+		}
+
+		Mat nodePots;
+		m_graph3.getNodes(0, nNodes, nodePots);
+		float *pMsgF2V = getArena().allocate<float>(nSlots * K);								// factor-to-variable messages
+		float *pMsgV2F = getArena().allocate<float>(nSlots * K);								// variable-to-factor messages
+		std::fill(pMsgF2V, pMsgF2V + nSlots * K, 1.0f / nStates);
+
+		// Normalizes the message: the sum (or the maximum for the max-product) of its values is 1
+		auto normalize = [nStates, maxSum](float *msg) {
+			float Z = 0;
+			for (byte s = 0; s < nStates; s++) Z = maxSum ? MAX(Z, msg[s]) : Z + msg[s];
+			if (Z > FLT_EPSILON) for (byte s = 0; s < nStates; s++) msg[s] /= Z;
+			else				 std::fill(msg, msg + nStates, 1.0f / nStates);
+		};
+
+		// ======================== Main loop (iterative messages calculation) ========================
+		for (unsigned int i = 0; i < nIt; i++) {												// iterations
+			DGM_PROFILE_ZONE("LBP3 iteration");
+			// Variable-to-factor messages: the product of the node potential and of the messages from all the other factors
+			parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range& range) {
+				for (int n = range.start; n < range.end; n++) {
+					const float *pPot = nodePots.ptr<float>(n);
+					for (size_t k = vOffset[n]; k < vOffset[n + 1]; k++) {
+						float *msg = pMsgV2F + vNodeSlots[k] * K;
+						memcpy(msg, pPot, K * sizeof(float));
+						for (size_t l = vOffset[n]; l < vOffset[n + 1]; l++) {
+							if (l == k) continue;
+							const float *msg_in = pMsgF2V + vNodeSlots[l] * K;
+							for (byte s = 0; s < nStates; s++) msg[s] *= msg_in[s];
+						}
+						normalize(msg);
+					} // k
+				} // n
+			});
+
+			// Factor-to-variable messages
+			float	maxResidual = 0;															// maximal L1-change of a message
+			double	sumResidual = 0;															// sum of the L1-changes of all messages
+			parallel::parallelFor(Range(0, nFactors), [&](const Range& range) {
+				float  *msg_new = CArena::getScratch<float>(3 * K);
+				float	maxRes	= 0;
+				double	sumRes	= 0;
+				for (int f = range.start; f < range.end; f++) {
+					const Factor &factor = vFactors[f];
+					const byte	  arity	 = factor.kind == FactorKind::pairwise ? 2 : 3;
+					const float	* pMsgIn[3];
+					for (byte v = 0; v < arity; v++) pMsgIn[v] = pMsgV2F + (factor.slot + v) * K;
+					calculateMessages(factor, pMsgIn, msg_new, nStates, maxSum);
+
+					for (byte v = 0; v < arity; v++) {
+						float *src = msg_new + v * K;
+						float *msg = pMsgF2V + (factor.slot + v) * K;
+						normalize(src);
+						float res = 0;
+						for (byte s = 0; s < nStates; s++) res += fabs(src[s] - msg[s]);
+						memcpy(msg, src, K * sizeof(float));
+						if (maxRes < res) maxRes = res;
+						sumRes += res;
+					} // v
+				} // f
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					if (maxResidual < maxRes) maxResidual = maxRes;
+					sumResidual += sumRes;
+				}
+			});
+
+			float residual = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(1, nSlots));
+			if (isConverged(i, residual, nSlots)) break;
+		} // iterations
+
+		// =================================== Calculating beliefs ===================================
+		Mat beliefs(static_cast<int>(nNodes), nStates, CV_32FC1);
+		parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range& range) {
+			for (int n = range.start; n < range.end; n++) {
+				float *pot = beliefs.ptr<float>(n);
+				memcpy(pot, nodePots.ptr<float>(n), K * sizeof(float));
+				for (size_t k = vOffset[n]; k < vOffset[n + 1]; k++) {
+					const float *msg = pMsgF2V + vNodeSlots[k] * K;
+					for (byte s = 0; s < nStates; s++) pot[s] *= msg[s];
+				}
+				float SUM_pot = 0;
+				for (byte s = 0; s < nStates; s++) SUM_pot += pot[s];
+				if (SUM_pot > 0) for (byte s = 0; s < nStates; s++) pot[s] /= SUM_pot;
+			} // n
+		});
+		if (getOutput()) beliefs.copyTo(*getOutput());
+		else m_graph3.setNodes(0, beliefs);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// All the messages of the factor are computed in one pass over its potential: the inner loops run over the last index of the table
+	void CInferLBP3::calculateMessages(const Factor &factor, const float * const *pMsgIn, float *pMsgOut, byte nStates, bool maxSum)
+	{
+		const size_t K = nStates;
+		const float *m0 = pMsgIn[0];
+		const float *m1 = pMsgIn[1];
+		float		*o0 = pMsgOut;
+		float		*o1 = pMsgOut + K;
+
+		switch (factor.kind) {
+			case FactorKind::pairwise:				// o0(x) = sum_y pot(x, y) m1(y);  o1(y) = sum_x pot(x, y) m0(x)
+				std::fill(o1, o1 + K, 0.0f);
+				for (byte x = 0; x < nStates; x++) {
+					const float *row = factor.pot + x * K;
+					float r = 0;
+					if (maxSum) {
+						for (byte y = 0; y < nStates; y++) r = MAX(r, row[y] * m1[y]);
+						for (byte y = 0; y < nStates; y++) o1[y] = MAX(o1[y], row[y] * m0[x]);
+					}
+					else {
+						for (byte y = 0; y < nStates; y++) r += row[y] * m1[y];
+						for (byte y = 0; y < nStates; y++) o1[y] += row[y] * m0[x];
+					}
+					o0[x] = r;
+				} // x
+				break;
+
+			case FactorKind::triplet: {				// o0(a) = sum_b (sum_c pot(a, b, c) m2(c)) m1(b);  o1(b) = sum_a (sum_c pot(a, b, c) m2(c)) m0(a);  o2(c) = sum_a,b pot(a, b, c) m0(a) m1(b)
+				const float *m2 = pMsgIn[2];
+				float		*o2 = pMsgOut + 2 * K;
+				std::fill(o0, o0 + K, 0.0f);
+				std::fill(o1, o1 + K, 0.0f);
+				std::fill(o2, o2 + K, 0.0f);
+				for (byte a = 0; a < nStates; a++)
+					for (byte b = 0; b < nStates; b++) {
+						const float *row = factor.pot + (a * K + b) * K;
+						const float  w	 = m0[a] * m1[b];
+						float r = 0;
+						if (maxSum) {
+							for (byte c = 0; c < nStates; c++) r = MAX(r, row[c] * m2[c]);
+							for (byte c = 0; c < nStates; c++) o2[c] = MAX(o2[c], row[c] * w);
+							o0[a] = MAX(o0[a], r * m1[b]);
+							o1[b] = MAX(o1[b], r * m0[a]);
+						}
+						else {
+							for (byte c = 0; c < nStates; c++) r += row[c] * m2[c];
+							for (byte c = 0; c < nStates; c++) o2[c] += row[c] * w;
+							o0[a] += r * m1[b];
+							o1[b] += r * m0[a];
+						}
+					} // b
+				break;
+			}
+
+			case FactorKind::potts: {				// pot(a, b, c) = same if a == b == c and diff otherwise
+				const float same = factor.pot[0];
+				const float diff = factor.pot[1];
+				for (byte v = 0; v < 3; v++) {
+					const float *p = pMsgIn[(v + 1) % 3];
+					const float *q = pMsgIn[(v + 2) % 3];
+					float		*o = pMsgOut + v * K;
+					if (maxSum) {
+						// the maximum of p(b) q(c) over all (b, c) except (s, s) needs the two largest values of p and q
+						float pMax = 0, pMax2 = 0, qMax = 0, qMax2 = 0;
+						byte  pArg = 0, qArg = 0;
+						for (byte s = 0; s < nStates; s++) {
+							if (p[s] > pMax) { pMax2 = pMax; pMax = p[s]; pArg = s; }
+							else if (p[s] > pMax2) pMax2 = p[s];
+							if (q[s] > qMax) { qMax2 = qMax; qMax = q[s]; qArg = s; }
+							else if (q[s] > qMax2) qMax2 = q[s];
+						}
+						for (byte s = 0; s < nStates; s++) {
+							const float other = (s == pArg && s == qArg) ? MAX(pMax2 * qMax, pMax * qMax2) : pMax * qMax;
+							o[s] = MAX(same * p[s] * q[s], diff * other);
+						}
+					}
+					else {
+						float pSum = 0, qSum = 0;
+						for (byte s = 0; s < nStates; s++) { pSum += p[s]; qSum += q[s]; }
+						for (byte s = 0; s < nStates; s++) o[s] = diff * pSum * qSum + (same - diff) * p[s] * q[s];
+					}
+				} // v
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+// Loopy Belief Propagation inference class interface for the triplet graphs
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "Infer.h"
+#include "Graph3.h"
+
+namespace DirectGraphicalModels
+{
+	// ============= Loopy Belief Propagation Infer Class for Triplet Graphs ============
+	/**
+	* @ingroup moduleDecode
+	* @brief Loopy Belief Propagation inference class for the graphs with triplets
+	* @details This class runs the loopy belief propagation on the factor graph of a @ref CGraph3: every node potential is a unary factor, every directed edge
+	* \f$(i)\rightarrow(j)\f$ is a pairwise factor with the potential \f$\psi_{ij}(x_i, x_j) = \f$ \a Pot.at<float>(x_i, x_j) (both edges of an arc form one factor), and every triplet is a factor of the third
+	* order, which potential is given either as the full table or as the parametric Potts potential (Ref. @ref CGraph3::setTripletPotts()).
+	* The messages are updated with the synchronous schedule: first all the variable-to-factor messages, and then all the factor-to-variable messages,
+	* both in parallel. The factor-to-variable messages of a factor are computed together in one pass over its potential table with contiguous inner loops;
+	* the messages of the Potts triplets take only \f$O(nStates)\f$ operations. The tables, shared between the triplets (Ref. @ref CGraph3::setTriplets()), are not copied.
+	* > The triplets without potential and the edges without potential are ignored.
+	* @note On the factor graphs without loops \a e.g. a single triplet with the attached chains, the inference is exact
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferLBP3 : public CInfer
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		* @param maxSum Flag indicating whether the max-product (\a true) or the sum-product (\a false) messages should be used
+		*/
+		DllExport CInferLBP3(CGraph3 &graph, bool maxSum = false) : CInfer(graph), m_graph3(graph), m_maxSum(maxSum) {}
+		DllExport virtual ~CInferLBP3(void) = default;
+
+		DllExport virtual void	infer(unsigned int nIt = 1);
+
+
+	private:
+		/// The kind of the factor potential
+		enum class FactorKind : byte {
+			pairwise,		///< Pairwise table: nStates x nStates
+			triplet,		///< Triplet table: nStates x nStates x nStates
+			potts			///< Triplet Potts potential: the values for the equal states and for the other configurations
+		};
+
+		/// Factor of the factor graph
+		struct Factor {
+			FactorKind	  kind;				///< The kind of the potential
+			const float	* pot;				///< The potential data
+			size_t		  slot;				///< The index of the first variable slot of the factor; the slots of one factor are consecutive
+		};
+
+		static void	calculateMessages(const Factor &factor, const float * const *pMsgIn, float *pMsgOut, byte nStates, bool maxSum);
+
+
+	private:
+		CGraph3	& m_graph3;			///< The graph
+		bool	  m_maxSum;			///< Flag indicating weather the max-product messages should be used
+	};
+}
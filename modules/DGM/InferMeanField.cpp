@@ -0,0 +1,141 @@
+#include "InferMeanField.h"
+#include "Arena.h"
+#include "simd.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <map>
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	void CInferMeanField::infer(unsigned int nIt)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+
+		// ====================================== Initialization ======================================
+		resetConvergence();
+		createView();
+		createLogPotentials();
+
+		m_vQ.resize(nNodes * nStates);
+		m_vQTemp.resize(nNodes * nStates);
+		for (size_t n = 0; n < nNodes; n++) {
+			const float *pot = getNodePot(n);
+			float		*q	 = &m_vQ[n * nStates];
+			float		 sum = 0;
+			for (byte s = 0; s < nStates; s++) sum += pot[s];
+			for (byte s = 0; s < nStates; s++) q[s] = sum > 0 ? pot[s] / sum : 1.0f / nStates;
+		}
+
+		// ======================================== Main loop ========================================
+		for (unsigned int i = 0; i < nIt; i++) {									// iterations
+			DGM_PROFILE_ZONE("Mean-field iteration");
+			const float residual = update();
+			m_vQ.swap(m_vQTemp);
+			if (isConverged(i, residual, nNodes)) break;
+		} // iterations
+
+		// ==================================== Storing the result ====================================
+		for (size_t n = 0; n < nNodes; n++)
+			std::copy(&m_vQ[n * nStates], &m_vQ[n * nStates] + nStates, getNodePot(n));
+
+		deleteMessages();
+	}
+
+	size_t CInferMeanField::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing)
+			+ footprint::getBytes(m_vQ) + footprint::getBytes(m_vQTemp) + footprint::getBytes(m_vLogPot) + footprint::getBytes(m_vEdgeLogPot);
+	}
+
+	void CInferMeanField::setDamping(float damping)
+	{
+		DGM_ASSERT_MSG(damping >= 0.0f && damping < 1.0f, "The damping factor %f is out of range [0; 1)", damping);
+		m_damping = damping;
+	}
+
+	Mat CInferMeanField::getCurrentBeliefs(void)
+	{
+		return Mat(static_cast<int>(getGraph().getNumNodes()), getGraph().getNumStates(), CV_32FC1, m_vQ.data());
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferMeanField::createLogPotentials(void)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nSlots	= getNumEdgeSlots();
+		const size_t	NONE	= static_cast<size_t>(-1);
+
+		std::map<const void *, size_t> mTable;
+		m_vLogPot.clear();
+		m_vEdgeLogPot.assign(nSlots, NONE);
+		for (size_t e = 0; e < nSlots; e++) {
+			if (!getEdgePot(e)) continue;
+			const void *key = isEdgePotPotts(e) ? static_cast<const void *>(&getEdgePotModel(e)) : getEdgePot(e);	// the shared potentials share one table
+			auto it = mTable.emplace(key, mTable.size());
+			if (it.second) {
+				const size_t offset = m_vLogPot.size();
+				m_vLogPot.resize(offset + 2 * nStates * nStates);
+				float *L  = &m_vLogPot[offset];
+				float *LT = L + nStates * nStates;
+				for (byte x = 0; x < nStates; x++)
+					for (byte y = 0; y < nStates; y++)
+						L[x * nStates + y] = LT[y * nStates + x] = logf(MAX(FLT_MIN, getEdgePotValue(e, x, y)));
+			}
+			m_vEdgeLogPot[e] = it.first->second;
+		} // e
+	}
+
+	float CInferMeanField::update(void)
+	{
+		const byte		nStates		= getGraph().getNumStates();
+		const int		nNodes		= static_cast<int>(getGraph().getNumNodes());
+		const size_t	tableSize	= 2 * nStates * nStates;
+		float			maxResidual	= 0;											// maximal L1-change of a distribution
+		double			sumResidual	= 0;											// sum of the L1-changes of all distributions
+		std::mutex		mtx;
+
+		parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+			float	*acc	= CArena::getScratch<float>(nStates);
+			float	*temp	= CArena::getScratch<float>(nStates, 1);
+			float	 maxRes	= 0;
+			double	 sumRes	= 0;
+			for (int n = range.start; n < range.end; n++) {
+				const float *pot = getNodePot(n);
+				for (byte s = 0; s < nStates; s++) acc[s] = logf(MAX(FLT_MIN, pot[s]));
+
+				// acc += L^T x Q_m for the incoming edges and L x Q_m for the outgoing edges
+				for (int dir = 0; dir < 2; dir++)
+					for (size_t e : dir ? getOutEdges(n) : getInEdges(n)) {
+						if (!getEdgePot(e)) continue;
+						const size_t m = dir ? getEdgeDst(e) : getEdgeSrc(e);
+						const float *L = &m_vLogPot[m_vEdgeLogPot[e] * tableSize + dir * nStates * nStates];
+						simd::matTVecMul(L, &m_vQ[m * nStates], temp, nStates);
+						simd::axpy(1.0f, temp, acc, nStates);
+					} // e
+
+				simd::expVec(acc, acc, nStates, *std::max_element(acc, acc + nStates));
+				float sum = 0;
+				for (byte s = 0; s < nStates; s++) sum += acc[s];							// sum >= 1
+
+				const float *q_old = &m_vQ[n * nStates];
+				float		*q_new = &m_vQTemp[n * nStates];
+				float		 res   = 0;
+				for (byte s = 0; s < nStates; s++) {
+					q_new[s] = (1 - m_damping) * acc[s] / sum + m_damping * q_old[s];
+					res += fabs(q_new[s] - q_old[s]);
+				}
+				if (maxRes < res) maxRes = res;
+				sumRes += res;
+			} // n
+			std::lock_guard<std::mutex> lock(mtx);
+			if (maxResidual < maxRes) maxResidual = maxRes;
+			sumResidual += sumRes;
+		});
+
+		return getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(1, nNodes));
+	}
+}
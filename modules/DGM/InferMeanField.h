@@ -0,0 +1,74 @@
+// Mean-field inference class interface for the pairwise graphs
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Mean-Field Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Mean-field inference class for the sparse pairwise graphs
+	* @details This class approximates the marginals with the fully factorized distribution \f$Q(\vec{x}) = \prod_n Q_n(x_n)\f$, which is updated
+	* for all the nodes in parallel, from the distributions of their neighbours:
+	* \f[ Q_n(s) \propto \psi_n(s)\exp\left(\sum_{m\to n}\sum_x Q_m(x)\log\psi_{mn}(x, s) + \sum_{n\to m}\sum_y Q_m(y)\log\psi_{nm}(s, y)\right) \f]
+	* Unlike the message passing algorithms, which keep \a nEdges x \a nStates messages, it keeps only two \a nNodes x \a nStates distributions and the logarithms
+	* of the distinct edge potentials (\a e.g. one for all the edges of a grid with the default edge model), which makes it suitable for the large graphs with many states.
+	* This is the counterpart of @ref CInferDense for the pairwise graphs.
+	*
+	* The synchronous updates of the strongly coupled bipartite graphs, \a e.g. the grids, may oscillate. The damping (ref. setDamping()) averages the new
+	* and the previous distributions, what suppresses the oscillations. The residual of every iteration (ref. setConvergence()) is the change of the distributions:
+	* @code
+	* CInferMeanField inferer(graph);
+	* inferer.setDamping(0.5f);
+	* inferer.setConvergence(1e-4f);
+	* vec_byte_t solution = inferer.decode(100);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferMeanField : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		*/
+		DllExport CInferMeanField(IGraphPairwise &graph) : CMessagePassing(graph), m_damping(0.5f) {}
+		DllExport virtual ~CInferMeanField(void) = default;
+
+		/**
+		* @brief Inference with the mean-field approximation
+		* @details The distributions are initialized with the normalized node potentials
+		* @param nIt The maximal number of iterations
+		*/
+		DllExport virtual void	infer(unsigned int nIt = 1);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Sets the damping
+		* @details After every iteration the distributions are \f$Q_n = (1 - \lambda) Q_n^{new} + \lambda Q_n^{old}\f$
+		* @param damping The damping factor \f$\lambda\in[0; 1)\f$ (default: 0.5); zero value disables the damping
+		*/
+		DllExport void			setDamping(float damping);
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int) {}
+		virtual Mat				getCurrentBeliefs(void) override;
+
+
+	private:
+		// Creates the logarithms of the distinct edge potentials and their indexes for every edge
+		void	createLogPotentials(void);
+		// Updates the distributions of all the nodes from m_vQ into m_vQTemp; returns the residual
+		float	update(void);
+
+
+	private:
+		float			m_damping;			///< The damping factor
+		vec_float_t		m_vQ;				///< The current distributions: nNodes x nStates
+		vec_float_t		m_vQTemp;			///< The updated distributions: nNodes x nStates
+		vec_float_t		m_vLogPot;			///< The logarithms of the distinct edge potentials and their transposes: 2 x nStates x nStates each
+		vec_size_t		m_vEdgeLogPot;		///< Index of the logarithm of the potential of every edge, or -1
+	};
+}
@@ -0,0 +1,93 @@
+#include "InferMultiscale.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Returns the index of the direction from node (xs, ys) to node (xd, yd) in [0; 9)
+		inline size_t getDirection(int xs, int ys, int xd, int yd) { return static_cast<size_t>((ys - yd + 1) * 3 + (xs - xd + 1)); }
+	}
+
+	// Constructor
+	CInferMultiscale::CInferMultiscale(byte nStates, INFER infer, word nLevels, byte gType)
+		: m_graphKit(nStates, infer, GraphType::grid)
+		, m_graphExt(dynamic_cast<IGraphPairwise &>(m_graphKit.getGraph()), 1, gType)
+		, m_infer(dynamic_cast<CMessagePassing &>(m_graphKit.getInfer()))
+		, m_nLevels(MAX(1, nLevels))
+	{}
+
+	Mat CInferMultiscale::decode(const Mat &pots, unsigned int nIt)
+	{
+		const byte nStates = m_graphKit.getGraph().getNumStates();
+		DGM_ASSERT_MSG(pots.type() == CV_32FC(nStates), "The potentials must have type CV_32FC(%d)", nStates);
+
+		// The pyramid of the potentials
+		vec_mat_t vPots(1, pots);
+		while (vPots.size() < m_nLevels && (vPots.back().cols > 1 || vPots.back().rows > 1))
+			vPots.push_back(pool(vPots.back()));
+
+		// The messages, received by every node of the previous (coarser) level from every direction
+		const size_t nDirs = 9;
+		vec_float_t	 vMsg, vMsgCoarse;
+		vec_byte_t	 vValid, vValidCoarse;
+		int			 width = 0, widthCoarse = 0;
+
+		m_infer.setMessagesInitializer([&](size_t src, size_t dst, float *msg) {
+			if (vMsgCoarse.empty()) return;
+			const int xd = static_cast<int>(dst % width), yd = static_cast<int>(dst / width);
+			const size_t dir = getDirection(static_cast<int>(src % width), static_cast<int>(src / width), xd, yd);
+			const size_t idx = (static_cast<size_t>(yd / 2) * widthCoarse + xd / 2) * nDirs + dir;
+			if (vValidCoarse[idx]) memcpy(msg, &vMsgCoarse[idx * nStates], nStates * sizeof(float));
+		});
+		m_infer.setMessagesCollector([&](size_t src, size_t dst, float *msg) {
+			const size_t idx = dst * nDirs + getDirection(static_cast<int>(src % width), static_cast<int>(src / width), static_cast<int>(dst % width), static_cast<int>(dst / width));
+			memcpy(&vMsg[idx * nStates], msg, nStates * sizeof(float));
+			vValid[idx] = 1;
+		});
+
+		vec_byte_t vDecoding;
+		for (int level = static_cast<int>(vPots.size()) - 1; level >= 0; level--) {
+			width = vPots[level].cols;
+			const size_t nNodes = vPots[level].total();
+			vMsg.assign(level > 0 ? nNodes * nDirs * nStates : 0, 0.0f);
+			vValid.assign(level > 0 ? nNodes * nDirs : 0, 0);
+			if (level == 0) m_infer.setMessagesCollector(nullptr);
+
+			m_graphExt.setGraph(vPots[level]);
+			m_edges(m_graphExt, static_cast<word>(level));
+			if (level > 0) m_infer.infer(nIt);
+			else vDecoding = m_infer.decode(nIt);
+
+			vMsgCoarse.swap(vMsg);
+			vValidCoarse.swap(vValid);
+			widthCoarse = width;
+		} // level
+		m_infer.setMessagesInitializer(nullptr);
+
+		return Mat(vDecoding, true).reshape(1, pots.rows);
+	}
+
+	Mat CInferMultiscale::pool(const Mat &pots)
+	{
+		const int nStates = pots.channels();
+		Mat res = Mat((pots.rows + 1) / 2, (pots.cols + 1) / 2 * nStates, CV_32FC1, Scalar(1)).reshape(nStates);
+
+		for (int y = 0; y < pots.rows; y++) {
+			const float *pPot = pots.ptr<float>(y);
+			float		*pRes = res.ptr<float>(y / 2);
+			for (int x = 0; x < pots.cols; x++)
+				for (int s = 0; s < nStates; s++)
+					pRes[(x / 2) * nStates + s] *= pPot[x * nStates + s];
+		} // y
+
+		for (int y = 0; y < res.rows; y++) {
+			float *pRes = res.ptr<float>(y);
+			for (int x = 0; x < res.cols; x++) {
+				float *pot = pRes + x * nStates;
+				const float max = *std::max_element(pot, pot + nStates);
+				if (max > 0) for (int s = 0; s < nStates; s++) pot[s] /= max;
+			} // x
+		} // y
+		return res;
+	}
+}
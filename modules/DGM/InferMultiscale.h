@@ -0,0 +1,83 @@
+// Coarse-to-fine multiscale inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphPairwiseKit.h"
+#include "GraphLayeredExt.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Multiscale Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Coarse-to-fine multiscale decoding of 2D grid CRFs
+	* @details This class builds a pyramid of grid graphs: at every coarser level a node pools the potentials of a 2 x 2 block of the finer nodes,
+	* \a i.e. the pooled potential is the normalized product of the block potentials. The inference starts at the coarsest level, where the long-range
+	* information propagates within a few iterations, and every finer level starts from the messages of the coarser one: the message, which a fine node
+	* receives from a direction, is initialized with the message, which the corresponding coarse node has received from the same direction
+	* (after <a href="https://cs.brown.edu/people/pfelzens/papers/bp-long.pdf" target="_blank">Felzenszwalb and Huttenlocher</a>). Thus, together with
+	* the convergence criterion (ref. CInfer::setConvergence()) the fine levels need only a few iterations.
+	*
+	* The message-passing inference algorithms (ref. @ref CMessagePassing) are supported.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferMultiscale
+	{
+	public:
+		/**
+		* @brief Callback function filling the edges of the level graph
+		* @details The arguments are the graph extension of the level graph and the level: 0 for the finest (original) level
+		*/
+		using edges_function_t = std::function<void(CGraphLayeredExt &, word)>;
+
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param infer The message-passing inference algorithm
+		* @param nLevels Number of the pyramid levels, including the original level
+		* @param gType Graph type (Ref. @ref graphEdgesType)
+		*/
+		DllExport CInferMultiscale(byte nStates, INFER infer = INFER::LBP, word nLevels = 3, byte gType = GRAPH_EDGES_GRID);
+		DllExport ~CInferMultiscale(void) = default;
+
+		/**
+		* @brief Sets the edge model of the level graphs
+		* @details By default every level graph uses CGraphLayeredExt::addDefaultEdgesModel() with the value, given in setDefaultEdgesModel() [100]
+		* @param edges The callback function, which fills the edges of a level graph
+		*/
+		DllExport void	setEdgesModel(edges_function_t edges) { m_edges = edges; }
+		/**
+		* @brief Sets the default data-independent edge model of the level graphs
+		* @param val Value, specifying the smoothness strength (ref. CGraphLayeredExt::addDefaultEdgesModel())
+		* @param weight The weighting parameter
+		*/
+		DllExport void	setDefaultEdgesModel(float val, float weight = 1.0f) { m_edges = [val, weight](CGraphLayeredExt &graphExt, word) { graphExt.addDefaultEdgesModel(val, weight); }; }
+		/**
+		* @brief Returns the inference object
+		* @details Allows for setting the parameters of the inference, \a e.g. the convergence criterion (ref. CInfer::setConvergence()), used on all the levels
+		* @return The message-passing inference object
+		*/
+		DllExport CMessagePassing & getInfer(void) { return m_infer; }
+		/**
+		* @brief Decodes the image coarse to fine
+		* @param pots The node potentials of the image: Mat(type: CV_32FC(nStates))
+		* @param nIt Number of iterations of the inference at every level
+		* @return The labels: Mat(size: pots.size(); type: CV_8UC1)
+		*/
+		DllExport Mat	decode(const Mat &pots, unsigned int nIt = 10);
+		/**
+		* @brief Pools the node potentials
+		* @param pots The node potentials: Mat(size: \a width x \a height; type: CV_32FC(nStates))
+		* @return The pooled potentials: Mat(size: \a (width + 1) / 2 x \a (height + 1) / 2; type: CV_32FC(nStates)), normalized to the maximal value of 1
+		*/
+		DllExport static Mat	pool(const Mat &pots);
+
+
+	private:
+		CGraphPairwiseKit	m_graphKit;
+		CGraphLayeredExt	m_graphExt;
+		CMessagePassing	  & m_infer;
+		word				m_nLevels;
+		edges_function_t	m_edges = [](CGraphLayeredExt &graphExt, word) { graphExt.addDefaultEdgesModel(100.0f); };
+	};
+}
@@ -0,0 +1,110 @@
+#include "InferPartitioned.h"
+#include "Arena.h"
+#include "ThreadPool.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	size_t CInferPartitioned::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing) + footprint::getBytes(m_vPartition);
+	}
+
+	void CInferPartitioned::setExchangePeriod(unsigned int nIt)
+	{
+		DGM_ASSERT_MSG(nIt > 0, "The exchange period must be positive");
+		m_exchangePeriod = nIt;
+	}
+
+	vec_size_t CInferPartitioned::getGridPartition(Size graphSize, Size blockSize)
+	{
+		DGM_ASSERT_MSG(blockSize.width > 0 && blockSize.height > 0, "The block size %d x %d must be positive", blockSize.width, blockSize.height);
+		const int	nBlocksX = (graphSize.width + blockSize.width - 1) / blockSize.width;
+		vec_size_t	res(graphSize.area());
+		for (int y = 0; y < graphSize.height; y++)
+			for (int x = 0; x < graphSize.width; x++)
+				res[y * graphSize.width + x] = (y / blockSize.height) * nBlocksX + x / blockSize.width;
+		return res;
+	}
+
+	// Each partition is swept by one thread: the edges inside the partition are updated in place, the cut edges are written into the temp container
+	void CInferPartitioned::calculateMessages(unsigned int nIt)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+
+		// ====================================== Partitioning =======================================
+		vec_size_t vPartition = m_vPartition;
+		if (vPartition.empty()) {
+			const size_t nParts = MAX(size_t(1), MIN(nNodes, CThreadPool::getDefault().getNumThreads()));
+			vPartition.resize(nNodes);
+			for (size_t n = 0; n < nNodes; n++) vPartition[n] = n * nParts / nNodes;
+		}
+		DGM_ASSERT_MSG(vPartition.size() == nNodes, "The size of the partition (%zu) does not correspond to the number of nodes (%zu)", vPartition.size(), nNodes);
+		const size_t nParts = nNodes ? *std::max_element(vPartition.begin(), vPartition.end()) + 1 : 0;
+
+		std::vector<vec_size_t>	vNodes(nParts);											// the boundary nodes followed by the interior nodes of every partition
+		std::vector<vec_size_t>	vInterior(nParts);
+		vec_size_t				vCutEdges;
+		size_t					nMessages = 0;
+		for (size_t n = 0; n < nNodes; n++) {
+			bool boundary = false;
+			for (size_t e_t : getOutEdges(n)) {
+				nMessages++;
+				if (getEdgePot(e_t) && vPartition[getEdgeDst(e_t)] != vPartition[n]) {
+					vCutEdges.push_back(e_t);
+					boundary = true;
+				}
+			} // e_t
+			(boundary ? vNodes : vInterior)[vPartition[n]].push_back(n);
+		} // n
+		for (size_t p = 0; p < nParts; p++) vNodes[p].insert(vNodes[p].end(), vInterior[p].begin(), vInterior[p].end());
+		m_nCutEdges = vCutEdges.size();
+
+		float		maxResidual = 0;													// maximal L1-change of a message
+		double		sumResidual = 0;													// sum of the L1-changes of all messages
+		std::mutex	mtx;
+
+		// ======================== Main loop (iterative messages calculation) ========================
+		for (unsigned int i = 0; i < nIt; i++) {								// iterations
+			DGM_PROFILE_ZONE("Partitioned LBP iteration");
+			maxResidual = 0;
+			sumResidual = 0;
+			parallel::parallelFor(Range(0, static_cast<int>(nParts)), [&](const Range &range) {
+				float  *temp	= CArena::getScratch<float>(nStates);
+				float	msg_old[256];
+				float	maxRes	= 0;
+				double	sumRes	= 0;
+				for (int p = range.start; p < range.end; p++)
+					for (size_t n : vNodes[p])
+						for (size_t e_t : getOutEdges(n)) {						// outgoing edges
+							float *msg_new = vPartition[getEdgeDst(e_t)] == static_cast<size_t>(p) ? getMessage(e_t) : getMessageTemp(e_t);
+							memcpy(msg_old, msg_new, nStates * sizeof(float));
+							calculateMessage(e_t, temp, msg_new);
+
+							float res = 0;
+							for (byte s = 0; s < nStates; s++) res += fabs(msg_new[s] - msg_old[s]);
+							if (maxRes < res) maxRes = res;
+							sumRes += res;
+						} // e_t
+				std::lock_guard<std::mutex> lock(mtx);
+				if (maxResidual < maxRes) maxResidual = maxRes;
+				sumResidual += sumRes;
+			}, 1);
+
+			const float residual  = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(size_t(1), nMessages));
+			const bool	converged = isConverged(i, residual, nMessages);
+			if (converged || (i + 1) % m_exchangePeriod == 0 || i + 1 == nIt) {
+				DGM_PROFILE_ZONE("Halo exchange");
+				parallel::parallelFor(Range(0, static_cast<int>(vCutEdges.size())), [&](const Range &range) {
+					for (int c = range.start; c < range.end; c++)
+						memcpy(getMessage(vCutEdges[c]), getMessageTemp(vCutEdges[c]), nStates * sizeof(float));
+				});
+			}
+			if (converged) break;
+		} // iterations
+	}
+}
@@ -0,0 +1,78 @@
+// Partitioned Loopy Belief Propagation inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Partitioned Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Partitioned sum product Loopy Belief Propagation inference class
+	* @details This class splits the graph into partitions, \a e.g. the blocks of a grid (ref. getGridPartition()), which are processed independently, as
+	* by the ranks of a distributed system: every partition updates the messages of its own edges in place with the Gauss-Seidel schedule, while the messages
+	* of the cut edges, \a i.e. the edges between two partitions, play the role of the halo. A partition writes its outgoing cut messages into the send buffer
+	* (the temp message container) and reads the incoming ones from the received halo, which is exchanged only every few local iterations (ref. setExchangePeriod()).
+	* Within an iteration the boundary nodes of every partition, \a i.e. the sources of the cut edges, are processed first, so that their halo messages
+	* are ready for the transfer, while the interior nodes are processed.
+	*
+	* The partitions are processed in parallel, one partition per thread, so that a thread works on a compact part of the graph and touches no memory of the
+	* other partitions between the exchanges. The partitions should be compact and numerous enough to keep all the threads busy:
+	* @code
+	* CInferPartitioned inferer(graph);
+	* inferer.setPartition(CInferPartitioned::getGridPartition(imgSize, Size(256, 256)));
+	* inferer.setExchangePeriod(4);
+	* vec_byte_t solution = inferer.decode(100);
+	* @endcode
+	* With the exchange after every iteration the messages converge to the same fixed point as with @ref CInferLBP.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferPartitioned : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		*/
+		DllExport CInferPartitioned(IGraphPairwise &graph) : CMessagePassing(graph), m_exchangePeriod(4), m_nCutEdges(0) {}
+		DllExport virtual ~CInferPartitioned(void) = default;
+
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Sets the partition of the graph
+		* @details If not set, the nodes are split into one contiguous range per thread
+		* @param vPartition The index of the partition of every node
+		*/
+		DllExport void			setPartition(const vec_size_t &vPartition) { m_vPartition = vPartition; }
+		/**
+		* @brief Sets the number of local iterations between the halo exchanges
+		* @param nIt The number of iterations (default: 4)
+		*/
+		DllExport void			setExchangePeriod(unsigned int nIt);
+		/**
+		* @brief Returns the number of the cut edges
+		* @return The number of the edges between different partitions in the last call of infer(), \a i.e. the size of the halo in messages
+		*/
+		DllExport size_t		getNumCutEdges(void) const { return m_nCutEdges; }
+		/**
+		* @brief Returns the partition of a grid into the blocks
+		* @details The node \f$(x, y)\f$ of the grid must have the index \f$y \cdot width + x\f$, as in the graphs, built with @ref CGraphPairwiseExt
+		* on the @ref CGraphLayeredExt with one layer. The blocks are numbered in the row-major order.
+		* @param graphSize The size of the grid
+		* @param blockSize The size of the blocks
+		* @return The index of the block of every node
+		*/
+		DllExport static vec_size_t getGridPartition(Size graphSize, Size blockSize);
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int nIt);
+
+
+	private:
+		unsigned int			m_exchangePeriod;	///< The number of local iterations between the halo exchanges
+		size_t					m_nCutEdges;		///< The number of the cut edges
+		vec_size_t				m_vPartition;		///< The index of the partition of every node
+	};
+}
@@ -0,0 +1,89 @@
+#include "InferPerturbMAP.h"
+#include "GraphPairwise.h"
+#include "ThreadPool.h"
+#include "random.h"
+#include "parallel.h"
+#include "macroses.h"
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	CInferPerturbMAP::CInferPerturbMAP(IGraphPairwise &graph, INFER infer, size_t nSolvers) 
+		: m_graph(graph)
+		, m_infer(infer)
+		, m_nSolvers(nSolvers ? nSolvers : CThreadPool::getDefault().getNumThreads())
+	{}
+
+	Mat CInferPerturbMAP::sample(size_t nSamples, unsigned int nIt, float scale)
+	{
+		DGM_ASSERT_MSG(scale >= 0, "The scale %f of the noise must be non-negative", scale);
+		const byte	nStates	= m_graph.getNumStates();
+		const int	nNodes	= static_cast<int>(m_graph.getNumNodes());
+		Mat res(nNodes, nStates, CV_32FC1, Scalar(0));
+		if (nSamples == 0 || nNodes == 0) return res;
+
+		// The logarithms of the unaries are shared by all the samples
+		Mat logPot;
+		m_graph.getNodes(0, 0, logPot);
+		logPot = max(logPot, FLT_MIN);
+		log(logPot, logPot);
+
+		const size_t nSolvers = MIN(m_nSolvers, nSamples);
+		while (m_vpSolvers.size() < nSolvers) {
+			auto pSolver = std::make_unique<Solver>();
+			pSolver->pInfer = CGraphPairwiseKit::createInfer(m_infer, m_graph);
+			pSolver->pInfer->setInput(&pSolver->input);
+			if (m_configure) m_configure(*pSolver->pInfer);
+			pSolver->pInfer->setWarmStart(false);										// every sample starts from the uniform messages, whichever solver draws it
+			m_vpSolvers.push_back(std::move(pSolver));
+		}
+
+		vec_size_t	vFree(nSolvers);
+		std::mutex	mtx;
+		for (size_t k = 0; k < nSolvers; k++) {
+			vFree[k] = k;
+			m_vpSolvers[k]->input.create(nNodes, nStates, CV_32FC1);
+			m_vpSolvers[k]->counts.create(nNodes, nStates, CV_32SC1);
+			m_vpSolvers[k]->counts.setTo(0);
+		}
+
+		// At most nSolvers chunks run concurrently, thus every chunk acquires a free solver
+		parallel::parallelFor(Range(0, static_cast<int>(nSamples)), [&](const Range &range) {
+			size_t k;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				DGM_ASSERT(!vFree.empty());
+				k = vFree.back();
+				vFree.pop_back();
+			}
+			Solver *pSolver = m_vpSolvers[k].get();
+			for (int i = range.start; i < range.end; i++) {
+				random::CPhilox generator = random::getStream(m_nDrawn + i);
+				for (int n = 0; n < nNodes; n++) {
+					const float *pLogPot	= logPot.ptr<float>(n);
+					float		*pInput		= pSolver->input.ptr<float>(n);
+					for (byte s = 0; s < nStates; s++) {
+						const float u = MAX(FLT_MIN, random::U<float>(generator));
+						pInput[s] = pLogPot[s] - scale * logf(-logf(u));						// log(pot) + scale * Gumbel
+					}
+					const float maxInput = *std::max_element(pInput, pInput + nStates);
+					for (byte s = 0; s < nStates; s++) pInput[s] = expf(pInput[s] - maxInput);
+				} // n
+
+				vec_byte_t solution = pSolver->pInfer->decode(nIt);
+				for (int n = 0; n < nNodes; n++) pSolver->counts.at<int>(n, solution[n])++;
+			} // i
+			std::lock_guard<std::mutex> lock(mtx);
+			vFree.push_back(k);
+		}, 1, nSolvers);
+		m_nDrawn += nSamples;
+
+		for (size_t k = 0; k < nSolvers; k++) {
+			Mat counts;
+			m_vpSolvers[k]->counts.convertTo(counts, CV_32FC1);
+			res += counts;
+		}
+		res /= static_cast<double>(nSamples);
+		return res;
+	}
+}
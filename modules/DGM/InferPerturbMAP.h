@@ -0,0 +1,90 @@
+// Perturb-and-MAP sampling class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphPairwiseKit.h"
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	// ============================= Perturb-and-MAP Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Perturb-and-MAP sampling over one graph
+	* @details Every sample is the most probable configuration (MAP) of the graph, whose unaries are perturbed with the Gumbel noise:
+	* \f[ \tilde{\psi}_i(s) = \psi_i(s)\cdot\exp(\sigma\gamma_{i,s}),\quad \gamma_{i,s} = -\log(-\log u_{i,s}),\quad u_{i,s}\sim U(0, 1), \f]
+	* where \f$\sigma\f$ is the scale of the noise. The frequencies of the labels over the samples estimate the uncertainty of the MAP solution.
+	*
+	* The graph is neither rebuilt, nor copied, nor compacted: the topology and the edge potentials are shared by the concurrent solvers, and every solver
+	* reads its own perturbed copy of the unaries from the input buffer (ref. CMessagePassing::setInput()). The solvers do not keep their messages between
+	* the samples (the warm start is disabled, ref. CMessagePassing::setWarmStart()), thus the solution of a sample does not depend on the solver, which
+	* has drawn it; the convergence criterion stops every solve early:
+	* @code
+	* CInferPerturbMAP sampler(graph, INFER::Viterbi);
+	* sampler.setConfiguration([](CInfer &inferer) { inferer.setConvergence(1e-3f); });
+	* Mat freq = sampler.sample(64, 100);						// Mat(size: nNodes x nStates; type: CV_32FC1)
+	* @endcode
+	* The noise of the sample \a i is drawn from the stream random::getStream() with the index \a i, counted over all the calls of sample(), thus the results
+	* do not depend on the number of threads. The graph must not be changed during sampling.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferPerturbMAP
+	{
+	public:
+		/**
+		* @brief Callback function, configuring the inferer of one solver
+		* @details Allows for setting the parameters of the inference, \a e.g. the convergence criterion (ref. CInfer::setConvergence())
+		*/
+		using configure_function_t = std::function<void(CInfer &)>;
+
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		* @param infer The inference method, \a e.g. INFER::Viterbi, INFER::TRW or INFER::GraphCut
+		* @param nSolvers The maximal number of the concurrent solvers. If zero, the number of threads of the default thread pool is used
+		*/
+		DllExport CInferPerturbMAP(IGraphPairwise &graph, INFER infer = INFER::Viterbi, size_t nSolvers = 0);
+		DllExport CInferPerturbMAP(const CInferPerturbMAP&) = delete;
+		DllExport ~CInferPerturbMAP(void) = default;
+
+		DllExport bool	operator=(const CInferPerturbMAP&) = delete;
+
+		/**
+		* @brief Sets the configuration of the inferers
+		* @param configure The callback function, which is called once for the inferer of every solver, when the solver is created
+		*/
+		DllExport void	setConfiguration(configure_function_t configure) { m_configure = configure; }
+		/**
+		* @brief Draws the samples and estimates the frequencies of the labels
+		* @details The samples are solved concurrently by up to \a nSolvers solvers; the unaries are read from the graph once per call
+		* @param nSamples The number of samples
+		* @param nIt Number of iterations of every MAP solve (ref. CInfer::decode())
+		* @param scale The scale \f$\sigma\f$ of the Gumbel noise
+		* @return The frequencies of the labels of every node: Mat(size: nNodes x nStates; type: CV_32FC1). Every row sums up to 1
+		*/
+		DllExport Mat	sample(size_t nSamples, unsigned int nIt = 10, float scale = 1.0f);
+		/**
+		* @brief Resets the solvers
+		* @details The solvers and their messages are released, \a e.g. to free the memory after sampling
+		*/
+		DllExport void	reset(void) { m_vpSolvers.clear(); }
+
+
+	private:
+		/// The solver of the perturbed problems
+		struct Solver {
+			std::unique_ptr<CMessagePassing>	pInfer;		///< The inferer
+			Mat									input;		///< The perturbed unaries: Mat(size: nNodes x nStates; type: CV_32FC1)
+			Mat									counts;		///< The numbers of the samples with every label of every node: Mat(size: nNodes x nStates; type: CV_32SC1)
+		};
+
+
+	private:
+		IGraphPairwise		  & m_graph;
+		INFER					m_infer;
+		size_t					m_nSolvers;
+		configure_function_t	m_configure;
+		std::vector<std::unique_ptr<Solver>>	m_vpSolvers;	///< The solvers: their input buffers are referenced by the inferers
+		uint64_t				m_nDrawn = 0;	///< The number of samples, drawn by all the calls of sample()
+	};
+}
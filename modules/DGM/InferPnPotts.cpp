@@ -0,0 +1,194 @@
+#include "InferPnPotts.h"
+#include "Arena.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <mutex>
+
+namespace DirectGraphicalModels
+{
+	size_t CInferPnPotts::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing)
+			+ footprint::getBytes(m_vCliqueNodes) + footprint::getBytes(m_vCliqueOffset) + footprint::getBytes(m_vGamma) + footprint::getBytes(m_vQ)
+			+ footprint::getBytes(m_vCliqueMsg) + footprint::getBytes(m_vPot);
+	}
+
+	void CInferPnPotts::addClique(const vec_size_t &vNodes, float gamma, float Q)
+	{
+		DGM_ASSERT_MSG(!vNodes.empty(), "The clique is empty");
+		DGM_ASSERT_MSG(gamma >= 0, "The maximal cost %f of the clique must be non-negative", gamma);
+		m_vCliqueNodes.insert(m_vCliqueNodes.end(), vNodes.begin(), vNodes.end());
+		m_vCliqueOffset.push_back(m_vCliqueNodes.size());
+		m_vGamma.push_back(gamma);
+		m_vQ.push_back(MAX(1.0f, Q));
+	}
+
+	void CInferPnPotts::addCliques(const Mat &labels, float gamma, float ratio)
+	{
+		DGM_ASSERT(labels.type() == CV_32SC1);
+		std::vector<vec_size_t> vRegions;
+		for (int y = 0; y < labels.rows; y++) {
+			const int *pLabels = labels.ptr<int>(y);
+			for (int x = 0; x < labels.cols; x++) {
+				if (pLabels[x] < 0) continue;
+				if (static_cast<size_t>(pLabels[x]) >= vRegions.size()) vRegions.resize(pLabels[x] + 1);
+				vRegions[pLabels[x]].push_back(static_cast<size_t>(y) * labels.cols + x);
+			} // x
+		} // y
+		for (const vec_size_t &vNodes : vRegions)
+			if (vNodes.size() > 1) addClique(vNodes, gamma, ratio * vNodes.size());
+	}
+
+	void CInferPnPotts::clearCliques(void)
+	{
+		m_vCliqueNodes.clear();
+		m_vCliqueOffset.assign(1, 0);
+		m_vGamma.clear();
+		m_vQ.clear();
+	}
+
+	// The pairwise messages are followed by the clique messages, which are multiplied into the node potentials
+	void CInferPnPotts::calculateMessages(unsigned int nIt)
+	{
+		DGM_ASSERT_MSG(!isLogDomain(), "The logarithmic domain is not supported by the Pn-Potts inference");
+		const byte		nStates		= getGraph().getNumStates();
+		const int		nNodes		= static_cast<int>(getGraph().getNumNodes());
+		const int		nCliques	= static_cast<int>(getNumCliques());
+		const size_t	nSlots		= m_vCliqueNodes.size();
+		const size_t	nMessages	= getGraph().getNumEdges() + nSlots;
+		for (size_t n : m_vCliqueNodes) DGM_ASSERT_MSG(n < static_cast<size_t>(nNodes), "The clique node %zu is out of range [0; %d)", n, nNodes);
+
+		m_vPot.resize(static_cast<size_t>(nNodes) * nStates);
+		for (int n = 0; n < nNodes; n++) memcpy(&m_vPot[n * nStates], getNodePot(n), nStates * sizeof(float));
+		m_vCliqueMsg.assign(nSlots * nStates, 0.0f);
+
+		// The clique slots of every node
+		vec_size_t vNodeOffset(nNodes + 1, 0);
+		vec_size_t vNodeSlots(nSlots);
+		for (size_t n : m_vCliqueNodes) vNodeOffset[n + 1]++;
+		for (int n = 0; n < nNodes; n++) vNodeOffset[n + 1] += vNodeOffset[n];
+		vec_size_t vPos(vNodeOffset.begin(), vNodeOffset.end() - 1);
+		for (size_t k = 0; k < nSlots; k++) vNodeSlots[vPos[m_vCliqueNodes[k]]++] = k;
+
+		vec_float_t vCost(static_cast<size_t>(nNodes) * nStates);				// the negative logarithms of the beliefs
+		float		maxResidual = 0;											// maximal L1-change of a message
+		double		sumResidual = 0;											// sum of the L1-changes of all messages
+		std::mutex	mtx;
+		auto reduce = [&](float maxRes, double sumRes) {
+			std::lock_guard<std::mutex> lock(mtx);
+			if (maxResidual < maxRes) maxResidual = maxRes;
+			sumResidual += sumRes;
+		};
+
+		// ======================== Main loop (iterative messages calculation) ========================
+		for (unsigned int i = 0; i < nIt; i++) {								// iterations
+			DGM_PROFILE_ZONE("Pn-Potts iteration");
+			maxResidual = 0;
+			sumResidual = 0;
+
+			// Pairwise messages
+			parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+				float  *temp	= CArena::getScratch<float>(nStates);
+				float	maxRes	= 0;
+				double	sumRes	= 0;
+				for (int n = range.start; n < range.end; n++)
+					for (size_t e_t : getOutEdges(n)) {								// outgoing edges
+						float		*msg_new = getMessageTemp(e_t);
+						const float *msg	 = getMessage(e_t);
+						calculateMessage(e_t, temp, msg_new, true);
+
+						float res = 0;
+						for (byte s = 0; s < nStates; s++) res += fabs(msg_new[s] - msg[s]);
+						if (maxRes < res) maxRes = res;
+						sumRes += res;
+					} // e_t
+				reduce(maxRes, sumRes);
+			});
+			swapMessages();
+
+			// Clique messages
+			parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+				for (int n = range.start; n < range.end; n++) {
+					if (vNodeOffset[n] == vNodeOffset[n + 1]) continue;
+					float *cost = &vCost[n * nStates];
+					calculateBelief(n, cost);
+					for (byte s = 0; s < nStates; s++) cost[s] = -logf(MAX(FLT_MIN, cost[s]));
+				} // n
+			});
+			parallel::parallelFor(Range(0, nCliques), [&](const Range &range) {
+				float  *buf		= CArena::getScratch<float>(3 * nStates);
+				float	maxRes	= 0;
+				double	sumRes	= 0;
+				for (int c = range.start; c < range.end; c++) {
+					const float res = calculateCliqueMessages(c, vCost.data(), buf);
+					if (maxRes < res) maxRes = res;
+					sumRes += res;
+				} // c
+				reduce(maxRes, sumRes);
+			});
+
+			// The node potentials with the clique messages
+			parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+				float *acc = CArena::getScratch<float>(nStates);
+				for (int n = range.start; n < range.end; n++) {
+					if (vNodeOffset[n] == vNodeOffset[n + 1]) continue;
+					std::fill(acc, acc + nStates, 0.0f);
+					for (size_t k = vNodeOffset[n]; k < vNodeOffset[n + 1]; k++) {
+						const float *msg = &m_vCliqueMsg[vNodeSlots[k] * nStates];
+						for (byte s = 0; s < nStates; s++) acc[s] += msg[s];
+					} // k
+					const float	 minAcc = *std::min_element(acc, acc + nStates);
+					const float *pot0	= &m_vPot[n * nStates];
+					float		*pot	= getNodePot(n);
+					for (byte s = 0; s < nStates; s++) pot[s] = pot0[s] * expf(minAcc - acc[s]);
+				} // n
+			});
+
+			float residual = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(size_t(1), nMessages));
+			if (isConverged(i, residual, nMessages)) break;
+		} // iterations
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// For the normalized costs c_j of the messages to the clique: M_i(s) = min(gamma, v(s), theta + min_k v(k)), where v(k) = sum_{j != i} min(c_j(k), theta)
+	float CInferPnPotts::calculateCliqueMessages(size_t clique, const float *cost, float *buf)
+	{
+		const byte	nStates	= getGraph().getNumStates();
+		const float	gamma	= m_vGamma[clique];
+		const float	theta	= gamma / m_vQ[clique];									// the cost of one inconsistent node
+		float		*c		= buf;													// the cost of the message from a node to the clique
+		float		*G		= buf + nStates;
+		float		*v		= buf + 2 * nStates;
+
+		auto getNodeCost = [&](size_t k) {
+			const float *pCost	= cost + m_vCliqueNodes[k] * nStates;
+			const float *msg	= &m_vCliqueMsg[k * nStates];
+			for (byte s = 0; s < nStates; s++) c[s] = pCost[s] - msg[s];
+			const float minC = *std::min_element(c, c + nStates);
+			for (byte s = 0; s < nStates; s++) c[s] -= minC;
+		};
+
+		std::fill(G, G + nStates, 0.0f);
+		for (size_t k = m_vCliqueOffset[clique]; k < m_vCliqueOffset[clique + 1]; k++) {
+			getNodeCost(k);
+			for (byte s = 0; s < nStates; s++) G[s] += MIN(c[s], theta);
+		} // k
+
+		float res = 0;
+		for (size_t k = m_vCliqueOffset[clique]; k < m_vCliqueOffset[clique + 1]; k++) {
+			getNodeCost(k);
+			for (byte s = 0; s < nStates; s++) v[s] = G[s] - MIN(c[s], theta);
+			const float deviating	= theta + *std::min_element(v, v + nStates);
+			float	   *msg			= &m_vCliqueMsg[k * nStates];
+			for (byte s = 0; s < nStates; s++) v[s] = MIN(gamma, MIN(v[s], deviating));
+			const float minV = *std::min_element(v, v + nStates);
+			for (byte s = 0; s < nStates; s++) {
+				res += fabs(expf(-(v[s] - minV)) - expf(-msg[s]));
+				msg[s] = v[s] - minV;
+			}
+		} // k
+		return res;
+	}
+}
@@ -0,0 +1,92 @@
+// Max-product Loopy Belief Propagation with the robust Pn-Potts clique potentials class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================= Pn-Potts Infer Class =============================
+	/**
+	* @ingroup moduleDecode
+	* @brief Max product Loopy Belief Propagation inference class with the higher-order robust \f$P^n\f$-Potts potentials
+	* @details Additionally to the pairwise edges of the graph, this class supports the cliques over arbitrary sets of nodes, \a e.g. the superpixels
+	* (ref. addCliques()), which encourage all the nodes of a clique to take the same label. Every clique is stored compactly as the list of its node indices,
+	* while enforcing the same consistency with the pairwise edges would require \a |c| x (\a |c| - 1) / 2 arcs. The clique energy is the robust \f$P^n\f$-Potts model:
+	* \f[ \psi_c(\vec{x}_c) = \min\left(\gamma, \min_k N_k(\vec{x}_c)\frac{\gamma}{Q}\right), \f]
+	* where \f$N_k(\vec{x}_c)\f$ is the number of the nodes of the clique, which do not take the label \f$k\f$, and the truncation \f$Q\f$ is the number of such nodes,
+	* at which the maximal cost \f$\gamma\f$ is paid. With \f$Q = 1\f$ it is the strict \f$P^n\f$-Potts model. The clique potential is \f$\exp(-\psi_c)\f$.
+	*
+	* The energy decomposes over the labels into the independent per-node terms, thus the factor-to-variable messages of a clique are calculated in
+	* \f$O(|c| \cdot nStates)\f$ instead of \f$O(nStates^{|c|})\f$. The pairwise messages are calculated as with @ref CInferViterbi. The cliques of one iteration
+	* are processed in parallel:
+	* @code
+	* CInferPnPotts inferer(graph);
+	* inferer.addCliques(superpixels, 5.0f, 0.1f);											// superpixels: Mat(type: CV_32SC1)
+	* vec_byte_t solution = inferer.decode(100);
+	* @endcode
+	* > The logarithmic domain (ref. setLogDomain()) and the incremental mode (ref. setIncremental()) take no account of the cliques and should not be used
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferPnPotts : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		*/
+		DllExport CInferPnPotts(IGraphPairwise &graph) : CMessagePassing(graph), m_vCliqueOffset(1, 0) {}
+		DllExport virtual ~CInferPnPotts(void) = default;
+
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Adds a clique
+		* @param vNodes The indices of the distinct nodes of the clique
+		* @param gamma The maximal cost \f$\gamma\f$ of the inconsistent labelling
+		* @param Q The truncation: the number of the inconsistent nodes, at which the maximal cost is paid. Values not exceeding 1 give the strict \f$P^n\f$-Potts model
+		*/
+		DllExport void			addClique(const vec_size_t &vNodes, float gamma, float Q = 1.0f);
+		/**
+		* @brief Adds a clique for every region of a segmentation
+		* @details The node of pixel \f$(x, y)\f$ must have the index \f$y \cdot width + x\f$, as in the graphs, built with @ref CGraphPairwiseExt or @ref CGraphLayeredExt with one layer
+		* @param labels The label image: Mat(size: image width x image height; type: CV_32SC1) with the region indices, \a e.g. the superpixels, or negative values for the excluded pixels
+		* @param gamma The maximal cost \f$\gamma\f$ of the inconsistent labelling of a region
+		* @param ratio The truncation \f$Q\f$ of every region as a fraction of the region size
+		*/
+		DllExport void			addCliques(const Mat &labels, float gamma, float ratio);
+		/**
+		* @brief Removes all the cliques
+		*/
+		DllExport void			clearCliques(void);
+		/**
+		* @brief Returns the number of cliques
+		* @return The number of cliques
+		*/
+		DllExport size_t		getNumCliques(void) const { return m_vGamma.size(); }
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int nIt);
+		bool					isMaxSum(void) const override { return true; }
+
+
+	private:
+		/**
+		* @brief Calculates the messages from one clique to its nodes
+		* @param clique The index of the clique
+		* @param cost The costs of the beliefs of all the nodes: \a nNodes x \a nStates negative logarithms
+		* @param buf Auxilary array of 3 x \a nStates values
+		* @return The L1-change of the messages
+		*/
+		float					calculateCliqueMessages(size_t clique, const float *cost, float *buf);
+
+
+	private:
+		vec_size_t				m_vCliqueNodes;		///< The nodes of all the cliques
+		vec_size_t				m_vCliqueOffset;	///< The index of the first node of every clique in m_vCliqueNodes, followed by the total number of nodes
+		vec_float_t				m_vGamma;			///< The maximal cost of every clique
+		vec_float_t				m_vQ;				///< The truncation of every clique
+		vec_float_t				m_vCliqueMsg;		///< The messages from the cliques to their nodes: the negative logarithms with the minimal value of zero
+		vec_float_t				m_vPot;				///< The node potentials without the clique messages
+	};
+}
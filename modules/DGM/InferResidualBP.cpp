@@ -0,0 +1,113 @@
+#include "InferResidualBP.h"
+#include "ThreadPool.h"
+#include "profiler.h"
+#include <mutex>
+#include <queue>
+
+namespace DirectGraphicalModels
+{
+	void CInferResidualBP::calculateMessages(unsigned int nIt)
+	{
+		const byte		nStates		= getGraph().getNumStates();				// number of states
+		const int		nNodes		= static_cast<int>(getGraph().getNumNodes());
+		const size_t	nEdges		= getGraph().getNumEdges();
+		const size_t	nQueues		= m_nQueues;
+		const size_t	maxUpdates	= static_cast<size_t>(nIt) * nEdges;
+
+		struct Queue {
+			std::mutex										mtx;
+			std::priority_queue<std::pair<float, size_t>>	pq;				// (residual, edge)
+		};
+		std::vector<Queue>		vQueues(nQueues);							// edge e is scheduled in queue e % nQueues
+		std::vector<vec_size_t>	vCommitted(nQueues);						// edges, committed by every queue in the current round
+		vec_float_t				vResidual(getNumEdgeSlots(), 0);			// residuals of the pending messages
+		vec_byte_t				vMark(getNumEdgeSlots(), 0);
+		vec_size_t				vAffected;
+
+		// Recomputes the pending message of the edge and schedules it
+		auto refresh = [&](size_t e, float *temp) {
+			float		*msg_temp	= getMessageTemp(e);
+			const float *msg		= getMessage(e);
+			calculateMessage(e, temp, msg_temp);
+			float res = 0;
+			for (byte s = 0; s < nStates; s++) res += fabs(msg_temp[s] - msg[s]);
+			vResidual[e] = res;
+			if (res > FLT_EPSILON) {
+				Queue &queue = vQueues[e % nQueues];
+				std::lock_guard<std::mutex> lock(queue.mtx);
+				queue.pq.emplace(res, e);
+			}
+		};
+
+		// Commits the largest pending messages of the queue; returns the largest committed residual
+		auto commit = [&](size_t q, size_t nMessages) {
+			Queue	&queue	= vQueues[q];
+			float	 maxRes = 0;
+			vCommitted[q].clear();
+			while (vCommitted[q].size() < nMessages && !queue.pq.empty()) {
+				auto [res, e] = queue.pq.top();
+				queue.pq.pop();
+				if (res != vResidual[e]) continue;								// outdated entry
+				memcpy(getMessage(e), getMessageTemp(e), nStates * sizeof(float));
+				vResidual[e] = 0;
+				if (maxRes < res) maxRes = res;
+				vCommitted[q].push_back(e);
+			}
+			return maxRes;
+		};
+
+		// ====================================== Initialization ======================================
+		parallel::parallelFor(Range(0, nNodes), [&, nStates](const Range& range) {
+			float *temp = CArena::getScratch<float>(nStates);
+			for (int n = range.start; n < range.end; n++)
+				for (size_t e_t : getOutEdges(n)) refresh(e_t, temp);
+		});
+
+		// ======================== Main loop (residual scheduled messages) ========================
+		float	*temp		= CArena::getScratch<float>(nStates);
+		size_t	 nUpdates	= 0;
+		while (nUpdates < maxUpdates) {
+			DGM_PROFILE_ZONE("ResidualBP batch");
+			// Committing the messages with the largest residuals
+			float maxResidual = 0;
+			if (nQueues == 1) maxResidual = commit(0, 1);
+			else {
+				vec_float_t vMaxRes(nQueues, 0);
+				parallel::parallelFor(Range(0, static_cast<int>(nQueues)), [&](const Range& range) {
+					for (int q = range.start; q < range.end; q++)
+						vMaxRes[q] = commit(q, m_batchSize);
+				});
+				maxResidual = *std::max_element(vMaxRes.begin(), vMaxRes.end());
+			}
+
+			// Collecting the messages, which depend on the committed ones
+			size_t nCommitted = 0;
+			vAffected.clear();
+			for (const vec_size_t &vEdges : vCommitted)
+				for (size_t e : vEdges) {
+					nCommitted++;
+					const size_t src = getEdgeSrc(e);
+					for (size_t e_t : getOutEdges(getEdgeDst(e)))
+						if (getEdgeDst(e_t) != src && !vMark[e_t]) {
+							vMark[e_t] = 1;
+							vAffected.push_back(e_t);
+						}
+				} // e
+			if (nCommitted == 0) break;												// all the residuals vanished
+			nUpdates += nCommitted;
+
+			// Refreshing the dependent messages
+			if (nQueues == 1)
+				for (size_t e : vAffected) refresh(e, temp);
+			else {
+				parallel::parallelFor(Range(0, static_cast<int>(vAffected.size())), [&, nStates](const Range& range) {
+					float *temp = CArena::getScratch<float>(nStates);
+					for (int i = range.start; i < range.end; i++) refresh(vAffected[i], temp);
+				});
+			}
+			for (size_t e : vAffected) vMark[e] = 0;
+
+			if (isConverged(static_cast<unsigned int>((nUpdates - 1) / MAX(1, nEdges)), maxResidual, nCommitted + vAffected.size())) break;
+		} // while
+	}
+}
@@ -0,0 +1,48 @@
+// Residual Belief Propagation inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ==================== Residual Belief Propagation Infer Class ==================
+	/**
+	* @ingroup moduleDecode
+	* @brief Sum product Residual Belief Propagation inference class
+	* @details This class implements the asynchronous belief propagation with the residual scheduling, described in the paper
+	* <a href="https://arxiv.org/abs/1206.6837" target="_blank">Residual Belief Propagation: Informed Scheduling for Asynchronous Message Passing</a>.
+	* Instead of recomputing all the messages on every sweep, like @ref CInferLBP does, the algorithm keeps a priority queue of the message residuals,
+	* \a i.e. the L1-norm of the difference between the pending and the current message, and commits only the messages, which change most.
+	* After a message is committed, only the messages, depending on it, are recomputed.
+	*
+	* With more than one queue the concurrent variant is used: the edges are distributed among the queues and every round all the queues commit
+	* their \a batchSize largest messages in parallel, followed by the parallel refresh of the dependent messages. This relaxes the strict
+	* priority order in favor of scalability across cores.
+	* > The number of iterations in infer() is measured in sweeps: the algorithm stops after \a nIt x \a nEdges message updates, when all the residuals
+	* vanish, or when the largest residual falls below the threshold, given in setConvergence().
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferResidualBP : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		* @param nQueues The number of priority queues. If 1, the messages are committed strictly in order of their residuals
+		* @param batchSize The number of messages committed by every queue in one round (used only if \b nQueues > 1)
+		*/
+		DllExport CInferResidualBP(IGraphPairwise &graph, word nQueues = 1, word batchSize = 64)
+			: CMessagePassing(graph), m_nQueues(MAX(1, nQueues)), m_batchSize(MAX(1, batchSize)) {}
+		DllExport virtual ~CInferResidualBP(void) = default;
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int nIt);
+
+
+	private:
+		word	m_nQueues;		///< The number of priority queues
+		word	m_batchSize;	///< The number of messages committed by every queue in one round
+	};
+}
@@ -0,0 +1,188 @@
+#include "InferSGM.h"
+#include "Arena.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "simd.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// The neighbours, which edges are stored per node: right, bottom, bottom-right and bottom-left
+		const int OFFSETS[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { -1, 1 } };
+		// The directions of the paths: the first 4, 8 or 16 are used
+		const int DIRECTIONS[16][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 },
+										{ 2, 1 }, { -2, -1 }, { 1, 2 }, { -1, -2 }, { -1, 2 }, { 1, -2 }, { -2, 1 }, { 2, -1 } };
+	}
+
+	// Constructor
+	CInferSGM::CInferSGM(IGraphPairwise &graph, Size size, byte nPaths) : CMessagePassing(graph), m_size(size), m_nPaths(nPaths)
+	{
+		DGM_ASSERT_MSG(nPaths == 4 || nPaths == 8 || nPaths == 16, "The number of paths (%d) must be 4, 8 or 16", nPaths);
+	}
+
+	void CInferSGM::infer(unsigned int)
+	{
+		const byte		nStates	= getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+		DGM_ASSERT_MSG(nNodes == static_cast<size_t>(m_size.area()), "The number of nodes (%zu) does not correspond to the size of the grid (%d x %d)", nNodes, m_size.width, m_size.height);
+
+		// ====================================== Initialization ======================================
+		createView();
+		m_vUnary.resize(nNodes * nStates);
+		parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range &range) {
+			for (int n = range.start; n < range.end; n++)
+				for (byte s = 0; s < nStates; s++)
+					m_vUnary[n * nStates + s] = -logf(MAX(FLT_MIN, getNodePot(n)[s]));
+		}, 1024);
+		createPenalties();
+
+		// ======================================= Aggregation =======================================
+		m_vCosts.assign(nNodes * nStates, 0.0f);
+		for (byte r = 0; r < m_nPaths; r++) {
+			DGM_PROFILE_ZONE("SGM direction");
+			aggregate(DIRECTIONS[r][0], DIRECTIONS[r][1]);
+		}
+
+		// ==================================== Storing the result ====================================
+		parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range &range) {
+			for (int n = range.start; n < range.end; n++) {
+				const float *pCost	= &m_vCosts[n * nStates];
+				float		*pot	= getNodePot(n);
+				const byte	 state	= static_cast<byte>(std::min_element(pCost, pCost + nStates) - pCost);
+				std::fill(pot, pot + nStates, 0.0f);
+				pot[state] = 1.0f;
+			} // n
+		}, 1024);
+
+		deleteMessages();
+	}
+
+	size_t CInferSGM::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing)
+			+ footprint::getBytes(m_vUnary) + footprint::getBytes(m_vCosts) + footprint::getBytes(m_vPenalties);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferSGM::createPenalties(void)
+	{
+		const byte	nStates = getGraph().getNumStates();
+		const int	width	= m_size.width;
+		const int	height	= m_size.height;
+
+		// The truncated linear energy of one arc
+		auto getArcPenalty = [&](size_t e) {
+			const EdgePotModel &model = getEdgePotModel(e);
+			Penalty res;
+			res.exists = true;
+			switch (model.kind) {
+				case EdgePotKind::potts:
+					res.tau		= model.diag > 0 ? logf(model.diag / MAX(FLT_MIN, model.trunc)) : 0;
+					res.lambda	= res.tau;
+					break;
+				case EdgePotKind::truncatedLinear:
+					res.lambda	= -logf(model.rate);
+					res.tau		= logf(model.diag / MAX(FLT_MIN, model.trunc));
+					break;
+				default: {
+					if (nStates < 2) break;
+					const float e0 = -logf(MAX(FLT_MIN, getEdgePotValue(e, 0, 0)));
+					res.lambda	= -logf(MAX(FLT_MIN, getEdgePotValue(e, 0, 1))) - e0;
+					res.tau		= -logf(MAX(FLT_MIN, getEdgePotValue(e, 0, nStates - 1))) - e0;
+				}
+			}
+			res.lambda	= MAX(0.0f, res.lambda);
+			res.tau		= MAX(0.0f, res.tau);
+			return res;
+		};
+
+		m_vPenalties.assign(4 * m_size.area(), Penalty());
+		parallel::parallelFor(Range(0, height), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++)
+				for (int x = 0; x < width; x++) {
+					const size_t p = y * width + x;
+					for (int k = 0; k < 4; k++) {
+						const int qx = x + OFFSETS[k][0];
+						const int qy = y + OFFSETS[k][1];
+						if (qx < 0 || qx >= width || qy >= height) continue;
+						const size_t q = qy * width + qx;
+						Penalty &pen = m_vPenalties[4 * p + k];
+						for (size_t e : getOutEdges(p))
+							if (getEdgeDst(e) == q && getEdgePot(e)) {
+								const Penalty arcPen = getArcPenalty(e);
+								pen = { pen.lambda + arcPen.lambda, pen.tau + arcPen.tau, true };
+							}
+						for (size_t e : getInEdges(p))
+							if (getEdgeSrc(e) == q && getEdgePot(e)) {
+								const Penalty arcPen = getArcPenalty(e);
+								pen = { pen.lambda + arcPen.lambda, pen.tau + arcPen.tau, true };
+							}
+					} // k
+				} // x
+		});
+	}
+
+	CInferSGM::Penalty CInferSGM::getPenalty(int x, int y, int dx, int dy) const
+	{
+		const int width = m_size.width;
+		for (int k = 0; k < 4; k++) {
+			if (dx == OFFSETS[k][0] && dy == OFFSETS[k][1]) {
+				const Penalty &pen = m_vPenalties[4 * (y * width + x) + k];
+				if (pen.exists || k < 2) return pen;
+			}
+			if (dx == -OFFSETS[k][0] && dy == -OFFSETS[k][1]) {
+				const Penalty &pen = m_vPenalties[4 * ((y + dy) * width + x + dx) + k];
+				if (pen.exists || k < 2) return pen;
+			}
+		} // k
+
+		// The weighted sum of the horizontal and vertical steps
+		const Penalty	penX = getPenalty(x, y, dx > 0 ? 1 : -1, 0);
+		const Penalty	penY = getPenalty(x, y, 0, dy > 0 ? 1 : -1);
+		const float		wx	 = static_cast<float>(abs(dx)) / (abs(dx) + abs(dy));
+		const float		wy	 = 1.0f - wx;
+		return { wx * penX.lambda + wy * penY.lambda, wx * penX.tau + wy * penY.tau, false };
+	}
+
+	void CInferSGM::aggregate(int dx, int dy)
+	{
+		const int	nStates = getGraph().getNumStates();
+		const int	width	= m_size.width;
+		const int	height	= m_size.height;
+		auto		isInside = [&](int x, int y) { return x >= 0 && x < width && y >= 0 && y < height; };
+
+		// The first nodes of the lines: their predecessors are outside of the grid
+		std::vector<Point> vStarts;
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				if (!isInside(x - dx, y - dy)) vStarts.emplace_back(x, y);
+
+		parallel::parallelFor(Range(0, static_cast<int>(vStarts.size())), [&](const Range &range) {
+			float *pPrev = CArena::getScratch<float>(nStates, 0);
+			float *pCur	 = CArena::getScratch<float>(nStates, 1);
+			for (int i = range.start; i < range.end; i++) {
+				int x = vStarts[i].x;
+				int y = vStarts[i].y;
+				std::copy_n(&m_vUnary[(y * width + x) * nStates], nStates, pPrev);
+				simd::axpy(1.0f, pPrev, &m_vCosts[(y * width + x) * nStates], nStates);
+				for (x += dx, y += dy; isInside(x, y); x += dx, y += dy) {
+					const size_t	p		= y * width + x;
+					const float	  * pUnary	= &m_vUnary[p * nStates];
+					const Penalty	pen		= getPenalty(x - dx, y - dy, dx, dy);
+					if (pen.tau <= 2 * pen.lambda) simd::minPlusStep(pPrev, pUnary, MIN(pen.lambda, pen.tau), pen.tau, pCur, nStates);
+					else {																		// distance transform
+						const float m = *std::min_element(pPrev, pPrev + nStates);
+						pCur[0] = pPrev[0];
+						for (int s = 1; s < nStates; s++)		pCur[s] = MIN(pPrev[s], pCur[s - 1] + pen.lambda);
+						for (int s = nStates - 2; s >= 0; s--)	pCur[s] = MIN(pCur[s], pCur[s + 1] + pen.lambda);
+						for (int s = 0; s < nStates; s++)		pCur[s] = pUnary[s] + (MIN(pCur[s], m + pen.tau) - m);
+					}
+					simd::axpy(1.0f, pCur, &m_vCosts[p * nStates], nStates);
+					std::swap(pPrev, pCur);
+				} // x, y
+			} // i
+		}, 16);
+	}
+}
@@ -0,0 +1,87 @@
+// Semi-global matching decoding class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "MessagePassing.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ SGM Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Semi-global matching (SGM) decoding of the 2D grids
+	* @details This class finds a fast approximation of the MAP configuration of a grid graph after
+	* <a href="https://core.ac.uk/download/pdf/11134866.pdf" target="_blank">Hirschmuller</a>: instead of the whole grid, the energy is minimized
+	* exactly along every scanline of 8 or 16 directions, and the state of every node minimizes the sum of the costs, aggregated over all the directions:
+	* \f[ L_r(p, d) = C(p, d) + \min_{d'}\left(L_r(p - r, d') + V(d, d')\right) - \min_{d'} L_r(p - r, d'),\qquad S(p, d) = \sum_r L_r(p, d), \f]
+	* where \f$C = -\log\f$ of the node potential and \f$V(d, d') = \min(\lambda|d - d'|, \tau)\f$ is the truncated linear energy of the edge \f$(p - r, p)\f$.
+	* For \f$\tau\leq 2\lambda\f$ (\a e.g. the Potts potentials) the minimization is the vectorized two-penalty step (ref. simd::minPlusStep()), and the distance transform otherwise.
+	*
+	* The energies of the edges are derived from their potentials (ref. CMessagePassing::getEdgePotModel()): the truncated linear and Potts potentials are exact, the other
+	* ones are approximated with the truncated linear energy with the same energies of the state differences 1 and \a nStates - 1. The energies of both arcs of an edge are added.
+	* The steps of the paths without their own edge (\a e.g. the diagonal steps in the 4-connected grids) combine the energies of the horizontal and vertical edges of the node.
+	* The directions are processed one after another, the lines of one direction in parallel:
+	* @code
+	* CGraphPairwiseKit graphKit(nStates, INFER::TRW);
+	* graphKit.getGraphExt().buildGraph(imgSize);
+	* // ... filling the graph
+	* CInferSGM sgm(graphKit.getGraph(), imgSize, 8);
+	* vec_byte_t disparity = sgm.decode(1);
+	* @endcode
+	* The node index must be \f$y \cdot width + x\f$, as produced by @ref CGraphPairwiseExt with one layer.
+	* @note The inference results in the node potentials, which are 1 for the decoded state and 0 otherwise, thus the decode() function returns the found configuration
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferSGM : public CMessagePassing
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param graph The graph
+		* @param size The size of the grid (image resolution)
+		* @param nPaths The number of the scanline directions: 4, 8 or 16
+		*/
+		DllExport CInferSGM(IGraphPairwise &graph, Size size, byte nPaths = 8);
+		DllExport virtual ~CInferSGM(void) = default;
+
+		/**
+		* @brief Semi-global matching
+		* @param nIt is not used
+		*/
+		DllExport virtual void	infer(unsigned int nIt = 1);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Returns the aggregated costs
+		* @return The sums \f$S(p, d)\f$ of the costs over all the directions, found by the last call of infer(): Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		DllExport Mat			getAggregatedCosts(void) const { return Mat(static_cast<int>(m_vCosts.size() / MAX(1, getGraph().getNumStates())), getGraph().getNumStates(), CV_32FC1, const_cast<float *>(m_vCosts.data())); }
+
+
+	protected:
+		DllExport virtual void	calculateMessages(unsigned int) {}
+
+
+	private:
+		/// Truncated linear energy \f$V(d, d') = \min(\lambda|d - d'|, \tau)\f$
+		struct Penalty {
+			float	lambda	= 0;		///< The slope
+			float	tau		= 0;		///< The truncation
+			bool	exists	= false;	///< Flag indicating whether the step has its own edge
+		};
+
+		// Fills the penalties of the edges to the right, bottom, bottom-right and bottom-left neighbours of every node
+		void	createPenalties(void);
+		// Returns the penalty of the step from node p to node p + (dx, dy)
+		Penalty	getPenalty(int x, int y, int dx, int dy) const;
+		// Aggregates the unaries along all the lines of the direction (dx, dy) and adds the result to m_vCosts
+		void	aggregate(int dx, int dy);
+
+
+	private:
+		Size					m_size;				///< The size of the grid
+		byte					m_nPaths;			///< The number of the directions
+		vec_float_t				m_vUnary;			///< The node energies: nNodes x nStates
+		vec_float_t				m_vCosts;			///< The aggregated costs: nNodes x nStates
+		std::vector<Penalty>	m_vPenalties;		///< The penalties of the edges: nNodes x 4
+	};
+}
@@ -0,0 +1,41 @@
+#include "InferSlabs.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	void CInferSlabs::decode(Size sliceSize, int depth, potentials_function_t potentials, labels_function_t labels, unsigned int nIt) const
+	{
+		DGM_ASSERT_MSG(m_slabDepth > 0, "Wrong slab depth");
+		DGM_ASSERT_MSG(m_overlap >= 0, "Wrong overlap");
+
+		// The slab graph is rebuilt only when the depth of the slab changes, i.e. at the borders of the volume
+		CGraphPairwiseKit graphKit(m_nStates, m_infer, GraphType::grid);
+		CGraphVolumeExt	  graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), 1, m_connectivity);
+		for (int z = 0; z < depth; z += m_slabDepth) {
+			const Range core(z, MIN(depth, z + m_slabDepth));
+			const Range slab(MAX(0, core.start - m_overlap), MIN(depth, core.end + m_overlap));
+
+			Mat pots = potentials(slab);
+			DGM_ASSERT_MSG(pots.size() == Size(sliceSize.width, sliceSize.height * slab.size()) && pots.type() == CV_32FC(m_nStates), "The potentials of the slab have wrong size or type");
+			graphExt.setDepth(slab.size());
+			graphExt.setGraph(pots);
+			m_edges(graphExt, slab);
+			vec_byte_t vDecoding = graphKit.getInfer().decode(nIt);
+
+			const Mat slabLabels(sliceSize.height * slab.size(), sliceSize.width, CV_8UC1, vDecoding.data());
+			labels(core, slabLabels.rowRange((core.start - slab.start) * sliceSize.height, (core.end - slab.start) * sliceSize.height));
+		} // z
+	}
+
+	Mat CInferSlabs::decode(const Mat &pots, int depth, unsigned int nIt) const
+	{
+		DGM_ASSERT_MSG(depth > 0 && pots.rows % depth == 0, "The height of the stack (%d) is not a multiple of the depth (%d)", pots.rows, depth);
+		const int height = pots.rows / depth;
+		Mat res(pots.size(), CV_8UC1);
+		decode(Size(pots.cols, height), depth, 
+			[&](const Range &slices) { return pots.rowRange(slices.start * height, slices.end * height); },
+			[&](const Range &slices, const Mat &labels) { labels.copyTo(res.rowRange(slices.start * height, slices.end * height)); },
+			nIt);
+		return res;
+	}
+}
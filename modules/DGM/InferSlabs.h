@@ -0,0 +1,100 @@
+// Slab-wise inference class interface for the 3D volumes
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphPairwiseKit.h"
+#include "GraphVolumeExt.h"
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	// ================================ Slabs Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Slab-wise decoding of large volumes
+	* @details This class decodes the 3D lattices (ref. @ref CGraphVolumeExt), \a e.g. the medical volumes or the video streams, which do not fit into the memory at once.
+	* The volume is split along the z-axis into slabs of several slices, every slab is extended with the overlap margin of the neighbouring slices and decoded
+	* as an independent @ref CGraphGrid graph; only the labels of the slab core, \a i.e. without the margin, are kept. This is the volumetric counterpart of @ref CInferTiled.
+	*
+	* The slabs are decoded one after the other in the order of the slices, while the inference of every slab is parallel. The node potentials are requested and the labels are 
+	* returned slab by slab via the callback functions, thus the peak memory is bounded by the size of one extended slab, and the slices may be streamed, \a e.g. from the disk or a camera:
+	* @code
+	* CInferSlabs inferer(nStates, INFER::TRW, VOLUME_EDGES_6, 16, 2);
+	* inferer.decode(sliceSize, nFrames,
+	*	[&](const Range &slices) { return loadPotentials(slices); },						// Mat(size: width x (height * slices.size()); type: CV_32FC(nStates))
+	*	[&](const Range &slices, const Mat &labels) { storeLabels(slices, labels); });		// Mat(size: width x (height * slices.size()); type: CV_8UC1)
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferSlabs
+	{
+	public:
+		/**
+		* @brief Callback function returning the node potentials of the slices
+		* @details The argument is the range of the slices; the result is the stack of their potentials: Mat(size: width x (height * range size); type: CV_32FC(nStates))
+		*/
+		using potentials_function_t	= std::function<Mat(const Range &)>;
+		/**
+		* @brief Callback function filling the edges of the slab graph
+		* @details The arguments are the graph extension of the slab graph and the range of the slices, which corresponds to the slab
+		*/
+		using edges_function_t		= std::function<void(CGraphVolumeExt &, const Range &)>;
+		/**
+		* @brief Callback function receiving the labels of the slices
+		* @details The arguments are the range of the slices and the stack of their labels: Mat(size: width x (height * range size); type: CV_8UC1). 
+		* The ranges of different calls do not overlap and follow in the order of the slices
+		*/
+		using labels_function_t		= std::function<void(const Range &, const Mat &)>;
+
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param infer The inference algorithm
+		* @param connectivity The connectivity of the lattice (Ref. @ref volumeEdgesType)
+		* @param slabDepth The number of slices of the slab core
+		* @param overlap The number of the margin slices on every side of the slab
+		*/
+		DllExport CInferSlabs(byte nStates, INFER infer = INFER::TRW, byte connectivity = VOLUME_EDGES_6, int slabDepth = 16, int overlap = 2)
+			: m_nStates(nStates), m_infer(infer), m_connectivity(connectivity), m_slabDepth(slabDepth), m_overlap(overlap) {}
+		DllExport ~CInferSlabs(void) = default;
+
+		/**
+		* @brief Sets the edge model of the slab graphs
+		* @details By default every slab graph uses CGraphVolumeExt::addDefaultEdgesModel() with the value, given in setDefaultEdgesModel() [100]
+		* @param edges The callback function, which fills the edges of a slab graph
+		*/
+		DllExport void	setEdgesModel(edges_function_t edges) { m_edges = edges; }
+		/**
+		* @brief Sets the default data-independent edge model of the slab graphs
+		* @param val Value, specifying the smoothness strength (ref. CGraphVolumeExt::addDefaultEdgesModel())
+		* @param weight The weighting parameter
+		*/
+		DllExport void	setDefaultEdgesModel(float val, float weight = 1.0f) { m_edges = [val, weight](CGraphVolumeExt &graphExt, const Range &) { graphExt.addDefaultEdgesModel(val, weight); }; }
+		/**
+		* @brief Decodes the volume slab by slab
+		* @param sliceSize The size of one slice
+		* @param depth The number of slices
+		* @param potentials The callback function, which returns the node potentials of a range of slices
+		* @param labels The callback function, which receives the labels of the core of a slab
+		* @param nIt Number of iterations of the inference in every slab
+		*/
+		DllExport void	decode(Size sliceSize, int depth, potentials_function_t potentials, labels_function_t labels, unsigned int nIt = 10) const;
+		/**
+		* @brief Decodes the volume slab by slab
+		* @param pots The stack of the node potentials of the slices: Mat(size: width x (height * depth); type: CV_32FC(nStates))
+		* @param depth The number of slices
+		* @param nIt Number of iterations of the inference in every slab
+		* @return The stack of the labels: Mat(size: pots.size(); type: CV_8UC1)
+		*/
+		DllExport Mat	decode(const Mat &pots, int depth, unsigned int nIt = 10) const;
+
+
+	private:
+		byte				m_nStates;
+		INFER				m_infer;
+		byte				m_connectivity;
+		int					m_slabDepth;
+		int					m_overlap;
+		edges_function_t	m_edges = [](CGraphVolumeExt &graphExt, const Range &) { graphExt.addDefaultEdgesModel(100.0f); };
+	};
+}
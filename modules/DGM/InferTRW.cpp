@@ -1,149 +1,343 @@
 #include "InferTRW.h"
-#include "GraphPairwise.h"
+#include "ThreadPool.h"
+#include "kernels.h"
+#include "profiler.h"
+#include "footprint.h"
 #include "macroses.h"
+#include <deque>
+#include <mutex>
 
 namespace DirectGraphicalModels
 {
 	void CInferTRW::infer(unsigned int nIt)
 	{
-		const byte nStates = getGraph().getNumStates();					// number of states (classes)
+		const size_t	nNodes	= getGraph().getNumNodes();
+		DGM_ASSERT_MSG(!isLogDomain(), "The logarithmic domain is not supported by the TRW inference");
 
-		// ====================================== Initialization ======================================			
+		// ====================================== Initialization ======================================
+		resetConvergence();
+		m_vEnergy.clear();
+		m_vLowerBound.clear();
+		beginPhase("setup");
 		createMessages(1.0f);
 
-		// =================================== Calculating messages ==================================	
+		// =================================== Calculating messages ==================================
+		beginPhase("messages");
+		updateMessages(nIt);
 
-		calculateMessages(nIt);
+		// =================================== Calculating beliefs ===================================
+		beginPhase("beliefs");
+		vec_byte_t vSol(nNodes, 0);
+		computeSolution(vSol, true);
 
-		// =================================== Calculating beliefs ===================================	
+		deleteMessages();
+		endPhase();
+	}
 
-		for (ptr_node_t &node : getGraphPairwise().m_vNodes) {
-			// backward edges
-			for (size_t e_f : node->from) {
-				Edge * edge_from = getGraphPairwise().m_vEdges[e_f].get();
-				if (edge_from->node1 > edge_from->node2) continue;
-				Node *src = getGraphPairwise().m_vNodes[edge_from->node1].get();
-				for (byte s = 0; s < nStates; s++) node->Pot.at<float>(s, 0) *= edge_from->Pot.at<float>(src->sol, s);
-			}
-			// forward edges
-			for (size_t e_t : node->to) {
-				Edge *edge_to = getGraphPairwise().m_vEdges[e_t].get();
-				if (edge_to->node1 > edge_to->node2) continue;
-				float *msg = getMessage(e_t);
-				for (byte s = 0; s < nStates; s++) node->Pot.at<float>(s, 0) *= msg[s];
-			}
+	size_t CInferTRW::getMemoryUsage(void) const
+	{
+		return CMessagePassing::getMemoryUsage() + sizeof(*this) - sizeof(CMessagePassing) + footprint::getBytes(m_vEnergy) + footprint::getBytes(m_vLowerBound);
+	}
+
+	void CInferTRW::calculateMessages(unsigned int nIt)
+	{
+		kernels::dispatch(getGraph().getNumStates(), [&](auto N) { calculateMessagesFixed<decltype(N)::value>(nIt); });
+	}
+
+	// Propagates the changes with a work-list of nodes: every node updates its messages in both directions, as in the forward and in the backward pass
+	void CInferTRW::calculateMessagesLocal(const vec_size_t &vNodes, unsigned int nIt)
+	{
+		const byte		nStates		= getGraph().getNumStates();
+		const size_t	nNodes		= getGraph().getNumNodes();
+		const size_t	maxUpdates	= static_cast<size_t>(nIt) * nNodes;
+		const float		threshold	= getIncrementalThreshold();
+		std::deque<size_t>	qNodes;
+		vec_byte_t			vQueued(nNodes, 0);
+
+		auto schedule = [&](size_t n) {
+			if (vQueued[n]) return;
+			vQueued[n] = 1;
+			qNodes.push_back(n);
+		};
+		for (size_t n : vNodes) schedule(n);
+
+		float	*data		= CArena::getScratch<float>(nStates, 0);
+		float	*temp		= CArena::getScratch<float>(nStates, 1);
+		float	 maxResidual = 0;
+		size_t	 nMessages	 = 0;
+		for (size_t nUpdates = 0; !qNodes.empty() && nUpdates < maxUpdates; nUpdates++) {
+			const size_t n = qNodes.front();
+			qNodes.pop_front();
+			vQueued[n] = 0;
+
+			auto update = [&](size_t e, size_t neighbor) {
+				float res = calculateMessage(getMessage(e), e, temp, data);
+				if (maxResidual < res) maxResidual = res;
+				if (res > threshold) schedule(neighbor);
+				nMessages++;
+			};
+
+			collect<0>(n, data, false);
+			for (size_t e_t : getOutEdges(n))
+				if (n < getEdgeDst(e_t)) update(e_t, getEdgeDst(e_t));
+			collect<0>(n, data, true);
+			for (size_t e_f : getInEdges(n))
+				if (getEdgeSrc(e_f) < n) update(e_f, getEdgeSrc(e_f));
 
-			Point extremumLoc;
-			minMaxLoc(node->Pot, NULL, NULL, NULL, &extremumLoc);
-			node->sol = static_cast<byte> (extremumLoc.y);
+			if (nUpdates % 1024 == 1023 && getTimeBudget().isExpired()) break;
 		}
+		isConverged(0, maxResidual, nMessages);
+	}
 
-		deleteMessages();
+	float CInferTRW::calculateMessage(float *msg, size_t edge, float *temp, float *data)
+	{
+		return updateMessage<0>(msg, edge, temp, data);
 	}
 
-	void CInferTRW::calculateMessages(unsigned int nIt)
+	void CInferTRW::calculateBelief(size_t node, float *pot)
+	{
+		const byte nStates = getGraph().getNumStates();
+		collect<0>(node, pot, true);
+		float sum = 0;
+		for (byte s = 0; s < nStates; s++) sum += pot[s];
+		if (sum > 0) for (byte s = 0; s < nStates; s++) pot[s] /= sum;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	template<int N>
+	void CInferTRW::calculateMessagesFixed(unsigned int nIt)
 	{
 		const    byte	  nStates	= getGraph().getNumStates();										// number of states
-		float			* data		= new float[nStates];
-		float			* temp		= new float[nStates];
+		const	 size_t	  nNodes	= getGraph().getNumNodes();
+		const	 size_t	  nEdges	= getGraph().getNumEdges();
+		std::mutex		  mtx;
+
+		// The wavefronts: the nodes of one wavefront share no edges and may be processed in parallel without changing the result
+		std::vector<vec_size_t> vForwardFronts, vBackwardFronts;
+		getWavefronts(vForwardFronts, true);
+		getWavefronts(vBackwardFronts, false);
+
+		float	maxResidual = 0;												// maximal L1-change of a message
+		double	sumResidual = 0;												// sum of the L1-changes of all messages (both passes)
+
+		// Processes one wavefront of the forward (or backward) pass
+		auto pass = [&](const vec_size_t &vNodes, bool forward) {
+			const int size = static_cast<int>(vNodes.size());
+			auto body = [&, nStates](const Range& range) {
+				float	*data	= CArena::getScratch<float>(nStates, 0);
+				float	*temp	= CArena::getScratch<float>(nStates, 1);
+				float	 maxRes = 0;
+				double	 sumRes = 0;
+				auto	 update = [&](size_t e) {
+					float res = updateMessage<N>(getMessage(e), e, temp, data);
+					if (maxRes < res) maxRes = res;
+					sumRes += res;
+				};
+
+				for (int i = range.start; i < range.end; i++) {
+					const size_t n = vNodes[i];
+					collect<N>(n, data, !forward);
+					if (forward) {
+						// pass messages from i to nodes with higher m_ordering
+						for (size_t e_t : getOutEdges(n))
+							if (n < getEdgeDst(e_t)) update(e_t);
+					}
+					else {
+						// pass messages from i to nodes with smaller m_ordering
+						for (size_t e_f : getInEdges(n))
+							if (getEdgeSrc(e_f) < n) update(e_f);
+					}
+				} // i
+
+				std::lock_guard<std::mutex> lock(mtx);
+				if (maxResidual < maxRes) maxResidual = maxRes;
+				sumResidual += sumRes;
+			};
+			parallel::parallelFor(Range(0, size), body, 64);
+		};
 
 		// main loop
+		vec_byte_t vSol(nNodes, 0);
 		for (unsigned int i = 0; i < nIt; i++) {										// iterations
+			DGM_PROFILE_ZONE("TRW iteration");
 	#ifdef DEBUG_PRINT_INFO
 			if (i == 0) printf("\n");
 			if (i % 5 == 0) printf("--- It: %d ---\n", i);
 	#endif
-			// Forward pass
-			std::for_each(getGraphPairwise().m_vNodes.begin(), getGraphPairwise().m_vNodes.end(), [&](ptr_node_t &node) {
-				memcpy(data, node->Pot.data, nStates * sizeof(float));					// data = node.pot
-
-				int	nForward = 0;
-				for (size_t e_t : node->to) {
-					Edge *edge_to = getGraphPairwise().m_vEdges[e_t].get();
-					if (edge_to->node1 > edge_to->node2) continue;
-					float *msg = getMessage(e_t);
-					for (byte s = 0; s < nStates; s++) data[s] *= msg[s];				// data = node.pot * edge_to.msg
-					nForward++;
-				} // e_t
-			
-				int	nBackward = 0;
-				for (size_t e_f : node->from) {
-					Edge *edge_from = getGraphPairwise().m_vEdges[e_f].get();
-					if (edge_from->node1 > edge_from->node2) continue;
-					float *msg = getMessage(e_f);
-					for (byte s = 0; s < nStates; s++) data[s] *= msg[s];				// data = node.pot * edge_to.msg * edge_from.msg
-					nBackward++;
-				} // e_f
-
-				for (byte s = 0; s < nStates; s++) data[s] = static_cast<float>(fastPow(data[s], 1.0f / MAX(nForward, nBackward)));
-
-				// pass messages from i to nodes with higher m_ordering
-				for (size_t e_t : node->to) {
-					Edge *edge_to = getGraphPairwise().m_vEdges[e_t].get();
-					if (edge_to->node1 < edge_to->node2) calculateMessage(getMessage(e_t), *edge_to, temp, data);
-				} // e_t
-			});
-
-			// Backward pass
-			std::for_each(getGraphPairwise().m_vNodes.rbegin(), getGraphPairwise().m_vNodes.rend(), [&](ptr_node_t &node) {
-				memcpy(data, node->Pot.data, nStates * sizeof(float));							// data = node.pot
-
-				int	nForward = 0;
-				for (size_t e_t : node->to) {
-					Edge *edge_to = getGraphPairwise().m_vEdges[e_t].get();
-					if (edge_to->node1 > edge_to->node2) continue;
-					float *msg = getMessage(e_t);
-					for (byte s = 0; s < nStates; s++) data[s] *= msg[s];
-					nForward++;
-				} // e_t
-			
-				int	nBackward = 0;
-				for (size_t e_f : node->from) {
-					Edge *edge_from = getGraphPairwise().m_vEdges[e_f].get();
-					if (edge_from->node1 > edge_from->node2) continue;
-					float *msg = getMessage(e_f);
-					for (byte s = 0; s < nStates; s++) data[s] *= msg[s];
-					nBackward++;
-				} // e_f
-
-				// normalize data
-				float max = data[0];
-				for (byte s = 1; s < nStates; s++) if (max < data[s]) max = data[s];
-				for (byte s = 0; s < nStates; s++) data[s] /= max;
-				for (byte s = 0; s < nStates; s++) data[s] = static_cast<float>(fastPow(data[s], 1.0f / MAX(nForward, nBackward)));
-
-				// pass messages from i to nodes with smaller m_ordering
-				for (size_t e_f : node->from) {
-					Edge *edge_from = getGraphPairwise().m_vEdges[e_f].get();
-					if (edge_from->node1 < edge_from->node2) calculateMessage(getMessage(e_f), *edge_from, temp, data);
-				} // e_f
-			}); // All Nodes
-		} // iterations
+			maxResidual = 0;
+			sumResidual = 0;
+
+			for (const vec_size_t &vNodes : vForwardFronts)  pass(vNodes, true);		// Forward pass
+			for (const vec_size_t &vNodes : vBackwardFronts) pass(vNodes, false);		// Backward pass
 
-		delete[] data;
-		delete[] temp;
+			float residual = getResidualNorm() == ResidualNorm::max ? maxResidual : static_cast<float>(sumResidual / MAX(1, nEdges));
+			bool  converged = isConverged(i, residual, nEdges);
+
+			if (m_energyTracking) {
+				computeSolution(vSol, false);
+				m_vEnergy.push_back(computeEnergy(vSol));
+				addEnergy(m_vEnergy.back());
+				m_vLowerBound.push_back(computeLowerBound());
+				if (m_vEnergy.back() - m_vLowerBound.back() <= 1e-5f * MAX(1.0f, fabs(m_vEnergy.back()))) converged = true;	// the solution is optimal
+			}
+			if (converged) break;
+		} // iterations
 	}
 
 	// Updates edge->msg = F(data, edge.Pot)
-	void CInferTRW::calculateMessage(float *msg, Edge &edge, float *temp, float *data)
+	template<int N>
+	float CInferTRW::updateMessage(float *msg, size_t edge, float *temp, float *data)
 	{
-		const byte nStates = getGraph().getNumStates();
+		float msg_old[N ? N : 256];
+		const byte	  nStates = getGraph().getNumStates();
+		const int	  n		  = kernels::count<N>(nStates);
+		const float * pEdgePot = getEdgePot(edge);
+		DGM_ASSERT_MSG(pEdgePot, "The potential of the edge %zu is not set", edge);
 
-		for (byte s = 0; s < nStates; s++) temp[s] = data[s] / MAX(FLT_EPSILON, msg[s]); 				// tmp = gamma * data / edge.msg
+		for (int s = 0; s < n; s++) temp[s] = data[s] / MAX(FLT_EPSILON, msg[s]);						// tmp = gamma * data / edge.msg
+		memcpy(msg_old, msg, n * sizeof(float));
 
-		for (byte y = 0; y < nStates; y++) {
-			float *pPot = edge.Pot.ptr<float>(y);
-			float max = temp[0] * pPot[0];																// vMin = tmp + edge.Pot(0, kdest)
-			for (byte x = 1; x < nStates; x++) {
-				float val = temp[x] * pPot[x];
-				if (max < val) max = val;
+		const EdgePotModel &model = getEdgePotModel(edge);
+		if (model.kind != EdgePotKind::general)															// symmetric potential: msg = edge.Pot^T x tmp
+			MatMul(model, pEdgePot, temp, msg, nStates, true);
+		else kernels::matVecMax<N>(pEdgePot, temp, msg, nStates);										// msg[y] = max_x tmp[x] * edge.Pot(y, x)
+
+		// Normalization
+		kernels::normalizeMax<N>(msg, nStates);
+
+		float res = 0;
+		for (int s = 0; s < n; s++) res += fabs(msg[s] - msg_old[s]);
+		return res;
+	}
+
+	// Calculates data = (node.pot * edge_to.msg * edge_from.msg) ^ (1 / max(nForward, nBackward)) for the messages, directed from lower to higher node indexes
+	template<int N>
+	void CInferTRW::collect(size_t n, float *data, bool normalize)
+	{
+		const byte	nStates = getGraph().getNumStates();
+		const int	k		= kernels::count<N>(nStates);
+		memcpy(data, getNodePot(n), k * sizeof(float));											// data = node.pot
+
+		int	nForward = 0;
+		for (size_t e_t : getOutEdges(n)) {
+			if (n > getEdgeDst(e_t)) continue;
+			kernels::mul<N>(data, getMessage(e_t), nStates);									// data = node.pot * edge_to.msg
+			nForward++;
+		} // e_t
+
+		int	nBackward = 0;
+		for (size_t e_f : getInEdges(n)) {
+			if (getEdgeSrc(e_f) > n) continue;
+			kernels::mul<N>(data, getMessage(e_f), nStates);									// data = node.pot * edge_to.msg * edge_from.msg
+			nBackward++;
+		} // e_f
+
+		if (normalize) kernels::normalizeMax<N>(data, nStates);
+		for (int s = 0; s < k; s++) data[s] = static_cast<float>(fastPow(data[s], 1.0f / MAX(nForward, nBackward)));
+	}
+
+	void CInferTRW::getWavefronts(std::vector<vec_size_t> &vFronts, bool forward) const
+	{
+		const size_t nNodes = getGraph().getNumNodes();
+		vec_size_t	 vLevel(nNodes, 0);
+
+		vFronts.clear();
+		for (size_t i = 0; i < nNodes; i++) {
+			const size_t n = forward ? i : nNodes - 1 - i;
+			size_t level = 0;
+			if (forward) {
+				for (size_t e_f : getInEdges(n)) {
+					const size_t src = getEdgeSrc(e_f);
+					if (src < n) level = MAX(level, vLevel[src] + 1);
+				}
 			}
-			msg[y] = max;
+			else {
+				for (size_t e_t : getOutEdges(n)) {
+					const size_t dst = getEdgeDst(e_t);
+					if (dst > n) level = MAX(level, vLevel[dst] + 1);
+				}
+			}
+			vLevel[n] = level;
+			if (level >= vFronts.size()) vFronts.resize(level + 1);
+			vFronts[level].push_back(n);
 		}
+	}
 
-		// Normalization
-		float max = msg[0];
-		for (byte s = 1; s < nStates; s++) if (max < msg[s]) max = msg[s];
-		for (byte s = 0; s < nStates; s++) msg[s] /= max;
+	void CInferTRW::computeSolution(vec_byte_t &vSol, bool updatePot)
+	{
+		const byte		nStates = getGraph().getNumStates();			// number of states (classes)
+		const size_t	nNodes	= getGraph().getNumNodes();
+		float		  * buf		= CArena::getScratch<float>(nStates, 2);
+
+		for (size_t n = 0; n < nNodes; n++) {
+			float *pot = updatePot ? getNodePot(n) : buf;
+			if (!updatePot) memcpy(pot, getNodePot(n), nStates * sizeof(float));
+			// backward edges
+			for (size_t e_f : getInEdges(n)) {
+				size_t src = getEdgeSrc(e_f);
+				if (src > n) continue;
+				if (isEdgePotPotts(e_f))
+					for (byte s = 0; s < nStates; s++) pot[s] *= getEdgePotValue(e_f, vSol[src], s);
+				else {
+					const float *edgePot = getEdgePot(e_f) + vSol[src] * nStates;
+					for (byte s = 0; s < nStates; s++) pot[s] *= edgePot[s];
+				}
+			}
+			// forward edges
+			for (size_t e_t : getOutEdges(n)) {
+				if (n > getEdgeDst(e_t)) continue;
+				float *msg = getMessage(e_t);
+				for (byte s = 0; s < nStates; s++) pot[s] *= msg[s];
+			}
+
+			vSol[n] = static_cast<byte>(std::max_element(pot, pot + nStates) - pot);
+		}
+	}
+
+	float CInferTRW::computeEnergy(const vec_byte_t &vSol) const
+	{
+		const size_t	nNodes	= getGraph().getNumNodes();
+
+		double energy = 0;
+		for (size_t n = 0; n < nNodes; n++) {
+			energy -= log(MAX(FLT_MIN, getNodePot(n)[vSol[n]]));
+			for (size_t e_t : getOutEdges(n)) {
+				const size_t dst = getEdgeDst(e_t);
+				if (n > dst || !getEdgePot(e_t)) continue;
+				energy -= log(MAX(FLT_MIN, getEdgePotValue(e_t, vSol[n], vSol[dst])));
+			}
+		}
+		return static_cast<float>(energy);
+	}
+
+	// After the backward pass, the message of every edge (n) -> (m), n < m, is defined over the states of node n.
+	// Adding its logarithm to node n and subtracting it from the edge gives a reparametrization of the energy, which minima sum up to the lower bound.
+	float CInferTRW::computeLowerBound(void)
+	{
+		const byte		nStates = getGraph().getNumStates();
+		const size_t	nNodes	= getGraph().getNumNodes();
+		float		  * theta	= CArena::getScratch<float>(nStates, 2);
+
+		double bound = 0;
+		for (size_t n = 0; n < nNodes; n++) {
+			for (byte s = 0; s < nStates; s++) theta[s] = -logf(MAX(FLT_MIN, getNodePot(n)[s]));
+			for (size_t e_t : getOutEdges(n)) {
+				const size_t dst = getEdgeDst(e_t);
+				if (n > dst) continue;
+				const float *msg = getMessage(e_t);
+				if (!getEdgePot(e_t)) continue;
+				float minEdge = FLT_MAX;
+				for (byte x = 0; x < nStates; x++) {
+					const float logMsg = logf(MAX(FLT_MIN, msg[x]));
+					theta[x] -= logMsg;
+					for (byte y = 0; y < nStates; y++)
+						minEdge = MIN(minEdge, -logf(MAX(FLT_MIN, getEdgePotValue(e_t, x, y))) + logMsg);
+				}
+				bound += minEdge;
+			}
+			bound += *std::min_element(theta, theta + nStates);
+		}
+
+		return static_cast<float>(bound);
 	}
 }
@@ -6,14 +6,17 @@
 
 namespace DirectGraphicalModels
 {
-	struct Edge;
-	
 	// ==================== Microsoft TRW Decode Class ==================
 	/**
 	* @ingroup moduleDecode
 	* @brief Tree-reweighted inference class
 	* @details This class is based on the Tree-reweighted message passing algorithm (a modification of a max-poduct LBP algorithm), 
 	* described in the paper <a href="http://pub.ist.ac.at/~vnk/papers/TRW-S-PAMI.pdf" target="_blank">Convergent Tree-reweighted Message Passing for Energy Minimization</a>
+	* 
+	* The nodes are processed in the order of their indexes. Since every node depends only on its neighbours, the forward and backward passes are split into
+	* wavefronts: groups of nodes, which share no edges, \a e.g. the anti-diagonals of a grid graph. The nodes of one wavefront are processed in parallel,
+	* which gives exactly the same messages as the sequential processing and thus keeps the monotonic lower bound property.
+	* > The messages are calculated in the linear domain only: the logarithmic domain (ref. setLogDomain()) is not supported
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CInferTRW : public CMessagePassing
@@ -23,14 +26,76 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param graph The graph
 		*/
-		DllExport CInferTRW(CGraphPairwise &graph) : CMessagePassing(graph) {}
+		DllExport CInferTRW(IGraphPairwise &graph) : CMessagePassing(graph), m_energyTracking(false) {}
 		DllExport virtual ~CInferTRW(void) = default;
 
 		DllExport virtual void infer(unsigned int nIt = 1);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		/**
+		* @brief Enables the calculation of the energy and of the lower bound after every iteration
+		* @details The energy of the current solution is \f$-\sum_n\log(pot_n(x_n)) - \sum_{(n,m)}\log(pot_{n,m}(x_n, x_m))\f$. The lower bound is the sum of the minima
+		* of the reparametrized node and edge energies. If the gap between them vanishes, the solution is optimal and the inference stops.
+		* > The tracking costs approximately one additional sweep over the graph per iteration.
+		* @param energyTracking Flag indicating whether the energy and the lower bound should be calculated
+		*/
+		DllExport void			setEnergyTracking(bool energyTracking) { m_energyTracking = energyTracking; }
+		/**
+		* @brief Returns the energies of the solutions after every iteration of the last call of infer()
+		* @note Available only if the tracking is enabled with setEnergyTracking()
+		* @return The energies
+		*/
+		DllExport const vec_float_t& getEnergies(void) const { return m_vEnergy; }
+		/**
+		* @brief Returns the lower bounds of the energy after every iteration of the last call of infer()
+		* @note Available only if the tracking is enabled with setEnergyTracking()
+		* @return The lower bounds
+		*/
+		DllExport const vec_float_t& getLowerBounds(void) const { return m_vLowerBound; }
 
 
 	protected:
 		DllExport virtual void	calculateMessages(unsigned int nIt);
-		void					calculateMessage(float* msg, Edge& edge, float* temp, float* data);
+		DllExport virtual void	calculateMessagesLocal(const vec_size_t &vNodes, unsigned int nIt);
+		/**
+		* @brief Updates the message of the edge
+		* @param[in,out] msg The message of the edge
+		* @param[in] edge The %Edge index
+		* @param[in] temp Auxilary array of \b nStates values
+		* @param[in] data The product of the node potential and the incoming messages
+		* @return The L1-norm of the message change
+		*/
+		float					calculateMessage(float* msg, size_t edge, float* temp, float* data);
+		/**
+		* @brief Calculates the belief of a node
+		* @details The belief is the product of the node potential and of the messages, raised to the power of the edge appearance probability
+		* (\a i.e. the reparametrized node potential, which is maximal for the current solution), normalized to the sum of one
+		* @param[in] node Index of the graph node
+		* @param[out] pot Destination array of \b nStates values
+		*/
+		virtual void			calculateBelief(size_t node, float *pot) override;
+
+
+	private:
+		// calculateMessages() with the kernels, specialized for N states (ref. kernels::dispatch())
+		template<int N>
+		void		calculateMessagesFixed(unsigned int nIt);
+		// calculateMessage(), specialized for N states
+		template<int N>
+		float		updateMessage(float *msg, size_t edge, float *temp, float *data);
+		// Calculates the product of the node potential and the messages of the node, raised to the power of the edge appearance probability
+		template<int N>
+		void		collect(size_t n, float *data, bool normalize);
+		// Splits the nodes into the groups, which may be processed in parallel in the forward (or backward) pass
+		void		getWavefronts(std::vector<vec_size_t> &vFronts, bool forward) const;
+		// Calculates the solution from the messages; if updatePot is true, the node potentials are replaced with the beliefs
+		void		computeSolution(vec_byte_t &vSol, bool updatePot);
+		float		computeEnergy(const vec_byte_t &vSol) const;
+		float		computeLowerBound(void);
+
+
+	private:
+		bool		m_energyTracking;	///< Flag indicating whether the energy and the lower bound are calculated
+		vec_float_t	m_vEnergy;			///< The energies after every iteration
+		vec_float_t	m_vLowerBound;		///< The lower bounds after every iteration
 	};
 }
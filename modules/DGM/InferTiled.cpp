@@ -0,0 +1,41 @@
+#include "InferTiled.h"
+#include "ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	void CInferTiled::decode(Size imageSize, potentials_function_t potentials, labels_function_t labels, unsigned int nIt) const
+	{
+		DGM_ASSERT_MSG(m_tileSize.width > 0 && m_tileSize.height > 0, "Wrong tile size");
+		const int nTilesX	= (imageSize.width  + m_tileSize.width  - 1) / m_tileSize.width;
+		const int nTilesY	= (imageSize.height + m_tileSize.height - 1) / m_tileSize.height;
+		const Rect image(Point(0, 0), imageSize);
+
+		parallel::parallelFor(Range(0, nTilesX * nTilesY), [&](const Range& range) {
+			// The tile graph is owned by the worker and is rebuilt only when the tile size changes
+			CGraphPairwiseKit graphKit(m_nStates, m_infer, GraphType::grid);
+			CGraphLayeredExt  graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), 1, GRAPH_EDGES_GRID);
+			for (int t = range.start; t < range.end; t++) {
+				const Rect core(Point((t % nTilesX) * m_tileSize.width, (t / nTilesX) * m_tileSize.height), m_tileSize);
+				const Rect tile = Rect(core.x - m_overlap, core.y - m_overlap, core.width + 2 * m_overlap, core.height + 2 * m_overlap) & image;
+
+				Mat pots = potentials(tile);
+				DGM_ASSERT_MSG(pots.size() == tile.size() && pots.type() == CV_32FC(m_nStates), "The potentials of the tile have wrong size or type");
+				graphExt.setGraph(pots);
+				m_edges(graphExt, tile);
+				vec_byte_t vDecoding = graphKit.getInfer().decode(nIt);
+
+				const Rect roi = core & image;
+				Mat tileLabels(tile.size(), CV_8UC1, vDecoding.data());
+				labels(roi, tileLabels(Rect(roi.tl() - tile.tl(), roi.size())));
+			} // t
+		});
+	}
+
+	Mat CInferTiled::decode(const Mat &pots, unsigned int nIt) const
+	{
+		Mat res(pots.size(), CV_8UC1);
+		decode(pots.size(), [&pots](const Rect &roi) { return pots(roi); }, [&res](const Rect &roi, const Mat &labels) { labels.copyTo(res(roi)); }, nIt);
+		return res;
+	}
+}
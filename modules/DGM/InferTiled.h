@@ -0,0 +1,90 @@
+// Tiled inference class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "GraphPairwiseKit.h"
+#include "GraphLayeredExt.h"
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	// ================================ Tiled Infer Class ================================
+	/**
+	* @ingroup moduleDecode
+	* @brief Tiled decoding of large images
+	* @details This class decodes the 2D grid CRFs, which do not fit into the memory at once, \a e.g. the gigapixel images. The image is split into tiles,
+	* every tile is extended with an overlap margin and decoded as an independent @ref CGraphGrid graph, built with @ref CGraphLayeredExt; only the labels of 
+	* the tile core, \a i.e. without the margin, are kept. The margin passes the context of the neighbouring tiles, so that the seams between the tiles 
+	* vanish for the margins, wider than the range of interaction of the model.
+	*
+	* The tiles are decoded in parallel. The node potentials are requested and the labels are returned tile by tile via the callback functions, 
+	* thus the peak memory is bounded by the tile size times the number of threads.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CInferTiled
+	{
+	public:
+		/**
+		* @brief Callback function returning the node potentials of the region
+		* @details The argument is the region of the image; the result is Mat(size: region size; type: CV_32FC(nStates))
+		*/
+		using potentials_function_t	= std::function<Mat(const Rect &)>;
+		/**
+		* @brief Callback function filling the edges of the tile graph
+		* @details The arguments are the graph extension of the tile graph and the region of the image, which corresponds to the tile
+		*/
+		using edges_function_t		= std::function<void(CGraphLayeredExt &, const Rect &)>;
+		/**
+		* @brief Callback function receiving the labels of the region
+		* @details The arguments are the region of the image and the labels: Mat(size: region size; type: CV_8UC1). The regions of different calls do not overlap
+		*/
+		using labels_function_t		= std::function<void(const Rect &, const Mat &)>;
+
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param infer The inference algorithm
+		* @param tileSize The size of the tile core
+		* @param overlap The width of the overlap margin in pixels
+		*/
+		DllExport CInferTiled(byte nStates, INFER infer = INFER::TRW, Size tileSize = Size(512, 512), int overlap = 32)
+			: m_nStates(nStates), m_infer(infer), m_tileSize(tileSize), m_overlap(overlap) {}
+		DllExport ~CInferTiled(void) = default;
+
+		/**
+		* @brief Sets the edge model of the tile graphs
+		* @details By default every tile graph uses CGraphLayeredExt::addDefaultEdgesModel() with the value, given in setDefaultEdgesModel() [100]
+		* @param edges The callback function, which fills the edges of a tile graph. It is called concurrently for different tiles
+		*/
+		DllExport void	setEdgesModel(edges_function_t edges) { m_edges = edges; }
+		/**
+		* @brief Sets the default data-independent edge model of the tile graphs
+		* @param val Value, specifying the smoothness strength (ref. CGraphLayeredExt::addDefaultEdgesModel())
+		* @param weight The weighting parameter
+		*/
+		DllExport void	setDefaultEdgesModel(float val, float weight = 1.0f) { m_edges = [val, weight](CGraphLayeredExt &graphExt, const Rect &) { graphExt.addDefaultEdgesModel(val, weight); }; }
+		/**
+		* @brief Decodes the image tile by tile
+		* @param imageSize The size of the image
+		* @param potentials The callback function, which returns the node potentials of a region. It is called concurrently for different regions
+		* @param labels The callback function, which receives the labels of a tile. It is called concurrently for different tiles
+		* @param nIt Number of iterations of the inference in every tile
+		*/
+		DllExport void	decode(Size imageSize, potentials_function_t potentials, labels_function_t labels, unsigned int nIt = 10) const;
+		/**
+		* @brief Decodes the image tile by tile
+		* @param pots The node potentials of the image: Mat(type: CV_32FC(nStates))
+		* @param nIt Number of iterations of the inference in every tile
+		* @return The labels: Mat(size: pots.size(); type: CV_8UC1)
+		*/
+		DllExport Mat	decode(const Mat &pots, unsigned int nIt = 10) const;
+
+
+	private:
+		byte				m_nStates;
+		INFER				m_infer;
+		Size				m_tileSize;
+		int					m_overlap;
+		edges_function_t	m_edges = [](CGraphLayeredExt &graphExt, const Rect &) { graphExt.addDefaultEdgesModel(100.0f); };
+	};
+}
@@ -1,89 +1,78 @@
 #include "InferTree.h"
-#include "GraphPairwise.h"
+#include "ThreadPool.h"
 
 namespace DirectGraphicalModels
 {
 	void CInferTree::calculateMessages(unsigned int)
 	{
 		const byte		nStates	= getGraph().getNumStates();
-		const size_t	nNodes	= getGraph().getNumNodes();
-		const size_t	nEdges	= getGraph().getNumEdges();
+		const size_t	NONE	= static_cast<size_t>(-1);
 
 		// ====================================== Initialization ======================================
-		vec_bool_t		isReady(nEdges, false);								// Flags indicating whether the messages were already calculated
-		vec_bool_t		suspend(nEdges, false);								// Flags indicating weather the message calculation must be postponed
-		
-		// =================================== Computing messages ===================================
-		size_t  * nFromEdges = new size_t[nNodes];							// Count number of neighbors
-		std::deque<size_t> nodeQueue;
-		for (ptr_node_t &node: getGraphPairwise().m_vNodes) {
-			nFromEdges[node->id] = node->from.size();						// number of incoming edges
-			if (nFromEdges[node->id] <= 1) nodeQueue.push_back(node->id);	// Add all leafs to the queue
-		}
+		std::vector<vec_size_t> vLevels;											// nodes of every level
+		vec_size_t				vUpEdge;											// edge from the node to its parent
+		vec_size_t				vDownEdge;											// edge from the parent to the node
+		getLevels(vLevels, vUpEdge, vDownEdge);
 
+		// Calculates the messages of the edges vEdge[n] for all nodes n of the level
+		auto pass = [&](const vec_size_t &vNodes, const vec_size_t &vEdge) {
+			const int size = static_cast<int>(vNodes.size());
+			auto body = [&, nStates](const Range& range) {
+				float *temp = CArena::getScratch<float>(nStates);
+				for (int i = range.start; i < range.end; i++) {
+					const size_t e = vEdge[vNodes[i]];
+					if (e != NONE) calculateMessage(e, temp, getMessage(e));
+				}
+			};
+			if (size >= 64) parallel::parallelFor(Range(0, size), body);
+			else body(Range(0, size));
+		};
+
+		// =================================== Computing messages ===================================
+		for (size_t l = vLevels.size(); l > 1; l--) pass(vLevels[l - 1], vUpEdge);	// upward pass: from the leafs to the roots
+		for (size_t l = 1; l < vLevels.size(); l++) pass(vLevels[l], vDownEdge);	// downward pass: from the roots to the leafs
+	}
 
-		float *temp = new float[nStates];
-		while (!nodeQueue.empty()) {
-			//for (size_t q = 0; q < nodeQueue.size(); q++) printf("%d, ", nodeQueue[q]);	printf("\n");
-			
-			size_t n = nodeQueue.front();									// n - node with one neighbour
-			nodeQueue.pop_front();
+	// ------------------------------ PRIVATE ------------------------------
+	void CInferTree::getLevels(std::vector<vec_size_t> &vLevels, vec_size_t &vUpEdge, vec_size_t &vDownEdge) const
+	{
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const size_t	NONE	= static_cast<size_t>(-1);
+		vec_size_t		vLevel(nNodes, NONE);
 
-			Node  *node = getGraphPairwise().m_vNodes[n].get();				// Node with one neighbour
-			
-			bool allSuspend = true;
-			for (size_t e_t : node->to)
-				if (!suspend[e_t]) {
-					allSuspend = false;
-					break;
-				}
+		vLevels.clear();
+		vUpEdge.assign(nNodes, NONE);
+		vDownEdge.assign(nNodes, NONE);
 
-			if (allSuspend) {	// Now prepare messages for suspending edges
-				for (size_t e_t : node->to) {
-					if (isReady[e_t]) continue;
-					
-					Edge *edge_to = getGraphPairwise().m_vEdges[e_t].get();
-					calculateMessage(*edge_to, temp, getMessage(e_t));
-					isReady[e_t] = true;
-					
-					// ------
-					size_t n1 = edge_to->node1;
-					size_t n2 = edge_to->node2;
-					auto it = std::find_if(getGraphPairwise().m_vNodes[n1]->from.begin(), getGraphPairwise().m_vNodes[n1]->from.end(), [&](size_t e) {
-						return (getGraphPairwise().m_vEdges[e]->node1 == n2);
-					});
-					if (it != getGraphPairwise().m_vNodes[n1]->from.end())
-						suspend[*it] = true;
-					// ------
-					
-					nFromEdges[n2]--;
-					if (nFromEdges[n2] <= 1) nodeQueue.push_back(n2);
+		// Breadth-first search from the first node of every connected component
+		vec_size_t vQueue;
+		for (size_t root = 0; root < nNodes; root++) {
+			if (vLevel[root] != NONE) continue;
+			vLevel[root] = 0;
+			vQueue.assign(1, root);
+			for (size_t i = 0; i < vQueue.size(); i++) {
+				const size_t n = vQueue[i];
+				if (vLevel[n] >= vLevels.size()) vLevels.resize(vLevel[n] + 1);
+				vLevels[vLevel[n]].push_back(n);
+				// the neighbours, connected with the outgoing edges n -> m
+				for (size_t e_t : getOutEdges(n)) {
+					const size_t m = getEdgeDst(e_t);
+					if (vLevel[m] == NONE) {
+						vLevel[m] = vLevel[n] + 1;
+						vQueue.push_back(m);
+					}
+					if (vLevel[m] == vLevel[n] + 1 && vDownEdge[m] == NONE) vDownEdge[m] = e_t;
 				}
-			} else {			// Prepare messages for all non-suspending edges
-				for (size_t e_t : node->to) {
-					if (suspend[e_t]) continue;
-					if (isReady[e_t]) continue;
-					
-					Edge * edge_to = getGraphPairwise().m_vEdges[e_t].get();
-					calculateMessage(*edge_to, temp, getMessage(e_t));
-					isReady[e_t] = true;
-					// ------
-					size_t n1 = edge_to->node1;
-					size_t n2 = edge_to->node2;
-					auto it = std::find_if(getGraphPairwise().m_vNodes[n1]->from.begin(), getGraphPairwise().m_vNodes[n1]->from.end(), [&](size_t e) {
-						return (getGraphPairwise().m_vEdges[e]->node1 == n2);
-					});
-					if (it != getGraphPairwise().m_vNodes[n1]->from.end())
-						suspend[*it] = true;
-					// ------
-					
-					nFromEdges[n2]--;
-					if (nFromEdges[n2] <= 1) nodeQueue.push_back(n2);
+				// the neighbours, connected with the incoming edges m -> n
+				for (size_t e_f : getInEdges(n)) {
+					const size_t m = getEdgeSrc(e_f);
+					if (vLevel[m] == NONE) {
+						vLevel[m] = vLevel[n] + 1;
+						vQueue.push_back(m);
+					}
+					if (vLevel[m] == vLevel[n] + 1 && vUpEdge[m] == NONE) vUpEdge[m] = e_f;
 				}
-			}
-		} // while
-
-		delete[] temp;
-		delete[] nFromEdges;
+			} // i
+		} // root
 	}
 }
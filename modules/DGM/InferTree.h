@@ -10,6 +10,9 @@ namespace DirectGraphicalModels
 	/**
 	* @ingroup moduleDecode
 	* @brief Inference for tree graphs (undirected graphs without loops)
+	* @details The messages are calculated in two passes over the breadth-first levels of the trees: upward (from the leafs to the roots) and 
+	* downward (from the roots to the leafs). The nodes of one level are independent and are processed in parallel. 
+	* The level ordering and the edges between every node and its parent are precomputed once per inference.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	* @todo Check the application of this class to DAGs and mixed graphs
 	*/
@@ -20,7 +23,7 @@ namespace DirectGraphicalModels
 		* @brief Constructor
 		* @param graph The graph
 		*/
-		DllExport CInferTree(CGraphPairwise & graph) : CMessagePassing(graph) {}
+		DllExport CInferTree(IGraphPairwise &graph) : CMessagePassing(graph) {}
 		DllExport virtual ~CInferTree(void) = default;
 
 
@@ -31,5 +34,15 @@ namespace DirectGraphicalModels
 		* @param nIt is not used
 		*/
 		DllExport virtual void calculateMessages(unsigned int nIt);
+
+
+	private:
+		/**
+		* @brief Calculates the breadth-first levels of the trees
+		* @param[out] vLevels The nodes of every level; the level 0 contains the roots: the first nodes of every connected component
+		* @param[out] vUpEdge The edges from every node to its parent (or -1 if there is no such edge)
+		* @param[out] vDownEdge The edges from the parent to every node (or -1 if there is no such edge)
+		*/
+		void getLevels(std::vector<vec_size_t> &vLevels, vec_size_t &vUpEdge, vec_size_t &vDownEdge) const;
 	};
 }
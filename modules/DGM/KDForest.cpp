@@ -0,0 +1,163 @@
+#include "KDForest.h"
+#include "ModelFile.h"
+#include "parallel.h"
+#include "footprint.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	// Constructor
+	CKDForest::CKDForest(size_t bufferSize) : m_bufferSize(bufferSize)
+	{
+		DGM_ASSERT_MSG(bufferSize > 0, "The size of the buffer must be positive");
+	}
+
+	void CKDForest::reset(void)
+	{
+		m_vpTrees.clear();
+		m_bufferKeys.release();
+		m_bufferValues.release();
+		m_k = 0;
+	}
+
+	size_t CKDForest::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vpTrees) + footprint::getBytes(m_bufferKeys) + footprint::getBytes(m_bufferValues);
+		for (const auto &pTree : m_vpTrees)
+			if (pTree) res += pTree->getMemoryUsage();
+		return res;
+	}
+
+	void CKDForest::save(CModelFileWriter &writer, const std::string &prefix) const
+	{
+		Mat levels(1, MAX(1, static_cast<int>(m_vpTrees.size())), CV_8UC1, Scalar(0));
+		for (size_t l = 0; l < m_vpTrees.size(); l++)
+			if (m_vpTrees[l]) {
+				levels.at<byte>(0, static_cast<int>(l)) = 1;
+				m_vpTrees[l]->save(writer, prefix + "." + std::to_string(l));
+			}
+		writer.addSection(prefix + ".levels", levels);
+		if (!m_bufferKeys.empty()) {
+			writer.addSection(prefix + ".bufferKeys", m_bufferKeys);
+			writer.addSection(prefix + ".bufferValues", m_bufferValues);
+		}
+	}
+
+	void CKDForest::load(const CModelFile &file, const std::string &prefix)
+	{
+		reset();
+		const Mat levels = file.getSection(prefix + ".levels");
+		m_vpTrees.resize(levels.cols);
+		for (int l = 0; l < levels.cols; l++)
+			if (levels.at<byte>(0, l)) {
+				m_vpTrees[l] = std::make_unique<CKDTree>();
+				m_vpTrees[l]->load(file, prefix + "." + std::to_string(l));
+			}
+		while (!m_vpTrees.empty() && !m_vpTrees.back()) m_vpTrees.pop_back();
+		for (const auto &pTree : m_vpTrees)
+			if (pTree && pTree->getNumKeys()) {
+				Mat keys, values;
+				pTree->getKeys(keys, values);
+				m_k = keys.cols;
+			}
+		if (file.hasSection(prefix + ".bufferKeys")) {
+			file.getSection(prefix + ".bufferKeys").copyTo(m_bufferKeys);
+			file.getSection(prefix + ".bufferValues").copyTo(m_bufferValues);
+			m_k = m_bufferKeys.cols;
+		}
+	}
+
+	void CKDForest::add(const Mat &keys, const Mat &values)
+	{
+		if (keys.empty()) return;
+		DGM_ASSERT_MSG(keys.type() == CV_8UC1, "Incorrect type of the keys");
+		DGM_ASSERT_MSG(values.type() == CV_8UC1, "Incorrect type of the values");
+		DGM_ASSERT_MSG(keys.rows == values.rows, "The amount of keys (%d) does not crrespond to the amount of values (%d)", keys.rows, values.rows);
+		DGM_ASSERT_MSG(m_k == 0 || m_k == keys.cols, "The dimensionality of the keys (%d) does not correspond to the dimensionality of the forest (%d)", keys.cols, m_k);
+		m_k = keys.cols;
+
+		m_bufferKeys.push_back(keys);
+		m_bufferValues.push_back(values);
+		if (static_cast<size_t>(m_bufferKeys.rows) >= m_bufferSize) flush();
+	}
+
+	void CKDForest::knnSearch(const Mat &queries, size_t k, Mat &labels, size_t maxLeafVisits) const
+	{
+		DGM_ASSERT_MSG(queries.type() == CV_8UC1, "Incorrect type of the queries");
+		const int nNeighbors = static_cast<int>(MIN(k, getNumKeys()));
+		if (nNeighbors == 0) {
+			DGM_WARNING("The k-D forest is empty");
+			labels.release();
+			return;
+		}
+
+		// The candidates of every tree
+		vec_mat_t vLabels, vDistances;
+		for (const auto &pTree : m_vpTrees) {
+			if (!pTree || pTree->getNumKeys() == 0) continue;
+			vLabels.emplace_back();
+			vDistances.emplace_back();
+			pTree->knnSearch(queries, k, vLabels.back(), vDistances.back(), maxLeafVisits);
+		}
+
+		labels.create(queries.rows, nNeighbors, CV_8UC1);
+		parallel::parallelFor(Range(0, queries.rows), [&](const Range &range) {
+			std::vector<std::pair<int, int>> vCandidates;								// (squared distance, label)
+			for (int q = range.start; q < range.end; q++) {
+				const byte *pQuery = queries.ptr<byte>(q);
+				vCandidates.clear();
+				for (size_t t = 0; t < vLabels.size(); t++) {
+					const byte *pLabels		= vLabels[t].ptr<byte>(q);
+					const int  *pDistances	= vDistances[t].ptr<int>(q);
+					for (int i = 0; i < vLabels[t].cols; i++) vCandidates.emplace_back(pDistances[i], pLabels[i]);
+				} // t
+				for (int i = 0; i < m_bufferKeys.rows; i++) {							// the buffer is searched exhaustively
+					const byte *pKey = m_bufferKeys.ptr<byte>(i);
+					int dist = 0;
+					for (int d = 0; d < m_bufferKeys.cols; d++) dist += (pQuery[d] - pKey[d]) * (pQuery[d] - pKey[d]);
+					vCandidates.emplace_back(dist, m_bufferValues.at<byte>(i, 0));
+				} // i
+
+				std::partial_sort(vCandidates.begin(), vCandidates.begin() + nNeighbors, vCandidates.end());
+				byte *pLabels = labels.ptr<byte>(q);
+				for (int i = 0; i < nNeighbors; i++) pLabels[i] = static_cast<byte>(vCandidates[i].second);
+			} // q
+		}, 64);
+	}
+
+	size_t CKDForest::getNumKeys(void) const
+	{
+		size_t res = m_bufferKeys.rows;
+		for (const auto &pTree : m_vpTrees)
+			if (pTree) res += pTree->getNumKeys();
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The buffer goes to the lowest level, which may hold it; the trees of the lower and of the occupied levels are merged into it
+	void CKDForest::flush(void)
+	{
+		Mat keys	= m_bufferKeys;
+		Mat values	= m_bufferValues;
+		m_bufferKeys	= Mat();
+		m_bufferValues	= Mat();
+
+		size_t level = 0;
+		while ((m_bufferSize << level) < static_cast<size_t>(keys.rows)) level++;
+		for (size_t l = 0; l < m_vpTrees.size() && (l < level || m_vpTrees[l]); l++) {
+			if (m_vpTrees[l]) {
+				Mat treeKeys, treeValues;
+				m_vpTrees[l]->getKeys(treeKeys, treeValues);
+				keys.push_back(treeKeys);
+				values.push_back(treeValues);
+				m_vpTrees[l].reset();
+			}
+			level = MAX(level, l + 1);
+			while ((m_bufferSize << level) < static_cast<size_t>(keys.rows)) level++;
+		} // l
+
+		if (m_vpTrees.size() <= level) m_vpTrees.resize(level + 1);
+		m_vpTrees[level] = std::make_unique<CKDTree>();
+		m_vpTrees[level]->build(keys, values);
+	}
+}
@@ -0,0 +1,102 @@
+// Logarithmic k-Dimensional Forest class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "KDTree.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ k-D Forest Class ================================
+	/**
+	* @brief Class implementing the dynamic k-D Tree index with the logarithmic method
+	* @details The static @ref CKDTree must be rebuilt from all the keys, when new keys are added. This class keeps the keys in a forest of the static trees
+	* (Bentley-Saxe): the tree of level \a i holds about \f$B \cdot 2^i\f$ keys, where \a B is the size of the buffer. The new keys are collected in the buffer,
+	* which is searched exhaustively; a full buffer is built into a tree of level 0, and two trees of the same level are merged into one tree of the next level.
+	* Hence, a key is rebuilt \f$O(\log n)\f$ times, and a query searches \f$O(\log n)\f$ trees:
+	* @code
+	* CKDForest forest;
+	* forest.add(keys, values);														// the initial training data
+	* forest.add(newKeys, newValues);												// some more labelled samples, without rebuilding the whole index
+	* forest.knnSearch(queries, 100, labels);
+	* @endcode
+	* > The duplicated pairs (key, value) are removed within every tree, but may persist in different trees
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CKDForest
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param bufferSize The number of keys \a B, which are collected before building a new tree
+		*/
+		DllExport CKDForest(size_t bufferSize = 4096);
+		DllExport CKDForest(const CKDForest&) = delete;
+		DllExport ~CKDForest(void) = default;
+
+		DllExport bool			operator=(const CKDForest&) = delete;
+
+		/**
+		* @brief Resets the forest
+		*/
+		DllExport void			reset(void);
+		/**
+		* @brief Returns the memory, used by the forest
+		* @return The size of the forest in bytes
+		*/
+		DllExport size_t		getMemoryUsage(void) const;
+		/**
+		* @brief Adds the forest to a model container
+		* @details The flags of the non-empty levels are stored in the section \a <prefix>.levels, and every tree in the sections \a <prefix>.<level>.nodes,
+		* \a <prefix>.<level>.keys and \a <prefix>.<level>.values (ref. CKDTree::save(CModelFileWriter &, const std::string &) const). The buffer is stored in the
+		* sections \a <prefix>.bufferKeys and \a <prefix>.bufferValues
+		* @param writer The writer of the model container
+		* @param prefix The prefix of the names of the sections
+		*/
+		DllExport void			save(CModelFileWriter &writer, const std::string &prefix) const;
+		/**
+		* @brief Loads a forest from a model container
+		* @param file The model container
+		* @param prefix The prefix of the names of the sections
+		*/
+		DllExport void			load(const CModelFile &file, const std::string &prefix);
+		/**
+		* @brief Adds new keys with corresponding values
+		* @details The work per key is amortized \f$O(\log n)\f$ tree builds
+		* @param keys The keys: k-d points: Mat(size: nKeys x k; type: CV_8UC1)
+		* @param values The values for every key: Mat(size: nKeys x 1; type: CV_8UC1)
+		*/
+		DllExport void			add(const Mat &keys, const Mat &values);
+		/**
+		* @brief Finds the \b k nearest neighbors for every query in the block
+		* @details Every tree is searched with CKDTree::knnSearch() and the buffer exhaustively, and the \b k closest results are selected.
+		* The queries are processed in parallel.
+		* @param queries The search keys: k-d points: Mat(size: nQueries x k; type: CV_8UC1)
+		* @param k The number of the nearest neighbors to find
+		* @param labels The values of the found neighbors, sorted by the increasing distance to the query: Mat(size: nQueries x min(\b k, nKeys); type: CV_8UC1)
+		* @param maxLeafVisits The maximal number of the visited leaves per query and tree. 0 means the exact search
+		*/
+		DllExport void			knnSearch(const Mat &queries, size_t k, Mat &labels, size_t maxLeafVisits = 0) const;
+		/**
+		* @brief Returns the number of keys
+		* @return The number of keys in all the trees and in the buffer
+		*/
+		DllExport size_t		getNumKeys(void) const;
+		/**
+		* @brief Returns the number of the levels of the forest
+		* @return The number of the levels, some of which may be empty
+		*/
+		DllExport size_t		getNumLevels(void) const { return m_vpTrees.size(); }
+
+
+	private:
+		void					flush(void);				// Builds the buffer into a tree, merging the trees of the same level
+
+
+	private:
+		size_t									m_bufferSize;		///< The maximal number of keys in the buffer
+		std::vector<std::unique_ptr<CKDTree>>	m_vpTrees;			///< The trees of all the levels: nullptr for the empty levels
+		Mat										m_bufferKeys;		///< The keys, which are not in the trees yet: Mat(size: nKeys x k; type: CV_8UC1)
+		Mat										m_bufferValues;		///< The values of the keys in the buffer: Mat(size: nKeys x 1; type: CV_8UC1)
+		int										m_k = 0;			///< The dimensionality of the keys
+	};
+}
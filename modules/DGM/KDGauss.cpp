@@ -1,4 +1,5 @@
 #include "KDGauss.h"
+#include "Arena.h"
 #include "random.h"
 #include "mathop.h"
 #include "macroses.h"
@@ -7,6 +8,7 @@ namespace DirectGraphicalModels
 {
 	// Constants
 	const bool CKDGauss::USE_SAFE_SIGMA = false;
+	const size_t CKDGauss::RANK_ONE_REFRESH = 256;
 
 	// Constructor
 	CKDGauss::CKDGauss(dword k) {
@@ -31,6 +33,9 @@ namespace DirectGraphicalModels
 		this->m_sigmaInv	= rhs.m_sigmaInv.empty() ? Mat() : rhs.m_sigmaInv.clone();
 		this->m_Q			= rhs.m_Q.empty() ? Mat() : rhs.m_Q.clone();
 		this->m_alpha		= rhs.m_alpha;
+		this->m_logAlpha	= rhs.m_logAlpha;
+		this->m_logDet		= rhs.m_logDet;
+		this->m_nRankOneUpdates = rhs.m_nRankOneUpdates;
 	}
 
 	// Copy Operator
@@ -42,6 +47,9 @@ namespace DirectGraphicalModels
 			this->m_sigmaInv	= rhs.m_sigmaInv.empty() ? Mat() : rhs.m_sigmaInv.clone();
 			this->m_Q			= rhs.m_Q.empty() ? Mat() : rhs.m_Q.clone();
 			this->m_alpha		= rhs.m_alpha;
+			this->m_logAlpha	= rhs.m_logAlpha;
+			this->m_logDet		= rhs.m_logDet;
+			this->m_nRankOneUpdates = rhs.m_nRankOneUpdates;
 		}
 		return *this;
 	}
@@ -87,48 +95,78 @@ namespace DirectGraphicalModels
 		reset_SigmaInv_Q_Alpha();
 	}
 
+	void CKDGauss::finalize(void)
+	{
+		getSigmaInv();
+		getAlpha();
+		if (m_Q.empty()) m_Q = calculateQ();
+	}
+
 	void CKDGauss::addPoint(const Mat &point, bool approximate)
 	{
 		// Assertions
 		DGM_ASSERT_MSG(point.size() == m_mu.size(), "Wrong input point size");
 		DGM_ASSERT_MSG(point.type() == m_mu.type(), "Wrong input point type");
 
-		if (m_nPoints == 0) point.copyTo(m_mu);
-		else {
-			long double a = static_cast<long double>(m_nPoints) / (m_nPoints + 1);
-			
-			if (approximate) { // ---------------- approximate calculation of sigma ----------------
-				addWeighted(m_mu, a, point, (1.0 - a), 0.0, m_mu);				// mu = a * mu + (1-a) * point
-
-				// fast matrix multiplation (faster than OpenCV gemm())
-				// sigma^ = a * sigma1 + (1 - a) * (point * point^t - mu1 * mu1^T) 				
-				for (int y = 0; y < m_sigma.rows; y++) {
-					double *pSigma = m_sigma.ptr<double>(y);
-					for (int x = 0; x < m_sigma.cols; x++) {
-						double cr = (point.at<double>(x, 0) - m_mu.at<double>(x, 0)) * (point.at<double>(y, 0) - m_mu.at<double>(y, 0));
-						pSigma[x] = cr + static_cast<double>(a * (pSigma[x] - cr));
-					} // x
-				} // y				
+		if (m_nPoints == 0) {
+			point.copyTo(m_mu);
+			m_nPoints++;
+			reset_SigmaInv_Q_Alpha();
+			return;
+		}
+
+		// Both update rules are the rank-1 updates sigma^ = a * (sigma + beta * d * d^T) with d = point - mu:
+		// the exact rule with beta = 1 - a and the approximate one, where d is taken to the updated mu, with beta = (1 - a) * a
+		const int	 k		= m_mu.rows;
+		const double a		= static_cast<double>(m_nPoints) / (m_nPoints + 1);
+		const double beta	= approximate ? (1 - a) * a : 1 - a;
+		double		*d		= CArena::getScratch<double>(2 * k, 3);
+		double		*z		= d + k;
+		for (int i = 0; i < k; i++) d[i] = point.at<double>(i, 0) - m_mu.at<double>(i, 0);
+
+		// The cached inverse is updated with the Sherman-Morrison formula; z = sigma^-1 * d must lie in the range of sigma, otherwise the pseudo-inverse changes its rank
+		bool rankOne = !m_sigmaInv.empty() && m_nRankOneUpdates < RANK_ONE_REFRESH;
+		double denom = 1;
+		if (rankOne) {
+			double q = 0, dd = 0, err = 0;
+			for (int i = 0; i < k; i++) {
+				const double *pSigmaInv = m_sigmaInv.ptr<double>(i);
+				double sum = 0;
+				for (int j = 0; j < k; j++) sum += pSigmaInv[j] * d[j];
+				z[i] = sum;
+				q	+= d[i] * sum;
+				dd	+= d[i] * d[i];
 			}
-			else { // ---------------- general exact calculation of sigma ----------------
-				Mat mu;
-				addWeighted(this->m_mu, a, point, 1.0 - a, 0.0, mu);	// mu^ = a * mu1 + (1- a) * point
-
-																		// fast matrix multiplation (faster than OpenCV gemm())
-																		// sigma^ = a * (sigma1 + mu1 * mu1^t) + (1 - a) * point * point^t - mu^ * mu^^T 
-				for (int y = 0; y < m_sigma.rows; y++) {
-					double *pSigma = m_sigma.ptr<double>(y);
-					for (int x = 0; x < m_sigma.cols; x++) {
-						pSigma[x] = static_cast<double>(a * (pSigma[x] + m_mu.at<double>(x, 0) * m_mu.at<double>(y, 0)) +
-							(1.0 - a) *  point.at<double>(x, 0) * point.at<double>(y, 0) -
-							mu.at<double>(x, 0) * mu.at<double>(y, 0));
-					} // x
-				} // y
-				this->m_mu = mu;
+			for (int i = 0; i < k; i++) {
+				const double *pSigma = m_sigma.ptr<double>(i);
+				double sum = 0;
+				for (int j = 0; j < k; j++) sum += pSigma[j] * z[j];
+				err += (sum - d[i]) * (sum - d[i]);
 			}
+			denom	= 1 + beta * q;
+			rankOne = err <= 1e-12 * dd && denom > DBL_EPSILON;
 		}
+
+		for (int y = 0; y < k; y++) {
+			double *pSigma = m_sigma.ptr<double>(y);
+			for (int x = 0; x < k; x++) pSigma[x] = a * (pSigma[x] + beta * d[y] * d[x]);
+		} // y
+		for (int i = 0; i < k; i++) m_mu.at<double>(i, 0) += (1 - a) * d[i];
 		m_nPoints++;
-		reset_SigmaInv_Q_Alpha();
+
+		if (!rankOne) {
+			reset_SigmaInv_Q_Alpha();
+			return;
+		}
+		// sigma^-1 = (sigma^-1 - beta * z * z^T / denom) / a,  ln|sigma^| = ln|sigma| + k * ln(a) + ln(denom)
+		const double c = beta / denom;
+		for (int y = 0; y < k; y++) {
+			double *pSigmaInv = m_sigmaInv.ptr<double>(y);
+			for (int x = 0; x < k; x++) pSigmaInv[x] = (pSigmaInv[x] - c * z[y] * z[x]) / a;
+		} // y
+		m_nRankOneUpdates++;
+		if (!m_Q.empty()) m_Q.release();
+		if (m_alpha >= 0) setLogDet(m_logDet + k * log(a) + log(denom));
 	}
 
 	void CKDGauss::setMu(const Mat& mu)
@@ -155,35 +193,43 @@ namespace DirectGraphicalModels
 
 	Mat CKDGauss::getSigmaInv(void) const
 	{
-		if (m_sigmaInv.empty()) invert(m_sigma, m_sigmaInv, DECOMP_SVD);	// sigmaInv = sigma^-1
+		if (m_sigmaInv.empty()) {
+			invert(m_sigma, m_sigmaInv, DECOMP_SVD);						// sigmaInv = sigma^-1
+			m_nRankOneUpdates = 0;
+		}
 		
         return m_sigmaInv;
 	}
 
 	long double CKDGauss::getAlpha(void) const
 	{
-		if (m_alpha < 0) {
-            int k = m_sigma.cols;
-            long double det = MAX(LDBL_EPSILON, sqrtl(static_cast<long double>(determinant(m_sigma))));
-            long double sPi = powl(2 * static_cast<long double>(Pi), static_cast<long double>(k) / 2);
-            m_alpha = 1 / (det * sPi);
-		}
+		if (m_alpha < 0) setLogDet(log(determinant(m_sigma)));
 		
         return m_alpha;
 	}
 
-	double CKDGauss::getValue(const Mat& x, Mat &X, Mat &p1, Mat &p2) const
+	double CKDGauss::getLogAlpha(void) const
+	{
+		getAlpha();
+		return m_logAlpha;
+	}
+
+	double CKDGauss::getValue(const Mat& x, Mat &, Mat &, Mat &) const
 	{
 		// Assertions
 		DGM_ASSERT_MSG(x.size() == m_mu.size(), "Wrong x size");
 		DGM_ASSERT_MSG(x.type() == m_mu.type(), "Wrong x type");
 
-		subtract(x, m_mu, X);							// X = x - mu
-		gemm(getSigmaInv(), X, 1.0, Mat(), 0.0, p1, 0);
-		gemm(X, p1, 1.0, Mat(), 0.0, p2, GEMM_1_T);
-		double value = -0.5 * p2.at<double>(0, 0);		// val = -0.5 * (X-mu)^T * Sigma^-1 * (X-mu)
+		return exp(-0.5 * getQuadraticForm(x));			// val = -0.5 * (X-mu)^T * Sigma^-1 * (X-mu)
+	}
+
+	double CKDGauss::getLogValue(const Mat &x) const
+	{
+		// Assertions
+		DGM_ASSERT_MSG(x.size() == m_mu.size(), "Wrong x size");
+		DGM_ASSERT_MSG(x.type() == m_mu.type(), "Wrong x type");
 
-		return exp(value);
+		return getLogAlpha() - 0.5 * getQuadraticForm(x);
 	}
 
 	double CKDGauss::getEuclidianDistance(const Mat &x) const
@@ -195,13 +241,29 @@ namespace DirectGraphicalModels
 		return mathop::Euclidian<double, double>(m_mu, x);
 	}
 
+	double CKDGauss::getEuclidianDistance(const Mat &x, double maxDist) const
+	{
+		// Assertions
+		DGM_ASSERT_MSG(x.size() == m_mu.size(), "Wrong x size");
+		DGM_ASSERT_MSG(x.type() == m_mu.type(), "Wrong x type");
+
+		const double maxDist2 = maxDist * maxDist;
+		double		 res	  = 0;
+		for (int i = 0; i < m_mu.rows; i++) {
+			const double di = x.at<double>(i, 0) - m_mu.at<double>(i, 0);
+			res += di * di;
+			if (res > maxDist2) break;													// the partial sum is a lower bound
+		} // i
+		return sqrt(res);
+	}
+
 	double CKDGauss::getMahalanobisDistance(const Mat &x) const
 	{
 		// Assertions
 		DGM_ASSERT_MSG(x.size() == m_mu.size(), "Wrong x size");
 		DGM_ASSERT_MSG(x.type() == m_mu.type(), "Wrong x type");
 
-		return static_cast<double>(Mahalanobis(x, m_mu, getSigmaInv()));
+		return sqrt(MAX(0.0, getQuadraticForm(x)));
 	}
 
 	double CKDGauss::getKullbackLeiberDivergence(const CKDGauss &x) const
@@ -219,7 +281,9 @@ namespace DirectGraphicalModels
 
 		int k = m_mu.rows;
 
-		double ln = log(determinant(m_sigma) / determinant(x.getSigma()));
+		getAlpha();
+		x.getAlpha();
+		double ln = m_logDet - x.m_logDet;											// ln(|sigma| / |sigma_x|)
 
 		double res = static_cast<double>(tr.val[0] + dst*dst - k - ln) / 2;
 
@@ -246,6 +310,33 @@ namespace DirectGraphicalModels
 		m_alpha = -1.0;
 	}
 
+	void CKDGauss::setLogDet(double logDet) const
+	{
+		const int		  k		= m_sigma.cols;
+		const long double det	= MAX(LDBL_EPSILON, expl(0.5L * logDet));			// sqrt(|sigma|)
+		const long double sPi	= powl(2 * static_cast<long double>(Pi), static_cast<long double>(k) / 2);
+		m_logDet	= logDet;
+		m_alpha		= 1 / (det * sPi);
+		m_logAlpha	= -static_cast<double>(logl(det)) - 0.5 * k * log(2 * Pi);
+	}
+
+	// The symmetric Sigma^-1 is traversed only above the diagonal; x - mu is not stored
+	double CKDGauss::getQuadraticForm(const Mat &x) const
+	{
+		if (m_sigmaInv.empty()) getSigmaInv();
+
+		const int k	  = m_mu.rows;
+		double	  res = 0;
+		for (int i = 0; i < k; i++) {
+			const double *pSigmaInv = m_sigmaInv.ptr<double>(i);
+			const double  di		= x.at<double>(i, 0) - m_mu.at<double>(i, 0);
+			double		  sum		= 0.5 * pSigmaInv[i] * di;
+			for (int j = i + 1; j < k; j++) sum += pSigmaInv[j] * (x.at<double>(j, 0) - m_mu.at<double>(j, 0));
+			res += di * sum;
+		} // i
+		return 2 * res;
+	}
+
 	Mat CKDGauss::calculateQ(void) const
 	{
 		int D = m_mu.rows;	// dimension
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include "footprint.h"
 
 namespace DirectGraphicalModels
 {
@@ -23,6 +24,10 @@ namespace DirectGraphicalModels
 	* @endcode
 	*
 	* In order to generate a random sample from the distribution, given by Gaussian function \f$ \mathcal{N}(\mu,\Sigma) \f$, one uses function getSample().
+	*
+	* The inverse covariance matrix \f$\Sigma^{-1}\f$, the coefficient \f$\alpha\f$ and its logarithm are calculated on the first use and cached until
+	* the parameters change. Before the Gaussian is evaluated concurrently, \a e.g. from the parallel loops of the node trainers, these caches must be
+	* filled with finalize(): afterwards getValue(), getLogValue(), getAlpha(), getLogAlpha() and getMahalanobisDistance() only read the Gaussian and allocate no memory.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CKDGauss
@@ -79,6 +84,12 @@ namespace DirectGraphicalModels
 		*/
 		DllExport void			clear(void);
 		/**
+		* @brief Calculates all the cached quantities of the Gaussian
+		* @details Calculates \f$\Sigma^{-1}\f$, \f$\alpha\f$, \f$\ln\alpha\f$ and the auxilary matrix of getSample() at once, so that the following 
+		* evaluations are PPL-safe. The caches are reset by every non-constant method
+		*/
+		DllExport void			finalize(void);
+		/**
 		* @brief Checks weather the Gaussian function is approximated
 		* @retval TRUE if the Gaussian had at least 1 point for approximation, or
 		* @retval FALSE otherwise
@@ -117,6 +128,11 @@ namespace DirectGraphicalModels
 		* @return the covariance matrix \f$\Sigma\f$: Mat(size: k x k; type: CV_64FC1)
 		*/
 		DllExport Mat			getSigma(void) const { return m_sigma.clone(); }
+		/**
+		* @brief Returns the memory, used by the Gaussian
+		* @return The size of the Gaussian and of its cached matrices in bytes
+		*/
+		DllExport size_t		getMemoryUsage(void) const { return sizeof(*this) + footprint::getBytes(m_mu) + footprint::getBytes(m_sigma) + footprint::getBytes(m_sigmaInv) + footprint::getBytes(m_Q); }
 		///@}
 		
 		///@{
@@ -136,6 +152,9 @@ namespace DirectGraphicalModels
 		* @param approximate Flag indicating whether a faster approximation of the update rule for \f$\Sigma\f$ should be used:
 		* \f$ \hat{\Sigma} = \frac{n\Sigma + (p-\hat{\mu})(p-\hat{\mu})^\top}{n + 1} \f$.
 		* For large \f$n\f$ this approximation is equevalent to the original update rool.
+		* @note Both rules are the rank-1 updates of \f$\Sigma\f$. If \f$\Sigma^{-1}\f$ has been calculated before, it is updated with the Sherman-Morrison formula
+		* together with \f$\alpha\f$ in \f$O(k^2)\f$, instead of being re-calculated in \f$O(k^3)\f$ on the next use. To bound the accumulation of the rounding errors,
+		* the inverse is re-calculated after every 256 such updates.
 		*/
 		DllExport void			addPoint(const Mat &point, bool approximate = false);
 		/**
@@ -144,6 +163,12 @@ namespace DirectGraphicalModels
 		*/
 		DllExport long double	getAlpha(void) const;
 		/**
+		* @brief Returns \f$\ln\alpha\f$.
+		* @details The logarithm is calculated from the log-determinant of \f$\Sigma\f$, thus does not underflow for the high dimensions
+		* @return The logarithm of the Gaussian coefficient \f$\alpha\f$.
+		*/
+		DllExport double		getLogAlpha(void) const;
+		/**
 		* @brief Returns unscaled value of the Gaussian function
 		* @details This function returns unscaled value of the Gaussian function, \a i.e. \f$ \exp\big( -\frac{1}{2}(x-\mu)^T\Sigma^{-1}(x-\mu)\big) \f$. In order to
 		* get the value of \f$ \mathcal{N}_k(\mu,\Sigma) \f$, the output of this function must be multiplied with \f$ \alpha \f$ from the getAlpha() function.
@@ -157,7 +182,7 @@ namespace DirectGraphicalModels
 		* @code
 		* for (int i = 0; i < 100; i++) y[i] = getValue(x[i]);
 		* @endcode
-		* > This function is PPL-safe function.
+		* > This function is PPL-safe function after finalize(). It allocates no memory, thus the auxilary parameters are not used.
 		* @param x n-dimensional point (sample): Mat(size: k x 1; type: CV_64FC1)
 		* @param aux1 Auxilary variable
 		* @param aux2 Auxilary variable
@@ -166,6 +191,14 @@ namespace DirectGraphicalModels
 		*/
 		DllExport double		getValue(const Mat& x, Mat &aux1 = EmptyMat, Mat &aux2 = EmptyMat, Mat &aux3 = EmptyMat) const;
 		/**
+		* @brief Returns the logarithm of the Gaussian function
+		* @details This function returns \f$ \ln\mathcal{N}_k(\mu,\Sigma) = \ln\alpha - \frac{1}{2}(x-\mu)^T\Sigma^{-1}(x-\mu) \f$, which does not underflow far from \f$\mu\f$
+		* > This function is PPL-safe function after finalize()
+		* @param x n-dimensional point (sample): Mat(size: k x 1; type: CV_64FC1)
+		* @return The logarithm of the scaled value of the Gaussian function
+		*/
+		DllExport double		getLogValue(const Mat &x) const;
+		/**
 		* @brief Returns a random vector (sample) from multivariate normal distribution
 		* @details The implementation is based on the paper <a target=blank href="ftp://ftp.dca.fee.unicamp.br/pub/docs/vonzuben/ia013_2s09/material_de_apoio/gen_rand_multivar.pdf">Generating Random Vectors from the Multivariate Normal Distribution</a>
 		* @return n-dimensional point (sample): Mat(size: k x 1; type: CV_64FC1)
@@ -183,6 +216,14 @@ namespace DirectGraphicalModels
 		*/
 		DllExport double		getEuclidianDistance(const Mat &x) const;
 		/**
+		* @brief Returns the Euclidian distance between argument point \b x and \f$\mu\f$, if it is smaller than the given bound
+		* @details The summation stops as soon as the partial sum exceeds \b maxDist, which allows for the fast search of the nearest Gaussian
+		* @param x A k-dimensional point (sample): Mat(size: k x 1; type: CV_64FC1)
+		* @param maxDist The bound of the distance
+		* @return The Euclidian distance \f$D_E(x)\f$ if it does not exceed \b maxDist, or a value larger than \b maxDist otherwise
+		*/
+		DllExport double		getEuclidianDistance(const Mat &x, double maxDist) const;
+		/**
 		* @brief Returns the Mahalanobis distance between argument point \b x and the center of multivariate normal distribution \f$\mathcal{N}(\mu,\Sigma)\f$.
 		* @details The Mahalanobis distance is calculated by the formula: \f$D_M(\mathcal{N};x)=\sqrt{ (x-\mu)^\top\Sigma^{-1}(x-\mu) }\f$
 		* @param x n-dimensional point (sample): Mat(size: k x 1; type: CV_64FC1)
@@ -204,7 +245,8 @@ namespace DirectGraphicalModels
 
 
 	private:
-		static const bool USE_SAFE_SIGMA;
+		static const bool	USE_SAFE_SIGMA;
+		static const size_t	RANK_ONE_REFRESH;			// the number of the rank-1 updates of the inverse before it is re-calculated
 
 	
 	private:
@@ -214,6 +256,9 @@ namespace DirectGraphicalModels
 		mutable Mat			  m_sigmaInv	= Mat();	// the inverse to the <sigma> matrix
 		mutable Mat			  m_Q			= Mat();	// aux Mat for getSample()
 		mutable long double	  m_alpha		= -1;		// gaussian coefficient
+		mutable double		  m_logAlpha	= 0;		// logarithm of the gaussian coefficient (valid if m_alpha >= 0)
+		mutable double		  m_logDet		= 0;		// logarithm of the determinant of the <sigma> matrix (valid if m_alpha >= 0)
+		mutable size_t		  m_nRankOneUpdates = 0;	// number of the rank-1 updates of the <sigmaInv> matrix since it was calculated
 
 	
 	private:		
@@ -223,7 +268,12 @@ namespace DirectGraphicalModels
 		* @return The inversed covariance matrix \f$\Sigma^{-1}\f$: Mat(size: k x k; type: CV_64FC1)
 		*/
 		Mat				getSigmaInv(void) const;
+		/**
+		* @brief Returns \f$(x-\mu)^T\Sigma^{-1}(x-\mu)\f$ without memory allocations
+		*/
+		double			getQuadraticForm(const Mat &x) const;
 		inline void		reset_SigmaInv_Q_Alpha(void);
+		void			setLogDet(double logDet) const;
 		Mat				calculateQ(void) const;
 	};
 
@@ -1,11 +1,25 @@
 #include "KDTree.h"
+#include "ModelFile.h"
 #include "random.h"
-#include "parallel.h"
+#include "macroses.h"
 #include "mathop.h"
+#include "footprint.h"
+#include "ThreadPool.h"
+#include <unordered_set>
 
 namespace DirectGraphicalModels
 {
 	namespace {
+		// Returns the size of the subtree and of the keys of its nodes in bytes
+		size_t getMemoryUsage(const std::shared_ptr<const CKDNode> &node)
+		{
+			if (!node) return 0;
+			const pair_mat_t boundingBox = node->getBoundingBox();
+			size_t res = sizeof(CKDNode) + footprint::getBytes(node->getKey());
+			if (!node->isLeaf()) res += footprint::getBytes(boundingBox.first) + footprint::getBytes(boundingBox.second) + getMemoryUsage(node->Left()) + getMemoryUsage(node->Right());
+			return res;
+		}
+
 		template<typename T>
 		pair_mat_t getBoundingBox(const Mat& data)
 		{
@@ -27,7 +41,7 @@ namespace DirectGraphicalModels
 		}
 
 		template<typename T>
-		int getSplitDimension(const pair_mat_t& boundingBox)
+		int getSplitDimension(const pair_mat_t& boundingBox, random::CPhilox &generator)
 		{
 			int		res = 0;
 			Mat		diff = boundingBox.second - boundingBox.first;		// diff = max - min
@@ -53,38 +67,160 @@ namespace DirectGraphicalModels
 
 			// Randomly choose one of the maximums
 			int x = 0;
-			int n = random::u<int>(1, nMaxs);
+			int n = random::u<int>(generator, 1, nMaxs);
 			for (x = 0; x < diff.cols; x++) {						// dimensions
 				if (maxMasc.at<byte>(0, x) == 1) n--;
 				if (n == 0) break;
 			} // x: dimensions
 			return x;
 		}
+
+		// The split of a node: the rows of the node are partitioned, such that the first nLeft rows belong to the left subtree
+		struct Split {
+			int		dim;
+			byte	val;
+			int		nLeft;
+		};
+
+		// Partitions in place the indexes pIdx[0; n) of the packed rows around the median of the split dimension
+		// The ties of the split dimension are broken with the random stream of the node, so the tree does not depend on the number of threads
+		Split partition(const byte *pData, int stride, int *pIdx, int n, const pair_mat_t &boundingBox, uint64_t node)
+		{
+			random::CPhilox generator = random::getStream(node);
+			Split res;
+			res.dim		= getSplitDimension<byte>(boundingBox, generator);
+			res.nLeft	= n / 2;
+			auto value = [&](int idx) { return pData[static_cast<size_t>(idx) * stride + res.dim]; };
+			if (n == 2) {
+				if (!(value(pIdx[0]) < value(pIdx[1]))) std::swap(pIdx[0], pIdx[1]);
+				res.val = (value(pIdx[0]) + value(pIdx[1])) / 2;
+			}
+			else {
+				std::nth_element(pIdx, pIdx + res.nLeft, pIdx + n, [&](int a, int b) { return value(a) < value(b); });
+				res.val = value(pIdx[res.nLeft]);
+			}
+			return res;
+		}
+
+		// left = [0; splitVal), right = [splitVal; end]
+		std::pair<pair_mat_t, pair_mat_t> splitBoundingBox(const pair_mat_t &boundingBox, const Split &split)
+		{
+			pair_mat_t boundingBoxLeft(boundingBox.first.clone(), boundingBox.second.clone());
+			pair_mat_t boundingBoxRight(boundingBox.first.clone(), boundingBox.second.clone());
+
+			boundingBoxLeft.second.at<byte>(0, split.dim) = split.val > 0 ? split.val - 1 : 0;
+			boundingBoxRight.first.at<byte>(0, split.dim) = split.val;
+			return std::make_pair(boundingBoxLeft, boundingBoxRight);
+		}
+
+		// data_i = [key,val]: k + 1 entries 
+		// The subtrees of the nodes with more than grain rows are built as parallel tasks; node is the index of the node in the breadth-first order, starting with 1 for the root
+		std::shared_ptr<CKDNode> buildTree(const byte *pData, int stride, int *pIdx, int n, const pair_mat_t &boundingBox, int grain = INT_MAX, uint64_t node = 1)
+		{
+			if (n == 1) {
+				const byte *pRow = pData + static_cast<size_t>(pIdx[0]) * stride;
+				return std::make_shared<CKDNode>(Mat(1, stride - 1, CV_8UC1, const_cast<byte *>(pRow)).clone(), pRow[stride - 1]);
+			}
+
+			Split split = partition(pData, stride, pIdx, n, boundingBox, node);
+			auto  boundingBoxes = n == 2 ? std::make_pair(boundingBox, boundingBox) : splitBoundingBox(boundingBox, split);		// the leaves do not use the bounding box
+			std::shared_ptr<CKDNode> left, right;
+			if (n > grain) {
+				CTaskGroup group;
+				group.run([&] { left = buildTree(pData, stride, pIdx, split.nLeft, boundingBoxes.first, grain, 2 * node); });
+				right = buildTree(pData, stride, pIdx + split.nLeft, n - split.nLeft, boundingBoxes.second, grain, 2 * node + 1);
+				group.wait();
+			}
+			else {
+				left  = buildTree(pData, stride, pIdx, split.nLeft, boundingBoxes.first, INT_MAX, 2 * node);
+				right = buildTree(pData, stride, pIdx + split.nLeft, n - split.nLeft, boundingBoxes.second, INT_MAX, 2 * node + 1);
+			}
+			return std::make_shared<CKDNode>(boundingBox, split.val, split.dim, left, right);
+		}
 	}
 	 
+	void CKDTree::reset(void)
+	{
+		m_root.reset();
+		m_vNodes.clear();
+		m_vKeys.clear();
+		m_vValues.clear();
+		m_k = 0;
+	}
+
+	size_t CKDTree::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vNodes) + footprint::getBytes(m_vKeys) + footprint::getBytes(m_vValues);
+		std::lock_guard<std::mutex> lock(m_mtxRoot);
+		return res + DirectGraphicalModels::getMemoryUsage(m_root);
+	}
+
 	void CKDTree::save(const std::string &fileName) const
 	{
-		if (!m_root) {
+		if (m_vNodes.empty()) {
 			DGM_WARNING("The k-D tree is not built");
 			return;
 		}
-		FILE *pFile = fopen(fileName.c_str(), "wb");
-		
-		// header
-		int k = m_root->getBoundingBox().first.cols;
-		fwrite(&k, sizeof(int), 1, pFile);				// dimensionality
-		m_root->save(pFile);
-		fclose(pFile);
+		CModelFileWriter writer;
+		save(writer, "KDTree");
+		writer.save(fileName);
 	}
 	
-	void CKDTree::load(const std::string &fileName)
+	void CKDTree::load(const std::string &fileName, bool mapped)
 	{
+		if (CModelFile::isModelFile(fileName)) {
+			load(*CModelFile::open(fileName, mapped), "KDTree");
+			return;
+		}
+
+		// legacy format: the nodes are stored recursively in the depth-first order
 		FILE *pFile = fopen(fileName.c_str(), "rb");
+		DGM_ASSERT_MSG(pFile, "Can't load data from %s", fileName.c_str());
 		// header
 		int k;
 		fread(&k, sizeof(int), 1, pFile);				// dimensionality
+		reset();
 		m_root = loadTree(pFile, k);
 		fclose(pFile);
+
+		m_k = k;
+		flatten(m_root);
+	}
+
+	// Every node is stored as a row of 3 integers: the right child (the key index for leaves), the split dimension (-1 for leaves) and the split value
+	void CKDTree::save(CModelFileWriter &writer, const std::string &prefix) const
+	{
+		Mat nodes(static_cast<int>(m_vNodes.size()), 3, CV_32SC1);
+		for (int n = 0; n < nodes.rows; n++) {
+			int *pNode = nodes.ptr<int>(n);
+			pNode[0] = m_vNodes[n].right;
+			pNode[1] = m_vNodes[n].splitDim;
+			pNode[2] = m_vNodes[n].splitVal;
+		}
+		const int nKeys = static_cast<int>(m_vValues.size());
+		writer.addSection(prefix + ".nodes", nodes);
+		writer.addSection(prefix + ".keys", Mat(nKeys, m_k, CV_8UC1, const_cast<byte *>(m_vKeys.data())));
+		writer.addSection(prefix + ".values", Mat(1, nKeys, CV_8UC1, const_cast<byte *>(m_vValues.data())));
+	}
+
+	void CKDTree::load(const CModelFile &file, const std::string &prefix)
+	{
+		const Mat nodes	 = file.getSection(prefix + ".nodes");
+		const Mat keys	 = file.getSection(prefix + ".keys");
+		const Mat values = file.getSection(prefix + ".values");
+		DGM_ASSERT_MSG(nodes.empty() || (nodes.type() == CV_32SC1 && nodes.cols == 3), "The k-D tree in the model file is corrupted");
+		DGM_ASSERT_MSG(keys.type() == CV_8UC1 && values.type() == CV_8UC1 && keys.rows == static_cast<int>(values.total()), "The k-D tree in the model file is corrupted");
+
+		reset();
+		m_k = keys.cols;
+		m_vNodes.resize(nodes.rows);
+		for (int n = 0; n < nodes.rows; n++) {
+			const int *pNode = nodes.ptr<int>(n);
+			m_vNodes[n] = { pNode[0], pNode[1], static_cast<byte>(pNode[2]) };
+		}
+		m_vKeys.assign(keys.data, keys.data + keys.total());
+		m_vValues.assign(values.data, values.data + values.total());
+		DGM_ASSERT_MSG(isValid(), "The k-D tree in the model file is corrupted");
 	}
 
 	void CKDTree::build(Mat &keys, Mat &values)
@@ -97,21 +233,38 @@ namespace DirectGraphicalModels
 		DGM_ASSERT_MSG(values.type() == CV_8UC1, "Incorrect type of the values");
 		DGM_ASSERT_MSG(keys.rows == values.rows, "The amount of keys (%d) does not crrespond to the amount of values (%d)", keys.rows, values.rows);
 		
-		pair_mat_t boundingBox = getBoundingBox<byte>(keys);
-		hconcat(keys, values, keys);							// keys = [keys; data]
+		const pair_mat_t	boundingBox	= getBoundingBox<byte>(keys);
+		const int			stride		= keys.cols + 1;
 
-		// Delete dublicated entries
-		parallel::sortRows<byte>(keys);
-		Mat data;
-		int y = keys.rows - 1;
-		for(; y > 0; y--) {
-			if (!mathop::isEqual<byte>(keys.row(y), keys.row(y - 1))) data.push_back(keys.row(y));
-			keys.pop_back();
+		// Packing the rows [key, value] into a contiguous array
+		vec_byte_t vData(static_cast<size_t>(keys.rows) * stride);
+		for (int y = 0; y < keys.rows; y++) {
+			byte *pRow = &vData[static_cast<size_t>(y) * stride];
+			memcpy(pRow, keys.ptr<byte>(y), keys.cols);
+			pRow[keys.cols] = values.at<byte>(y, 0);
 		}
-		data.push_back(keys.row(0));
-		keys.pop_back();
 
-		m_root = buildTree(data, boundingBox);
+		// Delete dublicated entries
+		auto hash = [&](int y) {
+			const byte *pRow = &vData[static_cast<size_t>(y) * stride];
+			size_t res = 14695981039346656037ULL;											// FNV-1a
+			for (int x = 0; x < stride; x++) res = (res ^ pRow[x]) * 1099511628211ULL;
+			return res;
+		};
+		auto equal = [&](int a, int b) { return memcmp(&vData[static_cast<size_t>(a) * stride], &vData[static_cast<size_t>(b) * stride], stride) == 0; };
+		std::unordered_set<int, decltype(hash), decltype(equal)> sRows(keys.rows, hash, equal);
+		vec_int_t vIdx;
+		vIdx.reserve(keys.rows);
+		for (int y = 0; y < keys.rows; y++)
+			if (sRows.insert(y).second) vIdx.push_back(y);
+		const int nRows = static_cast<int>(vIdx.size());
+
+		reset();
+		const int grain = MAX(4096, nRows / 64);										// the smaller subtrees are built sequentially
+		m_root = buildTree(vData.data(), stride, vIdx.data(), nRows, boundingBox, grain);
+
+		m_k = keys.cols;
+		flatten(m_root);
 	}
 
 	std::vector<std::shared_ptr<const CKDNode>> CKDTree::findNearestNeighbors(const Mat &key, size_t maxNeighbors) const
@@ -121,7 +274,8 @@ namespace DirectGraphicalModels
 		std::vector<std::shared_ptr<const CKDNode>> nearestNeighbors;
 		nearestNeighbors.reserve(maxNeighbors);
 
-		if (!m_root) {
+		const std::shared_ptr<CKDNode> pRoot = root();
+		if (!pRoot) {
 			DGM_WARNING("The k-D tree is not built");
 			return nearestNeighbors;
 		}
@@ -137,11 +291,97 @@ namespace DirectGraphicalModels
 		searchBox.first  = key - searchRadius;
 		searchBox.second = key + searchRadius;
 
-		m_root->findNearestNeighbors(key, maxNeighbors, searchBox, searchRadius, nearestNeighbors);
+		pRoot->findNearestNeighbors(key, maxNeighbors, searchBox, searchRadius, nearestNeighbors);
 	
 		return nearestNeighbors;
 	}
 
+	void CKDTree::knnSearch(const Mat &queries, size_t k, Mat &labels, size_t maxLeafVisits) const
+	{
+		Mat distances;
+		knnSearch(queries, k, labels, distances, maxLeafVisits);
+	}
+
+	void CKDTree::knnSearch(const Mat &queries, size_t k, Mat &labels, Mat &distances, size_t maxLeafVisits) const
+	{
+		DGM_ASSERT_MSG(queries.type() == CV_8UC1, "Incorrect type of the queries");
+		if (m_vNodes.empty()) {
+			DGM_WARNING("The k-D tree is not built");
+			labels.release();
+			distances.release();
+			return;
+		}
+		DGM_ASSERT_MSG(queries.cols == m_k, "The dimensionality of the queries (%d) does not correspond to the dimensionality of the tree (%d)", queries.cols, m_k);
+		
+		const int		nNeighbors	= static_cast<int>(MIN(k, m_vValues.size()));
+		const size_t	maxVisits	= maxLeafVisits ? maxLeafVisits : m_vValues.size();
+		labels.create(queries.rows, nNeighbors, CV_8UC1);
+		distances.create(queries.rows, nNeighbors, CV_32SC1);
+		if (nNeighbors == 0) return;
+
+		auto body = [&](const Range &range) {
+			std::vector<std::pair<int, int>> vHeap;								// max-heap of (squared distance, key index) for the best candidates
+			std::vector<std::pair<int, int>> vQueue;							// min-heap of the subtrees to visit: (lower bound of the squared distance, node index)
+			const std::greater<std::pair<int, int>> closer;
+			vHeap.reserve(nNeighbors + 1);
+			for (int q = range.start; q < range.end; q++) {
+				const byte *pQuery = queries.ptr<byte>(q);
+				vHeap.clear();
+				vQueue.clear();
+				vQueue.emplace_back(0, 0);
+				size_t nVisits = 0;
+				while (!vQueue.empty()) {
+					std::pop_heap(vQueue.begin(), vQueue.end(), closer);
+					auto [bound, n] = vQueue.back();
+					vQueue.pop_back();
+					if (static_cast<int>(vHeap.size()) == nNeighbors && (bound > vHeap.front().first || nVisits >= maxVisits)) break;
+
+					// descending to the leaf, postponing the far subtrees
+					while (m_vNodes[n].splitDim >= 0) {
+						const Node &node	= m_vNodes[n];
+						const int	diff	= pQuery[node.splitDim] - node.splitVal;
+						vQueue.emplace_back(MAX(bound, diff * diff), diff < 0 ? node.right : n + 1);	// the keys of both subtrees may be equal to splitVal
+						std::push_heap(vQueue.begin(), vQueue.end(), closer);
+						n = diff < 0 ? n + 1 : node.right;
+					}
+
+					nVisits++;
+					const int	 idx	= m_vNodes[n].right;
+					const byte	*pKey	= &m_vKeys[static_cast<size_t>(idx) * m_k];
+					int dist = 0;
+					for (int d = 0; d < m_k; d++) dist += (pQuery[d] - pKey[d]) * (pQuery[d] - pKey[d]);
+					
+					const auto candidate = std::make_pair(dist, idx);
+					if (static_cast<int>(vHeap.size()) < nNeighbors) {
+						vHeap.push_back(candidate);
+						std::push_heap(vHeap.begin(), vHeap.end());
+					}
+					else if (candidate < vHeap.front()) {
+						std::pop_heap(vHeap.begin(), vHeap.end());
+						vHeap.back() = candidate;
+						std::push_heap(vHeap.begin(), vHeap.end());
+					}
+				} // while
+
+				std::sort_heap(vHeap.begin(), vHeap.end());
+				byte *pLabels = labels.ptr<byte>(q);
+				int	 *pDistances = distances.ptr<int>(q);
+				for (int i = 0; i < nNeighbors; i++) {
+					pLabels[i]	  = m_vValues[vHeap[i].second];
+					pDistances[i] = vHeap[i].first;
+				}
+			} // q
+		};
+		parallel::parallelFor(Range(0, queries.rows), body, 64);
+	}
+
+	void CKDTree::getKeys(Mat &keys, Mat &values) const
+	{
+		const int nKeys = static_cast<int>(m_vValues.size());
+		Mat(nKeys, m_k, CV_8UC1, const_cast<byte *>(m_vKeys.data())).copyTo(keys);
+		Mat(nKeys, 1, CV_8UC1, const_cast<byte *>(m_vValues.data())).copyTo(values);
+	}
+
 	// ----------------------------------------- Private -----------------------------------------
 	std::shared_ptr<CKDNode> CKDTree::loadTree(FILE * pFile, int k) 
 	{
@@ -173,50 +413,87 @@ namespace DirectGraphicalModels
 		}
 	}
 	
-	// data_i = [key,val]: k + 1 entries 
-	// left = [0; splitVal)
-	// right = [splitVal; end]
-	std::shared_ptr<CKDNode> CKDTree::buildTree(Mat& data, const pair_mat_t& boundingBox)
-	{
-		if (data.rows == 1) {
-			return std::make_shared<CKDNode>(lvalue_cast(data(Rect(0, 0, data.cols - 1, 1))), data.at<byte>(0, data.cols - 1));
-		}
-		else if (data.rows == 2) {
-			int	 splitDim = getSplitDimension<byte>(boundingBox);
-			byte splitVal = (data.at<byte>(0, splitDim) + data.at<byte>(1, splitDim)) / 2;
-			
-			std::shared_ptr<CKDNode> left, right;
-			if (data.at<byte>(0, splitDim) < data.at<byte>(1, splitDim)) {
-				left  = std::make_shared<CKDNode>(lvalue_cast(data.row(0)(Rect(0, 0, data.cols - 1, 1))), data.at<byte>(0, data.cols - 1));
-				right = std::make_shared<CKDNode>(lvalue_cast(data.row(1)(Rect(0, 0, data.cols - 1, 1))), data.at<byte>(1, data.cols - 1));
+	void CKDTree::flatten(const std::shared_ptr<const CKDNode> &node)
+	{
+		const size_t idx = m_vNodes.size();
+		m_vNodes.push_back({ 0, -1, 0 });
+		if (node->isLeaf()) {
+			const Mat key = node->getKey();
+			m_vNodes[idx].right = static_cast<int>(m_vValues.size());
+			m_vKeys.insert(m_vKeys.end(), key.ptr<byte>(0), key.ptr<byte>(0) + m_k);
+			m_vValues.push_back(node->getValue());
+		}
+		else {
+			flatten(node->Left());												// the left child is stored right after its parent
+			m_vNodes[idx].right		= static_cast<int>(m_vNodes.size());
+			m_vNodes[idx].splitDim	= node->getSplitDim();
+			m_vNodes[idx].splitVal	= node->getSplitVal();
+			flatten(node->Right());
+		}
+	}
+
+	// The nodes are visited in the depth-first order: every subtree must end right before the right child of its parent, which is pending on the stack
+	bool CKDTree::isValid(void) const
+	{
+		const int nNodes = static_cast<int>(m_vNodes.size());
+		const int nKeys	 = static_cast<int>(m_vValues.size());
+		if (nNodes == 0) return nKeys == 0;
+
+		vec_int_t vPending;
+		for (int n = 0; n < nNodes; n++) {
+			const Node &node = m_vNodes[n];
+			if (node.splitDim < 0) {											// leaf
+				if (node.right < 0 || node.right >= nKeys) return false;
+				if (vPending.empty()) return n + 1 == nNodes;
+				if (vPending.back() != n + 1) return false;
+				vPending.pop_back();
 			}
-			else {
-				left  = std::make_shared<CKDNode>(lvalue_cast(data.row(1)(Rect(0, 0, data.cols - 1, 1))), data.at<byte>(1, data.cols - 1));
-				right = std::make_shared<CKDNode>(lvalue_cast(data.row(0)(Rect(0, 0, data.cols - 1, 1))), data.at<byte>(0, data.cols - 1));
+			else {																// branch
+				if (node.splitDim >= m_k || node.right <= n + 1 || node.right >= nNodes) return false;
+				vPending.push_back(node.right);
 			}
-			return std::make_shared<CKDNode>(boundingBox, splitVal, splitDim, left, right);
+		} // n
+		return false;															// the last subtree is not complete
+	}
+
+	// n is the index of the node in the flattened tree; at the return it points to the node, following the subtree
+	std::shared_ptr<CKDNode> CKDTree::unflatten(int &n) const
+	{
+		const Node node = m_vNodes[n++];
+		if (node.splitDim < 0) {
+			const Mat key(1, m_k, CV_8UC1, const_cast<byte *>(&m_vKeys[static_cast<size_t>(node.right) * m_k]));
+			return std::make_shared<CKDNode>(key.clone(), m_vValues[node.right]);
 		}
-		else {
-			int	 splitDim = getSplitDimension<byte>(boundingBox);
-			parallel::sortRows<byte>(data, splitDim);
-			int	 splitIdx = data.rows / 2;
-			byte splitVal = data.at<byte>(splitIdx, splitDim);
 
-			pair_mat_t boundingBoxLeft(boundingBox.first.clone(), boundingBox.second.clone());
-			pair_mat_t boundingBoxRight(boundingBox.first.clone(), boundingBox.second.clone());
+		std::shared_ptr<CKDNode> left  = unflatten(n);
+		std::shared_ptr<CKDNode> right = unflatten(n);
+		const pair_mat_t boxLeft  = left->getBoundingBox();
+		const pair_mat_t boxRight = right->getBoundingBox();
+		pair_mat_t boundingBox;
+		cv::min(boxLeft.first, boxRight.first, boundingBox.first);
+		cv::max(boxLeft.second, boxRight.second, boundingBox.second);
+		return std::make_shared<CKDNode>(boundingBox, node.splitVal, node.splitDim, left, right);
+	}
 
-			boundingBoxLeft.second.at<byte>(0, splitDim) = splitVal > 0 ? splitVal - 1 : 0;
-			boundingBoxRight.first.at<byte>(0, splitDim) = splitVal;
+	// The tree of nodes is published atomically, thus the concurrent searches lock the mutex only until the tree is rebuilt
+	std::shared_ptr<CKDNode> CKDTree::root(void) const
+	{
+		std::shared_ptr<CKDNode> res = std::atomic_load(&m_root);
+		if (res || m_vNodes.empty()) return res;
 
-			auto left  = buildTree(lvalue_cast(data(Rect(0, 0, data.cols, splitIdx))), boundingBoxLeft);
-			auto right = buildTree(lvalue_cast(data(Rect(0, data.rows / 2, data.cols, data.rows - data.rows / 2))), boundingBoxRight);
-			return std::make_shared<CKDNode>(boundingBox, splitVal, splitDim, left, right);
+		std::lock_guard<std::mutex> lock(m_mtxRoot);
+		res = std::atomic_load(&m_root);
+		if (!res) {
+			int n = 0;
+			res = unflatten(n);
+			std::atomic_store(&m_root, res);
 		}
+		return res;
 	}
 
 	std::shared_ptr<const CKDNode> CKDTree::findNearestNode(const Mat& key) const
 	{
-		std::shared_ptr<CKDNode> node(m_root);
+		std::shared_ptr<CKDNode> node(root());
 
 		while (!node->isLeaf()) {
 			std::shared_ptr<CKDNode> n = std::static_pointer_cast<CKDNode>(node);
@@ -5,9 +5,13 @@
 
 #include "types.h"
 #include "KDNode.h"
+#include <mutex>
 
 namespace DirectGraphicalModels
 {
+	class CModelFileWriter;
+	class CModelFile;
+
 	// ================================ k-D Tree Class ================================
 	/**
 	* @brief Class implementing k-D Tree data structure
@@ -35,21 +39,46 @@ namespace DirectGraphicalModels
 		/**
 		* @brief Resets the tree
 		*/
-		DllExport void											reset(void) { m_root.reset(); }
+		DllExport void											reset(void);
+		/**
+		* @brief Returns the memory, used by the tree
+		* @details The result includes the flattened tree and the tree of nodes, if it has been built (ref. getRoot())
+		* @return The size of the tree in bytes
+		*/
+		DllExport size_t										getMemoryUsage(void) const;
 		/**
 		* @brief Saves the tree into a file
+		* @details The flattened tree is written as a model container with three contiguous arrays (ref. save(CModelFileWriter &, const std::string &) const)
 		* @param fileName The output file name
 		*/
 		DllExport void											save(const std::string &fileName) const;
 		/**
 		* @brief Loads a tree from the file
+		* @details The flattened tree is loaded with one block copy per array. The files in the legacy recursive format are also supported
 		* @param fileName The output file name
+		* @param mapped Flag indicating whether the file should be mapped into memory (ref. CModelFile::open())
+		*/
+		DllExport void											load(const std::string &fileName, bool mapped = true);
+		/**
+		* @brief Adds the tree to a model container
+		* @details The flattened tree is stored in the sections \a <prefix>.nodes, \a <prefix>.keys and \a <prefix>.values, which are copied in bulk by load(const CModelFile &, const std::string &)
+		* @param writer The writer of the model container
+		* @param prefix The prefix of the names of the sections
 		*/
-		DllExport void											load(const std::string &fileName);
+		DllExport void											save(CModelFileWriter &writer, const std::string &prefix) const;
+		/**
+		* @brief Loads a tree from a model container
+		* @details Only the flattened tree is restored, which is used by knnSearch(). The tree of nodes is rebuilt on the first call of getRoot() or findNearestNeighbors(),
+		* where the branch nodes get the bounding boxes of their leaves
+		* @param file The model container
+		* @param prefix The prefix of the names of the sections
+		*/
+		DllExport void											load(const CModelFile &file, const std::string &prefix);
 		/**
 		* @brief Builds a k-d tree on \b keys with corresponding \b values
+		* @details The duplicated pairs (key, value) are removed with a hash set and the nodes are partitioned in place with the median selection 
+		* on an array of indexes. If PDP is enabled, the subtrees are built in parallel.
 		* @param keys The tree keys: k-d points: Mat(size: nKeys x k; type: CV_8UC1)
-		* > The \b keys matrix is modified by this function
 		* @param values The values for every key: Mat(size: nKeys x 1; type: CV_8UC1)
 		*/
 		DllExport void											build(Mat &keys, Mat &values);
@@ -67,19 +96,69 @@ namespace DirectGraphicalModels
 		*/
 		DllExport std::vector<std::shared_ptr<const CKDNode>>	findNearestNeighbors(const Mat &key, size_t maxNeighbors) const;
 		/**
+		* @brief Finds the \b k nearest neighbors for every query in the block
+		* @details Unlike findNearestNeighbors(), this function searches the flattened copy of the tree, without any 
+		* memory allocations or reference counting per query. The queries are processed in parallel. The subtrees are visited in the order of 
+		* their distance to the query (best-bin-first), thus limiting the number of the visited leaves gives an approximate search, 
+		* which still finds the closest neighbors in most cases.
+		* @param queries The search keys: k-d points: Mat(size: nQueries x k; type: CV_8UC1)
+		* @param k The number of the nearest neighbors to find
+		* @param labels The values of the found neighbors, sorted by the increasing distance to the query: Mat(size: nQueries x min(\b k, nKeys); type: CV_8UC1)
+		* @param maxLeafVisits The maximal number of the visited leaves per query: if smaller than \b k, \b k leaves are visited. 0 means the exact search
+		*/
+		DllExport void											knnSearch(const Mat &queries, size_t k, Mat &labels, size_t maxLeafVisits = 0) const;
+		/**
+		* @brief Finds the \b k nearest neighbors for every query in the block
+		* @details This function is the same as knnSearch(const Mat &, size_t, Mat &, size_t) const, returning additionally the distances to the neighbors,
+		* \a e.g. to combine the search results of several trees
+		* @param queries The search keys: k-d points: Mat(size: nQueries x k; type: CV_8UC1)
+		* @param k The number of the nearest neighbors to find
+		* @param labels The values of the found neighbors, sorted by the increasing distance to the query: Mat(size: nQueries x min(\b k, nKeys); type: CV_8UC1)
+		* @param distances The squared Euclidean distances to the found neighbors: Mat(size: nQueries x min(\b k, nKeys); type: CV_32SC1)
+		* @param maxLeafVisits The maximal number of the visited leaves per query: if smaller than \b k, \b k leaves are visited. 0 means the exact search
+		*/
+		DllExport void											knnSearch(const Mat &queries, size_t k, Mat &labels, Mat &distances, size_t maxLeafVisits = 0) const;
+		/**
+		* @brief Returns the keys and the values of the tree
+		* @details The duplicated pairs (key, value) have been removed by build()
+		* @param keys The tree keys: k-d points: Mat(size: nKeys x k; type: CV_8UC1)
+		* @param values The values for every key: Mat(size: nKeys x 1; type: CV_8UC1)
+		*/
+		DllExport void											getKeys(Mat &keys, Mat &values) const;
+		/**
+		* @brief Returns the number of keys
+		* @return The number of the distinct pairs (key, value) in the tree
+		*/
+		DllExport size_t										getNumKeys(void) const { return m_vValues.size(); }
+		/**
 		* @brief Returns pointer to the root of the tree
 		* @returns The pointer to the root of the tree
 		*/
-		DllExport std::shared_ptr<const CKDNode>				getRoot(void) const { return m_root; }
+		DllExport std::shared_ptr<const CKDNode>				getRoot(void) const { return root(); }
 
 
 	private:
 		std::shared_ptr<CKDNode>								loadTree(FILE *pFile, int k);
-		std::shared_ptr<CKDNode>								buildTree(Mat& data, const pair_mat_t& boundingBox);
 		std::shared_ptr<const CKDNode>							findNearestNode(const Mat &key) const;
+		void													flatten(const std::shared_ptr<const CKDNode> &node);
+		std::shared_ptr<CKDNode>								unflatten(int &n) const;
+		bool													isValid(void) const;			// Checks the indices of the flattened tree
+		std::shared_ptr<CKDNode>								root(void) const;				// Returns the tree of nodes, rebuilding it from the flattened tree if needed
 
 
 	private:
-		std::shared_ptr<CKDNode>	m_root = nullptr;
+		// Node of the flattened tree: the left child of a branch node immediately follows it in the array
+		struct Node {
+			int		right;								// index of the right child (for leaves: index of the key)
+			int		splitDim;							// split dimension (for leaves: -1)
+			byte	splitVal;							// split value
+		};
+
+		mutable std::shared_ptr<CKDNode>	m_root = nullptr;
+		mutable std::mutex			m_mtxRoot;			///< Guards the lazy rebuilding of the tree of nodes
+		std::vector<Node>			m_vNodes;			///< The flattened tree in the depth-first order
+		vec_byte_t					m_vKeys;			///< The keys of the leaves: contiguous array of size nKeys x k
+		vec_byte_t					m_vValues;			///< The values of the leaves
+		int							m_k		= 0;		///< The dimensionality of the keys
 	};
 }
\ No newline at end of file
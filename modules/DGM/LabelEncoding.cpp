@@ -0,0 +1,164 @@
+#include "LabelEncoding.h"
+#include "ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Packs the labels of one row starting from the least significant bits
+		void packRow(const byte *pLabels, int width, byte nBits, byte *pDst)
+		{
+			if (nBits == 8) {
+				memcpy(pDst, pLabels, width);
+				return;
+			}
+			const int	perByte = 8 / nBits;
+			const byte	mask	= static_cast<byte>((1 << nBits) - 1);
+			for (int x = 0, i = 0; x < width; i++) {
+				byte val = 0;
+				for (int k = 0; k < perByte && x < width; k++, x++) val |= (pLabels[x] & mask) << (k * nBits);
+				pDst[i] = val;
+			}
+		}
+	}
+
+	// The rows are processed in blocks of about 4096 pixels; every block collects its own runs and statistics, which are merged in the order of the blocks
+	void CLabelEncoder::encode(Size size, byte nStates, const row_function_t &getRow, PackedLabels *pPacked, RunLengthLabels *pRuns, LabelStats *pStats)
+	{
+		DGM_ASSERT_MSG(size.width >= 0 && size.height >= 0, "Wrong size of the label map");
+		const int blockSize	= MAX(1, 4096 / MAX(1, size.width));			// rows per block
+		const int nBlocks	= (size.height + blockSize - 1) / blockSize;
+
+		if (pPacked) {
+			if (!pPacked->nBits) pPacked->nBits = getNumBits(nStates);
+			const byte nBits = pPacked->nBits;
+			DGM_ASSERT_MSG(nBits == 1 || nBits == 2 || nBits == 4 || nBits == 8, "The number of bits per label (%d) must be 1, 2, 4 or 8", nBits);
+			DGM_ASSERT_MSG(nStates <= (1 << nBits), "%d bits can not hold %d states", nBits, nStates);
+			pPacked->size = size;
+			pPacked->data.create(size.height, (size.width * nBits + 7) / 8, CV_8UC1);
+		}
+		std::vector<std::vector<LabelRun>>	vvRuns(pRuns ? nBlocks : 0);
+		std::vector<vec_size_t>				vvArea(pStats ? nBlocks : 0);
+		std::vector<std::vector<int>>		vvBox(pStats ? nBlocks : 0);			// x0, y0, x1, y1 of every state
+		if (pRuns) {
+			pRuns->size = size;
+			pRuns->vRowStart.assign(size.height + 1, 0);
+		}
+
+		parallel::parallelFor(Range(0, nBlocks), [&](const Range& range) {
+			vec_byte_t vRow(size.width);
+			for (int b = range.start; b < range.end; b++) {
+				if (pStats) {
+					vvArea[b].assign(nStates, 0);
+					vvBox[b].resize(4 * nStates);
+					for (byte s = 0; s < nStates; s++) {
+						int *pBox = &vvBox[b][4 * s];
+						pBox[0] = pBox[1] = INT_MAX;
+						pBox[2] = pBox[3] = -1;
+					}
+				}
+				const int end = MIN(size.height, (b + 1) * blockSize);
+				for (int y = b * blockSize; y < end; y++) {
+					getRow(y, vRow.data());
+					if (pPacked) packRow(vRow.data(), size.width, pPacked->nBits, pPacked->data.ptr<byte>(y));
+					if (!pRuns && !pStats) continue;
+
+					size_t nRuns = 0;
+					for (int x = 0; x < size.width; nRuns++) {
+						const byte	label	= vRow[x];
+						int			x1		= x + 1;
+						while (x1 < size.width && vRow[x1] == label) x1++;
+						if (pRuns) vvRuns[b].push_back({ label, static_cast<dword>(x1 - x) });
+						if (pStats) {
+							DGM_ASSERT_MSG(label < nStates, "The label %d exceeds the number of states %d", label, nStates);
+							int *pBox = &vvBox[b][4 * label];
+							vvArea[b][label] += x1 - x;
+							pBox[0] = MIN(pBox[0], x);
+							pBox[1] = MIN(pBox[1], y);
+							pBox[2] = MAX(pBox[2], x1 - 1);
+							pBox[3] = MAX(pBox[3], y);
+						}
+						x = x1;
+					} // x
+					if (pRuns) pRuns->vRowStart[y + 1] = nRuns;						// the number of runs is converted to the index below
+				} // y
+			} // b
+		});
+
+		if (pRuns) {
+			for (int y = 0; y < size.height; y++) pRuns->vRowStart[y + 1] += pRuns->vRowStart[y];
+			pRuns->vRuns.clear();
+			pRuns->vRuns.reserve(pRuns->vRowStart.back());
+			for (const std::vector<LabelRun> &vRuns : vvRuns) pRuns->vRuns.insert(pRuns->vRuns.end(), vRuns.begin(), vRuns.end());
+		}
+
+		if (pStats) {
+			pStats->vArea.assign(nStates, 0);
+			pStats->vBoundingBox.assign(nStates, Rect());
+			std::vector<int> vBox(4 * nStates);
+			for (byte s = 0; s < nStates; s++) {
+				vBox[4 * s] = vBox[4 * s + 1] = INT_MAX;
+				vBox[4 * s + 2] = vBox[4 * s + 3] = -1;
+			}
+			for (int b = 0; b < nBlocks; b++)
+				for (byte s = 0; s < nStates; s++) {
+					pStats->vArea[s] += vvArea[b][s];
+					vBox[4 * s]		= MIN(vBox[4 * s],		vvBox[b][4 * s]);
+					vBox[4 * s + 1] = MIN(vBox[4 * s + 1],	vvBox[b][4 * s + 1]);
+					vBox[4 * s + 2] = MAX(vBox[4 * s + 2],	vvBox[b][4 * s + 2]);
+					vBox[4 * s + 3] = MAX(vBox[4 * s + 3],	vvBox[b][4 * s + 3]);
+				}
+			for (byte s = 0; s < nStates; s++)
+				if (pStats->vArea[s]) pStats->vBoundingBox[s] = Rect(Point(vBox[4 * s], vBox[4 * s + 1]), Point(vBox[4 * s + 2] + 1, vBox[4 * s + 3] + 1));
+		}
+	}
+
+	void CLabelEncoder::encode(const Mat &labels, byte nStates, PackedLabels *pPacked, RunLengthLabels *pRuns, LabelStats *pStats)
+	{
+		DGM_ASSERT_MSG(labels.type() == CV_8UC1, "The labels must be of type CV_8UC1");
+		encode(labels.size(), nStates, [&labels](int y, byte *pRow) { memcpy(pRow, labels.ptr<byte>(y), labels.cols); }, pPacked, pRuns, pStats);
+	}
+
+	Mat CLabelEncoder::decode(const PackedLabels &packed)
+	{
+		const byte nBits = packed.nBits;
+		DGM_ASSERT_MSG(nBits == 1 || nBits == 2 || nBits == 4 || nBits == 8, "The number of bits per label (%d) must be 1, 2, 4 or 8", nBits);
+		const byte mask = static_cast<byte>((1 << nBits) - 1);
+		Mat res(packed.size, CV_8UC1);
+		for (int y = 0; y < res.rows; y++) {
+			const byte	*pSrc = packed.data.ptr<byte>(y);
+			byte		*pRes = res.ptr<byte>(y);
+			for (int x = 0; x < res.cols; x++) {
+				const int bit = x * nBits;
+				pRes[x] = (pSrc[bit >> 3] >> (bit & 7)) & mask;
+			}
+		}
+		return res;
+	}
+
+	Mat CLabelEncoder::decode(const RunLengthLabels &runs)
+	{
+		DGM_ASSERT_MSG(runs.vRowStart.size() == static_cast<size_t>(runs.size.height) + 1, "The row index does not correspond to the size of the label map");
+		Mat res(runs.size, CV_8UC1);
+		for (int y = 0; y < res.rows; y++) {
+			byte *pRes = res.ptr<byte>(y);
+			int x = 0;
+			for (size_t r = runs.vRowStart[y]; r < runs.vRowStart[y + 1]; r++) {
+				const LabelRun &run = runs.vRuns[r];
+				DGM_ASSERT_MSG(x + static_cast<int>(run.length) <= res.cols, "The runs of row %d exceed the width of the label map", y);
+				memset(pRes + x, run.label, run.length);
+				x += run.length;
+			}
+			DGM_ASSERT_MSG(x == res.cols, "The runs of row %d do not cover the width of the label map", y);
+		}
+		return res;
+	}
+
+	byte CLabelEncoder::getNumBits(byte nStates)
+	{
+		if (nStates <= 2)	return 1;
+		if (nStates <= 4)	return 2;
+		if (nStates <= 16)	return 4;
+		return 8;
+	}
+}
@@ -0,0 +1,99 @@
+// Compact label output class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	/// Run of the equal labels in one row
+	struct LabelRun {
+		byte	label;			///< The label (state) of the run
+		dword	length;			///< The number of the pixels in the run
+	};
+
+	/**
+	* @brief Run-length encoded label map
+	* @details The runs do not cross the rows: the runs of the row \a y are vRuns[vRowStart[y]] to vRuns[vRowStart[y + 1] - 1], thus every row may be decoded independently
+	*/
+	struct RunLengthLabels {
+		Size					size;			///< The size of the label map
+		vec_size_t				vRowStart;		///< The index of the first run of every row: \a size.height + 1 elements
+		std::vector<LabelRun>	vRuns;			///< The runs of all the rows
+	};
+
+	/**
+	* @brief Bit-packed label map
+	* @details Every row starts with a new byte; the labels of a row are packed starting from the least significant bits of the first byte
+	*/
+	struct PackedLabels {
+		Size	size;			///< The size of the label map
+		byte	nBits	= 0;	///< The number of bits per label: 1, 2, 4 or 8
+		Mat		data;			///< The packed labels: Mat(size: size.height x ceil(size.width * nBits / 8); type: CV_8UC1)
+	};
+
+	/// Statistics of the regions of every label
+	struct LabelStats {
+		vec_size_t			vArea;			///< The number of the pixels of every label (state)
+		std::vector<Rect>	vBoundingBox;	///< The bounding box of every label (state); the empty rectangle, if the label is absent
+	};
+
+	// ================================ Label Encoder Class ================================
+	/**
+	* @brief Compact label output
+	* @details This class encodes the label maps into the run-length encoded rows (@ref RunLengthLabels) and into the bit-packed labels (@ref PackedLabels),
+	* and calculates the area and the bounding box of every label (@ref LabelStats) in the same pass. The rows are produced and encoded one by one in parallel,
+	* thus the full byte label map is never materialized: the decoders provide the rows directly from their argmax pass (ref. CInfer::encodeResults())
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CLabelEncoder
+	{
+	public:
+		/**
+		* @brief Row function
+		* @details Writes the labels of the row \a y into the buffer of \a width elements. It is called concurrently for different rows
+		*/
+		using row_function_t = std::function<void(int y, byte *pRow)>;
+
+		/**
+		* @brief Encodes the label map, which is produced row by row
+		* @details Every output is optional.
+		* > This function supports PPL
+		* @param size The size of the label map
+		* @param nStates The number of States (classes)
+		* @param getRow The row function
+		* @param[in,out] pPacked (optional) Pointer to the bit-packed labels. If its \a nBits is zero, the minimal number of bits for \b nStates is used (ref. getNumBits())
+		* @param[out] pRuns (optional) Pointer to the run-length encoded labels
+		* @param[out] pStats (optional) Pointer to the statistics of the labels
+		*/
+		DllExport static void	encode(Size size, byte nStates, const row_function_t &getRow, PackedLabels *pPacked, RunLengthLabels *pRuns = NULL, LabelStats *pStats = NULL);
+		/**
+		* @brief Encodes the label map
+		* @param labels The label map: Mat(type: CV_8UC1)
+		* @param nStates The number of States (classes)
+		* @param[in,out] pPacked (optional) Pointer to the bit-packed labels
+		* @param[out] pRuns (optional) Pointer to the run-length encoded labels
+		* @param[out] pStats (optional) Pointer to the statistics of the labels
+		*/
+		DllExport static void	encode(const Mat &labels, byte nStates, PackedLabels *pPacked, RunLengthLabels *pRuns = NULL, LabelStats *pStats = NULL);
+		/**
+		* @brief Decodes the bit-packed labels
+		* @param packed The bit-packed labels
+		* @return The label map: Mat(size: packed.size; type: CV_8UC1)
+		*/
+		DllExport static Mat	decode(const PackedLabels &packed);
+		/**
+		* @brief Decodes the run-length encoded labels
+		* @param runs The run-length encoded labels
+		* @return The label map: Mat(size: runs.size; type: CV_8UC1)
+		*/
+		DllExport static Mat	decode(const RunLengthLabels &runs);
+		/**
+		* @brief Returns the minimal number of bits per label for bit-packing
+		* @param nStates The number of States (classes)
+		* @return The number of bits: 1, 2, 4 or 8
+		*/
+		DllExport static byte	getNumBits(byte nStates);
+	};
+}
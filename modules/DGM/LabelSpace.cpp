@@ -0,0 +1,105 @@
+#include "LabelSpace.h"
+#include "parallel.h"
+#include "footprint.h"
+#include "macroses.h"
+#include <numeric>
+
+namespace DirectGraphicalModels
+{
+	// Constructor
+	CLabelSpace::CLabelSpace(word nLabels, byte nCandidates)
+		: m_nLabels(nLabels)
+		, m_nCandidates(static_cast<byte>(MIN(static_cast<word>(nCandidates), nLabels)))
+	{
+		DGM_ASSERT_MSG(m_nCandidates > 0, "The numbers of the labels and of the candidates must be positive");
+	}
+
+	// The candidates are the first nCandidates labels after the partial ordering by the potential
+	void CLabelSpace::selectCandidates(size_t nNodes, const node_potential_function_t &potential)
+	{
+		m_vLabels.resize(nNodes * m_nCandidates);
+		m_vPots.resize(nNodes * m_nCandidates);
+		parallel::parallelFor(Range(0, static_cast<int>(nNodes)), [&](const Range &range) {
+			vec_float_t			vPot(m_nLabels);
+			std::vector<word>	vIdx(m_nLabels);
+			for (int n = range.start; n < range.end; n++) {
+				potential(n, vPot.data());
+				std::iota(vIdx.begin(), vIdx.end(), static_cast<word>(0));
+				std::nth_element(vIdx.begin(), vIdx.begin() + m_nCandidates - 1, vIdx.end(), [&vPot](word a, word b) {
+					return vPot[a] > vPot[b] || (vPot[a] == vPot[b] && a < b);
+				});
+				std::sort(vIdx.begin(), vIdx.begin() + m_nCandidates);
+				for (byte s = 0; s < m_nCandidates; s++) {
+					m_vLabels[n * m_nCandidates + s] = vIdx[s];
+					m_vPots[n * m_nCandidates + s]	 = vPot[vIdx[s]];
+				}
+			} // n
+		}, 64);
+	}
+
+	void CLabelSpace::selectCandidates(const Mat &pots)
+	{
+		DGM_ASSERT_MSG(pots.type() == CV_32FC1 && pots.cols == m_nLabels, "The potentials must be a single-channel float matrix with %d columns", m_nLabels);
+		selectCandidates(pots.rows, [&pots, this](size_t node, float *pot) {
+			memcpy(pot, pots.ptr<float>(static_cast<int>(node)), m_nLabels * sizeof(float));
+		});
+	}
+
+	void CLabelSpace::fillGraph(IGraphPairwise &graph, const edge_potential_function_t &edgePot) const
+	{
+		const size_t nNodes = getNumNodes();
+		DGM_ASSERT_MSG(graph.getNumStates() == m_nCandidates, "The graph must have %d states, one per candidate", m_nCandidates);
+		DGM_ASSERT_MSG(graph.getNumNodes() == 0 || graph.getNumNodes() == nNodes, "The graph has %zu nodes, while the candidates are selected for %zu nodes", graph.getNumNodes(), nNodes);
+
+		const bool	add = graph.getNumNodes() == 0;
+		Mat			pot;
+		for (size_t n = 0; n < nNodes; n++) {
+			getNodePot(n, pot);
+			if (add) graph.addNode(pot);
+			else	 graph.setNode(n, pot);
+		}
+		if (!edgePot) return;
+
+		vec_size_t vChilds;
+		pot = Mat(m_nCandidates, m_nCandidates, CV_32FC1);
+		for (size_t n = 0; n < nNodes; n++) {
+			graph.getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				for (byte s = 0; s < m_nCandidates; s++) {
+					float *pPot = pot.ptr<float>(s);
+					for (byte t = 0; t < m_nCandidates; t++) pPot[t] = edgePot(getLabel(n, s), getLabel(c, t));
+				}
+				graph.setEdge(n, c, pot);
+			}
+		}
+	}
+
+	void CLabelSpace::getNodePot(size_t node, Mat &pot) const
+	{
+		DGM_ASSERT_MSG(node < getNumNodes(), "The node %zu is out of range [0; %zu)", node, getNumNodes());
+		pot = Mat(m_nCandidates, 1, CV_32FC1);
+		memcpy(pot.data, &m_vPots[node * m_nCandidates], m_nCandidates * sizeof(float));
+	}
+
+	std::vector<word> CLabelSpace::getLabels(const vec_byte_t &solution) const
+	{
+		DGM_ASSERT_MSG(solution.size() == getNumNodes(), "The number of states (%zu) does not match the number of nodes (%zu)", solution.size(), getNumNodes());
+		std::vector<word> res(solution.size());
+		for (size_t n = 0; n < solution.size(); n++) res[n] = getLabel(n, solution[n]);
+		return res;
+	}
+
+	void CLabelSpace::getLabels(const vec_byte_t &solution, Mat &labels) const
+	{
+		DGM_ASSERT_MSG(solution.size() == getNumNodes(), "The number of states (%zu) does not match the number of nodes (%zu)", solution.size(), getNumNodes());
+		if (labels.total() != solution.size() || labels.type() != CV_16UC1 || !labels.isContinuous())
+			labels.create(static_cast<int>(solution.size()), 1, CV_16UC1);
+		word *pLabels = labels.ptr<word>();
+		for (size_t n = 0; n < solution.size(); n++) pLabels[n] = getLabel(n, solution[n]);
+	}
+
+	size_t CLabelSpace::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + footprint::getBytes(m_vLabels) + footprint::getBytes(m_vPots);
+	}
+}
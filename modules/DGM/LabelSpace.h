@@ -0,0 +1,128 @@
+// Compact state indexing class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "IGraphPairwise.h"
+
+namespace DirectGraphicalModels
+{
+	// ============================== Label Space Class ==============================
+	/**
+	* @ingroup moduleGraph
+	* @brief Compact state indexing of the large label spaces
+	* @details The graphs, the inference and the decoding of the library index the states with a byte, thus the number of states is limited to 255, and the
+	* node potentials, the edge potentials and the messages grow with \a nStates, \a nStates<sup>2</sup> and \a nStates per edge. The high-resolution
+	* stereo and optical flow need 256 - 65535 labels, most of which are very unlikely at every pixel. This class keeps for every node only the \a nCandidates
+	* most probable labels of the global label space: the state \a s of the node \a n of the graph then stands for the global label getLabel(n, s).
+	* The graph with \a nCandidates states is filled with the potentials of the candidates, and the edge potentials are evaluated for the pairs of their global labels,
+	* so that any inference algorithm, as well as the compressed messages (ref. CMessagePassing::setMessageCompression()), may be applied to it:
+	* @code
+	* CLabelSpace labelSpace(1024, 16);											// 1024 disparities, 16 candidates per pixel
+	* labelSpace.selectCandidates(pots);										// Mat(size: nNodes x nLabels; type: CV_32FC1)
+	* CGraphPairwiseKit graphKit(16, INFER::TRW);
+	* graphKit.getGraphExt().buildGraph(imgSize);
+	* labelSpace.fillGraph(graphKit.getGraph(), [](word a, word b) { return expf(-MIN(abs(a - b), 8)); });
+	* Mat disparity(imgSize, CV_16UC1);
+	* labelSpace.getLabels(graphKit.getInfer().decode(100), disparity);
+	* @endcode
+	* The candidates of a node are stored in the ascending order of their global labels.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CLabelSpace
+	{
+	public:
+		/**
+		* @brief Potential function
+		* @details Fills the potentials of all the \a nLabels global labels of the node. It is called concurrently for different nodes
+		*/
+		using node_potential_function_t = std::function<void(size_t node, float *pot)>;
+		/**
+		* @brief Edge potential function
+		* @details Returns the potential of the pair of the global labels of the source and destination nodes of an edge
+		*/
+		using edge_potential_function_t = std::function<float(word srcLabel, word dstLabel)>;
+
+		/**
+		* @brief Constructor
+		* @param nLabels The number of the global labels
+		* @param nCandidates The number of the candidate labels per node, \a i.e. the number of states of the graph. If it is not less than \b nLabels, all the labels are kept
+		*/
+		DllExport CLabelSpace(word nLabels, byte nCandidates);
+		DllExport ~CLabelSpace(void) = default;
+
+		/**
+		* @brief Selects the candidate labels of the nodes
+		* @details The labels with the highest potentials are selected; the ties are resolved in favour of the smaller labels.
+		* > This function supports PPL
+		* @param nNodes The number of nodes
+		* @param potential The potentials of the global labels of a node
+		*/
+		DllExport void		selectCandidates(size_t nNodes, const node_potential_function_t &potential);
+		/**
+		* @brief Selects the candidate labels of the nodes
+		* @param pots The potentials of the global labels of all the nodes: Mat(size: nNodes x nLabels; type: CV_32FC1)
+		*/
+		DllExport void		selectCandidates(const Mat &pots);
+		/**
+		* @brief Fills the potentials of a graph
+		* @details If the graph is empty, the nodes are added; otherwise the potentials of its nodes are replaced. The potentials of all the existing edges
+		* are set to the values of the \b edgePot function for the candidates of their nodes: Mat(size: nCandidates x nCandidates; type: CV_32FC1).
+		* @param graph The graph with \a nCandidates states
+		* @param edgePot The potential of the pairs of the global labels. If empty, the edge potentials are not changed
+		*/
+		DllExport void		fillGraph(IGraphPairwise &graph, const edge_potential_function_t &edgePot = nullptr) const;
+		/**
+		* @brief Returns the global label of a state
+		* @param node The index of the node
+		* @param state The state of the node
+		* @return The global label
+		*/
+		DllExport word		getLabel(size_t node, byte state) const { return m_vLabels[node * m_nCandidates + state]; }
+		/**
+		* @brief Returns the potentials of the candidates of a node
+		* @param node The index of the node
+		* @param[out] pot The potentials: Mat(size: nCandidates x 1; type: CV_32FC1)
+		*/
+		DllExport void		getNodePot(size_t node, Mat &pot) const;
+		/**
+		* @brief Maps the states of the nodes to the global labels
+		* @param solution The states of all the nodes, \a e.g. the result of CDecode::decode()
+		* @return The global labels of all the nodes
+		*/
+		DllExport std::vector<word> getLabels(const vec_byte_t &solution) const;
+		/**
+		* @brief Maps the states of the nodes to the global labels in the caller's container
+		* @param solution The states of all the nodes, \a e.g. the result of CDecode::decode()
+		* @param[out] labels The global labels: Mat(type: CV_16UC1) with \a nNodes elements, \a e.g. the label image. If not allocated appropriately,
+		* it is allocated as Mat(size: nNodes x 1; type: CV_16UC1)
+		*/
+		DllExport void		getLabels(const vec_byte_t &solution, Mat &labels) const;
+		/**
+		* @brief Returns the number of the global labels
+		* @return The number of the global labels
+		*/
+		DllExport word		getNumLabels(void) const { return m_nLabels; }
+		/**
+		* @brief Returns the number of the candidate labels per node
+		* @return The number of states of the graph
+		*/
+		DllExport byte		getNumCandidates(void) const { return m_nCandidates; }
+		/**
+		* @brief Returns the number of nodes
+		* @return The number of nodes, whose candidates are selected
+		*/
+		DllExport size_t	getNumNodes(void) const { return m_vLabels.size() / m_nCandidates; }
+		/**
+		* @brief Returns the memory, used by the class
+		* @return The size of the candidates and of their potentials in bytes
+		*/
+		DllExport size_t	getMemoryUsage(void) const;
+
+
+	private:
+		word				m_nLabels;			///< The number of the global labels
+		byte				m_nCandidates;		///< The number of the candidates per node
+		std::vector<word>	m_vLabels;			///< The global labels of the candidates: nNodes x nCandidates
+		vec_float_t			m_vPots;			///< The potentials of the candidates: nNodes x nCandidates
+	};
+}
@@ -0,0 +1,244 @@
+#include "MaxFlow.h"
+#include "footprint.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	void CMaxFlow::reset(size_t nNodes, size_t nEdges)
+	{
+		m_vNodes.assign(nNodes, { NONE, NONE, 0, 0, false, false, 0 });
+		m_vArcs.clear();
+		m_vArcs.reserve(2 * nEdges);
+		m_qActive.clear();
+		m_qOrphans.clear();
+		m_flow	= 0;
+		m_time	= 0;
+	}
+
+	void CMaxFlow::addEdge(size_t i, size_t j, double cap, double revCap)
+	{
+		DGM_ASSERT_MSG(i != j, "The loops are not allowed");
+		DGM_ASSERT_MSG(cap >= 0 && revCap >= 0, "The capacities must be non-negative");
+		const int a = static_cast<int>(m_vArcs.size());
+		m_vArcs.push_back({ static_cast<int>(j), m_vNodes[i].first, a + 1, cap });
+		m_vArcs.push_back({ static_cast<int>(i), m_vNodes[j].first, a, revCap });
+		m_vNodes[i].first = a;
+		m_vNodes[j].first = a + 1;
+	}
+
+	void CMaxFlow::addTWeights(size_t i, double capSource, double capSink)
+	{
+		double delta = m_vNodes[i].trCap;
+		if (delta > 0)	capSource += delta;
+		else			capSink -= delta;
+		m_flow += MIN(capSource, capSink);
+		m_vNodes[i].trCap = capSource - capSink;
+	}
+
+	double CMaxFlow::maxflow(void)
+	{
+		const int nNodes = static_cast<int>(m_vNodes.size());
+
+		// Initialization: the nodes, connected with the terminals, are the roots of the search trees
+		m_qActive.clear();
+		m_qOrphans.clear();
+		m_time = 0;
+		for (int i = 0; i < nNodes; i++) {
+			Node &node = m_vNodes[i];
+			node.isActive	= false;
+			node.ts			= 0;
+			if (node.trCap != 0) {
+				node.isSink	= node.trCap < 0;
+				node.parent	= TERMINAL;
+				node.dist	= 1;
+				setActive(i);
+			}
+			else node.parent = NONE;
+		}
+
+		int current = NONE;
+		for (;;) {
+			int i = current;
+			if (i != NONE && m_vNodes[i].parent == NONE) i = NONE;
+			if (i == NONE && (i = nextActive()) == NONE) break;
+
+			// Growth
+			int middle = NONE;
+			const Node &node = m_vNodes[i];
+			for (int a = node.first; a != NONE; a = m_vArcs[a].next) {
+				const Arc	&arc = m_vArcs[a];
+				const double cap = node.isSink ? m_vArcs[arc.sister].rCap : arc.rCap;
+				if (cap <= 0) continue;
+				Node &head = m_vNodes[arc.head];
+				if (head.parent == NONE) {
+					head.isSink	= node.isSink;
+					head.parent	= arc.sister;
+					head.ts		= node.ts;
+					head.dist	= node.dist + 1;
+					setActive(arc.head);
+				}
+				else if (head.isSink != node.isSink) {
+					middle = node.isSink ? arc.sister : a;						// the arc from the source tree to the sink tree
+					break;
+				}
+				else if (head.ts <= node.ts && head.dist > node.dist) {		// shorter path to the terminal
+					head.parent	= arc.sister;
+					head.ts		= node.ts;
+					head.dist	= node.dist + 1;
+				}
+			} // a
+
+			m_time++;
+			if (middle != NONE) {
+				current = i;
+				augment(middle);
+				// Adoption
+				while (!m_qOrphans.empty()) {
+					int j = m_qOrphans.front();
+					m_qOrphans.pop_front();
+					processOrphan(j);
+				}
+			}
+			else current = NONE;
+		}
+		return m_flow;
+	}
+
+	size_t CMaxFlow::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + footprint::getBytes(m_vNodes) + footprint::getBytes(m_vArcs) + (m_qActive.size() + m_qOrphans.size()) * sizeof(int);
+	}
+
+	size_t CMaxFlow::estimateMemory(size_t nNodes, size_t nEdges)
+	{
+		return sizeof(CMaxFlow) + nNodes * (sizeof(Node) + 2 * sizeof(int)) + 2 * nEdges * sizeof(Arc);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CMaxFlow::setActive(int i)
+	{
+		if (!m_vNodes[i].isActive) {
+			m_vNodes[i].isActive = true;
+			m_qActive.push_back(i);
+		}
+	}
+
+	int CMaxFlow::nextActive(void)
+	{
+		while (!m_qActive.empty()) {
+			int i = m_qActive.front();
+			m_qActive.pop_front();
+			m_vNodes[i].isActive = false;
+			if (m_vNodes[i].parent != NONE) return i;
+		}
+		return NONE;
+	}
+
+	void CMaxFlow::setOrphan(int i)
+	{
+		m_vNodes[i].parent = ORPHAN;
+		m_qOrphans.push_back(i);
+	}
+
+	void CMaxFlow::augment(int middle)
+	{
+		// Bottleneck capacity
+		double delta = m_vArcs[middle].rCap;
+		int i;
+		for (i = m_vArcs[m_vArcs[middle].sister].head; m_vNodes[i].parent != TERMINAL; i = m_vArcs[m_vNodes[i].parent].head)
+			delta = MIN(delta, m_vArcs[m_vArcs[m_vNodes[i].parent].sister].rCap);
+		delta = MIN(delta, m_vNodes[i].trCap);
+		for (i = m_vArcs[middle].head; m_vNodes[i].parent != TERMINAL; i = m_vArcs[m_vNodes[i].parent].head)
+			delta = MIN(delta, m_vArcs[m_vNodes[i].parent].rCap);
+		delta = MIN(delta, -m_vNodes[i].trCap);
+
+		// Augmentation
+		m_vArcs[m_vArcs[middle].sister].rCap += delta;
+		m_vArcs[middle].rCap -= delta;
+		// the source tree
+		for (i = m_vArcs[m_vArcs[middle].sister].head; ; ) {
+			const int a = m_vNodes[i].parent;
+			if (a == TERMINAL) break;
+			m_vArcs[a].rCap += delta;
+			m_vArcs[m_vArcs[a].sister].rCap -= delta;
+			if (m_vArcs[m_vArcs[a].sister].rCap <= 0) setOrphan(i);
+			i = m_vArcs[a].head;
+		}
+		m_vNodes[i].trCap -= delta;
+		if (m_vNodes[i].trCap <= 0) setOrphan(i);
+		// the sink tree
+		for (i = m_vArcs[middle].head; ; ) {
+			const int a = m_vNodes[i].parent;
+			if (a == TERMINAL) break;
+			m_vArcs[m_vArcs[a].sister].rCap += delta;
+			m_vArcs[a].rCap -= delta;
+			if (m_vArcs[a].rCap <= 0) setOrphan(i);
+			i = m_vArcs[a].head;
+		}
+		m_vNodes[i].trCap += delta;
+		if (m_vNodes[i].trCap >= 0) setOrphan(i);
+
+		m_flow += delta;
+	}
+
+	// Looks for a new valid parent of the orphan i in its own tree; if there is no such parent, the node becomes free
+	void CMaxFlow::processOrphan(int i)
+	{
+		const bool	isSink	= m_vNodes[i].isSink;
+		const int	INF		= std::numeric_limits<int>::max();
+		int			minArc	= NONE;
+		int			minDist = INF;
+
+		for (int a0 = m_vNodes[i].first; a0 != NONE; a0 = m_vArcs[a0].next) {
+			const double cap = isSink ? m_vArcs[a0].rCap : m_vArcs[m_vArcs[a0].sister].rCap;
+			if (cap <= 0) continue;
+			int j = m_vArcs[a0].head;
+			if (m_vNodes[j].isSink != isSink || m_vNodes[j].parent == NONE) continue;
+
+			// Checking the origin of j
+			int d = 0;
+			for (;;) {
+				if (m_vNodes[j].ts == m_time) { d += m_vNodes[j].dist; break; }
+				const int a = m_vNodes[j].parent;
+				d++;
+				if (a == TERMINAL) {
+					m_vNodes[j].ts		= m_time;
+					m_vNodes[j].dist	= 1;
+					break;
+				}
+				if (a == ORPHAN) { d = INF; break; }
+				j = m_vArcs[a].head;
+			}
+			if (d == INF) continue;
+
+			// j originates from the terminal
+			if (d < minDist) {
+				minArc	= a0;
+				minDist = d;
+			}
+			// marking the path
+			for (j = m_vArcs[a0].head; m_vNodes[j].ts != m_time; j = m_vArcs[m_vNodes[j].parent].head) {
+				m_vNodes[j].ts		= m_time;
+				m_vNodes[j].dist	= d--;
+			}
+		} // a0
+
+		if (minArc != NONE) {
+			m_vNodes[i].parent	= minArc;
+			m_vNodes[i].ts		= m_time;
+			m_vNodes[i].dist	= minDist + 1;
+			return;
+		}
+
+		// No parent is found: the neighbours, which may grow into i are activated, and the children of i become orphans
+		m_vNodes[i].parent = NONE;
+		for (int a0 = m_vNodes[i].first; a0 != NONE; a0 = m_vArcs[a0].next) {
+			const int j = m_vArcs[a0].head;
+			const int a = m_vNodes[j].parent;
+			if (m_vNodes[j].isSink != isSink || a == NONE) continue;
+			const double cap = isSink ? m_vArcs[a0].rCap : m_vArcs[m_vArcs[a0].sister].rCap;
+			if (cap > 0) setActive(j);
+			if (a != TERMINAL && a != ORPHAN && m_vArcs[a].head == i) setOrphan(j);
+		}
+	}
+}
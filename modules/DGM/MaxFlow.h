@@ -0,0 +1,111 @@
+// Boykov-Kolmogorov max-flow / min-cut class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Max-Flow Class ================================
+	/**
+	* @brief Max-flow / min-cut solver
+	* @details This class implements the augmenting paths algorithm of 
+	* <a href="https://www.csd.uwo.ca/~yboykov/Papers/pami04.pdf" target="_blank">Boykov and Kolmogorov</a>, which reuses the search trees, grown 
+	* from the source and from the sink, after every augmentation. The algorithm is efficient for the sparse graphs, arising in the computer vision.
+	* 
+	* The graph storage is kept by reset(): the graph of the same or smaller size may be built again without memory allocations.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CMaxFlow
+	{
+	public:
+		DllExport CMaxFlow(void) = default;
+		DllExport ~CMaxFlow(void) = default;
+
+		/**
+		* @brief Resets the graph
+		* @details Removes all the edges and sets the number of nodes; the memory is kept for reuse
+		* @param nNodes The number of nodes
+		* @param nEdges The expected number of edges (optional)
+		*/
+		DllExport void		reset(size_t nNodes, size_t nEdges = 0);
+		/**
+		* @brief Adds the edge between two nodes
+		* @param i The first node
+		* @param j The second node
+		* @param cap The capacity of the edge \a i -> \a j
+		* @param revCap The capacity of the edge \a j -> \a i
+		*/
+		DllExport void		addEdge(size_t i, size_t j, double cap, double revCap);
+		/**
+		* @brief Adds the terminal edges to the node
+		* @details May be called several times for one node: the capacities are accumulated
+		* @param i The node
+		* @param capSource The capacity of the edge \a source -> \a i
+		* @param capSink The capacity of the edge \a i -> \a sink
+		*/
+		DllExport void		addTWeights(size_t i, double capSource, double capSink);
+		/**
+		* @brief Calculates the maximal flow
+		* @return The value of the maximal flow, which is the value of the minimal cut
+		*/
+		DllExport double	maxflow(void);
+		/**
+		* @brief Checks whether the node belongs to the sink set of the minimal cut
+		* @note Valid only after maxflow()
+		* @param i The node
+		* @retval true if the node belongs to the sink set
+		* @retval false if the node belongs to the source set
+		*/
+		DllExport bool		isSink(size_t i) const { return m_vNodes[i].parent != NONE && m_vNodes[i].isSink; }
+		/**
+		* @brief Returns the memory, used by the solver
+		* @return The size of the solver and of its containers in bytes
+		*/
+		DllExport size_t	getMemoryUsage(void) const;
+		/**
+		* @brief Estimates the memory of the solver
+		* @param nNodes The number of nodes
+		* @param nEdges The number of edges
+		* @return The estimated size of the solver in bytes, including the queues at full length
+		*/
+		DllExport static size_t	estimateMemory(size_t nNodes, size_t nEdges);
+
+
+	private:
+		static const int NONE		= -1;			///< The node is free
+		static const int TERMINAL	= -2;			///< The parent is the terminal
+		static const int ORPHAN		= -3;			///< The node has lost its parent
+
+		struct Node {
+			int		first;			///< The first outgoing arc
+			int		parent;			///< The arc to the parent in the search tree, or NONE, TERMINAL, ORPHAN
+			int		ts;				///< Time stamp of the distance
+			int		dist;			///< Distance to the terminal
+			bool	isSink;			///< Flag indicating whether the node belongs to the sink search tree
+			bool	isActive;		///< Flag indicating whether the node is in the active queue
+			double	trCap;			///< Residual capacity of the terminal edge: > 0 from the source, < 0 to the sink
+		};
+		struct Arc {
+			int		head;			///< The node, the arc goes to
+			int		next;			///< The next arc, outgoing from the same node
+			int		sister;			///< The reverse arc
+			double	rCap;			///< Residual capacity
+		};
+
+		void		setActive(int i);
+		int			nextActive(void);
+		void		augment(int middleArc);
+		void		processOrphan(int i);
+		void		setOrphan(int i);
+
+
+	private:
+		std::vector<Node>	m_vNodes;
+		std::vector<Arc>	m_vArcs;
+		std::deque<int>		m_qActive;		///< Queue of the active nodes
+		std::deque<int>		m_qOrphans;		///< Queue of the orphan nodes
+		double				m_flow	= 0;
+		int					m_time	= 0;
+	};
+}
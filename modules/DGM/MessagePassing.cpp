@@ -1,6 +1,17 @@
 #include "MessagePassing.h"
 #include "GraphPairwise.h"
+#include "GraphPairwiseCSR.h"
+#include "GraphGrid.h"
+#include "Arena.h"
+#include "simd.h"
+#include "kernels.h"
+#include "footprint.h"
 #include "macroses.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "numa.h"
+#include <deque>
+#include <unordered_map>
 
 namespace DirectGraphicalModels
 {
@@ -9,100 +20,345 @@ namespace DirectGraphicalModels
 		const byte   nStates = getGraph().getNumStates();
 
 		// ====================================== Initialization ======================================
-		createMessages(1.0f / nStates);				// msg[] = 1 / nStates; msg_temp[] = 1 / nStates;
+		resetConvergence();
+		beginPhase("setup");
+		createMessages(m_logDomain ? 0.0f : 1.0f / nStates);	// msg[] = 1 / nStates (or log(1) = 0); msg_temp[] = msg[];
 
 		// =================================== Calculating messages ==================================
-		calculateMessages(nIt);
+		beginPhase("messages");
+		updateMessages(nIt);
 
 		// =================================== Calculating beliefs ===================================
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, getGraphPairwise().m_vNodes.size()), [&, nStates](const Range& range) {
-#else
-		const Range range(0, getGraphPairwise().m_vNodes.size());
-#endif
-		for (int i = range.start; i < range.end; i++) {
-			auto& node = getGraphPairwise().m_vNodes[i];
-			for (size_t e_f : node->from) {
-				float* msg = getMessage(e_f);				// message of current incoming edge
-				float epsilon = FLT_EPSILON;
-				for (byte s = 0; s < nStates; s++) { 		// states
-					// node->Pot.at<float>(s,0) *= msg[s];
-					node->Pot.at<float>(s, 0) = (epsilon + node->Pot.at<float>(s, 0)) * (epsilon + msg[s]);		// Soft multiplication
-				} //s
-			} // e_f
+		beginPhase("beliefs");
+		parallel::parallelFor(Range(0, static_cast<int>(getGraph().getNumNodes())), [&, nStates](const Range& range) {
+			for (int i = range.start; i < range.end; i++)
+				calculateBelief(i, getNodePot(i));
+		});
+		deleteMessages();
+		endPhase();
+	}
+
+	Mat CMessagePassing::getCurrentBeliefs(void)
+	{
+		const int nNodes = static_cast<int>(getGraph().getNumNodes());
+		m_currentBeliefs.create(nNodes, getGraph().getNumStates(), CV_32FC1);
+		parallel::parallelFor(Range(0, nNodes), [&](const Range &range) {
+			for (int i = range.start; i < range.end; i++)
+				calculateBelief(i, m_currentBeliefs.ptr<float>(i));
+		});
+		return m_currentBeliefs;
+	}
 
-			// Normalization
+	void CMessagePassing::calculateBelief(size_t node, float *pot)
+	{
+		const byte nStates = getGraph().getNumStates();
+
+		if (m_logDomain) {
+			memcpy(pot, getNodePotLog(node), nStates * sizeof(float));
+			for (size_t e_f : getInEdges(node)) {
+				const float *msg = readInMessage(e_f);
+				for (byte s = 0; s < nStates; s++) pot[s] += msg[s];
+			} // e_f
+			simd::expVec(pot, pot, nStates, *std::max_element(pot, pot + nStates));
 			float SUM_pot = 0;
-			for (byte s = 0; s < nStates; s++)				// states
-				SUM_pot += node->Pot.at<float>(s, 0);
-			for (byte s = 0; s < nStates; s++) {			// states
-				node->Pot.at<float>(s, 0) /= SUM_pot;
-				DGM_ASSERT_MSG(!std::isnan(node->Pot.at<float>(s, 0)), "The lower precision boundary for the potential of the node %zu is reached.\n \
-						SUM_pot = %f\n", node->id, SUM_pot);
+			for (byte s = 0; s < nStates; s++) SUM_pot += pot[s];
+			for (byte s = 0; s < nStates; s++) pot[s] /= SUM_pot;			// SUM_pot >= 1
+			return;
+		}
+		if (pot != getNodePot(node)) memcpy(pot, getNodePot(node), nStates * sizeof(float));
+		for (size_t e_f : getInEdges(node)) {
+			const float *msg = readInMessage(e_f);			// message of current incoming edge
+			float epsilon = FLT_EPSILON;
+			for (byte s = 0; s < nStates; s++) { 			// states
+				// pot[s] *= msg[s];
+				pot[s] = (epsilon + pot[s]) * (epsilon + msg[s]);		// Soft multiplication
+			} //s
+		} // e_f
+
+		// Normalization
+		float SUM_pot = 0;
+		for (byte s = 0; s < nStates; s++)					// states
+			SUM_pot += pot[s];
+		for (byte s = 0; s < nStates; s++) {				// states
+			pot[s] /= SUM_pot;
+			DGM_ASSERT_MSG(!std::isnan(pot[s]), "The lower precision boundary for the potential of the node %zu is reached.\n \
+					SUM_pot = %f\n", node, SUM_pot);
+		}
+	}
+
+	size_t CMessagePassing::getMemoryUsage(void) const
+	{
+		size_t res = CInfer::getMemoryUsage() + sizeof(*this) - sizeof(CInfer);
+		for (const MessageStore *pStore : { &m_msgStore, &m_msgStoreTemp })
+			res += footprint::getBytes(pStore->vHalf) + footprint::getBytes(pStore->vValues) + footprint::getBytes(pStore->vStates);
+		res += footprint::getBytes(m_currentBeliefs);
+		if (m_pMsgSeq) res += getNumEdgeSlots() * sizeof(std::atomic<dword>);
+		res += footprint::getBytes(m_vWarmMsg) + footprint::getBytes(m_vEdgePotSquaredHalf) + footprint::getBytes(m_vActiveStates) + footprint::getBytes(m_vActiveOffset);
+		res += footprint::getBytes(m_vpNodePot) + footprint::getBytes(m_vpEdgePot) + footprint::getBytes(m_vEdgePotPotts) + footprint::getBytes(m_vpEdgePotSquared)
+			+ footprint::getBytes(m_vEdgePotSquared) + footprint::getBytes(m_vEdgePotIdx) + footprint::getBytes(m_vEdgePotModel) + footprint::getBytes(m_vEdgePotModelSquared);
+		res += footprint::getBytes(m_vEdgeSrc) + footprint::getBytes(m_vEdgeDst) + footprint::getBytes(m_vOutOffset) + footprint::getBytes(m_vOutEdges)
+			+ footprint::getBytes(m_vInOffset) + footprint::getBytes(m_vInEdges);
+		return res;
+	}
+
+	size_t CMessagePassing::estimateMemory(size_t nNodes, size_t nEdges, byte nStates, size_t nPots, bool ownAdjacency)
+	{
+		const size_t potSize = static_cast<size_t>(nStates) * nStates * sizeof(float);
+		size_t res = sizeof(CMessagePassing);
+		res += 2 * nEdges * nStates * sizeof(float);												// messages and temp messages
+		res += nNodes * sizeof(float *) + 2 * nEdges * sizeof(float *) + nEdges * sizeof(size_t);		// graph view: pointers to the potentials and to the squared potentials, indexes of the distinct potentials
+		res += nPots * (potSize + 2 * sizeof(EdgePotModel) + 4 * sizeof(void *));					// squared distinct potentials, their models and the hash map of the distinct potentials
+		if (ownAdjacency) res += 4 * nEdges * sizeof(size_t) + 2 * (nNodes + 1) * sizeof(size_t);	// own copy of the edges and of the CSR adjacency
+		return res;
+	}
+
+	void CMessagePassing::setIncremental(bool enable, float threshold)
+	{
+		DGM_ASSERT_MSG(threshold >= 0, "Negative threshold %f is not allowed", threshold);
+		m_incremental			= enable;
+		m_incrementalThreshold	= threshold;
+		getGraphPairwise().setDirtyTracking(enable);
+		if (enable) {
+			setWarmStart(true);
+			if (!getOutput()) setKeepPotentials(true);
+		}
+	}
+
+	void CMessagePassing::setStatePruning(float threshold)
+	{
+		DGM_ASSERT_MSG(threshold >= 0 && threshold <= 1, "The threshold %f is out of range [0; 1]", threshold);
+		m_pruneThreshold = threshold;
+	}
+
+	void CMessagePassing::calculateMessagesLocal(const vec_size_t &vNodes, unsigned int nIt)
+	{
+		const byte		nStates		= getGraph().getNumStates();
+		const size_t	nEdges		= getNumEdgeSlots();
+		const size_t	maxUpdates	= static_cast<size_t>(nIt) * nEdges;
+		const bool		maxSum		= isMaxSum();
+		std::deque<size_t>	qEdges;
+		vec_byte_t			vQueued(nEdges, 0);
+
+		auto schedule = [&](size_t e) {
+			if (vQueued[e] || !getEdgePot(e)) return;
+			vQueued[e] = 1;
+			qEdges.push_back(e);
+		};
+		for (size_t n : vNodes)
+			for (size_t e_t : getOutEdges(n)) schedule(e_t);
+
+		float	*temp		= CArena::getScratch<float>(nStates);
+		float	*msg_new	= CArena::getScratch<float>(nStates, 2);
+		float	 msg_old[256];
+		float	 maxResidual = 0;
+		size_t	 nUpdates	 = 0;
+		while (!qEdges.empty() && nUpdates < maxUpdates) {
+			const size_t e = qEdges.front();
+			qEdges.pop_front();
+			vQueued[e] = 0;
+
+			const float *msg = readMessage(e, msg_old);
+			if (msg != msg_old) memcpy(msg_old, msg, nStates * sizeof(float));		// the message is overwritten below
+			calculateMessage(e, temp, msg_new, maxSum);
+			writeMessage(e, msg_new);
+			nUpdates++;
+
+			float res = 0;
+			for (byte s = 0; s < nStates; s++) res += fabs(msg_new[s] - msg_old[s]);
+			if (maxResidual < res) maxResidual = res;
+			if (res > m_incrementalThreshold) {												// the messages, depending on the changed one
+				const size_t src = getEdgeSrc(e);
+				for (size_t e_t : getOutEdges(getEdgeDst(e)))
+					if (getEdgeDst(e_t) != src) schedule(e_t);
 			}
+			if (nUpdates % 1024 == 0 && getTimeBudget().isExpired()) break;
 		}
-#ifdef ENABLE_PDP
-		});
-#endif
-		deleteMessages();
+		isConverged(0, maxResidual, nUpdates);
+	}
+
+	void CMessagePassing::updateMessages(unsigned int nIt)
+	{
+		IGraphPairwise &graph = getGraphPairwise();
+		if (m_incremental && m_warmLoaded && graph.isDirtyTracking()) {
+			DGM_PROFILE_ZONE("Incremental messages");
+			calculateMessagesLocal(graph.getDirtyNodes(), nIt);
+		}
+		else calculateMessages(nIt);
+		if (graph.isDirtyTracking()) graph.clearDirtyNodes();
 	}
 
 	// dst: usually edge msg or edge msg_temp
-	void CMessagePassing::calculateMessage(const Edge& edge_to, float* temp, float* dst, bool maxSum)
+	void CMessagePassing::calculateMessage(size_t edge_to, float* temp, float* dst, bool maxSum)
 	{
-		Node		* node = getGraphPairwise().m_vNodes[edge_to.node1].get();		// source node
+		const size_t  src = getEdgeSrc(edge_to);									// source node
+		const size_t  dstNode = getEdgeDst(edge_to);								// destination node
 		const byte	  nStates = getGraph().getNumStates();							// number of states
 
-		// Compute temp = product of all incoming msgs except e_t
-		for (byte s = 0; s < nStates; s++) temp[s] = node->Pot.at<float>(s, 0);		// temp = node.Pot
+		if (!m_vActiveOffset.empty()) {
+			calculateMessageSparse(edge_to, temp, dst, maxSum);
+			return;
+		}
 
-		for (size_t e_f : node->from) {												// incoming edges
-			Edge *edge_from = getGraphPairwise().m_vEdges[e_f].get();				// current incoming edge
-			if (edge_from->node1 != edge_to.node2) {
-				float *msg = getMessage(e_f);										// message of current incoming edge
-				for (byte s = 0; s < nStates; s++)
-					temp[s] *= msg[s];												// temp = temp * msg
-			}
-		} // e_f
+		if (m_logDomain) {
+			// temp = sum of all incoming log-msgs except e_t
+			memcpy(temp, getNodePotLog(src), nStates * sizeof(float));
+			for (size_t e_f : getInEdges(src))
+				if (getEdgeSrc(e_f) != dstNode) {
+					const float *msg = readInMessage(e_f);
+					for (byte s = 0; s < nStates; s++) temp[s] += msg[s];
+				}
 
-		// Compute new message: new_msg = (edge_to.Pot^2)^t x temp
-		float Z = MatMul(edge_to.Pot, temp, dst, maxSum);
+			// log-sum-exp: new_msg = log((edge_to.Pot^2)^t x exp(temp - max(temp)))
+			if (!m_vpEdgePot[edge_to]) {
+				std::fill(dst, dst + nStates, 0.0f);
+				return;
+			}
+			simd::expVec(temp, temp, nStates, *std::max_element(temp, temp + nStates));
+			multiplyEdgePotSquared(edge_to, temp, dst, maxSum);
+			simd::logVec(dst, dst, nStates);
+			const float max = *std::max_element(dst, dst + nStates);
+			for (byte s = 0; s < nStates; s++) dst[s] -= max;
+			return;
+		}
 
-		// Normalization and setting new values
-		if (Z > FLT_EPSILON)
-			for (byte s = 0; s < nStates; s++)
-				dst[s] /= Z;
-		else
-			for (byte s = 0; s < nStates; s++)
-				dst[s] = 1.0f / nStates;
+		(this->*m_pCalculateMessageDense)(edge_to, temp, dst, maxSum);
 	}
 
 	void CMessagePassing::createMessages(std::optional<float> val)
 	{
-		const size_t nEdges = getGraph().getNumEdges();
 		const byte	nStates	= getGraph().getNumStates();
-		
-		m_msg = new float[nEdges * nStates];
-		DGM_ASSERT_MSG(m_msg, "Out of Memory");
-		m_msg_temp = new float[nEdges * nStates];
-		DGM_ASSERT_MSG(m_msg_temp, "Out of Memory");
 
-		if (val) {
-			std::fill(m_msg, m_msg + nEdges * nStates, val.value());
-			std::fill(m_msg_temp, m_msg_temp + nEdges * nStates, val.value());
+		deleteMessages();
+		m_pCalculateMessageDense = kernels::dispatch(nStates, [](auto N) { return &CMessagePassing::calculateMessageDense<decltype(N)::value>; });
+		createGraphView();
+		createOutputView();
+		createSquaredPotentials();
+		if (m_pruneThreshold > 0) createActiveStates();
+		const size_t nEdges = getNumEdgeSlots();
+
+		const bool inPlace = isInPlace();
+		if (isConcurrent()) m_pMsgSeq = std::make_unique<std::atomic<dword>[]>(nEdges);
+		m_msgCompressed = m_compression != MessageCompression::none && isCompressible();
+		if (m_msgCompressed) {
+			createStore(m_msgStore, nEdges);
+			if (!inPlace) createStore(m_msgStoreTemp, nEdges);
+		}
+		else {
+			m_msg = getArena().allocate<float>(nEdges * nStates);
+			if (!inPlace) m_msg_temp = getArena().allocate<float>(nEdges * nStates);
+		}
+		if (m_logDomain) {
+			const size_t nNodes = m_vpNodePot.size();
+			m_pNodePotLog = getArena().allocate<float>(nNodes * nStates);
+			for (size_t n = 0; n < nNodes; n++)
+				simd::logVec(getNodePot(n), m_pNodePotLog + n * nStates, nStates);
+		}
+
+		const bool warm = m_warmStart && m_vWarmMsg.size() == nEdges * nStates && m_warmHash == getTopologyHash();
+		m_warmLoaded = warm;
+		if (m_msgCompressed) {
+			vec_float_t vMsg(nStates);
+			for (size_t e = 0; e < nEdges; e++) {
+				if (warm)	std::copy(m_vWarmMsg.begin() + e * nStates, m_vWarmMsg.begin() + (e + 1) * nStates, vMsg.begin());
+				else		std::fill(vMsg.begin(), vMsg.end(), val.value_or(0.0f));
+				if (m_init && getEdgePot(e)) m_init(getEdgeSrc(e), getEdgeDst(e), vMsg.data());
+				writeMessage(e, vMsg.data());
+				if (!inPlace) writeMessage(e, vMsg.data(), true);
+			}
+			return;
+		}
+
+		// The messages are first-touched in the partitioning of the parallel loops over the edges
+		if (warm) {
+			const float *pWarm = m_vWarmMsg.data();
+			numa::firstTouch(m_msg, nEdges * nStates, sizeof(float), [&](size_t begin, size_t end) { std::copy(pWarm + begin, pWarm + end, m_msg + begin); });
+			if (m_msg_temp) numa::firstTouch(m_msg_temp, nEdges * nStates, sizeof(float), [&](size_t begin, size_t end) { std::copy(pWarm + begin, pWarm + end, m_msg_temp + begin); });
+		}
+		else if (val) {
+			numa::fill(m_msg, nEdges * nStates, val.value());
+			if (m_msg_temp) numa::fill(m_msg_temp, nEdges * nStates, val.value());
+		}
+
+		if (m_init) 
+			for (size_t e = 0; e < nEdges; e++) {
+				if (!getEdgePot(e)) continue;												// unused edge slot
+				m_init(getEdgeSrc(e), getEdgeDst(e), getMessage(e));
+				if (m_msg_temp) memcpy(getMessageTemp(e), getMessage(e), nStates * sizeof(float));
+			}
+
+		// The placement is queried only, when the buffers are re-allocated or re-sized. The re-allocated message buffers may re-use the memory of the arena,
+		// which has been touched before with another layout, thus they are moved to their nodes explicitly
+		if (numa::isEnabled()) {
+			const size_t msgSize = nEdges * nStates * sizeof(float);
+			std::vector<std::pair<const void *, size_t>> vBuffers = { { m_msg, msgSize }, { m_msg_temp, m_msg_temp ? msgSize : 0 } };
+			const CGraphPairwiseCSR *pGraphCSR	= dynamic_cast<const CGraphPairwiseCSR *>(&getGraph());
+			const CGraphGrid		*pGraphGrid	= dynamic_cast<const CGraphGrid *>(&getGraph());
+			if (pGraphCSR) {
+				vBuffers.emplace_back(pGraphCSR->m_vNodePots.data(), pGraphCSR->m_vNodePots.size() * sizeof(float));
+				vBuffers.emplace_back(pGraphCSR->m_vEdgePots.data(), pGraphCSR->m_vEdgePots.size() * sizeof(float));
+			}
+			if (pGraphGrid) {
+				vBuffers.emplace_back(pGraphGrid->m_vNodePots.data(), pGraphGrid->m_vNodePots.size() * sizeof(float));
+				vBuffers.emplace_back(pGraphGrid->m_vEdgePots.data(), pGraphGrid->m_vEdgePots.size() * sizeof(float));
+			}
+			if (vBuffers != m_vNumaBuffers) {
+				if (val || warm) {
+					numa::distribute(m_msg, msgSize);
+					if (m_msg_temp) numa::distribute(m_msg_temp, msgSize);
+				}
+				m_vNumaBytes.assign(numa::getNumNodes(), 0);
+				for (const auto &buffer : vBuffers) {
+					const vec_size_t vPlacement = numa::getPlacement(buffer.first, buffer.second);
+					for (size_t i = 0; i < m_vNumaBytes.size(); i++) m_vNumaBytes[i] += vPlacement[i];
+				}
+				m_vNumaBuffers = std::move(vBuffers);
+			}
+			setNumaBytes(m_vNumaBytes);
 		}
 	}
 
+	void CMessagePassing::createView(void)
+	{
+		deleteMessages();
+		createGraphView();
+		createOutputView();
+		createSquaredPotentials();
+	}
+
 	void CMessagePassing::deleteMessages(void)
 	{
-		if (m_msg) {
-			delete[] m_msg;
-			m_msg = NULL;
+		const byte nStates = getGraph().getNumStates();
+		if (m_msgCompressed) {													// the callbacks receive the decompressed copies
+			vec_float_t vMsg(nStates);
+			if (m_collect)
+				for (size_t e = 0; e < getNumEdgeSlots(); e++)
+					if (getEdgePot(e)) {
+						decompressMessage(m_msgStore, e, vMsg.data());
+						m_collect(getEdgeSrc(e), getEdgeDst(e), vMsg.data());
+					}
+			if (m_warmStart) {
+				m_vWarmMsg.resize(getNumEdgeSlots() * nStates);
+				for (size_t e = 0; e < getNumEdgeSlots(); e++)
+					decompressMessage(m_msgStore, e, m_vWarmMsg.data() + e * nStates);
+				m_warmHash = getTopologyHash();
+			}
 		}
-		if (m_msg_temp) {
-			delete[] m_msg_temp;
-			m_msg_temp = NULL;
+		if (m_collect && m_msg)
+			for (size_t e = 0; e < getNumEdgeSlots(); e++)
+				if (getEdgePot(e)) m_collect(getEdgeSrc(e), getEdgeDst(e), getMessage(e));
+		if (m_warmStart && m_msg) {
+			m_vWarmMsg.assign(m_msg, m_msg + getNumEdgeSlots() * nStates);
+			m_warmHash = getTopologyHash();
 		}
+		m_msg		= NULL;
+		m_msg_temp	= NULL;
+		m_msgCompressed = false;
+		m_pMsgSeq.reset();
+		m_msgStore		= MessageStore();
+		m_msgStoreTemp	= MessageStore();
+		m_pNodePotLog = NULL;
+		getArena().reset();															// the memory is kept for the next inference
+		deleteGraphView();
 	}
 
 	void CMessagePassing::swapMessages(void)
@@ -110,18 +366,63 @@ namespace DirectGraphicalModels
 		float *pTemp = m_msg;
 		m_msg = m_msg_temp;
 		m_msg_temp = pTemp;
+		std::swap(m_msgStore, m_msgStoreTemp);
 	}
 
-	float* CMessagePassing::getMessage(size_t edge) 
-	{ 
+	const CMessagePassing::EdgePotModel& CMessagePassing::getEdgePotModel(size_t edge, bool squared) const
+	{
+		static const EdgePotModel general;
+		if (!m_vpEdgePot[edge]) return general;
+		return squared ? m_vEdgePotModelSquared[m_vEdgePotIdx[edge]] : m_vEdgePotModel[m_vEdgePotIdx[edge]];
+	}
+
+	float* CMessagePassing::getMessage(size_t edge)
+	{
 		return m_msg ? m_msg + edge * getGraph().getNumStates() : NULL;
 	}
 
-	float* CMessagePassing::getMessageTemp(size_t edge) 
-	{ 
+	float* CMessagePassing::getMessageTemp(size_t edge)
+	{
 		return m_msg_temp ? m_msg_temp + edge * getGraph().getNumStates() : NULL;
 	}
 
+	// The sequence of the concurrent message is odd while the message is written: the reader repeats the copy until it sees the same even sequence before and after
+	const float* CMessagePassing::readMessage(size_t edge, float *buf) const
+	{
+		const byte nStates = getGraph().getNumStates();
+		if (!m_pMsgSeq) {
+			if (!m_msgCompressed) return m_msg + edge * nStates;
+			decompressMessage(m_msgStore, edge, buf);
+			return buf;
+		}
+
+		const std::atomic<dword> &seq = m_pMsgSeq[edge];
+		for (;;) {
+			const dword begin = seq.load(std::memory_order_acquire);
+			if (begin & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			if (m_msgCompressed) decompressMessage(m_msgStore, edge, buf);
+			else memcpy(buf, m_msg + edge * nStates, nStates * sizeof(float));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq.load(std::memory_order_relaxed) == begin) return buf;
+		}
+	}
+
+	void CMessagePassing::writeMessage(size_t edge, const float *msg, bool temp)
+	{
+		std::atomic<dword> *pSeq = m_pMsgSeq && !temp ? &m_pMsgSeq[edge] : NULL;
+		const dword			seq	 = pSeq ? pSeq->load(std::memory_order_relaxed) : 0;
+		if (pSeq) {
+			pSeq->store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+		if (m_msgCompressed) compressMessage(temp ? m_msgStoreTemp : m_msgStore, edge, msg);
+		else memcpy(temp ? getMessageTemp(edge) : getMessage(edge), msg, getGraph().getNumStates() * sizeof(float));
+		if (pSeq) pSeq->store(seq + 2, std::memory_order_release);
+	}
+
 	// dst = (M * M)^T x v
 	float CMessagePassing::MatMul(const Mat& M, const float* v, float* dst, bool maxSum)
 	{
@@ -140,4 +441,602 @@ namespace DirectGraphicalModels
 		} // x
 		return res;
 	}
+
+	// dst = M^T x v
+	float CMessagePassing::MatMul(const EdgePotModel &model, const float* M, const float* v, float* dst, byte nStates, bool maxSum)
+	{
+		const int	n = nStates;
+		const float	a = model.diag;
+		const float	r = model.rate;
+		const float	c = model.trunc;
+
+		float S = 0;																// sum of v
+		float vMax = 0;																// max of v
+		for (int y = 0; y < n; y++) {
+			S += v[y];
+			if (vMax < v[y]) vMax = v[y];
+		}
+
+		switch (model.kind) {
+			case EdgePotKind::potts:
+				if (maxSum) {
+					int		yMax = 0;
+					float	vMax2 = 0;												// second maximum of v
+					for (int y = 1; y < n; y++) if (v[y] > v[yMax]) yMax = y;
+					for (int y = 0; y < n; y++) if (y != yMax && v[y] > vMax2) vMax2 = v[y];
+					for (int x = 0; x < n; x++) dst[x] = MAX(a * v[x], c * (x == yMax ? vMax2 : vMax));
+				}
+				else
+					for (int x = 0; x < n; x++) dst[x] = c * S + (a - c) * v[x];
+				break;
+			
+			case EdgePotKind::truncatedLinear:
+				if (maxSum) {
+					// Distance transform: two passes with the geometric decay
+					float h = 0;
+					for (int x = 0; x < n; x++) {
+						h = MAX(a * v[x], r * h);
+						dst[x] = h;
+					}
+					h = 0;
+					for (int x = n - 1; x >= 0; x--) {
+						h = MAX(a * v[x], r * h);
+						dst[x] = MAX(MAX(dst[x], h), c * vMax);
+					}
+				}
+				else {
+					// g(d) = c + (a * r^d - c) for d < T, and g(d) = c for d >= T
+					int T = 1;
+					double rT = r;
+					while (T < n && a * rT > c) { T++; rT *= r; }
+
+					double prefix[257];
+					prefix[0] = 0;
+					for (int y = 0; y < n; y++) prefix[y + 1] = prefix[y] + v[y];
+
+					double F = 0;													// F[x] = sum_{0 <= x - y < T} v[y] * r^(x - y)
+					for (int x = 0; x < n; x++) {
+						F = r * F + v[x] - (x >= T ? rT * v[x - T] : 0);
+						dst[x] = static_cast<float>(F);
+					}
+					double B = 0;													// B[x] = sum_{0 < y - x < T} v[y] * r^(y - x)
+					for (int x = n - 1; x >= 0; x--) {
+						if (x < n - 1) B = r * (B + v[x + 1]) - (x + T < n ? rT * v[x + T] : 0);
+						double W = prefix[MIN(n, x + T)] - prefix[MAX(0, x - T + 1)];	// sum_{|x - y| < T} v[y]
+						dst[x] = MAX(0.0f, static_cast<float>(c * S + a * (dst[x] + B) - c * W));
+					}
+				}
+				break;
+
+			case EdgePotKind::truncatedQuadratic:
+				if (maxSum) {
+					// Distance transform of the negative logarithms: lower envelope of parabolas
+					const float lambda = -logf(r);
+					float	f[256];													// f[y] = -log(v[y] / vMax)
+					int		loc[256];												// locations of the parabolas in the lower envelope
+					float	z[257];													// boundaries between the parabolas
+					int		k = -1;
+					for (int y = 0; y < n; y++) {
+						if (v[y] <= 0) continue;
+						f[y] = -logf(v[y] / vMax);
+						float s = -FLT_MAX;
+						while (k >= 0) {
+							const int q = loc[k];
+							s = ((f[y] + lambda * y * y) - (f[q] + lambda * q * q)) / (2 * lambda * (y - q));
+							if (s > z[k]) break;
+							k--;
+						}
+						k++;
+						loc[k]		= y;
+						z[k]		= k ? s : -FLT_MAX;
+						z[k + 1]	= FLT_MAX;
+					} // y
+					if (k < 0) {													// v == 0
+						std::fill(dst, dst + n, 0.0f);
+						return 0;
+					}
+					for (int x = 0, j = 0; x < n; x++) {
+						while (z[j + 1] < x) j++;
+						const int q = loc[j];
+						dst[x] = MAX(vMax * a * expf(-(lambda * (x - q) * (x - q) + f[q])), c * vMax);
+					}
+				}
+				else return simd::matTVecMul(M, v, dst, nStates, maxSum);
+				break;
+
+			default: return simd::matTVecMul(M, v, dst, nStates, maxSum);
+		}
+
+		float res = 0;
+		for (int x = 0; x < n; x++) res += dst[x];
+		return res;
+	}
+
+	CMessagePassing::EdgePotModel CMessagePassing::getEdgePotModel(const float* pot, byte nStates)
+	{
+		const int		n	= nStates;
+		EdgePotModel	res;
+		if (n < 3) return res;
+
+		// The first row g(d), d = |x - y| defines the symmetric Toeplitz matrix
+		const float *g = pot;
+		float gMax = 0;
+		for (int d = 0; d < n; d++) {
+			if (g[d] < 0) return res;
+			if (gMax < g[d]) gMax = g[d];
+		}
+		const float tol = 1e-5f * gMax;
+		if (gMax == 0) return res;
+		for (int y = 1; y < n; y++)
+			for (int x = 0; x < n; x++)
+				if (fabs(pot[y * n + x] - g[abs(x - y)]) > tol) return res;
+
+		// Potts
+		bool isPotts = true;
+		for (int d = 2; d < n; d++) 
+			if (fabs(g[d] - g[1]) > tol) { isPotts = false; break; }
+		if (isPotts) return { EdgePotKind::potts, g[0], 0, g[1] };
+
+		// Truncated linear and truncated quadratic
+		const float a = g[0];
+		const float r = g[1] / a;
+		const float c = g[n - 1];
+		if (a <= 0 || r >= 1 || r <= 0 || g[1] <= c) return res;
+		
+		bool isLinear		= true;
+		bool isQuadratic	= true;
+		for (int d = 2; d < n; d++) {
+			if (fabs(g[d] - MAX(a * powf(r, static_cast<float>(d)), c)) > tol)		isLinear = false;
+			if (fabs(g[d] - MAX(a * powf(r, static_cast<float>(d * d)), c)) > tol)	isQuadratic = false;
+		}
+		if (isLinear)		return { EdgePotKind::truncatedLinear, a, r, c };
+		if (isQuadratic)	return { EdgePotKind::truncatedQuadratic, a, r, c };
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The node potentials are copied into the output buffer, so that the inference reads and updates the buffer instead of the graph
+	void CMessagePassing::createOutputView(void)
+	{
+		Mat *pBeliefs = getOutput();
+		DGM_ASSERT_MSG(pBeliefs || !m_pInput, "The input buffer requires the output buffer");
+		if (!pBeliefs) return;
+
+		const size_t	nNodes	= m_vpNodePot.size();
+		const byte		nStates	= getGraph().getNumStates();
+		if (m_pInput) {
+			DGM_ASSERT_MSG(m_pInput->type() == CV_32FC1, "The input buffer must be of type CV_32FC1");
+			DGM_ASSERT_MSG(m_pInput->rows == static_cast<int>(nNodes) && m_pInput->cols == nStates, "The size of the input buffer (%d x %d) does not correspond to the graph (%zu x %d)",
+				m_pInput->rows, m_pInput->cols, nNodes, nStates);
+			DGM_ASSERT_MSG(m_pInput != pBeliefs, "The input and the output buffers must differ");
+		}
+		pBeliefs->create(static_cast<int>(nNodes), nStates, CV_32FC1);
+		for (size_t n = 0; n < nNodes; n++) {
+			float *pot = pBeliefs->ptr<float>(static_cast<int>(n));
+			memcpy(pot, m_pInput ? m_pInput->ptr<float>(static_cast<int>(n)) : m_vpNodePot[n], nStates * sizeof(float));
+			m_vpNodePot[n] = pot;
+		}
+	}
+
+	void CMessagePassing::createGraphView(void)
+	{
+		const size_t	nNodes	= getGraph().getNumNodes();
+		const size_t	nEdges	= getGraph().getNumEdges();
+		const byte		nStates	= getGraph().getNumStates();
+
+		m_vpNodePot.resize(nNodes);
+		m_vpEdgePot.resize(nEdges);
+
+		CGraphPairwiseCSR *pGraphCSR = dynamic_cast<CGraphPairwiseCSR *>(&getGraph());
+		if (pGraphCSR) {
+			pGraphCSR->buildIndex(true);
+			numa::distribute(pGraphCSR->m_vNodePots.data(), pGraphCSR->m_vNodePots.size() * sizeof(float));
+			numa::distribute(pGraphCSR->m_vEdgePots.data(), pGraphCSR->m_vEdgePots.size() * sizeof(float));
+			for (size_t n = 0; n < nNodes; n++)	m_vpNodePot[n] = &pGraphCSR->m_vNodePots[n * nStates];
+			for (size_t e = 0; e < nEdges; e++) {
+				m_vpEdgePot[e] = pGraphCSR->getEdgePot(e);
+				const float *pPotts = pGraphCSR->getEdgePotts(e);
+				if (!pPotts) continue;
+				if (m_vEdgePotPotts.empty()) m_vEdgePotPotts.assign(nEdges, 0);
+				m_vEdgePotPotts[e]	= 1;
+				m_vpEdgePot[e]		= pPotts;
+			}
+			m_pEdgeSrc		= pGraphCSR->m_vEdgeSrc.data();
+			m_pEdgeDst		= pGraphCSR->m_vEdgeDst.data();
+			m_pOutOffset	= pGraphCSR->m_vOutOffset.data();
+			m_pOutEdges		= pGraphCSR->m_vOutEdges.data();
+			m_pInOffset		= pGraphCSR->m_vInOffset.data();
+			m_pInEdges		= pGraphCSR->m_vInEdges.data();
+			return;
+		}
+
+		CGraphGrid *pGraphGrid = dynamic_cast<CGraphGrid *>(&getGraph());
+		if (pGraphGrid) {
+			const size_t nDirs	= pGraphGrid->m_vDirections.size();
+			const size_t nSlots	= pGraphGrid->getNumSlots();
+			vec_byte_t	 vValid(nSlots, 0);
+			numa::distribute(pGraphGrid->m_vNodePots.data(), pGraphGrid->m_vNodePots.size() * sizeof(float));
+			numa::distribute(pGraphGrid->m_vEdgePots.data(), pGraphGrid->m_vEdgePots.size() * sizeof(float));
+
+			m_vpEdgePot.resize(nSlots);
+			m_vEdgeSrc.resize(nSlots);
+			m_vEdgeDst.resize(nSlots);
+			for (size_t n = 0; n < nNodes; n++) {
+				m_vpNodePot[n] = &pGraphGrid->m_vNodePots[n * nStates];
+				for (size_t d = 0; d < nDirs; d++) {
+					size_t e	= n * nDirs + d;
+					size_t dst	= pGraphGrid->getNeighbour(n, d);
+					vValid[e]		= (dst < nNodes && !pGraphGrid->isSlotRemoved(e)) ? 1 : 0;
+					m_vEdgeSrc[e]	= n;
+					m_vEdgeDst[e]	= vValid[e] ? dst : n;
+					m_vpEdgePot[e]	= vValid[e] ? pGraphGrid->getSlotPot(e) : NULL;
+				} // d
+			} // n
+			buildAdjacency(nNodes, vValid);
+			return;
+		}
+
+		CGraphPairwise *pGraph = dynamic_cast<CGraphPairwise *>(&getGraph());
+		DGM_ASSERT_MSG(pGraph, "Message passing requires CGraphPairwise, CGraphPairwiseCSR or CGraphGrid graph");
+
+		// The graph of the user is not compacted: the removed edges (tombstones) are the unused slots, which belong to no node
+		const size_t nSlots = pGraph->m_vEdges.size();
+		m_vpEdgePot.resize(nSlots);
+		m_vEdgeSrc.resize(nSlots);
+		m_vEdgeDst.resize(nSlots);
+		for (size_t e = 0; e < nSlots; e++) {
+			const Edge *edge = pGraph->m_vEdges[e].get();
+			if (!edge) {
+				m_vEdgeSrc[e]	= 0;
+				m_vEdgeDst[e]	= 0;
+				m_vpEdgePot[e]	= NULL;
+				continue;
+			}
+			DGM_ASSERT_MSG(edge->Pot.empty() || edge->Pot.isContinuous(), "The potential of the edge %zu is not continuous", e);
+			m_vEdgeSrc[e]	= edge->node1;
+			m_vEdgeDst[e]	= edge->node2;
+			m_vpEdgePot[e]	= edge->Pot.empty() ? NULL : edge->Pot.ptr<float>();
+		}
+
+		m_vOutOffset.assign(nNodes + 1, 0);
+		m_vInOffset.assign(nNodes + 1, 0);
+		for (size_t n = 0; n < nNodes; n++) {
+			Node *node = pGraph->m_vNodes[n].get();
+			DGM_ASSERT_MSG(!node->Pot.empty(), "Specified node %zu is not set", n);
+			DGM_ASSERT_MSG(node->Pot.isContinuous(), "The potential of the node %zu is not continuous", n);
+			m_vpNodePot[n]		= node->Pot.ptr<float>();
+			m_vOutOffset[n + 1] = m_vOutOffset[n] + node->to.size();
+			m_vInOffset[n + 1]	= m_vInOffset[n] + node->from.size();
+		}
+		m_vOutEdges.resize(m_vOutOffset[nNodes]);
+		m_vInEdges.resize(m_vInOffset[nNodes]);
+		for (size_t n = 0; n < nNodes; n++) {
+			Node *node = pGraph->m_vNodes[n].get();
+			std::copy(node->to.begin(), node->to.end(), m_vOutEdges.begin() + m_vOutOffset[n]);
+			std::copy(node->from.begin(), node->from.end(), m_vInEdges.begin() + m_vInOffset[n]);
+		}
+
+		m_pEdgeSrc		= m_vEdgeSrc.data();
+		m_pEdgeDst		= m_vEdgeDst.data();
+		m_pOutOffset	= m_vOutOffset.data();
+		m_pOutEdges		= m_vOutEdges.data();
+		m_pInOffset		= m_vInOffset.data();
+		m_pInEdges		= m_vInEdges.data();
+	}
+
+	void CMessagePassing::createSquaredPotentials(void)
+	{
+		const size_t	nEdges	= getNumEdgeSlots();
+		const size_t	size	= static_cast<size_t>(getGraph().getNumStates()) * getGraph().getNumStates();
+		
+		// Distinct potentials
+		std::unordered_map<const float *, size_t> mIdx;
+		std::unordered_map<uint64_t, size_t>	  mPottsIdx;						// compact Potts potentials are distinguished by their values
+		vec_size_t				  & vIdx = m_vEdgePotIdx;
+		vIdx.assign(nEdges, 0);
+		std::vector<const float *>	vpPot;
+		std::vector<const float *>	vpPotts;
+		for (size_t e = 0; e < nEdges; e++) {
+			if (!m_vpEdgePot[e]) continue;
+			if (isEdgePotPotts(e)) {
+				dword bits[2];
+				memcpy(bits, m_vpEdgePot[e], sizeof(bits));
+				auto it = mPottsIdx.emplace((static_cast<uint64_t>(bits[0]) << 32) | bits[1], vpPotts.size());
+				if (it.second) vpPotts.push_back(m_vpEdgePot[e]);
+				vIdx[e] = it.first->second;
+				continue;
+			}
+			auto it = mIdx.emplace(m_vpEdgePot[e], vpPot.size());
+			if (it.second) vpPot.push_back(m_vpEdgePot[e]);
+			vIdx[e] = it.first->second;
+		}
+
+		// The models of the compact Potts potentials follow the models of the matrices
+		if (m_halfPrecision) m_vEdgePotSquaredHalf.resize(vpPot.size() * size);
+		else m_vEdgePotSquared.resize(vpPot.size() * size);
+		m_vEdgePotModel.resize(vpPot.size() + vpPotts.size());
+		m_vEdgePotModelSquared.resize(vpPot.size() + vpPotts.size());
+		for (size_t i = 0; i < vpPotts.size(); i++) {
+			m_vEdgePotModel[vpPot.size() + i]			= { EdgePotKind::potts, vpPotts[i][0], 0, vpPotts[i][1] };
+			m_vEdgePotModelSquared[vpPot.size() + i]	= m_vEdgePotModel[vpPot.size() + i].squared();
+		}
+		if (!vpPotts.empty())
+			for (size_t e = 0; e < nEdges; e++)
+				if (m_vpEdgePot[e] && isEdgePotPotts(e)) vIdx[e] += vpPot.size();
+		parallel::parallelFor(Range(0, static_cast<int>(vpPot.size())), [&](const Range& range) {
+			for (int i = range.start; i < range.end; i++) {
+				const float *pPot	= vpPot[i];
+				float		*pPot2	= m_halfPrecision ? CArena::getScratch<float>(size) : m_vEdgePotSquared.data() + i * size;
+				for (size_t k = 0; k < size; k++)
+					pPot2[k] = pPot[k] * pPot[k];
+				if (m_halfPrecision) simd::floatToHalf(pPot2, m_vEdgePotSquaredHalf.data() + i * size, static_cast<int>(size));
+				m_vEdgePotModel[i]			= getEdgePotModel(pPot, getGraph().getNumStates());
+				m_vEdgePotModelSquared[i]	= m_vEdgePotModel[i].squared();
+			}
+		});
+
+		// The Potts update does not access the matrix, thus the compact Potts edges point to their values
+		m_vpEdgePotSquared.resize(nEdges);
+		for (size_t e = 0; e < nEdges; e++)
+			if (isEdgePotPotts(e)) m_vpEdgePotSquared[e] = m_vpEdgePot[e];
+			else m_vpEdgePotSquared[e] = m_vpEdgePot[e] && !m_halfPrecision ? m_vEdgePotSquared.data() + vIdx[e] * size : NULL;
+	}
+
+	// Only the general model and the sum-product truncated quadratic model access the matrix
+	float CMessagePassing::multiplyEdgePotSquared(size_t edge, const float *v, float *dst, bool maxSum) const
+	{
+		const byte			  nStates	= getGraph().getNumStates();
+		const EdgePotModel	& model		= getEdgePotModel(edge, true);
+		const bool			  dense		= model.kind == EdgePotKind::general || (model.kind == EdgePotKind::truncatedQuadratic && !maxSum);
+		if (m_halfPrecision && dense)
+			return simd::matTVecMulHalf(m_vEdgePotSquaredHalf.data() + m_vEdgePotIdx[edge] * nStates * nStates, v, dst, nStates, maxSum);
+		return MatMul(model, getEdgePotSquared(edge), v, dst, nStates, maxSum);
+	}
+
+	template<int N>
+	void CMessagePassing::calculateMessageDense(size_t edge_to, float *temp, float *dst, bool maxSum)
+	{
+		const size_t  src		= getEdgeSrc(edge_to);									// source node
+		const size_t  dstNode	= getEdgeDst(edge_to);									// destination node
+		const byte	  nStates	= getGraph().getNumStates();							// number of states
+		const int	  n			= kernels::count<N>(nStates);
+
+		// Compute temp = product of all incoming msgs except e_t
+		memcpy(temp, getNodePot(src), n * sizeof(float));								// temp = node.Pot
+		for (size_t e_f : getInEdges(src))												// incoming edges
+			if (getEdgeSrc(e_f) != dstNode)
+				kernels::mul<N>(temp, readInMessage(e_f), nStates);						// temp = temp * msg
+
+		// Compute new message: new_msg = (edge_to.Pot^2)^t x temp
+		float Z = 0;
+		if (m_vpEdgePot[edge_to]) {
+			const EdgePotModel &model = getEdgePotModel(edge_to, true);
+			if (model.kind == EdgePotKind::general && !m_halfPrecision) Z = kernels::matTVecMul<N>(getEdgePotSquared(edge_to), temp, dst, nStates, maxSum);
+			else Z = multiplyEdgePotSquared(edge_to, temp, dst, maxSum);
+		}
+		else std::fill(dst, dst + n, 0.0f);
+
+		// Normalization and setting new values
+		if (Z > FLT_EPSILON)
+			for (int s = 0; s < n; s++) dst[s] /= Z;
+		else
+			for (int s = 0; s < n; s++) dst[s] = 1.0f / n;
+	}
+
+	void CMessagePassing::createActiveStates(void)
+	{
+		const size_t	nNodes	= m_vpNodePot.size();
+		const byte		nStates	= getGraph().getNumStates();
+
+		m_vActiveOffset.resize(nNodes + 1);
+		m_vActiveOffset[0] = 0;
+		m_vActiveStates.clear();
+		for (size_t n = 0; n < nNodes; n++) {
+			const float *pot		= getNodePot(n);
+			const float	 threshold	= m_pruneThreshold * *std::max_element(pot, pot + nStates);
+			for (byte s = 0; s < nStates; s++)
+				if (pot[s] >= threshold) m_vActiveStates.push_back(s);
+			m_vActiveOffset[n + 1] = m_vActiveStates.size();
+		}
+	}
+
+	// The inactive states of the source node do not contribute, and the inactive states of the destination node receive zeros
+	void CMessagePassing::calculateMessageSparse(size_t edge_to, float *temp, float *dst, bool maxSum)
+	{
+		const size_t		src			= getEdgeSrc(edge_to);
+		const size_t		dstNode		= getEdgeDst(edge_to);
+		const byte			nStates		= getGraph().getNumStates();
+		const StateRange	srcStates	= getActiveStates(src);
+		const StateRange	dstStates	= getActiveStates(dstNode);
+
+		// temp = product of all incoming msgs except e_t (or sum of log-msgs) at the active states of the source node
+		std::fill(temp, temp + nStates, 0.0f);
+		const float *nodePot = m_logDomain ? getNodePotLog(src) : getNodePot(src);
+		for (byte s : srcStates) temp[s] = nodePot[s];
+		for (size_t e_f : getInEdges(src))
+			if (getEdgeSrc(e_f) != dstNode) {
+				const float *msg = readInMessage(e_f);
+				if (m_logDomain)	for (byte s : srcStates) temp[s] += msg[s];
+				else				for (byte s : srcStates) temp[s] *= msg[s];
+			}
+		if (m_logDomain) {
+			float max = -FLT_MAX;
+			for (byte s : srcStates) max = MAX(max, temp[s]);
+			for (byte s : srcStates) temp[s] = expf(temp[s] - max);
+		}
+
+		// new_msg = (edge_to.Pot^2)^t x temp at the active states of the destination node
+		std::fill(dst, dst + nStates, 0.0f);
+		float Z = 0;
+		if (m_vpEdgePot[edge_to]) {
+			const EdgePotModel &model = getEdgePotModel(edge_to, true);
+			if (model.kind == EdgePotKind::general && !m_halfPrecision) {
+				const float *pot2 = getEdgePotSquared(edge_to);
+				for (byte y : srcStates) {
+					const float *pM = pot2 + y * nStates;
+					const float	 vy = temp[y];
+					if (maxSum)	for (byte x : dstStates) dst[x] = MAX(dst[x], vy * pM[x]);
+					else		for (byte x : dstStates) dst[x] += vy * pM[x];
+				} // y
+			}
+			else {																	// the structured models are O(nStates) anyway
+				multiplyEdgePotSquared(edge_to, temp, dst, maxSum);
+				for (byte x : dstStates) temp[x] = dst[x];
+				std::fill(dst, dst + nStates, 0.0f);
+				for (byte x : dstStates) dst[x] = temp[x];
+			}
+			for (byte x : dstStates) Z += dst[x];
+		}
+
+		// Normalization and setting new values
+		if (Z > FLT_EPSILON)	for (byte x : dstStates) dst[x] /= Z;
+		else					for (byte x : dstStates) dst[x] = 1.0f / dstStates.size();
+		if (m_logDomain) {
+			simd::logVec(dst, dst, nStates);
+			const float max = *std::max_element(dst, dst + nStates);
+			for (byte s = 0; s < nStates; s++) dst[s] -= max;
+		}
+	}
+
+	const float* CMessagePassing::readInMessage(size_t edge) const
+	{
+		return readMessage(edge, m_msgCompressed || m_pMsgSeq ? CArena::getScratch<float>(getGraph().getNumStates(), 3) : NULL);
+	}
+
+	void CMessagePassing::createStore(MessageStore &store, size_t nEdges) const
+	{
+		const byte nStates = getGraph().getNumStates();
+		store.compression = m_compression;
+		store.k = MIN(m_topK, nStates);
+		if (store.compression == MessageCompression::fp16) store.vHalf.assign(nEdges * nStates, 0);
+		else {
+			store.vValues.assign(nEdges * (store.k + 1), 0.0f);
+			store.vStates.assign(nEdges * store.k, 0);
+		}
+	}
+
+	// The floor value is the mean of the values, which are not kept, thus the sum of the message is preserved. In the log domain the sum of the exponents
+	// is preserved: the floor value is the log of the mean of the exponents of the values, which are not kept
+	void CMessagePassing::compressMessage(MessageStore &store, size_t edge, const float *msg) const
+	{
+		const byte nStates = getGraph().getNumStates();
+		if (store.compression == MessageCompression::fp16) {
+			simd::floatToHalf(msg, store.vHalf.data() + edge * nStates, nStates);
+			return;
+		}
+
+		const byte	  k			= store.k;
+		float		* pValues	= store.vValues.data() + edge * (k + 1);
+		byte		* pStates	= store.vStates.data() + edge * k;
+		byte		  states[256];
+		for (int s = 0; s < nStates; s++) states[s] = static_cast<byte>(s);
+		if (k < nStates) std::nth_element(states, states + k, states + nStates, [msg](byte a, byte b) { return msg[a] > msg[b]; });
+		
+		for (byte i = 0; i < k; i++) {
+			pStates[i] = states[i];
+			pValues[i] = msg[states[i]];
+		}
+		if (k == nStates) pValues[k] = 0;
+		else if (m_logDomain) {
+			const float max = msg[states[k]];																			// the largest value, which is not kept
+			double rest = 0;
+			for (int i = k; i < nStates; i++) rest += exp(static_cast<double>(msg[states[i]] - max));
+			pValues[k] = max + static_cast<float>(log(rest / (nStates - k)));
+		}
+		else {
+			double rest = 0;
+			for (int i = k; i < nStates; i++) rest += msg[states[i]];
+			pValues[k] = static_cast<float>(rest / (nStates - k));
+		}
+	}
+
+	void CMessagePassing::decompressMessage(const MessageStore &store, size_t edge, float *msg) const
+	{
+		const byte nStates = getGraph().getNumStates();
+		if (store.compression == MessageCompression::fp16) {
+			simd::halfToFloat(store.vHalf.data() + edge * nStates, msg, nStates);
+			return;
+		}
+
+		const byte	  k			= store.k;
+		const float	* pValues	= store.vValues.data() + edge * (k + 1);
+		const byte	* pStates	= store.vStates.data() + edge * k;
+		std::fill(msg, msg + nStates, pValues[k]);
+		for (byte i = 0; i < k; i++) msg[pStates[i]] = pValues[i];
+	}
+
+	void CMessagePassing::buildAdjacency(size_t nNodes, const vec_byte_t &vValid)
+	{
+		const size_t nEdges = m_vEdgeSrc.size();
+
+		m_vOutOffset.assign(nNodes + 1, 0);
+		m_vInOffset.assign(nNodes + 1, 0);
+		for (size_t e = 0; e < nEdges; e++) {
+			if (!vValid[e]) continue;
+			m_vOutOffset[m_vEdgeSrc[e] + 1]++;
+			m_vInOffset[m_vEdgeDst[e] + 1]++;
+		}
+		for (size_t n = 0; n < nNodes; n++) {
+			m_vOutOffset[n + 1] += m_vOutOffset[n];
+			m_vInOffset[n + 1] += m_vInOffset[n];
+		}
+
+		m_vOutEdges.resize(m_vOutOffset[nNodes]);
+		m_vInEdges.resize(m_vInOffset[nNodes]);
+		vec_size_t vOutPos(m_vOutOffset.begin(), m_vOutOffset.end() - 1);
+		vec_size_t vInPos(m_vInOffset.begin(), m_vInOffset.end() - 1);
+		for (size_t e = 0; e < nEdges; e++) {
+			if (!vValid[e]) continue;
+			m_vOutEdges[vOutPos[m_vEdgeSrc[e]]++] = e;
+			m_vInEdges[vInPos[m_vEdgeDst[e]]++] = e;
+		}
+
+		m_pEdgeSrc		= m_vEdgeSrc.data();
+		m_pEdgeDst		= m_vEdgeDst.data();
+		m_pOutOffset	= m_vOutOffset.data();
+		m_pOutEdges		= m_vOutEdges.data();
+		m_pInOffset		= m_vInOffset.data();
+		m_pInEdges		= m_vInEdges.data();
+	}
+
+	size_t CMessagePassing::getTopologyHash(void) const
+	{
+		const size_t nNodes = m_vpNodePot.size();
+		const size_t nEdges = getNumEdgeSlots();
+
+		// FNV-1a
+		size_t res = 14695981039346656037ULL;
+		auto   add = [&res](size_t val) { res = (res ^ val) * 1099511628211ULL; };
+		add(getGraph().getNumStates());
+		add(m_logDomain ? 1 : 0);												// the messages of the other domain are not compatible
+		add(nNodes);
+		add(nEdges);
+		for (size_t e = 0; e < nEdges; e++) {
+			add(m_pEdgeSrc[e]);
+			add(m_vpEdgePot[e] ? m_pEdgeDst[e] : nNodes);				// unused slots
+		}
+		return res;
+	}
+
+	void CMessagePassing::deleteGraphView(void)
+	{
+		m_vpNodePot.clear();
+		m_vpEdgePot.clear();
+		m_vEdgePotPotts.clear();
+		m_vpEdgePotSquared.clear();
+		m_vEdgePotSquared.clear();
+		m_vEdgePotSquaredHalf.clear();
+		m_vActiveStates.clear();
+		m_vActiveOffset.clear();
+		m_vEdgePotIdx.clear();
+		m_vEdgePotModel.clear();
+		m_vEdgePotModelSquared.clear();
+		m_vEdgeSrc.clear();
+		m_vEdgeDst.clear();
+		m_vOutOffset.clear();
+		m_vOutEdges.clear();
+		m_vInOffset.clear();
+		m_vInEdges.clear();
+		m_pEdgeSrc = m_pEdgeDst = m_pOutOffset = m_pOutEdges = m_pInOffset = m_pInEdges = NULL;
+	}
 }
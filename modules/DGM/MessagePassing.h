@@ -3,63 +3,346 @@
 #pragma once
 
 #include "Infer.h"
-#include "GraphPairwise.h"
+#include "IGraphPairwise.h"
+#include <atomic>
+#include <functional>
 
 namespace DirectGraphicalModels
 {
-	struct Edge;
+	/// Storage formats of the messages (ref. CMessagePassing::setMessageCompression())
+	enum class MessageCompression : byte {
+		none,				///< \a nStates single precision values
+		fp16,				///< \a nStates IEEE 754 half precision values
+		topK				///< The \a k largest values with their states and one floor value for all the other states
+	};
 
 	// ==================== Message Passing Base Abstract Class ==================
 	/**
 	* @ingroup moduleDecode
 	* @brief Abstract base class for message passing inference algorithmes
+	* @details The message passing algorithms operate on a flat view of the graph, which is created together with the messages in createMessages().
+	* The view consists of contiguous arrays of node and edge potential pointers, edge end-points and compressed sparse row (CSR) adjacency.
+	* For the @ref CGraphPairwiseCSR graphs the view points directly to the graph storage, for the @ref CGraphPairwise and @ref CGraphGrid graphs the adjacency is gathered once per inference.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CMessagePassing : public CInfer
 	{
 	public:
+		/**
+		* @brief Callback function, accessing the message of one edge
+		* @details The arguments are the source and destination nodes of the edge and the pointer to \a nStates message values
+		*/
+		using message_function_t = std::function<void(size_t src, size_t dst, float *msg)>;
+
 		/**
 		* @brief Constructor
-		* @param graph The graph
+		* @param graph The graph: @ref CGraphPairwise, @ref CGraphPairwiseCSR or @ref CGraphGrid
 		*/
-		DllExport CMessagePassing(CGraphPairwise &graph) : CInfer(graph) {}
-		DllExport virtual ~CMessagePassing(void) = default;
-		
+		DllExport CMessagePassing(IGraphPairwise &graph) : CInfer(graph), m_msg(NULL), m_msg_temp(NULL) {}
+		DllExport virtual ~CMessagePassing(void) { deleteMessages(); }
+
 		DllExport virtual void	  infer(unsigned int nIt = 1);
+		DllExport virtual size_t  getMemoryUsage(void) const;
+		/**
+		* @brief Estimates the peak memory of the message passing inference
+		* @details The estimation includes the messages and the temp messages, the graph view and the squared distinct edge potentials, \a i.e. the memory
+		* which is allocated by infer() in addition to the graph (ref. getMemoryUsage())
+		* @param nNodes The number of nodes
+		* @param nEdges The number of the directed edges (or of the edge slots for @ref CGraphGrid)
+		* @param nStates The number of states (classes)
+		* @param nPots The number of the distinct edge potentials
+		* @param ownAdjacency Flag indicating whether the adjacency is copied from the graph: \a true for @ref CGraphPairwise and @ref CGraphGrid
+		* @return The estimated memory in bytes
+		*/
+		DllExport static size_t	  estimateMemory(size_t nNodes, size_t nEdges, byte nStates, size_t nPots, bool ownAdjacency);
+		/**
+		* @brief Enables or disables the warm start
+		* @details If enabled, the messages are kept after the inference and the next call of infer() starts from them instead of the default values,
+		* given that the topology of the graph is unchanged. This is useful for the sequences of similar graphs (\a e.g. the video frames), where only
+		* the node potentials are updated with IGraphPairwise::setNodes(): together with the convergence criterion (ref. setConvergence()) the inference
+		* needs then only a few iterations. If the topology has changed, the messages are initialized with the default values.
+		* @param enable Flag indicating whether the warm start should be used. Disabling the warm start discards the kept messages
+		*/
+		DllExport void			  setWarmStart(bool enable) { m_warmStart = enable; if (!enable) m_vWarmMsg.clear(); }
+		/**
+		* @brief Checks whether the warm start is enabled
+		* @retval true if the warm start is enabled
+		* @retval false otherwise
+		*/
+		DllExport bool			  getWarmStart(void) const { return m_warmStart; }
+		/**
+		* @brief Sets the external input buffer for the node potentials
+		* @details If set, the inference reads the node potentials from the buffer instead of the graph, while the topology and the edge potentials are still
+		* read from the graph. Thus, several inferers may solve the problems with different unaries, \a e.g. the perturbed copies (ref. @ref CInferPerturbMAP),
+		* on one graph concurrently. The marginals are written into the output buffer (ref. CInfer::setOutput()), which is enabled with CInfer::setKeepPotentials(), if not set yet.
+		* @param pPots Pointer to the buffer: Mat(size: nNodes x nStates; type: CV_32FC1), or NULL to read the node potentials of the graph (default). The buffer must outlive the inferer
+		*/
+		DllExport void			  setInput(const Mat *pPots) { m_pInput = pPots; if (pPots && !getOutput()) setKeepPotentials(true); }
+		/**
+		* @brief Enables or disables the incremental inference
+		* @details In the incremental mode, the inference is restricted to the region around the nodes, whose potentials have been changed since the previous
+		* inference, \a e.g. by a few user scribbles in an interactive labelling tool. The messages of the previous inference are kept (ref. setWarmStart()), and only
+		* the messages, leaving the changed nodes, are recomputed; the changes are propagated further only while the message residuals exceed the \b threshold.
+		* The changed nodes, including the nodes of the changed edges, are tracked by the graph (ref. IGraphPairwise::setDirtyTracking()). Since the next inference needs the original node potentials,
+		* the marginals are written into the output buffer (ref. CInfer::setOutput()), which is enabled with CInfer::setKeepPotentials(), if not set yet.
+		* @code
+		* inferer.setIncremental(true);
+		* inferer.decode(100);					// the first inference runs over the whole graph
+		* graph.setNode(node, pot);				// the scribbles
+		* inferer.decode(100);					// only the messages around the changed nodes are updated
+		* @endcode
+		* The first inference, as well as the inference after a change of the topology, runs over the whole graph. The setup of the graph view and the
+		* calculation of the beliefs remain linear passes over the whole graph.
+		* @param enable Flag indicating whether the inference should be incremental
+		* @param threshold The residual, \a i.e. the L1-norm of the message change, below which the changes are not propagated
+		*/
+		DllExport void			  setIncremental(bool enable, float threshold = 1e-3f);
+		/**
+		* @brief Checks whether the incremental inference is enabled
+		* @retval true if the incremental inference is enabled
+		* @retval false otherwise
+		*/
+		DllExport bool			  isIncremental(void) const { return m_incremental; }
+		/**
+		* @brief Enables or disables the logarithmic domain
+		* @details In the logarithmic domain the messages are the logarithms of the probabilities: the products of the messages are replaced with the sums,
+		* and the \a max-product passing becomes the \a max-sum (\a min-sum for the energies) passing. The message matrix products are evaluated with the
+		* log-sum-exp trick using the vectorized exponent and logarithm (ref. simd::expVec() and simd::logVec()), so that the inference on large graphs
+		* does not run out of the floating point precision. Used by @ref CInferLBP, @ref CInferViterbi, @ref CInferTree, @ref CInferChain and @ref CInferResidualBP;
+		* @ref CInferTRW and @ref CInferPnPotts do not support it.
+		* @param enable Flag indicating whether the inference should be performed in the logarithmic domain
+		*/
+		DllExport void			  setLogDomain(bool enable) { m_logDomain = enable; }
+		/**
+		* @brief Checks whether the inference is performed in the logarithmic domain
+		* @retval true if the logarithmic domain is used
+		* @retval false otherwise
+		*/
+		DllExport bool			  isLogDomain(void) const { return m_logDomain; }
+		/**
+		* @brief Enables or disables the half precision storage of the squared edge potentials
+		* @details The squared distinct edge potentials (ref. getEdgePotSquared()), which are calculated in createMessages(), are stored in the IEEE 754 half precision,
+		* which halves both the memory footprint of the tables and the memory traffic of the message updates. The values are widened to the single precision on load,
+		* thus the messages themselves are calculated in the single precision (ref. simd::matTVecMulHalf()). The potentials must lie within the half precision range
+		* (\f$6.1\cdot 10^{-5}\f$ to \f$65504\f$ for the normalized values); the relative error of every stored value is below \f$4.9\cdot 10^{-4}\f$.
+		* The node potentials and the messages are kept in the single precision. The OpenCL message passing of @ref CInferLBP is not used in this mode.
+		* @param enable Flag indicating whether the squared edge potentials should be stored in the half precision
+		*/
+		DllExport void			  setHalfPrecision(bool enable) { m_halfPrecision = enable; }
+		/**
+		* @brief Checks whether the squared edge potentials are stored in the half precision
+		* @retval true if the half precision is used
+		* @retval false otherwise
+		*/
+		DllExport bool			  isHalfPrecision(void) const { return m_halfPrecision; }
+		/**
+		* @brief Sets the threshold for the pruning of the node states
+		* @details If positive, every node keeps only the active states, whose potentials are not less than \b threshold times the largest potential of the node.
+		* The active states are selected once in createMessages(); the messages are then calculated only from the active states of the source node and only
+		* for the active states of the destination node, so that the cost of the message with the general edge potential is
+		* \f$O(|A_{src}|\cdot|A_{dst}|)\f$ instead of \f$O(nStates^2)\f$ (ref. calculateMessage()). The messages of the pruned states are zero (\f$\log(FLT\_MIN)\f$ in the
+		* logarithmic domain), thus their beliefs vanish. The states with zero potentials, \a e.g. set by a classifier, which excludes the implausible classes,
+		* are pruned with any positive threshold. The message containers keep \a nStates values per edge. The OpenCL message passing of @ref CInferLBP is not used in this mode.
+		* @param threshold The threshold in range [0; 1]. Zero disables the pruning
+		*/
+		DllExport void			  setStatePruning(float threshold);
+		/**
+		* @brief Returns the threshold for the pruning of the node states
+		* @return The threshold (ref. setStatePruning())
+		*/
+		DllExport float			  getStatePruning(void) const { return m_pruneThreshold; }
+		/**
+		* @brief Sets the storage format of the messages
+		* @details The message containers take \a 2 x \a nEdges x \a nStates single precision values, which becomes the limiting factor for the large state spaces,
+		* \a e.g. the stereo matching with 128 disparities. The compressed messages are decompressed on the fly, whenever they are read, and compressed, whenever they are written:
+		* - MessageCompression::fp16 halves the memory with the relative error below \f$4.9\cdot 10^{-4}\f$;
+		* - MessageCompression::topK keeps the \b k largest values of every message exactly and replaces the other values with their mean, so that a message takes
+		* \f$5k + 4\f$ bytes instead of \f$4 nStates\f$. The sum of the values (in the log domain, the sum of their exponents) and thus the normalization are preserved. The approximation is good for the peaked messages,
+		* \a e.g. for the node potentials, where only a few states are plausible.
+		*
+		* Used by @ref CInferLBP and @ref CInferViterbi; the other algorithms keep the uncompressed messages (ref. isCompressible()).
+		* @param compression The storage format of the messages
+		* @param k The number of the values, kept by MessageCompression::topK
+		*/
+		DllExport void			  setMessageCompression(MessageCompression compression, byte k = 8) { m_compression = compression; m_topK = MAX(1, k); }
+		/**
+		* @brief Returns the storage format of the messages
+		* @return The storage format of the messages (ref. setMessageCompression())
+		*/
+		DllExport MessageCompression getMessageCompression(void) const { return m_compression; }
+		/**
+		* @brief Sets the initializer of the messages
+		* @details The initializer is called in createMessages() for every edge of the graph after the messages are filled with the default values,
+		* so that the inference may start from the messages, derived from another graph, \a e.g. a coarser one (ref. @ref CInferMultiscale)
+		* @param init The callback function, which may overwrite the message of the edge, or \a nullptr to use the default values only
+		*/
+		DllExport void			  setMessagesInitializer(message_function_t init) { m_init = init; }
+		/**
+		* @brief Sets the collector of the messages
+		* @details The collector is called in deleteMessages() for every edge of the graph, \a i.e. once after every inference, with the final messages
+		* @param collect The callback function, which receives the message of the edge, or \a nullptr
+		*/
+		DllExport void			  setMessagesCollector(message_function_t collect) { m_collect = collect; }
 
 
 	protected:
+		/// Kind of the edge potential matrix
+		enum class EdgePotKind : byte {
+			general,				///< Arbitrary matrix
+			potts,					///< Constant diagonal and constant off-diagonal values
+			truncatedLinear,		///< \f$g(d) = \max(diag \cdot rate^{d}, trunc)\f$, where \f$d = |x - y|\f$
+			truncatedQuadratic		///< \f$g(d) = \max(diag \cdot rate^{d^2}, trunc)\f$, where \f$d = |x - y|\f$
+		};
+
+		/**
+		* @brief Model of the edge potential matrix
+		* @details The potentials of the special kinds are symmetric Toeplitz matrices, which elements depend only on the distance \f$d = |x - y|\f$ between the states.
+		* In the negative logarithmic domain they correspond to the Potts, truncated linear and truncated quadratic energies.
+		*/
+		struct EdgePotModel {
+			EdgePotKind	kind	= EdgePotKind::general;	///< Kind of the potential
+			float		diag	= 0;					///< Diagonal value \f$g(0)\f$
+			float		rate	= 0;					///< Decay rate
+			float		trunc	= 0;					///< Truncation value (the off-diagonal value for the Potts model)
+
+			/// Returns the model of the element-wise squared potential
+			EdgePotModel squared(void) const { return { kind, diag * diag, rate * rate, trunc * trunc }; }
+		};
+
+		/**
+		* @brief Range of edge indices, adjacent to a node
+		*/
+		struct EdgeRange {
+			const size_t * first;		///< Pointer to the first edge index
+			const size_t * last;		///< Pointer past the last edge index
+
+			const size_t * begin(void) const { return first; }
+			const size_t * end(void) const { return last; }
+			size_t		   size(void) const { return static_cast<size_t>(last - first); }
+		};
+
+		/**
+		* @brief Range of states, active in a node (ref. setStatePruning())
+		*/
+		struct StateRange {
+			const byte * first;			///< Pointer to the first state
+			const byte * last;			///< Pointer past the last state
+
+			const byte * begin(void) const { return first; }
+			const byte * end(void) const { return last; }
+			size_t		 size(void) const { return static_cast<size_t>(last - first); }
+		};
+
 		/**
 		* @brief Returns the graph
 		* @return The graph
 		*/
-		CGraphPairwise& getGraphPairwise(void) const { return dynamic_cast<CGraphPairwise&>(getGraph()); }
+		IGraphPairwise& getGraphPairwise(void) const { return dynamic_cast<IGraphPairwise&>(getGraph()); }
 		/**
 		* @brief Calculates messages, associated with the edges of corresponding graphical model
-		* @details > This function may modify Edge::msg and Edge::msg_temp containers of graph edges
+		* @details > This function may modify the message containers, returned by getMessage() and getMessageTemp()
 		* @param nIt Number of iterations
 		*/
 		virtual void calculateMessages(unsigned int nIt) = 0;
 		/**
+		* @brief Calculates the messages around the changed nodes
+		* @details This function is called by updateMessages() in the incremental mode (ref. setIncremental()) instead of calculateMessages(). 
+		* The default implementation propagates the changes with a work-list of edges: first the outgoing edges of the changed nodes are recomputed with calculateMessage(),
+		* and whenever the residual of a message exceeds the threshold, the messages, depending on it, are scheduled as well. The updates are counted as one iteration.
+		* @param vNodes The changed nodes
+		* @param nIt The maximal number of message updates in units of the number of edges
+		*/
+		virtual void calculateMessagesLocal(const vec_size_t &vNodes, unsigned int nIt);
+		/**
+		* @brief Calculates the messages over the whole graph, or around the changed nodes in the incremental mode
+		* @details This function should be called by the derived classes in infer() after createMessages() instead of calling calculateMessages() directly.
+		* Afterwards the changed nodes of the graph are cleared.
+		* @param nIt Number of iterations
+		*/
+		void	updateMessages(unsigned int nIt);
+		/**
+		* @brief Checks whether the messages are calculated according to the \a max-product algorithm
+		* @details This flag is used by the default implementation of calculateMessagesLocal()
+		* @retval true for the \a max-product algorithm
+		* @retval false for the \a sum-product algorithm (default)
+		*/
+		virtual bool isMaxSum(void) const { return false; }
+		/**
+		* @brief Returns the threshold of the incremental inference
+		* @return The residual, below which the changes of the messages are not propagated (ref. setIncremental())
+		*/
+		float	getIncrementalThreshold(void) const { return m_incrementalThreshold; }
+		/**
+		* @brief Returns the beliefs after the current iteration
+		* @details The beliefs are calculated with calculateBelief() from the current messages into the own buffer of the inferer, which is re-used by the next calls
+		* @return The beliefs: Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		virtual Mat getCurrentBeliefs(void) override;
+		/**
+		* @brief Calculates the belief of a node
+		* @details The default implementation calculates the normalized product of the node potential and of the incoming messages
+		* > PPL-safe function.
+		* @param[in] node Index of the graph node
+		* @param[out] pot Destination array of \b nStates values. It may be the node potential, \a i.e. getNodePot(node)
+		*/
+		virtual void calculateBelief(size_t node, float *pot);
+		/**
 		* @brief Calculates one message for the specified edge \b edge
 		* @details > PPL-safe function.
-		* @param[in] edge Graph edge
+		* @param[in] edge Index of the graph edge
 		* @param[in] temp Auxilary array of \b nStates values. Introduced for higher perfomance reasons.
-		* @param[out] dst Destination array for calculated message. Usually \b edge->msg or \b edge->msg_temp.
+		* @param[out] dst Destination array for calculated message. Usually getMessage(edge) or getMessageTemp(edge).
+		* In the logarithmic domain (ref. setLogDomain()) the message is the logarithm, normalized to the maximal value of zero.
+		* If the node states are pruned (ref. setStatePruning()), only the active states of both nodes are processed.
 		* @param[in] maxSum Flag indicating weather the message must be calculated according to the \a sum-product (false) or \a max-product (true) algorithm.
 		*/
-		void	calculateMessage(const Edge& edge, float* temp, float* dst, bool maxSum = false);
+		void	calculateMessage(size_t edge, float* temp, float* dst, bool maxSum = false);
+		/**
+		* @brief Checks whether the messages are updated in place
+		* @details This function is called in createMessages() after the graph view is created. The derived classes may analyse the graph here
+		* and decide whether the temp message containers (ref. getMessageTemp()) are needed.
+		* @retval true if the messages are updated in place and the temp message containers are not allocated
+		* @retval false otherwise (default)
+		*/
+		virtual bool isInPlace(void) { return false; }
+		/**
+		* @brief Checks whether the messages may be stored compressed
+		* @details The derived classes, which access the messages only with readMessage() and writeMessage(), may return true here, so that the storage format,
+		* set with setMessageCompression(), is applied. In that case getMessage() and getMessageTemp() return NULL.
+		* @retval true if the messages may be compressed
+		* @retval false otherwise (default)
+		*/
+		virtual bool isCompressible(void) { return false; }
 		/**
-		* @brief Allocates memory for Edge::msg and Edge::msg_temp containers for all edges in the graph
-		* @param val Default value to fill in the Edge::msg and Edge::msg_temp containers 
+		* @brief Checks whether the messages are updated in place by concurrent threads
+		* @details This function is called in createMessages() after isInPlace(). The derived classes, whose threads update the messages in place, while the other
+		* threads read them, may return true here. In that case every message is guarded with a sequence lock: readMessage() and calculateMessage() always read
+		* a consistent copy, and writeMessage() publishes the new message at once. The messages must be written only with writeMessage(), and every message must
+		* have only one writing thread at a time.
+		* @retval true if the messages are updated concurrently
+		* @retval false otherwise (default)
+		*/
+		virtual bool isConcurrent(void) { return false; }
+		/**
+		* @brief Creates the graph view and allocates memory for the message containers for all edges in the graph
+		* @details The temp message containers are allocated only if isInPlace() returns false.
+		* If the warm start is enabled (ref. setWarmStart()) and the topology of the graph is unchanged, the containers are filled with the messages,
+		* kept by deleteMessages() after the previous inference.
+		* @param val Default value to fill in the message containers
 		*/
 		void	createMessages(std::optional<float> val = std::nullopt);
 		/**
-		* @brief Deletes memory for Edge::msg and Edge::msg_temp containers for all edges in the graph
+		* @brief Creates the graph view without the message containers
+		* @details This function is used by the algorithms, which operate on the potentials directly. The view is released with deleteMessages().
+		*/
+		void	createView(void);
+		/**
+		* @brief Deletes memory for the message containers for all edges in the graph and releases the graph view
+		* @details If the warm start is enabled (ref. setWarmStart()), the messages are kept for the next inference
 		*/
 		void	deleteMessages(void);
 		/**
-		* @brief Swaps Edge::msg and Edge::msg_temp for all edges in the graph 
+		* @brief Swaps the message and temp message containers for all edges in the graph
 		*/
 		void	swapMessages(void);
 		/**
@@ -75,6 +358,133 @@ namespace DirectGraphicalModels
 		*/
 		float*	getMessageTemp(size_t edge);
 		/**
+		* @brief Checks whether the messages are stored compressed
+		* @details The messages are compressed if the storage format is set (ref. setMessageCompression()) and the algorithm supports it (ref. isCompressible())
+		* @note Valid only between createMessages() and deleteMessages()
+		* @retval true if the messages are compressed and should be accessed with readMessage() and writeMessage()
+		* @retval false otherwise
+		*/
+		bool	isMessageCompressed(void) const { return m_msgCompressed; }
+		/**
+		* @brief Reads the edge message
+		* @details > PPL-safe function.
+		* @param[in] edge The %Edge index
+		* @param[in] buf Buffer of \a nStates values, which receives the decompressed message
+		* @return The pointer to \a nStates message values: either the message container itself or \b buf, if the messages are compressed or updated
+		* concurrently (ref. isConcurrent())
+		*/
+		const float* readMessage(size_t edge, float *buf) const;
+		/**
+		* @brief Writes the edge message
+		* @details > PPL-safe function.
+		* @param edge The %Edge index
+		* @param msg The \a nStates message values
+		* @param temp Flag indicating whether the temp message (ref. getMessageTemp()) should be written
+		*/
+		void	writeMessage(size_t edge, const float *msg, bool temp = false);
+		/**
+		* @brief Returns the number of edge indices in the graph view
+		* @details For the graphs with implicit structure (@ref CGraphGrid) the edge indices are slots, which may be unused, thus this number may 
+		* exceed the number of edges in the graph. All message containers are allocated for this number of edges.
+		* @note Valid only between createMessages() and deleteMessages()
+		* @return The number of edge indices
+		*/
+		size_t			getNumEdgeSlots(void) const { return m_vpEdgePot.size(); }
+		/**
+		* @brief Returns the pointer to the node potential
+		* @note Valid only between createMessages() and deleteMessages()
+		* @param node The %Node index
+		* @return The pointer to \a nStates potential values of the node
+		*/
+		float*			getNodePot(size_t node) const { return m_vpNodePot[node]; }
+		/**
+		* @brief Returns the pointer to the logarithm of the node potential
+		* @note Valid only between createMessages() and deleteMessages() in the logarithmic domain (ref. setLogDomain())
+		* @param node The %Node index
+		* @return The pointer to \a nStates logarithms of the potential values of the node
+		*/
+		const float*	getNodePotLog(size_t node) const { return m_pNodePotLog + node * getGraph().getNumStates(); }
+		/**
+		* @brief Returns the active states of the node
+		* @note Valid only between createMessages() and deleteMessages() if the node states are pruned (ref. setStatePruning())
+		* @param node The %Node index
+		* @return The range of the active states in ascending order
+		*/
+		StateRange		getActiveStates(size_t node) const { return { m_vActiveStates.data() + m_vActiveOffset[node], m_vActiveStates.data() + m_vActiveOffset[node + 1] }; }
+		/**
+		* @brief Returns the pointer to the edge potential
+		* @note Valid only between createMessages() and deleteMessages()
+		* @param edge The %Edge index
+		* @return The pointer to \a nStates x \a nStates row-major potential values of the edge, or NULL if the potential is not set.
+		* For the compact Potts edges (ref. isEdgePotPotts()) the pointer addresses only the diagonal and off-diagonal values.
+		*/
+		const float*	getEdgePot(size_t edge) const { return m_vpEdgePot[edge]; }
+		/**
+		* @brief Checks whether the edge potential is stored in the compact Potts form
+		* @details Such potentials are set with IGraphPairwise::setEdgePotts() in the @ref CGraphPairwiseCSR graphs. Their values should be accessed with 
+		* getEdgePotValue() or derived from the model (ref. getEdgePotModel()), which is always of the Potts kind.
+		* @note Valid only between createMessages() and deleteMessages()
+		* @param edge The %Edge index
+		* @retval true if the potential of the edge is given by the diagonal and off-diagonal values only
+		* @retval false otherwise
+		*/
+		bool			isEdgePotPotts(size_t edge) const { return !m_vEdgePotPotts.empty() && m_vEdgePotPotts[edge]; }
+		/**
+		* @brief Returns one value of the edge potential
+		* @note Valid only between createMessages() and deleteMessages() for the edges with the potential set
+		* @param edge The %Edge index
+		* @param x The state of the source node (row of the potential matrix)
+		* @param y The state of the destination node (column of the potential matrix)
+		* @return The potential value
+		*/
+		float			getEdgePotValue(size_t edge, byte x, byte y) const 
+		{ 
+			const float *pot = m_vpEdgePot[edge];
+			return isEdgePotPotts(edge) ? pot[x == y ? 0 : 1] : pot[x * getGraph().getNumStates() + y];
+		}
+		/**
+		* @brief Returns the pointer to the squared edge potential
+		* @details The squared potentials are calculated once in createMessages(): the edges, which share one potential, share also its square.
+		* @note Valid only between createMessages() and deleteMessages(). In the half precision mode (ref. setHalfPrecision()) the squared matrices are not
+		* available in the single precision, and the function returns NULL for all the edges, but those stored in the compact Potts form
+		* @param edge The %Edge index
+		* @return The pointer to \a nStates x \a nStates row-major squared potential values of the edge, or NULL if the potential is not set
+		*/
+		const float*	getEdgePotSquared(size_t edge) const { return m_vpEdgePotSquared[edge]; }
+		/**
+		* @brief Returns the model of the edge potential
+		* @details The kind of every distinct edge potential is detected once in createMessages()
+		* @note Valid only between createMessages() and deleteMessages()
+		* @param edge The %Edge index
+		* @param squared Flag indicating whether the model of the squared potential (ref. getEdgePotSquared()) should be returned
+		* @return The model of the edge potential
+		*/
+		const EdgePotModel& getEdgePotModel(size_t edge, bool squared = false) const;
+		/**
+		* @brief Returns the source node of the edge
+		* @param edge The %Edge index
+		* @return The source node index
+		*/
+		size_t			getEdgeSrc(size_t edge) const { return m_pEdgeSrc[edge]; }
+		/**
+		* @brief Returns the destination node of the edge
+		* @param edge The %Edge index
+		* @return The destination node index
+		*/
+		size_t			getEdgeDst(size_t edge) const { return m_pEdgeDst[edge]; }
+		/**
+		* @brief Returns the outgoing edges of the node
+		* @param node The %Node index
+		* @return The range of the outgoing edge indices
+		*/
+		EdgeRange		getOutEdges(size_t node) const { return { m_pOutEdges + m_pOutOffset[node], m_pOutEdges + m_pOutOffset[node + 1] }; }
+		/**
+		* @brief Returns the incoming edges of the node
+		* @param node The %Node index
+		* @return The range of the incoming edge indices
+		*/
+		EdgeRange		getInEdges(size_t node) const { return { m_pInEdges + m_pInOffset[node], m_pInEdges + m_pInOffset[node + 1] }; }
+		/**
 		* @brief Specific matrix multiplication
 		* @details This function calculates the result of multiplying square of matrix \b M by vector \b v as following:
 		* \f$\vec{dst} = (M\cdot M)^\top\times\vec{v}\f$
@@ -85,10 +495,135 @@ namespace DirectGraphicalModels
 		* @return The sum of all elemts in vector \b dst
 		*/
 		static float MatMul(const Mat& M, const float* v, float* dst, bool maxSum = false);
+		/**
+		* @brief Matrix multiplication, which exploits the kind of the potential
+		* @details This function calculates \f$\vec{dst} = M^\top\times\vec{v}\f$, or the same product, where the summation is replaced by maximization.
+		* The complexity is \f$O(nStates)\f$ for the Potts and truncated linear models, as well as for the truncated quadratic model in the \a max-sum case 
+		* (distance transform after <a href="https://cs.brown.edu/people/pfelzens/papers/dt-final.pdf" target="_blank">Felzenszwalb and Huttenlocher</a>),
+		* and \f$O(nStates^2)\f$ otherwise.
+		* @param[in] model The model of the matrix \b M
+		* @param[in] M Row-major square matrix of size \b nStates x \b nStates
+		* @param[in] v Vector of length \b nStates with non-negative elements
+		* @param[out] dst Resulting vector of length \b nStates
+		* @param[in] nStates The number of states
+		* @param[in] maxSum Flag indicating weather the \a max-sum multiplication should be performed
+		* @return The sum of all elemts in vector \b dst
+		*/
+		static float MatMul(const EdgePotModel &model, const float* M, const float* v, float* dst, byte nStates, bool maxSum = false);
+		/**
+		* @brief Detects the kind of the edge potential
+		* @param pot Row-major square matrix of size \b nStates x \b nStates
+		* @param nStates The number of states
+		* @return The model of the potential
+		*/
+		static EdgePotModel getEdgePotModel(const float* pot, byte nStates);
 
 
 	private:
-		float	* m_msg;			///< Message: Mat(size: nStates x 1; type: CV_32FC1)
-		float	* m_msg_temp;		///< Temp Message: Mat(size: nStates x 1; type: CV_32FC1)
+		void	createGraphView(void);
+		void	deleteGraphView(void);
+		// Redirects the node potentials of the graph view to the output buffer (ref. CInfer::setOutput()), if it is set; the buffer is filled from the input buffer (ref. setInput()), if it is set
+		void	createOutputView(void);
+		// Calculates the squared edge potentials and their models, one per distinct potential
+		void	createSquaredPotentials(void);
+		// dst = (edge.Pot^2)^T x v; reads the half precision table if needed
+		float	multiplyEdgePotSquared(size_t edge, const float *v, float *dst, bool maxSum) const;
+		// Selects the active states of every node (ref. setStatePruning())
+		void	createActiveStates(void);
+		// calculateMessage() in the linear domain with all the states active, specialized for N states (ref. kernels::dispatch())
+		template<int N>
+		void	calculateMessageDense(size_t edge, float *temp, float *dst, bool maxSum);
+		// calculateMessage() restricted to the active states of the source and destination nodes
+		void	calculateMessageSparse(size_t edge, float *temp, float *dst, bool maxSum);
+		// Returns the incoming message, decompressed into the thread-local buffer if needed
+		const float* readInMessage(size_t edge) const;
+
+
+	private:
+		/// Compressed message container
+		struct MessageStore {
+			MessageCompression	compression = MessageCompression::none;	///< The storage format
+			byte				k = 0;				///< The number of the top-k values
+			std::vector<word>	vHalf;				///< The half precision values: nStates per edge
+			vec_float_t			vValues;			///< The top-k values followed by the floor value: k + 1 per edge
+			vec_byte_t			vStates;			///< The states of the top-k values: k per edge
+		};
+
+		void	createStore(MessageStore &store, size_t nEdges) const;
+		void	compressMessage(MessageStore &store, size_t edge, const float *msg) const;
+		void	decompressMessage(const MessageStore &store, size_t edge, float *msg) const;
+		// Builds the own CSR arrays out of m_vEdgeSrc and m_vEdgeDst, skipping the edges with vValid[e] == 0
+		void	buildAdjacency(size_t nNodes, const vec_byte_t &vValid);
+		// Returns the hash of the graph view topology: the numbers of states, nodes and edge slots and the edge end-points
+		size_t	getTopologyHash(void) const;
+
+
+	private:
+		float					* m_msg;			///< Message: Mat(size: nStates x 1; type: CV_32FC1)
+		float					* m_msg_temp;		///< Temp Message: Mat(size: nStates x 1; type: CV_32FC1)
+		void (CMessagePassing::	* m_pCalculateMessageDense)(size_t, float *, float *, bool) = NULL;	///< calculateMessageDense(), specialized for the number of states in createMessages()
+
+		// NUMA placement
+		std::vector<std::pair<const void *, size_t>> m_vNumaBuffers;	///< The buffers, whose placement is m_vNumaBytes
+		vec_size_t				  m_vNumaBytes;		///< The bytes of the buffers on every NUMA node (ref. InferStats::vNumaBytes)
+
+		// Warm start
+		bool					  m_warmStart	= false;	///< Flag indicating whether the messages are kept between the inferences
+		vec_float_t				  m_vWarmMsg;		///< The messages, kept after the last inference
+		size_t					  m_warmHash	= 0;		///< Topology hash of the graph view of the kept messages
+		bool					  m_warmLoaded	= false;	///< Flag indicating whether the current messages are the kept ones
+
+		// Incremental inference
+		bool					  m_incremental	= false;	///< Flag indicating whether the inference is restricted to the changed region
+		float					  m_incrementalThreshold = 1e-3f;	///< The residual, below which the changes are not propagated
+		message_function_t		  m_init;			///< Initializer of the messages
+		message_function_t		  m_collect;		///< Collector of the messages
+		
+		// Progress
+		Mat						  m_currentBeliefs;	///< The beliefs for the progress callback (ref. getCurrentBeliefs())
+
+		// Logarithmic domain
+		bool					  m_logDomain	= false;	///< Flag indicating whether the messages are logarithms
+		float					* m_pNodePotLog	= NULL;		///< Logarithms of the node potentials
+
+		// Half precision
+		bool					  m_halfPrecision = false;	///< Flag indicating whether the squared edge potentials are stored in the half precision
+		std::vector<word>		  m_vEdgePotSquaredHalf;	///< Squared distinct edge potentials in the half precision
+
+		// Compression of the messages
+		MessageCompression		  m_compression	= MessageCompression::none;	///< The storage format of the messages
+		byte					  m_topK		= 8;		///< The number of the values, kept by MessageCompression::topK
+		bool					  m_msgCompressed = false;	///< Flag indicating whether the current messages are compressed
+		std::unique_ptr<std::atomic<dword>[]> m_pMsgSeq;	///< The sequence locks of the messages (empty if the messages are not updated concurrently, ref. isConcurrent())
+		MessageStore			  m_msgStore;				///< Compressed messages
+		MessageStore			  m_msgStoreTemp;			///< Compressed temp messages
+
+		// Pruning of the states
+		float					  m_pruneThreshold = 0;		///< The threshold for the pruning of the node states
+		vec_byte_t				  m_vActiveStates;			///< Active states of all the nodes
+		vec_size_t				  m_vActiveOffset;			///< CSR offsets of the active states of every node (empty if the states are not pruned)
+
+		// Graph view
+		const Mat				* m_pInput		= NULL;		///< The external input buffer for the node potentials (ref. setInput())
+		std::vector<float*>		  m_vpNodePot;		///< Pointers to the node potentials
+		std::vector<const float*> m_vpEdgePot;		///< Pointers to the edge potentials
+		vec_byte_t				  m_vEdgePotPotts;	///< Flags indicating whether the edge potential is stored in the compact Potts form (empty if there are no such edges)
+		std::vector<const float*> m_vpEdgePotSquared;	///< Pointers to the squared edge potentials
+		vec_float_t				  m_vEdgePotSquared;	///< Squared distinct edge potentials
+		vec_size_t				  m_vEdgePotIdx;		///< Index of the distinct potential of every edge
+		std::vector<EdgePotModel> m_vEdgePotModel;		///< Models of the distinct edge potentials
+		std::vector<EdgePotModel> m_vEdgePotModelSquared;	///< Models of the squared distinct edge potentials
+		const size_t			* m_pEdgeSrc	= NULL;
+		const size_t			* m_pEdgeDst	= NULL;
+		const size_t			* m_pOutOffset	= NULL;
+		const size_t			* m_pOutEdges	= NULL;
+		const size_t			* m_pInOffset	= NULL;
+		const size_t			* m_pInEdges	= NULL;
+		vec_size_t				  m_vEdgeSrc;		///< Own copy of the edge sources (if the graph does not provide contiguous storage)
+		vec_size_t				  m_vEdgeDst;		///< Own copy of the edge destinations
+		vec_size_t				  m_vOutOffset;		///< Own copy of the outgoing CSR offsets
+		vec_size_t				  m_vOutEdges;		///< Own copy of the outgoing CSR edges
+		vec_size_t				  m_vInOffset;		///< Own copy of the incoming CSR offsets
+		vec_size_t				  m_vInEdges;		///< Own copy of the incoming CSR edges
 	};
 }
@@ -0,0 +1,231 @@
+#include "ModelFile.h"
+#include "macroses.h"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace DirectGraphicalModels
+{
+	// Constants
+	const uint32_t CModelFile::VERSION = 1;
+
+	namespace {
+		const char		FILE_MAGIC[4]	= { 'D', 'G', 'M', 'C' };
+		const size_t	FILE_ALIGNMENT	= 64;			// the cache line / AVX-512 register size
+
+		/// Header of the container
+		struct FileHeader {
+			char		magic[4];
+			uint32_t	version;
+			uint32_t	nSections;
+			uint32_t	checksum;						// FNV-1a hash of the table of sections
+		};
+
+		inline size_t align(size_t size) { return (size + FILE_ALIGNMENT - 1) & ~(FILE_ALIGNMENT - 1); }
+
+		// Maps the file into memory copy-on-write; returns an empty pointer if the file can not be mapped
+		std::shared_ptr<const void> mapFile(const std::string &fileName, size_t &size)
+		{
+#ifdef _WIN32
+			HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (hFile == INVALID_HANDLE_VALUE) return nullptr;
+			LARGE_INTEGER fileSize;
+			const BOOL hasSize = GetFileSizeEx(hFile, &fileSize);
+			HANDLE hMapping = hasSize && fileSize.QuadPart > 0 ? CreateFileMappingA(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL) : NULL;
+			CloseHandle(hFile);
+			if (!hMapping) return nullptr;
+			void *pData = MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+			CloseHandle(hMapping);												// the view keeps the mapping alive
+			if (!pData) return nullptr;
+			size = static_cast<size_t>(fileSize.QuadPart);
+			return std::shared_ptr<const void>(pData, [](const void *p) { UnmapViewOfFile(p); });
+#else
+			const int fd = open(fileName.c_str(), O_RDONLY);
+			if (fd < 0) return nullptr;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+				close(fd);
+				return nullptr;
+			}
+			const size_t fileSize = static_cast<size_t>(st.st_size);
+			void *pData = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			close(fd);															// the mapping keeps the file open
+			if (pData == MAP_FAILED) return nullptr;
+			size = fileSize;
+			return std::shared_ptr<const void>(pData, [fileSize](const void *p) { munmap(const_cast<void *>(p), fileSize); });
+#endif
+		}
+
+		// Returns the size of the file with 64-bit offsets, since the size of the large files does not fit into long on all platforms; or -1 on error
+		int64_t getFileSize(FILE *pFile)
+		{
+#ifdef _WIN32
+			if (_fseeki64(pFile, 0, SEEK_END) != 0) return -1;
+			const int64_t res = _ftelli64(pFile);
+			return _fseeki64(pFile, 0, SEEK_SET) == 0 ? res : -1;
+#else
+			if (fseeko(pFile, 0, SEEK_END) != 0) return -1;
+			const int64_t res = static_cast<int64_t>(ftello(pFile));
+			return fseeko(pFile, 0, SEEK_SET) == 0 ? res : -1;
+#endif
+		}
+
+		// Reads the whole file into an aligned buffer
+		std::shared_ptr<const void> readFile(const std::string &fileName, size_t &size)
+		{
+			FILE *pFile = fopen(fileName.c_str(), "rb");
+			DGM_ASSERT_MSG(pFile, "Can't load data from %s", fileName.c_str());
+			const int64_t fileSize = getFileSize(pFile);
+			if (fileSize < 0) fclose(pFile);
+			DGM_ASSERT_MSG(fileSize >= 0, "Can't read data from %s", fileName.c_str());
+			size = static_cast<size_t>(fileSize);
+			auto pBuffer = std::make_shared<std::vector<uint64_t>>((size + FILE_ALIGNMENT - 1) / sizeof(uint64_t) + 1);
+			byte *pData = reinterpret_cast<byte *>(align(reinterpret_cast<size_t>(pBuffer->data())));
+			const size_t nRead = fread(pData, 1, size, pFile);
+			fclose(pFile);
+			DGM_ASSERT_MSG(nRead == size, "Can't read data from %s", fileName.c_str());
+			return std::shared_ptr<const void>(pBuffer, pData);
+		}
+	}
+
+	// =============================== Model File Writer ===============================
+	void CModelFileWriter::addSection(const std::string &name, const Mat &data)
+	{
+		DGM_ASSERT_MSG(name.size() < sizeof(CModelFile::SectionRecord::name), "The name of the section %s is too long", name.c_str());
+		DGM_ASSERT(data.dims <= 2);
+		for (auto &section : m_vSections)
+			DGM_ASSERT_MSG(section.first != name, "The section %s already exists", name.c_str());
+		m_vSections.emplace_back(name, data.isContinuous() ? data : data.clone());
+	}
+
+	void CModelFileWriter::addSection(const std::string &name, const void *pData, size_t size)
+	{
+		addSection(name, Mat(1, static_cast<int>(size), CV_8UC1, const_cast<void *>(pData)).clone());
+	}
+
+	void CModelFileWriter::save(const std::string &fileName) const
+	{
+		const size_t nSections = m_vSections.size();
+
+		std::vector<CModelFile::SectionRecord> vRecords(nSections);
+		size_t offset = align(sizeof(FileHeader) + nSections * sizeof(CModelFile::SectionRecord));
+		for (size_t s = 0; s < nSections; s++) {
+			const Mat				   &data	= m_vSections[s].second;
+			CModelFile::SectionRecord  &record	= vRecords[s];
+			memset(&record, 0, sizeof(CModelFile::SectionRecord));
+			strncpy(record.name, m_vSections[s].first.c_str(), sizeof(record.name) - 1);
+			record.type		= data.type();
+			record.rows		= data.rows;
+			record.cols		= data.cols;
+			record.size		= data.total() * data.elemSize();
+			record.checksum	= CModelFile::checksum(data.data, static_cast<size_t>(record.size));
+			record.offset	= offset;
+			offset = align(offset + static_cast<size_t>(record.size));
+		} // s
+
+		FileHeader header;
+		memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+		header.version		= CModelFile::VERSION;
+		header.nSections	= static_cast<uint32_t>(nSections);
+		header.checksum		= CModelFile::checksum(vRecords.data(), nSections * sizeof(CModelFile::SectionRecord));
+
+		FILE *pFile = fopen(fileName.c_str(), "wb");
+		DGM_ASSERT_MSG(pFile, "Can't create file %s", fileName.c_str());
+		fwrite(&header, sizeof(FileHeader), 1, pFile);
+		fwrite(vRecords.data(), sizeof(CModelFile::SectionRecord), nSections, pFile);
+		size_t pos = sizeof(FileHeader) + nSections * sizeof(CModelFile::SectionRecord);
+		const byte padding[FILE_ALIGNMENT] = { 0 };
+		for (size_t s = 0; s < nSections; s++) {
+			fwrite(padding, 1, static_cast<size_t>(vRecords[s].offset) - pos, pFile);
+			fwrite(m_vSections[s].second.data, 1, static_cast<size_t>(vRecords[s].size), pFile);
+			pos = static_cast<size_t>(vRecords[s].offset + vRecords[s].size);
+		} // s
+		fclose(pFile);
+	}
+
+	// =============================== Model File ===============================
+	// Constructor
+	CModelFile::CModelFile(std::shared_ptr<const void> pStorage, size_t size, const std::string &fileName) : m_pStorage(pStorage)
+	{
+		const byte		 *pData		= static_cast<const byte *>(m_pStorage.get());
+		const FileHeader *pHeader	= reinterpret_cast<const FileHeader *>(pData);
+		DGM_ASSERT_MSG(size >= sizeof(FileHeader) && memcmp(pHeader->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0, "The file %s is not a model file", fileName.c_str());
+		DGM_ASSERT_MSG(pHeader->version <= VERSION, "The version %u of the model file %s is not supported", pHeader->version, fileName.c_str());
+		DGM_ASSERT_MSG(size >= sizeof(FileHeader) + pHeader->nSections * sizeof(SectionRecord), "The model file %s is corrupted", fileName.c_str());
+
+		m_nSections = pHeader->nSections;
+		m_pSections = reinterpret_cast<const SectionRecord *>(pData + sizeof(FileHeader));
+		DGM_ASSERT_MSG(checksum(m_pSections, m_nSections * sizeof(SectionRecord)) == pHeader->checksum, "The model file %s is corrupted", fileName.c_str());
+		for (uint32_t s = 0; s < m_nSections; s++) {
+			const SectionRecord &record = m_pSections[s];
+			DGM_ASSERT_MSG(record.offset + record.size <= size, "The model file %s is corrupted", fileName.c_str());
+			DGM_ASSERT_MSG(record.rows >= 0 && record.cols >= 0 && record.size == static_cast<uint64_t>(record.rows) * record.cols * CV_ELEM_SIZE(record.type), "The model file %s is corrupted", fileName.c_str());
+		}
+	}
+
+	std::shared_ptr<const CModelFile> CModelFile::open(const std::string &fileName, bool mapped)
+	{
+		size_t size = 0;
+		std::shared_ptr<const void> pStorage = loadData(fileName, size, mapped);
+		return std::shared_ptr<const CModelFile>(new CModelFile(pStorage, size, fileName));
+	}
+
+	std::shared_ptr<const void> CModelFile::loadData(const std::string &fileName, size_t &size, bool mapped)
+	{
+		std::shared_ptr<const void> pStorage = mapped ? mapFile(fileName, size) : nullptr;
+		if (!pStorage) pStorage = readFile(fileName, size);
+		return pStorage;
+	}
+
+	bool CModelFile::isModelFile(const std::string &fileName)
+	{
+		FILE *pFile = fopen(fileName.c_str(), "rb");
+		if (!pFile) return false;
+		char magic[sizeof(FILE_MAGIC)];
+		const bool res = fread(magic, 1, sizeof(magic), pFile) == sizeof(magic) && memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0;
+		fclose(pFile);
+		return res;
+	}
+
+	Mat CModelFile::getSection(const std::string &name) const
+	{
+		const SectionRecord *pRecord = findSection(name);
+		DGM_ASSERT_MSG(pRecord, "The model file has no section %s", name.c_str());
+		if (pRecord->size == 0) return Mat(pRecord->rows, pRecord->cols, pRecord->type);
+		byte *pData = const_cast<byte *>(static_cast<const byte *>(m_pStorage.get())) + pRecord->offset;
+		return Mat(pRecord->rows, pRecord->cols, pRecord->type, pData);
+	}
+
+	bool CModelFile::verify(void) const
+	{
+		const byte *pData = static_cast<const byte *>(m_pStorage.get());
+		for (uint32_t s = 0; s < m_nSections; s++)
+			if (checksum(pData + m_pSections[s].offset, static_cast<size_t>(m_pSections[s].size)) != m_pSections[s].checksum) return false;
+		return true;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	const CModelFile::SectionRecord * CModelFile::findSection(const std::string &name) const
+	{
+		for (uint32_t s = 0; s < m_nSections; s++)
+			if (strncmp(m_pSections[s].name, name.c_str(), sizeof(SectionRecord::name)) == 0) return &m_pSections[s];
+		return nullptr;
+	}
+
+	uint32_t CModelFile::checksum(const void *pData, size_t size)
+	{
+		const byte *p	= static_cast<const byte *>(pData);
+		uint32_t	res = 2166136261u;
+		for (size_t i = 0; i < size; i++) res = (res ^ p[i]) * 16777619u;
+		return res;
+	}
+}
@@ -0,0 +1,144 @@
+// Versioned binary model container class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Model File Writer Class ================================
+	/**
+	* @brief Writer of the versioned binary model container
+	* @details The container consists of a header, a table of the named sections and the data of the sections. Every section holds a continuous matrix,
+	* whose data starts at a 64-byte aligned offset and is protected with a checksum. Thus, the container may be mapped into memory and its sections used in place 
+	* (ref. CModelFile).
+	* @code
+	* CModelFileWriter writer;
+	* writer.addSection("GMM.mu", mu);
+	* writer.save("model.dgm");
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CModelFileWriter
+	{
+	public:
+		DllExport CModelFileWriter(void) = default;
+		DllExport CModelFileWriter(const CModelFileWriter&) = delete;
+		DllExport ~CModelFileWriter(void) = default;
+
+		DllExport bool	operator=(const CModelFileWriter&) = delete;
+
+		/**
+		* @brief Adds a matrix section
+		* @details The matrix data is shared with the writer, if it is continuous, and copied otherwise: it must not be changed until save() is called
+		* @param name The unique name of the section (at most 31 characters)
+		* @param data The data of the section: the matrix of any type with at most 2 dimensions
+		*/
+		DllExport void	addSection(const std::string &name, const Mat &data);
+		/**
+		* @brief Adds a raw data section
+		* @details The data is copied into the writer
+		* @param name The unique name of the section (at most 31 characters)
+		* @param pData Pointer to the data
+		* @param size The size of the data in bytes
+		*/
+		DllExport void	addSection(const std::string &name, const void *pData, size_t size);
+		/**
+		* @brief Writes the container to a file
+		* @param fileName The name of the file
+		*/
+		DllExport void	save(const std::string &fileName) const;
+
+
+	private:
+		std::vector<std::pair<std::string, Mat>>	m_vSections;		///< The names and the data of the sections
+	};
+
+	// ================================ Model File Class ================================
+	/**
+	* @brief Versioned binary model container
+	* @details This class provides read-only access to the sections of a container, written by the @ref CModelFileWriter class. The file is mapped into memory 
+	* copy-on-write, and the sections are returned as the matrix headers, referring to the mapped data: the opening takes constant time, independently 
+	* from the size of the model, and the pages of the file are shared between all the processes, which open the same file, until they are modified.
+	* The matrices are valid as long as the container object exists.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CModelFile
+	{
+	public:
+		static const uint32_t VERSION;			///< The version of the container format, written by the CModelFileWriter class
+
+		DllExport CModelFile(const CModelFile&) = delete;
+		DllExport ~CModelFile(void) = default;
+
+		DllExport bool	operator=(const CModelFile&) = delete;
+
+		/**
+		* @brief Opens a model container
+		* @details The header and the table of sections are checked; the data of the sections is checked only by the verify() function
+		* @param fileName The name of the file
+		* @param mapped Flag indicating whether the file should be mapped into memory. If \a false, or if the file can not be mapped, it is read into an aligned buffer
+		* @return The container
+		*/
+		DllExport static std::shared_ptr<const CModelFile>	open(const std::string &fileName, bool mapped = true);
+		/**
+		* @brief Loads the whole content of a file into memory
+		* @details If \b mapped is \a true, the file is mapped into memory copy-on-write, otherwise, or if the file can not be mapped, it is read into a 64-byte aligned buffer
+		* @param[in] fileName The name of the file
+		* @param[out] size The size of the file in bytes
+		* @param[in] mapped Flag indicating whether the file should be mapped into memory
+		* @return The owner of the memory, holding the content of the file
+		*/
+		DllExport static std::shared_ptr<const void>		loadData(const std::string &fileName, size_t &size, bool mapped = true);
+		/**
+		* @brief Checks whether a file is a model container
+		* @details Only the signature of the file is checked
+		* @param fileName The name of the file
+		* @return \a true if the file starts with the signature of the model container, \a false otherwise or if the file can not be opened
+		*/
+		DllExport static bool								isModelFile(const std::string &fileName);
+		/**
+		* @brief Checks whether the container has a section
+		* @param name The name of the section
+		* @return \a true if the section exists, \a false otherwise
+		*/
+		DllExport bool	hasSection(const std::string &name) const { return findSection(name) != nullptr; }
+		/**
+		* @brief Returns a section
+		* @param name The name of the section. If the section does not exist, an exception is thrown
+		* @return The matrix header, referring to the data of the section within the container. Changes of the matrix values are not written to the file
+		*/
+		DllExport Mat	getSection(const std::string &name) const;
+		/**
+		* @brief Checks the data of all the sections with their checksums
+		* @details This function reads the whole file
+		* @return \a true if all the sections are intact, \a false otherwise
+		*/
+		DllExport bool	verify(void) const;
+
+
+	private:
+		/// Record of a section in the table of sections
+		struct SectionRecord {
+			char		name[32];
+			int32_t		type;						// the OpenCV type of the matrix
+			int32_t		rows;
+			int32_t		cols;
+			uint32_t	checksum;					// FNV-1a hash of the data
+			uint64_t	offset;						// the offset of the data from the beginning of the file
+			uint64_t	size;						// the size of the data in bytes
+		};
+
+		friend class CModelFileWriter;
+
+		CModelFile(std::shared_ptr<const void> pStorage, size_t size, const std::string &fileName);
+		const SectionRecord *	findSection(const std::string &name) const;
+		static uint32_t			checksum(const void *pData, size_t size);
+
+
+	private:
+		std::shared_ptr<const void>		m_pStorage;		///< The owner of the memory, holding the content of the file
+		const SectionRecord			  *	m_pSections;	///< The table of sections within the storage
+		uint32_t						m_nSections;	///< The number of sections
+	};
+}
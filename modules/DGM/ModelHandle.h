@@ -0,0 +1,92 @@
+// Shareable model handle class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	// ============================== Model Handle Class ==============================
+	/**
+	* @brief Shareable handle of an immutable model with the hot swap
+	* @details The long-running services keep the trained models, \a e.g. @ref CTrainNode and @ref CTrainEdge, or the graph templates loaded and use them
+	* from many threads. The CBaseRandomModel::loadModel() function modifies the model in place and thus may not be called while the model is in use.
+	* This handle holds the model as \b std::shared_ptr<const T>: every request takes a snapshot of the current model with get() and uses it until
+	* the end of the request, while a new model is loaded into a separate object and published with set() or reload(). The new requests pick up the new
+	* model at once, the requests in flight finish with the old one, and the old model is released together with the last snapshot:
+	* @code
+	* CModelHandle<CTrainNode> nodeModel(CTrainNode::create(NodeRandomModel::GMM, nStates, nFeatures));
+	* // ... serving threads
+	* std::shared_ptr<const CTrainNode> pModel = nodeModel.get();
+	* Mat pots = pModel->getNodePotentials(featureVectors);
+	* // ... control thread
+	* nodeModel.reload("model.dgm", [] { return CTrainNode::create(NodeRandomModel::GMM, nStates, nFeatures); });
+	* @endcode
+	* With the memory-mapped model containers (ref. CBaseRandomModel::loadModel()) the loading of a new model takes almost no time.
+	* Neither get() nor set() waits for the loading of a model; the pointer is exchanged with the atomic operations of \b std::shared_ptr.
+	* @tparam T The type of the model. Its constant member functions must be thread-safe
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	template <typename T>
+	class CModelHandle
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param pModel The initial model
+		*/
+		explicit CModelHandle(std::shared_ptr<const T> pModel = nullptr) : m_pModel(std::move(pModel)), m_version(0) {}
+		~CModelHandle(void) = default;
+		CModelHandle(const CModelHandle &) = delete;
+		const CModelHandle& operator= (const CModelHandle &) = delete;
+
+		/**
+		* @brief Returns the current model
+		* @details The snapshot stays valid and unchanged, while it is held by the caller, even if another model is published meanwhile.
+		* > This function is thread-safe
+		* @return The snapshot of the current model
+		*/
+		std::shared_ptr<const T>	get(void) const { return std::atomic_load_explicit(&m_pModel, std::memory_order_acquire); }
+		/**
+		* @brief Publishes a new model
+		* @details The model must not be modified after the publishing.
+		* > This function is thread-safe
+		* @param pModel The new model
+		* @return The previous model
+		*/
+		std::shared_ptr<const T>	set(std::shared_ptr<const T> pModel)
+		{
+			std::shared_ptr<const T> res = std::atomic_exchange_explicit(&m_pModel, std::move(pModel), std::memory_order_acq_rel);
+			m_version++;
+			return res;
+		}
+		/**
+		* @brief Loads a new model from a model container and publishes it
+		* @details The model is created with the \b create function, loaded with CBaseRandomModel::loadModel() and published with set(). If the loading
+		* throws an exception, the current model stays published.
+		* @param fileName The name of the model file
+		* @param create The function, creating an empty model
+		* @param mapped Flag indicating whether the file should be mapped into memory
+		* @param verify Flag indicating whether the data of all the sections should be checked with their checksums
+		* @return The previous model
+		*/
+		std::shared_ptr<const T>	reload(const std::string &fileName, const std::function<std::shared_ptr<T>(void)> &create, bool mapped = true, bool verify = false)
+		{
+			std::shared_ptr<T> pModel = create();
+			pModel->loadModel(fileName, mapped, verify);
+			return set(std::move(pModel));
+		}
+		/**
+		* @brief Returns the version of the model
+		* @return The number of the models, published with set() or reload() since the construction
+		*/
+		size_t						getVersion(void) const { return m_version; }
+
+
+	private:
+		std::shared_ptr<const T>	m_pModel;		///< The current model
+		std::atomic<size_t>			m_version;		///< The number of the published models
+	};
+}
@@ -22,12 +22,38 @@ namespace DirectGraphicalModels
 		m_nPoints++;
 	}
 
+	void CPDFGaussian::merge(const IPDF &pdf)
+	{
+		const CPDFGaussian &rhs = dynamic_cast<const CPDFGaussian &>(pdf);
+		if (rhs.m_nPoints == 0) return;
+
+		const double a	= static_cast<double>(m_nPoints) / (m_nPoints + rhs.m_nPoints);
+		const double d	= rhs.m_mu - m_mu;
+		m_mu		   += (1.0 - a) * d;
+		m_sigma2		= a * m_sigma2 + (1.0 - a) * rhs.m_sigma2 + a * (1.0 - a) * d * d;
+		m_nPoints	   += rhs.m_nPoints;
+	}
+
 	double CPDFGaussian::getDensity(Scalar point)
 	{
 		return exp(- 0.5f * (point[0] - m_mu) * (point[0] - m_mu) / m_sigma2) /
 			(sqrt(2.0f * m_sigma2 * Pi));
 	}
 
+	void CPDFGaussian::getDensities(const Mat &points, Mat &densities)
+	{
+		Mat pts;
+		points.col(0).convertTo(pts, CV_32FC1);
+		densities.create(points.rows, 1, CV_32FC1);
+		const float mu		= static_cast<float>(m_mu);
+		const float k		= static_cast<float>(-0.5 / m_sigma2);
+		const float norm	= static_cast<float>(1.0 / sqrt(2.0 * m_sigma2 * Pi));
+		for (int i = 0; i < pts.rows; i++) {
+			const float d = pts.at<float>(i, 0) - mu;
+			densities.at<float>(i, 0) = norm * expf(k * d * d);
+		}
+	}
+
 	void CPDFGaussian::smooth(unsigned int nIt)
 	{
 		DGM_WARNING("This function is not implemented");
@@ -21,10 +21,13 @@ namespace DirectGraphicalModels
 		DllExport virtual void		reset(void) override;
 
 		DllExport virtual void		addPoint(Scalar point) override;
+		DllExport virtual void		merge(const IPDF &pdf) override;
 		DllExport virtual double	getDensity(Scalar point) override;
+		DllExport virtual void		getDensities(const Mat &points, Mat &densities) override;
 		DllExport virtual void 		smooth(unsigned int nIt) override;
 		DllExport virtual Scalar	min(void) const override { return Scalar(m_mu - 3 * sqrt(m_sigma2)); }
 		DllExport virtual Scalar	max(void) const override { return Scalar(m_mu + 3 * sqrt(m_sigma2)); }
+		DllExport virtual size_t	getMemoryUsage(void) const override { return sizeof(*this); }
 
 
 	protected:
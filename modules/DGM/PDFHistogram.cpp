@@ -3,7 +3,7 @@
 namespace DirectGraphicalModels 
 {
 	// Constructor
-	CPDFHistogram::CPDFHistogram(void) : IPDF()
+	CPDFHistogram::CPDFHistogram(void) : IPDF(), m_pTableOnce(std::make_unique<std::once_flag>()), m_isTableValid(false)
 	{
 		memset(m_data, 0, 256 * sizeof(long));
 	}
@@ -12,6 +12,7 @@ namespace DirectGraphicalModels
 	{
 		memset(m_data, 0, 256 * sizeof(long));
 		m_nPoints = 0;
+		invalidateTable();
 	}
 
 	void CPDFHistogram::addPoint(Scalar point)
@@ -19,6 +20,15 @@ namespace DirectGraphicalModels
 		byte i = static_cast<byte>(MIN(255, MAX(0, point[0])));
 		m_data[i]++;
 		m_nPoints++;
+		invalidateTable();
+	}
+
+	void CPDFHistogram::merge(const IPDF &pdf)
+	{
+		const CPDFHistogram &rhs = dynamic_cast<const CPDFHistogram &>(pdf);
+		for (int i = 0; i < 256; i++) m_data[i] += rhs.m_data[i];
+		m_nPoints += rhs.m_nPoints;
+		invalidateTable();
 	}
 
 	double CPDFHistogram::getDensity(Scalar point)
@@ -27,14 +37,30 @@ namespace DirectGraphicalModels
 		return m_nPoints ? static_cast<double>(m_data[i]) / m_nPoints : 0;
 	}
 
+	void CPDFHistogram::getDensities(const Mat &points, Mat &densities)
+	{
+		updateTable();
+		densities.create(points.rows, 1, CV_32FC1);
+		if (points.depth() == CV_8U) 
+			for (int i = 0; i < points.rows; i++)
+				densities.at<float>(i, 0) = m_table[points.at<byte>(i, 0)];
+		else {
+			Mat pts;
+			points.col(0).convertTo(pts, CV_32FC1);
+			for (int i = 0; i < pts.rows; i++)
+				densities.at<float>(i, 0) = m_table[static_cast<byte>(MIN(255, MAX(0, pts.at<float>(i, 0))))];
+		}
+	}
+
 	void CPDFHistogram::smooth(unsigned int nIt)
 	{
 		long tmp[256];
 		for (unsigned int iter = 0; iter < nIt; iter++) {
 			memcpy(tmp, m_data, 256 * sizeof(long));
 			for (int i = 1; i < 255; i++)
-				m_data[i] = static_cast<long>(0.25 * (tmp[i-1] + 2 * tmp[i] + tmp[i+1]));
+				m_data[i] = (tmp[i-1] + 2 * tmp[i] + tmp[i+1]) / 4;		// the counts are non-negative, so the division truncates as 0.25 * (...) did
 		} // iterations
+		invalidateTable();
 	}
 
 	void CPDFHistogram::saveFile(FILE *pFile) const
@@ -47,5 +73,24 @@ namespace DirectGraphicalModels
 	{
 		fread(&m_data, sizeof(long), 256, pFile);
 		fread(&m_nPoints, sizeof(long), 1,   pFile);
+		invalidateTable();
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CPDFHistogram::updateTable(void)
+	{
+		std::call_once(*m_pTableOnce, [this] {
+			const float k = m_nPoints ? 1.0f / m_nPoints : 0.0f;
+			for (int i = 0; i < 256; i++) m_table[i] = k * m_data[i];
+			m_isTableValid = true;
+		});
+	}
+
+	// The flag is replaced only if it has been used, so that addPoint() does not allocate for every point
+	void CPDFHistogram::invalidateTable(void)
+	{
+		if (!m_isTableValid) return;
+		m_pTableOnce = std::make_unique<std::once_flag>();
+		m_isTableValid = false;
 	}
 }
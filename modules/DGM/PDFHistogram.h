@@ -3,6 +3,7 @@
 #pragma once
 
 #include "IPDF.h"
+#include <mutex>
 
 namespace DirectGraphicalModels 
 {
@@ -11,10 +12,15 @@ namespace DirectGraphicalModels
 	 * @brief Histogram-based PDF class (1D)
 	 * @details This class makes use of distribution histograms in order to estimate the PDF. The length of the histogram is 255,
 	 * thus arguments \b point of the addPoint() and getDensity() functions should be also in range [0; 255].
+	 * The normalized densities are cached in a table of floats, which is updated on the first density request after the histogram has changed;
+	 * getDensities() evaluates a batch of points with this table. The table is filled once with std::call_once(), thus getDensities() may be called
+	 * concurrently, as long as the histogram is not changed at the same time.
 	 * @author Sergey G. Kosov, sergey.kosov@project-10.de
 	 */	
 	class CPDFHistogram : public IPDF
 	{
+	friend class CTrainNodeBayes;
+
 	public:
 		DllExport CPDFHistogram(void);
 		DllExport virtual ~CPDFHistogram(void) = default;
@@ -22,10 +28,18 @@ namespace DirectGraphicalModels
 		DllExport virtual void		reset(void) override;
 
 		DllExport virtual void		addPoint(Scalar point) override;
+		DllExport virtual void		merge(const IPDF &pdf) override;
 		DllExport virtual double	getDensity(Scalar point) override;
+		DllExport virtual void		getDensities(const Mat &points, Mat &densities) override;
+		/**
+		 * @brief Performs the gaussian smoothing on the histogram
+		 * @details Every iteration convolves the histogram with the kernel [1 2 1] / 4 in integer arithmetic, which the compiler vectorizes
+		 * @param nIt Number of iterations
+		 */
 		DllExport virtual void		smooth(unsigned int nIt) override;
 		DllExport virtual Scalar	min(void) const override { return Scalar(0); }
 		DllExport virtual Scalar	max(void) const override { return Scalar(255); }
+		DllExport virtual size_t	getMemoryUsage(void) const override { return sizeof(*this) + sizeof(std::once_flag); }
 
 
 	protected:
@@ -34,7 +48,23 @@ namespace DirectGraphicalModels
 
 
 	private:
-		long m_data[256];
+		/**
+		 * @brief Fills the table of the normalized densities, if the histogram has changed
+		 * @details Thread-safe: the concurrent callers wait until the first one has filled the table
+		 */
+		void	updateTable(void);
+		/**
+		 * @brief Marks the table of the normalized densities as outdated
+		 * @details Must not be called concurrently with updateTable()
+		 */
+		void	invalidateTable(void);
+
+
+	private:
+		long							m_data[256];
+		float							m_table[256];		///< The normalized densities m_data / m_nPoints
+		std::unique_ptr<std::once_flag>	m_pTableOnce;		///< Guards the filling of m_table; replaced by a new one, when the histogram changes
+		bool							m_isTableValid;		///< Flag indicating whether m_table has been filled under the current m_pTableOnce
 	};
 
 }
@@ -1,4 +1,5 @@
 #include "PDFHistogram2D.h"
+#include "parallel.h"
 
 namespace DirectGraphicalModels
 {
@@ -22,6 +23,15 @@ namespace DirectGraphicalModels
 		m_nPoints++;
 	}
 
+	void CPDFHistogram2D::merge(const IPDF &pdf)
+	{
+		const CPDFHistogram2D &rhs = dynamic_cast<const CPDFHistogram2D &>(pdf);
+		for (int x = 0; x < 256; x++)
+			for (int y = 0; y < 256; y++)
+				m_data[x][y] += rhs.m_data[x][y];
+		m_nPoints += rhs.m_nPoints;
+	}
+
 	double CPDFHistogram2D::getDensity(Scalar point)
 	{
 		byte x = static_cast<byte>(MIN(255, MAX(0, point[0])));
@@ -29,14 +39,39 @@ namespace DirectGraphicalModels
 		return m_nPoints ? static_cast<double>(m_data[x][y]) / m_nPoints : 0;
 	}
 
+	void CPDFHistogram2D::getDensities(const Mat &points, Mat &densities)
+	{
+		DGM_ASSERT(points.cols >= 2);
+		const float k = m_nPoints ? 1.0f / m_nPoints : 0.0f;
+		densities.create(points.rows, 1, CV_32FC1);
+		if (points.depth() == CV_8U)
+			for (int i = 0; i < points.rows; i++) {
+				const byte *pPoint = points.ptr<byte>(i);
+				densities.at<float>(i, 0) = k * m_data[pPoint[0]][pPoint[1]];
+			}
+		else {
+			Mat pts;
+			points.colRange(0, 2).convertTo(pts, CV_32FC1);
+			for (int i = 0; i < pts.rows; i++) {
+				const float *pPoint = pts.ptr<float>(i);
+				byte x = static_cast<byte>(MIN(255, MAX(0, pPoint[0])));
+				byte y = static_cast<byte>(MIN(255, MAX(0, pPoint[1])));
+				densities.at<float>(i, 0) = k * m_data[x][y];
+			}
+		}
+	}
+
 	void CPDFHistogram2D::smooth(unsigned int nIt)
 	{
-		long tmp[256][256];
+		std::vector<long> vTmp(256 * 256);									// 512 KB are too many for the stack
+		auto tmp = reinterpret_cast<long (*)[256]>(vTmp.data());
 		for (unsigned int iter = 0; iter < nIt; iter++) {
 			memcpy(tmp, m_data, 256 * 256 * sizeof(long));
-			for (int x = 1; x < 255; x++)
-				for (int y = 1; y < 255; y++)
-					m_data[x][y] = static_cast<long>(0.125 * (tmp[x][y-1] + tmp[x-1][y] + 4 * tmp[x][y] + tmp[x+1][y] + tmp[x][y+1]));
+			parallel::parallelFor(Range(1, 255), [&](const Range &range) {
+				for (int x = range.start; x < range.end; x++)
+					for (int y = 1; y < 255; y++)		// the counts are non-negative, so the division truncates as 0.125 * (...) did
+						m_data[x][y] = (tmp[x][y-1] + tmp[x-1][y] + 4 * tmp[x][y] + tmp[x+1][y] + tmp[x][y+1]) / 8;
+			});
 		} // iterations
 	}
 
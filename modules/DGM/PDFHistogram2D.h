@@ -16,6 +16,8 @@ namespace DirectGraphicalModels
 	*/
 	class CPDFHistogram2D : public IPDF
 	{
+	friend class CTrainNodeBayes;
+
 	public:
 		DllExport CPDFHistogram2D(void);
 		DllExport virtual ~CPDFHistogram2D(void) = default;
@@ -23,10 +25,19 @@ namespace DirectGraphicalModels
 		DllExport virtual void		reset(void) override;
 
 		DllExport virtual void		addPoint(Scalar point) override;
+		DllExport virtual void		merge(const IPDF &pdf) override;
 		DllExport virtual double	getDensity(Scalar point) override;
+		DllExport virtual void		getDensities(const Mat &points, Mat &densities) override;
+		/**
+		 * @brief Performs the gaussian smoothing on the histogram
+		 * @details Every iteration convolves the histogram with the 5-point kernel in integer arithmetic, which the compiler vectorizes, and the rows
+		 * are processed in parallel
+		 * @param nIt Number of iterations
+		 */
 		DllExport virtual void		smooth(unsigned int nIt) override;
 		DllExport virtual Scalar	min(void) const override { return Scalar(0); }
 		DllExport virtual Scalar	max(void) const override { return Scalar(255); }
+		DllExport virtual size_t	getMemoryUsage(void) const override { return sizeof(*this); }
 
 
 	protected:
@@ -2,7 +2,10 @@
 
 #include "ParamEstimationPowell.h"
 #include "ParamEstimationPSO.h"
+#include "ParamEstimationBO.h"
 
+#include "Graph.h"
+#include "parallel.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels 
@@ -19,11 +22,52 @@ namespace DirectGraphicalModels
 		switch (paramEstimationModel) {
 			case ParamEstimationModel::Powell:	return std::make_shared<CParamEstimationPowell>(nParams);
 			case ParamEstimationModel::PSO:		return std::make_shared<CParamEstimationPSO>(nParams);
+			case ParamEstimationModel::BO:		return std::make_shared<CParamEstimationBO>(nParams);
 			default:
 				DGM_ASSERT_MSG(false, "Unknown type of the parameter estimation model");
 		}
 	}
 
+    std::vector<vec_float_t> CParamEstimation::getBatch(void) {
+        DGM_ASSERT_MSG(false, "This parameter estimation method does not support the batch evaluation");
+        return std::vector<vec_float_t>();
+    }
+
+    void CParamEstimation::setBatchValues(const vec_float_t&) {
+        DGM_ASSERT_MSG(false, "This parameter estimation method does not support the batch evaluation");
+    }
+
+    vec_float_t CParamEstimation::evaluate(const std::vector<vec_float_t>& vvParams, const CGraph& graph, const objective_function_t& objective, size_t maxConcurrency) {
+        vec_float_t res(vvParams.size());
+        parallel::parallelFor(Range(0, static_cast<int>(vvParams.size())), [&](const Range& range) {
+            for (int i = range.start; i < range.end; i++) {
+                std::unique_ptr<CGraph> pGraph = graph.clone();        // the snapshot: the evaluations do not share the graph
+                res[i] = objective(vvParams[i], *pGraph);
+            }
+        }, 1, maxConcurrency);
+        return res;
+    }
+
+    vec_float_t CParamEstimation::optimize(const CGraph& graph, const objective_function_t& objective, size_t maxConcurrency) {
+        while (!isConverged()) {
+            const std::vector<vec_float_t> vvParams = getBatch();
+            setBatchValues(evaluate(vvParams, graph, objective, maxConcurrency));
+        }
+        return m_vParams;
+    }
+
+    vec_float_t CParamEstimation::optimize(const std::function<float(const vec_float_t &)> &objective, size_t maxConcurrency) {
+        while (!isConverged()) {
+            const std::vector<vec_float_t> vvParams = getBatch();
+            vec_float_t vValues(vvParams.size());
+            parallel::parallelFor(Range(0, static_cast<int>(vvParams.size())), [&](const Range& range) {
+                for (int i = range.start; i < range.end; i++) vValues[i] = objective(vvParams[i]);
+            }, 1, maxConcurrency);
+            setBatchValues(vValues);
+        }
+        return m_vParams;
+    }
+
     void CParamEstimation::setInitParams(const vec_float_t& vParams) {
         DGM_ASSERT_MSG(vParams.size() == m_vParams.size(),
             "The size of the argument (%zu) does not correspond to the number of parameters (%zu)",
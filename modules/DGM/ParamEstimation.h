@@ -4,13 +4,17 @@
 #pragma once
 
 #include "types.h"
+#include <functional>
 
 namespace DirectGraphicalModels 
 {
+	class CGraph;
+
 	/// Types of the parameter estimation model
 	enum ParamEstimationModel : byte {
 		Powell = 0,				///< Powell parameter optimization
-		PSO						///< Particle Swarm optimization
+		PSO,					///< Particle Swarm optimization
+		BO						///< Bayesian optimization
 	 };
 
 	/**
@@ -19,6 +23,9 @@ namespace DirectGraphicalModels
 	class CParamEstimation
 	{
 	public:
+		/// The objective function: returns the value of the objective function for the parameters (arguments), evaluated on its own copy of the graph. It is called concurrently
+		using objective_function_t = std::function<float(const vec_float_t &vParams, CGraph &graph)>;
+
 		/**
 		 * @brief Constructor
 		 * @param nParams Number of parameters (arguments) of the objective function
@@ -53,6 +60,60 @@ namespace DirectGraphicalModels
 		 * @retval false otherwise
 		 */
 		DllExport virtual bool isConverged(void) const = 0;
+		/**
+		 * @brief Gets all the parameters (arguments), which may be evaluated independently
+		 * @details This function is the batch counterpart of getParams(): the objective function should be evaluated for every returned parameters array,
+		 * \a e.g. concurrently with evaluate(), and the values should be passed to setBatchValues() in the same order before the next call.
+		 * > The default implementation does not support the batch evaluation
+		 * @return The arrays with the parameters to be evaluated
+		 */
+		DllExport virtual std::vector<vec_float_t> getBatch(void);
+		/**
+		 * @brief Sets the values of the objective function for the last batch
+		 * @details This function updates the parameters (arguments) based on the outcome values of the objective function for the arrays, returned by getBatch()
+		 * > The default implementation does not support the batch evaluation
+		 * @param vValues The values of the objective function: one per array, returned by getBatch()
+		 */
+		DllExport virtual void setBatchValues(const vec_float_t &vValues);
+		/**
+		 * @brief Evaluates the objective function concurrently
+		 * @details Every evaluation is given its own snapshot of the \b graph (ref. CGraph::clone()), thus the objective function may change the graph,
+		 * \a e.g. set new potentials and run the inference, without synchronization. The evaluations are executed by the library thread pool (ref. parallel::parallelFor()).
+		 * > This function supports PPL.
+		 * @param vvParams The arrays with the parameters (arguments), \a e.g. returned by getBatch()
+		 * @param graph The graph, which is copied for every evaluation
+		 * @param objective The objective function
+		 * @param maxConcurrency The maximal number of concurrent evaluations. If zero, no limit is applied
+		 * @return The values of the objective function: one per array in \b vvParams
+		 */
+		DllExport static vec_float_t evaluate(const std::vector<vec_float_t> &vvParams, const CGraph &graph, const objective_function_t &objective, size_t maxConcurrency = 0);
+		/**
+		 * @brief Runs the search until the method has converged
+		 * @details This function alternates getBatch(), evaluate() and setBatchValues():
+		 * @code
+		 * pso.setInitParams(vInitParams);
+		 * vec_float_t vParams = pso.optimize(graph, [&](const vec_float_t &vParams, CGraph &graphCopy) {
+		 *	trainAndFill(graphCopy, vParams);
+		 *	vec_byte_t vLabels = CInferLBP(dynamic_cast<IGraphPairwise &>(graphCopy)).decode(100);
+		 *	return getAccuracy(vLabels);
+		 * });
+		 * @endcode
+		 * @param graph The graph, which is copied for every evaluation
+		 * @param objective The objective function
+		 * @param maxConcurrency The maximal number of concurrent evaluations. If zero, no limit is applied
+		 * @return The array with the optimal parameters
+		 */
+		DllExport vec_float_t optimize(const CGraph &graph, const objective_function_t &objective, size_t maxConcurrency = 0);
+		/**
+		 * @brief Runs the search until the method has converged
+		 * @details This function alternates getBatch(), the concurrent evaluations of the \b objective function and setBatchValues(). Unlike the function above,
+		 * no graph is copied: the objective function keeps its own state, \a e.g. the graphs and the inferers of @ref CEdgeTuner, which are re-used by the evaluations.
+		 * > This function supports PPL.
+		 * @param objective The objective function. It is called concurrently
+		 * @param maxConcurrency The maximal number of concurrent evaluations. If zero, no limit is applied
+		 * @return The array with the optimal parameters
+		 */
+		DllExport vec_float_t optimize(const std::function<float(const vec_float_t &vParams)> &objective, size_t maxConcurrency = 0);
 		
 		/**
 		 * @brief Sets the initial parameters (arguments) for the search algorithm
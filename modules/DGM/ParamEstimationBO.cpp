@@ -0,0 +1,283 @@
+#include "ParamEstimationBO.h"
+#include "parallel.h"
+#include "random.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Gaussian process with the squared exponential kernel and unit signal variance on the unit hypercube
+		class CGaussianProcess {
+		public:
+			CGaussianProcess(double lengthScale) : m_lengthScale(lengthScale) {}
+
+			// Fits the process to the points vvX with the normalized values vY
+			bool fit(const std::vector<vec_float_t> &vvX, const std::vector<double> &vY)
+			{
+				const size_t n = vvX.size();
+				m_vvX = vvX;
+				m_vL.assign(n * n, 0);
+				for (size_t j = 0; j < n; j++) {					// Cholesky decomposition of the kernel matrix
+					double sum = 1 + NOISE;
+					for (size_t k = 0; k < j; k++) sum -= m_vL[j * n + k] * m_vL[j * n + k];
+					if (sum <= 0) return false;
+					m_vL[j * n + j] = sqrt(sum);
+					for (size_t i = j + 1; i < n; i++) {
+						double s = kernel(vvX[i], vvX[j]);
+						for (size_t k = 0; k < j; k++) s -= m_vL[i * n + k] * m_vL[j * n + k];
+						m_vL[i * n + j] = s / m_vL[j * n + j];
+					}
+				}
+				m_vAlpha = solveLower(vY);
+				for (size_t i = n; i-- > 0; ) {						// back substitution with the transposed factor
+					for (size_t k = i + 1; k < n; k++) m_vAlpha[i] -= m_vL[k * n + i] * m_vAlpha[k];
+					m_vAlpha[i] /= m_vL[i * n + i];
+				}
+
+				m_logLikelihood = -0.5 * n * log(2 * Pif);
+				for (size_t i = 0; i < n; i++) m_logLikelihood -= 0.5 * vY[i] * m_vAlpha[i] + log(m_vL[i * n + i]);
+				return true;
+			}
+
+			// Predicts the mean and the standard deviation at the point x
+			void predict(const vec_float_t &x, double &mu, double &sigma) const
+			{
+				std::vector<double> vK(m_vvX.size());
+				for (size_t i = 0; i < m_vvX.size(); i++) vK[i] = kernel(x, m_vvX[i]);
+				mu = 0;
+				for (size_t i = 0; i < vK.size(); i++) mu += vK[i] * m_vAlpha[i];
+				const std::vector<double> vV = solveLower(vK);
+				double var = 1 + NOISE;
+				for (double v : vV) var -= v * v;
+				sigma = sqrt(MAX(var, 1e-12));
+			}
+
+			double getLogLikelihood(void) const { return m_logLikelihood; }
+
+
+		private:
+			double kernel(const vec_float_t &a, const vec_float_t &b) const
+			{
+				double dist2 = 0;
+				for (size_t d = 0; d < a.size(); d++) dist2 += static_cast<double>(a[d] - b[d]) * (a[d] - b[d]);
+				return exp(-0.5 * dist2 / (m_lengthScale * m_lengthScale));
+			}
+
+			// Solves L x = b
+			std::vector<double> solveLower(const std::vector<double> &b) const
+			{
+				const size_t n = b.size();
+				std::vector<double> res(b);
+				for (size_t i = 0; i < n; i++) {
+					for (size_t k = 0; k < i; k++) res[i] -= m_vL[i * n + k] * res[k];
+					res[i] /= m_vL[i * n + i];
+				}
+				return res;
+			}
+
+
+		private:
+			static constexpr double		NOISE = 1e-6;		// the variance of the observation noise, which also regularizes the kernel matrix
+
+			double						m_lengthScale;
+			double						m_logLikelihood = 0;
+			std::vector<vec_float_t>	m_vvX;
+			std::vector<double>			m_vL;				// the lower triangular Cholesky factor of the kernel matrix: n x n
+			std::vector<double>			m_vAlpha;			// the kernel matrix, inverted and multiplied with the values
+		};
+
+		// Expected improvement over the value best for the maximization
+		inline double expectedImprovement(double mu, double sigma, double best)
+		{
+			const double xi	= 0.01;								// exploration margin
+			const double z	= (mu - best - xi) / sigma;
+			return (mu - best - xi) * 0.5 * erfc(-z / sqrt(2.0)) + sigma * exp(-0.5 * z * z) / sqrt(2 * Pif);
+		}
+	}
+
+	const size_t CParamEstimationBO::NUMBER_CANDIDATES = 2000;
+
+	// Constructor
+	CParamEstimationBO::CParamEstimationBO(size_t nParams)
+		: CParamEstimation(nParams)
+		, m_nInitial(MAX(5, 2 * nParams))
+	{
+		reset();
+	}
+
+	void CParamEstimationBO::reset(void)
+	{
+		m_maxEvaluations	= 50;
+		m_batchSize			= 4;
+		m_converged			= false;
+		m_valBest			= -FLT_MAX;
+
+		std::fill(m_vParams.begin(), m_vParams.end(), 0.0f);
+		std::fill(m_vDeltas.begin(), m_vDeltas.end(), 0.1f);
+		std::fill(m_vMin.begin(), m_vMin.end(), -FLT_MAX);
+		std::fill(m_vMax.begin(), m_vMax.end(), FLT_MAX);
+
+		m_vLower.clear();
+		m_vUpper.clear();
+		m_vvX.clear();
+		m_vY.clear();
+		m_vvPending.clear();
+	}
+
+	vec_float_t CParamEstimationBO::getParams(float val)
+	{
+		if (m_vLower.empty()) initDomain();
+
+		// The value belongs to the last returned point, or to the initial parameters on the first call
+		if (!m_vvPending.empty()) {
+			addObservation(m_vvPending.front(), val);
+			m_vvPending.erase(m_vvPending.begin());
+		}
+		else if (m_vY.empty()) addObservation(m_vParams, val);
+
+		if (m_vvPending.empty() && !isConverged()) m_vvPending = propose();
+		return m_vvPending.empty() ? m_vParams : m_vvPending.front();
+	}
+
+	bool CParamEstimationBO::isConverged(void) const
+	{
+		return m_converged || m_vY.size() >= m_maxEvaluations;
+	}
+
+	std::vector<vec_float_t> CParamEstimationBO::getBatch(void)
+	{
+		if (m_vLower.empty()) initDomain();
+
+		if (m_vvPending.empty() && !isConverged()) {
+			if (m_vY.empty()) m_vvPending.push_back(m_vParams);		// the initial parameters
+			for (vec_float_t &vParams : propose()) m_vvPending.push_back(vParams);
+		}
+		return m_vvPending;
+	}
+
+	void CParamEstimationBO::setBatchValues(const vec_float_t &vValues)
+	{
+		DGM_ASSERT_MSG(vValues.size() == m_vvPending.size(),
+			"The number of values (%zu) does not correspond to the size of the batch (%zu)",
+			vValues.size(), m_vvPending.size());
+
+		for (size_t i = 0; i < vValues.size(); i++)
+			addObservation(m_vvPending[i], vValues[i]);
+		m_vvPending.clear();
+	}
+
+	void CParamEstimationBO::setMaxEvaluations(size_t maxEvaluations)
+	{
+		if (maxEvaluations > 0) m_maxEvaluations = maxEvaluations;
+		else DGM_WARNING("Zero number of evaluations was not set");
+	}
+
+	void CParamEstimationBO::setBatchSize(size_t batchSize)
+	{
+		if (batchSize > 0) m_batchSize = batchSize;
+		else DGM_WARNING("Zero batch size was not set");
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// Fixes the search domain, once the initial parameters and the boundaries are set
+	void CParamEstimationBO::initDomain(void)
+	{
+		m_vLower.resize(m_vParams.size());
+		m_vUpper.resize(m_vParams.size());
+		for (size_t p = 0; p < m_vParams.size(); p++) {
+			m_vLower[p] = m_vMin[p] > -FLT_MAX ? m_vMin[p] : m_vParams[p] - 10 * m_vDeltas[p];
+			m_vUpper[p] = m_vMax[p] <  FLT_MAX ? m_vMax[p] : m_vParams[p] + 10 * m_vDeltas[p];
+			if (m_vUpper[p] <= m_vLower[p]) m_vUpper[p] = m_vLower[p] + 1;
+		}
+	}
+
+	void CParamEstimationBO::addObservation(const vec_float_t &vParams, float val)
+	{
+		vec_float_t x(vParams.size());
+		for (size_t p = 0; p < x.size(); p++)
+			x[p] = (vParams[p] - m_vLower[p]) / (m_vUpper[p] - m_vLower[p]);
+		m_vvX.push_back(x);
+		m_vY.push_back(val);
+
+		if (val > m_valBest) {
+			m_valBest = val;
+			m_vParams = vParams;
+		}
+	}
+
+	// Returns the next points: random points for the initial design, afterwards the maximizers of the expected improvement
+	std::vector<vec_float_t> CParamEstimationBO::propose(void)
+	{
+		const size_t nParams	= m_vParams.size();
+		const size_t nKnown		= m_vY.size() + m_vvPending.size();
+		const size_t nLeft		= m_maxEvaluations > nKnown ? m_maxEvaluations - nKnown : 0;
+
+		std::vector<vec_float_t> vvRes;
+		if (nKnown < m_nInitial) {
+			vvRes.resize(MIN(m_nInitial - nKnown, nLeft));
+			for (vec_float_t &x : vvRes) {
+				x.resize(nParams);
+				for (float &p : x) p = random::U<float>();
+			}
+		} else if (!m_vY.empty()) {
+			// Normalize the values
+			std::vector<double> vY(m_vY.begin(), m_vY.end());
+			double mean = 0, sd = 0;
+			for (double y : vY) mean += y;
+			mean /= vY.size();
+			for (double y : vY) sd += (y - mean) * (y - mean);
+			sd = sqrt(sd / vY.size());
+			if (sd < DBL_EPSILON) sd = 1;
+			for (double &y : vY) y = (y - mean) / sd;
+
+			// Choose the length scale, maximizing the marginal likelihood
+			std::vector<vec_float_t> vvX = m_vvX;
+			std::unique_ptr<CGaussianProcess> pGP;
+			for (double scale : { 0.05, 0.1, 0.2, 0.4, 0.8, 1.6 }) {
+				auto pCandidateGP = std::make_unique<CGaussianProcess>(scale * sqrt(static_cast<double>(nParams)));
+				if (!pCandidateGP->fit(vvX, vY)) continue;
+				if (!pGP || pCandidateGP->getLogLikelihood() > pGP->getLogLikelihood()) pGP = std::move(pCandidateGP);
+			}
+			DGM_ASSERT_MSG(pGP, "The surrogate model could not be fitted");
+
+			const vec_float_t &xBest = m_vvX[std::max_element(m_vY.begin(), m_vY.end()) - m_vY.begin()];
+			std::vector<vec_float_t> vvCandidates(NUMBER_CANDIDATES, vec_float_t(nParams));
+			vec_float_t vEI(NUMBER_CANDIDATES);
+			for (size_t q = 0; q < MIN(m_batchSize, nLeft); q++) {
+				const double best = *std::max_element(vY.begin(), vY.end());
+
+				// Half of the candidates are uniform, another half are the local perturbations of the best point
+				for (size_t c = 0; c < NUMBER_CANDIDATES; c++)
+					for (size_t p = 0; p < nParams; p++)
+						vvCandidates[c][p] = c % 2 ? random::U<float>() : MIN(1.0f, MAX(0.0f, xBest[p] + random::N<float>(0, 0.05f)));
+
+				parallel::parallelFor(Range(0, static_cast<int>(NUMBER_CANDIDATES)), [&](const Range &range) {
+					double mu, sigma;
+					for (int c = range.start; c < range.end; c++) {
+						pGP->predict(vvCandidates[c], mu, sigma);
+						vEI[c] = static_cast<float>(expectedImprovement(mu, sigma, best));
+					}
+				});
+				const size_t c = std::max_element(vEI.begin(), vEI.end()) - vEI.begin();
+				if (vEI[c] < 1e-6f) {
+					if (q == 0) m_converged = m_vvPending.empty();
+					break;
+				}
+
+				// Kriging believer: the selected point is added to the surrogate with its predicted value
+				double mu, sigma;
+				pGP->predict(vvCandidates[c], mu, sigma);
+				vvRes.push_back(vvCandidates[c]);
+				vvX.push_back(vvCandidates[c]);
+				vY.push_back(mu);
+				if (!pGP->fit(vvX, vY)) break;
+			}
+		}
+
+		// Map the points from the unit hypercube into the search domain
+		for (vec_float_t &x : vvRes)
+			for (size_t p = 0; p < nParams; p++)
+				x[p] = m_vLower[p] + x[p] * (m_vUpper[p] - m_vLower[p]);
+		return vvRes;
+	}
+}
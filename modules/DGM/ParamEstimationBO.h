@@ -0,0 +1,98 @@
+// Bayesian optimization parameter estimation class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "ParamEstimation.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Bayesian Optimization Class ===============================
+	/**
+	* @ingroup moduleParamEst
+	* @brief The Bayesian optimization search method class
+	* @details This method is intended for the expensive objective functions, \a e.g. for the training and the inference over a validation set.
+	* It keeps all the evaluated points and fits them with a Gaussian process surrogate (squared exponential kernel, whose length scale is chosen by maximizing
+	* the marginal likelihood). The next points are those maximizing the expected improvement of the surrogate; a batch of points is selected with the
+	* \a kriging \a believer strategy, \a i.e. every selected point is added to the surrogate with its predicted value before selecting the next one.
+	* The search starts with the initial parameters and a few random points, and typically needs tens of evaluations instead of hundreds.
+	*
+	* The search domain is given by setMinParams() and setMaxParams(). Along the parameters without boundaries, the domain spans \f$\pm 10\f$ deltas
+	* (ref. setDeltas()) around the initial parameters. The method may be used in the same loop as @ref CParamEstimationPowell (ref. [example code](#powell_example_code)),
+	* or with the batch interface, which evaluates the points concurrently:
+	* @code
+	* CParamEstimationBO bo(nParams);
+	* bo.setMinParams(vMinParams);
+	* bo.setMaxParams(vMaxParams);
+	* vec_float_t vParams = bo.optimize(graph, objectiveFunction);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CParamEstimationBO : public CParamEstimation
+	{
+	public:
+		/**
+		 * @brief Constructor
+		 * @param nParams Number of parameters (arguments) of the objective function
+		 */
+		DllExport CParamEstimationBO(size_t nParams);
+		DllExport virtual ~CParamEstimationBO(void) = default;
+
+		DllExport virtual void			reset(void) override;
+		DllExport virtual vec_float_t	getParams(float val) override;
+		/**
+		 * @brief Indicates weather the method has converged
+		 * @details The method converges, when the number of evaluations reaches the maximum (ref. setMaxEvaluations()), or when the expected improvement
+		 * of all the candidate points becomes negligible
+		 * @retval true if the method has converged
+		 * @retval false otherwise
+		 */
+		DllExport virtual bool			isConverged(void) const override;
+		/**
+		 * @brief Gets the points, maximizing the expected improvement
+		 * @details The first batch contains the initial parameters and the random points of the initial design
+		 * @return The arrays with the parameters to be evaluated. The array is empty, if the method has converged
+		 */
+		DllExport virtual std::vector<vec_float_t>	getBatch(void) override;
+		/**
+		 * @brief Sets the values of the objective function for the last batch
+		 * @param vValues The values of the objective function: one per array, returned by getBatch()
+		 */
+		DllExport virtual void			setBatchValues(const vec_float_t &vValues) override;
+
+		/**
+		 * @brief Sets the maximal number of evaluations of the objective function
+		 * > Default value is \b 50
+		 * @param maxEvaluations The maximal number of evaluations
+		 */
+		DllExport void					setMaxEvaluations(size_t maxEvaluations);
+		/**
+		 * @brief Sets the number of points in one batch
+		 * @details Larger batches allow for more concurrent evaluations, at the cost of less informed points
+		 * > Default value is \b 4
+		 * @param batchSize The number of points in one batch
+		 */
+		DllExport void					setBatchSize(size_t batchSize);
+
+
+	private:
+		void						initDomain(void);
+		void						addObservation(const vec_float_t &vParams, float val);
+		std::vector<vec_float_t>	propose(void);
+
+
+	private:
+		static const size_t			NUMBER_CANDIDATES;	// number of the random candidates for maximizing the expected improvement
+
+		size_t						m_maxEvaluations;	// maximal number of evaluations
+		size_t						m_batchSize;		// number of points in one batch
+		size_t						m_nInitial;			// number of points in the initial design
+		bool						m_converged;		// flag indicating that the expected improvement became negligible
+		float						m_valBest;			// the best value of the objective function
+
+		vec_float_t					m_vLower;			// lower boundaries of the search domain
+		vec_float_t					m_vUpper;			// upper boundaries of the search domain
+		std::vector<vec_float_t>	m_vvX;				// evaluated points, normalized to the unit hypercube
+		vec_float_t					m_vY;				// values of the objective function at the evaluated points
+		std::vector<vec_float_t>	m_vvPending;		// points, waiting for their values
+	};
+}
@@ -0,0 +1,82 @@
+#include "ParamEstimationDense.h"
+#include "GraphDense.h"
+#include "InferDense.h"
+#include "EdgeModelPotts.h"
+#include "macroses.h"
+#include <map>
+#include <set>
+
+namespace DirectGraphicalModels
+{
+	float CParamEstimationDense::train(const std::vector<CGraphDense *> &vpGraphs, const std::vector<vec_byte_t> &vvGroundTruth, unsigned int nEpochs) const
+	{
+		DGM_ASSERT_MSG(vpGraphs.size() == vvGroundTruth.size(), "The number of graphs (%zu) does not match the number of ground-truth vectors (%zu)", vpGraphs.size(), vvGroundTruth.size());
+		if (vpGraphs.empty()) return 0;
+
+		const size_t nGraphs = vpGraphs.size();
+		const size_t nModels = vpGraphs[0]->getEdgeModels().size();
+		const byte	 nStates = vpGraphs[0]->getNumStates();
+		for (const CGraphDense *pGraph : vpGraphs) {
+			DGM_ASSERT_MSG(pGraph->getEdgeModels().size() == nModels, "All the graphs must have the same number of edge models");
+			for (const ptr_edgeModel_t &pModel : pGraph->getEdgeModels())
+				DGM_ASSERT_MSG(dynamic_cast<const CEdgeModelPotts *>(pModel.get()), "Only the CEdgeModelPotts edge models may be trained");
+		}
+
+		// Copy-on-write: the models, referenced outside the training graphs (e.g. by the cache of the Gaussian models or by other graphs), are replaced
+		// with their copies, which are trained instead; the models, shared by the training graphs, stay shared by them
+		std::map<const IEdgeModel *, long> mRefs;
+		for (const CGraphDense *pGraph : vpGraphs)
+			for (const ptr_edgeModel_t &pModel : pGraph->getEdgeModels()) mRefs[pModel.get()]++;
+		std::map<const IEdgeModel *, ptr_edgeModel_t> mCopies;
+		for (CGraphDense *pGraph : vpGraphs)
+			for (ptr_edgeModel_t &pModel : pGraph->getEdgeModels()) {
+				if (pModel.use_count() <= mRefs[pModel.get()]) continue;
+				ptr_edgeModel_t &pCopy = mCopies[pModel.get()];
+				if (!pCopy) pCopy = dynamic_cast<const CEdgeModelPotts *>(pModel.get())->clone();
+				pModel = pCopy;
+			}
+		mCopies.clear();
+
+		// The inference changes the node potentials
+		vec_mat_t vPotentials(nGraphs);
+		for (size_t g = 0; g < nGraphs; g++) vPotentials[g] = vpGraphs[g]->getNodePotentials().clone();
+
+		float			loss = 0;
+		vec_float_t		vWeightGrad, vWeightGradSum;
+		vec_mat_t		vCompatibilityGrad, vCompatibilityGradSum;
+		for (unsigned int epoch = 0; epoch < nEpochs; epoch++) {
+			vWeightGradSum.assign(nModels, 0.0f);
+			vCompatibilityGradSum.assign(nModels, Mat());
+			double lossSum = 0;
+			for (size_t g = 0; g < nGraphs; g++) {
+				vPotentials[g].copyTo(vpGraphs[g]->getNodePotentials());
+				CInferDense inferer(*vpGraphs[g]);
+				lossSum += inferer.computeGradient(vvGroundTruth[g], m_nIt, vWeightGrad, vCompatibilityGrad);
+				for (size_t m = 0; m < nModels; m++) {
+					vWeightGradSum[m] += vWeightGrad[m];
+					if (vCompatibilityGradSum[m].empty()) vCompatibilityGradSum[m] = vCompatibilityGrad[m].clone();
+					else vCompatibilityGradSum[m] += vCompatibilityGrad[m];
+				}
+			} // g
+			loss = static_cast<float>(lossSum / nGraphs);
+
+			// Gradient step: the graphs may share the model instances
+			const float step = m_learningRate / nGraphs;
+			std::set<const IEdgeModel *> sUpdated;
+			for (size_t m = 0; m < nModels; m++)
+				for (const CGraphDense *pGraph : vpGraphs) {
+					CEdgeModelPotts *pModel = dynamic_cast<CEdgeModelPotts *>(pGraph->getEdgeModels()[m].get());
+					if (!sUpdated.insert(pModel).second) continue;
+					pModel->setWeight(pModel->getWeight() - step * vWeightGradSum[m]);
+					if (m_learnCompatibility) {
+						Mat compatibility = pModel->getCompatibility();
+						if (compatibility.empty()) compatibility = Mat::eye(nStates, nStates, CV_32FC1);
+						pModel->setCompatibility(compatibility - step * vCompatibilityGradSum[m]);
+					}
+				} // pGraph
+		} // epoch
+
+		for (size_t g = 0; g < nGraphs; g++) vPotentials[g].copyTo(vpGraphs[g]->getNodePotentials());
+		return loss;
+	}
+}
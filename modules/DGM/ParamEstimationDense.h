@@ -0,0 +1,64 @@
+// Gradient-based training of the dense CRF edge model parameters class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	class CGraphDense;
+
+	// ================================ CParamEstimationDense Class ===============================
+	/**
+	* @ingroup moduleParamEst
+	* @brief Gradient-based training of the dense CRF edge models
+	* @details This class learns the weights and the label compatibility matrices of the @ref CEdgeModelPotts edge models of the dense graphs
+	* by the gradient descent. The gradients of the loss \f$-\frac{1}{nNodes}\sum_i\log Q(y_i)\f$ are averaged over the training graphs in every epoch
+	* (ref. CInferDense::computeGradient()). The models with the same index in all the training graphs are considered to be the same model, 
+	* \a i.e. the graphs must have the same set of the edge models:
+	* @code
+	* using namespace DirectGraphicalModels;
+	*
+	* std::vector<CGraphDense *> vpGraphs;		// the graphs with the node potentials and the edge models
+	* std::vector<vec_byte_t> vvGroundTruth;	// the ground-truth labels of the graph nodes
+	*
+	* CParamEstimationDense trainer(0.5f);
+	* float loss = trainer.train(vpGraphs, vvGroundTruth, 20);
+	* @endcode
+	* > The models, which are referenced outside the training graphs, \a e.g. the Gaussian edge models, cached by CGraphDenseExt::addGaussianEdgeModel() and
+	* shared by all the graphs of the same size, are not modified: the training graphs get the trained copies of these models (ref. CEdgeModelPotts::clone()).
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CParamEstimationDense
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param learningRate The step of the gradient descent
+		* @param nIt The number of the mean-field iterations
+		* @param learnCompatibility Flag indicating whether the label compatibility matrices should be learned in addition to the weights
+		*/
+		DllExport CParamEstimationDense(float learningRate = 0.1f, unsigned int nIt = 5, bool learnCompatibility = true)
+			: m_learningRate(learningRate)
+			, m_nIt(nIt)
+			, m_learnCompatibility(learnCompatibility)
+		{}
+		DllExport ~CParamEstimationDense(void) = default;
+
+		/**
+		* @brief Trains the parameters of the edge models
+		* @details The node potentials of the graphs are preserved
+		* @param vpGraphs The training graphs
+		* @param vvGroundTruth The ground-truth states of the nodes for every graph
+		* @param nEpochs The number of the gradient descent steps
+		* @return The mean loss of the last epoch
+		*/
+		DllExport float	train(const std::vector<CGraphDense *> &vpGraphs, const std::vector<vec_byte_t> &vvGroundTruth, unsigned int nEpochs = 10) const;
+
+
+	private:
+		float			m_learningRate;			///< The step of the gradient descent
+		unsigned int	m_nIt;					///< The number of the mean-field iterations
+		bool			m_learnCompatibility;	///< Flag indicating whether the label compatibility matrices are learned
+	};
+}
@@ -0,0 +1,247 @@
+#include "ParamEstimationPL.h"
+#include "IGraphPairwise.h"
+#include "parallel.h"
+#include "macroses.h"
+#include <deque>
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		using objective_t = std::function<double(const std::vector<double> &x, std::vector<double> &grad)>;
+
+		double dot(const std::vector<double> &a, const std::vector<double> &b)
+		{
+			double res = 0;
+			for (size_t i = 0; i < a.size(); i++) res += a[i] * b[i];
+			return res;
+		}
+
+		// Minimizes the objective with L-BFGS (the history of m steps) and the backtracking line search
+		std::vector<double> lbfgs(const objective_t &objective, std::vector<double> x, unsigned int nIt, size_t m = 8)
+		{
+			const size_t n = x.size();
+			std::vector<double> grad(n), xNew(n), gradNew(n), dir(n), alpha;
+			std::deque<std::vector<double>> vS, vY;
+			std::deque<double> vRho;
+
+			double f = objective(x, grad);
+			for (unsigned int it = 0; it < nIt; it++) {
+				// Two-loop recursion: dir = -H grad
+				dir = grad;
+				alpha.assign(vS.size(), 0);
+				for (size_t k = vS.size(); k-- > 0;) {
+					alpha[k] = vRho[k] * dot(vS[k], dir);
+					for (size_t i = 0; i < n; i++) dir[i] -= alpha[k] * vY[k][i];
+				}
+				const double gamma = vS.empty() ? 1.0 / MAX(1.0, sqrt(dot(grad, grad))) : dot(vS.back(), vY.back()) / dot(vY.back(), vY.back());
+				for (double &d : dir) d *= gamma;
+				for (size_t k = 0; k < vS.size(); k++) {
+					const double beta = vRho[k] * dot(vY[k], dir);
+					for (size_t i = 0; i < n; i++) dir[i] += (alpha[k] - beta) * vS[k][i];
+				}
+				for (double &d : dir) d = -d;
+
+				double slope = dot(grad, dir);
+				if (slope >= 0) {														// not a descent direction: restart with the steepest descent
+					vS.clear(); vY.clear(); vRho.clear();
+					for (size_t i = 0; i < n; i++) dir[i] = -grad[i] / MAX(1.0, sqrt(dot(grad, grad)));
+					slope = dot(grad, dir);
+				}
+
+				// Armijo backtracking
+				double step = 1.0, fNew = f;
+				bool found = false;
+				for (int ls = 0; ls < 40 && !found; ls++, step *= 0.5) {
+					for (size_t i = 0; i < n; i++) xNew[i] = x[i] + step * dir[i];
+					fNew	= objective(xNew, gradNew);
+					found	= fNew <= f + 1e-4 * step * slope;
+				}
+				if (!found) break;
+
+				std::vector<double> s(n), y(n);
+				for (size_t i = 0; i < n; i++) {
+					s[i] = xNew[i] - x[i];
+					y[i] = gradNew[i] - grad[i];
+				}
+				const double sy = dot(s, y);
+				if (sy > 1e-12) {
+					vS.push_back(std::move(s));
+					vY.push_back(std::move(y));
+					vRho.push_back(1.0 / sy);
+					if (vS.size() > m) { vS.pop_front(); vY.pop_front(); vRho.pop_front(); }
+				}
+
+				const bool converged = f - fNew <= 1e-9 * MAX(1.0, fabs(f));
+				x.swap(xNew);
+				grad.swap(gradNew);
+				f = fNew;
+				if (converged || sqrt(dot(grad, grad)) < 1e-6) break;
+			}
+			return x;
+		}
+	}
+
+	// The features of every node are precomputed: A(s) = log phi(s), and per edge group B_g(s) = sum log psi(s, y_j), D_g(s) = sum [s = y_j]
+	float CParamEstimationPL::train(const std::vector<IGraphPairwise *> &vpGraphs, const std::vector<vec_byte_t> &vvGroundTruth)
+	{
+		DGM_ASSERT_MSG(vpGraphs.size() == vvGroundTruth.size(), "The number of graphs (%zu) does not match the number of ground-truth vectors (%zu)", vpGraphs.size(), vvGroundTruth.size());
+		if (vpGraphs.empty()) return 0;
+
+		const byte nStates = vpGraphs[0]->getNumStates();
+		vec_size_t vGraphOffset(1, 0);
+		size_t nGroups = 1;
+		for (size_t g = 0; g < vpGraphs.size(); g++) {
+			const IGraphPairwise &graph = *vpGraphs[g];
+			DGM_ASSERT_MSG(graph.getNumStates() == nStates, "All the graphs must have the same number of states");
+			DGM_ASSERT_MSG(vvGroundTruth[g].size() == graph.getNumNodes(), "The number of labels (%zu) does not match the number of nodes (%zu)", vvGroundTruth[g].size(), graph.getNumNodes());
+			vGraphOffset.push_back(vGraphOffset.back() + graph.getNumNodes());
+			vec_size_t vChilds;
+			for (size_t n = 0; n < graph.getNumNodes(); n++) {
+				graph.getChildNodes(n, vChilds);
+				for (size_t c : vChilds) nGroups = MAX(nGroups, static_cast<size_t>(graph.getEdgeGroup(n, c)) + 1);
+			}
+		}
+		const size_t nNodes		= vGraphOffset.back();
+		const size_t nParams	= 1 + 2 * nGroups;
+		vec_float_t	vA(nNodes * nStates);
+		vec_float_t	vB(nNodes * nGroups * nStates, 0.0f);
+		vec_float_t	vD(nNodes * nGroups * nStates, 0.0f);
+		vec_byte_t	vLabels(nNodes);
+
+		for (size_t g = 0; g < vpGraphs.size(); g++) {
+			const IGraphPairwise &graph = *vpGraphs[g];
+			const vec_byte_t	 &gt	= vvGroundTruth[g];
+			parallel::parallelFor(Range(0, static_cast<int>(graph.getNumNodes())), [&](const Range &range) {
+				vec_size_t	vNeighbours;
+				Mat			pot;
+				// Adds the edge between the node n (state s) and the neighbour j (state gt[j]) to the features of the node
+				auto addEdge = [&](size_t k, size_t src, size_t dst, bool isSrc) {
+					const size_t j		= isSrc ? dst : src;
+					const byte	 group	= graph.getEdgeGroup(src, dst);
+					float		*pB		= &vB[(k * nGroups + group) * nStates];
+					float		*pD		= &vD[(k * nGroups + group) * nStates];
+					span<const float> view = graph.getEdgeView(src, dst);
+					if (view.size() == 0) {
+						graph.getEdge(src, dst, pot);
+						if (!pot.empty()) view = span<const float>(pot.ptr<float>(), pot.total());
+					}
+					for (byte s = 0; s < nStates; s++) {
+						if (view.size()) pB[s] += logf(MAX(FLT_MIN, isSrc ? view[s * nStates + gt[j]] : view[gt[j] * nStates + s]));
+						if (s == gt[j]) pD[s] += 1.0f;
+					}
+				};
+				for (int n = range.start; n < range.end; n++) {
+					const size_t k = vGraphOffset[g] + n;
+					vLabels[k] = gt[n];
+					span<const float> node = graph.getNodeView(n);
+					for (byte s = 0; s < nStates; s++) vA[k * nStates + s] = logf(MAX(FLT_MIN, node[s]));
+					graph.getChildNodes(n, vNeighbours);
+					for (size_t c : vNeighbours) addEdge(k, n, c, true);
+					graph.getParentNodes(n, vNeighbours);
+					for (size_t p : vNeighbours) addEdge(k, p, n, false);
+				} // n
+			});
+		}
+
+		// The objective and its gradient are accumulated per block of nodes and reduced in the fixed order, thus the result does not depend on the threads
+		const int	blockSize	= 4096;
+		const int	nBlocks		= static_cast<int>((nNodes + blockSize - 1) / blockSize);
+		std::vector<std::vector<double>> vvPartial(nBlocks, std::vector<double>(nParams + 1));
+		const std::vector<double> x0 = [&] {
+			std::vector<double> res(nParams, 0.0);
+			for (size_t p = 0; p <= nGroups; p++) res[p] = 1.0;						// w_n = w_g = 1, theta_g = 0
+			return res;
+		}();
+		auto objective = [&](const std::vector<double> &x, std::vector<double> &grad) {
+			parallel::parallelFor(Range(0, nBlocks), [&](const Range &range) {
+				vec_float_t vE(nStates), vP(nStates);
+				for (int b = range.start; b < range.end; b++) {
+					std::vector<double> &partial = vvPartial[b];
+					std::fill(partial.begin(), partial.end(), 0.0);
+					const size_t end = MIN(nNodes, static_cast<size_t>(b + 1) * blockSize);
+					for (size_t k = static_cast<size_t>(b) * blockSize; k < end; k++) {
+						const float *pA = &vA[k * nStates];
+						const float *pB = &vB[k * nGroups * nStates];
+						const float *pD = &vD[k * nGroups * nStates];
+						float maxE = -FLT_MAX;
+						for (byte s = 0; s < nStates; s++) {
+							double e = x[0] * pA[s];
+							for (size_t grp = 0; grp < nGroups; grp++) e += x[1 + grp] * pB[grp * nStates + s] + x[1 + nGroups + grp] * pD[grp * nStates + s];
+							vE[s] = static_cast<float>(e);
+							maxE = MAX(maxE, vE[s]);
+						}
+						double Z = 0;
+						for (byte s = 0; s < nStates; s++) Z += vP[s] = expf(vE[s] - maxE);
+						for (byte s = 0; s < nStates; s++) vP[s] = static_cast<float>(vP[s] / Z);
+
+						// -log P(y) = log Z - E(y); its gradient is E_P[f] - f(y)
+						const byte y = vLabels[k];
+						partial[nParams] += maxE + log(Z) - vE[y];
+						for (byte s = 0; s < nStates; s++) {
+							const double coef = vP[s] - (s == y ? 1.0 : 0.0);
+							if (coef == 0) continue;
+							partial[0] += coef * pA[s];
+							for (size_t grp = 0; grp < nGroups; grp++) {
+								partial[1 + grp]			+= coef * pB[grp * nStates + s];
+								partial[1 + nGroups + grp]	+= coef * pD[grp * nStates + s];
+							}
+						}
+					} // k
+				} // b
+			});
+
+			double f = 0;
+			grad.assign(nParams, 0.0);
+			for (const std::vector<double> &partial : vvPartial) {
+				f += partial[nParams];
+				for (size_t p = 0; p < nParams; p++) grad[p] += partial[p];
+			}
+			f /= nNodes;
+			for (size_t p = 0; p < nParams; p++) {
+				grad[p]	= grad[p] / nNodes + m_regularization * (x[p] - x0[p]);
+				f		+= 0.5 * m_regularization * (x[p] - x0[p]) * (x[p] - x0[p]);
+			}
+			return f;
+		};
+
+		const std::vector<double> x = lbfgs(objective, x0, m_nIt);
+		m_nodeWeight = static_cast<float>(x[0]);
+		m_vEdgeWeights.resize(nGroups);
+		m_vPottsParams.resize(nGroups);
+		for (size_t grp = 0; grp < nGroups; grp++) {
+			m_vEdgeWeights[grp] = static_cast<float>(x[1 + grp]);
+			m_vPottsParams[grp] = static_cast<float>(x[1 + nGroups + grp]);
+		}
+
+		std::vector<double> grad;
+		return static_cast<float>(objective(x, grad));
+	}
+
+	void CParamEstimationPL::apply(IGraphPairwise &graph) const
+	{
+		const byte	nStates = graph.getNumStates();
+		Mat			pot;
+		vec_size_t	vChilds;
+		for (size_t n = 0; n < graph.getNumNodes(); n++) {
+			graph.getNode(n, pot);
+			for (byte s = 0; s < nStates; s++) pot.at<float>(s, 0) = powf(MAX(FLT_MIN, pot.at<float>(s, 0)), m_nodeWeight);
+			graph.setNode(n, pot);
+		}
+		for (size_t n = 0; n < graph.getNumNodes(); n++) {
+			graph.getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				const byte	group	= graph.getEdgeGroup(n, c);
+				const float	weight	= getEdgeWeight(group);
+				const float	potts	= expf(getPottsParam(group));
+				graph.getEdge(n, c, pot);
+				if (pot.empty()) pot = Mat(nStates, nStates, CV_32FC1, Scalar(1.0f));
+				for (byte s = 0; s < nStates; s++)
+					for (byte t = 0; t < nStates; t++) {
+						float &val = pot.at<float>(s, t);
+						val = powf(MAX(FLT_MIN, val), weight) * (s == t ? potts : 1.0f);
+					}
+				graph.setEdge(n, c, pot);
+			}
+		}
+	}
+}
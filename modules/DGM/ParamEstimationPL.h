@@ -0,0 +1,89 @@
+// Pseudo-likelihood training of the CRF parameters class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	class IGraphPairwise;
+
+	// ================================ CParamEstimationPL Class ===============================
+	/**
+	* @ingroup moduleParamEst
+	* @brief Pseudo-likelihood training of the CRF parameters
+	* @details This class learns the weights of the node and edge potentials and the Potts parameters of the pairwise graphs jointly, instead of the black-box
+	* search of @ref CParamEstimation. The graphs are filled with the potentials of the independently trained node and edge models; the learned CRF
+	* has the potentials
+	* \f[ \phi'_i(s) = \phi_i(s)^{w_n},\qquad \psi'_{ij}(s, t) = \psi_{ij}(s, t)^{w_g}\,e^{\theta_g[s = t]}, \f]
+	* where \a g is the group of the edge (ref. IGraphPairwise::setEdgeGroup()). The parameters minimize the negative log-pseudo-likelihood of the ground truth
+	* \f[ L = -\frac{1}{nNodes}\sum_i\log P(y_i\,|\,y_{N(i)}) + \frac{\lambda}{2}\left((w_n - 1)^2 + \sum_g (w_g - 1)^2 + \theta_g^2\right), \f]
+	* where every node is conditioned on the ground-truth states of its neighbours. Thus, the objective and its gradient are the sums over the nodes,
+	* which are accumulated in parallel over the blocks of nodes of all the training graphs, and the minimization is done with L-BFGS:
+	* @code
+	* std::vector<IGraphPairwise *> vpGraphs;		// the graphs with the node and edge potentials
+	* std::vector<vec_byte_t> vvGroundTruth;		// the ground-truth labels of the graph nodes
+	*
+	* CParamEstimationPL trainer;
+	* float loss = trainer.train(vpGraphs, vvGroundTruth);
+	* for (IGraphPairwise *pGraph : vpTestGraphs) trainer.apply(*pGraph);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CParamEstimationPL
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param regularization The weight \f$\lambda\f$ of the L2 regularization
+		* @param nIt The maximal number of the L-BFGS iterations
+		*/
+		DllExport CParamEstimationPL(float regularization = 1e-3f, unsigned int nIt = 100)
+			: m_regularization(regularization)
+			, m_nIt(nIt)
+			, m_nodeWeight(1.0f)
+		{}
+		DllExport ~CParamEstimationPL(void) = default;
+
+		/**
+		* @brief Trains the parameters
+		* @details The graphs are not changed. The parameters are learned for the edge groups, which occur in the training graphs
+		* > This function supports PPL
+		* @param vpGraphs The training graphs
+		* @param vvGroundTruth The ground-truth states of the nodes for every graph
+		* @return The mean negative log-pseudo-likelihood per node after the training
+		*/
+		DllExport float	train(const std::vector<IGraphPairwise *> &vpGraphs, const std::vector<vec_byte_t> &vvGroundTruth);
+		/**
+		* @brief Applies the learned parameters to a graph
+		* @details The node and edge potentials of the graph, filled the same way as the training graphs, are replaced with the potentials of the learned CRF
+		* @param graph The graph
+		*/
+		DllExport void	apply(IGraphPairwise &graph) const;
+		/**
+		* @brief Returns the weight of the node potentials
+		* @return The weight \f$w_n\f$
+		*/
+		DllExport float	getNodeWeight(void) const { return m_nodeWeight; }
+		/**
+		* @brief Returns the weight of the edge potentials of a group
+		* @param group The edge group
+		* @return The weight \f$w_g\f$, or 1 if the group did not occur in the training graphs
+		*/
+		DllExport float	getEdgeWeight(byte group) const { return group < m_vEdgeWeights.size() ? m_vEdgeWeights[group] : 1.0f; }
+		/**
+		* @brief Returns the Potts parameter of a group
+		* @param group The edge group
+		* @return The Potts parameter \f$\theta_g\f$, or 0 if the group did not occur in the training graphs
+		*/
+		DllExport float	getPottsParam(byte group) const { return group < m_vPottsParams.size() ? m_vPottsParams[group] : 0.0f; }
+
+
+	private:
+		float			m_regularization;		///< The weight of the L2 regularization
+		unsigned int	m_nIt;					///< The maximal number of the L-BFGS iterations
+		float			m_nodeWeight;			///< The weight of the node potentials
+		vec_float_t		m_vEdgeWeights;			///< The weights of the edge potentials per edge group
+		vec_float_t		m_vPottsParams;			///< The Potts parameters per edge group
+	};
+}
@@ -5,6 +5,7 @@
 
 #include "ParamEstimationPSO.h"
 #include "random.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels {
     CParamEstimationPSO::CParamEstimationPSO(size_t nParams)
@@ -55,28 +56,70 @@ namespace DirectGraphicalModels {
             } else if (!boid.valCurrent.second)
                 boid.valCurrent = std::make_pair(val, true);
 
-            if (boid.valCurrent.first > boid.valBest) {
-                boid.vArgBest = boid.vArgCurrent;
-                boid.valBest = boid.valCurrent.first;
-            } else if (fabs(boid.valCurrent.first - boid.valBest) < FLT_EPSILON) {
-                float p = random::U<float>();
-                if (p < 0.5) {
-                    boid.vArgBest = boid.vArgCurrent;
-                    boid.valBest = boid.valCurrent.first;
-                }
+            updateBest(boid);
+        } // Boids
+
+        move();
+        return m_vParams;
+    }
+
+    std::vector<vec_float_t> CParamEstimationPSO::getBatch(void) {
+        std::vector<vec_float_t> res;
+        res.reserve(m_vBoids.size() + 1);
+        for (const Boid &boid : m_vBoids)
+            res.push_back(boid.vArgCurrent);
+        if (m_globalValBest == UNINITIALIZED) res.push_back(m_vParams);    // the initial parameters
+        return res;
+    }
+
+    void CParamEstimationPSO::setBatchValues(const vec_float_t &vValues) {
+        const bool isFirst = m_globalValBest == UNINITIALIZED;
+        DGM_ASSERT_MSG(vValues.size() == m_vBoids.size() + (isFirst ? 1 : 0), 
+            "The number of values (%zu) does not correspond to the size of the batch (%zu)", 
+            vValues.size(), m_vBoids.size() + (isFirst ? 1 : 0));
+
+        // On the first generation we get the value for the initial parameters
+        if (isFirst) {
+            m_globalValBest = vValues.back();
+            for (Boid &boid : m_vBoids) {
+                boid.vArgBest = m_vParams;
+                boid.valBest = m_globalValBest;
             }
+        }
+
+        for (size_t b = 0; b < m_vBoids.size(); b++) {
+            m_vBoids[b].valCurrent = std::make_pair(vValues[b], true);
+            updateBest(m_vBoids[b]);
+        }
+
+        move();
+    }
 
-            if (boid.valBest > m_globalValBest) {
-                m_vParams = boid.vArgBest;
-                m_globalValBest = boid.valBest;
-                boid.hasConverged = false;
-            } else if (fabs(boid.valCurrent.first - m_globalValBest) < FLT_EPSILON) {
-                boid.hasConverged = true;
+    // ------------------------------ PRIVATE ------------------------------
+    // Updates the personal and the global bests with the value of the boid's current position
+    void CParamEstimationPSO::updateBest(Boid &boid) {
+        if (boid.valCurrent.first > boid.valBest) {
+            boid.vArgBest = boid.vArgCurrent;
+            boid.valBest = boid.valCurrent.first;
+        } else if (fabs(boid.valCurrent.first - boid.valBest) < FLT_EPSILON) {
+            float p = random::U<float>();
+            if (p < 0.5) {
+                boid.vArgBest = boid.vArgCurrent;
+                boid.valBest = boid.valCurrent.first;
             }
-        } // Boids
+        }
 
+        if (boid.valBest > m_globalValBest) {
+            m_vParams = boid.vArgBest;
+            m_globalValBest = boid.valBest;
+            boid.hasConverged = false;
+        } else if (fabs(boid.valCurrent.first - m_globalValBest) < FLT_EPSILON) {
+            boid.hasConverged = true;
+        }
+    }
 
-        // Update vVelocity and vParams of every boid
+    // Updates vVelocity and vParams of every boid
+    void CParamEstimationPSO::move(void) {
         for (Boid& boid : m_vBoids) {
             for (auto d = 0; d < m_vParams.size(); d++) {
                 // initialize random variables 
@@ -87,8 +130,6 @@ namespace DirectGraphicalModels {
             }
             boid.valCurrent = std::make_pair(UNINITIALIZED, true);
         }
-
-        return m_vParams;
     }
 
     bool CParamEstimationPSO::isConverged(void) const {
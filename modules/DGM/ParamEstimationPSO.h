@@ -26,6 +26,8 @@ namespace DirectGraphicalModels {
 	* vec_float_t vParams = pso.getParams(objectiveFunction);
 
 	* @endcode
+	* Since the boids of one generation are independent, the whole generation may be evaluated at once with the batch interface (ref. getBatch() and setBatchValues()),
+	* \a e.g. concurrently with CParamEstimation::optimize().
 	* @author Alexandru Hambasan, a.hambasan@jacobs-university.de
 	*/
 
@@ -59,6 +61,9 @@ namespace DirectGraphicalModels {
 
 		const float         UNINITIALIZED = -INFINITY;
 
+		void	updateBest(Boid &boid);
+		void	move(void);
+
 	public:
 		/**
 		 * @brief Constructor
@@ -70,6 +75,17 @@ namespace DirectGraphicalModels {
 		DllExport virtual void			reset(void) override;
 		DllExport virtual vec_float_t	getParams(float val) override;                     
 		DllExport virtual bool			isConverged(void) const override; 
+		/**
+		 * @brief Gets the current positions of all the boids
+		 * @details The first batch contains additionally the initial parameters (arguments) as its last array (ref. setInitParams())
+		 * @return The arrays with the parameters of the current generation
+		 */
+		DllExport virtual std::vector<vec_float_t>	getBatch(void) override;
+		/**
+		 * @brief Sets the values of the objective function for the current generation and moves the boids
+		 * @param vValues The values of the objective function: one per array, returned by getBatch()
+		 */
+		DllExport virtual void			setBatchValues(const vec_float_t &vValues) override;
 
 	};
 }
@@ -23,6 +23,7 @@ namespace DirectGraphicalModels {
         std::fill(m_vMax.begin(), m_vMax.end(), FLT_MAX);
         std::fill(m_vConverged.begin(), m_vConverged.end(), false);
         std::fill(m_vKappa.begin(), m_vKappa.end(), -1.0f);
+        m_vProbes.clear();
     }
 
     vec_float_t CParamEstimationPowell::getParams(float kappa) {
@@ -67,53 +68,110 @@ namespace DirectGraphicalModels {
             }
 
             // =============== All 3 kappas are ready ===============
-            float maxKappa = *std::max_element(m_vKappa.begin(), m_vKappa.end());
+            advance();
+            if (isConverged()) return m_vParams;                    // we have converged
+        } // infinite loop
+    }
 
-            if (maxKappa == m_vKappa[oD]) {            // >>>>> Middle value -> Proceed to the next argument
-                convArg = true;
-                curArg = m_midPoint;
+    std::vector<vec_float_t> CParamEstimationPowell::getBatch(void) {
+        if (m_vProbes.empty()) prepareProbes();
+
+        std::vector<vec_float_t> res;
+        res.reserve(m_vProbes.size());
+        for (byte k : m_vProbes) {
+            vec_float_t vParams = m_vParams;
+            switch (k) {
+                case mD: vParams[m_paramID] = MAX(minArg, m_midPoint - m_koeff * delta); break;
+                case oD: vParams[m_paramID] = m_midPoint; break;
+                case pD: vParams[m_paramID] = MIN(maxArg, m_midPoint + m_koeff * delta); break;
+            }
+            res.push_back(vParams);
+        }
+        return res;
+    }
 
-                if (isConverged()) return m_vParams;                // we have converged
+    void CParamEstimationPowell::setBatchValues(const vec_float_t& vValues) {
+        DGM_ASSERT_MSG(vValues.size() == m_vProbes.size(),
+            "The number of values (%zu) does not correspond to the size of the batch (%zu)",
+            vValues.size(), m_vProbes.size());
 
-                m_paramID = (m_paramID + 1) % m_vParams.size();     // new argument
+        for (size_t i = 0; i < vValues.size(); i++) {
+            DGM_ASSERT_MSG(vValues[i] > 0.0f, "Negative kappa values are not allowed");
+            m_vKappa[m_vProbes[i]] = vValues[i];
+        }
+        m_vProbes.clear();
+        prepareProbes();                                            // steps forward, so that isConverged() is up to date
+    }
 
-                // reset variabels for new argument
-                m_vKappa[mD] = -1;
-                m_vKappa[pD] = -1;
-                m_nSteps = 0;
-                m_koeff = 1.0;
+    // ------------------------------ PRIVATE ------------------------------
+    // Moves the middle point or proceeds to the next argument, when all 3 kappas are ready
+    void CParamEstimationPowell::advance(void) {
+        float maxKappa = *std::max_element(m_vKappa.begin(), m_vKappa.end());
 
-                m_midPoint = curArg;                            // refresh the middle point
-            }
-            else if (maxKappa == m_vKappa[mD]) {    // >>>>> Lower value -> Step argument down
-                std::fill(m_vConverged.begin(), m_vConverged.end(), false);        // reset convergence
+        if (maxKappa == m_vKappa[oD]) {            // >>>>> Middle value -> Proceed to the next argument
+            convArg = true;
+            curArg = m_midPoint;
 
-                m_midPoint = MAX(minArg, m_midPoint - m_koeff * delta);            // refresh the middle point
+            if (isConverged()) return;                          // we have converged
 
-                // shift kappa
-                m_vKappa[pD] = m_vKappa[oD];
-                m_vKappa[oD] = m_vKappa[mD];
-                m_vKappa[mD] = -1.0f;
+            m_paramID = (m_paramID + 1) % m_vParams.size();     // new argument
 
-                // increase the search step
-                m_nSteps++;
-                m_koeff += m_acceleration * m_nSteps;
-            }
-            else if (maxKappa == m_vKappa[pD]) {    // >>>>> Upper value -> Step argument up
-                std::fill(m_vConverged.begin(), m_vConverged.end(), false);        // reset convergence
+            // reset variabels for new argument
+            m_vKappa[mD] = -1;
+            m_vKappa[pD] = -1;
+            m_nSteps = 0;
+            m_koeff = 1.0;
+
+            m_midPoint = curArg;                            // refresh the middle point
+        }
+        else if (maxKappa == m_vKappa[mD]) {    // >>>>> Lower value -> Step argument down
+            std::fill(m_vConverged.begin(), m_vConverged.end(), false);        // reset convergence
+
+            m_midPoint = MAX(minArg, m_midPoint - m_koeff * delta);            // refresh the middle point
+
+            // shift kappa
+            m_vKappa[pD] = m_vKappa[oD];
+            m_vKappa[oD] = m_vKappa[mD];
+            m_vKappa[mD] = -1.0f;
 
-                m_midPoint = MIN(maxArg, m_midPoint + m_koeff * delta);            // refresh the middle point
+            // increase the search step
+            m_nSteps++;
+            m_koeff += m_acceleration * m_nSteps;
+        }
+        else if (maxKappa == m_vKappa[pD]) {    // >>>>> Upper value -> Step argument up
+            std::fill(m_vConverged.begin(), m_vConverged.end(), false);        // reset convergence
+
+            m_midPoint = MIN(maxArg, m_midPoint + m_koeff * delta);            // refresh the middle point
 
-                // shift kappa
-                m_vKappa[mD] = m_vKappa[oD];
-                m_vKappa[oD] = m_vKappa[pD];
-                m_vKappa[pD] = -1.0f;
+            // shift kappa
+            m_vKappa[mD] = m_vKappa[oD];
+            m_vKappa[oD] = m_vKappa[pD];
+            m_vKappa[pD] = -1.0f;
 
-                // increase the search step
-                m_nSteps++;
-                m_koeff += m_acceleration * m_nSteps;
+            // increase the search step
+            m_nSteps++;
+            m_koeff += m_acceleration * m_nSteps;
+        }
+    }
+
+    // Collects the missing kappas of the current argument into m_vProbes; the argument itself stays in the middle point
+    void CParamEstimationPowell::prepareProbes(void) {
+        while (!isConverged()) {
+            if (m_vKappa[oD] < 0) {
+                m_midPoint = curArg;
+                m_vProbes.push_back(oD);
             }
-        } // infinite loop
+            if (m_vKappa[mD] < 0) {
+                if (m_midPoint == minArg) m_vKappa[mD] = 0.0f;
+                else m_vProbes.push_back(mD);
+            }
+            if (m_vKappa[pD] < 0) {
+                if (m_midPoint == maxArg) m_vKappa[pD] = 0.0f;
+                else m_vProbes.push_back(pD);
+            }
+            if (!m_vProbes.empty()) return;
+            advance();
+        }
     }
 
     bool CParamEstimationPowell::isConverged(void) const
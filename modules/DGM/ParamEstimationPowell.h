@@ -32,6 +32,8 @@ namespace DirectGraphicalModels
 	* 	vParams = powell.getParams(val);
 	* } 
 	* @endcode
+	* The three probes of the current argument (\f$-\delta\f$, \f$0\f$ and \f$+\delta\f$) may be evaluated concurrently with the batch interface
+	* (ref. getBatch(), setBatchValues() and CParamEstimation::optimize()). The batch interface and getParams() should not be mixed in one search.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/	
 	class CParamEstimationPowell : public CParamEstimation
@@ -62,6 +64,18 @@ namespace DirectGraphicalModels
 		 * @param acceleration The acceleration coefficient
 		 */
 		DllExport void					setAcceleration(float acceleration);
+		/**
+		 * @brief Gets all the pending probes of the current argument
+		 * @details The batch contains up to three arrays, which differ only in the current argument: the middle point and the points, shifted by \f$\pm\delta\f$.
+		 * The probes, whose values are already known from the previous steps, are not repeated
+		 * @return The arrays with the parameters to be evaluated. The array is empty, if the method has converged
+		 */
+		DllExport virtual std::vector<vec_float_t>	getBatch(void) override;
+		/**
+		 * @brief Sets the values of the objective function for the pending probes
+		 * @param vValues The values of the objective function: one per array, returned by getBatch()
+		 */
+		DllExport virtual void			setBatchValues(const vec_float_t &vValues) override;
 
 
 	private:
@@ -73,6 +87,7 @@ namespace DirectGraphicalModels
 		
 		vec_float_t	m_vKappa;		// method's auxilary array
 		vec_bool_t	m_vConverged;	// array of flags, indicating converged variables
+		std::vector<byte> m_vProbes;	// coordinates of the Kappa function, pending in the batch
 
 		// Simplified accessors for current argument
 		#define curArg m_vParams[m_paramID]
@@ -82,6 +97,11 @@ namespace DirectGraphicalModels
 		#define convArg m_vConverged[m_paramID]
 
 
+	private:
+		void	advance(void);
+		void	prepareProbes(void);
+
+
 	private:		
 		/// coordinates of the Kappa function
 		enum {
@@ -0,0 +1,182 @@
+// Pipelined multi-tile execution class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace DirectGraphicalModels
+{
+	// ================================ Pipeline Class ================================
+	/**
+	* @brief Pipelined execution of the tiles
+	* @details The processing of a tile consists of the stages, \a e.g. the feature extraction, the node potentials, the graph filling, the inference and the visualization.
+	* Executed one after another for every tile, the stages are separated by the barriers, and the serial parts of the stages leave the cores idle. This class
+	* executes every stage in its own thread, and the tiles flow from stage to stage through the queues: the tile \a N may be decoded, while the tile \a N+1
+	* is classified and the tile \a N+2 is in the feature extraction. The stages may use the parallel loops of the library, which share the default thread pool.
+	*
+	* The tiles are processed in the objects of type \b Tile, which are taken from a pool of \a nBuffers objects and returned to it after the last stage. Thus,
+	* at most \a nBuffers tiles are in flight, and the containers of a \b Tile object, \a e.g. the feature images and the graph, are re-used by the later tiles:
+	* @code
+	* struct Tile {
+	*	Mat				img, fv, pots;
+	*	CGraphPairwise	graph{ 6 };
+	* };
+	* CPipeline<Tile> pipeline(3);
+	* pipeline.addStage("fex",		[&](Tile &tile, size_t t) { tile.img = loadTile(t); tile.fv = fex::CCommonFeatureExtractor(tile.img).get(); });
+	* pipeline.addStage("classify",	[&](Tile &tile, size_t)	  { tile.pots = nodeTrainer.getNodePotentials(tile.fv); });
+	* pipeline.addStage("decode",	[&](Tile &tile, size_t t) { fillGraph(tile.graph, tile.pots); saveTile(t, CInferTRW(tile.graph).decode(10)); });
+	* pipeline.run(nTiles);
+	* @endcode
+	* Every stage processes the tiles in the ascending order of their indices, and the stages of one tile are executed one after another.
+	* @tparam Tile The buffers of one tile. It must be default-constructible
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	template <typename Tile>
+	class CPipeline
+	{
+	public:
+		/**
+		* @brief Stage function
+		* @details Processes the tile with the given index. The stage functions are called concurrently for different tiles, and one stage function is called
+		* for one tile at a time
+		*/
+		using stage_function_t = std::function<void(Tile &tile, size_t index)>;
+
+		/**
+		* @brief Constructor
+		* @param nBuffers The number of the tile buffers, \a i.e. the maximal number of tiles in flight. The value equal to the number of stages lets all the stages work at once
+		*/
+		explicit CPipeline(size_t nBuffers = 3) : m_vBuffers(MAX(1, nBuffers)) {}
+		~CPipeline(void) = default;
+		CPipeline(const CPipeline &) = delete;
+		const CPipeline& operator= (const CPipeline &) = delete;
+
+		/**
+		* @brief Adds a stage
+		* @param name The name of the stage: a string literal
+		* @param stage The stage function
+		*/
+		void	addStage(const char *name, stage_function_t stage) { m_vStages.push_back({ name, std::move(stage), 0.0f }); }
+		/**
+		* @brief Processes the tiles
+		* @details The function returns when all the stages are finished for all the tiles. If a stage throws an exception, the remaining stages of all the tiles
+		* are skipped, and the first exception is re-thrown here.
+		* @param nTiles The number of tiles
+		*/
+		void	run(size_t nTiles)
+		{
+			const size_t nStages = m_vStages.size();
+			if (nStages == 0 || nTiles == 0) return;
+
+			// The queue 0 holds the free buffers, the queue s > 0 holds the tiles, waiting for the stage s
+			std::vector<Queue> vQueues(nStages);
+			for (Tile &tile : m_vBuffers) vQueues[0].items.push_back({ &tile, 0 });
+			std::exception_ptr	exception;
+			std::mutex			mtx;
+			std::atomic<bool>	failed(false);
+			for (Stage &stage : m_vStages) stage.time = 0.0f;
+
+			// The stage 0 marks the last tile it has produced, so that the following stages know, when to stop
+			std::vector<std::thread> vThreads;
+			vThreads.reserve(nStages);
+			vThreads.emplace_back([&] {
+				for (size_t t = 0; t < nTiles; t++) {
+					Item item = vQueues[0].pop();
+					item.index	= t;
+					item.last	= t + 1 == nTiles;
+					if (!failed) execute(m_vStages[0], item, exception, mtx, failed);
+					if (failed) item.last = true;
+					vQueues[1 % nStages].push(item);
+					if (item.last) break;
+				}
+			});
+			for (size_t s = 1; s < nStages; s++)
+				vThreads.emplace_back([&, s] {
+					for (bool last = false; !last;) {
+						Item item = vQueues[s].pop();
+						if (!failed) execute(m_vStages[s], item, exception, mtx, failed);
+						last = item.last;
+						vQueues[(s + 1) % nStages].push(item);
+					}
+				});
+			for (std::thread &thread : vThreads) thread.join();
+			if (exception) std::rethrow_exception(exception);
+		}
+		/**
+		* @brief Returns the busy times of the stages
+		* @return The names of the stages and the sums of their execution times over all the tiles of the last call of run() in milliseconds
+		*/
+		std::vector<std::pair<const char *, float>> getStageTimes(void) const
+		{
+			std::vector<std::pair<const char *, float>> res;
+			for (const Stage &stage : m_vStages) res.emplace_back(stage.name, stage.time);
+			return res;
+		}
+
+
+	private:
+		/// Stage
+		struct Stage {
+			const char		  *	name;		///< The name of the stage
+			stage_function_t	fn;			///< The stage function
+			float				time;		///< The busy time of the stage in milliseconds
+		};
+		/// Tile in flight
+		struct Item {
+			Tile  *	pTile	= NULL;			///< The buffer of the tile
+			size_t	index	= 0;			///< The index of the tile
+			bool	last	= false;		///< Flag indicating whether this is the last tile
+		};
+		/// Blocking queue of the tiles
+		struct Queue {
+			std::deque<Item>		items;	///< The tiles
+			std::mutex				mtx;	///< The mutex, protecting the tiles
+			std::condition_variable	cv;		///< The condition for the waiting stage
+
+			void push(const Item &item)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					items.push_back(item);
+				}
+				cv.notify_one();
+			}
+			Item pop(void)
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait(lock, [this] { return !items.empty(); });
+				Item res = items.front();
+				items.pop_front();
+				return res;
+			}
+		};
+
+		// Executes the stage for the tile and records the first exception
+		static void execute(Stage &stage, Item &item, std::exception_ptr &exception, std::mutex &mtx, std::atomic<bool> &failed)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			try {
+				stage.fn(*item.pTile, item.index);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(mtx);
+				if (!exception) exception = std::current_exception();
+				failed = true;
+			}
+			stage.time += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+
+	private:
+		std::vector<Tile>	m_vBuffers;		///< The pool of the tile buffers
+		std::vector<Stage>	m_vStages;		///< The stages
+	};
+}
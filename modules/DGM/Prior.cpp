@@ -1,4 +1,7 @@
 #include "Prior.h"
+#include "parallel.h"
+#include "macroses.h"
+#include <mutex>
 
 namespace DirectGraphicalModels
 {
@@ -21,16 +24,53 @@ namespace DirectGraphicalModels
 		m_histogramPrior.setTo(0);
 	}
 
+	void CPrior::merge(const CPrior &prior)
+	{
+		DGM_ASSERT(prior.m_type == m_type);
+		DGM_ASSERT(prior.m_nStates == m_nStates);
+		m_histogramPrior += prior.m_histogramPrior;
+	}
+
 	Mat CPrior::getPrior(float weight) const
 	{
-		if (sum(m_histogramPrior)[0] < 1)									// if addXXXGroundTruth() was not called
-			return Mat(m_nStates, m_nStates, CV_32FC1, Scalar(1.0f));		// return uniform distribution	
+		if (sum(m_histogramPrior)[0] < 1) {									// if addXXXGroundTruth() was not called
+			if (m_type != RM_TRIPLET) return Mat(m_nStates, m_nStates, CV_32FC1, Scalar(1.0f));		// return uniform distribution	
+			const int size[] = { m_nStates, m_nStates, m_nStates };
+			Mat res(3, size, CV_32FC1);
+			res.setTo(1.0f);
+			return res;
+		}
 		
 		Mat res = calculatePrior();
 		if (weight != 1.0f)  res.convertTo(res, res.type(), weight);
 		return res;
 	}
 
+	// Every chunk of at least 64K samples is counted into its own integer histogram; the histograms are added up at once
+	void CPrior::addCounts(Size size, const std::function<void(const Range &rows, int *pHistogram)> &counter)
+	{
+		DGM_ASSERT(m_histogramPrior.isContinuous());
+		const size_t	nBins		= m_histogramPrior.total();
+		const int		grainSize	= MAX(1, 65536 / MAX(1, size.width));
+		std::mutex		mtx;
+
+		parallel::parallelFor(Range(0, size.height), [&](const Range &range) {
+			vec_int_t vHistogram(nBins, 0);
+			counter(range, vHistogram.data());
+			std::lock_guard<std::mutex> lock(mtx);
+			int *pHistogram = m_histogramPrior.ptr<int>();
+			for (size_t i = 0; i < nBins; i++) pHistogram[i] += vHistogram[i];
+		}, grainSize);
+	}
+
+	void CPrior::checkGroundTruth(const Mat &gt) const
+	{
+		DGM_ASSERT_MSG(gt.type() == CV_8UC1, "The ground-truth image has either wrong depth or more than one channel");
+		double maxVal = 0;
+		if (!gt.empty()) minMaxLoc(gt, NULL, &maxVal);
+		DGM_ASSERT_MSG(maxVal < m_nStates, "The groundtruth value %d is out of range %d", static_cast<int>(maxVal), m_nStates);
+	}
+
 	void CPrior::saveFile(FILE *pFile) const 
 	{
 		switch(m_type) {
@@ -33,6 +33,12 @@ namespace DirectGraphicalModels
 		* @returns 1D (nStates) for node, 2D (nStates x nStates) for edge or 3D (nStates x nStates x nStates) for triplet Mat of type CV_32FC1 with prior probabilies.
 		*/
 		DllExport Mat			getPrior(float weight = 1.0f) const;
+		/**
+		* @brief Merges the class co-occurance histogram of another prior into this one
+		* @details Used to combine the histograms, which were built independently, \a e.g. in parallel
+		* @param prior The prior of the same type and with the same number of states (classes)
+		*/
+		DllExport void			merge(const CPrior &prior);
 
 	
 	protected:
@@ -45,6 +51,20 @@ namespace DirectGraphicalModels
 		* @returns 1D (nStates) for node, 2D (nStates x nStates) for edge or 3D (nStates x nStates x nStates) for triplet Mat of type CV_32FC1 with prior probabilies.		
 		*/
 		DllExport virtual Mat	calculatePrior(void) const = 0;
+		/**
+		* @brief Adds the counts of a parallel pass over the rows of the ground-truth images to the co-occurance histogram
+		* @details Every chunk of rows is counted into its own integer histogram, which is added to the co-occurance histogram under a lock
+		* > This function supports PPL.
+		* @param size The size of the ground-truth images
+		* @param counter The function, which increments the bins of the given continuous histogram for all the samples of the given range of rows. 
+		* The bins are layed out as in the co-occurance histogram. It is called concurrently.
+		*/
+		DllExport void			addCounts(Size size, const std::function<void(const Range &rows, int *pHistogram)> &counter);
+		/**
+		* @brief Checks that all the values of the ground-truth image are valid states (classes)
+		* @param gt The ground-truth image: Mat(type: CV_8UC1)
+		*/
+		DllExport void			checkGroundTruth(const Mat &gt) const;
 
 
 	protected:
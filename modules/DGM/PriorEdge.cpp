@@ -10,6 +10,54 @@ void CPriorEdge::addEdgeGroundTruth(byte gt1, byte gt2)
 	m_histogramPrior.at<int>(gt2, gt1)++;	
 }
 
+void CPriorEdge::addEdgeGroundTruth(const Mat &counts)
+{
+	DGM_ASSERT(counts.size() == m_histogramPrior.size());
+	DGM_ASSERT(counts.type() == CV_32SC1);
+	m_histogramPrior += counts;
+}
+
+void CPriorEdge::addEdgeGroundTruth(const Mat &gt1, const Mat &gt2)
+{
+	DGM_ASSERT(gt1.size() == gt2.size());
+	checkGroundTruth(gt1);
+	checkGroundTruth(gt2);
+	const byte nStates = m_nStates;
+	addCounts(gt1.size(), [&, nStates](const Range &rows, int *pHistogram) {
+		for (int y = rows.start; y < rows.end; y++) {
+			const byte *pGt1 = gt1.ptr<byte>(y);
+			const byte *pGt2 = gt2.ptr<byte>(y);
+			for (int x = 0; x < gt1.cols; x++) pHistogram[pGt2[x] * nStates + pGt1[x]]++;
+		}
+	});
+}
+
+// Every row is counted with its edges to the row above
+void CPriorEdge::addGridGroundTruth(const Mat &gt, bool withDiagonals)
+{
+	checkGroundTruth(gt);
+	const byte nStates = m_nStates;
+	addCounts(gt.size(), [&, nStates, withDiagonals](const Range &rows, int *pHistogram) {
+		auto count = [pHistogram, nStates](const byte *pGt1, const byte *pGt2, int n) {
+			for (int x = 0; x < n; x++) {
+				pHistogram[pGt2[x] * nStates + pGt1[x]]++;
+				pHistogram[pGt1[x] * nStates + pGt2[x]]++;
+			}
+		};
+		for (int y = rows.start; y < rows.end; y++) {
+			const byte *pGt1 = gt.ptr<byte>(y);
+			count(pGt1 + 1, pGt1, gt.cols - 1);							// [x][y] - [x-1][y]
+			if (y == 0) continue;
+			const byte *pGt2 = gt.ptr<byte>(y - 1);
+			count(pGt1, pGt2, gt.cols);										// [x][y] - [x][y-1]
+			if (withDiagonals) {
+				count(pGt1 + 1, pGt2, gt.cols - 1);							// [x][y] - [x-1][y-1]
+				count(pGt1, pGt2 + 1, gt.cols - 1);							// [x][y] - [x+1][y-1]
+			}
+		}
+	});
+}
+
 Mat CPriorEdge::calculatePrior(void) const
 {
 	byte x;
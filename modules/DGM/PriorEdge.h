@@ -53,6 +53,28 @@ namespace DirectGraphicalModels
 		@param gt2 The ground-truth state (class) of the second node in edge. 
 		*/
 		DllExport void			addEdgeGroundTruth(byte gt1, byte gt2); 
+		/**
+		@brief Adds a block of counts to the co-occurance histogram matrix
+		@details This function is equivalent to calling addEdgeGroundTruth(gt1, gt2) \a counts.at<int>(gt2, gt1) times for every pair of states
+		@param counts The co-occurance counts: Mat(size: nStates x nStates; type: CV_32SC1)
+		*/
+		DllExport void			addEdgeGroundTruth(const Mat &counts);
+		/**
+		@brief Adds the pairs of ground-truth values to the co-occurance histogram matrix
+		@details This function is equivalent to calling addEdgeGroundTruth(gt1, gt2) for every pair of the corresponding elements of \b gt1 and \b gt2. 
+		The rows are counted in parallel (ref. addCounts()).
+		@param gt1 Matrix, each element of which is the ground-truth state (class) of the first node in edge: Mat(type: CV_8UC1)
+		@param gt2 Matrix, each element of which is the ground-truth state (class) of the second node in edge: Mat(size: gt1.size(); type: CV_8UC1)
+		*/
+		DllExport void			addEdgeGroundTruth(const Mat &gt1, const Mat &gt2);
+		/**
+		@brief Adds the ground-truth values of all the edges of a grid graph to the co-occurance histogram matrix
+		@details Every edge between two neighboring pixels is counted in both directions, as CGraphLayeredExt::addFeatureVecs() does for the nodes of one layer.
+		All the edges are counted in one parallel pass over the rows (ref. addCounts()).
+		@param gt Matrix, each element of which is a ground-truth state (class): Mat(type: CV_8UC1)
+		@param withDiagonals Flag indicating whether the diagonal edges are counted as well as the vertical and horizontal ones (ref. GRAPH_EDGES_DIAG)
+		*/
+		DllExport void			addGridGroundTruth(const Mat &gt, bool withDiagonals = false);
 
 		
 		
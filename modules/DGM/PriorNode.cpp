@@ -6,7 +6,13 @@ namespace DirectGraphicalModels
 
 void CPriorNode::addNodeGroundTruth(const Mat &gt)
 {
-	DGM_ELEMENTWISE1<CPriorNode, &CPriorNode::addNodeGroundTruth>(*this, gt);
+	checkGroundTruth(gt);
+	addCounts(gt.size(), [&gt](const Range &rows, int *pHistogram) {
+		for (int y = rows.start; y < rows.end; y++) {
+			const byte *pGt = gt.ptr<byte>(y);
+			for (int x = 0; x < gt.cols; x++) pHistogram[pGt[x]]++;
+		}
+	});
 }
 	
 void CPriorNode::addNodeGroundTruth(byte gt)
@@ -23,7 +23,8 @@ namespace DirectGraphicalModels
 
 		/**
 		* @brief Adds ground truth values to the co-occurance histogram vector
-		* @param gt Matrix, each element of which is a ground-truth state (class)
+		* @details The rows of the matrix are counted in parallel (ref. addCounts())
+		* @param gt Matrix, each element of which is a ground-truth state (class): Mat(type: CV_8UC1)
 		*/
 		DllExport void	addNodeGroundTruth(const Mat &gt);
 		/**
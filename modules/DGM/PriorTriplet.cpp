@@ -11,15 +11,29 @@ void CPriorTriplet::addTripletGroundTruth(byte gt1, byte gt2, byte gt3)
 	m_histogramPrior.at<int>(gt1, gt2, gt3)++;
 }
 
-///@todo Implement this function
-///@warning This function is not implemented (returns only uniform distribution "all ones")
-Mat CPriorTriplet::calculatePrior(void) const
+void CPriorTriplet::addTripletGroundTruth(const Mat &gt1, const Mat &gt2, const Mat &gt3)
 {
-	int size[] = {m_nStates, m_nStates, m_nStates};
-	Mat res(3, size, CV_32FC1);
-
-	res.setTo(1.0f);
+	DGM_ASSERT(gt1.size() == gt2.size());
+	DGM_ASSERT(gt1.size() == gt3.size());
+	checkGroundTruth(gt1);
+	checkGroundTruth(gt2);
+	checkGroundTruth(gt3);
+	const byte nStates = m_nStates;
+	addCounts(gt1.size(), [&, nStates](const Range &rows, int *pHistogram) {
+		for (int y = rows.start; y < rows.end; y++) {
+			const byte *pGt1 = gt1.ptr<byte>(y);
+			const byte *pGt2 = gt2.ptr<byte>(y);
+			const byte *pGt3 = gt3.ptr<byte>(y);
+			for (int x = 0; x < gt1.cols; x++) pHistogram[(pGt1[x] * nStates + pGt2[x]) * nStates + pGt3[x]]++;
+		}
+	});
+}
 
+Mat CPriorTriplet::calculatePrior(void) const
+{
+	Mat res;
+	double Sum = sum(m_histogramPrior)[0];
+	m_histogramPrior.convertTo(res, CV_32FC1, 1.0 / Sum);
 	return res;
 }
 
@@ -29,6 +29,15 @@ namespace DirectGraphicalModels
 		@param gt3 The ground-truth state (value) of the third node in triplet. 
 		*/
 		DllExport void	addTripletGroundTruth(byte gt1, byte gt2, byte gt3); 
+		/**
+		@brief Adds the triplets of ground-truth values to the co-occurance histogram matrix
+		@details This function is equivalent to calling addTripletGroundTruth(gt1, gt2, gt3) for every triplet of the corresponding elements of \b gt1, \b gt2 and \b gt3.
+		The rows are counted in parallel (ref. addCounts()).
+		@param gt1 Matrix, each element of which is the ground-truth state (class) of the first node in triplet: Mat(type: CV_8UC1)
+		@param gt2 Matrix, each element of which is the ground-truth state (class) of the second node in triplet: Mat(size: gt1.size(); type: CV_8UC1)
+		@param gt3 Matrix, each element of which is the ground-truth state (class) of the third node in triplet: Mat(size: gt1.size(); type: CV_8UC1)
+		*/
+		DllExport void	addTripletGroundTruth(const Mat &gt1, const Mat &gt2, const Mat &gt3);
 
 
 	protected:
@@ -1,35 +1,105 @@
 #include "SamplesAccumulator.h"
 #include "random.h"
+#include "footprint.h"
 #include "macroses.h"
+#include <numeric>
 
 namespace DirectGraphicalModels
 {
+	const int CSamplesAccumulator::INITIAL_CAPACITY = 1024;
+
+	namespace {
+		// Returns a random number with the beta distribution B(a, b), drawn from the generator of the thread like all the other random numbers of the accumulator
+		double beta(double a, double b)
+		{
+			random::CPhilox &generator = random::getGenerator();
+			const double x = std::gamma_distribution<double>(a)(generator);
+			const double y = std::gamma_distribution<double>(b)(generator);
+			return x / (x + y);
+		}
+	}
+
 	void CSamplesAccumulator::reset(void)
 	{
 		for (Mat &acc : m_vSamplesAcc) acc.release();
+		std::fill(m_vNumSamples.begin(), m_vNumSamples.end(), 0);
 		std::fill(m_vNumInputSamples.begin(), m_vNumInputSamples.end(), 0);
 	}
 
 	void CSamplesAccumulator::addSample(const Mat &featureVector, byte state)
+	{
+		const Mat sample = featureVector.isContinuous() ? featureVector : featureVector.clone();
+		addSample(sample.data, static_cast<int>(sample.total() * sample.channels()), sample.depth(), state);
+	}
+
+	void CSamplesAccumulator::addSamples(const Mat &featureVectors, const Mat &gt)
 	{
 		// Assertions:
-		DGM_ASSERT_MSG(state < m_vSamplesAcc.size(), "The groundtruth value %d is out of range %zu", state, m_vSamplesAcc.size());
+		DGM_ASSERT(featureVectors.size() == gt.size());
+		DGM_ASSERT(gt.type() == CV_8UC1);
 
-		if (m_vSamplesAcc[state].rows < m_maxSamples) {
-			m_vSamplesAcc[state].push_back(featureVector.t());
-		}
-		else {
-			int k = random::u(0, m_vNumInputSamples[state]);
-			if (k < m_maxSamples)
-				m_vSamplesAcc[state].row(k) = featureVector.t();
-		}
-		m_vNumInputSamples[state]++;
+		const int		nFeatures	= featureVectors.channels();
+		const int		depth		= featureVectors.depth();
+		const size_t	sampleSize	= featureVectors.elemSize();
+		for (int y = 0; y < gt.rows; y++) {
+			const byte *pFv = featureVectors.ptr<byte>(y);
+			const byte *pGt = gt.ptr<byte>(y);
+			for (int x = 0; x < gt.cols; x++)
+				addSample(pFv + x * sampleSize, nFeatures, depth, pGt[x]);
+		} // y
+	}
+
+	void CSamplesAccumulator::merge(const CSamplesAccumulator &rhs)
+	{
+		// Assertions:
+		DGM_ASSERT_MSG(rhs.m_vSamplesAcc.size() == m_vSamplesAcc.size(), "The number of states in the accumulators differ: %zu and %zu", m_vSamplesAcc.size(), rhs.m_vSamplesAcc.size());
+		DGM_ASSERT(rhs.m_maxSamples == m_maxSamples);
+
+		for (byte s = 0; s < static_cast<byte>(m_vSamplesAcc.size()); s++) {
+			const Mat	&rhsAcc		= rhs.m_vSamplesAcc[s];
+			const int	 nSamples	= m_vNumSamples[s];
+			const int	 nRhsSamples = rhs.m_vNumSamples[s];
+			if (nRhsSamples == 0) continue;
+			if (nSamples + nRhsSamples <= m_maxSamples) {				// both accumulators store all their input samples
+				reserve(s, nSamples + nRhsSamples, rhsAcc.cols, rhsAcc.depth());
+				rhsAcc.rowRange(0, nRhsSamples).copyTo(m_vSamplesAcc[s].rowRange(nSamples, nSamples + nRhsSamples));
+				m_vNumSamples[s] += nRhsSamples;
+			}
+			else {
+				DGM_ASSERT_MSG(nSamples == 0 || (m_vSamplesAcc[s].cols == rhsAcc.cols && m_vSamplesAcc[s].type() == rhsAcc.type()), "The samples in the accumulators differ");
+				// The number of samples, taken from each reservoir, follows the hypergeometric distribution
+				int nInput		= m_vNumInputSamples[s];
+				int nRhsInput	= rhs.m_vNumInputSamples[s];
+				int nTaken		= 0;
+				for (int i = 0; i < m_maxSamples; i++)
+					if (random::u(0, nInput + nRhsInput - 1) < nInput) { nInput--; nTaken++; }
+					else nRhsInput--;
+
+				// A random subset of a reservoir is a uniform sample of its input samples
+				Mat res(m_maxSamples, rhsAcc.cols, rhsAcc.type());
+				int row = 0;
+				auto take = [&res, &row](const Mat &reservoir, int nStored, int n) {
+					vec_int_t vIdx(nStored);
+					std::iota(vIdx.begin(), vIdx.end(), 0);
+					for (int i = 0; i < n; i++) {
+						std::swap(vIdx[i], vIdx[random::u(i, nStored - 1)]);
+						reservoir.row(vIdx[i]).copyTo(res.row(row++));
+					}
+				};
+				take(m_vSamplesAcc[s], nSamples, nTaken);
+				take(rhsAcc, nRhsSamples, m_maxSamples - nTaken);
+				m_vSamplesAcc[s] = res;
+				m_vNumSamples[s] = m_maxSamples;
+			}
+			m_vNumInputSamples[s] += rhs.m_vNumInputSamples[s];
+			if (m_vNumSamples[s] == m_maxSamples) skip(s, true);		// the weight of the algorithm L does not survive the merge
+		} // s
 	}
 
 	int	CSamplesAccumulator::getNumSamples(byte state) const
 	{
-		DGM_ASSERT_MSG(state < m_vSamplesAcc.size(), "The groundtruth value %d is out of range %zu", state, m_vSamplesAcc.size());
-		return m_vSamplesAcc[state].rows;
+		DGM_ASSERT_MSG(state < m_vNumSamples.size(), "The groundtruth value %d is out of range %zu", state, m_vNumSamples.size());
+		return m_vNumSamples[state];
 	}
 
 	int CSamplesAccumulator::getNumInputSamples(byte state) const
@@ -40,8 +110,62 @@ namespace DirectGraphicalModels
 
 	void CSamplesAccumulator::release(byte state)
 	{
+		m_vNumSamples[state] = 0;
 		m_vNumInputSamples[state] = 0;
 		m_vSamplesAcc[state].release();
 	}
 
-}
\ No newline at end of file
+	size_t CSamplesAccumulator::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + footprint::getBytes(m_vSamplesAcc) + footprint::getBytes(m_vNumSamples) + footprint::getBytes(m_vNumInputSamples)
+			+ footprint::getBytes(m_vSkipWeight) + footprint::getBytes(m_vNextSample);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CSamplesAccumulator::addSample(const byte *pSample, int nFeatures, int depth, byte state)
+	{
+		// Assertions:
+		DGM_ASSERT_MSG(state < m_vSamplesAcc.size(), "The groundtruth value %d is out of range %zu", state, m_vSamplesAcc.size());
+
+		int &nSamples = m_vNumSamples[state];
+		if (nSamples < m_maxSamples) {
+			reserve(state, nSamples + 1, nFeatures, depth);
+			Mat &acc = m_vSamplesAcc[state];
+			memcpy(acc.ptr(nSamples++), pSample, acc.cols * acc.elemSize());
+			m_vNumInputSamples[state]++;
+			if (nSamples == m_maxSamples) skip(state, true);
+		}
+		else if (m_vNumInputSamples[state] == m_vNextSample[state]) {
+			Mat &acc = m_vSamplesAcc[state];
+			DGM_ASSERT(acc.cols == nFeatures && acc.depth() == depth);
+			memcpy(acc.ptr(random::u(0, m_maxSamples - 1)), pSample, acc.cols * acc.elemSize());
+			m_vNumInputSamples[state]++;
+			skip(state, false);
+		}
+		else m_vNumInputSamples[state]++;
+	}
+
+	void CSamplesAccumulator::reserve(byte state, int nSamples, int nFeatures, int depth)
+	{
+		Mat &acc = m_vSamplesAcc[state];
+		DGM_ASSERT_MSG(acc.empty() || (acc.cols == nFeatures && acc.depth() == depth), "The sample (%d features of depth %d) does not correspond to the stored ones (%d features of depth %d)", nFeatures, depth, acc.cols, acc.depth());
+		if (acc.rows >= nSamples) return;
+
+		const long long capacity = MIN(static_cast<long long>(m_maxSamples), MAX(static_cast<long long>(INITIAL_CAPACITY), 2LL * acc.rows));
+		Mat res(MAX(nSamples, static_cast<int>(capacity)), nFeatures, CV_MAKETYPE(depth, 1));
+		if (m_vNumSamples[state]) acc.rowRange(0, m_vNumSamples[state]).copyTo(res.rowRange(0, m_vNumSamples[state]));
+		acc = res;
+	}
+
+	// The skip of the algorithm L follows the geometric distribution with the parameter W, the largest of the k smallest random keys of the input samples
+	void CSamplesAccumulator::skip(byte state, bool resetWeight)
+	{
+		const long long nInput	= m_vNumInputSamples[state];
+		double			&W		= m_vSkipWeight[state];
+		if (resetWeight) W = beta(m_maxSamples, static_cast<double>(nInput - m_maxSamples + 1));	// the k-th smallest of nInput uniform keys
+		else			 W *= exp(log(1.0 - random::U<double>()) / m_maxSamples);
+
+		const double nSkip = floor(log(1.0 - random::U<double>()) / log(1.0 - W));
+		m_vNextSample[state] = nInput + static_cast<long long>(MIN(nSkip, 1e18));
+	}
+}
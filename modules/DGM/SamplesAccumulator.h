@@ -24,7 +24,10 @@ namespace DirectGraphicalModels
 		*/
 		CSamplesAccumulator(byte nStates, size_t maxSamples)
 			: m_vSamplesAcc(vec_mat_t(nStates))
+			, m_vNumSamples(vec_int_t(nStates, 0))
 			, m_vNumInputSamples(vec_int_t(nStates, 0))
+			, m_vSkipWeight(std::vector<double>(nStates, 0))
+			, m_vNextSample(std::vector<long long>(nStates, 0))
 			, m_maxSamples(maxSamples ? static_cast<int>(maxSamples) : std::numeric_limits<int>::max())
 		{ }
 		CSamplesAccumulator(const CSamplesAccumulator&) = delete;
@@ -35,25 +38,39 @@ namespace DirectGraphicalModels
 		/**
 		* @brief Resets the accumulator
 		*/
-		void	reset(void);
+		DllExport void	reset(void);
 		/**
 		* @brief Adds new sample to the accumulator
 		* @param featureVector Multi-dimensinal point: Mat(size: nFeatures x 1)
 		* @param state State (class) corresponding to the \b featureVector
 		*/
-		void	addSample(const Mat &featureVector, byte state);
+		DllExport void	addSample(const Mat &featureVector, byte state);
+		/**
+		* @brief Adds a block of samples to the accumulator
+		* @details The feature vectors are copied directly from the block into the containers, without creating a temporary matrix for every sample.
+		* @param featureVectors Multi-dimensinal points: Mat(size: height x width; type: CV_{XX}C{nFeatures})
+		* @param gt Matrix, each element of which is the state (class) corresponding to the feature vector of the same pixel: Mat(size: height x width; type: CV_8UC1)
+		*/
+		DllExport void	addSamples(const Mat &featureVectors, const Mat &gt);
+		/**
+		* @brief Merges the samples of another accumulator into this one
+		* @details If the accumulators store all their input samples, the containers are concatenated. Otherwise the reservoirs are merged in such a way,
+		* that the result is a uniform random subset of the union of the input samples of both accumulators, as if all the samples were added to this one.
+		* @param rhs The accumulator with the same number of states and the same \b maxSamples parameter
+		*/
+		DllExport void	merge(const CSamplesAccumulator &rhs);
 		/**
 		* @brief Returns samples container for the state (class) \b state
 		* @param state The state (class)
 		* @return The container: Mat(size: nSamples x nFeatures)
 		*/
-		Mat		getSamplesContainer(byte state) const { return m_vSamplesAcc[state]; }
+		Mat		getSamplesContainer(byte state) const { return m_vNumSamples[state] ? m_vSamplesAcc[state].rowRange(0, m_vNumSamples[state]) : Mat(); }
 		/**
 		* @brief Returns the number of stored samples in container for the state (class) \b state
 		* @param state The state (class)
 		* @return The number of samples
 		*/
-		int		getNumSamples(byte state) const;
+		DllExport int		getNumSamples(byte state) const;
 		/**
 		* @brief Returns the number of input samples in container for the state (class) \b state
 		* @details This function retunts the number of samples added with the addSample() function.
@@ -63,17 +80,62 @@ namespace DirectGraphicalModels
 		* @param state The state (class)
 		* @return The number of samples
 		*/
-		int		getNumInputSamples(byte state) const;
+		DllExport int		getNumInputSamples(byte state) const;
+		/**
+		* @brief Returns the maximum number of samples to be stored for every state (class)
+		* @return The \b maxSamples parameter of the constructor
+		*/
+		size_t	getMaxSamples(void) const { return m_maxSamples == std::numeric_limits<int>::max() ? 0 : static_cast<size_t>(m_maxSamples); }
 		/**
 		* @brief Releases memory of container for the state (class) \b state
 		* @param state The state (class)
 		*/
-		void	release(byte state);
+		DllExport void	release(byte state);
+		/**
+		* @brief Returns the memory, used by the accumulator
+		* @return The size of the accumulator and of the sample containers in bytes
+		*/
+		DllExport size_t	getMemoryUsage(void) const;
+
+
+	private:
+		static const int INITIAL_CAPACITY;				///< The number of samples, for which the container of a state is allocated at first
+
+		/**
+		* @brief Adds new sample to the container of the state (class) \b state
+		* @details Until the container is full, the sample is appended to it. Afterwards, the container is a reservoir, updated with the Vitter's
+		* <a href="https://en.wikipedia.org/wiki/Reservoir_sampling#Optimal:_Algorithm_L">algorithm L</a>: the number of input samples to be skipped
+		* is drawn at once, so that only the replacing samples need random numbers.
+		* @param pSample Pointer to the sample, stored contiguously
+		* @param nFeatures The number of features in the sample
+		* @param depth The depth of the features, \a e.g. CV_8U
+		* @param state State (class) corresponding to the sample
+		*/
+		void	addSample(const byte *pSample, int nFeatures, int depth, byte state);
+		/**
+		* @brief Ensures that the container of the state (class) \b state is able to store \b nSamples samples
+		* @details The capacity of the container grows geometrically up to the \b maxSamples parameter of the constructor
+		* @param state The state (class)
+		* @param nSamples The number of samples
+		* @param nFeatures The number of features in a sample
+		* @param depth The depth of the features
+		*/
+		void	reserve(byte state, int nSamples, int nFeatures, int depth);
+		/**
+		* @brief Draws the index of the next input sample, which replaces a sample in the full container of the state (class) \b state
+		* @param state The state (class)
+		* @param resetWeight Flag indicating whether the weight of the algorithm L should be drawn anew: this is needed when the container becomes full
+		* or when the container was merged and the weight was lost
+		*/
+		void	skip(byte state, bool resetWeight);
 
 
 	private:
-		vec_mat_t	m_vSamplesAcc;						// = vec_mat_t(nStates);	// Samples container for all states
-		vec_int_t	m_vNumInputSamples;					// = vec_int_t(nStates, 0);	// Amount of input samples for all states		
-		int			m_maxSamples;						// = INFINITY;				// for optimisation purposes
+		vec_mat_t				m_vSamplesAcc;			// = vec_mat_t(nStates);	// Samples container for all states, preallocated with a capacity
+		vec_int_t				m_vNumSamples;			// = vec_int_t(nStates, 0);	// Amount of samples, stored in the containers
+		vec_int_t				m_vNumInputSamples;		// = vec_int_t(nStates, 0);	// Amount of input samples for all states
+		std::vector<double>		m_vSkipWeight;			// The weights W of the algorithm L for all states
+		std::vector<long long>	m_vNextSample;			// The indexes of the next input samples, which replace the stored ones, for all states
+		int						m_maxSamples;			// = INFINITY;				// for optimisation purposes
 	};
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "StereoCost.h"
+#include "Arena.h"
+#include "parallel.h"
+#include "simd.h"
+#include "macroses.h"
+#include <bitset>
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Copies the row of the right image, so that the candidates of pixel x are dst[x .. x + nDisparities): dst[k] = src[k + offset], clamped to the row
+		template <typename T>
+		void padRow(const T *src, int width, int offset, int length, T *dst)
+		{
+			for (int k = 0; k < length; k++) dst[k] = src[MIN(MAX(k + offset, 0), width - 1)];
+		}
+
+		// Census transform: bit i is set if the i-th pixel of the window (the center excluded) is darker than the center
+		std::vector<uint64_t> census(const Mat &img, int windowSize)
+		{
+			const int r = windowSize / 2;
+			std::vector<uint64_t> res(img.total());
+			parallel::parallelFor(Range(0, img.rows), [&](const Range &range) {
+				for (int y = range.start; y < range.end; y++) {
+					const byte *pImg = img.ptr<byte>(y);
+					for (int x = 0; x < img.cols; x++) {
+						uint64_t code = 0;
+						for (int dy = -r; dy <= r; dy++) {
+							const byte *pRow = img.ptr<byte>(MIN(MAX(y + dy, 0), img.rows - 1));
+							for (int dx = -r; dx <= r; dx++) {
+								if (dy == 0 && dx == 0) continue;
+								code = (code << 1) | (pRow[MIN(MAX(x + dx, 0), img.cols - 1)] < pImg[x] ? 1 : 0);
+							} // dx
+						} // dy
+						res[y * img.cols + x] = code;
+					} // x
+				} // y
+			});
+			return res;
+		}
+	}
+
+	// Constructor
+	CStereoCost::CStereoCost(int minDisparity, int maxDisparity, MatchingCost cost, int windowSize)
+		: m_minDisparity(minDisparity)
+		, m_maxDisparity(maxDisparity)
+		, m_cost(cost)
+		, m_windowSize(windowSize)
+	{
+		DGM_ASSERT_MSG(maxDisparity > minDisparity && maxDisparity - minDisparity <= 255, "The number of disparities (%d) must be in range [1; 255]", maxDisparity - minDisparity);
+		DGM_ASSERT_MSG(windowSize > 0 && windowSize % 2 == 1, "The size of the window (%d) must be odd", windowSize);
+		if (cost == MatchingCost::census)	DGM_ASSERT_MSG(windowSize >= 3 && windowSize <= 7, "The size of the census window (%d) must be in range [3; 7]", windowSize);
+		if (cost == MatchingCost::ZNCC)		DGM_ASSERT_MSG(windowSize >= 3, "The size of the ZNCC window (%d) must be at least 3", windowSize);
+	}
+
+	Mat CStereoCost::getPotentials(const Mat &imgL, const Mat &imgR) const
+	{
+		DGM_ASSERT_MSG(imgL.type() == CV_8UC1 && imgR.type() == CV_8UC1, "The images must be of type CV_8UC1");
+		DGM_ASSERT_MSG(imgL.size() == imgR.size(), "The sizes of the images (%d x %d) and (%d x %d) do not match", imgL.cols, imgL.rows, imgR.cols, imgR.rows);
+
+		const int nDisparities = getNumDisparities();
+		const int width = imgL.cols;
+		Mat res(imgL.size(), CV_32FC(nDisparities));
+		switch (m_cost) {
+			case MatchingCost::SAD:		fillSAD(imgL, imgR, res);		break;
+			case MatchingCost::census:	fillCensus(imgL, imgR, res);	break;
+			case MatchingCost::ZNCC:	fillZNCC(imgL, imgR, res);		break;
+		}
+
+		// Costs to potentials
+		parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				float *pRes = res.ptr<float>(y);
+				for (int x = 0; x < width; x++)
+					for (int d = 0; d < nDisparities; d++) {
+						const int xR = x + m_minDisparity + d;
+						float &pot = pRes[x * nDisparities + d];
+						if (xR < 0 || xR >= width) pot = 1.0f;
+						else {
+							const float p = 1.0f - pot;
+							pot = p * p;
+						}
+					} // d
+			} // y
+		});
+		return res;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CStereoCost::fillSAD(const Mat &imgL, const Mat &imgR, Mat &res) const
+	{
+		const int nDisparities = getNumDisparities();
+		const int width = imgL.cols;
+		Mat L, R;
+		imgL.convertTo(L, CV_32FC1, 1.0 / 255);
+		imgR.convertTo(R, CV_32FC1, 1.0 / 255);
+
+		parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+			float *pPad = CArena::getScratch<float>(width + nDisparities - 1);
+			for (int y = range.start; y < range.end; y++) {
+				const float *pL = L.ptr<float>(y);
+				float		*pRes = res.ptr<float>(y);
+				padRow(R.ptr<float>(y), width, m_minDisparity, width + nDisparities - 1, pPad);
+				for (int x = 0; x < width; x++)
+					simd::absDiff(pL[x], pPad + x, pRes + x * nDisparities, nDisparities);
+			} // y
+		});
+
+		if (m_windowSize > 1) boxFilter(res, res, -1, Size(m_windowSize, m_windowSize), Point(-1, -1), true, BORDER_REPLICATE);
+	}
+
+	void CStereoCost::fillCensus(const Mat &imgL, const Mat &imgR, Mat &res) const
+	{
+		const int nDisparities = getNumDisparities();
+		const int width = imgL.cols;
+		const float nBits = static_cast<float>(m_windowSize * m_windowSize - 1);
+		const std::vector<uint64_t> vCensusL = census(imgL, m_windowSize);
+		const std::vector<uint64_t> vCensusR = census(imgR, m_windowSize);
+
+		parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+			uint64_t *pPad = CArena::getScratch<uint64_t>(width + nDisparities - 1);
+			for (int y = range.start; y < range.end; y++) {
+				const uint64_t *pL = vCensusL.data() + y * width;
+				float		   *pRes = res.ptr<float>(y);
+				padRow(vCensusR.data() + y * width, width, m_minDisparity, width + nDisparities - 1, pPad);
+				for (int x = 0; x < width; x++)
+					for (int d = 0; d < nDisparities; d++)
+						pRes[x * nDisparities + d] = std::bitset<64>(pL[x] ^ pPad[x + d]).count() / nBits;
+			} // y
+		});
+	}
+
+	void CStereoCost::fillZNCC(const Mat &imgL, const Mat &imgR, Mat &res) const
+	{
+		const int nDisparities = getNumDisparities();
+		const int width = imgL.cols;
+		const Size window(m_windowSize, m_windowSize);
+		Mat L, R, meanL, meanR, sqrL, sqrR;
+		imgL.convertTo(L, CV_32FC1, 1.0 / 255);
+		imgR.convertTo(R, CV_32FC1, 1.0 / 255);
+		boxFilter(L, meanL, -1, window, Point(-1, -1), true, BORDER_REPLICATE);
+		boxFilter(R, meanR, -1, window, Point(-1, -1), true, BORDER_REPLICATE);
+		boxFilter(L.mul(L), sqrL, -1, window, Point(-1, -1), true, BORDER_REPLICATE);
+		boxFilter(R.mul(R), sqrR, -1, window, Point(-1, -1), true, BORDER_REPLICATE);
+
+		// The products L(x) * R(x + d), averaged over the window
+		parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+			float *pPad = CArena::getScratch<float>(width + nDisparities - 1);
+			for (int y = range.start; y < range.end; y++) {
+				const float *pL = L.ptr<float>(y);
+				float		*pRes = res.ptr<float>(y);
+				padRow(R.ptr<float>(y), width, m_minDisparity, width + nDisparities - 1, pPad);
+				std::fill(pRes, pRes + width * nDisparities, 0.0f);
+				for (int x = 0; x < width; x++)
+					simd::axpy(pL[x], pPad + x, pRes + x * nDisparities, nDisparities);
+			} // y
+		});
+		boxFilter(res, res, -1, window, Point(-1, -1), true, BORDER_REPLICATE);
+
+		// The correlation from the moments
+		parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+			float *pMeanR = CArena::getScratch<float>(width + nDisparities - 1, 0);
+			float *pSqrR  = CArena::getScratch<float>(width + nDisparities - 1, 1);
+			for (int y = range.start; y < range.end; y++) {
+				const float *pMeanL = meanL.ptr<float>(y);
+				const float *pSqrL  = sqrL.ptr<float>(y);
+				float		*pRes   = res.ptr<float>(y);
+				padRow(meanR.ptr<float>(y), width, m_minDisparity, width + nDisparities - 1, pMeanR);
+				padRow(sqrR.ptr<float>(y), width, m_minDisparity, width + nDisparities - 1, pSqrR);
+				for (int x = 0; x < width; x++) {
+					const float varL = MAX(0.0f, pSqrL[x] - pMeanL[x] * pMeanL[x]);
+					for (int d = 0; d < nDisparities; d++) {
+						const float varR = MAX(0.0f, pSqrR[x + d] - pMeanR[x + d] * pMeanR[x + d]);
+						const float den	 = sqrtf(varL * varR);
+						const float zncc = den > 1e-4f ? (pRes[x * nDisparities + d] - pMeanL[x] * pMeanR[x + d]) / den : 0.0f;
+						pRes[x * nDisparities + d] = MIN(MAX(0.5f * (1.0f - zncc), 0.0f), 1.0f);
+					} // d
+				} // x
+			} // y
+		});
+	}
+}
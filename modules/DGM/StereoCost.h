@@ -0,0 +1,74 @@
+// Stereo matching cost volume class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	/// Matching costs of the stereo pixels
+	enum class MatchingCost {
+		SAD,			///< Sum of the absolute differences of the intensities over the window
+		census,			///< Hamming distance between the census transforms over the window
+		ZNCC			///< Zero-mean normalized cross-correlation over the window
+	};
+
+	// ============================= Stereo Cost Class =============================
+	/**
+	* @brief Stereo matching cost volume builder
+	* @details This class builds the node potentials of a disparity estimation graph at once for all the pixels and all the disparities:
+	* for a pixel \a x of the left image and a disparity \a d, the pixel \a x + \a d of the right image is compared. The rows of the images
+	* are processed in parallel; within a row the right image is padded, so that the candidates of every pixel form one contiguous segment,
+	* which is compared with the left pixel by the vectorized kernels (ref. simd::absDiff()). The matching cost \f$c\in[0; 1]\f$ is converted
+	* into the potential \f$(1 - c)^2\f$; the disparities, pointing outside of the right image, get potential 1.
+	*
+	* The result is the block of the node potentials of a grid graph, which is written to the graph with one call:
+	* @code
+	* CGraphPairwiseKit graphKit(maxDisparity - minDisparity, INFER::TRW);
+	* graphKit.getGraphExt().buildGraph(imgL.size());
+	* graphKit.getGraphExt().addDefaultEdgesModel(1.175f);
+	* graphKit.getGraphExt().setGraph(CStereoCost(minDisparity, maxDisparity).getPotentials(imgL, imgR));
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CStereoCost
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param minDisparity The minimal disparity
+		* @param maxDisparity The maximal disparity (exclusive): the number of disparities \a nDisparities = \b maxDisparity - \b minDisparity must be in range [1; 255]
+		* @param cost The matching cost
+		* @param windowSize The size of the square aggregation window. Must be odd. For MatchingCost::census the window of the census transform,
+		* which must be in range [3; 7], and for MatchingCost::ZNCC must be at least 3
+		*/
+		DllExport CStereoCost(int minDisparity, int maxDisparity, MatchingCost cost = MatchingCost::SAD, int windowSize = 1);
+		DllExport ~CStereoCost(void) = default;
+
+		/**
+		* @brief Builds the node potentials
+		* @param imgL The left image: Mat(size: W x H; type: CV_8UC1)
+		* @param imgR The right image: Mat(size: W x H; type: CV_8UC1)
+		* @return The node potentials of every pixel: Mat(size: W x H; type: CV_32FC(nDisparities))
+		*/
+		DllExport Mat	getPotentials(const Mat &imgL, const Mat &imgR) const;
+		/**
+		* @brief Returns the number of disparities
+		* @return The number of disparities, \a i.e. the number of states of the graph
+		*/
+		DllExport int	getNumDisparities(void) const { return m_maxDisparity - m_minDisparity; }
+
+
+	private:
+		void			fillSAD(const Mat &imgL, const Mat &imgR, Mat &res) const;			// Fills the matching costs with the mean absolute differences
+		void			fillCensus(const Mat &imgL, const Mat &imgR, Mat &res) const;		// Fills the matching costs with the normalized Hamming distances
+		void			fillZNCC(const Mat &imgL, const Mat &imgR, Mat &res) const;		// Fills the matching costs with (1 - ZNCC) / 2
+
+
+	private:
+		int				m_minDisparity;
+		int				m_maxDisparity;
+		MatchingCost	m_cost;
+		int				m_windowSize;
+	};
+}
@@ -0,0 +1,268 @@
+#include "ThreadPool.h"
+#include "numa.h"
+#include "macroses.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		thread_local CThreadPool	* tl_pPool	= NULL;		// the pool, which owns the current thread
+		thread_local size_t			  tl_idx	= 0;		// the index of the current worker thread in its pool
+	}
+
+	// Constructor
+	CThreadPool::CThreadPool(size_t nThreads) : m_pinning(false), m_nPending(0), m_next(0), m_stop(false)
+	{
+		if (nThreads == 0) nThreads = MAX(1, std::thread::hardware_concurrency());
+		const size_t nWorkers = nThreads - 1;
+		for (size_t i = 0; i < MAX(1, nWorkers); i++) m_vQueues.push_back(std::make_unique<Queue>());
+		m_vWorkers.reserve(nWorkers);
+		for (size_t i = 0; i < nWorkers; i++) m_vWorkers.emplace_back(&CThreadPool::work, this, i);
+	}
+
+	// Destructor
+	CThreadPool::~CThreadPool(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		for (std::thread &worker : m_vWorkers) worker.join();
+	}
+
+	// The calling thread processes the chunks as one of the runners
+	void CThreadPool::parallelFor(const Range &range, const std::function<void(const Range &)> &body, int grainSize, size_t maxConcurrency)
+	{
+		const int size = range.size();
+		if (size <= 0) return;
+
+		const size_t nThreads	= maxConcurrency ? MIN(maxConcurrency, getNumThreads()) : getNumThreads();
+		if (grainSize <= 0) grainSize = MAX(1, size / static_cast<int>(4 * nThreads));
+		const int	 nChunks	= (size - 1) / grainSize + 1;
+		const size_t nRunners	= MIN(nThreads, static_cast<size_t>(nChunks));
+		if (nRunners <= 1) {
+			body(range);
+			return;
+		}
+
+		// The pinned threads process the part of their NUMA node first
+		const int nParts = m_pinning ? static_cast<int>(MIN(numa::getNumNodes(), static_cast<size_t>(nChunks))) : 1;
+		std::unique_ptr<std::atomic<int>[]> next(new std::atomic<int>[nParts]);
+		for (int p = 0; p < nParts; p++) next[p] = p * nChunks / nParts;
+		auto runner = [&]() {
+			const size_t home = nParts == 1 ? 0 : (tl_pPool == this ? m_vWorkerNodes[tl_idx] : numa::getCurrentNode()) % nParts;
+			for (int i = 0; i < nParts; i++) {
+				const int p		= static_cast<int>((home + i) % nParts);
+				const int last	= (p + 1) * nChunks / nParts;
+				for (int c = next[p]++; c < last; c = next[p]++)
+					body(Range(range.start + c * grainSize, MIN(range.end, range.start + (c + 1) * grainSize)));
+			}
+		};
+		CTaskGroup group(*this);
+		for (size_t r = 1; r < nRunners; r++) group.run(runner);
+		runner();
+		group.wait();
+	}
+
+	// The workers take the CPUs in turn, skipping the first CPU, which is left for the calling thread
+	void CThreadPool::setPinning(bool pinning)
+	{
+		vec_int_t	vCpus;
+		vec_size_t	vCpuNodes;
+		for (size_t node = 0; node < numa::getNumNodes(); node++)
+			for (int cpu : numa::getNodeCpus(node)) {
+				vCpus.push_back(cpu);
+				vCpuNodes.push_back(node);
+			}
+
+		m_vWorkerNodes.assign(m_vWorkers.size(), 0);
+#ifdef __linux__
+		for (size_t i = 0; i < m_vWorkers.size(); i++) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			if (pinning) {
+				const size_t idx = (i + 1) % vCpus.size();
+				CPU_SET(vCpus[idx], &set);
+				m_vWorkerNodes[i] = vCpuNodes[idx];
+			}
+			else
+				for (int cpu : vCpus) CPU_SET(cpu, &set);
+			if (pthread_setaffinity_np(m_vWorkers[i].native_handle(), sizeof(set), &set) != 0)
+				DGM_WARNING("Can not set the affinity of the worker thread %zu", i);
+		}
+		m_pinning = pinning;
+#else
+		if (pinning) DGM_WARNING("The pinning of the threads is supported on Linux only");
+#endif
+	}
+
+	CThreadPool & CThreadPool::getDefault(void)
+	{
+#ifdef ENABLE_PDP
+		static CThreadPool pool;
+#else
+		static CThreadPool pool(1);
+#endif
+		return pool;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The tasks, spawned by a worker, go to its own deque; the other tasks are distributed over the deques in turn
+	void CThreadPool::push(Task &&task)
+	{
+		const size_t idx = tl_pPool == this ? tl_idx : m_next++ % m_vQueues.size();
+		m_nPending++;
+		{
+			std::lock_guard<std::mutex> lock(m_vQueues[idx]->mtx);
+			m_vQueues[idx]->tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);					// the sleeping workers check m_nPending under this mutex
+		}
+		m_cv.notify_one();
+	}
+
+	bool CThreadPool::runPending(void)
+	{
+		Task task;
+		if (!pop(task)) return false;
+		task.pGroup->execute(task.fn);
+		return true;
+	}
+
+	// The own deque is processed from the back (LIFO), the other deques are stolen from the front (FIFO)
+	bool CThreadPool::pop(Task &task)
+	{
+		if (m_nPending == 0) return false;
+
+		const bool   isWorker = tl_pPool == this;
+		const size_t nQueues  = m_vQueues.size();
+		const size_t first    = isWorker ? tl_idx : m_next % nQueues;
+		for (size_t i = 0; i < nQueues; i++) {
+			Queue &queue = *m_vQueues[(first + i) % nQueues];
+			std::lock_guard<std::mutex> lock(queue.mtx);
+			if (queue.tasks.empty()) continue;
+			if (isWorker && i == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			m_nPending--;
+			return true;
+		}
+		return false;
+	}
+
+	void CThreadPool::work(size_t idx)
+	{
+		tl_pPool = this;
+		tl_idx	 = idx;
+		for (;;) {
+			if (runPending()) continue;
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_cv.wait(lock, [this] { return m_stop || m_nPending > 0; });
+			if (m_stop) break;
+		}
+	}
+
+	// ================================== Task Group ==================================
+	void CTaskGroup::run(std::function<void(void)> task)
+	{
+		m_nActive++;
+#ifdef ENABLE_PDP
+		m_pool.push({ std::move(task), this });
+#else
+		execute(task);
+#endif
+	}
+
+	void CTaskGroup::wait(void)
+	{
+		join();
+		if (m_exception) {
+			std::exception_ptr exception = m_exception;
+			m_exception = nullptr;
+			std::rethrow_exception(exception);
+		}
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// Instead of blocking, the waiting thread executes the pending tasks, which may belong to the other groups
+	void CTaskGroup::join(void)
+	{
+		while (m_nActive > 0)
+			if (!m_pool.runPending()) std::this_thread::yield();
+	}
+
+	void CTaskGroup::execute(std::function<void(void)> &fn)
+	{
+		try {
+			fn();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if (!m_exception) m_exception = std::current_exception();
+		}
+		m_nActive--;
+	}
+
+	// ================================== Backends ==================================
+	namespace parallel {
+		namespace {
+			std::atomic<Backend>	g_backend(Backend::pool);
+			executor_function_t		g_executor;
+			std::mutex				g_mtx;					// protects g_executor
+		}
+
+		void setBackend(Backend backend)
+		{
+			g_backend = backend;
+		}
+
+		Backend getBackend(void)
+		{
+			return g_backend;
+		}
+
+		void setExecutor(executor_function_t executor)
+		{
+			std::lock_guard<std::mutex> lock(g_mtx);
+			g_executor = std::move(executor);
+			g_backend  = Backend::host;
+		}
+
+		void parallelFor(const Range &range, const std::function<void(const Range &)> &body, int grainSize, size_t maxConcurrency)
+		{
+			if (range.size() <= 0) return;
+#ifdef ENABLE_PDP
+			switch (getBackend()) {
+				case Backend::pool:
+					CThreadPool::getDefault().parallelFor(range, body, grainSize, maxConcurrency);
+					break;
+				case Backend::opencv:
+					parallel_for_(range, body, grainSize > 0 ? static_cast<double>(range.size()) / grainSize : -1.0);
+					break;
+				case Backend::host: {
+					executor_function_t executor;
+					{
+						std::lock_guard<std::mutex> lock(g_mtx);
+						executor = g_executor;
+					}
+					if (executor) executor(range, body, grainSize, maxConcurrency);
+					else body(range);
+					break;
+				}
+			}
+#else
+			body(range);
+#endif
+		}
+	}
+}
@@ -0,0 +1,216 @@
+// Work-stealing thread pool class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace DirectGraphicalModels
+{
+	class CTaskGroup;
+
+	// ============================== Thread Pool Class ==============================
+	/**
+	* @brief Work-stealing thread pool
+	* @details Every worker thread owns a deque of tasks: the tasks, spawned by a worker, are pushed to and popped from the back of its own deque, while the idle
+	* workers steal the tasks from the front of the other deques. A thread waiting for a @ref CTaskGroup executes the pending tasks instead of blocking,
+	* so the parallel regions may be nested and the recursive algorithms may spawn the tasks at every level of the recursion.
+	*
+	* The library uses one shared pool, returned by getDefault(), via the functions of the @ref parallel namespace. The host application may construct its own pools.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CThreadPool
+	{
+		friend class CTaskGroup;
+
+	public:
+		/**
+		* @brief Constructor
+		* @param nThreads The number of threads, including the calling thread, which participates in the computations. If zero, the number of the hardware threads is used
+		*/
+		DllExport explicit CThreadPool(size_t nThreads = 0);
+		DllExport ~CThreadPool(void);
+		CThreadPool(const CThreadPool &) = delete;
+		const CThreadPool& operator= (const CThreadPool &) = delete;
+
+		/**
+		* @brief Returns the number of threads
+		* @return The number of the worker threads plus one for the calling thread
+		*/
+		DllExport size_t				getNumThreads(void) const { return m_vWorkers.size() + 1; }
+		/**
+		* @brief Executes the loop body in parallel
+		* @details The range is split into the chunks of \b grainSize iterations, which are processed by at most \b maxConcurrency threads, including the calling thread.
+		* The function returns when all the chunks are processed; the first exception, thrown by the body, is re-thrown in the calling thread.
+		* @param range The range of the loop
+		* @param body The loop body, processing a sub-range of the \b range. It is called concurrently.
+		* @param grainSize The number of iterations in one chunk. If zero, the range is split into about four chunks per thread
+		* @param maxConcurrency The maximal number of threads, processing the range. If zero, all the threads of the pool may be used
+		*/
+		DllExport void					parallelFor(const Range &range, const std::function<void(const Range &)> &body, int grainSize = 0, size_t maxConcurrency = 0);
+		/**
+		* @brief Pins the worker threads to the CPUs
+		* @details The worker threads are bound to the CPUs in the order of the NUMA nodes (ref. numa::getNodeCpus()), one thread per CPU. On the machines with several
+		* NUMA nodes, the chunks of parallelFor() are then split into numa::getNumNodes() contiguous parts, and every thread processes the part of its own NUMA node
+		* first, before helping the others. Thus the \a k-th part of the range is mostly processed on the NUMA node \a k, where the buffers, placed with the functions
+		* of the @ref numa namespace, keep the \a k-th part of their data. The calling thread is not pinned. Pinning is supported on Linux only.
+		* > This function must not be called concurrently with parallelFor().
+		* @param pinning Flag indicating whether the worker threads should be pinned. If \b false, the threads may run on all the CPUs again
+		*/
+		DllExport void					setPinning(bool pinning);
+		/**
+		* @brief Checks whether the worker threads are pinned to the CPUs
+		* @return The pinning flag (ref. setPinning())
+		*/
+		DllExport bool					isPinning(void) const { return m_pinning; }
+		/**
+		* @brief Returns the default thread pool
+		* @details The default pool is created on the first call with the number of the hardware threads
+		* @return The pool, shared by all the library classes
+		*/
+		DllExport static CThreadPool  & getDefault(void);
+
+
+	private:
+		/// Task
+		struct Task {
+			std::function<void(void)>	fn;			///< The task function
+			CTaskGroup				  * pGroup;		///< The group, which waits for the task
+		};
+		/// Deque of tasks of a worker thread
+		struct Queue {
+			std::deque<Task>	tasks;				///< The tasks
+			std::mutex			mtx;				///< The mutex, protecting the tasks
+		};
+
+		void	push(Task &&task);
+		bool	runPending(void);
+		bool	pop(Task &task);
+		void	work(size_t idx);
+
+
+	private:
+		std::vector<std::unique_ptr<Queue>>	m_vQueues;			///< The task deques: one per worker thread (at least one)
+		std::vector<std::thread>			m_vWorkers;			///< The worker threads
+		vec_size_t							m_vWorkerNodes;		///< The NUMA nodes of the pinned worker threads
+		std::atomic<bool>					m_pinning;			///< Flag indicating whether the worker threads are pinned
+		std::atomic<size_t>					m_nPending;			///< The number of tasks in all the deques
+		std::atomic<size_t>					m_next;				///< The index of the deque for the next task, spawned outside the pool
+		std::mutex							m_mtx;				///< The mutex for the sleeping workers
+		std::condition_variable				m_cv;				///< The condition for the sleeping workers
+		bool								m_stop;				///< Flag indicating whether the workers should stop
+	};
+
+	// =============================== Task Group Class ===============================
+	/**
+	* @brief Group of tasks
+	* @details The tasks are executed by the threads of a @ref CThreadPool. The wait() function returns (or re-throws the first exception, thrown by the tasks), when all the tasks
+	* of the group are finished; meanwhile, the waiting thread executes the pending tasks of the pool. If PDP is disabled, the tasks are executed immediately in the calling thread.
+	* @code
+	* std::shared_ptr<Node> build(int *pBegin, int n)
+	* {
+	*	if (n < 1024) return buildSequential(pBegin, n);
+	*	int *pMiddle = partition(pBegin, n);
+	*	std::shared_ptr<Node> left, right;
+	*	CTaskGroup group;
+	*	group.run([&] { left = build(pBegin, pMiddle - pBegin); });
+	*	right = build(pMiddle, n - (pMiddle - pBegin));
+	*	group.wait();
+	*	return std::make_shared<Node>(left, right);
+	* }
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CTaskGroup
+	{
+		friend class CThreadPool;
+
+	public:
+		/**
+		* @brief Constructor
+		* @param pool The thread pool, executing the tasks
+		*/
+		DllExport explicit CTaskGroup(CThreadPool &pool = CThreadPool::getDefault()) : m_pool(pool), m_nActive(0) {}
+		DllExport ~CTaskGroup(void) { join(); }
+		CTaskGroup(const CTaskGroup &) = delete;
+		const CTaskGroup& operator= (const CTaskGroup &) = delete;
+
+		/**
+		* @brief Spawns a task
+		* @param task The task function. The objects, captured by reference, must stay alive until wait() returns
+		*/
+		DllExport void	run(std::function<void(void)> task);
+		/**
+		* @brief Waits for all the spawned tasks
+		* @details If one of the tasks has thrown an exception, it is re-thrown here
+		*/
+		DllExport void	wait(void);
+
+
+	private:
+		void	join(void);
+		void	execute(std::function<void(void)> &fn);
+
+
+	private:
+		CThreadPool			& m_pool;				///< The thread pool
+		std::atomic<size_t>	  m_nActive;			///< The number of unfinished tasks
+		std::exception_ptr	  m_exception;			///< The first exception, thrown by the tasks
+		std::mutex			  m_mtx;				///< The mutex, protecting the exception
+	};
+
+	namespace parallel {
+		/// The execution backends
+		enum class Backend {
+			pool,			///< The work-stealing pool of the library: CThreadPool::getDefault()
+			opencv,			///< The OpenCV parallel framework: cv::parallel_for_(), which uses TBB, OpenMP or the OpenCV own pool, depending on the OpenCV build. The concurrency limit is ignored
+			host			///< The executor of the host application, set by setExecutor()
+		};
+
+		/**
+		* @brief The executor of the host application
+		* @details The executor must call \b body for the disjoint sub-ranges, covering the whole range, and return when all the calls are finished.
+		* Its arguments are the same as in the parallelFor() function.
+		*/
+		using executor_function_t = std::function<void(const Range &range, const std::function<void(const Range &)> &body, int grainSize, size_t maxConcurrency)>;
+
+		/**
+		* @brief Sets the execution backend for all the parallel loops of the library
+		* @param backend The backend
+		*/
+		DllExport void		setBackend(Backend backend);
+		/**
+		* @brief Returns the current execution backend
+		* @return The backend
+		*/
+		DllExport Backend	getBackend(void);
+		/**
+		* @brief Sets the executor of the host application and switches the backend to Backend::host
+		* @details This allows for sharing one thread pool, \a e.g. a TBB arena or an OpenMP team, between the library and the host application:
+		* @code
+		* parallel::setExecutor([](const Range &range, const std::function<void(const Range &)> &body, int grainSize, size_t) {
+		*	tbb::parallel_for(tbb::blocked_range<int>(range.start, range.end, MAX(1, grainSize)), [&](const tbb::blocked_range<int> &r) {
+		*		body(Range(r.begin(), r.end()));
+		*	});
+		* });
+		* @endcode
+		* @param executor The executor
+		*/
+		DllExport void		setExecutor(executor_function_t executor);
+		/**
+		* @brief Executes the loop body in parallel with the current backend
+		* @details If PDP is disabled, the body is called once for the whole range in the calling thread.
+		* > This function supports PPL.
+		* @param range The range of the loop
+		* @param body The loop body, processing a sub-range of the \b range. It is called concurrently.
+		* @param grainSize The number of iterations in one chunk. If zero, the backend chooses the chunk size
+		* @param maxConcurrency The maximal number of threads, processing the range. If zero, no limit is applied
+		*/
+		DllExport void		parallelFor(const Range &range, const std::function<void(const Range &)> &body, int grainSize = 0, size_t maxConcurrency = 0);
+	}
+}
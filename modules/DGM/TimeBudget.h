@@ -0,0 +1,73 @@
+// Time budget and cancellation class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <chrono>
+
+namespace DirectGraphicalModels
+{
+	// ================================ Time Budget Class ================================
+	/**
+	* @brief Time budget and cooperative cancellation
+	* @details The long-running algorithms call start() in the beginning and check isExpired() between the chunks of work, \a e.g. between the iterations.
+	* The budget expires, when the time, given in setTimeBudget(), has passed since start(), or when the cancellation token, given in 
+	* setCancellationToken(), is set from another thread. Once expired, the budget stays expired until the next start().
+	* > The isExpired() function is thread-safe
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CTimeBudget
+	{
+	public:
+		DllExport CTimeBudget(void) : m_budget(0), m_pToken(NULL), m_expired(false) {}
+		DllExport ~CTimeBudget(void) = default;
+
+		/**
+		* @brief Sets the time budget
+		* @param budget The maximal duration from start() to expiration. Zero value disables the time budget (default)
+		*/
+		DllExport void	setTimeBudget(std::chrono::milliseconds budget) { m_budget = budget; }
+		/**
+		* @brief Sets the cancellation token
+		* @param pToken Pointer to the flag, which cancels the work once set to \a true, or NULL to disable the cancellation (default). 
+		* The flag must outlive the work
+		*/
+		DllExport void	setCancellationToken(const std::atomic<bool> *pToken) { m_pToken = pToken; }
+		/**
+		* @brief Starts the time budget
+		*/
+		DllExport void	start(void) 
+		{ 
+			m_start = std::chrono::steady_clock::now(); 
+			m_expired = false; 
+		}
+		/**
+		* @brief Checks whether the time budget has expired or the work is cancelled
+		* @retval true if the work should be stopped
+		* @retval false otherwise
+		*/
+		DllExport bool	isExpired(void) const
+		{
+			if (m_expired.load(std::memory_order_relaxed)) return true;
+			const bool expired = (m_pToken && m_pToken->load(std::memory_order_relaxed)) ||
+								 (m_budget.count() > 0 && std::chrono::steady_clock::now() - m_start >= m_budget);
+			if (expired) m_expired = true;
+			return expired;
+		}
+		/**
+		* @brief Checks whether the budget has expired during the work, started last
+		* @details Unlike isExpired(), this function does not check the time and the token
+		* @retval true if isExpired() has returned \a true since the last start()
+		* @retval false otherwise
+		*/
+		DllExport bool	hasExpired(void) const { return m_expired.load(std::memory_order_relaxed); }
+
+
+	private:
+		std::chrono::milliseconds				m_budget;		///< The time budget
+		const std::atomic<bool>				  * m_pToken;		///< The cancellation token
+		std::chrono::steady_clock::time_point	m_start;		///< The start time
+		mutable std::atomic<bool>				m_expired;		///< Flag indicating whether the budget has expired
+	};
+}
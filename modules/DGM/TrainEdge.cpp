@@ -26,6 +26,15 @@ namespace DirectGraphicalModels
 		}
 	}
 	
+	void CTrainEdge::addFeatureVecBlock(const Mat &featureMatrix1, const Mat &gt1, const Mat &featureMatrix2, const Mat &gt2)
+	{
+		DGM_ASSERT(featureMatrix1.size() == featureMatrix2.size());
+		DGM_ASSERT(gt1.type() == CV_8UC1 && gt2.type() == CV_8UC1);
+		DGM_ASSERT(gt1.rows == featureMatrix1.rows && gt2.rows == featureMatrix2.rows);
+		for (int i = 0; i < featureMatrix1.rows; i++)
+			addFeatureVecs(featureMatrix1.row(i).reshape(1, getNumFeatures()), gt1.at<byte>(i, 0), featureMatrix2.row(i).reshape(1, getNumFeatures()), gt2.at<byte>(i, 0));
+	}
+
 	Mat CTrainEdge::getEdgePotentials(const Mat &featureVector1, const Mat &featureVector2, const vec_float_t &vParams, float weight) const
 	{
 		Mat res = calculateEdgePotentials(featureVector1, featureVector2, vParams);
@@ -42,6 +51,23 @@ namespace DirectGraphicalModels
 	
 		return res;
 	}
+
+	void CTrainEdge::getEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials, float weight) const
+	{
+		DGM_ASSERT(featureMatrix1.size() == featureMatrix2.size());
+		calculateEdgePotentials(featureMatrix1, featureMatrix2, vParams, potentials);
+		if (weight != 1.0f) pow(potentials, weight, potentials);
+
+		// Normalization
+		for (int i = 0; i < potentials.rows; i++)
+			for (byte y = 0; y < m_nStates; y++) {
+				float *pRes = potentials.ptr<float>(i) + y * m_nStates;
+				float  Sum = 0;
+				for (byte x = 0; x < m_nStates; x++) Sum += pRes[x];
+				if (Sum == 0) continue;
+				for (byte x = 0; x < m_nStates; x++) pRes[x] *= 100 / Sum;
+			} // y
+	}
     
     // returns the matrix filled with ones, except the diagonal values wich are set to <values>
     Mat CTrainEdge::getDefaultEdgePotentials(const vec_float_t &values)
@@ -51,4 +77,14 @@ namespace DirectGraphicalModels
         for (byte s = 0; s < nStates; s++) res.at<float>(s, s) = values[s];
         return res;
     }
+
+	void CTrainEdge::calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const
+	{
+		potentials.create(featureMatrix1.rows, m_nStates * m_nStates, CV_32FC1);
+		for (int i = 0; i < featureMatrix1.rows; i++) {
+			Mat pot = calculateEdgePotentials(featureMatrix1.row(i).reshape(1, getNumFeatures()), featureMatrix2.row(i).reshape(1, getNumFeatures()), vParams);
+			if (!pot.isContinuous()) pot = pot.clone();
+			pot.reshape(1, 1).copyTo(potentials.row(i));
+		} // i
+	}
 }
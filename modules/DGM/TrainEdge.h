@@ -51,6 +51,16 @@ namespace DirectGraphicalModels
 		* @param gt2 The ground-truth state (class) of the second node of the edge, given by \b featureVector2 
 		*/		
 		DllExport virtual void	addFeatureVecs(const Mat &featureVector1, byte gt1, const Mat &featureVector2, byte gt2) = 0;			
+		/**
+		* @brief Adds the pairs of feature vectors of a block of edges
+		* @details The default implementation calls addFeatureVecs(const Mat &, byte, const Mat &, byte) for every edge; the derived classes may override it
+		* in order to pass the whole block to the underlying classifier at once.
+		* @param featureMatrix1 Multi-dimensinal points, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the first nodes of the edges
+		* @param gt1 The ground-truth states (classes) of the first nodes of the edges: Mat(size: nEdges x 1; type: CV_8UC1)
+		* @param featureMatrix2 Multi-dimensinal points, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the second nodes of the edges
+		* @param gt2 The ground-truth states (classes) of the second nodes of the edges: Mat(size: nEdges x 1; type: CV_8UC1)
+		*/
+		DllExport virtual void	addFeatureVecBlock(const Mat &featureMatrix1, const Mat &gt1, const Mat &featureMatrix2, const Mat &gt2);
 		DllExport virtual void	train(bool doClean = false) {}
 		/**
 		* @brief Returns the edge potential, based on the feature vectors
@@ -63,6 +73,17 @@ namespace DirectGraphicalModels
 		* @return %Edge potentials on success: Mat(size: nStates x nStates; type: CV_32FC1)
 		*/	
 		DllExport Mat			getEdgePotentials(const Mat &featureVector1, const Mat &featureVector2, const vec_float_t &vParams, float weight = 1.0f) const; 
+		/**
+		* @brief Returns the edge potentials, based on the blocks of feature vectors
+		* @details This function calculates the potentials of \a nEdges edges at once with calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &, Mat &) const.
+		* After that, the resulting edge potentials are powered by parameter \b weight and normalized in the same way as getEdgePotentials(const Mat &, const Mat &, const vec_float_t &, float) const does.
+		* @param[in] featureMatrix1 Multi-dimensinal points \f$\textbf{f}_1\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the first nodes of the edges
+		* @param[in] featureMatrix2 Multi-dimensinal points \f$\textbf{f}_2\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the second nodes of the edges
+		* @param[in] vParams Array of control parameters. Please refer to the concrete model implementation of the calculateEdgePotentials() function for more details
+		* @param[out] potentials %Edge potentials: Mat(size: nEdges x (nStates * nStates); type: CV_32FC1), every row of which is a row-major edge potential matrix
+		* @param[in] weight The weighting parameter
+		*/
+		DllExport void			getEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials, float weight = 1.0f) const;
         /**
          * @brief Returns the data-independent edge potentials
          * @details This function returns matrix with diagonal elements equal to the argument \b val, all the other elements are 1's, what imitates the Potts model.
@@ -80,6 +101,19 @@ namespace DirectGraphicalModels
          * @return The edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
          */
         DllExport static Mat    getDefaultEdgePotentials(const vec_float_t &values);
+		/**
+		* @brief Creates a worker for the parallel accumulation of the feature vectors
+		* @details The worker is an empty edge trainer, which is able to accumulate the pairs of feature vectors with addFeatureVecs() independently from this one.
+		* The accumulated data is then merged into this edge trainer with the merge() function. The default implementation returns an empty pointer,
+		* meaning that the edge trainer does not support the parallel accumulation.
+		* @return The pointer to the worker or an empty pointer
+		*/
+		DllExport virtual std::shared_ptr<CTrainEdge> createWorker(void) const { return nullptr; }
+		/**
+		* @brief Merges the data, accumulated by a worker, into this edge trainer
+		* @param worker The worker, created with createWorker() function
+		*/
+		DllExport virtual void	merge(CTrainEdge &worker) {}
 
         
 	protected:
@@ -95,5 +129,15 @@ namespace DirectGraphicalModels
 		* @returns The edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
 		*/	
 		DllExport virtual Mat	calculateEdgePotentials(const Mat &featureVector1, const Mat &featureVector2, const vec_float_t &vParams) const = 0;
+		/**
+		* @brief Calculates the edge potentials, based on the blocks of feature vectors
+		* @details The default implementation calls calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &) const for every edge;
+		* the derived classes may override it in order to calculate the potentials of all the edges in vectorized passes.
+		* @param[in] featureMatrix1 Multi-dimensinal points \f$\textbf{f}_1\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the first nodes of the edges
+		* @param[in] featureMatrix2 Multi-dimensinal points \f$\textbf{f}_2\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the second nodes of the edges
+		* @param[in] vParams Array of control parameters. Please refer to the concrete model implementation of the calculateEdgePotentials() function for more details
+		* @param[out] potentials %Edge potentials: Mat(size: nEdges x (nStates * nStates); type: CV_32FC1), every row of which is a row-major edge potential matrix
+		*/
+		DllExport virtual void	calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const;
 	};
 }
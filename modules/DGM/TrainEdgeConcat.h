@@ -37,8 +37,8 @@ namespace DirectGraphicalModels
 		{
 			DGM_ASSERT(nStates < 16);
 			m_pPrior		= std::make_unique<CPriorNode>(nStates * nStates);
-			m_pTrainer		= std::make_unique<Trainer>(nStates * nStates, nFeatures);
 			m_pConcatenator = std::make_unique<Concatenator>(nFeatures);
+			m_pTrainer		= std::make_shared<Trainer>(nStates * nStates, m_pConcatenator->getNumFeatures());
 			m_featureVector = Mat(m_pConcatenator->getNumFeatures(), 1, CV_8UC1);
 		}
 		/**
@@ -55,8 +55,8 @@ namespace DirectGraphicalModels
 		{
 			DGM_ASSERT(nStates < 16);
 			m_pPrior		= std::make_unique<CPriorNode>(nStates * nStates);
-			m_pTrainer		= std::make_unique<Trainer>(nStates * nStates, nFeatures, params);
 			m_pConcatenator = std::make_unique<Concatenator>(nFeatures);
+			m_pTrainer		= std::make_shared<Trainer>(nStates * nStates, m_pConcatenator->getNumFeatures(), params);
 			m_featureVector = Mat(m_pConcatenator->getNumFeatures(), 1, CV_8UC1);
 		}
 		virtual ~CTrainEdgeConcat(void) = default;
@@ -73,7 +73,46 @@ namespace DirectGraphicalModels
 			m_pConcatenator->concatenate(featureVector1, featureVector2, m_featureVector);
 			m_pTrainer->addFeatureVec(m_featureVector, gt);
 		}
+		/**
+		* @brief Adds the pairs of feature vectors of a block of edges
+		* @details The feature vectors of all the edges are concatenated in parallel into one matrix (Ref. CFeaturesConcatenator::concatenateBlock()),
+		* which is passed to CTrainNode::addFeatureVecs(const Mat &, const Mat &) of the nested node trainer at once
+		* @param featureMatrix1 Multi-dimensinal points, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the first nodes of the edges
+		* @param gt1 The ground-truth states (classes) of the first nodes of the edges: Mat(size: nEdges x 1; type: CV_8UC1)
+		* @param featureMatrix2 Multi-dimensinal points, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the second nodes of the edges
+		* @param gt2 The ground-truth states (classes) of the second nodes of the edges: Mat(size: nEdges x 1; type: CV_8UC1)
+		*/
+		virtual void	addFeatureVecBlock(const Mat &featureMatrix1, const Mat &gt1, const Mat &featureMatrix2, const Mat &gt2)
+		{
+			DGM_ASSERT(gt1.type() == CV_8UC1 && gt2.type() == CV_8UC1);
+			DGM_ASSERT(gt1.rows == featureMatrix1.rows && gt2.rows == featureMatrix2.rows);
+			const int nEdges = featureMatrix1.rows;
+			if (nEdges == 0) return;
+
+			Mat gt(nEdges, 1, CV_8UC1);
+			for (int i = 0; i < nEdges; i++) gt.at<byte>(i, 0) = gt2.at<byte>(i, 0) * m_nStates + gt1.at<byte>(i, 0);
+			m_pPrior->addNodeGroundTruth(gt);
+			m_pConcatenator->concatenateBlock(featureMatrix1, featureMatrix2, m_featureMatrix);
+			m_pTrainer->addFeatureVecs(m_featureMatrix.reshape(m_pConcatenator->getNumFeatures(), nEdges), gt);
+		}
 		virtual void	train(bool doClean = false) { m_pTrainer->train(doClean); }
+		/**
+		* @brief Creates a worker for the parallel accumulation of the feature vectors
+		* @details The worker is available only if the nested node trainer supports workers (Ref. CTrainNode::createWorker())
+		* @return The pointer to the worker or an empty pointer
+		*/
+		virtual std::shared_ptr<CTrainEdge> createWorker(void) const
+		{
+			std::shared_ptr<CTrainNode> pTrainer = m_pTrainer->createWorker();
+			if (!pTrainer) return nullptr;
+			return std::shared_ptr<CTrainEdgeConcat>(new CTrainEdgeConcat(m_nStates, getNumFeatures(), pTrainer));
+		}
+		virtual void	merge(CTrainEdge &worker)
+		{
+			CTrainEdgeConcat &concat = dynamic_cast<CTrainEdgeConcat &>(worker);
+			m_pPrior->merge(*concat.m_pPrior);
+			m_pTrainer->merge(*concat.m_pTrainer);
+		}
 
 
 	protected:
@@ -112,12 +151,59 @@ namespace DirectGraphicalModels
 
 			return res;
 		}
+		/**
+		* @brief Calculates the edge potentials, based on the blocks of feature vectors
+		* @details The feature vectors of all the edges are concatenated in parallel into one matrix (Ref. CFeaturesConcatenator::concatenateBlock()), 
+		* which is classified with CTrainNode::getNodePotentials(const Mat &, const Mat &, float, const Mat &) const of the nested node trainer at once.
+		* The potentials are the same as the ones of calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &) const.
+		* @param[in] featureMatrix1 Multi-dimensinal points \f$\textbf{f}_1\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the first nodes of the edges
+		* @param[in] featureMatrix2 Multi-dimensinal points \f$\textbf{f}_2\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1), corresponding to the second nodes of the edges
+		* @param[in] vParams Array of control parameters (not used)
+		* @param[out] potentials %Edge potentials: Mat(size: nEdges x (nStates * nStates); type: CV_32FC1), every row of which is a row-major edge potential matrix
+		*/
+		DllExport virtual void	calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const
+		{
+			const int nEdges = featureMatrix1.rows;
+			potentials.create(nEdges, m_nStates * m_nStates, CV_32FC1);
+			if (nEdges == 0) return;
+
+			Mat featureMatrix;
+			m_pConcatenator->concatenateBlock(featureMatrix1, featureMatrix2, featureMatrix);
+			const Mat pots	= m_pTrainer->getNodePotentials(featureMatrix.reshape(m_pConcatenator->getNumFeatures(), nEdges)).reshape(1, nEdges);		// Mat(size: nEdges x nStates^2)
+			const Mat prior = m_pPrior->getPrior(100);
+
+			for (int i = 0; i < nEdges; i++) {
+				const float *pPot = pots.ptr<float>(i);
+				float		*pRes = potentials.ptr<float>(i);
+				for (byte gt1 = 0; gt1 < m_nStates; gt1++)
+					for (byte gt2 = 0; gt2 < m_nStates; gt2++) {
+						byte gt = gt2 * m_nStates + gt1;
+
+						float epsilon = prior.at<float>(gt) > 0 ? FLT_EPSILON : 0.0f;
+						pRes[gt1 * m_nStates + gt2] = MAX(pPot[gt], epsilon);
+					}
+			} // i
+		}
 	
 
+	private:
+		// Constructor of the worker with the given nested node trainer worker
+		CTrainEdgeConcat(byte nStates, word nFeatures, std::shared_ptr<CTrainNode> pTrainer)
+			: CBaseRandomModel(nStates)
+			, CTrainEdge(nStates, nFeatures)
+		{
+			m_pPrior		= std::make_unique<CPriorNode>(nStates * nStates);
+			m_pTrainer		= pTrainer;
+			m_pConcatenator = std::make_unique<Concatenator>(nFeatures);
+			m_featureVector = Mat(m_pConcatenator->getNumFeatures(), 1, CV_8UC1);
+		}
+
+
 	private:
         std::unique_ptr<CPriorNode>				m_pPrior;			///< %Node prior poobability
-        std::unique_ptr<CTrainNode>				m_pTrainer;			///< %Node trainer
+        std::shared_ptr<CTrainNode>				m_pTrainer;			///< %Node trainer
         std::unique_ptr<CFeaturesConcatenator>	m_pConcatenator;	///< Feature concatenator
 		Mat										m_featureVector;	///< Feature vector
+		Mat										m_featureMatrix;	///< The concatenated feature vectors of a block of edges
 	};
 }
@@ -9,4 +9,11 @@ namespace DirectGraphicalModels
 		else if (vParams.size() == m_nStates)	return getDefaultEdgePotentials(vParams);
 		else DGM_ASSERT_MSG(false, "Wrong number of parameters: %zu. It must be either %d or %u", vParams.size(), 1, m_nStates);
     }
+
+	void CTrainEdgePotts::calculateEdgePotentials(const Mat &featureMatrix1, const Mat &, const vec_float_t &vParams, Mat &potentials) const
+	{
+		const Mat pot = calculateEdgePotentials(Mat(), Mat(), vParams).reshape(1, 1);
+		potentials.create(featureMatrix1.rows, pot.cols, CV_32FC1);
+		for (int i = 0; i < potentials.rows; i++) pot.copyTo(potentials.row(i));
+	}
 }
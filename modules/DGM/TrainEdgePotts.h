@@ -49,5 +49,14 @@ namespace DirectGraphicalModels
 		* @return The edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
 		*/
 		DllExport virtual Mat	calculateEdgePotentials(const Mat &featureVector1, const Mat &featureVector2, const vec_float_t &vParams) const;
+		/**
+		* @brief Returns the data-independent edge potentials for a block of edges
+		* @details All the rows of the resulting block are equal to the potential matrix, returned by calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &) const
+		* @param[in] featureMatrix1 Multi-dimensinal points \f$\textbf{f}_1\f$: Mat(size: nEdges x nFeatures; type: CV_8UC1). Only the number of rows is used.
+		* @param[in] featureMatrix2 Multi-dimensinal points \f$\textbf{f}_2\f$: Mat(size: nEdges x nFeatures; type: CV_8UC1). It is not used in the Potts model.
+		* @param[in] vParams Array of control parameters \f$\vec{\theta}\f$
+		* @param[out] potentials %Edge potentials: Mat(size: nEdges x (nStates * nStates); type: CV_32FC1)
+		*/
+		DllExport virtual void	calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const;
 	};
 }
@@ -76,4 +76,44 @@ Mat	CTrainEdgePottsCS::calculateEdgePotentials(const Mat &featureVector1, const
 
 	return res;
 }
+
+void CTrainEdgePottsCS::calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const
+{
+	DGM_ASSERT_MSG((vParams.size() == 2) || (vParams.size() == m_nStates + 1), "Wrong number of parameters: %zu. It must be either %d or %u", vParams.size(), 2, m_nStates + 1);
+	// Assertions:
+	DGM_ASSERT_MSG((featureMatrix1.type() == CV_8UC1) && (featureMatrix2.type() == CV_8UC1), 
+		"One (or both) of input feature matrices has either wrong depth or more than one channel");
+	DGM_ASSERT_MSG((featureMatrix1.cols == getNumFeatures()) && (featureMatrix2.cols == getNumFeatures()), 
+		"The input feature matrices have wrong number of features: %d and %d", featureMatrix1.cols, featureMatrix2.cols);
+	DGM_ASSERT(featureMatrix1.rows == featureMatrix2.rows);
+
+	CTrainEdgePotts::calculateEdgePotentials(featureMatrix1, featureMatrix2, vec_float_t(vParams.begin(), vParams.end() - 1), potentials);
+
+	// Contrasts: the sums of the squared differences are exact in the integer arithmetic
+	const int	nEdges		= featureMatrix1.rows;
+	const int	nFeatures	= getNumFeatures();
+	vec_float_t	vPenalty(nEdges);
+	for (int i = 0; i < nEdges; i++) {
+		const byte *pFv1 = featureMatrix1.ptr<byte>(i);
+		const byte *pFv2 = featureMatrix2.ptr<byte>(i);
+		int sum = 0;
+		for (int f = 0; f < nFeatures; f++) {
+			const int d = pFv1[f] - pFv2[f];
+			sum += d * d;
+		}
+		vPenalty[i] = sqrtf(static_cast<float>(sum) / nFeatures);
+	} // i
+
+	const float lambda = vParams.back();
+	switch (m_penApproach) {
+		case eP_APP_PEN_CHAR:	for (float &penalty : vPenalty) penalty = penalizerChar(penalty, lambda);	break;
+		case eP_APP_PEN_PM:		for (float &penalty : vPenalty) penalty = penalizerPM(penalty, lambda);		break;
+		case eP_APP_PEN_EXP:	for (float &penalty : vPenalty) penalty = penalizerExp(penalty, lambda);	break;
+	}
+
+	for (int i = 0; i < nEdges; i++) {
+		float *pPot = potentials.ptr<float>(i);
+		for (byte s = 0; s < m_nStates; s++) pPot[s * (m_nStates + 1)] = MAX(1.0f, pPot[s * (m_nStates + 1)] * vPenalty[i]);
+	}
+}
 }
\ No newline at end of file
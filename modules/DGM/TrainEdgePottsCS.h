@@ -66,6 +66,16 @@ namespace DirectGraphicalModels
 		* > If \b featureVector1 or \b featureVector2 is empty, the function returns the test-data-independent Potts potential: @ref CTrainEdgePotts::calculateEdgePotentials()
 		*/		
 		DllExport virtual Mat	calculateEdgePotentials(const Mat &featureVector1, const Mat &featureVector2, const vec_float_t &vParams) const;
+		/**
+		* @brief Returns the contrast-sensitive edge potentials for a block of edges
+		* @details This function calculates the same potentials as calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &) const does,
+		* but the contrasts and the penalties of all the edges are evaluated in vectorized passes over the feature blocks.
+		* @param[in] featureMatrix1 Multi-dimensinal points \f$\textbf{f}_1\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1)
+		* @param[in] featureMatrix2 Multi-dimensinal points \f$\textbf{f}_2\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1)
+		* @param[in] vParams Array of control parameters \f$\{\vec{\theta},\lambda\} \f$
+		* @param[out] potentials %Edge potentials: Mat(size: nEdges x (nStates * nStates); type: CV_32FC1)
+		*/
+		DllExport virtual void	calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const;
 
 
 	private:
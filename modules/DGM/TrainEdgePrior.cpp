@@ -1,4 +1,5 @@
 #include "TrainEdgePrior.h"
+#include "footprint.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
@@ -29,11 +30,28 @@ void CTrainEdgePrior::addFeatureVecs(const Mat &, byte gt1, const Mat &, byte gt
 	CPriorEdge::addEdgeGroundTruth(gt1, gt2);
 }
 
+size_t CTrainEdgePrior::getMemoryUsage(void) const
+{
+	return sizeof(*this) + footprint::getBytes(m_prior) + footprint::getBytes(m_histogramPrior);
+}
+
 void CTrainEdgePrior::train(bool)
 {
 	loadPriorMatrix();
 }
 
+// The worker only accumulates the co-occurance histogram
+std::shared_ptr<CTrainEdge> CTrainEdgePrior::createWorker(void) const
+{
+	return std::make_shared<CTrainEdgePrior>(m_nStates, getNumFeatures());
+}
+
+void CTrainEdgePrior::merge(CTrainEdge &worker)
+{
+	const CTrainEdgePrior &prior = dynamic_cast<const CTrainEdgePrior &>(worker);
+	CPriorEdge::merge(prior);
+}
+
 void CTrainEdgePrior::saveFile(FILE *pFile) const 
 {
 	CPriorEdge::saveFile(pFile);
@@ -52,6 +70,16 @@ Mat	CTrainEdgePrior::calculateEdgePotentials(const Mat &featureVector1, const Ma
 	return res;
 }
 
+void CTrainEdgePrior::calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const
+{
+	CTrainEdgePottsCS::calculateEdgePotentials(featureMatrix1, featureMatrix2, vParams, potentials);
+	const Mat prior = m_prior.isContinuous() ? m_prior.reshape(1, 1) : m_prior.clone().reshape(1, 1);
+	for (int i = 0; i < potentials.rows; i++) {
+		Mat pot = potentials.row(i);
+		multiply(pot, prior, pot);
+	}
+}
+
 inline void CTrainEdgePrior::loadPriorMatrix(void)
 {
 	if (!m_prior.empty()) m_prior.release();
@@ -31,6 +31,9 @@ namespace DirectGraphicalModels
 
 		DllExport virtual void	addFeatureVecs(const Mat &featureVector1, byte gt1, const Mat &featureVector2, byte gt2);
 		DllExport virtual void	train(bool doClean = false);
+		DllExport virtual size_t getMemoryUsage(void) const;
+		DllExport virtual std::shared_ptr<CTrainEdge> createWorker(void) const;
+		DllExport virtual void	merge(CTrainEdge &worker);
 
 	protected:
 		DllExport virtual void 	saveFile(FILE *pFile) const;
@@ -56,6 +59,16 @@ namespace DirectGraphicalModels
 		* @return The edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
 		*/
 		DllExport virtual Mat	calculateEdgePotentials(const Mat &featureVector1, const Mat &featureVector2, const vec_float_t &vParams) const;
+		/**
+		* @brief Calculates the edge potentials for a block of edges
+		* @details The contrast-sensitive potentials of all the edges (Ref. CTrainEdgePottsCS::calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &, Mat &) const)
+		* are multiplied with the edge prior probability
+		* @param[in] featureMatrix1 Multi-dimensinal points \f$\textbf{f}_1\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1)
+		* @param[in] featureMatrix2 Multi-dimensinal points \f$\textbf{f}_2\f$, stored row-wise: Mat(size: nEdges x nFeatures; type: CV_8UC1)
+		* @param[in] vParams Array of control parameters \f$\{\vec{\theta},\lambda\} \f$
+		* @param[out] potentials %Edge potentials: Mat(size: nEdges x (nStates * nStates); type: CV_32FC1)
+		*/
+		DllExport virtual void	calculateEdgePotentials(const Mat &featureMatrix1, const Mat &featureMatrix2, const vec_float_t &vParams, Mat &potentials) const;
 
 
 	private:
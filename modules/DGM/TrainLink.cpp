@@ -1,18 +1,25 @@
 #include "TrainLink.h"
+#include "parallel.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels 
 {
+	const int CTrainLink::BATCH_SIZE = 4096;
+
 	void CTrainLink::addFeatureVec(const Mat &featureVectors, const Mat &gtb, const Mat &gto)
 	{
 		DGM_ASSERT_MSG(featureVectors.channels() == getNumFeatures(), "Number of features in the <featureVectors> (%d) does not correspond to the specified (%d)", featureVectors.channels(), getNumFeatures());
-		DGM_VECTORWISE2<CTrainLink, &CTrainLink::addFeatureVec>(*this, featureVectors, gtb, gto);
+		DGM_ASSERT(featureVectors.size() == gtb.size());
+		DGM_ASSERT(featureVectors.size() == gto.size());
+		addFeatureVecBlock(featureVectors, gtb, gto);
 	}
 	
 	void CTrainLink::addFeatureVec(const vec_mat_t &featureVectors, const Mat &gtb, const Mat &gto)
 	{
 		DGM_ASSERT_MSG(featureVectors.size() == getNumFeatures(), "Number of features in the <featureVectors> (%zu) does not correspond to the specified (%d)", featureVectors.size(), getNumFeatures());
-		DGM_VECTORWISE2<CTrainLink, &CTrainLink::addFeatureVec>(*this, featureVectors, gtb, gto);
+		Mat fv;
+		merge(featureVectors, fv);
+		addFeatureVec(fv, gtb, gto);
 	}
 
 	Mat	CTrainLink::getLinkPotentials(const Mat &featureVector, float weight) const 
@@ -22,4 +29,39 @@ namespace DirectGraphicalModels
 		return res;
 	}
 
+	void CTrainLink::getLinkPotentials(const Mat &featureMatrix, Mat &potentials, float weight) const
+	{
+		DGM_ASSERT_MSG(featureMatrix.cols == getNumFeatures(), "Number of features in the <featureMatrix> (%d) does not correspond to the specified (%d)", featureMatrix.cols, getNumFeatures());
+		DGM_ASSERT(featureMatrix.type() == CV_8UC1);
+
+		const int nStates = m_nStatesBase + m_nStatesOccl;
+		potentials.create(featureMatrix.rows, nStates * nStates, CV_32FC1);
+		const int nBatches = (featureMatrix.rows + BATCH_SIZE - 1) / BATCH_SIZE;
+		parallel::parallelFor(Range(0, nBatches), [&](const Range &range) {
+			Mat pots;
+			for (int b = range.start; b < range.end; b++) {
+				const Range rows(b * BATCH_SIZE, MIN((b + 1) * BATCH_SIZE, featureMatrix.rows));
+				calculateLinkPotentials(featureMatrix.rowRange(rows), pots);
+				DGM_ASSERT(pots.rows == rows.size() && pots.cols == nStates * nStates);
+				if (weight != 1.0f) pow(pots, weight, pots);
+				pots.copyTo(potentials.rowRange(rows));
+			} // b
+		}, 1);
+	}
+
+	void CTrainLink::calculateLinkPotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		const int nStates = m_nStatesBase + m_nStatesOccl;
+		potentials.create(featureMatrix.rows, nStates * nStates, CV_32FC1);
+		for (int i = 0; i < featureMatrix.rows; i++) {
+			Mat pot = calculateLinkPotentials(featureMatrix.row(i).reshape(1, getNumFeatures()));
+			if (!pot.isContinuous()) pot = pot.clone();
+			pot.reshape(1, 1).copyTo(potentials.row(i));
+		} // i
+	}
+
+	void CTrainLink::addFeatureVecBlock(const Mat &featureVectors, const Mat &gtb, const Mat &gto)
+	{
+		DGM_VECTORWISE2<CTrainLink, &CTrainLink::addFeatureVec>(*this, featureVectors, gtb, gto);
+	}
 }
\ No newline at end of file
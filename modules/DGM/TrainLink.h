@@ -24,7 +24,7 @@ namespace DirectGraphicalModels
 		* @param nFeatures Number of features
 		*/
 		DllExport CTrainLink(byte nStatesBase, byte nStatesOccl, word nFeatures) 
-            : CBaseRandomModel(nStatesBase * nStatesOccl)
+            : CBaseRandomModel(nStatesBase * nStatesOccl)
             , ITrain(nStatesBase * nStatesOccl, nFeatures)
 			, m_nStatesBase(nStatesBase)
 			, m_nStatesOccl(nStatesOccl)
@@ -34,7 +34,8 @@ namespace DirectGraphicalModels
 		
 		/**
 		* @brief Adds a block of new feature vectors
-		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gtb and \b gto for training
+		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gtb and \b gto for training.
+		* The whole block is passed to addFeatureVecBlock() at once
 		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC<nFeatures>)
 		* @param gtb Matrix, each element of which is a ground-truth state (class), corresponding to the base layer
 		* @param gto Matrix, each element of which is a ground-truth state (class), corresponding to the occlusion layer
@@ -42,7 +43,8 @@ namespace DirectGraphicalModels
 		DllExport void			addFeatureVec(const Mat &featureVectors, const Mat &gtb, const Mat &gto);
 		/**
 		* @brief Adds a block of new feature vectors
-		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gtb and \b gto for training
+		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gtb and \b gto for training.
+		* The feature images are interleaved and passed to addFeatureVecBlock() at once
 		* @param featureVectors Vector of size \a nFeatures, each element of which is a single feature - image: Mat(type: CV_8UC1)
 		* @param gtb Matrix, each element of which is a ground-truth state (class), corresponding to the base layer
 		* @param gto Matrix, each element of which is a ground-truth state (class), corresponding to the occlusion layer
@@ -67,6 +69,17 @@ namespace DirectGraphicalModels
 		* @return %Edge potentials on success: Mat(size: nStates x nStates; type: CV_32FC1)
 		*/
 		DllExport Mat			getLinkPotentials(const Mat &featureVector, float weight = 1.0f) const;
+		/**
+		* @brief Returns the link potentials, based on the block of feature vectors
+		* @details This function calculates the potentials of \a nSamples links at once with calculateLinkPotentials(const Mat &, Mat &) const.
+		* The samples are split into batches, which are processed in parallel. After that, the resulting potentials are powered by parameter \b weight.
+		* > This function supports PPL
+		* @param[in] featureMatrix Multi-dimensinal points, stored row-wise: Mat(size: nSamples x nFeatures; type: CV_8UC1)
+		* @param[out] potentials %Edge potentials: Mat(size: nSamples x nStates<sup>2</sup>; type: CV_32FC1), where every row is the edge potential matrix
+		* of one link and \a nStates = \a nStatesBase + \a nStatesOccl
+		* @param weight The weighting parameter
+		*/
+		DllExport void			getLinkPotentials(const Mat &featureMatrix, Mat &potentials, float weight = 1.0f) const;
 
 
 	protected:
@@ -81,10 +94,32 @@ namespace DirectGraphicalModels
 		* @returns The edge potential matrix: Mat(size: nStates x nStates; type: CV_32FC1)
 		*/
 		DllExport virtual Mat	calculateLinkPotentials(const Mat &featureVector) const = 0;
+		/**
+		* @brief Calculates the link potentials, based on the block of feature vectors
+		* @details The default implementation calls calculateLinkPotentials(const Mat &) const for every sample; the derived classes may override it
+		* in order to use the batch prediction of the underlying model.
+		* @param[in] featureMatrix Multi-dimensinal points, stored row-wise: Mat(size: nSamples x nFeatures; type: CV_8UC1)
+		* @param[out] potentials %Edge potentials: Mat(size: nSamples x nStates<sup>2</sup>; type: CV_32FC1)
+		*/
+		DllExport virtual void	calculateLinkPotentials(const Mat &featureMatrix, Mat &potentials) const;
+		/**
+		* @brief Adds a block of new feature vectors
+		* @details This function is called by addFeatureVec(const Mat &, const Mat &, const Mat &) and addFeatureVec(const vec_mat_t &, const Mat &, const Mat &).
+		* The default implementation calls addFeatureVec(const Mat &, byte, byte) for every pixel; the derived classes may override it in order
+		* to pass the whole block to the underlying model.
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC<nFeatures>)
+		* @param gtb Matrix, each element of which is a ground-truth state (class), corresponding to the base layer: Mat(type: CV_8UC1)
+		* @param gto Matrix, each element of which is a ground-truth state (class), corresponding to the occlusion layer: Mat(type: CV_8UC1)
+		*/
+		DllExport virtual void	addFeatureVecBlock(const Mat &featureVectors, const Mat &gtb, const Mat &gto);
 
 
 	protected:
 		byte m_nStatesBase;		///< Number of states (classes) at the base layer of ML-CRF
 		byte m_nStatesOccl;		///< Number of states (classes) at the occlusion layerts of ML-CRF
+
+
+	private:
+		static const int BATCH_SIZE;	///< The desired number of samples, passed to calculateLinkPotentials(const Mat &, Mat &) const at once
 	};
 }
@@ -89,6 +89,20 @@ namespace DirectGraphicalModels
 	protected:
 		DllExport virtual void	saveFile(FILE *pFile) const {}
 		DllExport virtual void	loadFile(FILE *pFile) {}
+		virtual void	addFeatureVecBlock(const Mat &featureVectors, const Mat &gtb, const Mat &gto)
+		{
+			// The ground-truth states of both layers are united into one state of the nested trainer, which accumulates the whole block
+			Mat gt(gtb.size(), CV_8UC1);
+			for (int y = 0; y < gt.rows; y++) {
+				const byte *pGtb = gtb.ptr<byte>(y);
+				const byte *pGto = gto.ptr<byte>(y);
+				byte	   *pGt	 = gt.ptr<byte>(y);
+				for (int x = 0; x < gt.cols; x++) pGt[x] = pGtb[x] + m_nStatesBase * pGto[x];
+			} // y
+			m_pPrior->addNodeGroundTruth(gt);
+			m_pTrainer->addFeatureVecs(featureVectors, gt);
+		}
+
 		/**
 		* @brief Returns the data-dependent link (inter-layer edge) potentials
 		* @details This function returns edge potential matrix, which elements are obrained from the unary potential vector:
@@ -99,7 +113,7 @@ namespace DirectGraphicalModels
 		*/
 		virtual Mat	calculateLinkPotentials(const Mat &featureVector) const
 		{
-			Mat pot = m_pTrainer->getNodePotentials(featureVector);
+			Mat pot = m_pTrainer->getNodePotentials(featureVector, 1.0f);
 			//pot = m_pPrior->getPrior(100);
 
 			DGM_ASSERT_MSG(pot.rows == m_nStatesBase * m_nStatesOccl, "The length of the node potentinal vector = %d, but must be %d", pot.rows, m_nStatesBase * m_nStatesOccl);
@@ -117,6 +131,30 @@ namespace DirectGraphicalModels
 			return res;
 		}
 
+		/**
+		* @brief Returns the data-dependent link (inter-layer edge) potentials for a block of feature vectors
+		* @details The node potentials of all the samples are calculated at once with CTrainNode::getNodePotentials(const Mat &, const Mat &, float, const Mat &) const
+		* and arranged in the same way as in calculateLinkPotentials(const Mat &) const
+		* @param[in] featureMatrix Multi-dimensinal points, stored row-wise: Mat(size: nSamples x nFeatures; type: CV_8UC1)
+		* @param[out] potentials %Edge potentials: Mat(size: nSamples x nStates<sup>2</sup>; type: CV_32FC1)
+		*/
+		virtual void calculateLinkPotentials(const Mat &featureMatrix, Mat &potentials) const
+		{
+			const int nStates = m_nStatesBase + m_nStatesOccl;
+			const Mat fm  = featureMatrix.isContinuous() ? featureMatrix : featureMatrix.clone();
+			const Mat pot = m_pTrainer->getNodePotentials(fm.reshape(getNumFeatures()));		// Mat(size: nSamples x 1; type: CV_32FC(nStatesBase * nStatesOccl))
+
+			potentials.create(featureMatrix.rows, nStates * nStates, CV_32FC1);
+			potentials.setTo(0);
+			for (int i = 0; i < potentials.rows; i++) {
+				const float *pPot = pot.ptr<float>(i);
+				float		*pRes = potentials.ptr<float>(i);
+				for (byte gto = 0; gto < m_nStatesOccl; gto++)
+					for (byte gtb = 0; gtb < m_nStatesBase; gtb++)
+						pRes[(m_nStatesBase + gto) * nStates + gtb] = pPot[gtb + m_nStatesBase * gto];
+			} // i
+		}
+
 	//	CPriorNode * getPrior(void) const { return m_pPrior; }
 	//	CTrainNode * getTrainer(void) const { return m_pTrainer; }
 
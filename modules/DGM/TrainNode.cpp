@@ -12,10 +12,23 @@
 #include "TrainNodeCvANN.h"
 #include "TrainNodeCvSVM.h"
 
+#include "ThreadPool.h"
 #include "macroses.h"
+#include <future>
+#include <map>
 
 namespace DirectGraphicalModels
 {
+	// Constants
+	const int CTrainNode::MIN_WORKER_PIXELS = 16384;
+	const int CTrainNode::BATCH_SIZE		= 4096;
+
+	namespace {
+		// The node trainers, registered by the other modules
+		std::map<byte, CTrainNode::creator_function_t>	&	getRegistry(void)	{ static std::map<byte, CTrainNode::creator_function_t> registry;	return registry; }
+		std::mutex										&	getRegistryMutex(void)	{ static std::mutex mtx; return mtx; }
+	}
+
 	// Factory method
 	std::shared_ptr<CTrainNode> CTrainNode::create(byte nodeRandomModel, byte nStates, word nFeatures)
 	{
@@ -34,24 +47,103 @@ namespace DirectGraphicalModels
 #endif
 		case NodeRandomModel::CvANN:	return std::make_shared<CTrainNodeCvANN>(nStates, nFeatures);		
 		case NodeRandomModel::CvSVM:	return std::make_shared<CTrainNodeCvSVM>(nStates, nFeatures);		
-		default:
-			DGM_ASSERT_MSG(false, "Unknown type of the node random model");
+		default: {
+			std::lock_guard<std::mutex> lock(getRegistryMutex());
+			auto it = getRegistry().find(nodeRandomModel);
+			DGM_ASSERT_MSG(it != getRegistry().end(), "Unknown type of the node random model");
+			return it->second(nStates, nFeatures);
 		}
+		}
+	}
+
+	void CTrainNode::registerModel(byte nodeRandomModel, creator_function_t creator)
+	{
+		std::lock_guard<std::mutex> lock(getRegistryMutex());
+		getRegistry()[nodeRandomModel] = std::move(creator);
 	}
 
 	void CTrainNode::addFeatureVecs(const Mat &featureVectors, const Mat &gt)
 	{
 		DGM_ASSERT_MSG(featureVectors.channels() == getNumFeatures(), "Number of features in the <featureVectors> (%d) does not correspond to the specified (%d)", featureVectors.channels(), getNumFeatures());
-		DGM_VECTORWISE1<CTrainNode, &CTrainNode::addFeatureVec>(*this, featureVectors, gt);
+#ifdef ENABLE_PDP
+		if (addStripes(gt.size(), [&](CTrainNode &worker, const Range &rows) { worker.addFeatureVecBlock(featureVectors.rowRange(rows), gt.rowRange(rows)); })) return;
+#endif
+		addFeatureVecBlock(featureVectors, gt);
 	}
 
 	void CTrainNode::addFeatureVecs(const vec_mat_t &featureVectors, const Mat &gt)
 	{
 		DGM_ASSERT_MSG(featureVectors.size() == getNumFeatures(), "Number of features in the <featureVectors> (%zu) does not correspond to the specified (%d)", featureVectors.size(), getNumFeatures());
-		DGM_VECTORWISE1<CTrainNode, &CTrainNode::addFeatureVec>(*this, featureVectors, gt);
+#ifdef ENABLE_PDP
+		if (addStripes(gt.size(), [&](CTrainNode &worker, const Range &rows) { DGM_BLOCKWISE1<CTrainNode, &CTrainNode::addFeatureVecBlock>(worker, featureVectors, gt, rows); })) return;
+#endif
+		DGM_BLOCKWISE1<CTrainNode, &CTrainNode::addFeatureVecBlock>(*this, featureVectors, gt);
+	}
+
+	void CTrainNode::addFeatureVecs(const std::string &fileName, size_t chunkSize)
+	{
+		DGM_ASSERT(chunkSize > 0);
+		FILE *pFile = fopen(fileName.c_str(), "rb");
+		DGM_ASSERT_MSG(pFile, "Can't load data from %s", fileName.c_str());
+
+		word nFeatures = 0;
+		fread(&nFeatures, sizeof(word), 1, pFile);
+		DGM_ASSERT_MSG(nFeatures == getNumFeatures(), "Number of features in the sample store (%d) does not correspond to the specified (%d)", nFeatures, getNumFeatures());
+
+		const size_t recordSize = nFeatures + 1;									// the feature vector and the ground-truth
+		vec_byte_t	 vRecords(chunkSize * recordSize);
+		Mat			 featureVectors(static_cast<int>(chunkSize), 1, CV_8UC(nFeatures));
+		Mat			 gt(static_cast<int>(chunkSize), 1, CV_8UC1);
+		for (;;) {
+			const size_t nSamples = fread(vRecords.data(), recordSize, chunkSize, pFile);
+			if (nSamples == 0) break;
+			for (size_t i = 0; i < nSamples; i++) {
+				const byte *pRecord = vRecords.data() + i * recordSize;
+				memcpy(featureVectors.ptr<byte>(static_cast<int>(i)), pRecord, nFeatures);
+				gt.at<byte>(static_cast<int>(i), 0) = pRecord[nFeatures];
+			} // i
+			const Range rows(0, static_cast<int>(nSamples));
+			addFeatureVecs(featureVectors.rowRange(rows), gt.rowRange(rows));
+		}
+		fclose(pFile);
 	}
 
-	Mat	CTrainNode::getNodePotentials(const Mat& featureVectors, const Mat& weights, float Z) const
+	void CTrainNode::appendFeatureVecs(const std::string &fileName, const Mat &featureVectors, const Mat &gt)
+	{
+		DGM_ASSERT(featureVectors.size() == gt.size());
+		DGM_ASSERT(featureVectors.depth() == CV_8U);
+		DGM_ASSERT(gt.type() == CV_8UC1);
+		const word nFeatures = static_cast<word>(featureVectors.channels());
+
+		FILE *pFile = fopen(fileName.c_str(), "r+b");
+		if (pFile) {
+			word nStoredFeatures = 0;
+			fread(&nStoredFeatures, sizeof(word), 1, pFile);
+			DGM_ASSERT_MSG(nStoredFeatures == nFeatures, "Number of features in the <featureVectors> (%d) does not correspond to the sample store (%d)", nFeatures, nStoredFeatures);
+			fseek(pFile, 0, SEEK_END);
+		}
+		else {
+			pFile = fopen(fileName.c_str(), "wb");
+			DGM_ASSERT_MSG(pFile, "Can't create file %s", fileName.c_str());
+			fwrite(&nFeatures, sizeof(word), 1, pFile);
+		}
+
+		const size_t recordSize = nFeatures + 1;
+		vec_byte_t	 vRecords(gt.cols * recordSize);
+		for (int y = 0; y < gt.rows; y++) {
+			const byte *pFv = featureVectors.ptr<byte>(y);
+			const byte *pGt = gt.ptr<byte>(y);
+			for (int x = 0; x < gt.cols; x++) {
+				byte *pRecord = vRecords.data() + x * recordSize;
+				memcpy(pRecord, pFv + x * nFeatures, nFeatures);
+				pRecord[nFeatures] = pGt[x];
+			} // x
+			fwrite(vRecords.data(), recordSize, gt.cols, pFile);
+		} // y
+		fclose(pFile);
+	}
+
+	Mat	CTrainNode::getNodePotentials(const Mat& featureVectors, const Mat& weights, float Z, const Mat &mask) const
 	{
 		// Assertions
 		DGM_ASSERT_MSG(featureVectors.channels() == getNumFeatures(), "Number of features in the <featureVectors> (%d) does not correspond to the specified (%d)", featureVectors.channels(), getNumFeatures());
@@ -60,30 +152,25 @@ namespace DirectGraphicalModels
 			DGM_ASSERT(featureVectors.size() == weights.size());
 			DGM_ASSERT(weights.type() == CV_32FC1);
 		}
+		if (!mask.empty()) {
+			DGM_ASSERT(featureVectors.size() == mask.size());
+			DGM_ASSERT(mask.type() == CV_8UC1);
+			return getMaskedNodePotentials(featureVectors, weights, Z, mask);
+		}
 
 		Mat res(featureVectors.size(), CV_32FC(m_nStates));
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, res.rows), [&](const Range& range) {
-#else
-		const Range range(0, res.rows);
-#endif
-		Mat pot;
-		Mat vec(getNumFeatures(), 1, CV_8UC1);
-
-		for (int y =  range.start; y < range.end; y++) {
-			const byte* pFv = featureVectors.ptr<byte>(y);
-			const float* pW = weights.empty() ? NULL : weights.ptr<float>(y);
-			float* pRes = res.ptr<float>(y);
-			for (int x = 0; x < res.cols; x++) {
-				float weight = pW ? pW[x] : 1.0f;
-				for (int f = 0; f < getNumFeatures(); f++) vec.at<byte>(f, 0) = pFv[getNumFeatures() * x + f];
-				pot = getNodePotentials(vec, weight, Z);
-				for (int s = 0; s < m_nStates; s++) pRes[m_nStates * x + s] = pot.at<float>(s, 0);
-			} // x
-		} // y	
-#ifdef ENABLE_PDP
-		});
-#endif
+		// Several rows form one batch, if they are stored continuously
+		const int nRows		= featureVectors.isContinuous() && (weights.empty() || weights.isContinuous()) ? MAX(1, BATCH_SIZE / MAX(1, res.cols)) : 1;
+		const int nBatches	= (res.rows + nRows - 1) / nRows;
+		parallel::parallelFor(Range(0, nBatches), [&](const Range& range) {
+			Mat pot;
+			for (int b = range.start; b < range.end; b++) {
+				const int y = b * nRows;
+				const Mat featureMatrix(MIN(nRows, res.rows - y) * res.cols, getNumFeatures(), CV_8UC1, const_cast<byte *>(featureVectors.ptr<byte>(y)));
+				calculateNodePotentials(featureMatrix, pot);
+				normalize(pot, weights.empty() ? NULL : weights.ptr<float>(y), Z, res.ptr<float>(y));
+			} // b
+		}, 1);
 
 		return res;
 	}
@@ -98,29 +185,28 @@ namespace DirectGraphicalModels
 		}
 
 		Mat res(featureVectors[0].size(), CV_32FC(m_nStates));
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, res.rows), [&](const Range& range) {
-#else
-		const Range range(0, res.rows);
-#endif
-		Mat pot;
-		Mat vec(getNumFeatures(), 1, CV_8UC1);
-		for (int y = range.start; y < range.end; y++) {
-			const byte  **pFv = new const byte *[getNumFeatures()];
-			for (word f = 0; f < getNumFeatures(); f++) pFv[f] = featureVectors[f].ptr<byte>(y);
-			const float *pW = weights.empty() ? NULL : weights.ptr<float>(y);
-			float		*pRes = res.ptr<float>(y);
-			for (int x = 0; x < res.cols; x++) {
-				float weight = pW ? pW[x] : 1.0f;
-				for (int f = 0; f < getNumFeatures(); f++) vec.at<byte>(f, 0) = pFv[f][x];
-				pot = getNodePotentials(vec, weight, Z);
-				for (int s = 0; s < m_nStates; s++) pRes[m_nStates * x + s] = pot.at<float>(s, 0);
-			} // x
-			delete[] pFv;
-		} // y	
-#ifdef ENABLE_PDP
-		});
-#endif
+		// The features are gathered into batches of several rows
+		const int nRows		= weights.empty() || weights.isContinuous() ? MAX(1, BATCH_SIZE / MAX(1, res.cols)) : 1;
+		const int nBatches	= (res.rows + nRows - 1) / nRows;
+		parallel::parallelFor(Range(0, nBatches), [&](const Range& range) {
+			Mat pot;
+			Mat featureMatrix;
+			std::vector<const byte *> vpFv(getNumFeatures());
+			for (int b = range.start; b < range.end; b++) {
+				const int y0 = b * nRows;
+				const int y1 = MIN(y0 + nRows, res.rows);
+				featureMatrix.create((y1 - y0) * res.cols, getNumFeatures(), CV_8UC1);
+				for (int y = y0; y < y1; y++) {
+					for (word f = 0; f < getNumFeatures(); f++) vpFv[f] = featureVectors[f].ptr<byte>(y);
+					for (int x = 0; x < res.cols; x++) {
+						byte *pFm = featureMatrix.ptr<byte>((y - y0) * res.cols + x);
+						for (word f = 0; f < getNumFeatures(); f++) pFm[f] = vpFv[f][x];
+					} // x
+				} // y
+				calculateNodePotentials(featureMatrix, pot);
+				normalize(pot, weights.empty() ? NULL : weights.ptr<float>(y0), Z, res.ptr<float>(y0));
+			} // b
+		}, 1);
 
 		return res;
 	}
@@ -151,4 +237,151 @@ namespace DirectGraphicalModels
 
 		return res;
 	}
-}
+
+	// The futures are joined before they are replaced, so that a callback is never called concurrently with itself
+	void CTrainNode::streamNodePotentials(Size rasterSize, Size tileSize, const features_function_t &features, const potentials_function_t &sink, float Z) const
+	{
+		DGM_ASSERT(features && sink);
+		DGM_ASSERT_MSG(tileSize.width > 0 && tileSize.height > 0, "Wrong tile size: (%d, %d)", tileSize.width, tileSize.height);
+
+		std::vector<Rect> vTiles;
+		for (int y = 0; y < rasterSize.height; y += tileSize.height)
+			for (int x = 0; x < rasterSize.width; x += tileSize.width)
+				vTiles.emplace_back(x, y, MIN(tileSize.width, rasterSize.width - x), MIN(tileSize.height, rasterSize.height - y));
+		if (vTiles.empty()) return;
+
+		std::future<Mat>	nextFeatures = std::async(std::launch::async, features, vTiles[0]);
+		std::future<void>	lastSink;
+		for (size_t t = 0; t < vTiles.size(); t++) {
+			const Rect &roi = vTiles[t];
+			Mat featureVectors = nextFeatures.get();
+			DGM_ASSERT_MSG(featureVectors.size() == roi.size(), "The features of the tile (%d, %d) have wrong size: (%d, %d)", roi.x, roi.y, featureVectors.cols, featureVectors.rows);
+			if (t + 1 < vTiles.size()) nextFeatures = std::async(std::launch::async, features, vTiles[t + 1]);
+
+			Mat pot = getNodePotentials(featureVectors, Mat(), Z);
+			featureVectors.release();
+			if (lastSink.valid()) lastSink.get();
+			lastSink = std::async(std::launch::async, [&sink, roi, pot] { sink(roi, pot); });
+		} // t
+		lastSink.get();
+	}
+
+	void CTrainNode::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+		Mat pot(m_nStates, 1, CV_32FC1);
+		Mat mask(m_nStates, 1, CV_8UC1);
+		for (int i = 0; i < featureMatrix.rows; i++) {
+			pot.setTo(0);
+			mask.setTo(1);
+			calculateNodePotentials(featureMatrix.row(i).reshape(1, getNumFeatures()), pot, mask);
+			const float *pPot	 = reinterpret_cast<const float *>(pot.data);						// the derived classes may re-shape the potential
+			float		*pRes	 = potentials.ptr<float>(i);
+			for (byte s = 0; s < m_nStates; s++) pRes[s] = mask.at<byte>(s, 0) ? pPot[s] : -1.0f;
+		} // i
+	}
+
+	void CTrainNode::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		DGM_VECTORWISE1<CTrainNode, &CTrainNode::addFeatureVec>(*this, featureVectors, gt);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The stripes are processed in waves of as many stripes as there are threads: every worker accumulates one stripe and is merged after its wave,
+	// thus the sequence of the accumulations and the merges is the same for any number of threads
+	bool CTrainNode::addStripes(Size size, const std::function<void(CTrainNode &worker, const Range &rows)> &add)
+	{
+#ifdef ENABLE_PDP
+		const int nStripes = MIN(size.area() / MIN_WORKER_PIXELS, size.height);
+		if (nStripes < 2) return false;
+		std::shared_ptr<CTrainNode> pWorker = createWorker();
+		if (!pWorker) return false;
+
+		const int nWave = static_cast<int>(CThreadPool::getDefault().getNumThreads());
+		for (int first = 0; first < nStripes; first += nWave) {
+			const int last = MIN(first + nWave, nStripes);
+			std::vector<std::shared_ptr<CTrainNode>> vpWorkers(last - first);
+			for (int w = MAX(1, first); w < last; w++) {
+				vpWorkers[w - first] = pWorker ? pWorker : createWorker();
+				pWorker.reset();
+			}
+			parallel::parallelFor(Range(first, last), [&](const Range &range) {
+				for (int w = range.start; w < range.end; w++) {
+					const Range rows(size.height * w / nStripes, size.height * (w + 1) / nStripes);
+					add(w ? *vpWorkers[w - first] : *this, rows);					// the first stripe is accumulated by this node trainer
+				} // w
+			}, 1);
+			for (auto &pStripeWorker : vpWorkers) if (pStripeWorker) merge(*pStripeWorker);
+		} // first
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// The valid pixels of every batch of rows are gathered into one feature matrix and their potentials are scattered back
+	Mat CTrainNode::getMaskedNodePotentials(const Mat &featureVectors, const Mat &weights, float Z, const Mat &mask) const
+	{
+		const word	nFeatures	= getNumFeatures();
+		const int	nRows		= MAX(1, BATCH_SIZE / MAX(1, featureVectors.cols));
+		const int	nBatches	= (featureVectors.rows + nRows - 1) / nRows;
+
+		Mat res(featureVectors.size(), CV_32FC(m_nStates), Scalar::all(0));
+		parallel::parallelFor(Range(0, nBatches), [&](const Range &range) {
+			Mat			pot, featureMatrix;
+			vec_float_t	vWeights, vPot;
+			vec_int_t	vIdx;
+			for (int b = range.start; b < range.end; b++) {
+				const int y0 = b * nRows;
+				const int y1 = MIN(y0 + nRows, res.rows);
+				vIdx.clear();
+				for (int y = y0; y < y1; y++) {
+					const byte *pMask = mask.ptr<byte>(y);
+					for (int x = 0; x < res.cols; x++) if (pMask[x]) vIdx.push_back(y * res.cols + x);
+				}
+				if (vIdx.empty()) continue;
+
+				const int n = static_cast<int>(vIdx.size());
+				featureMatrix.create(n, nFeatures, CV_8UC1);
+				vWeights.resize(n);
+				for (int i = 0; i < n; i++) {
+					const int y = vIdx[i] / res.cols;
+					const int x = vIdx[i] % res.cols;
+					memcpy(featureMatrix.ptr<byte>(i), featureVectors.ptr<byte>(y) + x * nFeatures, nFeatures);
+					if (!weights.empty()) vWeights[i] = weights.at<float>(y, x);
+				}
+				calculateNodePotentials(featureMatrix, pot);
+				vPot.resize(n * m_nStates);
+				normalize(pot, weights.empty() ? NULL : vWeights.data(), Z, vPot.data());
+				for (int i = 0; i < n; i++)
+					memcpy(res.ptr<float>(vIdx[i] / res.cols) + (vIdx[i] % res.cols) * m_nStates, vPot.data() + i * m_nStates, m_nStates * sizeof(float));
+			} // b
+		}, 1);
+
+		return res;
+	}
+
+	void CTrainNode::normalize(const Mat &potentials, const float *pWeights, float Z, float *pRes) const
+	{
+		for (int i = 0; i < potentials.rows; i++) {
+			const float *pPot	= potentials.ptr<float>(i);
+			const float	 weight = pWeights ? pWeights[i] : 1.0f;
+			float		*res	= pRes + i * m_nStates;
+
+			float Sum = 0;
+			for (byte s = 0; s < m_nStates; s++) {
+				res[s] = MAX(0.0f, pPot[s]);
+				if (weight != 1.0f) res[s] = powf(res[s], weight);
+				Sum += res[s];
+			}
+
+			if (Sum < FLT_EPSILON) {																	// Case of too small potentials (make all the cases equaly small probable)
+				for (byte s = 0; s < m_nStates; s++) if (pPot[s] >= 0) res[s] = FLT_EPSILON;
+			}
+			else {
+				const float k = 100.0f / (Z > FLT_EPSILON ? Z : Sum);
+				for (byte s = 0; s < m_nStates; s++) res[s] *= k;
+			}
+		} // i
+	}
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ITrain.h"
+#include <functional>
 
 namespace DirectGraphicalModels
 {
@@ -20,6 +21,7 @@ namespace DirectGraphicalModels
 
 		GM, 					///< Gaussian Model
 		CvGM, 					///< OpenCV Gaussian Model
+		DNN,					///< Multilayer perceptron of the DNN module (Ref. @ref CTrainNodeDNN). Available, if the application is linked with the DNN module
 	 };
 
 	// ============================= Node Train Class =============================
@@ -46,7 +48,21 @@ namespace DirectGraphicalModels
 	*/
 	class CTrainNode : public ITrain
 	{
+		template<class Trainer, class Concatenator> friend class CTrainEdgeConcat;	// uses the workers of the nested node trainer
+		friend class CTrainNodeCascade;												// uses the protected interface of the stages
+
 	public:
+		/**
+		* @brief Callback function returning the feature vectors of the region
+		* @details The argument is the region of the raster; the result is Mat(size: region size; type: CV_8UC(nFeatures))
+		*/
+		using features_function_t	= std::function<Mat(const Rect &)>;
+		/**
+		* @brief Callback function receiving the node potentials of the region
+		* @details The arguments are the region of the raster and the node potentials: Mat(size: region size; type: CV_32FC(nStates))
+		*/
+		using potentials_function_t	= std::function<void(const Rect &, const Mat &)>;
+
 		/**
 		* @brief Constructor
 		* @param nStates Number of states (classes)
@@ -69,20 +85,54 @@ namespace DirectGraphicalModels
 		*/
 		DllExport static std::shared_ptr<CTrainNode> create(byte nodeRandomModel, byte nStates, word nFeatures);
 		/**
+		* @brief The function, creating a node trainer object with default parameters
+		* @details Its arguments are the same as the last two arguments of the create() function
+		*/
+		using creator_function_t = std::function<std::shared_ptr<CTrainNode>(byte nStates, word nFeatures)>;
+		/**
+		* @brief Registers a node trainer, implemented outside the DGM module, in the factory method
+		* @details This allows the other modules, \a e.g. the DNN module, which depend on the DGM module, to add their node trainers to the create() function.
+		* The modules register their node trainers, when they are loaded.
+		* @param nodeRandomModel Type of the random model (Ref. @ref NodeRandomModel)
+		* @param creator The function, creating the node trainer object
+		*/
+		DllExport static void registerModel(byte nodeRandomModel, creator_function_t creator);
+		/**
 		* @brief Adds a block of new feature vectors
-		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gt for training
+		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gt for training.
+		* If the node trainer supports workers (Ref. createWorker()), large blocks are split into horizontal stripes of a fixed size, which are accumulated
+		* in parallel and merged together in the order of the stripes. Thus, the result does not depend on the number of threads.
 		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC(nFeatures))
 		* @param gt Matrix, each element of which is a ground-truth state (class)
 		*/			
 		DllExport void			addFeatureVecs(const Mat &featureVectors, const Mat &gt);
 		/**
 		* @brief Adds a block of new feature vectors
-		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gt for training
+		* @details Used to add multiple \b featureVectors, corresponding to the ground-truth states (classes) \b gt for training. The features of several rows
+		* are gathered into one interleaved block (ref. DGM_BLOCKWISE1()), which is passed to addFeatureVecBlock()
 		* @param featureVectors Vector of size \a nFeatures, each element of which is a single feature - image: Mat(type: CV_8UC1)
 		* @param gt Matrix, each element of which is a ground-truth state (class)
 		*/
 		DllExport void			addFeatureVecs(const vec_mat_t &featureVectors, const Mat &gt);
 		/**
+		* @brief Adds the feature vectors from a sample store
+		* @details Streams the samples from the file, written with the appendFeatureVecs() function, chunk by chunk, and passes every chunk to 
+		* addFeatureVecs(const Mat &, const Mat &). Thus, the memory consumption does not depend on the size of the sample store.
+		* @param fileName The name of the sample store file
+		* @param chunkSize The number of samples, read from the file at once
+		*/
+		DllExport void			addFeatureVecs(const std::string &fileName, size_t chunkSize = 65536);
+		/**
+		* @brief Appends a block of feature vectors to a sample store
+		* @details The sample store is a binary file, which starts with the number of features (word) followed by the samples, 
+		* each of which is stored as \a nFeatures bytes of the feature vector and one byte of the ground-truth state (class).
+		* If the file does not exist, it is created.
+		* @param fileName The name of the sample store file
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC(nFeatures))
+		* @param gt Matrix, each element of which is a ground-truth state (class)
+		*/
+		DllExport static void	appendFeatureVecs(const std::string &fileName, const Mat &featureVectors, const Mat &gt);
+		/**
 		* @brief Adds new feature vector
 		* @details Used to add a \b featureVector, corresponding to the ground-truth state (class) \b gt for training
 		* @param featureVector Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1)
@@ -92,13 +142,17 @@ namespace DirectGraphicalModels
 		DllExport virtual void	train(bool doClean = false) {}
 		/**
 		* @brief Returns a block of node potentials, based on the block of feature vector
+		* @details If the \b mask is given, only the feature vectors of the valid pixels are gathered and classified, thus the computation scales with the valid area
+		* of the block, \a e.g. when the no-data regions of a tile are excluded from the graph (ref. CGraphSuperpixelExt::getPixelLabels()).
 		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC(nFeatures))
 		* @param weights The block of weighting parameters Mat(type: CV_32FC1). If empty, values 1 are used.
 		* @param Z The value of <a href="https://en.wikipedia.org/wiki/Partition_function_(statistical_mechanics)">partition function</a>.
 		* In order to convert potential to the probability, it is multiplied by \f$1/Z\f$.
 		* If \f$Z\leq0\f$, the resulting node potentials are normalized to 100, independently for each potential.
+		* @param mask The mask of valid pixels: Mat(size: featureVectors.size(); type: CV_8UC1). The node potentials of the pixels with zero mask are set to 0. 
+		* If empty, all the pixels are classified.
 		*/
-		DllExport Mat			getNodePotentials(const Mat &featureVectors, const Mat &weights = Mat(), float Z = 0.0f) const;
+		DllExport Mat			getNodePotentials(const Mat &featureVectors, const Mat &weights = Mat(), float Z = 0.0f, const Mat &mask = Mat()) const;
 		/**
 		* @brief Returns a block of node potentials, based on the block of feature vector
 		* @param featureVectors Vector of size \a nFeatures, each element of which is a single feature - image: Mat(type: CV_8UC1)
@@ -120,6 +174,27 @@ namespace DirectGraphicalModels
 		* @return Normalized %node potentials on success: Mat(size: nStates x 1; type: CV_32FC1); 
 		*/		
 		DllExport Mat			getNodePotentials(const Mat &featureVector, float weight, float Z = 0.0f) const;
+		/**
+		* @brief Calculates the node potentials of a large raster tile by tile
+		* @details The raster is split into the tiles of the given size, which are processed as a pipeline in the row-major order: while the potentials of one tile are 
+		* calculated in parallel with getNodePotentials(const Mat &, const Mat &, float) const, the features of the next tile are requested and the potentials of the previous
+		* tile are passed to the sink in the background. Thus, at most two tiles of features and two tiles of potentials are held in memory, and the raster may be disk-backed:
+		* @code
+		* std::shared_ptr<const void> pStorage;
+		* Mat features = Serialize::map("features.dat", pStorage);									// Mat(type: CV_8UC(nFeatures))
+		* Serialize::CTileWriter writer("potentials.dat", features.size(), CV_32FC(nStates));
+		* nodeTrainer->streamNodePotentials(features.size(), Size(1024, 256), 
+		*	[&](const Rect &roi) { return features(roi); }, 
+		*	[&](const Rect &roi, const Mat &pot) { writer.write(pot, roi.tl()); });
+		* @endcode
+		* @param rasterSize The size of the raster
+		* @param tileSize The size of the tiles. The tiles of the last row and column may be smaller
+		* @param features The callback function, which returns the feature vectors of a tile. The calls are sequential in the order of the tiles
+		* @param sink The callback function, which receives the node potentials of a tile. The calls are sequential in the order of the tiles
+		* @param Z The value of <a href="https://en.wikipedia.org/wiki/Partition_function_(statistical_mechanics)">partition function</a>.
+		* If \f$Z\leq0\f$, the resulting node potentials are normalized to 100, independently for each potential.
+		*/
+		DllExport void			streamNodePotentials(Size rasterSize, Size tileSize, const features_function_t &features, const potentials_function_t &sink, float Z = 0.0f) const;
 
 
 	protected:
@@ -133,9 +208,75 @@ namespace DirectGraphicalModels
 		* @param[in,out]	mask Relevant %Node potentials: Mat(size: nStates x 1; type: CV_8UC1). This parameter should be preinitialized and set to value 1 (all potentials are relevant).
 		*/		
 		DllExport virtual void calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const = 0;
+		/**
+		* @brief Calculates the node potentials, based on the block of feature vectors
+		* @details This function calculates the potentials of  nSamples nodes at once. The default implementation calls 
+		* calculateNodePotentials(const Mat &, Mat &, Mat &) const for every sample; the derived classes may override it 
+		* in order to use the batch prediction of the underlying classifier.
+		* @param[in]	featureMatrix Multi-dimensinal points, stored row-wise: Mat(size: nSamples x nFeatures; type: CV_8UC1)
+		* @param[out]	potentials %Node potentials: Mat(size: nSamples x nStates; type: CV_32FC1). The irrelevant potentials 
+		* (the ones, masked out in the per-sample function) are marked with negative values.
+		*/
+		DllExport virtual void calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		/**
+		* @brief Adds a block of new feature vectors
+		* @details This function is called by addFeatureVecs(const Mat &, const Mat &) for the whole block or for each of its stripes, and by
+		* addFeatureVecs(const vec_mat_t &, const Mat &) for the gathered blocks of rows. The default
+		* implementation calls addFeatureVec() for every pixel; the derived classes may override it in order to store the feature vectors directly
+		* from the block.
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC(nFeatures))
+		* @param gt Matrix, each element of which is a ground-truth state (class): Mat(type: CV_8UC1)
+		*/
+		DllExport virtual void addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		/**
+		* @brief Creates a worker for the parallel accumulation of the feature vectors
+		* @details The worker is an empty node trainer, which is able to accumulate the feature vectors with addFeatureVec() independently from this one.
+		* The accumulated data is then merged into this node trainer with the merge() function. The default implementation returns an empty pointer,
+		* meaning that the node trainer does not support the parallel accumulation.
+		* @return The pointer to the worker or an empty pointer
+		*/
+		DllExport virtual std::shared_ptr<CTrainNode> createWorker(void) const { return nullptr; }
+		/**
+		* @brief Merges the data, accumulated by a worker, into this node trainer
+		* @param worker The worker, created with createWorker() function
+		*/
+		DllExport virtual void merge(CTrainNode &worker) {}
 		
 
 	private:
+		static const int MIN_WORKER_PIXELS;										///< The minimal number of pixels per stripe in addFeatureVecs()
+		static const int BATCH_SIZE;											///< The desired number of samples, passed to calculateNodePotentials(const Mat &, Mat &) const at once
+
+		/**
+		* @brief Accumulates a block of feature vectors in parallel stripes
+		* @details The block is split into the stripes of at least MIN_WORKER_PIXELS pixels. The first stripe is accumulated by this node trainer and every 
+		* other one by its own worker (Ref. createWorker()); the workers are merged in the order of the stripes.
+		* @param size The size of the block
+		* @param add The function, accumulating the rows  rows of the block into the node trainer  worker
+		* @retval true if the block has been accumulated
+		* @retval false if the block is too small or the node trainer does not support workers
+		*/
+		bool addStripes(Size size, const std::function<void(CTrainNode &worker, const Range &rows)> &add);
+		/**
+		* @brief Returns the node potentials of the valid pixels of a block of feature vectors
+		* @details This function is called by getNodePotentials(const Mat &, const Mat &, float, const Mat &) const, if the mask is given
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_8UC(nFeatures))
+		* @param weights The block of weighting parameters Mat(type: CV_32FC1). If empty, values 1 are used.
+		* @param Z The value of partition function
+		* @param mask The mask of valid pixels: Mat(size: featureVectors.size(); type: CV_8UC1)
+		* @return The node potentials: Mat(size: featureVectors.size(); type: CV_32FC(nStates)), which are 0 for the pixels with zero mask
+		*/
+		Mat getMaskedNodePotentials(const Mat &featureVectors, const Mat &weights, float Z, const Mat &mask) const;
+		/**
+		* @brief Converts the raw node potentials into the normalized ones
+		* @details Powers the potentials by the weights and normalizes them in the same way as getNodePotentials(const Mat &, float, float) const does
+		* @param potentials The raw node potentials (Ref. calculateNodePotentials(const Mat &, Mat &) const): Mat(size: nSamples x nStates; type: CV_32FC1)
+		* @param pWeights Pointer to the \a nSamples weighting parameters. If NULL, values 1 are used.
+		* @param Z The value of partition function
+		* @param pRes Pointer to the \a nSamples x \a nStates resulting node potentials
+		*/
+		void normalize(const Mat &potentials, const float *pWeights, float Z, float *pRes) const;
+
 		Mat	m_mask;
 	};
 }
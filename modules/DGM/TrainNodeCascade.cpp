@@ -0,0 +1,146 @@
+#include "TrainNodeCascade.h"
+#include "footprint.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	// Constructor
+	CTrainNodeCascade::CTrainNodeCascade(byte nStates, word nFeatures, const std::vector<std::shared_ptr<CTrainNode>> &vpStages, float threshold)
+		: CBaseRandomModel(nStates)
+		, CTrainNode(nStates, nFeatures)
+		, m_vpStages(vpStages)
+		, m_threshold(threshold)
+	{
+		DGM_ASSERT_MSG(!m_vpStages.empty(), "The cascade must contain at least one stage");
+		for (auto &pStage : m_vpStages) {
+			DGM_ASSERT(pStage);
+			DGM_ASSERT_MSG(pStage->getNumStates() == nStates, "Number of states of the stage (%d) does not correspond to the specified (%d)", pStage->getNumStates(), nStates);
+			DGM_ASSERT_MSG(pStage->getNumFeatures() == nFeatures, "Number of features of the stage (%d) does not correspond to the specified (%d)", pStage->getNumFeatures(), nFeatures);
+		}
+	}
+
+	void CTrainNodeCascade::reset(void)
+	{
+		for (auto &pStage : m_vpStages) pStage->reset();
+	}
+
+	void CTrainNodeCascade::addFeatureVec(const Mat &featureVector, byte gt)
+	{
+		for (auto &pStage : m_vpStages) pStage->addFeatureVec(featureVector, gt);
+	}
+
+	size_t CTrainNodeCascade::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vpStages);
+		for (const auto &pStage : m_vpStages) res += pStage->getMemoryUsage();
+		return res;
+	}
+
+	void CTrainNodeCascade::train(bool doClean)
+	{
+		for (auto &pStage : m_vpStages) pStage->train(doClean);
+	}
+
+	void CTrainNodeCascade::saveFile(FILE *pFile) const
+	{
+		const word nStages = static_cast<word>(m_vpStages.size());
+		fwrite(&nStages, sizeof(word), 1, pFile);
+		fwrite(&m_threshold, sizeof(float), 1, pFile);
+		for (auto &pStage : m_vpStages) pStage->saveFile(pFile);
+	}
+
+	void CTrainNodeCascade::loadFile(FILE *pFile)
+	{
+		word nStages = 0;
+		fread(&nStages, sizeof(word), 1, pFile);
+		DGM_ASSERT_MSG(nStages == m_vpStages.size(), "Number of stages in the file (%d) does not correspond to the specified (%zu)", nStages, m_vpStages.size());
+		fread(&m_threshold, sizeof(float), 1, pFile);
+		for (auto &pStage : m_vpStages) pStage->loadFile(pFile);
+	}
+
+	void CTrainNodeCascade::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
+	{
+		for (size_t s = 0; s < m_vpStages.size(); s++) {
+			if (s > 0) {
+				potential.setTo(0);
+				mask.setTo(1);
+			}
+			m_vpStages[s]->calculateNodePotentials(featureVector, potential, mask);
+			if (s + 1 == m_vpStages.size()) break;
+
+			// The potentials with the mask, as produced by the default batch implementation
+			vec_float_t vPot(m_nStates);
+			const float *pPot = reinterpret_cast<const float *>(potential.data);						// the stages may re-shape the potential
+			for (byte i = 0; i < m_nStates; i++) vPot[i] = mask.at<byte>(i, 0) ? pPot[i] : -1.0f;
+			if (isConfident(vPot.data())) break;
+		} // s
+	}
+
+	// The indexes of the unconfident samples are propagated from stage to stage; their feature vectors are gathered into a continuous matrix
+	void CTrainNodeCascade::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+
+		vec_int_t	vIndexes(featureMatrix.rows);
+		for (int i = 0; i < featureMatrix.rows; i++) vIndexes[i] = i;
+
+		Mat samples = featureMatrix;
+		Mat pot;
+		for (size_t s = 0; s < m_vpStages.size(); s++) {
+			m_vpStages[s]->calculateNodePotentials(samples, pot);
+			const bool isLast = s + 1 == m_vpStages.size();
+
+			vec_int_t vNextIndexes;
+			for (int i = 0; i < pot.rows; i++) {
+				const float *pPot = pot.ptr<float>(i);
+				if (isLast || isConfident(pPot)) std::copy(pPot, pPot + m_nStates, potentials.ptr<float>(vIndexes[i]));
+				else vNextIndexes.push_back(i);
+			} // i
+			if (vNextIndexes.empty()) break;
+
+			Mat nextSamples(static_cast<int>(vNextIndexes.size()), featureMatrix.cols, CV_8UC1);
+			for (int i = 0; i < nextSamples.rows; i++) {
+				samples.row(vNextIndexes[i]).copyTo(nextSamples.row(i));
+				vNextIndexes[i] = vIndexes[vNextIndexes[i]];
+			}
+			samples = nextSamples;
+			vIndexes.swap(vNextIndexes);
+		} // s
+	}
+
+	void CTrainNodeCascade::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		for (auto &pStage : m_vpStages) pStage->addFeatureVecBlock(featureVectors, gt);
+	}
+
+	std::shared_ptr<CTrainNode> CTrainNodeCascade::createWorker(void) const
+	{
+		std::vector<std::shared_ptr<CTrainNode>> vpWorkers;
+		for (auto &pStage : m_vpStages) {
+			std::shared_ptr<CTrainNode> pWorker = pStage->createWorker();
+			if (!pWorker) return nullptr;
+			vpWorkers.push_back(pWorker);
+		}
+		return std::make_shared<CTrainNodeCascade>(m_nStates, getNumFeatures(), vpWorkers, m_threshold);
+	}
+
+	void CTrainNodeCascade::merge(CTrainNode &worker)
+	{
+		CTrainNodeCascade &cascade = dynamic_cast<CTrainNodeCascade &>(worker);
+		for (size_t s = 0; s < m_vpStages.size(); s++)
+			m_vpStages[s]->merge(*cascade.m_vpStages[s]);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	bool CTrainNodeCascade::isConfident(const float *pPot) const
+	{
+		float sum = 0;
+		float max = 0;
+		for (byte s = 0; s < m_nStates; s++)
+			if (pPot[s] > 0) {
+				sum += pPot[s];
+				if (max < pPot[s]) max = pPot[s];
+			}
+		return sum > FLT_EPSILON && max >= m_threshold * sum;
+	}
+}
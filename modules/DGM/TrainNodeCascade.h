@@ -0,0 +1,99 @@
+// Cascade of node trainers class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "TrainNode.h"
+
+namespace DirectGraphicalModels
+{
+	// ====================== Cascade Train Class =====================
+	/**
+	* @ingroup moduleTrainNode
+	* @brief Cascade of node trainers
+	* @details This class combines an ordered list of node trainers, from the cheapest to the most expensive one (\a e.g. @ref CTrainNodeBayes followed by
+	* @ref CTrainNodeMsRF). All the stages are trained on the same samples. During classification, the samples are evaluated by the first stage in batches, and only the samples,
+	* whose largest normalized potential does not reach the confidence threshold, are gathered and forwarded to the next stage. The last stage classifies all the remaining samples.
+	* Thus, the classification cost follows the difficulty of the image: the easy pixels are classified by the cheap stages only.
+	* @code
+	* CTrainNodeCascade nodeTrainer(nStates, nFeatures, { CTrainNode::create(Bayes, nStates, nFeatures), CTrainNode::create(MsRF, nStates, nFeatures) }, 0.9f);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CTrainNodeCascade : public CTrainNode
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param nFeatures Number of features
+		* @param vpStages The node trainers of the stages, ordered from the cheapest to the most expensive one. They must have the same numbers of states and features
+		* @param threshold The confidence threshold in range [0; 1]: a sample is finally classified by a stage, if its largest potential, divided by the sum of its potentials,
+		* is not less than the threshold
+		*/
+		DllExport CTrainNodeCascade(byte nStates, word nFeatures, const std::vector<std::shared_ptr<CTrainNode>> &vpStages, float threshold = 0.9f);
+		DllExport virtual ~CTrainNodeCascade(void) = default;
+
+		DllExport virtual void	reset(void);
+
+		DllExport virtual void	addFeatureVec(const Mat &featureVector, byte gt);
+		DllExport virtual void	train(bool doClean = false);
+		DllExport virtual size_t getMemoryUsage(void) const;
+
+		/**
+		* @brief Returns the node trainer of a stage
+		* @param stage The index of the stage
+		* @return The node trainer
+		*/
+		DllExport std::shared_ptr<CTrainNode>	getStage(size_t stage) const { return m_vpStages.at(stage); }
+		/**
+		* @brief Returns the number of stages
+		* @return The number of stages
+		*/
+		DllExport size_t		getNumStages(void) const { return m_vpStages.size(); }
+		/**
+		* @brief Sets the confidence threshold
+		* @param threshold The confidence threshold in range [0; 1]
+		*/
+		DllExport void			setThreshold(float threshold) { m_threshold = threshold; }
+		/**
+		* @brief Returns the confidence threshold
+		* @return The confidence threshold
+		*/
+		DllExport float			getThreshold(void) const { return m_threshold; }
+
+
+	protected:
+		DllExport virtual void	saveFile(FILE *pFile) const;
+		DllExport virtual void	loadFile(FILE *pFile);
+		DllExport virtual void	calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		/**
+		* @brief Calculates the node potentials, based on the block of feature vectors
+		* @details Every stage is applied to the samples, which were not classified confidently by the previous stages, at once
+		* @param[in]	featureMatrix Multi-dimensinal points, stored row-wise: Mat(size: nSamples x nFeatures; type: CV_8UC1)
+		* @param[out]	potentials %Node potentials: Mat(size: nSamples x nStates; type: CV_32FC1)
+		*/
+		DllExport virtual void	calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport virtual void	addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		/**
+		* @brief Creates a worker for the parallel accumulation of the feature vectors
+		* @details The worker is available only if all the stages support workers (Ref. CTrainNode::createWorker())
+		* @return The pointer to the worker or an empty pointer
+		*/
+		DllExport virtual std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport virtual void	merge(CTrainNode &worker);
+
+
+	private:
+		/**
+		* @brief Checks, whether the potentials of a sample are confident
+		* @param pPot Pointer to the \a nStates potentials of the sample. The negative values mark the irrelevant potentials
+		* @return true, if the largest potential, divided by the sum of the potentials, is not less than the threshold
+		*/
+		bool	isConfident(const float *pPot) const;
+
+
+	private:
+		std::vector<std::shared_ptr<CTrainNode>>	m_vpStages;			///< The node trainers of the stages
+		float										m_threshold;		///< The confidence threshold
+	};
+}
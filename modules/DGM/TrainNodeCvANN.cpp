@@ -64,6 +64,21 @@ namespace DirectGraphicalModels
 		m_pSamplesAcc->addSample(featureVector, gt);
 	}
 
+	void	CTrainNodeCvANN::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		m_pSamplesAcc->addSamples(featureVectors, gt);
+	}
+
+	std::shared_ptr<CTrainNode> CTrainNodeCvANN::createWorker(void) const
+	{
+		return std::make_shared<CTrainNodeCvANN>(m_nStates, getNumFeatures(), m_pSamplesAcc->getMaxSamples());
+	}
+
+	void CTrainNodeCvANN::merge(CTrainNode &worker)
+	{
+		m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeCvANN &>(worker).m_pSamplesAcc);
+	}
+
 	void	CTrainNodeCvANN::train(bool doClean)
 	{
 #ifdef DEBUG_PRINT_INFO
@@ -109,4 +124,12 @@ namespace DirectGraphicalModels
 			if (pot < 0) pot = 0;
 		potential = potential.t();
 	}
+
+	void CTrainNodeCvANN::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		Mat fm;
+		featureMatrix.convertTo(fm, CV_32FC1);
+		m_pANN->predict(fm, potentials);
+		max(potentials, 0, potentials);
+	}
 }
@@ -76,6 +76,21 @@ void CTrainNodeCvGMM::addFeatureVec(const Mat &featureVector, byte gt)
 	m_pSamplesAcc->addSample(featureVector, gt);
 }
 
+void CTrainNodeCvGMM::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+{
+	m_pSamplesAcc->addSamples(featureVectors, gt);
+}
+
+std::shared_ptr<CTrainNode> CTrainNodeCvGMM::createWorker(void) const
+{
+	return std::make_shared<CTrainNodeCvGMM>(m_nStates, getNumFeatures(), m_pSamplesAcc->getMaxSamples());
+}
+
+void CTrainNodeCvGMM::merge(CTrainNode &worker)
+{
+	m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeCvGMM &>(worker).m_pSamplesAcc);
+}
+
 void CTrainNodeCvGMM::train(bool doClean)
 {
 #ifdef DEBUG_PRINT_INFO
@@ -130,4 +145,20 @@ void CTrainNodeCvGMM::calculateNodePotentials(const Mat &featureVector, Mat &pot
 	}
 	delete [] v;*/
 }
+
+void CTrainNodeCvGMM::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+{
+	Mat fm;
+	featureMatrix.convertTo(fm, CV_64FC1);
+	potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+
+	// Min Coefficient approach
+	for (byte s = 0; s < m_nStates; s++) { 					// state
+		if (m_vpEM[s]->isTrained())
+			for (int i = 0; i < fm.rows; i++)
+				potentials.at<float>(i, s) = static_cast<float>(std::exp(m_vpEM[s]->predict2(fm.row(i), noArray())[0]) * m_minCoefficient);
+		else
+			potentials.col(s).setTo(-1.0f);
+	} // s
+}
 }
@@ -56,7 +56,28 @@ namespace DirectGraphicalModels
 	{
 		m_pSamplesAcc->addSample(featureVector, gt);
 	}
+
+	void	CTrainNodeCvKNN::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		m_pSamplesAcc->addSamples(featureVectors, gt);
+	}
+
+	std::shared_ptr<CTrainNode> CTrainNodeCvKNN::createWorker(void) const
+	{
+		return std::make_shared<CTrainNodeCvKNN>(m_nStates, getNumFeatures(), m_params);
+	}
+
+	void CTrainNodeCvKNN::merge(CTrainNode &worker)
+	{
+		m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeCvKNN &>(worker).m_pSamplesAcc);
+	}
 	
+	// The memory of the OpenCV model is not accounted
+	size_t CTrainNodeCvKNN::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + m_pSamplesAcc->getMemoryUsage();
+	}
+
 	void	CTrainNodeCvKNN::train(bool doClean)
 	{
 #ifdef DEBUG_PRINT_INFO
@@ -112,4 +133,26 @@ namespace DirectGraphicalModels
 		if (n) potential /= n;
 		potential += m_params.bias;
 	}
+
+	void CTrainNodeCvKNN::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		Mat fm;
+		featureMatrix.convertTo(fm, CV_32FC1);
+
+		Mat result, neighborResponses;
+		m_pKNN->findNearest(fm, static_cast<int>(m_params.maxNeighbors), result, neighborResponses);
+
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+		potentials.setTo(0);
+		const int n = neighborResponses.cols;
+		for (int i = 0; i < potentials.rows; i++) {
+			const float *pResponse	= neighborResponses.ptr<float>(i);
+			float		*pPot		= potentials.ptr<float>(i);
+			for (int k = 0; k < n; k++) pPot[static_cast<byte>(pResponse[k])] += 1.0f;
+			for (byte s = 0; s < m_nStates; s++) {
+				if (n) pPot[s] /= n;
+				pPot[s] += m_params.bias;
+			}
+		} // i
+	}
 }
@@ -60,12 +60,17 @@ namespace DirectGraphicalModels
 		DllExport void	addFeatureVec(const Mat &featureVector, byte gt);
 
 		DllExport void	train(bool doClean = false);
+		DllExport size_t getMemoryUsage(void) const;
 
 
 	protected:
 		DllExport void	saveFile(FILE *pFile) const { }
 		DllExport void	loadFile(FILE *pFile) { }
 		DllExport void  calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void  calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport void  addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void  merge(CTrainNode &worker);
 
 	
 	protected:
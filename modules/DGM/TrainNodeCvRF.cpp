@@ -62,6 +62,21 @@ void CTrainNodeCvRF::addFeatureVec(const Mat &featureVector, byte gt)
 	m_pSamplesAcc->addSample(featureVector, gt); 
 }
 
+void CTrainNodeCvRF::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+{
+	m_pSamplesAcc->addSamples(featureVectors, gt);
+}
+
+std::shared_ptr<CTrainNode> CTrainNodeCvRF::createWorker(void) const
+{
+	return std::make_shared<CTrainNodeCvRF>(m_nStates, getNumFeatures(), m_params);
+}
+
+void CTrainNodeCvRF::merge(CTrainNode &worker)
+{
+	m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeCvRF &>(worker).m_pSamplesAcc);
+}
+
 void CTrainNodeCvRF::train(bool doClean)
 {
 #ifdef DEBUG_PRINT_INFO
@@ -122,4 +137,18 @@ void CTrainNodeCvRF::calculateNodePotentials(const Mat &featureVector, Mat &pote
 	//if (sum) potential /= sum;
 }
 
+void CTrainNodeCvRF::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+{
+	Mat fm, res;
+	featureMatrix.convertTo(fm, CV_32FC1);
+	m_pRF->predict(fm, res);
+
+	potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+	potentials.setTo(0.1f);
+	for (int i = 0; i < potentials.rows; i++) {
+		byte s = static_cast<byte>(res.at<float>(i, 0));
+		potentials.at<float>(i, s) = 1.1f;
+	}
+}
+
 }
@@ -88,6 +88,10 @@ namespace DirectGraphicalModels
 		DllExport void	saveFile(FILE *pFile) const { }
 		DllExport void	loadFile(FILE *pFile) { }
 		DllExport void	calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void	calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport void	addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void	merge(CTrainNode &worker);
 
 
 	protected:
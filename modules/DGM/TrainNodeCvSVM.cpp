@@ -1,5 +1,8 @@
 #include "TrainNodeCvSVM.h"
 #include "SamplesAccumulator.h"
+#include "Arena.h"
+#include "parallel.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels
 {
@@ -37,6 +40,7 @@ namespace DirectGraphicalModels
 	{
 		m_pSamplesAcc->reset();
 		m_pSVM->clear();
+		extractLinear(vec_byte_t());
 	}
 
 	void	CTrainNodeCvSVM::save(const std::string &path, const std::string &name, short idx) const
@@ -49,6 +53,20 @@ namespace DirectGraphicalModels
 	{
 		std::string fileName = generateFileName(path, name.empty() ? "TrainNodeCvSVM" : name, idx);
 		m_pSVM = Algorithm::load<ml::SVM>(fileName.c_str());
+		DGM_ASSERT_MSG(m_pSVM && m_pSVM->isTrained(), "Can't load the SVM from %s", fileName.c_str());
+
+		// The class labels are stored by OpenCV in the same file: the states, which were absent in the training data, have no decision functions
+		FileStorage fs(fileName, FileStorage::READ);
+		Mat labels;
+		fs.getFirstTopLevelNode()["class_labels"] >> labels;
+		if (!labels.empty()) labels.convertTo(labels, CV_32S);
+		vec_byte_t vClassLabels;
+		for (int i = 0; i < static_cast<int>(labels.total()); i++) {
+			const int label = labels.at<int>(i);
+			DGM_ASSERT_MSG(label >= 0 && label < m_nStates, "The SVM in %s has the class label %d, which is not a state", fileName.c_str(), label);
+			vClassLabels.push_back(static_cast<byte>(label));
+		}
+		extractLinear(vClassLabels);
 	}
 
 	void	CTrainNodeCvSVM::addFeatureVec(const Mat &featureVector, byte gt)
@@ -56,6 +74,21 @@ namespace DirectGraphicalModels
 		m_pSamplesAcc->addSample(featureVector, gt);
 	}
 
+	void	CTrainNodeCvSVM::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		m_pSamplesAcc->addSamples(featureVectors, gt);
+	}
+
+	std::shared_ptr<CTrainNode> CTrainNodeCvSVM::createWorker(void) const
+	{
+		return std::make_shared<CTrainNodeCvSVM>(m_nStates, getNumFeatures(), m_pSamplesAcc->getMaxSamples());
+	}
+
+	void CTrainNodeCvSVM::merge(CTrainNode &worker)
+	{
+		m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeCvSVM &>(worker).m_pSamplesAcc);
+	}
+
 	void	CTrainNodeCvSVM::train(bool doClean)
 	{
 #ifdef DEBUG_PRINT_INFO
@@ -63,11 +96,13 @@ namespace DirectGraphicalModels
 #endif
 		// Filling the <samples> and <classes>
 		Mat samples, classes;
+		vec_byte_t vClassLabels;
 		for (byte s = 0; s < m_nStates; s++) {						// states
 			int nSamples = m_pSamplesAcc->getNumSamples(s);
 #ifdef DEBUG_PRINT_INFO		
 			printf("State[%d] - %d of %d samples\n", s, nSamples, m_pSamplesAcc->getNumInputSamples(s));
 #endif
+			if (nSamples) vClassLabels.push_back(s);
 			samples.push_back(m_pSamplesAcc->getSamplesContainer(s));
 			classes.push_back(Mat(nSamples, 1, CV_32SC1, Scalar(s)));
 			if (doClean) m_pSamplesAcc->release(s);				// free memory
@@ -75,15 +110,92 @@ namespace DirectGraphicalModels
 		samples.convertTo(samples, CV_32FC1);
 
 		m_pSVM->train(samples, ml::ROW_SAMPLE, classes);
+		extractLinear(vClassLabels);
 	}
 
 	void CTrainNodeCvSVM::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
 	{
 		Mat fv;
 		featureVector.convertTo(fv, CV_32FC1);
+		if (!m_weights.empty()) {
+			Mat decisions = fv.t() * m_weights;
+			Mat pot;
+			vote(decisions, pot);
+			potential += pot.t();
+			return;
+		}
 		float res = m_pSVM->predict(fv.t());
 		byte s = static_cast<byte>(res);
 		potential.at<float>(s, 0) = 1.0f;
 		potential += 0.1f;
 	}
+
+	void CTrainNodeCvSVM::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		Mat fm, res;
+		featureMatrix.convertTo(fm, CV_32FC1);
+		if (!m_weights.empty()) {
+			gemm(fm, m_weights, 1.0, noArray(), 0.0, res);
+			vote(res, potentials);
+			return;
+		}
+		m_pSVM->predict(fm, res);
+
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+		potentials.setTo(0.1f);
+		for (int i = 0; i < potentials.rows; i++) {
+			byte s = static_cast<byte>(res.at<float>(i, 0));
+			potentials.at<float>(i, s) = 1.1f;
+		}
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The decision function d of OpenCV is sum_k alpha_k <sv_k, x> - rho, thus its weight vector is sum_k alpha_k sv_k
+	void CTrainNodeCvSVM::extractLinear(const vec_byte_t &vClassLabels)
+	{
+		m_weights.release();
+		m_rho.release();
+		m_vClassLabels = vClassLabels;
+		if (!m_pSVM->isTrained() || m_pSVM->getKernelType() != ml::SVM::LINEAR) return;
+
+		const size_t nClasses	= vClassLabels.size();
+		const int	 nDecisions	= static_cast<int>(nClasses * (nClasses - 1) / 2);
+		const Mat	 sv			= m_pSVM->getSupportVectors();
+		if (nClasses < 2 || sv.cols != getNumFeatures()) return;
+
+		m_weights = Mat::zeros(getNumFeatures(), nDecisions, CV_32FC1);
+		m_rho.create(1, nDecisions, CV_32FC1);
+		Mat alpha, svIdx;
+		for (int d = 0; d < nDecisions; d++) {
+			m_rho.at<float>(0, d) = static_cast<float>(m_pSVM->getDecisionFunction(d, alpha, svIdx));
+			alpha.convertTo(alpha, CV_64FC1);
+			for (int k = 0; k < static_cast<int>(svIdx.total()); k++) {
+				const float *pSv = sv.ptr<float>(svIdx.at<int>(k));
+				const double a	 = alpha.at<double>(k);
+				for (int f = 0; f < sv.cols; f++) m_weights.at<float>(f, d) += static_cast<float>(a * pSv[f]);
+			} // k
+		} // d
+	}
+
+	// The one-against-one voting of OpenCV: the decision function of the pair (i, j) votes for i if positive, and the first state with the most votes wins
+	void CTrainNodeCvSVM::vote(const Mat &decisions, Mat &potentials) const
+	{
+		const int nClasses = static_cast<int>(m_vClassLabels.size());
+		potentials.create(decisions.rows, m_nStates, CV_32FC1);
+		potentials.setTo(0.1f);
+		parallel::parallelFor(Range(0, decisions.rows), [&](const Range &range) {
+			int *pVotes = CArena::getScratch<int>(nClasses);
+			for (int n = range.start; n < range.end; n++) {
+				const float *pDecision	= decisions.ptr<float>(n);
+				const float *pRho		= m_rho.ptr<float>(0);
+				std::fill(pVotes, pVotes + nClasses, 0);
+				int d = 0;
+				for (int i = 0; i < nClasses; i++)
+					for (int j = i + 1; j < nClasses; j++, d++)
+						pVotes[pDecision[d] - pRho[d] > 0 ? i : j]++;
+				const int k = static_cast<int>(std::max_element(pVotes, pVotes + nClasses) - pVotes);
+				potentials.at<float>(n, m_vClassLabels[k]) = 1.1f;
+			} // n
+		});
+	}
 }
@@ -33,6 +33,13 @@ namespace DirectGraphicalModels
 	* @ingroup moduleTrainNode
 	* @brief OpenCV Support Vector Machines training class
 	* @details This class implements the <a href="https://en.wikipedia.org/wiki/Support_vector_machine" target="blank">Support vector machine classifier (SVM)</a>.
+	* 
+	* With the linear kernel (ref. setKernel()) the one-against-one decision functions of the trained SVM are extracted into the explicit weight vectors and biases,
+	* thus the potentials of a whole image are calculated with one matrix multiplication of the features with the weights, followed by the voting of OpenCV:
+	* @code
+	* CTrainNodeCvSVM nodeTrainer(nStates, nFeatures);
+	* nodeTrainer.setKernel(ml::SVM::LINEAR);
+	* @endcode
 	* @note This trainer was not well-tested.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
@@ -63,20 +70,48 @@ namespace DirectGraphicalModels
 		DllExport void	addFeatureVec(const Mat &featureVector, byte gt);
 
 		DllExport void	train(bool doClean = false);
+		/**
+		* @brief Sets the kernel of the SVM
+		* @details The default kernel is ml::SVM::INTER. The new kernel is applied to the next training
+		* @param kernel The kernel type (Ref. <a href="https://docs.opencv.org/master/d1/d2d/classcv_1_1ml_1_1SVM.html" target="blank">cv::ml::SVM::KernelTypes</a>)
+		*/
+		DllExport void	setKernel(int kernel) { m_pSVM->setKernel(kernel); }
 
 
 	protected:
 		DllExport void	saveFile(FILE *pFile) const { }
 		DllExport void	loadFile(FILE *pFile) { }
 		DllExport void  calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void  calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport void  addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void  merge(CTrainNode &worker);
 
 
 	private:
 		void		  init(TrainNodeCvSVMParams params);		// This function is called by both constructors
+		/**
+		* @brief Extracts the weight vectors and the biases of the decision functions of the linear SVM
+		* @details If the SVM is not trained or its kernel is not linear, the weights are released and the generic prediction of OpenCV is used
+		* @param vClassLabels The sorted states (classes), which were present in the training data
+		*/
+		void		  extractLinear(const vec_byte_t &vClassLabels);
+		/**
+		* @brief Calculates the potentials from the decision values of the linear SVM
+		* @param decisions The values of the decision functions without the biases: Mat(size: nSamples x nDecisionFunctions; type: CV_32FC1)
+		* @param potentials The potentials: Mat(size: nSamples x nStates; type: CV_32FC1)
+		*/
+		void		  vote(const Mat &decisions, Mat &potentials) const;
 
 
 	protected:
 		Ptr<ml::SVM>				  m_pSVM;					///< Support Vector Machine
 		CSamplesAccumulator			* m_pSamplesAcc;			///< Samples Accumulator
+
+
+	private:
+		Mat							  m_weights;				///< The weights of the linear decision functions: Mat(size: nFeatures x nDecisionFunctions; type: CV_32FC1)
+		Mat							  m_rho;					///< The biases of the linear decision functions: Mat(size: 1 x nDecisionFunctions; type: CV_32FC1)
+		vec_byte_t					  m_vClassLabels;			///< The states (classes) of the SVM
 	};
 }
\ No newline at end of file
@@ -1,4 +1,10 @@
 #include "TrainNodeGMM.h"
+#include "Arena.h"
+#include "ModelFile.h"
+#include "footprint.h"
+#include "parallel.h"
+#include "random.h"
+#include "simd.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
@@ -35,6 +41,19 @@ namespace DirectGraphicalModels
 	{
 		m_vGaussianMixtures.clear();
 		m_minAlpha = 1;
+		m_mu.release();
+		m_whitening.release();
+		m_logCoefficient.release();
+		m_vOffsets.clear();
+		if (m_pSamplesAcc) m_pSamplesAcc->reset();
+	}
+
+	void CTrainNodeGMM::setEM(bool enable, size_t maxSamples, unsigned int nIt)
+	{
+		DGM_ASSERT_MSG(nIt > 0, "The number of EM iterations must be positive");
+		if (enable) m_pSamplesAcc = std::make_unique<CSamplesAccumulator>(m_nStates, maxSamples);
+		else		m_pSamplesAcc.reset();
+		m_nEMIt = nIt;
 	}
 
 	namespace {
@@ -65,22 +84,61 @@ namespace DirectGraphicalModels
 	}
 
 	void CTrainNodeGMM::addFeatureVec(const Mat &featureVector, byte gt) {
-		// Assertions
-		DGM_ASSERT_MSG(gt < m_nStates, "The groundtruth value %u is out of range [0; %u)", gt, m_nStates);
-
+		if (m_pSamplesAcc) {
+			m_pSamplesAcc->addSample(featureVector, gt);
+			return;
+		}
 		Mat point;
 		featureVector.convertTo(point, CV_64FC1);
+		addSample(point, gt);
+	}
+
+	// The block is converted row by row into one buffer, whose columns are passed to addSample() without copying
+	void CTrainNodeGMM::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		const word nFeatures = getNumFeatures();
+		DGM_ASSERT(featureVectors.size() == gt.size());
+		DGM_ASSERT(featureVectors.channels() == nFeatures);
+		DGM_ASSERT(gt.type() == CV_8UC1);
+		if (m_pSamplesAcc) {
+			m_pSamplesAcc->addSamples(featureVectors, gt);
+			return;
+		}
+
+		Mat row;
+		for (int y = 0; y < gt.rows; y++) {
+			featureVectors.row(y).convertTo(row, CV_64F);
+			double		*pRow	= row.ptr<double>(0);
+			const byte	*pGt	= gt.ptr<byte>(y);
+			for (int x = 0; x < gt.cols; x++)
+				addSample(Mat(nFeatures, 1, CV_64FC1, pRow + x * nFeatures), pGt[x]);
+		} // y
+	}
+
+	void CTrainNodeGMM::addSample(const Mat &point, byte gt)
+	{
+		// Assertions
+		DGM_ASSERT_MSG(gt < m_nStates, "The groundtruth value %u is out of range [0; %u)", gt, m_nStates);
 
 		GaussianMixture &gaussianMixture = m_vGaussianMixtures[gt];							// GMM of current state		
 
 		if (gaussianMixture.empty()) 
 			gaussianMixture.emplace_back(point);			// NEW GAUSS
 		else {
-			std::vector<double> dist = getDistance(point, gaussianMixture, m_params.minSamples, m_params.dist_Etreshold, m_params.dist_Mtreshold);					// Calculate distances all existing Gaussians in the mixture to the point
-
-			// Find the smallest distance
-			auto it = std::min_element(dist.begin(), dist.end());
-			double minDist = *it;
+			// Find the smallest distance (as in getDistance()): the Euclidean distances are not completed, as soon as they exceed the smallest one
+			size_t updIdx	= 0;
+			double minDist	= DBL_MAX;
+			for (size_t i = 0; i < gaussianMixture.size(); i++) {
+				const CKDGauss &gauss = gaussianMixture[i];
+				double dist;
+				if (m_params.dist_Mtreshold)									dist = gauss.getEuclidianDistance(point, minDist);
+				else if (gauss.getNumPoints() >= m_params.minSamples)			dist = gauss.getMahalanobisDistance(point);
+				else															dist = gauss.getEuclidianDistance(point) * m_params.dist_Mtreshold / m_params.dist_Etreshold;
+				if (dist < minDist) {
+					minDist = dist;
+					updIdx	= i;
+				}
+			} // i
 
 			double dist_treshold = (m_params.dist_Mtreshold < 0) ? m_params.dist_Etreshold : m_params.dist_Mtreshold;
 
@@ -88,7 +146,6 @@ namespace DirectGraphicalModels
 			if ((minDist > dist_treshold) && (gaussianMixture.size() < m_params.maxGausses)) 
 				gaussianMixture.emplace_back(point);		// NEW GAUSS
 			else {
-				size_t updIdx = std::distance(dist.begin(), it);
 				CKDGauss &updGauss = gaussianMixture[updIdx];				// the nearest Gaussian
 				updGauss += point;											// update the nearest Gauss
 
@@ -112,6 +169,40 @@ namespace DirectGraphicalModels
 		}
 	}
 
+	std::shared_ptr<CTrainNode> CTrainNodeGMM::createWorker(void) const
+	{
+		auto res = std::make_shared<CTrainNodeGMM>(m_nStates, getNumFeatures(), m_params);
+		if (m_pSamplesAcc) res->setEM(true, m_pSamplesAcc->getMaxSamples(), m_nEMIt);
+		return res;
+	}
+
+	void CTrainNodeGMM::merge(CTrainNode &worker)
+	{
+		const CTrainNodeGMM &gmm = dynamic_cast<const CTrainNodeGMM &>(worker);
+		if (m_pSamplesAcc) {
+			DGM_ASSERT(gmm.m_pSamplesAcc);
+			m_pSamplesAcc->merge(*gmm.m_pSamplesAcc);
+			return;
+		}
+		const double dist_treshold = (m_params.dist_Mtreshold < 0) ? m_params.dist_Etreshold : m_params.dist_Mtreshold;
+
+		for (size_t s = 0; s < MIN(m_vGaussianMixtures.size(), gmm.m_vGaussianMixtures.size()); s++) {	// state
+			GaussianMixture &gaussianMixture = m_vGaussianMixtures[s];
+			for (const CKDGauss &gauss : gmm.m_vGaussianMixtures[s]) {
+				if (gaussianMixture.empty()) {
+					gaussianMixture.push_back(gauss);				// NEW GAUSS
+					continue;
+				}
+				std::vector<double> dist = getDistance(gauss.getMu(), gaussianMixture, m_params.minSamples, m_params.dist_Etreshold, m_params.dist_Mtreshold);
+				auto it = std::min_element(dist.begin(), dist.end());
+				if ((*it > dist_treshold) && (gaussianMixture.size() < m_params.maxGausses))
+					gaussianMixture.push_back(gauss);				// NEW GAUSS
+				else
+					gaussianMixture[std::distance(dist.begin(), it)] += gauss;
+			} // gauss
+		} // s
+	}
+
 	namespace {
 		template<typename T>
 		void printMat(const std::string &name, const Mat &m) {
@@ -147,8 +238,28 @@ namespace DirectGraphicalModels
 		}
 	}
 
-	void CTrainNodeGMM::train(bool)
+	size_t CTrainNodeGMM::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vGaussianMixtures);
+		for (const GaussianMixture &gaussianMixture : m_vGaussianMixtures)
+			for (const CKDGauss &gauss : gaussianMixture)
+				res += gauss.getMemoryUsage() - sizeof(CKDGauss);							// the objects are counted with the capacity of the mixture
+		res += footprint::getBytes(m_mu) + footprint::getBytes(m_whitening) + footprint::getBytes(m_logCoefficient) + footprint::getBytes(m_vOffsets);
+		if (m_pSamplesAcc) res += m_pSamplesAcc->getMemoryUsage();
+		return res;
+	}
+
+	void CTrainNodeGMM::train(bool doClean)
 	{
+		// the mixtures are estimated at once from the accumulated samples
+		if (m_pSamplesAcc) {
+			m_vGaussianMixtures.resize(m_nStates);
+			for (byte s = 0; s < m_nStates; s++) {				// state
+				m_vGaussianMixtures[s] = trainEM(m_pSamplesAcc->getSamplesContainer(s));
+				if (doClean) m_pSamplesAcc->release(s);			// free memory
+			} // s
+		}
+
 		// merge gausses with too small number of samples 
 		for (GaussianMixture &gaussianMixture : m_vGaussianMixtures) {			// state
 			for (auto it = gaussianMixture.begin(); it != gaussianMixture.end(); it++) {
@@ -175,6 +286,7 @@ namespace DirectGraphicalModels
 		// getting the coefficients
 		for (GaussianMixture &gaussianMixture : m_vGaussianMixtures) {			// state
 			for (auto itGauss = gaussianMixture.begin(); itGauss != gaussianMixture.end(); itGauss++) {
+				itGauss->finalize();
 				long double alpha = itGauss->getAlpha();
 				if (alpha > MAX_COEFFICIENT) {			// i.e. if (Coefficient = \infinitiy) delete Gaussian
 					gaussianMixture.erase(itGauss);
@@ -187,6 +299,70 @@ namespace DirectGraphicalModels
 		} // gaussianMixture
 
 		printStatus(m_vGaussianMixtures, m_minAlpha);
+		compile();
+	}
+
+	// The Runnalls bounds of all the pairs are kept in a matrix, whose row and column of the merged Gaussian are updated after every merge
+	double CTrainNodeGMM::compact(word maxGausses, double maxLoss)
+	{
+		DGM_ASSERT_MSG(maxGausses > 0, "The number of Gaussians must be positive");
+		double res = 0;
+		for (GaussianMixture &gaussianMixture : m_vGaussianMixtures) {			// state
+			size_t nAllPoints = 0;
+			for (const CKDGauss &gauss : gaussianMixture) nAllPoints += gauss.getNumPoints();
+			if (gaussianMixture.size() < 2 || nAllPoints == 0) continue;
+
+			auto getWeight = [&](const CKDGauss &gauss) { return static_cast<double>(gauss.getNumPoints()) / nAllPoints; };
+			// B_ij with ln|Sigma| = -2 (ln(alpha) + k/2 ln(2 Pi)), where the constants cancel out
+			auto getBound = [&](const CKDGauss &g1, const CKDGauss &g2) {
+				CKDGauss gauss(g1);
+				gauss += g2;
+				gauss.finalize();
+				return getWeight(g1) * g1.getLogAlpha() + getWeight(g2) * g2.getLogAlpha() - getWeight(gauss) * gauss.getLogAlpha();
+			};
+
+			const int nGausses = static_cast<int>(gaussianMixture.size());
+			Mat bounds(nGausses, nGausses, CV_64FC1, Scalar(DBL_MAX));
+			for (int i = 0; i < nGausses; i++)
+				for (int j = i + 1; j < nGausses; j++)
+					bounds.at<double>(i, j) = getBound(gaussianMixture[i], gaussianMixture[j]);
+
+			std::vector<bool> vAlive(nGausses, true);
+			size_t	nAlive	= gaussianMixture.size();
+			double	loss	= 0;
+			while (nAlive > 1) {
+				Point minLoc;
+				double minBound;
+				minMaxLoc(bounds, &minBound, NULL, &minLoc);
+				if (nAlive <= maxGausses && loss + minBound > maxLoss) break;
+
+				const int i = minLoc.y;
+				const int j = minLoc.x;
+				gaussianMixture[i] += gaussianMixture[j];
+				gaussianMixture[i].finalize();
+				loss += MAX(0.0, minBound);
+				vAlive[j] = false;
+				nAlive--;
+				bounds.row(j).setTo(DBL_MAX);
+				bounds.col(j).setTo(DBL_MAX);
+				for (int k = 0; k < nGausses; k++)
+					if (k != i && vAlive[k]) {
+						const double bound = getBound(gaussianMixture[i], gaussianMixture[k]);
+						if (k < i)	bounds.at<double>(k, i) = bound;
+						else		bounds.at<double>(i, k) = bound;
+					}
+			}
+			res += loss;
+
+			GaussianMixture compacted;
+			for (int g = 0; g < nGausses; g++)
+				if (vAlive[g]) compacted.push_back(std::move(gaussianMixture[g]));
+			gaussianMixture = std::move(compacted);
+		} // gaussianMixture
+
+		printStatus(m_vGaussianMixtures, m_minAlpha);
+		compile();
+		return res;
 	}
 
 	void CTrainNodeGMM::saveFile(FILE *pFile) const
@@ -251,6 +427,7 @@ namespace DirectGraphicalModels
 				gauss.setMu(mu);
 				gauss.setSigma(sigma);
 				gauss.setNumPoints(nPoints);
+				gauss.finalize();
 
 				mu.release();
 				sigma.release();
@@ -258,31 +435,375 @@ namespace DirectGraphicalModels
 		} // gaussianMixture
 
 		fread(&m_minAlpha, sizeof(long double), 1, pFile);
+		compile();
+	}
+
+	// The Gaussians are stored column-wise in the Mats of all the states; the compiled packed arrays are stored as they are
+	void CTrainNodeGMM::saveSections(CModelFileWriter &writer) const
+	{
+		DGM_ASSERT_MSG(!m_vOffsets.empty(), "The node trainer is not trained");
+		const word	nFeatures	= getNumFeatures();
+		const int	nGausses	= m_vOffsets.back();
+
+		Mat nPoints(1, nGausses, CV_64FC1);
+		Mat mu(nFeatures, nGausses, CV_64FC1);
+		Mat sigma(nGausses * nFeatures, nFeatures, CV_64FC1);
+		int g = 0;
+		for (const GaussianMixture &gaussianMixture : m_vGaussianMixtures)		// state
+			for (const CKDGauss &gauss : gaussianMixture) {
+				nPoints.at<double>(0, g) = static_cast<double>(gauss.getNumPoints());
+				gauss.getMu().copyTo(mu.col(g));
+				gauss.getSigma().copyTo(sigma.rowRange(g * nFeatures, (g + 1) * nFeatures));
+				g++;
+			} // gauss
+
+		writer.addSection("GMM.params", &m_params, sizeof(TrainNodeGMMParams));
+		writer.addSection("GMM.minAlpha", &m_minAlpha, sizeof(long double));
+		writer.addSection("GMM.offsets", Mat(m_vOffsets, true).t());
+		writer.addSection("GMM.nPoints", nPoints);
+		writer.addSection("GMM.gaussMu", mu);
+		writer.addSection("GMM.gaussSigma", sigma);
+		writer.addSection("GMM.mu", m_mu);
+		writer.addSection("GMM.whitening", m_whitening);
+		writer.addSection("GMM.logCoefficient", m_logCoefficient);
+	}
+
+	void CTrainNodeGMM::loadSections(const CModelFile &file)
+	{
+		const word nFeatures = getNumFeatures();
+
+		memcpy(&m_params, file.getSection("GMM.params").data, sizeof(TrainNodeGMMParams));
+		memcpy(&m_minAlpha, file.getSection("GMM.minAlpha").data, sizeof(long double));
+		const Mat offsets = file.getSection("GMM.offsets");
+		DGM_ASSERT_MSG(offsets.cols == m_nStates + 1, "The file has been saved for another number of states");
+		m_vOffsets.assign(offsets.ptr<int>(0), offsets.ptr<int>(0) + offsets.cols);
+
+		const Mat nPoints	= file.getSection("GMM.nPoints");
+		const Mat mu		= file.getSection("GMM.gaussMu");
+		const Mat sigma		= file.getSection("GMM.gaussSigma");
+		DGM_ASSERT_MSG(mu.rows == nFeatures, "The file has been saved for another number of features");
+		m_vGaussianMixtures.resize(m_nStates);
+		for (byte s = 0; s < m_nStates; s++) {
+			GaussianMixture &gaussianMixture = m_vGaussianMixtures[s];
+			gaussianMixture.assign(m_vOffsets[s + 1] - m_vOffsets[s], CKDGauss(nFeatures));
+			for (int g = m_vOffsets[s]; g < m_vOffsets[s + 1]; g++) {
+				CKDGauss &gauss = gaussianMixture[g - m_vOffsets[s]];
+				gauss.setMu(mu.col(g));
+				gauss.setSigma(sigma.rowRange(g * nFeatures, (g + 1) * nFeatures));
+				gauss.setNumPoints(static_cast<long>(nPoints.at<double>(0, g)));
+				gauss.finalize();
+			} // g
+		} // s
+
+		// The compiled mixtures are used in place
+		m_mu			 = file.getSection("GMM.mu");
+		m_whitening		 = file.getSection("GMM.whitening");
+		m_logCoefficient = file.getSection("GMM.logCoefficient");
 	}
 
 	void CTrainNodeGMM::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
 	{
 		Mat fv;
-		Mat aux1, aux2, aux3;
+		featureVector.convertTo(fv, CV_32FC1);
+
+		float *pPot = CArena::getScratch<float>(m_nStates, 1);
+		evaluate(fv.ptr<float>(), pPot);
+		for (byte s = 0; s < m_nStates; s++)						// state
+			if (pPot[s] < 0)	mask.at<byte>(s, 0) = 0;
+			else				potential.at<float>(s, 0) += pPot[s];
+	}
 
-		featureVector.convertTo(fv, CV_64FC1);
+	void CTrainNodeGMM::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		Mat fm;
+		featureMatrix.convertTo(fm, CV_32FC1);
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+
+		for (int i = 0; i < featureMatrix.rows; i++)				// sample
+			evaluate(fm.ptr<float>(i), potentials.ptr<float>(i));
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	namespace {
+		// Calculates the Cholesky factor L of the matrix A + jitter * I = L * L^T (both size: k x k; type: CV_64FC1)
+		// Returns false if the matrix is not positive definite
+		bool cholesky(const Mat &A, double jitter, Mat &L)
+		{
+			const int k = A.rows;
+			L = Mat::zeros(k, k, CV_64FC1);
+			for (int i = 0; i < k; i++)
+				for (int j = 0; j <= i; j++) {
+					double sum = A.at<double>(i, j) + (i == j ? jitter : 0);
+					for (int p = 0; p < j; p++) sum -= L.at<double>(i, p) * L.at<double>(j, p);
+					if (i == j) {
+						if (!(sum > 0)) return false;
+						L.at<double>(i, i) = sqrt(sum);
+					}
+					else L.at<double>(i, j) = sum / L.at<double>(j, j);
+				} // j
+			return true;
+		}
+	}
 
-		for (byte s = 0; s < m_nStates; s++) {						// state
+	void CTrainNodeGMM::compile(void)
+	{
+		const word	nFeatures = getNumFeatures();
+		const int	nTri	  = nFeatures * (nFeatures + 1) / 2;
+
+		m_vOffsets.assign(1, 0);
+		for (const GaussianMixture &gaussianMixture : m_vGaussianMixtures)
+			m_vOffsets.push_back(m_vOffsets.back() + static_cast<int>(gaussianMixture.size()));
+		const int nGausses = m_vOffsets.back();
+
+		m_mu.create(nFeatures, nGausses, CV_32FC1);
+		m_whitening.create(nTri, nGausses, CV_32FC1);
+		m_logCoefficient.create(1, nGausses, CV_32FC1);
+
+		const double logMinAlpha	= static_cast<double>(logl(m_minAlpha));
+		const double logMinDet		= static_cast<double>(logl(LDBL_EPSILON));				// the same limit as in CKDGauss::getAlpha()
+		const double logSqrtPi		= 0.5 * nFeatures * log(2 * Pi);
+		Mat L, Linv;
+		for (size_t s = 0; s < m_vGaussianMixtures.size(); s++) {							// state
 			const GaussianMixture &gaussianMixture = m_vGaussianMixtures[s];
+			size_t nAllPoints = 0;																// number of points were used for approximating the density for current state
+			for (const CKDGauss &gauss : gaussianMixture)
+				nAllPoints += gauss.getNumPoints();
 
-			if (gaussianMixture.empty())	mask.at<byte>(s, 0) = 0;
-			else {
-				size_t nAllPoints = 0;									// number of points were used for approximating the density for current state
-				for (const CKDGauss &gauss : gaussianMixture)
-					nAllPoints += gauss.getNumPoints();
-
-				for (const CKDGauss &gauss : gaussianMixture) {
-					double		k = static_cast<double>(gauss.getNumPoints()) / nAllPoints;
-					double		value = gauss.getValue(fv, aux1, aux2, aux3);
-					long double	aK = gauss.getAlpha() / m_minAlpha;		// scaled Gaussian coefficient
-					potential.at<float>(s, 0) += static_cast<float>(k * aK * value);
-				} // gausses
+			int g = m_vOffsets[s];
+			for (const CKDGauss &gauss : gaussianMixture) {
+				const Mat mu	= gauss.getMu();
+				const Mat sigma = gauss.getSigma();
+
+				// A degenerated covariance matrix is regularized with an increasing jitter
+				const double scale	= MAX(1.0, trace(sigma)[0] / nFeatures);
+				double		 jitter = 0;
+				for (int attempt = 0; !cholesky(sigma, jitter, L); attempt++) {
+					DGM_ASSERT_MSG(attempt < 16, "The covariance matrix of a Gaussian can not be decomposed");
+					jitter = jitter > 0 ? 10 * jitter : 1e-9 * scale;
+				}
+
+				// Linv = L^{-1} with the forward substitution
+				Linv = Mat::zeros(nFeatures, nFeatures, CV_64FC1);
+				for (int c = 0; c < nFeatures; c++) {
+					Linv.at<double>(c, c) = 1.0 / L.at<double>(c, c);
+					for (int i = c + 1; i < nFeatures; i++) {
+						double sum = 0;
+						for (int j = c; j < i; j++) sum += L.at<double>(i, j) * Linv.at<double>(j, c);
+						Linv.at<double>(i, c) = -sum / L.at<double>(i, i);
+					} // i
+				} // c
+
+				double logDet = 0;																// ln(sqrt(det(sigma))) = sum ln(L_ii)
+				for (int i = 0; i < nFeatures; i++) {
+					logDet += log(L.at<double>(i, i));
+					m_mu.at<float>(i, g) = static_cast<float>(mu.at<double>(i, 0));
+					for (int j = 0; j <= i; j++)
+						m_whitening.at<float>(i * (i + 1) / 2 + j, g) = static_cast<float>(Linv.at<double>(i, j));
+				} // i
+				const double logAlpha = -MAX(logMinDet, logDet) - logSqrtPi;
+				m_logCoefficient.at<float>(0, g) = static_cast<float>(log(static_cast<double>(gauss.getNumPoints()) / nAllPoints) + logAlpha - logMinAlpha);
+				g++;
+			} // gauss
+		} // s
+	}
+
+	void CTrainNodeGMM::evaluate(const float *pFv, float *pPot) const
+	{
+		const int	 nGausses	= m_vOffsets.empty() ? 0 : m_vOffsets.back();
+		float		*pExp		= CArena::getScratch<float>(nGausses);
+
+		simd::mahalanobis(pFv, m_mu.ptr<float>(), m_whitening.ptr<float>(), pExp, getNumFeatures(), nGausses);
+
+		const float *pLogCoefficient = m_logCoefficient.ptr<float>();
+		for (byte s = 0; s < m_nStates; s++) {												// state
+			const int begin = nGausses ? m_vOffsets[s]	   : 0;
+			const int end	= nGausses ? m_vOffsets[s + 1] : 0;
+			if (begin == end) {
+				pPot[s] = -1.0f;
+				continue;
 			}
+
+			float max = -FLT_MAX;
+			for (int g = begin; g < end; g++) {
+				pExp[g] = pLogCoefficient[g] - 0.5f * pExp[g];
+				if (max < pExp[g]) max = pExp[g];
+			}
+			float sum = 0;
+			for (int g = begin; g < end; g += 255) {
+				const byte n = static_cast<byte>(MIN(255, end - g));
+				simd::expVec(pExp + g, pExp + g, n, max);
+				for (byte i = 0; i < n; i++) sum += pExp[g + i];
+			} // g
+			pPot[s] = expf(max) * sum;
 		} // s
 	}
+
+	// The samples are split into the fixed blocks, which accumulate the sufficient statistics (sum of weights, sum of x and sum of x x^T per Gaussian) in parallel.
+	// The blocks are summed up sequentially, thus the mixture does not depend on the number of threads
+	GaussianMixture CTrainNodeGMM::trainEM(const Mat &samples) const
+	{
+		GaussianMixture res;
+		if (samples.empty()) return res;
+
+		const int	nFeatures	= getNumFeatures();
+		const int	nSamples	= samples.rows;
+		const int	nBlocks		= MIN(64, (nSamples + 1023) / 1024);
+		Mat X;
+		samples.convertTo(X, CV_64F);																	// Mat(size: nSamples x nFeatures; type: CV_64FC1)
+		int nGausses = static_cast<int>(std::min<size_t>(m_params.maxGausses, std::max<size_t>(1, nSamples / m_params.minSamples)));
+		auto getBlock = [&](int b) { return Range(b * nSamples / nBlocks, (b + 1) * nSamples / nBlocks); };
+
+		// ======================================= k-means++ seeding =======================================
+		Mat centers(nGausses, nFeatures, CV_64FC1);
+		X.row(random::u<int>(0, nSamples - 1)).copyTo(centers.row(0));
+		std::vector<double> vDist2(nSamples, DBL_MAX);													// squared distance to the nearest center
+		std::vector<double> vBlockSum(nBlocks);
+		for (int k = 0; k < nGausses; k++) {
+			const double *pCenter = centers.ptr<double>(k);
+			parallel::parallelFor(Range(0, nBlocks), [&](const Range &range) {
+				for (int b = range.start; b < range.end; b++) {
+					const Range block = getBlock(b);
+					double		sum	  = 0;
+					for (int i = block.start; i < block.end; i++) {
+						const double *pX = X.ptr<double>(i);
+						double dist2 = 0;
+						for (int f = 0; f < nFeatures; f++) dist2 += (pX[f] - pCenter[f]) * (pX[f] - pCenter[f]);
+						if (vDist2[i] > dist2) vDist2[i] = dist2;
+						sum += vDist2[i];
+					} // i
+					vBlockSum[b] = sum;
+				} // b
+			}, 1);
+			if (k + 1 == nGausses) break;
+
+			double total = 0;
+			for (double sum : vBlockSum) total += sum;
+			if (total <= 0) {																			// all the samples coincide with the centers
+				nGausses = k + 1;
+				break;
+			}
+			double r = random::U<double>(0, total);
+			int i = 0;
+			for (; i < nSamples - 1; i++) {
+				r -= vDist2[i];
+				if (r < 0) break;
+			}
+			X.row(i).copyTo(centers.row(k + 1));
+		} // k
+
+		// ======================================== E- and M-steps =========================================
+		const int			statSize	= 1 + nFeatures + nFeatures * nFeatures;						// weight, sum of x, sum of x x^T
+		std::vector<double> vStats(static_cast<size_t>(nBlocks) * nGausses * statSize);
+		std::vector<double> vBlockLL(nBlocks);
+		std::vector<double> vLogPi;
+
+		// Regularization of the covariance matrices: a fraction of the mean variance of the samples
+		Mat mean, var;
+		reduce(X, mean, 0, REDUCE_AVG);
+		reduce(X.mul(X), var, 0, REDUCE_AVG);
+		var -= mean.mul(mean);
+		double reg = 1e-3 * sum(var)[0] / nFeatures;
+		if (reg <= 0) reg = 1e-3;
+
+		// Accumulates the statistics with the hard assignments to the k-means++ centers (for <hard>) or with the responsibilities of the current mixture
+		auto accumulate = [&](bool hard) {
+			std::fill(vStats.begin(), vStats.end(), 0.0);
+			parallel::parallelFor(Range(0, nBlocks), [&](const Range &range) {
+				double *resp = CArena::getScratch<double>(nGausses, 2);
+				for (int b = range.start; b < range.end; b++) {
+					const Range block = getBlock(b);
+					double	   *pStats = &vStats[static_cast<size_t>(b) * nGausses * statSize];
+					double		ll	   = 0;
+					for (int i = block.start; i < block.end; i++) {
+						const double *pX = X.ptr<double>(i);
+						if (hard) {
+							int		best	 = 0;
+							double	minDist2 = DBL_MAX;
+							for (int k = 0; k < nGausses; k++) {
+								const double *pCenter = centers.ptr<double>(k);
+								double dist2 = 0;
+								for (int f = 0; f < nFeatures; f++) dist2 += (pX[f] - pCenter[f]) * (pX[f] - pCenter[f]);
+								if (dist2 < minDist2) {
+									minDist2 = dist2;
+									best	 = k;
+								}
+							} // k
+							std::fill(resp, resp + nGausses, 0.0);
+							resp[best] = 1;
+						} else {
+							const Mat	x(nFeatures, 1, CV_64FC1, const_cast<double *>(pX));
+							double		maxLog = -DBL_MAX;
+							for (size_t k = 0; k < res.size(); k++) {
+								resp[k] = vLogPi[k] + res[k].getLogValue(x);
+								if (maxLog < resp[k]) maxLog = resp[k];
+							}
+							double sumExp = 0;
+							for (size_t k = 0; k < res.size(); k++) sumExp += (resp[k] = exp(resp[k] - maxLog));
+							for (size_t k = 0; k < res.size(); k++) resp[k] /= sumExp;
+							ll += maxLog + log(sumExp);
+						}
+						for (int k = 0; k < nGausses; k++) {
+							if (resp[k] == 0) continue;
+							double *pStat = pStats + k * statSize;
+							pStat[0] += resp[k];
+							for (int f = 0; f < nFeatures; f++) pStat[1 + f] += resp[k] * pX[f];
+							for (int y = 0; y < nFeatures; y++)
+								for (int x = y; x < nFeatures; x++)
+									pStat[1 + nFeatures + y * nFeatures + x] += resp[k] * pX[y] * pX[x];
+						} // k
+					} // i
+					vBlockLL[b] = ll;
+				} // b
+			}, 1);
+
+			double ll = 0;
+			for (int b = 1; b < nBlocks; b++) {
+				const double *pSrc = &vStats[static_cast<size_t>(b) * nGausses * statSize];
+				for (int j = 0; j < nGausses * statSize; j++) vStats[j] += pSrc[j];
+			}
+			for (double val : vBlockLL) ll += val;
+			return ll;
+		};
+
+		// Estimates the mixture from the summed statistics; the Gaussians without samples are removed
+		auto maximize = [&]() {
+			GaussianMixture gaussianMixture;
+			vLogPi.clear();
+			Mat mu(nFeatures, 1, CV_64FC1);
+			Mat sigma(nFeatures, nFeatures, CV_64FC1);
+			for (int k = 0; k < nGausses; k++) {
+				const double *pStat = &vStats[k * statSize];
+				const double  n		= pStat[0];
+				if (n < 1) continue;
+				for (int f = 0; f < nFeatures; f++) mu.at<double>(f, 0) = pStat[1 + f] / n;
+				for (int y = 0; y < nFeatures; y++)
+					for (int x = y; x < nFeatures; x++) {
+						double val = pStat[1 + nFeatures + y * nFeatures + x] / n - mu.at<double>(y, 0) * mu.at<double>(x, 0);
+						if (x == y) val += reg;
+						sigma.at<double>(y, x) = sigma.at<double>(x, y) = val;
+					} // x
+				CKDGauss gauss(nFeatures);
+				gauss.setMu(mu);
+				gauss.setSigma(sigma);
+				gauss.setNumPoints(static_cast<long>(n + 0.5));
+				gauss.finalize();
+				gaussianMixture.push_back(gauss);
+				vLogPi.push_back(log(n / nSamples));
+			} // k
+			res		 = std::move(gaussianMixture);
+			nGausses = static_cast<int>(res.size());
+		};
+
+		accumulate(true);
+		maximize();
+		double prevLL = -DBL_MAX;
+		for (unsigned int it = 0; it < m_nEMIt; it++) {
+			const double ll = accumulate(false);
+			maximize();
+			if (ll - prevLL < 1e-6 * fabs(ll)) break;
+			prevLL = ll;
+		} // it
+
+		return res;
+	}
 }
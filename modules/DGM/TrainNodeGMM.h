@@ -5,6 +5,7 @@
 
 #include "TrainNode.h"
 #include "KDGauss.h"
+#include "SamplesAccumulator.h"
 
 namespace DirectGraphicalModels
 {
@@ -35,6 +36,15 @@ namespace DirectGraphicalModels
 	* @details This class implements the generative training mechanism, based on the idea of approximating the density of multi-dimensional random variables
 	* with an additive super-position of multivariate Gaussian distributions. The underlying algorithm is described in the paper
 	* <a href="http://www.project-10.de/Kosov/files/GCPR_2013.pdf" target="_blank">Sequential Gaussian Mixture Models for Two-Level Conditional Random Fields</a>
+	*
+	* The sequential algorithm depends on the order of the samples. Alternatively, the mixtures may be estimated with the Expectation-Maximization algorithm
+	* (ref. setEM()), which scales with the number of cores. The trained mixtures are the same @ref GaussianMixture containers in both cases, and are saved in the same format:
+	* @code
+	* CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+	* nodeTrainer.setEM(true, 1000000);														// at most 10^6 random samples per state
+	* nodeTrainer.addFeatureVecs(featureVectors, gt);
+	* nodeTrainer.train();
+	* @endcode
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CTrainNodeGMM : public CTrainNode
@@ -58,23 +68,93 @@ namespace DirectGraphicalModels
 
 		DllExport void	reset(void);
 
+		/**
+		* @brief Adds new feature vector
+		* @details The point is added to the nearest Gaussian of the mixture of state \b gt, or starts a new Gaussian. The nearest Gaussian is searched with the
+		* early termination of the Euclidean distances, and the updated Gaussian keeps its inverse covariance matrix with the rank-1 updates (ref. CKDGauss::addPoint()),
+		* thus a sample costs \f$O(nGausses \cdot nFeatures + nFeatures^2)\f$ without memory allocations.
+		* @param featureVector Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_{XX}C1)
+		* @param gt Corresponding ground-truth state (class)
+		*/
 		DllExport void	addFeatureVec(const Mat &featureVector, byte gt);
 		DllExport void	train(bool doClean = false);
+		DllExport size_t getMemoryUsage(void) const;
+		/**
+		* @brief Enables the training with the Expectation-Maximization algorithm
+		* @details If enabled, the feature vectors are accumulated in the reservoirs of the @ref CSamplesAccumulator, and the mixture of every state is estimated in train():
+		* the Gaussians are initialized with the <a href="https://en.wikipedia.org/wiki/K-means%2B%2B">k-means++</a> seeding, followed by the E- and M-steps, which run
+		* in parallel over the blocks of samples with the sufficient statistics of every block. The statistics of the blocks are summed up in the fixed order, thus 
+		* the result does not depend on the number of threads. The number of Gaussians of a state is limited by \a maxGausses and by the number of samples per \a minSamples
+		* (ref. @ref TrainNodeGMMParams); the Gaussians, which lose their samples, are removed. 
+		* > Enabling or disabling this mode discards the accumulated samples
+		* @param enable Flag indicating whether the EM algorithm should be used instead of the sequential one
+		* @param maxSamples Maximum number of samples per state to be used in training. Default value \b 0 means using all the samples
+		* @param nIt Maximal number of EM iterations
+		*/
+		DllExport void	setEM(bool enable, size_t maxSamples = 0, unsigned int nIt = 100);
+		/**
+		* @brief Compacts the trained mixtures
+		* @details The inference evaluates all the Gaussians of all the states for every pixel, while only few of them contribute noticeably to the potentials.
+		* This function greedily merges the pairs of Gaussians of one state (ref. CKDGauss::operator+=()) with the smallest
+		* <a href="https://doi.org/10.1109/TAES.2007.4383588">Runnalls</a> upper bound of the Kullback-Leibler divergence between the mixture before and after the merge:
+		* \f[ B_{ij} = \frac{1}{2}\left((w_i + w_j)\ln|\Sigma_{ij}| - w_i\ln|\Sigma_i| - w_j\ln|\Sigma_j|\right), \f]
+		* where \f$w\f$ are the weights of the Gaussians in the mixture. The merging stops, when the mixture has at most \a maxGausses Gaussians, and the next merge 
+		* would increase the sum of the bounds of the state above \a maxLoss. Afterwards the mixtures are compiled anew. The inference time is proportional to the 
+		* number of the remaining Gaussians (ref. getNumGausses()):
+		* @code
+		* nodeTrainer.train();
+		* double loss = nodeTrainer.compact(8, 0.01);											// at most 8 Gaussians per state, and as many merges as cost 0.01 nats
+		* @endcode
+		* @param maxGausses The target number of Gaussians per state
+		* @param maxLoss The maximal sum of the divergence bounds of the merges per state, beyond the \a maxGausses budget
+		* @return The sum of the divergence bounds of all the merges over all the states
+		*/
+		DllExport double compact(word maxGausses, double maxLoss = 0);
+		/**
+		* @brief Returns the number of Gaussians
+		* @param state The state (class)
+		* @return The number of Gaussians in the mixture of state \b state
+		*/
+		DllExport size_t getNumGausses(byte state) const { return state < m_vGaussianMixtures.size() ? m_vGaussianMixtures[state].size() : 0; }
 
 
 	protected:
 		DllExport void	saveFile(FILE *pFile) const;
 		DllExport void	loadFile(FILE *pFile);
+		DllExport void	saveSections(CModelFileWriter &writer) const;
+		/**
+		* @brief Loads the random model from the model container
+		* @details The packed arrays of the compiled mixtures refer to the sections of the container, thus the Gaussians are not re-compiled
+		* @param file The model container
+		*/
+		DllExport void	loadSections(const CModelFile &file);
 		/**
 		* @brief Calculates the node potential, based on the feature vector
 		* @details This function calculates the potentials of the node, described with the sample \a featureVector (\f$ \textbf{f} \f$):
 		* \f$ nodePot_s = \sum^{nGaussians_s}_{i=1}\pi_{i,s}\cdot\mathcal{N}_{i,s}(\textbf{f}), \forall s \in \mathbb{S} \f$, where \f$\mathbb{S}\f$ is the set of all states (classes) and \f$\pi\f$ is a weighted coefficient.
 		* In other words, the indexes: \f$ s \in [0; nStates) \f$. Here \f$ \mathcal{N} \f$ is a Gaussian function kernel, described in class @ref CKDGauss
+		* The Gaussians are evaluated in the log-domain with the whitening matrices, compiled in train().
 		* @param[in]	featureVector Multi-dimensinal point \f$\textbf{f}\f$: Mat(size: nFeatures x 1; type: CV_{XX}C1)
 		* @param[in,out]	potential %Node potentials: Mat(size: nStates x 1; type: CV_32FC1). This parameter should be preinitialized and set to value 0.
 		* @param[in,out]	mask Relevant %Node potentials: Mat(size: nStates x 1; type: CV_8UC1). This parameter should be preinitialized and set to value 1 (all potentials are relevant).
 		*/
 		DllExport void calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		/**
+		* @brief Adds a block of new feature vectors
+		* @details The block is converted to the double precision once per row and its points are added in the same order as with addFeatureVec()
+		* @param featureVectors Multi-channel matrix, each element of which is a multi-dimensinal point: Mat(type: CV_{XX}C(nFeatures))
+		* @param gt Matrix, each element of which is a ground-truth state (class): Mat(type: CV_8UC1)
+		*/
+		DllExport void addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		/**
+		* @brief Merges the Gaussians, accumulated by a worker, into this node trainer
+		* @details Every Gaussian of the worker is either added to the mixture of the corresponding state or merged with the nearest Gaussian 
+		* in the same way as addFeatureVec() treats the points
+		* @param worker The worker, created with createWorker() function
+		*/
+		DllExport void merge(CTrainNode &worker);
 
 
 	private:
@@ -82,10 +162,45 @@ namespace DirectGraphicalModels
 		static const long double		MAX_COEFFICIENT;
 
 
+	private:
+		/**
+		* @brief Compiles the trained mixtures into the packed arrays
+		* @details Fills the \a m_mu, \a m_whitening and \a m_logCoefficient containers with the data of all the Gaussians of all the states.
+		* Must be called every time the mixtures are changed.
+		*/
+		void compile(void);
+		/**
+		* @brief Adds new point to the mixture of a state
+		* @param point Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_64FC1)
+		* @param gt Corresponding ground-truth state (class)
+		*/
+		void addSample(const Mat &point, byte gt);
+		/**
+		* @brief Estimates a Gaussian mixture with the EM algorithm
+		* @param samples The samples of one state: Mat(size: nSamples x nFeatures; type: CV_{XX}C1)
+		* @return The Gaussian mixture
+		*/
+		GaussianMixture trainEM(const Mat &samples) const;
+		/**
+		* @brief Evaluates the node potentials with the packed arrays
+		* @details This function calculates \f$ nodePot_s = \exp(\ln\sum_i\exp(\ln\pi_{i,s} - \frac{1}{2}\|W_{i,s}(\textbf{f} - \mu_{i,s})\|^2)) \f$ 
+		* with the log-sum-exp trick, where \f$ W \f$ is the inverse of the Cholesky factor of the covariance matrix.
+		* @param pFv Pointer to the \a nFeatures features
+		* @param pPot Pointer to the \a nStates resulting potentials. The potentials of the states without Gaussians are set to -1 (irrelevant)
+		*/
+		void evaluate(const float *pFv, float *pPot) const;
+
+
 	private:
 		TrainNodeGMMParams				m_params;
 		std::vector<GaussianMixture>	m_vGaussianMixtures;						// block of n-dimensional Gauss function	
 		long double						m_minAlpha = 1;								// auxilary coefficient for scaling gaussian coefficients
+		Mat								m_mu;										///< The means of all the Gaussians: Mat(size: nFeatures x nGausses; type: CV_32FC1)
+		Mat								m_whitening;								///< The packed lower triangular whitening matrices: Mat(size: nFeatures * (nFeatures + 1) / 2 x nGausses; type: CV_32FC1)
+		Mat								m_logCoefficient;							///< The logarithms of the scaled mixture coefficients: Mat(size: 1 x nGausses; type: CV_32FC1)
+		vec_int_t						m_vOffsets;									///< The Gaussians of state s occupy the columns [m_vOffsets[s]; m_vOffsets[s + 1])
+		std::unique_ptr<CSamplesAccumulator> m_pSamplesAcc;							///< Samples Accumulator of the EM training (empty for the sequential training)
+		unsigned int					m_nEMIt = 100;								///< Maximal number of EM iterations
 	};
 }
 
@@ -1,5 +1,7 @@
 #include "TrainNodeKNN.h"
 #include "mathop.h"
+#include "footprint.h"
+#include "ModelFile.h"
 
 namespace DirectGraphicalModels 
 {
@@ -28,10 +30,22 @@ namespace DirectGraphicalModels
 	{
 		m_pSamplesAcc->reset();
 		m_pTree->reset();
+		if (m_pForest) m_pForest->reset();
+	}
+
+	void CTrainNodeKNN::setIncremental(bool enable)
+	{
+		if (enable) m_pForest = std::make_unique<CKDForest>();
+		else		m_pForest.reset();
+		m_pTree->reset();
 	}
 
 	void CTrainNodeKNN::save(const std::string &path, const std::string &name, short idx) const
 	{
+		if (m_pForest) {
+			DGM_WARNING("The k-D forest may be stored with saveModel() only");
+			return;
+		}
 		std::string fileName = generateFileName(path, name.empty() ? "TrainNodeKNN" : name, idx);
 		m_pTree->save(fileName);
 	}
@@ -42,11 +56,46 @@ namespace DirectGraphicalModels
 		m_pTree->load(fileName);
 	}
 
+	void CTrainNodeKNN::saveSections(CModelFileWriter &writer) const
+	{
+		if (m_pForest)	m_pForest->save(writer, "KNN.forest");
+		else			m_pTree->save(writer, "KNN.tree");
+	}
+
+	void CTrainNodeKNN::loadSections(const CModelFile &file)
+	{
+		setIncremental(file.hasSection("KNN.forest.levels"));
+		if (m_pForest)	m_pForest->load(file, "KNN.forest");
+		else			m_pTree->load(file, "KNN.tree");
+	}
+
 	void CTrainNodeKNN::addFeatureVec(const Mat &featureVector, byte gt)
 	{
 		m_pSamplesAcc->addSample(featureVector, gt);
 	}
 
+	void CTrainNodeKNN::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		m_pSamplesAcc->addSamples(featureVectors, gt);
+	}
+
+	std::shared_ptr<CTrainNode> CTrainNodeKNN::createWorker(void) const
+	{
+		auto res = std::make_shared<CTrainNodeKNN>(m_nStates, getNumFeatures(), m_params);
+		if (m_pForest) res->setIncremental(true);
+		return res;
+	}
+
+	void CTrainNodeKNN::merge(CTrainNode &worker)
+	{
+		m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeKNN &>(worker).m_pSamplesAcc);
+	}
+
+	size_t CTrainNodeKNN::getMemoryUsage(void) const
+	{
+		return sizeof(*this) + m_pTree->getMemoryUsage() + m_pSamplesAcc->getMemoryUsage() + (m_pForest ? m_pForest->getMemoryUsage() : 0);
+	}
+
 	void CTrainNodeKNN::train(bool doClean)
 	{
 #ifdef DEBUG_PRINT_INFO
@@ -65,26 +114,41 @@ namespace DirectGraphicalModels
 			if (doClean) m_pSamplesAcc->release(s);				// free memory
 		} // s
 
-		// Training, e.g. building the tree
-		m_pTree->build(samples, classes);
+		// Training, e.g. building the tree or adding the new samples to the forest
+		if (m_pForest) {
+			m_pForest->add(samples, classes);
+			m_pSamplesAcc->reset();								// the samples are added only once
+		}
+		else m_pTree->build(samples, classes);
 	}
 
 	void CTrainNodeKNN::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
 	{
-		auto nearestNeighbors = m_pTree->findNearestNeighbors(featureVector.t(), m_params.maxNeighbors);
-		//float minr = mathop::Euclidian<byte, float>(featureVector.t(), nearestNeighbors.front()->getKey());
-
-		size_t n = nearestNeighbors.size();
-		for (auto node : nearestNeighbors) {
-			byte  s = node->getValue();				
-			
-			//float r = mathop::Euclidian<byte, float>(featureVector.t(), node->getKey());			
-			//r = 1 + r - minr;
-			//potential.at<float>(s, 0) += 0.1f / (r * r);
-			
-			potential.at<float>(s, 0) += 1.0f;
-		}
-		if (n) potential /= static_cast<double>(n);
-		potential += m_params.bias;
+		Mat potentials;
+		calculateNodePotentials(featureVector.t(), potentials);
+		for (byte s = 0; s < m_nStates; s++) potential.at<float>(s, 0) = potentials.at<float>(0, s);
+	}
+
+	void CTrainNodeKNN::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		Mat labels;
+		if (m_pForest)	m_pForest->knnSearch(featureMatrix, m_params.maxNeighbors, labels, m_params.maxLeafVisits);
+		else			m_pTree->knnSearch(featureMatrix, m_params.maxNeighbors, labels, m_params.maxLeafVisits);
+
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+		potentials.setTo(0);
+		for (int i = 0; i < featureMatrix.rows; i++) {
+			float *pPot = potentials.ptr<float>(i);
+			if (!labels.empty()) {
+				const byte *pLabels = labels.ptr<byte>(i);
+				for (int k = 0; k < labels.cols; k++) pPot[pLabels[k]] += 1.0f;
+			}
+
+			const float n = static_cast<float>(labels.cols);
+			for (byte s = 0; s < m_nStates; s++) {
+				if (n > 0) pPot[s] /= n;
+				pPot[s] += m_params.bias;
+			}
+		} // i
 	}
 }
@@ -4,6 +4,7 @@
 
 #include "TrainNode.h"
 #include "KDTree.h"
+#include "KDForest.h"
 #include "SamplesAccumulator.h"
 
 namespace DirectGraphicalModels
@@ -13,15 +14,17 @@ namespace DirectGraphicalModels
 		float	bias;								///< Regularization CRF parameter: bias is added to all potential values
 		size_t	maxNeighbors;						///< Max number of neighbors to be used for calculating potentials
 		size_t 	maxSamples;							///< Maximum number of samples to be used in training. 0 means using all the samples
+		size_t	maxLeafVisits;						///< Maximum number of the k-D tree leaves, visited per sample: trades the recall of the neighbors for speed. 0 means the exact search
 
 		TrainNodeKNNParams() {}
-		TrainNodeKNNParams(float _bias, size_t _maxNeighbors, size_t _maxSamples) : bias(_bias), maxNeighbors(_maxNeighbors), maxSamples(_maxSamples) {}
+		TrainNodeKNNParams(float _bias, size_t _maxNeighbors, size_t _maxSamples, size_t _maxLeafVisits = 0) : bias(_bias), maxNeighbors(_maxNeighbors), maxSamples(_maxSamples), maxLeafVisits(_maxLeafVisits) {}
 	} TrainNodeKNNParams;
 	
 	const TrainNodeKNNParams TRAIN_NODE_KNN_PARAMS_DEFAULT =	TrainNodeKNNParams(
 																0.1f,	// Regularization CRF parameter: bias is added to all potential values
 																100,	// Max number of neighbors to be used for calculating potentials
-																0		// Maximum number of samples to be used in training. 0 means using all the samples
+																0,		// Maximum number of samples to be used in training. 0 means using all the samples
+																0		// Maximum number of the k-D tree leaves, visited per sample. 0 means the exact search
 																);
 
 	// ====================== k-Nearest Neighbors Train Class =====================
@@ -32,6 +35,19 @@ namespace DirectGraphicalModels
 	* where the input consists of the k closest training samples in the feature space and the output depends on k-Nearest Neighbors. The implementation is based on 
 	* the <a href="https://en.wikipedia.org/wiki/K-d_tree" target="blank"><i>k</i>-d tree</a> data structure: @ref CKDTree.
 	* > This trainer is especially effective for low-dimentional feature spaces.
+	*
+	* In the incremental mode (ref. setIncremental()) the samples are kept in the logarithmic forest of the k-d trees (@ref CKDForest) instead of one tree:
+	* every call of train() adds only the samples, accumulated since the previous call, thus a few new samples do not trigger the rebuilding of the whole index,
+	* \a e.g. in an active-learning loop:
+	* @code
+	* nodeTrainer.setIncremental(true);
+	* nodeTrainer.addFeatureVecs(featureVectors, gt);
+	* nodeTrainer.train();
+	* while (...) {
+	*	nodeTrainer.addFeatureVecs(newFeatureVectors, newGt);
+	*	nodeTrainer.train();														// amortized O(log n) per new sample
+	* }
+	* @endcode
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CTrainNodeKNN : public CTrainNode
@@ -61,17 +77,31 @@ namespace DirectGraphicalModels
 
 		DllExport void	addFeatureVec(const Mat &featureVector, byte gt);
 		DllExport void	train(bool doClean = false);
+		DllExport size_t getMemoryUsage(void) const;
+		/**
+		* @brief Enables the incremental training
+		* @details Switching the mode resets the trained index
+		* @param enable Flag indicating whether the samples should be added to the @ref CKDForest index in every call of train()
+		*/
+		DllExport void	setIncremental(bool enable);
 
 
 	protected:
 		DllExport void	saveFile(FILE *pFile) const {}
 		DllExport void	loadFile(FILE *pFile) {}
+		DllExport void	saveSections(CModelFileWriter &writer) const;
+		DllExport void	loadSections(const CModelFile &file);
 		DllExport void	calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void	calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport void	addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void	merge(CTrainNode &worker);
 
 
 	protected:
 		std::unique_ptr<CKDTree>				m_pTree;					///< k-D Tree
 		std::unique_ptr<CSamplesAccumulator>	m_pSamplesAcc;				///< Samples Accumulator
+		std::unique_ptr<CKDForest>				m_pForest;					///< k-D Forest of the incremental mode (empty otherwise)
 
 
 	private:
@@ -4,17 +4,217 @@
 
 #include "sherwood/Sherwood.h"
 
-#ifdef ENABLE_PDP
-#include "sherwood/ParallelForestTrainer.h"				// for parallle computing
-#endif
-
 #include "sherwood/utilities/FeatureResponseFunctions.h"
 #include "sherwood/utilities/StatisticsAggregators.h"
 #include "sherwood/utilities/DataPointCollection.h"
 #include "sherwood/utilities/TrainingContexts.h"
 
+#include "ModelFile.h"
+#include "parallel.h"
+#include "random.h"
+#include "simd.h"
+#include "macroses.h"
+
 namespace DirectGraphicalModels
 {
+namespace {
+	using Forest	= sw::Forest<sw::LinearFeatureResponse, sw::HistogramAggregator>;
+	using Tree		= sw::Tree<sw::LinearFeatureResponse, sw::HistogramAggregator>;
+
+	const size_t BLOCK_SIZE = 16384;										// the nodes with more samples are split in parallel
+
+	// Trains one tree as the Sherwood TreeTrainingOperation does, with the random numbers drawn from the stream of the tree.
+	// The samples are read in place: vpSamples holds the pointers to the rows of the containers of the samples accumulator
+	class CTreeTrainer
+	{
+	public:
+		CTreeTrainer(const std::vector<const byte *> &vpSamples, const vec_byte_t &vLabels, byte nStates, word nFeatures, const sw::TrainingParameters &params, size_t tree)
+			: m_vpSamples(vpSamples)
+			, m_vLabels(vLabels)
+			, m_nStates(nStates)
+			, m_nFeatures(nFeatures)
+			, m_params(params)
+			, m_generator(random::getStream(tree))
+			, m_vIndices(vpSamples.size())
+		{
+			std::iota(m_vIndices.begin(), m_vIndices.end(), 0);
+		}
+
+		std::unique_ptr<Tree> train(void)
+		{
+			auto res = std::make_unique<Tree>(m_params.MaxDecisionLevels);
+			trainNode(res->GetNodes(), 0, 0, m_vIndices.size());
+			res->CheckValid();
+			return res;
+		}
+
+
+	private:
+		float getResponse(const float *pDx, size_t i) const
+		{
+			const byte *pSample = m_vpSamples[m_vIndices[i]];
+			float		res		= 0.0f;
+			for (word f = 0; f < m_nFeatures; f++) res += pDx[f] * pSample[f];
+			return res;
+		}
+
+		static double getEntropy(const unsigned long *pBins, byte nStates)
+		{
+			unsigned long nSamples = 0;
+			for (byte s = 0; s < nStates; s++) nSamples += pBins[s];
+			double res = 0.0;
+			if (nSamples == 0) return res;
+			for (byte s = 0; s < nStates; s++) {
+				const double p = static_cast<double>(pBins[s]) / nSamples;
+				if (p > 0) res -= p * log(p) / log(2.0);
+			}
+			return res;
+		}
+
+		// Draws the candidate thresholds from the responses of the random samples; returns their number, or 0 if all the drawn responses are the same
+		int chooseThresholds(const float *pDx, size_t i0, size_t i1, float *pThresholds)
+		{
+			const int	nMax		= static_cast<int>(m_params.NumberOfCandidateThresholdsPerFeature);
+			int			nThresholds;
+			vec_float_t &vQuantiles	= m_vQuantiles;
+			if (i1 - i0 < 2) return 0;
+			if (i1 - i0 > static_cast<size_t>(nMax)) {
+				nThresholds = nMax;
+				vQuantiles.resize(nThresholds + 1);
+				for (float &q : vQuantiles) q = getResponse(pDx, random::u<size_t>(m_generator, i0, i1 - 1));
+			}
+			else {
+				nThresholds = static_cast<int>(i1 - i0) - 1;
+				vQuantiles.resize(nThresholds + 1);
+				for (size_t i = i0; i < i1; i++) vQuantiles[i - i0] = getResponse(pDx, i);
+			}
+			std::sort(vQuantiles.begin(), vQuantiles.end());
+			if (vQuantiles[0] == vQuantiles[nThresholds]) return 0;
+			for (int t = 0; t < nThresholds; t++)
+				pThresholds[t] = vQuantiles[t] + random::U<float>(m_generator) * (vQuantiles[t + 1] - vQuantiles[t]);
+			return nThresholds;
+		}
+
+		void trainNode(std::vector<sw::Node<sw::LinearFeatureResponse, sw::HistogramAggregator>> &vNodes, size_t node, size_t i0, size_t i1)
+		{
+			const int	nCandidates	= m_params.NumberOfCandidateFeatures;
+			const int	nBins		= static_cast<int>(m_params.NumberOfCandidateThresholdsPerFeature) + 1;
+			const int	nBlocks		= static_cast<int>(std::min<size_t>(64, std::max<size_t>(1, (i1 - i0) / BLOCK_SIZE)));
+			auto		getBlock	= [&](int b) { return std::make_pair(i0 + b * (i1 - i0) / nBlocks, i0 + (b + 1) * (i1 - i0) / nBlocks); };
+
+			// The statistics of the node
+			std::vector<unsigned long> vParent(m_nStates, 0);
+			for (size_t i = i0; i < i1; i++) vParent[m_vLabels[m_vIndices[i]]]++;
+			sw::HistogramAggregator parent(m_nStates);
+			for (byte s = 0; s < m_nStates; s++) parent.Aggregate(s, vParent[s]);
+
+			if (node >= vNodes.size() / 2) {												// this is a leaf node, nothing else to do
+				vNodes[node].InitializeLeaf(parent);
+				return;
+			}
+
+			// The candidate features and thresholds are drawn sequentially, thus the tree does not depend on the number of threads
+			vec_float_t	vDx(static_cast<size_t>(nCandidates) * m_nFeatures);
+			vec_float_t	vThresholds(static_cast<size_t>(nCandidates) * nBins);
+			vec_int_t	vNumThresholds(nCandidates);
+			for (int c = 0; c < nCandidates; c++) {
+				float *pDx = &vDx[c * m_nFeatures];
+				float  R   = 0.0f;
+				for (word f = 0; f < m_nFeatures; f++) {
+					pDx[f] = random::U<float>(m_generator, -1.0f, 1.0f);
+					R += pDx[f] * pDx[f];
+				}
+				R = sqrtf(R);
+				for (word f = 0; f < m_nFeatures; f++) pDx[f] /= R;
+				vNumThresholds[c] = chooseThresholds(pDx, i0, i1, &vThresholds[c * nBins]);
+			} // c
+
+			// The histograms of the partitions of all the candidates for every block of the samples
+			const size_t histSize = static_cast<size_t>(nCandidates) * nBins * m_nStates;
+			std::vector<unsigned long> vHist(nBlocks * histSize, 0);
+			parallel::parallelFor(Range(0, nBlocks), [&](const Range &range) {
+				for (int b = range.start; b < range.end; b++) {
+					unsigned long *pHist = &vHist[b * histSize];
+					const auto	   block = getBlock(b);
+					for (size_t i = block.first; i < block.second; i++) {
+						const byte label = m_vLabels[m_vIndices[i]];
+						for (int c = 0; c < nCandidates; c++) {
+							const int nThresholds = vNumThresholds[c];
+							if (nThresholds == 0) continue;
+							const float *pThresholds = &vThresholds[c * nBins];
+							const float	 response	 = getResponse(&vDx[c * m_nFeatures], i);
+							int			 bin		 = 0;
+							while (bin < nThresholds && response >= pThresholds[bin]) bin++;
+							pHist[(c * nBins + bin) * m_nStates + label]++;
+						} // c
+					} // i
+				} // b
+			}, 1);
+			for (int b = 1; b < nBlocks; b++)
+				for (size_t j = 0; j < histSize; j++) vHist[j] += vHist[b * histSize + j];
+
+			// The best split
+			const double	entropy			= getEntropy(vParent.data(), m_nStates);
+			const double	nSamples		= static_cast<double>(i1 - i0);
+			double			maxGain			= 0.0;
+			int				bestCandidate	= 0;
+			float			bestThreshold	= 0.0f;
+			std::vector<unsigned long> vLeft(m_nStates), vRight(m_nStates);
+			for (int c = 0; c < nCandidates; c++) {
+				const unsigned long *pHist = &vHist[c * nBins * m_nStates];
+				for (int t = 0; t < vNumThresholds[c]; t++) {
+					std::fill(vLeft.begin(), vLeft.end(), 0);
+					for (int bin = 0; bin <= t; bin++)
+						for (byte s = 0; s < m_nStates; s++) vLeft[s] += pHist[bin * m_nStates + s];
+					unsigned long nLeft = 0;
+					for (byte s = 0; s < m_nStates; s++) {
+						vRight[s] = vParent[s] - vLeft[s];
+						nLeft += vLeft[s];
+					}
+					if (nSamples <= 1) continue;
+					const double gain = entropy - (nLeft * getEntropy(vLeft.data(), m_nStates) + (nSamples - nLeft) * getEntropy(vRight.data(), m_nStates)) / nSamples;
+					if (gain >= maxGain) {
+						maxGain			= gain;
+						bestCandidate	= c;
+						bestThreshold	= vThresholds[c * nBins + t];
+					}
+				} // t
+			} // c
+
+			// as ClassificationTrainingContext::ShouldTerminate()
+			if (maxGain < 0.01) {
+				vNodes[node].InitializeLeaf(parent);
+				return;
+			}
+
+			// The samples with the response below the threshold go to the left child
+			const float *pDx = &vDx[bestCandidate * m_nFeatures];
+			vNodes[node].InitializeSplit(sw::LinearFeatureResponse(m_nFeatures, const_cast<float *>(pDx)), bestThreshold, parent);
+			const auto	 it	 = std::partition(m_vIndices.begin() + i0, m_vIndices.begin() + i1, [&](size_t idx) {
+				const byte *pSample	= m_vpSamples[idx];
+				float		response	= 0.0f;
+				for (word f = 0; f < m_nFeatures; f++) response += pDx[f] * pSample[f];
+				return response < bestThreshold;
+			});
+			const size_t ii	 = static_cast<size_t>(std::distance(m_vIndices.begin(), it));
+
+			trainNode(vNodes, 2 * node + 1, i0, ii);
+			trainNode(vNodes, 2 * node + 2, ii, i1);
+		}
+
+
+	private:
+		const std::vector<const byte *>	& m_vpSamples;
+		const vec_byte_t				& m_vLabels;
+		byte							  m_nStates;
+		word							  m_nFeatures;
+		const sw::TrainingParameters	& m_params;
+		random::CPhilox					  m_generator;
+		vec_size_t						  m_vIndices;
+		vec_float_t						  m_vQuantiles;
+	};
+}
+
 // Constructor
     CTrainNodeMsRF::CTrainNodeMsRF(byte nStates, word nFeatures, TrainNodeMsRFParams params) : CBaseRandomModel(nStates), CTrainNode(nStates, nFeatures)
 {
@@ -49,10 +249,18 @@ void CTrainNodeMsRF::reset(void)
 {
 	m_pSamplesAcc->reset();
 	m_pRF.reset();
+	m_nodes.release();
+	m_directions.release();
+	m_leafBins.release();
+	m_vRoots.clear();
 }
 
 void CTrainNodeMsRF::save(const std::string &path, const std::string &name, short idx) const
 {
+	if (!m_pRF) {
+		DGM_WARNING("The Sherwood forest is not trained or has been loaded from a model container");
+		return;
+	}
 	std::string fileName = generateFileName(path, name.empty() ?  "TrainNodeMsRF" : name, idx);
 	m_pRF->Serialize(fileName);
 }
@@ -61,6 +269,34 @@ void CTrainNodeMsRF::load(const std::string &path, const std::string &name, shor
 {
 	std::string fileName = generateFileName(path, name.empty() ?  "TrainNodeMsRF" : name, idx);
     m_pRF = sw::Forest<sw::LinearFeatureResponse, sw::HistogramAggregator>::Deserialize(fileName);
+	compile();
+}
+
+void CTrainNodeMsRF::saveSections(CModelFileWriter &writer) const
+{
+	// The leaf histograms are scaled to 16 bits only if the counts do not fit
+	double maxCount = 0;
+	if (!m_leafBins.empty()) minMaxLoc(m_leafBins, NULL, &maxCount);
+	const double scale = maxCount > 0xFFFF ? 0xFFFF / maxCount : 1.0;
+	Mat leafBins;
+	m_leafBins.convertTo(leafBins, CV_16UC1, scale);
+
+	writer.addSection("MsRF.nodes",		 m_nodes);
+	writer.addSection("MsRF.directions", m_directions);
+	writer.addSection("MsRF.leafBins",	 leafBins);
+	writer.addSection("MsRF.roots",		 Mat(1, static_cast<int>(m_vRoots.size()), CV_32SC1, const_cast<int *>(m_vRoots.data())));
+}
+
+void CTrainNodeMsRF::loadSections(const CModelFile &file)
+{
+	m_pRF.reset();
+	m_nodes		 = file.getSection("MsRF.nodes");
+	m_directions = file.getSection("MsRF.directions");
+	DGM_ASSERT_MSG(m_directions.empty() || m_directions.cols == getNumFeatures(), "The file has been saved for another number of features");
+	file.getSection("MsRF.leafBins").convertTo(m_leafBins, CV_32FC1);
+	DGM_ASSERT_MSG(m_leafBins.empty() || m_leafBins.cols == m_nStates, "The file has been saved for another number of states");
+	const Mat roots = file.getSection("MsRF.roots");
+	m_vRoots.assign(roots.ptr<int>(0), roots.ptr<int>(0) + roots.cols);
 }
 
 void CTrainNodeMsRF::addFeatureVec(const Mat &featureVector, byte gt)
@@ -68,67 +304,155 @@ void CTrainNodeMsRF::addFeatureVec(const Mat &featureVector, byte gt)
 	m_pSamplesAcc->addSample(featureVector, gt);
 }
 
+void CTrainNodeMsRF::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+{
+	m_pSamplesAcc->addSamples(featureVectors, gt);
+}
+
+std::shared_ptr<CTrainNode> CTrainNodeMsRF::createWorker(void) const
+{
+	return std::make_shared<CTrainNodeMsRF>(m_nStates, getNumFeatures(), m_pSamplesAcc->getMaxSamples());
+}
+
+void CTrainNodeMsRF::merge(CTrainNode &worker)
+{
+	m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeMsRF &>(worker).m_pSamplesAcc);
+}
+
 void CTrainNodeMsRF::train(bool doClean)
 {
 #ifdef DEBUG_PRINT_INFO
 	printf("\n");
 #endif
-	// Filling <pData>
-	sw::DataPointCollection * pData = new sw::DataPointCollection();
-	pData->m_dimension = getNumFeatures();
-
+	// The samples are referred in the containers of the accumulator
+	std::vector<const byte *>	vpSamples;
+	vec_byte_t					vLabels;
 	for (byte s = 0; s < m_nStates; s++) {						// states
 		int nSamples = m_pSamplesAcc->getNumSamples(s);
 #ifdef DEBUG_PRINT_INFO		
 		printf("State[%d] - %d of %d samples\n", s, nSamples, m_pSamplesAcc->getNumInputSamples(s));
 #endif
-		for (int smp = 0; smp < nSamples; smp++) {
-			for (word f = 0; f < getNumFeatures(); f++) {			// features
-				byte fval = m_pSamplesAcc->getSamplesContainer(s).at<byte>(smp, f);
-				pData->m_vData.push_back(fval);
-			} // f
-			pData->m_vLabels.push_back(s);
-		} // smp
-		if (doClean) m_pSamplesAcc->release(s);					// releases memory
+		const Mat samples = m_pSamplesAcc->getSamplesContainer(s);
+		DGM_ASSERT(samples.empty() || samples.depth() == CV_8U);
+		for (int smp = 0; smp < nSamples; smp++) vpSamples.push_back(samples.ptr<byte>(smp));
+		vLabels.insert(vLabels.end(), nSamples, s);
 	} // s
 
+	// Training: the trees are independent, and the large nodes of every tree are split in parallel
+	std::vector<std::unique_ptr<Tree>> vpTrees(m_pParams->NumberOfTrees);
+	parallel::parallelFor(Range(0, m_pParams->NumberOfTrees), [&](const Range &range) {
+		for (int t = range.start; t < range.end; t++)
+			vpTrees[t] = CTreeTrainer(vpSamples, vLabels, m_nStates, getNumFeatures(), *m_pParams, t).train();
+	}, 1);
+	if (m_pParams->Verbose) printf("Trained %d trees.\n", m_pParams->NumberOfTrees);
 
-	// Training
-	sw::Random random;
-	sw::ClassificationTrainingContext classificationContext(m_nStates, getNumFeatures());
-#ifdef ENABLE_PDP
-	// Use this function with cautions - it is not verifiied!
-	m_pRF = sw::ParallelForestTrainer<sw::LinearFeatureResponse, sw::HistogramAggregator>::TrainForest(random, *m_pParams, classificationContext, *pData);
-#else
-	m_pRF = sw::ForestTrainer<sw::LinearFeatureResponse, sw::HistogramAggregator>::TrainForest(random, *m_pParams, classificationContext, *pData);
-#endif
-
-	delete pData;
+	m_pRF = std::make_unique<Forest>();
+	for (auto &pTree : vpTrees) m_pRF->AddTree(std::move(pTree));
+	if (doClean)
+		for (byte s = 0; s < m_nStates; s++) m_pSamplesAcc->release(s);			// releases memory
+	compile();
 }	
 
 void CTrainNodeMsRF::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
 {
-	std::unique_ptr<sw::DataPointCollection> testData = std::unique_ptr<sw::DataPointCollection>(new sw::DataPointCollection());
-	testData->m_dimension = getNumFeatures();
-	for (word f = 0; f < getNumFeatures(); f++) {
-		float feature = static_cast<float>(featureVector.ptr<byte>(f)[0]);
-		testData->m_vData.push_back(feature);
-	}
+	Mat featureMatrix = featureVector.t();							// Mat(size: 1 x nFeatures)
+	Mat pot;
+	calculateNodePotentials(featureMatrix, pot);
+	for (byte s = 0; s < m_nStates; s++) 
+		potential.at<float>(s, 0) = pot.at<float>(0, s);
+}
+
+void CTrainNodeMsRF::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+{
+	const word	 nFeatures	= getNumFeatures();
+	const Node	*pNodes		= reinterpret_cast<const Node *>(m_nodes.data);
+	potentials = Mat::zeros(featureMatrix.rows, m_nStates, CV_32FC1);
+
+	// Tree by tree: the nodes of one tree stay in cache for the whole batch
+	for (int root : m_vRoots)
+		for (int i = 0; i < featureMatrix.rows; i++) {
+			const byte *pFv	= featureMatrix.ptr<byte>(i);
+			int			n	= root;
+			while (pNodes[n].child) {
+				const float *pDx = m_directions.ptr<float>(pNodes[n].index);
+				float response = 0.0f;
+				for (word f = 0; f < nFeatures; f++) response += pDx[f] * pFv[f];
+				n = pNodes[n].child + (response < pNodes[n].threshold ? 0 : 1);
+			}
+			simd::axpy(1.0f, m_leafBins.ptr<float>(pNodes[n].index), potentials.ptr<float>(i), m_nStates);
+		} // i
+
+	// The aggregated histograms are scaled with their entropy
+	for (int i = 0; i < featureMatrix.rows; i++) {
+		float *pPot = potentials.ptr<float>(i);
+		float  sum	= 0;
+		for (byte s = 0; s < m_nStates; s++) sum += pPot[s];
+		if (sum == 0) continue;
+
+		double entropy = 0;
+		for (byte s = 0; s < m_nStates; s++) {
+			pPot[s] /= sum;
+			if (pPot[s] > 0) entropy -= pPot[s] * log(static_cast<double>(pPot[s])) / log(2.0);
+		}
+		const float mudiness = static_cast<float>(0.5 * entropy);
+		for (byte s = 0; s < m_nStates; s++) pPot[s] *= 1.0f - mudiness;
+	} // i
+}
 
-	std::vector<std::vector<int>> leafNodeIndices;
-	m_pRF->Apply(*testData, leafNodeIndices);
-	
-	sw::HistogramAggregator h(m_nStates);
-	int index = 0;
+// ------------------------------ PRIVATE ------------------------------
+void CTrainNodeMsRF::compile(void)
+{
+	static_assert(sizeof(Node) == 3 * sizeof(int), "The node must be stored as 3 integers");
+	const word nFeatures = getNumFeatures();
+
+	m_nodes.release();
+	m_directions.release();
+	m_leafBins.release();
+	m_vRoots.clear();
+	if (!m_pRF) return;
+
+	std::vector<Node>	vNodes;
+	vec_float_t			vDirections;
+	vec_float_t			vLeafBins;
+
+	// Adds a new node to the flat array
+	auto addNode = [&]() {
+		vNodes.push_back({ 0.0f, 0, 0 });
+		return static_cast<int>(vNodes.size()) - 1;
+	};
+
+	std::vector<std::pair<int, int>> vQueue;							// (node in the Sherwood tree, node in the flat array)
 	for (size_t t = 0; t < m_pRF->TreeCount(); t++) {
-		int leafIndex = leafNodeIndices[t][index];
-		h.Aggregate(m_pRF->GetTree((t)).GetNode(leafIndex).TrainingDataStatistics);
+		const auto &tree = m_pRF->GetTree(static_cast<int>(t));
+		m_vRoots.push_back(addNode());
+		vQueue.assign(1, std::make_pair(0, m_vRoots.back()));
+		for (size_t q = 0; q < vQueue.size(); q++) {					// breadth-first traversal
+			const int	 idx	= vQueue[q].first;
+			const int	 flat	= vQueue[q].second;
+			const auto	&node	= tree.GetNode(idx);
+			DGM_ASSERT_MSG(!node.IsNull(), "The tree %zu has a null node %d", t, idx);
+			if (node.IsSplit()) {
+				const int	 child	= addNode();
+				addNode();
+				const float *pDx	= node.Feature.GetDirection();
+				vNodes[flat].threshold	= node.Threshold;
+				vNodes[flat].child		= child;
+				vNodes[flat].index		= static_cast<int>(vDirections.size() / nFeatures);
+				vDirections.insert(vDirections.end(), pDx, pDx + nFeatures);
+				vQueue.push_back(std::make_pair(2 * idx + 1, child));		// the Sherwood trees are complete binary trees
+				vQueue.push_back(std::make_pair(2 * idx + 2, child + 1));
+			}
+			else {
+				vNodes[flat].index = static_cast<int>(vLeafBins.size() / m_nStates);
+				for (byte s = 0; s < m_nStates; s++)
+					vLeafBins.push_back(static_cast<float>(node.TrainingDataStatistics.GetBinCount(s)));
+			}
+		} // q
 	} // t
 
-	float mudiness = static_cast<float> (0.5 * h.Entropy());
-
-	for (byte s = 0; s < m_nStates; s++) 
-		potential.at<float>(s, 0) = (1.0f - mudiness) * h.GetProbability(s);
+	Mat(static_cast<int>(vNodes.size()), 1, CV_32SC3, vNodes.data()).copyTo(m_nodes);
+	Mat(static_cast<int>(vDirections.size() / nFeatures), nFeatures, CV_32FC1, vDirections.data()).copyTo(m_directions);
+	Mat(static_cast<int>(vLeafBins.size() / m_nStates), m_nStates, CV_32FC1, vLeafBins.data()).copyTo(m_leafBins);
 }
 }
 #endif
@@ -47,6 +47,13 @@ namespace DirectGraphicalModels
 	* @brief Microsoft Sherwood Random Forest training class
 	* @details This class is based on the <a href="http://research.microsoft.com/en-us/downloads/52d5b9c3-a638-42a1-94a5-d549e2251728/">Sherwood C++ code library for decision forests</a> v.1.0.0
 	* > In order to use the Sherwood library, DGM must be built with the \b USE_SHERWOOD flag
+	* 
+	* The trees are trained in parallel, each with its own stream of random numbers (ref. random::getStream()), and the candidate splits of the nodes with many samples
+	* are evaluated in parallel over the blocks of the samples. The samples are read in place from the containers of the accumulator. The trained forest depends only 
+	* on the seed of the random numbers (ref. random::seed()) and not on the number of threads.
+	*
+	* After training (or loading) the forest is compiled into a flat array of nodes, which is used for the evaluation of the node potentials.
+	* The compiled forest may be stored with saveModel() in the compact form and used in place after loadModel(), without the Sherwood forest.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CTrainNodeMsRF : public CTrainNode
@@ -88,17 +95,55 @@ namespace DirectGraphicalModels
 	protected:
 		DllExport void saveFile(FILE *pFile) const { }
 		DllExport void loadFile(FILE *pFile) { }
+		/**
+		* @brief Adds the compiled forest to the model container
+		* @details The nodes, the direction vectors of the split nodes and the leaf histograms are stored as contiguous arrays. The leaf histograms are stored
+		* with 16 bits per bin; if the counts of the training samples do not fit, all the histograms are scaled with one common factor, which does not change the 
+		* normalized node potentials up to the rounding errors
+		* @param writer The writer of the model container
+		*/
+		DllExport void saveSections(CModelFileWriter &writer) const;
+		/**
+		* @brief Loads the compiled forest from the model container
+		* @details The nodes and the direction vectors refer to the sections of the container, only the leaf histograms are expanded. 
+		* The Sherwood forest is not restored, thus the forest may not be saved with save() afterwards
+		* @param file The model container
+		*/
+		DllExport void loadSections(const CModelFile &file);
 		DllExport void calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport void addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void merge(CTrainNode &worker);
+
+
+	private:
+		/// Node of the flattened forest
+		struct Node {
+			float	threshold;				///< The split threshold: the samples with the response below it go to the left child
+			int		child;					///< Index of the left child; the right child follows it. 0 for the leaves
+			int		index;					///< Index of the direction vector for the split nodes, or of the leaf class distribution for the leaves
+		};
 
 
 	private:
 		void		  init(TrainNodeMsRFParams params);													// This function is called by both constructors
+		/**
+		* @brief Compiles the trained forest into the flat arrays
+		* @details Fills the \a m_nodes, \a m_directions, \a m_leafBins and \a m_vRoots containers. The nodes of every tree are stored in the 
+		* breadth-first order with the children of a split node next to each other. Must be called every time the forest is changed.
+		*/
+		void		  compile(void);
 
 
 	private:
         std::unique_ptr<sw::Forest<sw::LinearFeatureResponse, sw::HistogramAggregator>>     m_pRF;            ///< Random Forest classifier
         std::unique_ptr<CSamplesAccumulator>                                                m_pSamplesAcc;    ///< Samples Accumulator
         std::unique_ptr<sw::TrainingParameters>											    m_pParams;
+		Mat					m_nodes;						///< The nodes of all the trees: Mat(size: nNodes x 1; type: CV_32SC3), one Node per element
+		Mat					m_directions;					///< The direction vectors of the linear feature responses: Mat(size: nSplitNodes x nFeatures; type: CV_32FC1)
+		Mat					m_leafBins;						///< The class histograms of the training samples: Mat(size: nLeaves x nStates; type: CV_32FC1)
+		vec_int_t			m_vRoots;						///< Indexes of the root nodes of all the trees
 	};
 }
 //#endif
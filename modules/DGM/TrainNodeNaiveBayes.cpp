@@ -2,6 +2,10 @@
 #include "PDFHistogram.h"
 #include "PDFHistogram2D.h"
 #include "PDFGaussian.h"
+#include "simd.h"
+#include "DenseOCL.h"
+#include "ModelFile.h"
+#include "footprint.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels
@@ -26,6 +30,11 @@ namespace DirectGraphicalModels
 	{
 		CPriorNode::reset();							// resetting the prior histogram vector
 		if (!m_prior.empty()) m_prior.release();		// resetting the prior
+		m_logPrior.release();							// resetting the lookup tables
+		m_logLUT.release();
+#ifdef ENABLE_OCL
+		m_uLogLUT.release();
+#endif
 
 		for (auto& pdf : m_vPDF)
 			pdf->reset();
@@ -53,9 +62,35 @@ namespace DirectGraphicalModels
 		}
 	}
 
+	std::shared_ptr<CTrainNode> CTrainNodeBayes::createWorker(void) const
+	{
+		return std::make_shared<CTrainNodeBayes>(m_nStates, getNumFeatures());
+	}
+
+	void CTrainNodeBayes::merge(CTrainNode &worker)
+	{
+		const CTrainNodeBayes &bayes = dynamic_cast<const CTrainNodeBayes &>(worker);
+		m_histogramPrior += bayes.m_histogramPrior;
+		for (size_t i = 0; i < m_vPDF.size(); i++)
+			m_vPDF[i]->merge(*bayes.m_vPDF[i]);
+		for (size_t s = 0; s < MIN(m_vPDF2D.size(), bayes.m_vPDF2D.size()); s++)		// the 2D PDFs are removed in reset()
+			m_vPDF2D[s]->merge(*bayes.m_vPDF2D[s]);
+	}
+
+	size_t CTrainNodeBayes::getMemoryUsage(void) const
+	{
+		size_t res = sizeof(*this) + footprint::getBytes(m_vPDF) + footprint::getBytes(m_vPDF2D) + footprint::getBytes(m_histogramPrior);
+		for (const std::vector<ptr_pdf_t> *pvPDF : { &m_vPDF, &m_vPDF2D })
+			for (const ptr_pdf_t &pPDF : *pvPDF)
+				if (pPDF) res += pPDF->getMemoryUsage();
+		res += footprint::getBytes(m_prior) + footprint::getBytes(m_logPrior) + footprint::getBytes(m_logLUT) + footprint::getBytes(m_vEstimated);
+		return res;
+	}
+
 	void CTrainNodeBayes::train(bool)
 	{
 		m_prior = getPrior(FLT_MAX);
+		compile();
 	}
 
 	void CTrainNodeBayes::smooth(int nIt)
@@ -64,6 +99,7 @@ namespace DirectGraphicalModels
 			pdf->smooth(nIt);
 		for(auto &pdf: m_vPDF2D)
 			pdf->smooth(nIt);
+		if (!m_prior.empty()) compile();
 	}
 
 	void CTrainNodeBayes::saveFile(FILE *pFile) const
@@ -85,23 +121,165 @@ namespace DirectGraphicalModels
 			pdf->loadFile(pFile);
 		for (auto &pdf: m_vPDF2D)
 			pdf->loadFile(pFile);
+		compile();
 	} 
 
+	// The histograms are stored row-wise: the number of points followed by the bins
+	void CTrainNodeBayes::saveSections(CModelFileWriter &writer) const
+	{
+		DGM_ASSERT_MSG(!m_logLUT.empty(), "The node trainer is not trained");
+
+		Mat histograms(static_cast<int>(m_vPDF.size()), 257, CV_64FC1);
+		for (size_t i = 0; i < m_vPDF.size(); i++) {
+			const CPDFHistogram &pdf = dynamic_cast<const CPDFHistogram &>(*m_vPDF[i]);
+			double *pHistogram = histograms.ptr<double>(static_cast<int>(i));
+			pHistogram[0] = static_cast<double>(pdf.m_nPoints);
+			for (int v = 0; v < 256; v++) pHistogram[v + 1] = static_cast<double>(pdf.m_data[v]);
+		}
+		Mat histograms2D(static_cast<int>(m_vPDF2D.size()) * 256, 256, CV_64FC1);
+		Mat points2D(1, static_cast<int>(m_vPDF2D.size()), CV_64FC1);
+		for (size_t i = 0; i < m_vPDF2D.size(); i++) {
+			const CPDFHistogram2D &pdf = dynamic_cast<const CPDFHistogram2D &>(*m_vPDF2D[i]);
+			points2D.at<double>(0, static_cast<int>(i)) = static_cast<double>(pdf.m_nPoints);
+			for (int y = 0; y < 256; y++) {
+				double *pHistogram = histograms2D.ptr<double>(static_cast<int>(i) * 256 + y);
+				for (int x = 0; x < 256; x++) pHistogram[x] = static_cast<double>(pdf.m_data[y][x]);
+			}
+		}
+		Mat estimated(1, m_nStates, CV_8UC1);
+		for (byte s = 0; s < m_nStates; s++) estimated.at<byte>(0, s) = m_vEstimated[s] ? 1 : 0;
+
+		writer.addSection("Bayes.histogramPrior", m_histogramPrior);
+		writer.addSection("Bayes.histograms", histograms);
+		writer.addSection("Bayes.histograms2D", histograms2D);
+		writer.addSection("Bayes.points2D", points2D);
+		writer.addSection("Bayes.estimated", estimated);
+		writer.addSection("Bayes.logPrior", m_logPrior);
+		writer.addSection("Bayes.logLUT", m_logLUT);
+	}
+
+	void CTrainNodeBayes::loadSections(const CModelFile &file)
+	{
+		const Mat histogramPrior = file.getSection("Bayes.histogramPrior");
+		DGM_ASSERT_MSG(histogramPrior.size() == m_histogramPrior.size(), "The file has been saved for another number of states");
+		histogramPrior.copyTo(m_histogramPrior);
+		m_prior = getPrior(FLT_MAX);
+
+		const Mat histograms = file.getSection("Bayes.histograms");
+		DGM_ASSERT_MSG(histograms.rows == static_cast<int>(m_vPDF.size()), "The file has been saved for another number of features");
+		for (size_t i = 0; i < m_vPDF.size(); i++) {
+			CPDFHistogram &pdf = dynamic_cast<CPDFHistogram &>(*m_vPDF[i]);
+			const double *pHistogram = histograms.ptr<double>(static_cast<int>(i));
+			pdf.m_nPoints = static_cast<long>(pHistogram[0]);
+			for (int v = 0; v < 256; v++) pdf.m_data[v] = static_cast<long>(pHistogram[v + 1]);
+			pdf.m_isTableValid = false;
+		}
+		const Mat histograms2D	= file.getSection("Bayes.histograms2D");
+		const Mat points2D		= file.getSection("Bayes.points2D");
+		m_vPDF2D.clear();
+		for (int i = 0; i < points2D.cols; i++) {
+			auto pPdf = std::make_shared<CPDFHistogram2D>();
+			pPdf->m_nPoints = static_cast<long>(points2D.at<double>(0, i));
+			for (int y = 0; y < 256; y++) {
+				const double *pHistogram = histograms2D.ptr<double>(i * 256 + y);
+				for (int x = 0; x < 256; x++) pPdf->m_data[y][x] = static_cast<long>(pHistogram[x]);
+			}
+			m_vPDF2D.push_back(pPdf);
+		}
+
+		// The lookup tables are used in place
+		const Mat estimated = file.getSection("Bayes.estimated");
+		m_vEstimated.resize(m_nStates);
+		for (byte s = 0; s < m_nStates; s++) m_vEstimated[s] = estimated.at<byte>(0, s) != 0;
+		m_logPrior	= file.getSection("Bayes.logPrior");
+		m_logLUT	= file.getSection("Bayes.logLUT");
+		upload();
+	}
+
 	void CTrainNodeBayes::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
 	{
-		m_prior.copyTo(potential);
-		for (byte s = 0; s < m_nStates; s++) {				// state
-			float	* pPot	= potential.ptr<float>(s);
-			byte	* pMask	= mask.ptr<byte>(s);
-			for (word f = 0; f < getNumFeatures(); f++) {		// feature
-				byte feature = featureVector.ptr<byte>(f)[0];
-				if (m_vPDF[f * m_nStates + s]->isEstimated()) 
-					pPot[0] *= static_cast<float>(m_vPDF[f * m_nStates + s]->getDensity(feature));
-				else  {
-					pPot[0] = 0; 
-					pMask[0] = 0;
-				}
+		DGM_ASSERT_MSG(!m_logLUT.empty(), "The node trainer is not trained");
+		float *pPot = potential.ptr<float>(0);									// continuous nStates x 1 matrix
+		accumulate(featureVector.ptr<byte>(0), featureVector.step[0], pPot);
+		for (byte s = 0; s < m_nStates; s++)
+			if (!m_vEstimated[s]) {
+				pPot[s] = 0;
+				mask.at<byte>(s, 0) = 0;
+			}
+	}
+
+	void CTrainNodeBayes::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		DGM_ASSERT_MSG(!m_logLUT.empty(), "The node trainer is not trained");
+		potentials.create(featureMatrix.rows, m_nStates, CV_32FC1);
+#ifdef ENABLE_OCL
+		if (!m_uLogLUT.empty() && featureMatrix.rows >= 1024 && featureMatrix.isContinuous()) {	// the tables stay on the device, only the samples are copied
+			UMat uFeatures, uPotentials(potentials.size(), CV_32FC1);
+			featureMatrix.copyTo(uFeatures);
+			ocl::Kernel kernel = gpu::getKernel("lut_potentials");
+			kernel.args(ocl::KernelArg::PtrReadOnly(uFeatures), ocl::KernelArg::PtrReadOnly(m_uLogLUT), ocl::KernelArg::PtrReadOnly(m_uLogPrior), 
+				ocl::KernelArg::PtrReadOnly(m_uEstimated), ocl::KernelArg::PtrWriteOnly(uPotentials), static_cast<int>(getNumFeatures()), static_cast<int>(m_nStates), featureMatrix.rows);
+			if (gpu::run(kernel, featureMatrix.rows, m_nStates)) {
+				uPotentials.copyTo(potentials);
+				return;
+			}
+		}
+#endif
+		for (int i = 0; i < featureMatrix.rows; i++) {
+			float *pPot = potentials.ptr<float>(i);
+			accumulate(featureMatrix.ptr<byte>(i), 1, pPot);
+			for (byte s = 0; s < m_nStates; s++)
+				if (!m_vEstimated[s]) pPot[s] = -1.0f;
+		} // i
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CTrainNodeBayes::compile(void)
+	{
+		const word	nFeatures	= getNumFeatures();
+		const float	logZero		= -1e30f;											// stands for ln(0): the sum of up to 2^16 such values does not overflow
+
+		m_vEstimated.assign(m_nStates, true);
+		m_logPrior.create(1, m_nStates, CV_32FC1);
+		m_logLUT.create(nFeatures * 256, m_nStates, CV_32FC1);
+		Mat values(256, 1, CV_8UC1);												// all the values of a feature
+		for (int v = 0; v < 256; v++) values.at<byte>(v, 0) = static_cast<byte>(v);
+		Mat densities;
+		for (byte s = 0; s < m_nStates; s++) {
+			float prior = m_prior.at<float>(s, 0);
+			m_logPrior.at<float>(0, s) = prior > 0 ? logf(prior) : logZero;
+			for (word f = 0; f < nFeatures; f++) {
+				ptr_pdf_t pdf = m_vPDF[f * m_nStates + s];
+				if (!pdf->isEstimated()) m_vEstimated[s] = false;
+				pdf->getDensities(values, densities);
+				for (int v = 0; v < 256; v++) {
+					float density = densities.at<float>(v, 0);
+					m_logLUT.at<float>(f * 256 + v, s) = density > 0 ? logf(density) : logZero;
+				} // v
 			} // f
 		} // s
+
+		upload();
+	}
+
+	void CTrainNodeBayes::upload(void)
+	{
+#ifdef ENABLE_OCL
+		if (gpu::isAvailable()) {
+			Mat estimated(1, m_nStates, CV_8UC1);
+			for (byte s = 0; s < m_nStates; s++) estimated.at<byte>(0, s) = m_vEstimated[s] ? 1 : 0;
+			m_logLUT.copyTo(m_uLogLUT);
+			m_logPrior.copyTo(m_uLogPrior);
+			estimated.copyTo(m_uEstimated);
+		}
+#endif
+	}
+
+	void CTrainNodeBayes::accumulate(const byte *pFv, size_t step, float *pPot) const
+	{
+		memcpy(pPot, m_logPrior.ptr<float>(0), m_nStates * sizeof(float));
+		for (word f = 0; f < getNumFeatures(); f++)
+			simd::axpy(1.0f, m_logLUT.ptr<float>(f * 256 + pFv[f * step]), pPot, m_nStates);
+		simd::expVec(pPot, pPot, m_nStates);
 	}
 }
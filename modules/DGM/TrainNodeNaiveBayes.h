@@ -31,6 +31,7 @@ namespace DirectGraphicalModels
 
 		DllExport virtual void	addFeatureVec(const Mat &featureVector, byte gt);	
 		DllExport virtual void	train(bool doClean = false);
+		DllExport virtual size_t getMemoryUsage(void) const;
 
 		/**
 		* @brief Returns the normalized probability density function (PDF) for specific state (class) and feature 
@@ -55,6 +56,13 @@ namespace DirectGraphicalModels
 	protected:
 		DllExport virtual void	saveFile(FILE *pFile) const; 
 		DllExport virtual void	loadFile(FILE *pFile); 
+		DllExport virtual void	saveSections(CModelFileWriter &writer) const;
+		/**
+		* @brief Loads the random model from the model container
+		* @details The lookup tables refer to the sections of the container, thus they are not re-compiled
+		* @param file The model container
+		*/
+		DllExport virtual void	loadSections(const CModelFile &file);
 		/**
 		* @brief Calculates the node potential, based on the feature vector.
 		* @details This function calculates the potentials of the node, described with the sample \b featureVector (\f$ \textbf{f} \f$):
@@ -63,16 +71,49 @@ namespace DirectGraphicalModels
 		* \f$ s \in [0; nStates) \f$ and \f$ f \in [0; nFeatures) \f$.
 		* Here \f$ H.data[256] \f$ is a 1D histogram, \f$ H.n \f$ is the number of entries in histogram, \a i.e.  \f$ H.n = \sum^{255}_{i = 0} H.data[i] \f$.
 		* And \f$ \textbf{f}_f \in [0; 255], \forall f \in [0; nFeatures) \f$, \a i.e. has (type: CV_8UC1).
+		* The product is evaluated in the log-domain with the lookup tables, compiled in train(). If the library is built with the \b ENABLE_OCL option and 
+		* the OpenCL device is available (ref. gpu::isAvailable()), the large batches of samples are evaluated on the device, where the lookup tables are kept.
 		* @param[in]	featureVector Multi-dimensinal point \f$\textbf{f}\f$: Mat(size: nFeatures x 1; type: CV_{XX}C1)
 		* @param[in,out]	potential %Node potentials: Mat(size: nStates x 1; type: CV_32FC1). This parameter should be preinitialized and set to value 0.
 		* @param[in,out]	mask Relevant %Node potentials: Mat(size: nStates x 1; type: CV_8UC1). This parameter should be preinitialized and set to value 1 (all potentials are relevant).
 		*/
 		DllExport void calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void merge(CTrainNode &worker);
+
+
+	private:
+		/**
+		* @brief Compiles the trained model into the lookup tables
+		* @details Fills the \a m_logPrior and \a m_logLUT containers. Must be called every time the prior or the PDFs are changed.
+		*/
+		void compile(void);
+		/**
+		* @brief Copies the lookup tables to the OpenCL device, if it is available
+		*/
+		void upload(void);
+		/**
+		* @brief Evaluates the node potentials with the lookup tables
+		* @details This function calculates \f$ nodePot_s = \exp(\ln prior_s + \sum_f \ln H_{s,f}(\textbf{f}_f)) \f$ with SIMD additions of the table rows.
+		* @param pFv Pointer to the first feature
+		* @param step The distance between two consecutive features in bytes
+		* @param pPot Pointer to the \a nStates resulting potentials
+		*/
+		void accumulate(const byte *pFv, size_t step, float *pPot) const;
 
 
 	private:
 		std::vector<ptr_pdf_t>	m_vPDF;			///< The 1D PDF for node potentials	 [state][feature]
 		std::vector<ptr_pdf_t>	m_vPDF2D;		///< The 2D data histogram for node potentials and 2 features[state]
 		Mat						m_prior;		///< The class prior probability vector
+		Mat						m_logPrior;		///< The logarithm of the class prior: Mat(size: 1 x nStates; type: CV_32FC1)
+		Mat						m_logLUT;		///< The logarithms of the densities: Mat(size: nFeatures * 256 x nStates; type: CV_32FC1), row f * 256 + v holds the values for the feature f, equal to v
+		vec_bool_t				m_vEstimated;	///< Flags indicating whether the PDFs of all the features are estimated for a state
+#ifdef ENABLE_OCL
+		UMat					m_uLogLUT;		///< The copy of \a m_logLUT on the OpenCL device (empty if the device is not available)
+		UMat					m_uLogPrior;	///< The copy of \a m_logPrior on the OpenCL device
+		UMat					m_uEstimated;	///< The flags \a m_vEstimated on the OpenCL device: Mat(size: 1 x nStates; type: CV_8UC1)
+#endif
 	};
 }
@@ -4,6 +4,7 @@
 
 #include "ITrain.h"
 #include "PriorTriplet.h"
+#include "footprint.h"
 #include "macroses.h"		// For DGM_WARNING
 
 namespace DirectGraphicalModels
@@ -11,6 +12,8 @@ namespace DirectGraphicalModels
 	// ============================= Triplet Train Class =============================
 	/**
 	@brief  Base abstract class for triplet potential training
+	@details At the moment the triplet potentials are data-independent: they are given by the class co-occurance histogram of the triplets (Ref. @ref CPriorTriplet).
+	Thus, getTripletPotentials() returns the same table for all the triplets, which may be shared between them with CGraph3::setTriplets().
 	@author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	class CTrainTriplet : public ITrain, private CPriorTriplet
@@ -21,9 +24,27 @@ namespace DirectGraphicalModels
 
 		DllExport void	reset(void) {CPriorTriplet::reset(); }
 
+		/**
+		@brief Adds a triplet of feature vectors
+		@param featureVector1 Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1), corresponding to the first node of the triplet
+		@param gt1 The ground-truth state (class) of the first node of the triplet
+		@param featureVector2 Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1), corresponding to the second node of the triplet
+		@param gt2 The ground-truth state (class) of the second node of the triplet
+		@param featureVector3 Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1), corresponding to the third node of the triplet
+		@param gt3 The ground-truth state (class) of the third node of the triplet
+		*/
+		DllExport void	addFeatureVecs(const Mat &featureVector1, byte gt1, const Mat &featureVector2, byte gt2, const Mat &featureVector3, byte gt3) { addTripletGroundTruth(gt1, gt2, gt3); }
 
 		DllExport void	train(bool doClean = false) {}
+		DllExport size_t getMemoryUsage(void) const { return sizeof(*this) + footprint::getBytes(m_histogramPrior); }
 
+		/**
+		@brief Returns the triplet potential
+		@param featureVector1 Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1), corresponding to the first node of the triplet
+		@param featureVector2 Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1), corresponding to the second node of the triplet
+		@param featureVector3 Multi-dimensinal point: Mat(size: nFeatures x 1; type: CV_8UC1), corresponding to the third node of the triplet
+		@return The triplet potential table: Mat(dims: 3; size: nStates x nStates x nStates; type: CV_32FC1)
+		*/
 		DllExport Mat	getTripletPotentials(const Mat &featureVector1, const Mat &featureVector2, const Mat &featureVector3) const;
 
 
@@ -40,7 +61,5 @@ namespace DirectGraphicalModels
 		*/			
 		DllExport void	loadFile(FILE *pFile) 
 		{ DGM_WARNING("Load function is not implemented yet!"); } 
-		
-		DllExport void	calculateTripletPotentials(const Mat &featureVector1, const Mat &featureVector2, const Mat &featureVector3) const;
 	};
 }
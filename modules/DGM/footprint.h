@@ -0,0 +1,60 @@
+// Memory footprint helpers
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Footprint Namespace ==============================
+	/**
+	* @brief Memory footprint helpers
+	* @details These functions return the sizes of the heap buffers of the containers, which are used by the getMemoryUsage() functions of
+	* the graphs, inferers and trainers. The bookkeeping overhead of the heap allocator is not included
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	namespace footprint {
+		/**
+		* @brief Returns the size of the data of the matrix
+		* @param m The matrix
+		* @return The size of the data in bytes, including the data of the parent matrix, if \b m is a submatrix
+		*/
+		inline size_t getBytes(const Mat &m) { return m.empty() ? 0 : static_cast<size_t>(m.dataend - m.datastart); }
+		/**
+		* @brief Returns the size of the data of the matrices
+		* @param vMats The array of matrices
+		* @return The size of the array and the data of all the matrices in bytes
+		*/
+		inline size_t getBytes(const vec_mat_t &vMats)
+		{
+			size_t res = vMats.capacity() * sizeof(Mat);
+			for (const Mat &m : vMats) res += getBytes(m);
+			return res;
+		}
+		/**
+		* @brief Returns the size of the buffer of the vector
+		* @param v The vector
+		* @return The size of the allocated buffer in bytes
+		*/
+		template<typename T>
+		inline size_t getBytes(const std::vector<T> &v) { return v.capacity() * sizeof(T); }
+		/**
+		* @brief Returns the size of the buffer of the bit vector
+		* @param v The vector
+		* @return The size of the allocated buffer in bytes
+		*/
+		inline size_t getBytes(const std::vector<bool> &v) { return (v.capacity() + 7) / 8; }
+		/**
+		* @brief Returns the size of the buffers of the nested vectors
+		* @param vv The vector of vectors
+		* @return The size of the outer buffer and of all the inner buffers in bytes
+		*/
+		template<typename T>
+		inline size_t getBytes(const std::vector<std::vector<T>> &vv)
+		{
+			size_t res = vv.capacity() * sizeof(std::vector<T>);
+			for (const std::vector<T> &v : vv) res += getBytes(v);
+			return res;
+		}
+	}
+}
@@ -0,0 +1,168 @@
+// Message passing kernels, specialized for the compile-time number of states
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "simd.h"
+#include <type_traits>
+
+namespace DirectGraphicalModels { namespace kernels {
+	/**
+	* @brief Calls the functor with the compile-time number of states
+	* @details The functor is called with \b std::integral_constant<int, N>, where \b N is the number of states, if it is 2, 4, 6, 8 or 16, and zero otherwise.
+	* The kernels of this namespace, instantiated with a non-zero \b N, have constant trip counts, so that the compiler unrolls them and keeps the vectors
+	* in registers; with \b N = 0 they fall back to the run-time number of states. This function is intended to be called once per inference, \a e.g.:
+	* @code
+	* kernels::dispatch(nStates, [&](auto N) { calculateMessages<decltype(N)::value>(nIt); });
+	* @endcode
+	* @param nStates The run-time number of states
+	* @param f The generic functor
+	* @return The value, returned by the functor
+	*/
+	template<typename F>
+	inline auto dispatch(byte nStates, F &&f)
+	{
+		switch (nStates) {
+			case 2:		return f(std::integral_constant<int, 2>());
+			case 4:		return f(std::integral_constant<int, 4>());
+			case 6:		return f(std::integral_constant<int, 6>());
+			case 8:		return f(std::integral_constant<int, 8>());
+			case 16:	return f(std::integral_constant<int, 16>());
+			default:	return f(std::integral_constant<int, 0>());
+		}
+	}
+
+	/**
+	* @brief Returns the number of states
+	* @param n The run-time number of states
+	* @return \b N if it is non-zero, \b n otherwise
+	*/
+	template<int N>
+	constexpr int count(byte n) { return N ? N : n; }
+
+	/**
+	* @brief Element-wise multiplication: \f$\vec{dst} = \vec{dst}\circ\vec{src}\f$
+	* @param[in,out] dst Vector of length \b n
+	* @param[in] src Vector of length \b n
+	* @param[in] n The run-time number of states
+	*/
+	template<int N>
+	inline void mul(float *dst, const float *src, byte n)
+	{
+		const int nStates = count<N>(n);
+		for (int s = 0; s < nStates; s++) dst[s] *= src[s];
+	}
+
+	/**
+	* @brief Returns the maximal element
+	* @param src Vector of length \b n
+	* @param n The run-time number of states
+	* @return The maximal element of vector \b src
+	*/
+	template<int N>
+	inline float max(const float *src, byte n)
+	{
+		const int nStates = count<N>(n);
+		float res = src[0];
+		for (int s = 1; s < nStates; s++) res = src[s] > res ? src[s] : res;
+		return res;
+	}
+
+	/**
+	* @brief Returns the index of the first maximal element
+	* @param src Vector of length \b n
+	* @param n The run-time number of states
+	* @return The same index as simd::argMax()
+	*/
+	template<int N>
+	inline byte argMax(const float *src, byte n)
+	{
+		if constexpr (N == 0) return simd::argMax(src, n);
+		else {
+			int res = 0;
+			for (int s = 1; s < N; s++) if (src[s] > src[res]) res = s;
+			return static_cast<byte>(res);
+		}
+	}
+
+	/**
+	* @brief Returns the index of the first minimal element
+	* @param src Vector of length \b n
+	* @param n The run-time number of states
+	* @return The same index as \a std::min_element() does
+	*/
+	template<int N>
+	inline byte argMin(const float *src, byte n)
+	{
+		const int nStates = count<N>(n);
+		int res = 0;
+		for (int s = 1; s < nStates; s++) if (src[s] < src[res]) res = s;
+		return static_cast<byte>(res);
+	}
+
+	/**
+	* @brief Normalizes the vector to the maximal element of one
+	* @param[in,out] dst Vector of length \b n with the non-zero maximal element
+	* @param[in] n The run-time number of states
+	*/
+	template<int N>
+	inline void normalizeMax(float *dst, byte n)
+	{
+		const int	nStates = count<N>(n);
+		const float m		= max<N>(dst, n);
+		for (int s = 0; s < nStates; s++) dst[s] /= m;
+	}
+
+	/**
+	* @brief Transposed matrix - vector multiplication
+	* @details This function calculates the same product as simd::matTVecMul(), to which it falls back for \b N = 0
+	* @param[in] M Row-major square matrix of size \b n x \b n
+	* @param[in] v Vector of length \b n
+	* @param[out] dst Resulting vector of length \b n
+	* @param[in] n The run-time number of states
+	* @param[in] maxSum Flag indicating weather the \a max-sum multiplication should be performed
+	* @return The sum of all elemts in vector \b dst
+	*/
+	template<int N>
+	inline float matTVecMul(const float *M, const float *v, float *dst, byte n, bool maxSum)
+	{
+		if constexpr (N == 0) return simd::matTVecMul(M, v, dst, n, maxSum);
+		else {
+			float acc[N] = {};
+			for (int y = 0; y < N; y++) {												// row-wise traversal keeps the memory access sequential
+				const float *pM = M + y * N;
+				const float	 vy = v[y];
+				if (maxSum) for (int x = 0; x < N; x++) { const float prod = vy * pM[x]; acc[x] = prod > acc[x] ? prod : acc[x]; }
+				else		for (int x = 0; x < N; x++) acc[x] += vy * pM[x];
+			} // y
+
+			float res = 0;
+			for (int x = 0; x < N; x++) {
+				dst[x] = acc[x];
+				res += acc[x];
+			}
+			return res;
+		}
+	}
+
+	/**
+	* @brief Matrix - vector max-product: \f$dst_y = \max_x M_{y,x}\cdot v_x\f$
+	* @param[in] M Row-major square matrix of size \b n x \b n
+	* @param[in] v Vector of length \b n
+	* @param[out] dst Resulting vector of length \b n
+	* @param[in] n The run-time number of states
+	*/
+	template<int N>
+	inline void matVecMax(const float *M, const float *v, float *dst, byte n)
+	{
+		const int nStates = count<N>(n);
+		for (int y = 0; y < nStates; y++) {
+			const float *pM  = M + y * nStates;
+			float		 res = v[0] * pM[0];
+			for (int x = 1; x < nStates; x++) {
+				const float val = v[x] * pM[x];
+				res = val > res ? val : res;
+			}
+			dst[y] = res;
+		}
+	}
+} }
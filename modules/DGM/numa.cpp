@@ -0,0 +1,240 @@
+#include "numa.h"
+#include "ThreadPool.h"
+#include "macroses.h"
+#include <fstream>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace DirectGraphicalModels { namespace numa {
+	namespace {
+		const int		MPOL_DEFAULT_	= 0;					// the memory policies of <numaif.h>, which is not a part of the C library
+		const int		MPOL_PREFERRED_	= 1;
+		const int		MPOL_MF_MOVE_	= 1 << 1;
+		const size_t	CHUNK_PAGES		= 64;					// the number of pages, initialized by one task of firstTouch()
+		const size_t	BATCH_PAGES		= 4096;					// the number of pages per system call
+		const size_t	MAX_NODES		= 1024;					// the size of the node masks of the memory policies
+
+		std::atomic<bool> g_enabled(true);
+
+		// Parses the Linux list format, e.g. "0-3,8-11"
+		vec_int_t parseList(const std::string &str)
+		{
+			vec_int_t res;
+			size_t pos = 0;
+			while (pos < str.size()) {
+				size_t end = str.find(',', pos);
+				if (end == std::string::npos) end = str.size();
+				const std::string item = str.substr(pos, end - pos);
+				const size_t dash = item.find('-');
+				if (!item.empty() && isdigit(item[0])) {
+					const int first = atoi(item.c_str());
+					const int last	= dash == std::string::npos ? first : atoi(item.c_str() + dash + 1);
+					for (int i = first; i <= last; i++) res.push_back(i);
+				}
+				pos = end + 1;
+			}
+			return res;
+		}
+
+		std::string readLine(const std::string &fileName)
+		{
+			std::ifstream file(fileName);
+			std::string res;
+			std::getline(file, res);
+			return res;
+		}
+
+		/// NUMA topology
+		struct Topology {
+			std::vector<vec_int_t>	vNodeCpus;			///< The CPUs of every NUMA node
+			vec_size_t				vCpuNode;			///< The NUMA node of every CPU
+
+			Topology(void)
+			{
+#ifdef __linux__
+				const vec_int_t vNodes = parseList(readLine("/sys/devices/system/node/online"));
+				for (int node : vNodes) {
+					if (node != static_cast<int>(vNodeCpus.size())) break;						// the sparse node indices are not supported
+					vNodeCpus.push_back(parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")));
+				}
+#endif
+				if (vNodeCpus.empty()) {
+					vNodeCpus.emplace_back();
+					for (int cpu = 0; cpu < static_cast<int>(MAX(1, std::thread::hardware_concurrency())); cpu++) vNodeCpus[0].push_back(cpu);
+				}
+				for (size_t node = 0; node < vNodeCpus.size(); node++)
+					for (int cpu : vNodeCpus[node]) {
+						if (vCpuNode.size() <= static_cast<size_t>(cpu)) vCpuNode.resize(cpu + 1, 0);
+						vCpuNode[cpu] = node;
+					}
+			}
+		};
+
+		const Topology & getTopology(void)
+		{
+			static const Topology topology;
+			return topology;
+		}
+
+		size_t getPageSize(void)
+		{
+#ifdef __linux__
+			static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			return pageSize;
+#else
+			return 4096;
+#endif
+		}
+
+		// Returns the NUMA node of the part of the buffer, containing the byte at the offset
+		size_t getPartNode(size_t offset, size_t size) { return offset >= size ? getNumNodes() - 1 : offset * getNumNodes() / size; }
+
+#ifdef __linux__
+		// Sets the preferred node of the memory policy of the calling thread; the policy of the thread, e.g. set by the application, is restored on destruction
+		class CPreferredNode {
+		public:
+			CPreferredNode(void) { m_saved = syscall(SYS_get_mempolicy, &m_mode, m_mask, MAX_NODES, NULL, 0) == 0; }
+			~CPreferredNode(void)
+			{
+				if (m_saved)	syscall(SYS_set_mempolicy, m_mode, m_mask, MAX_NODES);
+				else			syscall(SYS_set_mempolicy, MPOL_DEFAULT_, NULL, 0);
+			}
+
+			void set(size_t node)
+			{
+				unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+				mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+				syscall(SYS_set_mempolicy, MPOL_PREFERRED_, mask, MAX_NODES);
+			}
+
+		private:
+			int				m_mode = MPOL_DEFAULT_;
+			unsigned long	m_mask[MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+			bool			m_saved;
+		};
+
+		// Calls move_pages() for the pages of the buffer: moves them to the nodes, if pNodes is not NULL, and returns their nodes in vStatus
+		void movePages(const void *data, size_t size, const int *pNodes, vec_int_t &vStatus)
+		{
+			const size_t	 pageSize	= getPageSize();
+			const uintptr_t	 first		= reinterpret_cast<uintptr_t>(data) / pageSize * pageSize;
+			const size_t	 nPages		= (reinterpret_cast<uintptr_t>(data) + size - first + pageSize - 1) / pageSize;
+			std::vector<void *> vPages(MIN(nPages, BATCH_PAGES));
+			vStatus.assign(nPages, -1);
+			for (size_t p = 0; p < nPages; p += BATCH_PAGES) {
+				const size_t count = MIN(BATCH_PAGES, nPages - p);
+				for (size_t i = 0; i < count; i++) vPages[i] = reinterpret_cast<void *>(first + (p + i) * pageSize);
+				syscall(SYS_move_pages, 0, count, vPages.data(), pNodes ? pNodes + p : NULL, vStatus.data() + p, pNodes ? MPOL_MF_MOVE_ : 0);
+			}
+		}
+#endif
+	}
+
+	size_t getNumNodes(void)
+	{
+		return getTopology().vNodeCpus.size();
+	}
+
+	vec_int_t getNodeCpus(size_t node)
+	{
+		DGM_ASSERT_MSG(node < getNumNodes(), "The NUMA node %zu is out of range [0; %zu)", node, getNumNodes());
+		return getTopology().vNodeCpus[node];
+	}
+
+	size_t getCurrentNode(void)
+	{
+#ifdef __linux__
+		const int cpu = sched_getcpu();
+		const vec_size_t &vCpuNode = getTopology().vCpuNode;
+		if (cpu >= 0 && static_cast<size_t>(cpu) < vCpuNode.size()) return vCpuNode[cpu];
+#endif
+		return 0;
+	}
+
+	void setEnabled(bool enable)
+	{
+		g_enabled = enable;
+	}
+
+	bool isEnabled(void)
+	{
+		return g_enabled && getNumNodes() > 1;
+	}
+
+	// The chunk boundaries are page-aligned in the address space, thus no page is touched by two nodes
+	void firstTouch(void *data, size_t n, size_t elemSize, const std::function<void(size_t begin, size_t end)> &init)
+	{
+		if (n == 0) return;
+		const size_t chunkSize = CHUNK_PAGES * getPageSize();
+		if (!isEnabled() || n * elemSize <= chunkSize || chunkSize % elemSize) {
+			init(0, n);
+			return;
+		}
+
+		const size_t	size	= n * elemSize;
+		const size_t	head	= (chunkSize - reinterpret_cast<uintptr_t>(data) % chunkSize) % chunkSize;		// bytes before the first chunk boundary
+		const size_t	nChunks	= (size + chunkSize - 1 - MIN(head, size)) / chunkSize + (head ? 1 : 0);
+		auto getOffset = [&](size_t c) { return c == 0 ? 0 : MIN(size, head + (c - (head ? 1 : 0)) * chunkSize); };
+		parallel::parallelFor(Range(0, static_cast<int>(nChunks)), [&](const Range &range) {
+#ifdef __linux__
+			CPreferredNode preferredNode;
+#endif
+			for (int c = range.start; c < range.end; c++) {
+				const size_t begin	= getOffset(c);
+				const size_t end	= getOffset(c + 1);
+#ifdef __linux__
+				preferredNode.set(getPartNode(begin, size));
+#endif
+				init((begin + elemSize - 1) / elemSize, (end + elemSize - 1) / elemSize);
+			}
+		});
+	}
+
+	void distribute(const void *data, size_t size)
+	{
+		if (!isEnabled() || size == 0) return;
+#ifdef __linux__
+		const size_t	 pageSize	= getPageSize();
+		const uintptr_t	 first		= reinterpret_cast<uintptr_t>(data) / pageSize * pageSize;
+		const size_t	 nPages		= (reinterpret_cast<uintptr_t>(data) + size - first + pageSize - 1) / pageSize;
+		vec_int_t vNodes(nPages);
+		for (size_t p = 0; p < nPages; p++) {
+			const uintptr_t page = first + p * pageSize;
+			const size_t offset = page > reinterpret_cast<uintptr_t>(data) ? page - reinterpret_cast<uintptr_t>(data) : 0;
+			vNodes[p] = static_cast<int>(getPartNode(offset, size));
+		}
+		vec_int_t vStatus;
+		movePages(data, size, vNodes.data(), vStatus);
+#endif
+	}
+
+	vec_size_t getPlacement(const void *data, size_t size)
+	{
+		vec_size_t res(getNumNodes(), 0);
+		if (size == 0) return res;
+#ifdef __linux__
+		const size_t	 pageSize	= getPageSize();
+		const uintptr_t	 begin		= reinterpret_cast<uintptr_t>(data);
+		const uintptr_t	 first		= begin / pageSize * pageSize;
+		vec_int_t vStatus;
+		movePages(data, size, NULL, vStatus);
+		if (vStatus.empty() || vStatus[0] == -1) {
+			res[0] = size;
+			return res;
+		}
+		for (size_t p = 0; p < vStatus.size(); p++) {
+			if (vStatus[p] < 0 || static_cast<size_t>(vStatus[p]) >= res.size()) continue;		// the page is not allocated yet
+			const uintptr_t pageBegin	= MAX(begin, first + p * pageSize);
+			const uintptr_t pageEnd		= MIN(begin + size, first + (p + 1) * pageSize);
+			res[vStatus[p]] += pageEnd - pageBegin;
+		}
+#else
+		res[0] = size;
+#endif
+		return res;
+	}
+} }
@@ -0,0 +1,94 @@
+// NUMA-aware memory placement
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+namespace DirectGraphicalModels
+{
+	// ================================ NUMA Namespace ==============================
+	/**
+	* @brief NUMA-aware memory placement
+	* @details On the multi-socket machines the memory pages are placed on the NUMA node of the thread, which touches them first. The library buffers,
+	* allocated and initialized by one thread, would reside on one socket, while the threads of the other sockets do the most of the reads. The functions of this
+	* namespace split a buffer into getNumNodes() equal contiguous parts and place the part \a k on the NUMA node \a k. This matches the partitioning of the parallel
+	* loops of the pinned thread pool (ref. CThreadPool::setPinning()), which process the \a k-th part of the range on the threads of the NUMA node \a k:
+	* @code
+	* CThreadPool::getDefault().setPinning(true);
+	* vec_byte_t solution = graphKit.getInfer().decode(100);		// the messages are first-touched part by part
+	* const vec_size_t &vBytes = graphKit.getInfer().getStats().vNumaBytes;
+	* for (size_t node = 0; node < vBytes.size(); node++) printf("NUMA node %zu: %zu bytes\n", node, vBytes[node]);
+	* @endcode
+	* The message buffers of @ref CMessagePassing are initialized with firstTouch() and, when they are re-allocated in the memory of the arena, which has been
+	* touched before, moved with distribute(); their placement is queried only after the re-allocation. The contiguous potentials of @ref CGraphPairwiseCSR and @ref CGraphGrid,
+	* which are initialized by the caller, are moved with distribute(). The NUMA topology is read on Linux only; on the other systems, as well as on the
+	* single-socket machines, all the functions behave as with one NUMA node and cost nothing.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	namespace numa {
+		/**
+		* @brief Returns the number of NUMA nodes
+		* @return The number of the online NUMA nodes (at least 1)
+		*/
+		DllExport size_t		getNumNodes(void);
+		/**
+		* @brief Returns the CPUs of a NUMA node
+		* @param node The index of the NUMA node
+		* @return The indices of the CPUs of the node in ascending order
+		*/
+		DllExport vec_int_t		getNodeCpus(size_t node);
+		/**
+		* @brief Returns the NUMA node of the calling thread
+		* @return The index of the NUMA node of the CPU, which currently runs the calling thread
+		*/
+		DllExport size_t		getCurrentNode(void);
+		/**
+		* @brief Enables or disables the NUMA-aware placement of the library buffers
+		* @details The placement is enabled by default, but has effect only on the machines with several NUMA nodes
+		* @param enable Flag indicating whether the library buffers should be placed part by part on the NUMA nodes
+		*/
+		DllExport void			setEnabled(bool enable);
+		/**
+		* @brief Checks whether the library buffers are placed on the NUMA nodes
+		* @return \b true if the placement is enabled and the machine has several NUMA nodes, \b false otherwise
+		*/
+		DllExport bool			isEnabled(void);
+		/**
+		* @brief Initializes a buffer part by part on the NUMA nodes
+		* @details The buffer is split into page-aligned chunks, which are initialized in parallel; the pages of the chunks of the part \a k are allocated on the
+		* NUMA node \a k, independently of the thread, executing the initialization. The memory policy of the executing threads is restored afterwards.
+		* The pages, touched before the call, \a e.g. the re-used memory of an arena, are not moved: they may be placed with distribute().
+		* If the placement is disabled (ref. isEnabled()), \b init is called once for the whole buffer.
+		* @param data The pointer to the buffer
+		* @param n The number of the elements of the buffer
+		* @param elemSize The size of one element in bytes
+		* @param init The initialization of the elements [\a begin; \a end). It is called concurrently for the disjoint ranges, covering the whole buffer
+		*/
+		DllExport void			firstTouch(void *data, size_t n, size_t elemSize, const std::function<void(size_t begin, size_t end)> &init);
+		/**
+		* @brief Fills a buffer part by part on the NUMA nodes
+		* @param data The pointer to the buffer
+		* @param n The number of the elements of the buffer
+		* @param val The value of the elements
+		*/
+		template<typename T>
+		inline void				fill(T *data, size_t n, T val) { firstTouch(data, n, sizeof(T), [data, val](size_t begin, size_t end) { std::fill(data + begin, data + end, val); }); }
+		/**
+		* @brief Moves the pages of an initialized buffer part by part to the NUMA nodes
+		* @details The pages, which already reside on their NUMA nodes, are not copied. The pages, shared with the neighbouring allocations, are placed by the
+		* position of their first byte in the buffer. If the placement is disabled (ref. isEnabled()), this function does nothing.
+		* @param data The pointer to the buffer
+		* @param size The size of the buffer in bytes
+		*/
+		DllExport void			distribute(const void *data, size_t size);
+		/**
+		* @brief Returns the placement of a buffer
+		* @details The bytes of the pages, which are not allocated yet, are not counted. If the placement can not be queried, all the bytes are attributed to the NUMA node 0.
+		* @param data The pointer to the buffer
+		* @param size The size of the buffer in bytes
+		* @return The number of bytes of the buffer on every NUMA node: vector of size getNumNodes()
+		*/
+		DllExport vec_size_t	getPlacement(const void *data, size_t size);
+	}
+}
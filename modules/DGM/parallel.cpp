@@ -0,0 +1,65 @@
+#include "parallel.h"
+#include "simd.h"
+#ifdef ENABLE_BLAS
+#include <cblas.h>
+#endif
+
+namespace DirectGraphicalModels { namespace parallel { namespace impl {
+	namespace {
+		// Checks whether the elements of two matrices share memory: the matrices may be the overlapping views of one buffer with different origins
+		bool overlaps(const Mat &a, const Mat &b)
+		{
+			if (a.empty() || b.empty()) return false;
+			const uchar *aEnd = a.ptr(a.rows - 1) + a.cols * a.elemSize();
+			const uchar *bEnd = b.ptr(b.rows - 1) + b.cols * b.elemSize();
+			return a.data < bEnd && b.data < aEnd;
+		}
+	}
+
+	// The result is split into the macro-tiles, which are multiplied in parallel
+	void blocked_gemm(const Mat &A, const Mat &B, float alpha, const Mat &C, float beta, Mat &res, const std::function<void(const Rect &)> &epilogue)
+	{
+		DGM_ASSERT(A.cols == B.rows);
+		DGM_ASSERT(A.type() == CV_32FC1 && B.type() == CV_32FC1);
+		const bool hasC = !C.empty() && beta != 0;
+		if (hasC) {
+			DGM_ASSERT(C.type() == CV_32FC1);
+			DGM_ASSERT(C.rows == A.rows && C.cols == B.cols);
+		}
+
+		// The result may not share the memory with the factors, and may share it with the addend only if it is the addend itself
+		if (overlaps(res, A) || overlaps(res, B) || (hasC && overlaps(res, C) && (res.data != C.data || res.step != C.step))) {
+			Mat tmp;
+			blocked_gemm(A, B, alpha, C, beta, tmp, epilogue);
+			res = tmp;
+			return;
+		}
+		if (!hasC)						res.create(A.rows, B.cols, CV_32FC1);
+		else if (C.data != res.data)	C.copyTo(res);
+
+		const int M		= A.rows;
+		const int N		= B.cols;
+		const int K		= A.cols;
+		const int lda	= static_cast<int>(A.step1());
+		const int ldb	= static_cast<int>(B.step1());
+		const int ldc	= static_cast<int>(res.step1());
+		const float _beta = hasC ? beta : 0.0f;
+#ifdef ENABLE_BLAS
+		cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, M, N, K, alpha, A.ptr<float>(), lda, B.ptr<float>(), ldb, _beta, res.ptr<float>(), ldc);
+		if (epilogue) parallelFor(Range(0, M), [&](const Range &range) { epilogue(Rect(0, range.start, N, range.size())); });
+#else
+		const int tileRows = 192;
+		const int tileCols = 1024;
+		const int nTileRows = (M + tileRows - 1) / tileRows;
+		const int nTileCols = (N + tileCols - 1) / tileCols;
+		parallelFor(Range(0, nTileRows * nTileCols), [&](const Range &range) {
+			for (int t = range.start; t < range.end; t++) {
+				const int y = (t / nTileCols) * tileRows;
+				const int x = (t % nTileCols) * tileCols;
+				simd::sgemm(MIN(tileRows, M - y), MIN(tileCols, N - x), K, alpha, A.ptr<float>(y), lda, B.ptr<float>(0) + x, ldb, _beta, res.ptr<float>(y) + x, ldc);
+				if (epilogue) epilogue(Rect(x, y, MIN(tileCols, N - x), MIN(tileRows, M - y)));
+			}
+		}, 1);
+#endif
+	}
+} } }
@@ -4,6 +4,8 @@
 #include "types.h"
 #include "macroses.h"
 #include "random.h"
+#include "ThreadPool.h"
+#include <numeric>
 
 namespace DirectGraphicalModels { namespace parallel {
 // ------------------------------------------- GEMM ------------------------------------------
@@ -102,10 +104,22 @@ namespace DirectGraphicalModels { namespace parallel {
 			});
 		}
 #endif 
+		DllExport void blocked_gemm(const Mat &A, const Mat &B, float alpha, const Mat &C, float beta, Mat &res, const std::function<void(const Rect &)> &epilogue = nullptr);
 	}
 	///@endcond
+	/**
+	* @brief Epilogue of the matrix multiplication
+	* @details The argument is a tile of the result, which is completely calculated. The epilogue may read and modify the tile of the result, \a e.g. apply an activation function,
+	* while the tile is still in the cache. It is called concurrently for different tiles.
+	*/
+	using epilogue_function_t = std::function<void(const Rect &tile)>;
+
 	/**
 	* @brief Fast generalized matrix multiplication.
+	* @details For the single-channel float matrices, this function calculates \f$res = \alpha A\times B + \beta C\f$ with the blocked vectorized kernel (ref. simd::sgemm()),
+	* applied to the tiles of the result in parallel, or with the external BLAS library, if DGM is built with \a ENABLE_BLAS option. The other types are processed with cv::gemm().
+	* The result may be the same matrix as \b C.
+	* > This function supports PPL.
 	* @param A first multiplied input matrix that should have CV_32FC1, CV_64FC1, CV_32FC2, or CV_64FC2 type.
 	* @param B second multiplied input matrix of the same type as src1.
 	* @param alpha weight of the matrix product.
@@ -119,18 +133,102 @@ namespace DirectGraphicalModels { namespace parallel {
 		if (C.empty()) impl::amp_gemm(A, B, alpha, res);
 		else impl::amp_gemm(A, B, alpha, C, beta, res);
 #else 
-#ifdef ENABLE_PDP
-		if (C.empty()) impl::ppl_gemm(A, B, alpha, res);
-		else impl::ppl_gemm(A, B, alpha, C, beta, res);
-#else
-		cv::gemm(A, B, alpha, C, beta, res);
+		if (A.type() == CV_32FC1 && B.type() == CV_32FC1 && (C.empty() || C.type() == CV_32FC1)) impl::blocked_gemm(A, B, alpha, C, beta, res);
+		else cv::gemm(A, B, alpha, C, beta, res);
 #endif
+	}
+	/**
+	* @brief Fast generalized matrix multiplication with an epilogue
+	* @details This function calculates \f$res = \alpha A\times B + \beta C\f$ as gemm(const Mat &, const Mat &, float, const Mat &, float, Mat &) does, and calls the epilogue
+	* for every tile of the result, as soon as the tile is calculated. This allows for fusing the element-wise post-processing of the result with the multiplication.
+	* If the multiplication is not tiled, \a e.g. with the external BLAS library, the epilogue is called for the stripes of the result rows.
+	* > This function supports PPL.
+	* @param A first multiplied input matrix that should have CV_32FC1, CV_64FC1, CV_32FC2, or CV_64FC2 type.
+	* @param B second multiplied input matrix of the same type as src1.
+	* @param alpha weight of the matrix product.
+	* @param C third optional delta matrix added to the matrix product; it should have the same type as src1 and src2.
+	* @param beta weight of src3.
+	* @param res output matrix; it has the proper size and the same type as input matrices.
+	* @param epilogue The epilogue, called for every tile of the result (Ref. @ref epilogue_function_t)
+	*/
+	DllExport inline void gemm(const Mat &A, const Mat &B, float alpha, const Mat &C, float beta, Mat &res, const epilogue_function_t &epilogue)
+	{
+#ifndef ENABLE_AMP
+		if (A.type() == CV_32FC1 && B.type() == CV_32FC1 && (C.empty() || C.type() == CV_32FC1)) {
+			impl::blocked_gemm(A, B, alpha, C, beta, res, epilogue);
+			return;
+		}
 #endif
+		gemm(A, B, alpha, C, beta, res);
+		parallelFor(Range(0, res.rows), [&](const Range &range) { epilogue(Rect(0, range.start, res.cols, range.size())); });
 	}
 
+#ifdef ENABLE_OCL
+	/**
+	* @brief Generalized matrix multiplication on the OpenCL device
+	* @details This function calculates \f$res = \alpha A\times B + \beta C\f$ with the device buffers: the operands and the result stay on the device,
+	* thus a chain of products, \a e.g. the layers of a neural network, needs no transfers between the host and the device.
+	* If no OpenCL device is available (ref. gpu::isAvailable()), OpenCV processes the product on the host.
+	* @param A first multiplied input matrix that should have CV_32FC1, CV_64FC1, CV_32FC2, or CV_64FC2 type.
+	* @param B second multiplied input matrix of the same type as src1.
+	* @param alpha weight of the matrix product.
+	* @param C third optional delta matrix added to the matrix product; it should have the same type as src1 and src2.
+	* @param beta weight of src3.
+	* @param res output matrix; it has the proper size and the same type as input matrices.
+	*/
+	DllExport inline void gemm(const UMat &A, const UMat &B, float alpha, const UMat &C, float beta, UMat &res)
+	{
+		cv::gemm(A, B, alpha, C, beta, res);
+	}
+#endif
+
 	
+	// ----------------------------------------- TRAVERSAL -----------------------------------------
+	// ---------------- traversal of the feature blocks with concurrent rows with PPL  ----------------
+	/**
+	* @brief Calls the method of the object for every pixel of the block
+	* @details This function traverses the block as DGM_VECTORWISE1() does. If the class \a T is declared thread-safe (ref. is_thread_safe), the rows of the block
+	* are processed concurrently, otherwise sequentially.
+	* > This function supports PPL.
+	* @tparam T The type of the object
+	* @tparam SomeMethod The method, which is called with the feature vector Mat(size: nFeatures x 1; type: CV_8UC1) and the value of \b m2 of every pixel
+	* @tparam M The layout of the features: Mat(type: CV_8UC(nFeatures)) or vec_mat_t
+	* @param self The object
+	* @param m1 The block of feature vectors
+	* @param m2 The block of values: Mat(type: CV_8UC1)
+	*/
+	template<typename T, void (T::*SomeMethod)(const Mat &vec, byte b), typename M>
+	DllExport inline void vectorwise1(T &self, const M &m1, const Mat &m2)
+	{
+		if constexpr (is_thread_safe<T>::value)
+			parallelFor(Range(0, m2.rows), [&](const Range &rows) { DGM_VECTORWISE1<T, SomeMethod>(self, m1, m2, rows); });
+		else 
+			DGM_VECTORWISE1<T, SomeMethod>(self, m1, m2);
+	}
+
+	/**
+	* @brief Calls the method of the object for the blocks of rows
+	* @details This function traverses the block as DGM_BLOCKWISE1() does: the method receives the interleaved blocks of rows. If the class \a T is declared 
+	* thread-safe (ref. is_thread_safe), the rows of the block are processed concurrently, otherwise sequentially.
+	* > This function supports PPL.
+	* @tparam T The type of the object
+	* @tparam SomeMethod The method, which is called with the block of rows of feature vectors Mat(type: CV_8UC(nFeatures)) and the corresponding block of values
+	* @tparam M The layout of the features: Mat(type: CV_8UC(nFeatures)) or vec_mat_t
+	* @param self The object
+	* @param m1 The block of feature vectors
+	* @param m2 The block of values: Mat(type: CV_8UC1)
+	*/
+	template<typename T, void (T::*SomeMethod)(const Mat &block, const Mat &gt), typename M>
+	DllExport inline void blockwise1(T &self, const M &m1, const Mat &m2)
+	{
+		if constexpr (is_thread_safe<T>::value)
+			parallelFor(Range(0, m2.rows), [&](const Range &rows) { DGM_BLOCKWISE1<T, SomeMethod>(self, m1, m2, rows); });
+		else
+			DGM_BLOCKWISE1<T, SomeMethod>(self, m1, m2);
+	}
+
 	// -------------------------------------------- SORT -------------------------------------------
-	// --------------------------- fast sorting of Mat elements with PPL  --------------------------
+	// ------------------------ fast sorting of Mat rows via an index with PPL  ------------------------
 	namespace {
         inline void Swap(Mat &a, Mat &b, Mat &tmp = EmptyMat)
 		{
@@ -139,82 +237,41 @@ namespace DirectGraphicalModels { namespace parallel {
 			tmp.copyTo(b);
 		}
 
-		template <typename T>
-		inline void insertion_sort(Mat &m, int x, int begin, int end)
-		{
-			Mat tmp;
-			for (int i = begin; i <= end; i++) {
-				int j = i;
-				while (j > begin && m.at<T>(j, x) < m.at<T>(j - 1, x)) {
-					Swap(lvalue_cast(m.row(j)), lvalue_cast(m.row(j - 1)), tmp);
-					j--;
-				}
-			}
-		}
-	
-		template <typename T>
-		inline void sequential_quick_sort(Mat &m, int x, int begin, int end, int threshold)
+		// Merge sort of the row indexes: the halves are sorted as parallel tasks and merged
+		template <typename Compare>
+		inline void sortIndex(int *pBegin, int *pEnd, Compare compare)
 		{
-			if (end - begin < threshold) insertion_sort<T>(m, x, begin, end);
-			else {
-				int	_begin	= begin;
-				int	_end	= end;
-				T	pivot	= m.at<T>((begin + end) / 2, x);
-
-				// partition
-				while (_begin <= _end) {
-					while (m.at<T>(_begin, x) < pivot) _begin++;
-					while (m.at<T>(_end,   x) > pivot) _end--;
-					if (_begin <= _end) {
-						Swap(lvalue_cast(m.row(_begin)), lvalue_cast(m.row(_end)));
-						_begin++;
-						_end--;
-					}
-				};
-
-				// recursion 
-				if (begin < _end)	sequential_quick_sort<T>(m, x, begin, _end, threshold);
-				if (_begin < end)	sequential_quick_sort<T>(m, x, _begin, end, threshold);
+#ifdef ENABLE_PDP
+			if (pEnd - pBegin > 4096) {
+				int *pMiddle = pBegin + (pEnd - pBegin) / 2;
+				CTaskGroup group;
+				group.run([=] { sortIndex(pBegin, pMiddle, compare); });
+				sortIndex(pMiddle, pEnd, compare);
+				group.wait();
+				std::inplace_merge(pBegin, pMiddle, pEnd, compare);
+				return;
 			}
+#endif
+			std::sort(pBegin, pEnd, compare);
 		}
 
-#ifdef ENABLE_PDP
-		template <typename T>
-		inline void parallel_quick_sort(Mat &m, int x, int begin, int end, int threshold, int depthRemaining)
+		// Moves every row once: row y of the result is row vIdx[y] of the source
+		inline void permuteRows(Mat &m, const vec_int_t &vIdx)
 		{
-			if (end - begin < threshold) insertion_sort<T>(m, x, begin, end);
-			else {
-				int	_begin	= begin;
-				int	_end	= end;
-				T	pivot	= m.at<T>((begin + end) / 2, x);
-
-				// partition
-				while (_begin <= _end) {
-					while (m.at<T>(_begin, x) < pivot) _begin++;
-					while (m.at<T>(_end,   x) > pivot) _end--;
-					if (_begin <= _end) {
-						Swap(lvalue_cast(m.row(_begin)), lvalue_cast(m.row(_end)));
-						_begin++;
-						_end--;
-					}
-				};
-
-				// recursion 
-				if (depthRemaining > 0) {
-					if (begin < _end)	parallel_quick_sort<T>(m, x, begin, _end, threshold, depthRemaining - 1);
-					if (_begin < end)	parallel_quick_sort<T>(m, x, _begin, end, threshold, depthRemaining - 1);
-				} else {
-					if (begin < _end)	sequential_quick_sort<T>(m, x, begin, _end, threshold);
-					if (_begin < end)	sequential_quick_sort<T>(m, x, _begin, end, threshold);
-				}
-			}
+			Mat res(m.size(), m.type());
+			const size_t rowSize = m.cols * m.elemSize();
+			parallelFor(Range(0, m.rows), [&](const Range &range) {
+				for (int y = range.start; y < range.end; y++)
+					memcpy(res.ptr(y), m.ptr(vIdx[y]), rowSize);
+			}, 1024);
+			res.copyTo(m);
 		}
-#endif
 	}
 
 	/**
 	* @brief Sorts the rows of the input matrix by the given dimension.
 	* @details The result of the sorting may is expressed as: \f$ m_{x,y} < m_{x,y+1}, \forall y \f$.
+	* The array of the row indexes is sorted first, and then every row is moved once.
 	* > This function supports PPL.
 	* @tparam T The type of elements in matrix.
 	* @param[in, out] m The input/output data, which rows should be sorted.
@@ -224,42 +281,16 @@ namespace DirectGraphicalModels { namespace parallel {
 	DllExport inline void sortRows(Mat &m, int x)
 	{
 		DGM_ASSERT(x < m.cols);
-#ifdef ENABLE_PDP
-		parallel_quick_sort<T>(m, x, 0, m.rows - 1, 200, 16);
-#else 
-		sequential_quick_sort<T>(m, x, 0, m.rows - 1, 200);
-#endif
-	}
-
-	namespace {
-		template <typename T>
-		inline void deepSort(Mat &m, int depth, int begin, int end)
-		{
-			if (depth == m.cols) return;				// we are too deep
-			if (begin == end)    return;				// do not sort one element
-
-#ifdef ENABLE_PDP
-			parallel_quick_sort<T>(m, depth, begin, end, 200, 16);
-#else 
-			sequential_quick_sort<T>(m, depth, begin, end, 200);
-#endif
-
-			int ref_pos = begin;
-			T   ref_val = m.at<T>(begin, depth);
-			for (int y = begin + 1; y <= end; y++) {
-				T val = m.at<T>(y, depth);
-				if (val != ref_val) {
-					deepSort<T>(m, depth + 1, ref_pos, y - 1);
-					ref_pos = y;
-					ref_val = val;
-				}
-			} // y
-		}
+		vec_int_t vIdx(m.rows);
+		std::iota(vIdx.begin(), vIdx.end(), 0);
+		sortIndex(vIdx.data(), vIdx.data() + vIdx.size(), [&m, x](int a, int b) { return m.at<T>(a, x) < m.at<T>(b, x); });
+		permuteRows(m, vIdx);
 	}
 
 	/**
 	* @brief Sorts the rows of the input matrix
-	* @details 
+	* @details The rows are sorted in the lexicographical order, \a i.e. by the first dimension, the rows with equal first dimension - by the second, and so on.
+	* The array of the row indexes is sorted first with the comparison of the whole rows (the rows of bytes are compared with \a memcmp()), and then every row is moved once.
 	* > This function supports PPL.
 	* @tparam T The type of elements in matrix.
 	* @param[in, out] m The input/output data, which rows should be sorted.
@@ -267,7 +298,16 @@ namespace DirectGraphicalModels { namespace parallel {
 	template <typename T>
 	DllExport inline void sortRows(Mat &m)
 	{
-		deepSort<T>(m, 0, 0, m.rows - 1);
+		const int n = m.cols * m.channels();
+		vec_int_t vIdx(m.rows);
+		std::iota(vIdx.begin(), vIdx.end(), 0);
+		sortIndex(vIdx.data(), vIdx.data() + vIdx.size(), [&m, n](int a, int b) {
+			const T *pA = m.ptr<T>(a);
+			const T *pB = m.ptr<T>(b);
+			if constexpr (std::is_same<T, byte>::value) return memcmp(pA, pB, n) < 0;
+			else return std::lexicographical_compare(pA, pA + n, pB, pB + n);
+		});
+		permuteRows(m, vIdx);
 	}
 
 	// ------------------------------------------- SUFFLE ------------------------------------------
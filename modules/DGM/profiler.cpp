@@ -0,0 +1,151 @@
+#include "profiler.h"
+#include "macroses.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+
+namespace DirectGraphicalModels { namespace profiler
+{
+	namespace {
+		using clock_type = std::chrono::steady_clock;
+
+		// The ring buffer of the closed zones and the stack of the open zones of one thread
+		struct Buffer {
+			std::mutex			mtx;			// protects vEvents, head and nEvents against the readers from the other threads
+			std::vector<Event>	vEvents;		// the ring buffer, allocated on the first closed zone
+			size_t				head	= 0;	// the index of the next zone to be written
+			size_t				nEvents	= 0;	// the number of the recorded zones
+			std::vector<std::pair<const char *, int64_t>> vOpen;	// the names and the opening times of the open zones; used only by the owning thread
+			dword				thread	= 0;	// the index of the thread
+		};
+
+		const clock_type::time_point	g_epoch = clock_type::now();
+		std::atomic<bool>			g_enabled(true);
+		std::atomic<size_t>			g_capacity(65536);
+		std::mutex					g_mtx;			// protects g_vpBuffers and g_names
+		std::vector<std::shared_ptr<Buffer>>	g_vpBuffers;	// the buffers of all the threads, kept after the threads exit
+		std::unordered_set<std::string>			g_names;		// the interned names: the nodes of the set are never moved
+
+		inline int64_t now(void)
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - g_epoch).count();
+		}
+
+		Buffer &getBuffer(void)
+		{
+			thread_local std::shared_ptr<Buffer> pBuffer = [] {
+				auto res = std::make_shared<Buffer>();
+				std::lock_guard<std::mutex> lock(g_mtx);
+				res->thread = static_cast<dword>(g_vpBuffers.size());
+				g_vpBuffers.push_back(res);
+				return res;
+			}();
+			return *pBuffer;
+		}
+
+		// Writes the string with the JSON escape sequences
+		void writeString(FILE *pFile, const char *str)
+		{
+			fputc('"', pFile);
+			for (const char *c = str; *c; c++) {
+				if (*c == '"' || *c == '\\') fprintf(pFile, "\\%c", *c);
+				else if (static_cast<unsigned char>(*c) < 0x20) fprintf(pFile, "\\u%04x", *c);
+				else fputc(*c, pFile);
+			}
+			fputc('"', pFile);
+		}
+	}
+
+	void setEnabled(bool enable)
+	{
+		g_enabled = enable;
+	}
+
+	bool isEnabled(void)
+	{
+		return g_enabled;
+	}
+
+	void setCapacity(size_t nEvents)
+	{
+		DGM_ASSERT(nEvents > 0);
+		g_capacity = nEvents;
+		clear();
+	}
+
+	void clear(void)
+	{
+		std::lock_guard<std::mutex> lock(g_mtx);
+		for (auto &pBuffer : g_vpBuffers) {
+			std::lock_guard<std::mutex> lockBuffer(pBuffer->mtx);
+			pBuffer->vEvents.clear();
+			pBuffer->vEvents.shrink_to_fit();
+			pBuffer->head		= 0;
+			pBuffer->nEvents	= 0;
+		}
+	}
+
+	bool begin(const char *name)
+	{
+		if (!g_enabled) return false;
+		getBuffer().vOpen.emplace_back(name, now());
+		return true;
+	}
+
+	void end(void)
+	{
+		const int64_t t = now();
+		Buffer &buffer = getBuffer();
+		DGM_ASSERT_MSG(!buffer.vOpen.empty(), "There is no open zone in this thread");
+		const auto zone = buffer.vOpen.back();
+		buffer.vOpen.pop_back();
+
+		std::lock_guard<std::mutex> lock(buffer.mtx);
+		if (buffer.vEvents.empty()) buffer.vEvents.resize(g_capacity);
+		buffer.vEvents[buffer.head] = { zone.first, zone.second, t - zone.second, buffer.thread, static_cast<word>(buffer.vOpen.size()) };
+		buffer.head = (buffer.head + 1) % buffer.vEvents.size();
+		if (buffer.nEvents < buffer.vEvents.size()) buffer.nEvents++;
+	}
+
+	const char * intern(const std::string &name)
+	{
+		std::lock_guard<std::mutex> lock(g_mtx);
+		return g_names.insert(name).first->c_str();
+	}
+
+	std::vector<Event> getEvents(void)
+	{
+		std::vector<Event> res;
+		{
+			std::lock_guard<std::mutex> lock(g_mtx);
+			for (auto &pBuffer : g_vpBuffers) {
+				std::lock_guard<std::mutex> lockBuffer(pBuffer->mtx);
+				const size_t capacity	= pBuffer->vEvents.size();
+				const size_t first		= (pBuffer->head + capacity - pBuffer->nEvents) % MAX(1, capacity);	// the oldest zone
+				for (size_t i = 0; i < pBuffer->nEvents; i++)
+					res.push_back(pBuffer->vEvents[(first + i) % capacity]);
+			}
+		}
+		std::stable_sort(res.begin(), res.end(), [](const Event &a, const Event &b) { return a.begin < b.begin; });
+		return res;
+	}
+
+	void saveChromeTrace(const std::string &fileName)
+	{
+		const std::vector<Event> vEvents = getEvents();
+
+		FILE *pFile = fopen(fileName.c_str(), "w");
+		DGM_ASSERT_MSG(pFile, "Can't create file %s", fileName.c_str());
+		fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+		for (size_t i = 0; i < vEvents.size(); i++) {
+			const Event &event = vEvents[i];
+			fprintf(pFile, "%s\n{\"name\":", i ? "," : "");
+			writeString(pFile, event.name);
+			fprintf(pFile, ",\"cat\":\"DGM\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"depth\":%u}}",
+				event.begin * 1e-3, event.duration * 1e-3, static_cast<unsigned int>(event.thread), static_cast<unsigned int>(event.depth));
+		}
+		fprintf(pFile, "\n]}\n");
+		fclose(pFile);
+	}
+} }
@@ -0,0 +1,132 @@
+// Scoped hierarchical profiler
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Profiler Namespace ==============================
+	/**
+	* @brief Scoped hierarchical profiler
+	* @details This namespace collects methods for measuring the time, spent in the named zones of the code. A zone is the scope of a
+	* @ref profiler::CZone object, usually declared with the @ref DGM_PROFILE_ZONE macro; the zones may be nested and may be opened concurrently by different threads.
+	* Every thread records its closed zones into its own ring buffer, so the threads do not contend, and when the buffer is full, the oldest zones are overwritten.
+	* The recorded zones may be exported in the <a href="https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU">Chrome trace event format</a>,
+	* which is opened by \a chrome://tracing and by <a href="https://ui.perfetto.dev">Perfetto</a>:
+	* @code
+	* {
+	*	DGM_PROFILE_ZONE("Filling the graph");
+	*	graphKit.getGraphExt().setGraph(potentials);
+	* }
+	* vec_byte_t solution = graphKit.getInfer().decode(100);		// the library zones: "decode", "LBP iteration", ...
+	* profiler::saveChromeTrace("trace.json");
+	* @endcode
+	* The library code is instrumented with @ref DGM_PROFILE_ZONE, which expands to nothing, unless DGM is built with \a ENABLE_PROFILER option;
+	* thus the profiler has no cost in the default builds.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	namespace profiler {
+		/// Closed zone
+		struct Event {
+			const char	* name;				///< The name of the zone
+			int64_t		  begin;			///< The time of opening the zone in nanoseconds since the start of the application
+			int64_t		  duration;			///< The duration of the zone in nanoseconds
+			dword		  thread;			///< The index of the thread, in the order of their first zone
+			word		  depth;			///< The nesting depth of the zone in its thread: 0 for the outermost zones
+		};
+
+		/**
+		* @brief Enables or disables the recording of the zones
+		* @details The zones, opened while the recording is disabled, are not recorded. The recording is enabled by default
+		* @param enable Flag indicating whether the zones should be recorded
+		*/
+		DllExport void		setEnabled(bool enable);
+		/**
+		* @brief Checks whether the zones are recorded
+		* @return \b true if the recording is enabled, \b false otherwise
+		*/
+		DllExport bool		isEnabled(void);
+		/**
+		* @brief Sets the capacity of the ring buffers
+		* @details This function also removes all the recorded zones (ref. clear())
+		* @param nEvents The maximal number of the zones, kept for every thread (default: 65536)
+		*/
+		DllExport void		setCapacity(size_t nEvents);
+		/**
+		* @brief Removes all the recorded zones of all the threads
+		*/
+		DllExport void		clear(void);
+
+		/**
+		* @brief Opens a zone in the calling thread
+		* @details Every call, returning \b true, must be followed by a call of end() in the same thread. The @ref profiler::CZone class does it automatically
+		* @param name The name of the zone. The string must persist until the zones are exported, \a e.g. be a string literal or be returned by intern()
+		* @retval true if the zone is opened
+		* @retval false if the recording is disabled
+		*/
+		DllExport bool		begin(const char *name);
+		/**
+		* @brief Closes the innermost open zone of the calling thread
+		*/
+		DllExport void		end(void);
+		/**
+		* @brief Returns a persistent copy of the zone name
+		* @details The names, composed at run-time, should be interned once and reused, since this function locks a global mutex
+		* @param name The name of the zone
+		* @return The pointer to the copy of the \b name, valid until the end of the application
+		*/
+		DllExport const char * intern(const std::string &name);
+
+		/**
+		* @brief Returns the recorded zones of all the threads
+		* @details The zones, which are still open, are not returned
+		* @return The zones, sorted by their opening time
+		*/
+		DllExport std::vector<Event> getEvents(void);
+		/**
+		* @brief Saves the recorded zones in the Chrome trace event format
+		* @details Every zone is stored as a complete event ("ph": "X") with the time in microseconds; the threads are stored as the threads of one process
+		* @param fileName The name of the JSON file
+		*/
+		DllExport void		saveChromeTrace(const std::string &fileName);
+
+		// ================================ Zone Class ==============================
+		/**
+		* @brief Scoped zone
+		* @details The zone is opened in the constructor and closed in the destructor
+		* @author Sergey G. Kosov, sergey.kosov@project-10.de
+		*/
+		class CZone {
+		public:
+			/**
+			* @brief Constructor
+			* @param name The name of the zone (ref. begin())
+			*/
+			CZone(const char *name) : m_active(begin(name)) {}
+			CZone(const CZone &) = delete;
+			~CZone(void) { if (m_active) end(); }
+
+			bool operator=(const CZone &) = delete;
+
+
+		private:
+			bool m_active;					///< Flag indicating whether the zone has been opened
+		};
+	}
+}
+
+#define DGM_PROFILE_CONCAT_(a, b) a##b
+#define DGM_PROFILE_CONCAT(a, b) DGM_PROFILE_CONCAT_(a, b)
+
+/**
+* @def DGM_PROFILE_ZONE(name)
+* @brief Opens a profiler zone until the end of the current scope
+* @details This macro expands to nothing, unless DGM is built with \a ENABLE_PROFILER option (ref. @ref profiler)
+* @param name The name of the zone: a string literal or a pointer, returned by profiler::intern()
+*/
+#ifdef ENABLE_PROFILER
+#define DGM_PROFILE_ZONE(name) DirectGraphicalModels::profiler::CZone DGM_PROFILE_CONCAT(__dgmZone, __LINE__)(name)
+#else
+#define DGM_PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,44 @@
+#include "random.h"
+#include "macroses.h"
+#include <atomic>
+
+namespace DirectGraphicalModels { namespace random 
+{
+	namespace {
+		const uint64_t	THREAD_STREAM = 1ULL << 63;									// the bit, marking the streams of the thread generators
+
+		std::atomic<uint64_t>	g_seed(static_cast<uint64_t>(std::random_device()()) << 32 | std::random_device()());
+		std::atomic<uint64_t>	g_epoch(0);											// the number of seed() calls
+		std::atomic<uint64_t>	g_nThreadStreams(0);								// the number of the thread streams, created since the last seed() call
+	}
+
+	void seed(uint64_t seed)
+	{
+		g_seed			= seed;
+		g_nThreadStreams = 0;
+		g_epoch++;
+	}
+
+	uint64_t getSeed(void)
+	{
+		return g_seed;
+	}
+
+	// The generator of a thread is re-created on the first draw after seeding
+	CPhilox & getGenerator(void)
+	{
+		static thread_local CPhilox		generator;
+		static thread_local uint64_t	epoch = UINT64_MAX;
+		if (epoch != g_epoch) {
+			epoch		= g_epoch;
+			generator	= CPhilox(g_seed, THREAD_STREAM | g_nThreadStreams++);
+		}
+		return generator;
+	}
+
+	CPhilox getStream(uint64_t id)
+	{
+		DGM_ASSERT_MSG((id & THREAD_STREAM) == 0, "The stream index %llu is reserved for the thread generators", static_cast<unsigned long long>(id));
+		return CPhilox(g_seed, id);
+	}
+} }
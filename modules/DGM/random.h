@@ -11,15 +11,129 @@ namespace DirectGraphicalModels
 	// ================================ Random Namespace ==============================
 	/**
 	* @brief Random number generation
-	* @details This namespace collects methods for generating random numbers and vectors with uniform and normal distributions
+	* @details This namespace collects methods for generating random numbers and vectors with uniform and normal distributions.
+	* The numbers are drawn from the counter-based @ref random::CPhilox generators: every thread uses its own generator (ref. getGenerator()) and the parallel algorithms
+	* use one stream per work item (ref. getStream()), so no generator is shared between the threads. After calling seed() the results are reproducible:
+	* the streams depend only on the seed and their indexes, but not on the number of threads, which process the work items.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	namespace random {
+		// ============================== Philox Generator Class ==============================
+		/**
+		* @brief Philox4x32-10 counter-based random number generator
+		* @details The generator encrypts the 128-bit counter, composed of the 64-bit block number and the 64-bit stream index, with the 64-bit key (the seed)
+		* in 10 rounds, producing 4 random 32-bit words per block (Ref. <a href="https://doi.org/10.1145/2063384.2063405">Salmon et al., Parallel random numbers: as easy as 1, 2, 3</a>).
+		* Thus, the generators of different streams are independent, their construction is free and discard() takes constant time.
+		* The class satisfies the requirements of the \a UniformRandomBitGenerator, so it works with all the \a std distributions.
+		* @author Sergey G. Kosov, sergey.kosov@project-10.de
+		*/
+		class CPhilox
+		{
+		public:
+			using result_type = uint32_t;
+
+			/**
+			* @brief Constructor
+			* @param seed The seed (the key of the generator)
+			* @param stream The index of the stream
+			*/
+			CPhilox(uint64_t seed = 0, uint64_t stream = 0) : m_key{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) }, m_stream(stream), m_pos(0), m_block(UINT64_MAX) {}
+
+			static constexpr result_type min(void) { return 0; }
+			static constexpr result_type max(void) { return UINT32_MAX; }
+			/**
+			* @brief Returns the next random number
+			* @return The random 32-bit word
+			*/
+			result_type operator() (void)
+			{
+				const uint64_t block = m_pos / 4;
+				if (block != m_block) {
+					generate(block);
+					m_block = block;
+				}
+				return m_result[m_pos++ % 4];
+			}
+			/**
+			* @brief Skips random numbers
+			* @param z The number of the random numbers to skip
+			*/
+			void discard(unsigned long long z) { m_pos += z; }
+			/**
+			* @brief Returns the stream index
+			* @return The index of the stream
+			*/
+			uint64_t getStream(void) const { return m_stream; }
+			bool operator== (const CPhilox &rhs) const { return m_key[0] == rhs.m_key[0] && m_key[1] == rhs.m_key[1] && m_stream == rhs.m_stream && m_pos == rhs.m_pos; }
+			bool operator!= (const CPhilox &rhs) const { return !(*this == rhs); }
+
+
+		private:
+			void generate(uint64_t block)
+			{
+				uint32_t c[4] = { static_cast<uint32_t>(block), static_cast<uint32_t>(block >> 32), static_cast<uint32_t>(m_stream), static_cast<uint32_t>(m_stream >> 32) };
+				uint32_t k[2] = { m_key[0], m_key[1] };
+				for (int r = 0; r < 10; r++) {												// rounds
+					const uint64_t p0 = static_cast<uint64_t>(0xD2511F53) * c[0];
+					const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57) * c[2];
+					const uint32_t t[4] = { static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0], static_cast<uint32_t>(p1), static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1], static_cast<uint32_t>(p0) };
+					std::copy(t, t + 4, c);
+					k[0] += 0x9E3779B9;
+					k[1] += 0xBB67AE85;
+				}
+				std::copy(c, c + 4, m_result);
+			}
+
+
+		private:
+			uint32_t	m_key[2];			///< The key
+			uint64_t	m_stream;			///< The stream index: the upper half of the counter
+			uint64_t	m_pos;				///< The index of the next random number in the stream
+			uint64_t	m_block;			///< The block number of m_result
+			uint32_t	m_result[4];		///< The random numbers of the current block
+		};
+
+		/**
+		* @brief Seeds the random number generation
+		* @details After this call, the generators of all the threads (ref. getGenerator()) and all the streams (ref. getStream()) are derived from the \b seed.
+		* Without this call the seed is non-deterministic.
+		* @param seed The seed
+		*/
+		DllExport void		seed(uint64_t seed);
+		/**
+		* @brief Returns the current seed
+		* @return The seed, set by seed() or chosen non-deterministically at the start of the application
+		*/
+		DllExport uint64_t	getSeed(void);
+		/**
+		* @brief Returns the random number generator of the calling thread
+		* @details The generator is re-created after every call of seed(). The threads use different streams, indexed in the order of their first draw after the seeding,
+		* \a e.g. the thread calling seed() and drawing next, receives the first one. Hence, the serial code is reproducible, while the parallel code should use getStream() for every work item.
+		* @return The generator, used by the calling thread only
+		*/
+		DllExport CPhilox & getGenerator(void);
+		/**
+		* @brief Returns a stream of random numbers
+		* @details The stream depends only on the current seed and the index, so the work items of a parallel loop, which draw from the streams, indexed by the items,
+		* produce the same results for any number of threads:
+		* @code
+		* parallel::parallelFor(Range(0, nSamples), [&](const Range &range) {
+		*	for (int i = range.start; i < range.end; i++) {
+		*		random::CPhilox generator = random::getStream(i);
+		*		vSamples[i] = random::N<float>(generator);
+		*	}
+		* });
+		* @endcode
+		* @param id The index of the stream. The indexes with the highest bit set are reserved for the thread generators.
+		* @return The generator of the stream
+		*/
+		DllExport CPhilox	getStream(uint64_t id);
+
 		/**
 		* @brief Returns an integer random number with uniform distribution
 		* @details This function produces random integer values \a i, uniformly distributed on the closed interval [\b min, \b max], that is, distributed according to the discrete probability function:
 		* \f[ P(i\,|\,min,max)=\frac{1}{max-min+1}, min \leq i \leq max \f]
-		* > This function is thread-safe
+		* > This function is thread-safe and draws from getGenerator()
 		* @tparam T An integer type: \a short, \a int, \a long, \a long \a long, \a unsigned \a short, \a unsigned \a int, \a unsigned \a long, or \a unsigned \a long \a long
 		* @param min The lower boudaty of the interval
 		* @param max The upper boundary of the interval
@@ -28,15 +142,14 @@ namespace DirectGraphicalModels
 		template <typename T>
 		inline T u(T min, T max)
 		{
-			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			std::uniform_int_distribution<T> distribution(min, max);
-			return distribution(generator);
+			return distribution(getGenerator());
 		}
 		/**
 		* @brief Returns a floating-point random number with uniform distribution
 		* @details This function produces random floating-point values \a i, uniformly distributed on the interval [\b min, \b max), that is, distributed according to the probability function: 
 		* \f[ P(i\,|\,min,max)=\frac{1}{max-min}, min \leq i < max \f] 
-		* > This function is thread-safe
+		* > This function is thread-safe and draws from getGenerator()
 		* @tparam T A floating-point type: \a float, \a double, or \a long \a double
 		* @param min The lower boudaty of the interval
 		* @param max The upper boundary of the interval
@@ -45,15 +158,14 @@ namespace DirectGraphicalModels
 		template <typename T>
 		inline T U(T min = 0, T max = 1)
 		{
-			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			std::uniform_real_distribution<T> distribution(min, max);
-			return distribution(generator);
+			return distribution(getGenerator());
 		}
 		/**
 		* @brief Returns a floating-point random number with normal distribution
 		* @details This function generates random numbers according to the <a href="https://en.wikipedia.org/wiki/Normal_distribution">Normal (or Gaussian) random number distribution</a>:
 		* \f[ f(x\,;\,\mu,\sigma)=\frac{1}{\sqrt{2\sigma^2\pi}} exp{\frac{-(x-\mu)^2}{2\sigma^2}} \f]
-		* > This function is thread-safe
+		* > This function is thread-safe and draws from getGenerator()
 		* @tparam T A floating-point type: \a float, \a double, or \a long \a double
 		* @param mu The <a href="https://en.wikipedia.org/wiki/Mean">mean</a> \f$\mu\f$
 		* @param sigma The <a href="https://en.wikipedia.org/wiki/Standard_deviation">standard deviation</a> \f$\sigma\f$
@@ -62,9 +174,8 @@ namespace DirectGraphicalModels
 		template <typename T>
 		inline T N(T mu = 0, T sigma = 1)
 		{
-			static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 			std::normal_distribution<T> distribution(mu, sigma);
-			return distribution(generator);
+			return distribution(getGenerator());
 		}
 
 
@@ -78,7 +189,7 @@ namespace DirectGraphicalModels
 		*/
 		inline Mat U(cv::Size size, int type, double min = 0, double max = 1)
 		{
-			static thread_local RNG rng(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
+			RNG rng(static_cast<uint64>(getGenerator()()) << 32 | getGenerator()());
 			Mat res(size, type);
 			rng.fill(res, RNG::UNIFORM, min, max);
 			return res;
@@ -93,12 +204,56 @@ namespace DirectGraphicalModels
 		*/
 		inline Mat N(cv::Size size, int type, double mu = 0, double sigma = 1)
 		{
-			static thread_local RNG rng(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
+			RNG rng(static_cast<uint64>(getGenerator()()) << 32 | getGenerator()());
 			Mat res(size, type);
 			rng.fill(res, RNG::NORMAL, mu, sigma);
 			return res;
 		}
 
+		/**
+		* @brief Returns an integer random number with uniform distribution, drawn from the given generator
+		* @tparam T An integer type. It must be given explicitly: \a e.g. random::u<int>(generator, 0, 9)
+		* @tparam G The type of the generator
+		* @param generator The random number generator, \a e.g. a stream (ref. getStream())
+		* @param min The lower boudaty of the interval
+		* @param max The upper boundary of the interval
+		* @returns The random number from interval [\b min, \b max]
+		*/
+		template <typename T, typename G, typename = std::enable_if_t<!std::is_arithmetic_v<G>>>
+		inline T u(G &generator, T min, T max)
+		{
+			std::uniform_int_distribution<T> distribution(min, max);
+			return distribution(generator);
+		}
+		/**
+		* @brief Returns a floating-point random number with uniform distribution, drawn from the given generator
+		* @tparam T A floating-point type. It must be given explicitly: \a e.g. random::U<float>(generator)
+		* @tparam G The type of the generator
+		* @param generator The random number generator, \a e.g. a stream (ref. getStream())
+		* @param min The lower boudaty of the interval
+		* @param max The upper boundary of the interval
+		* @return The random number from interval [\b min, \b max)
+		*/
+		template <typename T, typename G, typename = std::enable_if_t<!std::is_arithmetic_v<G>>>
+		inline T U(G &generator, T min = 0, T max = 1)
+		{
+			std::uniform_real_distribution<T> distribution(min, max);
+			return distribution(generator);
+		}
+		/**
+		* @brief Returns a floating-point random number with normal distribution, drawn from the given generator
+		* @tparam T A floating-point type. It must be given explicitly: \a e.g. random::N<float>(generator)
+		* @tparam G The type of the generator
+		* @param generator The random number generator, \a e.g. a stream (ref. getStream())
+		* @param mu The mean \f$\mu\f$
+		* @param sigma The standard deviation \f$\sigma\f$
+		* @return A floating point number with normal distribution
+		*/
+		template <typename T, typename G, typename = std::enable_if_t<!std::is_arithmetic_v<G>>>
+		inline T N(G &generator, T mu = 0, T sigma = 1)
+		{
+			std::normal_distribution<T> distribution(mu, sigma);
+			return distribution(generator);
+		}
 	}
 }
-
@@ -4,6 +4,7 @@
 
 #include "types.h"
 #include "macroses.h"
+#include "ModelFile.h"
 
 namespace DirectGraphicalModels
 {
@@ -14,41 +15,61 @@ namespace DirectGraphicalModels
 	*/
 	namespace Serialize
 	{
+		namespace impl {
+			const int HEADER_SIZE = 4 * sizeof(int);		// height, width, depth, channels
+
+			inline int elementSize(int depth)
+			{
+				switch (depth) {
+				case CV_8U:	 return 1;
+				case CV_8S:  return 1;
+				case CV_16U: return 2;
+				case CV_16S: return 2;
+				case CV_32S: return 4;
+				case CV_32F: return 4;
+				case CV_64F: return 8;
+				default:
+					DGM_WARNING("Custom matrix type is not supported");
+					return 0;
+				}
+			}
+
+			// Sets the position of the file with 64-bit offsets: the offsets of the large matrices do not fit into long on all platforms
+			inline bool seek(FILE *pFile, uint64_t offset)
+			{
+#ifdef _WIN32
+				return _fseeki64(pFile, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+				return fseeko(pFile, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+			}
+
+			inline void writeHeader(FILE *pFile, int height, int width, int type)
+			{
+				const int header[4] = { height, width, CV_MAT_DEPTH(type), CV_MAT_CN(type) };
+				fwrite(header, sizeof(int), 4, pFile);
+			}
+		}
+
 		/**
 		* @brief Saves matrix \b m into the file \b fileName
 		* @param fileName The full path to the destination file
 		* @param m Matrix to be saved
 		*/
-		void to(const std::string &fileName, const Mat &m)
+		inline void to(const std::string &fileName, const Mat &m)
 		{
 			FILE *pFile = fopen(fileName.c_str(), "wb");
-			// Header
-			int height = m.rows;
-			int width = m.cols;
-			int depth = m.depth();
-			int channels = m.channels();
-
-			fwrite(&height, sizeof(int), 1, pFile);
-			fwrite(&width, sizeof(int), 1, pFile);
-			fwrite(&depth, sizeof(int), 1, pFile);
-			fwrite(&channels, sizeof(int), 1, pFile);
-
-			int elementSize;
-			switch (depth) {
-			case CV_8U:	 elementSize = 1; break;
-			case CV_8S:  elementSize = 1; break;
-			case CV_16U: elementSize = 2; break;
-			case CV_16S: elementSize = 2; break;
-			case CV_32S: elementSize = 4; break;
-			case CV_32F: elementSize = 4; break;
-			case CV_64F: elementSize = 8; break;
-			default:
-				DGM_WARNING("Custom matrix type is not supported");
-				elementSize = 0;
-				break;
+			if (!pFile) {
+				DGM_WARNING("Can't create file %s", fileName.c_str());
+				return;
 			}
-
-			fwrite(m.data, elementSize, height * width * channels, pFile);
+			impl::writeHeader(pFile, m.rows, m.cols, m.type());
+			const size_t rowSize = static_cast<size_t>(m.cols) * m.channels() * impl::elementSize(m.depth());
+			if (m.isContinuous())
+				fwrite(m.data, rowSize, m.rows, pFile);
+			else
+				for (int y = 0; y < m.rows; y++)
+					fwrite(m.ptr(y), rowSize, 1, pFile);
 			fclose(pFile);
 		}
 
@@ -56,7 +77,7 @@ namespace DirectGraphicalModels
 		* @brief Loads the matrix from file \b filename
 		* @param fileName The full path to the source file
 		*/
-		Mat from(const std::string &fileName)
+		inline Mat from(const std::string &fileName)
 		{
 			FILE *pFile = fopen(fileName.c_str(), "rb");
 			if (!pFile) return Mat();
@@ -69,25 +90,110 @@ namespace DirectGraphicalModels
 			fread(&depth, sizeof(int), 1, pFile);
 			fread(&channels, sizeof(int), 1, pFile);
 
-			int elementSize;
-			switch (depth) {
-			case CV_8U:	 elementSize = 1; break;
-			case CV_8S:  elementSize = 1; break;
-			case CV_16U: elementSize = 2; break;
-			case CV_16S: elementSize = 2; break;
-			case CV_32S: elementSize = 4; break;
-			case CV_32F: elementSize = 4; break;
-			case CV_64F: elementSize = 8; break;
-			default:
-				DGM_WARNING("Custom matrix type is not supported");
-				elementSize = 0;
-				break;
-			}
-
 			Mat res(height, width, CV_MAKETYPE(depth, channels));
-			fread(res.data, elementSize, height * width * channels, pFile);
+			fread(res.data, impl::elementSize(depth), height * width * channels, pFile);
 			fclose(pFile);
 			return res;
 		}
+
+		/**
+		* @brief Maps the matrix from file \b fileName into memory
+		* @details Unlike from(), this function does not read the data: the file is mapped into memory copy-on-write, and the returned matrix refers to the mapped data.
+		* Thus, the mapping takes constant time, independently from the size of the matrix, and only the pages, which are accessed, are read from the disk.
+		* If the file can not be mapped, it is read into an aligned buffer (ref. CModelFile::loadData()).
+		* @param[in] fileName The full path to the source file, written by the to() function or by the CTileWriter class
+		* @param[out] pStorage The owner of the mapped memory. The returned matrix is valid as long as this object exists
+		* @return The matrix, referring to the mapped data, or an empty matrix if the file can not be opened or its header is not valid
+		*/
+		inline Mat map(const std::string &fileName, std::shared_ptr<const void> &pStorage)
+		{
+			size_t size = 0;
+			pStorage = CModelFile::loadData(fileName, size);
+			if (!pStorage || size < static_cast<size_t>(impl::HEADER_SIZE)) {
+				pStorage.reset();
+				return Mat();
+			}
+			
+			const int *pHeader = static_cast<const int *>(pStorage.get());
+			const int height	= pHeader[0];
+			const int width		= pHeader[1];
+			const int depth		= pHeader[2];
+			const int channels	= pHeader[3];
+			const bool isValid	= height >= 0 && width >= 0 && depth >= CV_8U && depth <= CV_64F && channels >= 1 && channels <= CV_CN_MAX
+								&& size - impl::HEADER_SIZE >= static_cast<size_t>(height) * width * channels * impl::elementSize(depth);
+			if (!isValid) {
+				DGM_WARNING("The file %s is corrupted", fileName.c_str());
+				pStorage.reset();
+				return Mat();
+			}
+			
+			byte *pData = const_cast<byte *>(static_cast<const byte *>(pStorage.get())) + impl::HEADER_SIZE;
+			return Mat(height, width, CV_MAKETYPE(depth, channels), pData);
+		}
+
+		// ================================ Tile Writer Class ==============================
+		/**
+		* @brief Streaming writer of large matrices
+		* @details This class writes a matrix into the file tile by tile, in the format of the to() function, so that the whole matrix never has to be held in memory,
+		* \a e.g. the potential maps of large images, produced block-wise. The parts of the matrix, which are not written, are filled with zeros.
+		* The file may be read with the from() or the map() functions, when the writer is destroyed.
+		* @code
+		* Serialize::CTileWriter writer("potentials.dat", imgSize, CV_32FC(nStates));
+		* for (const Rect &tile : vTiles)
+		*	writer.write(potentials(tile), tile.tl());
+		* @endcode
+		*/
+		class CTileWriter
+		{
+		public:
+			/**
+			* @brief Constructor
+			* @param fileName The full path to the destination file
+			* @param size The size of the whole matrix
+			* @param type The type of the whole matrix
+			*/
+			CTileWriter(const std::string &fileName, Size size, int type)
+				: m_pFile(fopen(fileName.c_str(), "wb"))
+				, m_size(size)
+				, m_type(type)
+				, m_pixelSize(CV_MAT_CN(type) * impl::elementSize(CV_MAT_DEPTH(type)))
+			{
+				DGM_ASSERT_MSG(m_pFile, "Can't create file %s", fileName.c_str());
+				impl::writeHeader(m_pFile, size.height, size.width, type);
+				const size_t dataSize = static_cast<size_t>(size.width) * size.height * m_pixelSize;
+				if (dataSize) {											// the file is extended to the full size: the gaps read as zeros
+					const bool res = impl::seek(m_pFile, impl::HEADER_SIZE + dataSize - 1) && fputc(0, m_pFile) != EOF;
+					DGM_ASSERT_MSG(res, "Can't extend file %s to %zu bytes", fileName.c_str(), impl::HEADER_SIZE + dataSize);
+				}
+			}
+			CTileWriter(const CTileWriter &) = delete;
+			~CTileWriter(void) { if (m_pFile) fclose(m_pFile); }
+
+			bool operator=(const CTileWriter &) = delete;
+
+			/**
+			* @brief Writes a tile of the matrix
+			* @param tile The tile: Mat(type: the type of the whole matrix)
+			* @param pos The position of the upper-left corner of the tile in the whole matrix
+			*/
+			void write(const Mat &tile, Point pos)
+			{
+				DGM_ASSERT(tile.type() == m_type);
+				DGM_ASSERT(Rect(Point(0, 0), m_size).contains(pos) && pos.x + tile.cols <= m_size.width && pos.y + tile.rows <= m_size.height);
+				const size_t rowSize = static_cast<size_t>(tile.cols) * m_pixelSize;
+				for (int y = 0; y < tile.rows; y++) {
+					const uint64_t offset = impl::HEADER_SIZE + (static_cast<uint64_t>(pos.y + y) * m_size.width + pos.x) * m_pixelSize;
+					const bool res = impl::seek(m_pFile, offset) && fwrite(tile.ptr(y), rowSize, 1, m_pFile) == 1;
+					DGM_ASSERT_MSG(res, "Can't write the tile at (%d, %d)", pos.x, pos.y);
+				}
+			}
+
+
+		private:
+			FILE	* m_pFile;					///< The destination file
+			Size	  m_size;					///< The size of the whole matrix
+			int		  m_type;					///< The type of the whole matrix
+			size_t	  m_pixelSize;				///< The size of one element of the matrix in bytes
+		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,1193 @@
+#include "simd.h"
+#include <cstring>
+
+#if !defined(ENABLE_SIMD)
+	// The scalar kernels only
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define DGM_SIMD_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#define DGM_TARGET(isa)
+	#else
+		#define DGM_TARGET(isa) __attribute__((target(isa)))
+	#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+	#define DGM_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace DirectGraphicalModels { namespace simd {
+	namespace impl {
+		using matTVecMulFunction	= float(*)(const float *, const float *, float *, byte, bool);
+		using matTVecMulHalfFunction= float(*)(const word *, const float *, float *, byte, bool);
+		using expVecFunction		= void(*)(const float *, float *, byte, float);
+		using logVecFunction		= void(*)(const float *, float *, byte);
+		using axpyFunction			= void(*)(float, const float *, float *, int);
+		using absDiffFunction		= void(*)(float, const float *, float *, int);
+		using minPlusStepFunction	= void(*)(const float *, const float *, float, float, float *, int);
+		using matTVecMulBatchFunction = void(*)(const float *, const float *, int, float *, int, byte, int, bool);
+		using argMaxFunction		= byte(*)(const float *, byte);
+		using mahalanobisFunction	= void(*)(const float *, const float *, const float *, float *, int, int);
+		using floatToHalfFunction	= void(*)(const float *, word *, int);
+		using halfToFloatFunction	= void(*)(const word *, float *, int);
+		using gemmKernelFunction	= void(*)(int, const float *, const float *, float *, int, float);
+		using dotU8S8Function		= void(*)(const byte *, const int8_t *, int, int, int, int *);
+		using gradientRowFunction	= void(*)(const byte *, const byte *, const byte *, const float *, int, float *, byte *, int);
+
+		const int GEMM_MR = 6;													// the number of rows of the micro-kernel tile
+		const int GEMM_NR = 16;													// the number of columns of the micro-kernel tile
+
+		float matTVecMul_scalar(const float *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			std::fill(dst, dst + n, 0.0f);
+			for (byte y = 0; y < n; y++) {										// row-wise traversal keeps the memory access sequential
+				const float *pM = M + y * n;
+				const float	 vy = v[y];
+				for (byte x = 0; x < n; x++) {
+					float prod = vy * pM[x];
+					if (maxSum) { if (prod > dst[x]) dst[x] = prod; }
+					else dst[x] += prod;
+				} // x
+			} // y
+
+			float res = 0;
+			for (byte x = 0; x < n; x++) res += dst[x];
+			return res;
+		}
+
+		float matTVecMulHalf_scalar(const word *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			float row[256];
+			std::fill(dst, dst + n, 0.0f);
+			for (byte y = 0; y < n; y++) {
+				halfToFloat_scalar(M + y * n, row, n);
+				const float	 vy = v[y];
+				for (byte x = 0; x < n; x++) {
+					float prod = vy * row[x];
+					if (maxSum) { if (prod > dst[x]) dst[x] = prod; }
+					else dst[x] += prod;
+				} // x
+			} // y
+
+			float res = 0;
+			for (byte x = 0; x < n; x++) res += dst[x];
+			return res;
+		}
+
+		void expVec_scalar(const float *src, float *dst, byte n, float shift)
+		{
+			for (byte i = 0; i < n; i++) dst[i] = expf(src[i] - shift);
+		}
+
+		void logVec_scalar(const float *src, float *dst, byte n)
+		{
+			for (byte i = 0; i < n; i++) dst[i] = logf(MAX(FLT_MIN, src[i]));
+		}
+
+		void axpy_scalar(float a, const float *x, float *y, int n)
+		{
+			for (int i = 0; i < n; i++) y[i] += a * x[i];
+		}
+
+		void absDiff_scalar(float a, const float *x, float *dst, int n)
+		{
+			for (int i = 0; i < n; i++) dst[i] = fabsf(a - x[i]);
+		}
+
+		// One element of minPlusStep(): mP2 is min(src) + P2
+		inline float minPlusStepElement(const float *src, const float *cost, float P1, float mP2, float m, int i, int n)
+		{
+			float res = MIN(src[i], mP2);
+			if (i > 0)		res = MIN(res, src[i - 1] + P1);
+			if (i < n - 1)	res = MIN(res, src[i + 1] + P1);
+			return cost[i] + (res - m);
+		}
+
+		void minPlusStep_scalar(const float *src, const float *cost, float P1, float P2, float *dst, int n)
+		{
+			const float m = *std::min_element(src, src + n);
+			for (int i = 0; i < n; i++) dst[i] = minPlusStepElement(src, cost, P1, m + P2, m, i, n);
+		}
+
+		// One vector of matTVecMulBatch(): the lane i of the matrices a and dst
+		inline void matTVecMulBatchLane(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int i, bool maxSum)
+		{
+			float Z = 0;
+			for (byte x = 0; x < k; x++) {
+				float acc = 0;
+				for (byte y = 0; y < k; y++) {
+					float prod = a[y * lda + i] * M[y * k + x];
+					if (maxSum) { if (prod > acc) acc = prod; }
+					else acc += prod;
+				} // y
+				dst[x * ldd + i] = acc;
+				Z += acc;
+			} // x
+			for (byte x = 0; x < k; x++)
+				dst[x * ldd + i] = Z > FLT_EPSILON ? dst[x * ldd + i] / Z : 1.0f / k;
+		}
+
+		void matTVecMulBatch_scalar(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum)
+		{
+			for (int i = 0; i < n; i++) matTVecMulBatchLane(M, a, lda, dst, ldd, k, i, maxSum);
+		}
+
+		byte argMax_scalar(const float *src, byte n)
+		{
+			return static_cast<byte>(std::max_element(src, src + n) - src);
+		}
+
+		void mahalanobis_scalar(const float *x, const float *mu, const float *W, float *dst, int k, int n)
+		{
+			for (int g = 0; g < n; g++) {
+				const float *pW  = W + g;
+				float		 res = 0;
+				for (int i = 0; i < k; i++) {
+					float y = 0;
+					for (int j = 0; j <= i; j++, pW += n) y += *pW * (x[j] - mu[j * n + g]);
+					res += y * y;
+				} // i
+				dst[g] = res;
+			} // g
+		}
+
+		// The bit manipulations follow F. Giesen, "Half to float done quick", 2012
+		void floatToHalf_scalar(const float *src, word *dst, int n)
+		{
+			const uint32_t	f16max			= (127 + 16) << 23;							// 65536.0f: the values above overflow
+			const uint32_t	f32infty		= 255 << 23;
+			const uint32_t	denormMagicBits	= ((127 - 15) + (23 - 10) + 1) << 23;
+			float			denormMagic;
+			memcpy(&denormMagic, &denormMagicBits, sizeof(float));
+
+			for (int i = 0; i < n; i++) {
+				uint32_t u;
+				memcpy(&u, src + i, sizeof(float));
+				const uint32_t sign = u & 0x80000000u;
+				u ^= sign;
+
+				word res;
+				if (u >= f16max) res = u > f32infty ? 0x7E00 : 0x7C00;						// NaN or infinity
+				else if (u < (113 << 23)) {													// subnormal value or zero
+					float f;
+					memcpy(&f, &u, sizeof(float));
+					f += denormMagic;
+					memcpy(&u, &f, sizeof(float));
+					res = static_cast<word>(u - denormMagicBits);
+				}
+				else {
+					const uint32_t mantOdd = (u >> 13) & 1;
+					u += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + mantOdd;			// exponent rebias and rounding to the nearest even
+					res = static_cast<word>(u >> 13);
+				}
+				dst[i] = res | static_cast<word>(sign >> 16);
+			} // i
+		}
+
+		void halfToFloat_scalar(const word *src, float *dst, int n)
+		{
+			const uint32_t	shiftedExp	= 0x7C00 << 13;
+			const uint32_t	magicBits	= 113 << 23;
+			float			magic;
+			memcpy(&magic, &magicBits, sizeof(float));
+
+			for (int i = 0; i < n; i++) {
+				uint32_t u = static_cast<uint32_t>(src[i] & 0x7FFF) << 13;
+				const uint32_t exp = u & shiftedExp;
+				u += (127 - 15) << 23;
+				if (exp == shiftedExp) u += (128 - 16) << 23;								// NaN or infinity
+				else if (exp == 0) {														// subnormal value or zero
+					u += 1 << 23;
+					float f;
+					memcpy(&f, &u, sizeof(float));
+					f -= magic;
+					memcpy(&u, &f, sizeof(float));
+				}
+				u |= static_cast<uint32_t>(src[i] & 0x8000) << 16;
+				memcpy(dst + i, &u, sizeof(float));
+			} // i
+		}
+
+		// C += alpha * pA x pB, where pA is a packed panel of GEMM_MR rows, and pB is a packed panel of GEMM_NR columns
+		void gemmKernel_scalar(int k, const float *pA, const float *pB, float *C, int ldc, float alpha)
+		{
+			float acc[GEMM_MR][GEMM_NR] = {};
+			for (int p = 0; p < k; p++, pA += GEMM_MR, pB += GEMM_NR)
+				for (int i = 0; i < GEMM_MR; i++)
+					for (int j = 0; j < GEMM_NR; j++)
+						acc[i][j] += pA[i] * pB[j];
+			for (int i = 0; i < GEMM_MR; i++)
+				for (int j = 0; j < GEMM_NR; j++)
+					C[i * ldc + j] += alpha * acc[i][j];
+		}
+
+		void dotU8S8_scalar(const byte *a, const int8_t *B, int ldb, int n, int k, int *dst)
+		{
+			for (int j = 0; j < n; j++) {
+				const int8_t *pB = B + static_cast<size_t>(j) * ldb;
+				int acc = 0;
+				for (int p = 0; p < k; p++) acc += a[p] * pB[p];
+				dst[j] = acc;
+			} // j
+		}
+
+		// One pixel of gradientRow(): ix is zero at the row boundaries; the vanishing ix is replaced with FLT_EPSILON of the same sign, thus the vertical gradients fall into the last bin
+		inline void gradientElement(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int x, int n)
+		{
+			float ix = x > 0 && x < n - 1 ? 0.5f * (static_cast<float>(pCur[x + 1]) - static_cast<float>(pCur[x - 1])) : 0;
+			const float iy = 0.5f * (static_cast<float>(pNext[x]) - static_cast<float>(pPrev[x]));
+			mgn[x] = sqrtf(ix * ix + iy * iy);
+			if (bin) {
+				if (fabsf(ix) < FLT_EPSILON) ix = SIGN(ix) * FLT_EPSILON;
+				const float tg = iy / ix;
+				int res = 0;
+				for (int t = 0; t < nTan; t++) res += tg > pTan[t] ? 1 : 0;
+				bin[x] = static_cast<byte>(res);
+			}
+		}
+
+		void gradientRow_scalar(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int n)
+		{
+			for (int x = 0; x < n; x++) gradientElement(pPrev, pCur, pNext, pTan, nTan, mgn, bin, x, n);
+		}
+
+#ifdef DGM_SIMD_X86
+		DGM_TARGET("avx2,fma") float matTVecMul_avx2(const float *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+			__m256 res = _mm256_setzero_ps();
+			for (int x = 0; x < n; x += 8) {
+				const int		rest	= std::min(8, n - x);
+				const __m256i	m		= _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - rest));
+				__m256			acc		= _mm256_setzero_ps();
+				if (maxSum)
+					for (int y = 0; y < n; y++)
+						acc = _mm256_max_ps(acc, _mm256_mul_ps(_mm256_set1_ps(v[y]), _mm256_maskload_ps(M + y * n + x, m)));
+				else
+					for (int y = 0; y < n; y++)
+						acc = _mm256_fmadd_ps(_mm256_set1_ps(v[y]), _mm256_maskload_ps(M + y * n + x, m), acc);
+				_mm256_maskstore_ps(dst + x, m, acc);
+				res = _mm256_add_ps(res, acc);									// masked lanes are zeros
+			} // x
+
+			// Horizontal sum
+			__m128 sum = _mm_add_ps(_mm256_castps256_ps128(res), _mm256_extractf128_ps(res, 1));
+			sum = _mm_hadd_ps(sum, sum);
+			sum = _mm_hadd_ps(sum, sum);
+			return _mm_cvtss_f32(sum);
+		}
+
+		// Polynomial approximations after the Cephes library
+		DGM_TARGET("avx2,fma") inline __m256 exp_avx2(__m256 x)
+		{
+			const __m256 underflow = _mm256_cmp_ps(x, _mm256_set1_ps(-87.0f), _CMP_LT_OQ);
+			x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(88.3762626647949f));
+
+			// x = k * ln(2) + r, |r| <= ln(2) / 2
+			const __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			x = _mm256_fnmadd_ps(k, _mm256_set1_ps(0.693359375f), x);
+			x = _mm256_fnmadd_ps(k, _mm256_set1_ps(-2.12194440e-4f), x);
+
+			__m256 y = _mm256_set1_ps(1.9875691500e-4f);
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+			y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+			y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+			// y * 2^k
+			const __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+			y = _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+			return _mm256_andnot_ps(underflow, y);
+		}
+
+		DGM_TARGET("avx2,fma") inline __m256 log_avx2(__m256 x)
+		{
+			x = _mm256_max_ps(x, _mm256_set1_ps(FLT_MIN));
+
+			// x = m * 2^e, m in [sqrt(1/2); sqrt(2))
+			const __m256i bits = _mm256_castps_si256(x);
+			__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+			__m256 m = _mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF))), _mm256_set1_ps(0.5f));
+			const __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+			e = _mm256_sub_ps(e, _mm256_and_ps(small, _mm256_set1_ps(1.0f)));
+			m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), _mm256_set1_ps(1.0f));
+
+			const __m256 z = _mm256_mul_ps(m, m);
+			__m256 y = _mm256_set1_ps(7.0376836292e-2f);
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.1514610310e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.1676998740e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.2420140846e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.4249322787e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.6668057665e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(2.0000714765e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-2.4999993993e-1f));
+			y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(3.3333331174e-1f));
+			y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+			y = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), y);
+			y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+			return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), _mm256_add_ps(m, y));
+		}
+
+		DGM_TARGET("avx2,fma") void expVec_avx2(const float *src, float *dst, byte n, float shift)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+			const __m256 s = _mm256_set1_ps(shift);
+			for (int i = 0; i < n; i += 8) {
+				const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - std::min(8, n - i)));
+				_mm256_maskstore_ps(dst + i, m, exp_avx2(_mm256_sub_ps(_mm256_maskload_ps(src + i, m), s)));
+			}
+		}
+
+		DGM_TARGET("avx2,fma") void logVec_avx2(const float *src, float *dst, byte n)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+			for (int i = 0; i < n; i += 8) {
+				const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - std::min(8, n - i)));
+				_mm256_maskstore_ps(dst + i, m, log_avx2(_mm256_maskload_ps(src + i, m)));
+			}
+		}
+
+		DGM_TARGET("avx512f") float matTVecMul_avx512(const float *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			__m512 res = _mm512_setzero_ps();
+			for (int x = 0; x < n; x += 16) {
+				const int		rest	= std::min(16, n - x);
+				const __mmask16	m		= static_cast<__mmask16>((1u << rest) - 1);
+				__m512			acc		= _mm512_setzero_ps();
+				if (maxSum)
+					for (int y = 0; y < n; y++)
+						acc = _mm512_max_ps(acc, _mm512_mul_ps(_mm512_set1_ps(v[y]), _mm512_maskz_loadu_ps(m, M + y * n + x)));
+				else
+					for (int y = 0; y < n; y++)
+						acc = _mm512_fmadd_ps(_mm512_set1_ps(v[y]), _mm512_maskz_loadu_ps(m, M + y * n + x), acc);
+				_mm512_mask_storeu_ps(dst + x, m, acc);
+				res = _mm512_add_ps(res, acc);									// masked lanes are zeros
+			} // x
+			return _mm512_reduce_add_ps(res);
+		}
+
+		// The tail is processed with the masked loads and stores
+		DGM_TARGET("avx512f") void matTVecMulBatch_avx512(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum)
+		{
+			const __m512 eps		= _mm512_set1_ps(FLT_EPSILON);
+			const __m512 uniform	= _mm512_set1_ps(1.0f / k);
+			for (int i = 0; i < n; i += 16) {
+				const __mmask16	m	= static_cast<__mmask16>((1u << std::min(16, n - i)) - 1);
+				__m512			Z	= _mm512_setzero_ps();
+				for (byte x = 0; x < k; x++) {
+					__m512 acc = _mm512_setzero_ps();
+					if (maxSum)
+						for (byte y = 0; y < k; y++)
+							acc = _mm512_max_ps(acc, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, a + y * lda + i), _mm512_set1_ps(M[y * k + x])));
+					else
+						for (byte y = 0; y < k; y++)
+							acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + y * lda + i), _mm512_set1_ps(M[y * k + x]), acc);
+					_mm512_mask_storeu_ps(dst + x * ldd + i, m, acc);
+					Z = _mm512_add_ps(Z, acc);
+				} // x
+				const __mmask16 valid = _mm512_mask_cmp_ps_mask(m, Z, eps, _CMP_GT_OQ);
+				for (byte x = 0; x < k; x++) {
+					const __m512 res = _mm512_mask_div_ps(uniform, valid, _mm512_maskz_loadu_ps(m, dst + x * ldd + i), Z);
+					_mm512_mask_storeu_ps(dst + x * ldd + i, m, res);
+				}
+			} // i
+		}
+
+		DGM_TARGET("avx2,fma") void axpy_avx2(float a, const float *x, float *y, int n)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+			const __m256 va = _mm256_set1_ps(a);
+			int i = 0;
+			for (; i + 8 <= n; i += 8)
+				_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+			if (i < n) {
+				const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - (n - i)));
+				_mm256_maskstore_ps(y + i, m, _mm256_fmadd_ps(va, _mm256_maskload_ps(x + i, m), _mm256_maskload_ps(y + i, m)));
+			}
+		}
+
+		// The sign bit is cleared with the mask
+		DGM_TARGET("avx2,fma") void absDiff_avx2(float a, const float *x, float *dst, int n)
+		{
+			const __m256 va		= _mm256_set1_ps(a);
+			const __m256 vAbs	= _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+			int i = 0;
+			for (; i + 8 <= n; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_and_ps(vAbs, _mm256_sub_ps(va, _mm256_loadu_ps(x + i))));
+			for (; i < n; i++) dst[i] = fabsf(a - x[i]);
+		}
+
+		// The neighbours src[i - 1] and src[i + 1] are read with the unaligned loads; the first and the last elements are processed separately
+		DGM_TARGET("avx2,fma") void minPlusStep_avx2(const float *src, const float *cost, float P1, float P2, float *dst, int n)
+		{
+			__m256 vMin = _mm256_set1_ps(FLT_MAX);
+			int i = 0;
+			for (; i + 8 <= n; i += 8) vMin = _mm256_min_ps(vMin, _mm256_loadu_ps(src + i));
+			float buf[8];
+			_mm256_storeu_ps(buf, vMin);
+			float m = *std::min_element(buf, buf + 8);
+			for (; i < n; i++) m = MIN(m, src[i]);
+
+			const __m256 vP1	= _mm256_set1_ps(P1);
+			const __m256 vmP2	= _mm256_set1_ps(m + P2);
+			const __m256 vm		= _mm256_set1_ps(m);
+			dst[0] = minPlusStepElement(src, cost, P1, m + P2, m, 0, n);
+			for (i = 1; i + 8 < n; i += 8) {
+				__m256 res = _mm256_min_ps(_mm256_loadu_ps(src + i), vmP2);
+				res = _mm256_min_ps(res, _mm256_add_ps(_mm256_loadu_ps(src + i - 1), vP1));
+				res = _mm256_min_ps(res, _mm256_add_ps(_mm256_loadu_ps(src + i + 1), vP1));
+				_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(cost + i), _mm256_sub_ps(res, vm)));
+			}
+			for (; i < n; i++) dst[i] = minPlusStepElement(src, cost, P1, m + P2, m, i, n);
+		}
+
+		// Every lane holds one vector; the unnormalized results are stored first and then scaled in place
+		DGM_TARGET("avx2,fma") void matTVecMulBatch_avx2(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum)
+		{
+			const __m256 eps		= _mm256_set1_ps(FLT_EPSILON);
+			const __m256 uniform	= _mm256_set1_ps(1.0f / k);
+			int i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256 Z = _mm256_setzero_ps();
+				for (byte x = 0; x < k; x++) {
+					__m256 acc = _mm256_setzero_ps();
+					if (maxSum)
+						for (byte y = 0; y < k; y++)
+							acc = _mm256_max_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + y * lda + i), _mm256_set1_ps(M[y * k + x])));
+					else
+						for (byte y = 0; y < k; y++)
+							acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + y * lda + i), _mm256_set1_ps(M[y * k + x]), acc);
+					_mm256_storeu_ps(dst + x * ldd + i, acc);
+					Z = _mm256_add_ps(Z, acc);
+				} // x
+				const __m256 valid = _mm256_cmp_ps(Z, eps, _CMP_GT_OQ);
+				for (byte x = 0; x < k; x++)
+					_mm256_storeu_ps(dst + x * ldd + i, _mm256_blendv_ps(uniform, _mm256_div_ps(_mm256_loadu_ps(dst + x * ldd + i), Z), valid));
+			} // i
+			for (; i < n; i++) matTVecMulBatchLane(M, a, lda, dst, ldd, k, i, maxSum);
+		}
+
+		// The maximum is found first, and then its first occurrence
+		DGM_TARGET("avx2,fma") byte argMax_avx2(const float *src, byte n)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+			const __m256 lowest = _mm256_set1_ps(-FLT_MAX);
+			__m256 vMax = lowest;
+			for (int i = 0; i < n; i += 8) {
+				const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - std::min(8, n - i)));
+				vMax = _mm256_max_ps(vMax, _mm256_blendv_ps(lowest, _mm256_maskload_ps(src + i, m), _mm256_castsi256_ps(m)));
+			}
+			__m128 max = _mm_max_ps(_mm256_castps256_ps128(vMax), _mm256_extractf128_ps(vMax, 1));
+			max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+			max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+			vMax = _mm256_set1_ps(_mm_cvtss_f32(max));
+
+			for (int i = 0; i < n; i += 8) {
+				const int rest	= std::min(8, n - i);
+				const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - rest));
+				const int bits	= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_maskload_ps(src + i, m), vMax, _CMP_EQ_OQ)) & ((1 << rest) - 1);
+				if (bits) for (int k = 0; k < rest; k++) if (bits & (1 << k)) return static_cast<byte>(i + k);
+			}
+			return argMax_scalar(src, n);														// NaN values
+		}
+
+		// SSE has no masked loads: the tails are processed with the scalar code, as for NEON
+		DGM_TARGET("sse4.2") float matTVecMul_sse42(const float *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			const int n4 = n & ~3;
+			__m128 res = _mm_setzero_ps();
+			for (int x = 0; x < n4; x += 4) {
+				__m128 acc = _mm_setzero_ps();
+				if (maxSum)
+					for (int y = 0; y < n; y++)
+						acc = _mm_max_ps(acc, _mm_mul_ps(_mm_set1_ps(v[y]), _mm_loadu_ps(M + y * n + x)));
+				else
+					for (int y = 0; y < n; y++)
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(v[y]), _mm_loadu_ps(M + y * n + x)));
+				_mm_storeu_ps(dst + x, acc);
+				res = _mm_add_ps(res, acc);
+			} // x
+			res = _mm_hadd_ps(res, res);
+			res = _mm_hadd_ps(res, res);
+			float sum = _mm_cvtss_f32(res);
+
+			for (int x = n4; x < n; x++) {
+				float acc = 0;
+				for (int y = 0; y < n; y++) {
+					float prod = v[y] * M[y * n + x];
+					if (maxSum) { if (prod > acc) acc = prod; }
+					else acc += prod;
+				} // y
+				dst[x] = acc;
+				sum += acc;
+			} // x
+			return sum;
+		}
+
+		DGM_TARGET("sse4.2") void axpy_sse42(float a, const float *x, float *y, int n)
+		{
+			const __m128 va = _mm_set1_ps(a);
+			int i = 0;
+			for (; i + 4 <= n; i += 4)
+				_mm_storeu_ps(y + i, _mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(x + i)), _mm_loadu_ps(y + i)));
+			for (; i < n; i++) y[i] += a * x[i];
+		}
+
+		DGM_TARGET("sse4.2") void absDiff_sse42(float a, const float *x, float *dst, int n)
+		{
+			const __m128 va		= _mm_set1_ps(a);
+			const __m128 vAbs	= _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			int i = 0;
+			for (; i + 4 <= n; i += 4)
+				_mm_storeu_ps(dst + i, _mm_and_ps(vAbs, _mm_sub_ps(va, _mm_loadu_ps(x + i))));
+			for (; i < n; i++) dst[i] = fabsf(a - x[i]);
+		}
+
+		DGM_TARGET("sse4.2") void minPlusStep_sse42(const float *src, const float *cost, float P1, float P2, float *dst, int n)
+		{
+			__m128 vMin = _mm_set1_ps(FLT_MAX);
+			int i = 0;
+			for (; i + 4 <= n; i += 4) vMin = _mm_min_ps(vMin, _mm_loadu_ps(src + i));
+			float buf[4];
+			_mm_storeu_ps(buf, vMin);
+			float m = *std::min_element(buf, buf + 4);
+			for (; i < n; i++) m = MIN(m, src[i]);
+
+			const __m128 vP1	= _mm_set1_ps(P1);
+			const __m128 vmP2	= _mm_set1_ps(m + P2);
+			const __m128 vm		= _mm_set1_ps(m);
+			dst[0] = minPlusStepElement(src, cost, P1, m + P2, m, 0, n);
+			for (i = 1; i + 4 < n; i += 4) {
+				__m128 res = _mm_min_ps(_mm_loadu_ps(src + i), vmP2);
+				res = _mm_min_ps(res, _mm_add_ps(_mm_loadu_ps(src + i - 1), vP1));
+				res = _mm_min_ps(res, _mm_add_ps(_mm_loadu_ps(src + i + 1), vP1));
+				_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(cost + i), _mm_sub_ps(res, vm)));
+			}
+			for (; i < n; i++) dst[i] = minPlusStepElement(src, cost, P1, m + P2, m, i, n);
+		}
+
+		DGM_TARGET("sse4.2") void matTVecMulBatch_sse42(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum)
+		{
+			const __m128 eps		= _mm_set1_ps(FLT_EPSILON);
+			const __m128 uniform	= _mm_set1_ps(1.0f / k);
+			int i = 0;
+			for (; i + 4 <= n; i += 4) {
+				__m128 Z = _mm_setzero_ps();
+				for (byte x = 0; x < k; x++) {
+					__m128 acc = _mm_setzero_ps();
+					if (maxSum)
+						for (byte y = 0; y < k; y++)
+							acc = _mm_max_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + y * lda + i), _mm_set1_ps(M[y * k + x])));
+					else
+						for (byte y = 0; y < k; y++)
+							acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + y * lda + i), _mm_set1_ps(M[y * k + x])));
+					_mm_storeu_ps(dst + x * ldd + i, acc);
+					Z = _mm_add_ps(Z, acc);
+				} // x
+				const __m128 valid = _mm_cmpgt_ps(Z, eps);
+				for (byte x = 0; x < k; x++)
+					_mm_storeu_ps(dst + x * ldd + i, _mm_blendv_ps(uniform, _mm_div_ps(_mm_loadu_ps(dst + x * ldd + i), Z), valid));
+			} // i
+			for (; i < n; i++) matTVecMulBatchLane(M, a, lda, dst, ldd, k, i, maxSum);
+		}
+
+		DGM_TARGET("sse4.2") byte argMax_sse42(const float *src, byte n)
+		{
+			const int n4 = n & ~3;
+			if (n4 == 0) return argMax_scalar(src, n);
+			__m128 vMax = _mm_loadu_ps(src);
+			for (int i = 4; i < n4; i += 4) vMax = _mm_max_ps(vMax, _mm_loadu_ps(src + i));
+			vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(1, 0, 3, 2)));
+			vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(2, 3, 0, 1)));
+			float max = _mm_cvtss_f32(vMax);
+			for (int i = n4; i < n; i++) if (src[i] > max) max = src[i];
+
+			vMax = _mm_set1_ps(max);
+			for (int i = 0; i < n4; i += 4) {
+				const int bits = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(src + i), vMax));
+				if (bits) for (int k = 0; k < 4; k++) if (bits & (1 << k)) return static_cast<byte>(i + k);
+			}
+			for (int i = n4; i < n; i++) if (src[i] == max) return static_cast<byte>(i);
+			return argMax_scalar(src, n);														// NaN values
+		}
+
+		DGM_TARGET("avx2,fma") void mahalanobis_avx2(const float *x, const float *mu, const float *W, float *dst, int k, int n)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+			for (int g = 0; g < n; g += 8) {											// 8 Gaussians at once
+				const __m256i	m	= _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - std::min(8, n - g)));
+				const float	  * pW	= W + g;
+				__m256			res = _mm256_setzero_ps();
+				for (int i = 0; i < k; i++) {
+					__m256 y = _mm256_setzero_ps();
+					for (int j = 0; j <= i; j++, pW += n) {
+						const __m256 d = _mm256_sub_ps(_mm256_set1_ps(x[j]), _mm256_maskload_ps(mu + j * n + g, m));
+						y = _mm256_fmadd_ps(_mm256_maskload_ps(pW, m), d, y);
+					} // j
+					res = _mm256_fmadd_ps(y, y, res);
+				} // i
+				_mm256_maskstore_ps(dst + g, m, res);
+			} // g
+		}
+
+		DGM_TARGET("avx2,f16c") void floatToHalf_f16c(const float *src, word *dst, int n)
+		{
+			int i = 0;
+			for (; i + 8 <= n; i += 8)
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+			floatToHalf_scalar(src + i, dst + i, n - i);
+		}
+
+		// The tails of the rows are copied into a zero-padded buffer, since there is no masked load of 16-bit elements in AVX2
+		DGM_TARGET("avx2,fma,f16c") float matTVecMulHalf_f16c(const word *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			static const int mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+			__m256 res = _mm256_setzero_ps();
+			for (int x = 0; x < n; x += 8) {
+				const int		rest	= std::min(8, n - x);
+				const __m256i	m		= _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + 8 - rest));
+				__m256			acc		= _mm256_setzero_ps();
+				for (int y = 0; y < n; y++) {
+					const word *pM = M + y * n + x;
+					__m128i h;
+					if (rest == 8) h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pM));
+					else {
+						word buf[8] = { 0 };
+						std::copy(pM, pM + rest, buf);
+						h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf));
+					}
+					const __m256 row = _mm256_cvtph_ps(h);
+					acc = maxSum ? _mm256_max_ps(acc, _mm256_mul_ps(_mm256_set1_ps(v[y]), row)) : _mm256_fmadd_ps(_mm256_set1_ps(v[y]), row, acc);
+				} // y
+				_mm256_maskstore_ps(dst + x, m, acc);
+				res = _mm256_add_ps(res, acc);									// padded lanes are zeros
+			} // x
+
+			// Horizontal sum
+			__m128 sum = _mm_add_ps(_mm256_castps256_ps128(res), _mm256_extractf128_ps(res, 1));
+			sum = _mm_hadd_ps(sum, sum);
+			sum = _mm_hadd_ps(sum, sum);
+			return _mm_cvtss_f32(sum);
+		}
+
+		DGM_TARGET("avx2,f16c") void halfToFloat_f16c(const word *src, float *dst, int n)
+		{
+			int i = 0;
+			for (; i + 8 <= n; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))));
+			halfToFloat_scalar(src + i, dst + i, n - i);
+		}
+
+		// The tile of 6 x 16 elements is accumulated in 12 registers
+		DGM_TARGET("avx2,fma") void gemmKernel_avx2(int k, const float *pA, const float *pB, float *C, int ldc, float alpha)
+		{
+			__m256 acc[GEMM_MR][2];
+			for (int i = 0; i < GEMM_MR; i++) acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+			for (int p = 0; p < k; p++, pA += GEMM_MR, pB += GEMM_NR) {
+				const __m256 b0 = _mm256_loadu_ps(pB);
+				const __m256 b1 = _mm256_loadu_ps(pB + 8);
+				for (int i = 0; i < GEMM_MR; i++) {
+					const __m256 a = _mm256_broadcast_ss(pA + i);
+					acc[i][0] = _mm256_fmadd_ps(a, b0, acc[i][0]);
+					acc[i][1] = _mm256_fmadd_ps(a, b1, acc[i][1]);
+				}
+			} // p
+			const __m256 va = _mm256_set1_ps(alpha);
+			for (int i = 0; i < GEMM_MR; i++) {
+				float *pC = C + i * ldc;
+				_mm256_storeu_ps(pC,     _mm256_fmadd_ps(va, acc[i][0], _mm256_loadu_ps(pC)));
+				_mm256_storeu_ps(pC + 8, _mm256_fmadd_ps(va, acc[i][1], _mm256_loadu_ps(pC + 8)));
+			}
+		}
+
+		DGM_TARGET("avx2") inline int hsum_avx2(__m256i v)
+		{
+			__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+			sum = _mm_hadd_epi32(sum, sum);
+			sum = _mm_hadd_epi32(sum, sum);
+			return _mm_cvtsi128_si32(sum);
+		}
+
+		// The products of 16 pairs are accumulated by vpmaddwd in 8 lanes of 32 bits: the 16-bit operands allow for no saturation
+		DGM_TARGET("avx2") void dotU8S8_avx2(const byte *a, const int8_t *B, int ldb, int n, int k, int *dst)
+		{
+			const int k16 = k & ~15;
+			int j = 0;
+			for (; j + 4 <= n; j += 4) {
+				const int8_t *pB[4] = { B + static_cast<size_t>(j) * ldb, B + static_cast<size_t>(j + 1) * ldb, B + static_cast<size_t>(j + 2) * ldb, B + static_cast<size_t>(j + 3) * ldb };
+				__m256i acc[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+				for (int p = 0; p < k16; p += 16) {
+					const __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + p)));
+					for (int r = 0; r < 4; r++)
+						acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(va, _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pB[r] + p)))));
+				} // p
+				for (int r = 0; r < 4; r++) {
+					int res = hsum_avx2(acc[r]);
+					for (int p = k16; p < k; p++) res += a[p] * pB[r][p];
+					dst[j + r] = res;
+				}
+			} // j
+			dotU8S8_scalar(a, B + static_cast<size_t>(j) * ldb, ldb, n - j, k, dst + j);
+		}
+
+		// The products of 64 pairs are accumulated by vpdpbusd in 16 lanes of 32 bits; the tails are loaded with masks
+		DGM_TARGET("avx512f,avx512bw,avx512vnni") void dotU8S8_vnni(const byte *a, const int8_t *B, int ldb, int n, int k, int *dst)
+		{
+			const int		k64		= k & ~63;
+			const __mmask64	tail	= k - k64 ? ~0ULL >> (64 - (k - k64)) : 0;
+			int j = 0;
+			for (; j + 4 <= n; j += 4) {
+				const int8_t *pB[4] = { B + static_cast<size_t>(j) * ldb, B + static_cast<size_t>(j + 1) * ldb, B + static_cast<size_t>(j + 2) * ldb, B + static_cast<size_t>(j + 3) * ldb };
+				__m512i acc[4] = { _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512() };
+				for (int p = 0; p < k64; p += 64) {
+					const __m512i va = _mm512_loadu_si512(a + p);
+					for (int r = 0; r < 4; r++) acc[r] = _mm512_dpbusd_epi32(acc[r], va, _mm512_loadu_si512(pB[r] + p));
+				} // p
+				if (tail) {
+					const __m512i va = _mm512_maskz_loadu_epi8(tail, a + k64);
+					for (int r = 0; r < 4; r++) acc[r] = _mm512_dpbusd_epi32(acc[r], va, _mm512_maskz_loadu_epi8(tail, pB[r] + k64));
+				}
+				for (int r = 0; r < 4; r++) dst[j + r] = _mm512_reduce_add_epi32(acc[r]);
+			} // j
+			for (; j < n; j++) {
+				const int8_t *pB = B + static_cast<size_t>(j) * ldb;
+				__m512i acc = _mm512_setzero_si512();
+				for (int p = 0; p < k64; p += 64) acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(a + p), _mm512_loadu_si512(pB + p));
+				if (tail) acc = _mm512_dpbusd_epi32(acc, _mm512_maskz_loadu_epi8(tail, a + k64), _mm512_maskz_loadu_epi8(tail, pB + k64));
+				dst[j] = _mm512_reduce_add_epi32(acc);
+			} // j
+		}
+
+		DGM_TARGET("avx2,fma") inline __m256 loadU8_avx2(const byte *p)
+		{
+			return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+		}
+
+		// 8 pixels per iteration: the bytes are widened to 32-bit floats; the bin is the number of the thresholds below tg, accumulated from the comparison masks
+		DGM_TARGET("avx2,fma") void gradientRow_avx2(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int n)
+		{
+			const __m256 vHalf	= _mm256_set1_ps(0.5f);
+			const __m256 vAbs	= _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+			const __m256 vEps	= _mm256_set1_ps(FLT_EPSILON);
+			const __m256 vmEps	= _mm256_set1_ps(-FLT_EPSILON);
+			const __m256 vZero	= _mm256_setzero_ps();
+			if (n > 0) gradientElement(pPrev, pCur, pNext, pTan, nTan, mgn, bin, 0, n);
+			int x = 1;
+			for (; x + 9 <= n; x += 8) {
+				__m256		 ix		= _mm256_mul_ps(vHalf, _mm256_sub_ps(loadU8_avx2(pCur + x + 1), loadU8_avx2(pCur + x - 1)));
+				const __m256 iy		= _mm256_mul_ps(vHalf, _mm256_sub_ps(loadU8_avx2(pNext + x), loadU8_avx2(pPrev + x)));
+				_mm256_storeu_ps(mgn + x, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ix, ix), _mm256_mul_ps(iy, iy))));
+				if (!bin) continue;
+				const __m256 small	= _mm256_cmp_ps(_mm256_and_ps(ix, vAbs), vEps, _CMP_LT_OQ);
+				ix = _mm256_blendv_ps(ix, _mm256_blendv_ps(vmEps, vEps, _mm256_cmp_ps(ix, vZero, _CMP_GE_OQ)), small);
+				const __m256 tg		= _mm256_div_ps(iy, ix);
+				__m256i		 cnt	= _mm256_setzero_si256();
+				for (int t = 0; t < nTan; t++)
+					cnt = _mm256_sub_epi32(cnt, _mm256_castps_si256(_mm256_cmp_ps(tg, _mm256_set1_ps(pTan[t]), _CMP_GT_OQ)));
+				const __m128i cnt16 = _mm_packs_epi32(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(bin + x), _mm_packus_epi16(cnt16, cnt16));
+			}
+			for (; x < n; x++) gradientElement(pPrev, pCur, pNext, pTan, nTan, mgn, bin, x, n);
+		}
+
+		DGM_TARGET("sse4.2") inline __m128 loadU8_sse42(const byte *p)
+		{
+			int32_t v;
+			memcpy(&v, p, 4);
+			return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v)));
+		}
+
+		DGM_TARGET("sse4.2") void gradientRow_sse42(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int n)
+		{
+			const __m128 vHalf	= _mm_set1_ps(0.5f);
+			const __m128 vAbs	= _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			const __m128 vEps	= _mm_set1_ps(FLT_EPSILON);
+			const __m128 vmEps	= _mm_set1_ps(-FLT_EPSILON);
+			const __m128 vZero	= _mm_setzero_ps();
+			if (n > 0) gradientElement(pPrev, pCur, pNext, pTan, nTan, mgn, bin, 0, n);
+			int x = 1;
+			for (; x + 5 <= n; x += 4) {
+				__m128		 ix		= _mm_mul_ps(vHalf, _mm_sub_ps(loadU8_sse42(pCur + x + 1), loadU8_sse42(pCur + x - 1)));
+				const __m128 iy		= _mm_mul_ps(vHalf, _mm_sub_ps(loadU8_sse42(pNext + x), loadU8_sse42(pPrev + x)));
+				_mm_storeu_ps(mgn + x, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ix, ix), _mm_mul_ps(iy, iy))));
+				if (!bin) continue;
+				const __m128 small	= _mm_cmplt_ps(_mm_and_ps(ix, vAbs), vEps);
+				ix = _mm_blendv_ps(ix, _mm_blendv_ps(vmEps, vEps, _mm_cmpge_ps(ix, vZero)), small);
+				const __m128 tg		= _mm_div_ps(iy, ix);
+				__m128i		 cnt	= _mm_setzero_si128();
+				for (int t = 0; t < nTan; t++) cnt = _mm_sub_epi32(cnt, _mm_castps_si128(_mm_cmpgt_ps(tg, _mm_set1_ps(pTan[t]))));
+				const __m128i cnt16 = _mm_packs_epi32(cnt, cnt);
+				const int32_t res	= _mm_cvtsi128_si32(_mm_packus_epi16(cnt16, cnt16));
+				memcpy(bin + x, &res, 4);
+			}
+			for (; x < n; x++) gradientElement(pPrev, pCur, pNext, pTan, nTan, mgn, bin, x, n);
+		}
+#endif
+
+#ifdef DGM_SIMD_NEON
+		// NEON has no masked loads: the tail is processed with the scalar code
+		float matTVecMul_neon(const float *M, const float *v, float *dst, byte n, bool maxSum)
+		{
+			const int n4 = n & ~3;
+			float32x4_t res = vdupq_n_f32(0);
+			for (int x = 0; x < n4; x += 4) {
+				float32x4_t acc = vdupq_n_f32(0);
+				if (maxSum)
+					for (int y = 0; y < n; y++)
+						acc = vmaxq_f32(acc, vmulq_n_f32(vld1q_f32(M + y * n + x), v[y]));
+				else
+					for (int y = 0; y < n; y++)
+						acc = vmlaq_n_f32(acc, vld1q_f32(M + y * n + x), v[y]);
+				vst1q_f32(dst + x, acc);
+				res = vaddq_f32(res, acc);
+			} // x
+			float32x2_t sum2 = vadd_f32(vget_low_f32(res), vget_high_f32(res));
+			float sum = vget_lane_f32(vpadd_f32(sum2, sum2), 0);
+
+			for (int x = n4; x < n; x++) {
+				float acc = 0;
+				for (int y = 0; y < n; y++) {
+					float prod = v[y] * M[y * n + x];
+					if (maxSum) { if (prod > acc) acc = prod; }
+					else acc += prod;
+				} // y
+				dst[x] = acc;
+				sum += acc;
+			} // x
+			return sum;
+		}
+#endif
+
+		ISA detectISA(void)
+		{
+			ISA res = ISA::scalar;
+#if defined(DGM_SIMD_X86)
+			if (checkHardwareSupport(CV_CPU_AVX_512F)) res = ISA::avx512;
+			else if (checkHardwareSupport(CV_CPU_AVX2) && checkHardwareSupport(CV_CPU_FMA3)) res = ISA::avx2;
+			else if (checkHardwareSupport(CV_CPU_SSE4_2)) res = ISA::sse42;
+#elif defined(DGM_SIMD_NEON)
+			res = ISA::neon;
+#endif
+			// The instruction set may be lowered with the environment variable, e.g. for the reproducibility across the machines of a cluster
+			const char *env = getenv("DGM_ISA");
+			if (env)
+				for (ISA isa : { ISA::scalar, ISA::neon, ISA::sse42, ISA::avx2, ISA::avx512 })
+					if (strcmp(env, getISAName(isa)) == 0 && isa < res) res = isa;
+			return res;
+		}
+
+		matTVecMulFunction getMatTVecMul(ISA isa)
+		{
+			switch (isa) {
+#if defined(DGM_SIMD_X86)
+				case ISA::avx512:	return matTVecMul_avx512;
+				case ISA::avx2:		return matTVecMul_avx2;
+				case ISA::sse42:	return matTVecMul_sse42;
+#elif defined(DGM_SIMD_NEON)
+				case ISA::neon:		return matTVecMul_neon;
+#endif
+				default:			return matTVecMul_scalar;
+			}
+		}
+
+		// The AVX-512 CPUs use the AVX2 kernels; NEON CPUs use the scalar kernels
+		expVecFunction getExpVec(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return expVec_avx2;
+#endif
+			return expVec_scalar;
+		}
+
+		logVecFunction getLogVec(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return logVec_avx2;
+#endif
+			return logVec_scalar;
+		}
+
+		axpyFunction getAxpy(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return axpy_avx2;
+			if (isa == ISA::sse42) return axpy_sse42;
+#endif
+			return axpy_scalar;
+		}
+
+		absDiffFunction getAbsDiff(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return absDiff_avx2;
+			if (isa == ISA::sse42) return absDiff_sse42;
+#endif
+			return absDiff_scalar;
+		}
+
+		minPlusStepFunction getMinPlusStep(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return minPlusStep_avx2;
+			if (isa == ISA::sse42) return minPlusStep_sse42;
+#endif
+			return minPlusStep_scalar;
+		}
+
+		matTVecMulBatchFunction getMatTVecMulBatch(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512) return matTVecMulBatch_avx512;
+			if (isa == ISA::avx2) return matTVecMulBatch_avx2;
+			if (isa == ISA::sse42) return matTVecMulBatch_sse42;
+#endif
+			return matTVecMulBatch_scalar;
+		}
+
+		argMaxFunction getArgMax(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return argMax_avx2;
+			if (isa == ISA::sse42) return argMax_sse42;
+#endif
+			return argMax_scalar;
+		}
+
+		mahalanobisFunction getMahalanobis(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return mahalanobis_avx2;
+#endif
+			return mahalanobis_scalar;
+		}
+
+		// The F16C conversion instructions are available on all the CPUs with AVX2, but have their own CPUID flag
+		floatToHalfFunction getFloatToHalf(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if ((isa == ISA::avx512 || isa == ISA::avx2) && checkHardwareSupport(CV_CPU_FP16)) return floatToHalf_f16c;
+#endif
+			return floatToHalf_scalar;
+		}
+
+		matTVecMulHalfFunction getMatTVecMulHalf(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if ((isa == ISA::avx512 || isa == ISA::avx2) && checkHardwareSupport(CV_CPU_FP16)) return matTVecMulHalf_f16c;
+#endif
+			return matTVecMulHalf_scalar;
+		}
+
+		halfToFloatFunction getHalfToFloat(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if ((isa == ISA::avx512 || isa == ISA::avx2) && checkHardwareSupport(CV_CPU_FP16)) return halfToFloat_f16c;
+#endif
+			return halfToFloat_scalar;
+		}
+		// VNNI has its own CPUID flag; NEON CPUs use the scalar kernel
+		dotU8S8Function getDotU8S8(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+#ifdef CV_CPU_AVX_512VNNI
+			if (isa == ISA::avx512 && checkHardwareSupport(CV_CPU_AVX_512BW) && checkHardwareSupport(CV_CPU_AVX_512VNNI)) return dotU8S8_vnni;
+#endif
+			if (isa == ISA::avx512 || isa == ISA::avx2) return dotU8S8_avx2;
+#endif
+			return dotU8S8_scalar;
+		}
+
+		gradientRowFunction getGradientRow(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return gradientRow_avx2;
+			if (isa == ISA::sse42) return gradientRow_sse42;
+#endif
+			return gradientRow_scalar;
+		}
+
+		gemmKernelFunction getGemmKernel(ISA isa)
+		{
+#if defined(DGM_SIMD_X86)
+			if (isa == ISA::avx512 || isa == ISA::avx2) return gemmKernel_avx2;
+#endif
+			return gemmKernel_scalar;
+		}
+	}
+
+	ISA getISA(void)
+	{
+		static const ISA isa = impl::detectISA();
+		return isa;
+	}
+
+	const char * getISAName(ISA isa)
+	{
+		switch (isa) {
+			case ISA::neon:		return "neon";
+			case ISA::sse42:	return "sse42";
+			case ISA::avx2:		return "avx2";
+			case ISA::avx512:	return "avx512";
+			default:			return "scalar";
+		}
+	}
+
+	float matTVecMul(const float *M, const float *v, float *dst, byte n, bool maxSum)
+	{
+		static const impl::matTVecMulFunction kernel = impl::getMatTVecMul(getISA());
+		return kernel(M, v, dst, n, maxSum);
+	}
+
+	float matTVecMulHalf(const word *M, const float *v, float *dst, byte n, bool maxSum)
+	{
+		static const impl::matTVecMulHalfFunction kernel = impl::getMatTVecMulHalf(getISA());
+		return kernel(M, v, dst, n, maxSum);
+	}
+
+	void expVec(const float *src, float *dst, byte n, float shift)
+	{
+		static const impl::expVecFunction kernel = impl::getExpVec(getISA());
+		kernel(src, dst, n, shift);
+	}
+
+	void logVec(const float *src, float *dst, byte n)
+	{
+		static const impl::logVecFunction kernel = impl::getLogVec(getISA());
+		kernel(src, dst, n);
+	}
+
+	void axpy(float a, const float *x, float *y, int n)
+	{
+		static const impl::axpyFunction kernel = impl::getAxpy(getISA());
+		kernel(a, x, y, n);
+	}
+
+	void absDiff(float a, const float *x, float *dst, int n)
+	{
+		static const impl::absDiffFunction kernel = impl::getAbsDiff(getISA());
+		kernel(a, x, dst, n);
+	}
+
+	void minPlusStep(const float *src, const float *cost, float P1, float P2, float *dst, int n)
+	{
+		static const impl::minPlusStepFunction kernel = impl::getMinPlusStep(getISA());
+		kernel(src, cost, P1, P2, dst, n);
+	}
+
+	void matTVecMulBatch(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum)
+	{
+		static const impl::matTVecMulBatchFunction kernel = impl::getMatTVecMulBatch(getISA());
+		kernel(M, a, lda, dst, ldd, k, n, maxSum);
+	}
+
+	byte argMax(const float *src, byte n)
+	{
+		static const impl::argMaxFunction kernel = impl::getArgMax(getISA());
+		return kernel(src, n);
+	}
+
+	void mahalanobis(const float *x, const float *mu, const float *W, float *dst, int k, int n)
+	{
+		static const impl::mahalanobisFunction kernel = impl::getMahalanobis(getISA());
+		kernel(x, mu, W, dst, k, n);
+	}
+
+	void floatToHalf(const float *src, word *dst, int n)
+	{
+		static const impl::floatToHalfFunction kernel = impl::getFloatToHalf(getISA());
+		kernel(src, dst, n);
+	}
+
+	void halfToFloat(const word *src, float *dst, int n)
+	{
+		static const impl::halfToFloatFunction kernel = impl::getHalfToFloat(getISA());
+		kernel(src, dst, n);
+	}
+
+	// The loops follow the GotoBLAS scheme: panels of B (KC x NC) and A (MC x KC) are packed once and traversed by the micro-kernel tiles
+	void sgemm(int m, int n, int k, float alpha, const float *A, int lda, const float *B, int ldb, float beta, float *C, int ldc)
+	{
+		static const impl::gemmKernelFunction kernel = impl::getGemmKernel(getISA());
+		const int MR = impl::GEMM_MR;
+		const int NR = impl::GEMM_NR;
+		const int KC = 256;														// the panels of A fit into L2 cache, the slivers of B - into L1 cache
+		const int MC = 16 * MR;
+		const int NC = 128 * NR;
+
+		for (int y = 0; y < m; y++) {
+			float *pC = C + static_cast<size_t>(y) * ldc;
+			if (beta == 0)			std::fill(pC, pC + n, 0.0f);
+			else if (beta != 1)		for (int x = 0; x < n; x++) pC[x] *= beta;
+		}
+		if (k == 0 || alpha == 0) return;
+
+		thread_local std::vector<float> vPackA, vPackB;
+		vPackA.resize(static_cast<size_t>(MC) * KC);
+		vPackB.resize(static_cast<size_t>(KC) * NC);
+		float tile[MR * NR];
+
+		for (int jc = 0; jc < n; jc += NC) {
+			const int nc = std::min(NC, n - jc);
+			for (int pc = 0; pc < k; pc += KC) {
+				const int kc = std::min(KC, k - pc);
+
+				// Packing B: the slivers of NR columns, padded with zeros
+				for (int j = 0; j < nc; j += NR) {
+					const int nr = std::min(NR, nc - j);
+					float *pB = vPackB.data() + static_cast<size_t>(j) * kc;
+					for (int p = 0; p < kc; p++, pB += NR) {
+						const float *src = B + static_cast<size_t>(pc + p) * ldb + jc + j;
+						std::copy(src, src + nr, pB);
+						std::fill(pB + nr, pB + NR, 0.0f);
+					}
+				} // j
+
+				for (int ic = 0; ic < m; ic += MC) {
+					const int mc = std::min(MC, m - ic);
+
+					// Packing A: the slivers of MR rows, padded with zeros
+					for (int i = 0; i < mc; i += MR) {
+						const int mr = std::min(MR, mc - i);
+						float *pA = vPackA.data() + static_cast<size_t>(i) * kc;
+						for (int r = 0; r < MR; r++) {
+							const float *src = r < mr ? A + static_cast<size_t>(ic + i + r) * lda + pc : NULL;
+							for (int p = 0; p < kc; p++) pA[p * MR + r] = src ? src[p] : 0.0f;
+						}
+					} // i
+
+					// Micro-kernel tiles; the incomplete border tiles are accumulated in a temporary tile
+					for (int j = 0; j < nc; j += NR) {
+						const int nr = std::min(NR, nc - j);
+						for (int i = 0; i < mc; i += MR) {
+							const int	mr = std::min(MR, mc - i);
+							float	  * pC = C + static_cast<size_t>(ic + i) * ldc + jc + j;
+							if (mr == MR && nr == NR) kernel(kc, vPackA.data() + static_cast<size_t>(i) * kc, vPackB.data() + static_cast<size_t>(j) * kc, pC, ldc, alpha);
+							else {
+								std::fill(tile, tile + MR * NR, 0.0f);
+								kernel(kc, vPackA.data() + static_cast<size_t>(i) * kc, vPackB.data() + static_cast<size_t>(j) * kc, tile, NR, alpha);
+								for (int r = 0; r < mr; r++)
+									for (int c = 0; c < nr; c++) pC[static_cast<size_t>(r) * ldc + c] += tile[r * NR + c];
+							}
+						} // i
+					} // j
+				} // ic
+			} // pc
+		} // jc
+	}
+
+	void dotU8S8(const byte *a, const int8_t *B, int ldb, int n, int k, int *dst)
+	{
+		static const impl::dotU8S8Function kernel = impl::getDotU8S8(getISA());
+		kernel(a, B, ldb, n, k, dst);
+	}
+
+	void gradientRow(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int n)
+	{
+		static const impl::gradientRowFunction kernel = impl::getGradientRow(getISA());
+		kernel(pPrev, pCur, pNext, pTan, nTan, mgn, bin, n);
+	}
+} }
@@ -0,0 +1,230 @@
+// Vectorized kernels with the run-time instruction set dispatching
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels { namespace simd {
+	/// Instruction sets
+	enum class ISA : byte {
+		scalar,		///< No vector instructions
+		neon,		///< ARM NEON
+		sse42,		///< x86 SSE4.2
+		avx2,		///< x86 AVX2 with FMA3
+		avx512		///< x86 AVX-512F
+	};
+
+	/**
+	* @brief Returns the instruction set used by the kernels
+	* @details The instruction set is detected once at run-time, using the OpenCV hardware support check. Every kernel is compiled for all the instruction sets
+	* of the target architecture with the function-level target attributes, thus the library needs no \a -march flags and one binary runs on all the CPUs.
+	* The vectorized kernels are disabled with the \b ENABLE_SIMD CMake option. The detected instruction set may be lowered with the \b DGM_ISA environment
+	* variable, set to one of the names, returned by getISAName(), \a e.g. \b DGM_ISA=sse42.
+	* @return The best instruction set, supported by the CPU and by the compiler
+	*/
+	DllExport ISA	getISA(void);
+	/**
+	* @brief Returns the name of the instruction set
+	* @param isa The instruction set
+	* @return The lower-case name: \a scalar, \a neon, \a sse42, \a avx2 or \a avx512
+	*/
+	DllExport const char *	getISAName(ISA isa);
+
+	/**
+	* @brief Transposed matrix - vector multiplication
+	* @details This function calculates \f$\vec{dst} = M^\top\times\vec{v}\f$, or the same product, where the summation is replaced by maximization.
+	* The kernel is selected at run-time (ref. getISA()); arbitrary sizes \b n are supported: the tails, which do not fill a vector register, are processed
+	* with masked loads and stores.
+	* @param[in] M Row-major square matrix of size \b n x \b n
+	* @param[in] v Vector of length \b n
+	* @param[out] dst Resulting vector of length \b n
+	* @param[in] n The size of the matrix
+	* @param[in] maxSum Flag indicating weather the \a max-sum multiplication should be performed
+	* @return The sum of all elemts in vector \b dst
+	*/
+	DllExport float	matTVecMul(const float *M, const float *v, float *dst, byte n, bool maxSum = false);
+	/**
+	* @brief Transposed half precision matrix - vector multiplication
+	* @details This function calculates the same product as matTVecMul(), but the matrix is stored in the IEEE 754 half precision (ref. floatToHalf()).
+	* The elements of the matrix are widened to the single precision on load, thus all the computations are performed in the single precision.
+	* @param[in] M Row-major square matrix of size \b n x \b n with the bit patterns of the half precision values
+	* @param[in] v Vector of length \b n
+	* @param[out] dst Resulting vector of length \b n
+	* @param[in] n The size of the matrix
+	* @param[in] maxSum Flag indicating weather the \a max-sum multiplication should be performed
+	* @return The sum of all elemts in vector \b dst
+	*/
+	DllExport float	matTVecMulHalf(const word *M, const float *v, float *dst, byte n, bool maxSum = false);
+
+	/**
+	* @brief Vector exponent
+	* @details This function calculates \f$dst_i = e^{src_i - shift}\f$. The vectorized kernels use the polynomial approximation with the relative error below \f$10^{-6}\f$;
+	* the arguments below \f$-87\f$ result in zero.
+	* @param[in] src Source vector of length \b n
+	* @param[out] dst Resulting vector of length \b n (may be equal to \b src)
+	* @param[in] n The length of the vectors
+	* @param[in] shift The value to be subtracted from the arguments
+	*/
+	DllExport void	expVec(const float *src, float *dst, byte n, float shift = 0);
+	/**
+	* @brief Vector natural logarithm
+	* @details This function calculates \f$dst_i = \ln(\max(src_i, FLT\_MIN))\f$, thus the zero arguments result in a finite value.
+	* @param[in] src Source vector of length \b n
+	* @param[out] dst Resulting vector of length \b n (may be equal to \b src)
+	* @param[in] n The length of the vectors
+	*/
+	DllExport void	logVec(const float *src, float *dst, byte n);
+	/**
+	* @brief Scaled vector addition
+	* @details This function calculates \f$\vec{y} = \vec{y} + a\cdot\vec{x}\f$
+	* @param[in] a The scale factor
+	* @param[in] x Source vector of length \b n
+	* @param[in,out] y Destination vector of length \b n
+	* @param[in] n The length of the vectors
+	*/
+	DllExport void	axpy(float a, const float *x, float *y, int n);
+	/**
+	* @brief Absolute differences to a scalar
+	* @details This function calculates \f$dst_i = |a - x_i|\f$, \a e.g. the matching costs of one pixel for all the disparities (ref. @ref CStereoCost)
+	* @param[in] a The scalar
+	* @param[in] x Source vector of length \b n
+	* @param[out] dst Resulting vector of length \b n (may be equal to \b x)
+	* @param[in] n The length of the vectors
+	*/
+	DllExport void	absDiff(float a, const float *x, float *dst, int n);
+	/**
+	* @brief One step of the min-plus dynamic programming with the two-penalty smoothness
+	* @details This function calculates \f$dst_i = cost_i + \min(src_i, src_{i-1} + P_1, src_{i+1} + P_1, m + P_2) - m\f$, where \f$m = \min_j src_j\f$,
+	* \a i.e. the aggregated cost of a pixel along one scanline path (ref. @ref CInferSGM)
+	* @param[in] src The aggregated costs of the previous pixel of the path: vector of length \b n
+	* @param[in] cost The matching costs of the pixel: vector of length \b n
+	* @param[in] P1 The penalty for the change of the state by 1
+	* @param[in] P2 The penalty for the larger changes of the state
+	* @param[out] dst Resulting vector of length \b n. Must not overlap with \b src
+	* @param[in] n The length of the vectors. Must be positive
+	*/
+	DllExport void	minPlusStep(const float *src, const float *cost, float P1, float P2, float *dst, int n);
+	/**
+	* @brief Batched normalized transposed matrix - vector multiplication
+	* @details This function calculates \f$\vec{dst}_i = M^\top\times\vec{a}_i / Z_i\f$ for \b n vectors at once, where \f$Z_i\f$ is the sum of the elements of the product,
+	* or the same product, where the summation is replaced by maximization. If \f$Z_i \leq FLT\_EPSILON\f$, the result is the uniform vector \f$1 / k\f$.
+	* These are the messages of \b n edges sharing one squared edge potential (ref. CInferLBP::setEdgeBatched()). The vectors are stored in the structure-of-arrays
+	* layout, \a i.e. the consecutive elements of a row belong to the consecutive vectors, thus every vector instruction updates 4, 8 or 16 vectors, regardless of \b k.
+	* @param[in] M Row-major square matrix of size \b k x \b k
+	* @param[in] a The vectors: matrix of size \b k x \b n, row \a j holds the \a j-th elements
+	* @param[in] lda The distance between the rows of the matrix \b a in elements
+	* @param[out] dst The resulting vectors: matrix of size \b k x \b n. Must not overlap with \b a
+	* @param[in] ldd The distance between the rows of the matrix \b dst in elements
+	* @param[in] k The size of the matrix
+	* @param[in] n The number of vectors
+	* @param[in] maxSum Flag indicating weather the \a max-sum multiplication should be performed
+	*/
+	DllExport void	matTVecMulBatch(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum = false);
+	/**
+	* @brief Index of the maximal element
+	* @details If the maximum is reached several times, the index of the first occurrence is returned, as with std::max_element()
+	* @param[in] src Source vector of length \b n
+	* @param[in] n The length of the vector. Must be positive
+	* @return The index of the maximal element
+	*/
+	DllExport byte	argMax(const float *src, byte n);
+	/**
+	* @brief Squared Mahalanobis distances to a set of Gaussians
+	* @details This function calculates \f$dst_g = \|W_g(\vec{x} - \vec{\mu}_g)\|^2\f$ for \b n Gaussians at once, where \f$W_g\f$ is a lower triangular
+	* whitening matrix, \a e.g. the inverse of the Cholesky factor of the covariance matrix. The Gaussians are stored in the structure-of-arrays layout,
+	* \a i.e. the consecutive elements of a row belong to the consecutive Gaussians.
+	* @param[in] x The point of length \b k
+	* @param[in] mu The means: matrix of size \b k x \b n, row \a j holds the \a j-th coordinates
+	* @param[in] W The packed whitening matrices: matrix of size \b k(k+1)/2 x \b n, row \a i(i+1)/2+j holds the elements \f$W_{ij}, j \leq i\f$
+	* @param[out] dst Resulting vector of length \b n
+	* @param[in] k The dimension of the point
+	* @param[in] n The number of Gaussians
+	*/
+	DllExport void	mahalanobis(const float *x, const float *mu, const float *W, float *dst, int k, int n);
+	/**
+	* @brief Conversion to the half precision
+	* @details This function converts the single precision values to the IEEE 754 half precision values with rounding to the nearest even. The values,
+	* exceeding the half precision range, result in infinity.
+	* @param[in] src Source vector of length \b n
+	* @param[out] dst Resulting vector of length \b n with the bit patterns of the half precision values
+	* @param[in] n The length of the vectors
+	*/
+	DllExport void	floatToHalf(const float *src, word *dst, int n);
+	/**
+	* @brief Conversion from the half precision
+	* @details This function converts the IEEE 754 half precision values to the single precision values (ref. floatToHalf())
+	* @param[in] src Source vector of length \b n with the bit patterns of the half precision values
+	* @param[out] dst Resulting vector of length \b n
+	* @param[in] n The length of the vectors
+	*/
+	DllExport void	halfToFloat(const word *src, float *dst, int n);
+
+	/**
+	* @brief Single precision general matrix multiplication
+	* @details This function calculates \f$C = \alpha A\times B + \beta C\f$ for the row-major matrices. The matrices are processed in the cache-sized blocks:
+	* the blocks of \b A and \b B are packed into contiguous panels, which are multiplied by a register-blocked micro-kernel of 6 x 16 elements, selected at run-time (ref. getISA()).
+	* > This function is single-threaded: for the multithreaded multiplication ref. parallel::gemm()
+	* @param[in] m The number of rows of the matrices \b A and \b C
+	* @param[in] n The number of columns of the matrices \b B and \b C
+	* @param[in] k The number of columns of the matrix \b A and rows of the matrix \b B
+	* @param[in] alpha The weight of the matrix product
+	* @param[in] A Matrix of size \b m x \b k
+	* @param[in] lda The distance between the rows of the matrix \b A in elements
+	* @param[in] B Matrix of size \b k x \b n
+	* @param[in] ldb The distance between the rows of the matrix \b B in elements
+	* @param[in] beta The weight of the matrix \b C. If zero, the initial content of \b C is ignored
+	* @param[in,out] C Matrix of size \b m x \b n
+	* @param[in] ldc The distance between the rows of the matrix \b C in elements
+	*/
+	DllExport void	sgemm(int m, int n, int k, float alpha, const float *A, int lda, const float *B, int ldb, float beta, float *C, int ldc);
+	/**
+	* @brief Dot products of an unsigned 8-bit vector with the rows of a signed 8-bit matrix
+	* @details This function calculates \f$dst_j = \sum_{p=0}^{k-1} a_p B_{j,p}\f$ for \f$j = 0, \ldots, n-1\f$ with the exact 32-bit integer accumulation. 
+	* The kernel is selected at run-time: with AVX-512 VNNI the products of 64 pairs are accumulated by one \a vpdpbusd instruction, with AVX2 the operands are widened to
+	* 16 bits and accumulated with \a vpmaddwd; 4 rows of \b B share the loads of \b a. No saturation occurs for \f$k < 2^{16}\f$.
+	* @param[in] a Vector of length \b k
+	* @param[in] B Row-major matrix of size \b n x \b k
+	* @param[in] ldb The distance between the rows of the matrix \b B in elements
+	* @param[in] n The number of rows of the matrix \b B
+	* @param[in] k The length of the vector \b a
+	* @param[out] dst Resulting vector of length \b n
+	*/
+	DllExport void	dotU8S8(const byte *a, const int8_t *B, int ldb, int n, int k, int *dst);
+	/**
+	* @brief Gradient magnitudes and orientation bins of an image row
+	* @details This function calculates the central derivatives \f$I_x = (cur_{x+1} - cur_{x-1}) / 2\f$, which are zero at the row boundaries, and \f$I_y = (next_x - prev_x) / 2\f$
+	* of one row of an 8-bit image, and from them in the same pass the magnitude \f$mgn_x = \sqrt{I_x^2 + I_y^2}\f$ and the orientation bin \f$bin_x = |\{t : I_y / I_x > tan_t\}|\f$,
+	* where \f$|I_x|\f$ is limited below by \f$FLT\_EPSILON\f$. Thus, no derivative images are needed for the gradient-based features (ref. fex::CGradient::getPolar()).
+	* For the first and the last image rows \b pPrev and \b pNext should be equal to \b pCur, which results in \f$I_y = 0\f$
+	* @param[in] pPrev The previous row of length \b n
+	* @param[in] pCur The row of length \b n
+	* @param[in] pNext The next row of length \b n
+	* @param[in] pTan The ascending thresholds of the orientation bins: vector of length \b nTan
+	* @param[in] nTan The number of the thresholds, \a i.e. the number of bins minus one
+	* @param[out] mgn The gradient magnitudes: vector of length \b n
+	* @param[out] bin The orientation bins: vector of length \b n. If \b nullptr, only the magnitudes are calculated
+	* @param[in] n The length of the rows
+	*/
+	DllExport void	gradientRow(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int n);
+
+	/// @cond
+	namespace impl {
+		// Reference implementations
+		DllExport float	matTVecMul_scalar(const float *M, const float *v, float *dst, byte n, bool maxSum);
+		DllExport float	matTVecMulHalf_scalar(const word *M, const float *v, float *dst, byte n, bool maxSum);
+		DllExport void	expVec_scalar(const float *src, float *dst, byte n, float shift);
+		DllExport void	logVec_scalar(const float *src, float *dst, byte n);
+		DllExport void	axpy_scalar(float a, const float *x, float *y, int n);
+		DllExport void	absDiff_scalar(float a, const float *x, float *dst, int n);
+		DllExport void	minPlusStep_scalar(const float *src, const float *cost, float P1, float P2, float *dst, int n);
+		DllExport void	matTVecMulBatch_scalar(const float *M, const float *a, int lda, float *dst, int ldd, byte k, int n, bool maxSum);
+		DllExport byte	argMax_scalar(const float *src, byte n);
+		DllExport void	mahalanobis_scalar(const float *x, const float *mu, const float *W, float *dst, int k, int n);
+		DllExport void	floatToHalf_scalar(const float *src, word *dst, int n);
+		DllExport void	halfToFloat_scalar(const word *src, float *dst, int n);
+		DllExport void	gemmKernel_scalar(int k, const float *pA, const float *pB, float *C, int ldc, float alpha);
+		DllExport void	dotU8S8_scalar(const byte *a, const int8_t *B, int ldb, int n, int k, int *dst);
+		DllExport void	gradientRow_scalar(const byte *pPrev, const byte *pCur, const byte *pNext, const float *pTan, int nTan, float *mgn, byte *bin, int n);
+	}
+	/// @endcond
+} }
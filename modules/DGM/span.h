@@ -0,0 +1,43 @@
+// Non-owning view of a contiguous sequence
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+
+namespace DirectGraphicalModels
+{
+	// ================================ Span Class ================================
+	/**
+	* @brief Non-owning view of a contiguous sequence of elements
+	* @details A minimal counterpart of the C++20 \a std::span: the pointer to the first element and the number of elements.
+	* The view neither allocates nor owns the elements; it remains valid until the storage, which it addresses, is reallocated or destroyed.
+	* @tparam T The type of the elements, \a e.g. \a const \a float for the read-only views
+	*/
+	template <typename T>
+	class span
+	{
+	public:
+		span(void) = default;
+		/**
+		* @brief Constructor
+		* @param data The pointer to the first element
+		* @param size The number of elements
+		*/
+		span(T *data, size_t size) : m_data(data), m_size(size) {}
+		/// Converts the mutable view into the read-only one
+		template <typename U, typename = std::enable_if_t<std::is_convertible<U(*)[], T(*)[]>::value>>
+		span(const span<U> &other) : m_data(other.data()), m_size(other.size()) {}
+
+		T		* data(void) const { return m_data; }
+		size_t	  size(void) const { return m_size; }
+		bool	  empty(void) const { return m_size == 0; }
+		T		& operator[](size_t i) const { return m_data[i]; }
+		T		* begin(void) const { return m_data; }
+		T		* end(void) const { return m_data + m_size; }
+
+
+	private:
+		T		* m_data = nullptr;
+		size_t	  m_size = 0;
+	};
+}
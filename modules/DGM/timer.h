@@ -3,35 +3,55 @@
 #pragma once
 
 #include "types.h"
+#include "profiler.h"
 
 namespace DirectGraphicalModels
 {
 	// ================================ Timer Namespace ==============================
 	/**
 	* @brief %Timer
+	* @details The timers are thread-safe and may be nested. For the detailed measurements, use the @ref profiler zones
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	namespace Timer 
 	{
-		static int64 m_ticks = 0;
+		namespace impl {
+			// The stack of the started timers of the calling thread: the starting time and the flag indicating whether the profiler zone was opened
+			inline std::vector<std::pair<int64, bool>> & getTimers(void)
+			{
+				thread_local std::vector<std::pair<int64, bool>> vTimers;
+				return vTimers;
+			}
+		}
 
 		/**
 		* @brief Starts the timer
+		* @details The timers may be nested: every call of stop() refers to the last started timer of the calling thread.
+		* If DGM is built with \a ENABLE_PROFILER option, the timer also opens the profiler zone with name \b str (ref. @ref profiler)
 		* @param str Custom string to be printed when the timer has started
 		*/
-		void start(const std::string &str) 
+		inline void start(const std::string &str) 
 		{
 			printf("%s ", str.c_str());
-			m_ticks = getTickCount();
+			bool zone = false;
+#ifdef ENABLE_PROFILER
+			zone = profiler::begin(profiler::intern(str));
+#endif
+			impl::getTimers().emplace_back(getTickCount(), zone);
 		}
 
 		/**
 		* @brief Stops the timer
 		* @details This function prints out the time in milliseconds passed between start() and stop()
 		*/
-		void stop(void) 
+		inline void stop(void) 
 		{
-			int64 ms = static_cast<int64>(1000 * (getTickCount() - m_ticks) / getTickFrequency());
+			std::vector<std::pair<int64, bool>> &vTimers = impl::getTimers();
+			if (vTimers.empty()) return;
+			const std::pair<int64, bool> timer = vTimers.back();
+			vTimers.pop_back();
+			if (timer.second) profiler::end();
+			int64 ms = static_cast<int64>(1000 * (getTickCount() - timer.first) / getTickFrequency());
 			int64 sec = 0;
 			int64 min = 0;
 			int64 hrs = 0;
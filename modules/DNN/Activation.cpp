@@ -0,0 +1,103 @@
+#include "Activation.h"
+#include "DGM/simd.h"
+#include "DGM/ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels { namespace dnn { namespace activation
+{
+	namespace {
+		const int CHUNK = 240;		// the chunk size for simd::expVec(), which processes at most 255 values
+
+		// dst = 1 / (1 + e^(-scale * src))
+		void logistic(const float *src, float *dst, int n, float scale)
+		{
+			float tmp[CHUNK];
+			for (int i = 0; i < n; i += CHUNK) {
+				const int len = MIN(CHUNK, n - i);
+				for (int j = 0; j < len; j++) tmp[j] = -scale * src[i + j];
+				simd::expVec(tmp, tmp, static_cast<byte>(len));
+				for (int j = 0; j < len; j++) dst[i + j] = 1.0f / (1.0f + tmp[j]);
+			}
+		}
+	}
+
+	void apply(Activation activation, const float *src, float *dst, int n)
+	{
+		switch (activation) {
+			case Activation::linear:	if (dst != src) for (int i = 0; i < n; i++) dst[i] = src[i]; break;
+			case Activation::relu:		for (int i = 0; i < n; i++) dst[i] = MAX(0.0f, src[i]); break;
+			case Activation::sigmoid:	logistic(src, dst, n, 1.0f); break;
+			case Activation::tanh:																			// tanh(x) = 2 / (1 + e^(-2x)) - 1
+				logistic(src, dst, n, 2.0f);
+				for (int i = 0; i < n; i++) dst[i] = 2 * dst[i] - 1;
+				break;
+			default: DGM_ASSERT_MSG(false, "The activation function is not element-wise");
+		}
+	}
+
+	// The columns are processed row by row, thus all the inner loops run over contiguous memory
+	void softmax(const Mat &src, Mat &dst)
+	{
+		DGM_ASSERT(src.type() == CV_32FC1 && dst.type() == CV_32FC1 && src.size() == dst.size());
+		const int grainSize = MAX(1, 1024 / MAX(1, src.rows));
+		parallel::parallelFor(Range(0, src.cols), [&](const Range &range) {
+			const int n = range.size();
+			vec_float_t vMax(n, -FLT_MAX);
+			vec_float_t vSum(n, 0);
+			for (int y = 0; y < src.rows; y++) {
+				const float *pSrc = src.ptr<float>(y) + range.start;
+				for (int x = 0; x < n; x++) vMax[x] = MAX(vMax[x], pSrc[x]);
+			}
+			float tmp[CHUNK];
+			for (int y = 0; y < src.rows; y++) {
+				const float *pSrc = src.ptr<float>(y) + range.start;
+				float		*pDst = dst.ptr<float>(y) + range.start;
+				for (int i = 0; i < n; i += CHUNK) {
+					const int len = MIN(CHUNK, n - i);
+					for (int j = 0; j < len; j++) tmp[j] = pSrc[i + j] - vMax[i + j];
+					simd::expVec(tmp, pDst + i, static_cast<byte>(len));
+				}
+				for (int x = 0; x < n; x++) vSum[x] += pDst[x];
+			}
+			for (float &sum : vSum) sum = 1.0f / sum;
+			for (int y = 0; y < src.rows; y++) {
+				float *pDst = dst.ptr<float>(y) + range.start;
+				for (int x = 0; x < n; x++) pDst[x] *= vSum[x];
+			}
+		}, grainSize);
+	}
+
+	void multiplyDerivative(Activation activation, const float *values, float *delta, int n)
+	{
+		switch (activation) {
+			case Activation::linear:
+			case Activation::softmax:	break;
+			case Activation::relu:		for (int i = 0; i < n; i++) delta[i] = values[i] > 0 ? delta[i] : 0; break;
+			case Activation::sigmoid:	for (int i = 0; i < n; i++) delta[i] *= values[i] * (1 - values[i]); break;
+			case Activation::tanh:		for (int i = 0; i < n; i++) delta[i] *= 1 - values[i] * values[i]; break;
+			default: DGM_ASSERT_MSG(false, "The derivative of the custom activation function must be given by a callback");
+		}
+	}
+
+	std::function<float(float)> getFunction(Activation activation)
+	{
+		switch (activation) {
+			case Activation::linear:	return [](float x) { return x; };
+			case Activation::relu:		return [](float x) { return MAX(0.0f, x); };
+			case Activation::sigmoid:	return [](float x) { return 1.0f / (1.0f + expf(-x)); };
+			case Activation::tanh:		return [](float x) { return tanhf(x); };
+			default: DGM_ASSERT_MSG(false, "The activation function is not element-wise"); return nullptr;
+		}
+	}
+
+	std::function<float(float)> getDerivative(Activation activation)
+	{
+		switch (activation) {
+			case Activation::linear:	return [](float) { return 1.0f; };
+			case Activation::relu:		return [](float x) { return x > 0 ? 1.0f : 0.0f; };
+			case Activation::sigmoid:	return [](float x) { const float s = 1.0f / (1.0f + expf(-x)); return s * (1 - s); };
+			case Activation::tanh:		return [](float x) { const float t = tanhf(x); return 1 - t * t; };
+			default: DGM_ASSERT_MSG(false, "The activation function is not element-wise"); return nullptr;
+		}
+	}
+} } }
@@ -0,0 +1,65 @@
+// Activation functions interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+namespace DirectGraphicalModels { namespace dnn
+{
+	/// Activation functions of the neuron layers
+	enum class Activation : byte {
+		linear,			///< \f$f(x) = x\f$
+		relu,			///< Rectified linear unit: \f$f(x) = \max(0, x)\f$
+		sigmoid,		///< Logistic function: \f$f(x) = \frac{1}{1 + e^{-x}}\f$
+		tanh,			///< Hyperbolic tangent: \f$f(x) = \tanh(x)\f$
+		softmax,		///< Softmax over the neurons of the layer: \f$f(\vec{x})_i = \frac{e^{x_i}}{\sum_j e^{x_j}}\f$
+		custom			///< User-defined function, given by a callback
+	};
+
+	/**
+	* @brief Built-in activation functions
+	* @details The functions process the contiguous arrays with the vectorized kernels (ref. simd::expVec()); the derivatives are expressed via the values of the function,
+	* thus they need no additional evaluations of the exponent.
+	*/
+	namespace activation {
+		/**
+		* @brief Applies the element-wise activation function
+		* @param activation The activation function: linear, relu, sigmoid or tanh
+		* @param[in] src The net values of length \b n
+		* @param[out] dst The values of length \b n (may be equal to \b src)
+		* @param[in] n The length of the arrays
+		*/
+		DllExport void	apply(Activation activation, const float *src, float *dst, int n);
+		/**
+		* @brief Applies the softmax function to every column of a matrix
+		* @details The rows of the matrix correspond to the neurons and the columns - to the samples
+		* > This function supports PPL.
+		* @param[in] src The net values: Mat(size: numNeurons x batch; type: CV_32FC1)
+		* @param[out] dst The values: Mat(size: numNeurons x batch; type: CV_32FC1). It must be allocated
+		*/
+		DllExport void	softmax(const Mat &src, Mat &dst);
+		/**
+		* @brief Multiplies the errors with the derivative of the activation function
+		* @details This function calculates \f$delta_i = delta_i\cdot f'(x_i)\f$, where \f$f'(x_i)\f$ is expressed via the value \f$f(x_i)\f$. For the softmax,
+		* the derivative is one: the errors of the softmax layer are supposed to be the gradients of the cross-entropy loss.
+		* @param activation The built-in activation function
+		* @param[in] values The values of the activation function of length \b n
+		* @param[in,out] delta The errors of length \b n
+		* @param[in] n The length of the arrays
+		*/
+		DllExport void	multiplyDerivative(Activation activation, const float *values, float *delta, int n);
+		/**
+		* @brief Returns the activation function
+		* @param activation The built-in element-wise activation function
+		* @return The activation function of the net value
+		*/
+		DllExport std::function<float(float)>	getFunction(Activation activation);
+		/**
+		* @brief Returns the derivative of the activation function
+		* @param activation The built-in element-wise activation function
+		* @return The derivative of the activation function at the net value
+		*/
+		DllExport std::function<float(float)>	getDerivative(Activation activation);
+	}
+} }
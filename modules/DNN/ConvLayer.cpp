@@ -0,0 +1,79 @@
+#include "ConvLayer.h"
+#include "DGM/parallel.h"
+#include "DGM/random.h"
+#include "DGM/simd.h"
+
+namespace DirectGraphicalModels { namespace dnn
+{
+	// Constants
+	const int CConvLayer::STRIPE_PIXELS = 4096;
+
+	void CConvLayer::generateRandomWeights(void)
+	{
+		random::U(m_weights.size(), m_weights.type(), -0.5f, 0.5f).copyTo(m_weights);
+	}
+
+	// res(y, x) = f(patch(y, x) x weights), where the patches of a stripe form the rows of one matrix
+	Mat CConvLayer::apply(const Mat& img, float inputScale) const
+	{
+		DGM_ASSERT_MSG(img.channels() == m_nChannels, "The number of channels of the image (%d) does not correspond to the specified (%d)", img.channels(), m_nChannels);
+
+		const int nFilters		= m_weights.cols;
+		const int patchSize		= m_weights.rows;						// including the bias
+		const int radius		= m_kernelSize / 2;
+		const int rowSize		= m_kernelSize * m_nChannels;			// the size of one row of a patch
+
+		Mat src;
+		img.convertTo(src, CV_32F, inputScale);
+		Mat res(img.size(), CV_32FC(nFilters));
+
+		const int stripeRows	= MAX(1, STRIPE_PIXELS / MAX(1, img.cols));
+		const int nStripes		= (img.rows + stripeRows - 1) / stripeRows;
+		parallel::parallelFor(Range(0, nStripes), [&](const Range& range) {
+			Mat patches;
+			for (int s = range.start; s < range.end; s++) {
+				const int y0		= s * stripeRows;
+				const int y1		= MIN(y0 + stripeRows, img.rows);
+				const int nPixels	= (y1 - y0) * img.cols;
+
+				// im2col
+				patches.create(nPixels, patchSize, CV_32FC1);
+				for (int y = y0; y < y1; y++)
+					for (int x = 0; x < img.cols; x++) {
+						float *pPatch = patches.ptr<float>((y - y0) * img.cols + x);
+						for (int dy = -radius; dy <= radius; dy++, pPatch += rowSize) {
+							if (y + dy < 0 || y + dy >= img.rows) {
+								std::fill(pPatch, pPatch + rowSize, 0.0f);
+								continue;
+							}
+							const float *pSrc = src.ptr<float>(y + dy);
+							if (x - radius >= 0 && x + radius < img.cols) {
+								std::copy(pSrc + (x - radius) * m_nChannels, pSrc + (x + radius + 1) * m_nChannels, pPatch);
+								continue;
+							}
+							for (int dx = -radius; dx <= radius; dx++) {
+								float *pDst = pPatch + (dx + radius) * m_nChannels;
+								if (x + dx < 0 || x + dx >= img.cols) std::fill(pDst, pDst + m_nChannels, 0.0f);
+								else std::copy(pSrc + (x + dx) * m_nChannels, pSrc + (x + dx + 1) * m_nChannels, pDst);
+							} // dx
+						} // dy
+						*pPatch = 1.0f;											// bias
+					} // x
+
+				// The result of the stripe is a contiguous block of nPixels x nFilters values
+				float *pRes = res.ptr<float>(y0);
+				simd::sgemm(nPixels, nFilters, patchSize, 1, patches.ptr<float>(), patchSize, m_weights.ptr<float>(), static_cast<int>(m_weights.step1()), 0, pRes, nFilters);
+				if (m_activation == Activation::softmax) {
+					Mat values(nPixels, nFilters, CV_32FC1, pRes);
+					const Mat netValuesT = values.t();
+					Mat valuesT(netValuesT.size(), CV_32FC1);
+					activation::softmax(netValuesT, valuesT);
+					transpose(valuesT, values);
+				}
+				else activation::apply(m_activation, pRes, pRes, nPixels * nFilters);
+			} // s
+		}, 1);
+
+		return res;
+	}
+}}
@@ -0,0 +1,95 @@
+// Convolutional layer class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "Activation.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels {
+	namespace dnn
+	{
+		/**
+		 * @brief Convolutional layer
+		 * @details The layer applies \a nFilters filters of size \a kernelSize x \a kernelSize x \a nChannels to every pixel of a multi-channel image, followed by the activation function.
+		 * The image is processed in the stripes of rows in parallel: the patches of a stripe are gathered into the rows of a matrix (\a im2col), which is multiplied
+		 * with the weights by one matrix-matrix product, written directly into the result. The image borders are padded with zeros, thus the result has the size of the image.
+		 *
+		 * The weights of the filters are stored as the columns of the matrix, where the rows correspond to the elements of the patch in the row-major order (\a dy, \a dx, \a channel),
+		 * and the last row is the bias. Therefore, a perceptron layer, trained on the flattened patches augmented with the constant feature 1, may be applied to the whole image as a
+		 * convolutional layer. A layer with \a nStates filters and the softmax activation produces the node potentials, which may be passed directly to CGraphExt::setGraph():
+		 * @code
+		 * CConvLayer conv1(3, nFeatures, 32, Activation::relu);
+		 * CConvLayer conv2(1, 32, nStates, Activation::softmax);
+		 * Mat potentials = conv2.apply(conv1.apply(featureImage, 1.0f / 255));	// CV_32FC(nStates)
+		 * graphExt.setGraph(potentials);
+		 * @endcode
+		 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+		 */
+		class CConvLayer
+		{
+		public:
+			/**
+			 * @brief Constructor
+			 * @param kernelSize The size of the filters (odd number)
+			 * @param nChannels The number of channels of the input images
+			 * @param nFilters The number of filters, \a i.e. the number of channels of the result (at most \a CV_CN_MAX)
+			 * @param activation The built-in activation function
+			 */
+			DllExport CConvLayer(int kernelSize, int nChannels, int nFilters, Activation activation = Activation::relu)
+				: CConvLayer(kernelSize, nChannels, Mat(kernelSize * kernelSize * nChannels + 1, nFilters, CV_32FC1, Scalar(0)), activation)
+			{}
+			/**
+			 * @brief Constructor
+			 * @param kernelSize The size of the filters (odd number)
+			 * @param nChannels The number of channels of the input images
+			 * @param weights The weights of the filters and the biases: Mat(size: (kernelSize * kernelSize * nChannels + 1) x nFilters; type: CV_32FC1). The matrix is shared with the layer
+			 * @param activation The built-in activation function
+			 */
+			DllExport CConvLayer(int kernelSize, int nChannels, const Mat& weights, Activation activation = Activation::relu)
+				: m_kernelSize(kernelSize)
+				, m_nChannels(nChannels)
+				, m_weights(weights)
+				, m_activation(activation)
+			{
+				DGM_ASSERT_MSG(kernelSize > 0 && kernelSize % 2 == 1, "The kernel size must be a positive odd number");
+				DGM_ASSERT(weights.type() == CV_32FC1);
+				DGM_ASSERT(weights.rows == kernelSize * kernelSize * nChannels + 1);
+				DGM_ASSERT(weights.cols > 0 && weights.cols <= CV_CN_MAX);
+				DGM_ASSERT_MSG(activation != Activation::custom, "The custom activation functions are not supported");
+			}
+			DllExport CConvLayer(const CConvLayer&) = delete;
+			DllExport ~CConvLayer(void) = default;
+
+			DllExport bool	operator=(const CConvLayer&) = delete;
+
+			DllExport void	generateRandomWeights(void);
+			/**
+			 * @brief Applies the layer to an image
+			 * @details This function does not change the state of the layer, thus it may be called concurrently
+			 * > This function supports PPL.
+			 * @param img The image: Mat(type: CV_{XX}C(nChannels))
+			 * @param inputScale The scale of the image values, \a e.g. 1/255 for the 8-bit features, trained in the range [0; 1]
+			 * @return The values of the filters: Mat(size: img.size(); type: CV_32FC(nFilters))
+			 */
+			DllExport Mat	apply(const Mat& img, float inputScale = 1.0f) const;
+
+			// Accessors
+			DllExport Mat			getWeights(void) const { return m_weights; }
+			DllExport int			getKernelSize(void) const { return m_kernelSize; }
+			DllExport int			getNumChannels(void) const { return m_nChannels; }
+			DllExport int			getNumFilters(void) const { return m_weights.cols; }
+			DllExport Activation	getActivation(void) const { return m_activation; }
+
+
+		private:
+			static const int STRIPE_PIXELS;				///< The desired number of pixels in one stripe of rows
+
+
+		private:
+			int			m_kernelSize;					///< The size of the filters
+			int			m_nChannels;					///< The number of channels of the input images
+			Mat			m_weights;						///< The weights of the filters and the biases: one column per filter
+			Activation	m_activation;					///< The activation function
+		};
+	}
+}
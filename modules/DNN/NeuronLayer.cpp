@@ -12,27 +12,77 @@ namespace DirectGraphicalModels { namespace dnn
 
 	void CNeuronLayer::dotProd(const Mat& values)
 	{
-		// this->m_netValues = this->m_weights * values;
-		gemm(m_weights.t(), values, 1, Mat(), 0, m_netValues);
+		// Assertions
+		DGM_ASSERT(values.type() == m_weights.type());
+		DGM_ASSERT(values.rows == m_weights.rows);
+		
+		// this->m_netValues = this->m_weights.t() * values;
+		transpose(m_weights, m_weightsT);
+		if (m_activation == Activation::custom || m_activation == Activation::softmax) {
+			parallel::gemm(m_weightsT, values, 1, Mat(), 0, m_netValues);
+			activate(m_netValues, m_values);
+			return;
+		}
+
+		// The element-wise activation of a tile of the net values, while it is in the cache
+		m_values.create(m_weights.cols, values.cols, CV_32FC1);
+		parallel::gemm(m_weightsT, values, 1, Mat(), 0, m_netValues, [this](const Rect &tile) {
+			for (int y = tile.y; y < tile.y + tile.height; y++)
+				activation::apply(m_activation, m_netValues.ptr<float>(y) + tile.x, m_values.ptr<float>(y) + tile.x, tile.width);
+		});
 	}
 
 	void CNeuronLayer::setNetValues(const Mat& values)
 	{
 		// Assertions
 		DGM_ASSERT(values.type() == m_netValues.type());
-		DGM_ASSERT(values.size() == m_netValues.size());
+		DGM_ASSERT(values.rows == m_netValues.rows);
 		values.copyTo(m_netValues);
+		activate(m_netValues, m_values);
+	}
+
+	std::function<float(float y)> CNeuronLayer::getActivationFunctionDeriateve(void) const
+	{
+		switch (m_activation) {
+			case Activation::custom:	return m_activationFunctionDerivative;
+			case Activation::softmax:	return [](float) { return 1.0f; };
+			default:					return activation::getDerivative(m_activation);
+		}
 	}
 
-	Mat CNeuronLayer::getValues(void) const
+	void CNeuronLayer::activate(const Mat& netValues, Mat& values) const
 	{ 
-		Mat res(m_netValues.clone());
-		for (int y = 0; y < res.rows; y++) {
-			float* pRes = res.ptr<float>(y);
-			for (int x = 0; x < res.cols; x++)
-				pRes[x] = m_activationFunction(pRes[x]);
+		values.create(netValues.size(), netValues.type());
+		if (m_activation == Activation::softmax) {
+			activation::softmax(netValues, values);
+			return;
+		}
+		if (m_activation != Activation::custom) {
+			for (int y = 0; y < values.rows; y++)
+				activation::apply(m_activation, netValues.ptr<float>(y), values.ptr<float>(y), values.cols);
+			return;
+		}
+		for (int y = 0; y < values.rows; y++) {
+			const float	* pNetValues	= netValues.ptr<float>(y);
+			float		* pValues		= values.ptr<float>(y);
+			for (int x = 0; x < values.cols; x++)
+				pValues[x] = m_activationFunction(pNetValues[x]);
+		}
+	}
+
+	void CNeuronLayer::applyDerivative(const Mat& values, const Mat& netValues, Mat& delta) const
+	{
+		DGM_ASSERT(delta.size() == netValues.size());
+		for (int y = 0; y < delta.rows; y++) {
+			float *pDelta = delta.ptr<float>(y);
+			if (m_activation != Activation::custom)
+				activation::multiplyDerivative(m_activation, values.ptr<float>(y), pDelta, delta.cols);
+			else {
+				const float *pNetValues = netValues.ptr<float>(y);
+				for (int x = 0; x < delta.cols; x++)
+					pDelta[x] *= m_activationFunctionDerivative(pNetValues[x]);
+			}
 		}
-		return res; 
 	}
 
 }}
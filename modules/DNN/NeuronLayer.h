@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Neuron.h"
+#include "Activation.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels {
 	namespace dnn
@@ -10,38 +12,115 @@ namespace DirectGraphicalModels {
 		public:
 			/**
 			 * @brief Constructor
+			 * @details The built-in activation functions are applied with the vectorized kernels within the matrix multiplication (ref. parallel::gemm() with epilogue)
 			 * @param numNeurons The number of neurons in the layer
 			 * @param numConnections The number of incoming connections for every neuron
+			 * @param activation The built-in activation function
+			 * @note In feed-forward networks \b numConnections is usually equal to the number of neurons on the previouse layer
+			 */
+			DllExport CNeuronLayer(int numNeurons, int numConnections, Activation activation = Activation::linear)
+				: m_netValues(numNeurons, 1, CV_32FC1)
+				, m_weights(numConnections, numNeurons, CV_32FC1)
+				, m_activation(activation)
+			{
+				DGM_ASSERT_MSG(activation != Activation::custom, "The custom activation function must be given by the callbacks");
+			}
+			/**
+			 * @brief Constructor
+			 * @details The custom activation function and its derivative are called for every element: use the built-in activation functions, where possible
+			 * @param numNeurons The number of neurons in the layer
+			 * @param numConnections The number of incoming connections for every neuron
+			 * @param activationFunction The activation function
+			 * @param activationFunctionDerivative The derivative of the activation function
 			 * @note In feed-forward networks \b numConnections is usually equal to the number of neurons on the previouse layer
 			 */
 			DllExport CNeuronLayer(int numNeurons, int numConnections, const std::function<float(float x)>& activationFunction, const std::function<float(float x)>& activationFunctionDerivative)
 				: m_netValues(numNeurons, 1, CV_32FC1)
 				, m_weights(numConnections, numNeurons, CV_32FC1)
+				, m_activation(Activation::custom)
 				, m_activationFunction(activationFunction)
 				, m_activationFunctionDerivative(activationFunctionDerivative)
 			{}
+			/**
+			 * @brief Constructor
+			 * @details The layer uses the given weights without copying them, \a e.g. the weights, mapped from a model file (ref. CPerceptron::load())
+			 * @param numNeurons The number of neurons in the layer
+			 * @param activation The built-in activation function
+			 * @param weights The weights: Mat(size: numConnections x numNeurons; type: CV_32FC1)
+			 * @param pStorage The owner of the memory of the \b weights, which is kept alive as long as the layer. It may be empty, if the \b weights own their memory
+			 */
+			DllExport CNeuronLayer(int numNeurons, Activation activation, const Mat& weights, std::shared_ptr<const void> pStorage = nullptr)
+				: m_netValues(numNeurons, 1, CV_32FC1)
+				, m_weights(weights)
+				, m_activation(activation)
+				, m_pStorage(pStorage)
+			{
+				DGM_ASSERT_MSG(activation != Activation::custom, "The custom activation function must be given by the callbacks");
+				DGM_ASSERT(weights.type() == CV_32FC1);
+				DGM_ASSERT(weights.empty() || weights.cols == numNeurons);
+			}
 			DllExport CNeuronLayer(const CNeuronLayer&) = delete;
 			DllExport ~CNeuronLayer(void) = default;
 
 			DllExport bool   operator=(const CNeuronLayer&) = delete;
 
 			DllExport void	generateRandomWeights(void);
+			/**
+			 * @brief Calculates the net values and the values of the neurons
+			 * @details \f$netValues = weights^\top \times values\f$; the values of the neurons are the activation function of the net values
+			 * > This function supports PPL.
+			 * @param values The values of the neurons on the previous layer: Mat(size: numConnections x batch; type: CV_32FC1), one column per sample of the mini-batch
+			 */
 			DllExport void  dotProd(const Mat& values);
-			DllExport Mat	getValues(void) const;
+			/**
+			 * @brief Returns the values of the neurons
+			 * @return The activation function of the net values: Mat(size: numNeurons x batch; type: CV_32FC1). The matrix is shared with the layer and is overwritten by the next dotProd() or setNetValues() call
+			 */
+			DllExport Mat	getValues(void) const { return m_values; }
 
 			// Accessors
+			/**
+			 * @brief Sets the net values of the neurons
+			 * @param values The net values: Mat(size: numNeurons x batch; type: CV_32FC1), one column per sample of the mini-batch
+			 */
 			DllExport void	setNetValues(const Mat& values);
 			DllExport Mat	getNetValues(void) const { return m_netValues; }
 			DllExport Mat	getWeights(void) const { return m_weights; }
 			DllExport int   getNumNeurons(void) const { return m_netValues.rows; }
-			DllExport std::function<float(float y)> getActivationFunctionDeriateve(void) const { return m_activationFunctionDerivative; }
+			DllExport Activation	getActivation(void) const { return m_activation; }
+			DllExport std::function<float(float y)> getActivationFunctionDeriateve(void) const;
+			/**
+			 * @brief Multiplies the errors with the derivative of the activation function
+			 * @details \f$delta = delta \cdot f'(netValues)\f$, element-wise
+			 * @param delta The errors: Mat(size: numNeurons x batch; type: CV_32FC1)
+			 */
+			DllExport void	applyDerivative(Mat& delta) const { applyDerivative(m_values, m_netValues, delta); }
+			/**
+			 * @brief Applies the activation function of the layer to the external net values
+			 * @details Unlike setNetValues(), this function does not change the state of the layer, thus it may be called concurrently, \a e.g. for different parts of a mini-batch
+			 * @param[in] netValues The net values: Mat(size: numNeurons x batch; type: CV_32FC1)
+			 * @param[out] values The values of the neurons: Mat(size: numNeurons x batch; type: CV_32FC1)
+			 */
+			DllExport void	activate(const Mat& netValues, Mat& values) const;
+			/**
+			 * @brief Multiplies the errors with the derivative of the activation function at the external values
+			 * @details This function does not use the state of the layer, thus it may be called concurrently
+			 * @param values The values of the neurons: Mat(size: numNeurons x batch; type: CV_32FC1), calculated by activate(const Mat&, Mat&) const
+			 * @param netValues The net values of the neurons, corresponding to \b values
+			 * @param delta The errors: Mat(size: numNeurons x batch; type: CV_32FC1)
+			 */
+			DllExport void	applyDerivative(const Mat& values, const Mat& netValues, Mat& delta) const;
 
 
 		private:
-			Mat								m_netValues;					///< The values of the neurons at the layer (1d matrix)
+			Mat								m_netValues;					///< The net values of the neurons at the layer (numNeurons x batch matrix)
+			Mat								m_values;						///< The values of the neurons at the layer: the activation function of the net values (numNeurons x batch matrix)
 			Mat								m_weights;						///< The weight of the neurons (2d matrix )
-			std::function<float(float y)>	m_activationFunction;			///< The activation function
-			std::function<float(float y)>	m_activationFunctionDerivative;	///< The derivative of the activation function
+			Mat								m_weightsT;						///< The transposed weights: the workspace of dotProd()
+			Activation						m_activation;					///< The activation function
+			std::function<float(float y)>	m_activationFunction;			///< The custom activation function
+			std::function<float(float y)>	m_activationFunctionDerivative;	///< The derivative of the custom activation function
+			std::shared_ptr<const void>		m_pStorage;						///< The owner of the external memory of the weights
 		};
 
 		using ptr_nl_t = std::shared_ptr<CNeuronLayer>;
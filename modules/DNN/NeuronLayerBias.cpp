@@ -6,30 +6,20 @@
 namespace DirectGraphicalModels { namespace dnn
 {
 	namespace {
-		/**
-		 * Applies the Sigmoid Activation function
-		 *
-		 * @param the value at each node
-		 * @return a number between 0 and 1.
-		 */
-		float sigmoidFunction(float x)
+		// weights += alpha * (1, values)^T x delta^T: the first row of the weights are the biases
+		void updateWeights(const Mat& values, const Mat& delta, float alpha, Mat& weights, Mat& deltaT)
 		{
-			return 1.0f / (1.0f + expf(-x));
-		}
-	
-		float sigmoidFunction_derivative(float x)
-		{
-			float s = sigmoidFunction(x);
-			return s * (1 - s);
-		}
-	
-		void sigmoidFunction(Mat& X)
-		{
-			for (int y = 0; y < X.rows; y++){
-				float* pX = X.ptr<float>(y);
-				for (int x = 0; x < X.cols; x++)
-					pX[x] = sigmoidFunction(pX[x]);
+			float *pBias = weights.ptr<float>(0);
+			for (int n = 0; n < delta.rows; n++) {
+				const float *pDelta = delta.ptr<float>(n);
+				float sum = 0;
+				for (int b = 0; b < delta.cols; b++) sum += pDelta[b];
+				pBias[n] += alpha * sum;
 			}
+			
+			transpose(delta, deltaT);
+			Mat connections = weights.rowRange(1, weights.rows);
+			parallel::gemm(values, deltaT, alpha, connections, 1, connections);
 		}
 	}
 	
@@ -38,52 +28,51 @@ namespace DirectGraphicalModels { namespace dnn
 		m_weights = random::U(m_weights.size(), m_weights.type(), -0.5f, 0.5f);
 	}
 
-	void CNeuronLayerBias::dotProd(const CNeuronLayerBias& layer)
+	void CNeuronLayerBias::dotProd(const Mat& values)
 	{
-		// this->m_values = this->m_weights * layer.m_values;
-		Mat temp(1, 1, CV_32FC1, Scalar(1));
-		temp.push_back(layer.m_values);
-		parallel::gemm(m_weights.t(), temp /*layer.m_values*/, 1, Mat(), 0, m_values);
-		sigmoidFunction(m_values);
+		// Assertions
+		DGM_ASSERT(values.type() == m_weights.type());
+		DGM_ASSERT(values.rows == m_weights.rows - 1);
+
+		// this->m_values = sigmoid(this->m_weights.t() * (1, values)^T);
+		transpose(m_weights.rowRange(1, m_weights.rows), m_weightsT);
+		const float *pBias = m_weights.ptr<float>(0);
+		parallel::gemm(m_weightsT, values, 1, Mat(), 0, m_values, [&](const Rect &tile) {
+			for (int y = tile.y; y < tile.y + tile.height; y++) {
+				float *pValues = m_values.ptr<float>(y) + tile.x;
+				for (int x = 0; x < tile.width; x++) pValues[x] += pBias[y];
+				activation::apply(Activation::sigmoid, pValues, pValues, tile.width);
+			}
+		});
 	}
 	
 	void CNeuronLayerBias::setValues(const Mat& values)
 	{
 		// Assertions
 		DGM_ASSERT(values.type() == m_values.type());
-		DGM_ASSERT(values.size() == m_values.size());
+		DGM_ASSERT(values.rows == m_values.rows);
 		values.copyTo(m_values);
 	}
 
+	// The derivative of the sigmoid is expressed via its value: s' = s * (1 - s)
 	void CNeuronLayerBias::backPropagate(const CNeuronLayerBias& layerA, CNeuronLayerBias& layerB, CNeuronLayerBias& layerC, const Mat& resultErrorRate, float learningRate)
 	{
-		Mat DeltaIn_j; // = layerB.getWeights() x resultErrorRate;
-		parallel::gemm(layerC.m_weights, resultErrorRate, 1, Mat(), 0, DeltaIn_j);
+		// Assertions
+		DGM_ASSERT(resultErrorRate.type() == CV_32FC1);
+		DGM_ASSERT(resultErrorRate.size() == layerC.m_values.size());
+		DGM_ASSERT(layerA.m_values.cols == resultErrorRate.cols);
+		DGM_ASSERT(layerB.m_values.cols == resultErrorRate.cols);
 
-		Mat DeltaJ(layerB.getNumNeurons(), 1, CV_32FC1); // 60 x 1
-		for(int i = 0; i < layerB.getNumNeurons(); i++){
-			DeltaJ.at<float>(i,0) = DeltaIn_j.at<float>(i,0) * sigmoidFunction_derivative(layerB.m_values.at<float>(i, 0));
-		}
-		
-//		Mat DeltaJ(layerB.getNumNeurons(), 1, CV_32FC1);
-//		for (int i = 0; i < layerB.getNumNeurons(); i++) {
-//			float nodeVal = 0;
-//			for (int j = 0; j < layerC.getNumNeurons(); j++)
-//				nodeVal += layerC.m_weights.at<float>(i, j) * resultErrorRate.at<float>(j, 0);
-//
-//			float sigmoid = sigmoidFunction(layerB.m_values.at<float>(i, 0));
-//			DeltaJ.at<float>(i, 0) = nodeVal * sigmoidFunction_derivative(sigmoid);
-//		}
-		
-		// layerC.m_weights += learningRate * layerB.m_values x resultErrorRate.t()
-		Mat tempB(1, 1, CV_32FC1, Scalar(1));
-		tempB.push_back(layerB.m_values);
-		parallel::gemm(tempB /*layerB.m_values*/, resultErrorRate.t(), learningRate, layerC.m_weights, 1, layerC.m_weights);
-		
-		//layerB.m_weights += learningRate * layerA.m_values x DeltaJ.t();
-		Mat tempA(1, 1, CV_32FC1, Scalar(1));
-		tempA.push_back(layerA.m_values);
-		parallel::gemm(tempA /*layerA.m_values*/, DeltaJ.t(), learningRate, layerB.m_weights, 1, layerB.m_weights);
+		// DeltaJ = layerC.weights (without the biases) x resultErrorRate * sigmoid'(layerB.m_values)
+		const Mat weightsC = layerC.m_weights.rowRange(1, layerC.m_weights.rows);
+		parallel::gemm(weightsC, resultErrorRate, 1, Mat(), 0, layerB.m_delta);
+		for (int y = 0; y < layerB.m_delta.rows; y++)
+			activation::multiplyDerivative(Activation::sigmoid, layerB.m_values.ptr<float>(y), layerB.m_delta.ptr<float>(y), layerB.m_delta.cols);
+
+		const float alpha = learningRate / resultErrorRate.cols;
+		// layerC.m_weights += learningRate / batch * (1, layerB.m_values) x resultErrorRate.t()
+		updateWeights(layerB.m_values, resultErrorRate, alpha, layerC.m_weights, layerC.m_deltaT);
+		// layerB.m_weights += learningRate / batch * (1, layerA.m_values) x DeltaJ.t();
+		updateWeights(layerA.m_values, layerB.m_delta, alpha, layerB.m_weights, layerB.m_deltaT);
 	}
 }}
-
@@ -1,10 +1,17 @@
 #pragma once
 
 #include "Neuron.h"
+#include "Activation.h"
 
 namespace DirectGraphicalModels {
 	namespace dnn
 	{
+		/**
+		 * @brief Layer of the neurons with the sigmoid activation function and the bias
+		 * @details The first row of the weights holds the biases of the neurons, and the other rows - the weights of the incoming connections.
+		 * The values of the neurons are stored column-wise: one column per sample of the mini-batch. All the buffers are allocated at the first call and re-used,
+		 * while the batch size does not change.
+		 */
 		class CNeuronLayerBias
 		{
 		public:
@@ -27,9 +34,25 @@ namespace DirectGraphicalModels {
 			/**
 			 * @note This method updates only the node values
 			 */
-			DllExport void      dotProd(const CNeuronLayerBias& layer);
+			DllExport void      dotProd(const CNeuronLayerBias& layer) { dotProd(layer.m_values); }
+			/**
+			 * @brief Calculates the values of the neurons
+			 * @details \f$values = \sigma(weights^\top \times (1, values_{prev})^\top)\f$. The bias and the activation function are applied to the tiles of the result within
+			 * the matrix multiplication (ref. parallel::gemm() with epilogue), thus no augmented input matrix is built.
+			 * > This function supports PPL.
+			 * @param values The values of the neurons on the previous layer: Mat(size: numConnections x batch; type: CV_32FC1), one column per sample of the mini-batch
+			 */
+			DllExport void      dotProd(const Mat& values);
 
 			/**
+			 * @brief Updates the weights of two consecutive layers with the gradient descent
+			 * @details The gradients are averaged over the samples of the mini-batch and added to the weights in place
+			 * > This function supports PPL.
+			 * @param layerA The input layer
+			 * @param layerB The hidden layer
+			 * @param layerC The output layer
+			 * @param resultErrorRate The errors of the output layer: Mat(size: layerC.getNumNeurons() x batch; type: CV_32FC1), \a e.g. \f$gt - values\f$
+			 * @param learningRate The learning rate
 			 * @note This method updates only weights of layerB and layerC
 			 * @todo move this method to a proper place
 			 */
@@ -37,16 +60,22 @@ namespace DirectGraphicalModels {
 
 
 			// Accessors
+			/**
+			 * @brief Sets the values of the neurons
+			 * @param values The values: Mat(size: numNeurons x batch; type: CV_32FC1), one column per sample of the mini-batch
+			 */
 			DllExport void	setValues(const Mat& values);
 			DllExport Mat   getValues(void) const { return m_values; }
 			DllExport int   getNumNeurons(void) const { return m_values.rows; }
 
 
 		private:
-			Mat	m_values;	///< The values of the neurons at the layer (1d matrix)
+			Mat	m_values;	///< The values of the neurons at the layer (numNeurons x batch matrix)
 			Mat m_weights;	///< The weight of the neurons (2d matrix )
+			Mat m_weightsT;	///< The transposed weights without the biases: the workspace of dotProd()
+			Mat m_delta;	///< The errors of the neurons: the workspace of backPropagate()
+			Mat m_deltaT;	///< The transposed errors: the workspace of backPropagate()
 		};
 	}
 }
 
-
@@ -1,15 +1,42 @@
 #include "Perceptron.h"
+#include "DGM/ModelFile.h"
+#include "DGM/parallel.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels {
 	namespace dnn {
+		namespace {
+			const char		MODEL_MAGIC[4]	= { 'D', 'G', 'M', 'P' };
+			const uint32_t	MODEL_VERSION	= 1;
+			const size_t	MODEL_ALIGNMENT	= 64;			// the cache line / AVX-512 register size
+
+			/// Header of the model file
+			struct ModelHeader {
+				char		magic[4];
+				uint32_t	version;
+				uint32_t	nLayers;
+				uint32_t	reserved;
+			};
+
+			/// Record of a layer in the model file
+			struct LayerRecord {
+				uint32_t	numNeurons;
+				uint32_t	numConnections;
+				uint32_t	activation;
+				uint32_t	reserved;
+				uint64_t	offset;							// the offset of the weights from the beginning of the file
+			};
+
+			inline size_t align(size_t size) { return (size + MODEL_ALIGNMENT - 1) & ~(MODEL_ALIGNMENT - 1); }
+		}
+
 		// Constructor
 		CPerceptron::CPerceptron(const std::vector<int>& vNumNeurons) {
 			// TODO: imp,lement this constructor in the future
 			for (size_t i = 0; i < vNumNeurons.size(); i++) {
 				int numNeurons = vNumNeurons[i];
 				int numConnections = (i == 0) ? 0 : vNumNeurons[i - 1];
-				ptr_nl_t pNeuronLayer = std::make_shared<CNeuronLayer>(numNeurons, numConnections, [](float x) {return x; }, [](float x) { return 1; });
+				ptr_nl_t pNeuronLayer = std::make_shared<CNeuronLayer>(numNeurons, numConnections, Activation::linear);
 				m_vpNeuronLayers.push_back(pNeuronLayer);
 			}
 		}
@@ -34,37 +61,123 @@ namespace DirectGraphicalModels {
 				m_vpNeuronLayers[i]->dotProd(m_vpNeuronLayers[i - 1]->getValues());
 
 			// Return the node values from the output layer
-			return m_vpNeuronLayers.back()->getValues();
+			return m_vpNeuronLayers.back()->getValues().clone();
+		}
+
+		void CPerceptron::save(const std::string& fileName) const
+		{
+			const size_t nLayers = m_vpNeuronLayers.size();
+
+			ModelHeader header;
+			memcpy(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+			header.version	= MODEL_VERSION;
+			header.nLayers	= static_cast<uint32_t>(nLayers);
+			header.reserved	= 0;
+
+			std::vector<LayerRecord> vRecords(nLayers);
+			size_t offset = align(sizeof(ModelHeader) + nLayers * sizeof(LayerRecord));
+			for (size_t l = 0; l < nLayers; l++) {
+				const ptr_nl_t	pLayer	= m_vpNeuronLayers[l];
+				const Mat		weights	= pLayer->getWeights();
+				DGM_ASSERT_MSG(pLayer->getActivation() != Activation::custom, "The layers with the custom activation functions can not be saved");
+				vRecords[l].numNeurons		= static_cast<uint32_t>(pLayer->getNumNeurons());
+				vRecords[l].numConnections	= static_cast<uint32_t>(weights.rows);
+				vRecords[l].activation		= static_cast<uint32_t>(pLayer->getActivation());
+				vRecords[l].reserved		= 0;
+				vRecords[l].offset			= offset;
+				offset = align(offset + weights.total() * sizeof(float));
+			} // l
+
+			FILE *pFile = fopen(fileName.c_str(), "wb");
+			DGM_ASSERT_MSG(pFile, "Can't create file %s", fileName.c_str());
+			fwrite(&header, sizeof(ModelHeader), 1, pFile);
+			fwrite(vRecords.data(), sizeof(LayerRecord), nLayers, pFile);
+			size_t pos = sizeof(ModelHeader) + nLayers * sizeof(LayerRecord);
+			const byte padding[MODEL_ALIGNMENT] = { 0 };
+			for (size_t l = 0; l < nLayers; l++) {
+				const Mat weights = m_vpNeuronLayers[l]->getWeights();
+				fwrite(padding, 1, vRecords[l].offset - pos, pFile);
+				for (int y = 0; y < weights.rows; y++)
+					fwrite(weights.ptr<float>(y), sizeof(float), weights.cols, pFile);
+				pos = vRecords[l].offset + weights.total() * sizeof(float);
+			} // l
+			fclose(pFile);
+		}
+
+		std::unique_ptr<CPerceptron> CPerceptron::load(const std::string& fileName, bool mapped)
+		{
+			size_t size = 0;
+			std::shared_ptr<const void> pStorage = CModelFile::loadData(fileName, size, mapped);
+			const byte *pData = static_cast<const byte *>(pStorage.get());
+
+			const ModelHeader *pHeader = reinterpret_cast<const ModelHeader *>(pData);
+			DGM_ASSERT_MSG(size >= sizeof(ModelHeader) && memcmp(pHeader->magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0, "The file %s is not a model file", fileName.c_str());
+			DGM_ASSERT_MSG(pHeader->version == MODEL_VERSION, "The version %u of the model file %s is not supported", pHeader->version, fileName.c_str());
+			DGM_ASSERT_MSG(size >= sizeof(ModelHeader) + pHeader->nLayers * sizeof(LayerRecord), "The model file %s is corrupted", fileName.c_str());
+
+			const LayerRecord *pRecords = reinterpret_cast<const LayerRecord *>(pData + sizeof(ModelHeader));
+			std::vector<ptr_nl_t> vpLayers;
+			for (uint32_t l = 0; l < pHeader->nLayers; l++) {
+				const LayerRecord &record = pRecords[l];
+				const int numNeurons	 = static_cast<int>(record.numNeurons);
+				const int numConnections = static_cast<int>(record.numConnections);
+				DGM_ASSERT_MSG(record.offset + static_cast<uint64_t>(numConnections) * numNeurons * sizeof(float) <= size, "The model file %s is corrupted", fileName.c_str());
+				DGM_ASSERT_MSG(record.activation < static_cast<uint32_t>(Activation::custom), "The model file %s is corrupted", fileName.c_str());
+				const Mat weights = numConnections ? Mat(numConnections, numNeurons, CV_32FC1, const_cast<byte *>(pData + record.offset)) : Mat(0, numNeurons, CV_32FC1);
+				vpLayers.push_back(std::make_shared<CNeuronLayer>(numNeurons, static_cast<Activation>(record.activation), weights, pStorage));
+			} // l
+
+			return std::make_unique<CPerceptron>(vpLayers);
 		}
 
-		// TODO: this method works only for 3 layers
 		// dCost/dw = dCost/dNode.Value * dNode.Value/dNode.NetValue * dNode.NetValue/dNode.Weight
 		// dCost/dw = 2(solution - gt) * ActivationFunctionDeriateve(nodeNetValue) * Node_i-1.Value
 		void CPerceptron::backPropagate(const Mat& gt, float learningRate)
 		{
-			const int nLayers = static_cast<int>(m_vpNeuronLayers.size());
+			calculateDeltas(gt);
+		
+			// compute gradient descent, averaged over the mini-batch: the weights are updated in place
+			const float alpha = -learningRate / gt.cols;
+			for (size_t l = 1; l < m_vpNeuronLayers.size(); l++) {
+				// Wi -= learningRate / batch * x_(i-1) x delta_(i - 1).t();
+				Mat weights = m_vpNeuronLayers[l]->getWeights();
+				parallel::gemm(m_vpNeuronLayers[l - 1]->getValues(), m_vDeltasT[l - 1], alpha, weights, 1, weights);
+			}
+		}
+
+		void CPerceptron::calculateGradients(const Mat& gt)
+		{
+			calculateDeltas(gt);
+			m_vGradients.resize(m_vDeltas.size());
+			for (size_t l = 1; l < m_vpNeuronLayers.size(); l++)
+				parallel::gemm(m_vpNeuronLayers[l - 1]->getValues(), m_vDeltasT[l - 1], 1.0f / gt.cols, Mat(), 0, m_vGradients[l - 1]);
+		}
+
+		// ------------------------------ PRIVATE ------------------------------
+		// The buffers are allocated at the first call and re-used, while the batch size does not change
+		void CPerceptron::calculateDeltas(const Mat& gt)
+		{
+			const size_t nLayers = m_vpNeuronLayers.size();
 			
 			// Assertion
-			DGM_ASSERT_MSG(nLayers >= 3, "Percepton must contain at least 3 layers");
+			DGM_ASSERT_MSG(nLayers >= 2, "Percepton must contain at least 2 layers");
+			DGM_ASSERT(gt.type() == CV_32FC1);
+			DGM_ASSERT(gt.size() == m_vpNeuronLayers.back()->getValues().size());
 			
-			vec_mat_t vDeltas(nLayers - 1);
+			m_vDeltas.resize(nLayers - 1);
+			m_vDeltasT.resize(nLayers - 1);
 			
 			// compute init delta
-			vDeltas.back() = m_vpNeuronLayers.back()->getValues() - gt;
-			for (int i = 0; i < vDeltas.back().rows; i++)
-				vDeltas.back().at<float>(i, 0) *= m_vpNeuronLayers.back()->getActivationFunctionDeriateve()(m_vpNeuronLayers.back()->getNetValues().at<float>(i, 0));
+			subtract(m_vpNeuronLayers.back()->getValues(), gt, m_vDeltas.back());
+			m_vpNeuronLayers.back()->applyDerivative(m_vDeltas.back());
 			
 			// compute deltas
-			for (int l = nLayers - 3; l >= 0; l--) {
-				vDeltas[l] = m_vpNeuronLayers[l + 2]->getWeights() * vDeltas[l + 1];
-				for (int i = 0; i < vDeltas[l].rows; i++)
-					vDeltas[l].at<float>(i, 0) *= m_vpNeuronLayers[l + 1]->getActivationFunctionDeriateve()(m_vpNeuronLayers[l + 1]->getNetValues().at<float>(i, 0));
+			for (size_t l = nLayers - 2; l-- > 0; ) {
+				parallel::gemm(m_vpNeuronLayers[l + 2]->getWeights(), m_vDeltas[l + 1], 1, Mat(), 0, m_vDeltas[l]);
+				m_vpNeuronLayers[l + 1]->applyDerivative(m_vDeltas[l]);
 			}
-		
-			// compute gradient descen
-			for (int l =  1; l < nLayers; l++)
-				// Wi -= learningRate * x_(i-1) x delta_(i - 1).t();
-				gemm(m_vpNeuronLayers[l - 1]->getValues(), vDeltas[l - 1].t(), -learningRate, m_vpNeuronLayers[l]->getWeights(), 1, m_vpNeuronLayers[l]->getWeights());
+
+			for (size_t l = 0; l < nLayers - 1; l++) transpose(m_vDeltas[l], m_vDeltasT[l]);
 		}
 	}
 }
@@ -14,12 +14,79 @@ namespace DirectGraphicalModels {
 			
 			DllExport bool operator=(const CPerceptron&) = delete;
 
+			/**
+			 * @brief Calculates the prediction of the network
+			 * @details The samples of a mini-batch are processed together: every layer calculates its net values with one matrix-matrix product for all the samples
+			 * > This function supports PPL.
+			 * @param inputValues The input values: Mat(size: nFeatures x batch; type: CV_32FC1), one column per sample
+			 * @return The values of the output layer: Mat(size: nOutputs x batch; type: CV_32FC1), one column per sample
+			 */
 			DllExport Mat	getPrediction(const Mat& inputValues);
+			/**
+			 * @brief Updates the weights of the network with the gradient descent
+			 * @details The gradients are calculated for the mini-batch of the last getPrediction() call with one matrix-matrix product per layer, and averaged over the samples.
+			 * The network may have any number of layers (at least 2); the errors of the layers are stored in the workspace buffers, which are re-used while the batch size does not change,
+			 * and the weights are updated in place.
+			 * > This function supports PPL.
+			 * @param gt The expected output values: Mat(size: nOutputs x batch; type: CV_32FC1), one column per sample
+			 * @param learningRate The learning rate
+			 */
 			DllExport void	backPropagate(const Mat& gt, float learningRate);
+			/**
+			 * @brief Calculates the gradients of the cost function with respect to the weights
+			 * @details The gradients are calculated for the mini-batch of the last getPrediction() call and averaged over the samples, as in backPropagate(),
+			 * but the weights are not updated. This allows for the other optimizers, \a e.g. Adam. The gradients are stored in the buffers of the perceptron (ref. getGradient()).
+			 * > This function supports PPL.
+			 * @param gt The expected output values: Mat(size: nOutputs x batch; type: CV_32FC1), one column per sample
+			 */
+			DllExport void	calculateGradients(const Mat& gt);
+			/**
+			 * @brief Returns the gradient of the weights of a layer
+			 * @param layer The index of the layer, starting from 1 for the first layer after the input layer
+			 * @return The gradient, calculated by the last calculateGradients() call: Mat(size: the size of the weights of the layer; type: CV_32FC1)
+			 */
+			DllExport Mat	getGradient(size_t layer) const { return m_vGradients.at(layer - 1); }
+			/**
+			 * @brief Returns the number of layers
+			 * @return The number of layers, including the input layer
+			 */
+			DllExport size_t	getNumLayers(void) const { return m_vpNeuronLayers.size(); }
+			/**
+			 * @brief Returns a layer
+			 * @param layer The index of the layer: 0 for the input layer
+			 * @return The layer
+			 */
+			DllExport ptr_nl_t	getLayer(size_t layer) const { return m_vpNeuronLayers.at(layer); }
+			/**
+			 * @brief Saves the network into a binary model file
+			 * @details The file starts with a header and a table of the layers, describing the number of neurons, the number of connections and the activation function
+			 * of every layer; it is followed by the weights of the layers. The weights of every layer are stored row-wise as one contiguous block of the little-endian 32-bit floats,
+			 * aligned to 64 bytes within the file, thus the file may be mapped into memory and its weights used in place (ref. load()).
+			 * @note The layers with the custom activation functions can not be saved
+			 * @param fileName The name of the model file
+			 */
+			DllExport void		save(const std::string& fileName) const;
+			/**
+			 * @brief Loads a network from a binary model file
+			 * @details If \b mapped is \a true, the file is mapped into memory copy-on-write, and the layers refer to the mapped weights: the loading takes constant time, 
+			 * and the weights are shared between all the processes, which load the same file, until they are modified, \a e.g. by training. 
+			 * Otherwise, or if the file can not be mapped, the file is read into one aligned buffer, shared by the layers.
+			 * @param fileName The name of the model file, written by the save() function
+			 * @param mapped Flag indicating whether the file should be mapped into memory
+			 * @return The network
+			 */
+			DllExport static std::unique_ptr<CPerceptron> load(const std::string& fileName, bool mapped = true);
 		
 
 		private:
-			std::vector<ptr_nl_t> m_vpNeuronLayers;
+			void	calculateDeltas(const Mat& gt);
+
+
+		private:
+			std::vector<ptr_nl_t>	m_vpNeuronLayers;
+			vec_mat_t				m_vDeltas;			///< The errors of the layers 1, 2, ...: the workspace of the back-propagation
+			vec_mat_t				m_vDeltasT;			///< The transposed errors
+			vec_mat_t				m_vGradients;		///< The gradients of the weights of the layers 1, 2, ...
 		
 		};
 	}
@@ -0,0 +1,105 @@
+#include "PerceptronTrainer.h"
+#include "DGM/parallel.h"
+#include "DGM/ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels {
+	namespace dnn {
+		// Constants
+		const int CPerceptronTrainer::MIN_SHARD_SIZE = 32;
+
+		// Constructor
+		CPerceptronTrainer::CPerceptronTrainer(CPerceptron& perceptron, size_t maxShards)
+			: m_perceptron(perceptron)
+			, m_maxShards(maxShards ? maxShards : CThreadPool::getDefault().getNumThreads())
+		{}
+
+		void CPerceptronTrainer::train(const Mat& input, const Mat& gt, float learningRate)
+		{
+			calculateGradients(input, gt);
+			for (size_t l = 1; l < m_perceptron.getNumLayers(); l++) {
+				Mat weights = m_perceptron.getLayer(l)->getWeights();
+				scaleAdd(getGradient(l), -learningRate, weights, weights);
+			}
+		}
+
+		void CPerceptronTrainer::calculateGradients(const Mat& input, const Mat& gt)
+		{
+			const size_t nLayers = m_perceptron.getNumLayers();
+
+			// Assertions
+			DGM_ASSERT_MSG(nLayers >= 2, "Percepton must contain at least 2 layers");
+			DGM_ASSERT(input.type() == CV_32FC1 && gt.type() == CV_32FC1);
+			DGM_ASSERT(input.cols == gt.cols);
+			DGM_ASSERT(input.rows == m_perceptron.getLayer(0)->getNumNeurons());
+			DGM_ASSERT(gt.rows == m_perceptron.getLayer(nLayers - 1)->getNumNeurons());
+
+			const int batch		= input.cols;
+			const int nShards	= MAX(1, MIN(static_cast<int>(m_maxShards), batch / MIN_SHARD_SIZE));
+			m_vWorkspaces.resize(nShards);
+
+			// The weights are not changed until the gradients of all the shards are calculated
+			m_vWeightsT.resize(nLayers - 1);
+			for (size_t l = 1; l < nLayers; l++) transpose(m_perceptron.getLayer(l)->getWeights(), m_vWeightsT[l - 1]);
+
+			parallel::parallelFor(Range(0, nShards), [&](const Range& range) {
+				for (int s = range.start; s < range.end; s++) {
+					const Range cols(batch * s / nShards, batch * (s + 1) / nShards);
+					Workspace& ws = m_vWorkspaces[s];
+					ws.vNetValues.resize(nLayers);
+					input.colRange(cols).copyTo(ws.vNetValues[0]);
+					gt.colRange(cols).copyTo(ws.gt);
+					process(ws);
+				} // s
+			}, 1);
+
+			// Tree reduction: at every level the gradients of shard (i + stride) are added to the gradients of shard i
+			for (int stride = 1; stride < nShards; stride *= 2) {
+				const int nPairs = (nShards + 2 * stride - 1) / (2 * stride);
+				parallel::parallelFor(Range(0, nPairs), [&](const Range& range) {
+					for (int i = range.start; i < range.end; i++) {
+						const int dst = 2 * stride * i;
+						const int src = dst + stride;
+						if (src >= nShards) continue;
+						for (size_t l = 0; l < nLayers - 1; l++)
+							add(m_vWorkspaces[dst].vGradients[l], m_vWorkspaces[src].vGradients[l], m_vWorkspaces[dst].vGradients[l]);
+					} // i
+				}, 1);
+			}
+
+			for (Mat& gradient : m_vWorkspaces[0].vGradients) gradient *= 1.0 / batch;
+		}
+
+		// ------------------------------ PRIVATE ------------------------------
+		// The input values of the shard are given in ws.vNetValues[0] and the expected output values in ws.gt
+		void CPerceptronTrainer::process(Workspace& ws) const
+		{
+			const size_t nLayers = m_perceptron.getNumLayers();
+			ws.vValues.resize(nLayers);
+			ws.vDeltas.resize(nLayers - 1);
+			ws.vDeltasT.resize(nLayers - 1);
+			ws.vGradients.resize(nLayers - 1);
+
+			// Forward propagation
+			m_perceptron.getLayer(0)->activate(ws.vNetValues[0], ws.vValues[0]);
+			for (size_t l = 1; l < nLayers; l++) {
+				parallel::gemm(m_vWeightsT[l - 1], ws.vValues[l - 1], 1, Mat(), 0, ws.vNetValues[l]);
+				m_perceptron.getLayer(l)->activate(ws.vNetValues[l], ws.vValues[l]);
+			}
+
+			// Backward propagation
+			subtract(ws.vValues.back(), ws.gt, ws.vDeltas.back());
+			m_perceptron.getLayer(nLayers - 1)->applyDerivative(ws.vValues.back(), ws.vNetValues.back(), ws.vDeltas.back());
+			for (size_t l = nLayers - 2; l-- > 0; ) {
+				parallel::gemm(m_perceptron.getLayer(l + 2)->getWeights(), ws.vDeltas[l + 1], 1, Mat(), 0, ws.vDeltas[l]);
+				m_perceptron.getLayer(l + 1)->applyDerivative(ws.vValues[l + 1], ws.vNetValues[l + 1], ws.vDeltas[l]);
+			}
+
+			// Gradients: x_(l-1) x delta_(l-1).t()
+			for (size_t l = 0; l < nLayers - 1; l++) {
+				transpose(ws.vDeltas[l], ws.vDeltasT[l]);
+				parallel::gemm(ws.vValues[l], ws.vDeltasT[l], 1, Mat(), 0, ws.vGradients[l]);
+			}
+		}
+	}
+}
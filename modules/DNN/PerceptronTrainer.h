@@ -0,0 +1,83 @@
+// Data-parallel perceptron trainer class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "Perceptron.h"
+
+namespace DirectGraphicalModels {
+	namespace dnn {
+		/**
+		 * @brief Data-parallel trainer of the perceptron
+		 * @details The mini-batch is split into the shards of consecutive samples, which are processed concurrently: every shard is propagated forward and backward
+		 * through the network on its own workspace, without changing the state of the layers. The gradients of the shards are summed up with the parallel tree reduction,
+		 * and the weights are updated synchronously, once per mini-batch. Thus, the result is the same as for CPerceptron::backPropagate() up to the rounding errors.
+		 * The workspaces are allocated at the first call and re-used, while the batch size does not change.
+		 * @code
+		 * CPerceptron perceptron(vpLayers);
+		 * CPerceptronTrainer trainer(perceptron);
+		 * for (int b = 0; b < nBatches; b++)
+		 *	trainer.train(batch[b], gt[b], learningRate);
+		 * @endcode
+		 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+		 */
+		class CPerceptronTrainer {
+		public:
+			/**
+			 * @brief Constructor
+			 * @param perceptron The perceptron to be trained. It must stay alive until the trainer is destroyed
+			 * @param maxShards The maximal number of shards of a mini-batch. If zero, the number of threads of the default thread pool is used
+			 */
+			DllExport CPerceptronTrainer(CPerceptron& perceptron, size_t maxShards = 0);
+			DllExport CPerceptronTrainer(const CPerceptronTrainer&) = delete;
+			DllExport ~CPerceptronTrainer(void) = default;
+
+			DllExport bool operator=(const CPerceptronTrainer&) = delete;
+
+			/**
+			 * @brief Updates the weights of the perceptron with the gradient descent
+			 * > This function supports PPL.
+			 * @param input The input values: Mat(size: nInputs x batch; type: CV_32FC1), one column per sample
+			 * @param gt The expected output values: Mat(size: nOutputs x batch; type: CV_32FC1), one column per sample
+			 * @param learningRate The learning rate
+			 */
+			DllExport void	train(const Mat& input, const Mat& gt, float learningRate);
+			/**
+			 * @brief Calculates the gradients of the cost function with respect to the weights
+			 * @details The gradients are averaged over the samples of the mini-batch; the weights are not updated (ref. getGradient()).
+			 * > This function supports PPL.
+			 * @param input The input values: Mat(size: nInputs x batch; type: CV_32FC1), one column per sample
+			 * @param gt The expected output values: Mat(size: nOutputs x batch; type: CV_32FC1), one column per sample
+			 */
+			DllExport void	calculateGradients(const Mat& input, const Mat& gt);
+			/**
+			 * @brief Returns the gradient of the weights of a layer
+			 * @param layer The index of the layer, starting from 1 for the first layer after the input layer
+			 * @return The gradient, calculated by the last calculateGradients() or train() call: Mat(size: the size of the weights of the layer; type: CV_32FC1)
+			 */
+			DllExport Mat	getGradient(size_t layer) const { return m_vWorkspaces.at(0).vGradients.at(layer - 1); }
+
+
+		private:
+			static const int MIN_SHARD_SIZE;		///< The minimal number of samples in one shard
+
+			/// Workspace of a shard
+			struct Workspace {
+				Mat			gt;						///< The expected output values of the shard
+				vec_mat_t	vNetValues;				///< The net values of the layers 0, 1, ...
+				vec_mat_t	vValues;				///< The values of the layers 0, 1, ...
+				vec_mat_t	vDeltas;				///< The errors of the layers 1, 2, ...
+				vec_mat_t	vDeltasT;				///< The transposed errors
+				vec_mat_t	vGradients;				///< The sums of the gradients of the weights of the layers 1, 2, ... over the samples of the shard
+			};
+
+			void	process(Workspace& ws) const;
+
+
+		private:
+			CPerceptron				& m_perceptron;			///< The perceptron
+			size_t					  m_maxShards;			///< The maximal number of shards
+			std::vector<Workspace>	  m_vWorkspaces;		///< The workspaces of the shards
+			vec_mat_t				  m_vWeightsT;			///< The transposed weights of the layers 1, 2, ..., shared by the shards
+		};
+	}
+}
@@ -0,0 +1,123 @@
+#include "QuantizedPerceptron.h"
+#include "DGM/parallel.h"
+#include "DGM/simd.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels {
+	namespace dnn {
+		// Constants
+		const int CQuantizedPerceptron::BATCH_SIZE = 256;
+
+		namespace {
+			// Applies the activation function to the net values of the samples, stored row-wise
+			void activate(Activation activation, const Mat& netValues, Mat& values)
+			{
+				values.create(netValues.size(), CV_32FC1);
+				if (activation != Activation::softmax) {
+					for (int y = 0; y < values.rows; y++)
+						activation::apply(activation, netValues.ptr<float>(y), values.ptr<float>(y), values.cols);
+					return;
+				}
+				const Mat netValuesT = netValues.t();
+				Mat valuesT(netValuesT.size(), CV_32FC1);
+				activation::softmax(netValuesT, valuesT);
+				transpose(valuesT, values);
+			}
+		}
+
+		// Constructor
+		CQuantizedPerceptron::CQuantizedPerceptron(const CPerceptron& perceptron, const Mat& calibration, float inputScale)
+		{
+			const size_t nLayers = perceptron.getNumLayers();
+
+			// Assertions
+			DGM_ASSERT_MSG(nLayers >= 2, "Percepton must contain at least 2 layers");
+			DGM_ASSERT(calibration.type() == CV_8UC1);
+			DGM_ASSERT(calibration.cols == perceptron.getLayer(0)->getNumNeurons());
+			DGM_ASSERT_MSG(perceptron.getLayer(0)->getActivation() == Activation::linear, "The input layer must have the linear activation function");
+
+			// The values of the calibration samples are propagated through the original network row-wise: values_l = f(values_(l-1) x weights_l)
+			Mat values;
+			calibration.convertTo(values, CV_32FC1, inputScale);
+			float	inScale	= inputScale;
+			int		inZero	= 0;
+			m_vLayers.resize(nLayers - 1);
+			for (size_t l = 1; l < nLayers; l++) {
+				Layer		& layer		= m_vLayers[l - 1];
+				const Mat	  weights	= perceptron.getLayer(l)->getWeights();
+				layer.activation = perceptron.getLayer(l)->getActivation();
+				DGM_ASSERT_MSG(layer.activation != Activation::custom, "The custom activation functions are not supported");
+
+				// Weights
+				double maxWeight;
+				minMaxLoc(abs(weights), NULL, &maxWeight);
+				const float weightScale = maxWeight > 0 ? static_cast<float>(maxWeight / 127) : 1.0f;
+				Mat(weights.t()).convertTo(layer.weights, CV_8SC1, 1.0 / weightScale);
+				layer.scale = weightScale * inScale;
+				layer.vOffsets.resize(layer.weights.rows);
+				for (int j = 0; j < layer.weights.rows; j++)
+					layer.vOffsets[j] = inZero * static_cast<int>(sum(layer.weights.row(j))[0]);
+
+				// Values
+				Mat netValues;
+				parallel::gemm(values, weights, 1, Mat(), 0, netValues);
+				activate(layer.activation, netValues, values);
+				if (l < nLayers - 1) {
+					double minValue, maxValue;
+					minMaxLoc(values, &minValue, &maxValue);
+					minValue = MIN(minValue, 0);
+					maxValue = MAX(maxValue, 0);
+					layer.outputScale		= maxValue > minValue ? static_cast<float>((maxValue - minValue) / 255) : 1.0f;
+					layer.outputZeroPoint	= MIN(255, MAX(0, static_cast<int>(std::round(-minValue / layer.outputScale))));
+					inScale	= layer.outputScale;
+					inZero	= layer.outputZeroPoint;
+				}
+				else {
+					layer.outputScale		= 1.0f;
+					layer.outputZeroPoint	= 0;
+				}
+			} // l
+		}
+
+		Mat CQuantizedPerceptron::getPrediction(const Mat& input) const
+		{
+			// Assertions
+			DGM_ASSERT(input.type() == CV_8UC1);
+			DGM_ASSERT(input.cols == m_vLayers.front().weights.cols);
+
+			Mat res(input.rows, m_vLayers.back().weights.rows, CV_32FC1);
+			const int nBatches = (input.rows + BATCH_SIZE - 1) / BATCH_SIZE;
+			parallel::parallelFor(Range(0, nBatches), [&](const Range& range) {
+				Mat			netValues, values, q;
+				vec_int_t	vAcc;
+				for (int b = range.start; b < range.end; b++) {
+					const Range rows(b * BATCH_SIZE, MIN((b + 1) * BATCH_SIZE, input.rows));
+					Mat src = input.rowRange(rows);
+					for (size_t l = 0; l < m_vLayers.size(); l++) {
+						const Layer &layer	= m_vLayers[l];
+						const int	 nOut	= layer.weights.rows;
+						netValues.create(src.rows, nOut, CV_32FC1);
+						vAcc.resize(nOut);
+						for (int i = 0; i < src.rows; i++) {
+							simd::dotU8S8(src.ptr<byte>(i), layer.weights.ptr<int8_t>(), static_cast<int>(layer.weights.step), nOut, layer.weights.cols, vAcc.data());
+							float *pNetValues = netValues.ptr<float>(i);
+							for (int j = 0; j < nOut; j++) pNetValues[j] = layer.scale * (vAcc[j] - layer.vOffsets[j]);
+						} // i
+
+						if (l == m_vLayers.size() - 1) {
+							Mat dst = res.rowRange(rows);
+							activate(layer.activation, netValues, dst);
+						}
+						else {
+							activate(layer.activation, netValues, values);
+							values.convertTo(q, CV_8UC1, 1.0 / layer.outputScale, layer.outputZeroPoint);
+							src = q;
+						}
+					} // l
+				} // b
+			}, 1);
+
+			return res;
+		}
+	}
+}
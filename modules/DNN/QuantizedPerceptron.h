@@ -0,0 +1,66 @@
+// Quantized perceptron class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "Perceptron.h"
+
+namespace DirectGraphicalModels {
+	namespace dnn {
+		/**
+		 * @brief Perceptron with 8-bit integer weights for the inference
+		 * @details This class is produced from a trained @ref CPerceptron with post-training quantization:
+		 * - the weights of every layer are quantized symmetrically to \a int8 with one scale per layer: \f$w \approx s_w q_w\f$, \f$q_w\in[-127; 127]\f$;
+		 * - the values of every hidden layer are quantized asymmetrically to \a uint8: \f$x \approx s_x (q_x - z_x)\f$, where the scale \f$s_x\f$ and the zero point \f$z_x\f$
+		 * are derived from the range of the values, observed on the calibration samples;
+		 * - the input values are the \a uint8 features, \a e.g. produced by the FEX module, with the given scale and zero point 0.
+		 *
+		 * The net values are accumulated exactly in 32-bit integers with the vectorized dot products (ref. simd::dotU8S8()) and converted to floats only for the activation functions.
+		 * The output values are returned as floats. The quantized network does not refer to the original one; its weights take 4 times less memory.
+		 * @note The accuracy of the quantized network should be checked against the original one on the validation data, \a e.g. by comparing the predicted classes
+		 * @author Sergey G. Kosov, sergey.kosov@project-10.de
+		 */
+		class CQuantizedPerceptron {
+		public:
+			/**
+			 * @brief Constructor
+			 * @param perceptron The trained perceptron. Its input layer must have the linear activation function, and the other layers - the built-in activation functions
+			 * @param calibration The calibration samples: Mat(size: nSamples x nInputs; type: CV_8UC1), one row per sample.
+			 * These should be a representative subset of the training samples.
+			 * @param inputScale The scale of the input values: the input values of the perceptron are \f$inputScale \cdot calibration\f$
+			 */
+			DllExport CQuantizedPerceptron(const CPerceptron& perceptron, const Mat& calibration, float inputScale = 1.0f / 255);
+			DllExport CQuantizedPerceptron(const CQuantizedPerceptron&) = delete;
+			DllExport ~CQuantizedPerceptron(void) = default;
+
+			DllExport bool operator=(const CQuantizedPerceptron&) = delete;
+
+			/**
+			 * @brief Calculates the output values of the network
+			 * @details Unlike CPerceptron::getPrediction(), the samples are stored row-wise, and this function does not change the state of the object,
+			 * thus it may be called concurrently.
+			 * > This function supports PPL.
+			 * @param input The input values: Mat(size: nSamples x nInputs; type: CV_8UC1), one row per sample
+			 * @return The output values: Mat(size: nSamples x nOutputs; type: CV_32FC1), one row per sample
+			 */
+			DllExport Mat	getPrediction(const Mat& input) const;
+
+
+		private:
+			/// Quantized layer
+			struct Layer {
+				Activation	activation;				///< The activation function
+				Mat			weights;				///< The quantized transposed weights: Mat(size: numNeurons x numConnections; type: CV_8SC1)
+				vec_int_t	vOffsets;				///< The sums of the quantized weights of every neuron, multiplied with the zero point of the input values
+				float		scale;					///< The scale of the weights multiplied with the scale of the input values
+				float		outputScale;			///< The scale of the output values (for the hidden layers)
+				int			outputZeroPoint;		///< The zero point of the output values (for the hidden layers)
+			};
+
+			static const int BATCH_SIZE;			///< The number of samples, processed by one thread at once
+
+
+		private:
+			std::vector<Layer>	m_vLayers;			///< The quantized layers 1, 2, ...
+		};
+	}
+}
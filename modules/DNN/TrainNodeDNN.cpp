@@ -0,0 +1,264 @@
+#include "TrainNodeDNN.h"
+#include "PerceptronTrainer.h"
+#include "DGM/SamplesAccumulator.h"
+#include "DGM/parallel.h"
+#include "DGM/random.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels
+{
+	namespace {
+		// Registers the node trainer in the CTrainNode::create() factory method, when the module is loaded
+		const bool isRegistered = (CTrainNode::registerModel(NodeRandomModel::DNN, [](byte nStates, word nFeatures) {
+			return std::make_shared<CTrainNodeDNN>(nStates, nFeatures);
+		}), true);
+	}
+
+	// Constructor
+	CTrainNodeDNN::CTrainNodeDNN(byte nStates, word nFeatures, TrainNodeDNNParams params) : CBaseRandomModel(nStates), CTrainNode(nStates, nFeatures), m_params(params)
+	{
+		m_pSamplesAcc = new CSamplesAccumulator(m_nStates, m_params.maxSamples);
+		init();
+	}
+
+	// Constructor
+	CTrainNodeDNN::CTrainNodeDNN(byte nStates, word nFeatures, size_t maxSamples) : CBaseRandomModel(nStates), CTrainNode(nStates, nFeatures), m_params(TRAIN_NODE_DNN_PARAMS_DEFAULT)
+	{
+		m_params.maxSamples = maxSamples;
+		m_pSamplesAcc = new CSamplesAccumulator(m_nStates, m_params.maxSamples);
+		init();
+	}
+
+	// Destructor
+	CTrainNodeDNN::~CTrainNodeDNN(void)
+	{
+		delete m_pSamplesAcc;
+	}
+
+	void CTrainNodeDNN::reset(void)
+	{
+		m_pSamplesAcc->reset();
+		init();
+	}
+
+	void CTrainNodeDNN::addFeatureVec(const Mat &featureVector, byte gt)
+	{
+		m_pSamplesAcc->addSample(featureVector, gt);
+	}
+
+	void CTrainNodeDNN::addFeatureVecBlock(const Mat &featureVectors, const Mat &gt)
+	{
+		m_pSamplesAcc->addSamples(featureVectors, gt);
+	}
+
+	std::shared_ptr<CTrainNode> CTrainNodeDNN::createWorker(void) const
+	{
+		return std::make_shared<CTrainNodeDNN>(m_nStates, getNumFeatures(), m_params);
+	}
+
+	void CTrainNodeDNN::merge(CTrainNode &worker)
+	{
+		m_pSamplesAcc->merge(*dynamic_cast<CTrainNodeDNN &>(worker).m_pSamplesAcc);
+	}
+
+	void CTrainNodeDNN::train(bool doClean)
+	{
+		const int nFeatures = getNumFeatures();
+#ifdef DEBUG_PRINT_INFO
+		printf("\n");
+#endif
+		// Filling the <samples> and <classes>: one row per sample, the last column is the bias
+		int nSamples = 0;
+		for (byte s = 0; s < m_nStates; s++) nSamples += m_pSamplesAcc->getNumSamples(s);
+		if (nSamples == 0) return;
+
+		Mat			samples(nSamples, nFeatures + 1, CV_32FC1);
+		vec_byte_t	classes(nSamples);
+		for (int i = 0, s = 0; s < m_nStates; s++) {				// states
+			const int nStateSamples = m_pSamplesAcc->getNumSamples(s);
+#ifdef DEBUG_PRINT_INFO
+			printf("State[%d] - %d of %d samples\n", s, nStateSamples, m_pSamplesAcc->getNumInputSamples(s));
+#endif
+			if (nStateSamples) {
+				Mat dst = samples(Rect(0, i, nFeatures, nStateSamples));
+				m_pSamplesAcc->getSamplesContainer(s).convertTo(dst, CV_32FC1, 1.0 / 255);
+				std::fill_n(classes.begin() + i, nStateSamples, static_cast<byte>(s));
+				i += nStateSamples;
+			}
+			if (doClean) m_pSamplesAcc->release(s);				// free memory
+		} // s
+		samples.col(nFeatures).setTo(1.0f);
+
+		// Training
+		vec_int_t vIndexes(nSamples);
+		for (int i = 0; i < nSamples; i++) vIndexes[i] = i;
+
+		const int batchSize = MAX(1, m_params.batchSize);
+		dnn::CPerceptronTrainer trainer(*m_pPerceptron);			// splits the mini-batches between the threads
+		Mat batch, batchT, gt;
+		std::vector<std::pair<Mat, Mat>> vMoments;					// the first and the second moments of the gradients for Adam
+		int t = 0;
+		for (int epoch = 0; epoch < m_params.numEpochs; epoch++) {
+			for (int i = nSamples - 1; i > 0; i--) std::swap(vIndexes[i], vIndexes[random::u<int>(0, i)]);
+			for (int b = 0; b < nSamples; b += batchSize) {
+				const int n = MIN(batchSize, nSamples - b);
+				batch.create(n, nFeatures + 1, CV_32FC1);
+				gt.create(m_nStates, n, CV_32FC1);
+				gt.setTo(0);
+				for (int j = 0; j < n; j++) {
+					const int idx = vIndexes[b + j];
+					samples.row(idx).copyTo(batch.row(j));
+					gt.at<float>(classes[idx], j) = 1.0f;
+				} // j
+				transpose(batch, batchT);
+
+				if (m_params.optimizer == Optimizer::SGD)
+					trainer.train(batchT, gt, m_params.learningRate);
+				else {
+					trainer.calculateGradients(batchT, gt);
+					updateAdam(trainer, vMoments, ++t);
+				}
+			} // b
+		} // epoch
+	}
+
+	void CTrainNodeDNN::saveFile(FILE *pFile) const
+	{
+		// m_params
+		fwrite(&m_params.numLayers, sizeof(word), 1, pFile);
+		fwrite(&m_params.numNeurons, sizeof(word), 1, pFile);
+		fwrite(&m_params.optimizer, sizeof(Optimizer), 1, pFile);
+		fwrite(&m_params.learningRate, sizeof(float), 1, pFile);
+		fwrite(&m_params.batchSize, sizeof(int), 1, pFile);
+		fwrite(&m_params.numEpochs, sizeof(int), 1, pFile);
+
+		// m_pPerceptron
+		for (size_t l = 1; l < m_pPerceptron->getNumLayers(); l++) {
+			Mat weights = m_pPerceptron->getLayer(l)->getWeights();
+			for (int y = 0; y < weights.rows; y++)
+				fwrite(weights.ptr<float>(y), sizeof(float), weights.cols, pFile);
+		} // l
+	}
+
+	void CTrainNodeDNN::loadFile(FILE *pFile)
+	{
+		// m_params: the parameters are applied only if the whole header has been read
+		TrainNodeDNNParams params = m_params;
+		bool res = true;
+		res = res && fread(&params.numLayers, sizeof(word), 1, pFile) == 1;
+		res = res && fread(&params.numNeurons, sizeof(word), 1, pFile) == 1;
+		res = res && fread(&params.optimizer, sizeof(Optimizer), 1, pFile) == 1;
+		res = res && fread(&params.learningRate, sizeof(float), 1, pFile) == 1;
+		res = res && fread(&params.batchSize, sizeof(int), 1, pFile) == 1;
+		res = res && fread(&params.numEpochs, sizeof(int), 1, pFile) == 1;
+		DGM_ASSERT_MSG(res, "The file is truncated: the parameters of the perceptron can not be read");
+		DGM_ASSERT_MSG(params.numLayers >= 2 && (params.numLayers == 2 || params.numNeurons > 0) && params.optimizer <= Optimizer::Adam, "The file is corrupted: wrong parameters of the perceptron");
+		m_params = params;
+
+		// m_pPerceptron
+		init();
+		for (size_t l = 1; l < m_pPerceptron->getNumLayers(); l++) {
+			Mat weights = m_pPerceptron->getLayer(l)->getWeights();
+			for (int y = 0; y < weights.rows; y++) {
+				const size_t nRead = fread(weights.ptr<float>(y), sizeof(float), weights.cols, pFile);
+				DGM_ASSERT_MSG(nRead == static_cast<size_t>(weights.cols), "The file is corrupted or has been saved for another number of features");
+			}
+		} // l
+	}
+
+	void CTrainNodeDNN::calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const
+	{
+		Mat potentials;
+		calculateNodePotentials(Mat(featureVector.t()), potentials);
+		for (byte s = 0; s < m_nStates; s++) potential.at<float>(s, 0) = potentials.at<float>(0, s);
+	}
+
+	// The samples are stored row-wise, thus the weights are used without transposition: values_l = f(values_(l-1) x weights_l)
+	void CTrainNodeDNN::calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const
+	{
+		const int nFeatures = getNumFeatures();
+
+		Mat values(featureMatrix.rows, nFeatures + 1, CV_32FC1);
+		Mat dst = values.colRange(0, nFeatures);
+		featureMatrix.convertTo(dst, CV_32FC1, 1.0 / 255);
+		values.col(nFeatures).setTo(1.0f);
+
+		Mat netValues;
+		for (size_t l = 1; l < m_pPerceptron->getNumLayers(); l++) {
+			const dnn::ptr_nl_t	pLayer		= m_pPerceptron->getLayer(l);
+			const dnn::Activation	activation	= pLayer->getActivation();
+			if (activation == dnn::Activation::softmax) {
+				parallel::gemm(values, pLayer->getWeights(), 1, Mat(), 0, netValues);
+				Mat netValuesT = netValues.t();
+				Mat valuesT(netValuesT.size(), CV_32FC1);
+				dnn::activation::softmax(netValuesT, valuesT);
+				transpose(valuesT, netValues);
+			}
+			else
+				parallel::gemm(values, pLayer->getWeights(), 1, Mat(), 0, netValues, [&](const Rect &tile) {
+					for (int y = tile.y; y < tile.y + tile.height; y++) {
+						float *pValues = netValues.ptr<float>(y) + tile.x;
+						dnn::activation::apply(activation, pValues, pValues, tile.width);
+					}
+				});
+			std::swap(values, netValues);
+		} // l
+
+		potentials = values;
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	// The weights are initialized with the He uniform distribution
+	void CTrainNodeDNN::init(void)
+	{
+		DGM_ASSERT_MSG(m_params.numLayers >= 2, "The perceptron must contain at least 2 layers");
+
+		std::vector<dnn::ptr_nl_t> vpLayers;
+		vpLayers.push_back(std::make_shared<dnn::CNeuronLayer>(getNumFeatures() + 1, 0, dnn::Activation::linear));
+		for (word l = 1; l < m_params.numLayers - 1; l++)
+			vpLayers.push_back(std::make_shared<dnn::CNeuronLayer>(m_params.numNeurons, vpLayers.back()->getNumNeurons(), dnn::Activation::relu));
+		vpLayers.push_back(std::make_shared<dnn::CNeuronLayer>(m_nStates, vpLayers.back()->getNumNeurons(), dnn::Activation::softmax));
+
+		for (size_t l = 1; l < vpLayers.size(); l++) {
+			vpLayers[l]->generateRandomWeights();						// U(-0.5; 0.5)
+			Mat weights = vpLayers[l]->getWeights();
+			weights *= 2 * sqrt(6.0 / weights.rows);
+		} // l
+
+		m_pPerceptron = std::make_unique<dnn::CPerceptron>(vpLayers);
+	}
+
+	void CTrainNodeDNN::updateAdam(const dnn::CPerceptronTrainer &trainer, std::vector<std::pair<Mat, Mat>> &vMoments, int t)
+	{
+		const float beta1	= 0.9f;
+		const float beta2	= 0.999f;
+		const float epsilon = 1e-8f;
+		const float alpha	= m_params.learningRate * sqrtf(1 - powf(beta2, static_cast<float>(t))) / (1 - powf(beta1, static_cast<float>(t)));
+
+		vMoments.resize(m_pPerceptron->getNumLayers() - 1);
+		for (size_t l = 1; l < m_pPerceptron->getNumLayers(); l++) {
+			const Mat	 gradient = trainer.getGradient(l);
+			Mat			 weights  = m_pPerceptron->getLayer(l)->getWeights();
+			Mat			&m		  = vMoments[l - 1].first;
+			Mat			&v		  = vMoments[l - 1].second;
+			if (m.empty()) {
+				m = Mat(weights.size(), CV_32FC1, Scalar(0));
+				v = Mat(weights.size(), CV_32FC1, Scalar(0));
+			}
+
+			parallel::parallelFor(Range(0, weights.rows), [&](const Range &range) {
+				for (int y = range.start; y < range.end; y++) {
+					const float	* pGradient = gradient.ptr<float>(y);
+					float		* pWeights	= weights.ptr<float>(y);
+					float		* pM		= m.ptr<float>(y);
+					float		* pV		= v.ptr<float>(y);
+					for (int x = 0; x < weights.cols; x++) {
+						pM[x] = beta1 * pM[x] + (1 - beta1) * pGradient[x];
+						pV[x] = beta2 * pV[x] + (1 - beta2) * pGradient[x] * pGradient[x];
+						pWeights[x] -= alpha * pM[x] / (sqrtf(pV[x]) + epsilon);
+					} // x
+				} // y
+			});
+		} // l
+	}
+}
@@ -0,0 +1,103 @@
+// Multilayer perceptron training class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "DGM/TrainNode.h"
+#include "Perceptron.h"
+
+namespace DirectGraphicalModels
+{
+	class CSamplesAccumulator;
+	namespace dnn { class CPerceptronTrainer; }
+
+	/// Optimizers of the perceptron weights
+	enum class Optimizer : byte {
+		SGD,				///< Mini-batch stochastic gradient descent
+		Adam				///< Adaptive moment estimation
+	};
+
+	///@brief Multilayer perceptron parameters
+	typedef struct TrainNodeDNNParams {
+		word		numLayers;						///< Number of layers of neurons, including the input and the output layers (at least 2)
+		word		numNeurons;						///< Number of neurons in every hidden layer
+		Optimizer	optimizer;						///< Optimizer of the weights (Ref. @ref Optimizer)
+		float		learningRate;					///< The learning rate
+		int			batchSize;						///< Number of samples in one mini-batch
+		int			numEpochs;						///< Number of the passes over all the training samples
+		size_t		maxSamples;						///< Maximum number of samples to be used in training. 0 means using all the samples
+
+		TrainNodeDNNParams() {}
+		TrainNodeDNNParams(word _numLayers, word _numNeurons, Optimizer _optimizer, float _learningRate, int _batchSize, int _numEpochs, size_t _maxSamples) : numLayers(_numLayers), numNeurons(_numNeurons), optimizer(_optimizer), learningRate(_learningRate), batchSize(_batchSize), numEpochs(_numEpochs), maxSamples(_maxSamples) {}
+	} TrainNodeDNNParams;
+
+	const TrainNodeDNNParams TRAIN_NODE_DNN_PARAMS_DEFAULT =	TrainNodeDNNParams(
+																	3,					// Num layers
+																	64,					// Num neurons in the hidden layers
+																	Optimizer::Adam,	// Optimizer
+																	0.001f,				// Learning rate
+																	256,				// Mini-batch size
+																	20,					// Num epochs
+																	0					// Maximum number of samples to be used in training. 0 means using all the samples
+																	);
+
+	// ====================== Multilayer Perceptron Train Class =====================
+	/**
+	* @ingroup moduleTrainNode
+	* @brief Multilayer perceptron training class
+	* @details This class implements the <a href="https://en.wikipedia.org/wiki/Multilayer_perceptron" target="blank">multilayer perceptron classifier</a>,
+	* based on the @ref dnn::CPerceptron class: the hidden layers use the ReLU and the output layer - the softmax activation functions. The features are scaled to [0; 1] and
+	* augmented with the constant feature 1, serving as the bias. The perceptron is trained by minimizing the cross-entropy loss with either the stochastic gradient descent or
+	* the Adam optimizer, on the shuffled mini-batches of the samples, accumulated with the @ref CSamplesAccumulator; every mini-batch is split between the threads (Ref. @ref dnn::CPerceptronTrainer). The node potentials are predicted for the blocks of
+	* feature vectors at once, with one matrix-matrix product per layer.
+	*
+	* This class is registered in the CTrainNode::create() factory method as NodeRandomModel::DNN, when the DNN module is loaded.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CTrainNodeDNN : public CTrainNode {
+	public:
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param nFeatures Number of features
+		* @param params Perceptron parameters (Ref. @ref TrainNodeDNNParams)
+		*/
+		DllExport CTrainNodeDNN(byte nStates, word nFeatures, TrainNodeDNNParams params = TRAIN_NODE_DNN_PARAMS_DEFAULT);
+		/**
+		* @brief Constructor
+		* @param nStates Number of states (classes)
+		* @param nFeatures Number of features
+		* @param maxSamples Maximum number of samples to be used in training
+		* > Default value \b 0 means using all the samples.<br>
+		* > If another value is specified, the class for training will use \b maxSamples random samples from the whole amount of samples, added via addFeatureVec() function
+		*/
+		DllExport CTrainNodeDNN(byte nStates, word nFeatures, size_t maxSamples);
+		DllExport virtual ~CTrainNodeDNN(void);
+
+		DllExport void	reset(void);
+
+		DllExport void	addFeatureVec(const Mat &featureVector, byte gt);
+
+		DllExport void	train(bool doClean = false);
+
+
+	protected:
+		DllExport void	saveFile(FILE *pFile) const;
+		DllExport void	loadFile(FILE *pFile);
+		DllExport void  calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const;
+		DllExport void  calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const;
+		DllExport void  addFeatureVecBlock(const Mat &featureVectors, const Mat &gt);
+		DllExport std::shared_ptr<CTrainNode> createWorker(void) const;
+		DllExport void  merge(CTrainNode &worker);
+
+
+	private:
+		void	init(void);																	// Creates the perceptron with the random weights
+		void	updateAdam(const dnn::CPerceptronTrainer &trainer, std::vector<std::pair<Mat, Mat>> &vMoments, int t);	// Updates the weights with the gradients of the last mini-batch
+
+
+	protected:
+		TrainNodeDNNParams					  m_params;					///< The parameters
+		std::unique_ptr<dnn::CPerceptron>	  m_pPerceptron;			///< Multilayer perceptron
+		CSamplesAccumulator					* m_pSamplesAcc;			///< Samples Accumulator
+	};
+}
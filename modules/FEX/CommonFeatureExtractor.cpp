@@ -1,49 +1,157 @@
 #include "CommonFeatureExtractor.h"
+#include "DGM/ThreadPool.h"
+#include "DGM/profiler.h"
+#include <algorithm>
+#include <array>
+#include <mutex>
 
 namespace DirectGraphicalModels { namespace fex
 {
+// Node of the lazy expression: the source image, a general stage, the HSV conversion, or a per-pixel operator of the parent node
+struct CCommonFeatureExtractor::Node {
+	enum class Kind { source, stage, hsv, channel, invert, threshold };
+
+	Node(Kind _kind, const std::shared_ptr<const Node> &_pParent, int _param = 0, stage_function_t _stage = nullptr, const Mat &_img = Mat()) 
+		: kind(_kind), pParent(_pParent), param(_param), stage(std::move(_stage)), img(_img) {}
+
+	Kind						kind;
+	std::shared_ptr<const Node>	pParent;		// the input of the node (nullptr for the source)
+	int							param;			// the channel index or the threshold of the per-pixel operators
+	stage_function_t			stage;			// the function of the stage nodes
+	Mat							img;			// the image of the source node
+	mutable Mat					hsv;			// the HSV conversion of this node, shared by all the HSV nodes, derived from it
+	mutable std::mutex			mtx;			// protects hsv
+	std::shared_ptr<CFeatureCache> pCache;		// the feature cache of the stage nodes (nullptr if the stage is not cached)
+	uint64_t					key = 0;		// the key of the stage feature in the cache
+};
+
+namespace {
+	// Returns the content hash of the dictionary. The hashes of the recent dictionaries are memoized together with their headers, which keep the buffers alive,
+	// thus a buffer is not re-used by another dictionary, while its hash is memoized
+	uint64_t hashDictionary(const Mat &D)
+	{
+		static std::mutex									mtx;
+		static std::vector<std::pair<Mat, uint64_t>>		vMemo;
+		const size_t										maxMemo = 8;
+
+		auto isSame = [&D](const Mat &m) { return m.data == D.data && m.size == D.size && m.type() == D.type() && m.step[0] == D.step[0]; };
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			for (const auto &memo : vMemo)
+				if (isSame(memo.first)) return memo.second;
+		}
+		const uint64_t res = CFeatureCache::hash(D);
+		std::lock_guard<std::mutex> lock(mtx);
+		if (std::none_of(vMemo.cbegin(), vMemo.cend(), [&isSame](const std::pair<Mat, uint64_t> &memo) { return isSame(memo.first); })) {
+			if (vMemo.size() == maxMemo) vMemo.erase(vMemo.begin());
+			vMemo.emplace_back(D, res);
+		}
+		return res;
+	}
+
+	// Applies the lookup table to the channel of the 8-bit image (to all channels if channel < 0) in one parallel pass
+	Mat applyLUT(const Mat &img, int channel, const std::array<byte, 256> &lut)
+	{
+		const int nChannels = img.channels();
+		const int cn		= channel < 0 ? nChannels : 1;
+		Mat res(img.size(), CV_8UC(cn));
+		parallel::parallelFor(Range(0, img.rows), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				const byte *pImg = img.ptr<byte>(y);
+				byte	   *pRes = res.ptr<byte>(y);
+				if (channel < 0)
+					for (int i = 0; i < img.cols * nChannels; i++) pRes[i] = lut[pImg[i]];
+				else
+					for (int x = 0; x < img.cols; x++) pRes[x] = lut[pImg[x * nChannels + channel]];
+			} // y
+		}, 16);
+		return res;
+	}
+
+	// Stretches the histogram of every channel of the 8-bit image to the full range
+	Mat stretchHistogram(const Mat &img)
+	{
+		DGM_ASSERT_MSG(img.depth() == CV_8U, "The source image must have 8-bit / channel depth");
+		Mat res;
+		vec_mat_t vChannels;
+		split(img, vChannels);
+		parallel::parallelFor(Range(0, static_cast<int>(vChannels.size())), [&vChannels](const Range& range) {
+			for (int i = range.start; i < range.end; i++) {
+				double minVal, maxVal;
+				auto c = vChannels[i];
+				minMaxLoc(c, &minVal, &maxVal);
+				double k = (maxVal > minVal) ? k = 255.0 / (maxVal - minVal) : 1.0;
+				c.convertTo(c, c.type(), k, -minVal * k);
+			}
+		});
+		merge(vChannels, res);
+		return res;
+	}
+}
+
+Mat CCommonFeatureExtractor::get(void) const
+{
+	if (!m_pNode) return m_img;
+	return m_pNode->kind == Node::Kind::hsv ? evaluate(*m_pNode).clone() : evaluate(*m_pNode);		// the shared HSV conversion must not be changed by the caller
+}
+
+CCommonFeatureExtractor CCommonFeatureExtractor::lazy(void) const
+{
+	if (m_pNode) return *this;
+	CCommonFeatureExtractor res(std::make_shared<const Node>(Node::Kind::source, nullptr, 0, nullptr, m_img));
+	res.m_pCache	= m_pCache;
+	res.m_key		= m_key;
+	return res;
+}
+
+CCommonFeatureExtractor CCommonFeatureExtractor::cache(const std::shared_ptr<CFeatureCache> &pCache) const
+{
+	CCommonFeatureExtractor res(*this);
+	res.m_pCache	= pCache;
+	res.m_key		= pCache ? CFeatureCache::hash(CFeatureCache::hash(get()), format("FEX v%u", CFeatureCache::VERSION)) : 0;
+	return res;
+}
+
+// The dictionary is hashed only for the cached extraction
+CCommonFeatureExtractor CCommonFeatureExtractor::getSparseCoding(const Mat &D, SqNeighbourhood nbhd) const
+{
+	const unsigned long long hashD = m_pCache ? hashDictionary(D) : 0;
+	return apply(format("SparseCoding %016llx ", hashD) + toString(nbhd), [=](const Mat &img) { return CSparseCoding::get(img, D, nbhd); });
+}
+
+CCommonFeatureExtractor CCommonFeatureExtractor::getHSV(void) const
+{
+	if (m_pNode) return derive(CCommonFeatureExtractor(std::make_shared<const Node>(Node::Kind::hsv, m_pNode)), "HSV");
+	return apply("HSV", [](const Mat &img) { return CHSV::get(img); });
+}
+
 CCommonFeatureExtractor CCommonFeatureExtractor::invert(void) const
 {
+	if (m_pNode) return derive(CCommonFeatureExtractor(std::make_shared<const Node>(Node::Kind::invert, m_pNode)), "Invert");
 	Mat res;
 	bitwise_not(m_img, res);
-	return CCommonFeatureExtractor(res);
+	return derive(CCommonFeatureExtractor(res), "Invert");
 }
 
 CCommonFeatureExtractor CCommonFeatureExtractor::blur(int R) const
 {
-	Mat res;
-	R = 2 * R + 1;
-	GaussianBlur(m_img, res, cv::Size(R, R), 0.0, 0.0, BORDER_REFLECT);
-	return CCommonFeatureExtractor(res);
+	return apply(format("Blur %d", R), [R](const Mat &img) {
+		Mat res;
+		const int size = 2 * R + 1;
+		GaussianBlur(img, res, cv::Size(size, size), 0.0, 0.0, BORDER_REFLECT);
+		return res;
+	});
 }
 
 CCommonFeatureExtractor CCommonFeatureExtractor::autoContrast(void) const
 {
-	DGM_ASSERT_MSG(m_img.depth() == CV_8U, "The source image must have 8-bit / channel depth");
-	Mat res;
-	vec_mat_t vChannels;
-	split(m_img, vChannels);
-#ifdef ENABLE_PDP
-	parallel_for_(Range(0, static_cast<int>(vChannels.size())), [&vChannels](const Range& range) {
-#else
-	const Range range(0, static_cast<int>(vChannels.size()));
-#endif
-	for (int i = range.start; i < range.end; i++) {
-		double minVal, maxVal;
-		auto c = vChannels[i];
-		minMaxLoc(c, &minVal, &maxVal);
-		double k = (maxVal > minVal) ? k = 255.0 / (maxVal - minVal) : 1.0;
-		c.convertTo(c, c.type(), k, -minVal * k);
-	}
-#ifdef ENABLE_PDP
-	});
-#endif
-	merge(vChannels, res);
-	return CCommonFeatureExtractor(res);
+	return apply("AutoContrast", [](const Mat &img) { return stretchHistogram(img); });
 }
 
 CCommonFeatureExtractor CCommonFeatureExtractor::thresholding(byte threshold) const
 {
+	const std::string op = format("Threshold %d", threshold);
+	if (m_pNode) return derive(CCommonFeatureExtractor(std::make_shared<const Node>(Node::Kind::threshold, m_pNode, threshold)), op);
 	// Converting to one channel image
 	Mat res;
 	if (m_img.channels() != 1) cvtColor(m_img, res, cv::ColorConversionCodes::COLOR_RGB2GRAY);
@@ -55,17 +163,114 @@ CCommonFeatureExtractor CCommonFeatureExtractor::thresholding(byte threshold) co
 			pRes[x] = (pRes[x] > threshold) ? 225 : 0;
 	} // y
 
-	return CCommonFeatureExtractor(res);
+	return derive(CCommonFeatureExtractor(res), op);
 }
 
 CCommonFeatureExtractor CCommonFeatureExtractor::getChannel(int channel) const
 {
+	const std::string op = format("Channel %d", channel);
+	if (m_pNode) return derive(CCommonFeatureExtractor(std::make_shared<const Node>(Node::Kind::channel, m_pNode, channel)), op);
 	DGM_ASSERT_MSG(channel < m_img.channels(), "The required channel %d does not exist in the %d-channel source image", channel, m_img.channels());
 	Mat res;
 	vec_mat_t vChannels;
 	split(m_img, vChannels);
 	vChannels.at(channel).copyTo(res);
 	vChannels.clear();
-	return CCommonFeatureExtractor(res);
+	return derive(CCommonFeatureExtractor(res), op);
+}
+
+// ------------------------------ PRIVATE ------------------------------
+CCommonFeatureExtractor CCommonFeatureExtractor::apply(const std::string &op, stage_function_t stage) const
+{
+	const uint64_t key = m_pCache ? CFeatureCache::hash(m_key, op) : 0;
+#ifdef ENABLE_PROFILER
+	stage = [pName = profiler::intern(op), stage = std::move(stage)](const Mat &img) { DGM_PROFILE_ZONE(pName); return stage(img); };
+#endif
+	if (m_pNode) {
+		auto pNode		= std::make_shared<Node>(Node::Kind::stage, m_pNode, 0, std::move(stage));
+		pNode->pCache	= m_pCache;
+		pNode->key		= key;
+		return derive(CCommonFeatureExtractor(std::shared_ptr<const Node>(pNode)), op);
+	}
+	if (m_pCache) return derive(CCommonFeatureExtractor(m_pCache->get(key, [&]() { return stage(m_img); })), op);
+	return CCommonFeatureExtractor(stage(m_img));
+}
+
+// The derived extractor inherits the cache, and its key is derived from the key of this extractor and the operator
+CCommonFeatureExtractor CCommonFeatureExtractor::derive(CCommonFeatureExtractor fex, const std::string &op) const
+{
+	if (m_pCache) {
+		fex.m_pCache	= m_pCache;
+		fex.m_key		= CFeatureCache::hash(m_key, op);
+	}
+	return fex;
+}
+
+// The chain of the per-pixel operators, applied to an 8-bit image, is composed into one channel selection and one lookup table
+Mat CCommonFeatureExtractor::evaluate(const Node &node)
+{
+	switch (node.kind) {
+		case Node::Kind::source: return node.img;
+		case Node::Kind::stage:																		// the parent is not evaluated, if the stage feature is cached
+			if (node.pCache) return node.pCache->get(node.key, [&node]() { return node.stage(evaluate(*node.pParent)); });
+			return node.stage(evaluate(*node.pParent));
+		case Node::Kind::hsv: {
+			const Node &parent = *node.pParent;
+			std::lock_guard<std::mutex> lock(parent.mtx);
+			if (parent.hsv.empty()) parent.hsv = CHSV::get(evaluate(parent));
+			return parent.hsv;
+		}
+		default: break;
+	}
+
+	// The per-pixel operators from the first to the last one
+	std::vector<const Node *> vpOps;
+	const Node *pNode = &node;
+	for (; pNode->kind != Node::Kind::source && pNode->kind != Node::Kind::stage && pNode->kind != Node::Kind::hsv; pNode = pNode->pParent.get()) vpOps.push_back(pNode);
+	std::reverse(vpOps.begin(), vpOps.end());
+
+	Mat img = evaluate(*pNode);
+	if (img.depth() != CV_8U) {
+		for (const Node *pOp : vpOps) {
+			CCommonFeatureExtractor fex(img);
+			if		(pOp->kind == Node::Kind::channel)	 img = fex.getChannel(pOp->param).get();
+			else if (pOp->kind == Node::Kind::invert)	 img = fex.invert().get();
+			else										 img = fex.thresholding(static_cast<byte>(pOp->param)).get();
+		}
+		return img;
+	}
+
+	std::array<byte, 256> lut;
+	for (int i = 0; i < 256; i++) lut[i] = static_cast<byte>(i);
+	int  channel	= -1;
+	bool isIdentity	= true;
+	for (const Node *pOp : vpOps) {
+		const int nChannels = channel < 0 ? img.channels() : 1;
+		switch (pOp->kind) {
+			case Node::Kind::channel:
+				DGM_ASSERT_MSG(pOp->param < nChannels, "The required channel %d does not exist in the %d-channel source image", pOp->param, nChannels);
+				if (channel < 0 && nChannels > 1) channel = pOp->param;
+				break;
+			case Node::Kind::invert:
+				for (byte &val : lut) val = 255 - val;
+				isIdentity = false;
+				break;
+			default:
+				if (nChannels != 1) {														// the conversion to the gray image is not a per-pixel operator of a channel
+					if (!isIdentity || channel >= 0) img = applyLUT(img, channel, lut);
+					img = CCommonFeatureExtractor(img).thresholding(static_cast<byte>(pOp->param)).get();
+					for (int i = 0; i < 256; i++) lut[i] = static_cast<byte>(i);
+					channel		= -1;
+					isIdentity	= true;
+				}
+				else {
+					for (byte &val : lut) val = val > pOp->param ? 225 : 0;
+					isIdentity = false;
+				}
+				break;
+		}
+	} // pOp
+
+	return isIdentity && channel < 0 ? img.clone() : applyLUT(img, channel, lut);						// getChannel(0) of a single-channel image is a copy, as in the eager mode
 }
 } }
\ No newline at end of file
@@ -11,11 +11,15 @@
 #include "Distance.h"
 #include "HOG.h"
 #include "SIFT.h"
+#include "GradientDescriptors.h"
 #include "Variance.h"
 #include "Scale.h"
 #include "SparseCoding.h"
 #include "GlobalFeatureExtractor.h"
+#include "FeatureCache.h"
 #include "macroses.h"
+#include <functional>
+#include <memory>
 
 namespace DirectGraphicalModels { namespace fex
 {
@@ -47,6 +51,16 @@ namespace DirectGraphicalModels { namespace fex
 	* Mat    intesity   = fex.getIntensity().reScale(sqNeighbourhood(2)).get(); // Intencity feature, calculated at scale of window size 5 x 5 pixels
 	* size_t nLines     = fex.autoContrast().toGlobal().getNumLines();          // Global-feature: quantity of straight lines in image
 	* @endcode
+	* By default every call of the chain extracts the whole intermediate feature image. The lazy extractor, returned by lazy(), only records the chain, 
+	* which is evaluated, when get() is called: the consecutive per-pixel operators (getChannel(), invert() and thresholding() of single-channel features) 
+	* are fused into a single parallel pass over the image rows, and the HSV conversion is shared by all the chains, derived from the same extractor:
+	* @code
+	* CCommonFeatureExtractor lazy = CCommonFeatureExtractor(img).lazy();
+	* Mat    hue        = lazy.getHue().get();                                  // One HSV conversion and one fused pass
+	* Mat    saturation = lazy.getSaturation().invert().get();                  // The HSV image is reused; channel extraction and inversion are fused
+	* @endcode
+	* The extractor, returned by cache(), looks every extracted feature up in a @ref CFeatureCache before extracting it, so that the repeated runs of the same chains
+	* on the same images skip the feature extraction. In the lazy mode, the chain is evaluated only from the last cached feature on.
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/			
 	class CCommonFeatureExtractor : public ILocalFeatureExtractor
@@ -63,51 +77,76 @@ namespace DirectGraphicalModels { namespace fex
 		* @brief Returns the input image.
 		* @returns The input image.
 		*/
-		DllExport Mat virtual get(void) const { return m_img; }
+		DllExport Mat virtual get(void) const;
+		/**
+		* @brief Switches to the lazy evaluation
+		* @details The returned extractor and all the extractors, derived from it, record the calls of the chain instead of extracting the features. 
+		* The chain is evaluated when get() is called. The HSV conversions (ref. getHSV(), getHue(), getSaturation(), getBrightness()) are evaluated once per
+		* extractor and shared between the chains, derived from it.
+		* > The lazy extractors may be evaluated concurrently
+		* @return The lazy common feature extractor with the same feature
+		*/
+		DllExport CCommonFeatureExtractor lazy(void) const;
+		/**
+		* @brief Checks whether the extractor is lazy
+		* @retval true if the calls are recorded and evaluated in get() (ref. lazy())
+		* @retval false if every call extracts the feature immediately
+		*/
+		DllExport bool			isLazy(void) const { return m_pNode != nullptr; }
+		/**
+		* @brief Switches to the cached extraction
+		* @details The returned extractor and all the extractors, derived from it, take the features from the cache, if they are found there, and add the extracted features to the cache otherwise.
+		* The key of a feature is derived from the content hash of the current feature image and from the names and the parameters of the following calls of the chain, 
+		* thus this function should be called at the beginning of the chain. The keys are salted with the version of the extractors (ref. CFeatureCache::VERSION).
+		* > The per-pixel operators (getChannel(), invert() and thresholding()) are not cached, but they contribute to the keys of the following features
+		* @param pCache The feature cache
+		* @return The cached common feature extractor with the same feature
+		*/
+		DllExport CCommonFeatureExtractor cache(const std::shared_ptr<CFeatureCache> &pCache) const;
 
 		/**
 		* @brief Allows for global-features extraction
 		* @returns The base global feature extractor class
 		*/
-		DllExport CGlobalFeatureExtractor toGlobal(void) const { return CGlobalFeatureExtractor(m_img); }
+		DllExport CGlobalFeatureExtractor toGlobal(void) const { return CGlobalFeatureExtractor(get()); }
 		/**
 		* @brief Extracts a coordinate feature.
 		* @details This function calculates the coordinate feature of image pixels, based inly on theirs coordinates.
 		* @param type Type of the coordinate feature (Ref. @ref coordinateType).
 		* @return Common feature extractor class with extracted coordinate feature of type \b CV_8UC1.
 		*/		
-		DllExport CCommonFeatureExtractor getCoordinate(coordinateType type = COORDINATE_ORDINATE) const { return CCommonFeatureExtractor(CCoordinate::get(m_img, type)); }
+		DllExport CCommonFeatureExtractor getCoordinate(coordinateType type = COORDINATE_ORDINATE) const { return apply(format("Coordinate %d", type), [=](const Mat &img) { return CCoordinate::get(img, type); }); }
 		/**
 		* @brief Extracts the intesity feature.
 		* @details This function calculates the intesity of the input image as follows: \f[ intensity=weight_0\cdot img.RED+weight_1\cdot img.GREEN+weight_2\cdot img.BLUE \f]
 		* @param weight The weight coefficients, which determine the contribution of each color channel to the resulting intensity.
 		* @return Common feature extractor class with extracted intensity feature of type \b CV_8UC1.
 		*/		
-		DllExport CCommonFeatureExtractor getIntensity(cv::Scalar weight = CV_RGB(0.333, 0.333, 0.333)) const { return CCommonFeatureExtractor(CIntensity::get(m_img, weight)); }
+		DllExport CCommonFeatureExtractor getIntensity(cv::Scalar weight = CV_RGB(0.333, 0.333, 0.333)) const { return apply(format("Intensity %g %g %g", weight[0], weight[1], weight[2]), [=](const Mat &img) { return CIntensity::get(img, weight); }); }
 		/**
 		* @brief Extracts the HSV feature.
 		* @details This function transforms the input image into HSV (hue-saturation-value) color space.
 		* @return The (hue-saturation-value) feature image of type \b CV_8UC3.
 		*/
-		DllExport CCommonFeatureExtractor getHSV(void) const { return CCommonFeatureExtractor(CHSV::get(m_img)); }
+		DllExport CCommonFeatureExtractor getHSV(void) const;
 		/**
 		* @brief Extracts the hue feature.
 		* @details This function represents the input image in HSV (hue-saturation-value) color model and returns the hue channel.
 		* @return Common feature extractor class with extracted hue feature of type \b CV_8UC1.
 		*/
-		DllExport CCommonFeatureExtractor getHue(void) const { return CCommonFeatureExtractor(CHSV::get(m_img)).getChannel(CH_HUE); }
+		DllExport CCommonFeatureExtractor getHue(void) const { return getHSV().getChannel(CH_HUE); }
 		/**
 		* @brief Extracts the saturation feature.
 		* @details This function represents the input image in HSV (hue-saturation-value) color model and returns the saturation channel.
 		* @return Common feature extractor class with extracted saturation feature of type \b CV_8UC1.
 		*/
-		DllExport CCommonFeatureExtractor getSaturation(void) const { return CCommonFeatureExtractor(CHSV::get(m_img)).getChannel(CH_SATURATION); }
+		DllExport CCommonFeatureExtractor getSaturation(void) const { return getHSV().getChannel(CH_SATURATION); }
 		/**
 		* @brief Extracts the brightness feature.
 		* @details This function represents the input image in HSV (hue-saturation-value) color model and returns the value channel.
 		* @return Common feature extractor class with extracted brightness feature of type \b CV_8UC1.
 		*/
-		DllExport CCommonFeatureExtractor getBrightness(void) const { return CCommonFeatureExtractor(CHSV::get(m_img)).getChannel(CH_VALUE); }
+		DllExport CCommonFeatureExtractor getBrightness(void) const { return getHSV().getChannel(CH_VALUE); }
 		/**
 		* @brief Extracts the gradient feature.
 		* @details This function calculates the magnitude of gradient of the input image as follows: \f[gradient=\sqrt{\left(\frac{d\,img}{dx}\right)^2+\left(\frac{d\,img}{dy}\right)^2},\f]
@@ -118,7 +157,7 @@ namespace DirectGraphicalModels { namespace fex
 		* @param mid Parameter for the two-linear mapping of the feature: \f$mid\in(0;255\sqrt{2}]\f$. (Ref. @ref two_linear_mapper()). 
 		* @return Common feature extractor class with extracted gradient feature of type \b CV_8UC1.
 		*/	
-		DllExport CCommonFeatureExtractor getGradient(float mid = GRADIENT_MAX_VALUE) const { return CCommonFeatureExtractor(CGradient::get(m_img, mid)); }
+		DllExport CCommonFeatureExtractor getGradient(float mid = GRADIENT_MAX_VALUE) const { return apply(format("Gradient %g", mid), [=](const Mat &img) { return CGradient::get(img, mid); }); }
 		/**
 		* @brief Extracts the NDVI (<a href="http://en.wikipedia.org/wiki/Normalized_Difference_Vegetation_Index">normalized difference vegetation index</a>) feature.
 		* @details This function calculates the NDVI from the input image as follows: \f[ NDVI=\frac{NIR-VIS}{NIR+VIS},\f] 
@@ -135,7 +174,7 @@ namespace DirectGraphicalModels { namespace fex
 		* > - 255 - cut off the positive NDVI values.
 		* @return Common feature extractor class with extracted NDVI feature of type \b CV_8UC1.
 		*/	
-		DllExport CCommonFeatureExtractor getNDVI(byte midPoint = 127) const  { return CCommonFeatureExtractor(CNDVI::get(m_img, midPoint)); }
+		DllExport CCommonFeatureExtractor getNDVI(byte midPoint = 127) const  { return apply(format("NDVI %d", midPoint), [=](const Mat &img) { return CNDVI::get(img, midPoint); }); }
 		/**
 		* @brief Extracts the distance feature.
 		* @details For each pixel of the source image this function calculates the distance to the closest pixel, which value is larger or equal to \b threshold. 
@@ -144,7 +183,7 @@ namespace DirectGraphicalModels { namespace fex
 		* @param multiplier Amplification coefficient for the resulting feature image.
 		* @return Common feature extractor class with extracted distance feature of type \b CV_8UC1.
 		*/
-		DllExport CCommonFeatureExtractor getDistance(byte threshold = 16, double multiplier = 4.0) const { return CCommonFeatureExtractor(CDistance::get(m_img, threshold, multiplier)); }
+		DllExport CCommonFeatureExtractor getDistance(byte threshold = 16, double multiplier = 4.0) const { return apply(format("Distance %d %g", threshold, multiplier), [=](const Mat &img) { return CDistance::get(img, threshold, multiplier); }); }
 		/**
 		* @brief Extracts the HOG (<a href="http://en.wikipedia.org/wiki/Histogram_of_oriented_gradients"target="_blank">histogram of oriented gradients</a>) feature.
 		* @details For each pixel of the source image this function calculates the histogram of oriented gradients inside the pixel's neighbourhood \b nbhd.
@@ -153,20 +192,27 @@ namespace DirectGraphicalModels { namespace fex
 		* @param nbhd Neighborhood around the pixel, where its histogram is estimated. (Ref. @ref SqNeighbourhood).
 		* @return Common feature extractor class with extracted HOG feature of type \b CV_8UC{n}, where \f$n=nBins\f$.
 		*/
-		DllExport CCommonFeatureExtractor getHOG(int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return CCommonFeatureExtractor(CHOG::get(m_img, nBins, nbhd)); }
+		DllExport CCommonFeatureExtractor getHOG(int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return apply(format("HOG %d ", nBins) + toString(nbhd), [=](const Mat &img) { return CHOG::get(img, nBins, nbhd); }); }
 		/**
 		* @brief Extracts the SIFT (<a href="https://en.wikipedia.org/wiki/Scale-invariant_feature_transform" target="_blank">scale-invariant feature transform</a>) feature.
 		* @details For each pixel of the source image this function performs the scale-invariant feature transform.
 		* @return Common feature extractor class with extracted SIFT feature of type \b CV_8UC{128}.
 		*/
-		DllExport CCommonFeatureExtractor getSIFT() const { return CCommonFeatureExtractor(CSIFT::get(m_img)); }
+		DllExport CCommonFeatureExtractor getSIFT() const { return apply("SIFT", [](const Mat &img) { return CSIFT::get(img); }); }
+		/**
+		* @brief Extracts the dense SIFT feature.
+		* @details For each pixel of the source image this function calculates the SIFT descriptor of the \f$4\times 4\f$ cells around it (Ref. CSIFT::getDense()).
+		* @param cellSize The size of a cell in pixels
+		* @return Common feature extractor class with extracted dense SIFT feature of type \b CV_8UC{128}.
+		*/
+		DllExport CCommonFeatureExtractor getDenseSIFT(int cellSize = 4) const { return apply(format("DenseSIFT %d", cellSize), [=](const Mat &img) { return CSIFT::getDense(img, cellSize); }); }
 		/**
 		* @brief Extracts the variance feature.
 		* @details For each pixel of the source image this function calculates the variance within the pixel's neighbourhood \b nbhd.
 		* @param nbhd Neighborhood around the pixel, where the variance is estimated. (Ref. @ref SqNeighbourhood).
 		* @return Common feature extractor class with extracted variance feature of type \b CV_8UC1.
 		*/		
-		DllExport CCommonFeatureExtractor getVariance(SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return CCommonFeatureExtractor(CVariance::get(m_img, nbhd)); }
+		DllExport CCommonFeatureExtractor getVariance(SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return apply("Variance " + toString(nbhd), [=](const Mat &img) { return CVariance::get(img, nbhd); }); }
 		/**
 		* @brief Extracts the sparse coding feature.
 		* @details For each pixel of the source image this function calculates the sparse coding feature within the pixel's neighbourhood \b nbhd. 
@@ -175,9 +221,10 @@ namespace DirectGraphicalModels { namespace fex
 		* > Dictionary should be learned from a training data with CSparseDictionary::train() function,<br>
 		* > or it may be loaded directed from a \a dic file with CSparseDictionary::getDictionary("dictionary.dic").
 		* @param nbhd Neighborhood around the pixel, where the feature is estimated. (Ref. @ref SqNeighbourhood).
+		* > With the cached extraction (ref. cache()), the dictionary is a part of the key: it is hashed once per dictionary buffer, thus it must not be changed in place after the first use.
 		* @return Common feature extractor class with extracted sparse coding feature of type \b CV_8UC{nWords}.
 		*/
-		DllExport CCommonFeatureExtractor getSparseCoding(const Mat &D, SqNeighbourhood nbhd = sqNeighbourhood(3)) const { return CCommonFeatureExtractor(CSparseCoding::get(m_img, D, nbhd)); }
+		DllExport CCommonFeatureExtractor getSparseCoding(const Mat &D, SqNeighbourhood nbhd = sqNeighbourhood(3)) const;
 		/**
 		* @brief Extracts the scale feature.
 		* @details For each pixel of the source image this function calculates the mean value within the pixel's neighbourhood \b nbhd.
@@ -185,7 +232,7 @@ namespace DirectGraphicalModels { namespace fex
 		* @param nbhd Neighborhood around the pixel, where the mean is estimated. (Ref. @ref SqNeighbourhood).
 		* @return Common feature extractor class with extracted scale feature of type \b CV_8UC1.
 		*/
-		DllExport CCommonFeatureExtractor reScale(SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return CCommonFeatureExtractor(CScale::get(m_img, nbhd)); }
+		DllExport CCommonFeatureExtractor reScale(SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return apply("Scale " + toString(nbhd), [=](const Mat &img) { return CScale::get(img, nbhd); }); }
 		/**
 		* @brief Inverts the source image
 		* @return Common feature extractor class with the inverted feature with the same number of channels.
@@ -217,5 +264,23 @@ namespace DirectGraphicalModels { namespace fex
 		* @return Common feature extractor class with the required channel as a feature.
 		*/
 		DllExport CCommonFeatureExtractor getChannel(int channel) const;
+
+
+	private:
+		struct Node;
+		using stage_function_t = std::function<Mat(const Mat &)>;
+
+		explicit CCommonFeatureExtractor(const std::shared_ptr<const Node> &pNode) : ILocalFeatureExtractor(Mat()), m_pNode(pNode) {}
+
+		CCommonFeatureExtractor	apply(const std::string &op, stage_function_t stage) const;
+		CCommonFeatureExtractor	derive(CCommonFeatureExtractor fex, const std::string &op) const;
+		static Mat				evaluate(const Node &node);
+		static std::string		toString(const SqNeighbourhood &nbhd) { return format("%d %d %d %d", nbhd.leftGap, nbhd.rightGap, nbhd.upperGap, nbhd.lowerGap); }
+
+
+	private:
+		std::shared_ptr<const Node>		m_pNode;		///< The last node of the recorded chain (nullptr for the eager extractor)
+		std::shared_ptr<CFeatureCache>	m_pCache;		///< The feature cache (nullptr if the features are not cached)
+		uint64_t						m_key = 0;		///< The key of the feature in the cache
 	};
 } }
\ No newline at end of file
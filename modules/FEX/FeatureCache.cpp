@@ -0,0 +1,150 @@
+#include "FeatureCache.h"
+#include "macroses.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+namespace DirectGraphicalModels { namespace fex
+{
+namespace {
+	const int MAGIC = 0x58454644;												// "DFEX"
+}
+
+bool CFeatureCache::get(uint64_t key, Mat &features)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		auto it = m_index.find(key);
+		if (it != m_index.end()) {
+			m_lEntries.splice(m_lEntries.begin(), m_lEntries, it->second);
+			features = it->second->second.clone();
+			return true;
+		}
+	}
+
+	if (m_path.empty()) return false;
+	FILE *pFile = fopen(getFileName(key).c_str(), "rb");
+	if (!pFile) return false;
+	int header[5];																// magic, version, rows, cols, type
+	bool res = fread(header, sizeof(int), 5, pFile) == 5 && header[0] == MAGIC && header[1] == static_cast<int>(VERSION)
+		&& header[2] >= 0 && header[3] >= 0 && header[4] == CV_MAT_TYPE(header[4]) && CV_MAT_DEPTH(header[4]) <= CV_64F;
+	if (res) {
+		features.create(header[2], header[3], header[4]);
+		const size_t size = features.total() * features.elemSize();
+		res = fread(features.data, 1, size, pFile) == size && fgetc(pFile) == EOF;
+	}
+	fclose(pFile);
+	DGM_IF_WARNING(!res, "The cached feature file %s is corrupted", getFileName(key).c_str());
+	if (res) {
+		std::lock_guard<std::mutex> lock(m_mtx);
+		insert(key, features);
+	}
+	return res;
+}
+
+void CFeatureCache::put(uint64_t key, const Mat &features)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		insert(key, features);
+	}
+
+	if (m_path.empty()) return;
+	const std::string fileName = getFileName(key);
+	FILE *pFile = fopen(fileName.c_str(), "rb");
+	if (pFile) {																// already stored, e.g. by another process
+		fclose(pFile);
+		return;
+	}
+
+	// The file is written under a temporary name and renamed, so that the concurrent readers never see a partial file
+	const size_t	  id		= std::hash<std::thread::id>()(std::this_thread::get_id()) ^ static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+	const std::string tmpName	= fileName + format(".%zx.tmp", id);
+	pFile = fopen(tmpName.c_str(), "wb");
+	if (!pFile) {
+		DGM_WARNING("Unable to write the cached feature file %s", tmpName.c_str());
+		return;
+	}
+	const int header[5] = { MAGIC, static_cast<int>(VERSION), features.rows, features.cols, features.type() };
+	bool res = fwrite(header, sizeof(int), 5, pFile) == 5;
+	const size_t rowSize = features.cols * features.elemSize();
+	for (int y = 0; y < features.rows && res; y++)
+		res = fwrite(features.ptr(y), 1, rowSize, pFile) == rowSize;
+	fclose(pFile);
+	if (!res || std::rename(tmpName.c_str(), fileName.c_str()) != 0) std::remove(tmpName.c_str());
+}
+
+Mat CFeatureCache::get(uint64_t key, const std::function<Mat(void)> &extract)
+{
+	Mat res;
+	if (get(key, res)) return res;
+	res = extract();
+	put(key, res);
+	return res;
+}
+
+void CFeatureCache::clear(void)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_lEntries.clear();
+	m_index.clear();
+	m_memory = 0;
+}
+
+size_t CFeatureCache::getMemoryUsage(void) const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_memory;
+}
+
+// The rows are hashed word by word with the multiply-xorshift mixing; the tail of a row byte by byte
+uint64_t CFeatureCache::hash(const Mat &img)
+{
+	const uint64_t k = 0x9E3779B97F4A7C15ULL;
+	uint64_t res = hash(0, format("%d %d %d", img.rows, img.cols, img.type()));
+	const size_t rowSize = img.cols * img.elemSize();
+	for (int y = 0; y < img.rows; y++) {
+		const byte *pImg = img.ptr<byte>(y);
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= rowSize; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, pImg + i, sizeof(uint64_t));
+			res = (res ^ word) * k;
+			res ^= res >> 32;
+		}
+		for (; i < rowSize; i++) res = (res ^ pImg[i]) * k;
+	} // y
+	return res;
+}
+
+// FNV-1a
+uint64_t CFeatureCache::hash(uint64_t seed, const std::string &str)
+{
+	uint64_t res = seed ^ 0xCBF29CE484222325ULL;
+	for (char c : str) res = (res ^ static_cast<byte>(c)) * 0x100000001B3ULL;
+	return res;
+}
+
+// ------------------------------ PRIVATE ------------------------------
+// The least recently used entries are evicted, until the memory budget is met
+void CFeatureCache::insert(uint64_t key, const Mat &features)
+{
+	const size_t size = features.total() * features.elemSize();
+	if (size > m_maxMemory || m_index.count(key)) return;
+	while (m_memory + size > m_maxMemory) {
+		const entry_t &last = m_lEntries.back();
+		m_memory -= last.second.total() * last.second.elemSize();
+		m_index.erase(last.first);
+		m_lEntries.pop_back();
+	}
+	m_lEntries.emplace_front(key, features.clone());
+	m_index[key] = m_lEntries.begin();
+	m_memory += size;
+}
+
+std::string CFeatureCache::getFileName(uint64_t key) const
+{
+	return m_path + format("/%016llx.fex", static_cast<unsigned long long>(key));
+}
+} }
@@ -0,0 +1,115 @@
+// Feature cache class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace DirectGraphicalModels { namespace fex
+{
+	// ================================ Feature Cache Class ==============================
+	/**
+	* @ingroup moduleFEX
+	* @brief Persistent cache of the feature images
+	* @details This class stores the extracted feature images, identified by 64-bit keys, in the memory and, optionally, on the disk. The key of a feature is
+	* derived from the content hash of the source image and from the names and the parameters of the extractors of the chain (Ref. hash()). 
+	* The memory cache keeps the most recently used features within the given memory budget; the disk cache keeps all the features in one directory, one binary file per feature,
+	* thus it survives the program re-runs and may be shared between the processes. The cache is used by the @ref CCommonFeatureExtractor:
+	* @code
+	* auto pCache = std::make_shared<CFeatureCache>(512 << 20, "fex_cache");
+	* Mat hog = CCommonFeatureExtractor(img).cache(pCache).getGradient().getHOG(9).get();     // Extracted on the first run, loaded from "fex_cache" on the next runs
+	* @endcode
+	* The extractors are versioned with @ref VERSION: it is mixed into every key (ref. CCommonFeatureExtractor::cache()) and stored in the header of every file
+	* of the disk cache, thus the features of an outdated extractor are never returned.
+	* > The cache may be used concurrently
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CFeatureCache
+	{
+	public:
+		/**
+		* @brief The version of the feature extractors
+		* @details It must be incremented, whenever an extractor changes its output for the same image and parameters
+		*/
+		static const uint32_t VERSION = 1;
+
+		/**
+		* @brief Constructor
+		* @param maxMemory The memory budget of the memory cache in bytes. If zero, the features are not kept in the memory
+		* @param path The directory of the disk cache. It must exist. If empty, the features are not stored on the disk
+		*/
+		DllExport CFeatureCache(size_t maxMemory = 1 << 30, const std::string &path = std::string()) : m_maxMemory(maxMemory), m_memory(0), m_path(path) {}
+		DllExport ~CFeatureCache(void) = default;
+		CFeatureCache(const CFeatureCache &) = delete;
+		const CFeatureCache & operator= (const CFeatureCache &) = delete;
+
+		/**
+		* @brief Looks the feature up
+		* @details The memory cache is checked first, and then the disk cache. The feature, found on the disk, is added to the memory cache.
+		* The files with a foreign header, with another @ref VERSION, with an invalid type or with a wrong size are ignored
+		* @param key The key of the feature
+		* @param features The copy of the cached feature image
+		* @retval true if the feature is found
+		* @retval false otherwise
+		*/
+		DllExport bool	get(uint64_t key, Mat &features);
+		/**
+		* @brief Adds the feature to the cache
+		* @param key The key of the feature
+		* @param features The feature image
+		*/
+		DllExport void	put(uint64_t key, const Mat &features);
+		/**
+		* @brief Returns the cached feature or extracts and caches it
+		* @param key The key of the feature
+		* @param extract The function, extracting the feature. It is called only if the feature is not found
+		* @return The feature image
+		*/
+		DllExport Mat	get(uint64_t key, const std::function<Mat(void)> &extract);
+		/**
+		* @brief Clears the memory cache
+		* @details The disk cache is not affected
+		*/
+		DllExport void	clear(void);
+		/**
+		* @brief Returns the memory usage of the memory cache
+		* @return The size of the feature images in the memory cache in bytes
+		*/
+		DllExport size_t getMemoryUsage(void) const;
+
+		/**
+		* @brief Returns the content hash of an image
+		* @details The hash depends on the size, the type and the pixel values of the image
+		* @param img The image
+		* @return The 64-bit hash value
+		*/
+		DllExport static uint64_t hash(const Mat &img);
+		/**
+		* @brief Combines the hash value with a string
+		* @details This function is used to derive the key of a feature from the key of its source and the description of the extractor, \a e.g. "HOG 9 5 5 5 5"
+		* @param seed The hash value
+		* @param str The string
+		* @return The 64-bit hash value
+		*/
+		DllExport static uint64_t hash(uint64_t seed, const std::string &str);
+
+
+	private:
+		using entry_t = std::pair<uint64_t, Mat>;
+
+		void		insert(uint64_t key, const Mat &features);
+		std::string	getFileName(uint64_t key) const;
+
+
+	private:
+		std::list<entry_t>											m_lEntries;		///< The memory cache: the most recently used entry first
+		std::unordered_map<uint64_t, std::list<entry_t>::iterator>	m_index;		///< The index of the memory cache
+		size_t														m_maxMemory;	///< The memory budget in bytes
+		size_t														m_memory;		///< The memory usage in bytes
+		std::string													m_path;			///< The directory of the disk cache
+		mutable std::mutex											m_mtx;			///< The mutex, protecting the memory cache
+	};
+} }
@@ -0,0 +1,60 @@
+#include "FeaturePyramid.h"
+#include "DGM/ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels { namespace fex
+{
+CFeaturePyramid::CFeaturePyramid(const Mat &img, int nOctaves)
+{
+	DGM_ASSERT(nOctaves > 0);
+	m_vOctaves.push_back(img);
+	for (int o = 1; o < nOctaves; o++) {
+		const Mat &prev = m_vOctaves.back();
+		if (prev.cols < 2 || prev.rows < 2) break;
+		Mat octave;
+		pyrDown(prev, octave);
+		m_vOctaves.push_back(octave);
+	} // o
+	DGM_IF_WARNING(static_cast<int>(m_vOctaves.size()) < nOctaves, "The image is too small for %d octaves; only %zu octaves are built", nOctaves, m_vOctaves.size());
+}
+
+// The features are interleaved in one row-parallel pass
+Mat CFeaturePyramid::get(const std::vector<extractor_function_t> &vExtractors) const
+{
+	const Size	 size		= m_vOctaves[0].size();
+	const size_t nOctaves	= m_vOctaves.size();
+	const size_t nTasks		= nOctaves * vExtractors.size();
+
+	vec_mat_t vFeatures(nTasks);
+	parallel::parallelFor(Range(0, static_cast<int>(nTasks)), [&](const Range &range) {
+		for (int t = range.start; t < range.end; t++) {
+			const Mat &octave	= m_vOctaves[t / vExtractors.size()];
+			Mat features		= vExtractors[t % vExtractors.size()](octave);
+			DGM_ASSERT_MSG(features.size() == octave.size() && features.depth() == CV_8U, "The extractor must return the 8-bit feature image of the octave size");
+			if (features.size() != size) resize(features, features, size, 0, 0, INTER_LINEAR);
+			vFeatures[t] = features;
+		} // t
+	}, 1);
+
+	std::vector<int> vOffsets(nTasks + 1, 0);
+	for (size_t t = 0; t < nTasks; t++) vOffsets[t + 1] = vOffsets[t] + vFeatures[t].channels();
+	const int nChannels = vOffsets.back();
+	DGM_ASSERT_MSG(nChannels > 0 && nChannels <= CV_CN_MAX, "Number of channels (%d) must be in range [1; %d]", nChannels, CV_CN_MAX);
+
+	Mat res(size, CV_8UC(nChannels));
+	parallel::parallelFor(Range(0, size.height), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			byte *pRes = res.ptr<byte>(y);
+			for (size_t t = 0; t < nTasks; t++) {
+				const byte *pFeature	= vFeatures[t].ptr<byte>(y);
+				const int	cn			= vFeatures[t].channels();
+				byte		*pDst		= pRes + vOffsets[t];
+				for (int x = 0; x < size.width; x++, pFeature += cn, pDst += nChannels)
+					for (int c = 0; c < cn; c++) pDst[c] = pFeature[c];
+			} // t
+		} // y
+	});
+
+	return res;
+}
+} }
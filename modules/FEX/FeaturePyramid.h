@@ -0,0 +1,69 @@
+// Feature pyramid class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+namespace DirectGraphicalModels { namespace fex
+{
+	// ================================ Feature Pyramid Class ==============================
+	/**
+	* @ingroup moduleLFEX
+	* @brief Multi-scale feature extraction class
+	* @details This class builds the Gaussian pyramid of the image once, in the constructor: every octave is the previous one, blurred and down-sampled by the factor of 2.
+	* The local feature extractors are then evaluated on every octave, and the features of all the octaves are up-sampled to the base resolution and interleaved 
+	* into one feature image, which may be passed directly to the CTrainNode::addFeatureVecs() and CTrainNode::getNodePotentials() functions:
+	* @code
+	* CFeaturePyramid pyramid(img, 3);
+	* Mat featureVectors = pyramid.get({
+	*	[](const Mat &octave) { return CCommonFeatureExtractor(octave).getIntensity().get(); },
+	*	[](const Mat &octave) { return CCommonFeatureExtractor(octave).getGradient().getHOG(9).get(); }
+	* });																							// CV_8UC{3 * (1 + 9)}
+	* nodeTrainer->addFeatureVecs(featureVectors, gt);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CFeaturePyramid
+	{
+	public:
+		/**
+		* @brief Callback function extracting a local feature
+		* @details The argument is the image of an octave; the result is the feature image of the same size and of type \b CV_8UC{n}
+		*/
+		using extractor_function_t = std::function<Mat(const Mat &)>;
+		
+		/**
+		* @brief Constructor
+		* @param img The base image of the pyramid
+		* @param nOctaves The number of octaves, including the base image
+		*/
+		DllExport CFeaturePyramid(const Mat &img, int nOctaves = 3);
+		DllExport ~CFeaturePyramid(void) = default;
+
+		/**
+		* @brief Returns the number of octaves
+		* @return The number of octaves, including the base image
+		*/
+		DllExport size_t		getNumOctaves(void) const { return m_vOctaves.size(); }
+		/**
+		* @brief Returns an octave of the pyramid
+		* @param octave The index of the octave: 0 for the base image
+		* @return The image of the octave
+		*/
+		DllExport const Mat	  & getOctave(size_t octave) const { return m_vOctaves.at(octave); }
+		/**
+		* @brief Extracts the features on every octave
+		* @details Every extractor is evaluated on every octave; all the evaluations run in parallel. The features are up-sampled to the base resolution with the bilinear interpolation
+		* and interleaved: the channels of all the extractors for the base octave go first, followed by the channels for the next octave, and so on.
+		* > This function supports PPL.
+		* @param vExtractors The feature extractors. They are called concurrently
+		* @return The multi-scale feature image: Mat(size: base image size; type: CV_8UC{n}), where \f$n=nOctaves\cdot\sum_i n_i\f$ and \f$n_i\f$ is the number of channels of the i-th extractor
+		*/
+		DllExport Mat			get(const std::vector<extractor_function_t> &vExtractors) const;
+
+
+	private:
+		vec_mat_t	m_vOctaves;			///< The octaves of the pyramid
+	};
+} }
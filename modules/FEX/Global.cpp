@@ -1,16 +1,24 @@
 #include "Global.h"
+#include "DGM/ThreadPool.h"
+#include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex { namespace global
 {
-size_t getNumLines(const Mat &img, int threshold1, int threshold2)
+// Converting to one channel image
+static Mat toGray(const Mat &img)
+{
+	Mat res;
+	if (img.channels() != 1) cvtColor(img, res, cv::ColorConversionCodes::COLOR_RGB2GRAY);
+	else res = img;
+	return res;
+}
+
+// ------------------------------ The features of the one channel image ------------------------------
+static size_t getNumLinesGray(const Mat &gray, int threshold1, int threshold2)
 {
-	// Converting to one channel image
 	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I); 
-		
-	GaussianBlur(I, I, Size(5, 5), 0.75, 0.75);		// smooth it, otherwise a lot of false circles may be detected
-	
+	GaussianBlur(gray, I, Size(5, 5), 0.75, 0.75);		// smooth it, otherwise a lot of false circles may be detected
+
 	Mat canny8b;
 	Canny(I, canny8b, threshold1 / 2, threshold1, 3);
 
@@ -33,14 +41,13 @@ size_t getNumLines(const Mat &img, int threshold1, int threshold2)
 				, canny8b.rows / 2	// max line length
 			);
 #endif
-	
+
 
 	if (false) {		// Visualization
 		imshow("Canny", canny8b);
-		
+
 		Mat tmp;
-		if (img.channels() == 1)  cvtColor(img, tmp, cv::ColorConversionCodes::COLOR_GRAY2RGB);
-		else img.copyTo(tmp);
+		cvtColor(gray, tmp, cv::ColorConversionCodes::COLOR_GRAY2RGB);
 
 #if 1
 		for (Vec2f &l : vLines) {
@@ -58,34 +65,30 @@ size_t getNumLines(const Mat &img, int threshold1, int threshold2)
 			line(tmp, pt1, pt2, CV_RGB(255, 0, 0), 1, cv::LineTypes::LINE_AA);
 		}
 #else
-		for (Vec4i &l : vLines) 
+		for (Vec4i &l : vLines)
 			line(tmp, Point(l[0], l[1]), Point(l[2], l[3]), CV_RGB(255, 0, 0), 1, cv::LineTypes::LINE_AA);
 #endif
 		imshow("detected lines", tmp);
 		waitKey();
 	}
-		
+
 	return vLines.size();
 }
 
-size_t getNumCircles(const Mat &img, int threshold1, int threshold2)
+static size_t getNumCirclesGray(const Mat &gray, int threshold1, int threshold2)
 {
-	// Converting to one channel image
 	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-
-	GaussianBlur(I, I, Size(9, 9), 2, 2);		// smooth it, otherwise a lot of false circles may be detected
+	GaussianBlur(gray, I, Size(9, 9), 2, 2);		// smooth it, otherwise a lot of false circles may be detected
 
 	std::vector<Vec3f> vCircles;
 	HoughCircles(I				// image
 		, vCircles				// circles
 		, cv::HoughModes::HOUGH_GRADIENT		// method
-		, 1						// dp 
+		, 1						// dp
 		, 1						// min distance between centers
 		, threshold1			// high treshold of the canny
 		, threshold2			// lower -> more circles
-	);	
+	);
 
 	if (false) {		// Visualization
 		Mat canny8b;
@@ -93,8 +96,7 @@ size_t getNumCircles(const Mat &img, int threshold1, int threshold2)
 		imshow("Canny", canny8b);
 
 		Mat tmp;
-		if (img.channels() == 1)  cvtColor(img, tmp, cv::ColorConversionCodes::COLOR_GRAY2RGB);
-		else img.copyTo(tmp);
+		cvtColor(gray, tmp, cv::ColorConversionCodes::COLOR_GRAY2RGB);
 
 		for (Vec3f &c : vCircles) {
 			Point center(cvRound(c[0]), cvRound(c[1]));
@@ -109,22 +111,17 @@ size_t getNumCircles(const Mat &img, int threshold1, int threshold2)
 	return vCircles.size();
 }
 
-float getOpacity(const Mat &img)
+static float getOpacityGray(const Mat &I)
 {
-	int		width	= img.cols;
-	int		height	= img.rows;
+	int		width	= I.cols;
+	int		height	= I.rows;
 	float	R		= -1.0f;
 
-	// Converting to one channel image
-	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-
 	float _mean = static_cast<float>(mean(I)[0]);
 	float res	= 0.0f;
 
 	for (int y = 0; y < height; y++) {
-		byte *pI = I.ptr<byte>(y);
+		const byte *pI = I.ptr<byte>(y);
 		for (int x = 0; x < width; x++) {
 			float dx	= x - 0.5f * width;
 			float dy	= y - 0.5f * height;
@@ -138,13 +135,8 @@ float getOpacity(const Mat &img)
 	return res / (width * height);
 }
 
-float getVariance(const Mat &img)
+static float getVarianceGray(const Mat &I)
 {
-	// Converting to one channel image
-	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-
 	Scalar mean, stddev;
 	meanStdDev(I, mean, stddev);
 	float res = static_cast<float>(stddev[0] * stddev[0]);
@@ -152,50 +144,104 @@ float getVariance(const Mat &img)
 	return res;
 }
 
-int getArea(const Mat &img)
+static int getAreaGray(const Mat &I)
 {
-	// Converting to one channel image
-	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-
 	int res = 0;
 	for (int y = 0; y < I.rows; y++) {
-		byte *pI = I.ptr<byte>(y);
+		const byte *pI = I.ptr<byte>(y);
 		for (int x = 0; x < I.cols; x++)
 			if (pI[x] > 0) res++;
 	} // y
-	
+
 	return res;
 }
 
-int getPerimeter(const Mat &img)
+// A pixel belongs to the edge if it differs from its left or upper neighbour; the first row and column are not edges
+static int getPerimeterGray(const Mat &I)
 {
-	// Converting to one channel image
-	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-
-	Mat tmp(I.size(), CV_8UC1, Scalar(0));
-
+	int res = 0;
 	for (int y = 1; y < I.rows; y++) {
-		byte *pTmp	= tmp.ptr<byte>(y);
-		byte *pI	= I.ptr<byte>(y);
-		byte *pI1	= I.ptr<byte>(y - 1);
-		for (int x = 1; x < I.cols; x++) 
-			if ((pI[x] != pI[x - 1]) || (pI[x] != pI1[x])) pTmp[x] = 255;
+		const byte *pI	= I.ptr<byte>(y);
+		const byte *pI1	= I.ptr<byte>(y - 1);
+		for (int x = 1; x < I.cols; x++)
+			if ((pI[x] != pI[x - 1]) || (pI[x] != pI1[x])) res++;
 	} // y
 
-	imshow("tmp", tmp);
+	return res;
+}
+
+static float compactness(float S, float P)
+{
+	return (S > 0) ? P * P / (S * 4 * Pif) : 0;
+}
+
+// ------------------------------ The public functions ------------------------------
+size_t getNumLines(const Mat &img, int threshold1, int threshold2)
+{
+	return getNumLinesGray(toGray(img), threshold1, threshold2);
+}
+
+size_t getNumCircles(const Mat &img, int threshold1, int threshold2)
+{
+	return getNumCirclesGray(toGray(img), threshold1, threshold2);
+}
+
+float getOpacity(const Mat &img)
+{
+	return getOpacityGray(toGray(img));
+}
+
+float getVariance(const Mat &img)
+{
+	return getVarianceGray(toGray(img));
+}
 
-	return getArea(tmp);
+int getArea(const Mat &img)
+{
+	return getAreaGray(toGray(img));
+}
+
+int getPerimeter(const Mat &img)
+{
+	return getPerimeterGray(toGray(img));
 }
 
 float getCompactness(const Mat &img)
 {
-	float S = static_cast<float>(getArea(img));
-	float P = static_cast<float>(getPerimeter(img));
-	return (S > 0) ? P * P / (S * 4 * Pif) : 0;
+	const Mat I = toGray(img);
+	return compactness(static_cast<float>(getAreaGray(I)), static_cast<float>(getPerimeterGray(I)));
+}
+
+// Every image is processed by one thread: the area and the perimeter are calculated at most once
+Mat get(const vec_mat_t &vImgs, const std::vector<Feature> &vFeatures, int linesThreshold1, int linesThreshold2, int circlesThreshold1, int circlesThreshold2)
+{
+	Mat res(static_cast<int>(vImgs.size()), static_cast<int>(vFeatures.size()), CV_32FC1);
+	if (vImgs.empty() || vFeatures.empty()) return res;
+
+	parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+		for (int i = range.start; i < range.end; i++) {
+			const Mat	I			= toGray(vImgs[i]);
+			int			area		= -1;
+			int			perimeter	= -1;
+			auto lazyArea		= [&]() { if (area < 0) area = getAreaGray(I); return static_cast<float>(area); };
+			auto lazyPerimeter	= [&]() { if (perimeter < 0) perimeter = getPerimeterGray(I); return static_cast<float>(perimeter); };
+
+			float *pRes = res.ptr<float>(i);
+			for (size_t f = 0; f < vFeatures.size(); f++)
+				switch (vFeatures[f]) {
+					case Feature::numLines:		pRes[f] = static_cast<float>(getNumLinesGray(I, linesThreshold1, linesThreshold2));			break;
+					case Feature::numCircles:	pRes[f] = static_cast<float>(getNumCirclesGray(I, circlesThreshold1, circlesThreshold2));	break;
+					case Feature::opacity:		pRes[f] = getOpacityGray(I);																break;
+					case Feature::variance:		pRes[f] = getVarianceGray(I);																break;
+					case Feature::area:			pRes[f] = lazyArea();																		break;
+					case Feature::perimeter:	pRes[f] = lazyPerimeter();																break;
+					case Feature::compactness:	pRes[f] = compactness(lazyArea(), lazyPerimeter());										break;
+					default: DGM_ASSERT_MSG(false, "Unknown global feature %d", static_cast<int>(vFeatures[f]));
+				}
+		} // i
+	}, 1);
+
+	return res;
 }
 
-} } }
\ No newline at end of file
+} } }
@@ -14,6 +14,17 @@ namespace DirectGraphicalModels { namespace fex {
 	* @author Sergey G. Kosov, sergey.kosov@project-10.de
 	*/
 	namespace global {
+		/// Global features (ref. get(const vec_mat_t &, const std::vector<Feature> &, int, int, int, int))
+		enum class Feature {
+			numLines,		///< The number of straight lines (ref. getNumLines())
+			numCircles,		///< The number of circles (ref. getNumCircles())
+			opacity,		///< The weighted-mean transparancy (ref. getOpacity())
+			variance,		///< The variance (ref. getVariance())
+			area,			///< The number of non-zero pixels (ref. getArea())
+			perimeter,		///< The perimeter of an object (ref. getPerimeter())
+			compactness		///< The compactness of an object (ref. getCompactness())
+		};
+
 		/**
 		* @brief Returns the number of staight lines in the image.
 		* @param img The source image of type \b CV_8UC1 or \b CV_8UC3.
@@ -66,5 +77,20 @@ namespace DirectGraphicalModels { namespace fex {
 		* @return The compactness of the object in the source image.
 		*/
 		DllExport float		getCompactness(const Mat &img);
+		/**
+		* @brief Extracts the global features from a collection of images
+		* @details The images are processed in parallel. The intermediate results are calculated once per image and shared among its features: 
+		* the grayscale image is shared by all the features, and the area and the perimeter are shared with the compactness.
+		* The results are equal to the results of the single-image functions.
+		* > This function supports PPL.
+		* @param vImgs The source images of type \b CV_8UC1 or \b CV_8UC3.
+		* @param vFeatures The features to extract.
+		* @param linesThreshold1 The \b threshold1 argument of getNumLines().
+		* @param linesThreshold2 The \b threshold2 argument of getNumLines().
+		* @param circlesThreshold1 The \b threshold1 argument of getNumCircles().
+		* @param circlesThreshold2 The \b threshold2 argument of getNumCircles().
+		* @return The features: Mat(size: vImgs.size() x vFeatures.size(); type: CV_32FC1), where the row \a i holds the features of the image \a i in the order of \b vFeatures.
+		*/
+		DllExport Mat		get(const vec_mat_t &vImgs, const std::vector<Feature> &vFeatures, int linesThreshold1 = 100, int linesThreshold2 = 50, int circlesThreshold1 = 100, int circlesThreshold2 = 30);
 	}
 } }
\ No newline at end of file
@@ -1,64 +1,122 @@
 #include "Gradient.h"
 #include "LinearMapper.h"
+#include "DGM/ThreadPool.h"
+#include "DGM/simd.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex
 {
+namespace {
+	// Converting to one channel image
+	Mat toGray(const Mat &img)
+	{
+		Mat res;
+		if (img.channels() != 1) cvtColor(img, res, cv::ColorConversionCodes::COLOR_RGB2GRAY);
+		else res = img;
+		DGM_ASSERT(res.depth() == CV_8U);
+		return res;
+	}
+
+	// Calculates the magnitudes and, if bin is not nullptr, the orientation bins of the row y; the boundary rows have zero y-derivatives
+	void getPolarRow(const Mat &I, int y, const vec_float_t &vTan, float *mgn, byte *bin)
+	{
+		const byte *pCur	= I.ptr<byte>(y);
+		const bool	border	= y == 0 || y == I.rows - 1;
+		const byte *pPrev	= border ? pCur : I.ptr<byte>(y - 1);
+		const byte *pNext	= border ? pCur : I.ptr<byte>(y + 1);
+		simd::gradientRow(pPrev, pCur, pNext, vTan.data(), static_cast<int>(vTan.size()), mgn, bin, I.cols);
+	}
+}
+
+// The magnitudes of one row are mapped at once, thus no intermediate images are created
 Mat CGradient::get(const Mat &img, float mid)
 {
 	DGM_ASSERT(mid <= GRADIENT_MAX_VALUE);
 	DGM_ASSERT(mid > 0);
-	 
-	// Converting to one channel image
-	Mat I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-	
-	// Derivatives
-	Mat Ix = getDerivativeX(I);
-	Mat Iy = getDerivativeY(I);
-
-	// Magnitude
-	Mat res(img.size(), CV_8UC1);		// gradient 	
-	for(int y = 0; y < img.rows; y++) {	
-		float *pIx	= Ix.ptr<float>(y);
-		float *pIy	= Iy.ptr<float>(y);
-		for(int x = 0; x < img.cols; x++) {
-			float val = sqrtf(pIx[x]*pIx[x] + pIy[x]*pIy[x]);
-			res.at<byte>(y,x) = two_linear_mapper<byte>(val, 0, GRADIENT_MAX_VALUE, mid, 255);
-		}
-	} // y	
 
+	const Mat I = toGray(img);
+	Mat res(I.size(), CV_8UC1);
+	parallel::parallelFor(Range(0, I.rows), [&](const Range &range) {
+		vec_float_t vMgn(I.cols);
+		for (int y = range.start; y < range.end; y++) {
+			getPolarRow(I, y, vec_float_t(), vMgn.data(), nullptr);
+			byte *pRes = res.ptr<byte>(y);
+			for (int x = 0; x < res.cols; x++)
+				pRes[x] = two_linear_mapper<byte>(vMgn[x], 0, GRADIENT_MAX_VALUE, mid, 255);
+		} // y
+	});
 	return res;
 }
 
-Mat CGradient::getDerivativeX(const Mat &img)
+void CGradient::getDerivatives(const Mat &img, Mat &Ix, Mat &Iy)
 {
-	DGM_ASSERT(img.channels() == 1);
-	
-	Mat res(img.size(), CV_32FC1); res.setTo(0);
-	for(int y = 0; y < res.rows; y++) {
-		const byte	*pImg	= img.ptr<byte>(y);
-		float		*pRes	= res.ptr<float>(y);
-		for(int x = 1; x < res.cols - 1; x++)
-			pRes[x] = 0.5f * (static_cast<float>(pImg[x + 1]) - static_cast<float>(pImg[x - 1]));
-	} // y
-	return res;
+	const Mat I = toGray(img);
+	const int width		= I.cols;
+	const int height	= I.rows;
+	Ix.create(I.size(), CV_32FC1);
+	Iy.create(I.size(), CV_32FC1);
+	parallel::parallelFor(Range(0, height), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const byte	*pImg	= I.ptr<byte>(y);
+			float		*pIx	= Ix.ptr<float>(y);
+			float		*pIy	= Iy.ptr<float>(y);
+			
+			pIx[0] = pIx[width - 1] = 0;
+			for (int x = 1; x < width - 1; x++)
+				pIx[x] = 0.5f * (static_cast<float>(pImg[x + 1]) - static_cast<float>(pImg[x - 1]));
+			
+			if (y == 0 || y == height - 1) 
+				for (int x = 0; x < width; x++) pIy[x] = 0;
+			else {
+				const byte *pImgF = I.ptr<byte>(y + 1);
+				const byte *pImgB = I.ptr<byte>(y - 1);
+				for (int x = 0; x < width; x++)
+					pIy[x] = 0.5f * (static_cast<float>(pImgF[x]) - static_cast<float>(pImgB[x]));
+			}
+		} // y
+	});
 }
 
-Mat CGradient::getDerivativeY(const Mat &img)
+Mat CGradient::getMagnitude(const Mat &Ix, const Mat &Iy, float mid)
 {
-	DGM_ASSERT(img.channels() == 1);
-	
-	Mat res(img.size(), CV_32FC1); res.setTo(0);
-	for(int y = 1; y < res.rows - 1; y++) {
-		const byte	*pImgF	= img.ptr<byte>(y + 1);
-		const byte	*pImgB	= img.ptr<byte>(y - 1);
-		float		*pRes	= res.ptr<float>(y);
-		for(int x = 0; x < res.cols; x++)
-			pRes[x] = 0.5f * (static_cast<float>(pImgF[x]) - static_cast<float>(pImgB[x]));
-	} // y
+	DGM_ASSERT(mid <= GRADIENT_MAX_VALUE);
+	DGM_ASSERT(mid > 0);
+	DGM_ASSERT(Ix.size() == Iy.size());
+
+	Mat res(Ix.size(), CV_8UC1);		// gradient 	
+	parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const float *pIx	= Ix.ptr<float>(y);
+			const float *pIy	= Iy.ptr<float>(y);
+			byte		*pRes	= res.ptr<byte>(y);
+			for (int x = 0; x < res.cols; x++) {
+				float val = sqrtf(pIx[x] * pIx[x] + pIy[x] * pIy[x]);
+				pRes[x] = two_linear_mapper<byte>(val, 0, GRADIENT_MAX_VALUE, mid, 255);
+			} // x
+		} // y
+	});
+
 	return res;
 }
 
-} }
\ No newline at end of file
+void CGradient::getPolar(const Mat &img, int nBins, Mat &mgn, Mat &bins)
+{
+	DGM_ASSERT_MSG(nBins > 0 && nBins <= 256, "Number of bins (%d) is out of range [1; 256]", nBins);
+
+	const Mat			I		= toGray(img);
+	const vec_float_t	vTan	= getBinThresholds(nBins);
+	mgn.create(I.size(), CV_32FC1);
+	bins.create(I.size(), CV_8UC1);
+	parallel::parallelFor(Range(0, I.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++)
+			getPolarRow(I, y, vTan, mgn.ptr<float>(y), bins.ptr<byte>(y));
+	});
+}
+
+vec_float_t CGradient::getBinThresholds(int nBins)
+{
+	vec_float_t res(MAX(0, nBins - 1));
+	for (int i = 0; i < nBins - 1; i++) res[i] = static_cast<float>(tan((static_cast<double>(i + 1) / nBins - 0.5) * Pi));
+	return res;
+}
+} }
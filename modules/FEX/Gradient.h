@@ -14,7 +14,6 @@ namespace DirectGraphicalModels { namespace fex
 	*/		
 	class CGradient : public ILocalFeatureExtractor
 	{
-	friend class CHOG;
 	public:
 		/**
 		* @brief Constructor.
@@ -37,10 +36,52 @@ namespace DirectGraphicalModels { namespace fex
 		* @return The gradient feature image of type \b CV_8UC1.
 		*/		
 		DllExport static Mat get(const Mat &img, float mid = GRADIENT_MAX_VALUE);
-
-	protected:
-		static Mat getDerivativeX(const Mat &img);
-		static Mat getDerivativeY(const Mat &img);
+		/**
+		* @brief Returns the halo of the feature
+		* @details The derivatives are estimated with the 3 x 3 kernels, thus the gradient of a pixel depends only on its direct neighbours
+		* @return The width of the halo in pixels
+		*/
+		DllExport static int getHalo(void) { return 1; }
+		/**
+		* @brief Calculates the derivatives of the image
+		* @details This function calculates the first \a x and \a y central derivatives of the input image in one pass over the image. The derivatives at the image boundaries are zero.
+		* The derivatives may be shared by the gradient-based features: Ref. getMagnitude(), CHOG::get(const Mat &, const Mat &, int, SqNeighbourhood) and CSIFT::getDense(const Mat &, const Mat &, int).
+		* > This function supports PPL.
+		* @param[in] img Input image of type \b CV_8UC1 or \b CV_8UC3.
+		* @param[out] Ix The derivative \f$\frac{d\,img}{dx}\f$: Mat(size: img.size(); type: CV_32FC1).
+		* @param[out] Iy The derivative \f$\frac{d\,img}{dy}\f$: Mat(size: img.size(); type: CV_32FC1).
+		*/
+		DllExport static void getDerivatives(const Mat &img, Mat &Ix, Mat &Iy);
+		/**
+		* @brief Extracts the gradient feature from the derivatives
+		* @details This function is equivalent to get(const Mat &, float), but it uses the derivatives, calculated with getDerivatives()
+		* > This function supports PPL.
+		* @param Ix The derivative \f$\frac{d\,img}{dx}\f$: Mat(type: CV_32FC1).
+		* @param Iy The derivative \f$\frac{d\,img}{dy}\f$: Mat(type: CV_32FC1).
+		* @param mid Parameter for the two-linear mapping of the feature: \f$mid\in(0;255\sqrt{2}]\f$. (Ref. @ref two_linear_mapper()). 
+		* @return The gradient feature image of type \b CV_8UC1.
+		*/
+		DllExport static Mat getMagnitude(const Mat &Ix, const Mat &Iy, float mid = GRADIENT_MAX_VALUE);
+		/**
+		* @brief Calculates the magnitudes and the orientation bins of the gradient
+		* @details This function calculates the derivatives, the magnitude \f$\sqrt{I_x^2 + I_y^2}\f$ and the orientation bin of every pixel in one row-parallel pass over the image
+		* with a fused vectorized kernel (ref. simd::gradientRow()), thus no derivative images are created. The orientation \f$(0.5 + \arctan(I_y / I_x) / \pi) \cdot 180^\circ\f$
+		* falls into the bin \f$i\f$ covering the angles \f$[i; i + 1) \cdot \frac{180^\circ}{nBins}\f$. The results may be shared by the gradient-based features: 
+		* Ref. CHOG::getFromPolar().
+		* > This function supports PPL.
+		* @param[in] img Input image of type \b CV_8UC1 or \b CV_8UC3.
+		* @param[in] nBins Number of the orientation bins: \f$nBins\in[1; 256]\f$.
+		* @param[out] mgn The gradient magnitudes: Mat(size: img.size(); type: CV_32FC1).
+		* @param[out] bins The orientation bins: Mat(size: img.size(); type: CV_8UC1).
+		*/
+		DllExport static void getPolar(const Mat &img, int nBins, Mat &mgn, Mat &bins);
+		/**
+		* @brief Returns the thresholds of the orientation bins
+		* @details The orientation of the gradient falls into the first bin \a i with \f$I_y / I_x \leq tan_i\f$, or into the last bin
+		* @param nBins Number of the orientation bins
+		* @return The ascending thresholds \f$tan_i = \tan\left(\frac{(i + 1)\,\pi}{nBins} - \frac{\pi}{2}\right),\ i\in[0; nBins - 1)\f$
+		*/
+		DllExport static vec_float_t getBinThresholds(int nBins);
 	};
 } }
 
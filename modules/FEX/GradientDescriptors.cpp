@@ -0,0 +1,22 @@
+#include "GradientDescriptors.h"
+#include "DGM/ThreadPool.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels { namespace fex
+{
+Mat CGradientDescriptors::get(float mid, int nBins, SqNeighbourhood nbhd, int cellSize) const
+{
+	DGM_ASSERT_MSG(1 + nBins + 128 <= CV_CN_MAX, "Number of channels (%d) exceeds the maximum allowed number (%d)", 1 + nBins + 128, CV_CN_MAX);
+
+	vec_mat_t vFeatures(3);
+	CTaskGroup group;
+	group.run([&] { vFeatures[0] = getGradient(mid); });
+	group.run([&] { vFeatures[1] = getHOG(nBins, nbhd); });
+	vFeatures[2] = getDenseSIFT(cellSize);
+	group.wait();
+
+	Mat res;
+	merge(vFeatures, res);
+	return res;
+}
+} }
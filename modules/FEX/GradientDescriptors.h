@@ -0,0 +1,72 @@
+// Gradient-based descriptors class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "Gradient.h"
+#include "HOG.h"
+#include "SIFT.h"
+
+namespace DirectGraphicalModels { namespace fex
+{
+	// ================================ Gradient Descriptors Class ==============================
+	/**
+	* @ingroup moduleLFEX
+	* @brief Gradient-based descriptors extraction class
+	* @details This class calculates the derivatives of the image once, in the constructor, and extracts all the gradient-based features from them: the gradient,
+	* the HOG and the dense SIFT features. Thus the image is traversed only once for all these features:
+	* @code
+	* CGradientDescriptors descriptors(img);
+	* Mat gradient = descriptors.getGradient();
+	* Mat hog      = descriptors.getHOG(9, sqNeighbourhood(5));
+	* Mat sift     = descriptors.getDenseSIFT(4);
+	* @endcode
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGradientDescriptors
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @details Calculates the derivatives of the image (Ref. CGradient::getDerivatives())
+		* @param img Input image of type \b CV_8UC1 or \b CV_8UC3.
+		*/
+		DllExport CGradientDescriptors(const Mat &img) { CGradient::getDerivatives(img, m_Ix, m_Iy); }
+		DllExport ~CGradientDescriptors(void) = default;
+
+		/**
+		* @brief Extracts the gradient feature
+		* @param mid Parameter for the two-linear mapping of the feature (Ref. CGradient::get()).
+		* @return The gradient feature image of type \b CV_8UC1.
+		*/
+		DllExport Mat	getGradient(float mid = GRADIENT_MAX_VALUE) const { return CGradient::getMagnitude(m_Ix, m_Iy, mid); }
+		/**
+		* @brief Extracts the HOG feature
+		* @param nBins Number of bins (Ref. CHOG::get()).
+		* @param nbhd Neighborhood around the pixel, where its histogram is estimated. (Ref. @ref SqNeighbourhood).
+		* @return The HOG feature image of type \b CV_8UC{n}, where \f$n=nBins\f$.
+		*/
+		DllExport Mat	getHOG(int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5)) const { return CHOG::get(m_Ix, m_Iy, nBins, nbhd); }
+		/**
+		* @brief Extracts the dense SIFT feature
+		* @param cellSize The size of a cell in pixels (Ref. CSIFT::getDense()).
+		* @return The dense SIFT feature image of type \b CV_8UC{128}.
+		*/
+		DllExport Mat	getDenseSIFT(int cellSize = 4) const { return CSIFT::getDense(m_Ix, m_Iy, cellSize); }
+		/**
+		* @brief Extracts the gradient, the HOG and the dense SIFT features concurrently
+		* @details The three features are extracted as concurrent tasks and merged into one feature image
+		* > This function supports PPL.
+		* @param mid Parameter for the two-linear mapping of the gradient feature (Ref. CGradient::get()).
+		* @param nBins Number of bins of the HOG feature (Ref. CHOG::get()).
+		* @param nbhd Neighborhood of the HOG feature. (Ref. @ref SqNeighbourhood).
+		* @param cellSize The size of a cell of the dense SIFT feature (Ref. CSIFT::getDense()).
+		* @return The feature image of type \b CV_8UC{n}, where \f$n=1+nBins+128\f$: the gradient, followed by the HOG and the dense SIFT features.
+		*/
+		DllExport Mat	get(float mid = GRADIENT_MAX_VALUE, int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5), int cellSize = 4) const;
+
+
+	private:
+		Mat	m_Ix;			///< The derivative of the image in \a x direction
+		Mat	m_Iy;			///< The derivative of the image in \a y direction
+	};
+} }
@@ -1,95 +1,115 @@
 #include "HOG.h"
 #include "Gradient.h"
+#include "DGM/ThreadPool.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex
 {
 Mat CHOG::get(const Mat &img, int nBins, SqNeighbourhood nbhd)
 {
-	DGM_ASSERT_MSG(nBins < CV_CN_MAX, "Number of bins (%d) exceeds the maximum allowed number (%d)", nBins, CV_CN_MAX);
-	
-	int	i;						// bins index
-	int	x, y;
-	int	width	= img.cols;
-	int	height	= img.rows;
+	Mat mgn, bins;
+	CGradient::getPolar(img, nBins, mgn, bins);
+	return getFromPolar(mgn, bins, nBins, nbhd);
+}
 
-	// Converting to one channel image
-	Mat	I;
-	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-	
-	// Derivatives
-	Mat Ix = CGradient::getDerivativeX(I);
-	Mat Iy = CGradient::getDerivativeY(I);
+Mat CHOG::get(const Mat &Ix, const Mat &Iy, int nBins, SqNeighbourhood nbhd)
+{
+	DGM_ASSERT_MSG(nBins > 0 && nBins <= 256, "Number of bins (%d) is out of range [1; 256]", nBins);
+	DGM_ASSERT(Ix.size() == Iy.size());
 
-	// Initializing bins and integrals
-	vec_mat_t vTemp(nBins);
-	vec_mat_t vBins(nBins);
-	vec_mat_t vInts(nBins);
+	// The orientation (0.5 + atan(iy / ix) / Pi) * 180 in [0; 180] falls into the first bin i with iy / ix <= tan((i + 1) * Pi / nBins - Pi / 2)
+	const vec_float_t vTan = CGradient::getBinThresholds(nBins);
+	Mat mgn(Ix.size(), CV_32FC1);
+	Mat bins(Ix.size(), CV_8UC1);
+	parallel::parallelFor(Range(0, Ix.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const float *pIx	= Ix.ptr<float>(y);
+			const float *pIy	= Iy.ptr<float>(y);
+			float		*pMgn	= mgn.ptr<float>(y);
+			byte		*pBin	= bins.ptr<byte>(y);
+			for (int x = 0; x < Ix.cols; x++) {
+				float ix = pIx[x];
+				float iy = pIy[x];
 
-	for (i = 0; i < nBins; i++) {
-		vTemp[i].create(img.size(), CV_8UC1);
-		vBins[i].create(img.size(), CV_32FC1);	
-		vBins[i].setTo(0);
-	}
+				// gradient Magnitude
+				pMgn[x] = sqrtf(ix * ix + iy * iy);
 
-	std::vector<float *>	pBins(nBins);
-	std::vector<double *>	pInts0(nBins);
-	std::vector<double *>	pInts1(nBins);
-	std::vector<byte *>		pTemp(nBins);
-	
-	// Caclculating the bins
-	for (y = 0; y < height; y++) {
-		float *pIx = Ix.ptr<float>(y);
-		float *pIy = Iy.ptr<float>(y);
-		for (i = 0; i < nBins; i++) pBins[i] = vBins[i].ptr<float>(y);
-		for (x = 0; x < width; x++) {
-			float ix = pIx[x];
-			float iy = pIy[x];
-			
-			// gradient Magnitude
-			float gMgn = sqrtf(ix*ix + iy*iy);
+				// gradient Orientation bin
+				if (fabs(ix) < FLT_EPSILON) ix = SIGN(ix) * FLT_EPSILON;
+				const float tg = iy / ix;
+				int bin = 0;
+				for (float t : vTan) bin += tg > t ? 1 : 0;
+				pBin[x] = static_cast<byte>(bin);
+			} // x
+		} // y
+	});
+	return getFromPolar(mgn, bins, nBins, nbhd);
+}
 
-			// gradient Orientation
-			if (fabs(ix) < FLT_EPSILON) ix = SIGN(ix) * FLT_EPSILON;
-			float tg = iy / ix;
-			float gOrt = (0.5f + atanf(tg) / (float)Pi) * 180.0f;			// [0; 180]
+// The integral histograms are interleaved: the nBins values of one pixel are contiguous, thus all the stages run over contiguous memory
+Mat CHOG::getFromPolar(const Mat &mgn, const Mat &bins, int nBins, SqNeighbourhood nbhd)
+{
+	DGM_ASSERT_MSG(nBins < CV_CN_MAX, "Number of bins (%d) exceeds the maximum allowed number (%d)", nBins, CV_CN_MAX);
+	DGM_ASSERT(mgn.size() == bins.size());
+	DGM_ASSERT(mgn.type() == CV_32FC1 && bins.type() == CV_8UC1);
+	
+	const int	width	= mgn.cols;
+	const int	height	= mgn.rows;
+	const int	stride	= (width + 1) * nBins;									// length of a row of the integral histogram
 
-			// filling in the bins
-			float gOrtStep = 180.0f / nBins;
-			for (i = 0; i < nBins; i++)
-				if (gOrt <= (i + 1) * gOrtStep) {
-					pBins[i][x] = gMgn;
-					break;
-				}
-		}
-	}
+	// Calculating the row-wise integrals: row y + 1 of the integral holds the prefix sums of the row y
+	std::vector<double> vInt(static_cast<size_t>(height + 1) * stride, 0);
+	parallel::parallelFor(Range(0, height), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const float *pMgn	= mgn.ptr<float>(y);
+			const byte	*pBin	= bins.ptr<byte>(y);
+			double		*pInt	= &vInt[static_cast<size_t>(y + 1) * stride + nBins];
+			for (int x = 0; x < width; x++, pInt += nBins) {
+				DGM_ASSERT_MSG(pBin[x] < nBins, "The bin %d of the pixel (%d, %d) exceeds the number of bins (%d)", pBin[x], x, y, nBins);
+				for (int i = 0; i < nBins; i++) pInt[i] = pInt[i - nBins];
+				pInt[pBin[x]] += pMgn[x];
+			} // x
+		} // y
+	});
 
-	// Calculating the integrals
-	for (i = 0; i < nBins; i++) integral(vBins[i], vInts[i]);
+	// Accumulating the integrals down the columns
+	parallel::parallelFor(Range(0, stride), [&](const Range &range) {
+		for (int y = 2; y <= height; y++) {
+			const double *pPrev = &vInt[static_cast<size_t>(y - 1) * stride];
+			double		 *pInt	= &vInt[static_cast<size_t>(y) * stride];
+			for (int x = range.start; x < range.end; x++) pInt[x] += pPrev[x];
+		} // y
+	}, 1024);
 	
-	for (y = 0; y < height; y++) {	
-		int y0 = MAX(0, y - nbhd.upperGap);		
-		int y1 = MIN(y + nbhd.lowerGap, height - 1);
-		for (i = 0; i < nBins; i++) pInts0[i] = vInts[i].ptr<double>(y0);
-		for (i = 0; i < nBins; i++) pInts1[i] = vInts[i].ptr<double>(y1 + 1);
-		for (i = 0; i < nBins; i++) pTemp[i]  = vTemp[i].ptr<byte>(y);
-		for (x = 0; x < width; x++) {
-			int x0 = MAX(0, x - nbhd.leftGap);
-			int x1 = MIN(x + nbhd.rightGap, width - 1);
-
-			Mat HOGcell(cv::Size(nBins, 1), CV_64FC1);
-			double *pHOGcell = HOGcell.ptr<double>(0);
-			for (i = 0; i < nBins; i++) pHOGcell[i] = pInts1[i][x1 + 1] - pInts1[i][x0] - pInts0[i][x1 + 1] + pInts0[i][x0];
-			normalize(HOGcell, HOGcell, 255, 0, cv::NormTypes::NORM_MINMAX);
-			for (i = 0; i < nBins; i++) pTemp[i][x] = static_cast<byte>(pHOGcell[i]);
-			HOGcell.release();
-		} // x
-	} // y
+	// The histograms of the neighbourhoods, normalized as with cv::normalize(NORM_MINMAX) to [0; 255]
+	Mat res(mgn.size(), CV_8UC(nBins));
+	parallel::parallelFor(Range(0, height), [&](const Range &range) {
+		std::vector<double> vCell(nBins);
+		for (int y = range.start; y < range.end; y++) {
+			const int	  y0	= MAX(0, y - nbhd.upperGap);
+			const int	  y1	= MIN(y + nbhd.lowerGap, height - 1);
+			const double *pInt0	= &vInt[static_cast<size_t>(y0) * stride];
+			const double *pInt1	= &vInt[static_cast<size_t>(y1 + 1) * stride];
+			byte		 *pRes	= res.ptr<byte>(y);
+			for (int x = 0; x < width; x++, pRes += nBins) {
+				const int x0 = MAX(0, x - nbhd.leftGap) * nBins;
+				const int x1 = (MIN(x + nbhd.rightGap, width - 1) + 1) * nBins;
 
-	Mat res;
-	merge(vTemp, res);
+				double min = DBL_MAX;
+				double max = -DBL_MAX;
+				for (int i = 0; i < nBins; i++) {
+					const double val = pInt1[x1 + i] - pInt1[x0 + i] - pInt0[x1 + i] + pInt0[x0 + i];
+					vCell[i] = val;
+					if (min > val) min = val;
+					if (max < val) max = val;
+				}
+				const double scale = 255 * (max - min > DBL_EPSILON ? 1.0 / (max - min) : 0);
+				const double shift = -min * scale;
+				for (int i = 0; i < nBins; i++) pRes[i] = static_cast<byte>(vCell[i] * scale + shift);
+			} // x
+		} // y
+	});
 
 	return res;	
 }
-} }
\ No newline at end of file
+} }
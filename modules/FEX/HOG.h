@@ -28,11 +28,44 @@ namespace DirectGraphicalModels { namespace fex
 		* @brief Extracts the HOG feature.
 		* @details For each pixel of the source image this function calculates the histogram of oriented gradients inside the pixel's neighbourhood \a nbhd.
 		* The histogram consists of \a nBins values, it is normalized, and stored as \a nBins channel image, thus, the channel index corresponds to the histogram index.
+		* The gradient magnitudes and orientation bins are calculated in one pass over the image (Ref. CGradient::getPolar()).
+		* > This function supports PPL.
 		* @param img Input image of type \b CV_8UC1 or \b CV_8UC3.
 		* @param nBins Number of bins. Hence a single bin covers an angle of \f$\frac{180^\circ}{nBins}\f$.
 		* @param nbhd Neighborhood around the pixel, where its histogram is estimated. (Ref. @ref SqNeighbourhood).
 		* @return The HOG feature image of type \b CV_8UC{n}, where \f$n=nBins\f$.
 		*/
 		DllExport static Mat	get(const Mat &img, int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5));
+		/**
+		* @brief Extracts the HOG feature from the derivatives
+		* @details This function is equivalent to get(const Mat &, int, SqNeighbourhood), but it uses the derivatives, calculated with CGradient::getDerivatives(), 
+		* which may be shared with the other gradient-based features.
+		* > This function supports PPL.
+		* @param Ix The derivative \f$\frac{d\,img}{dx}\f$: Mat(type: CV_32FC1).
+		* @param Iy The derivative \f$\frac{d\,img}{dy}\f$: Mat(type: CV_32FC1).
+		* @param nBins Number of bins. Hence a single bin covers an angle of \f$\frac{180^\circ}{nBins}\f$.
+		* @param nbhd Neighborhood around the pixel, where its histogram is estimated. (Ref. @ref SqNeighbourhood).
+		* @return The HOG feature image of type \b CV_8UC{n}, where \f$n=nBins\f$.
+		*/
+		DllExport static Mat	get(const Mat &Ix, const Mat &Iy, int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5));
+		/**
+		* @brief Extracts the HOG feature from the gradient magnitudes and orientation bins
+		* @details This function is equivalent to get(const Mat &, int, SqNeighbourhood), but it uses the magnitudes and the orientation bins, calculated with CGradient::getPolar(),
+		* which may be shared with the other gradient-based features.
+		* > This function supports PPL.
+		* @param mgn The gradient magnitudes: Mat(type: CV_32FC1).
+		* @param bins The orientation bins: Mat(size: mgn.size(); type: CV_8UC1) with the values in \f$[0; nBins)\f$.
+		* @param nBins Number of bins. Hence a single bin covers an angle of \f$\frac{180^\circ}{nBins}\f$.
+		* @param nbhd Neighborhood around the pixel, where its histogram is estimated. (Ref. @ref SqNeighbourhood).
+		* @return The HOG feature image of type \b CV_8UC{n}, where \f$n=nBins\f$.
+		*/
+		DllExport static Mat	getFromPolar(const Mat &mgn, const Mat &bins, int nBins = 9, SqNeighbourhood nbhd = sqNeighbourhood(5));
+		/**
+		* @brief Returns the halo of the feature
+		* @details The histogram of a pixel is estimated in the neighbourhood \b nbhd from the derivatives, which need one more pixel at its boundary
+		* @param nbhd Neighborhood around the pixel, where the feature is estimated. (Ref. @ref SqNeighbourhood).
+		* @return The width of the halo in pixels
+		*/
+		DllExport static int	getHalo(SqNeighbourhood nbhd = sqNeighbourhood(5)) { return fex::getHalo(nbhd) + 1; }
 	};
 } }
\ No newline at end of file
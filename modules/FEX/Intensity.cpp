@@ -1,25 +1,48 @@
 #include "Intensity.h"
+#include "DGM/ThreadPool.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex
 {
 Mat CIntensity::get(const Mat &img, cv::Scalar weight)
+{
+	return get(img, std::vector<cv::Scalar>({ weight }));
+}
+
+// The weights are represented in the fixed-point format Q14, thus the contiguous inner loops use only the integer arithmetic
+Mat CIntensity::get(const Mat &img, const std::vector<cv::Scalar> &vWeights)
 {
 	DGM_ASSERT_MSG(img.channels() == 3, "Input image has %d channel(s), but must have 3.", img.channels());
+	DGM_ASSERT_MSG(img.depth() == CV_8U, "The source image must have 8-bit / channel depth");
+	const int nFeatures = static_cast<int>(vWeights.size());
+	DGM_ASSERT_MSG(nFeatures > 0 && nFeatures <= CV_CN_MAX, "Number of weights (%d) must be in range [1; %d]", nFeatures, CV_CN_MAX);
+
+	const int shift = 14;
+	std::vector<int> vW(3 * nFeatures);
+	for (int f = 0; f < nFeatures; f++)
+		for (int c = 0; c < 3; c++) {
+			DGM_ASSERT_MSG(fabs(vWeights[f].val[c]) < 128, "The weight %f is out of range (-128; 128)", vWeights[f].val[c]);
+			vW[3 * f + c] = static_cast<int>(std::round(vWeights[f].val[c] * (1 << shift)));
+		}
 
 	// OpenCV function addWeighted() has a bug.
-	Mat res(img.size(), CV_8UC1);
-	for (int y = 0; y < img.rows; y++) {
-		const byte  *pImg = img.ptr<byte>(y);
-		byte		*pRes = res.ptr<byte>(y);
-		for (int x = 0; x < img.cols; x++) {
-			double sum = 0;
-			for (int c = 0; c < 3; c++)
-				sum += weight.val[c] * pImg[3 * x + c];
-			pRes[x] = static_cast<byte> (MIN(255, MAX(0, sum + 0.5f)));
-		} // x
-	} // y
+	Mat res(img.size(), CV_8UC(nFeatures));
+	parallel::parallelFor(Range(0, img.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const byte	*pImg = img.ptr<byte>(y);
+			byte		*pRes = res.ptr<byte>(y);
+			for (int f = 0; f < nFeatures; f++) {
+				const int w0 = vW[3 * f];
+				const int w1 = vW[3 * f + 1];
+				const int w2 = vW[3 * f + 2];
+				for (int x = 0; x < img.cols; x++) {
+					const int sum = (w0 * pImg[3 * x] + w1 * pImg[3 * x + 1] + w2 * pImg[3 * x + 2] + (1 << (shift - 1))) >> shift;
+					pRes[nFeatures * x + f] = static_cast<byte>(MIN(255, MAX(0, sum)));
+				} // x
+			} // f
+		} // y
+	});
 
 	return res;
 }
-} }
\ No newline at end of file
+} }
@@ -27,9 +27,21 @@ namespace DirectGraphicalModels { namespace fex
 		* @brief Extracts the intesity feature.
 		* @details This function calculates the intesity of the input image as follows: \f[ intensity=weight_0\cdot img.RED+weight_1\cdot img.GREEN+weight_2\cdot img.BLUE \f]
 		* @param img Input image of type \b CV_8UC3.
-		* @param weight The weight coefficients, which determine the contribution of each color channel to the resulting intensity.
+		* The weighted sum is calculated in the fixed-point arithmetic with the precision of \f$2^{-14}\f$ for the weights.
+		* > This function supports PPL.
+		* @param weight The weight coefficients, which determine the contribution of each color channel to the resulting intensity. The absolute values of the coefficients must be less than 128.
 		* @return The intesity feature image of type \b CV_8UC1.
 		*/
 		DllExport static Mat	get(const Mat &img, cv::Scalar weight = CV_RGB(0.333, 0.333, 0.333));
+		/**
+		* @brief Extracts several intesity features in one pass.
+		* @details This function calculates one intensity feature (Ref. get(const Mat &, cv::Scalar)) for every set of the weight coefficients. 
+		* The source image is traversed only once and the weighted sums are calculated in the fixed-point arithmetic. 
+		* > This function supports PPL.
+		* @param img Input image of type \b CV_8UC3.
+		* @param vWeights The weight coefficients of the features. The absolute values of the coefficients must be less than 128.
+		* @return The intesity feature image of type \b CV_8UC{n}, where \f$n=vWeights.size()\f$.
+		*/
+		DllExport static Mat	get(const Mat &img, const std::vector<cv::Scalar> &vWeights);
 	};
 } }
\ No newline at end of file
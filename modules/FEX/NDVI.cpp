@@ -1,30 +1,38 @@
 #include "NDVI.h"
 #include "LinearMapper.h"
+#include "DGM/ThreadPool.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex
 {
+// The feature depends only on the red value and the sum of the green and blue values, thus it is taken from the lookup table of 256 x 511 values
 Mat CNDVI::get(const Mat &img, byte midPoint)
 {
 	DGM_ASSERT_MSG(img.channels() == 3, "Input image has %d channel(s), but must have 3.", img.channels());
-	Mat res(img.size(), CV_8UC1);
-	vec_mat_t vChannels;
-	split(img, vChannels);	
+	DGM_ASSERT_MSG(img.depth() == CV_8U, "The source image must have 8-bit / channel depth");
 
-	for (int y = 0; y < res.rows; y++) {
-		byte *pRes	= res.ptr<byte>(y);
-		byte *pR	= vChannels.at(2).ptr<byte>(y);
-		byte *pG	= vChannels.at(1).ptr<byte>(y);
-		byte *pB	= vChannels.at(0).ptr<byte>(y);
-		for (int x = 0; x < res.cols; x++) {
-			float nir	= static_cast<float>(pR[x]);
-			float vis	= 0.5f * (static_cast<float>(pG[x]) + static_cast<float>(pB[x]));
-			float ndvi = (nir + vis > 0) ? (nir - vis) / (nir + vis) : 0;
+	const int lutSize = 2 * 255 + 1;
+	std::vector<byte> vLUT(256 * lutSize);
+	parallel::parallelFor(Range(0, 256), [&](const Range &range) {
+		for (int r = range.start; r < range.end; r++)
+			for (int gb = 0; gb < lutSize; gb++) {
+				float nir	= static_cast<float>(r);
+				float vis	= 0.5f * static_cast<float>(gb);
+				float ndvi	= (nir + vis > 0) ? (nir - vis) / (nir + vis) : 0;
+				vLUT[r * lutSize + gb] = two_linear_mapper<byte>(ndvi, -1.0f, 1.0f, 0.0f, midPoint);
+			} // gb
+	});
 
-			pRes[x] = two_linear_mapper<byte>(ndvi, -1.0f, 1.0f, 0.0f, midPoint);
-		}
-	} // y
+	Mat res(img.size(), CV_8UC1);
+	parallel::parallelFor(Range(0, res.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const byte	*pImg	= img.ptr<byte>(y);
+			byte		*pRes	= res.ptr<byte>(y);
+			for (int x = 0; x < res.cols; x++)
+				pRes[x] = vLUT[pImg[3 * x + 2] * lutSize + pImg[3 * x + 1] + pImg[3 * x]];
+		} // y
+	});
 
 	return res;
 }
-} }
\ No newline at end of file
+} }
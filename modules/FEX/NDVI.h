@@ -32,6 +32,8 @@ namespace DirectGraphicalModels { namespace fex
 		* As \f$NDVI\in[-1; 1]\f$, this function performs two-linear mapping of the NDVI values to the interval \f$[0; 255]\f$, such that:
 		* \f{eqnarray*}{-1&\rightarrow&0 \\  0&\rightarrow&midPoint \\  1&\rightarrow&255\f} 
 		* For more details on mapping refer to the @ref two_linear_mapper() function.
+		* The mapped values are pre-calculated for all the combinations of the channel values, thus every pixel takes one table lookup.
+		* > This function supports PPL.
 		* @param img Input image of type \b CV_8UC3, where near-infra-red data is stored in the red channel.
 		* @param midPoint Parameter for the two-linear mapping of the feature (Ref. @ref two_linear_mapper()). 
 		* > Common values are: 
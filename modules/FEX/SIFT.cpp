@@ -1,6 +1,8 @@
 #include "SIFT.h"
 #include "opencv/SIFT.h"
+#include "Gradient.h"
 #include "LinearMapper.h"
+#include "DGM/ThreadPool.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex
@@ -55,4 +57,100 @@ namespace DirectGraphicalModels { namespace fex
 
 		return res;
 	}
+
+	Mat CSIFT::getDense(const Mat &img, int cellSize)
+	{
+		Mat Ix, Iy;
+		CGradient::getDerivatives(img, Ix, Iy);
+		return getDense(Ix, Iy, cellSize);
+	}
+
+	// The integral histograms of the 8 orientations are interleaved as in CHOG; every cell histogram is a box sum of the integral
+	Mat CSIFT::getDense(const Mat &Ix, const Mat &Iy, int cellSize)
+	{
+		DGM_ASSERT(cellSize > 0);
+		DGM_ASSERT(Ix.size() == Iy.size());
+		
+		const int	nBins	= 8;
+		const int	nCells	= 4;
+		const int	nFeatures = nCells * nCells * nBins;			// 128
+		const int	width	= Ix.cols;
+		const int	height	= Ix.rows;
+		const int	stride	= (width + 1) * nBins;					// length of a row of the integral histogram
+
+		// The orientations with the linear interpolation between the bins and the row-wise integrals: row y + 1 of the integral holds the prefix sums of the row y
+		std::vector<double> vInt(static_cast<size_t>(height + 1) * stride, 0);
+		parallel::parallelFor(Range(0, height), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				const float *pIx	= Ix.ptr<float>(y);
+				const float *pIy	= Iy.ptr<float>(y);
+				double		*pInt	= &vInt[static_cast<size_t>(y + 1) * stride + nBins];
+				for (int x = 0; x < width; x++, pInt += nBins) {
+					const float mgn		= sqrtf(pIx[x] * pIx[x] + pIy[x] * pIy[x]);
+					float		angle	= atan2f(pIy[x], pIx[x]);
+					if (angle < 0) angle += static_cast<float>(2 * Pi);
+					const float t		= angle * static_cast<float>(nBins / (2 * Pi));
+					const int	bin0	= static_cast<int>(t) % nBins;
+					const int	bin1	= (bin0 + 1) % nBins;
+					const float w1		= t - floorf(t);
+
+					for (int i = 0; i < nBins; i++) pInt[i] = pInt[i - nBins];
+					pInt[bin0] += mgn * (1 - w1);
+					pInt[bin1] += mgn * w1;
+				} // x
+			} // y
+		});
+
+		// Accumulating the integrals down the columns
+		parallel::parallelFor(Range(0, stride), [&](const Range &range) {
+			for (int y = 2; y <= height; y++) {
+				const double *pPrev = &vInt[static_cast<size_t>(y - 1) * stride];
+				double		 *pInt	= &vInt[static_cast<size_t>(y) * stride];
+				for (int x = range.start; x < range.end; x++) pInt[x] += pPrev[x];
+			} // y
+		}, 1024);
+
+		// The descriptors of the 4 x 4 cells, centered at every pixel
+		Mat res(Ix.size(), CV_8UC(nFeatures));
+		parallel::parallelFor(Range(0, height), [&](const Range &range) {
+			std::vector<float> vDesc(nFeatures);
+			for (int y = range.start; y < range.end; y++) {
+				int y0[nCells], y1[nCells];										// the clipped rows of the cells: [y0; y1)
+				for (int j = 0; j < nCells; j++) {
+					y0[j] = MIN(height, MAX(0, y + (j - nCells / 2) * cellSize));
+					y1[j] = MIN(height, MAX(0, y + (j - nCells / 2 + 1) * cellSize));
+				}
+				byte *pRes = res.ptr<byte>(y);
+				for (int x = 0; x < width; x++, pRes += nFeatures) {
+					float *pDesc = vDesc.data();
+					double sum2 = 0;
+					for (int j = 0; j < nCells; j++) {
+						const double *pInt0 = &vInt[static_cast<size_t>(y0[j]) * stride];
+						const double *pInt1 = &vInt[static_cast<size_t>(y1[j]) * stride];
+						for (int i = 0; i < nCells; i++, pDesc += nBins) {
+							const int x0 = MIN(width, MAX(0, x + (i - nCells / 2) * cellSize)) * nBins;
+							const int x1 = MIN(width, MAX(0, x + (i - nCells / 2 + 1) * cellSize)) * nBins;
+							for (int b = 0; b < nBins; b++) {
+								const float val = static_cast<float>(pInt1[x1 + b] - pInt1[x0 + b] - pInt0[x1 + b] + pInt0[x0 + b]);
+								pDesc[b] = val;
+								sum2 += val * val;
+							} // b
+						} // i
+					} // j
+
+					// Normalizing, clipping and re-normalizing
+					float norm = sum2 > FLT_EPSILON ? 1.0f / sqrtf(static_cast<float>(sum2)) : 0;
+					sum2 = 0;
+					for (float &val : vDesc) {
+						val = MIN(0.2f, val * norm);
+						sum2 += val * val;
+					}
+					norm = sum2 > FLT_EPSILON ? 512.0f / sqrtf(static_cast<float>(sum2)) : 0;
+					for (int i = 0; i < nFeatures; i++) pRes[i] = static_cast<byte>(MIN(255.0f, vDesc[i] * norm + 0.5f));
+				} // x
+			} // y
+		});
+
+		return res;
+	}
 } }
@@ -32,5 +32,42 @@ namespace DirectGraphicalModels { namespace fex
 		* @return Common feature extractor class with extracted SIFT feature of type \b CV_8UC{128}.
 		*/
 		DllExport static Mat	get(const Mat &img);
+		/**
+		* @brief Returns the halo of the feature
+		* @details The descriptor of the unit key point with the Gaussian smoothing of the scale space has a support of about 10 pixels; the halo includes a safety margin
+		* @return The width of the halo in pixels
+		*/
+		DllExport static int	getHalo(void) { return 16; }
+		/**
+		* @brief Extracts the dense SIFT feature.
+		* @details For each pixel of the source image this function calculates the SIFT descriptor of the \f$4\times 4\f$ cells of \f$cellSize\times cellSize\f$ pixels around it: 
+		* every cell contributes the histogram of the gradient orientations with 8 bins, the gradient magnitudes are linearly interpolated between the two nearest bins. 
+		* The descriptor is normalized as in the original SIFT: it is L2-normalized, clipped at 0.2 and L2-normalized again. In contrast to get(), the descriptors are computed
+		* without the Gaussian weighting of the cells, from the integral histograms, which makes the extraction time independent of the cell size (Ref. <a href="https://www.vlfeat.org/api/dsift.html" target="_blank">VLFeat dense SIFT</a>).
+		* > This function supports PPL.
+		* @param img Input image of type \b CV_8UC1 or \b CV_8UC3.
+		* @param cellSize The size of a cell in pixels
+		* @return The dense SIFT feature image of type \b CV_8UC{128}.
+		*/
+		DllExport static Mat	getDense(const Mat &img, int cellSize = 4);
+		/**
+		* @brief Extracts the dense SIFT feature from the derivatives
+		* @details This function is equivalent to getDense(const Mat &, int), but it uses the derivatives, calculated with CGradient::getDerivatives(), 
+		* which may be shared with the other gradient-based features.
+		* > This function supports PPL.
+		* @param Ix The derivative \f$\frac{d\,img}{dx}\f$: Mat(type: CV_32FC1).
+		* @param Iy The derivative \f$\frac{d\,img}{dy}\f$: Mat(type: CV_32FC1).
+		* @param cellSize The size of a cell in pixels
+		* @return The dense SIFT feature image of type \b CV_8UC{128}.
+		*/
+		DllExport static Mat	getDense(const Mat &Ix, const Mat &Iy, int cellSize = 4);
+		/**
+		* @brief Returns the halo of the dense SIFT feature
+		* @details The feature of a pixel depends only on the pixels within the halo around it, thus the feature may be extracted tile by tile with this halo (Ref. @ref CTiledExtractor).
+		* The halo includes the pixel, needed for the derivatives at the descriptor boundary
+		* @param cellSize The size of a cell in pixels
+		* @return The width of the halo in pixels
+		*/
+		DllExport static int	getDenseHalo(int cellSize = 4) { return 2 * cellSize + 1; }
 	};
 } }
\ No newline at end of file
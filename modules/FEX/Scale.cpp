@@ -1,37 +1,57 @@
 #include "Scale.h"
+#include "DGM/ThreadPool.h"
 
 namespace DirectGraphicalModels { namespace fex
 {
+// All the channels are averaged at once with one multi-channel integral image in O(1) per pixel
 Mat CScale::get(const Mat &img, SqNeighbourhood nbhd)
 {
-	int	width		= img.cols;
-	int	height		= img.rows;
-	int	nChannels	= img.channels();
+	const int width		= img.cols;
+	const int height	= img.rows;
+	const int nChannels	= img.channels();
 
 	Mat res(img.size(), img.type());
-	vec_mat_t vChannels;
-	split(img, vChannels);
-
-	Mat integralImg;												
-	for (byte c = 0; c < nChannels; c++) {		
-		integral(vChannels[c], integralImg);
-
-		for (int y = 0; y < height; y++) {
-			int		 y0 = MAX(0, y - nbhd.upperGap);
-			int	 	 y1 = MIN(y + nbhd.lowerGap, height - 1);
-			byte	*pRes = res.ptr<byte>(y);
-			int *pI0 = integralImg.ptr<int>(y0);
-			int *pI1 = integralImg.ptr<int>(y1 + 1);
-			for (int x = 0; x < width; x++) {
-				int		x0 = MAX(0, x - nbhd.leftGap);
-				int		x1 = MIN(x + nbhd.rightGap, width - 1);
-				int		S = (x1 - x0 + 1) * (y1 - y0 + 1);
-				float	med = static_cast<float>(pI1[x1 + 1] - pI1[x0] - pI0[x1 + 1] + pI0[x0]) / S;
-				pRes[nChannels * x + c] = static_cast<byte>(med + 0.5f);
-			} // x
+	Mat integralImg;
+	integral(img, integralImg, CV_64F);								// double: exact for the images up to 2^37 pixels
+
+	// The pixels, which neighbourhood does not cross the left and the right image boundaries
+	const int xBegin	= MIN(nbhd.leftGap, width);
+	const int xEnd		= MAX(xBegin, width - nbhd.rightGap);
+
+	parallel::parallelFor(Range(0, height), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			const int		  y0	= MAX(0, y - nbhd.upperGap);
+			const int		  y1	= MIN(y + nbhd.lowerGap, height - 1);
+			const double	* pI0	= integralImg.ptr<double>(y0);
+			const double	* pI1	= integralImg.ptr<double>(y1 + 1);
+			const int		  h		= y1 - y0 + 1;
+			byte			* pRes	= res.ptr<byte>(y);
+
+			auto border = [&](int x) {
+				const int	 x0 = MAX(0, x - nbhd.leftGap);
+				const int	 x1 = MIN(x + nbhd.rightGap, width - 1);
+				const double S	= (x1 - x0 + 1) * h;
+				for (int c = 0; c < nChannels; c++) {
+					const double med = (pI1[nChannels * (x1 + 1) + c] - pI1[nChannels * x0 + c] - pI0[nChannels * (x1 + 1) + c] + pI0[nChannels * x0 + c]) / S;
+					pRes[nChannels * x + c] = static_cast<byte>(med + 0.5);
+				} // c
+			};
+
+			for (int x = 0; x < xBegin; x++) border(x);
+
+			// Contiguous loop over the interleaved channels with the constant neighbourhood size: vectorized by the compiler
+			const double	S		= (nbhd.leftGap + nbhd.rightGap + 1) * h;
+			const int		l		= nChannels * nbhd.leftGap;
+			const int		r		= nChannels * (nbhd.rightGap + 1);
+			for (int i = nChannels * xBegin; i < nChannels * xEnd; i++) {
+				const double med = (pI1[i + r] - pI1[i - l] - pI0[i + r] + pI0[i - l]) / S;
+				pRes[i] = static_cast<byte>(med + 0.5);
+			} // i
+
+			for (int x = xEnd; x < width; x++) border(x);
 		} // y
-	} // c
+	});
 
 	return res;	
 }
-} }
\ No newline at end of file
+} }
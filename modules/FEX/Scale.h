@@ -29,11 +29,20 @@ namespace DirectGraphicalModels { namespace fex
 		* @brief Extracts the scale feature.
 		* @details For each pixel of the source image this function calculates the mean value within the pixel's neighbourhood \a nbhd.
 		* Using different neighbourhood radii, it alows for different scale representations of the features.
+		* The mean is taken from the integral image, thus the extraction time does not depend on the size of the neighbourhood.
+		* > This function supports PPL.
 		* @param img Input image of type \b CV_8Uxx with arbitrary number of channels.
 		* @param nbhd Neighborhood around the pixel, where the mean is estimated. (Ref. @ref SqNeighbourhood).
 		* @return The scale feature image of the same type as input image.
 		*/
 		DllExport static Mat	get(const Mat &img, SqNeighbourhood nbhd = sqNeighbourhood(5));
+		/**
+		* @brief Returns the halo of the feature
+		* @details The mean of a pixel is estimated in the neighbourhood \b nbhd, thus the halo is its largest gap
+		* @param nbhd Neighborhood around the pixel, where the feature is estimated. (Ref. @ref SqNeighbourhood).
+		* @return The width of the halo in pixels
+		*/
+		DllExport static int	getHalo(SqNeighbourhood nbhd = sqNeighbourhood(5)) { return fex::getHalo(nbhd); }
 	};
 
 } }
\ No newline at end of file
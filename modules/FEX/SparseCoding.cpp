@@ -1,6 +1,7 @@
 #include "SparseCoding.h"
 #include "SparseDictionary.h"
 #include "LinearMapper.h"
+#include "DGM/parallel.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace fex
@@ -35,32 +36,39 @@ vec_mat_t CSparseCoding::get_v(const Mat& img, const Mat& D, SqNeighbourhood nbh
 	for (word w = 0; w < nWords; w++)
 		res[w] = Mat(img.size(), CV_8UC1, cv::Scalar(0));
 
-#ifdef ENABLE_PDP
-	parallel_for_(Range(0, dataHeight), [&](const Range& range) {
-#else
-	const Range range(0, dataHeight);
-#endif
-	for (int y = range.start; y < range.end; y++) {
-		Mat _W, W;
-		for (int x = 0; x < dataWidth; x += 1) {
-			int s = y * dataWidth + x;										// sample index
-			Mat sample = X.row(s);											// sample as a row-vector
-			sample.convertTo(sample, CV_32FC1, 1.0 / normalizer);
+	// Precomputed dictionary terms: the transposed dictionary, the inverse norms of its words, the Gram matrix and the Lipschitz constant of the gradient
+	const Mat Dt = D.t();
+	Mat invNorm(1, nWords, CV_32FC1);
+	for (int w = 0; w < nWords; w++) invNorm.at<float>(0, w) = static_cast<float>(1.0 / norm(D.row(w), NORM_L2));
+	Mat gram;
+	const float L = calculateGram(D, gram);
 
-			gemm(D, sample.t(), 1.0, Mat(), 0.0, _W);						// W = D x sample^T
-			W = _W.t();
-			for (int w = 0; w < W.cols; w++)
-				W.col(w) /= norm(D.row(w), NORM_L2);
+	// The samples are encoded in blocks as matrices: one block per chunk
+	const int nSamples	= dataHeight * dataWidth;
+	const int blockLen	= 256;
+	parallel::parallelFor(Range(0, (nSamples - 1) / blockLen + 1), [&](const Range& range) {
+		Mat samples, W;
+		for (int b = range.start; b < range.end; b++) {
+			const int s0 = b * blockLen;
+			const int s1 = MIN(s0 + blockLen, nSamples);
+			X.rowRange(s0, s1).convertTo(samples, CV_32FC1, 1.0 / normalizer);
 
-			calculate_W(sample, D, W, SC_LAMBDA, SC_EPSILON, 200, SC_LRATE_W);
+			Mat XDt, invNorms;
+			parallel::gemm(samples, Dt, 1.0f, Mat(), 0.0f, XDt);						// XDt = samples x D^T
+			repeat(invNorm, XDt.rows, 1, invNorms);
+			W = XDt.mul(invNorms);														// the initial guess: the normalized correlations with the words
 
-			for (word w = 0; w < nWords; w++)
-				res[w].at<byte>(y + nbhd.upperGap, x + nbhd.leftGap) = linear_mapper<byte>(W.at<float>(0, w), -1.0f, 1.0f);
-		} // x
-	} // y
-#ifdef ENABLE_PDP
-	});
-#endif
+			calculate_W_FISTA(XDt, gram, L, W, SC_LAMBDA, 200);
+
+			for (int s = s0; s < s1; s++) {
+				const int	 y	= s / dataWidth;
+				const int	 x	= s % dataWidth;
+				const float *pW = W.ptr<float>(s - s0);
+				for (word w = 0; w < nWords; w++)
+					res[w].at<byte>(y + nbhd.upperGap, x + nbhd.leftGap) = linear_mapper<byte>(pW[w], -1.0f, 1.0f);
+			} // s
+		} // b
+	}, 1);
 	return res;
 }
 } }
\ No newline at end of file
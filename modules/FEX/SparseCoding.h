@@ -39,7 +39,10 @@ namespace DirectGraphicalModels {
 			DllExport static Mat		get(const Mat &img, const Mat &D, SqNeighbourhood nbhd = sqNeighbourhood(3));
 			/**
 			* @brief Extracts the sparse coding feature.
-			* @details This function is an alternative to get(), which can handle large amount of features (more then 512)
+			* @details This function is an alternative to get(), which can handle large amount of features (more then 512).
+			* The patches are encoded in blocks of 256 patches, processed in parallel, with the FISTA solver (ref. CSparseDictionary::calculate_W_FISTA()), which uses the 
+			* Gram matrix of the dictionary, computed once per call.
+			* > This function supports PPL.
 			* @param img Input image of type \b CV_8UC1 or \b CV_8UC3.
 			* @param D Sparse dictionary \f$D\f$:  Mat(size nWords x blockSize^2; type CV_32FC1).
 			* > Dictionary should be learned from a training data with CSparseDictionary::train() function,<br>
@@ -48,6 +51,13 @@ namespace DirectGraphicalModels {
 			* @return The vector with \a nWords sparse coding feature images of type \b CV_8UC1 each.
 			*/
 			DllExport static vec_mat_t	get_v(const Mat &img, const Mat &D, SqNeighbourhood nbhd = sqNeighbourhood(3));
+			/**
+			* @brief Returns the halo of the feature
+			* @details The sample of a pixel is the block of the neighbourhood \b nbhd, thus the halo is its largest gap
+			* @param nbhd Neighborhood around the pixel, where the feature is estimated. (Ref. @ref SqNeighbourhood).
+			* @return The width of the halo in pixels
+			*/
+			DllExport static int		getHalo(SqNeighbourhood nbhd = sqNeighbourhood(3)) { return fex::getHalo(nbhd); }
 		};
 	}
 }
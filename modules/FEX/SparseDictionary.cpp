@@ -75,6 +75,77 @@ void CSparseDictionary::train(const Mat &X, word nWords, dword batch, unsigned i
 	} // i
 }
 
+// A and B are the sufficient statistics of all the processed mini-batches: the history of the codes
+void CSparseDictionary::trainOnline(const Mat &X, word nWords, dword batch, unsigned int nIt, const std::string &fileName)
+{
+	const dword		nSamples	= X.rows;
+	const int		sampleLen	= X.cols;
+	const int		normalizer	= (X.depth() == CV_8U) ? 255 : 65535;
+	const int		blockLen	= 64;										// the number of samples, encoded in one parallel chunk
+
+	// Assertions
+	DGM_ASSERT_MSG((X.depth() == CV_8U) || (X.depth() == CV_16U), "The depth of argument X is not supported");
+	if (batch > nSamples) {
+		DGM_WARNING("The batch number %d exceeds the length of the training data %d", batch, nSamples);
+		batch = nSamples;
+	}
+
+	// 1. Initialize dictionary D randomly with the words in the unit ball
+	if (!m_D.empty()) m_D.release();
+	m_D = random::N(cv::Size(sampleLen, nWords), CV_32FC1, 0.0f, 0.3f);
+	for (word w = 0; w < nWords; w++) m_D.row(w) /= MAX(1.0, norm(m_D.row(w), NORM_L2));
+
+	Mat A(nWords, nWords, CV_32FC1, Scalar(0));							// A = sum W^T x W
+	Mat B(nWords, sampleLen, CV_32FC1, Scalar(0));						// B = sum W^T x X
+	Mat _X, W(batch, nWords, CV_32FC1);
+	Mat gram, Dt;
+
+	// 2. Repeat until convergence
+	for (unsigned int i = 0; i < nIt; i++) {								// iterations
+		// 2.1 Select a random mini-batch
+		dword rndRow = random::u<dword>(0, MAX(1, nSamples - batch) - 1);
+		X(cv::Rect(0, rndRow, sampleLen, batch)).convertTo(_X, CV_32FC1, 1.0 / normalizer);
+
+		// 2.2 Sparse coding of the mini-batch in parallel blocks
+		const float L = calculateGram(m_D, gram);
+		transpose(m_D, Dt);
+		parallel::parallelFor(Range(0, (static_cast<int>(batch) - 1) / blockLen + 1), [&](const Range &range) {
+			Mat XDt;
+			for (int b = range.start; b < range.end; b++) {
+				const Range rows(b * blockLen, MIN((b + 1) * blockLen, static_cast<int>(batch)));
+				parallel::gemm(_X.rowRange(rows), Dt, 1.0f, Mat(), 0.0f, XDt);	// XDt = X x D^T
+				Mat _W = Mat::zeros(XDt.size(), CV_32FC1);
+				calculate_W_FISTA(XDt, gram, L, _W, SC_LAMBDA, 100);
+				_W.copyTo(W.rowRange(rows));
+			} // b
+		}, 1);
+
+		// 2.3 Update the sufficient statistics; the older mini-batches are forgotten (Ref. Mairal et al., Sec. 3.4.2)
+		const double t		= i + 1;
+		const double theta	= t < batch ? t * batch : static_cast<double>(batch) * batch + t - batch;
+		const float  beta	= static_cast<float>((theta + 1 - batch) / (theta + 1));
+		parallel::gemm(W.t(), W, 1.0f / batch, A, beta, A);
+		parallel::gemm(W.t(), _X, 1.0f / batch, B, beta, B);
+
+		// 2.4 Update the words with the block-coordinate descent
+		Mat u;
+		for (word w = 0; w < nWords; w++) {
+			const float a = A.at<float>(w, w);
+			if (a < FLT_EPSILON) continue;									// the word is not used
+			parallel::gemm(A.row(w), m_D, -1.0f / a, B.row(w), 1.0f / a, u);	// u = (b_j - a_j x D) / a_jj
+			u += m_D.row(w);
+			u /= MAX(1.0, norm(u, NORM_L2));
+			u.copyTo(m_D.row(w));
+		} // w
+
+#ifdef DEBUG_PRINT_INFO
+		printf("--- It: %d --- Cost: %f\n", i, calculateCost(_X, m_D, W, SC_LAMBDA, SC_EPSILON, 0));
+#endif
+		// 2.5 Saving intermediate dictionary
+		if (!fileName.empty() && i % 5 == 0) save(fileName + std::to_string(i / 5) + ".dic");
+	} // i
+}
+
 void CSparseDictionary::save(const std::string &fileName) const
 {
 	FILE *pFile = fopen(fileName.c_str(), "wb");
@@ -120,36 +191,31 @@ Mat CSparseDictionary::TEST_decode(const Mat &X, cv::Size imgSize) const
 	Mat res(imgSize, CV_32FC1, Scalar(0));
 	Mat cover(imgSize, CV_32FC1, Scalar(0));
 
-#ifdef ENABLE_PDP
-	concurrency::parallel_for(0, dataHeight, blockSize, [&](int y) {
-#else
-	for (int y = 0; y < dataHeight; y += blockSize) {
-#endif
-		Mat _W, W;
-		Mat tmp;
-		for (int x = 0; x < dataWidth; x += blockSize) {
-			int s = y * dataWidth + x;										// sample index
-			Mat sample = X.row(s);											// sample
-			sample.convertTo(sample, CV_32FC1, 1.0 / normalizer);
-
-			gemm(m_D, sample.t(), 1.0, Mat(), 0.0, _W);						// _W = (D x sample^T)
-			W = _W.t();														// W = (D x sample^T)^T
-			for (int w = 0; w < W.cols; w++)
-				W.col(w) /= norm(m_D.row(w), NORM_L2);
-
-			// argmin J(W) = ||W x D - X||^{2}_{2} + \lambda||W||_1
-			calculate_W(sample, m_D, W, lambda, epsilon, 800);
-
-			gemm(W, m_D, 1.0, Mat(), 0.0, tmp);								// tmp = W x D
-			tmp = tmp.reshape(0, blockSize);
-
-			res(Rect(x, y, blockSize, blockSize))   += tmp;
-			cover(Rect(x, y, blockSize, blockSize)) += 1.0;
+	parallel::parallelFor(Range(0, (dataHeight + blockSize - 1) / blockSize), [&](const Range& range) {
+		for (int y = range.start * blockSize; y < MIN(range.end * blockSize, dataHeight); y += blockSize) {
+			Mat _W, W;
+			Mat tmp;
+			for (int x = 0; x < dataWidth; x += blockSize) {
+				int s = y * dataWidth + x;										// sample index
+				Mat sample = X.row(s);											// sample
+				sample.convertTo(sample, CV_32FC1, 1.0 / normalizer);
+
+				gemm(m_D, sample.t(), 1.0, Mat(), 0.0, _W);						// _W = (D x sample^T)
+				W = _W.t();														// W = (D x sample^T)^T
+				for (int w = 0; w < W.cols; w++)
+					W.col(w) /= norm(m_D.row(w), NORM_L2);
+
+				// argmin J(W) = ||W x D - X||^{2}_{2} + \lambda||W||_1
+				calculate_W(sample, m_D, W, lambda, epsilon, 800);
+
+				gemm(W, m_D, 1.0, Mat(), 0.0, tmp);								// tmp = W x D
+				tmp = tmp.reshape(0, blockSize);
+
+				res(Rect(x, y, blockSize, blockSize))   += tmp;
+				cover(Rect(x, y, blockSize, blockSize)) += 1.0;
+			}
 		}
-	}
-#ifdef ENABLE_PDP
-	);
-#endif
+	}, 1);
 	res /= cover;
 	res.convertTo(res, sampleType, normalizer);
 	return res;
@@ -231,6 +297,42 @@ void CSparseDictionary::calculate_W(const Mat &X, const Mat &D, Mat &W, float la
 	} // i
 }
 
+// Y is the extrapolated point of the accelerated scheme
+void CSparseDictionary::calculate_W_FISTA(const Mat &XDt, const Mat &gram, float L, Mat &W, float lambda, unsigned int nIt)
+{
+	const float threshold = lambda / L;
+	Mat Y = W.clone();
+	Mat W_new(W.size(), W.type());
+	Mat gradient;
+	float t = 1.0f;
+	for (unsigned int i = 0; i < nIt; i++) {
+		parallel::gemm(Y, gram, 2.0f, XDt, -2.0f, gradient);						// gradient = 2 * (Y x D x D^T - X x D^T)
+		const float t_new	 = 0.5f * (1.0f + sqrtf(1.0f + 4.0f * t * t));
+		const float momentum = (t - 1.0f) / t_new;
+		for (int s = 0; s < W.rows; s++) {
+			const float *pGradient	= gradient.ptr<float>(s);
+			float		*pY			= Y.ptr<float>(s);
+			float		*pW			= W.ptr<float>(s);
+			float		*pW_new		= W_new.ptr<float>(s);
+			for (int w = 0; w < W.cols; w++) {
+				const float val = pY[w] - pGradient[w] / L;
+				pW_new[w] = val > threshold ? val - threshold : (val < -threshold ? val + threshold : 0.0f);		// soft thresholding
+				pY[w]	  = pW_new[w] + momentum * (pW_new[w] - pW[w]);
+			} // w
+		} // s
+		std::swap(W, W_new);
+		t = t_new;
+	} // i
+}
+
+float CSparseDictionary::calculateGram(const Mat &D, Mat &gram)
+{
+	parallel::gemm(D, D.t(), 1.0f, Mat(), 0.0f, gram);						// gram = D x D^T
+	Mat eigenValues;
+	eigen(gram, eigenValues);
+	return 2.0f * MAX(FLT_EPSILON, eigenValues.at<float>(0, 0));
+}
+
 // J(D) = ||W x D - X||^{2}_{2} + \gamma||D||^{2}_{2}
 void CSparseDictionary::calculate_D(const Mat &X, Mat &D, const Mat &W, float gamma, unsigned int nIt, float lRate)
 {
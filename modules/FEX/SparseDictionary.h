@@ -65,6 +65,23 @@ namespace DirectGraphicalModels { namespace fex
 		*/
 		DllExport void train(const Mat &X, word nWords, dword batch = 2000, unsigned int nIt = 1000, float lRate = SC_LRATE_D, const std::string &fileName = std::string());
 		/**
+		* @brief Trains dictionary \f$D\f$ with the online dictionary learning
+		* @details This function creates and trains new dictionary \f$D\f$ on data \f$X\f$ with the <a href="https://www.di.ens.fr/~fbach/mairal_icml09.pdf">online dictionary learning</a> 
+		* of Mairal et al. In every iteration a random mini-batch of samples is encoded with calculate_W_FISTA() in parallel blocks, the sufficient statistics
+		* \f$A = \sum W^\top\times W\f$ and \f$B = \sum W^\top\times X\f$ are accumulated with a forgetting factor, and every word is updated by one pass of the block-coordinate descent:
+		* \f[ \vec{d}_j \leftarrow \frac{\vec{u}_j}{\max(1, \left\|\vec{u}_j\right\|_2)}, \qquad \vec{u}_j = \vec{d}_j + \frac{\vec{b}_j - \vec{a}_j \times D}{a_{j,j}}, \f]
+		* thus, the words are constrained to the unit ball instead of the \f$\gamma\left\|D\right\|^{2}_{2}\f$ regularization of train(). The cost of an iteration does not depend on the number of the processed samples.
+		* > This function supports PPL.
+		* @param X Training data \f$X\f$: Mat(size nSamples x sampleLen; type CV_8UC1 or CV_16UC1)
+		* > May be derived from an image with img2data() fucntion
+		* @param nWords Length of the dictionary (number of words)
+		* @param batch The number of randomly chosen samples from \b X to be used in every distinct iteration of training
+		* @param nIt Number of iterations
+		* @param fileName Path and file name to store intermediate dictionaries \f$D\f$ (every 5 iterations) in the format of save().
+		* If specified the resulting file name will be the follows: \b fileName<it/5>.dic
+		*/
+		DllExport void trainOnline(const Mat &X, word nWords, dword batch = 512, unsigned int nIt = 1000, const std::string &fileName = std::string());
+		/**
 		* @brief Saves dictionary \f$D\f$ into a binary file
 		* @param fileName Full file name
 		*/
@@ -184,6 +201,27 @@ namespace DirectGraphicalModels { namespace fex
 		* @param[in] lRate Learning rate parameter, which is charged with the speed of convergence
 		*/
 		DllExport static void calculate_D(const Mat &X, Mat &D, const Mat &W, float gamma, unsigned int nIt = 800, float lRate = SC_LRATE_D);
+		/**
+		* @brief Evaluates weighting coefficients matrix \f$W\f$ of a batch of samples with FISTA
+		* @details Finds the \f$W\f$, that minimizes the cost of every sample (row of \f$X\f$) for the given \f$D\f$:
+		* \f[ \text{arg}\,\min\limits_{W} \left\| W \times D - X \right\|^{2}_{2} + \lambda\sum_{i,j}{\left|w_{i,j}\right|} \f]
+		* with the <a href="https://doi.org/10.1137/080716542">fast iterative shrinkage-thresholding algorithm</a>. The gradient \f$2\,(W \times D\,D^\top - X \times D^\top)\f$ 
+		* is calculated with the precomputed products, thus one iteration takes one matrix multiplication of size nSamples x nWords x nWords, independently of the sample length.
+		* @param[in] XDt The product \f$X \times D^\top\f$: Mat(size nSamples x nWords; type CV_32FC1)
+		* @param[in] gram The Gram matrix of the dictionary \f$D \times D^\top\f$: Mat(size nWords x nWords; type CV_32FC1)
+		* @param[in] L The Lipschitz constant of the gradient: two times the largest eigenvalue of \b gram
+		* @param[in,out] W  Weighting coefficients \f$W\f$:  Mat(size nSamples x nWords; type CV_32FC1)
+		* @param[in] lambda Regularisation parameter \f$\lambda\f$
+		* @param[in] nIt Number of iterations
+		*/
+		DllExport static void calculate_W_FISTA(const Mat &XDt, const Mat &gram, float L, Mat &W, float lambda, unsigned int nIt = 200);
+		/**
+		* @brief Calculates the Gram matrix of the dictionary
+		* @param[in] D Dictionary \f$D\f$:  Mat(size nWords x sampleLen; type CV_32FC1)
+		* @param[out] gram The Gram matrix \f$D \times D^\top\f$: Mat(size nWords x nWords; type CV_32FC1)
+		* @returns The Lipschitz constant of the gradient in calculate_W_FISTA(): two times the largest eigenvalue of \b gram
+		*/
+		DllExport static float calculateGram(const Mat &D, Mat &gram);
 
 
 	private:
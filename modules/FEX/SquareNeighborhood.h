@@ -2,6 +2,8 @@
 // Written by Sergey G. Kosov in 2015 for Project X
 #pragma once
 
+#include <algorithm>
+
 namespace DirectGraphicalModels { namespace fex
 {
 	/**
@@ -86,4 +88,11 @@ namespace DirectGraphicalModels { namespace fex
 		}
 		return nbhd;
 	}
+	/**
+	* @brief Returns the halo of the neighborhood
+	* @details The halo is the width of the image margin, which the features of the pixels, located at the margin, depend on (Ref. @ref CTiledExtractor)
+	* @param nbhd The neighborhood (Ref. @ref SqNeighbourhood)
+	* @returns The largest distance from the base point to the neighborhood's boundaries
+	*/
+	inline int getHalo(const SqNeighbourhood &nbhd) { return std::max(std::max(nbhd.leftGap, nbhd.rightGap), std::max(nbhd.upperGap, nbhd.lowerGap)); }
 } }
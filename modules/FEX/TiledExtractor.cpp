@@ -0,0 +1,48 @@
+#include "TiledExtractor.h"
+#include "DGM/ThreadPool.h"
+#include "macroses.h"
+#include <mutex>
+
+namespace DirectGraphicalModels { namespace fex
+{
+Mat CTiledExtractor::extract(const Rect &region, Size imageSize, const reader_function_t &reader) const
+{
+	const Rect image(Point(0, 0), imageSize);
+	const Rect core = region & image;
+	const Rect tile = Rect(core.x - m_halo, core.y - m_halo, core.width + 2 * m_halo, core.height + 2 * m_halo) & image;
+
+	Mat img = reader(tile);
+	DGM_ASSERT_MSG(img.size() == tile.size(), "The region of the source image has wrong size");
+	Mat features = m_extractor(img);
+	DGM_ASSERT_MSG(features.size() == tile.size(), "The feature image has wrong size");
+	return features(Rect(core.tl() - tile.tl(), core.size()));
+}
+
+void CTiledExtractor::process(Size imageSize, reader_function_t reader, writer_function_t writer) const
+{
+	DGM_ASSERT_MSG(m_tileSize.width > 0 && m_tileSize.height > 0, "Wrong tile size");
+	const int nTilesX = (imageSize.width  + m_tileSize.width  - 1) / m_tileSize.width;
+	const int nTilesY = (imageSize.height + m_tileSize.height - 1) / m_tileSize.height;
+
+	parallel::parallelFor(Range(0, nTilesX * nTilesY), [&](const Range &range) {
+		for (int t = range.start; t < range.end; t++) {
+			const Rect core = Rect(Point((t % nTilesX) * m_tileSize.width, (t / nTilesX) * m_tileSize.height), m_tileSize) & Rect(Point(0, 0), imageSize);
+			writer(core, extract(core, imageSize, reader));
+		} // t
+	}, 1);
+}
+
+Mat CTiledExtractor::process(const Mat &img) const
+{
+	Mat res;
+	std::mutex mtx;
+	process(img.size(), [&img](const Rect &roi) { return img(roi); }, [&](const Rect &roi, const Mat &features) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (res.empty()) res.create(img.size(), features.type());				// the type of the features is known after the first tile
+		}
+		features.copyTo(res(roi));
+	});
+	return res;
+}
+} }
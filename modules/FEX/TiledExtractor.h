@@ -0,0 +1,89 @@
+// Tiled feature extraction class interface
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+namespace DirectGraphicalModels { namespace fex
+{
+	// ================================ Tiled Extractor Class ==============================
+	/**
+	* @ingroup moduleLFEX
+	* @brief Tiled extraction of local features from large images
+	* @details This class extracts a local feature from the images, which do not fit into the memory at once, \a e.g. large GeoTIFF files. The image is split into tiles,
+	* every tile is extended with a halo, which is read together with the tile and passed to the extractor; only the features of the tile core, \a i.e. without the halo, are kept.
+	* The local extractors declare the halo, which they need: \a e.g. CHOG::getHalo(), CVariance::getHalo(). If the halo is not smaller, than the one declared by the extractor,
+	* the tiled result is equal to the result of the extractor, applied to the whole image.
+	*
+	* The tiles are processed in parallel. The image regions are requested and the features are returned tile by tile via the callback functions,
+	* thus the peak memory is bounded by the tile size times the number of threads. The features of a region may also be requested directly with extract(), 
+	* \a e.g. by the potentials callback of the @ref CInferTiled: 
+	* @code
+	* CTiledExtractor tiledFex([](const Mat &img) { return CHOG::get(img, 9, sqNeighbourhood(5)); }, CHOG::getHalo(sqNeighbourhood(5)));
+	* CInferTiled tiledInfer(nStates);
+	* tiledInfer.decode(imageSize, [&](const Rect &tile) { 
+	*	Mat features = tiledFex.extract(tile, imageSize, reader);
+	*	return trainer.getNodePotentials(features);
+	* }, writer);
+	* @endcode
+	* > Only the extractors, which depend on a bounded neighbourhood of a pixel, may be tiled: the coordinate and the distance features depend on the whole image.
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CTiledExtractor
+	{
+	public:
+		/**
+		* @brief Callback function returning the region of the source image
+		* @details The argument is the region of the image; the result is the image data of the region
+		*/
+		using reader_function_t		= std::function<Mat(const Rect &)>;
+		/**
+		* @brief Callback function extracting the feature
+		* @details The argument is the image of a tile with the halo; the result is the feature image of the same size, \a e.g. the result of a static \a get() function of a local feature extractor
+		*/
+		using extractor_function_t	= std::function<Mat(const Mat &)>;
+		/**
+		* @brief Callback function receiving the features of the region
+		* @details The arguments are the region of the image and the features of the region. The regions of different calls do not overlap
+		*/
+		using writer_function_t		= std::function<void(const Rect &, const Mat &)>;
+		/**
+		* @brief Constructor
+		* @param extractor The callback function, extracting the feature. It is called concurrently for different tiles
+		* @param halo The width of the halo in pixels
+		* @param tileSize The size of the tile core
+		*/
+		DllExport CTiledExtractor(extractor_function_t extractor, int halo, Size tileSize = Size(512, 512)) 
+			: m_extractor(extractor), m_halo(halo), m_tileSize(tileSize) {}
+		DllExport ~CTiledExtractor(void) = default;
+
+		/**
+		* @brief Extracts the feature of a region
+		* @param region The region of the image
+		* @param imageSize The size of the image
+		* @param reader The callback function, which returns a region of the source image
+		* @return The feature image of the region
+		*/
+		DllExport Mat	extract(const Rect &region, Size imageSize, const reader_function_t &reader) const;
+		/**
+		* @brief Extracts the feature tile by tile
+		* @param imageSize The size of the image
+		* @param reader The callback function, which returns a region of the source image. It is called concurrently for different regions
+		* @param writer The callback function, which receives the features of a tile. It is called concurrently for different tiles
+		*/
+		DllExport void	process(Size imageSize, reader_function_t reader, writer_function_t writer) const;
+		/**
+		* @brief Extracts the feature tile by tile
+		* @param img The source image
+		* @return The feature image
+		*/
+		DllExport Mat	process(const Mat &img) const;
+
+
+	private:
+		extractor_function_t	m_extractor;		///< The feature extractor
+		int						m_halo;				///< The width of the halo
+		Size					m_tileSize;			///< The size of the tile core
+	};
+} }
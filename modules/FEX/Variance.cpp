@@ -1,46 +1,68 @@
 #include "Variance.h"
 #include "LinearMapper.h"
+#include "DGM/ThreadPool.h"
 
 namespace DirectGraphicalModels { namespace fex
 {
+// The sums of the values and of the squared values within the neighbourhood are taken from the integral images in O(1) per pixel
 Mat	CVariance::get(const Mat &img, SqNeighbourhood nbhd)
 {
-	int				width	= img.cols;
-	int				height	= img.rows;
+	const int width		= img.cols;
+	const int height	= img.rows;
 
 	// Converting to one channel image
 	Mat	I;
 	if (img.channels() != 1) cvtColor(img, I, cv::ColorConversionCodes::COLOR_RGB2GRAY);
-	else img.copyTo(I);
-
-	Mat res(img.size(), CV_8UC1);									
-	Mat integralImg;												
-	integral(I, integralImg);
-	
-	for (int y = 0; y < height; y++) {
-		int		 y0		= MAX(0, y - nbhd.upperGap);
-		int	 	 y1		= MIN(y + nbhd.lowerGap, height -1);
-		byte	*pRes	= res.ptr<byte>(y);
-		int *pI0	= integralImg.ptr<int>(y0);
-		int *pI1	= integralImg.ptr<int>(y1 + 1);
-		for (int x = 0; x < width; x++) {
-			int		x0	= MAX(0, x - nbhd.leftGap);
-			int		x1	= MIN(x + nbhd.rightGap, width - 1);
-			int		S	= (x1 - x0 + 1) * (y1 - y0 + 1);
-			float	med = static_cast<float>(pI1[x1 + 1] - pI1[x0] - pI0[x1 + 1] + pI0[x0]) / S;
-			float	Sum = 0;
-			for (int j = y0; j <= y1; j++) {
-				byte *pImg = I.ptr<byte>(j);
-				for (int i = x0; i <= x1; i++) {
-					float dif = static_cast<float>(pImg[i]) - med;
-					Sum += dif*dif;
-				} // i
-			} // j
-			float val = sqrtf(Sum / S);
-			pRes[x] = linear_mapper<byte>(val, 0, 100);
-		} // x
-	} // y
+	else I = img;
+
+	Mat res(img.size(), CV_8UC1);
+	Mat integralImg, integralSqImg;
+	integral(I, integralImg, integralSqImg, CV_64F, CV_64F);		// double: exact for the images up to 2^37 pixels
+
+	// The pixels, which neighbourhood does not cross the left and the right image boundaries
+	const int xBegin	= MIN(nbhd.leftGap, width);
+	const int xEnd		= MAX(xBegin, width - nbhd.rightGap);
+
+	parallel::parallelFor(Range(0, height), [&](const Range &range) {
+		std::vector<float> vStd(width);
+		for (int y = range.start; y < range.end; y++) {
+			const int		  y0	= MAX(0, y - nbhd.upperGap);
+			const int		  y1	= MIN(y + nbhd.lowerGap, height - 1);
+			const double	* pS0	= integralImg.ptr<double>(y0);
+			const double	* pS1	= integralImg.ptr<double>(y1 + 1);
+			const double	* pQ0	= integralSqImg.ptr<double>(y0);
+			const double	* pQ1	= integralSqImg.ptr<double>(y1 + 1);
+			const int		  h		= y1 - y0 + 1;
+
+			auto border = [&](int x) {
+				const int	 x0		= MAX(0, x - nbhd.leftGap);
+				const int	 x1		= MIN(x + nbhd.rightGap, width - 1);
+				const double S		= (x1 - x0 + 1) * h;
+				const double sum	= pS1[x1 + 1] - pS1[x0] - pS0[x1 + 1] + pS0[x0];
+				const double sumSq	= pQ1[x1 + 1] - pQ1[x0] - pQ0[x1 + 1] + pQ0[x0];
+				vStd[x] = sqrtf(static_cast<float>(MAX(0.0, (sumSq - sum * sum / S) / S)));
+			};
+
+			for (int x = 0; x < xBegin; x++) border(x);
+			
+			// Contiguous loop with the constant neighbourhood size: vectorized by the compiler
+			const double	  S		= (nbhd.leftGap + nbhd.rightGap + 1) * h;
+			const int		  l		= nbhd.leftGap;
+			const int		  r		= nbhd.rightGap + 1;
+			float			* pStd	= vStd.data();
+			for (int x = xBegin; x < xEnd; x++) {
+				const double sum	= pS1[x + r] - pS1[x - l] - pS0[x + r] + pS0[x - l];
+				const double sumSq	= pQ1[x + r] - pQ1[x - l] - pQ0[x + r] + pQ0[x - l];
+				pStd[x] = sqrtf(static_cast<float>(MAX(0.0, (sumSq - sum * sum / S) / S)));
+			} // x
+			
+			for (int x = xEnd; x < width; x++) border(x);
+
+			byte *pRes = res.ptr<byte>(y);
+			for (int x = 0; x < width; x++) pRes[x] = linear_mapper<byte>(vStd[x], 0, 100);
+		} // y
+	});
 
 	return res;	
 }
-} }
\ No newline at end of file
+} }
@@ -27,10 +27,19 @@ namespace DirectGraphicalModels { namespace fex
 		/**
 		* @brief Extracts the variance feature.
 		* @details For each pixel of the source image this function calculates the variance within the pixel's neighbourhood \a nbhd.
+		* The variance is taken from the integral images of the values and of the squared values, thus the extraction time does not depend on the size of the neighbourhood.
+		* > This function supports PPL.
 		* @param img Input image of type \b CV_8UC1 or \b CV_8UC3.
 		* @param nbhd Neighborhood around the pixel, where the variance is estimated. (Ref. @ref SqNeighbourhood).
 		* @return The variance feature image of type \b CV_8UC1.
 		*/
 		DllExport static Mat	get(const Mat &img, SqNeighbourhood nbhd = sqNeighbourhood(5));
+		/**
+		* @brief Returns the halo of the feature
+		* @details The variance of a pixel is estimated in the neighbourhood \b nbhd, thus the halo is its largest gap
+		* @param nbhd Neighborhood around the pixel, where the feature is estimated. (Ref. @ref SqNeighbourhood).
+		* @return The width of the halo in pixels
+		*/
+		DllExport static int	getHalo(SqNeighbourhood nbhd = sqNeighbourhood(5)) { return fex::getHalo(nbhd); }
 	};
 } }
@@ -0,0 +1,35 @@
+R"(
+#version 330 core
+
+// Input vertex data of the cone mesh: the top is at the origin and the axis is Z
+layout(location = 0) in vec3 vertexPosition;
+
+// Input instance data, different for every cone
+layout(location = 2) in vec3 coneTop;
+layout(location = 3) in vec3 coneAxis;
+layout(location = 4) in int  coneNode;
+
+// Output data ; will be interpolated for each fragment.
+out vec3 fragmentColor;
+
+// Values that stay constant for the whole mesh.
+uniform mat4 MVP;
+uniform samplerBuffer nodeColors;
+
+void main()
+{
+	// Orthonormal basis around the cone's axis
+	float len = length(coneAxis);
+	vec3 dir = len > 0.0f ? coneAxis / len : vec3(0, 0, 1);
+	vec3 normal = cross(dir, vec3(0, 0, 1));
+	if (length(normal) < 1e-6f) normal = cross(dir, vec3(0, 1, 0));
+	normal = normalize(normal);
+	vec3 binormal = cross(dir, normal);
+
+	vec3 position = coneTop + len * (vertexPosition.x * normal + vertexPosition.y * binormal + vertexPosition.z * dir);
+	gl_Position = MVP * vec4(position, 1);
+
+	// The cone has the color of its node
+	fragmentColor = texelFetch(nodeColors, coneNode).rgb;
+}
+)"
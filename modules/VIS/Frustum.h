@@ -0,0 +1,54 @@
+// View Frustum Culling
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <array>
+
+namespace DirectGraphicalModels { namespace vis
+{
+	/**
+	* @brief View frustum culling
+	* @details This namespace collects methods for testing the axis-aligned bounding boxes against the viewing frustum (ref. CGraphViewer3D)
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	namespace frustum {
+		/// The six planes \f$(a, b, c, d)\f$ of the viewing frustum: the points with \f$ax + by + cz + d \geq 0\f$ lie inside
+		using planes_t = std::array<Vec4f, 6>;
+
+		/**
+		* @brief Returns the planes of the viewing frustum
+		* @details The planes are the sums and the differences of the rows of the model-view-projection matrix
+		* @param MVP The model-view-projection matrix, which transforms the homogeneous points to the clip space: \f$p_{clip} = MVP \cdot (x, y, z, 1)^\top\f$
+		* @return The planes of the frustum
+		*/
+		inline planes_t getPlanes(const Matx44f &MVP)
+		{
+			planes_t res;
+			for (int i = 0; i < 3; i++)
+				for (int c = 0; c < 4; c++) {
+					res[2 * i][c]		= MVP(3, c) + MVP(i, c);
+					res[2 * i + 1][c]	= MVP(3, c) - MVP(i, c);
+				}
+			return res;
+		}
+		/**
+		* @brief Checks whether an axis-aligned bounding box may be visible
+		* @details The box is culled only if it lies completely outside of one of the planes, thus a few boxes near the corners of the frustum are
+		* reported as visible, while they are not
+		* @param planes The planes of the frustum (ref. getPlanes())
+		* @param min The minimal corner of the box
+		* @param max The maximal corner of the box
+		* @retval true if the box may intersect the frustum
+		* @retval false if the box is outside of the frustum
+		*/
+		inline bool isVisible(const planes_t &planes, const Point3f &min, const Point3f &max)
+		{
+			for (const Vec4f &plane : planes) {
+				const Point3f corner(plane[0] > 0 ? max.x : min.x, plane[1] > 0 ? max.y : min.y, plane[2] > 0 ? max.z : min.z);	// the corner farthest along the normal
+				if (plane[0] * corner.x + plane[1] * corner.y + plane[2] * corner.z + plane[3] < 0) return false;
+			}
+			return true;
+		}
+	}
+} }
@@ -1,6 +1,7 @@
 #include "Marker.h"
 #include "ColorSpaces.h"
 #include "macroses.h"
+#include "DGM/parallel.h"
 
 
 namespace DirectGraphicalModels { namespace vis
@@ -24,7 +25,6 @@ CMarker::CMarker(const vec_nColor_t &vPalette) : m_vPalette(vPalette)
 
 void CMarker::markClasses(Mat &base, const Mat &classes, byte flag) const
 {
-	size_t	n		= m_vPalette.size();
 	bool	mapping = true;
 	if (base.empty()) {
 		base = Mat(classes.size(), CV_8UC3);
@@ -42,17 +42,68 @@ void CMarker::markClasses(Mat &base, const Mat &classes, byte flag) const
 	DGM_ASSERT_MSG(base.channels() == 3, "Base image has %d channel(s), but must have 3.", base.channels());
 	DGM_ASSERT_MSG(classes.channels() == 1, "Class Map has %d channel(s), but must have 1.", classes.channels()); 
 
-	for (int y = 0; y < base.rows; y++) {
-		byte	   * pBase  = base.ptr<byte>(y);
-		const byte * pClass = classes.ptr<byte>(y);
-		for (int x = 0; x < base.cols; x++) {
-			if (((flag & MARK_NO_ZERO) == MARK_NO_ZERO) && (pClass[x] == 11)) continue;
-			//if (((flag & MARK_GRID) == MARK_GRID) && ((x+y) % 2 == 0)) continue;
-			for (int c = 0; c < 3; c++)
-				if (mapping && !((flag & MARK_OVER) == MARK_OVER))	pBase[3 * x + c] = static_cast<byte>((pBase[3 * x + c] + m_vPalette.at(pClass[x] % n).first.val[c]) / 2);
-				else			pBase[3 * x + c] = static_cast<byte>(m_vPalette.at(pClass[x] % n).first.val[c]);
-		} // x
-	} // y
+	const bool blend	= mapping && !((flag & MARK_OVER) == MARK_OVER);
+	const bool noZero	= (flag & MARK_NO_ZERO) == MARK_NO_ZERO;
+	const std::vector<byte> vLUT = getPaletteLUT();
+
+	parallel::parallelFor(Range(0, base.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			byte	   * pBase  = base.ptr<byte>(y);
+			const byte * pClass = classes.ptr<byte>(y);
+			for (int x = 0; x < base.cols; x++) {
+				if (noZero && (pClass[x] == 0)) continue;
+				//if (((flag & MARK_GRID) == MARK_GRID) && ((x+y) % 2 == 0)) continue;
+				const byte *pColor = vLUT.data() + 3 * pClass[x];
+				if (blend)	for (int c = 0; c < 3; c++) pBase[3 * x + c] = static_cast<byte>((pBase[3 * x + c] + pColor[c]) >> 1);
+				else		for (int c = 0; c < 3; c++) pBase[3 * x + c] = pColor[c];
+			} // x
+		} // y
+	}, 16);
+}
+
+void CMarker::markPotentials(Mat &base, const Mat &potentials, byte flag) const
+{
+	const int nStates = potentials.channels();
+	DGM_ASSERT_MSG(potentials.depth() == CV_32F, "The potentials must have 32-bit floating point depth");
+	DGM_ASSERT_MSG(nStates >= 2, "The potentials have %d channel(s), but must have at least 2", nStates);
+
+	bool mapping = true;
+	if (base.empty()) {
+		base = Mat(potentials.size(), CV_8UC3);
+		base.setTo(frgIntensity);
+		mapping = false;
+	}
+	if (mapping && !((flag & MARK_OVER) == MARK_OVER)) { // desaturate
+		cvtColor(base, base, cv::ColorConversionCodes::COLOR_BGR2GRAY);
+		cvtColor(base, base, cv::ColorConversionCodes::COLOR_GRAY2RGB);
+	}
+	DGM_ASSERT_MSG(base.channels() == 3, "Base image has %d channel(s), but must have 3.", base.channels());
+	DGM_ASSERT_MSG(base.size() == potentials.size(), "The size of the base image does not correspond to the size of the potentials");
+
+	const bool noZero = (flag & MARK_NO_ZERO) == MARK_NO_ZERO;
+	const std::vector<byte> vLUT = getPaletteLUT();
+
+	parallel::parallelFor(Range(0, base.rows), [&](const Range &range) {
+		for (int y = range.start; y < range.end; y++) {
+			byte		* pBase	= base.ptr<byte>(y);
+			const float * pPot	= potentials.ptr<float>(y);
+			for (int x = 0; x < base.cols; x++, pPot += nStates) {
+				// Arg-max and the second maximum in one pass
+				int		s		= 0;
+				float	max		= pPot[0];
+				float	second	= -FLT_MAX;
+				for (int i = 1; i < nStates; i++)
+					if (pPot[i] > max)			{ second = max; max = pPot[i]; s = i; }
+					else if (pPot[i] > second)	second = pPot[i];
+				if (noZero && s == 0) continue;
+
+				// The color of the state, faded to the base by the confidence (ref. CInfer::getConfidence())
+				const int	alpha	= max > 0 ? static_cast<int>(255 * (1.0f - MAX(0.0f, second) / max) + 0.5f) : 0;
+				const byte *pColor	= vLUT.data() + 3 * s;
+				for (int c = 0; c < 3; c++) pBase[3 * x + c] = static_cast<byte>((alpha * pColor[c] + (255 - alpha) * pBase[3 * x + c] + 127) / 255);
+			} // x
+		} // y
+	}, 16);
 }
 
 Mat CMarker::drawPotentials(const Mat &potential, byte flag) const
@@ -151,6 +202,16 @@ Mat	CMarker::drawConfusionMatrix(const Mat &confusionMat, byte flag) const
 
 // ======================================== Private ========================================
 
+// Returns the BGR colors of all 256 classes: the palette, repeated cyclically
+std::vector<byte> CMarker::getPaletteLUT(void) const
+{
+	const size_t n = m_vPalette.size();
+	std::vector<byte> res(3 * 256);
+	for (size_t s = 0; s < 256; s++)
+		for (int c = 0; c < 3; c++) res[3 * s + c] = static_cast<byte>(m_vPalette.at(s % n).first.val[c]);
+	return res;
+}
+
 Mat CMarker::drawVector(const Mat &potential, byte flag) const
 {
 	const byte		nStates		= potential.rows;
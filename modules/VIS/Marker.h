@@ -61,7 +61,7 @@ namespace DirectGraphicalModels { namespace vis
 	enum mark_flags {
 		MARK_GRID		= 1,	///< Visualizes only the odd pixels
 		MARK_OVER		= 2,	///< Blends the base image
-		MARK_NO_ZERO	= 4,	///< The class with index 0 will not be visualized
+		MARK_NO_ZERO	= 4,	///< The class with index 0 will not be visualized: its pixels keep the base image
 		MARK_BW			= 8,	///< Mark in "black and white" palette
 		MARK_PERCLASS	= 16,	///< Mark per-class accuracies in the confusion matrix
 		MARK_PERCENT	= 128	///< Adds percent symbol to the output text values
@@ -112,6 +112,16 @@ namespace DirectGraphicalModels { namespace vis
 		*/	
 		DllExport void			markClasses(Mat &base, const Mat &classes, byte flag = 0) const;				// Does nothing on error
 		/**
+		* @brief Visualizes the potential maps
+		* @details Draws the most probable state of every pixel of the \a potentials image on \a base image: the color of the state is faded to the base 
+		* according to the confidence of the state, estimated in the same way as in CInfer::getConfidence(). In contrast to decoding the potentials first and calling
+		* markClasses(), the arg-max, the confidence and the color of a pixel are calculated in one parallel pass.
+		* @param[in,out] base Base image on which the states will be mapped. Image of type: CV_8UC3. If empty, the states are faded to white.
+		* @param[in] potentials The potential maps, \a e.g. returned by CTrainNode::getNodePotentials(): Mat(type: CV_32FC(nStates))
+		* @param[in] flag Mapping flag (Ref. @ref mark_flags).
+		*/
+		DllExport void			markPotentials(Mat &base, const Mat &potentials, byte flag = 0) const;
+		/**
 		* @brief Visualizes the potentials
 		* @details Draws <node / edge / triplet> [potential / prior] <vector / matrix / voxel>
 		* > This function is also suit for the confusion matrix visualization, but function drawConfusionMatrix() is more preferable for such task
@@ -138,6 +148,8 @@ namespace DirectGraphicalModels { namespace vis
 
 
 	private:
+		std::vector<byte>	getPaletteLUT(void) const;
+
 		Mat	drawVector(const Mat &potential, byte flag) const;
 		Mat	drawMatrix(const Mat &potential, byte flag) const;
 		Mat	drawVoxel (const Mat &potential, byte flag) const;	// WARNING: not implemented
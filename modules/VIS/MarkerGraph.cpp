@@ -1,4 +1,5 @@
 #include "MarkerGraph.h"
+#include "Frustum.h"
 #include "DGM/IGraphPairwise.h"
 #include "ColorSpaces.h"
 #include "macroses.h"
@@ -107,10 +108,14 @@ namespace DirectGraphicalModels { namespace vis
 				if (groupsColor.size() > 0) 
 					color1 = color2 = groupsColor[graph.getEdgeGroup(n, c) % groupsColor.size()];
 
-				alpha.setTo(0);
+				// Only the bounding box of the edge (with the arrow tip) is blended into the result
+				Rect roi = Rect(Point(static_cast<int>(MIN(pt1.x, pt2.x)) - 16, static_cast<int>(MIN(pt1.y, pt2.y)) - 16),
+								Point(static_cast<int>(MAX(pt1.x, pt2.x)) + 17, static_cast<int>(MAX(pt1.y, pt2.y)) + 17)) & Rect(0, 0, size, size);
+				if (roi.area() == 0) continue;
+				alpha(roi).setTo(0);
 				if (graph.isEdgeArc(n, c))	drawLine(alpha, pt1, pt2, color1, color2, 1, cv::LineTypes::LINE_AA);
 				else						drawArrowedLine(alpha, pt1, pt2, color1, color2, 1, cv::LineTypes::LINE_AA);
-				add(res, alpha, res);
+				add(res(roi), alpha(roi), res(roi));
 			}
 		}
 		
@@ -129,201 +134,273 @@ namespace DirectGraphicalModels { namespace vis
 #ifdef USE_OPENGL
 	// types
 	using vec_vec3_t = std::vector<glm::vec3>;
-	
+	using vec_vec4_t = std::vector<glm::vec4>;
+	using vec_uint_t = std::vector<GLuint>;
+
 	namespace {
-		void LoadShaders(GLuint &NodeProgramID, GLuint &EdgeProgramID)
+		const float LOD_PIXELS	= 16.0f;								// the chunks, appearing smaller than this on the screen, are aggregated
+		const float FOV			= glm::radians(45.0f);					// the vertical field of view of the camera
+
+		// Compiles the shader
+		GLuint compileShader(GLenum type, const std::string &sourceCode, const char *name)
 		{
-#ifdef DEBUG_MODE
-			GLint	Result			= GL_FALSE;
-			int		InfoLogLength	= 0;
-#endif
-			// -------------- Vertex Shader --------------
-			GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-			{  
-				const std::string sourceCode =
-#include "VertexShader.glsl"
-					;
-#ifdef DEBUG_PRINT_INFO
-				printf("Compiling vertex shader... ");
-#endif
-				char const * VertexSourcePointer = sourceCode.c_str();
-				glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
-				glCompileShader(VertexShaderID);
-
-#ifdef DEBUG_MODE	// Check Vertex Shader
-				glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS,  &Result);
-				glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-				if (InfoLogLength > 1) {
-					std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
-					glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-					printf("\n%s\n", &VertexShaderErrorMessage[0]);
-				}
-#endif
 #ifdef DEBUG_PRINT_INFO
-				printf("Done\n");
+			printf("Compiling %s... ", name);
 #endif
-			}
+			GLuint res = glCreateShader(type);
+			char const * SourcePointer = sourceCode.c_str();
+			glShaderSource(res, 1, &SourcePointer, NULL);
+			glCompileShader(res);
 
-			// -------------- Node Fragment Shader --------------
-			GLuint NodeFragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-			{
-				const std::string sourceCode =
-#include "NodeFragmentShader.glsl"
-					;
-#ifdef DEBUG_PRINT_INFO
-				printf("Compiling node fragment Shader... ");
-#endif
-				char const * FragmentSourcePointer = sourceCode.c_str();
-				glShaderSource(NodeFragmentShaderID, 1, &FragmentSourcePointer, NULL);
-				glCompileShader(NodeFragmentShaderID);
-
-#ifdef DEBUG_MODE	// Check Fragment Shader
-				glGetShaderiv(NodeFragmentShaderID, GL_COMPILE_STATUS, &Result);
-				glGetShaderiv(NodeFragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-				if (InfoLogLength > 1) {
-					std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-					glGetShaderInfoLog(NodeFragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-					printf("\n%s\n", &FragmentShaderErrorMessage[0]);
-				}
-#endif
-#ifdef DEBUG_PRINT_INFO
-				printf("Done\n");
-#endif
+#ifdef DEBUG_MODE	// Check the shader
+			GLint	Result			= GL_FALSE;
+			int		InfoLogLength	= 0;
+			glGetShaderiv(res, GL_COMPILE_STATUS,  &Result);
+			glGetShaderiv(res, GL_INFO_LOG_LENGTH, &InfoLogLength);
+			if (InfoLogLength > 1) {
+				std::vector<char> ShaderErrorMessage(InfoLogLength + 1);
+				glGetShaderInfoLog(res, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+				printf("\n%s\n", &ShaderErrorMessage[0]);
 			}
-
-			// -------------- Edge Fragment Shader --------------
-			GLuint EdgeFragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-			{
-				const std::string sourceCode =
-#include "EdgeFragmentShader.glsl"
-					;
-#ifdef DEBUG_PRINT_INFO
-				printf("Compiling edge fragment shader... ");
-#endif
-				char const * FragmentSourcePointer = sourceCode.c_str();
-				glShaderSource(EdgeFragmentShaderID, 1, &FragmentSourcePointer, NULL);
-				glCompileShader(EdgeFragmentShaderID);
-
-#ifdef DEBUG_MODE	// Check Fragment Shader
-				glGetShaderiv(EdgeFragmentShaderID, GL_COMPILE_STATUS, &Result);
-				glGetShaderiv(EdgeFragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-				if (InfoLogLength > 1) {
-					std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-					glGetShaderInfoLog(EdgeFragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-					printf("\n%s\n", &FragmentShaderErrorMessage[0]);
-				}
 #endif
 #ifdef DEBUG_PRINT_INFO
-				printf("Done\n");
+			printf("Done\n");
 #endif
-			}
-
+			return res;
+		}
 
-			// -------------- Node Program --------------
-			{
+		// Links the program of the vertex and fragment shaders
+		GLuint linkProgram(GLuint VertexShaderID, GLuint FragmentShaderID, const char *name)
+		{
 #ifdef DEBUG_PRINT_INFO
-				printf("Linking node program... ");
+			printf("Linking %s... ", name);
 #endif
-				NodeProgramID = glCreateProgram();
-				glAttachShader(NodeProgramID, VertexShaderID);
-				glAttachShader(NodeProgramID, NodeFragmentShaderID);
-				glLinkProgram(NodeProgramID);
+			GLuint res = glCreateProgram();
+			glAttachShader(res, VertexShaderID);
+			glAttachShader(res, FragmentShaderID);
+			glLinkProgram(res);
 
 #ifdef DEBUG_MODE	// Check the program
-				glGetProgramiv(NodeProgramID, GL_LINK_STATUS, &Result);
-				glGetProgramiv(NodeProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-				if (InfoLogLength > 1) {
-					std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-					glGetProgramInfoLog(NodeProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-					printf("%s\n", &ProgramErrorMessage[0]);
-				}
+			GLint	Result			= GL_FALSE;
+			int		InfoLogLength	= 0;
+			glGetProgramiv(res, GL_LINK_STATUS, &Result);
+			glGetProgramiv(res, GL_INFO_LOG_LENGTH, &InfoLogLength);
+			if (InfoLogLength > 1) {
+				std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
+				glGetProgramInfoLog(res, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+				printf("%s\n", &ProgramErrorMessage[0]);
+			}
 #endif
 #ifdef DEBUG_PRINT_INFO
-				printf("Done\n");
+			printf("Done\n");
 #endif
-				glDetachShader(NodeProgramID, VertexShaderID);
-				glDetachShader(NodeProgramID, NodeFragmentShaderID);
-			}
+			glDetachShader(res, VertexShaderID);
+			glDetachShader(res, FragmentShaderID);
+			return res;
+		}
 
-			// -------------- Edge Program --------------
-			{
-#ifdef DEBUG_PRINT_INFO
-				printf("Linking edge program... ");
-#endif
-				EdgeProgramID = glCreateProgram();
-				glAttachShader(EdgeProgramID, VertexShaderID);
-				glAttachShader(EdgeProgramID, EdgeFragmentShaderID);
-				glLinkProgram(EdgeProgramID);
+		void LoadShaders(GLuint &NodeProgramID, GLuint &EdgeProgramID, GLuint &ConeProgramID)
+		{
+			const std::string vertexShader =
+#include "VertexShader.glsl"
+				;
+			const std::string coneVertexShader =
+#include "ConeVertexShader.glsl"
+				;
+			const std::string nodeFragmentShader =
+#include "NodeFragmentShader.glsl"
+				;
+			const std::string edgeFragmentShader =
+#include "EdgeFragmentShader.glsl"
+				;
+
+			GLuint VertexShaderID			= compileShader(GL_VERTEX_SHADER,	vertexShader,		"vertex shader");
+			GLuint ConeVertexShaderID		= compileShader(GL_VERTEX_SHADER,	coneVertexShader,	"cone vertex shader");
+			GLuint NodeFragmentShaderID		= compileShader(GL_FRAGMENT_SHADER, nodeFragmentShader, "node fragment shader");
+			GLuint EdgeFragmentShaderID		= compileShader(GL_FRAGMENT_SHADER, edgeFragmentShader, "edge fragment shader");
+
+			NodeProgramID = linkProgram(VertexShaderID,		NodeFragmentShaderID, "node program");
+			EdgeProgramID = linkProgram(VertexShaderID,		EdgeFragmentShaderID, "edge program");
+			ConeProgramID = linkProgram(ConeVertexShaderID, EdgeFragmentShaderID, "cone program");
 
-#ifdef DEBUG_MODE	// Check the program
-				glGetProgramiv(EdgeProgramID, GL_LINK_STATUS, &Result);
-				glGetProgramiv(EdgeProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-				if (InfoLogLength > 1) {
-					std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-					glGetProgramInfoLog(EdgeProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-					printf("%s\n", &ProgramErrorMessage[0]);
-				}
-#endif
-#ifdef DEBUG_PRINT_INFO
-				printf("Done\n");
-#endif
-				glDetachShader(NodeProgramID, VertexShaderID);
-				glDetachShader(NodeProgramID, NodeFragmentShaderID);
-			}
-			
 			glDeleteShader(VertexShaderID);
+			glDeleteShader(ConeVertexShaderID);
 			glDeleteShader(NodeFragmentShaderID);
 			glDeleteShader(EdgeFragmentShaderID);
 		}
 
-		void addCone(vec_vec3_t &vVertices, vec_vec3_t &vColors, vec_word_t &vIndices, glm::vec3 pt1, glm::vec3 pt2, glm::vec3 color, float length)
+		// Returns the cone mesh with the top at the origin and the base of radius tan(15) at z = 1
+		void getUnitCone(vec_vec3_t &vVertices, vec_uint_t &vIndices)
 		{
 			const int	nSectors = 32;
+			const float radius	 = glm::tan(glm::radians(15.0f));
 
-			word v0 = static_cast<word>(vVertices.size());
+			for (int i = 0; i < nSectors; i++) {
+				const float a = 2 * Pif * i / nSectors;
+				vVertices.push_back(glm::vec3(radius * cosf(a), radius * sinf(a), 1.0f));
+			}
+			vVertices.push_back(glm::vec3(0, 0, 0));							// cone's top point
+			vVertices.push_back(glm::vec3(0, 0, 1));							// cone's middle point
 
-			glm::vec3 dir	 = glm::normalize(pt1 - pt2);				// cone's axis
-			glm::vec3 normal = glm::cross(dir, glm::vec3(0, 0, 1));		// normal to cone's axis
-			if (glm::length(normal) < FLT_EPSILON) normal = glm::cross(dir, glm::vec3(0, 1, 0));
-			normal = glm::normalize(normal);
-			glm::vec3 top	 = pt2;										// cone's top point
-			glm::vec3 mid	 = pt2 + dir * length;						// cone's middle point
+			for (GLuint i = 1; i <= nSectors; i++) {
+				// Side triangle
+				vIndices.push_back(i - 1);
+				vIndices.push_back(i % nSectors);
+				vIndices.push_back(nSectors);
+
+				// Base triangle
+				vIndices.push_back(i % nSectors);
+				vIndices.push_back(i - 1);
+				vIndices.push_back(nSectors + 1);
+			}
+		}
+
+		template <typename T>
+		GLuint createBuffer(GLenum target, const std::vector<T> &vData, GLenum usage = GL_STATIC_DRAW)
+		{
+			GLuint res;
+			glGenBuffers(1, &res);																				// Create 1 buffer
+			glBindBuffer(target, res);																			// Make this buffer current
+			glBufferData(target, vData.size() * sizeof(T), vData.empty() ? NULL : vData.data(), usage);		// transmit data
+			return res;
+		}
 
-			glm::mat4 rmat	 = glm::rotate(glm::mat4(1), glm::radians(360.0f / nSectors), dir);
+		// Uploads the elements vData[i] for i in vIdx into the buffer. Close indexes are merged into one range, and if many elements have changed, the whole container is uploaded
+		template <typename T>
+		void uploadRanges(GLuint buffer, const std::vector<T> &vData, vec_uint_t &vIdx)
+		{
+			const GLuint maxGap = 16;
 
-			glm::vec3 point1 = normal * length * glm::tan(glm::radians(15.0f));
-			for (unsigned short i = 0; i < nSectors; i++) {
-				glm::vec3 point2 = rmat * glm::vec4(point1, 1.0f);
-				vVertices.push_back(mid + point1);
-				vColors.push_back(color);
-				point1 = point2;
+			if (vIdx.empty()) return;
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			if (vIdx.size() > vData.size() / 4) {
+				glBufferSubData(GL_ARRAY_BUFFER, 0, vData.size() * sizeof(T), vData.data());
+				return;
+			}
+			std::sort(vIdx.begin(), vIdx.end());
+			for (size_t i = 0; i < vIdx.size(); ) {
+				size_t j = i + 1;
+				while (j < vIdx.size() && vIdx[j] - vIdx[j - 1] <= maxGap) j++;
+				glBufferSubData(GL_ARRAY_BUFFER, vIdx[i] * sizeof(T), (vIdx[j - 1] - vIdx[i] + 1) * sizeof(T), &vData[vIdx[i]]);
+				i = j;
 			}
+		}
 
-			vVertices.push_back(top);
-			vColors.push_back(color);
+		// The ranges of the consecutive elements: the adjacent ranges are merged, so that the visible chunks are drawn with a few calls
+		struct Runs {
+			std::vector<GLint>		vFirst;
+			std::vector<GLsizei>	vCount;
 
-			vVertices.push_back(mid);
-			vColors.push_back(color);
+			void clear(void) { vFirst.clear(); vCount.clear(); }
+			void add(GLint first, GLsizei count)
+			{
+				if (count == 0) return;
+				if (!vFirst.empty() && vFirst.back() + vCount.back() == first) vCount.back() += count;
+				else {
+					vFirst.push_back(first);
+					vCount.push_back(count);
+				}
+			}
+		};
 
-			for (word i = 1; i <= nSectors; i++) {
-				// Side triangle
-				vIndices.push_back(v0 + i - 1);
-				vIndices.push_back(v0 + i % nSectors);
-				vIndices.push_back(v0 + nSectors);
+		// Draws the runs of primitives, consisting of nVertices vertices each
+		void drawArrays(GLenum mode, const Runs &runs, GLsizei nVertices)
+		{
+			std::vector<GLint>	 vFirst(runs.vFirst.size());
+			std::vector<GLsizei> vCount(runs.vCount.size());
+			for (size_t i = 0; i < vFirst.size(); i++) {
+				vFirst[i] = runs.vFirst[i] * nVertices;
+				vCount[i] = runs.vCount[i] * nVertices;
+			}
+			if (!vFirst.empty()) glMultiDrawArrays(mode, vFirst.data(), vCount.data(), static_cast<GLsizei>(vFirst.size()));
+		}
 
-				// Base triangle
-				vIndices.push_back(v0 + i % nSectors);
-				vIndices.push_back(v0 + i - 1);
-				vIndices.push_back(v0 + nSectors + 1);
+		// Draws the runs of primitives, consisting of nIndices indices each, from the bound element buffer
+		void drawElements(GLenum mode, const Runs &runs, GLsizei nIndices)
+		{
+			std::vector<GLsizei>	  vCount(runs.vCount.size());
+			std::vector<const void *> vOffset(runs.vFirst.size());
+			for (size_t i = 0; i < vCount.size(); i++) {
+				vCount[i]  = runs.vCount[i] * nIndices;
+				vOffset[i] = reinterpret_cast<const void *>(static_cast<size_t>(runs.vFirst[i]) * nIndices * sizeof(GLuint));
 			}
+			if (!vCount.empty()) glMultiDrawElements(mode, vCount.data(), GL_UNSIGNED_INT, vOffset.data(), static_cast<GLsizei>(vCount.size()));
 		}
+
+		// Chunk: a cell of the spatial grid. Its nodes, edges, cones and aggregated edges are stored contiguously in the buffers
+		struct Chunk {
+			GLint		firstNode	= 0;
+			GLsizei		nNodes		= 0;
+			GLint		firstEdge	= 0;								// the edges, starting in the chunk
+			GLsizei		nEdges		= 0;
+			GLint		firstCone	= 0;								// the cones of the directed edges, starting in the chunk
+			GLsizei		nCones		= 0;
+			GLint		firstAggEdge= 0;								// the edges to the other chunks, aggregated
+			GLsizei		nAggEdges	= 0;
+			glm::vec3	min			= glm::vec3(FLT_MAX);				// the bounding box of the nodes
+			glm::vec3	max			= glm::vec3(-FLT_MAX);
+			glm::vec3	edgeMin		= glm::vec3(FLT_MAX);				// the bounding box of the nodes and of the edges, starting in the chunk (including the aggregated edges)
+			glm::vec3	edgeMax		= glm::vec3(-FLT_MAX);
+			glm::vec3	posSum		= glm::vec3(0);						// the sum of the positions of the nodes
+			glm::vec4	colorSum	= glm::vec4(0);						// the sum of the colors of the nodes
+		};
+
+		// Instance of the cone mesh
+		struct Cone {
+			glm::vec3	top;											// the position of the destination node
+			glm::vec3	axis;											// the direction to the source node, scaled with the length of the cone
+			GLint		slot;											// the slot of the destination node in the color buffer
+		};
+
+		// Vertex of an edge, colored by its group
+		struct EdgeVertex {
+			glm::vec3	pos;
+			glm::vec4	color;
+		};
 	}
 
-	void showGraph3D(int size, IGraphPairwise &graph, std::function<Point3f(size_t)> posFunc, std::function<cv::Scalar(size_t)> colorFunc, const vec_scalar_t &groupsColor)
+	struct CGraphViewer3D::Impl {
+		GLFWwindow						* window = nullptr;
+		std::unique_ptr<CCameraControl>	  pCamera;
+		glm::mat4						  projection;
+		int								  size;
+		size_t							  nNodes;
+		std::function<cv::Scalar(size_t)> colorFunc;
+		bool							  isGroupsColor;
+
+		vec_uint_t				vSlots;				// the slot of every node in the node buffers
+		vec_uint_t				vSlotChunk;			// the chunk of every slot
+		vec_vec4_t				vColors;			// the colors of the slots
+		vec_vec4_t				vAggColors;			// the mean colors of the chunks
+		std::vector<Chunk>		vChunks;
+		GLsizei					nConeIndices = 0;
+		Runs					nodeRuns, aggNodeRuns, edgeRuns, aggEdgeRuns, coneRuns;
+
+		GLuint	NodeProgramID = 0, EdgeProgramID = 0, ConeProgramID = 0;
+		GLint	NodeMatrixID, NodeScaleID, EdgeMatrixID, ConeMatrixID, ConeColorsID;
+		GLuint	vaoNodes = 0, vaoAggNodes = 0, vaoGroupEdges = 0, vaoCones = 0;
+		GLuint	nodeBuffer = 0, colorBuffer = 0, edgeIndexBuffer = 0, groupEdgeBuffer = 0;
+		GLuint	aggNodeBuffer = 0, aggColorBuffer = 0, aggIndexBuffer = 0;
+		GLuint	coneMeshBuffer = 0, coneIndexBuffer = 0, coneBuffer = 0;
+		GLuint	colorTexture = 0;					// the color buffer as a texture buffer for the cones
+
+		glm::vec4 getColor(size_t n) const
+		{
+			cv::Scalar color = colorFunc ? colorspaces::bgr2rgb(colorFunc(n)) : colorspaces::hsv2bgr(DGM_HSV(360.0 * n / nNodes, 255.0, 255.0));
+			color = static_cast<Scalar>(color) / 255;
+			return glm::vec4(color.val[0], color.val[1], color.val[2], 1.0f);
+		}
+	};
+
+	CGraphViewer3D::CGraphViewer3D(int size, IGraphPairwise &graph, std::function<Point3f(size_t)> posFunc, std::function<cv::Scalar(size_t)> colorFunc, const vec_scalar_t &groupsColor)
+		: m_pImpl(std::make_unique<Impl>())
 	{
-		// Constants
-		const size_t	nNodes			= graph.getNumNodes();
-		const bool		isGroupsColor	= groupsColor.size() > 0;
+		Impl &impl = *m_pImpl;
+		impl.size			= size;
+		impl.nNodes			= graph.getNumNodes();
+		impl.colorFunc		= colorFunc;
+		impl.isGroupsColor	= groupsColor.size() > 0;
+		const size_t nNodes = impl.nNodes;
 
 		// Initialise GLFW
 		DGM_ASSERT_MSG(glfwInit(), "Failed to initialize GLFW");
@@ -337,15 +414,15 @@ namespace DirectGraphicalModels { namespace vis
 		glfwWindowHint(GLFW_SAMPLES, 16);
 
 		// Create a windowed mode window and its OpenGL context 
-		GLFWwindow *window = glfwCreateWindow(size, size, "3D Graph Viewer", NULL, NULL);
-		if (!window) {
+		impl.window = glfwCreateWindow(size, size, "3D Graph Viewer", NULL, NULL);
+		if (!impl.window) {
 			DGM_WARNING("Unable to create GLFW window");
 			glfwTerminate();
 			return;
 		}
 		
-		glfwMakeContextCurrent(window);										// Make the window's context current 
-		glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);				// Ensure we can capture the escape key being pressed below
+		glfwMakeContextCurrent(impl.window);								// Make the window's context current 
+		glfwSetInputMode(impl.window, GLFW_STICKY_KEYS, GL_TRUE);			// Ensure we can capture the escape key being pressed below
 
 		// Initialize GLEW
 		DGM_ASSERT_MSG(glewInit() == GLEW_OK, "Failed to initialize GLEW");
@@ -355,165 +432,372 @@ namespace DirectGraphicalModels { namespace vis
 #endif		
 
 		// Options
-		glShadeModel(GL_SMOOTH);											// Select flat or smooth shading
-		//glEnable(GL_DEPTH_TEST);											// Ebable depth buffer
-		//glDepthFunc(GL_LESS);												// Specify the value used for depth buffer comparisons
 		glEnable(GL_PROGRAM_POINT_SIZE);
 		glEnable(GL_BLEND);													// Enable blending
-		//glBlendFunc(GL_SRC_ALPHA, GL_ONE);
 		glFrontFace(GL_CW);													// Define front- and back-facing polygons
 		glEnable(GL_CULL_FACE);
-		//glCullFace(GL_BACK);
-
-		GLuint vertex_array_id;
-		glGenVertexArrays(1, &vertex_array_id);
-		glBindVertexArray(vertex_array_id);
 
 		// Create and compile our GLSL program from the shaders
-		GLuint NodeProgramID, EdgeProgramID;								// Different shaders for graph nodes and edges
-		LoadShaders(NodeProgramID, EdgeProgramID);
-		
-		// Get a handle for our "MVP" uniform
-		GLuint NodeMatrixID = glGetUniformLocation(NodeProgramID, "MVP");
-		GLuint EdgeMatrixID = glGetUniformLocation(EdgeProgramID, "MVP");
-
-		// Main containers
-		vec_vec3_t vVertices;
-		vec_vec3_t vColors;
-		vec_vec3_t vGroupColors;
-		vec_word_t vIndices, vConeIndices;
-
-		// Filling in the containers
-		// Nodes
+		LoadShaders(impl.NodeProgramID, impl.EdgeProgramID, impl.ConeProgramID);
+		impl.NodeMatrixID	= glGetUniformLocation(impl.NodeProgramID, "MVP");
+		impl.NodeScaleID	= glGetUniformLocation(impl.NodeProgramID, "pointScale");
+		impl.EdgeMatrixID	= glGetUniformLocation(impl.EdgeProgramID, "MVP");
+		impl.ConeMatrixID	= glGetUniformLocation(impl.ConeProgramID, "MVP");
+		impl.ConeColorsID	= glGetUniformLocation(impl.ConeProgramID, "nodeColors");
+
+		// -------------- Chunks --------------
+		vec_vec3_t vPositions(nNodes);
+		glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
 		for (size_t n = 0; n < nNodes; n++) {
 			Point3f pt = posFunc(n);
-			vVertices.push_back(glm::vec3(pt.x, pt.y, pt.z));
-			cv::Scalar color = colorFunc ? colorspaces::bgr2rgb(colorFunc(n)) : colorspaces::hsv2bgr(DGM_HSV(360.0 * n / nNodes, 255.0, 255.0));
-			color = static_cast<Scalar>(color) / 255;
-			vColors.push_back(glm::vec3(color.val[0], color.val[1], color.val[2]));
-		}		
+			vPositions[n] = glm::vec3(pt.x, pt.y, pt.z);
+			minPos = glm::min(minPos, vPositions[n]);
+			maxPos = glm::max(maxPos, vPositions[n]);
+		}
+		const int		 nCells	= static_cast<int>(MIN(32.0, MAX(1.0, cbrt(nNodes / 256.0))));	// about 256 nodes per chunk
+		const glm::vec3	 extent	= glm::max(maxPos - minPos, glm::vec3(FLT_EPSILON));
+		auto getCell = [&](const glm::vec3 &pos) {
+			const glm::ivec3 cell = glm::clamp(glm::ivec3((pos - minPos) / extent * static_cast<float>(nCells)), glm::ivec3(0), glm::ivec3(nCells - 1));
+			return (cell.z * nCells + cell.y) * nCells + cell.x;
+		};
+
+		// The non-empty cells become the chunks in the order of the cells, thus the neighbouring chunks are often adjacent in the buffers
+		std::vector<int> vCellChunk(nCells * nCells * nCells, 0);
+		for (size_t n = 0; n < nNodes; n++) vCellChunk[getCell(vPositions[n])]++;
+		GLint nSlots = 0;
+		for (int &chunk : vCellChunk)
+			if (chunk) {
+				Chunk c;
+				c.firstNode = nSlots;
+				nSlots += chunk;
+				chunk = static_cast<int>(impl.vChunks.size());
+				impl.vChunks.push_back(c);
+			}
+			else chunk = -1;
 
-		// Edges
+		vec_uint_t vNodeChunk(nNodes);
+		impl.vSlots.resize(nNodes);
+		impl.vSlotChunk.resize(nNodes);
+		impl.vColors.resize(nNodes);
+		vec_vec3_t vSlotPositions(nNodes);
+		for (size_t n = 0; n < nNodes; n++) {
+			vNodeChunk[n]	= vCellChunk[getCell(vPositions[n])];
+			Chunk &chunk	= impl.vChunks[vNodeChunk[n]];
+			const GLuint slot = chunk.firstNode + chunk.nNodes++;
+			impl.vSlots[n]				= slot;
+			impl.vSlotChunk[slot]		= vNodeChunk[n];
+			impl.vColors[slot]			= impl.getColor(n);
+			vSlotPositions[slot]		= vPositions[n];
+			chunk.min		= glm::min(chunk.min, vPositions[n]);
+			chunk.max		= glm::max(chunk.max, vPositions[n]);
+			chunk.posSum	+= vPositions[n];
+			chunk.colorSum	+= impl.vColors[slot];
+		}
+
+		// -------------- Edges --------------
+		std::vector<std::pair<size_t, size_t>> vEdges;
+		vec_byte_t vGroups;
 		for (size_t n = 0; n < nNodes; n++) {
 			vec_size_t childs;
 			graph.getChildNodes(n, childs);
-			
 			for (size_t c : childs) {
 				if (graph.isEdgeArc(n, c) && n < c) continue;			// draw only one edge in arc
-				vIndices.push_back(static_cast<word>(n));				// src
-				vIndices.push_back(static_cast<word>(c));				// dst
-				
-				if (isGroupsColor) {
-					byte group = graph.getEdgeGroup(n, c);
-					cv::Scalar color = groupsColor[group % groupsColor.size()];
-					color = static_cast<Scalar>(color) / 255;
-					vGroupColors.push_back(glm::vec3(color.val[0], color.val[1], color.val[2]));
-				}
+				vEdges.emplace_back(n, c);
+				if (impl.isGroupsColor) vGroups.push_back(graph.getEdgeGroup(n, c));
+			}
+		}
 
-				if (!graph.isEdgeArc(n, c))
-					addCone(vVertices, vColors, vConeIndices, vVertices[n], vVertices[c], vColors[c], 30.0f / size);
+		std::vector<byte> vIsArc(vEdges.size());
+		for (size_t e = 0; e < vEdges.size(); e++) {
+			Chunk &chunk = impl.vChunks[vNodeChunk[vEdges[e].first]];
+			chunk.nEdges++;
+			vIsArc[e] = graph.isEdgeArc(vEdges[e].first, vEdges[e].second) ? 1 : 0;
+			if (!vIsArc[e]) chunk.nCones++;
+		}
+		GLint nEdges = 0, nCones = 0;
+		for (Chunk &chunk : impl.vChunks) {
+			chunk.firstEdge = nEdges;
+			chunk.firstCone = nCones;
+			nEdges += chunk.nEdges;
+			nCones += chunk.nCones;
+			chunk.nEdges = chunk.nCones = 0;
+		}
+
+		vec_uint_t					vEdgeIndices(impl.isGroupsColor ? 0 : 2 * nEdges);
+		std::vector<EdgeVertex>		vEdgeVertices(impl.isGroupsColor ? 2 * nEdges : 0);
+		std::vector<Cone>			vCones(nCones);
+		std::vector<std::vector<GLuint>> vvAggEdges(impl.vChunks.size());
+		const float coneLength = 30.0f / size;
+		for (Chunk &chunk : impl.vChunks) {
+			chunk.edgeMin = chunk.min;
+			chunk.edgeMax = chunk.max;
+		}
+		for (size_t e = 0; e < vEdges.size(); e++) {
+			const size_t	src		= vEdges[e].first;
+			const size_t	dst		= vEdges[e].second;
+			Chunk		  & chunk	= impl.vChunks[vNodeChunk[src]];
+			const GLint		i		= chunk.firstEdge + chunk.nEdges++;
+			if (impl.isGroupsColor) {
+				cv::Scalar color = groupsColor[vGroups[e] % groupsColor.size()];
+				color = static_cast<Scalar>(color) / 255;
+				const glm::vec4 groupColor(color.val[0], color.val[1], color.val[2], 1.0f);
+				vEdgeVertices[2 * i]	 = { vPositions[src], groupColor };
+				vEdgeVertices[2 * i + 1] = { vPositions[dst], groupColor };
+			}
+			else {
+				vEdgeIndices[2 * i]		= impl.vSlots[src];
+				vEdgeIndices[2 * i + 1] = impl.vSlots[dst];
+			}
+			chunk.edgeMin = glm::min(chunk.edgeMin, vPositions[dst]);
+			chunk.edgeMax = glm::max(chunk.edgeMax, vPositions[dst]);
+			if (!vIsArc[e]) {
+				const glm::vec3 dir = vPositions[src] - vPositions[dst];
+				const float len = glm::length(dir);
+				vCones[chunk.firstCone + chunk.nCones++] = { vPositions[dst], len > FLT_EPSILON ? dir * (coneLength / len) : glm::vec3(0), static_cast<GLint>(impl.vSlots[dst]) };
+			}
+			if (vNodeChunk[src] != vNodeChunk[dst]) vvAggEdges[vNodeChunk[src]].push_back(vNodeChunk[dst]);
+		}
+		vEdges.clear();
+		vEdges.shrink_to_fit();
+
+		// -------------- Aggregated nodes and edges --------------
+		vec_vec3_t vAggPositions(impl.vChunks.size());
+		impl.vAggColors.resize(impl.vChunks.size());
+		vec_uint_t vAggIndices;
+		for (size_t k = 0; k < impl.vChunks.size(); k++) {
+			Chunk &chunk = impl.vChunks[k];
+			vAggPositions[k]	= chunk.posSum / static_cast<float>(chunk.nNodes);
+			impl.vAggColors[k]	= chunk.colorSum / static_cast<float>(chunk.nNodes);
+
+			std::vector<GLuint> &vAggEdges = vvAggEdges[k];
+			std::sort(vAggEdges.begin(), vAggEdges.end());
+			vAggEdges.erase(std::unique(vAggEdges.begin(), vAggEdges.end()), vAggEdges.end());
+			chunk.firstAggEdge	= static_cast<GLint>(vAggIndices.size() / 2);
+			chunk.nAggEdges		= static_cast<GLsizei>(vAggEdges.size());
+			for (GLuint dst : vAggEdges) {
+				vAggIndices.push_back(static_cast<GLuint>(k));
+				vAggIndices.push_back(dst);
+				const glm::vec3 centroid = impl.vChunks[dst].posSum / static_cast<float>(impl.vChunks[dst].nNodes);
+				chunk.edgeMin = glm::min(chunk.edgeMin, centroid);
+				chunk.edgeMax = glm::max(chunk.edgeMax, centroid);
 			}
+			vAggEdges.clear();
+			vAggEdges.shrink_to_fit();
 		}
-		const size_t nEdgesIdx = vIndices.size();						// Number of edge indices in the container
-		vIndices.insert(vIndices.end(), vConeIndices.begin(), vConeIndices.end());
-		vConeIndices.clear();
-
-		// Binding the containers: xxxBuffer to vXXX
-		GLuint vertexBuffer;
-		glGenBuffers(1, &vertexBuffer);																		// Create 1 buffer
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);														// Make this buffer current
-		glBufferData(GL_ARRAY_BUFFER, vVertices.size() * sizeof(glm::vec3), &vVertices[0], GL_STATIC_DRAW);	// transmit data
-
-		GLuint colorBuffer;
-		glGenBuffers(1, &colorBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-		glBufferData(GL_ARRAY_BUFFER, vColors.size() * sizeof(glm::vec3), &vColors[0], GL_STATIC_DRAW);
-
-		GLuint groupColorBuffer;
-		if (isGroupsColor) {
-			glGenBuffers(1, &groupColorBuffer);
-			glBindBuffer(GL_ARRAY_BUFFER, groupColorBuffer);
-			glBufferData(GL_ARRAY_BUFFER, vGroupColors.size() * sizeof(glm::vec3), &vGroupColors[0], GL_STATIC_DRAW);
+
+		// -------------- Buffers --------------
+		// Nodes and the edges, colored by the nodes
+		glGenVertexArrays(1, &impl.vaoNodes);
+		glBindVertexArray(impl.vaoNodes);
+		impl.nodeBuffer = createBuffer(GL_ARRAY_BUFFER, vSlotPositions);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+		impl.colorBuffer = createBuffer(GL_ARRAY_BUFFER, impl.vColors, GL_DYNAMIC_DRAW);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)0);
+		impl.edgeIndexBuffer = createBuffer(GL_ELEMENT_ARRAY_BUFFER, vEdgeIndices);
+
+		// Edges, colored by the groups
+		if (impl.isGroupsColor) {
+			glGenVertexArrays(1, &impl.vaoGroupEdges);
+			glBindVertexArray(impl.vaoGroupEdges);
+			impl.groupEdgeBuffer = createBuffer(GL_ARRAY_BUFFER, vEdgeVertices);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(EdgeVertex), (void *)offsetof(EdgeVertex, pos));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(EdgeVertex), (void *)offsetof(EdgeVertex, color));
+		}
+
+		// Aggregated nodes and edges
+		glGenVertexArrays(1, &impl.vaoAggNodes);
+		glBindVertexArray(impl.vaoAggNodes);
+		impl.aggNodeBuffer = createBuffer(GL_ARRAY_BUFFER, vAggPositions);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+		impl.aggColorBuffer = createBuffer(GL_ARRAY_BUFFER, impl.vAggColors, GL_DYNAMIC_DRAW);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)0);
+		impl.aggIndexBuffer = createBuffer(GL_ELEMENT_ARRAY_BUFFER, vAggIndices);
+
+		// Cones: one mesh with an instance per directed edge
+		vec_vec3_t vConeVertices;
+		vec_uint_t vConeIndices;
+		getUnitCone(vConeVertices, vConeIndices);
+		impl.nConeIndices = static_cast<GLsizei>(vConeIndices.size());
+		glGenVertexArrays(1, &impl.vaoCones);
+		glBindVertexArray(impl.vaoCones);
+		impl.coneMeshBuffer = createBuffer(GL_ARRAY_BUFFER, vConeVertices);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+		impl.coneIndexBuffer = createBuffer(GL_ELEMENT_ARRAY_BUFFER, vConeIndices);
+		impl.coneBuffer = createBuffer(GL_ARRAY_BUFFER, vCones);
+		for (GLuint attribute : { 2, 3, 4 }) {
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribDivisor(attribute, 1);
 		}
+		glBindVertexArray(0);
 
-		GLuint indexBuffer;
-		glGenBuffers(1, &indexBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, vIndices.size() * sizeof(word), &vIndices[0], GL_STATIC_DRAW);
+		glGenTextures(1, &impl.colorTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, impl.colorTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, impl.colorBuffer);
 
-		CCameraControl camera(window);
+		impl.pCamera	= std::make_unique<CCameraControl>(impl.window);
+		impl.projection = glm::perspective(FOV, 1.0f, 0.1f, 100.0f);
 
 		const float _bkgIntencity = static_cast<float>(bkgIntencity) / 255;
 		glClearColor(_bkgIntencity, _bkgIntencity, _bkgIntencity, 0.0f);	// Set background color
+	}
 
-		glm::mat4 ModelMatrix		= glm::mat4(1.0f);
-		//glm::mat4 ViewMatrix		= glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0., 0., 0.), glm::vec3(0., 1., 0.));
-		glm::mat4 ProjectionMatrix	= glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	CGraphViewer3D::~CGraphViewer3D(void)
+	{
+		Impl &impl = *m_pImpl;
+		if (!impl.window) return;
+
+		// Cleanup VBO, textures and shaders
+		for (GLuint buffer : { impl.nodeBuffer, impl.colorBuffer, impl.edgeIndexBuffer, impl.groupEdgeBuffer, impl.aggNodeBuffer, impl.aggColorBuffer,
+							   impl.aggIndexBuffer, impl.coneMeshBuffer, impl.coneIndexBuffer, impl.coneBuffer })
+			if (buffer) glDeleteBuffers(1, &buffer);
+		glDeleteTextures(1, &impl.colorTexture);
+		for (GLuint vao : { impl.vaoNodes, impl.vaoGroupEdges, impl.vaoAggNodes, impl.vaoCones })
+			if (vao) glDeleteVertexArrays(1, &vao);
 		
-		// Main loop
-		while (!glfwWindowShouldClose(window) && glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS ) {
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);				// Clear information from last draw
-			
-			// Compute the MVP matrix from keyboard and mouse input
-			if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) camera.reset();
-			glm::mat4 MVP = ProjectionMatrix * camera.getViewMatrix() * ModelMatrix;
-
-			// 1-st attribute buffer : vertices
-			glEnableVertexAttribArray(0);
-			glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+		glDeleteProgram(impl.NodeProgramID);
+		glDeleteProgram(impl.EdgeProgramID);
+		glDeleteProgram(impl.ConeProgramID);
 
-			// 2-nd attribute buffer : colors
-			glEnableVertexAttribArray(1);
-			glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-
-			// 3-rd attribute buffer : group-colors
-			if (isGroupsColor) {
-				glEnableVertexAttribArray(1);
-				glBindBuffer(GL_ARRAY_BUFFER, groupColorBuffer);
-				glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-			}
+		// Close OpenGL window and terminate GLFW
+		glfwTerminate();
+	}
 
-			if (true) { // Draw nodes
-				glUseProgram(NodeProgramID);
+	void CGraphViewer3D::updateColors(const vec_size_t &vNodes)
+	{
+		Impl &impl = *m_pImpl;
+		if (!impl.window) return;
+
+		vec_uint_t vSlots, vChunks;
+		vSlots.reserve(vNodes.size());
+		for (size_t n : vNodes) {
+			DGM_ASSERT_MSG(n < impl.nNodes, "Node %zu is out of range %zu", n, impl.nNodes);
+			const GLuint	slot	= impl.vSlots[n];
+			const GLuint	k		= impl.vSlotChunk[slot];
+			const glm::vec4 color	= impl.getColor(n);
+			impl.vChunks[k].colorSum += color - impl.vColors[slot];
+			impl.vColors[slot] = color;
+			vSlots.push_back(slot);
+			vChunks.push_back(k);
+		}
+		for (GLuint k : vChunks) impl.vAggColors[k] = impl.vChunks[k].colorSum / static_cast<float>(impl.vChunks[k].nNodes);
 
-				// Send our transformation to the currently bound shader, in the "MVP" uniform
-				glUniformMatrix4fv(NodeMatrixID, 1, GL_FALSE, &MVP[0][0]);
+		uploadRanges(impl.colorBuffer, impl.vColors, vSlots);
+		uploadRanges(impl.aggColorBuffer, impl.vAggColors, vChunks);
+	}
 
-				glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(nNodes));
-			}
-			
-			if (true) {	// Draw edges
-				glUseProgram(EdgeProgramID);
-				
-				glUniformMatrix4fv(EdgeMatrixID, 1, GL_FALSE, &MVP[0][0]);	// Send our transformation to the currently bound shader, in the "MVP" uniform
+	void CGraphViewer3D::updateColors(void)
+	{
+		vec_size_t vNodes(m_pImpl->nNodes);
+		for (size_t n = 0; n < vNodes.size(); n++) vNodes[n] = n;
+		updateColors(vNodes);
+	}
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);			// Index buffer
+	bool CGraphViewer3D::render(void)
+	{
+		Impl &impl = *m_pImpl;
+		if (!impl.window || glfwWindowShouldClose(impl.window) || glfwGetKey(impl.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) return false;
 
-				glDrawElements(GL_LINES, static_cast<GLsizei>(nEdgesIdx), GL_UNSIGNED_SHORT, (void *) 0);													// Edges
-				glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(vIndices.size() - nEdgesIdx), GL_UNSIGNED_SHORT, (void *) (nEdgesIdx * sizeof(word)));	// Cones
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);					// Clear information from last draw
+			
+		// Compute the MVP matrix from keyboard and mouse input
+		if (glfwGetKey(impl.window, GLFW_KEY_SPACE) == GLFW_PRESS) impl.pCamera->reset();
+		const glm::mat4 ViewMatrix	= impl.pCamera->getViewMatrix();
+		const glm::mat4 MVP			= impl.projection * ViewMatrix;
+		const glm::vec3 eye			= glm::vec3(glm::inverse(ViewMatrix)[3]);
+
+		// The planes of the viewing frustum (glm matrices are column-major)
+		Matx44f mvp;
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++) mvp(r, c) = MVP[c][r];
+		const frustum::planes_t planes = frustum::getPlanes(mvp);
+		auto isVisible = [&planes](const glm::vec3 &min, const glm::vec3 &max) { return frustum::isVisible(planes, Point3f(min.x, min.y, min.z), Point3f(max.x, max.y, max.z)); };
+		const float pixels = impl.size / (2 * tanf(FOV / 2));				// the size in pixels of a unit at the unit distance
+
+		// Culling and the level of detail of the chunks: the edges of a chunk are culled with their own bounding box, since they may cross the frustum,
+		// while both their ends are outside of it
+		impl.nodeRuns.clear();
+		impl.aggNodeRuns.clear();
+		impl.edgeRuns.clear();
+		impl.aggEdgeRuns.clear();
+		impl.coneRuns.clear();
+		for (size_t k = 0; k < impl.vChunks.size(); k++) {
+			const Chunk &chunk = impl.vChunks[k];
+			if (!isVisible(chunk.edgeMin, chunk.edgeMax)) continue;
+			const bool nodesVisible = isVisible(chunk.min, chunk.max);
+
+			const float diameter = glm::length(chunk.max - chunk.min);
+			const float distance = glm::length(0.5f * (chunk.min + chunk.max) - eye);
+			const bool  coarse	 = chunk.nNodes > 1 && distance > diameter && diameter * pixels < LOD_PIXELS * distance;
+			if (coarse) {
+				if (nodesVisible) impl.aggNodeRuns.add(static_cast<GLint>(k), 1);
+				impl.aggEdgeRuns.add(chunk.firstAggEdge, chunk.nAggEdges);
+			} else {
+				if (nodesVisible) impl.nodeRuns.add(chunk.firstNode, chunk.nNodes);
+				impl.edgeRuns.add(chunk.firstEdge, chunk.nEdges);
+				impl.coneRuns.add(chunk.firstCone, chunk.nCones);
 			}
+		}
 
-			glDisableVertexAttribArray(0);
-			glDisableVertexAttribArray(1);
-
-			glfwSwapBuffers(window);										// Swap front and back buffers 
-			glfwPollEvents();												// Poll for and process events 
+		// Draw nodes
+		glUseProgram(impl.NodeProgramID);
+		glUniformMatrix4fv(impl.NodeMatrixID, 1, GL_FALSE, &MVP[0][0]);		// Send our transformation to the currently bound shader, in the "MVP" uniform
+		glUniform1f(impl.NodeScaleID, 1.0f);
+		glBindVertexArray(impl.vaoNodes);
+		drawArrays(GL_POINTS, impl.nodeRuns, 1);
+		glUniform1f(impl.NodeScaleID, 2.0f);
+		glBindVertexArray(impl.vaoAggNodes);
+		drawArrays(GL_POINTS, impl.aggNodeRuns, 1);
+
+		// Draw edges
+		glUseProgram(impl.EdgeProgramID);
+		glUniformMatrix4fv(impl.EdgeMatrixID, 1, GL_FALSE, &MVP[0][0]);
+		if (impl.isGroupsColor) {
+			glBindVertexArray(impl.vaoGroupEdges);
+			drawArrays(GL_LINES, impl.edgeRuns, 2);
+		} else {
+			glBindVertexArray(impl.vaoNodes);
+			drawElements(GL_LINES, impl.edgeRuns, 2);
+		}
+		glBindVertexArray(impl.vaoAggNodes);
+		drawElements(GL_LINES, impl.aggEdgeRuns, 2);
+
+		// Draw cones
+		glUseProgram(impl.ConeProgramID);
+		glUniformMatrix4fv(impl.ConeMatrixID, 1, GL_FALSE, &MVP[0][0]);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, impl.colorTexture);
+		glUniform1i(impl.ConeColorsID, 0);
+		glBindVertexArray(impl.vaoCones);
+		glBindBuffer(GL_ARRAY_BUFFER, impl.coneBuffer);
+		for (size_t r = 0; r < impl.coneRuns.vFirst.size(); r++) {
+			const size_t offset = impl.coneRuns.vFirst[r] * sizeof(Cone);
+			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Cone), (void *)(offset + offsetof(Cone, top)));
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Cone), (void *)(offset + offsetof(Cone, axis)));
+			glVertexAttribIPointer(4, 1, GL_INT, sizeof(Cone), (void *)(offset + offsetof(Cone, slot)));
+			glDrawElementsInstanced(GL_TRIANGLES, impl.nConeIndices, GL_UNSIGNED_INT, (void *)0, impl.coneRuns.vCount[r]);
 		}
+		glBindVertexArray(0);
 
-		// Cleanup VBO and shader
-		glDeleteBuffers(1, &vertexBuffer);
-		glDeleteBuffers(1, &colorBuffer);
-		if (isGroupsColor) glDeleteBuffers(1, &groupColorBuffer);
-		glDeleteBuffers(1, &indexBuffer);
-		
-		glDeleteProgram(NodeProgramID);
-		glDeleteProgram(EdgeProgramID);
-		glDeleteVertexArrays(1, &vertex_array_id);
+		glfwSwapBuffers(impl.window);										// Swap front and back buffers 
+		glfwPollEvents();													// Poll for and process events 
+		return true;
+	}
 
-		// Close OpenGL window and terminate GLFW
-		glfwTerminate();
+	void CGraphViewer3D::show(void)
+	{
+		while (render());
+	}
+
+	void showGraph3D(int size, IGraphPairwise &graph, std::function<Point3f(size_t)> posFunc, std::function<cv::Scalar(size_t)> colorFunc, const vec_scalar_t &groupsColor)
+	{
+		CGraphViewer3D(size, graph, posFunc, colorFunc, groupsColor).show();
 	}
 #endif
 } }
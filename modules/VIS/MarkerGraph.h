@@ -3,6 +3,7 @@
 #pragma once
 
 #include "types.h"
+#include <memory>
 
 namespace DirectGraphicalModels { 
 	class IGraphPairwise;
@@ -59,11 +60,90 @@ namespace DirectGraphicalModels {
 	* @param colorFunc The color function: a mapper, that defines color (\b CV_RGB(r, g, b)) for every graph node.
 	* @param groupsColor The list of colors for graph edge groups. May be achieved with the function:
 	* \ref vis::generateDefaultPalette() or generated manually.                                 
+	* @note This function shows the graph with @ref CGraphViewer3D until the window is closed
 	*/
 	DllExport void showGraph3D(int								 size, 
 							   IGraphPairwise				   & graph,
 							   std::function<Point3f(size_t)>    posFunc, 
 							   std::function<cv::Scalar(size_t)>   colorFunc	= nullptr,
 							   const vec_scalar_t			   & groupsColor	= vec_scalar_t());
+
+	// ================================ Graph Viewer 3D Class ==============================
+	/**
+	* @ingroup moduleVIS
+	* @brief Interactive 3D viewer for large graphs
+	* @details This class creates an OpenGL window with the visualized graph, seen from a trackball camera (ref. showGraph3D()), and keeps it open 
+	* between the frames, so that the colors of the nodes may be updated, \a e.g. after every inference:
+	* @code
+	* CGraphViewer3D viewer(800, graph, posFunc, [&](size_t n) { return palette[vSolution[n]]; });
+	* while (viewer.render()) {
+	*	vec_byte_t vNewSolution = inferer.decode(10);
+	*	vec_size_t vChanged;
+	*	for (size_t n = 0; n < vSolution.size(); n++) if (vNewSolution[n] != vSolution[n]) vChanged.push_back(n);
+	*	vSolution = vNewSolution;
+	*	viewer.updateColors(vChanged);
+	* }
+	* @endcode
+	* In order to stay interactive with millions of nodes, the graph is uploaded to the GPU only once:
+	* - The nodes are sorted into a regular grid of spatial chunks, and the chunks outside of the viewing frustum are not drawn. The edges of a chunk are culled
+	* with the bounding box of both their ends, thus the edges to the visible nodes are drawn, even if the chunk itself is outside of the frustum;
+	* - The chunks, which appear smaller than a few pixels on the screen, are drawn with one aggregated node, placed at the centroid of the chunk and colored
+	* with the mean color of its nodes, and with the aggregated edges between the chunks (level of detail);
+	* - The edges are drawn from the node buffers, and the arrow cones of the directed edges are drawn as the instances of one cone mesh, colored from the node buffer;
+	* - updateColors() uploads only the changed ranges of the node colors, which are shared by the nodes, edges and cones.
+	* 
+	* All the methods must be called from the thread, which has created the viewer.
+	* > In order to use this class, OpenGL must be built with the \b USE_OPENGL flag
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CGraphViewer3D
+	{
+	public:
+		/**
+		* @brief Constructor
+		* @details Creates the window and uploads the graph. The parameters are the same as in showGraph3D()
+		* @param size The size of the viewing window (\b size x \b size pixels)
+		* @param graph The graph
+		* @param posFunc The positioning function: a mapper, that defines spacial position in 3D world for every graph node
+		* @param colorFunc The color function: a mapper, that defines color (\b CV_RGB(r, g, b)) for every graph node. It is called again by updateColors()
+		* @param groupsColor The list of colors for graph edge groups
+		*/
+		DllExport CGraphViewer3D(int								  size,
+								 IGraphPairwise					& graph,
+								 std::function<Point3f(size_t)>	  posFunc,
+								 std::function<cv::Scalar(size_t)> colorFunc	= nullptr,
+								 const vec_scalar_t				& groupsColor	= vec_scalar_t());
+		DllExport CGraphViewer3D(const CGraphViewer3D &) = delete;
+		DllExport ~CGraphViewer3D(void);
+
+		DllExport bool	operator=(const CGraphViewer3D &) = delete;
+
+		/**
+		* @brief Updates the colors of the given nodes
+		* @details The color function is called for every given node, and only the changed ranges of the buffers are uploaded to the GPU.
+		* The edges and the arrow cones follow the colors of their nodes; the edges, colored by their groups, are not changed.
+		* @param vNodes The indexes of the nodes, whose colors have changed
+		*/
+		DllExport void	updateColors(const vec_size_t &vNodes);
+		/**
+		* @brief Updates the colors of all the nodes
+		*/
+		DllExport void	updateColors(void);
+		/**
+		* @brief Renders one frame and processes the user input
+		* @retval true if the window remains open
+		* @retval false if the window has been closed by the user
+		*/
+		DllExport bool	render(void);
+		/**
+		* @brief Renders the frames until the window is closed by the user
+		*/
+		DllExport void	show(void);
+
+
+	private:
+		struct Impl;
+		std::unique_ptr<Impl>	m_pImpl;		///< The OpenGL objects and the chunks of the graph
+	};
 #endif
 } }
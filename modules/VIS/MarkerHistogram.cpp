@@ -1,6 +1,7 @@
 #include "MarkerHistogram.h"
 #include "DGM/TrainNodeNaiveBayes.h"
 #include "DGM/IPDF.h"
+#include "DGM/parallel.h"
 #include "macroses.h"
 
 namespace DirectGraphicalModels { namespace vis 
@@ -22,29 +23,31 @@ Mat	CMarkerHistogram::drawClassificationMap2D(float Z) const
 	rectangle(res, Point(margin.height, margin.height), Point(256 + margin.height, 256 + margin.height), CV_RGB(0, 0, 0), -1);
 
 	if (nFeatures == 2) {
-#ifdef ENABLE_PDP
-		parallel_for_(Range(0, 256), [&](const Range& range) {
-#else
-		const Range range(0, 256);
-#endif
-		for (int y = range.start; y < range.end; y++) {
-			Mat fv(2, 1, CV_8UC1);
-			fv.at<byte>(1, 0) = static_cast<byte>(y);
-			Vec3b* pRes = res.ptr<Vec3b>(margin.height + 255 - y);
+		// All the cells of the feature space are evaluated with one batched call
+		Mat fv(256, 256, CV_8UC2);
+		for (int y = 0; y < 256; y++) {
+			byte *pFv = fv.ptr<byte>(y);
 			for (int x = 0; x < 256; x++) {
-				fv.at<byte>(0, 0) = static_cast<byte>(x);
-				Mat pot = m_nodeTrainer.getNodePotentials(fv, 1.0f, Z);
+				pFv[2 * x]		= static_cast<byte>(x);
+				pFv[2 * x + 1]	= static_cast<byte>(y);
+			}
+		}
+		const Mat	pot		= m_nodeTrainer.getNodePotentials(fv, Mat(), Z);
+		const int	nStates	= pot.channels();
 
-				for (int s = 0; s < pot.rows; s++) {
-					float val = MIN(100, pot.at<float>(s, 0));
-					Scalar color = val * m_vPalette[s % n].first / 100;
-					pRes[margin.height + x] += Vec3b((byte)color[0], (byte)color[1], (byte)color[2]);
-				}
-			} // x
-		} // y
-#ifdef ENABLE_PDP
+		parallel::parallelFor(Range(0, 256), [&](const Range &range) {
+			for (int y = range.start; y < range.end; y++) {
+				const float	*pPot = pot.ptr<float>(y);
+				Vec3b		*pRes = res.ptr<Vec3b>(margin.height + 255 - y);
+				for (int x = 0; x < 256; x++) {
+					for (int s = 0; s < nStates; s++) {
+						float val = MIN(100, pPot[x * nStates + s]);
+						Scalar color = val * m_vPalette[s % n].first / 100;
+						pRes[margin.height + x] += Vec3b((byte)color[0], (byte)color[1], (byte)color[2]);
+					}
+				} // x
+			} // y
 		});
-#endif
 	}
 	else DGM_WARNING("The number of features (%d) is not 2", nFeatures);
 
@@ -108,15 +111,18 @@ Mat CMarkerHistogram::drawHistogram(Scalar color) const
 	Mat	res(resSize, CV_8UC3);							// Resulting Image
 	res.setTo(bkgIntencity);
 
-	for (word f = 0; f < nFeatures; f++) {				// freatures
-		int dx = f / fMaxHeight;	dx *= (256 + 2 * margin.width);
-		int dy = f % fMaxHeight;	dy *= (100 + margin.height);
+	// The feature histograms are drawn concurrently into the disjoint regions of the resulting image
+	parallel::parallelFor(Range(0, nFeatures), [&](const Range &range) {
+		for (int f = range.start; f < range.end; f++) {		// freatures
+			int dx = f / fMaxHeight;	dx *= (256 + 2 * margin.width);
+			int dy = f % fMaxHeight;	dy *= (100 + margin.height);
 
-		Mat featureHistogram = drawFeatureHistogram(f, activeState);
-		Rect roi(Point(dx, margin.height + dy), featureHistogram.size());
-		featureHistogram.copyTo(res(roi));
-		featureHistogram.release();
-	} // f
+			Mat featureHistogram = drawFeatureHistogram(static_cast<word>(f), activeState);
+			Rect roi(Point(dx, margin.height + dy), featureHistogram.size());
+			featureHistogram.copyTo(res(roi));
+			featureHistogram.release();
+		} // f
+	}, 1);
 
 
 	Rect roi(Point(res.cols - legende.cols, margin.height), legende.size());
@@ -209,16 +215,17 @@ Mat CMarkerHistogram::drawFeatureHistogram2D(word f, int activeState) const
 		for (byte s = 0; s < nStates; s++) {				// states
 			ptr_pdf_t pPDF2D = dynamic_cast<const CTrainNodeBayes &>(m_nodeTrainer).getPDF2D(s);
 			DGM_ASSERT(pPDF2D);
-			for (int y = 0; y < 256; y++) {
-				Vec3b *pTmp = tmp.ptr<Vec3b>(margin.height + 256 - y);
-				for (int x = 0; x < 256; x++) {
-					double val = MIN(255, koeff * pPDF2D->getDensity(Scalar(x, y)));
-					Scalar color = val * m_vPalette[s % n].first / 255;
-					
-					if ((activeState == -1) || (activeState == s % n))
+			if ((activeState != -1) && (activeState != s % n)) continue;
+			parallel::parallelFor(Range(0, 256), [&](const Range &range) {
+				for (int y = range.start; y < range.end; y++) {
+					Vec3b *pTmp = tmp.ptr<Vec3b>(margin.height + 256 - y);
+					for (int x = 0; x < 256; x++) {
+						double val = MIN(255, koeff * pPDF2D->getDensity(Scalar(x, y)));
+						Scalar color = val * m_vPalette[s % n].first / 255;
 						pTmp[margin.height + x] = Vec3b((byte)color[0], (byte)color[1], (byte)color[2]);
+					}
 				}
-			}
+			});
 			addWeighted(res, 1.0, tmp, frgWeight, 0.0, res);
 			tmp.setTo(0);
 		} // s
@@ -0,0 +1,103 @@
+#include "ProgressViewer.h"
+#include "Marker.h"
+#include "DGM/Infer.h"
+#include "macroses.h"
+
+namespace DirectGraphicalModels { namespace vis
+{
+	// Constructor
+	CProgressViewer::CProgressViewer(render_function_t render) 
+		: m_render(render)
+		, m_owner(std::this_thread::get_id())
+		, m_nRendered(0)
+		, m_nSkipped(0)
+	{
+		DGM_ASSERT_MSG(m_render, "The render function is empty");
+		m_worker = std::thread(&CProgressViewer::work, this);
+	}
+
+	// Constructor
+	CProgressViewer::CProgressViewer(Size size, const CMarker &marker, const std::string &windowName)
+		: CProgressViewer([this, size, &marker](unsigned int nIt, const Mat &beliefs) {
+			DGM_ASSERT_MSG(beliefs.rows == size.area(), "The number of nodes (%d) does not correspond to the image size %d x %d", beliefs.rows, size.width, size.height);
+			Mat img;
+			marker.markPotentials(img, beliefs.reshape(beliefs.cols, size.height));
+			char str[32];
+			sprintf(str, "It: %u", nIt);
+			putText(img, str, Point(5, 15), FONT_HERSHEY_SIMPLEX, 0.45, CV_RGB(0, 0, 0), 1, cv::LineTypes::LINE_AA);
+			std::lock_guard<std::mutex> lock(m_frameMtx);
+			m_frame = img;
+		})
+	{
+		m_windowName = windowName;
+	}
+
+	CProgressViewer::~CProgressViewer(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_one();
+		m_worker.join();
+		if (std::this_thread::get_id() == m_owner) show();
+	}
+
+	void CProgressViewer::attach(CInfer &inferer, unsigned int period)
+	{
+		inferer.setProgressCallback([this](unsigned int nIt, const Mat &beliefs) { push(nIt, beliefs); }, period);
+	}
+
+	void CProgressViewer::push(unsigned int nIt, const Mat &beliefs)
+	{
+		if (beliefs.empty()) return;
+
+		std::unique_lock<std::mutex> lock(m_mtx, std::try_to_lock);
+		if (!lock.owns_lock()) {							// the rendering thread is swapping the buffers
+			m_nSkipped++;
+			return;
+		}
+		if (m_pending) m_nSkipped++;						// the previous frame is replaced with the latest one
+		beliefs.copyTo(m_buffer);
+		m_nIt		= nIt;
+		m_pending	= true;
+		lock.unlock();
+		m_cv.notify_one();
+		if (std::this_thread::get_id() == m_owner) show();
+	}
+
+	// The frame is taken only if the rendering thread does not hold it at the moment, thus the inferring thread is not stalled
+	void CProgressViewer::show(void)
+	{
+		if (m_windowName.empty()) return;
+		DGM_ASSERT_MSG(std::this_thread::get_id() == m_owner, "The frames must be shown on the thread, which has created the viewer");
+
+		Mat frame;
+		{
+			std::unique_lock<std::mutex> lock(m_frameMtx, std::try_to_lock);
+			if (!lock.owns_lock() || m_frame.empty()) return;
+			std::swap(frame, m_frame);
+		}
+		imshow(m_windowName, frame);
+		waitKey(1);
+	}
+
+	// ------------------------------ PRIVATE ------------------------------
+	void CProgressViewer::work(void)
+	{
+		Mat front;											// the frame being rendered: the back buffer is free meanwhile
+		for (;;) {
+			unsigned int nIt;
+			{
+				std::unique_lock<std::mutex> lock(m_mtx);
+				m_cv.wait(lock, [this] { return m_pending || m_stop; });
+				if (!m_pending) return;						// stopped, and all the frames are rendered
+				std::swap(front, m_buffer);
+				nIt			= m_nIt;
+				m_pending	= false;
+			}
+			m_render(nIt, front);
+			m_nRendered++;
+		}
+	}
+} }
@@ -0,0 +1,122 @@
+// Progress Viewer Class
+// Written by Sergey G. Kosov in 2026 for Project X
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace DirectGraphicalModels { 
+	class CInfer;
+	namespace vis
+{
+	class CMarker;
+
+	// ================================ Progress Viewer Class ==============================
+	/**
+	* @ingroup moduleVIS
+	* @brief Asynchronous viewer of the inference progress
+	* @details This class renders the current beliefs of a running inference (ref. CInfer::setProgressCallback()) on a separate thread, so that 
+	* the labelling may be watched while it converges. The inferring thread only copies the beliefs into the back buffer of the viewer, and only if 
+	* the buffer is free: while the renderer swaps the buffers, the frame is skipped, thus the renderer never stalls the solver. If the renderer is slower
+	* than the inference, the intermediate frames are dropped and the latest one is rendered.
+	*
+	* The OpenCV windows may be used only from the thread, which has created them. Thus the viewer of an image only prepares the frames on the rendering thread,
+	* while the frames are shown on the thread, which has created the viewer (ref. show()): by push(), if the inference runs on that thread, and by the destructor.
+	* @code
+	* CMarker marker;
+	* CProgressViewer viewer(imgSize, marker);							// shows the labelling in the "Inference" window
+	* viewer.attach(graphKit.getInfer(), 5);							// every 5 iterations
+	* vec_byte_t solution = graphKit.getInfer().decode(100);
+	* @endcode
+	* > The viewer must outlive the inference, or be detached with CInfer::setProgressCallback(nullptr)
+	* @author Sergey G. Kosov, sergey.kosov@project-10.de
+	*/
+	class CProgressViewer
+	{
+	public:
+		/// Render function: receives the number of the completed iterations and the beliefs: Mat(size: nNodes x nStates; type: CV_32FC1), valid during the call
+		using render_function_t = std::function<void(unsigned int nIt, const Mat &beliefs)>;
+
+		/**
+		* @brief Constructor
+		* @param render The render function, called on the rendering thread of the viewer
+		*/
+		DllExport CProgressViewer(render_function_t render);
+		/**
+		* @brief Constructor for the graphs, built over an image
+		* @details The beliefs are mapped with CMarker::markPotentials() with the number of iterations on the rendering thread, and shown in the OpenCV window
+		* on the thread, which has created the viewer (ref. show())
+		* @param size The size of the image: the number of the graph nodes must be equal to its area
+		* @param marker The marker, which must outlive the viewer
+		* @param windowName The name of the window
+		*/
+		DllExport CProgressViewer(Size size, const CMarker &marker, const std::string &windowName = "Inference");
+		DllExport CProgressViewer(const CProgressViewer &) = delete;
+		/**
+		* @brief Destructor
+		* @details Renders the pending frame, if any, stops the rendering thread and shows the last frame
+		*/
+		DllExport ~CProgressViewer(void);
+
+		DllExport bool	operator=(const CProgressViewer &) = delete;
+
+		/**
+		* @brief Sets the progress callback of the inferer to push() the beliefs into this viewer
+		* @param inferer The inferer
+		* @param period The number of iterations between two frames
+		*/
+		DllExport void	attach(CInfer &inferer, unsigned int period = 1);
+		/**
+		* @brief Passes the beliefs to the rendering thread
+		* @details This function is called by the inferring thread. It copies the beliefs into the back buffer, unless the rendering thread holds the buffer
+		* at the moment: in this case the frame is skipped. The function never waits for the rendering. If it is called on the thread, which has created the viewer,
+		* it also shows the latest rendered frame (ref. show())
+		* @param nIt The number of the completed iterations
+		* @param beliefs The beliefs: Mat(size: nNodes x nStates; type: CV_32FC1)
+		*/
+		DllExport void	push(unsigned int nIt, const Mat &beliefs);
+		/**
+		* @brief Shows the latest rendered frame in the OpenCV window
+		* @details This function must be called on the thread, which has created the viewer. It is needed only if the inference runs on another thread:
+		* then the creating thread should call it periodically, \a e.g. while waiting for the inference. The function does nothing if no new frame is rendered,
+		* or if the viewer has been created with a custom render function
+		*/
+		DllExport void	show(void);
+		/**
+		* @brief Returns the number of the rendered frames
+		* @return The number of the calls of the render function
+		*/
+		DllExport size_t getNumRendered(void) const { return m_nRendered; }
+		/**
+		* @brief Returns the number of the skipped frames
+		* @return The number of the frames, which have been pushed but not rendered
+		*/
+		DllExport size_t getNumSkipped(void) const { return m_nSkipped; }
+
+
+	private:
+		void	work(void);
+
+
+	private:
+		render_function_t		m_render;				///< The render function
+		std::string				m_windowName;			///< The name of the OpenCV window, or the empty string for a custom render function
+		std::thread::id			m_owner;				///< The thread, which has created the viewer
+		Mat						m_frame;				///< The latest rendered frame, which has not been shown
+		std::mutex				m_frameMtx;				///< The mutex, protecting the rendered frame
+		Mat						m_buffer;				///< The back buffer with the latest frame
+		unsigned int			m_nIt		= 0;		///< The number of iterations of the latest frame
+		bool					m_pending	= false;	///< Flag indicating whether the back buffer holds a frame, which has not been rendered
+		bool					m_stop		= false;	///< Flag indicating whether the rendering thread should stop
+		std::atomic<size_t>		m_nRendered;			///< The number of the rendered frames
+		std::atomic<size_t>		m_nSkipped;				///< The number of the skipped frames
+		std::mutex				m_mtx;					///< The mutex, protecting the back buffer and the flags
+		std::condition_variable	m_cv;					///< The condition for the rendering thread, waiting for a frame
+		std::thread				m_worker;				///< The rendering thread
+	};
+} }
@@ -10,12 +10,13 @@ out vec3 fragmentColor;
 
 // Values that stay constant for the whole mesh.
 uniform mat4 MVP;
+uniform float pointScale = 1.0f;
 
 void main()
 {
 	// Output position of the vertex, in clip space : MVP * position
 	gl_Position =  MVP * vec4(vertexPosition, 1);
-	gl_PointSize = max(5.0f, 35.0f / gl_Position.w);
+	gl_PointSize = pointScale * max(5.0f, 35.0f / gl_Position.w);
 
 	// The color of each vertex will be interpolated to produce the color of each fragment
 	fragmentColor = vertexColor;  
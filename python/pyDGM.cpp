@@ -0,0 +1,190 @@
+// Python bindings for the graph potentials, the marginals and the labels
+// Written by Sergey G. Kosov in 2026 for Project X
+//
+// The NumPy arrays cross the language boundary without copying: the arrays, passed to the bindings, are wrapped into the Mat headers, and the arrays,
+// returned by the bindings, are views of the DGM buffers. Since NumPy exports its arrays with DLPack (__dlpack__), the views may be passed further,
+// e.g. with torch.from_dlpack(), without copying as well.
+//
+//	import numpy as np, pydgm
+//	kit = pydgm.GraphKit(pydgm.GraphType.grid, nStates)
+//	kit.build(height, width)
+//	kit.add_default_edges(0.01)
+//	kit.set_input(unaries)						# float32 array (height x width x nStates), read in place by the inference
+//	kit.set_output(marginals)					# float32 array (height x width x nStates), written in place by the inference
+//	kit.infer(100)
+//	labels = kit.get_results()					# uint8 array (height x width), allocated in Python and filled in place
+#include "DGM.h"
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+namespace py = pybind11;
+using namespace DirectGraphicalModels;
+
+namespace {
+	// Wraps the C-contiguous array with exactly rows x cols x channels elements of type T into the Mat header. The data is shared: an array, which does not
+	// meet the requirements, is rejected instead of being copied silently. The arrays, which are written by DGM, must be writable; the read-only arrays
+	// are wrapped only for reading
+	template <typename T>
+	Mat wrap(const py::array &arr, int rows, int cols, int channels, const char *name, bool write = false)
+	{
+		if (!py::isinstance<py::array_t<T>>(arr))						throw py::type_error(std::string(name) + ": wrong dtype: " + py::str(arr.dtype()).cast<std::string>());
+		if (!(arr.flags() & py::array::c_style))						throw py::value_error(std::string(name) + ": the array must be C-contiguous");
+		if (arr.size() != static_cast<py::ssize_t>(rows) * cols * channels)	throw py::value_error(std::string(name) + ": the array must have " + std::to_string(static_cast<size_t>(rows) * cols * channels) + " elements");
+		if (write && !arr.writeable())									throw py::value_error(std::string(name) + ": the array must be writable");
+		return Mat(rows, cols, CV_MAKETYPE(cv::DataType<T>::depth, channels), const_cast<void *>(arr.data()));
+	}
+
+	// Returns the view of the Mat, which keeps the Mat (and thus its reference-counted data) alive
+	py::array view(const Mat &mat)
+	{
+		Mat *pMat = new Mat(mat);
+		py::capsule owner(pMat, [](void *p) { delete static_cast<Mat *>(p); });
+		return py::array_t<float>(std::vector<py::ssize_t>{ pMat->rows, pMat->cols }, reinterpret_cast<float *>(pMat->data), owner);
+	}
+}
+
+// ================================ Graph Kit Wrapper Class ===============================
+// Owns the graph kit and the buffers, shared with Python. The arrays, passed as the external buffers, are referenced, so that they outlive the inferer
+class CPyGraphKit
+{
+public:
+	CPyGraphKit(GraphType graphType, byte nStates) : m_pKit(CGraphKit::create(graphType, nStates)) {}
+
+	// The storage of the node potentials is re-allocated, thus the graph may not be rebuilt, while their view is referenced
+	void build(int height, int width)
+	{
+		for (const py::weakref &view : m_vPotViews)
+			if (!view().is_none()) throw py::value_error("A view of the node potentials is still referenced: delete it before rebuilding the graph");
+		m_vPotViews.clear();
+		m_pKit->getGraphExt().buildGraph(Size(width, height));
+	}
+
+	void addDefaultEdges(float val, float weight) { m_pKit->getGraphExt().addDefaultEdgesModel(val, weight); }
+
+	// The Mat header is passed to the graph directly: the potentials are copied only once, into the storage of the graph
+	void setPotentials(const py::array &pots)
+	{
+		const Size size = m_pKit->getGraphExt().getSize();
+		m_pKit->getGraphExt().setGraph(wrap<float>(pots, size.height, size.width, getNumStates(), "pots"));
+	}
+
+	// The graphs with the continuous storage of the node potentials (dense and grid graphs) are exposed directly. The view is read-only, since the writes
+	// would bypass the dirty tracking of the graph (ref. IGraphPairwise::setDirtyTracking()): the potentials are changed with setPotentials()
+	py::array getNodePotentials(py::object self)
+	{
+		const CGraph	&graph	= m_pKit->getGraph();
+		const size_t	 nNodes = graph.getNumNodes();
+		const byte		 nStates = getNumStates();
+		if (nNodes == 0) throw py::value_error("The graph is empty");
+		const float *pFirst = graph.getNodeView(0).data();
+		for (size_t n = 1; n < nNodes; n++)
+			if (graph.getNodeView(n).data() != pFirst + n * nStates)
+				throw py::type_error("The node potentials of this graph type are not stored continuously: use pydgm.GraphType.grid or pydgm.GraphType.dense");
+		py::array res = py::array_t<float>(std::vector<py::ssize_t>{ static_cast<py::ssize_t>(nNodes), nStates }, pFirst, self);
+		res.attr("flags").attr("writeable") = false;
+		m_vPotViews.erase(std::remove_if(m_vPotViews.begin(), m_vPotViews.end(), [](const py::weakref &view) { return view().is_none(); }), m_vPotViews.end());
+		m_vPotViews.emplace_back(res);
+		return res;
+	}
+
+	void setInput(const py::object &pots)
+	{
+		auto pInfer = dynamic_cast<CMessagePassing *>(&m_pKit->getInfer());
+		if (!pInfer) throw py::type_error("The external input buffer is supported only by the message passing inference");
+		if (pots.is_none()) {
+			pInfer->setInput(NULL);
+			m_input = Mat();
+		}
+		else {
+			m_input = wrap<float>(pots.cast<py::array>(), static_cast<int>(getNumNodes()), getNumStates(), 1, "pots");
+			if (m_output.data == m_input.data) throw py::value_error("The input and the output buffers must differ");
+			pInfer->setInput(&m_input);
+		}
+		m_inputRef = pots;
+	}
+
+	void setOutput(const py::object &marginals)
+	{
+		if (marginals.is_none()) {
+			m_output = Mat();
+			m_pKit->getInfer().setKeepPotentials(!m_input.empty());			// the input buffer requires the output buffer
+		}
+		else {
+			m_output = wrap<float>(marginals.cast<py::array>(), static_cast<int>(getNumNodes()), getNumStates(), 1, "marginals", true);
+			if (m_output.data == m_input.data) throw py::value_error("The input and the output buffers must differ");
+			m_pKit->getInfer().setOutput(&m_output);						// the header of the right size is not re-allocated by the inference
+		}
+		m_outputRef = marginals;
+	}
+
+	void infer(unsigned int nIt) { m_pKit->getInfer().infer(nIt); }
+
+	// The external output buffer is returned as is; otherwise the view of the own buffer of the inferer or of the copy of the node potentials
+	py::object getMarginals(void) const
+	{
+		const Mat marginals = m_pKit->getInfer().getMarginals();
+		if (!m_output.empty() && marginals.data == m_output.data) return m_outputRef;
+		return view(marginals);
+	}
+
+	// The labels and the confidence values are written in place into the Python arrays
+	py::array getResults(py::object labels, const py::object &confidence)
+	{
+		const Size	size	= m_pKit->getGraphExt().getSize();
+		const int	nNodes	= static_cast<int>(getNumNodes());
+		const bool	isImage = size.area() == nNodes;
+		const int	rows	= isImage ? size.height : nNodes;
+		const int	cols	= isImage ? size.width : 1;
+
+		if (labels.is_none()) labels = py::array_t<byte>(std::vector<py::ssize_t>{ rows, cols });
+		const py::array arrLabels = labels.cast<py::array>();
+		Mat lbl = py::isinstance<py::array_t<word>>(arrLabels) ? wrap<word>(arrLabels, rows, cols, 1, "labels", true) : wrap<byte>(arrLabels, rows, cols, 1, "labels", true);
+		Mat conf;
+		if (!confidence.is_none()) conf = wrap<float>(confidence.cast<py::array>(), rows, cols, 1, "confidence", true);
+
+		{
+			py::gil_scoped_release release;
+			m_pKit->getInfer().getResults(lbl, conf.empty() ? NULL : &conf);
+		}
+		return arrLabels;
+	}
+
+	byte	getNumStates(void) const { return m_pKit->getGraph().getNumStates(); }
+	size_t	getNumNodes(void) const { return m_pKit->getGraph().getNumNodes(); }
+
+
+private:
+	std::shared_ptr<CGraphKit>	m_pKit;
+	Mat							m_input;		///< The header of the external input buffer
+	Mat							m_output;		///< The header of the external output buffer
+	py::object					m_inputRef;		///< The Python array of the input buffer
+	py::object					m_outputRef;	///< The Python array of the output buffer
+	std::vector<py::weakref>	m_vPotViews;	///< The weak references to the views of the node potentials
+};
+
+PYBIND11_MODULE(pydgm, m)
+{
+	m.doc() = "Direct Graphical Models: zero-copy bindings for the potentials, the marginals and the labels";
+
+	py::enum_<GraphType>(m, "GraphType")
+		.value("pairwise",	GraphType::pairwise)
+		.value("dense",		GraphType::dense)
+		.value("csr",		GraphType::csr)
+		.value("grid",		GraphType::grid);
+
+	py::class_<CPyGraphKit>(m, "GraphKit")
+		.def(py::init<GraphType, byte>(), py::arg("graph_type"), py::arg("n_states"))
+		.def("build", &CPyGraphKit::build, py::arg("height"), py::arg("width"), "Builds the graph over the image of the given size")
+		.def("add_default_edges", &CPyGraphKit::addDefaultEdges, py::arg("val"), py::arg("weight") = 1.0f, "Adds the default (Potts) edges model")
+		.def("set_potentials", &CPyGraphKit::setPotentials, py::arg("pots"), "Fills the node potentials from the float32 array (height x width x n_states)")
+		.def("node_potentials", [](py::object self) { return self.cast<CPyGraphKit &>().getNodePotentials(self); },
+			"Returns the read-only view (n_nodes x n_states) of the node potentials of the grid or dense graph. The graph may not be rebuilt while the view is referenced")
+		.def("set_input", &CPyGraphKit::setInput, py::arg("pots"), "Sets the float32 array (n_nodes x n_states) of the node potentials, read in place by the message passing inference, or None")
+		.def("set_output", &CPyGraphKit::setOutput, py::arg("marginals"), "Sets the float32 array (n_nodes x n_states), where the inference writes the marginals in place, or None")
+		.def("infer", &CPyGraphKit::infer, py::arg("n_it") = 1, py::call_guard<py::gil_scoped_release>(), "Runs the inference")
+		.def("marginals", &CPyGraphKit::getMarginals, "Returns the marginals (n_nodes x n_states) without copying, if the output buffer is set")
+		.def("get_results", &CPyGraphKit::getResults, py::arg("labels") = py::none(), py::arg("confidence") = py::none(),
+			"Writes the most probable states into the uint8 or uint16 array (height x width) and the confidence values into the float32 array in place; returns the labels")
+		.def_property_readonly("n_states", &CPyGraphKit::getNumStates)
+		.def_property_readonly("n_nodes", &CPyGraphKit::getNumNodes);
+}
@@ -0,0 +1,79 @@
+# Tests of the pydgm Python bindings
+# Written by Sergey G. Kosov in 2026 for Project X
+#
+# The module must be built with the BUILD_PYTHON option and found in the PYTHONPATH:
+#	PYTHONPATH=<build>/bin python -m unittest test_pydgm
+import gc
+import unittest
+import numpy as np
+import pydgm
+
+
+class TestPyDGM(unittest.TestCase):
+	def setUp(self):
+		self.height, self.width, self.n_states = 6, 8, 3
+		self.n_nodes = self.height * self.width
+		rng = np.random.default_rng(0xBEEF)
+		self.pots = rng.uniform(0.1, 1.0, (self.height, self.width, self.n_states)).astype(np.float32)
+		self.kit = pydgm.GraphKit(pydgm.GraphType.grid, self.n_states)
+		self.kit.build(self.height, self.width)
+		self.kit.set_potentials(self.pots)
+		self.kit.add_default_edges(0.01)
+
+	def test_zero_copy(self):
+		marginals = np.zeros((self.n_nodes, self.n_states), np.float32)
+		self.kit.set_output(marginals)
+		self.kit.infer(10)
+		self.assertTrue(np.shares_memory(self.kit.marginals(), marginals))
+		np.testing.assert_allclose(marginals.sum(axis=1), 1.0, rtol=1e-4)
+
+		labels = np.zeros((self.height, self.width), np.uint8)
+		self.assertTrue(np.shares_memory(self.kit.get_results(labels), labels))
+		np.testing.assert_array_equal(labels.reshape(-1), marginals.argmax(axis=1))
+
+	def test_rejected_arrays(self):
+		with self.assertRaises(TypeError):
+			self.kit.set_potentials(self.pots.astype(np.float64))
+		with self.assertRaises(ValueError):
+			self.kit.set_potentials(np.asfortranarray(self.pots))
+		with self.assertRaises(ValueError):
+			self.kit.set_potentials(self.pots[:, :-1])
+
+		marginals = np.zeros((self.n_nodes, self.n_states), np.float32)
+		marginals.flags.writeable = False
+		with self.assertRaises(ValueError):
+			self.kit.set_output(marginals)
+		labels = np.zeros((self.height, self.width), np.uint8)
+		labels.flags.writeable = False
+		with self.assertRaises(ValueError):
+			self.kit.get_results(labels)
+
+		# The read-only input is only read
+		pots = self.pots.reshape(self.n_nodes, self.n_states).copy()
+		pots.flags.writeable = False
+		self.kit.set_input(pots)
+
+	def test_node_potentials_view(self):
+		view = self.kit.node_potentials()
+		self.assertFalse(view.flags.writeable)
+		np.testing.assert_array_equal(view, self.pots.reshape(self.n_nodes, self.n_states))
+
+		# The view follows the potentials and keeps the kit alive
+		self.kit.set_potentials(2 * self.pots)
+		np.testing.assert_array_equal(view, 2 * self.pots.reshape(self.n_nodes, self.n_states))
+		kit, self.kit = self.kit, None
+		del kit
+		gc.collect()
+		np.testing.assert_array_equal(view, 2 * self.pots.reshape(self.n_nodes, self.n_states))
+
+	def test_rebuild_with_view(self):
+		view = self.kit.node_potentials()
+		with self.assertRaises(ValueError):
+			self.kit.build(self.height, self.width)
+		del view
+		gc.collect()
+		self.kit.build(self.height, self.width)
+
+
+if __name__ == '__main__':
+	unittest.main()
@@ -59,6 +59,20 @@ TEST_F(CTestGraph, CG_pairwise_building)
 	testGraphBuilding(graph, nStates);
 }
 
+TEST_F(CTestGraph, CG_weiss_building)
+{
+	const byte nStates = static_cast<byte>(random::u(10, 255));
+	CGraphWeiss graph(nStates);
+	testGraphBuilding(graph, nStates);
+}
+
+TEST_F(CTestGraph, CG_csr_building)
+{
+	const byte nStates = static_cast<byte>(random::u(10, 255));
+	CGraphPairwiseCSR graph(nStates);
+	testGraphBuilding(graph, nStates);
+}
+
 
 // ======================================== IGraphPairwise Building ========================================
 void testGraphPairwiseBuilding(IGraphPairwise& graph, byte nStates)
@@ -143,6 +157,13 @@ void testGraphPairwiseBuilding(IGraphPairwise& graph, byte nStates)
 			ASSERT_EQ(sqrtf(pIn[x]), pOut[x]);
 	}
 
+	// Test that changing one edge does not affect the other edges of its group
+	graph.setEdge(n - 2, n - 1, pot_in);
+	graph.getEdge(n - 2, n - 1, pot_out);
+	ASSERT_EQ(pot_in.at<float>(0, 0), pot_out.at<float>(0, 0));
+	graph.getEdge(n - 3, n - 2, pot_out);
+	ASSERT_EQ(0, pot_out.at<float>(0, 0));
+
 	// graph.marginalize(const vec_size_t &nodes);
 	// graph.setEdge(size_t srcNode, size_t dstNode, const Mat &pot);
 }
@@ -154,6 +175,193 @@ TEST_F(CTestGraph, IGP_pairwise_building)
 	testGraphPairwiseBuilding(graph, nStates);
 }
 
+TEST_F(CTestGraph, IGP_pairwise_indexed_building)
+{
+	const byte nStates = static_cast<byte>(random::u(10, 255));
+	CGraphPairwise graph(nStates);
+	graph.setEdgeIndex(true);
+	testGraphPairwiseBuilding(graph, nStates);
+}
+
+TEST_F(CTestGraph, IGP_pairwise_add_edges)
+{
+	const byte	 nStates = static_cast<byte>(random::u(2, 255));
+	const size_t nNodes	 = 200;
+	const int	 nEdges	 = 1000;
+
+	// A dense random edge list without duplicates
+	Mat edges(nEdges, 2, CV_32SC1);
+	vec_byte_t vGroups(nEdges);
+	for (int e = 0; e < nEdges; e++) {
+		edges.at<int>(e, 0) = e % nNodes;
+		edges.at<int>(e, 1) = (e % nNodes + 1 + e / nNodes) % nNodes;
+		vGroups[e] = static_cast<byte>(e % 3);
+	}
+	Mat pot = random::U(Size(nStates, nStates), CV_32FC1, 0.0, 1.0);
+
+	CGraphPairwise graph(nStates);
+	CGraphPairwise graphIndexed(nStates);
+	graphIndexed.setEdgeIndex(true);
+	for (size_t n = 0; n < nNodes; n++) {
+		graph.addNode();
+		graphIndexed.addNode();
+	}
+	graph.addEdges(edges.rowRange(0, nEdges / 2), vec_byte_t(vGroups.begin(), vGroups.begin() + nEdges / 2), pot);
+	graph.setEdgeIndex(true);															// the index is built for the existing edges
+	graph.addEdges(edges.rowRange(nEdges / 2, nEdges), vec_byte_t(vGroups.begin() + nEdges / 2, vGroups.end()), pot);
+	for (int e = 0; e < nEdges; e++) graphIndexed.addEdge(edges.at<int>(e, 0), edges.at<int>(e, 1), vGroups[e], pot);
+	ASSERT_EQ(static_cast<size_t>(nEdges), graph.getNumEdges());
+	ASSERT_EQ(static_cast<size_t>(nEdges), graphIndexed.getNumEdges());
+
+	Mat pot_out;
+	for (int e = 0; e < nEdges; e++) {
+		const size_t src = edges.at<int>(e, 0);
+		const size_t dst = edges.at<int>(e, 1);
+		ASSERT_TRUE(graph.isEdgeExists(src, dst));
+		ASSERT_TRUE(graphIndexed.isEdgeExists(src, dst));
+		ASSERT_EQ(vGroups[e], graph.getEdgeGroup(src, dst));
+		ASSERT_EQ(vGroups[e], graphIndexed.getEdgeGroup(src, dst));
+		graph.getEdge(src, dst, pot_out);
+		ASSERT_EQ(0, norm(pot, pot_out, NORM_INF));
+	}
+	ASSERT_FALSE(graphIndexed.isEdgeExists(0, 0));
+
+	// The index follows the removed edges and may be switched off
+	graphIndexed.removeEdge(edges.at<int>(0, 0), edges.at<int>(0, 1));
+	ASSERT_FALSE(graphIndexed.isEdgeExists(edges.at<int>(0, 0), edges.at<int>(0, 1)));
+	graphIndexed.setEdgeIndex(false);
+	ASSERT_FALSE(graphIndexed.isEdgeExists(edges.at<int>(0, 0), edges.at<int>(0, 1)));
+	ASSERT_TRUE(graphIndexed.isEdgeExists(edges.at<int>(1, 0), edges.at<int>(1, 1)));
+}
+
+TEST_F(CTestGraph, IGP_pairwise_compact)
+{
+	const byte	 nStates = static_cast<byte>(random::u(2, 10));
+	const size_t nNodes	 = 100;
+
+	// The graph with removed edges and the same graph, built without them
+	CGraphPairwise graph(nStates);
+	CGraphPairwise graphRef(nStates);
+	for (size_t n = 0; n < nNodes; n++) {
+		Mat nodePot = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+		graph.addNode(nodePot);
+		graphRef.addNode(nodePot);
+	}
+	for (size_t n = 1; n < nNodes; n++) {
+		Mat edgePot = random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0);
+		graph.addArc(n - 1, n, edgePot);
+		if (n % 3) graphRef.addArc(n - 1, n, edgePot);
+		else	   graph.addArc(n, (n + nNodes / 2) % nNodes);
+	}
+	for (size_t n = 3; n < nNodes; n += 3) {
+		graph.removeArc(n - 1, n);
+		graph.removeArc(n, (n + nNodes / 2) % nNodes);
+	}
+	ASSERT_EQ(graphRef.getNumEdges(), graph.getNumEdges());
+
+	graph.compact();
+	ASSERT_EQ(graphRef.getNumEdges(), graph.getNumEdges());
+	Mat pot, potRef;
+	vec_size_t vChilds;
+	for (size_t n = 0; n < nNodes; n++) {
+		graph.getChildNodes(n, vChilds);
+		for (size_t c : vChilds) {
+			ASSERT_TRUE(graphRef.isEdgeExists(n, c));
+			graph.getEdge(n, c, pot);
+			graphRef.getEdge(n, c, potRef);
+			ASSERT_EQ(0, norm(pot, potRef, NORM_INF));
+		}
+	}
+
+	// The edges may be removed after compaction: the message passing skips the removed edges without compacting the graph
+	graph.removeArc(0, 1);
+	graphRef.removeArc(0, 1);
+	CInferLBP inferer(graph);
+	CInferLBP infererRef(graphRef);
+	inferer.infer(10);
+	infererRef.infer(10);
+	ASSERT_EQ(graphRef.getNumEdges(), graph.getNumEdges());
+	for (byte s = 0; s < nStates; s++) {
+		vec_float_t vPot = inferer.getPotentials(s);
+		vec_float_t vPotRef = infererRef.getPotentials(s);
+		for (size_t n = 0; n < nNodes; n++) ASSERT_FLOAT_EQ(vPotRef[n], vPot[n]);
+	}
+}
+
+TEST_F(CTestGraph, IGP_weiss_add_edges)
+{
+	const byte	nStates = static_cast<byte>(random::u(2, 255));
+	const int	nNodes	= 100;
+	const int	nEdges	= 300;
+
+	CGraphWeiss graph(nStates);
+	Mat pots = random::U(Size(nStates, nNodes), CV_32FC1, 0.0, 1.0);
+	graph.addNodes(pots);
+	pots.setTo(0);																		// the graph keeps its own copy
+
+	Mat edges(nEdges, 2, CV_32SC1);
+	vec_byte_t vGroups(nEdges);
+	for (int e = 0; e < nEdges; e++) {
+		edges.at<int>(e, 0) = e % nNodes;
+		edges.at<int>(e, 1) = (e % nNodes + 1 + e / nNodes) % nNodes;
+		vGroups[e] = static_cast<byte>(e % 2);
+	}
+	Mat pot = random::U(Size(nStates, nStates), CV_32FC1, 0.0, 1.0);
+	graph.addEdges(edges, vGroups, pot);
+	ASSERT_EQ(static_cast<size_t>(nEdges), graph.getNumEdges());
+
+	Mat pot_out;
+	for (int e = 0; e < nEdges; e++) {
+		ASSERT_TRUE(graph.isEdgeExists(edges.at<int>(e, 0), edges.at<int>(e, 1)));
+		ASSERT_EQ(vGroups[e], graph.getEdgeGroup(edges.at<int>(e, 0), edges.at<int>(e, 1)));
+		graph.getEdge(edges.at<int>(e, 0), edges.at<int>(e, 1), pot_out);
+		ASSERT_EQ(0, norm(pot, pot_out, NORM_INF));
+	}
+	graph.getNode(0, pot_out);
+	ASSERT_GT(sum(pot_out)[0], 0);
+}
+
+TEST_F(CTestGraph, IGP_weiss_shared_potentials)
+{
+	const byte	nStates = static_cast<byte>(random::u(2, 20));
+	const Size	size	= Size(random::u<int>(5, 20), random::u<int>(5, 20));
+
+	CGraphWeiss			graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	graphExt.buildGraph(size);
+	const size_t nEdges		= graph.getNumEdges();
+	const size_t sharedUsage = graph.getMemoryUsage();
+
+	// One edge gets its own potential; the others keep referencing the shared one
+	const Mat pot = random::U(Size(nStates, nStates), CV_32FC1, 0.0, 1.0);
+	graph.setEdges(std::nullopt, Mat::ones(nStates, nStates, CV_32FC1));
+	graph.setEdge(0, 1, pot);
+	Mat pot_out;
+	graph.getEdge(0, 1, pot_out);
+	ASSERT_EQ(0, norm(pot, pot_out, NORM_INF));
+	graph.getEdge(1, 0, pot_out);
+	ASSERT_EQ(0, norm(Mat::ones(nStates, nStates, CV_32FC1), pot_out, NORM_INF));
+	ASSERT_GT(graph.getMemoryUsage(), sharedUsage);
+
+	// The removed edge disappears from the adjacency of both nodes
+	vec_size_t vNodes(1, 12345);
+	graph.removeEdge(0, 1);
+	ASSERT_EQ(nEdges - 1, graph.getNumEdges());
+	graph.getChildNodes(0, vNodes);
+	ASSERT_TRUE(std::find(vNodes.begin(), vNodes.end(), 1) == vNodes.end());
+	ASSERT_TRUE(std::find(vNodes.begin(), vNodes.end(), 12345) == vNodes.end());
+	graph.getParentNodes(1, vNodes);
+	ASSERT_TRUE(std::find(vNodes.begin(), vNodes.end(), 0) == vNodes.end());
+	ASSERT_TRUE(graph.isEdgeExists(1, 0));
+}
+
+TEST_F(CTestGraph, IGP_csr_building)
+{
+	const byte nStates = static_cast<byte>(random::u(10, 255));
+	CGraphPairwiseCSR graph(nStates);
+	testGraphPairwiseBuilding(graph, nStates);
+}
+
 TEST_F(CTestGraph, IGP_weiss_building)
 {
 	const byte nStates = static_cast<byte>(random::u(10, 255));
@@ -202,6 +410,72 @@ TEST_F(CTestGraph, CG_dense_extension)
 	testGraphExtension(graphExt, graph);
 }
 
+TEST_F(CTestGraph, CG_dense_edge_model_cache)
+{
+	const byte	nStates = 3;
+	const Size	size(20, 15);
+	CGraphDense	graph1(nStates), graph2(nStates);
+	CGraphDenseExt graphExt1(graph1), graphExt2(graph2);
+	graphExt1.buildGraph(size);
+	graphExt2.buildGraph(size);
+
+	CGraphDenseExt::clearEdgeModelCache();
+	graphExt1.addGaussianEdgeModel(Vec2f::all(3.0f), 2.0f);
+	graphExt2.addGaussianEdgeModel(Vec2f::all(3.0f), 2.0f);
+	graphExt2.addGaussianEdgeModel(Vec2f::all(3.0f), 1.0f);
+	ASSERT_EQ(graph1.getEdgeModels()[0], graph2.getEdgeModels()[0]);		// the same size, sigma and weight share one model
+	ASSERT_NE(graph2.getEdgeModels()[0], graph2.getEdgeModels()[1]);
+
+	CGraphDenseExt::clearEdgeModelCache();
+	graphExt2.addGaussianEdgeModel(Vec2f::all(3.0f), 2.0f);
+	ASSERT_NE(graph1.getEdgeModels()[0], graph2.getEdgeModels()[2]);
+
+	// The training does not modify the shared models: the trained graph gets its own copy
+	const ptr_edgeModel_t pShared = graph1.getEdgeModels()[0];
+	random::U(graph1.getNodePotentials().size(), CV_32FC1, 0.1, 1.0).copyTo(graph1.getNodePotentials());
+	CParamEstimationDense trainer(1.0f, 2);
+	trainer.train({ &graph1 }, { vec_byte_t(graph1.getNumNodes(), 1) }, 2);
+	ASSERT_NE(graph1.getEdgeModels()[0], pShared);
+	ASSERT_EQ(graph2.getEdgeModels()[0], pShared);
+	ASSERT_EQ(dynamic_cast<const CEdgeModelPotts *>(pShared.get())->getWeight(), 2.0f);
+}
+
+TEST_F(CTestGraph, CG_dense_bilateral_features)
+{
+	const byte	nStates = 3;
+	const Size	size(20, 15);
+	const Vec2f sigma(3.0f, 2.0f);
+	Mat img(size, CV_8UC3);
+	randu(img, 0, 255);
+	vec_mat_t vImg;
+	split(img, vImg);
+
+	// Reference features
+	Mat features(size.area(), 5, CV_32FC1);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			float *pFeature = features.ptr<float>(y * size.width + x);
+			pFeature[0] = x / sigma[0];
+			pFeature[1] = y / sigma[1];
+			for (int c = 0; c < 3; c++) pFeature[2 + c] = img.at<Vec3b>(y, x)[c] / 10.0f;
+		}
+	CEdgeModelPotts model(features, 1.0f);
+
+	CGraphDense	graph(nStates);
+	CGraphDenseExt graphExt(graph);
+	graphExt.buildGraph(size);
+	graphExt.addBilateralEdgeModel(img, sigma, 10.0f, 1.0f);
+	graphExt.addBilateralEdgeModel(vImg, sigma, 10.0f, 1.0f);
+
+	Mat src = random::U(Size(nStates, size.area()), CV_32FC1);
+	Mat dst, res;
+	model.apply(src, dst);
+	for (auto &pModel : graph.getEdgeModels()) {
+		pModel->apply(src, res);
+		ASSERT_EQ(countNonZero(res != dst), 0);
+	}
+}
+
 TEST_F(CTestGraph, CG_pairwise_extension)
 {
 	const byte nStates = static_cast<byte>(random::u(10, 255));
@@ -210,6 +484,633 @@ TEST_F(CTestGraph, CG_pairwise_extension)
 	testGraphExtension(graphExt, graph);
 }
 
+TEST_F(CTestGraph, CG_csr_extension)
+{
+	const byte nStates = static_cast<byte>(random::u(10, 255));
+	CGraphPairwiseCSR graph(nStates);
+	CGraphPairwiseExt graphExt(graph);
+	testGraphExtension(graphExt, graph);
+}
+
+TEST_F(CTestGraph, CG_csr_save_load)
+{
+	const byte		nStates		= static_cast<byte>(random::u(2, 16));
+	const size_t	nNodes		= random::u<size_t>(100, 1000);
+	const std::string fileName	= "test_graph_csr.dgm";
+	CGraphPairwiseCSR graph(nStates);
+	graph.addNodes(random::U(Size(nStates, static_cast<int>(nNodes)), CV_32FC1, 0.0, 100.0));
+	for (size_t n = 1; n < nNodes; n++) graph.addArc(n - 1, n, static_cast<byte>(n % 3), EmptyMat);
+	graph.setEdges(0, random::U(Size(nStates, nStates), CV_32FC1, 0.0, 100.0));
+	graph.setEdges(1, random::U(Size(nStates, nStates), CV_32FC1, 0.0, 100.0));
+	graph.setEdges(2, random::U(Size(nStates, nStates), CV_32FC1, 0.0, 100.0));
+	graph.setEdge(0, 1, random::U(Size(nStates, nStates), CV_32FC1, 0.0, 100.0));
+	graph.setEdgePotts(2, 3, 2.0f, 0.5f);
+	graph.removeEdge(4, 5);
+	graph.save(fileName);
+
+	CGraphPairwiseCSR loaded(nStates);
+	loaded.load(fileName);
+	ASSERT_EQ(graph.getNumNodes(), loaded.getNumNodes());
+	ASSERT_EQ(graph.getNumEdges(), loaded.getNumEdges());
+	ASSERT_FALSE(loaded.isEdgeExists(4, 5));
+
+	Mat pot1, pot2;
+	vec_size_t vNodes1, vNodes2;
+	for (size_t n = 0; n < nNodes; n++) {
+		graph.getNode(n, pot1);
+		loaded.getNode(n, pot2);
+		ASSERT_EQ(0, norm(pot1, pot2, NORM_INF));
+		graph.getChildNodes(n, vNodes1);
+		loaded.getChildNodes(n, vNodes2);
+		ASSERT_EQ(vNodes1, vNodes2);
+		if (n == 0 || n == 5) continue;
+		graph.getEdge(n - 1, n, pot1);
+		loaded.getEdge(n - 1, n, pot2);
+		ASSERT_EQ(0, norm(pot1, pot2, NORM_INF));
+		ASSERT_EQ(graph.getEdgeGroup(n, n - 1), loaded.getEdgeGroup(n, n - 1));
+	}
+	remove(fileName.c_str());
+}
+
+TEST_F(CTestGraph, CG_grid_extension)
+{
+	const byte nStates = static_cast<byte>(random::u(10, 255));
+	CGraphGrid graph(nStates);
+	CGraphPairwiseExt graphExt(graph, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	testGraphExtension(graphExt, graph);
+	
+	Size graphSize = graphExt.getSize();
+	size_t nEdges = 2 * (2 * graphSize.width * graphSize.height - graphSize.width - graphSize.height) + 4 * (graphSize.width - 1) * (graphSize.height - 1);
+	ASSERT_EQ(nEdges, graph.getNumEdges());
+	ASSERT_TRUE(graph.isArcExists(0, 1));
+	ASSERT_TRUE(graph.isArcExists(0, graphSize.width + 1));
+	ASSERT_FALSE(graph.isEdgeExists(0, 2));
+}
+
+namespace {
+	// Fully connected edge model with the uniform kernel: acc_i(s) += weight * sum_j src_j(s), including j = i
+	class CEdgeModelUniform : public IEdgeModel {
+	public:
+		CEdgeModelUniform(float weight) : m_weight(weight) {}
+
+		void apply(const Mat &src, Mat &dst) const override
+		{
+			Mat buffer;
+			dst = Mat(src.size(), CV_32FC1, Scalar(0));
+			accumulate(src, dst, buffer);
+			exp(dst, dst);
+		}
+		void accumulate(const Mat &src, Mat &acc, Mat &buffer) const override
+		{
+			reduce(src, buffer, 0, REDUCE_SUM);
+			for (int n = 0; n < acc.rows; n++) acc.row(n) += m_weight * buffer;
+		}
+
+	private:
+		float m_weight;
+	};
+}
+
+TEST_F(CTestGraph, CG_energy)
+{
+	const byte	nStates		= 5;
+	const Size	graphSize	= Size(random::u<int>(10, 50), random::u<int>(10, 50));
+	const Mat	pots		= random::U(graphSize, CV_32FC(nStates));
+	const Mat	features	= random::U(graphSize, CV_8UC3);
+	
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseCSR	graphCSR(nStates);
+	CGraphGrid			graphGrid(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	CGraphPairwiseExt	graphExtCSR(graphCSR, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	CGraphPairwiseExt	graphExtGrid(graphGrid, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	for (CGraphPairwiseExt *pGraphExt : { &graphExt, &graphExtCSR, &graphExtGrid }) {
+		pGraphExt->setGraph(pots);
+		pGraphExt->addDefaultEdgesModel(features, 100);
+	}
+	graph.removeArc(0, 1);
+	graphCSR.removeArc(0, 1);
+	graphGrid.removeArc(0, 1);
+
+	vec_byte_t vLabels(graph.getNumNodes());
+	for (byte &label : vLabels) label = random::u<byte>(0, nStates - 1);
+
+	// The reference energy: the sum over all the nodes and directed edges
+	double	energy = 0;
+	Mat		pot;
+	vec_size_t vChilds;
+	for (size_t n = 0; n < graph.getNumNodes(); n++) {
+		graph.getNode(n, pot);
+		energy -= log(MAX(FLT_MIN, pot.at<float>(vLabels[n], 0)));
+		graph.getChildNodes(n, vChilds);
+		for (size_t c : vChilds) {
+			graph.getEdge(n, c, pot);
+			energy -= log(MAX(FLT_MIN, pot.at<float>(vLabels[n], vLabels[c])));
+		}
+	}
+	const double tolerance = 1e-9 * fabs(energy);
+	ASSERT_NEAR(energy, graph.computeEnergy(vLabels), tolerance);
+	ASSERT_NEAR(energy, graph.IGraphPairwise::computeEnergy(vLabels), tolerance);
+	ASSERT_NEAR(energy, graphCSR.computeEnergy(vLabels), tolerance);
+	ASSERT_NEAR(energy, graphGrid.computeEnergy(vLabels), tolerance);
+
+	// Without the edge models, the energy of the dense graph contains only the node terms
+	CGraphDense		graphDense(nStates);
+	CGraphDenseExt	graphExtDense(graphDense);
+	graphExtDense.setGraph(pots);
+	energy = 0;
+	for (size_t n = 0; n < graphDense.getNumNodes(); n++) {
+		graphDense.getNode(n, pot);
+		energy -= log(MAX(FLT_MIN, pot.at<float>(vLabels[n], 0)));
+	}
+	ASSERT_NEAR(energy, graphDense.computeEnergy(vLabels), tolerance);
+
+	// The pairwise term: every pair of the nodes with the same label contributes -weight / 2, the self-interaction of every node included
+	const float weight = 0.01f;
+	graphDense.addEdgeModel(std::make_shared<CEdgeModelUniform>(weight));
+	vec_size_t vCounts(nStates, 0);
+	for (byte label : vLabels) vCounts[label]++;
+	for (size_t count : vCounts) energy -= 0.5 * weight * count * count;
+	ASSERT_NEAR(energy, graphDense.computeEnergy(vLabels), 1e-5 * fabs(energy));
+}
+
+TEST_F(CTestGraph, CG_potential_views)
+{
+	const byte	nStates		= static_cast<byte>(random::u(2, 10));
+	const Size	graphSize	= Size(random::u<int>(5, 20), random::u<int>(5, 20));
+	const Mat	pots		= random::U(graphSize, CV_32FC(nStates), 0.1, 1.0);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseCSR	graphCSR(nStates);
+	CGraphGrid			graphGrid(nStates);
+	CGraphWeiss			graphWeiss(nStates);
+	for (IGraphPairwise *pGraph : std::initializer_list<IGraphPairwise *>{ &graph, &graphCSR, &graphGrid, &graphWeiss }) {
+		CGraphPairwiseExt graphExt(*pGraph, GRAPH_EDGES_GRID);
+		graphExt.setGraph(pots);
+		graphExt.addDefaultEdgesModel(0.5f);									// all the edges share one potential
+
+		// The views address the same values, as returned by the copying getters
+		Mat		pot;
+		vec_size_t vChilds;
+		for (size_t n = 0; n < pGraph->getNumNodes(); n++) {
+			pGraph->getNode(n, pot);
+			const span<const float> nodeView = pGraph->getNodeView(n);
+			ASSERT_EQ(static_cast<size_t>(nStates), nodeView.size());
+			for (byte s = 0; s < nStates; s++) ASSERT_EQ(pot.at<float>(s, 0), nodeView[s]);
+			pGraph->getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				pGraph->getEdge(n, c, pot);
+				const span<const float> edgeView = pGraph->getEdgeView(n, c);
+				ASSERT_EQ(static_cast<size_t>(nStates * nStates), edgeView.size());
+				for (byte x = 0; x < nStates; x++)
+					for (byte y = 0; y < nStates; y++) ASSERT_EQ(pot.at<float>(x, y), edgeView[x * nStates + y]);
+			}
+		}
+
+		// The changes through the mutable node view are seen by the graph and mark the node as changed
+		pGraph->setDirtyTracking(true);
+		span<float> nodeView = pGraph->getMutableNodeView(1);
+		nodeView[0] = 2.0f;
+		pGraph->getNode(1, pot);
+		ASSERT_EQ(2.0f, pot.at<float>(0, 0));
+		ASSERT_EQ(vec_size_t({ 1 }), pGraph->getDirtyNodes());
+		pGraph->setDirtyTracking(false);
+
+		// The mutable edge view detaches the edge from the shared potential and marks both nodes of the edge as changed
+		Mat potShared;
+		pGraph->getEdge(1, 2, potShared);
+		pGraph->setDirtyTracking(true);
+		span<float> edgeView = pGraph->getMutableEdgeView(0, 1);
+		ASSERT_EQ(static_cast<size_t>(nStates * nStates), edgeView.size());
+		edgeView[1] = 3.0f;
+		pGraph->getEdge(0, 1, pot);
+		ASSERT_EQ(3.0f, pot.at<float>(0, 1));
+		pGraph->getEdge(1, 2, pot);
+		ASSERT_EQ(0, norm(potShared, pot, NORM_INF));
+		ASSERT_EQ(vec_size_t({ 0, 1 }), pGraph->getDirtyNodes());
+
+		// So does the change of the edge potential
+		pGraph->clearDirtyNodes();
+		pGraph->setEdge(2, 1, pot);
+		ASSERT_EQ(vec_size_t({ 2, 1 }), pGraph->getDirtyNodes());
+		pGraph->setDirtyTracking(false);
+	}
+
+	// The compact Potts potential has no view, but is expanded by the mutable one
+	graphCSR.setEdgePotts(0, 1, 2.0f, 0.5f);
+	ASSERT_TRUE(graphCSR.getEdgeView(0, 1).empty());
+	span<float> edgeView = graphCSR.getMutableEdgeView(0, 1);
+	ASSERT_EQ(2.0f, edgeView[0]);
+	ASSERT_EQ(0.5f, edgeView[1]);
+	ASSERT_EQ(static_cast<size_t>(nStates * nStates), graphCSR.getEdgeView(0, 1).size());
+
+	CGraphDense		graphDense(nStates);
+	CGraphDenseExt	graphExtDense(graphDense);
+	graphExtDense.setGraph(pots);
+	Mat pot;
+	graphDense.getNode(3, pot);
+	const span<const float> nodeView = graphDense.getNodeView(3);
+	for (byte s = 0; s < nStates; s++) ASSERT_EQ(pot.at<float>(s, 0), nodeView[s]);
+}
+
+TEST_F(CTestGraph, CG_reorder)
+{
+	const byte	nStates		= 4;
+	const Size	graphSize	= Size(random::u<int>(20, 60), random::u<int>(20, 60));
+	const int	nNodes		= graphSize.area();
+
+	// The grid graph, which nodes are inserted in the random order
+	std::vector<int> vPerm(nNodes);
+	for (int n = 0; n < nNodes; n++) vPerm[n] = n;
+	for (int n = nNodes - 1; n > 0; n--) std::swap(vPerm[n], vPerm[random::u<int>(0, n)]);
+
+	CGraphPairwise graph(nStates);
+	graph.addNodes(random::U(Size(nStates, nNodes), CV_32FC1, 0.1, 1.0));
+	Mat coordinates(nNodes, 2, CV_32FC1);
+	for (int y = 0; y < graphSize.height; y++)
+		for (int x = 0; x < graphSize.width; x++) {
+			const int n = vPerm[y * graphSize.width + x];
+			coordinates.at<float>(n, 0) = static_cast<float>(x);
+			coordinates.at<float>(n, 1) = static_cast<float>(y);
+			if (x > 0) graph.addArc(n, vPerm[y * graphSize.width + x - 1], random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+			if (y > 0) graph.addEdge(n, vPerm[(y - 1) * graphSize.width + x], random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+		}
+	vec_size_t vChilds;
+	graph.getChildNodes(0, vChilds);
+	graph.setEdgeGroup(0, vChilds[0], 1);
+	graph.setEdges(1, random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+
+	vec_byte_t vLabels(nNodes);
+	for (byte &label : vLabels) label = random::u<byte>(0, nStates - 1);
+
+	for (ReorderMethod method : { ReorderMethod::RCM, ReorderMethod::hilbert }) {
+		CGraphReorder reorder(graph, method, coordinates);
+		for (int n = 0; n < nNodes; n++) ASSERT_EQ(static_cast<size_t>(n), reorder.getCallerId(reorder.getNewId(n)));
+
+		const ReorderStats &stats = reorder.getStats();
+		ASSERT_LT(stats.meanSpanAfter, stats.meanSpanBefore);
+		ASSERT_LT(stats.nFarAfter, stats.nFarBefore);
+		if (method == ReorderMethod::RCM) ASSERT_LE(stats.bandwidthAfter, static_cast<size_t>(2 * MAX(graphSize.width, graphSize.height)));
+		else ASSERT_LT(stats.bandwidthAfter, static_cast<size_t>(nNodes));
+
+		CGraphPairwise graphReordered(nStates);
+		reorder.apply(graph, graphReordered);
+		ASSERT_EQ(graph.getNumNodes(), graphReordered.getNumNodes());
+		ASSERT_EQ(graph.getNumEdges(), graphReordered.getNumEdges());
+
+		// The potentials and the energy of a configuration are preserved
+		vec_byte_t vLabelsReordered(nNodes);
+		for (int n = 0; n < nNodes; n++) vLabelsReordered[n] = vLabels[reorder.getCallerId(n)];
+		ASSERT_EQ(vLabels, reorder.toCallerOrder(vLabelsReordered));
+		const double energy = graph.computeEnergy(vLabels);
+		ASSERT_NEAR(energy, graphReordered.computeEnergy(vLabelsReordered), 1e-9 * fabs(energy));
+
+		Mat pot, potReordered;
+		for (size_t n : { size_t(0), size_t(1), static_cast<size_t>(nNodes - 1) }) {
+			graph.getNode(n, pot);
+			graphReordered.getNode(reorder.getNewId(n), potReordered);
+			ASSERT_EQ(0, norm(pot, potReordered, NORM_INF));
+			graph.getChildNodes(n, vChilds);
+			for (size_t c : vChilds) {
+				graph.getEdge(n, c, pot);
+				graphReordered.getEdge(reorder.getNewId(n), reorder.getNewId(c), potReordered);
+				ASSERT_EQ(0, norm(pot, potReordered, NORM_INF));
+				ASSERT_EQ(graph.getEdgeGroup(n, c), graphReordered.getEdgeGroup(reorder.getNewId(n), reorder.getNewId(c)));
+			}
+		}
+	}
+}
+
+TEST_F(CTestGraph, CG_memory_usage)
+{
+	const byte	nStates		= 4;
+	const Size	graphSize	= Size(random::u<int>(50, 100), random::u<int>(50, 100));
+	const Mat	pots		= random::U(graphSize, CV_32FC(nStates));
+
+	for (GraphType graphType : { GraphType::pairwise, GraphType::csr, GraphType::grid })
+		for (INFER infer : { INFER::LBP, INFER::TRW, INFER::GraphCut }) {
+			CGraphPairwiseKit graphKit(nStates, infer, graphType);
+			const size_t emptyUsage = graphKit.getGraph().getMemoryUsage();
+			graphKit.getGraphExt().setGraph(pots);
+			graphKit.getGraphExt().addDefaultEdgesModel(100.0f);
+			const size_t graphUsage = graphKit.getGraph().getMemoryUsage();
+			ASSERT_GT(graphUsage, emptyUsage);
+
+			graphKit.getInfer().decode(10);
+			const size_t usage		= graphUsage + graphKit.getInfer().getMemoryUsage();
+			const size_t estimate	= CGraphPairwiseKit::estimateMemory(graphSize, nStates, infer, graphType);
+			ASSERT_GT(usage, graphUsage);
+			const double ratio		= static_cast<double>(estimate) / usage;
+			ASSERT_GT(ratio, 0.5);				// the capacities of the vectors may exceed their sizes at most twice
+			ASSERT_LT(ratio, 2.0);
+		}
+}
+
+TEST_F(CTestGraph, CG_pairwise_layered_fill_edges)
+{
+	const byte	nStates		= 4;
+	const word	nFeatures	= 3;
+	const Size	graphSize(random::u<int>(10, 30), random::u<int>(10, 30));
+	Mat featureVectors(graphSize, CV_8UC(nFeatures));
+	randu(featureVectors, 0, 255);
+	vec_mat_t vFeatureVectors;
+	split(featureVectors, vFeatureVectors);
+
+	CGraphPairwise graph1(nStates), graph2(nStates);
+	CGraphLayeredExt graphExt1(graph1, 1, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	CGraphLayeredExt graphExt2(graph2, 1, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	graphExt1.buildGraph(graphSize);
+	graphExt2.buildGraph(graphSize);
+
+	const CTrainEdgePottsCS edgeTrainer(nStates, nFeatures);
+	const vec_float_t vParams = { 100.0f, 0.01f };
+	graphExt1.fillEdges(edgeTrainer, NULL, featureVectors, vParams, 0.5f);
+	graphExt2.fillEdges(edgeTrainer, NULL, vFeatureVectors, vParams, 0.5f);
+
+	// The block edge potentials are equal to the ones, calculated edge by edge
+	Mat fv1(nFeatures, 1, CV_8UC1), fv2(nFeatures, 1, CV_8UC1), pot, pot1, pot2;
+	vec_size_t vChildNodes;
+	for (size_t n = 0; n < graph1.getNumNodes(); n++) {
+		graph1.getChildNodes(n, vChildNodes);
+		for (size_t c : vChildNodes) {
+			for (word f = 0; f < nFeatures; f++) {
+				fv1.at<byte>(f, 0) = featureVectors.ptr<byte>(static_cast<int>(n) / graphSize.width)[(n % graphSize.width) * nFeatures + f];
+				fv2.at<byte>(f, 0) = featureVectors.ptr<byte>(static_cast<int>(c) / graphSize.width)[(c % graphSize.width) * nFeatures + f];
+			}
+			sqrt(edgeTrainer.getEdgePotentials(fv1, fv2, vParams, 0.5f), pot);
+			graph1.getEdge(n, c, pot1);
+			graph2.getEdge(n, c, pot2);
+			for (byte y = 0; y < nStates; y++)
+				for (byte x = 0; x < nStates; x++) {
+					ASSERT_FLOAT_EQ(pot.at<float>(y, x), pot1.at<float>(y, x));
+					ASSERT_EQ(pot1.at<float>(y, x), pot2.at<float>(y, x));
+				}
+		} // c
+	} // n
+}
+
+TEST_F(CTestGraph, CG_pairwise_layered_reuse)
+{
+	const byte	nStates = 3;
+	const word	nLayers = 3;
+	const Size	graphSize(random::u<int>(10, 30), random::u<int>(10, 30));
+	const int	nPixels = graphSize.area();
+
+	CGraphPairwise		graph(nStates);
+	CGraphLayeredExt	graphExt(graph, nLayers, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG | GRAPH_EDGES_LINK);
+	graphExt.buildGraph(graphSize);
+	const size_t nArcs = (graphSize.width - 1) * graphSize.height + graphSize.width * (graphSize.height - 1) + 2 * (graphSize.width - 1) * (graphSize.height - 1);
+	ASSERT_EQ(nPixels * nLayers, graph.getNumNodes());
+	ASSERT_EQ(nPixels * nLayers + 2 * nLayers * nArcs, graph.getNumEdges());
+	ASSERT_EQ(1, graph.getEdgeGroup(0, 1));
+	ASSERT_EQ(1, graph.getEdgeGroup(1, 2));
+	ASSERT_FALSE(graph.isEdgeExists(2, 1));
+	ASSERT_EQ(0, graph.getEdgeGroup(nLayers, 0));
+	ASSERT_TRUE(graph.isArcExists(nLayers * (graphSize.width + 1), 0));
+	ASSERT_TRUE(graph.isArcExists(nLayers * graphSize.width, nLayers));
+
+	// The same shape is reused, and the potentials are reset
+	graphExt.setGraph(random::U(graphSize, CV_32FC(2)), random::U(graphSize, CV_32FC(1)));
+	graphExt.addDefaultEdgesModel(100.0f);
+	graphExt.buildGraph(graphSize);
+	ASSERT_EQ(nPixels * nLayers, graph.getNumNodes());
+	Mat pot;
+	graph.getNode(0, pot);
+	for (byte s = 0; s < nStates; s++) ASSERT_FLOAT_EQ(1.0f / nStates, pot.at<float>(s, 0));
+	graph.getEdge(nLayers, 0, pot);
+	ASSERT_EQ(0, countNonZero(pot != 1.0f));
+}
+
+TEST_F(CTestGraph, CG_pairwise_in_place)
+{
+	const byte	nStates		= 4;
+	const Size	graphSize(20, 15);
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph);
+	graphExt.setGraph(random::U(graphSize, CV_32FC(nStates)));
+	graphExt.addDefaultEdgesModel(random::U(graphSize, CV_8UC3), 100.0f);
+
+	// The potentials of the next same-sized image overwrite the previous ones
+	Mat pot1, pot2;
+	graph.getNode(0, pot1);
+	const Mat pots = random::U(graphSize, CV_32FC(nStates));
+	graphExt.setGraph(pots);
+	graph.getNode(0, pot2);
+	for (byte s = 0; s < nStates; s++) ASSERT_EQ(pots.at<float>(0, s), pot2.at<float>(s, 0));
+
+	std::unique_ptr<CGraph> pClone = graph.clone();
+	IGraphPairwise &clone = dynamic_cast<IGraphPairwise &>(*pClone);
+	clone.getEdge(1, 0, pot1);
+	const Mat pot = CTrainEdge::getDefaultEdgePotentials(3.0f, nStates);
+	graph.setEdge(1, 0, pot);
+	graph.setEdge(1, 0, 2 * pot);												// in place
+	graph.getEdge(1, 0, pot2);
+	ASSERT_EQ(0, countNonZero(pot2 != 2 * pot));
+	clone.getEdge(1, 0, pot2);													// the clone is not affected
+	ASSERT_EQ(0, countNonZero(pot2 != pot1));
+}
+
+TEST_F(CTestGraph, CG_superpixel)
+{
+	const byte	nStates		= 3;
+	const int	regionSize	= 10;
+	const Size	gridSize(4, 3);											// the regions are the blocks of the grid
+	const Size	graphSize(gridSize.width * regionSize, gridSize.height * regionSize);
+	Mat labels(graphSize, CV_32SC1);
+	for (int y = 0; y < graphSize.height; y++)
+		for (int x = 0; x < graphSize.width; x++)
+			labels.at<int>(y, x) = (y / regionSize) * gridSize.width + x / regionSize;
+	const Mat pots		= random::U(graphSize, CV_32FC(nStates));
+	const Mat features	= random::U(graphSize, CV_8UC3);
+
+	CGraphPairwiseCSR	graph(nStates);
+	CGraphSuperpixelExt	graphExt(graph);
+	graphExt.buildGraph(labels);
+	const size_t nRegions	= gridSize.area();
+	const size_t nArcs		= (gridSize.width - 1) * gridSize.height + gridSize.width * (gridSize.height - 1);
+	ASSERT_EQ(nRegions, graphExt.getNumRegions());
+	ASSERT_EQ(nRegions, graph.getNumNodes());
+	ASSERT_EQ(2 * nArcs, graph.getNumEdges());
+	ASSERT_EQ(nArcs, graphExt.getArcs().rows);
+	for (size_t r = 0; r < nRegions; r++) ASSERT_EQ(regionSize * regionSize, graphExt.getRegionSizes()[r]);
+	for (int a = 0; a < graphExt.getArcs().rows; a++) {
+		const int src = graphExt.getArcs().at<int>(a, 0);
+		const int dst = graphExt.getArcs().at<int>(a, 1);
+		ASSERT_TRUE(dst == src + 1 || dst == src + gridSize.width);
+		ASSERT_EQ(regionSize, graphExt.getBoundaryLengths()[a]);
+		ASSERT_TRUE(graph.isArcExists(src, dst));
+	}
+
+	// The node potentials are the means of the pixel-wise potentials
+	graphExt.setGraph(pots);
+	Mat pot;
+	for (size_t r = 0; r < nRegions; r++) {
+		const Rect roi((r % gridSize.width) * regionSize, (r / gridSize.width) * regionSize, regionSize, regionSize);
+		const Scalar mean = cv::mean(pots(roi));
+		graph.getNode(r, pot);
+		for (byte s = 0; s < nStates; s++) ASSERT_NEAR(mean[s], pot.at<float>(s, 0), 1e-3);
+	}
+
+	// All the boundaries have the mean length, thus the edge potentials are the ones of the pixel graphs
+	graphExt.addDefaultEdgesModel(100.0f);
+	graph.getEdge(0, 1, pot);
+	ASSERT_FLOAT_EQ(10.0f, pot.at<float>(0, 0));
+	ASSERT_FLOAT_EQ(1.0f, pot.at<float>(0, 1));
+	graphExt.addDefaultEdgesModel(features, 100.0f);
+	graph.getEdge(1, 0, pot);
+	ASSERT_GE(pot.at<float>(0, 0), 1.0f);
+
+	const Mat regionFeatures = graphExt.getRegionFeatures(features);
+	ASSERT_EQ(static_cast<int>(nRegions), regionFeatures.cols);
+	ASSERT_EQ(features.type(), regionFeatures.type());
+
+	vec_byte_t vSolution(nRegions);
+	for (size_t r = 0; r < nRegions; r++) vSolution[r] = static_cast<byte>(r % nStates);
+	const Mat solution = graphExt.getPixelSolution(vSolution);
+	for (int y = 0; y < graphSize.height; y++)
+		for (int x = 0; x < graphSize.width; x++)
+			ASSERT_EQ(vSolution[labels.at<int>(y, x)], solution.at<byte>(y, x));
+}
+
+TEST_F(CTestGraph, CG_superpixel_masked)
+{
+	const byte	nStates = 3;
+	const Size	graphSize(random::u<int>(10, 50), random::u<int>(10, 50));
+	Mat mask	= random::U(graphSize, CV_8UC1, 0, 2);
+	mask.row(0).setTo(0);													// a fully masked row
+	const Mat pots = random::U(graphSize, CV_32FC(nStates));
+
+	CGraphPairwiseCSR	graph(nStates);
+	CGraphSuperpixelExt	graphExt(graph);
+	const Mat labels = CGraphSuperpixelExt::getPixelLabels(mask);
+	graphExt.buildGraph(labels);
+
+	// Only the valid pixels and the edges between them are in the graph
+	size_t nArcs = 0;
+	for (int y = 0; y < graphSize.height; y++)
+		for (int x = 0; x < graphSize.width; x++) {
+			if (!mask.at<byte>(y, x)) {
+				ASSERT_EQ(-1, labels.at<int>(y, x));
+				continue;
+			}
+			if (x + 1 < graphSize.width && mask.at<byte>(y, x + 1))	nArcs++;
+			if (y + 1 < graphSize.height && mask.at<byte>(y + 1, x))	nArcs++;
+		}
+	ASSERT_EQ(static_cast<size_t>(countNonZero(mask)), graph.getNumNodes());
+	ASSERT_EQ(2 * nArcs, graph.getNumEdges());
+
+	// The node potentials are the ones of the valid pixels, and the masked pixels keep the given value in the solution
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(100.0f);
+	Mat pot;
+	vec_byte_t vSolution(graph.getNumNodes());
+	for (int y = 0; y < graphSize.height; y++)
+		for (int x = 0; x < graphSize.width; x++) {
+			const int n = labels.at<int>(y, x);
+			if (n < 0) continue;
+			graph.getNode(n, pot);
+			for (byte s = 0; s < nStates; s++) ASSERT_FLOAT_EQ(pots.ptr<float>(y)[x * nStates + s], pot.at<float>(s, 0));
+			vSolution[n] = static_cast<byte>(n % nStates);
+		}
+	const Mat solution = graphExt.getPixelSolution(vSolution, 255);
+	for (int y = 0; y < graphSize.height; y++)
+		for (int x = 0; x < graphSize.width; x++)
+			ASSERT_EQ(mask.at<byte>(y, x) ? vSolution[labels.at<int>(y, x)] : 255, solution.at<byte>(y, x));
+}
+
+TEST_F(CTestGraph, CG_superpixel_masked_large)
+{
+	// Every valid pixel of an HD mask is a region: the memory of the per-band accumulation must not grow with the number of regions
+	const byte	nStates = 2;
+	const Size	graphSize(1280, 720);
+	Mat mask(graphSize, CV_8UC1, Scalar(1));
+	mask(Rect(graphSize.width / 4, graphSize.height / 4, graphSize.width / 2, graphSize.height / 2)).setTo(0);
+	const Mat pots		= random::U(graphSize, CV_32FC(nStates));
+	const Mat features	= random::U(graphSize, CV_8UC3);
+
+	CGraphPairwiseCSR	graph(nStates);
+	CGraphSuperpixelExt	graphExt(graph);
+	const Mat labels = CGraphSuperpixelExt::getPixelLabels(mask);
+	graphExt.buildGraph(labels);
+	const size_t nRegions = static_cast<size_t>(countNonZero(mask));
+	ASSERT_EQ(nRegions, graphExt.getNumRegions());
+	ASSERT_EQ(nRegions, graph.getNumNodes());
+	for (size_t size : graphExt.getRegionSizes()) ASSERT_EQ(1, size);
+
+	graphExt.setGraph(pots);
+	const Mat regionFeatures = graphExt.getRegionFeatures(features);
+	ASSERT_EQ(static_cast<int>(nRegions), regionFeatures.cols);
+	Mat pot;
+	for (int i = 0; i < 100; i++) {
+		const int y = random::u<int>(0, graphSize.height - 1);
+		const int x = random::u<int>(0, graphSize.width - 1);
+		const int n = labels.at<int>(y, x);
+		if (n < 0) continue;
+		graph.getNode(n, pot);
+		for (byte s = 0; s < nStates; s++) ASSERT_FLOAT_EQ(pots.ptr<float>(y)[x * nStates + s], pot.at<float>(s, 0));
+		for (int c = 0; c < 3; c++) ASSERT_EQ(features.ptr<byte>(y)[x * 3 + c], regionFeatures.ptr<byte>(0)[n * 3 + c]);
+	}
+}
+
+TEST_F(CTestGraph, CG_volume)
+{
+	const byte	nStates		= 3;
+	const int	depth		= random::u<int>(3, 6);
+	const Size	sliceSize(random::u<int>(3, 8), random::u<int>(3, 8));
+	const Size	stackSize(sliceSize.width, sliceSize.height * depth);
+	const Mat	pots		= random::U(stackSize, CV_32FC(nStates), 0.1, 1.0);
+
+	for (byte connectivity : { VOLUME_EDGES_6, VOLUME_EDGES_10, VOLUME_EDGES_18, VOLUME_EDGES_26 }) {
+		CGraphPairwise	graph(nStates);
+		CGraphGrid		grid(nStates);
+		CGraphVolumeExt	graphExt(graph, depth, connectivity);
+		CGraphVolumeExt	gridExt(grid, depth, connectivity);
+		graphExt.setGraph(pots);
+		gridExt.setGraph(pots);
+		ASSERT_EQ(stackSize, graphExt.getSize());
+		ASSERT_EQ(static_cast<size_t>(stackSize.area()), graph.getNumNodes());
+		ASSERT_EQ(graph.getNumEdges(), grid.getNumEdges());
+
+		// The number of arcs along every direction follows from the size of the volume
+		size_t nEdges = 0;
+		for (const CGraphVolumeExt::Direction &dir : CGraphVolumeExt::getDirections(connectivity))
+			nEdges += 2 * static_cast<size_t>(sliceSize.width - abs(dir.dx)) * (sliceSize.height - abs(dir.dy)) * (depth - abs(dir.dz));
+		ASSERT_EQ(nEdges, graph.getNumEdges());
+
+		// An interior voxel has all its neighbours, and both graphs have the same topology and groups
+		const size_t center = (static_cast<size_t>(depth / 2) * sliceSize.height + sliceSize.height / 2) * sliceSize.width + sliceSize.width / 2;
+		vec_size_t vChildNodes, vGridNodes;
+		graph.getChildNodes(center, vChildNodes);
+		ASSERT_EQ(vChildNodes.size(), static_cast<size_t>(connectivity));
+		for (size_t n = 0; n < graph.getNumNodes(); n++) {
+			graph.getChildNodes(n, vChildNodes);
+			grid.getChildNodes(n, vGridNodes);
+			std::sort(vChildNodes.begin(), vChildNodes.end());
+			std::sort(vGridNodes.begin(), vGridNodes.end());
+			ASSERT_EQ(vChildNodes, vGridNodes);
+			for (size_t c : vChildNodes) {
+				const int dx = static_cast<int>(c % sliceSize.width) - static_cast<int>(n % sliceSize.width);
+				const int dy = static_cast<int>(c / sliceSize.width % sliceSize.height) - static_cast<int>(n / sliceSize.width % sliceSize.height);
+				const int dz = static_cast<int>(c / sliceSize.area()) - static_cast<int>(n / sliceSize.area());
+				ASSERT_EQ(graph.getEdgeGroup(n, c), CGraphVolumeExt::getDirectionGroup(dx, dy, dz));
+				ASSERT_EQ(grid.getEdgeGroup(n, c), graph.getEdgeGroup(n, c));
+			}
+		}
+		vec_size_t vParentNodes;
+		grid.getParentNodes(center, vParentNodes);
+		ASSERT_EQ(vParentNodes.size(), static_cast<size_t>(connectivity));
+
+		// Per-direction edge groups: the temporal edges are set independently
+		graphExt.addDefaultEdgesModel(4.0f);
+		graph.setEdges(CGraphVolumeExt::getDirectionGroup(0, 0, 1), CTrainEdge::getDefaultEdgePotentials(1.0f, nStates));
+		Mat pot;
+		graph.getEdge(center, center + 1, pot);
+		ASSERT_FLOAT_EQ(pot.at<float>(0, 0), 2.0f);
+		graph.getEdge(center, center + sliceSize.area(), pot);
+		ASSERT_FLOAT_EQ(pot.at<float>(0, 0), 1.0f);
+	}
+}
+
 TEST_F(CTestGraph, CG_pairwise_layered) 
 {
 	const byte nStatesBase = static_cast<byte>(random::u(5, 127));
@@ -254,10 +1155,55 @@ TEST_F(CTestGraph, CG_pairwise_layered)
 		}
 	}
 
+	// The graph with flat potential storage gets the same potentials
+	CGraphPairwiseCSR graphCSR(nStates);
+	CGraphLayeredExt graphCSRExt(graphCSR, nLayers, GRAPH_EDGES_GRID | GRAPH_EDGES_LINK);
+	graphCSRExt.setGraph(potBase, potOccl);
+	Mat test_potsCSR;
+	graphCSR.getNodes(0, 0, test_potsCSR);
+	ASSERT_EQ(norm(test_pots, test_potsCSR, NORM_INF), 0);
+
 	// addFeatureVecs(CTrainEdge &edgeTrainer, const Mat &featureVectors, const Mat &gt);
 	// addFeatureVecs(CTrainEdge &edgeTrainer, const vec_mat_t &featureVectors, const Mat &gt);
 	// fillEdges(const CTrainEdge &edgeTrainer, const CTrainLink* linkTrainer, const Mat &featureVectors, const vec_float_t &vParams, float edgeWeight = 1.0f, float linkWeight = 1.0f);
 	// fillEdges(const CTrainEdge &edgeTrainer, const CTrainLink* linkTrainer, const vec_mat_t &featureVectors, const vec_float_t &vParams, float edgeWeight = 1.0f, float linkWeight = 1.0f);
 	// defineEdgeGroup(float A, float B, float C, byte group);
 	// setEdges(std::optional<byte> group, const Mat &pot);
-}
\ No newline at end of file
+}
+
+TEST_F(CTestGraph, CG_label_space)
+{
+	const word	nLabels		= 600;
+	const byte	nCandidates	= 8;
+	const int	nNodes		= 30;
+
+	// The chain with the true labels 300 + n and a wrong peak of the node 10 at the label 50
+	Mat pots(nNodes, nLabels, CV_32FC1);
+	for (int n = 0; n < nNodes; n++)
+		for (int l = 0; l < nLabels; l++) pots.at<float>(n, l) = expf(-abs(l - 300 - n) / 4.0f);
+	pots.at<float>(10, 50) = 2.0f;
+
+	CLabelSpace labelSpace(nLabels, nCandidates);
+	labelSpace.selectCandidates(pots);
+	ASSERT_EQ(static_cast<size_t>(nNodes), labelSpace.getNumNodes());
+	for (int n = 0; n < nNodes; n++)
+		for (byte s = 0; s < nCandidates; s++) {
+			const word label = labelSpace.getLabel(n, s);
+			if (s > 0) ASSERT_LT(labelSpace.getLabel(n, s - 1), label);
+			ASSERT_TRUE(label == 50 || abs(label - 300 - n) <= 4);
+		}
+
+	CGraphPairwise graph(nCandidates);
+	labelSpace.fillGraph(graph);
+	for (int n = 1; n < nNodes; n++) graph.addArc(n - 1, n);
+	labelSpace.fillGraph(graph, [](word a, word b) { return expf(-static_cast<float>(MIN(abs(a - b), 20))); });
+
+	CInferLBP inferer(graph);
+	const std::vector<word> vLabels = labelSpace.getLabels(inferer.decode(10));
+	for (int n = 0; n < nNodes; n++) ASSERT_EQ(300 + n, vLabels[n]);
+
+	Mat labels;
+	labelSpace.getLabels(inferer.decode(10), labels);
+	ASSERT_EQ(CV_16UC1, labels.type());
+	for (int n = 0; n < nNodes; n++) ASSERT_EQ(vLabels[n], labels.at<word>(n, 0));
+}
@@ -90,6 +90,149 @@ TEST_F(CTestInference, inference_LBP)
 	testInferer(inferer);
 }
 
+TEST_F(CTestInference, inference_LBP_csr)
+{
+	CGraphPairwiseCSR graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP inferer(graph);
+	testInferer(inferer);
+}
+
+TEST_F(CTestInference, inference_tree_csr)
+{
+	CGraphPairwiseCSR graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferTree inferer(graph);
+	testInferer(inferer);
+}
+
+TEST_F(CTestInference, inference_LBP3)
+{
+	CGraph3 graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP3 inferer(graph);
+	testInferer(inferer);
+}
+
+TEST_F(CTestInference, inference_LBP3_triplets)
+{
+	const byte	nStates = 3;
+	const int	size[]	= { nStates, nStates, nStates };
+
+	Mat tripletPot(3, size, CV_32FC1);
+	for (byte a = 0; a < nStates; a++)
+		for (byte b = 0; b < nStates; b++)
+			for (byte c = 0; c < nStates; c++)
+				tripletPot.at<float>(a, b, c) = random::U(0.1f, 1.0f);
+
+	// The factor graph without loops: the triplet (0, 1, 2) with the arc (2) - (3) and the edge (3) -> (4)
+	CGraph3 graph(nStates);
+	for (int i = 0; i < 5; i++) graph.addNode(random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0));
+	graph.addTriplet(0, 1, 2, tripletPot);
+	graph.addArc(2, 3, random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+	graph.addEdge(3, 4, 0, random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+
+	// Exact marginals with the exhaustive search
+	Mat nodePot[5], pot23, pot32, pot34;
+	for (int i = 0; i < 5; i++) graph.getNode(i, nodePot[i]);
+	graph.getEdge(2, 3, pot23);
+	graph.getEdge(3, 2, pot32);
+	graph.getEdge(3, 4, pot34);
+	std::vector<double> vMarginals(5 * nStates, 0);
+	double Z = 0;
+	for (int conf = 0; conf < nStates * nStates * nStates * nStates * nStates; conf++) {
+		int x[5];
+		for (int i = 0, c = conf; i < 5; i++, c /= nStates) x[i] = c % nStates;
+		double p = tripletPot.at<float>(x[0], x[1], x[2]) * pot23.at<float>(x[2], x[3]) * pot32.at<float>(x[3], x[2]) * pot34.at<float>(x[3], x[4]);
+		for (int i = 0; i < 5; i++) p *= nodePot[i].at<float>(x[i], 0);
+		for (int i = 0; i < 5; i++) vMarginals[i * nStates + x[i]] += p;
+		Z += p;
+	}
+
+	CInferLBP3 inferer(graph);
+	inferer.infer(10);
+	Mat pot;
+	for (int i = 0; i < 5; i++) {
+		graph.getNode(i, pot);
+		for (byte s = 0; s < nStates; s++) ASSERT_NEAR(pot.at<float>(s, 0), vMarginals[i * nStates + s] / Z, 1e-4);
+	}
+
+	// The loopy graph: the Potts triplets and their full tables lead to the same messages
+	for (bool maxSum : { false, true }) {
+		CGraph3 graphPotts(nStates);
+		CGraph3 graphTable(nStates);
+		for (int i = 0; i < 6; i++) {
+			Mat nodePot = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+			graphPotts.addNode(nodePot);
+			graphTable.addNode(nodePot);
+		}
+		for (int i = 0; i < 4; i++) {
+			graphPotts.addTriplet(i, i + 1, i + 2);
+			graphPotts.setTripletPotts(i, i + 1, i + 2, random::U(1.0f, 3.0f), random::U(0.5f, 1.5f));
+			graphPotts.getTriplet(i, i + 1, i + 2, pot);
+			graphTable.addTriplet(i, i + 1, i + 2, pot);
+		}
+		Mat edgePot = random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0);
+		graphPotts.addArc(0, 5, edgePot);
+		graphTable.addArc(0, 5, edgePot);
+
+		CInferLBP3 infererPotts(graphPotts, maxSum);
+		CInferLBP3 infererTable(graphTable, maxSum);
+		infererPotts.infer(20);
+		infererTable.infer(20);
+		for (byte s = 0; s < nStates; s++) {
+			vec_float_t potsPotts = infererPotts.getPotentials(s);
+			vec_float_t potsTable = infererTable.getPotentials(s);
+			for (size_t i = 0; i < potsPotts.size(); i++) ASSERT_NEAR(potsPotts[i], potsTable[i], 1e-5);
+		}
+	}
+
+	// The trained triplet potential is shared between all the triplets
+	CTrainTriplet trainer(nStates, 1);
+	Mat fv(1, 1, CV_8UC1, Scalar(0));
+	for (int i = 0; i < 100; i++) trainer.addFeatureVecs(fv, static_cast<byte>(random::u(0, nStates - 1)), fv, static_cast<byte>(random::u(0, nStates - 1)), fv, static_cast<byte>(random::u(0, nStates - 1)));
+	Mat trainedPot = trainer.getTripletPotentials(fv, fv, fv);
+	ASSERT_EQ(trainedPot.dims, 3);
+	graph.setTriplets(trainedPot);
+	graph.getTriplet(0, 1, 2, pot);
+	ASSERT_EQ(sum(abs(pot - trainedPot))[0], 0);
+	ASSERT_EQ(graph.getTriplets()[0].Pot.data, graph.getTriplets().back().Pot.data);
+}
+
+TEST_F(CTestInference, inference_LBP_grid)
+{
+	const Size graphSize(random::u<int>(5, 20), random::u<int>(5, 20));
+	Mat pots = random::U(graphSize, CV_32FC(m_nStates));
+
+	CGraphPairwise		graph(m_nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(2.0f);
+
+	CGraphGrid			graphGrid(m_nStates);
+	CGraphPairwiseExt	graphGridExt(graphGrid, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	graphGridExt.setGraph(pots);
+	graphGridExt.addDefaultEdgesModel(2.0f);
+	ASSERT_EQ(graph.getNumEdges(), graphGrid.getNumEdges());
+
+	CInferLBP inferer(graph);
+	CInferLBP infererGrid(graphGrid);
+	inferer.infer(10);
+	infererGrid.infer(10);
+	
+	vec_float_t pot		= inferer.getPotentials(0);
+	vec_float_t potGrid = infererGrid.getPotentials(0);
+	ASSERT_EQ(pot.size(), potGrid.size());
+	for (size_t i = 0; i < pot.size(); i++)
+		ASSERT_LT(fabs(pot[i] - potGrid[i]), 1e-5);
+}
+
 TEST_F(CTestInference, inference_exact_weiss)
 {
 	CGraphWeiss graph(m_nStates);
@@ -99,3 +242,1975 @@ TEST_F(CTestInference, inference_exact_weiss)
 	CInferExact inferer(graph);
 	testInferer(inferer);
 }
+
+TEST_F(CTestInference, simd_isa)
+{
+	const simd::ISA isa = simd::getISA();
+	ASSERT_EQ(isa, simd::getISA());
+	for (simd::ISA i : { simd::ISA::scalar, simd::ISA::neon, simd::ISA::sse42, simd::ISA::avx2, simd::ISA::avx512 })
+		ASSERT_EQ(i == isa, strcmp(simd::getISAName(i), simd::getISAName(isa)) == 0);
+#if !defined(ENABLE_SIMD)
+	ASSERT_EQ(simd::ISA::scalar, isa);
+#endif
+}
+
+TEST_F(CTestInference, simd_matTVecMul)
+{
+	for (byte n = 1; n < 40; n++) {
+		Mat M = random::U(Size(n, n), CV_32FC1);
+		Mat v = random::U(Size(1, n), CV_32FC1);
+		vec_float_t dst(n), dstRef(n);
+		for (bool maxSum : { false, true }) {
+			float res	 = simd::matTVecMul(M.ptr<float>(), v.ptr<float>(), dst.data(), n, maxSum);
+			float resRef = simd::impl::matTVecMul_scalar(M.ptr<float>(), v.ptr<float>(), dstRef.data(), n, maxSum);
+			ASSERT_LT(fabs(res - resRef), 1e-3 * resRef);
+			for (byte x = 0; x < n; x++)
+				ASSERT_LT(fabs(dst[x] - dstRef[x]), 1e-4 * (1 + dstRef[x]));
+		}
+	}
+}
+
+TEST_F(CTestInference, simd_axpy)
+{
+	for (int n = 1; n < 40; n++) {
+		Mat x = random::U(Size(n, 1), CV_32FC1);
+		Mat y = random::U(Size(n, 1), CV_32FC1);
+		Mat yRef = y.clone();
+		simd::axpy(0.7f, x.ptr<float>(), y.ptr<float>(), n);
+		simd::impl::axpy_scalar(0.7f, x.ptr<float>(), yRef.ptr<float>(), n);
+		for (int i = 0; i < n; i++)
+			ASSERT_LT(fabs(y.at<float>(0, i) - yRef.at<float>(0, i)), 1e-6);
+	}
+}
+
+TEST_F(CTestInference, simd_absDiff)
+{
+	for (int n = 1; n < 40; n++) {
+		Mat x = random::U(Size(n, 1), CV_32FC1, -1.0, 1.0);
+		Mat y(1, n, CV_32FC1);
+		Mat yRef(1, n, CV_32FC1);
+		simd::absDiff(0.3f, x.ptr<float>(), y.ptr<float>(), n);
+		simd::impl::absDiff_scalar(0.3f, x.ptr<float>(), yRef.ptr<float>(), n);
+		for (int i = 0; i < n; i++)
+			ASSERT_EQ(y.at<float>(0, i), yRef.at<float>(0, i));
+	}
+}
+
+TEST_F(CTestInference, simd_minPlusStep)
+{
+	for (int n = 1; n < 40; n++) {
+		Mat src	 = random::U(Size(n, 1), CV_32FC1, 0.0, 5.0);
+		Mat cost = random::U(Size(n, 1), CV_32FC1, 0.0, 5.0);
+		Mat dst(1, n, CV_32FC1);
+		Mat dstRef(1, n, CV_32FC1);
+		simd::minPlusStep(src.ptr<float>(), cost.ptr<float>(), 0.5f, 2.0f, dst.ptr<float>(), n);
+		simd::impl::minPlusStep_scalar(src.ptr<float>(), cost.ptr<float>(), 0.5f, 2.0f, dstRef.ptr<float>(), n);
+		for (int i = 0; i < n; i++)
+			ASSERT_EQ(dst.at<float>(0, i), dstRef.at<float>(0, i));
+	}
+}
+
+TEST_F(CTestInference, simd_gradientRow)
+{
+	const int	nBins = 9;
+	vec_float_t	vTan(nBins - 1);
+	for (int i = 0; i < nBins - 1; i++) vTan[i] = static_cast<float>(tan((static_cast<double>(i + 1) / nBins - 0.5) * Pi));
+	for (int n = 1; n < 40; n++) {
+		Mat img = random::U(Size(n, 3), CV_8UC1, 0.0, 255.0);
+		vec_float_t mgn(n), mgnRef(n);
+		vec_byte_t	bin(n), binRef(n);
+		simd::gradientRow(img.ptr<byte>(0), img.ptr<byte>(1), img.ptr<byte>(2), vTan.data(), nBins - 1, mgn.data(), bin.data(), n);
+		simd::impl::gradientRow_scalar(img.ptr<byte>(0), img.ptr<byte>(1), img.ptr<byte>(2), vTan.data(), nBins - 1, mgnRef.data(), binRef.data(), n);
+		for (int i = 0; i < n; i++) {
+			ASSERT_EQ(mgn[i], mgnRef[i]);
+			ASSERT_EQ(bin[i], binRef[i]);
+			ASSERT_GT(nBins, bin[i]);
+		}
+
+		// The first and the last pixels have no horizontal derivative
+		ASSERT_FLOAT_EQ(0.5f * fabsf(static_cast<float>(img.at<byte>(2, 0)) - img.at<byte>(0, 0)), mgn[0]);
+		simd::gradientRow(img.ptr<byte>(1), img.ptr<byte>(1), img.ptr<byte>(1), vTan.data(), nBins - 1, mgn.data(), nullptr, n);
+		for (int i = 1; i < n - 1; i++)
+			ASSERT_FLOAT_EQ(0.5f * fabsf(static_cast<float>(img.at<byte>(1, i + 1)) - img.at<byte>(1, i - 1)), mgn[i]);
+	}
+}
+
+TEST_F(CTestInference, simd_matTVecMulBatch)
+{
+	for (byte k : { 1, 2, 3, 8 })
+		for (int n = 1; n < 40; n++) {
+			Mat M = random::U(Size(k, k), CV_32FC1, 0.0, 1.0);
+			Mat a = random::U(Size(n + 3, k), CV_32FC1, 0.0, 1.0);
+			a.col(0).setTo(0);														// the zero vector results in the uniform one
+			for (bool maxSum : { false, true }) {
+				Mat dst(k, n + 5, CV_32FC1);
+				Mat dstRef(k, n + 5, CV_32FC1);
+				simd::matTVecMulBatch(M.ptr<float>(), a.ptr<float>(), a.cols, dst.ptr<float>(), dst.cols, k, n, maxSum);
+				simd::impl::matTVecMulBatch_scalar(M.ptr<float>(), a.ptr<float>(), a.cols, dstRef.ptr<float>(), dstRef.cols, k, n, maxSum);
+				for (byte x = 0; x < k; x++) {
+					ASSERT_FLOAT_EQ(1.0f / k, dst.at<float>(x, 0));
+					for (int i = 0; i < n; i++)
+						ASSERT_LT(fabs(dst.at<float>(x, i) - dstRef.at<float>(x, i)), 1e-6);
+				}
+			}
+		}
+}
+
+TEST_F(CTestInference, simd_argMax)
+{
+	for (int n = 1; n < 256; n++) {
+		Mat x = random::U(Size(n, 1), CV_32FC1, -1.0, 1.0);
+		ASSERT_EQ(simd::impl::argMax_scalar(x.ptr<float>(), static_cast<byte>(n)), simd::argMax(x.ptr<float>(), static_cast<byte>(n)));
+		x.setTo(0.5f);																// all the elements are equal
+		ASSERT_EQ(0, simd::argMax(x.ptr<float>(), static_cast<byte>(n)));
+	}
+}
+
+TEST_F(CTestInference, kernels_fixed_states)
+{
+	for (byte n : { 2, 4, 6, 8, 16 }) {
+		Mat M = random::U(Size(n, n), CV_32FC1);
+		Mat v = random::U(Size(1, n), CV_32FC1, 0.1, 1.0);
+		vec_float_t dst(n), dstRef(n);
+		kernels::dispatch(n, [&](auto N) {
+			constexpr int K = decltype(N)::value;
+			ASSERT_EQ(n, K);
+			for (bool maxSum : { false, true }) {
+				float res	 = kernels::matTVecMul<K>(M.ptr<float>(), v.ptr<float>(), dst.data(), n, maxSum);
+				float resRef = simd::impl::matTVecMul_scalar(M.ptr<float>(), v.ptr<float>(), dstRef.data(), n, maxSum);
+				ASSERT_LT(fabs(res - resRef), 1e-5 * resRef);
+				for (byte x = 0; x < n; x++) ASSERT_FLOAT_EQ(dstRef[x], dst[x]);
+			}
+			kernels::matVecMax<K>(M.ptr<float>(), v.ptr<float>(), dst.data(), n);
+			kernels::matVecMax<0>(M.ptr<float>(), v.ptr<float>(), dstRef.data(), n);
+			for (byte x = 0; x < n; x++) ASSERT_EQ(dstRef[x], dst[x]);
+			ASSERT_EQ(simd::impl::argMax_scalar(v.ptr<float>(), n), kernels::argMax<K>(v.ptr<float>(), n));
+			kernels::normalizeMax<K>(dst.data(), n);
+			ASSERT_FLOAT_EQ(1.0f, kernels::max<K>(dst.data(), n));
+		});
+	}
+	kernels::dispatch(7, [](auto N) { ASSERT_EQ(0, decltype(N)::value); });
+}
+
+TEST_F(CTestInference, decode_labels)
+{
+	const byte	nStates = 7;
+	const Size	imgSize(100, 50);
+	const int	nNodes	= imgSize.area();
+
+	CGraphPairwiseCSR graph(nStates);
+	graph.addNodes(random::U(Size(nStates, nNodes), CV_32FC1, 0.0, 1.0));
+	
+	Mat lossMatrix = CDecode::getDefaultLossMatrix(nStates);
+	lossMatrix.at<float>(0, 3) = 5.0f;
+	lossMatrix.at<float>(2, 1) = 0.2f;
+
+	for (bool ifLossMat : { false, true }) {
+		Mat &L = ifLossMat ? lossMatrix : EmptyMat;
+
+		// Reference
+		vec_byte_t vRef(nNodes);
+		Mat pot;
+		for (int n = 0; n < nNodes; n++) {
+			graph.getNode(n, pot);
+			if (ifLossMat) gemm(L, pot, 1.0, Mat(), 0.0, pot);
+			Point extremumLoc;
+			if (ifLossMat) minMaxLoc(pot, NULL, NULL, &extremumLoc, NULL);
+			else minMaxLoc(pot, NULL, NULL, NULL, &extremumLoc);
+			vRef[n] = static_cast<byte>(extremumLoc.y);
+		}
+
+		Mat labels(imgSize, CV_8UC1);
+		const byte *pData = labels.data;
+		CDecode::decodeLabels(graph, labels, L);
+		ASSERT_EQ(pData, labels.data);												// filled in place
+		ASSERT_EQ(imgSize, labels.size());
+		for (int n = 0; n < nNodes; n++)
+			ASSERT_EQ(vRef[n], labels.at<byte>(n / imgSize.width, n % imgSize.width));
+
+		ASSERT_EQ(vRef, CDecode::decode(graph, L));
+	}
+}
+
+TEST_F(CTestInference, inference_junction_tree)
+{
+	const byte	nStates = 3;
+	const Size	size(3, 3);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	graphExt.setGraph(random::U(size, CV_32FC(nStates), 0.1, 1.0));
+	vec_size_t vChilds;
+	for (size_t n = 0; n < graph.getNumNodes(); n++) {								// asymmetric edge potentials
+		graph.getChildNodes(n, vChilds);
+		for (size_t c : vChilds) graph.setEdge(n, c, random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+	}
+
+	// The exact marginals and the most probable configuration of the enumeration
+	CInferExact exactInferer(graph);
+	exactInferer.setKeepPotentials(true);
+	exactInferer.infer();
+	const Mat	marginals	= exactInferer.getMarginals().clone();
+	vec_byte_t	decoding	= CDecodeExact(graph).decode();
+
+	CInferJunctionTree inferer(graph);
+	ASSERT_EQ(inferer.decodeMAP(), decoding);
+	ASSERT_EQ(inferer.getTreewidth(), 3);
+	inferer.setKeepPotentials(true);
+	inferer.infer();
+	ASSERT_LT(norm(inferer.getMarginals(), marginals, NORM_INF), 1e-5);
+
+	// A ladder of 60 nodes has the treewidth 2
+	CGraphPairwise		ladder(nStates);
+	CGraphPairwiseExt	ladderExt(ladder, GRAPH_EDGES_GRID);
+	ladderExt.setGraph(random::U(Size(30, 2), CV_32FC(nStates), 0.1, 1.0));
+	ladderExt.addDefaultEdgesModel(1.5f);
+	CInferJunctionTree ladderInferer(ladder);
+	ladderInferer.infer();
+	ASSERT_EQ(ladderInferer.getTreewidth(), 2);
+	Mat ladderMarginals;
+	ladder.getNodes(0, 0, ladderMarginals);
+	for (int n = 0; n < ladderMarginals.rows; n++) ASSERT_NEAR(sum(ladderMarginals.row(n))[0], 1.0, 1e-5);
+}
+
+TEST_F(CTestInference, decode_exact_loss_matrix)
+{
+	const byte		nStates = 3;
+	const Size		size(4, 3);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	graphExt.setGraph(random::U(size, CV_32FC(nStates), 0.1, 1.0));
+	graphExt.addDefaultEdgesModel(1.5f);
+
+	Mat lossMatrix = CDecode::getDefaultLossMatrix(nStates);
+	lossMatrix.at<float>(0, 1) = 4.0f;
+	lossMatrix.at<float>(2, 0) = 0.3f;
+
+	// The exact decoding with the loss matrix minimizes the risk, based on the exact marginals
+	Mat				defaultLoss		= CDecode::getDefaultLossMatrix(nStates);
+	CDecodeExact	exactDecoder(graph);
+	vec_byte_t		decodingRisk	= exactDecoder.decode(lossMatrix);
+	vec_byte_t		decodingMPM		= exactDecoder.decode(defaultLoss);
+	ASSERT_EQ(decodingRisk.size(), graph.getNumNodes());
+
+	CInferExact exactInferer(graph);
+	exactInferer.infer();
+	Mat labels;
+	CDecode::decodeLabels(exactInferer.getMarginals(), labels, lossMatrix);
+	for (size_t n = 0; n < graph.getNumNodes(); n++) ASSERT_EQ(labels.at<byte>(static_cast<int>(n), 0), decodingRisk[n]);
+	ASSERT_EQ(decodingRisk, exactInferer.decode(0, lossMatrix));
+	ASSERT_EQ(decodingMPM, exactInferer.decode(0));								// the default loss matrix gives the maximal marginals
+}
+
+TEST_F(CTestInference, inference_results)
+{
+	const byte	nStates = 5;
+	const Size	imgSize(40, 30);
+
+	Mat pots = random::U(imgSize, CV_32FC(nStates), 0.0, 1.0);
+
+	CGraphPairwise graph(nStates);
+	CGraphPairwiseExt graphExt(graph);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(2.0f);
+
+	CInferLBP inferer(graph);
+	inferer.infer(10);
+	const vec_byte_t	vLabels		= inferer.decode();
+	const vec_float_t	vConfidence	= inferer.getConfidence();
+	Mat					nodePots;
+	graph.getNodes(0, 0, nodePots);
+
+	Mat labels(imgSize, CV_16UC1);
+	Mat confidence(imgSize, CV_32FC1);
+	Mat marginals(imgSize, CV_32FC(nStates));
+	const byte *pData = labels.data;
+	inferer.getResults(labels, &confidence, &marginals);
+	ASSERT_EQ(pData, labels.data);													// filled in place
+	ASSERT_EQ(CV_16UC1, labels.type());
+	ASSERT_EQ(CV_32FC(nStates), marginals.type());
+	for (int y = 0; y < imgSize.height; y++)
+		for (int x = 0; x < imgSize.width; x++) {
+			const int n = y * imgSize.width + x;
+			ASSERT_EQ(vLabels[n], labels.at<word>(y, x));
+			ASSERT_FLOAT_EQ(vConfidence[n], confidence.at<float>(y, x));
+			for (byte s = 0; s < nStates; s++)
+				ASSERT_EQ(nodePots.at<float>(n, s), marginals.ptr<float>(y, x)[s]);
+		}
+
+	// The results are read from the external output buffer
+	CGraphPairwise graphCopy(nStates);
+	CGraphPairwiseExt graphCopyExt(graphCopy);
+	graphCopyExt.setGraph(pots);
+	graphCopyExt.addDefaultEdgesModel(2.0f);
+	Mat beliefs;
+	CInferLBP infererOut(graphCopy);
+	infererOut.setOutput(&beliefs);
+	infererOut.infer(10);
+	Mat labels8;
+	infererOut.getResults(labels8);
+	ASSERT_EQ(CV_8UC1, labels8.type());
+	ASSERT_EQ(static_cast<int>(graph.getNumNodes()), labels8.rows);
+	for (int n = 0; n < labels8.rows; n++) {
+		ASSERT_EQ(static_cast<byte>(std::max_element(beliefs.ptr<float>(n), beliefs.ptr<float>(n) + nStates) - beliefs.ptr<float>(n)), labels8.at<byte>(n, 0));
+		ASSERT_EQ(vLabels[n], labels8.at<byte>(n, 0));
+	}
+
+	// The graphs without the views of the potentials are read with getNodes()
+	class CGraphWithoutViews : public CGraphPairwise {
+	public:
+		using CGraphPairwise::CGraphPairwise;
+		span<const float> getNodeView(size_t node) const override { return CGraph::getNodeView(node); }
+	};
+	CGraphWithoutViews graphWithoutViews(nStates);
+	CGraphPairwiseExt graphWithoutViewsExt(graphWithoutViews);
+	graphWithoutViewsExt.setGraph(pots);
+	CInferLBP infererWithoutViews(graphWithoutViews);
+	const vec_float_t vConfidenceWithoutViews	= infererWithoutViews.getConfidence();
+	const vec_float_t vPotentialsWithoutViews	= infererWithoutViews.getPotentials(nStates - 1);
+	ASSERT_EQ(graph.getNumNodes(), vConfidenceWithoutViews.size());
+	for (size_t n = 0; n < graphWithoutViews.getNumNodes(); n++) {
+		Mat pot;
+		graphWithoutViews.getNode(n, pot);
+		vec_float_t vPot(pot.begin<float>(), pot.end<float>());
+		ASSERT_EQ(vPot[nStates - 1], vPotentialsWithoutViews[n]);
+		std::sort(vPot.rbegin(), vPot.rend());
+		ASSERT_FLOAT_EQ(1.0f - vPot[1] / vPot[0], vConfidenceWithoutViews[n]);
+	}
+}
+
+TEST_F(CTestInference, inference_encoded_results)
+{
+	const byte	nStates = 3;
+	const Size	imgSize(45, 37);												// the rows do not end on the byte boundary
+
+	Mat pots = random::U(imgSize, CV_32FC(nStates), 0.0, 1.0);
+
+	CGraphPairwise graph(nStates);
+	CGraphPairwiseExt graphExt(graph);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(2.0f);
+
+	CInferLBP inferer(graph);
+	inferer.infer(10);
+	const Mat labels = Mat(inferer.decode(), true).reshape(1, imgSize.height);
+
+	PackedLabels	packed;
+	RunLengthLabels	runs;
+	LabelStats		stats;
+	inferer.encodeResults(imgSize, &packed, &runs, &stats);
+	ASSERT_EQ(2, packed.nBits);
+	ASSERT_EQ(Size(12, imgSize.height), packed.data.size());
+	ASSERT_EQ(0, countNonZero(CLabelEncoder::decode(packed) != labels));
+	ASSERT_EQ(0, countNonZero(CLabelEncoder::decode(runs) != labels));
+	ASSERT_LT(runs.vRuns.size(), static_cast<size_t>(imgSize.area()));
+	for (byte s = 0; s < nStates; s++) {
+		const Mat mask = labels == s;
+		ASSERT_EQ(static_cast<size_t>(countNonZero(mask)), stats.vArea[s]);
+		std::vector<Point> vPoints;
+		findNonZero(mask, vPoints);
+		ASSERT_EQ(vPoints.empty() ? Rect() : boundingRect(vPoints), stats.vBoundingBox[s]);
+	}
+
+	// The same encoding from the label map with the explicit number of bits
+	for (byte nBits : { 4, 8 }) {
+		PackedLabels packedMap;
+		packedMap.nBits = nBits;
+		RunLengthLabels runsMap;
+		CLabelEncoder::encode(labels, nStates, &packedMap, &runsMap);
+		ASSERT_EQ(0, countNonZero(CLabelEncoder::decode(packedMap) != labels));
+		ASSERT_EQ(runs.vRowStart, runsMap.vRowStart);
+	}
+}
+
+TEST_F(CTestInference, simd_half)
+{
+	for (int n = 1; n < 40; n++) {
+		Mat x = random::U(Size(n, 1), CV_32FC1) - 0.5;
+		std::vector<word> vHalf(n), vHalfRef(n);
+		vec_float_t		  vRes(n);
+		simd::floatToHalf(x.ptr<float>(), vHalf.data(), n);
+		simd::impl::floatToHalf_scalar(x.ptr<float>(), vHalfRef.data(), n);
+		ASSERT_EQ(vHalf, vHalfRef);
+		simd::halfToFloat(vHalf.data(), vRes.data(), n);
+		for (int i = 0; i < n; i++)
+			ASSERT_LE(fabs(vRes[i] - x.at<float>(0, i)), fabs(x.at<float>(0, i)) / 2048 + 1e-7f);
+	}
+}
+
+TEST_F(CTestInference, simd_matTVecMulHalf)
+{
+	for (byte n = 1; n < 40; n++) {
+		Mat M = random::U(Size(n, n), CV_32FC1);
+		Mat v = random::U(Size(1, n), CV_32FC1);
+		std::vector<word> vHalf(n * n);
+		simd::floatToHalf(M.ptr<float>(), vHalf.data(), n * n);
+		vec_float_t dst(n), dstRef(n);
+		for (bool maxSum : { false, true }) {
+			float res	 = simd::matTVecMulHalf(vHalf.data(), v.ptr<float>(), dst.data(), n, maxSum);
+			float resRef = simd::impl::matTVecMul_scalar(M.ptr<float>(), v.ptr<float>(), dstRef.data(), n, maxSum);
+			ASSERT_LT(fabs(res - resRef), 1e-3 * resRef);
+			for (byte x = 0; x < n; x++)
+				ASSERT_LT(fabs(dst[x] - dstRef[x]), 1e-3 * (1 + dstRef[x]));
+		}
+	}
+}
+
+TEST_F(CTestInference, inference_half_precision)
+{
+	const byte		nStates = 6;
+	const size_t	nNodes	= 30;
+
+	CGraphPairwise graph(nStates);
+	CGraphPairwise graphHalf(nStates);
+	for (size_t n = 0; n < nNodes; n++) {
+		Mat nodePot = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+		graph.addNode(nodePot);
+		graphHalf.addNode(nodePot);
+	}
+	for (size_t n = 1; n < nNodes; n++) {
+		const size_t n2 = random::u<size_t>(0, n - 1);
+		Mat edgePot = random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0);
+		graph.addArc(n, n2, edgePot);
+		graphHalf.addArc(n, n2, edgePot);
+	}
+
+	for (bool logDomain : { false, true }) {
+		CInferLBP inferer(graph);
+		CInferLBP infererHalf(graphHalf);
+		inferer.setLogDomain(logDomain);
+		infererHalf.setLogDomain(logDomain);
+		infererHalf.setHalfPrecision(true);
+		ASSERT_TRUE(infererHalf.isHalfPrecision());
+		inferer.infer(10);
+		infererHalf.infer(10);
+		for (byte s = 0; s < nStates; s++) {
+			vec_float_t pot		= inferer.getPotentials(s);
+			vec_float_t potHalf	= infererHalf.getPotentials(s);
+			ASSERT_EQ(pot.size(), potHalf.size());
+			for (size_t i = 0; i < pot.size(); i++)
+				ASSERT_NEAR(pot[i], potHalf[i], 1e-2);
+		}
+	}
+}
+
+TEST_F(CTestInference, inference_state_pruning)
+{
+	const byte		nStates = 8;
+	const size_t	nNodes	= 40;
+
+	// Every node has 2 or 3 plausible states, the potentials of the other states are zero
+	CGraphPairwise graph(nStates);
+	CGraphPairwise graphPruned(nStates);
+	for (size_t n = 0; n < nNodes; n++) {
+		Mat nodePot(nStates, 1, CV_32FC1, Scalar(0));
+		for (int i = random::u(2, 3); i > 0; i--) nodePot.at<float>(random::u(0, nStates - 1)) = random::U(0.1f, 1.0f);
+		graph.addNode(nodePot);
+		graphPruned.addNode(nodePot);
+	}
+	for (size_t n = 1; n < nNodes; n++) {
+		const size_t n2 = random::u<size_t>(0, n - 1);
+		Mat edgePot = random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0);
+		graph.addArc(n, n2, edgePot);
+		graphPruned.addArc(n, n2, edgePot);
+	}
+
+	for (bool logDomain : { false, true }) {
+		CInferLBP inferer(graph);
+		CInferLBP infererPruned(graphPruned);
+		inferer.setLogDomain(logDomain);
+		infererPruned.setLogDomain(logDomain);
+		infererPruned.setStatePruning(0.01f);
+		ASSERT_EQ(0.01f, infererPruned.getStatePruning());
+		inferer.infer(10);
+		infererPruned.infer(10);
+		for (byte s = 0; s < nStates; s++) {
+			vec_float_t pot			= inferer.getPotentials(s);
+			vec_float_t potPruned	= infererPruned.getPotentials(s);
+			ASSERT_EQ(pot.size(), potPruned.size());
+			for (size_t i = 0; i < pot.size(); i++)
+				ASSERT_NEAR(pot[i], potPruned[i], 1e-4);
+		}
+	}
+}
+
+TEST_F(CTestInference, inference_message_compression)
+{
+	const byte		nStates = 10;
+	const size_t	nNodes	= 30;
+
+	CGraphPairwise graph(nStates);
+	buildGraph(graph, nNodes);
+	std::vector<Mat> vNodePots(nNodes);
+	for (Mat &nodePot : vNodePots) nodePot = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+	graph.setEdges(std::nullopt, random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+
+	auto infer = [&](MessageCompression compression, byte k, bool checkerboard, bool logDomain) {
+		for (size_t n = 0; n < nNodes; n++) graph.setNode(n, vNodePots[n]);
+		CInferLBP inferer(graph);
+		inferer.setCheckerboard(checkerboard);
+		inferer.setLogDomain(logDomain);
+		inferer.setMessageCompression(compression, k);
+		EXPECT_EQ(compression, inferer.getMessageCompression());
+		inferer.infer(10);
+		Mat res(nStates, static_cast<int>(nNodes), CV_32FC1);
+		for (byte s = 0; s < nStates; s++) {
+			vec_float_t pot = inferer.getPotentials(s);
+			for (size_t n = 0; n < nNodes; n++) res.at<float>(s, static_cast<int>(n)) = pot[n];
+		}
+		return res;
+	};
+
+	// In the log domain the floor value of the top-k messages preserves the sum of the exponents, thus the approximation is as good as in the linear domain
+	for (bool logDomain : { false, true })
+		for (bool checkerboard : { false, true }) {
+			Mat res = infer(MessageCompression::none, 8, checkerboard, logDomain);
+			ASSERT_LT(norm(res, infer(MessageCompression::fp16, 8, checkerboard, logDomain), NORM_INF), 1e-3);
+			ASSERT_LT(norm(res, infer(MessageCompression::topK, nStates, checkerboard, logDomain), NORM_INF), 1e-5);	// all the values are kept
+			ASSERT_LT(norm(res, infer(MessageCompression::topK, 5, checkerboard, logDomain), NORM_INF), 0.1);
+		}
+}
+
+TEST_F(CTestInference, inference_edge_models)
+{
+	const byte		nStates = 12;
+	const size_t	nNodes	= 4;
+
+	// Potts, truncated linear and truncated quadratic potentials
+	std::vector<Mat> vEdgePots(3);
+	for (auto &edgePot : vEdgePots) edgePot = Mat(nStates, nStates, CV_32FC1);
+	for (int y = 0; y < nStates; y++)
+		for (int x = 0; x < nStates; x++) {
+			const int d = abs(x - y);
+			vEdgePots[0].at<float>(y, x) = d ? 0.5f : 2.0f;
+			vEdgePots[1].at<float>(y, x) = MAX(2.0f * powf(0.7f, static_cast<float>(d)), 0.3f);
+			vEdgePots[2].at<float>(y, x) = MAX(2.0f * powf(0.8f, static_cast<float>(d * d)), 0.1f);
+		}
+
+	for (const Mat &edgePot : vEdgePots) {
+		CGraphPairwise graph(nStates);
+		buildGraph(graph, nNodes);
+		for (size_t n = 0; n < nNodes; n++) graph.setNode(n, random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0));
+		graph.setEdges(std::nullopt, edgePot);
+
+		// sum-product
+		CInferExact exactInferer(graph);
+		CInferTree	treeInferer(graph);
+		exactInferer.infer();
+		vec_float_t potExact = exactInferer.getPotentials(0);
+		treeInferer.infer();
+		vec_float_t pot = treeInferer.getPotentials(0);
+		ASSERT_EQ(pot.size(), potExact.size());
+		for (size_t i = 0; i < pot.size(); i++)
+			ASSERT_LT(fabs(pot[i] - potExact[i]), 1e-5);
+
+		// max-product
+		for (size_t n = 0; n < nNodes; n++) graph.setNode(n, random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0));
+		CDecodeExact	exactDecoder(graph);
+		CInferViterbi	viterbiInferer(graph);
+		vec_byte_t		decodingExact	= exactDecoder.decode();
+		vec_byte_t		decoding		= viterbiInferer.decode(nNodes);
+		ASSERT_EQ(decodingExact, decoding);
+	}
+}
+
+TEST_F(CTestInference, inference_potts_compact)
+{
+	const byte	nStates = 5;
+	const int	width	= 6;
+	const int	height	= 4;
+
+	// The same contrast-sensitive Potts potentials: the matrices and the compact form
+	CGraphPairwiseCSR graph(nStates);
+	CGraphPairwiseCSR graphCompact(nStates);
+	for (int i = 0; i < width * height; i++) {
+		Mat nodePot = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+		graph.addNode(nodePot);
+		graphCompact.addNode(nodePot);
+	}
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			for (int dir = 0; dir < 2; dir++) {
+				if ((dir == 0 && x + 1 == width) || (dir == 1 && y + 1 == height)) continue;
+				const size_t n1 = y * width + x;
+				const size_t n2 = dir == 0 ? n1 + 1 : n1 + width;
+				const float	 diag = random::U(1.0f, 3.0f);
+				Mat edgePot(nStates, nStates, CV_32FC1, Scalar(1.0f));
+				for (byte s = 0; s < nStates; s++) edgePot.at<float>(s, s) = diag;
+				graph.addArc(n1, n2, edgePot);
+				graphCompact.addArc(n1, n2);
+				graphCompact.setArcPotts(n1, n2, diag, 1.0f);
+			}
+
+	Mat edgePot, edgePotCompact;
+	graph.getEdge(0, 1, edgePot);
+	graphCompact.getEdge(0, 1, edgePotCompact);
+	ASSERT_LT(norm(edgePot, edgePotCompact, NORM_INF), 1e-6);
+
+	// sum-product
+	for (bool logDomain : { false, true }) {
+		CInferLBP inferer(graph);
+		CInferLBP infererCompact(graphCompact);
+		inferer.setLogDomain(logDomain);
+		infererCompact.setLogDomain(logDomain);
+		inferer.infer(10);
+		infererCompact.infer(10);
+		vec_float_t pot			= inferer.getPotentials(0);
+		vec_float_t potCompact	= infererCompact.getPotentials(0);
+		ASSERT_EQ(pot.size(), potCompact.size());
+		for (size_t i = 0; i < pot.size(); i++)
+			ASSERT_LT(fabs(pot[i] - potCompact[i]), 1e-5);
+	}
+
+	// max-product
+	CInferTRW		trwInferer(graph);
+	CInferTRW		trwInfererCompact(graphCompact);
+	trwInferer.setEnergyTracking(true);
+	trwInfererCompact.setEnergyTracking(true);
+	ASSERT_EQ(trwInferer.decode(10), trwInfererCompact.decode(10));
+	ASSERT_EQ(trwInferer.getEnergies().size(), trwInfererCompact.getEnergies().size());
+	for (size_t i = 0; i < trwInferer.getEnergies().size(); i++) {
+		ASSERT_LT(fabs(trwInferer.getEnergies()[i] - trwInfererCompact.getEnergies()[i]), 1e-3f);
+		ASSERT_LT(fabs(trwInferer.getLowerBounds()[i] - trwInfererCompact.getLowerBounds()[i]), 1e-3f);
+	}
+
+	CInferGraphCut	graphCutInferer(graph);
+	CInferGraphCut	graphCutInfererCompact(graphCompact);
+	ASSERT_EQ(graphCutInferer.decode(10), graphCutInfererCompact.decode(10));
+}
+
+TEST_F(CTestInference, inference_convergence)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP inferer(graph);
+	inferer.setConvergence(1e-7f, ResidualNorm::max);
+	testInferer(inferer);
+	ASSERT_GT(inferer.getNumIterations(), 0);
+	ASSERT_LT(inferer.getNumIterations(), 100);
+	ASSERT_LT(inferer.getResidual(), 1e-7f);
+}
+
+TEST_F(CTestInference, inference_stats)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP inferer(graph);
+	inferer.setConvergence(1e-7f, ResidualNorm::max);
+	inferer.decode(100);
+	const InferStats &stats = inferer.getStats();
+	ASSERT_TRUE(stats.converged);
+	ASSERT_EQ(inferer.getNumIterations(), stats.nIterations);
+	ASSERT_EQ(stats.nIterations, stats.vResiduals.size());
+	ASSERT_EQ(stats.nIterations, stats.vIterationTimes.size());
+	ASSERT_EQ(stats.nIterations * graph.getNumEdges(), stats.nMessages);
+	ASSERT_EQ(inferer.getResidual(), stats.vResiduals.back());
+	ASSERT_TRUE(stats.vEnergies.empty());
+	if (parallel::getBackend() != parallel::Backend::host) ASSERT_GE(stats.nThreads, 1);
+
+	const std::vector<std::string> vPhases = { "setup", "messages", "beliefs", "decoding" };
+	ASSERT_EQ(vPhases.size(), stats.vPhaseTimes.size());
+	for (size_t i = 0; i < vPhases.size(); i++) {
+		ASSERT_EQ(vPhases[i], stats.vPhaseTimes[i].first);
+		ASSERT_GE(stats.vPhaseTimes[i].second, 0);
+	}
+
+	// The statistics are reset by every inference
+	fillGraph(graph);
+	CInferTRW infererTRW(graph);
+	infererTRW.setEnergyTracking(true);
+	infererTRW.infer(10);
+	ASSERT_EQ(infererTRW.getNumIterations(), infererTRW.getStats().vEnergies.size());
+	ASSERT_EQ(3, infererTRW.getStats().vPhaseTimes.size());
+
+	// The decoding without the inference has only the decoding phase
+	infererTRW.decode(0);
+	ASSERT_EQ(0, infererTRW.getStats().nIterations);
+	ASSERT_TRUE(infererTRW.getStats().vEnergies.empty());
+	ASSERT_EQ(1, infererTRW.getStats().vPhaseTimes.size());
+	ASSERT_STREQ("decoding", infererTRW.getStats().vPhaseTimes[0].first);
+}
+
+TEST_F(CTestInference, inference_residual_BP)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferResidualBP inferer(graph);
+	testInferer(inferer);
+
+	fillGraph(graph);
+	CInferResidualBP infererConcurrent(graph, 4, 2);
+	testInferer(infererConcurrent);
+}
+
+TEST_F(CTestInference, inference_LBP_checkerboard)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP inferer(graph);
+	inferer.setCheckerboard(true);
+	testInferer(inferer);
+}
+
+TEST_F(CTestInference, inference_LBP_asynchronous)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP inferer(graph);
+	inferer.setAsynchronous(true);
+	testInferer(inferer);
+
+	// The asynchronous schedule converges to the same fixed point as the synchronous one
+	const Size graphSize(random::u<int>(20, 50), random::u<int>(20, 50));
+	CGraphPairwise		grid(m_nStates);
+	CGraphPairwiseExt	gridExt(grid, GRAPH_EDGES_GRID);
+	gridExt.setGraph(random::U(graphSize, CV_32FC(m_nStates), 0.1, 1.0));
+	gridExt.addDefaultEdgesModel(1.5f);
+
+	CInferLBP async(grid);
+	CInferLBP sync(grid);
+	async.setAsynchronous(true);
+	for (CInferLBP *pInferer : { &async, &sync }) {
+		pInferer->setConvergence(1e-6f);
+		pInferer->setKeepPotentials(true);									// both inferers start from the same node potentials
+	}
+	async.infer(500);
+	sync.infer(500);
+	ASSERT_LT(cv::norm(async.getMarginals(), sync.getMarginals(), NORM_INF), 1e-3);
+}
+
+TEST_F(CTestInference, inference_LBP_edge_batched)
+{
+	const Size graphSize(random::u<int>(20, 50), random::u<int>(20, 50));
+	for (byte nStates : { 2, 3 }) {
+		const Mat pots = random::U(graphSize, CV_32FC(nStates), 0.1, 1.0);
+		for (byte gType : { GRAPH_EDGES_GRID, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG }) {
+			CGraphGrid			grid(nStates);
+			CGraphPairwiseExt	gridExt(grid, gType);
+			gridExt.setGraph(pots);
+			gridExt.addDefaultEdgesModel(1.5f);
+
+			CInferLBP		lbp(grid);
+			CInferLBP		lbpBatched(grid);
+			CInferViterbi	viterbi(grid);
+			CInferViterbi	viterbiBatched(grid);
+			lbpBatched.setEdgeBatched(true);
+			viterbiBatched.setEdgeBatched(true);
+			for (CInferLBP *pInferer : { &lbp, &lbpBatched, &viterbi, &viterbiBatched }) {
+				pInferer->setKeepPotentials(true);
+				pInferer->infer(20);
+			}
+			ASSERT_LT(cv::norm(lbp.getMarginals(), lbpBatched.getMarginals(), NORM_INF), 1e-4);
+			ASSERT_LT(cv::norm(viterbi.getMarginals(), viterbiBatched.getMarginals(), NORM_INF), 1e-4);
+		}
+	}
+}
+
+TEST_F(CTestInference, inference_LBP_opencl)
+{
+	if (!gpu::isAvailable()) GTEST_SKIP() << "OpenCL is not available";
+
+	const Size graphSize(random::u<int>(20, 50), random::u<int>(20, 50));
+	for (byte nStates : { 2, 5 }) {
+		const Mat pots = random::U(graphSize, CV_32FC(nStates), 0.1, 1.0);
+		CGraphPairwise		graph(nStates);
+		CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+		graphExt.setGraph(pots);
+		graphExt.addDefaultEdgesModel(1.5f);
+
+		CInferLBP		lbp(graph);
+		CInferLBP		lbpOCL(graph);
+		CInferViterbi	viterbi(graph);
+		CInferViterbi	viterbiOCL(graph);
+		lbpOCL.setOpenCL(true);
+		viterbiOCL.setOpenCL(true);
+		for (CInferLBP *pInferer : { &lbp, &lbpOCL, &viterbi, &viterbiOCL }) {
+			pInferer->setKeepPotentials(true);
+			pInferer->infer(20);
+		}
+		ASSERT_LT(cv::norm(lbp.getMarginals(), lbpOCL.getMarginals(), NORM_INF), 1e-4);
+		ASSERT_LT(cv::norm(viterbi.getMarginals(), viterbiOCL.getMarginals(), NORM_INF), 1e-4);
+
+		// The time budget and the cancellation token stop the iterations on the device as well
+		std::atomic<bool> cancel(true);
+		lbpOCL.setCancellationToken(&cancel);
+		lbpOCL.infer(20);
+		ASSERT_TRUE(lbpOCL.isInterrupted());
+		ASSERT_EQ(lbpOCL.getNumIterations(), 1);
+	}
+}
+
+TEST_F(CTestInference, inference_partitioned)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferPartitioned inferer(graph);
+	inferer.setExchangePeriod(1);
+	testInferer(inferer);
+
+	// The partitioned inference converges to the same fixed point as the synchronous one
+	const Size graphSize(30, 24);
+	CGraphPairwise		grid(m_nStates);
+	CGraphPairwiseExt	gridExt(grid, GRAPH_EDGES_GRID);
+	gridExt.setGraph(random::U(graphSize, CV_32FC(m_nStates), 0.1, 1.0));
+	gridExt.addDefaultEdgesModel(1.5f);
+
+	CInferLBP sync(grid);
+	sync.setConvergence(1e-6f);
+	sync.setKeepPotentials(true);
+	sync.infer(500);
+
+	for (unsigned int period : { 1, 4 }) {
+		CInferPartitioned partitioned(grid);
+		partitioned.setPartition(CInferPartitioned::getGridPartition(graphSize, Size(8, 8)));
+		partitioned.setExchangePeriod(period);
+		partitioned.setConvergence(1e-6f);
+		partitioned.setKeepPotentials(true);
+		partitioned.infer(500);
+		ASSERT_EQ(partitioned.getNumCutEdges(), 2 * (3 * 24 + 2 * 30));
+		ASSERT_LT(cv::norm(partitioned.getMarginals(), sync.getMarginals(), NORM_INF), 1e-3);
+	}
+}
+
+TEST_F(CTestInference, inference_TRW_bounds)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferTRW inferer(graph);
+	inferer.setEnergyTracking(true);
+	inferer.infer(10);
+
+	const vec_float_t &vEnergy		= inferer.getEnergies();
+	const vec_float_t &vLowerBound	= inferer.getLowerBounds();
+	ASSERT_EQ(vEnergy.size(), inferer.getNumIterations());
+	ASSERT_EQ(vLowerBound.size(), inferer.getNumIterations());
+	for (size_t i = 0; i < vEnergy.size(); i++)
+		ASSERT_LE(vLowerBound[i], vEnergy[i] + 1e-4f);
+}
+
+TEST_F(CTestInference, arena)
+{
+	CArena arena;
+	for (int pass = 0; pass < 3; pass++) {
+		for (size_t n : { 1, 7, 100, 1000, 5000 }) {
+			float *p = arena.allocate<float>(n);
+			ASSERT_EQ(reinterpret_cast<size_t>(p) % CArena::ALIGNMENT, 0);
+			std::fill(p, p + n, 1.0f);
+		}
+		arena.reset();
+	}
+	const size_t capacity = arena.getCapacity();
+	arena.allocate<float>(1000);
+	arena.reset();
+	ASSERT_EQ(arena.getCapacity(), capacity);					// the memory is reused
+
+	float *p = CArena::getScratch<float>(100, 1);
+	ASSERT_EQ(reinterpret_cast<size_t>(p) % CArena::ALIGNMENT, 0);
+	ASSERT_EQ(CArena::getScratch<float>(50, 1), p);
+}
+
+TEST_F(CTestInference, inference_warm_start)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferLBP inferer(graph);
+	inferer.setConvergence(1e-6f);
+	inferer.setWarmStart(true);
+	testInferer(inferer);
+	const unsigned int nIt = inferer.getNumIterations();
+
+	fillGraph(graph);												// the same frame again
+	testInferer(inferer);
+	ASSERT_LE(inferer.getNumIterations(), 2);
+	ASSERT_LT(inferer.getNumIterations(), nIt);
+
+	buildGraph(graph, m_nNodes);									// the topology is rebuilt, but unchanged
+	fillGraph(graph);
+	testInferer(inferer);
+	ASSERT_LE(inferer.getNumIterations(), 2);
+}
+
+TEST_F(CTestInference, inference_incremental)
+{
+	const size_t nNodes = 200;
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, nNodes);
+	Mat nodePot(m_nStates, 1, CV_32FC1);
+	for (size_t n = 0; n < nNodes; n++) {
+		nodePot.at<float>(0, 0) = random::U(0.1f, 1.0f);
+		nodePot.at<float>(1, 0) = random::U(0.1f, 1.0f);
+		graph.setNode(n, nodePot);
+	}
+	Mat edgePot = (Mat_<float>(2, 2) << 2.0f, 1.0f, 1.0f, 2.0f);
+	for (size_t n = 0; n < nNodes - 1; n++) graph.setArc(n, n + 1, edgePot);
+
+	for (int i = 0; i < 2; i++) {
+		std::unique_ptr<CInfer> pInferer = i ? std::unique_ptr<CInfer>(new CInferTRW(graph)) : std::unique_ptr<CInfer>(new CInferLBP(graph));
+		CMessagePassing &inferer = dynamic_cast<CMessagePassing &>(*pInferer);
+		inferer.setConvergence(1e-6f);
+		inferer.setIncremental(true, 1e-6f);
+		ASSERT_TRUE(graph.isDirtyTracking());
+		inferer.infer(100);												// the first run is a full one
+		ASSERT_TRUE(graph.getDirtyNodes().empty());
+		const size_t nFull = inferer.getStats().nMessages;
+
+		nodePot.at<float>(0, 0) = 1.0f;									// a local edit in the middle of the chain
+		nodePot.at<float>(1, 0) = 0.01f;
+		for (size_t n = 100; n < 103; n++) graph.setNode(n, nodePot);
+		graph.setNode(101, nodePot);									// the repeated edits are not duplicated
+		ASSERT_EQ(3, graph.getDirtyNodes().size());
+
+		inferer.infer(100);
+		ASSERT_TRUE(graph.getDirtyNodes().empty());
+		ASSERT_LT(inferer.getStats().nMessages, nFull);
+		const Mat marginals = inferer.getMarginals().clone();
+
+		std::unique_ptr<CGraph> pClone = graph.clone();					// the reference: a full inference on the same unaries
+		IGraphPairwise &clone = dynamic_cast<IGraphPairwise &>(*pClone);
+		std::unique_ptr<CInfer> pReference = i ? std::unique_ptr<CInfer>(new CInferTRW(clone)) : std::unique_ptr<CInfer>(new CInferLBP(clone));
+		pReference->setKeepPotentials(true);
+		pReference->setConvergence(1e-6f);
+		pReference->infer(100);
+		ASSERT_LT(norm(marginals, pReference->getMarginals(), NORM_INF), 1e-2);
+
+		inferer.setIncremental(false);
+		ASSERT_FALSE(graph.isDirtyTracking());
+	}
+}
+
+TEST_F(CTestInference, inference_progress)
+{
+	const size_t nNodes = 50;
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, nNodes);
+	Mat nodePot(m_nStates, 1, CV_32FC1);
+	for (size_t n = 0; n < nNodes; n++) {
+		nodePot.at<float>(0, 0) = random::U(0.1f, 1.0f);
+		nodePot.at<float>(1, 0) = random::U(0.1f, 1.0f);
+		graph.setNode(n, nodePot);
+	}
+	Mat edgePot = (Mat_<float>(2, 2) << 2.0f, 1.0f, 1.0f, 2.0f);
+	for (size_t n = 0; n < nNodes - 1; n++) graph.setArc(n, n + 1, edgePot);
+
+	for (int i = 0; i < 2; i++) {
+		std::unique_ptr<CInfer> pInferer = i ? std::unique_ptr<CInfer>(new CInferTRW(graph)) : std::unique_ptr<CInfer>(new CInferLBP(graph));
+		std::vector<unsigned int> vIts;
+		pInferer->setProgressCallback([&](unsigned int nIt, const Mat &beliefs) {
+			vIts.push_back(nIt);
+			ASSERT_EQ(static_cast<int>(nNodes), beliefs.rows);
+			ASSERT_EQ(static_cast<int>(m_nStates), beliefs.cols);
+			for (int n = 0; n < beliefs.rows; n++)
+				ASSERT_NEAR(1.0, sum(beliefs.row(n))[0], 1e-4);
+		}, 2);
+		pInferer->setKeepPotentials(true);
+		pInferer->infer(10);
+		ASSERT_EQ(5, vIts.size());
+		for (size_t k = 0; k < vIts.size(); k++) ASSERT_EQ(2 * (k + 1), vIts[k]);
+
+		pInferer->setProgressCallback(nullptr);
+		pInferer->infer(10);
+		ASSERT_EQ(5, vIts.size());
+	}
+}
+
+TEST_F(CTestInference, inference_clone_output)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+	Mat nodePots;
+	graph.getNodes(0, 0, nodePots);
+
+	CGraphPairwiseCSR graphCSR(m_nStates);
+	buildGraph(graphCSR, m_nNodes);
+	fillGraph(graphCSR);
+
+	std::vector<std::unique_ptr<CGraph>> vpClones;
+	vpClones.push_back(graph.clone());
+	vpClones.push_back(graph.clone());
+	vpClones.push_back(graphCSR.clone());
+	ASSERT_EQ(graph.getNumEdges(), vpClones[0]->getNumEdges());
+	ASSERT_EQ(graphCSR.getNumEdges(), vpClones[2]->getNumEdges());
+
+	// Changing the clone does not affect the original graph
+	IGraphPairwise &clone = dynamic_cast<IGraphPairwise &>(*vpClones[1]);
+	Mat edgePot(m_nStates, m_nStates, CV_32FC1, Scalar(1.0f));
+	clone.setEdge(0, 1, edgePot);
+	clone.setNode(0, Mat(m_nStates, 1, CV_32FC1, Scalar(0.5f)));
+	Mat pot;
+	graph.getEdge(0, 1, pot);
+	ASSERT_GT(norm(pot, edgePot, NORM_INF), 0.1);
+	graph.getNode(0, pot);
+	ASSERT_EQ(0, norm(pot, nodePots.row(0).t(), NORM_INF));
+	fillGraph(clone);
+
+	// The marginals are written into the output buffers, the graphs stay unchanged
+	for (auto &pClone : vpClones) {
+		Mat beliefs;
+		CInferLBP inferer(dynamic_cast<IGraphPairwise &>(*pClone));
+		inferer.setOutput(&beliefs);
+		inferer.infer(100);
+		ASSERT_EQ(static_cast<int>(m_nNodes), beliefs.rows);
+		for (size_t n = 0; n < m_nNodes; n++)
+			ASSERT_LT(fabs(beliefs.at<float>(static_cast<int>(n), 0) - m_vPotExact[n]), 1e-5);
+
+		Mat clonePots;
+		pClone->getNodes(0, 0, clonePots);
+		ASSERT_EQ(0, norm(clonePots, nodePots, NORM_INF));
+	}
+
+	Mat beliefs;
+	CInferExact exactInferer(graph);
+	exactInferer.setOutput(&beliefs);
+	exactInferer.infer();
+	for (size_t n = 0; n < m_nNodes; n++)
+		ASSERT_LT(fabs(beliefs.at<float>(static_cast<int>(n), 0) - m_vPotExact[n]), 1e-5);
+	graph.getNodes(0, 0, pot);
+	ASSERT_EQ(0, norm(pot, nodePots, NORM_INF));
+}
+
+TEST_F(CTestInference, inference_keep_potentials)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+	Mat nodePots;
+	graph.getNodes(0, 0, nodePots);
+
+	CInferTRW trwInferer(graph);
+	trwInferer.setKeepPotentials(true);
+	const vec_byte_t decoding = trwInferer.decode(10);
+	
+	CInferLBP inferer(graph);
+	inferer.setKeepPotentials(true);
+	for (int i = 0; i < 2; i++) {													// the inference is repeated on the same unaries
+		testInferer(inferer);
+		Mat marginals = inferer.getMarginals();
+		ASSERT_EQ(static_cast<int>(m_nNodes), marginals.rows);
+		for (size_t n = 0; n < m_nNodes; n++)
+			ASSERT_LT(fabs(marginals.at<float>(static_cast<int>(n), 0) - m_vPotExact[n]), 1e-5);
+
+		Mat pots;
+		graph.getNodes(0, 0, pots);
+		ASSERT_EQ(0, norm(pots, nodePots, NORM_INF));
+	}
+	ASSERT_EQ(decoding, trwInferer.decode(10));
+
+	inferer.setKeepPotentials(false);
+	testInferer(inferer);
+	Mat pots;
+	graph.getNodes(0, 0, pots);
+	ASSERT_GT(norm(pots, nodePots, NORM_INF), 0);
+}
+
+TEST_F(CTestInference, inference_log_domain)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+
+	CInferChain chainInferer(graph);
+	CInferTree	treeInferer(graph);
+	CInferLBP	lbpInferer(graph);
+	for (CMessagePassing *pInferer : std::initializer_list<CMessagePassing *>{ &chainInferer, &treeInferer, &lbpInferer }) {
+		fillGraph(graph);
+		pInferer->setLogDomain(true);
+		testInferer(*pInferer);
+	}
+
+	// max-sum decoding
+	const byte		nStates = 12;
+	const size_t	nNodes	= 50;
+	CGraphPairwise graphMax(nStates);
+	buildGraph(graphMax, nNodes);
+	std::vector<Mat> vNodePots(nNodes);
+	for (Mat &nodePot : vNodePots) nodePot = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+	graphMax.setEdges(std::nullopt, random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0));
+	
+	CInferViterbi viterbiInferer(graphMax);
+	for (size_t n = 0; n < nNodes; n++) graphMax.setNode(n, vNodePots[n]);
+	vec_byte_t decoding = viterbiInferer.decode(nNodes);
+	
+	viterbiInferer.setLogDomain(true);
+	for (size_t n = 0; n < nNodes; n++) graphMax.setNode(n, vNodePots[n]);
+	ASSERT_EQ(viterbiInferer.decode(nNodes), decoding);
+}
+
+TEST_F(CTestInference, inference_chain_batch)
+{
+	const byte	nStates = 5;
+	const int	nChains = 20;
+	const int	length	= 10;
+
+	Mat transition = random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0);
+	transition = 0.5 * (transition + transition.t());							// the graph arcs require symmetric potentials
+	Mat edgePot;
+	sqrt(transition, edgePot);
+	Mat pots = random::U(Size(length * nStates, nChains), CV_32FC1, 0.1, 1.0).reshape(nStates);
+
+	CInferChainBatch batchInferer(nStates);
+	Mat decoding = batchInferer.decode(pots, transition);
+	Mat marginals = pots.clone();
+	batchInferer.infer(marginals, transition);
+
+	CGraphPairwise	graph(nStates);
+	CInferChain		chainInferer(graph);
+	CInferViterbi	viterbiInferer(graph);
+	for (int c = 0; c < nChains; c++) {
+		buildGraph(graph, length);
+		for (int t = 0; t < length; t++) graph.setNode(t, Mat(nStates, 1, CV_32FC1, pots.ptr<float>(c) + t * nStates));
+		graph.setEdges(std::nullopt, edgePot);
+		vec_byte_t decodingRef = viterbiInferer.decode(length);
+		for (int t = 0; t < length; t++) ASSERT_EQ(decoding.at<byte>(c, t), decodingRef[t]);
+
+		for (int t = 0; t < length; t++) graph.setNode(t, Mat(nStates, 1, CV_32FC1, pots.ptr<float>(c) + t * nStates));
+		chainInferer.infer();
+		for (byte s = 0; s < nStates; s++) {
+			vec_float_t potRef = chainInferer.getPotentials(s);
+			for (int t = 0; t < length; t++)
+				ASSERT_LT(fabs(marginals.ptr<float>(c)[t * nStates + s] - potRef[t]), 1e-5);
+		}
+	}
+}
+
+TEST_F(CTestInference, inference_tree_levels)
+{
+	const byte		nStates = 3;
+	const size_t	nNodes	= 300;
+
+	// 4-ary tree: the last level has more than 64 nodes, which are processed in parallel
+	CGraphPairwise graph(nStates);
+	for (size_t n = 0; n < nNodes; n++) graph.addNode(random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0));
+	for (size_t n = 1; n < nNodes; n++) graph.addArc(n, (n - 1) / 4);
+	graph.setEdges(std::nullopt, random::U(Size(nStates, nStates), CV_32FC1, 0.5, 1.0) + Mat::eye(nStates, nStates, CV_32FC1));
+	std::vector<Mat> vNodePots(nNodes);
+	for (size_t n = 0; n < nNodes; n++) graph.getNode(n, vNodePots[n]);
+
+	CInferTree treeInferer(graph);
+	treeInferer.infer();
+	std::vector<vec_float_t> vPot(nStates);
+	for (byte s = 0; s < nStates; s++) vPot[s] = treeInferer.getPotentials(s);
+
+	for (size_t n = 0; n < nNodes; n++) graph.setNode(n, vNodePots[n]);
+	CInferLBP lbpInferer(graph);
+	lbpInferer.infer(20);															// LBP is exact on trees
+	for (byte s = 0; s < nStates; s++) {
+		vec_float_t potRef = lbpInferer.getPotentials(s);
+		for (size_t n = 0; n < nNodes; n++)
+			ASSERT_LT(fabs(vPot[s][n] - potRef[n]), 1e-4);
+	}
+}
+
+TEST_F(CTestInference, inference_exact_streaming)
+{
+	const byte		nStates = 4;
+	const size_t	nNodes	= 10;
+
+	CGraphPairwise graph(nStates);
+	buildGraph(graph, nNodes);
+	std::vector<Mat> vNodePots(nNodes);
+	for (size_t n = 0; n < nNodes; n++) {
+		vNodePots[n] = random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0);
+		vNodePots[n].at<float>(n % nStates, 0) = 0;								// impossible states
+		graph.setNode(n, vNodePots[n]);
+	}
+	Mat edgePot = random::U(Size(nStates, nStates), CV_32FC1, 0.1, 1.0);
+	graph.setEdges(std::nullopt, edgePot + edgePot.t());						// the message passing requires symmetric potentials of the arcs
+
+	CInferExact exactInferer(graph);
+	exactInferer.infer();
+	std::vector<vec_float_t> vPotExact(nStates);
+	for (byte s = 0; s < nStates; s++) vPotExact[s] = exactInferer.getPotentials(s);
+
+	for (size_t n = 0; n < nNodes; n++) graph.setNode(n, vNodePots[n]);
+	CInferChain chainInferer(graph);
+	chainInferer.infer();
+	for (byte s = 0; s < nStates; s++) {
+		vec_float_t pot = chainInferer.getPotentials(s);
+		for (size_t n = 0; n < nNodes; n++)
+			ASSERT_LT(fabs(pot[n] - vPotExact[s][n]), 1e-5);
+	}
+
+	for (size_t n = 0; n < nNodes; n++) graph.setNode(n, vNodePots[n]);
+	CDecodeExact	exactDecoder(graph);
+	vec_byte_t		decoding = exactDecoder.decode();
+	for (size_t n = 0; n < nNodes; n++) ASSERT_NE(decoding[n], n % nStates);
+}
+
+TEST_F(CTestInference, maxflow)
+{
+	// s -> 0: 4, s -> 1: 1, 0 -> 1: 1, 0 -> t: 2, 1 -> t: 3; the minimal cut is {s, 0} | {1, t}
+	CMaxFlow maxFlow;
+	maxFlow.reset(2, 1);
+	maxFlow.addTWeights(0, 4, 2);
+	maxFlow.addTWeights(1, 1, 3);
+	maxFlow.addEdge(0, 1, 1, 0);
+	ASSERT_DOUBLE_EQ(maxFlow.maxflow(), 4);
+	ASSERT_FALSE(maxFlow.isSink(0));
+	ASSERT_TRUE(maxFlow.isSink(1));
+}
+
+TEST_F(CTestInference, inference_graph_cut)
+{
+	const byte		nStates = 2;
+	const int		width	= 4;
+	const int		height	= 3;
+
+	// For the binary Potts model the expansion is exact
+	CGraphPairwise graph(nStates);
+	for (int i = 0; i < width * height; i++) graph.addNode(random::U(Size(1, nStates), CV_32FC1, 0.1, 1.0));
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) {
+			if (x + 1 < width)	graph.addArc(y * width + x, y * width + x + 1);
+			if (y + 1 < height) graph.addArc(y * width + x, (y + 1) * width + x);
+		}
+	Mat edgePot(nStates, nStates, CV_32FC1, Scalar(1.0f));
+	edgePot.at<float>(0, 0) = edgePot.at<float>(1, 1) = 1.5f;
+	graph.setEdges(std::nullopt, edgePot);
+
+	CDecodeExact	exactDecoder(graph);
+	vec_byte_t		decodingExact = exactDecoder.decode();
+
+	CInferGraphCut	graphCutInferer(graph);
+	vec_byte_t		decoding = graphCutInferer.decode(10);
+	ASSERT_EQ(decoding, decodingExact);
+	ASSERT_GT(graphCutInferer.getNumIterations(), 0);
+}
+
+TEST_F(CTestInference, inference_dual_decomposition)
+{
+	const byte		nStates = 3;
+	const Size		size(4, 3);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	const Mat			pots = random::U(size, CV_32FC(nStates), 0.1, 1.0);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(1.5f);
+
+	CDecodeExact	exactDecoder(graph);
+	const double	energyExact = graph.computeEnergy(exactDecoder.decode());
+
+	CInferDualDecomposition inferer(graph, size);
+	vec_byte_t decoding = inferer.decode(200);
+	ASSERT_EQ(decoding.size(), graph.getNumNodes());
+
+	const vec_float_t &vEnergy		= inferer.getEnergies();
+	const vec_float_t &vLowerBound	= inferer.getLowerBounds();
+	ASSERT_EQ(vEnergy.size(), inferer.getNumIterations());
+	ASSERT_EQ(vLowerBound.size(), inferer.getNumIterations());
+	ASSERT_NEAR(vEnergy.back(), graph.computeEnergy(decoding), 1e-3);
+	for (size_t i = 0; i < vEnergy.size(); i++) {
+		ASSERT_LE(vLowerBound[i], energyExact + 1e-3);
+		ASSERT_GE(vEnergy[i], energyExact - 1e-3);
+		if (i) ASSERT_LE(vEnergy[i], vEnergy[i - 1]);
+	}
+
+	// A set token interrupts the decoding after the first iteration, which is always completed
+	graphExt.setGraph(pots);
+	std::atomic<bool> cancel(true);
+	inferer.setCancellationToken(&cancel);
+	decoding = inferer.decode(200);
+	ASSERT_TRUE(inferer.isInterrupted());
+	ASSERT_EQ(1, inferer.getNumIterations());
+	ASSERT_EQ(1, inferer.getEnergies().size());
+	graphExt.setGraph(pots);
+	ASSERT_NEAR(inferer.getEnergies().back(), graph.computeEnergy(decoding), 1e-3);
+}
+
+TEST_F(CTestInference, inference_Gibbs)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	random::seed(0xC0FFEE);
+	CInferGibbs inferer(graph);
+	inferer.setNumSamples(10);
+	inferer.infer(20000);
+	vec_float_t pot = inferer.getPotentials(0);
+	ASSERT_EQ(pot.size(), m_vPotExact.size());
+	for (size_t i = 0; i < pot.size(); i++)
+		ASSERT_NEAR(pot[i], m_vPotExact[i], 2e-2);
+
+	const Mat samples = inferer.getSamples().clone();
+	ASSERT_EQ(samples.rows, 10);
+	ASSERT_EQ(samples.cols, static_cast<int>(m_nNodes));
+
+	// The residual is the change of the running averages of the distributions: at most 2 / k in the k-th sweep
+	const vec_float_t &vResiduals = inferer.getStats().vResiduals;
+	ASSERT_EQ(vResiduals.size(), inferer.getNumIterations());
+	for (size_t k = 0; k < vResiduals.size(); k++)
+		ASSERT_LE(vResiduals[k], 2.0f / (k + 1) + 1e-6f);
+
+	// The same seed results in the same samples
+	random::seed(0xC0FFEE);
+	fillGraph(graph);
+	inferer.infer(20000);
+	ASSERT_EQ(cv::norm(samples, inferer.getSamples(), NORM_INF), 0);
+
+	// Hence, the convergence criterion stops the sampling
+	fillGraph(graph);
+	inferer.setConvergence(1e-3f);
+	inferer.infer(20000);
+	ASSERT_TRUE(inferer.getStats().converged);
+	ASSERT_LE(inferer.getNumIterations(), 2001);
+}
+
+TEST_F(CTestInference, inference_mean_field)
+{
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+
+	CInferMeanField inferer(graph);
+	inferer.setDamping(0.0f);
+	inferer.setConvergence(1e-7f);
+	inferer.infer(1000);
+	ASSERT_LT(inferer.getNumIterations(), 1000u);
+	Mat Q = inferer.getMarginals().clone();
+	ASSERT_EQ(Q.rows, static_cast<int>(m_nNodes));
+
+	// The fixed point: Q_n(s) ~ nodePot_n(s) * exp(sum_m sum_x Q_m(x) * log(edgePot(x, s))), where edgePot is the product of both directions of an arc
+	const float edgePot[2][2] = { { 2.0f, 1.0f }, { 1.0f, 2.0f } };
+	for (size_t n = 0; n < m_nNodes; n++) {
+		const float nodePot[2] = { n % 2 ? 0.10f : 0.75f, n % 2 ? 0.90f : 0.25f };
+		float q[2];
+		for (byte s = 0; s < m_nStates; s++) {
+			float acc = logf(nodePot[s]);
+			for (size_t m : { n - 1, n + 1 })
+				if (m < m_nNodes)
+					for (byte x = 0; x < m_nStates; x++) acc += Q.at<float>(static_cast<int>(m), x) * logf(edgePot[x][s]);
+			q[s] = expf(acc);
+		}
+		for (byte s = 0; s < m_nStates; s++)
+			ASSERT_NEAR(Q.at<float>(static_cast<int>(n), s), q[s] / (q[0] + q[1]), 1e-5);
+	}
+
+	// The damping changes the path, but not the fixed point
+	fillGraph(graph);
+	inferer.setDamping(0.5f);
+	inferer.infer(1000);
+	ASSERT_LT(cv::norm(Q, inferer.getMarginals(), NORM_INF), 1e-5);
+}
+
+TEST_F(CTestInference, inference_Pn_Potts)
+{
+	const byte	nStates = 3;
+	const int	nNodes	= 5;
+	Mat pots(nNodes, nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.05f, 1.0f);
+
+	// One clique is a tree, thus the max-product decoding is the minimum of the energy
+	CGraphPairwise graph(nStates);
+	graph.addNodes(pots);
+	for (auto [gamma, Q] : { std::pair<float, float>(0.0f, 1.0f), { 0.5f, 1.0f }, { 2.0f, 1.0f }, { 1.0f, 2.0f }, { 3.0f, 2.0f } }) {
+		vec_byte_t	best(nNodes);
+		float		minEnergy = FLT_MAX;
+		for (int code = 0; code < 243; code++) {												// 3^5 labelings
+			vec_byte_t x(nNodes);
+			float	   energy = 0;
+			for (int n = 0, c = code; n < nNodes; n++, c /= nStates) {
+				x[n] = static_cast<byte>(c % nStates);
+				energy -= logf(pots.at<float>(n, x[n]));
+			}
+			int maxCount = 0;
+			for (byte k = 0; k < nStates; k++) maxCount = MAX(maxCount, static_cast<int>(std::count(x.begin(), x.end(), k)));
+			energy += MIN(gamma, (nNodes - maxCount) * gamma / Q);
+			if (energy < minEnergy) {
+				minEnergy = energy;
+				best = x;
+			}
+		} // code
+
+		graph.setNodes(0, pots);
+		CInferPnPotts inferer(graph);
+		inferer.addClique({ 0, 1, 2, 3, 4 }, gamma, Q);
+		ASSERT_EQ(inferer.getNumCliques(), 1u);
+		ASSERT_EQ(inferer.decode(10), best);
+	}
+
+	// The cliques of the regions on top of the pairwise chain
+	const int	nChain = 12;
+	Mat chainPots(nChain, nStates, CV_32FC1);
+	RNG(0xF00D).fill(chainPots, RNG::UNIFORM, 0.05f, 1.0f);
+	Mat labels(1, nChain, CV_32SC1);
+	for (int n = 0; n < nChain; n++) labels.at<int>(n) = n < nChain / 2 ? 0 : 1;
+
+	CGraphPairwise chain(nStates);
+	chain.addNodes(chainPots);
+	for (int n = 0; n < nChain - 1; n++) chain.addArc(n, n + 1, CTrainEdge::getDefaultEdgePotentials(1.2f, nStates));
+
+	CInferViterbi viterbi(chain);
+	const vec_byte_t solution = viterbi.decode(100);
+	CInferPnPotts inferer(chain);
+	inferer.addCliques(labels, 0.0f, 0.1f);
+	ASSERT_EQ(inferer.getNumCliques(), 2u);
+	chain.setNodes(0, chainPots);
+	ASSERT_EQ(inferer.decode(100), solution);													// the zero cost does not change the solution
+
+	inferer.clearCliques();
+	inferer.addCliques(labels, 50.0f, 0.1f);
+	chain.setNodes(0, chainPots);
+	const vec_byte_t consistent = inferer.decode(100);
+	for (int n = 0; n < nChain; n++) ASSERT_EQ(consistent[n], consistent[n < nChain / 2 ? 0 : nChain - 1]);
+}
+
+TEST_F(CTestInference, inference_tiled)
+{
+	const byte	nStates = 3;
+	const Size	size(45, 37);
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+	pots = pots.reshape(nStates);
+
+	// One tile covering the whole image is equal to the direct decoding
+	CGraphPairwiseKit graphKit(nStates, INFER::TRW, GraphType::grid);
+	CGraphLayeredExt  graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), 1);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(2.0f);
+	Mat direct = Mat(graphKit.getInfer().decode(10), true).reshape(1, size.height);
+
+	CInferTiled whole(nStates, INFER::TRW, size, 0);
+	whole.setDefaultEdgesModel(2.0f);
+	Mat res = whole.decode(pots, 10);
+	ASSERT_EQ(res.size(), size);
+	ASSERT_EQ(countNonZero(res != direct), 0);
+
+	// Small overlapping tiles agree with the direct decoding almost everywhere
+	CInferTiled tiled(nStates, INFER::TRW, Size(16, 16), 8);
+	tiled.setDefaultEdgesModel(2.0f);
+	res = tiled.decode(pots, 10);
+	ASSERT_EQ(res.size(), size);
+	ASSERT_LT(countNonZero(res != direct), size.area() / 20);
+}
+
+TEST_F(CTestInference, auto_tuner)
+{
+	const byte	nStates = 3;
+	const Size	size(40, 32);
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+	pots = pots.reshape(nStates);
+
+	// Without the budgets the configuration with the lowest energy of the sample is selected and cached
+	CAutoTuner tuner(std::chrono::milliseconds(0), 0, 10);
+	tuner.setDefaultEdgesModel(2.0f);
+	const TunedConfig config = tuner.tune(pots);
+	ASSERT_EQ(config.tileSize, Size(0, 0));
+	ASSERT_EQ(config.memory, CGraphPairwiseKit::estimateMemory(size, nStates, config.infer, config.graphType));
+	ASSERT_EQ(tuner.getNumCached(), 1u);
+	for (INFER infer : { INFER::LBP, INFER::TRW, INFER::Viterbi }) {
+		CGraphPairwiseKit graphKit(nStates, infer, GraphType::csr);
+		CGraphLayeredExt  graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), 1);
+		graphExt.setGraph(pots);
+		graphExt.addDefaultEdgesModel(2.0f);
+		graphKit.getInfer().setKeepPotentials(true);
+		ASSERT_LE(config.energy, graphKit.getGraph().computeEnergy(graphKit.getInfer().decode(10)) + 1e-3 * fabs(config.energy));
+	}
+
+	// The cached decision is returned for the same workload signature
+	const TunedConfig cached = tuner.tune(Workload{ size, nStates });
+	ASSERT_EQ(cached.infer, config.infer);
+	ASSERT_EQ(cached.graphType, config.graphType);
+	ASSERT_EQ(cached.time, config.time);
+	ASSERT_EQ(tuner.getNumCached(), 1u);
+
+	// A large workload does not fit the memory budget and is tiled
+	const Workload	large{ Size(4096, 4096), nStates };
+	const size_t	budget = CGraphPairwiseKit::estimateMemory(large.size, nStates, INFER::TRW, GraphType::grid) / 8;
+	CAutoTuner tiler(std::chrono::milliseconds(0), budget, 10);
+	const TunedConfig tiled = tiler.tune(large, pots);
+	ASSERT_GT(tiled.tileSize.area(), 0);
+	ASSERT_LE(tiled.memory, budget);
+	ASSERT_EQ(tiled.graphType, GraphType::grid);
+	ASSERT_FALSE(tiled.halfPrecision);
+}
+
+TEST_F(CTestInference, inference_slabs)
+{
+	const byte	nStates = 3;
+	const Size	sliceSize(12, 10);
+	const int	depth	= 9;
+	Mat pots(sliceSize.height * depth, sliceSize.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+	pots = pots.reshape(nStates);
+
+	// One slab covering the whole volume is equal to the direct decoding
+	CGraphPairwiseKit graphKit(nStates, INFER::TRW, GraphType::grid);
+	CGraphVolumeExt	  graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), depth, VOLUME_EDGES_6);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(2.0f);
+	Mat direct = Mat(graphKit.getInfer().decode(10), true).reshape(1, pots.rows);
+
+	CInferSlabs whole(nStates, INFER::TRW, VOLUME_EDGES_6, depth, 0);
+	whole.setDefaultEdgesModel(2.0f);
+	Mat res = whole.decode(pots, depth, 10);
+	ASSERT_EQ(res.size(), pots.size());
+	ASSERT_EQ(countNonZero(res != direct), 0);
+
+	// Thin overlapping slabs agree with the direct decoding almost everywhere; the labels arrive in the order of the slices
+	CInferSlabs slabs(nStates, INFER::TRW, VOLUME_EDGES_6, 2, 2);
+	slabs.setDefaultEdgesModel(2.0f);
+	int next = 0;
+	res = Mat(pots.size(), CV_8UC1, Scalar(255));
+	slabs.decode(sliceSize, depth, [&](const Range &slices) { return pots.rowRange(slices.start * sliceSize.height, slices.end * sliceSize.height); },
+		[&](const Range &slices, const Mat &labels) {
+			ASSERT_EQ(slices.start, next);
+			next = slices.end;
+			labels.copyTo(res.rowRange(slices.start * sliceSize.height, slices.end * sliceSize.height));
+		}, 10);
+	ASSERT_EQ(next, depth);
+	ASSERT_LT(countNonZero(res != direct), pots.rows * pots.cols / 20);
+}
+
+TEST_F(CTestInference, inference_multiscale)
+{
+	const byte	nStates = 2;
+	const Size	size(40, 40);
+	Mat gt(size, CV_8UC1);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++)
+			gt.at<byte>(y, x) = ((x / 8) + (y / 8)) % 2;
+
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++)
+			pots.at<float>(y, x * nStates + gt.at<byte>(y, x)) += 0.5f;
+	pots = pots.reshape(nStates);
+
+	Mat pooled = CInferMultiscale::pool(pots);
+	ASSERT_EQ(pooled.size(), Size(20, 20));
+	ASSERT_EQ(pooled.type(), pots.type());
+
+	CInferMultiscale inferer(nStates, INFER::LBP, 3);
+	inferer.setDefaultEdgesModel(3.0f);
+	Mat res = inferer.decode(pots, 10);
+	ASSERT_EQ(res.size(), size);
+	ASSERT_LT(countNonZero(res != gt), size.area() / 10);
+}
+
+TEST_F(CTestInference, inference_time_budget)
+{
+	const byte nStates = 3;
+	const Size size(60, 60);
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+	pots = pots.reshape(nStates);
+
+	CGraphPairwiseKit graphKit(nStates, INFER::LBP, GraphType::grid);
+	CGraphLayeredExt  graphExt(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), 1);
+	graphExt.setGraph(pots);
+	graphExt.addDefaultEdgesModel(2.0f);
+
+	// A set token interrupts the inference after the first iteration
+	std::atomic<bool> cancel(true);
+	graphKit.getInfer().setCancellationToken(&cancel);
+	graphKit.getInfer().infer(100);
+	ASSERT_TRUE(graphKit.getInfer().isInterrupted());
+	ASSERT_EQ(graphKit.getInfer().getNumIterations(), 1);
+
+	// A generous budget does not interrupt the inference
+	graphExt.setGraph(pots);
+	cancel = false;
+	graphKit.getInfer().setTimeBudget(std::chrono::milliseconds(60000));
+	graphKit.getInfer().infer(5);
+	ASSERT_FALSE(graphKit.getInfer().isInterrupted());
+	ASSERT_EQ(graphKit.getInfer().getNumIterations(), 5);
+
+	// The cancelled exact decoding enumerates no configurations
+	CGraphPairwise graph(m_nStates);
+	buildGraph(graph, m_nNodes);
+	fillGraph(graph);
+	CDecodeExact decoder(graph);
+	cancel = true;
+	decoder.setCancellationToken(&cancel);
+	decoder.decode();
+	ASSERT_TRUE(decoder.isInterrupted());
+	decoder.setCancellationToken(NULL);
+	decoder.decode();
+	ASSERT_FALSE(decoder.isInterrupted());
+}
+
+TEST_F(CTestInference, inference_batch)
+{
+	const size_t nGraphs = 50;
+	std::vector<std::unique_ptr<CGraphPairwise>> vGraphs;
+	std::vector<IGraphPairwise *> vpGraphs;
+	for (size_t g = 0; g < nGraphs; g++) {
+		vGraphs.push_back(std::make_unique<CGraphPairwise>(m_nStates));
+		buildGraph(*vGraphs.back(), m_nNodes);
+		fillGraph(*vGraphs.back());
+		vpGraphs.push_back(vGraphs.back().get());
+	}
+
+	CInferBatch batch(INFER::LBP);
+	batch.infer(vpGraphs, 100);
+	for (IGraphPairwise *pGraph : vpGraphs) {
+		Mat pot;
+		for (size_t n = 0; n < m_nNodes; n++) {
+			pGraph->getNode(n, pot);
+			ASSERT_LT(fabs(pot.at<float>(0, 0) - m_vPotExact[n]), 1e-5);
+		}
+	}
+
+	std::vector<vec_byte_t> vDecoding = batch.decode(vpGraphs, 10);
+	ASSERT_EQ(vDecoding.size(), nGraphs);
+	for (const vec_byte_t &decoding : vDecoding) ASSERT_EQ(decoding, vDecoding.front());
+}
+
+TEST_F(CTestInference, perturb_map)
+{
+	const byte		nStates = 3;
+	const Size		size(6, 5);
+	const size_t	nSamples = 20;
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	graphExt.setGraph(random::U(size, CV_32FC(nStates), 0.1, 1.0));
+	graphExt.addDefaultEdgesModel(1.5f);
+	Mat unaries;
+	graph.getNodes(0, 0, unaries);
+
+	// The frequencies of every node sum up to 1, and the unaries of the graph stay intact
+	random::seed(7);
+	CInferPerturbMAP sampler(graph, INFER::Viterbi, 3);
+	Mat freq = sampler.sample(nSamples, 10);
+	ASSERT_EQ(freq.rows, static_cast<int>(graph.getNumNodes()));
+	ASSERT_EQ(freq.cols, nStates);
+	for (int n = 0; n < freq.rows; n++) ASSERT_NEAR(sum(freq.row(n))[0], 1.0, 1e-5);
+	Mat pots;
+	graph.getNodes(0, 0, pots);
+	ASSERT_EQ(norm(pots, unaries, NORM_INF), 0);
+
+	// The samples do not depend on the number of solvers
+	random::seed(7);
+	CInferPerturbMAP serialSampler(graph, INFER::Viterbi, 1);
+	ASSERT_LT(norm(serialSampler.sample(nSamples, 10), freq, NORM_INF), 1e-5);
+
+	// Without noise the sample is the MAP solution of the graph
+	CInferViterbi		inferer(graph);
+	inferer.setKeepPotentials(true);
+	vec_byte_t			solution = inferer.decode(10);
+	CInferPerturbMAP	mapSampler(graph, INFER::Viterbi, 1);
+	Mat					freqMAP = mapSampler.sample(1, 10, 0.0f);
+	for (size_t n = 0; n < solution.size(); n++) ASSERT_FLOAT_EQ(freqMAP.at<float>(static_cast<int>(n), solution[n]), 1.0f);
+}
+
+TEST_F(CTestInference, inference_sgm)
+{
+	const byte	nStates = 6;
+	const Size	size(24, 16);
+
+	// Piecewise constant configuration with the noisy node potentials
+	Mat			pots = random::U(size, CV_32FC(nStates), 0.1, 1.0);
+	vec_byte_t	gt(size.area());
+	vec_byte_t	vArgMax(size.area());
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			float *pPot = pots.ptr<float>(y) + x * nStates;
+			gt[y * size.width + x] = x < size.width / 2 ? 1 : 4;
+			pPot[gt[y * size.width + x]] += 0.4f;
+			vArgMax[y * size.width + x] = simd::argMax(pPot, nStates);
+		} // x
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	graphExt.setGraph(pots);
+	auto getErrors = [&](const vec_byte_t &vLabels) { 
+		size_t res = 0;
+		for (size_t n = 0; n < gt.size(); n++) if (vLabels[n] != gt[n]) res++;
+		return res; 
+	};
+
+	// Without the edge potentials every node takes its most probable state
+	CInferSGM sgm(graph, size, 8);
+	sgm.setKeepPotentials(true);
+	ASSERT_EQ(sgm.decode(1), vArgMax);
+
+	// Potts and truncated linear edges
+	Mat truncatedLinear(nStates, nStates, CV_32FC1);
+	for (int y = 0; y < nStates; y++)
+		for (int x = 0; x < nStates; x++)
+			truncatedLinear.at<float>(y, x) = MAX(4.0f * powf(0.7f, static_cast<float>(abs(x - y))), 1.0f);	// tau > 2 lambda: the distance transform
+	for (int model = 0; model < 2; model++) {
+		if (model == 0) graphExt.addDefaultEdgesModel(3.0f);
+		else graph.setEdges(std::nullopt, truncatedLinear);
+		for (byte nPaths : { 4, 8, 16 }) {
+			CInferSGM	 inferer(graph, size, nPaths);
+			inferer.setKeepPotentials(true);
+			vec_byte_t	 solution = inferer.decode(1);
+			ASSERT_LT(2 * getErrors(solution), getErrors(vArgMax));
+			ASSERT_LT(graph.computeEnergy(solution), graph.computeEnergy(vArgMax));
+		} // nPaths
+	} // model
+}
+
+TEST_F(CTestInference, stereo_cost)
+{
+	const int	width = 40;
+	const int	height = 10;
+	const int	shift = 3;															// the true disparity
+	const int	minDisparity = 0;
+	const int	maxDisparity = 8;
+	const int	nDisparities = maxDisparity - minDisparity;
+
+	Mat imgL = random::U(Size(width, height), CV_8UC1, 0, 256);
+	Mat imgR(imgL.size(), CV_8UC1, Scalar(0));
+	imgL(Rect(0, 0, width - shift, height)).copyTo(imgR(Rect(shift, 0, width - shift, height)));
+
+	// SAD without aggregation is the cost of the stereo demo
+	Mat pots = CStereoCost(minDisparity, maxDisparity).getPotentials(imgL, imgR);
+	ASSERT_EQ(pots.type(), CV_32FC(nDisparities));
+	ASSERT_EQ(pots.size(), imgL.size());
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			for (int d = 0; d < nDisparities; d++) {
+				const int xR = x + minDisparity + d;
+				float pot = 1.0f;
+				if (xR < width) {
+					const float p = 1.0f - fabs(static_cast<float>(imgL.at<byte>(y, x)) - static_cast<float>(imgR.at<byte>(y, xR))) / 255.0f;
+					pot = p * p;
+				}
+				ASSERT_NEAR(pots.ptr<float>(y)[x * nDisparities + d], pot, 1e-5);
+			} // d
+
+	// Every matching cost has its best potential at the true disparity
+	for (auto cost : { std::make_pair(MatchingCost::SAD, 3), std::make_pair(MatchingCost::census, 5), std::make_pair(MatchingCost::ZNCC, 5) }) {
+		pots = CStereoCost(minDisparity, maxDisparity, cost.first, cost.second).getPotentials(imgL, imgR);
+		const int r = cost.second / 2;
+		for (int y = 0; y < height; y++)
+			for (int x = r; x < width - maxDisparity - r; x++) {
+				const float *pPot = pots.ptr<float>(y) + x * nDisparities;
+				ASSERT_EQ(shift - minDisparity, simd::argMax(pPot, static_cast<byte>(nDisparities)));
+				ASSERT_NEAR(pPot[shift - minDisparity], 1.0f, 1e-4);
+			} // x
+	}
+}
+
+TEST_F(CTestInference, inference_dense)
+{
+	const byte	nStates = 4;
+	const Size	size(16, 12);
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.1f, 1.0f);
+	pots = pots.reshape(nStates);
+
+	CGraphDense		graph(nStates);
+	CGraphDenseExt	graphExt(graph);
+	graphExt.setGraph(pots);
+	graphExt.addGaussianEdgeModel(Vec2f::all(3.0f), 3.0f);
+
+	CInferDense inferer(graph);
+	inferer.setConvergence(1e-4f);
+	inferer.infer(100);
+	ASSERT_LT(inferer.getNumIterations(), 100);
+
+	// The result is the normalized Q distribution
+	Mat Q = graph.getNodePotentials();
+	for (int n = 0; n < Q.rows; n++) ASSERT_NEAR(sum(Q.row(n))[0], 1.0, 1e-5);
+}
+
+TEST_F(CTestInference, inference_dense_downsampled)
+{
+	const byte	nStates = 2;
+	const Size	size(32, 32);
+	Mat gt(size, CV_8UC1);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++)
+			gt.at<byte>(y, x) = x < size.width / 2 ? 0 : 1;
+
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.0f, 1.0f);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++)
+			pots.at<float>(y, x * nStates + gt.at<byte>(y, x)) += 0.5f;
+	pots = pots.reshape(nStates);
+
+	CInferDenseDownsampled inferer(nStates, 2);
+	inferer.addGaussianEdgeModel(Vec2f::all(3.0f), 3.0f);
+	Mat Q = inferer.infer(pots, 10);
+	ASSERT_EQ(Q.size(), size);
+	ASSERT_EQ(Q.type(), pots.type());
+
+	Mat res = inferer.decode(pots, 10);
+	ASSERT_LT(countNonZero(res != gt), size.area() / 10);
+}
+
+TEST_F(CTestInference, inference_dense_gradient)
+{
+	const byte	nStates = 2;
+	const Size	size(12, 12);
+	const int	nNodes	= size.area();
+	vec_byte_t	vGroundTruth(nNodes);
+	Mat			pots(nNodes, nStates, CV_32FC1);
+	Mat			features(nNodes, 2, CV_32FC1);
+	RNG			rng(0xBEEF);
+	for (int n = 0; n < nNodes; n++) {
+		const int x = n % size.width;
+		const int y = n / size.width;
+		vGroundTruth[n] = x < size.width / 2 ? 0 : 1;
+		for (byte s = 0; s < nStates; s++) pots.at<float>(n, s) = rng.uniform(0.1f, 1.0f) + (s == vGroundTruth[n] ? 0.3f : 0.0f);
+		features.at<float>(n, 0) = x / 2.0f;
+		features.at<float>(n, 1) = y / 2.0f;
+	}
+
+	CGraphDense graph(nStates);
+	graph.addNodes(pots);
+	auto pModel = std::make_shared<CEdgeModelPotts>(features, 0.5f);
+	graph.addEdgeModel(pModel);
+
+	auto computeLoss = [&](vec_float_t &vWeightGrad, vec_mat_t &vCompatibilityGrad) {
+		pots.copyTo(graph.getNodePotentials());
+		CInferDense inferer(graph);
+		return inferer.computeGradient(vGroundTruth, 3, vWeightGrad, vCompatibilityGrad);
+	};
+
+	// Finite-difference check of the weight gradient
+	vec_float_t	vWeightGrad, vTemp;
+	vec_mat_t	vCompatibilityGrad, vTempMat;
+	const float loss0 = computeLoss(vWeightGrad, vCompatibilityGrad);
+	ASSERT_EQ(vWeightGrad.size(), 1);
+	ASSERT_EQ(vCompatibilityGrad[0].size(), Size(nStates, nStates));
+	
+	const float h = 1e-2f;
+	pModel->setWeight(0.5f + h);
+	const float lossPlus = computeLoss(vTemp, vTempMat);
+	pModel->setWeight(0.5f - h);
+	const float lossMinus = computeLoss(vTemp, vTempMat);
+	pModel->setWeight(0.5f);
+	ASSERT_NEAR(vWeightGrad[0], (lossPlus - lossMinus) / (2 * h), 0.05f * MAX(1e-3f, fabs(vWeightGrad[0])));
+
+	// Training decreases the loss and preserves the node potentials
+	CParamEstimationDense trainer(1.0f, 3);
+	trainer.train({ &graph }, { vGroundTruth }, 10);
+	ASSERT_EQ(countNonZero(graph.getNodePotentials() != pots), 0);
+	ASSERT_LT(computeLoss(vTemp, vTempMat), loss0);
+}
+
+TEST_F(CTestInference, inference_dense_compact_lattice)
+{
+	const byte	nStates = 3;
+	const int	nNodes	= 400;
+	Mat features(nNodes, 2, CV_32FC1);
+	for (int n = 0; n < nNodes; n++) {
+		features.at<float>(n, 0) = (n % 20) / 3.0f;
+		features.at<float>(n, 1) = (n / 20) / 3.0f;
+	}
+	Mat src = random::U(Size(nStates, nNodes), CV_32FC1);
+
+	CEdgeModelPotts model(features, 1.0f);
+	CEdgeModelPotts modelCompact(features, 1.0f, {}, true, true);
+	Mat dst, dstCompact;
+	model.apply(src, dst);
+	modelCompact.apply(src, dstCompact);
+	for (int n = 0; n < nNodes; n++)
+		for (int s = 0; s < nStates; s++)
+			ASSERT_NEAR(dstCompact.at<float>(n, s), dst.at<float>(n, s), 1e-2f * dst.at<float>(n, s));
+
+	// The values beyond the half precision range are scaled down in the lattice
+	const Mat large = 1e5 * src;
+	model.filter(large, dst);
+	modelCompact.filter(large, dstCompact);
+	ASSERT_TRUE(checkRange(dstCompact));
+	ASSERT_LT(norm(dstCompact, dst, NORM_INF), 1e-2 * norm(dst, NORM_INF));
+}
+
+TEST_F(CTestInference, inference_dense_opencl)
+{
+	if (!gpu::isAvailable()) GTEST_SKIP() << "OpenCL is not available";
+
+	const byte	nStates = 4;
+	const Size	size(24, 16);
+	Mat pots(size.height, size.width * nStates, CV_32FC1);
+	RNG(0xBEEF).fill(pots, RNG::UNIFORM, 0.1f, 1.0f);
+	pots = pots.reshape(nStates);
+
+	Mat vQ[2];
+	for (int ocl = 0; ocl < 2; ocl++) {
+		CGraphDense		graph(nStates);
+		CGraphDenseExt	graphExt(graph);
+		graphExt.setGraph(pots);
+		graphExt.addGaussianEdgeModel(Vec2f::all(3.0f), 3.0f);
+
+		CInferDense inferer(graph);
+		inferer.setOpenCL(ocl == 1);
+		inferer.infer(10);
+		vQ[ocl] = graph.getNodePotentials().clone();
+	}
+	ASSERT_LT(norm(vQ[0], vQ[1], NORM_INF), 1e-4);
+}
+
+TEST_F(CTestInference, inference_dense_compatibility)
+{
+	const byte	nStates = 3;
+	const int	nNodes	= 600;
+	Mat features(nNodes, 2, CV_32FC1);
+	for (int n = 0; n < nNodes; n++) {
+		features.at<float>(n, 0) = (n % 30) / 3.0f;
+		features.at<float>(n, 1) = (n / 30) / 3.0f;
+	}
+	Mat src = random::U(Size(nStates, nNodes), CV_32FC1);
+	Mat compatibility = random::U(Size(nStates, nStates), CV_32FC1);
+
+	CEdgeModelPotts			potts(features, 2.0f);
+	CEdgeModelCompatibility model(features, compatibility, 2.0f);
+	CEdgeModelCompatibility modelIdentity(features, Mat::eye(nStates, nStates, CV_32FC1), 2.0f);
+
+	// dst = exp(w * norm * Lattice.compute(src) x compatibility^T)
+	Mat filtered, expected;
+	potts.filter(src, filtered);
+	exp(2.0f * filtered * compatibility.t(), expected);
+
+	Mat dst, dstPotts, dstIdentity;
+	model.apply(src, dst);
+	potts.apply(src, dstPotts);
+	modelIdentity.apply(src, dstIdentity);
+	ASSERT_LT(norm(dst, expected, NORM_INF), 1e-4 * norm(expected, NORM_INF));
+	ASSERT_LT(norm(dstIdentity, dstPotts, NORM_INF), 1e-4 * norm(dstPotts, NORM_INF));
+}
+
+TEST_F(CTestInference, inference_dense_lattice_permutation)
+{
+	const byte	nStates = 2;
+	const int	nNodes	= 5000;
+	Mat features = random::U(Size(3, nNodes), CV_32FC1, 0.0, 20.0);
+	Mat src		 = random::U(Size(nStates, nNodes), CV_32FC1);
+
+	// The lattice is invariant to the order of the features, which are inserted into the lattice concurrently
+	vec_int_t vPermutation(nNodes);
+	for (int n = 0; n < nNodes; n++) vPermutation[n] = n;
+	std::reverse(vPermutation.begin(), vPermutation.end());
+	Mat featuresPermuted(features.size(), features.type());
+	Mat srcPermuted(src.size(), src.type());
+	for (int n = 0; n < nNodes; n++) {
+		features.row(vPermutation[n]).copyTo(featuresPermuted.row(n));
+		src.row(vPermutation[n]).copyTo(srcPermuted.row(n));
+	}
+
+	CEdgeModelPotts model(features, 1.0f);
+	CEdgeModelPotts modelPermuted(featuresPermuted, 1.0f);
+	Mat dst, dstPermuted;
+	model.filter(src, dst);
+	modelPermuted.filter(srcPermuted, dstPermuted);
+	for (int n = 0; n < nNodes; n++)
+		for (int s = 0; s < nStates; s++)
+			ASSERT_NEAR(dstPermuted.at<float>(n, s), dst.at<float>(vPermutation[n], s), 1e-4f * (1 + fabs(dst.at<float>(vPermutation[n], s))));
+}
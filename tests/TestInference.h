@@ -6,6 +6,11 @@
 
 using namespace DirectGraphicalModels;
 
+#ifndef GTEST_SKIP
+// The bundled gtest has no skipped state: the skipped test returns and is reported as passed
+#define GTEST_SKIP() return GTEST_SUCCESS_("Skipped")
+#endif
+
 class CTestInference : public ::testing::Test {
 public:
 	CTestInference(void);
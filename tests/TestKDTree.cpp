@@ -1,5 +1,6 @@
 #include "TestKDTree.h"
 #include "DGM/random.h"
+#include <algorithm>
 
 void CTestKDTree::fill_tree(CKDTree& tree) {
 
@@ -40,6 +41,29 @@ Mat  CTestKDTree::find_nearestNeighbor_bruteForce(const Mat& key)
 	return res;
 }
 
+// Compares the values of the k nearest neighbors with the ones, found by the brute-force search
+void CTestKDTree::checkKnn(const Mat &keys, const Mat &values, const Mat &queries, int k, const Mat &labels)
+{
+	std::vector<std::pair<int, byte>> vCandidates(keys.rows);
+	for (int i = 0; i < queries.rows; i++) {
+		const byte *pQuery = queries.ptr<byte>(i);
+		for (int s = 0; s < keys.rows; s++) {
+			const byte *pKey = keys.ptr<byte>(s);
+			int dist = 0;
+			for (int f = 0; f < keys.cols; f++) dist += (pKey[f] - pQuery[f]) * (pKey[f] - pQuery[f]);
+			vCandidates[s] = std::make_pair(dist, values.at<byte>(s, 0));
+		}
+		std::partial_sort(vCandidates.begin(), vCandidates.begin() + k + 1, vCandidates.end());
+		if (vCandidates[k - 1].first == vCandidates[k].first) continue;		// the set of the nearest neighbors is ambiguous
+
+		vec_byte_t vExpected, vActual(labels.ptr<byte>(i), labels.ptr<byte>(i) + k);
+		for (int j = 0; j < k; j++) vExpected.push_back(vCandidates[j].second);
+		std::sort(vExpected.begin(), vExpected.end());
+		std::sort(vActual.begin(), vActual.end());
+		ASSERT_EQ(vExpected, vActual);
+	}
+}
+
 TEST_F(CTestKDTree, findNearestNeighbor)
 {
 	CKDTree tree;
@@ -70,3 +94,181 @@ TEST_F(CTestKDTree, findNearestNeighbor)
 		ASSERT_FLOAT_EQ(bf_dist, nn_dist);
 	}
 }
+
+TEST_F(CTestKDTree, knnSearch)
+{
+	const int k = 5;
+
+	Mat keys(nSamples, nFeatures, CV_8UC1);
+	Mat values(nSamples, 1, CV_8UC1);
+	for (int s = 0; s < nSamples; s++) {
+		for (int f = 0; f < nFeatures; f++)
+			keys.at<byte>(s, f) = static_cast<byte>(random::u(0, 255));
+		values.at<byte>(s, 0) = static_cast<byte>(random::u(0, 255));
+	}
+	CKDTree tree;
+	tree.build(lvalue_cast(keys.clone()), values);
+
+	Mat queries(nTests, nFeatures, CV_8UC1);
+	for (int i = 0; i < nTests; i++)
+		for (int f = 0; f < nFeatures; f++)
+			queries.at<byte>(i, f) = static_cast<byte>(random::u(0, 255));
+
+	Mat labels;
+	tree.knnSearch(queries, k, labels);
+	ASSERT_EQ(nTests, labels.rows);
+	ASSERT_EQ(k, labels.cols);
+
+	checkKnn(keys, values, queries, k, labels);
+}
+
+TEST_F(CTestKDTree, knnSearch_approximate)
+{
+	const int k = 5;
+
+	CKDTree tree;
+	fill_tree(tree);
+
+	Mat queries(nTests, nFeatures, CV_8UC1);
+	for (int i = 0; i < nTests; i++)
+		for (int f = 0; f < nFeatures; f++)
+			queries.at<byte>(i, f) = 5 * random::u(0, 51) + 1;
+
+	Mat exact, approximate, unbounded;
+	tree.knnSearch(queries, k, exact);
+	tree.knnSearch(queries, k, approximate, 2 * k);
+	tree.knnSearch(queries, k, unbounded, nSamples);
+
+	ASSERT_EQ(exact.size(), approximate.size());
+	ASSERT_EQ(0, norm(exact, unbounded, NORM_L1));
+
+	// Recall: the fraction of the found neighbors, which are not farther than the k-th nearest neighbor, found by the brute force
+	Mat keys, values;
+	tree.getKeys(keys, values);
+	std::vector<int> vKthDistances(nTests);
+	for (int i = 0; i < nTests; i++) {
+		std::vector<int> vDistances(keys.rows, 0);
+		for (int s = 0; s < keys.rows; s++)
+			for (int f = 0; f < nFeatures; f++) {
+				const int diff = static_cast<int>(keys.at<byte>(s, f)) - static_cast<int>(queries.at<byte>(i, f));
+				vDistances[s] += diff * diff;
+			}
+		std::nth_element(vDistances.begin(), vDistances.begin() + k - 1, vDistances.end());
+		vKthDistances[i] = vDistances[k - 1];
+	}
+	auto getRecall = [&](size_t maxLeafVisits) {
+		Mat labels, distances;
+		tree.knnSearch(queries, k, labels, distances, maxLeafVisits);
+		int nFound = 0;
+		for (int i = 0; i < nTests; i++)
+			for (int j = 0; j < k; j++)
+				if (distances.at<int>(i, j) <= vKthDistances[i]) nFound++;
+		return static_cast<float>(nFound) / (nTests * k);
+	};
+
+	// The leaves are visited in the same order, thus the larger budgets may only improve the neighbors. The minimal recalls are about 0.1 below 
+	// the typical ones for the uniformly distributed 16-dimensional keys
+	const float recallSmall		= getRecall(2 * k);
+	const float recallMedium	= getRecall(nSamples / 10);
+	const float recallLarge		= getRecall(nSamples / 4);
+	ASSERT_GT(recallSmall, 0.0f);
+	ASSERT_LE(recallSmall, recallMedium);
+	ASSERT_LE(recallMedium, recallLarge);
+	ASSERT_GE(recallMedium, 0.7f);
+	ASSERT_GE(recallLarge, 0.85f);
+	ASSERT_FLOAT_EQ(1.0f, getRecall(0));
+}
+
+TEST_F(CTestKDTree, build_duplicates)
+{
+	const int nUnique = 1000;
+
+	Mat keys(nUnique, nFeatures, CV_8UC1);
+	for (int s = 0; s < nUnique; s++)
+		for (int f = 0; f < nFeatures; f++)
+			keys.at<byte>(s, f) = static_cast<byte>(random::u(0, 255));
+	Mat values(nUnique, 1, CV_8UC1, Scalar(1));
+
+	// every (key, value) pair is added three times and every key once again with another value
+	Mat allKeys, allValues;
+	for (int i = 0; i < 3; i++) {
+		allKeys.push_back(keys);
+		allValues.push_back(values);
+	}
+	allKeys.push_back(keys);
+	allValues.push_back(Mat(nUnique, 1, CV_8UC1, Scalar(2)));
+
+	CKDTree tree;
+	tree.build(allKeys, allValues);
+
+	Mat labels;
+	tree.knnSearch(keys.row(0), 4 * nUnique, labels);
+	ASSERT_EQ(2 * nUnique, labels.cols);
+	ASSERT_EQ(nUnique, countNonZero(labels == 1));
+}
+
+TEST_F(CTestKDTree, forest_knnSearch)
+{
+	const int k = 5;
+
+	Mat keys(nSamples, nFeatures, CV_8UC1);
+	Mat values(nSamples, 1, CV_8UC1);
+	for (int s = 0; s < nSamples; s++) {
+		for (int f = 0; f < nFeatures; f++)
+			keys.at<byte>(s, f) = static_cast<byte>(random::u(0, 255));
+		values.at<byte>(s, 0) = static_cast<byte>(random::u(0, 255));
+	}
+
+	// The keys are added in chunks of different sizes, so that the trees of several levels, merged trees and the buffer are searched
+	CKDForest forest(256);
+	for (int s = 0; s < nSamples; ) {
+		const int n = MIN(nSamples - s, random::u(1, 1500));
+		forest.add(keys.rowRange(s, s + n), values.rowRange(s, s + n));
+		s += n;
+	}
+	ASSERT_EQ(nSamples, forest.getNumKeys());
+	ASSERT_GT(forest.getNumLevels(), 1);
+
+	Mat queries(nTests, nFeatures, CV_8UC1);
+	for (int i = 0; i < nTests; i++)
+		for (int f = 0; f < nFeatures; f++)
+			queries.at<byte>(i, f) = static_cast<byte>(random::u(0, 255));
+
+	Mat labels;
+	forest.knnSearch(queries, k, labels);
+	ASSERT_EQ(nTests, labels.rows);
+	ASSERT_EQ(k, labels.cols);
+
+	checkKnn(keys, values, queries, k, labels);
+}
+
+TEST_F(CTestKDTree, save_load)
+{
+	const int k = 5;
+	const std::string fileName = "test_kdtree.dgm";
+
+	CKDTree tree;
+	fill_tree(tree);
+	tree.save(fileName);
+
+	CKDTree loaded;
+	loaded.load(fileName);
+	remove(fileName.c_str());
+
+	Mat queries(nTests, nFeatures, CV_8UC1);
+	for (int i = 0; i < nTests; i++)
+		for (int f = 0; f < nFeatures; f++)
+			queries.at<byte>(i, f) = 5 * random::u(0, 51) + 1;
+
+	Mat expected, actual;
+	tree.knnSearch(queries, k, expected);
+	loaded.knnSearch(queries, k, actual);
+	ASSERT_EQ(0, norm(expected, actual, NORM_L1));
+
+	for (int i = 0; i < nTests; i++) {
+		// There might be multiple points with the same distance to the query. So we compare the distances
+		Mat expectedKey = tree.findNearestNeighbor(queries.row(i))->getKey();
+		Mat actualKey	= loaded.findNearestNeighbor(queries.row(i))->getKey();
+		ASSERT_DOUBLE_EQ(norm(queries.row(i), expectedKey, NORM_L2SQR), norm(queries.row(i), actualKey, NORM_L2SQR));
+	}
+}
@@ -15,6 +15,7 @@ public:
 protected:
 	void fill_tree(CKDTree& tree);
 	Mat  find_nearestNeighbor_bruteForce(const Mat& key);
+	void checkKnn(const Mat &keys, const Mat &values, const Mat &queries, int k, const Mat &labels);
 
 
 private:
@@ -35,3 +35,96 @@ TEST_F(CTestPDF, PDF_Gaussian) {
 	CPDFGaussian pdf;
 	testPDF_1D(pdf);
 }
+
+TEST_F(CTestPDF, PDF_batch_densities) {
+	CPDFHistogram	pdf;
+	CPDFGaussian	pdfGauss;
+	CPDFHistogram2D	pdf2D;
+	for (int i = 0; i < 10000; i++) {
+		Scalar point(random::u<int>(50, 150), random::u<int>(0, 255));
+		pdf.addPoint(point);
+		pdfGauss.addPoint(point);
+		pdf2D.addPoint(point);
+	}
+
+	Mat points		= random::U(Size(2, 1000), CV_8UC1, 0.0, 255.0);
+	Mat points32F;
+	points.convertTo(points32F, CV_32FC1);
+	Mat densities, densities32F;
+	for (int smooth = 0; smooth < 2; smooth++) {
+		for (IPDF *pPdf : { static_cast<IPDF *>(&pdf), static_cast<IPDF *>(&pdfGauss), static_cast<IPDF *>(&pdf2D) }) {
+			pPdf->getDensities(points, densities);
+			pPdf->getDensities(points32F, densities32F);
+			ASSERT_EQ(points.rows, densities.rows);
+			for (int i = 0; i < points.rows; i++) {
+				double density = pPdf->getDensity(Scalar(points.at<byte>(i, 0), points.at<byte>(i, 1)));
+				ASSERT_NEAR(density, densities.at<float>(i, 0), 1e-6);
+				ASSERT_NEAR(density, densities32F.at<float>(i, 0), 1e-6);
+			}
+		}
+		// The cached table has to follow the smoothed histograms
+		pdf.smooth(3);
+		pdf2D.smooth(1);
+	}
+
+	// The outdated table is filled once, while the densities are requested concurrently
+	pdf.addPoint(Scalar(200));
+	pdf.getDensities(points, densities);
+	pdf.addPoint(Scalar(201));
+	std::vector<Mat> vDensities(16);
+	parallel::parallelFor(Range(0, static_cast<int>(vDensities.size())), [&](const Range &range) {
+		for (int t = range.start; t < range.end; t++) pdf.getDensities(points, vDensities[t]);
+	}, 1);
+	for (const Mat &res : vDensities)
+		for (int i = 0; i < points.rows; i++)
+			ASSERT_NEAR(pdf.getDensity(Scalar(points.at<byte>(i, 0))), res.at<float>(i, 0), 1e-6);
+}
+
+TEST_F(CTestPDF, KDGauss_finalize) {
+	const int k = 4;
+	Mat A = random::U(Size(k, k), CV_64FC1, -1.0, 1.0);
+	Mat sigma = A * A.t() + Mat::eye(k, k, CV_64FC1);
+	CKDGauss gauss(k);
+	gauss.setMu(random::U(Size(1, k), CV_64FC1, -1.0, 1.0));
+	gauss.setSigma(sigma);
+	gauss.finalize();
+
+	Mat sigmaInv;
+	invert(sigma, sigmaInv, DECOMP_SVD);
+	const int nPoints = 1000;
+	Mat points = random::U(Size(nPoints, k), CV_64FC1, -3.0, 3.0);
+	std::vector<double> vValues(nPoints);
+	parallel::parallelFor(Range(0, nPoints), [&](const Range &range) {				// the finalized Gaussian is evaluated concurrently
+		for (int i = range.start; i < range.end; i++) vValues[i] = gauss.getValue(points.col(i));
+	});
+	for (int i = 0; i < nPoints; i++) {
+		const Mat	 x		= points.col(i);
+		const double maha	= Mahalanobis(x, gauss.getMu(), sigmaInv);
+		ASSERT_NEAR(vValues[i], exp(-0.5 * maha * maha), 1e-12);
+		ASSERT_NEAR(gauss.getMahalanobisDistance(x), maha, 1e-9);
+		ASSERT_NEAR(gauss.getLogValue(x), log(static_cast<double>(gauss.getAlpha()) * vValues[i]), 1e-9);
+	}
+	ASSERT_NEAR(gauss.getLogAlpha(), -0.5 * log(determinant(sigma)) - 0.5 * k * log(2 * Pi), 1e-9);
+}
+
+TEST_F(CTestPDF, KDGauss_rank_one_update) {
+	const int k = 5;
+	for (bool approximate : { false, true }) {
+		CKDGauss gauss(k);
+		for (int i = 0; i < 600; i++) {
+			gauss.addPoint(random::U(Size(1, k), CV_64FC1, -1.0, 1.0), approximate);
+			if (i == 20) gauss.finalize();												// the further updates keep the inverse and the coefficient
+		}
+
+		// The same Gaussian with the re-calculated inverse and coefficient
+		CKDGauss ref(k);
+		ref.setMu(gauss.getMu());
+		ref.setSigma(gauss.getSigma());
+		for (int i = 0; i < 100; i++) {
+			Mat x = random::U(Size(1, k), CV_64FC1, -2.0, 2.0);
+			ASSERT_NEAR(gauss.getMahalanobisDistance(x), ref.getMahalanobisDistance(x), 1e-6);
+		}
+		ASSERT_NEAR(gauss.getLogAlpha(), ref.getLogAlpha(), 1e-6);
+		ASSERT_NEAR(static_cast<double>(gauss.getAlpha() / ref.getAlpha()), 1.0, 1e-6);
+	}
+}
@@ -31,6 +31,32 @@ void CTestParamEstimation::testParamEstimation(CParamEstimation& paramEstimator)
 		ASSERT_GE(m_vInitDeltas[i], fabs(vParams[i] - m_vSolution[i]));
 }
 
+void CTestParamEstimation::testBatchParamEstimation(CParamEstimation& paramEstimator)
+{
+	for (size_t i = 0; i < nParams; i++) {
+		m_vInitParams[i] = random::U<float>(-10, 10);
+		m_vInitDeltas[i] = 1e-4f;						// accuracy
+		m_vSolution[i]	 = random::U<float>(-10, 10);
+	}
+
+	paramEstimator.setInitParams(m_vInitParams);
+	paramEstimator.setDeltas(m_vInitDeltas);
+
+	CGraphPairwise graph(2);
+	graph.addNodes(Mat(4, 2, CV_32FC1, Scalar(0.5f)));
+	vec_float_t vParams = paramEstimator.optimize(graph, [&](const vec_float_t& vParams, CGraph& graphCopy) {
+		graphCopy.setNode(0, Mat(2, 1, CV_32FC1, Scalar(0.0f)));		// the copies are independent
+		return objectiveFunction(vParams);
+	});
+
+	// Check result
+	Mat pot;
+	graph.getNode(0, pot);
+	ASSERT_EQ(0.5f, pot.at<float>(0, 0));
+	for (size_t i = 0; i < nParams; i++) 
+		ASSERT_GE(m_vInitDeltas[i], fabs(vParams[i] - m_vSolution[i]));
+}
+
 float CTestParamEstimation::objectiveFunction(const vec_float_t& vParams)
 {
 	float res = 0;
@@ -43,14 +69,139 @@ float CTestParamEstimation::objectiveFunction(const vec_float_t& vParams)
 }
 
 
+void CTestParamEstimation::buildFlippedHalves(CGraphPairwiseKit &graphKit, Size size, vec_byte_t &gt)
+{
+	graphKit.getGraphExt().buildGraph(size);
+	Mat pots(size, CV_32FC2);
+	gt.resize(size.area());
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			const byte s		= x < size.width / 2 ? 0 : 1;
+			const byte label	= (x * 7 + y * 13) % 4 == 0 ? 1 - s : s;
+			gt[y * size.width + x] = s;
+			pots.at<Vec2f>(y, x) = label == 0 ? Vec2f(0.7f, 0.3f) : Vec2f(0.3f, 0.7f);
+		}
+	graphKit.getGraphExt().setGraph(pots);
+}
+
+float CTestParamEstimation::getAccuracy(const vec_byte_t &solution, const vec_byte_t &gt)
+{
+	int nCorrect = 0;
+	for (size_t n = 0; n < solution.size(); n++) if (solution[n] == gt[n]) nCorrect++;
+	return static_cast<float>(nCorrect) / solution.size();
+}
+
 TEST_F(CTestParamEstimation, Powell) 
 {
 	CParamEstimationPowell powell(nParams);
 	testParamEstimation(powell);
 }
 
+TEST_F(CTestParamEstimation, Powell_batch)
+{
+	CParamEstimationPowell powell(nParams);
+	testBatchParamEstimation(powell);
+}
+
+TEST_F(CTestParamEstimation, BO)
+{
+	// A smooth objective with few parameters: the method should approach the maximum with tens of evaluations.
+	// The random points of the search are reproducible, thus the test does not depend on the start of the application
+	const uint64_t seed = random::getSeed();
+	random::seed(0xB0);
+	const vec_float_t vSolution = { random::U<float>(-1, 1), random::U<float>(-1, 1) };
+	auto objective = [&](const vec_float_t& vParams) {
+		float res = 10;
+		for (size_t i = 0; i < vParams.size(); i++) res -= (vParams[i] - vSolution[i]) * (vParams[i] - vSolution[i]);
+		return res;
+	};
+
+	for (bool batch : { false, true }) {
+		CParamEstimationBO bo(vSolution.size());
+		bo.setMinParams({ -2, -2 });
+		bo.setMaxParams({ 2, 2 });
+		bo.setMaxEvaluations(40);
+
+		vec_float_t vParams(vSolution.size(), 0.0f);
+		if (batch) {
+			CGraphPairwise graph(2);
+			vParams = bo.optimize(graph, [&](const vec_float_t& vParams, CGraph&) { return objective(vParams); });
+		} 
+		else
+			while (!bo.isConverged()) vParams = bo.getParams(objective(vParams));
+
+		for (size_t i = 0; i < vSolution.size(); i++)
+			EXPECT_GE(0.2f, fabs(vParams[i] - vSolution[i]));
+	}
+	random::seed(seed);
+}
+
 TEST_F(CTestParamEstimation, PSO)
 {
 	CParamEstimationPSO pso(nParams);
   testParamEstimation(pso);
 }
+
+TEST_F(CTestParamEstimation, PSO_batch)
+{
+	CParamEstimationPSO pso(nParams);
+	testBatchParamEstimation(pso);
+}
+
+TEST_F(CTestParamEstimation, edge_tuner)
+{
+	const byte	nStates = 2;
+	const Size	size	= Size(24, 24);
+
+	CGraphPairwiseKit graphKit(nStates, INFER::TRW);
+	vec_byte_t gt;
+	buildFlippedHalves(graphKit, size, gt);
+
+	CEdgeTuner tuner(dynamic_cast<IGraphPairwise &>(graphKit.getGraph()), INFER::TRW, [nStates](const vec_float_t &vParams, IGraphPairwise &graph) {
+		Mat pot(nStates, nStates, CV_32FC1, Scalar(1.0f));
+		for (byte s = 0; s < nStates; s++) pot.at<float>(s, s) = MAX(1.0f, vParams[0]);
+		graph.setEdges(std::nullopt, pot);
+	}, [&gt](const vec_byte_t &solution) { return getAccuracy(solution, gt); }, 20);
+
+	const float accuracy = tuner.evaluate({ 1.0f });								// no smoothing
+	ASSERT_FLOAT_EQ(0.75f, accuracy);
+
+	CParamEstimationPowell powell(1);
+	powell.setInitParams({ 1.0f });
+	powell.setDeltas({ 0.5f });
+	powell.setMinParams({ 1.0f });
+	powell.setMaxParams({ 20.0f });
+	const vec_float_t vParams = tuner.optimize(powell);
+	ASSERT_LT(accuracy, tuner.evaluate(vParams));
+	ASSERT_GE(tuner.getNumCopies(), 1u);
+
+	// The original graph is not changed
+	Mat pot;
+	graphKit.getGraph().getNode(0, pot);
+	ASSERT_EQ(0.7f, pot.at<float>(1, 0));
+}
+
+TEST_F(CTestParamEstimation, PL)
+{
+	const byte	nStates = 2;
+	const Size	size	= Size(24, 24);
+
+	CGraphPairwiseKit graphKit(nStates, INFER::TRW);
+	vec_byte_t gt;
+	buildFlippedHalves(graphKit, size, gt);
+	IGraphPairwise &graph = dynamic_cast<IGraphPairwise &>(graphKit.getGraph());
+	graph.setEdges(std::nullopt, Mat(nStates, nStates, CV_32FC1, Scalar(1.0f)));
+
+	const float accuracy = getAccuracy(graphKit.getInfer().decode(20), gt);			// no smoothing
+	ASSERT_FLOAT_EQ(0.75f, accuracy);
+
+	CParamEstimationPL trainer;
+	const float loss = trainer.train({ &graph }, { gt });
+	ASSERT_LT(loss, logf(2.0f));
+	ASSERT_GT(trainer.getNodeWeight(), 0.0f);
+	ASSERT_GT(trainer.getPottsParam(0), 0.0f);
+	ASSERT_FLOAT_EQ(0.0f, trainer.getPottsParam(1));
+
+	trainer.apply(graph);
+	ASSERT_LT(accuracy, getAccuracy(graphKit.getInfer().decode(20), gt));
+}
@@ -20,7 +20,12 @@ public:
 
 protected:	
 	void	testParamEstimation(CParamEstimation& paramEstimator);
+	void	testBatchParamEstimation(CParamEstimation& paramEstimator);
 	float	objectiveFunction(const vec_float_t& vParams);
+	// Builds the binary graph of two halves with 25% of the pixels flipped in the node potentials and returns the ground truth
+	void	buildFlippedHalves(CGraphPairwiseKit &graphKit, Size size, vec_byte_t &gt);
+	// Returns the fraction of the solution, which agrees with the ground truth
+	static float getAccuracy(const vec_byte_t &solution, const vec_byte_t &gt);
 
 private:
 	vec_float_t m_vInitParams;
@@ -0,0 +1,887 @@
+#include "TestTrain.h"
+#include "DGM/random.h"
+#include <array>
+
+// Generates the feature vectors of the states, which occupy the separate intervals [80 s; 80 s + spread] of every feature
+Mat CTestTrain::getTrainingData(Size size, Mat &gt, int spread) const
+{
+	if (gt.empty()) {
+		gt.create(size, CV_8UC1);
+		for (int y = 0; y < size.height; y++)
+			for (int x = 0; x < size.width; x++) gt.at<byte>(y, x) = static_cast<byte>(random::u(0, nStates - 1));
+	}
+	Mat featureVectors(size, CV_8UC(nFeatures));
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			byte	   *pFv = featureVectors.ptr<byte>(y) + x * nFeatures;
+			const byte	s	= gt.at<byte>(y, x);
+			for (word f = 0; f < nFeatures; f++) pFv[f] = static_cast<byte>(random::u(80 * s, 80 * s + spread));
+		}
+	return featureVectors;
+}
+
+// Trains the <nodeTrainer> and compares the block node potentials with the ones, estimated sample by sample
+void CTestTrain::testNodePotentials(CTrainNode &nodeTrainer)
+{
+	Mat gt;
+	Mat featureVectors = getTrainingData(Size(width, height), gt);
+	Mat weights(height, width, CV_32FC1);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) weights.at<float>(y, x) = random::U(0.5f, 2.0f);
+
+	nodeTrainer.addFeatureVecs(featureVectors, gt);
+	nodeTrainer.train();
+
+	vec_mat_t vFeatureVectors;
+	split(featureVectors, vFeatureVectors);
+
+	Mat pots1 = nodeTrainer.getNodePotentials(featureVectors, weights);
+	Mat pots2 = nodeTrainer.getNodePotentials(vFeatureVectors, weights);
+	ASSERT_EQ(pots1.size(), featureVectors.size());
+	ASSERT_EQ(pots1.type(), CV_32FC(nStates));
+
+	Mat vec(nFeatures, 1, CV_8UC1);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) {
+			for (word f = 0; f < nFeatures; f++) vec.at<byte>(f, 0) = featureVectors.ptr<byte>(y)[x * nFeatures + f];
+			Mat pot = nodeTrainer.getNodePotentials(vec, weights.at<float>(y, x));
+			const float *pPots1 = pots1.ptr<float>(y) + x * nStates;
+			const float *pPots2 = pots2.ptr<float>(y) + x * nStates;
+			for (byte s = 0; s < nStates; s++) {
+				ASSERT_NEAR(pot.at<float>(s, 0), pPots1[s], 1e-3f);
+				ASSERT_EQ(pPots1[s], pPots2[s]);
+			}
+		}
+}
+
+// Trains the <nodeTrainer>, saves it into the model container and compares its node potentials with the ones of the <loadedTrainer>, loaded from the container
+void CTestTrain::testModelFile(CTrainNode &nodeTrainer, CTrainNode &loadedTrainer)
+{
+	testNodePotentials(nodeTrainer);
+	const std::string fileName = "test_model_file.dgm";
+	nodeTrainer.saveModel(fileName);
+
+	Mat featureVectors(height, width, CV_8UC(nFeatures));
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			for (word f = 0; f < nFeatures; f++) featureVectors.ptr<byte>(y)[x * nFeatures + f] = static_cast<byte>(random::u(0, 255));
+	Mat pots = nodeTrainer.getNodePotentials(featureVectors);
+
+	for (bool mapped : { true, false }) {
+		loadedTrainer.loadModel(fileName, mapped, true);
+		ASSERT_EQ(0, norm(pots, loadedTrainer.getNodePotentials(featureVectors), NORM_INF));
+	}
+	remove(fileName.c_str());
+}
+
+TEST_F(CTestTrain, node_potentials_Bayes)
+{
+	CTrainNodeBayes nodeTrainer(nStates, nFeatures);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_potentials_GMM)
+{
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_potentials_GMM_EM)
+{
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+	nodeTrainer.setEM(true);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_trainer_GMM_compact)
+{
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures, TrainNodeGMMParams(16, 16, 16, -16, -16));
+	testNodePotentials(nodeTrainer);
+
+	Mat gt;
+	Mat featureVectors = getTrainingData(Size(width, height), gt);
+	Mat pots = nodeTrainer.getNodePotentials(featureVectors);
+
+	// Without the loss budget and with the sufficient number of Gaussians nothing is merged
+	size_t nGausses = 0;
+	for (byte s = 0; s < nStates; s++) nGausses = MAX(nGausses, nodeTrainer.getNumGausses(s));
+	ASSERT_EQ(nodeTrainer.compact(static_cast<word>(nGausses)), 0);
+	ASSERT_EQ(countNonZero(nodeTrainer.getNodePotentials(featureVectors).reshape(1) != pots.reshape(1)), 0);
+
+	// With one Gaussian per state the classification of the well-separated states is kept
+	ASSERT_GE(nodeTrainer.compact(1), 0);
+	for (byte s = 0; s < nStates; s++) ASSERT_LE(nodeTrainer.getNumGausses(s), 1);
+	Mat compactPots = nodeTrainer.getNodePotentials(featureVectors);
+	int nErrors = 0;
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) {
+			const float *pPot1 = pots.ptr<float>(y) + x * nStates;
+			const float *pPot2 = compactPots.ptr<float>(y) + x * nStates;
+			if (std::max_element(pPot1, pPot1 + nStates) - pPot1 != std::max_element(pPot2, pPot2 + nStates) - pPot2) nErrors++;
+		}
+	ASSERT_LE(nErrors, height * width / 100);
+}
+
+TEST_F(CTestTrain, node_trainer_GMM_block)
+{
+	const Size size(64, 48);																// one block without workers
+	Mat gt;
+	Mat featureVectors = getTrainingData(size, gt);
+
+	// The block accumulation reaches the same mixtures as the sample by sample one, with the Euclidean and with the Mahalanobis distances
+	for (const TrainNodeGMMParams &params : { TRAIN_NODE_GMM_PARAMS_DEFAULT, TrainNodeGMMParams(8, 16, 64, 0, -16) }) {
+		CTrainNodeGMM blockTrainer(nStates, nFeatures, params);
+		CTrainNodeGMM sampleTrainer(nStates, nFeatures, params);
+		blockTrainer.addFeatureVecs(featureVectors, gt);
+		Mat vec(nFeatures, 1, CV_8UC1);
+		for (int y = 0; y < size.height; y++)
+			for (int x = 0; x < size.width; x++) {
+				for (word f = 0; f < nFeatures; f++) vec.at<byte>(f, 0) = featureVectors.ptr<byte>(y)[x * nFeatures + f];
+				sampleTrainer.addFeatureVec(vec, gt.at<byte>(y, x));
+			}
+		blockTrainer.train();
+		sampleTrainer.train();
+
+		Mat pots1 = blockTrainer.getNodePotentials(featureVectors);
+		Mat pots2 = sampleTrainer.getNodePotentials(featureVectors);
+		ASSERT_EQ(countNonZero(pots1.reshape(1) != pots2.reshape(1)), 0);
+	}
+}
+
+TEST_F(CTestTrain, node_potentials_KNN)
+{
+	CTrainNodeKNN nodeTrainer(nStates, nFeatures);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_potentials_KNN_incremental)
+{
+	CTrainNodeKNN nodeTrainer(nStates, nFeatures);
+	nodeTrainer.setIncremental(true);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_potentials_CvRF)
+{
+	CTrainNodeCvRF nodeTrainer(nStates, nFeatures);
+	testNodePotentials(nodeTrainer);
+}
+
+namespace {
+	// Exposes the OpenCV SVM of the trainer
+	class CTrainNodeCvSVMProbe : public CTrainNodeCvSVM {
+	public:
+		using CTrainNodeCvSVM::CTrainNodeCvSVM;
+		using CTrainNodeCvSVM::m_pSVM;
+	};
+
+	// Returns the states of the maximal potentials: Mat(size: nSamples x 1; type: CV_32SC1)
+	Mat argmax(const Mat &pots)
+	{
+		const Mat pots1 = pots.reshape(1, static_cast<int>(pots.total()));
+		Mat res(pots1.rows, 1, CV_32SC1);
+		for (int n = 0; n < pots1.rows; n++) {
+			Point maxLoc;
+			minMaxLoc(pots1.row(n), NULL, NULL, NULL, &maxLoc);
+			res.at<int>(n, 0) = maxLoc.x;
+		}
+		return res;
+	}
+}
+
+TEST_F(CTestTrain, node_potentials_CvSVM_linear)
+{
+	CTrainNodeCvSVMProbe nodeTrainer(nStates, nFeatures);
+	nodeTrainer.setKernel(ml::SVM::LINEAR);
+	testNodePotentials(nodeTrainer);
+
+	// The decision functions agree with the prediction of OpenCV; only the samples on the class boundaries may be rounded differently
+	Mat featureVectors = random::U(Size(width, height), CV_8UC(nFeatures), 0, 256);
+	Mat fm, prediction;
+	featureVectors.reshape(1, width * height).convertTo(fm, CV_32FC1);
+	nodeTrainer.m_pSVM->predict(fm, prediction);
+	prediction.convertTo(prediction, CV_32SC1);
+	ASSERT_LE(countNonZero(prediction != argmax(nodeTrainer.getNodePotentials(featureVectors))), width * height / 100);
+
+	// The stored class labels: the absent state has no decision functions
+	Mat gt(height, width, CV_8UC1);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) gt.at<byte>(y, x) = static_cast<byte>(random::u(0, 1) ? nStates - 1 : 0);
+	featureVectors = getTrainingData(Size(width, height), gt);
+	CTrainNodeCvSVM partialTrainer(nStates, nFeatures), loadedTrainer(nStates, nFeatures);
+	partialTrainer.setKernel(ml::SVM::LINEAR);
+	partialTrainer.addFeatureVecs(featureVectors, gt);
+	partialTrainer.train();
+	partialTrainer.save("", "test_svm");
+	loadedTrainer.load("", "test_svm");
+	remove("test_svm.dat");
+	const Mat pots = partialTrainer.getNodePotentials(featureVectors);
+	ASSERT_EQ(0, norm(pots, loadedTrainer.getNodePotentials(featureVectors), NORM_INF));
+	ASSERT_EQ(0, countNonZero(argmax(pots) == 1));
+}
+
+#ifdef USE_SHERWOOD
+TEST_F(CTestTrain, node_potentials_MsRF)
+{
+	CTrainNodeMsRF nodeTrainer(nStates, nFeatures);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_trainer_MsRF_seed)
+{
+	Mat gt;
+	Mat featureVectors = getTrainingData(Size(width, height), gt, 100);
+
+	// The forests, trained in parallel with the same seed, are the same
+	Mat vPots[2];
+	for (Mat &pots : vPots) {
+		CTrainNodeMsRF nodeTrainer(nStates, nFeatures);
+		nodeTrainer.addFeatureVecs(featureVectors, gt);
+		random::seed(42);
+		nodeTrainer.train();
+		pots = nodeTrainer.getNodePotentials(featureVectors);
+	}
+	ASSERT_EQ(countNonZero(vPots[0].reshape(1) != vPots[1].reshape(1)), 0);
+}
+#endif
+
+TEST_F(CTestTrain, model_file_Bayes)
+{
+	CTrainNodeBayes nodeTrainer(nStates, nFeatures);
+	CTrainNodeBayes loadedTrainer(nStates, nFeatures);
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+
+TEST_F(CTestTrain, model_file_GMM)
+{
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+	CTrainNodeGMM loadedTrainer(nStates, nFeatures);
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+
+TEST_F(CTestTrain, model_file_GMM_EM)
+{
+	// The mixtures, trained with EM, are loaded by the sequential trainer
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+	CTrainNodeGMM loadedTrainer(nStates, nFeatures);
+	nodeTrainer.setEM(true, 10000);
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+
+TEST_F(CTestTrain, model_file_KNN)
+{
+	CTrainNodeKNN nodeTrainer(nStates, nFeatures);
+	CTrainNodeKNN loadedTrainer(nStates, nFeatures);
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+
+TEST_F(CTestTrain, model_file_KNN_incremental)
+{
+	CTrainNodeKNN nodeTrainer(nStates, nFeatures);
+	CTrainNodeKNN loadedTrainer(nStates, nFeatures);
+	nodeTrainer.setIncremental(true);
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+
+#ifdef USE_SHERWOOD
+TEST_F(CTestTrain, model_file_MsRF)
+{
+	CTrainNodeMsRF nodeTrainer(nStates, nFeatures);
+	CTrainNodeMsRF loadedTrainer(nStates, nFeatures);
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+#endif
+
+TEST_F(CTestTrain, model_file_cascade)
+{
+	// The cascade is stored with the default implementation, based on saveFile()
+	CTrainNodeCascade nodeTrainer(nStates, nFeatures, { std::make_shared<CTrainNodeBayes>(nStates, nFeatures), std::make_shared<CTrainNodeGMM>(nStates, nFeatures) });
+	CTrainNodeCascade loadedTrainer(nStates, nFeatures, { std::make_shared<CTrainNodeBayes>(nStates, nFeatures), std::make_shared<CTrainNodeGMM>(nStates, nFeatures) });
+	testModelFile(nodeTrainer, loadedTrainer);
+}
+
+namespace {
+	// Votes for its own state: confidently for the samples with the first feature below 128 (if enabled), and weakly for the other ones.
+	// Counts the samples, it is applied to
+	class CTrainNodeStage : public CTrainNode {
+	public:
+		CTrainNodeStage(byte nStates, word nFeatures, byte state, bool confident) : CBaseRandomModel(nStates), CTrainNode(nStates, nFeatures), m_state(state), m_confident(confident) {}
+
+		void	reset(void) override {}
+		void	addFeatureVec(const Mat &, byte) override {}
+
+		mutable std::atomic<size_t> m_nSamples{ 0 };
+
+
+	protected:
+		void	saveFile(FILE *) const override {}
+		void	loadFile(FILE *) override {}
+		void	calculateNodePotentials(const Mat &featureVector, Mat &potential, Mat &mask) const override
+		{
+			m_nSamples++;
+			vote(featureVector.at<byte>(0, 0), potential.ptr<float>());
+		}
+		void	calculateNodePotentials(const Mat &featureMatrix, Mat &potentials) const override
+		{
+			m_nSamples += featureMatrix.rows;
+			potentials.create(featureMatrix.rows, getNumStates(), CV_32FC1);
+			for (int i = 0; i < featureMatrix.rows; i++) vote(featureMatrix.at<byte>(i, 0), potentials.ptr<float>(i));
+		}
+
+
+	private:
+		void	vote(byte feature, float *pPot) const
+		{
+			const bool confident = m_confident && feature < 128;
+			for (byte s = 0; s < getNumStates(); s++) pPot[s] = s == m_state ? 1.0f : (confident ? 0.01f : 0.9f);
+		}
+
+
+	private:
+		byte	m_state;
+		bool	m_confident;
+	};
+}
+
+TEST_F(CTestTrain, cascade_early_exit)
+{
+	// Only the samples, which are not classified confidently by the first stage, reach the second one
+	Mat featureVectors = random::U(Size(width, height), CV_8UC(nFeatures), 0, 256);
+	auto pStage1 = std::make_shared<CTrainNodeStage>(nStates, nFeatures, 0, true);
+	auto pStage2 = std::make_shared<CTrainNodeStage>(nStates, nFeatures, 1, false);
+	CTrainNodeCascade nodeTrainer(nStates, nFeatures, { pStage1, pStage2 }, 0.9f);
+
+	size_t nHard = 0;
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			if (featureVectors.ptr<byte>(y)[x * nFeatures] >= 128) nHard++;
+	ASSERT_GT(nHard, 0);
+	ASSERT_LT(nHard, static_cast<size_t>(width * height));
+
+	auto check = [&](int y, int x, const float *pPot) {
+		const byte expected = featureVectors.ptr<byte>(y)[x * nFeatures] < 128 ? 0 : 1;
+		ASSERT_EQ(expected, static_cast<byte>(std::max_element(pPot, pPot + nStates) - pPot));
+	};
+
+	// Block-wise
+	Mat pots = nodeTrainer.getNodePotentials(featureVectors);
+	ASSERT_EQ(static_cast<size_t>(width * height), pStage1->m_nSamples.load());
+	ASSERT_EQ(nHard, pStage2->m_nSamples.load());
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) check(y, x, pots.ptr<float>(y) + x * nStates);
+
+	// Sample by sample
+	pStage1->m_nSamples = 0;
+	pStage2->m_nSamples = 0;
+	Mat vec(nFeatures, 1, CV_8UC1);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) {
+			for (word f = 0; f < nFeatures; f++) vec.at<byte>(f, 0) = featureVectors.ptr<byte>(y)[x * nFeatures + f];
+			Mat pot = nodeTrainer.getNodePotentials(vec, 1.0f);
+			check(y, x, pot.ptr<float>());
+		}
+	ASSERT_EQ(static_cast<size_t>(width * height), pStage1->m_nSamples.load());
+	ASSERT_EQ(nHard, pStage2->m_nSamples.load());
+}
+
+TEST_F(CTestTrain, model_handle)
+{
+	auto pModelA = std::make_shared<CTrainNodeBayes>(nStates, nFeatures);
+	auto pModelB = std::make_shared<CTrainNodeBayes>(nStates, nFeatures);
+	testNodePotentials(*pModelA);
+	testNodePotentials(*pModelB);
+	const std::string fileName = "test_model_handle.dgm";
+	pModelB->saveModel(fileName);
+
+	Mat featureVectors(height, width, CV_8UC(nFeatures));
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			for (word f = 0; f < nFeatures; f++) featureVectors.ptr<byte>(y)[x * nFeatures + f] = static_cast<byte>(random::u(0, 255));
+	const Mat potsA = pModelA->getNodePotentials(featureVectors);
+	const Mat potsB = pModelB->getNodePotentials(featureVectors);
+
+	// The readers see either the old or the new model during the swap
+	CModelHandle<CTrainNode> handle(pModelA);
+	std::shared_ptr<const CTrainNode> pOld = handle.get();
+	std::atomic<bool> stop(false);
+	std::atomic<int>  nMismatches(0);
+	std::vector<std::thread> vReaders;
+	for (int r = 0; r < 4; r++)
+		vReaders.emplace_back([&] {
+			while (!stop) {
+				const Mat pots = handle.get()->getNodePotentials(featureVectors);
+				if (norm(pots, potsA, NORM_INF) != 0 && norm(pots, potsB, NORM_INF) != 0) nMismatches++;
+			}
+		});
+	handle.reload(fileName, [this] { return std::make_shared<CTrainNodeBayes>(nStates, nFeatures); });
+	stop = true;
+	for (std::thread &reader : vReaders) reader.join();
+
+	ASSERT_EQ(0, nMismatches);
+	ASSERT_EQ(1u, handle.getVersion());
+	ASSERT_EQ(0, norm(potsB, handle.get()->getNodePotentials(featureVectors), NORM_INF));
+	ASSERT_EQ(0, norm(potsA, pOld->getNodePotentials(featureVectors), NORM_INF));			// the old snapshot is still valid
+	remove(fileName.c_str());
+}
+
+TEST_F(CTestTrain, node_potentials_Bayes_LUT)
+{
+	const int nSamples = 500;
+	CTrainNodeBayes nodeTrainer(nStates, nFeatures);
+	vec_float_t vPrior(nStates, 0);
+	Mat fv(nFeatures, 1, CV_8UC1);
+	for (int i = 0; i < nSamples; i++) {
+		byte s = static_cast<byte>(random::u(0, nStates - 1));
+		for (word f = 0; f < nFeatures; f++) fv.at<byte>(f, 0) = static_cast<byte>(random::u(50 * s, 50 * s + 120));
+		nodeTrainer.addFeatureVec(fv, s);
+		vPrior[s] += 1.0f / nSamples;
+	}
+	nodeTrainer.train();
+
+	// The lookup-table potentials have to follow the naive Bayes product for every possible feature value
+	vec_float_t vPot(nStates);
+	for (int v = 0; v < 256; v++) {
+		fv.setTo(v);
+		float sum = 0;
+		for (byte s = 0; s < nStates; s++) {
+			vPot[s] = vPrior[s];
+			for (word f = 0; f < nFeatures; f++) vPot[s] *= static_cast<float>(nodeTrainer.getPDF(s, f)->getDensity(v));
+			sum += vPot[s];
+		}
+		Mat pot = nodeTrainer.getNodePotentials(fv, 1.0f);
+		for (byte s = 0; s < nStates; s++)
+			if (sum > 0) ASSERT_NEAR(100 * vPot[s] / sum, pot.at<float>(s, 0), 1e-2f);
+	}
+}
+
+TEST_F(CTestTrain, node_potentials_KNN_approximate)
+{
+	TrainNodeKNNParams params = TRAIN_NODE_KNN_PARAMS_DEFAULT;
+	params.maxNeighbors		= 10;
+	params.maxLeafVisits	= 20;
+	CTrainNodeKNN nodeTrainer(nStates, nFeatures, params);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_potentials_KNN_reservoir)
+{
+	TrainNodeKNNParams params = TRAIN_NODE_KNN_PARAMS_DEFAULT;
+	params.maxSamples = 100;
+	CTrainNodeKNN nodeTrainer(nStates, nFeatures, params);
+	testNodePotentials(nodeTrainer);
+}
+
+TEST_F(CTestTrain, node_potentials_GMM_Cholesky)
+{
+	const int nSamples = 900;
+	TrainNodeGMMParams params = TRAIN_NODE_GMM_PARAMS_DEFAULT;
+	params.maxGausses = 1;														// one Gaussian per state
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures, params);
+	std::vector<CKDGauss> vGauss;
+	vGauss.reserve(nStates);
+	Mat fv(nFeatures, 1, CV_8UC1);
+	Mat point;
+	for (int i = 0; i < nSamples; i++) {
+		byte s		= static_cast<byte>(i % nStates);
+		int	 base	= random::u(60 * s, 60 * s + 100);							// correlated features
+		for (word f = 0; f < nFeatures; f++) fv.at<byte>(f, 0) = static_cast<byte>(base + random::u(0, 10 * (f + 1)));
+		nodeTrainer.addFeatureVec(fv, s);
+
+		fv.convertTo(point, CV_64FC1);
+		if (vGauss.size() <= s) vGauss.emplace_back(point);
+		else vGauss[s] += point;
+	}
+	nodeTrainer.train();
+
+	// The potentials have to follow the Gaussian functions, estimated with the full covariance matrices
+	Mat aux1, aux2, aux3;
+	vec_float_t vPot(nStates);
+	for (int i = 0; i < 200; i++) {
+		for (word f = 0; f < nFeatures; f++) fv.at<byte>(f, 0) = static_cast<byte>(random::u(0, 255));
+		fv.convertTo(point, CV_64FC1);
+		float sum = 0;
+		for (byte s = 0; s < nStates; s++) {
+			vPot[s] = static_cast<float>(vGauss[s].getAlpha() * vGauss[s].getValue(point, aux1, aux2, aux3));
+			sum += vPot[s];
+		}
+		Mat pot = nodeTrainer.getNodePotentials(fv, 1.0f);
+		for (byte s = 0; s < nStates; s++)
+			if (sum > FLT_EPSILON) ASSERT_NEAR(100 * vPot[s] / sum, pot.at<float>(s, 0), 1e-2f);
+	}
+}
+
+TEST_F(CTestTrain, addFeatureVecs_parallel_Bayes)
+{
+	// The block is large enough to be accumulated in parallel stripes; the merged histograms have to be exact
+	const Size size(256, 256);
+	Mat gt;
+	Mat featureVectors = getTrainingData(size, gt);
+
+	CTrainNodeBayes nodeTrainer1(nStates, nFeatures);
+	CTrainNodeBayes nodeTrainer2(nStates, nFeatures);
+	nodeTrainer1.addFeatureVecs(featureVectors, gt);
+	Mat vec(nFeatures, 1, CV_8UC1);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			for (word f = 0; f < nFeatures; f++) vec.at<byte>(f, 0) = featureVectors.ptr<byte>(y)[x * nFeatures + f];
+			nodeTrainer2.addFeatureVec(vec, gt.at<byte>(y, x));
+		}
+	nodeTrainer1.train();
+	nodeTrainer2.train();
+
+	for (byte s = 0; s < nStates; s++)
+		for (word f = 0; f < nFeatures; f++)
+			for (int v = 0; v < 256; v++)
+				ASSERT_EQ(nodeTrainer1.getPDF(s, f)->getDensity(v), nodeTrainer2.getPDF(s, f)->getDensity(v));
+
+	Mat pots1 = nodeTrainer1.getNodePotentials(featureVectors);
+	Mat pots2 = nodeTrainer2.getNodePotentials(featureVectors);
+	ASSERT_EQ(norm(pots1, pots2, NORM_INF), 0);
+}
+
+TEST_F(CTestTrain, addFeatureVecs_parallel_GMM)
+{
+	// The stripes have a fixed size: the mixtures do not depend on the number of threads
+	const Size size(256, 256);
+	Mat gt;
+	Mat featureVectors = getTrainingData(size, gt);
+
+	const int nThreads = getNumThreads();
+	vec_mat_t vPots;
+	for (int n : { 1, 3, 8 }) {
+		setNumThreads(n);
+		CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+		nodeTrainer.addFeatureVecs(featureVectors, gt);
+		nodeTrainer.train();
+		vPots.push_back(nodeTrainer.getNodePotentials(featureVectors));
+	}
+	setNumThreads(nThreads);
+	for (size_t i = 1; i < vPots.size(); i++) ASSERT_EQ(norm(vPots[0], vPots[i], NORM_INF), 0);
+}
+
+TEST_F(CTestTrain, addFeatureVecs_parallel_edges)
+{
+	// The block is large enough to be accumulated in parallel stripes; the merged histograms have to be exact
+	const Size size(256, 256);
+	Mat gt;
+	Mat featureVectors = getTrainingData(size, gt);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	CTrainEdgePrior		edgeTrainerPrior1(nStates, nFeatures);
+	CTrainEdgePrior		edgeTrainerPrior2(nStates, nFeatures);
+	CTrainEdgeConcat<CTrainNodeBayes, CDiffFeaturesConcatenator> edgeTrainerConcat1(nStates, nFeatures);
+	CTrainEdgeConcat<CTrainNodeBayes, CDiffFeaturesConcatenator> edgeTrainerConcat2(nStates, nFeatures);
+	graphExt.addFeatureVecs(edgeTrainerPrior1, featureVectors, gt);
+	graphExt.addFeatureVecs(edgeTrainerConcat1, featureVectors, gt);
+
+	// The same edges, added one by one
+	Mat fv1(nFeatures, 1, CV_8UC1);
+	Mat fv2(nFeatures, 1, CV_8UC1);
+	auto addEdge = [&](int x1, int y1, int x2, int y2) {
+		for (word f = 0; f < nFeatures; f++) {
+			fv1.at<byte>(f, 0) = featureVectors.ptr<byte>(y1)[x1 * nFeatures + f];
+			fv2.at<byte>(f, 0) = featureVectors.ptr<byte>(y2)[x2 * nFeatures + f];
+		}
+		const byte gt1 = gt.at<byte>(y1, x1);
+		const byte gt2 = gt.at<byte>(y2, x2);
+		for (CTrainEdge *pEdgeTrainer : { static_cast<CTrainEdge *>(&edgeTrainerPrior2), static_cast<CTrainEdge *>(&edgeTrainerConcat2) }) {
+			pEdgeTrainer->addFeatureVecs(fv1, gt1, fv2, gt2);
+			pEdgeTrainer->addFeatureVecs(fv2, gt2, fv1, gt1);
+		}
+	};
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			if (x > 0)							addEdge(x, y, x - 1, y);
+			if (y > 0)							addEdge(x, y, x, y - 1);
+			if (x > 0 && y > 0)					addEdge(x, y, x - 1, y - 1);
+			if (x < size.width - 1 && y > 0)	addEdge(x, y, x + 1, y - 1);
+		}
+
+	const int	nEdges			= 1000;
+	const Mat	featureMatrix	= featureVectors.reshape(1, size.area());
+	Mat pots1, pots2;
+	edgeTrainerPrior1.train();
+	edgeTrainerPrior2.train();
+	edgeTrainerPrior1.getEdgePotentials(featureMatrix.rowRange(1, nEdges + 1), featureMatrix.rowRange(0, nEdges), { 2.0f, 0.01f }, pots1);
+	edgeTrainerPrior2.getEdgePotentials(featureMatrix.rowRange(1, nEdges + 1), featureMatrix.rowRange(0, nEdges), { 2.0f, 0.01f }, pots2);
+	ASSERT_EQ(norm(pots1, pots2, NORM_INF), 0);
+
+	edgeTrainerConcat1.train();
+	edgeTrainerConcat2.train();
+	edgeTrainerConcat1.getEdgePotentials(featureMatrix.rowRange(1, nEdges + 1), featureMatrix.rowRange(0, nEdges), { 2.0f }, pots1);
+	edgeTrainerConcat2.getEdgePotentials(featureMatrix.rowRange(1, nEdges + 1), featureMatrix.rowRange(0, nEdges), { 2.0f }, pots2);
+	ASSERT_EQ(norm(pots1, pots2, NORM_INF), 0);
+}
+
+namespace {
+	// Records the sequence of the added edges; the workers are appended on merge
+	class CTrainEdgeRecorder : public CTrainEdge {
+	public:
+		CTrainEdgeRecorder(byte nStates, word nFeatures) : CBaseRandomModel(nStates), CTrainEdge(nStates, nFeatures) {}
+
+		void	reset(void) override { m_vEdges.clear(); }
+		void	addFeatureVecs(const Mat &featureVector1, byte gt1, const Mat &featureVector2, byte gt2) override
+		{
+			m_vEdges.push_back({ featureVector1.at<byte>(0, 0), gt1, featureVector2.at<byte>(0, 0), gt2 });
+		}
+		std::shared_ptr<CTrainEdge> createWorker(void) const override { return std::make_shared<CTrainEdgeRecorder>(getNumStates(), getNumFeatures()); }
+		void	merge(CTrainEdge &worker) override
+		{
+			const auto &vEdges = dynamic_cast<CTrainEdgeRecorder &>(worker).m_vEdges;
+			m_vEdges.insert(m_vEdges.end(), vEdges.begin(), vEdges.end());
+		}
+
+		std::vector<std::array<byte, 4>> m_vEdges;
+
+
+	protected:
+		void	saveFile(FILE *) const override {}
+		void	loadFile(FILE *) override {}
+		Mat		calculateEdgePotentials(const Mat &, const Mat &, const vec_float_t &) const override { return Mat::ones(getNumStates(), getNumStates(), CV_32FC1); }
+	};
+}
+
+TEST_F(CTestTrain, addFeatureVecs_edges_order)
+{
+	// The edges, added block-wise and in parallel stripes, reach the edge trainer in the same order, as the ones, added pixel by pixel
+	const Size size(256, 256);
+	Mat featureVectors = random::U(size, CV_8UC(nFeatures), 0, 256);
+	Mat gt = random::U(size, CV_8UC1, 0, nStates);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID | GRAPH_EDGES_DIAG);
+	CTrainEdgeRecorder	edgeTrainer1(nStates, nFeatures);
+	CTrainEdgeRecorder	edgeTrainer2(nStates, nFeatures);
+	graphExt.addFeatureVecs(edgeTrainer1, featureVectors, gt);
+
+	auto addEdge = [&](int x1, int y1, int x2, int y2) {
+		const Mat fv1 = featureVectors.row(y1).reshape(1, size.width).row(x1).t();
+		const Mat fv2 = featureVectors.row(y2).reshape(1, size.width).row(x2).t();
+		edgeTrainer2.addFeatureVecs(fv1, gt.at<byte>(y1, x1), fv2, gt.at<byte>(y2, x2));
+		edgeTrainer2.addFeatureVecs(fv2, gt.at<byte>(y2, x2), fv1, gt.at<byte>(y1, x1));
+	};
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			if (x > 0)							addEdge(x, y, x - 1, y);
+			if (y > 0)							addEdge(x, y, x, y - 1);
+			if (x > 0 && y > 0)					addEdge(x, y, x - 1, y - 1);
+			if (x < size.width - 1 && y > 0)	addEdge(x, y, x + 1, y - 1);
+		}
+
+	ASSERT_EQ(edgeTrainer1.m_vEdges.size(), edgeTrainer2.m_vEdges.size());
+	ASSERT_TRUE(edgeTrainer1.m_vEdges == edgeTrainer2.m_vEdges);
+}
+
+TEST_F(CTestTrain, addFeatureVecs_parallel_links)
+{
+	// The block is passed to the nested node trainer at once; the link potentials have to be the same as the ones, trained and estimated pixel by pixel
+	const byte	nStatesOccl = 2;
+	const Size	size(256, 256);
+	Mat featureVectors(size, CV_8UC(nFeatures));
+	Mat gtb(size, CV_8UC1);
+	Mat gto(size, CV_8UC1);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			byte *pFv = featureVectors.ptr<byte>(y) + x * nFeatures;
+			byte  sb  = static_cast<byte>(random::u(0, nStates - 1));
+			byte  so  = static_cast<byte>(random::u(0, nStatesOccl - 1));
+			for (word f = 0; f < nFeatures; f++) pFv[f] = static_cast<byte>(random::u(40 * (sb + nStates * so), 40 * (sb + nStates * so) + 30));
+			gtb.at<byte>(y, x) = sb;
+			gto.at<byte>(y, x) = so;
+		}
+
+	CTrainLinkNested<CTrainNodeBayes> linkTrainer1(nStates, nStatesOccl, nFeatures);
+	CTrainLinkNested<CTrainNodeBayes> linkTrainer2(nStates, nStatesOccl, nFeatures);
+	linkTrainer1.addFeatureVec(featureVectors, gtb, gto);
+	Mat vec(nFeatures, 1, CV_8UC1);
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) {
+			for (word f = 0; f < nFeatures; f++) vec.at<byte>(f, 0) = featureVectors.ptr<byte>(y)[x * nFeatures + f];
+			linkTrainer2.addFeatureVec(vec, gtb.at<byte>(y, x), gto.at<byte>(y, x));
+		}
+	linkTrainer1.train();
+	linkTrainer2.train();
+
+	const int	nLinks			= 10000;
+	const Mat	featureMatrix	= featureVectors.reshape(1, size.area()).rowRange(0, nLinks);
+	Mat pots;
+	linkTrainer1.getLinkPotentials(featureMatrix, pots, 0.5f);
+	ASSERT_EQ(nLinks, pots.rows);
+	ASSERT_EQ((nStates + nStatesOccl) * (nStates + nStatesOccl), pots.cols);
+	for (int i = 0; i < nLinks; i += 97) {
+		Mat pot = linkTrainer2.getLinkPotentials(featureMatrix.row(i).reshape(1, nFeatures), 0.5f);
+		ASSERT_LE(norm(pots.row(i), pot.reshape(1, 1), NORM_INF), 1e-4);
+	}
+}
+
+TEST_F(CTestTrain, edge_potentials_Concat_block)
+{
+	// The blocks of edges are concatenated at once; the resulting potentials have to be the same as the ones, estimated edge by edge
+	Mat gt;
+	Mat featureVectors = getTrainingData(Size(width, height), gt);
+
+	CGraphPairwise		graph(nStates);
+	CGraphPairwiseExt	graphExt(graph, GRAPH_EDGES_GRID);
+	CTrainEdgeConcat<CTrainNodeBayes, CSimpleFeaturesConcatenator>	edgeTrainerSimple(nStates, nFeatures);
+	CTrainEdgeConcat<CTrainNodeBayes, CDiffFeaturesConcatenator>	edgeTrainerDiff(nStates, nFeatures);
+
+	const int	nEdges			= 1000;
+	const Mat	featureMatrix	= featureVectors.reshape(1, height * width);
+	for (CTrainEdge *pEdgeTrainer : { static_cast<CTrainEdge *>(&edgeTrainerSimple), static_cast<CTrainEdge *>(&edgeTrainerDiff) }) {
+		graphExt.addFeatureVecs(*pEdgeTrainer, featureVectors, gt);
+		pEdgeTrainer->train();
+
+		Mat pots;
+		pEdgeTrainer->getEdgePotentials(featureMatrix.rowRange(1, nEdges + 1), featureMatrix.rowRange(0, nEdges), {}, pots);
+		ASSERT_EQ(pots.rows, nEdges);
+		ASSERT_EQ(pots.cols, nStates * nStates);
+		for (int i = 0; i < nEdges; i++) {
+			Mat pot = pEdgeTrainer->getEdgePotentials(featureMatrix.row(i + 1).reshape(1, nFeatures), featureMatrix.row(i).reshape(1, nFeatures), {});
+			for (byte y = 0; y < nStates; y++)
+				for (byte x = 0; x < nStates; x++) ASSERT_NEAR(pot.at<float>(y, x), pots.at<float>(i, y * nStates + x), 1e-3f);
+		}
+	}
+
+	// The concatenated blocks are the same as the vectors, concatenated one by one
+	CSimpleFeaturesConcatenator concatenatorSimple(nFeatures);
+	CDiffFeaturesConcatenator	concatenatorDiff(nFeatures);
+	for (const CFeaturesConcatenator *pConcatenator : { static_cast<const CFeaturesConcatenator *>(&concatenatorSimple), static_cast<const CFeaturesConcatenator *>(&concatenatorDiff) }) {
+		Mat block;
+		pConcatenator->concatenateBlock(featureMatrix.rowRange(1, nEdges + 1), featureMatrix.rowRange(0, nEdges), block);
+		Mat vec(pConcatenator->getNumFeatures(), 1, CV_8UC1);
+		for (int i = 0; i < nEdges; i++) {
+			pConcatenator->concatenate(featureMatrix.row(i + 1).reshape(1, nFeatures), featureMatrix.row(i).reshape(1, nFeatures), vec);
+			ASSERT_EQ(0, norm(vec.reshape(1, 1), block.row(i), NORM_INF));
+		}
+	}
+}
+
+TEST_F(CTestTrain, addFeatureVecs_store)
+{
+	const std::string fileName = "TestTrainSamples.dat";
+	std::remove(fileName.c_str());
+
+	// The sample store is filled block by block and streamed in small chunks
+	CTrainNodeBayes nodeTrainer1(nStates, nFeatures);
+	CTrainNodeBayes nodeTrainer2(nStates, nFeatures);
+	for (int i = 0; i < 3; i++) {
+		Mat gt;
+		const Mat featureVectors = getTrainingData(Size(width, height), gt);
+		CTrainNode::appendFeatureVecs(fileName, featureVectors, gt);
+		nodeTrainer2.addFeatureVecs(featureVectors, gt);
+	}
+	nodeTrainer1.addFeatureVecs(fileName, 100);
+	std::remove(fileName.c_str());
+	nodeTrainer1.train();
+	nodeTrainer2.train();
+
+	for (byte s = 0; s < nStates; s++)
+		for (word f = 0; f < nFeatures; f++)
+			for (int v = 0; v < 256; v++)
+				ASSERT_EQ(nodeTrainer1.getPDF(s, f)->getDensity(v), nodeTrainer2.getPDF(s, f)->getDensity(v));
+}
+
+TEST_F(CTestTrain, dataset_loader)
+{
+	const size_t nItems = 20;
+
+	// The items are generated in advance and loaded concurrently in random order
+	std::vector<std::pair<Mat, Mat>> vItems(nItems);
+	for (auto &item : vItems) {
+		item.first	= random::U(Size(width, height), CV_8UC(nFeatures), 0.0, 255.0);
+		item.second = random::U(Size(width, height), CV_8UC1, 0.0, static_cast<double>(nStates));
+	}
+	auto loader = [&](size_t i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(random::u(0, 5)));
+		return std::make_pair(vItems[i].first.clone(), vItems[i].second.clone());
+	};
+
+	CDatasetLoader datasetLoader(nItems, loader, 4, 3);
+	CDatasetLoader::item_t item;
+	for (size_t i = 0; i < nItems; i++) {
+		ASSERT_TRUE(datasetLoader.next(item));
+		ASSERT_EQ(0, norm(item.first, vItems[i].first, NORM_INF));
+		ASSERT_EQ(0, norm(item.second, vItems[i].second, NORM_INF));
+	}
+	ASSERT_FALSE(datasetLoader.next(item));
+
+	// The exceptions of the loader function are re-thrown by the consumer
+	CDatasetLoader failingLoader(3, [](size_t i) -> CDatasetLoader::item_t { if (i == 1) throw std::runtime_error("corrupted"); return {}; }, 2);
+	ASSERT_TRUE(failingLoader.next(item));
+	ASSERT_THROW(failingLoader.next(item), std::runtime_error);
+	ASSERT_TRUE(failingLoader.next(item));
+	ASSERT_FALSE(failingLoader.next(item));
+}
+
+TEST_F(CTestTrain, stream_node_potentials)
+{
+	CTrainNodeBayes nodeTrainer(nStates, nFeatures);
+	testNodePotentials(nodeTrainer);
+
+	Mat featureVectors = random::U(Size(width, height), CV_8UC(nFeatures), 0.0, 255.0);
+	Mat pots = nodeTrainer.getNodePotentials(featureVectors);
+
+	// The tiles are received in the order of their requests and assembled into the whole potential map
+	Mat res(featureVectors.size(), CV_32FC(nStates), Scalar::all(-1));
+	std::vector<Rect> vRequested, vReceived;
+	nodeTrainer.streamNodePotentials(featureVectors.size(), Size(7, 5),
+		[&](const Rect &roi) { vRequested.push_back(roi); return featureVectors(roi).clone(); },
+		[&](const Rect &roi, const Mat &pot) { vReceived.push_back(roi); pot.copyTo(res(roi)); });
+	ASSERT_EQ(vRequested, vReceived);
+	ASSERT_EQ(static_cast<size_t>(((width + 6) / 7) * ((height + 4) / 5)), vReceived.size());
+	ASSERT_EQ(0, norm(pots, res, NORM_INF));
+}
+
+TEST_F(CTestTrain, prior_bulk)
+{
+	Mat gt1 = random::U(Size(width, height), CV_8UC1, 0, nStates);
+	Mat gt2 = random::U(Size(width, height), CV_8UC1, 0, nStates);
+	Mat gt3 = random::U(Size(width, height), CV_8UC1, 0, nStates);
+
+	// The parallel bulk accumulation has to produce the same histograms as the sample-wise one
+	CPriorNode		nodePrior(nStates),		nodePriorBulk(nStates);
+	CPriorEdge		edgePrior(nStates, eP_APP_NORM_STANDARD), edgePriorBulk(nStates, eP_APP_NORM_STANDARD);
+	CPriorEdge		gridPrior(nStates, eP_APP_NORM_STANDARD), gridPriorBulk(nStates, eP_APP_NORM_STANDARD);
+	CPriorTriplet	tripletPrior(nStates),	tripletPriorBulk(nStates);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++) {
+			const byte gt = gt1.at<byte>(y, x);
+			nodePrior.addNodeGroundTruth(gt);
+			edgePrior.addEdgeGroundTruth(gt, gt2.at<byte>(y, x));
+			tripletPrior.addTripletGroundTruth(gt, gt2.at<byte>(y, x), gt3.at<byte>(y, x));
+			for (const Point &shift : { Point(-1, 0), Point(0, -1), Point(-1, -1), Point(1, -1) }) {
+				const Point neighbor = Point(x, y) + shift;
+				if (neighbor.x < 0 || neighbor.y < 0 || neighbor.x >= width) continue;
+				gridPrior.addEdgeGroundTruth(gt, gt1.at<byte>(neighbor));
+				gridPrior.addEdgeGroundTruth(gt1.at<byte>(neighbor), gt);
+			}
+		}
+	nodePriorBulk.addNodeGroundTruth(gt1);
+	edgePriorBulk.addEdgeGroundTruth(gt1, gt2);
+	gridPriorBulk.addGridGroundTruth(gt1, true);
+	tripletPriorBulk.addTripletGroundTruth(gt1, gt2, gt3);
+
+	ASSERT_EQ(0, norm(nodePrior.getPrior(), nodePriorBulk.getPrior(), NORM_INF));
+	ASSERT_EQ(0, norm(edgePrior.getPrior(), edgePriorBulk.getPrior(), NORM_INF));
+	ASSERT_EQ(0, norm(gridPrior.getPrior(), gridPriorBulk.getPrior(), NORM_INF));
+	ASSERT_EQ(0, norm(tripletPrior.getPrior(), tripletPriorBulk.getPrior(), NORM_INF));
+}
+
+TEST_F(CTestTrain, node_potentials_masked)
+{
+	CTrainNodeBayes nodeTrainer(nStates, nFeatures);
+	Mat featureVectors	= random::U(Size(width, height), CV_8UC(nFeatures), 0, 256);
+	Mat gt				= random::U(Size(width, height), CV_8UC1, 0, nStates);
+	nodeTrainer.addFeatureVecs(featureVectors, gt);
+	nodeTrainer.train();
+
+	// The valid pixels have the same potentials, as without the mask; the masked ones are zero
+	Mat mask		= random::U(Size(width, height), CV_8UC1, 0, 2);
+	Mat weights		= random::U(Size(width, height), CV_32FC1, 0.5, 1.5);
+	Mat pots		= nodeTrainer.getNodePotentials(featureVectors, weights);
+	Mat potsMasked	= nodeTrainer.getNodePotentials(featureVectors, weights, 0.0f, mask);
+	Mat zeros(pots.size(), pots.type(), Scalar::all(0));
+	zeros.copyTo(pots, mask == 0);
+	ASSERT_NEAR(0, norm(pots, potsMasked, NORM_INF), 1e-3);			// the OpenCL path may be taken for the whole block only
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "gtest/gtest.h"
+#include "types.h"
+#include "DGM.h"
+
+using namespace DirectGraphicalModels;
+
+class CTestTrain : public ::testing::Test {
+public:
+	CTestTrain(void) = default;
+	~CTestTrain(void) = default;
+
+
+protected:
+	void	testNodePotentials(CTrainNode &nodeTrainer);
+	void	testModelFile(CTrainNode &nodeTrainer, CTrainNode &loadedTrainer);
+	Mat		getTrainingData(Size size, Mat &gt, int spread = 60) const;
+
+
+protected:	// Test configuration
+	const byte	nStates		= 3;
+	const word	nFeatures	= 2;
+	const int	width		= 40;
+	const int	height		= 30;
+};
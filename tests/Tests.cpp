@@ -1,6 +1,17 @@
 #include "Tests.h"
 #include "DGM/parallel.h"
 #include "DGM/random.h"
+#include "DGM/SamplesAccumulator.h"
+#include "DGM/profiler.h"
+#include "DGM/numa.h"
+#include "DGM/Pipeline.h"
+#include "DGM/serialize.h"
+#include "VIS/Marker.h"
+#include "VIS/Frustum.h"
+#include <fstream>
+#include <array>
+#include <atomic>
+#include <set>
 
 using namespace DirectGraphicalModels;
 
@@ -22,5 +33,524 @@ TEST_F(CTests, parallel_gemm)
 
 	ASSERT_TRUE(std::equal(ppl_res.begin<float>(), ppl_res.end<float>(), amp_res.begin<float>()));
 #endif
+	// The sizes do not fit the micro-kernel tiles; the second product is accumulated in place
+	for (int i = 0; i < 4; i++) {
+		const int	m	  = random::u<int>(1, 500);
+		const int	n	  = random::u<int>(1, 1300);
+		const int	k	  = random::u<int>(1, 700);
+		const float alpha = random::U<float>(0.0f, 1.0f);
+		const float beta  = random::U<float>(0.0f, 1.0f);
+
+		Mat A = random::U(Size(k, m), CV_32FC1, -1.0, 1.0);
+		Mat B = random::U(Size(n, k), CV_32FC1, -1.0, 1.0);
+		Mat C = random::U(Size(n, m), CV_32FC1, -1.0, 1.0);
+		Mat ref, res;
+
+		cv::gemm(A, B, alpha, Mat(), 0, ref);
+		parallel::gemm(A, B, alpha, Mat(), 0, res);
+		ASSERT_LT(norm(ref, res, NORM_INF), 1e-4 * k);
+
+		cv::gemm(A, B, alpha, C, beta, ref);
+		parallel::gemm(A, B, alpha, C, beta, C);
+		ASSERT_LT(norm(ref, C, NORM_INF), 1e-4 * k);
+	}
+
+	// The result is a view of the same buffer as the first factor with another origin: the factor must be read before it is overwritten
+	Mat buffer = random::U(Size(96, 96), CV_32FC1, -1.0, 1.0);
+	Mat A = buffer(Rect(0, 0, 64, 64));
+	Mat B = random::U(Size(64, 64), CV_32FC1, -1.0, 1.0);
+	Mat ref, res = buffer(Rect(16, 16, 64, 64));
+	cv::gemm(A, B, 1, Mat(), 0, ref);
+	parallel::gemm(A, B, 1, Mat(), 0, res);
+	ASSERT_LT(norm(ref, res, NORM_INF), 1e-4 * 64);
+}
+
+TEST_F(CTests, thread_pool)
+{
+	CThreadPool pool(4);
+	const int size = 10000;
+
+	// Every iteration is processed exactly once for any grain size and concurrency limit
+	for (int grainSize : { 0, 1, 7, size }) 
+		for (size_t maxConcurrency : { 0, 1, 2 }) {
+			vec_int_t vCount(size, 0);
+			std::atomic<int> nActive(0), maxActive(0);
+			pool.parallelFor(Range(0, size), [&](const Range &range) {
+				const int active = ++nActive;
+				for (int m = maxActive; m < active && !maxActive.compare_exchange_weak(m, active);) {}
+				if (grainSize > 0) ASSERT_LE(range.size(), grainSize);
+				for (int i = range.start; i < range.end; i++) vCount[i]++;
+				nActive--;
+			}, grainSize, maxConcurrency);
+			for (int i = 0; i < size; i++) ASSERT_EQ(1, vCount[i]);
+			if (maxConcurrency) ASSERT_LE(maxActive, static_cast<int>(maxConcurrency));
+		}
+
+	// Nested task groups
+	std::function<int(int)> fib = [&](int n) {
+		if (n < 2) return n;
+		int a = 0;
+		CTaskGroup group(pool);
+		group.run([&] { a = fib(n - 1); });
+		const int b = fib(n - 2);
+		group.wait();
+		return a + b;
+	};
+	ASSERT_EQ(6765, fib(20));
+
+	// Exceptions are re-thrown in the waiting thread
+	CTaskGroup group(pool);
+	group.run([] { throw std::runtime_error("task"); });
+	ASSERT_THROW(group.wait(), std::runtime_error);
+
+	// Task-parallel sorting
+	Mat m = random::U(Size(3, 5000), CV_32FC1, 0.0, 100.0);
+	parallel::sortRows<float>(m, 1);
+	for (int y = 1; y < m.rows; y++) ASSERT_LE(m.at<float>(y - 1, 1), m.at<float>(y, 1));
+}
+
+TEST_F(CTests, numa)
+{
+	ASSERT_GE(numa::getNumNodes(), 1u);
+	ASSERT_LT(numa::getCurrentNode(), numa::getNumNodes());
+	for (size_t node = 0; node < numa::getNumNodes(); node++) ASSERT_FALSE(numa::getNodeCpus(node).empty());
+
+	// The buffer is not initialized by the allocation, thus its pages are first touched by fill(): the buffer is filled completely, 
+	// all its bytes are placed, and every NUMA node gets its part
+	const size_t n		= 1 << 22;
+	const size_t size	= n * sizeof(float);
+	std::unique_ptr<float[]> pBuffer(new float[n]);
+	numa::fill(pBuffer.get(), n, 0.5f);
+	for (size_t i = 0; i < n; i++) ASSERT_EQ(0.5f, pBuffer[i]);
+	vec_size_t vBytes = numa::getPlacement(pBuffer.get(), size);
+	ASSERT_EQ(numa::getNumNodes(), vBytes.size());
+	ASSERT_EQ(size, std::accumulate(vBytes.begin(), vBytes.end(), size_t(0)));
+	const size_t tolerance = size / 16;									// the pages may fall back to other nodes under the memory pressure
+	if (numa::isEnabled())
+		for (size_t node = 0; node < vBytes.size(); node++) ASSERT_NEAR(static_cast<double>(size / vBytes.size()), static_cast<double>(vBytes[node]), tolerance);
+
+	// The buffer, touched by its allocation, is placed by distribute()
+	vec_float_t vBuffer(n);
+	numa::distribute(vBuffer.data(), size);
+	vBytes = numa::getPlacement(vBuffer.data(), size);
+	ASSERT_EQ(size, std::accumulate(vBytes.begin(), vBytes.end(), size_t(0)));
+	if (numa::isEnabled())
+		for (size_t node = 0; node < vBytes.size(); node++) ASSERT_NEAR(static_cast<double>(size / vBytes.size()), static_cast<double>(vBytes[node]), tolerance);
+
+	// Every iteration of the pinned pool is processed exactly once
+	CThreadPool pool(4);
+	pool.setPinning(true);
+	for (int grainSize : { 0, 1, 7 }) {
+		vec_int_t vCount(10000, 0);
+		pool.parallelFor(Range(0, 10000), [&](const Range &range) {
+			for (int i = range.start; i < range.end; i++) vCount[i]++;
+		}, grainSize);
+		for (int c : vCount) ASSERT_EQ(1, c);
+	}
+	pool.setPinning(false);
+	ASSERT_FALSE(pool.isPinning());
+}
+
+TEST_F(CTests, pipeline)
+{
+	struct Tile {
+		int		value = -1;
+		Mat		buffer;
+	};
+	const size_t nTiles = 50;
+
+	for (size_t nBuffers : { 1, 2, 3 }) {
+		CPipeline<Tile> pipeline(nBuffers);
+		vec_int_t			vResults(nTiles, -1);
+		std::set<uchar *>	sBuffers;
+		std::atomic<int>	nInFlight(0), maxInFlight(0);
+		size_t				next = 0;
+		pipeline.addStage("first", [&](Tile &tile, size_t t) {
+			ASSERT_EQ(next++, t);
+			const int inFlight = ++nInFlight;
+			for (int m = maxInFlight; m < inFlight && !maxInFlight.compare_exchange_weak(m, inFlight);) {}
+			if (tile.buffer.empty()) tile.buffer = Mat(16, 16, CV_32FC1);
+			sBuffers.insert(tile.buffer.data);
+			tile.value = static_cast<int>(t);
+		});
+		pipeline.addStage("second", [](Tile &tile, size_t) { tile.value *= tile.value; });
+		pipeline.addStage("third", [&](Tile &tile, size_t t) {
+			vResults[t] = tile.value;
+			nInFlight--;
+		});
+		pipeline.run(nTiles);
+
+		// All the tiles are processed in the recycled buffers
+		for (size_t t = 0; t < nTiles; t++) ASSERT_EQ(static_cast<int>(t * t), vResults[t]);
+		ASSERT_EQ(nBuffers, sBuffers.size());
+		ASSERT_LE(maxInFlight, static_cast<int>(nBuffers));
+		ASSERT_EQ(3u, pipeline.getStageTimes().size());
+
+		// Exceptions are re-thrown in the calling thread
+		pipeline.addStage("fourth", [](Tile &, size_t t) { if (t == 7) throw std::runtime_error("tile"); });
+		next = 0;
+		ASSERT_THROW(pipeline.run(nTiles), std::runtime_error);
+	}
+}
+
+TEST_F(CTests, sort_rows)
+{
+	Mat m = random::U(Size(4, 20000), CV_8UC1, 0, 4);						// many equal rows
+	Mat m0 = m.clone();
+	parallel::sortRows<byte>(m);
+	for (int y = 1; y < m.rows; y++) ASSERT_LE(memcmp(m.ptr<byte>(y - 1), m.ptr<byte>(y), m.cols), 0);
+
+	// The rows are only permuted
+	Mat sorted0;
+	cv::sort(m0.reshape(1, 1), sorted0, SORT_EVERY_ROW);
+	Mat sorted;
+	cv::sort(m.clone().reshape(1, 1), sorted, SORT_EVERY_ROW);
+	ASSERT_EQ(0, norm(sorted0, sorted, NORM_INF));
+
+	Mat f = random::U(Size(3, 10000), CV_32FC1, 0.0, 100.0);
+	const Scalar sum = cv::sum(f);
+	parallel::sortRows<float>(f, 2);
+	for (int y = 1; y < f.rows; y++) ASSERT_LE(f.at<float>(y - 1, 2), f.at<float>(y, 2));
+	ASSERT_NEAR(sum[0], cv::sum(f)[0], 1.0);
+}
+
+namespace {
+	// Sums up the features, weighted with the values; the sums are atomic, thus the accumulator may be called concurrently
+	struct CFeatureSum {
+		std::atomic<int64_t> sum	= 0;
+		std::atomic<int64_t> count	= 0;
+		void addFeatureVec(const Mat &vec, byte b) {
+			int64_t s = 0;
+			for (int f = 0; f < vec.rows; f++) s += (f + 1) * vec.at<byte>(f, 0);
+			sum		+= s * b;
+			count	+= 1;
+		}
+		void addFeatureVecBlock(const Mat &block, const Mat &gt) {
+			DGM_VECTORWISE1<CFeatureSum, &CFeatureSum::addFeatureVec>(*this, block, gt);
+		}
+	};
+}
+
+namespace DirectGraphicalModels {
+	template<> struct is_thread_safe<CFeatureSum> : std::true_type {};
+}
+
+TEST_F(CTests, vectorwise)
+{
+	// All the traversals of both layouts visit every pixel once with the same feature vector
+	const Size size(300, 70);
+	Mat gt = random::U(size, CV_8UC1, 0, 4);
+	for (int nFeatures : { 1, 3, 4, 7 }) {
+		Mat featureVectors = random::U(size, CV_8UC(nFeatures), 0, 255);
+		vec_mat_t vFeatureVectors;
+		split(featureVectors, vFeatureVectors);
+
+		CFeatureSum reference;
+		Mat vec(nFeatures, 1, CV_8UC1);
+		for (int y = 0; y < size.height; y++)
+			for (int x = 0; x < size.width; x++) {
+				for (int f = 0; f < nFeatures; f++) vec.at<byte>(f, 0) = featureVectors.ptr<byte>(y)[x * nFeatures + f];
+				reference.addFeatureVec(vec, gt.at<byte>(y, x));
+			}
+
+		CFeatureSum sums[6];
+		DGM_VECTORWISE1<CFeatureSum, &CFeatureSum::addFeatureVec>(sums[0], featureVectors, gt);
+		DGM_VECTORWISE1<CFeatureSum, &CFeatureSum::addFeatureVec>(sums[1], vFeatureVectors, gt);
+		parallel::vectorwise1<CFeatureSum, &CFeatureSum::addFeatureVec>(sums[2], featureVectors, gt);
+		parallel::vectorwise1<CFeatureSum, &CFeatureSum::addFeatureVec>(sums[3], vFeatureVectors, gt);
+		parallel::blockwise1<CFeatureSum, &CFeatureSum::addFeatureVecBlock>(sums[4], featureVectors, gt);
+		parallel::blockwise1<CFeatureSum, &CFeatureSum::addFeatureVecBlock>(sums[5], vFeatureVectors, gt);
+		for (const CFeatureSum &s : sums) {
+			ASSERT_EQ(reference.count, s.count);
+			ASSERT_EQ(reference.sum, s.sum);
+		}
+	}
+}
+
+TEST_F(CTests, random_streams)
+{
+	// Known answer of Philox4x32-10 for the zero key and the zero counter
+	random::CPhilox generator;
+	const uint32_t kat[] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 };
+	for (uint32_t val : kat) ASSERT_EQ(val, generator());
+	random::CPhilox skipped;
+	skipped.discard(3);
+	ASSERT_EQ(kat[3], skipped());
+
+	const uint64_t seed = random::getSeed();
+	random::seed(2026);
+	const int a = random::u<int>(0, 1 << 30);
+	random::seed(2026);
+	ASSERT_EQ(a, random::u<int>(0, 1 << 30));
+
+	// The streams do not depend on the number of threads
+	auto sample = [](size_t nThreads) {
+		CThreadPool pool(nThreads);
+		vec_float_t vRes(10000);
+		pool.parallelFor(Range(0, static_cast<int>(vRes.size())), [&](const Range &range) {
+			for (int i = range.start; i < range.end; i++) {
+				random::CPhilox stream = random::getStream(i);
+				vRes[i] = random::N<float>(stream) + random::U<float>(stream);
+			}
+		}, 16);
+		return vRes;
+	};
+	const vec_float_t vRes = sample(1);
+	ASSERT_TRUE(vRes == sample(4));
+	ASSERT_NE(vRes[0], vRes[1]);
+
+	// The reservoir sampling of the training samples is reproducible as well
+	auto accumulate = [](void) {
+		CSamplesAccumulator accumulator(1, 16);
+		Mat sample(1, 1, CV_32FC1);
+		for (int i = 0; i < 1000; i++) {
+			sample.at<float>(0, 0) = static_cast<float>(i);
+			accumulator.addSample(sample, 0);
+		}
+		return accumulator.getSamplesContainer(0).clone();
+	};
+	random::seed(2026);
+	const Mat samples = accumulate();
+	random::seed(2026);
+	ASSERT_EQ(0, norm(samples, accumulate(), NORM_INF));
+	random::seed(seed);
+}
+
+TEST_F(CTests, profiler)
+{
+	auto find = [](const std::vector<profiler::Event> &vEvents, const char *name) {
+		return std::find_if(vEvents.begin(), vEvents.end(), [name](const profiler::Event &event) { return strcmp(event.name, name) == 0; });
+	};
+
+	profiler::setCapacity(4);
+	ASSERT_TRUE(profiler::begin("outer"));
+	{
+		profiler::CZone zone("inner");
+	}
+	profiler::end();
+	std::thread([] { profiler::CZone zone("worker"); }).join();
+
+	std::vector<profiler::Event> vEvents = profiler::getEvents();
+	ASSERT_EQ(3, vEvents.size());
+	auto outer	= find(vEvents, "outer");
+	auto inner	= find(vEvents, "inner");
+	auto worker	= find(vEvents, "worker");
+	ASSERT_TRUE(outer != vEvents.end() && inner != vEvents.end() && worker != vEvents.end());
+	ASSERT_EQ(0, outer->depth);
+	ASSERT_EQ(1, inner->depth);
+	ASSERT_LE(outer->begin, inner->begin);
+	ASSERT_GE(outer->begin + outer->duration, inner->begin + inner->duration);
+	ASSERT_EQ(outer->thread, inner->thread);
+	ASSERT_NE(outer->thread, worker->thread);
+
+	// The ring buffer keeps the latest zones
+	for (int i = 0; i < 10; i++) profiler::CZone zone("overflow");
+	vEvents = profiler::getEvents();
+	ASSERT_EQ(5, vEvents.size());
+	ASSERT_EQ(4, std::count_if(vEvents.begin(), vEvents.end(), [](const profiler::Event &event) { return strcmp(event.name, "overflow") == 0; }));
+
+	profiler::setEnabled(false);
+	{
+		profiler::CZone zone("disabled");
+	}
+	profiler::setEnabled(true);
+	vEvents = profiler::getEvents();
+	ASSERT_TRUE(find(vEvents, "disabled") == vEvents.end());
+
+	const std::string fileName = "TestProfiler.json";
+	profiler::saveChromeTrace(fileName);
+	std::ifstream file(fileName);
+	const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	remove(fileName.c_str());
+	ASSERT_NE(std::string::npos, json.find("\"traceEvents\""));
+	ASSERT_NE(std::string::npos, json.find("\"name\":\"worker\""));
+	ASSERT_NE(std::string::npos, json.find("\"ph\":\"X\""));
+
+	profiler::setCapacity(65536);
 }
 
+TEST_F(CTests, confusion_matrix)
+{
+	const byte	nStates = 6;
+	const Size	imgSize(random::u<int>(50, 300), random::u<int>(50, 300));
+	Mat gt(imgSize, CV_8UC1), solution(imgSize, CV_8UC1), mask(imgSize, CV_8UC1);
+	for (int y = 0; y < imgSize.height; y++)
+		for (int x = 0; x < imgSize.width; x++) {
+			gt.at<byte>(y, x)		= static_cast<byte>(random::u(0, nStates - 1));
+			solution.at<byte>(y, x)	= random::u(0, 3) ? gt.at<byte>(y, x) : static_cast<byte>(random::u(0, nStates - 1));
+			mask.at<byte>(y, x)		= static_cast<byte>(random::u(0, 4) ? 255 : 0);
+		}
+
+	// Reference: pixel by pixel
+	CCMat confMatRef(nStates);
+	for (int y = 0; y < imgSize.height; y++)
+		for (int x = 0; x < imgSize.width; x++)
+			if (mask.at<byte>(y, x)) confMatRef.estimate(gt.at<byte>(y, x), solution.at<byte>(y, x));
+
+	CCMat confMat(nStates);
+	confMat.estimate(gt, solution, mask);
+	ASSERT_EQ(0, norm(confMatRef.getConfusionMatrix(), confMat.getConfusionMatrix(), NORM_INF));
+
+	// Streaming: the tiles are added concurrently
+	CCMat confMatTiles(nStates);
+	const int tile = 32;
+	std::vector<Rect> vTiles;
+	for (int y = 0; y < imgSize.height; y += tile)
+		for (int x = 0; x < imgSize.width; x += tile)
+			vTiles.push_back(Rect(x, y, MIN(tile, imgSize.width - x), MIN(tile, imgSize.height - y)));
+	parallel_for_(Range(0, static_cast<int>(vTiles.size())), [&](const Range &range) {
+		for (int t = range.start; t < range.end; t++)
+			confMatTiles.estimate(gt(vTiles[t]), solution(vTiles[t]), mask(vTiles[t]));
+	});
+	ASSERT_LT(norm(confMatRef.getConfusionMatrix(), confMatTiles.getConfusionMatrix(), NORM_INF), 1e-4);
+	ASSERT_FLOAT_EQ(confMatRef.getAccuracy(), confMatTiles.getAccuracy());
+}
+
+TEST_F(CTests, average_precision)
+{
+	const byte		nStates = 5;
+	const size_t	nNodes	= 20000;
+
+	vec_byte_t	predictions(nNodes), gt(nNodes);
+	Mat			potentials = random::U(Size(nStates, static_cast<int>(nNodes)), CV_32FC1, 0.0, 1.0);
+	for (size_t n = 0; n < nNodes; n++) {
+		const float *pot = potentials.ptr<float>(static_cast<int>(n));
+		predictions[n]	= static_cast<byte>(std::max_element(pot, pot + nStates) - pot);
+		gt[n]			= random::u(0, 2) ? predictions[n] : static_cast<byte>(random::u(0, nStates - 1));
+	}
+
+	const vec_float_t vAP = getAveragePrecisions(predictions, potentials, gt);
+	ASSERT_EQ(static_cast<size_t>(nStates), vAP.size());
+
+	CAveragePrecision apStream(nStates);
+	const int nChunks = 4;
+	const int chunk	  = static_cast<int>(nNodes) / nChunks;
+	for (int c = 0; c < nChunks; c++)
+		apStream.addPredictions(vec_byte_t(predictions.begin() + c * chunk, predictions.begin() + (c + 1) * chunk), 
+								potentials.rowRange(c * chunk, (c + 1) * chunk), 
+								vec_byte_t(gt.begin() + c * chunk, gt.begin() + (c + 1) * chunk));
+
+	float mAP = 0;
+	for (byte s = 0; s < nStates; s++) {
+		vec_float_t pots(nNodes);
+		for (size_t n = 0; n < nNodes; n++) pots[n] = potentials.at<float>(static_cast<int>(n), s);
+		const float ap = getAveragePrecision(predictions, pots, gt, s);
+		ASSERT_NEAR(ap, vAP[s], 1e-4);
+		ASSERT_NEAR(ap, apStream.getAveragePrecision(s), 1e-2);
+		mAP += ap;
+	}
+	mAP /= nStates;
+	ASSERT_NEAR(mAP, getMeanAveragePrecision(vAP, gt), 1e-4);
+	ASSERT_NEAR(mAP, apStream.getMeanAveragePrecision(), 1e-2);
+}
+
+TEST_F(CTests, serialize)
+{
+	const std::string	fileName = "test_serialize.dat";
+	const Size			size(random::u<int>(50, 200), random::u<int>(50, 200));
+	const Mat			m = random::U(size, CV_32FC3, -1.0, 1.0);
+	std::shared_ptr<const void> pStorage;
+
+	// Mapped file of the to() function
+	Serialize::to(fileName, m);
+	Mat mapped = Serialize::map(fileName, pStorage);
+	ASSERT_TRUE(pStorage != nullptr);
+	ASSERT_EQ(m.type(), mapped.type());
+	ASSERT_EQ(0, norm(m, mapped, NORM_INF));
+	mapped.release();
+	pStorage.reset();
+
+	// Tiles: the tiles, which are not written, read as zeros
+	Mat expected(size, m.type(), Scalar::all(0));
+	{
+		Serialize::CTileWriter writer(fileName, size, m.type());
+		const int tile = 32;
+		for (int y = 0; y < size.height; y += tile)
+			for (int x = 0; x < size.width; x += tile) {
+				if (random::u(0, 3) == 0) continue;
+				const Rect roi(x, y, MIN(tile, size.width - x), MIN(tile, size.height - y));
+				writer.write(m(roi), roi.tl());
+				m(roi).copyTo(expected(roi));
+			}
+	}
+	ASSERT_EQ(0, norm(expected, Serialize::from(fileName), NORM_INF));
+	mapped = Serialize::map(fileName, pStorage);
+	ASSERT_EQ(0, norm(expected, mapped, NORM_INF));
+	mapped.release();
+	pStorage.reset();
+
+	// Invalid headers: a wrong type and a truncated file
+	for (const std::array<int, 4> &header : { std::array<int, 4>{ size.height, size.width, 7, 3 }, std::array<int, 4>{ size.height, size.width, CV_32F, 3 } }) {
+		FILE *pFile = fopen(fileName.c_str(), "wb");
+		ASSERT_TRUE(pFile != NULL);
+		fwrite(header.data(), sizeof(int), header.size(), pFile);
+		fwrite(m.data, sizeof(float), 100, pFile);
+		fclose(pFile);
+		ASSERT_TRUE(Serialize::map(fileName, pStorage).empty());
+		ASSERT_TRUE(pStorage == nullptr);
+	}
+	remove(fileName.c_str());
+}
+
+TEST_F(CTests, marker)
+{
+	const byte	nStates = 5;
+	const Size	size(64, 48);
+	const Mat	classes = random::U(size, CV_8UC1, 0, nStates);
+	const Mat	base	= random::U(size, CV_8UC3, 0, 256);
+
+	// The certain potentials: the colors of the states replace the base image, as the classes do
+	Mat pots(size, CV_32FC(nStates), Scalar::all(0));
+	for (int y = 0; y < size.height; y++)
+		for (int x = 0; x < size.width; x++) pots.ptr<float>(y)[x * nStates + classes.at<byte>(y, x)] = 1.0f;
+
+	vis::CMarker marker;
+	for (byte flag : { static_cast<byte>(vis::MARK_OVER), static_cast<byte>(vis::MARK_OVER | vis::MARK_NO_ZERO) }) {
+		Mat res1 = base.clone();
+		Mat res2 = base.clone();
+		marker.markClasses(res1, classes, flag);
+		marker.markPotentials(res2, pots, flag);
+		ASSERT_EQ(norm(res1, res2, NORM_INF), 0);
+
+		// The pixels of the class 0 keep the base image only with MARK_NO_ZERO
+		Mat mask = classes == 0;
+		Mat diff;
+		absdiff(res1, base, diff);
+		ASSERT_EQ(norm(diff, NORM_INF, mask) == 0, (flag & vis::MARK_NO_ZERO) == vis::MARK_NO_ZERO);
+	}
+
+	// The uniform potentials have zero confidence: the base image is unchanged
+	Mat res = base.clone();
+	marker.markPotentials(res, Mat(size, CV_32FC(nStates), Scalar::all(0.2)), vis::MARK_OVER);
+	ASSERT_EQ(norm(res, base, NORM_INF), 0);
+}
+
+TEST_F(CTests, frustum)
+{
+	// The identity matrix: the frustum is the cube [-1; 1]^3
+	const vis::frustum::planes_t planes = vis::frustum::getPlanes(Matx44f::eye());
+	ASSERT_TRUE(vis::frustum::isVisible(planes, Point3f(-0.5f, -0.5f, -0.5f), Point3f(0.5f, 0.5f, 0.5f)));
+	ASSERT_TRUE(vis::frustum::isVisible(planes, Point3f(-0.5f, 0, 0), Point3f(2, 0, 0)));
+	ASSERT_FALSE(vis::frustum::isVisible(planes, Point3f(2, 0, 0), Point3f(3, 0, 0)));
+	ASSERT_FALSE(vis::frustum::isVisible(planes, Point3f(0, 0, -3), Point3f(0, 0, -2)));
+
+	// The edge between two nodes outside of the frustum crosses it: the box of the nodes of one end is culled, while the box of the edge is not
+	const Point3f src(-2, 0, 0);
+	const Point3f dst(2, 0, 0);
+	ASSERT_FALSE(vis::frustum::isVisible(planes, src, src));
+	ASSERT_FALSE(vis::frustum::isVisible(planes, dst, dst));
+	ASSERT_TRUE(vis::frustum::isVisible(planes, src, dst));
+
+	// The perspective projection along -z with the near plane at 1 and the far plane at 10
+	const float n = 1.0f, f = 10.0f;
+	const Matx44f perspective(1, 0, 0, 0,
+							  0, 1, 0, 0,
+							  0, 0, -(f + n) / (f - n), -2 * f * n / (f - n),
+							  0, 0, -1, 0);
+	const vis::frustum::planes_t planes2 = vis::frustum::getPlanes(perspective);
+	ASSERT_TRUE(vis::frustum::isVisible(planes2, Point3f(-0.1f, -0.1f, -5.1f), Point3f(0.1f, 0.1f, -4.9f)));
+	ASSERT_FALSE(vis::frustum::isVisible(planes2, Point3f(-0.1f, -0.1f, 4.9f), Point3f(0.1f, 0.1f, 5.1f)));		// behind the camera
+	ASSERT_FALSE(vis::frustum::isVisible(planes2, Point3f(-0.1f, -0.1f, -20.1f), Point3f(0.1f, 0.1f, -19.9f)));	// beyond the far plane
+	ASSERT_FALSE(vis::frustum::isVisible(planes2, Point3f(9.9f, -0.1f, -5.1f), Point3f(10.1f, 0.1f, -4.9f)));		// to the right
+}
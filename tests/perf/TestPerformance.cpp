@@ -0,0 +1,158 @@
+#include "TestPerformance.h"
+#include "DGM/random.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	std::string getEnv(const char *name, const std::string &defaultValue)
+	{
+		const char *value = getenv(name);
+		return value && *value ? std::string(value) : defaultValue;
+	}
+
+	// Returns the node potentials Mat(size: size; type: CV_32FC(nStates)) in range [0.1; 1]
+	Mat getPotentials(Size size, byte nStates)
+	{
+		random::CPhilox generator = random::getStream(0);
+		Mat res(size, CV_32FC(nStates));
+		for (int y = 0; y < size.height; y++) {
+			float *pRes = res.ptr<float>(y);
+			for (int i = 0; i < size.width * nStates; i++) pRes[i] = random::U<float>(generator, 0.1f, 1.0f);
+		}
+		return res;
+	}
+
+	// Returns the feature image Mat(size: size; type: CV_8UC(nFeatures)) with the groundtruth of blocks of 16 x 16 pixels
+	Mat getFeatures(Size size, byte nStates, byte nFeatures, Mat &gt)
+	{
+		random::CPhilox generator = random::getStream(0);
+		gt.create(size, CV_8UC1);
+		Mat res(size, CV_8UC(nFeatures));
+		for (int y = 0; y < size.height; y++)
+			for (int x = 0; x < size.width; x++) {
+				const byte s = static_cast<byte>((x / 16 + y / 16) % nStates);
+				gt.at<byte>(y, x) = s;
+				for (byte f = 0; f < nFeatures; f++)
+					res.ptr<byte>(y)[x * nFeatures + f] = static_cast<byte>(random::u<int>(generator, 0, 60) + 195 * (s + f) / (nStates + nFeatures));
+			}
+		return res;
+	}
+}
+
+CTestPerformance::CTestPerformance(void)
+	: m_fileName(getEnv("DGM_PERF_BUDGETS", DGM_PERF_BUDGETS_FILE))
+	, m_profile(getEnv("DGM_PERF_PROFILE", "default"))
+	, m_tolerance(atof(getEnv("DGM_PERF_TOLERANCE", "0.2").c_str()))
+	, m_record(!getEnv("DGM_PERF_RECORD", "").empty())
+{}
+
+double CTestPerformance::measure(const std::function<void(void)> &run, size_t nItems, size_t nRuns)
+{
+	run();																// warm-up: the thread pool, the scratch buffers and the caches
+	double res = 0;
+	for (size_t r = 0; r < nRuns; r++) {
+		const auto begin = std::chrono::steady_clock::now();
+		run();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		res = MAX(res, nItems / MAX(seconds, 1e-9));
+	}
+	return res;
+}
+
+void CTestPerformance::checkThroughput(const std::string &workload, double throughput)
+{
+	if (m_record) {
+		std::ofstream file(m_fileName, std::ios::app);
+		ASSERT_TRUE(file.is_open()) << "Can't open file " << m_fileName;
+		file << m_profile << " " << workload << " " << static_cast<long long>(throughput) << std::endl;
+		printf("[  RECORD  ] %s %s: %.0f items/s\n", m_profile.c_str(), workload.c_str(), throughput);
+		return;
+	}
+
+	// The last budget of the profile is used, thus a re-recorded budget overrides the older one
+	double budget = 0;
+	std::ifstream file(m_fileName);
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream ss(line);
+		std::string profile, name;
+		double value;
+		if (line.empty() || line[0] == '#') continue;
+		if (ss >> profile >> name >> value && profile == m_profile && name == workload) budget = value;
+	}
+
+	if (budget <= 0) {
+		printf("[ NO BUDGET] %s %s: %.0f items/s (record it with DGM_PERF_RECORD=1)\n", m_profile.c_str(), workload.c_str(), throughput);
+		return;
+	}
+	printf("[  BUDGET  ] %s %s: %.0f items/s (budget: %.0f items/s)\n", m_profile.c_str(), workload.c_str(), throughput, budget);
+	ASSERT_GE(throughput, (1 - m_tolerance) * budget) << workload << " has regressed by " << 100 * (1 - throughput / budget) << "%";
+}
+
+TEST_F(CTestPerformance, grid_LBP_512x512x10)
+{
+	const byte	nStates = 10;
+	const Size	size(512, 512);
+	const Mat	pots = getPotentials(size, nStates);
+
+	CGraphPairwiseKit graphKit(nStates, INFER::LBP, GraphType::grid);
+	graphKit.getGraphExt().buildGraph(size);
+	graphKit.getGraphExt().setGraph(pots);
+	graphKit.getGraphExt().addDefaultEdgesModel(100.0f, 3.0f);
+	graphKit.getInfer().setKeepPotentials(true);					// the node potentials survive the runs
+
+	const double throughput = measure([&] { graphKit.getInfer().decode(10); }, static_cast<size_t>(size.area()));
+	checkThroughput("grid_LBP_512x512x10", throughput);
+}
+
+TEST_F(CTestPerformance, grid_LBP_batched_1024x1024x2)
+{
+	const byte	nStates = 2;
+	const Size	size(1024, 1024);
+	const Mat	pots = getPotentials(size, nStates);
+
+	CGraphPairwiseKit graphKit(nStates, INFER::LBP, GraphType::grid);
+	graphKit.getGraphExt().buildGraph(size);
+	graphKit.getGraphExt().setGraph(pots);
+	graphKit.getGraphExt().addDefaultEdgesModel(100.0f, 3.0f);
+	graphKit.getInfer().setKeepPotentials(true);
+	dynamic_cast<CInferLBP &>(graphKit.getInfer()).setEdgeBatched(true);
+
+	const double throughput = measure([&] { graphKit.getInfer().decode(10); }, static_cast<size_t>(size.area()));
+	checkThroughput("grid_LBP_batched_1024x1024x2", throughput);
+}
+
+TEST_F(CTestPerformance, dense_CRF_256x256x6)
+{
+	const byte	nStates = 6;
+	const Size	size(256, 256);
+	const Mat	pots = getPotentials(size, nStates);
+	Mat gt;
+	const Mat	features = getFeatures(size, nStates, 3, gt);
+
+	CGraphDenseKit graphKit(nStates);
+	const double throughput = measure([&] {
+		graphKit.getGraph().reset();
+		graphKit.getGraphExt().setGraph(pots);
+		graphKit.getGraphExt().addDefaultEdgesModel(100.0f, 3.0f);
+		graphKit.getGraphExt().addDefaultEdgesModel(features, 300.0f, 10.0f);
+		graphKit.getInfer().decode(10);
+	}, static_cast<size_t>(size.area()));
+	checkThroughput("dense_CRF_256x256x6", throughput);
+}
+
+TEST_F(CTestPerformance, GMM_predict_1M)
+{
+	const byte	nStates		= 6;
+	const byte	nFeatures	= 3;
+	Mat gt;
+	const Mat	features = getFeatures(Size(1024, 1024), nStates, nFeatures, gt);
+
+	CTrainNodeGMM nodeTrainer(nStates, nFeatures);
+	nodeTrainer.addFeatureVecs(features(Rect(0, 0, 256, 256)).clone(), gt(Rect(0, 0, 256, 256)).clone());
+	nodeTrainer.train();
+
+	const double throughput = measure([&] { nodeTrainer.getNodePotentials(features); }, static_cast<size_t>(features.total()));
+	checkThroughput("GMM_predict_1M", throughput);
+}
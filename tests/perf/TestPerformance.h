@@ -0,0 +1,29 @@
+#pragma once
+
+#include "gtest/gtest.h"
+#include "types.h"
+#include "DGM.h"
+#include <functional>
+
+using namespace DirectGraphicalModels;
+
+// Performance regression tests: the throughput of the reference workloads is compared with the budgets of the machine profile
+class CTestPerformance : public ::testing::Test {
+public:
+	CTestPerformance(void);
+	~CTestPerformance(void) = default;
+
+
+protected:
+	// Returns the best throughput in items per second of nRuns runs, after one warm-up run
+	static double	measure(const std::function<void(void)> &run, size_t nItems, size_t nRuns = 3);
+	// Compares the throughput with the budget of the workload, or records it as the new budget
+	void			checkThroughput(const std::string &workload, double throughput);
+
+
+private:
+	std::string		m_fileName;		// the file with the budgets
+	std::string		m_profile;		// the machine profile
+	double			m_tolerance;	// the allowed relative regression
+	bool			m_record;		// flag indicating whether the measured throughputs are recorded as the budgets
+};
@@ -0,0 +1,372 @@
+// Batch processing of image collections with the persistent models and graphs
+// Written by Sergey G. Kosov in 2026 for Project X
+#include "DGM.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+using namespace DirectGraphicalModels;
+
+namespace
+{
+	/// Pipeline description: ref. print_help()
+	struct Pipeline {
+		std::string	type		= "crf";
+		byte		nStates		= 0;
+		word		nFeatures	= 0;
+		int			nodeModel	= Bayes;
+		std::string	nodeFile;
+		int			edgeModel	= -1;
+		std::string	edgeFile;
+		vec_float_t	vEdgeParams	= { 100.0f };
+		INFER		infer		= INFER::TRW;
+		unsigned int nIt		= 100;
+		Size		size		= Size(0, 0);
+		int			minDisparity = 0;
+		int			maxDisparity = 0;
+	};
+
+	/// The per-stage timing statistics, collected concurrently
+	class CStats {
+	public:
+		void add(const std::string &stage, double ms)
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			Stage &s = m_stages[stage];
+			if (s.count == 0) m_vOrder.push_back(stage);
+			s.count++;
+			s.total	+= ms;
+			s.max	= MAX(s.max, ms);
+		}
+		void print(void) const
+		{
+			printf("%-12s %8s %12s %10s %10s\n", "stage", "count", "total, ms", "mean, ms", "max, ms");
+			for (const std::string &stage : m_vOrder) {
+				const Stage &s = m_stages.at(stage);
+				printf("%-12s %8zu %12.1f %10.2f %10.2f\n", stage.c_str(), s.count, s.total, s.total / s.count, s.max);
+			}
+		}
+
+	private:
+		struct Stage {
+			size_t	count	= 0;
+			double	total	= 0;
+			double	max		= 0;
+		};
+		mutable std::mutex				m_mtx;
+		std::map<std::string, Stage>	m_stages;
+		std::vector<std::string>		m_vOrder;
+	};
+
+	/// Measures the time of one stage
+	class CStageTimer {
+	public:
+		CStageTimer(CStats &stats, const char *stage) : m_stats(stats), m_stage(stage), m_start(std::chrono::steady_clock::now()) {}
+		~CStageTimer(void) { m_stats.add(m_stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count()); }
+
+	private:
+		CStats											  & m_stats;
+		const char										  *	m_stage;
+		std::chrono::steady_clock::time_point				m_start;
+	};
+
+	/**
+	* Pool of the graph kits: the graphs are built once per image size and re-used by the later images of the same size.
+	* Only the potentials of a re-used graph are refilled; its topology and, for the dense graphs, the cached lattices of the spatial edge models are kept
+	*/
+	class CGraphPool {
+	public:
+		using create_function_t = std::function<std::shared_ptr<CGraphKit>(Size)>;
+
+		explicit CGraphPool(create_function_t create) : m_create(std::move(create)) {}
+
+		std::shared_ptr<CGraphKit> acquire(Size size)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mtx);
+				std::vector<std::shared_ptr<CGraphKit>> &vFree = m_free[key(size)];
+				if (!vFree.empty()) {
+					std::shared_ptr<CGraphKit> res = std::move(vFree.back());
+					vFree.pop_back();
+					m_nReused++;
+					return res;
+				}
+			}
+			m_nBuilt++;
+			return m_create(size);
+		}
+		void release(Size size, std::shared_ptr<CGraphKit> pKit)
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_free[key(size)].push_back(std::move(pKit));
+		}
+		size_t getNumBuilt(void) const { return m_nBuilt; }
+		size_t getNumReused(void) const { return m_nReused; }
+
+	private:
+		static std::pair<int, int> key(Size size) { return std::make_pair(size.width, size.height); }
+
+		create_function_t												m_create;
+		std::mutex														m_mtx;
+		std::map<std::pair<int, int>, std::vector<std::shared_ptr<CGraphKit>>>	m_free;
+		std::atomic<size_t>												m_nBuilt{ 0 };
+		std::atomic<size_t>												m_nReused{ 0 };
+	};
+
+	std::string trim(const std::string &str)
+	{
+		const size_t begin	= str.find_first_not_of(" \t\r\n");
+		const size_t end	= str.find_last_not_of(" \t\r\n");
+		return begin == std::string::npos ? std::string() : str.substr(begin, end - begin + 1);
+	}
+
+	INFER parseInfer(const std::string &str)
+	{
+		if (str == "LBP")			return INFER::LBP;
+		if (str == "ResidualBP")	return INFER::ResidualBP;
+		if (str == "TRW")			return INFER::TRW;
+		if (str == "Viterbi")		return INFER::Viterbi;
+		if (str == "GraphCut")		return INFER::GraphCut;
+		throw std::runtime_error("Unknown inference: " + str);
+	}
+
+	// Reads the "key = value" lines of the pipeline description; the text after '#' is ignored
+	Pipeline loadPipeline(const std::string &fileName)
+	{
+		std::ifstream file(fileName);
+		if (!file) throw std::runtime_error("Can't open " + fileName);
+
+		Pipeline res;
+		std::string line;
+		while (std::getline(file, line)) {
+			line = trim(line.substr(0, line.find('#')));
+			if (line.empty()) continue;
+			const size_t pos = line.find('=');
+			if (pos == std::string::npos) throw std::runtime_error("Wrong line in " + fileName + ": " + line);
+			const std::string	key = trim(line.substr(0, pos));
+			std::istringstream	value(trim(line.substr(pos + 1)));
+			int	a = 0, b = 0;
+			if		(key == "pipeline")		value >> res.type;
+			else if (key == "states")		{ value >> a; res.nStates = static_cast<byte>(a); }
+			else if (key == "features")		{ value >> a; res.nFeatures = static_cast<word>(a); }
+			else if (key == "node_model")	value >> res.nodeModel;
+			else if (key == "node_file")	value >> res.nodeFile;
+			else if (key == "edge_model")	value >> res.edgeModel;
+			else if (key == "edge_file")	value >> res.edgeFile;
+			else if (key == "edge_params")	{ res.vEdgeParams.clear(); for (float p; value >> p;) res.vEdgeParams.push_back(p); }
+			else if (key == "infer")		{ std::string str; value >> str; res.infer = parseInfer(str); }
+			else if (key == "iterations")	value >> res.nIt;
+			else if (key == "size")			{ value >> a >> b; res.size = Size(a, b); }
+			else if (key == "disparity")	value >> res.minDisparity >> res.maxDisparity;
+			else throw std::runtime_error("Unknown key in " + fileName + ": " + key);
+			if (value.fail() && !value.eof()) throw std::runtime_error("Wrong value in " + fileName + ": " + line);
+		}
+
+		if (res.type != "crf" && res.type != "dense" && res.type != "stereo") throw std::runtime_error("Unknown pipeline: " + res.type);
+		if (res.type == "stereo") {
+			if (res.maxDisparity <= res.minDisparity || res.maxDisparity - res.minDisparity > 255) throw std::runtime_error("The number of disparities must be in range [1; 255]");
+			res.nStates = static_cast<byte>(res.maxDisparity - res.minDisparity);
+		}
+		else if (res.nFeatures == 0) throw std::runtime_error("The number of features is not set");
+		if (res.nStates == 0) throw std::runtime_error("The number of states is not set");
+		if (res.type != "stereo" && res.nodeFile.empty()) throw std::runtime_error("The node model file is not set");
+		if (res.edgeModel >= 0 && res.edgeFile.empty()) throw std::runtime_error("The edge model file is not set");
+		if (res.vEdgeParams.empty()) throw std::runtime_error("The edge parameters are not set");
+		return res;
+	}
+
+	// Reads the input lines: the input images and the output image, separated with the whitespaces
+	std::vector<std::vector<std::string>> loadInputs(const std::string &fileName, size_t nFiles)
+	{
+		std::ifstream file(fileName);
+		if (!file) throw std::runtime_error("Can't open " + fileName);
+
+		std::vector<std::vector<std::string>> res;
+		std::string line;
+		while (std::getline(file, line)) {
+			line = trim(line.substr(0, line.find('#')));
+			if (line.empty()) continue;
+			std::istringstream			stream(line);
+			std::vector<std::string>	vFiles;
+			for (std::string str; stream >> str;) vFiles.push_back(str);
+			if (vFiles.size() != nFiles) throw std::runtime_error("Wrong number of files in " + fileName + ": " + line);
+			res.push_back(std::move(vFiles));
+		}
+		return res;
+	}
+
+	Mat readImage(const std::string &fileName, int flags, Size size, int interpolation)
+	{
+		Mat res = imread(fileName, flags);
+		if (res.empty()) throw std::runtime_error("Can't open " + fileName);
+		if (size.area() > 0 && res.size() != size) resize(res, res, size, 0, 0, interpolation);
+		return res;
+	}
+
+	// Checks the input images against the pipeline: the library asserts on the mismatches, which would abort the whole batch instead of skipping the input
+	void validateInput(const Pipeline &pipeline, const Mat &img, const Mat &imgR)
+	{
+		if (pipeline.type == "stereo") {
+			if (img.type() != CV_8UC1 || imgR.type() != CV_8UC1) throw std::runtime_error("The stereo images must be 8-bit grayscale images");
+			if (img.size() != imgR.size())
+				throw std::runtime_error("The sizes of the left (" + std::to_string(img.cols) + " x " + std::to_string(img.rows) + ") and the right (" +
+					std::to_string(imgR.cols) + " x " + std::to_string(imgR.rows) + ") images differ");
+		}
+		else {
+			if (img.depth() != CV_8U) throw std::runtime_error("The features image must be an 8-bit image");
+			if (img.channels() != pipeline.nFeatures)
+				throw std::runtime_error("The features image has " + std::to_string(img.channels()) + " channels, while the pipeline has " + std::to_string(pipeline.nFeatures) + " features");
+		}
+	}
+}
+
+void print_help(char *argv0)
+{
+	printf("Usage: %s pipeline_description input_list [jobs]\n", argv0);
+
+	printf("\nThe pipeline description consists of the \"key = value\" lines:\n");
+	printf("pipeline    = crf | dense | stereo\n");
+	printf("states      = number of states (crf and dense)\n");
+	printf("features    = number of features (crf and dense)\n");
+	printf("node_model  = node training model, ref. \"Demo Train\" (crf and dense)\n");
+	printf("node_file   = node model file, saved with CBaseRandomModel::saveModel() (crf and dense)\n");
+	printf("edge_model  = edge training model, ref. \"Demo Train\". If not set, the Potts model is used (crf)\n");
+	printf("edge_file   = edge model file, saved with CBaseRandomModel::saveModel() (crf)\n");
+	printf("edge_params = parameters of the edge model (default: 100)\n");
+	printf("infer       = LBP | ResidualBP | TRW | Viterbi | GraphCut (crf and stereo; default: TRW)\n");
+	printf("iterations  = number of the inference iterations (default: 100)\n");
+	printf("size        = width height: the input images are resized (default: no resizing)\n");
+	printf("disparity   = min_disparity max_disparity (stereo)\n");
+
+	printf("\nEvery line of the input list holds the file names of one input, separated with the whitespaces:\n");
+	printf("crf, dense: features_image output_image\n");
+	printf("stereo:     left_image right_image output_image\n");
+	printf("The features image must have as many channels, as there are features: the color images are read for 3 features, the grayscale ones for 1 feature\n");
+	printf("and the images as they are stored otherwise. The inputs, which do not match the pipeline, are skipped.\n");
+
+	printf("\nThe inputs are processed by at most \"jobs\" concurrent workers (default: the number of the hardware threads).\n");
+	printf("The models are loaded once, and the graphs are re-used by the inputs of the same size.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3 && argc != 4) {
+		print_help(argv[0]);
+		return 0;
+	}
+
+	try {
+		CStats	 stats;
+		const auto start = std::chrono::steady_clock::now();
+
+		// ========================= Loading the models once =========================
+		const Pipeline pipeline = loadPipeline(argv[1]);
+		const std::vector<std::vector<std::string>> vInputs = loadInputs(argv[2], pipeline.type == "stereo" ? 3 : 2);
+		const size_t jobs = argc == 4 ? static_cast<size_t>(atoi(argv[3])) : 0;
+
+		std::shared_ptr<const CTrainNode> nodeTrainer;
+		std::shared_ptr<const CTrainEdge> edgeTrainer;
+		{
+			CStageTimer timer(stats, "models");
+			if (pipeline.type != "stereo") {
+				auto pNodeTrainer = CTrainNode::create(static_cast<byte>(pipeline.nodeModel), pipeline.nStates, pipeline.nFeatures);
+				pNodeTrainer->loadModel(pipeline.nodeFile);
+				nodeTrainer = pNodeTrainer;
+			}
+			if (pipeline.type == "crf" && pipeline.edgeModel >= 0) {
+				auto pEdgeTrainer = CTrainEdge::create(static_cast<byte>(pipeline.edgeModel), pipeline.nStates, pipeline.nFeatures);
+				pEdgeTrainer->loadModel(pipeline.edgeFile);
+				edgeTrainer = pEdgeTrainer;
+			}
+		}
+		const CStereoCost stereoCost(pipeline.minDisparity, MAX(pipeline.maxDisparity, pipeline.minDisparity + 1));
+
+		// The data-independent edges are set once, when the graph is built
+		CGraphPool pool([&](Size size) -> std::shared_ptr<CGraphKit> {
+			CStageTimer timer(stats, "build");
+			std::shared_ptr<CGraphKit> res;
+			if (pipeline.type == "dense") res = CGraphKit::create(GraphType::dense, pipeline.nStates);
+			else res = std::make_shared<CGraphPairwiseKit>(pipeline.nStates, pipeline.infer);
+			res->getGraphExt().buildGraph(size);
+			if (pipeline.type != "dense" && !edgeTrainer) res->getGraphExt().addDefaultEdgesModel(pipeline.vEdgeParams[0]);
+			return res;
+		});
+
+		// ========================= Processing the inputs =========================
+		std::atomic<size_t> nFailed(0);
+		parallel::parallelFor(Range(0, static_cast<int>(vInputs.size())), [&](const Range &range) {
+			for (int i = range.start; i < range.end; i++) {
+				const std::vector<std::string> &vFiles = vInputs[i];
+				try {
+					Mat img, imgR, pots;
+					{
+						CStageTimer timer(stats, "read");
+						if (pipeline.type == "stereo") {
+							img  = readImage(vFiles[0], 0, pipeline.size, INTER_LANCZOS4);
+							imgR = readImage(vFiles[1], 0, pipeline.size, INTER_LANCZOS4);
+						}
+						else img = readImage(vFiles[0], pipeline.nFeatures == 3 ? IMREAD_COLOR : pipeline.nFeatures == 1 ? IMREAD_GRAYSCALE : IMREAD_UNCHANGED, pipeline.size, INTER_LANCZOS4);
+						validateInput(pipeline, img, imgR);
+					}
+					{
+						CStageTimer timer(stats, "potentials");
+						pots = pipeline.type == "stereo" ? stereoCost.getPotentials(img, imgR) : nodeTrainer->getNodePotentials(img);
+					}
+
+					std::shared_ptr<CGraphKit> pKit = pool.acquire(img.size());
+					vec_byte_t solution;
+					try {
+						{
+							CStageTimer timer(stats, "fill");
+							if (pipeline.type == "dense") {
+								pKit->getGraph().reset();								// drops the edge models of the previous image
+								pKit->getGraphExt().setGraph(pots);
+								pKit->getGraphExt().addDefaultEdgesModel(pipeline.vEdgeParams[0], 3.0f);
+								pKit->getGraphExt().addDefaultEdgesModel(img, pipeline.vEdgeParams.size() > 1 ? pipeline.vEdgeParams[1] : 300.0f, 10.0f);
+							}
+							else {
+								pKit->getGraphExt().setGraph(pots);
+								if (edgeTrainer) dynamic_cast<CGraphPairwiseExt &>(pKit->getGraphExt()).fillEdges(*edgeTrainer, img, pipeline.vEdgeParams);
+							}
+						}
+						{
+							CStageTimer timer(stats, "decode");
+							solution = pKit->getInfer().decode(pipeline.nIt);
+						}
+					}
+					catch (...) {
+						pool.release(img.size(), std::move(pKit));
+						throw;
+					}
+					pool.release(img.size(), std::move(pKit));
+
+					{
+						CStageTimer timer(stats, "write");
+						Mat res(img.size(), CV_8UC1, solution.data());
+						if (pipeline.type == "stereo") res = (res + pipeline.minDisparity) * (256 / MAX(1, pipeline.maxDisparity));
+						if (!imwrite(vFiles.back(), res)) throw std::runtime_error("Can't write " + vFiles.back());
+					}
+				}
+				catch (const std::exception &e) {
+					printf("Input %d is skipped: %s\n", i, e.what());
+					nFailed++;
+				}
+			} // i
+		}, 1, jobs);
+
+		// ========================= Statistics =========================
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("\n");
+		stats.print();
+		printf("\nInputs: %zu processed, %zu skipped in %.2f s (%.2f inputs/s)\n", vInputs.size() - nFailed, nFailed.load(), seconds, vInputs.size() / MAX(seconds, 1e-9));
+		printf("Graphs: %zu built, %zu re-used\n", pool.getNumBuilt(), pool.getNumReused());
+		return nFailed ? 1 : 0;
+	}
+	catch (const std::exception &e) {
+		printf("%s\n", e.what());
+		return 1;
+	}
+}